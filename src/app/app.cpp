@@ -15,6 +15,7 @@
 #include "app/check_update.h"
 #include "app/cli/app_options.h"
 #include "app/cli/cli_processor.h"
+#include "app/cli/cli_server.h"
 #include "app/cli/default_cli_delegate.h"
 #include "app/cli/preview_cli_delegate.h"
 #include "app/color_spaces.h"
@@ -36,6 +37,7 @@
 #include "app/modules/gui.h"
 #include "app/modules/palettes.h"
 #include "app/pref/preferences.h"
+#include "app/profiler.h"
 #include "app/recent_files.h"
 #include "app/resource_finder.h"
 #include "app/send_crash.h"
@@ -55,11 +57,13 @@
 #include "app/ui/workspace.h"
 #include "app/ui_context.h"
 #include "app/util/clipboard.h"
+#include "base/chrono.h"
 #include "base/exception.h"
 #include "base/fs.h"
 #include "base/platform.h"
 #include "base/replace_string.h"
 #include "base/split_string.h"
+#include "doc/memory_account.h"
 #include "doc/sprite.h"
 #include "fmt/format.h"
 #include "os/error.h"
@@ -139,8 +143,11 @@ public:
   Extensions m_extensions;
   // Load main language (after loading the extensions)
   LoadLanguage m_loadLanguage;
-  tools::ToolBox m_toolbox;
-  tools::ActiveToolManager m_activeToolManager;
+  // The tool box (and the active tool manager) are created the first
+  // time they are needed, so in batch mode we don't parse the tools
+  // from gui.xml if no script uses tools.
+  std::unique_ptr<tools::ToolBox> m_toolbox;
+  std::unique_ptr<tools::ActiveToolManager> m_activeToolManager;
   Commands m_commands;
   RecentFiles m_recent_files;
   InputChain m_inputChain;
@@ -156,7 +163,6 @@ public:
           Preferences& pref)
     : m_loggerModule(createLogInDesktop)
     , m_loadLanguage(pref, m_extensions)
-    , m_activeToolManager(&m_toolbox)
     , m_recent_files(pref.general.recentItems())
 #ifdef ENABLE_DATA_RECOVERY
     , m_recovery(nullptr)
@@ -169,6 +175,20 @@ public:
     ASSERT(m_recovery == nullptr ||
            ui::get_app_state() == ui::AppState::kClosingWithException);
 #endif
+    // The active tool manager references the tool box
+    m_activeToolManager.reset();
+  }
+
+  tools::ToolBox* toolBox() {
+    if (!m_toolbox)
+      m_toolbox = std::make_unique<tools::ToolBox>();
+    return m_toolbox.get();
+  }
+
+  tools::ActiveToolManager* activeToolManager() {
+    if (!m_activeToolManager)
+      m_activeToolManager = std::make_unique<tools::ActiveToolManager>(toolBox());
+    return m_activeToolManager.get();
   }
 
   app::crash::DataRecovery* recovery() {
@@ -240,6 +260,7 @@ App::App(AppMod* mod)
   , m_legacy(nullptr)
   , m_isGui(false)
   , m_isShell(false)
+  , m_isServer(false)
   , m_backupIndicator(nullptr)
 #ifdef ENABLE_SCRIPTING
   , m_engine(new script::Engine)
@@ -251,7 +272,13 @@ App::App(AppMod* mod)
 
 int App::initialize(const AppOptions& options)
 {
+  // --trace <filename.json>
+  m_traceFilename = options.traceFilename();
+  if (!m_traceFilename.empty())
+    start_profiler();
+
   os::System* system = os::instance();
+  base::Chrono chrono;
 
   m_isGui = options.startUI() && !options.previewCLI();
 
@@ -265,6 +292,7 @@ int App::initialize(const AppOptions& options)
 #endif
 
   m_isShell = options.startShell();
+  m_isServer = options.startServer();
   m_coreModules = std::make_unique<CoreModules>();
 
   auto& pref = preferences();
@@ -321,6 +349,21 @@ int App::initialize(const AppOptions& options)
 
   initialize_color_spaces(pref);
 
+  // Soft limit for the memory of render caches/thumbnails/etc.
+  doc::set_memory_soft_limit(size_t(pref.general.cacheMemoryLimit()) * 1024 * 1024);
+  pref.general.cacheMemoryLimit.AfterChange.connect(
+    [](int limit){
+      doc::set_memory_soft_limit(size_t(limit) * 1024 * 1024);
+    });
+
+  // Statistics of profiler zones for the frame-time HUD of the editor
+  if (pref.perf.showFrameStats())
+    enable_profiler_stats(true);
+  pref.perf.showFrameStats.AfterChange.connect(
+    [](bool state){
+      enable_profiler_stats(state);
+    });
+
 #ifdef ENABLE_DRM
   LOG("APP: Initializing DRM...\n");
   app_configure_drm();
@@ -331,10 +374,13 @@ int App::initialize(const AppOptions& options)
     m_inAppSteam = false;
 #endif
 
+  LOG("APP: Core modules initialized (%.2f ms)\n", 1000.0*chrono.elapsed());
+
   // Load modules
   m_modules = std::make_unique<Modules>(createLogInDesktop, pref);
   m_legacy = std::make_unique<LegacyModules>(isGui() ? REQUIRE_INTERFACE: 0);
   m_brushes = std::make_unique<AppBrushes>();
+  LOG("APP: Modules initialized (%.2f ms)\n", 1000.0*chrono.elapsed());
 
   // Data recovery is enabled only in GUI mode
   if (isGui() && pref.general.dataRecovery())
@@ -344,8 +390,13 @@ int App::initialize(const AppOptions& options)
     LOG("APP: Running in portable mode\n");
 
   // Load or create the default palette, or migrate the default
-  // palette from an old format palette to the new one, etc.
-  load_default_palette();
+  // palette from an old format palette to the new one, etc. In batch
+  // mode it's loaded the first time it's used (many CLI operations
+  // don't need it at all).
+  if (isGui())
+    load_default_palette();
+  else
+    defer_default_palette_loading();
 
   // Initialize GUI interface
   if (isGui()) {
@@ -396,12 +447,14 @@ int App::initialize(const AppOptions& options)
     const bool gpu = Preferences::instance().general.gpuAcceleration();
     manager->updateAllDisplays(scale, gpu);
 #endif
+    LOG("APP: GUI initialized (%.2f ms)\n", 1000.0*chrono.elapsed());
   }
 
 #ifdef ENABLE_SCRIPTING
   // Call the init() function from all plugins
   LOG("APP: Initializing scripts...\n");
   extensions().executeInitActions();
+  LOG("APP: Scripts initialized (%.2f ms)\n", 1000.0*chrono.elapsed());
 #endif
 
   // Process options
@@ -417,6 +470,7 @@ int App::initialize(const AppOptions& options)
     CliProcessor cli(delegate.get(), options);
     code = cli.process(context());
   }
+  LOG("APP: Options processed (%.2f ms)\n", 1000.0*chrono.elapsed());
 
   LOG("APP: Finish launching...\n");
   system->finishLaunching();
@@ -574,6 +628,12 @@ void App::run()
   }
 #endif  // ENABLE_SCRIPTING
 
+  // Execute CLI jobs from stdin
+  if (m_isServer) {
+    CliServer server;
+    server.run(context());
+  }
+
   // ----------------------------------------------------------------------
 
 #ifdef ENABLE_SCRIPTING
@@ -647,6 +707,12 @@ App::~App()
     // Destroy the loaded gui.xml data.
     KeyboardShortcuts::destroyInstance();
     GuiXml::destroyInstance();
+
+    if (!m_traceFilename.empty()) {
+      stop_profiler();
+      if (!save_profiler_trace(m_traceFilename))
+        LOG(ERROR, "APP: Error saving trace file %s\n", m_traceFilename.c_str());
+    }
   }
   catch (const std::exception& e) {
     LOG(ERROR, "APP: Error: %s\n", e.what());
@@ -683,17 +749,17 @@ bool App::isPortable()
 tools::ToolBox* App::toolBox() const
 {
   ASSERT(m_modules != NULL);
-  return &m_modules->m_toolbox;
+  return m_modules->toolBox();
 }
 
 tools::Tool* App::activeTool() const
 {
-  return m_modules->m_activeToolManager.activeTool();
+  return m_modules->activeToolManager()->activeTool();
 }
 
 tools::ActiveToolManager* App::activeToolManager() const
 {
-  return &m_modules->m_activeToolManager;
+  return m_modules->activeToolManager();
 }
 
 RecentFiles* App::recentFiles() const
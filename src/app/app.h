@@ -137,6 +137,7 @@ namespace app {
     std::unique_ptr<LegacyModules> m_legacy;
     bool m_isGui;
     bool m_isShell;
+    bool m_isServer;
 #ifdef ENABLE_STEAM
     bool m_inAppSteam = true;
 #endif
@@ -151,6 +152,10 @@ namespace app {
     // Set the memory dump filename to show in the Preferences dialog
     // or the "send crash" dialog. It's set by the SendCrash class.
     std::string m_memoryDumpFilename;
+
+    // Trace file to save the profiler zones when the app exits
+    // (--trace option).
+    std::string m_traceFilename;
   };
 
   void app_refresh_screen();
@@ -21,6 +21,7 @@ AppOptions::AppOptions(int argc, const char* argv[])
   : m_exeName(base::get_file_name(argv[0]))
   , m_startUI(true)
   , m_startShell(false)
+  , m_startServer(false)
   , m_previewCLI(false)
   , m_showHelp(false)
   , m_showVersion(false)
@@ -29,7 +30,9 @@ AppOptions::AppOptions(int argc, const char* argv[])
   , m_shell(m_po.add("shell").description("Start an interactive console to execute scripts"))
 #endif
   , m_batch(m_po.add("batch").mnemonic('b').description("Do not start the UI"))
+  , m_server(m_po.add("server").description("Do not start the UI and execute jobs\nreceived from stdin (one JSON object\nper line with the CLI \"args\" array)"))
   , m_preview(m_po.add("preview").mnemonic('p').description("Do not execute actions, just print what will be\ndone"))
+  , m_jobs(m_po.add("jobs").mnemonic('j').requiresValue("<n>").description("Load up to <n> input files in parallel\nin batch mode (0 = number of CPU cores)"))
   , m_saveAs(m_po.add("save-as").requiresValue("<filename>").description("Save the last given sprite with other format"))
   , m_palette(m_po.add("palette").requiresValue("<filename>").description("Change the palette of the last given sprite"))
   , m_scale(m_po.add("scale").requiresValue("<factor>").description("Resize all previously opened sprites"))
@@ -38,10 +41,11 @@ AppOptions::AppOptions(int argc, const char* argv[])
   , m_colorMode(m_po.add("color-mode").requiresValue("<mode>").description("Change color mode of all previously\nopened sprites:\n  rgb\n  grayscale\n  indexed"))
   , m_shrinkTo(m_po.add("shrink-to").requiresValue("width,height").description("Shrink each sprite if it is\nlarger than width or height"))
   , m_data(m_po.add("data").requiresValue("<filename.json>").description("File to store the sprite sheet metadata"))
-  , m_format(m_po.add("format").requiresValue("<format>").description("Format to export the data file\n(json-hash, json-array)"))
+  , m_format(m_po.add("format").requiresValue("<format>").description("Format to export the data file\n(json-hash, json-array, msgpack)"))
   , m_sheet(m_po.add("sheet").requiresValue("<filename.png>").description("Image file to save the texture"))
   , m_sheetType(m_po.add("sheet-type").requiresValue("<type>").description("Algorithm to create the sprite sheet:\n  horizontal\n  vertical\n  rows\n  columns\n  packed"))
   , m_sheetPack(m_po.add("sheet-pack").description("Same as -sheet-type packed"))
+  , m_sheetIncremental(m_po.add("sheet-incremental").description("Re-use unchanged frames of the previous\n-sheet and -data files (their position in\na packed sheet and their pixels)"))
   , m_sheetWidth(m_po.add("sheet-width").requiresValue("<pixels>").description("Sprite sheet width"))
   , m_sheetHeight(m_po.add("sheet-height").requiresValue("<pixels>").description("Sprite sheet height"))
   , m_sheetColumns(m_po.add("sheet-columns").requiresValue("<columns>").description("Fixed # of columns for -sheet-type rows"))
@@ -79,8 +83,11 @@ AppOptions::AppOptions(int argc, const char* argv[])
   , m_listSlices(m_po.add("list-slices").description("List slices of the next given sprite\nor include slices in JSON data"))
   , m_oneFrame(m_po.add("oneframe").description("Load just the first frame"))
   , m_exportTileset(m_po.add("export-tileset").description("Export only tilesets from visible tilemap layers"))
+  , m_compare(m_po.add("compare").requiresValue("<filename>").description("Compare the last given sprite with other\nfile, exits with code 1 if they are different"))
+  , m_stats(m_po.add("stats").description("Print the number of saved frames and the\nthroughput (frames/s, MB/s) of each --save-as"))
   , m_verbose(m_po.add("verbose").mnemonic('v').description("Explain what is being done"))
   , m_debug(m_po.add("debug").description("Extreme verbose mode and\ncopy log to desktop"))
+  , m_trace(m_po.add("trace").requiresValue("<filename.json>").description("Profile the program and save a Chrome Trace\nfile (chrome://tracing or ui.perfetto.dev)\nwhen it exits"))
 #ifdef ENABLE_STEAM
   , m_noInApp(m_po.add("noinapp").description("Disable \"in game\" visibility on Steam\nDoesn't count playtime"))
 #endif
@@ -98,14 +105,21 @@ AppOptions::AppOptions(int argc, const char* argv[])
     else if (m_po.enabled(m_verbose))
       m_verboseLevel = kVerbose;
 
+    for (const auto& value : m_po.values()) {
+      if (value.option() == &m_trace)
+        m_traceFilename = value.value();
+    }
+
 #ifdef ENABLE_SCRIPTING
     m_startShell = m_po.enabled(m_shell);
 #endif
+    m_startServer = m_po.enabled(m_server);
     m_previewCLI = m_po.enabled(m_preview);
     m_showHelp = m_po.enabled(m_help);
     m_showVersion = m_po.enabled(m_version);
 
     if (m_startShell ||
+        m_startServer ||
         m_showHelp ||
         m_showVersion ||
         m_po.enabled(m_batch)) {
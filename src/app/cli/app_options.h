@@ -36,16 +36,19 @@ public:
 
   bool startUI() const { return m_startUI; }
   bool startShell() const { return m_startShell; }
+  bool startServer() const { return m_startServer; }
   bool previewCLI() const { return m_previewCLI; }
   bool showHelp() const { return m_showHelp; }
   bool showVersion() const { return m_showVersion; }
   VerboseLevel verboseLevel() const { return m_verboseLevel; }
+  const std::string& traceFilename() const { return m_traceFilename; }
 
   const ValueList& values() const {
     return m_po.values();
   }
 
   // Export options
+  const Option& jobs() const { return m_jobs; }
   const Option& saveAs() const { return m_saveAs; }
   const Option& palette() const { return m_palette; }
   const Option& scale() const { return m_scale; }
@@ -58,6 +61,7 @@ public:
   const Option& sheet() const { return m_sheet; }
   const Option& sheetType() const { return m_sheetType; }
   const Option& sheetPack() const { return m_sheetPack; }
+  const Option& sheetIncremental() const { return m_sheetIncremental; }
   const Option& sheetWidth() const { return m_sheetWidth; }
   const Option& sheetHeight() const { return m_sheetHeight; }
   const Option& sheetColumns() const { return m_sheetColumns; }
@@ -95,6 +99,8 @@ public:
   const Option& listSlices() const { return m_listSlices; }
   const Option& oneFrame() const { return m_oneFrame; }
   const Option& exportTileset() const { return m_exportTileset; }
+  const Option& compare() const { return m_compare; }
+  const Option& stats() const { return m_stats; }
 
   bool hasExporterParams() const;
 #ifdef ENABLE_STEAM
@@ -111,16 +117,20 @@ private:
   base::ProgramOptions m_po;
   bool m_startUI;
   bool m_startShell;
+  bool m_startServer;
   bool m_previewCLI;
   bool m_showHelp;
   bool m_showVersion;
   VerboseLevel m_verboseLevel;
+  std::string m_traceFilename;
 
 #ifdef ENABLE_SCRIPTING
   Option& m_shell;
 #endif
   Option& m_batch;
+  Option& m_server;
   Option& m_preview;
+  Option& m_jobs;
   Option& m_saveAs;
   Option& m_palette;
   Option& m_scale;
@@ -133,6 +143,7 @@ private:
   Option& m_sheet;
   Option& m_sheetType;
   Option& m_sheetPack;
+  Option& m_sheetIncremental;
   Option& m_sheetWidth;
   Option& m_sheetHeight;
   Option& m_sheetColumns;
@@ -170,9 +181,12 @@ private:
   Option& m_listSlices;
   Option& m_oneFrame;
   Option& m_exportTileset;
+  Option& m_compare;
+  Option& m_stats;
 
   Option& m_verbose;
   Option& m_debug;
+  Option& m_trace;
 #ifdef ENABLE_STEAM
   Option& m_noInApp;
 #endif
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2022  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2016-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -15,6 +15,7 @@ namespace app {
 
   class AppOptions;
   class Context;
+  class Doc;
   class DocExporter;
   class Params;
   struct CliOpenFile;
@@ -32,6 +33,8 @@ namespace app {
     virtual void saveFile(Context* ctx, const CliOpenFile& cof) { }
     virtual void loadPalette(Context* ctx, const std::string& filename) { }
     virtual void exportFiles(Context* ctx, DocExporter& exporter) { }
+    virtual bool compareFile(Context* ctx, const Doc* doc,
+                             const std::string& filename) { return true; }
 #ifdef ENABLE_SCRIPTING
     virtual int execScript(const std::string& filename,
                            const Params& params) {
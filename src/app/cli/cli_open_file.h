@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2016-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -46,6 +46,7 @@ namespace app {
     bool oneFrame = false;
     bool exportTileset = false;
     bool playSubtags = false;
+    bool stats = false;
     gfx::Rect crop;
 
     bool hasTag() const {
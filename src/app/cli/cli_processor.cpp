@@ -38,6 +38,8 @@
 
 #include <algorithm>
 #include <queue>
+#include <set>
+#include <thread>
 #include <vector>
 
 namespace app {
@@ -172,6 +174,9 @@ CliProcessor::CliProcessor(CliDelegate* delegate,
 
 int CliProcessor::process(Context* ctx)
 {
+  // True if some --compare found differences
+  bool differentFiles = false;
+
   // --help
   if (m_options.showHelp()) {
     m_delegate->showHelp(m_options);
@@ -192,6 +197,10 @@ int CliProcessor::process(Context* ctx)
     render::DitheringAlgorithm ditheringAlgorithm = render::DitheringAlgorithm::None;
     std::string ditheringMatrix;
 
+    // --jobs <n>
+    if (!ctx->isUIAvailable())
+      preloadFiles(ctx);
+
     for (const auto& value : m_options.values()) {
       const AppOptions::Option* opt = value.option();
 
@@ -211,6 +220,8 @@ int CliProcessor::process(Context* ctx)
               format = SpriteSheetDataFormat::JsonHash;
             else if (value.value() == "json-array")
               format = SpriteSheetDataFormat::JsonArray;
+            else if (value.value() == "msgpack")
+              format = SpriteSheetDataFormat::MsgPack;
 
             m_exporter->setDataFormat(format);
           }
@@ -257,6 +268,13 @@ int CliProcessor::process(Context* ctx)
         else if (opt == &m_options.sheetPack()) {
           sheetType = SpriteSheetType::Packed;
         }
+        // --sheet-incremental
+        else if (opt == &m_options.sheetIncremental()) {
+          if (m_exporter) {
+            m_exporter->setIncrementalLayout(true);
+            m_exporter->setIncrementalRender(true);
+          }
+        }
         // --split-layers
         else if (opt == &m_options.splitLayers()) {
           cof.splitLayers = true;
@@ -606,6 +624,19 @@ int CliProcessor::process(Context* ctx)
         else if (opt == &m_options.exportTileset()) {
           cof.exportTileset = true;
         }
+        // --stats
+        else if (opt == &m_options.stats()) {
+          cof.stats = true;
+        }
+        // --compare <filename>
+        else if (opt == &m_options.compare()) {
+          if (lastDoc) {
+            if (!m_delegate->compareFile(ctx, lastDoc, value.value()))
+              differentFiles = true;
+          }
+          else
+            console.printf("A document is needed before --compare argument\n");
+        }
       }
       // File names aren't associated to any option
       else {
@@ -622,6 +653,9 @@ int CliProcessor::process(Context* ctx)
       }
     }
 
+    // Stop loading files that weren't used
+    m_preloader.reset();
+
     if (m_exporter) {
       // Rows sprite sheet as the default type
       if (sheetType == SpriteSheetType::None)
@@ -643,7 +677,56 @@ int CliProcessor::process(Context* ctx)
   else {
     m_delegate->batchMode();
   }
-  return 0;
+  return (differentFiles ? 1: 0);
+}
+
+void CliProcessor::preloadFiles(Context* ctx)
+{
+  int jobs = 1;
+  for (const auto& value : m_options.values()) {
+    if (value.option() == &m_options.jobs()) {
+      jobs = strtol(value.value().c_str(), nullptr, 0);
+      if (jobs <= 0)
+        jobs = std::max<int>(1, std::thread::hardware_concurrency());
+    }
+  }
+  if (jobs <= 1)
+    return;
+
+  m_preloader = std::make_unique<FilesPreloader>(ctx, jobs);
+
+  // Input files are loaded in the same order they are going to be
+  // opened by process(), using the --oneframe option given before
+  // each file.
+  std::set<std::string> outputFiles;
+  bool oneFrame = false;
+  for (const auto& value : m_options.values()) {
+    const AppOptions::Option* opt = value.option();
+    if (!opt) {
+      const std::string fn = base::normalize_path(value.value());
+
+      // This file is generated by a previous --save-as, we cannot
+      // load it (nor the next files) in advance.
+      if (outputFiles.find(fn) != outputFiles.end())
+        break;
+
+      m_preloader->add(fn, oneFrame);
+    }
+    else if (opt == &m_options.oneFrame()) {
+      oneFrame = true;
+    }
+    else if (opt == &m_options.saveAs() ||
+             opt == &m_options.sheet() ||
+             opt == &m_options.data()) {
+      outputFiles.insert(base::normalize_path(value.value()));
+    }
+#ifdef ENABLE_SCRIPTING
+    // A script can modify the next input files
+    else if (opt == &m_options.script()) {
+      break;
+    }
+#endif
+  }
 }
 
 bool CliProcessor::openFile(Context* ctx, CliOpenFile& cof)
@@ -652,13 +735,23 @@ bool CliProcessor::openFile(Context* ctx, CliOpenFile& cof)
 
   Doc* oldDoc = ctx->activeDocument();
 
-  m_batch.open(ctx,
-               cof.filename,
-               cof.oneFrame);
+  std::unique_ptr<FileOp> fop;
+  if (m_preloader)
+    fop = m_preloader->take(cof.filename, cof.oneFrame);
+
+  base::paths usedFiles;
+  if (fop)
+    usedFiles = openPreloadedFile(ctx, fop.get());
+  else {
+    m_batch.open(ctx,
+                 cof.filename,
+                 cof.oneFrame);
+    usedFiles = m_batch.usedFiles();
+  }
 
   // Mark used file names as "already processed" so we don't try to
   // open then again
-  for (const auto& usedFn : m_batch.usedFiles()) {
+  for (const auto& usedFn : usedFiles) {
     auto fn = base::normalize_path(usedFn);
     m_usedFiles.insert(fn);
 
@@ -727,6 +820,31 @@ bool CliProcessor::openFile(Context* ctx, CliOpenFile& cof)
   return (doc ? true: false);
 }
 
+// Does the same post-load process of OpenFileCommand (in batch mode)
+// for a file loaded by the FilesPreloader.
+base::paths CliProcessor::openPreloadedFile(Context* ctx, FileOp* fop)
+{
+  base::paths usedFiles;
+  if (fop->isSequence()) {
+    for (const auto& fn : fop->filenames())
+      usedFiles.push_back(base::normalize_path(fn));
+  }
+  else
+    usedFiles.push_back(base::normalize_path(fop->filename()));
+
+  fop->postLoad();
+
+  if (fop->hasError() && !fop->isStop()) {
+    Console console;
+    console.printf(fop->error().c_str());
+  }
+
+  if (Doc* doc = fop->document())
+    doc->setContext(ctx);
+
+  return usedFiles;
+}
+
 void CliProcessor::saveFile(Context* ctx, const CliOpenFile& cof)
 {
   ctx->setActiveDocument(cof.document);
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2016-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -11,8 +11,10 @@
 
 #include "app/cli/cli_delegate.h"
 #include "app/cli/cli_open_file.h"
+#include "app/cli/files_preloader.h"
 #include "app/doc_exporter.h"
 #include "app/util/open_batch.h"
+#include "base/paths.h"
 #include "doc/selected_layers.h"
 
 #include <memory>
@@ -29,6 +31,7 @@ namespace app {
   class AppOptions;
   class Context;
   class DocExporter;
+  class FileOp;
 
   class CliProcessor {
   public:
@@ -44,7 +47,9 @@ namespace app {
                              doc::SelectedLayers& filteredLayers);
 
   private:
+    void preloadFiles(Context* ctx);
     bool openFile(Context* ctx, CliOpenFile& cof);
+    base::paths openPreloadedFile(Context* ctx, FileOp* fop);
     void saveFile(Context* ctx, const CliOpenFile& cof);
 
     void filterLayers(const doc::Sprite* sprite,
@@ -65,6 +70,9 @@ namespace app {
     // load a sequence of files) so we don't ask for them again.
     std::set<std::string> m_usedFiles;
     OpenBatchOfFiles m_batch;
+
+    // Loads the next input files in background threads (--jobs)
+    std::unique_ptr<FilesPreloader> m_preloader;
   };
 
 } // namespace app
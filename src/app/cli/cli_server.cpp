@@ -0,0 +1,113 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/cli/cli_server.h"
+
+#include "app/cli/app_options.h"
+#include "app/cli/cli_processor.h"
+#include "app/cli/default_cli_delegate.h"
+#include "app/cli/preview_cli_delegate.h"
+#include "app/doc.h"
+#include "app/ui_context.h"
+
+#include "json11.hpp"
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace app {
+
+void CliServer::run(Context* ctx)
+{
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos)
+      continue;
+
+    std::string id = "null";
+    std::string error;
+    const int code = executeJob(ctx, line, id, error);
+
+    // Each job starts without documents (as a new process would do)
+    closeAllDocs(ctx);
+
+    std::cout << "{\"id\":" << id << ",\"code\":" << code;
+    if (!error.empty())
+      std::cout << ",\"error\":" << json11::Json(error).dump();
+    std::cout << "}" << std::endl;
+  }
+}
+
+int CliServer::executeJob(Context* ctx, const std::string& line,
+                          std::string& id, std::string& error)
+{
+  const json11::Json job = json11::Json::parse(line, error);
+  if (!error.empty())
+    return -1;
+
+  if (!job["id"].is_null())
+    id = job["id"].dump();
+
+  if (!job["args"].is_array()) {
+    error = "A job needs an \"args\" array";
+    return -1;
+  }
+
+  std::vector<std::string> args = { "aseprite", "--batch" };
+  for (const auto& arg : job["args"].array_items()) {
+    if (!arg.is_string()) {
+      error = "All \"args\" must be strings";
+      return -1;
+    }
+    args.push_back(arg.string_value());
+  }
+
+  std::vector<const char*> argv;
+  for (const auto& arg : args)
+    argv.push_back(arg.c_str());
+
+  AppOptions options(int(argv.size()), argv.data());
+  if (options.startServer() || options.startShell()) {
+    error = "--server and --shell cannot be used in a job";
+    return -1;
+  }
+
+  std::unique_ptr<CliDelegate> delegate;
+  if (options.previewCLI())
+    delegate.reset(new PreviewCliDelegate);
+  else
+    delegate.reset(new DefaultCliDelegate);
+
+  try {
+    CliProcessor cli(delegate.get(), options);
+    return cli.process(ctx);
+  }
+  catch (const std::exception& ex) {
+    error = ex.what();
+    return -1;
+  }
+}
+
+void CliServer::closeAllDocs(Context* ctx)
+{
+  std::vector<Doc*> docs;
+  for (Doc* doc : static_cast<UIContext*>(ctx)->getAndRemoveAllClosedDocs())
+    docs.push_back(doc);
+  for (Doc* doc : ctx->documents())
+    docs.push_back(doc);
+
+  for (Doc* doc : docs) {
+    doc->close();
+    delete doc;
+  }
+}
+
+} // namespace app
@@ -0,0 +1,42 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_CLI_CLI_SERVER_H_INCLUDED
+#define APP_CLI_CLI_SERVER_H_INCLUDED
+#pragma once
+
+#include <string>
+
+namespace app {
+
+  class Context;
+
+  // Executes CLI jobs received from stdin (--server) using the same
+  // program instance (context, file formats, scripting engine,
+  // preferences, etc.), so we pay the startup cost just one time.
+  //
+  // Each line is a JSON object like:
+  //
+  //   { "id": 1, "args": [ "input.aseprite", "--save-as", "output.png" ] }
+  //
+  // And for each job we print (after the output of the job itself)
+  // one line with its result:
+  //
+  //   { "id": 1, "code": 0 }
+  //
+  class CliServer {
+  public:
+    void run(Context* ctx);
+
+  private:
+    int executeJob(Context* ctx, const std::string& line,
+                   std::string& id, std::string& error);
+    void closeAllDocs(Context* ctx);
+  };
+
+} // namespace app
+
+#endif
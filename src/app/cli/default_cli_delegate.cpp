@@ -18,14 +18,17 @@
 #include "app/console.h"
 #include "app/doc.h"
 #include "app/doc_exporter.h"
+#include "app/file/file.h"
 #include "app/file/palette_file.h"
 #include "app/ui_context.h"
+#include "base/chrono.h"
 #include "base/convert_to.h"
 #include "doc/layer.h"
 #include "doc/palette.h"
 #include "doc/slice.h"
 #include "doc/sprite.h"
 #include "doc/tag.h"
+#include "fmt/format.h"
 #include "ver/info.h"
 
 #ifdef ENABLE_SCRIPTING
@@ -35,6 +38,7 @@
   #include "app/ui/input_chain.h"
 #endif
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 
@@ -108,7 +112,20 @@ void DefaultCliDelegate::saveFile(Context* ctx, const CliOpenFile& cof)
   if (cof.ignoreEmpty)
     params.set("ignoreEmpty", "true");
 
+  const FileSaveStats before = get_file_save_stats();
+  base::Chrono chrono;
+
   ctx->executeCommand(saveAsCommand, params);
+
+  if (cof.stats) {
+    const double secs = std::max(chrono.elapsed(), 0.001);
+    const FileSaveStats after = get_file_save_stats();
+    const int64_t frames = after.frames - before.frames;
+    const double mb = double(after.bytes - before.bytes) / (1024.0*1024.0);
+    std::cout << fmt::format(
+      "{}: {} frame(s), {:.2f} MB in {:.3f} s ({:.1f} frames/s, {:.2f} MB/s)\n",
+      cof.filename, frames, mb, secs, frames / secs, mb / secs);
+  }
 }
 
 void DefaultCliDelegate::loadPalette(Context* ctx,
@@ -141,6 +158,40 @@ void DefaultCliDelegate::exportFiles(Context* ctx, DocExporter& exporter)
   LOG("APP: Export sprite sheet: Done\n");
 }
 
+bool DefaultCliDelegate::compareFile(Context* ctx,
+                                     const Doc* doc,
+                                     const std::string& filename)
+{
+  std::unique_ptr<Doc> other(load_document(ctx, filename));
+  if (!other) {
+    std::cout << "Error loading file '" << filename << "'\n";
+    return false;
+  }
+
+  DocDiffOptions options;
+  options.hashCache = &m_hashCache;
+  const DocDiff diff = compare_docs(doc, other.get(), options);
+  other->close();
+
+  if (!diff.anything)
+    return true;
+
+  std::cout << "'" << doc->filename() << "' and '" << filename << "' are different:";
+  if (diff.canvas) std::cout << " canvas";
+  if (diff.totalFrames) std::cout << " totalFrames";
+  if (diff.frameDuration) std::cout << " frameDuration";
+  if (diff.tags) std::cout << " tags";
+  if (diff.palettes) std::cout << " palettes";
+  if (diff.tilesets) std::cout << " tilesets";
+  if (diff.layers) std::cout << " layers";
+  if (diff.cels) std::cout << " cels";
+  if (diff.images) std::cout << " images";
+  if (diff.colorProfiles) std::cout << " colorProfiles";
+  if (diff.gridBounds) std::cout << " gridBounds";
+  std::cout << "\n";
+  return false;
+}
+
 #ifdef ENABLE_SCRIPTING
 int DefaultCliDelegate::execScript(const std::string& filename,
                                    const Params& params)
@@ -0,0 +1,145 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/cli/files_preloader.h"
+
+#include "app/doc.h"
+#include "app/file/file.h"
+#include "base/fs.h"
+
+#include <algorithm>
+
+namespace app {
+
+FilesPreloader::FilesPreloader(Context* ctx, const int jobs)
+  : m_ctx(ctx)
+  , m_maxInFlight(2*jobs)
+  , m_pool(jobs)
+{
+}
+
+FilesPreloader::~FilesPreloader()
+{
+  for (auto& item : m_items) {
+    if (item.loaded.valid())
+      item.fop->stop();
+  }
+  for (auto& item : m_items)
+    discard(item);
+}
+
+void FilesPreloader::add(const std::string& filename,
+                         const bool oneFrame)
+{
+  m_items.emplace_back();
+  Item& item = m_items.back();
+  item.filename = filename;
+  item.oneFrame = oneFrame;
+  startItems();
+}
+
+std::unique_ptr<FileOp> FilesPreloader::take(const std::string& filename,
+                                             const bool oneFrame)
+{
+  auto it = std::find_if(
+    m_items.begin(), m_items.end(),
+    [&filename, oneFrame](const Item& item){
+      return (item.filename == filename &&
+              item.oneFrame == oneFrame);
+    });
+  if (it == m_items.end())
+    return nullptr;
+
+  // Discard files that the CliProcessor didn't need (e.g. files that
+  // were loaded as part of a sequence)
+  for (auto n=it-m_items.begin(); n>0; --n) {
+    discard(m_items.front());
+    m_items.pop_front();
+  }
+
+  // Start loading the next files before we wait this one
+  startItems();
+
+  Item item = std::move(m_items.front());
+  m_items.pop_front();
+
+  // The file couldn't be preloaded (e.g. it has an unknown format),
+  // the CliProcessor will open (and report the error) as usual.
+  if (!item.loaded.valid())
+    return nullptr;
+
+  item.loaded.wait();
+  return std::move(item.fop);
+}
+
+void FilesPreloader::startItems()
+{
+  int inFlight = 0;
+  for (auto& item : m_items) {
+    if (inFlight >= m_maxInFlight)
+      break;
+    if (item.started) {
+      if (item.loaded.valid())
+        ++inFlight;
+      continue;
+    }
+    item.started = true;
+
+    if (m_sequenceFiles.find(item.filename) != m_sequenceFiles.end())
+      continue;
+
+    // Same flags used by OpenFileCommand in batch mode
+    const int flags =
+      FILE_LOAD_DATA_FILE |
+      FILE_LOAD_CREATE_PALETTE |
+      (item.oneFrame ? FILE_LOAD_SEQUENCE_NONE | FILE_LOAD_ONE_FRAME:
+                       FILE_LOAD_SEQUENCE_ASK);
+
+    item.fop.reset(
+      FileOp::createLoadDocumentOperation(m_ctx, item.filename, flags));
+    if (!item.fop || item.fop->hasError())
+      continue;
+
+    if (item.fop->isSequence()) {
+      for (const auto& fn : item.fop->filenames()) {
+        std::string seqFn = base::normalize_path(fn);
+        if (seqFn != item.filename)
+          m_sequenceFiles.insert(seqFn);
+      }
+    }
+
+    FileOp* fop = item.fop.get();
+    auto task = std::make_shared<std::packaged_task<void()>>(
+      [fop]{
+        try {
+          fop->operate(nullptr);
+        }
+        catch (const std::exception& e) {
+          fop->setError("Error loading file:\n%s", e.what());
+        }
+        fop->done();
+      });
+    item.loaded = task->get_future();
+    m_pool.execute([task]{ (*task)(); });
+    ++inFlight;
+  }
+}
+
+void FilesPreloader::discard(Item& item)
+{
+  if (!item.loaded.valid())
+    return;
+
+  item.loaded.wait();
+  if (item.fop->document())
+    delete item.fop->releaseDocument();
+}
+
+} // namespace app
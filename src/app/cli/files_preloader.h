@@ -0,0 +1,72 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_CLI_FILES_PRELOADER_H_INCLUDED
+#define APP_CLI_FILES_PRELOADER_H_INCLUDED
+#pragma once
+
+#include "base/disable_copying.h"
+#include "base/thread_pool.h"
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <set>
+#include <string>
+
+namespace app {
+
+  class Context;
+  class FileOp;
+
+  // Loads the input files of the CLI in N background threads (--jobs
+  // N), so the next files are already decoded when CliProcessor needs
+  // them. The post-load process and everything else (commands, save
+  // operations, console output) is still done in the main thread in
+  // the same order of the command line.
+  class FilesPreloader {
+  public:
+    FilesPreloader(Context* ctx, const int jobs);
+    ~FilesPreloader();
+
+    // Adds a file to the queue of files to be loaded (in the same
+    // order they are going to be requested with take()).
+    void add(const std::string& filename, const bool oneFrame);
+
+    // Returns the load operation of the given file (after waiting
+    // for it), or nullptr if the file wasn't preloaded. Files added
+    // before this one that weren't taken are discarded.
+    std::unique_ptr<FileOp> take(const std::string& filename,
+                                 const bool oneFrame);
+
+  private:
+    struct Item {
+      std::string filename;
+      bool oneFrame;
+      bool started = false;
+      std::unique_ptr<FileOp> fop;
+      std::future<void> loaded;
+    };
+
+    void startItems();
+    void discard(Item& item);
+
+    Context* m_ctx;
+    int m_maxInFlight;
+    std::deque<Item> m_items;
+
+    // Files that will be loaded as part of a sequence of images (and
+    // will be skipped by the CliProcessor)
+    std::set<std::string> m_sequenceFiles;
+
+    base::thread_pool m_pool;
+
+    DISABLE_COPYING(FilesPreloader);
+  };
+
+} // namespace app
+
+#endif
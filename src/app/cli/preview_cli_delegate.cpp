@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2022  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2016-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -180,6 +180,16 @@ void PreviewCliDelegate::loadPalette(Context* ctx,
             << "  - Palette: '" << filename << "'\n";
 }
 
+bool PreviewCliDelegate::compareFile(Context* ctx,
+                                     const Doc* doc,
+                                     const std::string& filename)
+{
+  std::cout << "- Compare with file:\n"
+            << "  - Sprite: '" << doc->filename() << "'\n"
+            << "  - File: '" << filename << "'\n";
+  return true;
+}
+
 void PreviewCliDelegate::exportFiles(Context* ctx, DocExporter& exporter)
 {
   std::string type = "None";
@@ -206,6 +216,7 @@ void PreviewCliDelegate::exportFiles(Context* ctx, DocExporter& exporter)
     switch (exporter.dataFormat()) {
       case SpriteSheetDataFormat::JsonHash: format = "JSON Hash"; break;
       case SpriteSheetDataFormat::JsonArray: format = "JSON Array"; break;
+      case SpriteSheetDataFormat::MsgPack: format = "MessagePack"; break;
     }
     std::cout << "  - Save data file: '" << exporter.dataFilename() << "'\n"
               << "  - Data format: " << format << "\n";
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2022  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2016-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -31,6 +31,8 @@ namespace app {
     void saveFile(Context* ctx, const CliOpenFile& cof) override;
     void loadPalette(Context* ctx, const std::string& filename) override;
     void exportFiles(Context* ctx, DocExporter& exporter) override;
+    bool compareFile(Context* ctx, const Doc* doc,
+                     const std::string& filename) override;
 #ifdef ENABLE_SCRIPTING
     int execScript(const std::string& filename,
                    const Params& params) override;
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -9,6 +10,8 @@
 #endif
 
 #include "app/cmd.h"
+
+#include "app/doc_changes.h"
 #include "base/debug.h"
 #include "base/mem_utils.h"
 
@@ -89,6 +92,16 @@ size_t Cmd::memSize() const
   return onMemSize();
 }
 
+void Cmd::spill(DocUndoSpillFile* file)
+{
+  onSpill(file);
+}
+
+void Cmd::collectChanges(DocChanges& changes)
+{
+  onCollectChanges(changes);
+}
+
 void Cmd::onExecute()
 {
   // Do nothing
@@ -119,4 +132,15 @@ size_t Cmd::onMemSize() const {
   return sizeof(*this);
 }
 
+void Cmd::onSpill(DocUndoSpillFile* file)
+{
+  // Do nothing
+}
+
+void Cmd::onCollectChanges(DocChanges& changes)
+{
+  // By default we don't know what this command modifies
+  changes.addAll();
+}
+
 } // namespace app
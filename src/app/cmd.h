@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -9,6 +10,7 @@
 #pragma once
 
 #include "base/disable_copying.h"
+#include "doc/small_object_pool.h"
 #include "undo/undo_command.h"
 
 #include <string>
@@ -16,12 +18,17 @@
 namespace app {
 
   class Context;
+  class DocChanges;
+  class DocUndoSpillFile;
 
   class Cmd : public undo::UndoCommand {
   public:
     Cmd();
     virtual ~Cmd();
 
+    // Commands are created by thousands in each transaction
+    DOC_SMALL_OBJECT_ALLOCATOR()
+
     void execute(Context* ctx);
 
     // undo::UndoCommand impl
@@ -32,6 +39,15 @@ namespace app {
     std::string label() const;
     size_t memSize() const;
 
+    // Moves the big payload of the command (e.g. pixels) to the given
+    // file to reduce its memSize(). The payload is loaded back
+    // automatically when it's needed to undo/redo the command.
+    void spill(DocUndoSpillFile* file);
+
+    // Adds the parts of the document modified by this command (after
+    // executing, undoing, or redoing it) to "changes".
+    void collectChanges(DocChanges& changes);
+
     Context* context() const { return m_ctx; }
 
   protected:
@@ -41,6 +57,8 @@ namespace app {
     virtual void onFireNotifications();
     virtual std::string onLabel() const;
     virtual size_t onMemSize() const;
+    virtual void onSpill(DocUndoSpillFile* file);
+    virtual void onCollectChanges(DocChanges& changes);
 
   private:
     Context* m_ctx;
@@ -12,6 +12,7 @@
 #include "app/cmd/add_cel.h"
 
 #include "app/doc.h"
+#include "app/doc_changes.h"
 #include "app/doc_event.h"
 #include "base/serialization.h"
 #include "doc/cel.h"
@@ -94,6 +95,9 @@ void AddCel::addCel(Layer* layer, Cel* cel)
   static_cast<LayerImage*>(layer)->addCel(cel);
   layer->incrementVersion();
 
+  m_dirtyBounds = cel->bounds();
+  m_frame = cel->frame();
+
   Doc* doc = static_cast<Doc*>(cel->document());
   DocEvent ev(doc);
   ev.sprite(layer->sprite());
@@ -104,6 +108,9 @@ void AddCel::addCel(Layer* layer, Cel* cel)
 
 void AddCel::removeCel(Layer* layer, Cel* cel)
 {
+  m_dirtyBounds = cel->bounds();
+  m_frame = cel->frame();
+
   Doc* doc = static_cast<Doc*>(cel->document());
   DocEvent ev(doc);
   ev.sprite(layer->sprite());
@@ -119,5 +126,10 @@ void AddCel::removeCel(Layer* layer, Cel* cel)
   delete cel;
 }
 
+void AddCel::onCollectChanges(DocChanges& changes)
+{
+  changes.addCelBounds(layer(), m_frame, m_dirtyBounds);
+}
+
 } // namespace cmd
 } // namespace app
@@ -11,6 +11,8 @@
 #include "app/cmd.h"
 #include "app/cmd/with_cel.h"
 #include "app/cmd/with_layer.h"
+#include "doc/frame.h"
+#include "gfx/rect.h"
 
 #include <sstream>
 
@@ -33,6 +35,7 @@ namespace cmd {
     void onExecute() override;
     void onUndo() override;
     void onRedo() override;
+    void onCollectChanges(DocChanges& changes) override;
     size_t onMemSize() const override {
       return sizeof(*this) + m_size;
     }
@@ -43,6 +46,10 @@ namespace cmd {
 
     size_t m_size;
     std::stringstream m_stream;
+
+    // Bounds/frame of the cel the last time it was added/removed.
+    gfx::Rect m_dirtyBounds;
+    frame_t m_frame = 0;
   };
 
 } // namespace cmd
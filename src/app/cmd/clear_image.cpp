@@ -11,6 +11,7 @@
 #include "app/cmd/clear_image.h"
 
 #include "app/doc.h"
+#include "app/doc_changes.h"
 #include "doc/image.h"
 #include "doc/primitives.h"
 
@@ -46,5 +47,12 @@ void ClearImage::onUndo()
   image->incrementVersion();
 }
 
+void ClearImage::onCollectChanges(DocChanges& changes)
+{
+  Image* image = this->image();
+  changes.addImageRegion(image,
+                         gfx::Region(image ? image->bounds(): gfx::Rect()));
+}
+
 } // namespace cmd
 } // namespace app
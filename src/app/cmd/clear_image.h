@@ -25,6 +25,7 @@ namespace cmd {
   protected:
     void onExecute() override;
     void onUndo() override;
+    void onCollectChanges(DocChanges& changes) override;
     size_t onMemSize() const override {
       return sizeof(*this) + (m_copy ? m_copy->getMemSize(): 0);
     }
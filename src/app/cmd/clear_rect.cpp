@@ -11,6 +11,7 @@
 #include "app/cmd/clear_rect.h"
 
 #include "app/doc.h"
+#include "app/doc_changes.h"
 #include "doc/cel.h"
 #include "doc/image.h"
 #include "doc/layer.h"
@@ -84,5 +85,15 @@ void ClearRect::restore()
   copy_image(m_dstImage->image(), m_copy.get(), m_offsetX, m_offsetY);
 }
 
+void ClearRect::onCollectChanges(DocChanges& changes)
+{
+  m_seq.collectChanges(changes);
+  if (m_dstImage) {
+    Image* image = m_dstImage->image();
+    changes.addImageRegion(image,
+                           gfx::Region(image ? image->bounds(): gfx::Rect()));
+  }
+}
+
 } // namespace cmd
 } // namespace app
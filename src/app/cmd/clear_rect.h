@@ -32,6 +32,7 @@ namespace cmd {
     void onExecute() override;
     void onUndo() override;
     void onRedo() override;
+    void onCollectChanges(DocChanges& changes) override;
     size_t onMemSize() const override {
       return sizeof(*this) + m_seq.memSize() +
         (m_copy ? m_copy->getMemSize(): 0);
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2021  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -13,61 +13,101 @@
 #include "app/cmd/assign_color_profile.h"
 #include "app/cmd/replace_image.h"
 #include "app/cmd/set_palette.h"
+#include "app/color_spaces.h"
 #include "app/doc.h"
+#include "base/thread_pool.h"
 #include "doc/cels_range.h"
 #include "doc/palette.h"
 #include "doc/sprite.h"
 #include "os/color_space.h"
 #include "os/system.h"
 
+#include <algorithm>
+#include <thread>
+#include <utility>
+#include <vector>
+
 namespace app {
 namespace cmd {
 
 static doc::ImageRef convert_image_color_space(const doc::Image* srcImage,
                                                const gfx::ColorSpaceRef& newCS,
-                                               os::ColorSpaceConversion* conversion)
+                                               const ColorSpaceLut* lut)
 {
   ImageSpec spec = srcImage->spec();
   spec.setColorSpace(newCS);
   ImageRef dstImage(Image::create(spec));
 
-  if (!conversion) {
+  if (!lut) {
     dstImage->copy(srcImage, gfx::Clip(0, 0, srcImage->bounds()));
     return dstImage;
   }
 
   if (spec.colorMode() == doc::ColorMode::RGB) {
     for (int y=0; y<spec.height(); ++y) {
-      conversion->convertRgba((uint32_t*)dstImage->getPixelAddress(0, y),
-                              (const uint32_t*)srcImage->getPixelAddress(0, y),
-                              spec.width());
+      lut->convertRgba((uint32_t*)dstImage->getPixelAddress(0, y),
+                       (const uint32_t*)srcImage->getPixelAddress(0, y),
+                       spec.width());
     }
   }
   else if (spec.colorMode() == doc::ColorMode::GRAYSCALE) {
     // TODO create a set of functions to create pixel format
     // conversions (this should be available when we add new kind of
     // pixel formats).
-    std::vector<uint8_t> buf(spec.width()*spec.height());
-
-    auto it = buf.begin();
     for (int y=0; y<spec.height(); ++y) {
       auto srcPtr = (const uint16_t*)srcImage->getPixelAddress(0, y);
-      for (int x=0; x<spec.width(); ++x, ++srcPtr, ++it)
-        *it = doc::graya_getv(*srcPtr);
+      auto dstPtr = (uint16_t*)dstImage->getPixelAddress(0, y);
+      for (int x=0; x<spec.width(); ++x, ++dstPtr, ++srcPtr)
+        *dstPtr = doc::graya(lut->convertGray(doc::graya_getv(*srcPtr)),
+                             doc::graya_geta(*srcPtr));
     }
+  }
 
-    conversion->convertGray(&buf[0], &buf[0], spec.width()*spec.height());
+  return dstImage;
+}
 
-    it = buf.begin();
-    for (int y=0; y<spec.height(); ++y) {
-      auto srcPtr = (const uint16_t*)srcImage->getPixelAddress(0, y);
-      auto dstPtr = (uint16_t*)dstImage->getPixelAddress(0, y);
-      for (int x=0; x<spec.width(); ++x, ++dstPtr, ++srcPtr, ++it)
-        *dstPtr = doc::graya(*it, doc::graya_geta(*srcPtr));
+// Converts all the (non-tilemap) cel images of the sprite in
+// parallel, returning pairs of old/new images.
+static std::vector<std::pair<ImageRef, ImageRef>>
+convert_sprite_images(doc::Sprite* sprite,
+                      const gfx::ColorSpaceRef& newCS,
+                      const ColorSpaceLut* lut)
+{
+  std::vector<std::pair<ImageRef, ImageRef>> images;
+  if (sprite->pixelFormat() == doc::IMAGE_INDEXED)
+    return images;
+
+  for (Cel* cel : sprite->uniqueCels()) {
+    ImageRef image = cel->imageRef();
+    if (image->pixelFormat() != IMAGE_TILEMAP)
+      images.emplace_back(image, nullptr);
+  }
+
+  const int threads =
+    std::clamp<int>(std::thread::hardware_concurrency(), 1,
+                    std::max<int>(1, int(images.size())));
+  if (threads > 1) {
+    base::thread_pool pool(threads);
+    for (auto& item : images) {
+      pool.execute([&item, &newCS, lut]{
+        item.second = convert_image_color_space(item.first.get(), newCS, lut);
+      });
     }
+    pool.wait_all();
+  }
+  else {
+    for (auto& item : images)
+      item.second = convert_image_color_space(item.first.get(), newCS, lut);
   }
+  return images;
+}
 
-  return dstImage;
+static void convert_palette_color_space(const Palette* pal,
+                                        Palette* newPal,
+                                        const ColorSpaceLut* lut)
+{
+  for (int i=0; i<pal->size(); ++i)
+    newPal->setEntry(i, lut->convertRgba(pal->entry(i)));
 }
 
 void convert_color_profile(doc::Sprite* sprite,
@@ -82,34 +122,18 @@ void convert_color_profile(doc::Sprite* sprite,
   ASSERT(srcOCS);
   ASSERT(dstOCS);
 
-  auto conversion = system->convertBetweenColorSpace(srcOCS, dstOCS);
+  ColorSpaceLutRef lut = get_color_space_lut(srcOCS, dstOCS);
 
   // Convert images
-  if (sprite->pixelFormat() != doc::IMAGE_INDEXED) {
-    for (Cel* cel : sprite->uniqueCels()) {
-      ImageRef old_image = cel->imageRef();
-      if (old_image.get()->pixelFormat() != IMAGE_TILEMAP) {
-        ImageRef new_image = convert_image_color_space(
-          old_image.get(), newCS, conversion.get());
-
-        sprite->replaceImage(old_image->id(), new_image);
-      }
-    }
-  }
+  for (const auto& item : convert_sprite_images(sprite, newCS, lut.get()))
+    sprite->replaceImage(item.first->id(), item.second);
 
-  if (conversion) {
+  if (lut) {
     // Convert palette
     if (sprite->pixelFormat() != doc::IMAGE_GRAYSCALE) {
       for (auto& pal : sprite->getPalettes()) {
         Palette newPal(pal->frame(), pal->size());
-
-        for (int i=0; i<pal->size(); ++i) {
-          color_t oldCol = pal->entry(i);
-          color_t newCol = pal->entry(i);
-          conversion->convertRgba((uint32_t*)&newCol,
-                                  (const uint32_t*)&oldCol, 1);
-          newPal.setEntry(i, newCol);
-        }
+        convert_palette_color_space(pal, &newPal, lut.get());
 
         if (*pal != newPal)
           sprite->setPalette(&newPal, false);
@@ -137,28 +161,21 @@ void convert_color_profile(doc::Image* image,
   ASSERT(srcOCS);
   ASSERT(dstOCS);
 
-  auto conversion = system->convertBetweenColorSpace(srcOCS, dstOCS);
-  if (conversion) {
+  ColorSpaceLutRef lut = get_color_space_lut(srcOCS, dstOCS);
+  if (lut) {
     switch (image->pixelFormat()) {
       case doc::IMAGE_RGB:
       case doc::IMAGE_GRAYSCALE: {
         ImageRef newImage = convert_image_color_space(
-          image, newCS, conversion.get());
+          image, newCS, lut.get());
 
         image->copy(newImage.get(), gfx::Clip(image->bounds()));
         break;
       }
 
-      case doc::IMAGE_INDEXED: {
-        for (int i=0; i<palette->size(); ++i) {
-          color_t oldCol, newCol;
-          oldCol = newCol = palette->entry(i);
-          conversion->convertRgba((uint32_t*)&newCol,
-                                  (const uint32_t*)&oldCol, 1);
-          palette->setEntry(i, newCol);
-        }
+      case doc::IMAGE_INDEXED:
+        convert_palette_color_space(palette, palette, lut.get());
         break;
-      }
     }
   }
 }
@@ -177,34 +194,18 @@ ConvertColorProfile::ConvertColorProfile(doc::Sprite* sprite, const gfx::ColorSp
   ASSERT(srcOCS);
   ASSERT(dstOCS);
 
-  auto conversion = system->convertBetweenColorSpace(srcOCS, dstOCS);
+  ColorSpaceLutRef lut = get_color_space_lut(srcOCS, dstOCS);
 
   // Convert images
-  if (sprite->pixelFormat() != doc::IMAGE_INDEXED) {
-    for (Cel* cel : sprite->uniqueCels()) {
-      ImageRef old_image = cel->imageRef();
-      if (old_image.get()->pixelFormat() != IMAGE_TILEMAP) {
-        ImageRef new_image = convert_image_color_space(
-          old_image.get(), newCS, conversion.get());
-
-        m_seq.add(new cmd::ReplaceImage(sprite, old_image, new_image));
-      }
-    }
-  }
+  for (const auto& item : convert_sprite_images(sprite, newCS, lut.get()))
+    m_seq.add(new cmd::ReplaceImage(sprite, item.first, item.second));
 
-  if (conversion) {
+  if (lut) {
     // Convert palette
     if (sprite->pixelFormat() != doc::IMAGE_GRAYSCALE) {
       for (auto& pal : sprite->getPalettes()) {
         Palette newPal(pal->frame(), pal->size());
-
-        for (int i=0; i<pal->size(); ++i) {
-          color_t oldCol = pal->entry(i);
-          color_t newCol = pal->entry(i);
-          conversion->convertRgba((uint32_t*)&newCol,
-                                  (const uint32_t*)&oldCol, 1);
-          newPal.setEntry(i, newCol);
-        }
+        convert_palette_color_space(pal, &newPal, lut.get());
 
         if (*pal != newPal)
           m_seq.add(new cmd::SetPalette(sprite, pal->frame(), &newPal));
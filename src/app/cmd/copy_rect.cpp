@@ -11,6 +11,7 @@
 
 #include "app/cmd/copy_rect.h"
 
+#include "app/doc_changes.h"
 #include "doc/image.h"
 
 #include <algorithm>
@@ -86,5 +87,11 @@ int CopyRect::lineSize()
   return image()->bytesPerPixel() * m_clip.size.w;
 }
 
+void CopyRect::onCollectChanges(DocChanges& changes)
+{
+  changes.addImageRegion(image(),
+                         gfx::Region(gfx::Rect(m_clip.dst, m_clip.size)));
+}
+
 } // namespace cmd
 } // namespace app
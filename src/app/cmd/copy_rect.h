@@ -31,6 +31,7 @@ namespace cmd {
     void onExecute() override;
     void onUndo() override;
     void onRedo() override;
+    void onCollectChanges(DocChanges& changes) override;
     size_t onMemSize() const override {
       return sizeof(*this) + m_data.size();
     }
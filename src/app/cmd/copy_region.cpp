@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -12,6 +12,8 @@
 #include "app/cmd/copy_region.h"
 
 #include "app/doc.h"
+#include "app/doc_changes.h"
+#include "app/doc_undo_spill_file.h"
 #include "app/util/buffer_region.h"
 #include "doc/image.h"
 #include "doc/sprite.h"
@@ -42,7 +44,13 @@ CopyRegion::CopyRegion(Image* dst, const Image* src,
     m_region &= gfx::Region(clip.dstBounds());
   }
 
-  save_image_region_in_buffer(m_region, src, dstPos, m_buffer);
+  // We store only the compressed differences between the src and
+  // dst pixels, so XOR'ing them with the image goes from one version
+  // to the other one (in onExecute, onUndo, and onRedo).
+  base::buffer diff;
+  save_image_region_in_buffer(m_region, src, dstPos, diff);
+  xor_buffer_with_image_region(m_region, dst, gfx::Point(0, 0), diff);
+  compress_buffer(diff, m_buffer);
 }
 
 CopyTileRegion::CopyTileRegion(Image* dst, const Image* src,
@@ -78,12 +86,31 @@ void CopyRegion::swap()
   Image* image = this->image();
   ASSERT(image);
 
-  swap_image_region_with_buffer(m_region, image, m_buffer);
+  if (m_spillFile && m_buffer.empty() && m_spillSize > 0)
+    m_spillFile->read(m_spillOffset, m_spillSize, m_buffer);
+
+  base::buffer diff;
+  decompress_buffer(m_buffer, diff);
+  xor_image_region_with_buffer(m_region, image, diff);
   image->incrementVersion();
 
   rehash();
 }
 
+void CopyRegion::onSpill(DocUndoSpillFile* file)
+{
+  if (m_buffer.empty())
+    return;
+
+  if (!m_spillFile) {
+    m_spillOffset = file->write(m_buffer);
+    m_spillSize = m_buffer.size();
+    m_spillFile = file;
+  }
+  ASSERT(m_spillFile == file);
+  base::buffer().swap(m_buffer);
+}
+
 void CopyTileRegion::rehash()
 {
   ASSERT(m_tileIndex != notile);
@@ -102,5 +129,10 @@ void CopyTileRegion::rehash()
   }
 }
 
+void CopyRegion::onCollectChanges(DocChanges& changes)
+{
+  changes.addImageRegion(image(), m_region);
+}
+
 } // namespace cmd
 } // namespace app
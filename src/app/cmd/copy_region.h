@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -16,6 +16,8 @@
 #include "gfx/point.h"
 #include "gfx/region.h"
 
+#include <cstdint>
+
 namespace doc {
   class Tileset;
 }
@@ -40,9 +42,11 @@ namespace cmd {
     void onExecute() override;
     void onUndo() override;
     void onRedo() override;
+    void onCollectChanges(DocChanges& changes) override;
     size_t onMemSize() const override {
       return sizeof(*this) + m_buffer.size();
     }
+    void onSpill(DocUndoSpillFile* file) override;
 
   private:
     void swap();
@@ -50,7 +54,14 @@ namespace cmd {
 
     bool m_alreadyCopied;
     gfx::Region m_region;
-    base::buffer m_buffer;
+    base::buffer m_buffer;      // Compressed XOR differences
+
+    // Location of m_buffer in the spill file (the differences never
+    // change, so once they are written we can drop/load m_buffer
+    // as many times as needed).
+    DocUndoSpillFile* m_spillFile = nullptr;
+    uint64_t m_spillOffset = 0;
+    size_t m_spillSize = 0;
   };
 
   class CopyTileRegion : public CopyRegion {
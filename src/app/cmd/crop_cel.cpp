@@ -11,6 +11,7 @@
 
 #include "app/cmd/crop_cel.h"
 
+#include "app/doc_changes.h"
 #include "doc/cel.h"
 #include "doc/layer.h"
 #include "doc/layer_tilemap.h"
@@ -49,6 +50,7 @@ void CropCel::cropImage(const gfx::Point& origin,
                         const gfx::Rect& bounds)
 {
   Cel* cel = this->cel();
+  m_dirtyBounds = cel->bounds();
 
   gfx::Rect localBounds(bounds);
   if (cel->layer()->isTilemap()) {
@@ -78,6 +80,17 @@ void CropCel::cropImage(const gfx::Point& origin,
     cel->data()->setPosition(origin);
     cel->data()->incrementVersion();
   }
+
+  m_dirtyBounds |= cel->bounds();
+}
+
+void CropCel::onCollectChanges(DocChanges& changes)
+{
+  Cel* cel = this->cel();
+  if (cel)
+    changes.addCelBounds(cel->layer(), cel->frame(), m_dirtyBounds);
+  else
+    changes.addAll();
 }
 
 } // namespace cmd
@@ -25,6 +25,7 @@ namespace cmd {
   protected:
     void onExecute() override;
     void onUndo() override;
+    void onCollectChanges(DocChanges& changes) override;
     size_t onMemSize() const override {
       return sizeof(*this);
     }
@@ -37,6 +38,9 @@ namespace cmd {
     gfx::Point m_newOrigin;
     gfx::Rect m_oldBounds;
     gfx::Rect m_newBounds;
+
+    // Union of the cel bounds before/after the last crop.
+    gfx::Rect m_dirtyBounds;
   };
 
 } // namespace cmd
@@ -13,6 +13,7 @@
 
 #include "app/cmd/set_mask.h"
 #include "app/doc.h"
+#include "app/doc_changes.h"
 #include "doc/mask.h"
 
 namespace app {
@@ -49,5 +50,10 @@ size_t DeselectMask::onMemSize() const
   return sizeof(*this) + (m_oldMask ? m_oldMask->getMemSize(): 0);
 }
 
+void DeselectMask::onCollectChanges(DocChanges& changes)
+{
+  // The selection doesn't modify the sprite pixels
+}
+
 } // namespace cmd
 } // namespace app
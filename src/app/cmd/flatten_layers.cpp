@@ -28,6 +28,7 @@
 #include "app/doc.h"
 #include "app/i18n/strings.h"
 #include "app/restore_visible_layers.h"
+#include "base/thread_pool.h"
 #include "doc/algorithm/shrink_bounds.h"
 #include "doc/cel.h"
 #include "doc/layer.h"
@@ -36,10 +37,122 @@
 #include "render/render.h"
 
 #include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
 
 namespace app {
 namespace cmd {
 
+namespace {
+
+// Result of rendering one frame of the flattened layers.
+struct FlatFrame {
+  bool render = false;  // False to keep the flatLayer cel as it is
+  ImageRef image;       // Cropped image or nullptr if it's transparent
+  gfx::Rect bounds;     // Bounds of the image in the rendered area
+};
+
+// Frames smaller than this are not split in bands to render them in
+// several threads.
+constexpr int kMinPixelsPerBand = 256*256;
+
+// Renders the frames marked with FlatFrame::render in parallel (one
+// frame per thread, or bands of the same frame in several threads
+// if there are less frames than threads).
+void render_flat_frames(const Sprite* sprite,
+                        const ImageSpec& spec,
+                        const gfx::Rect& area,
+                        const color_t bgcolor,
+                        const bool newBlend,
+                        std::vector<FlatFrame>& frames)
+{
+  std::vector<frame_t> framesToRender;
+  for (frame_t frame(0); frame<int(frames.size()); ++frame) {
+    if (frames[frame].render)
+      framesToRender.push_back(frame);
+  }
+  if (framesToRender.empty())
+    return;
+
+  auto makeRender = [newBlend]{
+    auto render = std::make_unique<render::Render>();
+    render->setNewBlend(newBlend);
+    render->setBgOptions(render::BgOptions::MakeNone());
+    return render;
+  };
+
+  // Crops the rendered image to the non-transparent bounds
+  auto cropFrame = [](FlatFrame& ff, const Image* image) {
+    gfx::Rect bounds = image->bounds();
+    if (doc::algorithm::shrink_bounds(image, image->maskColor(), nullptr,
+                                      image->bounds(), bounds)) {
+      ff.image.reset(doc::crop_image(image, bounds, image->maskColor()));
+      ff.bounds = bounds;
+    }
+  };
+
+  const int maxThreads = std::max<int>(1, std::thread::hardware_concurrency());
+  const int nframes = int(framesToRender.size());
+
+  // Many frames: each thread renders a subset of frames
+  if (nframes >= maxThreads || spec.width()*spec.height() < 2*kMinPixelsPerBand) {
+    const int threads = std::clamp(maxThreads, 1, nframes);
+    auto renderFrames = [&](const int k) {
+      auto render = makeRender();
+      ImageRef image(Image::create(spec));
+      for (int i=k; i<nframes; i+=threads) {
+        const frame_t frame = framesToRender[i];
+        clear_image(image.get(), bgcolor);
+        render->renderSprite(image.get(), sprite, frame,
+                             gfx::ClipF(0, 0, area));
+        cropFrame(frames[frame], image.get());
+      }
+    };
+
+    if (threads > 1) {
+      base::thread_pool pool(threads);
+      for (int k=0; k<threads; ++k)
+        pool.execute([&renderFrames, k]{ renderFrames(k); });
+      pool.wait_all();
+    }
+    else {
+      renderFrames(0);
+    }
+    return;
+  }
+
+  // Few big frames: each frame is split in horizontal bands
+  const int bands =
+    std::clamp(spec.width()*spec.height() / kMinPixelsPerBand,
+               1, std::min(maxThreads, spec.height()));
+  const int bandHeight = (spec.height() + bands - 1) / bands;
+  std::vector<std::unique_ptr<render::Render>> renders(bands);
+  for (auto& render : renders)
+    render = makeRender();
+
+  ImageRef image(Image::create(spec));
+  base::thread_pool pool(bands);
+  for (const frame_t frame : framesToRender) {
+    for (int k=0; k<bands; ++k) {
+      pool.execute([&, k, frame]{
+        const int y1 = std::min(spec.height(), k*bandHeight);
+        const int y2 = std::min(spec.height(), y1+bandHeight);
+        if (y1 >= y2)
+          return;
+        fill_rect(image.get(), 0, y1, spec.width()-1, y2-1, bgcolor);
+        renders[k]->renderSprite(
+          image.get(), sprite, frame,
+          gfx::ClipF(0, y1, area.x, area.y+y1, area.w, y2-y1));
+      });
+    }
+    pool.wait_all();
+    cropFrame(frames[frame], image.get());
+  }
+}
+
+} // anonymous namespace
+
 FlattenLayers::FlattenLayers(doc::Sprite* sprite,
                              const doc::SelectedLayers& layers0,
                              const Options options)
@@ -93,9 +206,6 @@ void FlattenLayers::onExecute()
     area.setSize(spec.size());
   }
 
-  // Create a temporary image.
-  ImageRef image(Image::create(spec));
-
   LayerImage* flatLayer;  // The layer onto which everything will be flattened.
   color_t bgcolor;        // The background color to use for flatLayer.
   bool newFlatLayer = false;
@@ -120,10 +230,6 @@ void FlattenLayers::onExecute()
     bgcolor = sprite->transparentColor();
   }
 
-  render::Render render;
-  render.setNewBlend(m_options.newBlendMethod);
-  render.setBgOptions(render::BgOptions::MakeNone());
-
   {
     // Show only the layers to be flattened so other layers are hidden
     // temporarily.
@@ -132,44 +238,40 @@ void FlattenLayers::onExecute()
 
     const LayerList visibleLayers = sprite->allVisibleLayers();
 
-    // Map draw area to image coords
-    const gfx::ClipF area_to_image(0, 0, area);
-
-    // Copy all frames to the background.
+    std::vector<FlatFrame> frames(sprite->totalFrames());
     for (frame_t frame(0); frame<sprite->totalFrames(); ++frame) {
       // If the flatLayer is the only cel in this frame, we can skip
       // this frame to keep existing links in the flatLayer.
-      const bool anotherCelExists =
+      frames[frame].render =
         std::any_of(visibleLayers.begin(),
                     visibleLayers.end(),
                     [flatLayer, frame](const Layer* other) {
                       return (flatLayer != other && other->cel(frame));
                     });
-      if (!anotherCelExists)
-        continue;
+    }
 
-      // Clear the image and render this frame.
-      clear_image(image.get(), bgcolor);
-      render.renderSprite(image.get(), sprite, frame, area_to_image);
+    // Render all frames first (in parallel), then modify the sprite
+    // with the rendered images.
+    render_flat_frames(sprite, spec, area, bgcolor,
+                       m_options.newBlendMethod, frames);
 
-      // Get exact bounds for rendered frame
-      gfx::Rect bounds = image->bounds();
-      const bool shrink = doc::algorithm::shrink_bounds(
-        image.get(), image->maskColor(), nullptr,
-        image->bounds(), bounds);
+    // Copy all frames to the background.
+    for (frame_t frame(0); frame<sprite->totalFrames(); ++frame) {
+      const FlatFrame& ff = frames[frame];
+      if (!ff.render)
+        continue;
 
       // Skip when fully transparent
       Cel* cel = flatLayer->cel(frame);
-      if (!shrink) {
+      if (!ff.image) {
         if (!newFlatLayer && cel)
           executeAndAdd(new cmd::RemoveCel(cel));
 
         continue;
       }
 
-      // Apply shrunk bounds to new image
-      const ImageRef new_image(doc::crop_image(
-        image.get(), bounds, image->maskColor()));
+      const ImageRef& new_image = ff.image;
+      const gfx::Rect& bounds = ff.bounds;
 
       // Replace image on existing cel
       if (cel) {
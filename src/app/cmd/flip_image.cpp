@@ -10,6 +10,7 @@
 
 #include "app/cmd/flip_image.h"
 
+#include "app/doc_changes.h"
 #include "doc/image.h"
 #include "doc/algorithm/flip_image.h"
 
@@ -43,5 +44,10 @@ void FlipImage::swap()
   image->incrementVersion();
 }
 
+void FlipImage::onCollectChanges(DocChanges& changes)
+{
+  changes.addImageRegion(image(), gfx::Region(m_bounds));
+}
+
 } // namespace cmd
 } // namespace app
@@ -0,0 +1,86 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/cmd/flip_images.h"
+
+#include "app/doc_changes.h"
+#include "base/thread_pool.h"
+#include "doc/algorithm/flip_image.h"
+#include "doc/image.h"
+#include "gfx/region.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace app {
+namespace cmd {
+
+FlipImages::FlipImages(const std::vector<Image*>& images,
+                       doc::algorithm::FlipType flipType)
+  : m_flipType(flipType)
+{
+  m_imageIds.reserve(images.size());
+  for (const Image* image : images)
+    m_imageIds.push_back(image->id());
+
+  // The same image cannot be flipped twice (or from two threads)
+  std::sort(m_imageIds.begin(), m_imageIds.end());
+  m_imageIds.erase(std::unique(m_imageIds.begin(), m_imageIds.end()),
+                   m_imageIds.end());
+}
+
+void FlipImages::onExecute()
+{
+  swap();
+}
+
+void FlipImages::onUndo()
+{
+  swap();
+}
+
+void FlipImages::swap()
+{
+  std::vector<Image*> images;
+  images.reserve(m_imageIds.size());
+  for (const ObjectId id : m_imageIds)
+    images.push_back(get<Image>(id));
+
+  const int nthreads =
+    std::clamp<int>(std::thread::hardware_concurrency(), 1,
+                    std::max<int>(1, images.size()));
+  if (nthreads > 1) {
+    base::thread_pool pool(nthreads);
+    for (Image* image : images) {
+      pool.execute([image, flipType = m_flipType]{
+        doc::algorithm::flip_image(image, image->bounds(), flipType);
+      });
+    }
+    pool.wait_all();
+  }
+  else {
+    for (Image* image : images)
+      doc::algorithm::flip_image(image, image->bounds(), m_flipType);
+  }
+
+  for (Image* image : images)
+    image->incrementVersion();
+}
+
+void FlipImages::onCollectChanges(DocChanges& changes)
+{
+  for (const ObjectId id : m_imageIds) {
+    const Image* image = get<Image>(id);
+    changes.addImageRegion(image, gfx::Region(image->bounds()));
+  }
+}
+
+} // namespace cmd
+} // namespace app
@@ -0,0 +1,50 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_CMD_FLIP_IMAGES_H_INCLUDED
+#define APP_CMD_FLIP_IMAGES_H_INCLUDED
+#pragma once
+
+#include "app/cmd.h"
+#include "doc/algorithm/flip_type.h"
+#include "doc/object_id.h"
+
+#include <vector>
+
+namespace doc {
+  class Image;
+}
+
+namespace app {
+namespace cmd {
+  using namespace doc;
+
+  // Flips several whole images (e.g. all cels of an animation) with
+  // one command, the images are flipped in parallel.
+  class FlipImages : public Cmd {
+  public:
+    FlipImages(const std::vector<Image*>& images,
+               doc::algorithm::FlipType flipType);
+
+  protected:
+    void onExecute() override;
+    void onUndo() override;
+    void onCollectChanges(DocChanges& changes) override;
+    size_t onMemSize() const override {
+      return sizeof(*this) + sizeof(ObjectId)*m_imageIds.size();
+    }
+
+  private:
+    void swap();
+
+    std::vector<ObjectId> m_imageIds;
+    doc::algorithm::FlipType m_flipType;
+  };
+
+} // namespace cmd
+} // namespace app
+
+#endif
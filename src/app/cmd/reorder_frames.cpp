@@ -0,0 +1,65 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/cmd/reorder_frames.h"
+
+#include "app/doc.h"
+#include "doc/layer.h"
+#include "doc/sprite.h"
+
+namespace app {
+namespace cmd {
+
+using namespace doc;
+
+ReorderFrames::ReorderFrames(Sprite* sprite, const std::vector<frame_t>& newFrames)
+  : WithSprite(sprite)
+  , m_newFrames(newFrames)
+  , m_oldFrames(newFrames.size())
+{
+  ASSERT(frame_t(newFrames.size()) == sprite->totalFrames());
+  for (frame_t i=0; i<frame_t(newFrames.size()); ++i)
+    m_oldFrames[newFrames[i]] = i;
+}
+
+void ReorderFrames::onExecute()
+{
+  reorder(m_newFrames);
+}
+
+void ReorderFrames::onUndo()
+{
+  reorder(m_oldFrames);
+}
+
+void ReorderFrames::onFireNotifications()
+{
+  // Frames and cels of all layers were moved, observers (timeline,
+  // editors, backups) must be refreshed completely.
+  static_cast<Doc*>(sprite()->document())->notifyGeneralUpdate();
+}
+
+void ReorderFrames::reorder(const std::vector<frame_t>& newFrames)
+{
+  Sprite* sprite = this->sprite();
+  const frame_t n = frame_t(newFrames.size());
+
+  std::vector<int> durations(n);
+  for (frame_t i=0; i<n; ++i)
+    durations[newFrames[i]] = sprite->frameDuration(i);
+  for (frame_t i=0; i<n; ++i)
+    sprite->setFrameDuration(i, durations[i]);
+
+  sprite->root()->reorderFrames(newFrames);
+  sprite->incrementVersion();
+}
+
+} // namespace cmd
+} // namespace app
@@ -0,0 +1,48 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_CMD_REORDER_FRAMES_H_INCLUDED
+#define APP_CMD_REORDER_FRAMES_H_INCLUDED
+#pragma once
+
+#include "app/cmd.h"
+#include "app/cmd/with_sprite.h"
+#include "doc/frame.h"
+
+#include <vector>
+
+namespace app {
+namespace cmd {
+  using namespace doc;
+
+  // Moves all frames of the sprite at once (durations and cels of all
+  // layers), the frame "i" goes to the "newFrames[i]" position. It's
+  // used to move big ranges of frames with just one undoable command.
+  class ReorderFrames : public Cmd
+                      , public WithSprite {
+  public:
+    ReorderFrames(Sprite* sprite, const std::vector<frame_t>& newFrames);
+
+  protected:
+    void onExecute() override;
+    void onUndo() override;
+    void onFireNotifications() override;
+    size_t onMemSize() const override {
+      return sizeof(*this) +
+        sizeof(frame_t) * (m_newFrames.size() + m_oldFrames.size());
+    }
+
+  private:
+    void reorder(const std::vector<frame_t>& newFrames);
+
+    std::vector<frame_t> m_newFrames;
+    std::vector<frame_t> m_oldFrames; // Inverse of m_newFrames
+  };
+
+} // namespace cmd
+} // namespace app
+
+#endif
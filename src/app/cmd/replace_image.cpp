@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2023  Igara Studio S.A.
+// Copyright (C) 2023-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -42,7 +42,7 @@ void ReplaceImage::onExecute()
   ASSERT(oldImage);
   m_copy.reset(Image::createCopy(oldImage.get()));
 
-  replaceImage(m_oldImageId, m_newImage);
+  replaceImage(sprite(), m_oldImageId, m_newImage);
   m_newImage.reset();
 }
 
@@ -53,7 +53,7 @@ void ReplaceImage::onUndo()
   ASSERT(!sprite()->getImageRef(m_oldImageId));
   m_copy->setId(m_oldImageId);
 
-  replaceImage(m_newImageId, m_copy);
+  replaceImage(sprite(), m_newImageId, m_copy);
   m_copy.reset(Image::createCopy(newImage.get()));
 }
 
@@ -64,14 +64,13 @@ void ReplaceImage::onRedo()
   ASSERT(!sprite()->getImageRef(m_newImageId));
   m_copy->setId(m_newImageId);
 
-  replaceImage(m_oldImageId, m_copy);
+  replaceImage(sprite(), m_oldImageId, m_copy);
   m_copy.reset(Image::createCopy(oldImage.get()));
 }
 
-void ReplaceImage::replaceImage(ObjectId oldId, const ImageRef& newImage)
+// static
+void ReplaceImage::replaceImage(Sprite* spr, ObjectId oldId, const ImageRef& newImage)
 {
-  Sprite* spr = sprite();
-
   for (Cel* cel : spr->uniqueCels()) {
     if (cel->image()->id() == oldId)
       cel->data()->incrementVersion();
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -23,6 +24,10 @@ namespace cmd {
   public:
     ReplaceImage(Sprite* sprite, const ImageRef& oldImage, const ImageRef& newImage);
 
+    // Replaces the image with the given ID in all cels/tilesets of
+    // the sprite (and increments the version of the modified objects).
+    static void replaceImage(Sprite* sprite, ObjectId oldId, const ImageRef& newImage);
+
   protected:
     void onExecute() override;
     void onUndo() override;
@@ -33,8 +38,6 @@ namespace cmd {
     }
 
   private:
-    void replaceImage(ObjectId oldId, const ImageRef& newImage);
-
     ObjectId m_oldImageId;
     ObjectId m_newImageId;
 
@@ -13,6 +13,7 @@
 
 #include "app/cmd/set_mask.h"
 #include "app/doc.h"
+#include "app/doc_changes.h"
 #include "doc/mask.h"
 
 namespace app {
@@ -51,5 +52,10 @@ size_t ReselectMask::onMemSize() const
   return sizeof(*this) + (m_oldMask ? m_oldMask->getMemSize(): 0);
 }
 
+void ReselectMask::onCollectChanges(DocChanges& changes)
+{
+  // The selection doesn't modify the sprite pixels
+}
+
 } // namespace cmd
 } // namespace app
@@ -29,6 +29,7 @@ namespace cmd {
   protected:
     void onExecute() override;
     void onUndo() override;
+    void onCollectChanges(DocChanges& changes) override;
     size_t onMemSize() const override;
 
   private:
@@ -11,6 +11,7 @@
 #include "app/cmd/set_cel_opacity.h"
 
 #include "app/doc.h"
+#include "app/doc_changes.h"
 #include "app/doc_event.h"
 #include "doc/cel.h"
 
@@ -48,5 +49,10 @@ void SetCelOpacity::onFireNotifications()
   doc->notify_observers<DocEvent&>(&DocObserver::onCelOpacityChange, ev);
 }
 
+void SetCelOpacity::onCollectChanges(DocChanges& changes)
+{
+  changes.addCel(cel());
+}
+
 } // namespace cmd
 } // namespace app
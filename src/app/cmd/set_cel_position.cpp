@@ -11,6 +11,7 @@
 #include "app/cmd/set_cel_position.h"
 
 #include "app/doc.h"
+#include "app/doc_changes.h"
 #include "app/doc_event.h"
 #include "doc/cel.h"
 
@@ -50,5 +51,20 @@ void SetCelPosition::onFireNotifications()
   doc->notify_observers<DocEvent&>(&DocObserver::onCelPositionChanged, ev);
 }
 
+void SetCelPosition::onCollectChanges(DocChanges& changes)
+{
+  Cel* cel = this->cel();
+  if (!cel) {
+    changes.addAll();
+    return;
+  }
+
+  // The old and new positions of the cel are modified
+  const gfx::Rect bounds = cel->bounds();
+  changes.addCelBounds(cel->layer(), cel->frame(),
+                       gfx::Rect(m_oldX, m_oldY, bounds.w, bounds.h) |
+                       gfx::Rect(m_newX, m_newY, bounds.w, bounds.h));
+}
+
 } // namespace cmd
 } // namespace app
@@ -24,6 +24,7 @@ namespace cmd {
     void onExecute() override;
     void onUndo() override;
     void onFireNotifications() override;
+    void onCollectChanges(DocChanges& changes) override;
     size_t onMemSize() const override {
       return sizeof(*this);
     }
@@ -12,6 +12,7 @@
 #include "app/cmd/set_mask.h"
 
 #include "app/doc.h"
+#include "app/doc_changes.h"
 #include "doc/mask.h"
 
 namespace app {
@@ -64,5 +65,10 @@ void SetMask::setMask(const Mask* mask)
   doc->notifySelectionChanged();
 }
 
+void SetMask::onCollectChanges(DocChanges& changes)
+{
+  // The selection doesn't modify the sprite pixels
+}
+
 } // namespace cmd
 } // namespace app
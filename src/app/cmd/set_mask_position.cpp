@@ -12,6 +12,7 @@
 #include "app/cmd/set_mask_position.h"
 
 #include "app/doc.h"
+#include "app/doc_changes.h"
 #include "doc/mask.h"
 
 namespace app {
@@ -43,5 +44,10 @@ void SetMaskPosition::setMaskPosition(const gfx::Point& pos)
   doc->notifySelectionChanged();
 }
 
+void SetMaskPosition::onCollectChanges(DocChanges& changes)
+{
+  // The selection doesn't modify the sprite pixels
+}
+
 } // namespace cmd
 } // namespace app
@@ -21,6 +21,7 @@
 #include "doc/cel.h"
 #include "doc/cels_range.h"
 #include "doc/document.h"
+#include "doc/image_io.h"
 #include "doc/layer.h"
 #include "doc/palette.h"
 #include "doc/rgbmap.h"
@@ -29,6 +30,8 @@
 #include "render/quantization.h"
 #include "render/task_delegate.h"
 
+#include <sstream>
+
 namespace app {
 namespace cmd {
 
@@ -79,65 +82,18 @@ SetPixelFormat::SetPixelFormat(Sprite* sprite,
   : WithSprite(sprite)
   , m_oldFormat(sprite->pixelFormat())
   , m_newFormat(newFormat)
+  , m_dithering(dithering)
+  , m_mapAlgorithm(mapAlgorithm)
+  , m_toGray(toGray)
+  , m_delegate(delegate)
+  , m_fitCriteria(fitCriteria)
 {
   if (sprite->pixelFormat() == newFormat)
     return;
 
-  // Calculate the number of images to convert just to show a proper
-  // progress bar.
-  tile_index nimages = 0;
-  for (Cel* cel : sprite->uniqueCels())
-    if (!cel->layer()->isTilemap())
-      ++nimages;
-  if (sprite->hasTilesets()) {
-    for (Tileset* tileset : *sprite->tilesets()) {
-      if (tileset)
-        nimages += tileset->size();
-    }
-  }
-
-  SuperDelegate superDel(nimages, delegate);
-
-  // Convert cel images
-  for (Cel* cel : sprite->uniqueCels()) {
-    if (cel->layer()->isTilemap())
-      continue;
-
-    ImageRef oldImage = cel->imageRef();
-    convertImage(sprite, dithering,
-                 oldImage,
-                 cel->frame(),
-                 cel->layer()->isBackground(),
-                 mapAlgorithm,
-                 toGray,
-                 &superDel,
-                 fitCriteria);
-
-    superDel.nextImage();
-  }
-
-  // Convert tileset images
-  if (sprite->hasTilesets()) {
-    for (Tileset* tileset : *sprite->tilesets()) {
-      if (!tileset)
-        continue;
-
-      for (tile_index i=0; i<tileset->size(); ++i) {
-        ImageRef oldImage = tileset->get(i);
-        if (oldImage) {
-          convertImage(sprite, dithering,
-                       oldImage,
-                       0,     // TODO select a frame or generate other tilesets?
-                       false, // TODO is background? it depends of the layer where this tileset is used
-                       mapAlgorithm,
-                       toGray,
-                       &superDel,
-                       fitCriteria);
-        }
-        superDel.nextImage();
-      }
-    }
-  }
+  // Images are converted in onExecute() (one by one, so we don't need
+  // all the original and converted images in memory at the same
+  // time).
 
   // By default, when converting to RGB or grayscale, the mask color
   // is always 0.
@@ -190,6 +146,9 @@ SetPixelFormat::SetPixelFormat(Sprite* sprite,
 
 void SetPixelFormat::onExecute()
 {
+  if (m_oldFormat != m_newFormat)
+    convertImages();
+
   m_pre.execute(context());
   setFormat(m_newFormat);
   m_post.execute(context());
@@ -200,15 +159,115 @@ void SetPixelFormat::onUndo()
   m_post.undo();
   setFormat(m_oldFormat);
   m_pre.undo();
+  swapImages(false);
 }
 
 void SetPixelFormat::onRedo()
 {
+  swapImages(true);
   m_pre.redo();
   setFormat(m_newFormat);
   m_post.redo();
 }
 
+size_t SetPixelFormat::onMemSize() const
+{
+  size_t size = sizeof(*this) + m_pre.memSize() + m_post.memSize();
+  for (const auto& image : m_images)
+    size += sizeof(image) + image.data.size();
+  return size;
+}
+
+void SetPixelFormat::convertImages()
+{
+  Sprite* sprite = this->sprite();
+
+  // Images to convert with the frame and background flag used to
+  // convert them.
+  struct Item {
+    ImageRef image;
+    frame_t frame;
+    bool isBackground;
+  };
+  std::vector<Item> items;
+
+  for (Cel* cel : sprite->uniqueCels()) {
+    if (!cel->layer()->isTilemap())
+      items.push_back({ cel->imageRef(), cel->frame(), cel->layer()->isBackground() });
+  }
+  if (sprite->hasTilesets()) {
+    for (Tileset* tileset : *sprite->tilesets()) {
+      if (!tileset)
+        continue;
+
+      for (tile_index i=0; i<tileset->size(); ++i) {
+        items.push_back({ tileset->get(i),
+                          0,        // TODO select a frame or generate other tilesets?
+                          false }); // TODO is background? it depends of the layer where this tileset is used
+      }
+    }
+  }
+
+  SuperDelegate superDel(int(items.size()), m_delegate);
+  m_images.reserve(items.size());
+
+  for (Item& item : items) {
+    if (item.image) {
+      ImageRef newImage = convertImage(sprite, item.image,
+                                       item.frame, item.isBackground,
+                                       &superDel);
+
+      // Keep a compressed copy of the original image for undo, and
+      // release it from the sprite.
+      std::ostringstream os;
+      write_image(os, item.image.get());
+      m_images.push_back({ item.image->id(), newImage->id(), os.str() });
+
+      item.image.reset();
+      ReplaceImage::replaceImage(sprite, m_images.back().oldId, newImage);
+    }
+    superDel.nextImage();
+
+    // The transaction will be rolled back, anyway we stop converting
+    // images here.
+    if (!superDel.continueTask())
+      break;
+  }
+
+  m_delegate = nullptr;
+}
+
+void SetPixelFormat::swapImages(const bool toNewImages)
+{
+  Sprite* sprite = this->sprite();
+
+  auto swapImage = [sprite](ConvertedImage& image,
+                            const ObjectId curId){
+    ImageRef curImage = sprite->getImageRef(curId);
+    ASSERT(curImage);
+
+    std::istringstream is(image.data);
+    ImageRef otherImage(read_image(is, true));
+    ASSERT(otherImage);
+
+    std::ostringstream os;
+    write_image(os, curImage.get());
+    image.data = os.str();
+
+    curImage.reset();
+    ReplaceImage::replaceImage(sprite, curId, otherImage);
+  };
+
+  if (toNewImages) {
+    for (auto& image : m_images)
+      swapImage(image, image.oldId);
+  }
+  else {
+    for (auto it=m_images.rbegin(), end=m_images.rend(); it!=end; ++it)
+      swapImage(*it, it->newId);
+  }
+}
+
 void SetPixelFormat::setFormat(PixelFormat format)
 {
   Sprite* sprite = this->sprite();
@@ -226,15 +285,11 @@ void SetPixelFormat::setFormat(PixelFormat format)
   doc->notify_observers<DocEvent&>(&DocObserver::onPixelFormatChanged, ev);
 }
 
-void SetPixelFormat::convertImage(doc::Sprite* sprite,
-                                  const render::Dithering& dithering,
-                                  const doc::ImageRef& oldImage,
-                                  const doc::frame_t frame,
-                                  const bool isBackground,
-                                  const doc::RgbMapAlgorithm mapAlgorithm,
-                                  doc::rgba_to_graya_func toGray,
-                                  render::TaskDelegate* delegate,
-                                  const doc::FitCriteria fitCriteria)
+ImageRef SetPixelFormat::convertImage(doc::Sprite* sprite,
+                                      const doc::ImageRef& oldImage,
+                                      const doc::frame_t frame,
+                                      const bool isBackground,
+                                      render::TaskDelegate* delegate)
 {
   ASSERT(oldImage);
   ASSERT(oldImage->pixelFormat() != IMAGE_TILEMAP);
@@ -246,8 +301,8 @@ void SetPixelFormat::convertImage(doc::Sprite* sprite,
   if (m_newFormat == IMAGE_INDEXED) {
     rgbmap = sprite->rgbMap(frame,
                             sprite->rgbMapForSprite(),
-                            mapAlgorithm,
-                            fitCriteria);
+                            m_mapAlgorithm,
+                            m_fitCriteria);
     if (m_oldFormat == IMAGE_INDEXED)
       newMaskIndex = sprite->transparentColor();
     else
@@ -256,18 +311,16 @@ void SetPixelFormat::convertImage(doc::Sprite* sprite,
   else {
     rgbmap = nullptr;
   }
-  ImageRef newImage(
+  return ImageRef(
     render::convert_pixel_format
     (oldImage.get(), nullptr, m_newFormat,
-     dithering,
+     m_dithering,
      rgbmap,
      sprite->palette(frame),
      isBackground,
      newMaskIndex,
-     toGray,
+     m_toGray,
      delegate));
-
-  m_pre.add(new cmd::ReplaceImage(sprite, oldImage, newImage));
 }
 
 } // namespace cmd
@@ -15,15 +15,19 @@
 #include "doc/fit_criteria.h"
 #include "doc/frame.h"
 #include "doc/image_ref.h"
+#include "doc/object_id.h"
 #include "doc/pixel_format.h"
 #include "doc/rgbmap_algorithm.h"
+#include "render/dithering.h"
+
+#include <string>
+#include <vector>
 
 namespace doc {
   class Sprite;
 }
 
 namespace render {
-  class Dithering;
   class TaskDelegate;
 }
 
@@ -45,26 +49,39 @@ namespace cmd {
     void onExecute() override;
     void onUndo() override;
     void onRedo() override;
-    size_t onMemSize() const override {
-      return sizeof(*this) + m_pre.memSize() + m_post.memSize();
-    }
+    size_t onMemSize() const override;
 
   private:
+    // An image converted in onExecute(). The image that is not in
+    // the sprite (the original one after onExecute()/onRedo(), or the
+    // converted one after onUndo()) is kept compressed in "data".
+    struct ConvertedImage {
+      doc::ObjectId oldId;
+      doc::ObjectId newId;
+      std::string data;
+    };
+
     void setFormat(doc::PixelFormat format);
-    void convertImage(doc::Sprite* sprite,
-                      const render::Dithering& dithering,
-                      const doc::ImageRef& oldImage,
-                      const doc::frame_t frame,
-                      const bool isBackground,
-                      const doc::RgbMapAlgorithm mapAlgorithm,
-                      doc::rgba_to_graya_func toGray,
-                      render::TaskDelegate* delegate,
-                      const doc::FitCriteria fitCriteria = doc::FitCriteria::DEFAULT);
+    void convertImages();
+    void swapImages(const bool toNewImages);
+    doc::ImageRef convertImage(doc::Sprite* sprite,
+                               const doc::ImageRef& oldImage,
+                               const doc::frame_t frame,
+                               const bool isBackground,
+                               render::TaskDelegate* delegate);
 
     doc::PixelFormat m_oldFormat;
     doc::PixelFormat m_newFormat;
     CmdSequence m_pre;
     CmdSequence m_post;
+    std::vector<ConvertedImage> m_images;
+
+    // Options to convert images, used only in onExecute().
+    render::Dithering m_dithering;
+    doc::RgbMapAlgorithm m_mapAlgorithm;
+    doc::rgba_to_graya_func m_toGray;
+    render::TaskDelegate* m_delegate;
+    doc::FitCriteria m_fitCriteria;
   };
 
 } // namespace cmd
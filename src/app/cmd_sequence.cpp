@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2023  Igara Studio S.A.
+// Copyright (C) 2023-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -80,6 +80,18 @@ size_t CmdSequence::onMemSize() const
   return size;
 }
 
+void CmdSequence::onSpill(DocUndoSpillFile* file)
+{
+  for (auto* cmd : m_cmds)
+    cmd->spill(file);
+}
+
+void CmdSequence::onCollectChanges(DocChanges& changes)
+{
+  for (auto* cmd : m_cmds)
+    cmd->collectChanges(changes);
+}
+
 void CmdSequence::executeAndAdd(Cmd* cmd)
 {
   addAndExecute(context(), cmd);
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2022  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -16,6 +16,9 @@
 #include "os/system.h"
 #include "os/window.h"
 
+#include <algorithm>
+#include <mutex>
+
 namespace app {
 
 // We use this variable to avoid accessing Preferences::instance()
@@ -62,6 +65,129 @@ gfx::ColorSpaceRef get_working_rgb_space_from_preferences()
   return gfx::ColorSpace::MakeNone();
 }
 
+//////////////////////////////////////////////////////////////////////
+// Color space LUTs
+
+ColorSpaceLut::ColorSpaceLut(os::ColorSpaceConversion* conversion)
+  : m_rgb(kSize*kSize*kSize*3)
+{
+  // Convert all the colors of the grid at once
+  std::vector<uint32_t> grid(kSize*kSize*kSize);
+  auto it = grid.begin();
+  for (int r=0; r<kSize; ++r)
+    for (int g=0; g<kSize; ++g)
+      for (int b=0; b<kSize; ++b, ++it)
+        *it = gfx::rgba((r*255 + (kSize-1)/2) / (kSize-1),
+                        (g*255 + (kSize-1)/2) / (kSize-1),
+                        (b*255 + (kSize-1)/2) / (kSize-1), 255);
+  conversion->convertRgba(grid.data(), grid.data(), int(grid.size()));
+
+  auto dst = m_rgb.begin();
+  for (const uint32_t c : grid) {
+    *(dst++) = gfx::getr(c);
+    *(dst++) = gfx::getg(c);
+    *(dst++) = gfx::getb(c);
+  }
+
+  for (int i=0; i<256; ++i)
+    m_gray[i] = i;
+  conversion->convertGray(m_gray, m_gray, 256);
+}
+
+gfx::Color ColorSpaceLut::convertRgba(const gfx::Color c) const
+{
+  // Position of the color in the grid in 8.8 fixed point
+  const int fr = gfx::getr(c) * (kSize-1) * 256 / 255;
+  const int fg = gfx::getg(c) * (kSize-1) * 256 / 255;
+  const int fb = gfx::getb(c) * (kSize-1) * 256 / 255;
+  const int r = fr >> 8, wr = fr & 255;
+  const int g = fg >> 8, wg = fg & 255;
+  const int b = fb >> 8, wb = fb & 255;
+
+  // Offsets to the next grid color in each axis (0 in the last one)
+  const int dr = (r < kSize-1 ? kSize*kSize*3: 0);
+  const int dg = (g < kSize-1 ? kSize*3: 0);
+  const int db = (b < kSize-1 ? 3: 0);
+
+  // Tetrahedral interpolation: the cube is split in 6 tetrahedrons,
+  // and we interpolate between the 4 vertices of the one that
+  // contains the color.
+  const uint8_t* c000 = &m_rgb[(r*kSize*kSize + g*kSize + b)*3];
+  const uint8_t* c111 = c000 + dr + dg + db;
+  const uint8_t* c1;
+  const uint8_t* c2;
+  int w0, w1, w2;
+  if (wr >= wg) {
+    if (wg >= wb)      { c1 = c000+dr;    c2 = c000+dr+dg; w0 = wr; w1 = wg; w2 = wb; }
+    else if (wr >= wb) { c1 = c000+dr;    c2 = c000+dr+db; w0 = wr; w1 = wb; w2 = wg; }
+    else               { c1 = c000+db;    c2 = c000+dr+db; w0 = wb; w1 = wr; w2 = wg; }
+  }
+  else {
+    if (wb >= wg)      { c1 = c000+db;    c2 = c000+dg+db; w0 = wb; w1 = wg; w2 = wr; }
+    else if (wb >= wr) { c1 = c000+dg;    c2 = c000+dg+db; w0 = wg; w1 = wb; w2 = wr; }
+    else               { c1 = c000+dg;    c2 = c000+dr+dg; w0 = wg; w1 = wr; w2 = wb; }
+  }
+
+  int out[3];
+  for (int i=0; i<3; ++i) {
+    out[i] = (c000[i]*256
+              + (c1[i]-c000[i])*w0
+              + (c2[i]-c1[i])*w1
+              + (c111[i]-c2[i])*w2
+              + 128) >> 8;
+  }
+  return gfx::rgba(out[0], out[1], out[2], gfx::geta(c));
+}
+
+void ColorSpaceLut::convertRgba(uint32_t* dst, const uint32_t* src, int n) const
+{
+  for (; n>0; --n, ++dst, ++src)
+    *dst = convertRgba(*src);
+}
+
+ColorSpaceLutRef get_color_space_lut(const os::ColorSpaceRef& srcCS,
+                                     const os::ColorSpaceRef& dstCS)
+{
+  // Max number of cached LUTs (~110KB each)
+  constexpr size_t kMaxCachedLuts = 16;
+
+  struct Entry {
+    os::ColorSpaceRef srcCS, dstCS;
+    ColorSpaceLutRef lut;
+  };
+  static std::mutex mutex;
+  static std::vector<Entry> cache; // Most recently used first
+
+  if (!srcCS || !dstCS)
+    return nullptr;
+
+  auto sameCS = [](const os::ColorSpaceRef& a,
+                   const os::ColorSpaceRef& b) {
+    return (a == b ||
+            a->gfxColorSpace()->nearlyEqual(*b->gfxColorSpace()));
+  };
+
+  const std::lock_guard lock(mutex);
+  auto it = std::find_if(cache.begin(), cache.end(),
+                         [&](const Entry& e){
+                           return (sameCS(e.srcCS, srcCS) &&
+                                   sameCS(e.dstCS, dstCS));
+                         });
+  if (it != cache.end()) {
+    std::rotate(cache.begin(), it, it+1);
+    return cache.front().lut;
+  }
+
+  ColorSpaceLutRef lut;
+  if (auto conversion = os::instance()->convertBetweenColorSpace(srcCS, dstCS))
+    lut = std::make_shared<ColorSpaceLut>(conversion.get());
+
+  if (cache.size() == kMaxCachedLuts)
+    cache.pop_back();
+  cache.insert(cache.begin(), Entry{ srcCS, dstCS, lut });
+  return lut;
+}
+
 //////////////////////////////////////////////////////////////////////
 // Color conversion
 
@@ -71,7 +197,7 @@ ConvertCS::ConvertCS()
     auto srcCS = get_current_color_space();
     auto dstCS = get_screen_color_space();
     if (srcCS && dstCS)
-      m_conversion = os::instance()->convertBetweenColorSpace(srcCS, dstCS);
+      m_lut = get_color_space_lut(srcCS, dstCS);
   }
 }
 
@@ -79,25 +205,21 @@ ConvertCS::ConvertCS(const os::ColorSpaceRef& srcCS,
                      const os::ColorSpaceRef& dstCS)
 {
   if (g_manage) {
-    m_conversion = os::instance()->convertBetweenColorSpace(srcCS, dstCS);
+    m_lut = get_color_space_lut(srcCS, dstCS);
   }
 }
 
 ConvertCS::ConvertCS(ConvertCS&& that)
-  : m_conversion(std::move(that.m_conversion))
+  : m_lut(std::move(that.m_lut))
 {
 }
 
 gfx::Color ConvertCS::operator()(const gfx::Color c)
 {
-  if (m_conversion) {
-    gfx::Color out;
-    m_conversion->convertRgba((uint32_t*)&out, (const uint32_t*)&c, 1);
-    return out;
-  }
-  else {
+  if (m_lut)
+    return m_lut->convertRgba(c);
+  else
     return c;
-  }
 }
 
 ConvertCS convert_from_current_to_screen_color_space()
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (c) 2018-2020  Igara Studio S.A.
+// Copyright (c) 2018-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -12,6 +12,10 @@
 #include "gfx/color_space.h"
 #include "os/color_space.h"
 
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 namespace doc {
   class Sprite;
 }
@@ -28,6 +32,38 @@ namespace app {
 
   gfx::ColorSpaceRef get_working_rgb_space_from_preferences();
 
+  // Cached result of a conversion between two color spaces: a 3D LUT
+  // for RGB colors (a grid of kSize^3 colors converted with the
+  // os::ColorSpaceConversion, and tetrahedral interpolation between
+  // them) and a 1D table for gray values. The alpha is kept as it is.
+  class ColorSpaceLut {
+  public:
+    static constexpr int kSize = 33;
+
+    ColorSpaceLut(os::ColorSpaceConversion* conversion);
+
+    gfx::Color convertRgba(const gfx::Color c) const;
+    void convertRgba(uint32_t* dst, const uint32_t* src, int n) const;
+    uint8_t convertGray(const uint8_t v) const { return m_gray[v]; }
+
+    std::size_t memSize() const {
+      return sizeof(*this) + m_rgb.size() + sizeof(m_gray);
+    }
+
+  private:
+    std::vector<uint8_t> m_rgb;   // kSize^3 RGB triplets
+    uint8_t m_gray[256];
+  };
+
+  using ColorSpaceLutRef = std::shared_ptr<const ColorSpaceLut>;
+
+  // Returns the LUT to convert from "srcCS" to "dstCS" (it's created
+  // the first time and then cached), or nullptr if there is no
+  // conversion between these color spaces. Can be called from any
+  // thread.
+  ColorSpaceLutRef get_color_space_lut(const os::ColorSpaceRef& srcCS,
+                                       const os::ColorSpaceRef& dstCS);
+
   class ConvertCS {
   public:
     ConvertCS();
@@ -37,7 +73,7 @@ namespace app {
     ConvertCS& operator=(const ConvertCS&) = delete;
     gfx::Color operator()(const gfx::Color c);
   private:
-    os::Ref<os::ColorSpaceConversion> m_conversion;
+    ColorSpaceLutRef m_lut;
   };
 
   ConvertCS convert_from_current_to_screen_color_space();
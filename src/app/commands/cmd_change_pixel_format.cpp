@@ -21,6 +21,7 @@
 #include "app/load_matrix.h"
 #include "app/modules/gui.h"
 #include "app/modules/palettes.h"
+#include "app/render/shader_quantization.h"
 #include "app/sprite_job.h"
 #include "app/transaction.h"
 #include "app/ui/best_fit_criteria_selector.h"
@@ -35,6 +36,7 @@
 #include "fmt/format.h"
 #include "render/dithering.h"
 #include "render/dithering_algorithm.h"
+#include "render/dithering_matrix.h"
 #include "render/ordered_dither.h"
 #include "render/quantization.h"
 #include "render/render.h"
@@ -418,6 +420,11 @@ private:
     progress()->setVisible(false);
     layout();
 
+#if SK_ENABLE_SKSL && ENABLE_DEVMODE
+    if (convertPreviewWithShader(dstPixelFormat, visibleBounds))
+      return;
+#endif
+
     m_bgThread.reset(
       new ConvertThread(
         m_image,
@@ -432,6 +439,42 @@ private:
     m_timer.start();
   }
 
+#if SK_ENABLE_SKSL && ENABLE_DEVMODE
+  // With the shader renderer, the preview of RGB -> Indexed with
+  // ordered dithering (or without dithering) is calculated with a
+  // shader in the UI thread, so it's interactive even for big
+  // canvases. Returns false if the preview must be calculated with
+  // the ConvertThread.
+  bool convertPreviewWithShader(const doc::PixelFormat dstPixelFormat,
+                                const gfx::Rect& visibleBounds) {
+    const Sprite* sprite = m_editor->sprite();
+    const render::Dithering d = dithering();
+    if (m_editor->renderEngine().type() != EditorRender::kShaderRenderer ||
+        sprite->pixelFormat() != IMAGE_RGB ||
+        dstPixelFormat != IMAGE_INDEXED ||
+        d.algorithm() == render::DitheringAlgorithm::ErrorDiffusion)
+      return false;
+
+    doc::ImageRef tmp(
+      Image::create(IMAGE_RGB, visibleBounds.w, visibleBounds.h));
+
+    render::Render render;
+    render.setNewBlend(Preferences::instance().experimental.newBlend());
+    render.renderSprite(
+      tmp.get(), sprite, m_editor->frame(),
+      gfx::Clip(0, 0,
+                visibleBounds.x, visibleBounds.y,
+                visibleBounds.w, visibleBounds.h));
+
+    const render::DitheringMatrix matrix = d.matrix();
+    return shader_convert_rgb_to_indexed(
+      tmp.get(), m_image.get(),
+      sprite->palette(m_editor->frame()),
+      (d.algorithm() != render::DitheringAlgorithm::None ? &matrix: nullptr),
+      (sprite->backgroundLayer() ? -1: 0));
+  }
+#endif
+
   void onIndexParamChange() {
     stop();
     m_selectedItem = nullptr;
@@ -578,6 +621,8 @@ void ChangePixelFormatCommand::onLoadParams(const Params& params)
     m_rgbmap = doc::RgbMapAlgorithm::OCTREE;
   else if (rgbmap == "rgb5a3")
     m_rgbmap = doc::RgbMapAlgorithm::RGB5A3;
+  else if (rgbmap == "kdtree")
+    m_rgbmap = doc::RgbMapAlgorithm::KDTREE;
   else if (rgbmap == "default")
     m_rgbmap = doc::RgbMapAlgorithm::DEFAULT;
   else {
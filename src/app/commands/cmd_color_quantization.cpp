@@ -39,6 +39,8 @@ struct ColorQuantizationParams : public NewParams {
   Param<int> maxColors { this, 256, "maxColors" };
   Param<bool> useRange { this, false, "useRange" };
   Param<RgbMapAlgorithm> algorithm { this, RgbMapAlgorithm::DEFAULT, "algorithm" };
+  Param<int> frameStep { this, 1, "frameStep" };
+  Param<int> pixelStep { this, 1, "pixelStep" };
 };
 
 class PaletteFromSpriteWindow : public app::gen::PaletteFromSprite {
@@ -173,17 +175,25 @@ void ColorQuantizationCommand::onExecute(Context* ctx)
     const Palette* curPalette = site.sprite()->palette(frame);
     Palette tmpPalette(frame, entries.picks());
 
+    // Sampling of frames/pixels to create an approximated palette
+    // faster (e.g. for long animations)
+    render::PaletteSampling sampling;
+    sampling.frameStep = std::max(1, params().frameStep());
+    sampling.pixelStep = std::max(1, params().pixelStep());
+
     SpriteJob job(ctx, doc, "Color Quantization", ui);
     const bool newBlend = pref.experimental.newBlend();
     job.startJobWithCallback(
       [sprite, withAlpha, curPalette, &tmpPalette, &job, &entries,
-       newBlend, algorithm, createPal, site, frame](Tx& tx) {
+       newBlend, algorithm, createPal, site, frame, sampling](Tx& tx) {
         render::create_palette_from_sprite(
           sprite, 0, sprite->lastFrame(),
           withAlpha, &tmpPalette,
           &job,                 // SpriteJob is a render::TaskDelegate
           newBlend,
-          algorithm);
+          algorithm,
+          true,                 // calculateWithTransparent
+          sampling);
 
         std::unique_ptr<Palette> newPalette(
           new Palette(createPal ? tmpPalette:
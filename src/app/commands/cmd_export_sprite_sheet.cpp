@@ -190,6 +190,7 @@ Doc* generate_sprite_sheet_from_params(
   const bool extrude = params.extrude();
   const bool ignoreEmpty = params.ignoreEmpty();
   const bool mergeDuplicates = params.mergeDuplicates();
+  const bool incremental = params.incremental();
   const bool splitLayers = params.splitLayers();
   const bool splitTags = params.splitTags();
   const bool splitGrid = params.splitGrid();
@@ -277,6 +278,10 @@ Doc* generate_sprite_sheet_from_params(
   exporter.setSplitTags(splitTags);
   exporter.setIgnoreEmptyCels(ignoreEmpty);
   exporter.setMergeDuplicates(mergeDuplicates);
+  if (incremental) {
+    exporter.setIncrementalLayout(true);
+    exporter.setIncrementalRender(true);
+  }
   if (listLayers) exporter.setListLayers(true);
   if (listTags) exporter.setListTags(true);
   if (listSlices) exporter.setListSlices(true);
@@ -419,6 +424,7 @@ public:
                                    params.trimByGrid());
     extrudeEnabled()->setSelected(params.extrude());
     mergeDups()->setSelected(params.mergeDuplicates());
+    incremental()->setSelected(params.incremental());
     ignoreEmpty()->setSelected(params.ignoreEmpty());
 
     borderPadding()->setTextf("%d", params.borderPadding());
@@ -560,6 +566,7 @@ public:
     params.trimByGrid      (trimByGridValue());
     params.extrude         (extrudeValue());
     params.mergeDuplicates (mergeDupsValue());
+    params.incremental     (incrementalValue());
     params.ignoreEmpty     (ignoreEmptyValue());
     params.openGenerated   (openGeneratedValue());
     params.layer           (layerValue());
@@ -747,6 +754,10 @@ private:
     return mergeDups()->isSelected();
   }
 
+  bool incrementalValue() const {
+    return incremental()->isSelected();
+  }
+
   bool ignoreEmptyValue() const {
     return ignoreEmpty()->isSelected();
   }
@@ -909,8 +920,7 @@ private:
   }
 
   void onDataFilename() {
-    // TODO hardcoded "json" extension
-    base::paths exts = { "json" };
+    base::paths exts = { "json", "msgpack" };
     base::paths newFilename;
     if (!app::show_file_selector(
            Strings::export_sprite_sheet_save_json_title(),
@@ -1287,6 +1297,7 @@ void ExportSpriteSheetCommand::onExecute(Context* context)
       if (!params.trimByGrid.isSet())       params.trimByGrid(      defPref.spriteSheet.trimByGrid());
       if (!params.extrude.isSet())          params.extrude(         defPref.spriteSheet.extrude());
       if (!params.mergeDuplicates.isSet())  params.mergeDuplicates( defPref.spriteSheet.mergeDuplicates());
+      if (!params.incremental.isSet())      params.incremental(     defPref.spriteSheet.incremental());
       if (!params.ignoreEmpty.isSet())      params.ignoreEmpty(     defPref.spriteSheet.ignoreEmpty());
       if (!params.openGenerated.isSet())    params.openGenerated(   defPref.spriteSheet.openGenerated());
       if (!params.layer.isSet())            params.layer(           defPref.spriteSheet.layer());
@@ -1305,6 +1316,11 @@ void ExportSpriteSheetCommand::onExecute(Context* context)
   if (showUI) {
     auto& pref = Preferences::instance();
 
+    // Each change in the dialog generates a new preview, so we keep
+    // the renders of samples between exports (in this way changing
+    // only the layout doesn't render all the samples again).
+    exporter.setCacheRenders(true);
+
     ExportSpriteSheetWindow window(exporter, site, params, pref);
     window.openWindowInForeground();
 
@@ -1336,6 +1352,7 @@ void ExportSpriteSheetCommand::onExecute(Context* context)
     docPref.spriteSheet.trimByGrid      (params.trimByGrid());
     docPref.spriteSheet.extrude         (params.extrude());
     docPref.spriteSheet.mergeDuplicates (params.mergeDuplicates());
+    docPref.spriteSheet.incremental     (params.incremental());
     docPref.spriteSheet.ignoreEmpty     (params.ignoreEmpty());
     docPref.spriteSheet.openGenerated   (params.openGenerated());
     docPref.spriteSheet.layer           (params.layer());
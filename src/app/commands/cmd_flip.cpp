@@ -12,6 +12,7 @@
 #include "app/commands/cmd_flip.h"
 
 #include "app/app.h"
+#include "app/cmd/flip_images.h"
 #include "app/cmd/flip_mask.h"
 #include "app/cmd/flip_masked_cel.h"
 #include "app/cmd/set_cel_bounds.h"
@@ -180,6 +181,9 @@ void FlipCommand::onExecute(Context* ctx)
     }
   }
   else {
+    std::vector<Image*> images;
+    images.reserve(cels.size());
+
     for (Cel* cel : cels) {
       Image* image = cel->image();
 
@@ -205,8 +209,12 @@ void FlipCommand::onExecute(Context* ctx)
             cel->y()));
       }
 
-      api.flipImage(image, image->bounds(), m_flipType);
+      images.push_back(image);
     }
+
+    // Flip all images with one command (in parallel)
+    if (!images.empty())
+      tx(new cmd::FlipImages(images, m_flipType));
   }
 
   // Flip the mask.
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -17,7 +17,6 @@
 #include "app/tx.h"
 #include "doc/image.h"
 #include "doc/mask.h"
-#include "doc/primitives.h"
 #include "doc/sprite.h"
 
 namespace app {
@@ -64,33 +63,10 @@ void InvertMaskCommand::onExecute(Context* context)
     Doc* document(writer.document());
     Sprite* sprite(writer.sprite());
 
-    // Select all the sprite area
+    // Select all the sprite area and remove the current mask
     std::unique_ptr<Mask> mask(new Mask());
     mask->replace(sprite->bounds());
-
-    // Remove in the new mask the current sprite marked region
-    const gfx::Rect& maskBounds = document->mask()->bounds();
-    doc::fill_rect(mask->bitmap(),
-      maskBounds.x, maskBounds.y,
-      maskBounds.x + maskBounds.w-1,
-      maskBounds.y + maskBounds.h-1, 0);
-
-    Mask* curMask = document->mask();
-    if (curMask->bitmap()) {
-      // Copy the inverted region in the new mask (we just modify the
-      // document's mask temporaly here)
-      curMask->freeze();
-      curMask->invert();
-      doc::copy_image(mask->bitmap(),
-        curMask->bitmap(),
-        curMask->bounds().x,
-        curMask->bounds().y);
-      curMask->invert();
-      curMask->unfreeze();
-    }
-
-    // We need only need the area inside the sprite
-    mask->intersect(sprite->bounds());
+    mask->subtract(*document->mask());
 
     // Set the new mask
     Tx tx(writer, "Mask Invert", DoesntModifyDocument);
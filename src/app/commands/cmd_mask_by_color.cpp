@@ -25,9 +25,12 @@
 #include "app/ui/color_bar.h"
 #include "app/ui/color_button.h"
 #include "app/ui/selection_mode_field.h"
+#include "app/util/range_utils.h"
 #include "base/chrono.h"
 #include "base/convert_to.h"
 #include "base/scoped_value.h"
+#include "base/thread_pool.h"
+#include "doc/cel.h"
 #include "doc/image.h"
 #include "doc/mask.h"
 #include "doc/sprite.h"
@@ -39,6 +42,10 @@
 #include "ui/widget.h"
 #include "ui/window.h"
 
+#include <algorithm>
+#include <thread>
+#include <vector>
+
 // Uncomment to see the performance of doc::MaskBoundaries ctor
 //#define SHOW_BOUNDARIES_GEN_PERFORMANCE
 
@@ -58,9 +65,7 @@ protected:
 
 private:
   Mask* generateMask(const Mask& origMask,
-                     const Sprite* sprite,
-                     const Image* image,
-                     int xpos, int ypos,
+                     const Site& site,
                      gen::SelectionMode mode);
   void maskPreview(const ContextReader& reader);
 
@@ -76,6 +81,7 @@ private:
   Window* m_window = nullptr;
   ColorButton* m_buttonColor = nullptr;
   CheckBox* m_checkPreview = nullptr;
+  CheckBox* m_checkSelectedCels = nullptr;
   Slider* m_sliderTolerance = nullptr;
   SelModeField* m_selMode = nullptr;
   bool m_isOrigMaskVisible;
@@ -103,9 +109,7 @@ void MaskByColorCommand::onExecute(Context* context)
   if (!App::instance()->isGui() || !sprite)
     return;
 
-  int xpos, ypos;
-  const Image* image = reader.image(&xpos, &ypos);
-  if (!image)
+  if (!reader.image())
     return;
 
   std::unique_ptr<Window> win(
@@ -129,22 +133,32 @@ void MaskByColorCommand::onExecute(Context* context)
   m_selMode->setupTooltips(tooltipManager);
 
   m_checkPreview = new CheckBox(Strings::mask_by_color_preview());
+  m_checkSelectedCels = new CheckBox(Strings::mask_by_color_selected_cels());
   auto button_ok = new Button(Strings::mask_by_color_ok());
   auto button_cancel = new Button(Strings::mask_by_color_cancel());
 
   m_checkPreview->processMnemonicFromText();
+  m_checkSelectedCels->processMnemonicFromText();
   button_ok->processMnemonicFromText();
   button_cancel->processMnemonicFromText();
 
   if (get_config_bool(ConfigSection, "Preview", true))
     m_checkPreview->setSelected(true);
 
+  // Selecting the color in all the selected cels makes sense only
+  // when there is a range of cels selected in the timeline.
+  if (reader.site()->range().enabled())
+    m_checkSelectedCels->setSelected(get_config_bool(ConfigSection, "SelectedCels", false));
+  else
+    m_checkSelectedCels->setEnabled(false);
+
   button_ok->Click.connect([this, button_ok]{ m_window->closeWindow(button_ok); });
   button_cancel->Click.connect([this, button_cancel]{ m_window->closeWindow(button_cancel); });
 
   m_buttonColor->Change.connect([&]{ maskPreview(reader); });
   m_sliderTolerance->Change.connect([&]{ maskPreview(reader); });
   m_checkPreview->Click.connect([&]{ maskPreview(reader); });
+  m_checkSelectedCels->Click.connect([&]{ maskPreview(reader); });
   m_selMode->ModeChange.connect([&]{ maskPreview(reader); });
 
   button_ok->setFocusMagnet(true);
@@ -156,6 +170,7 @@ void MaskByColorCommand::onExecute(Context* context)
   box1->addChild(m_selMode);
   box1->addChild(box2);
   box1->addChild(box3);
+  box1->addChild(m_checkSelectedCels);
   box1->addChild(m_checkPreview);
   box1->addChild(box4);
   box2->addChild(label_color);
@@ -190,13 +205,15 @@ void MaskByColorCommand::onExecute(Context* context)
   if (apply) {
     Tx tx(writer, "Mask by Color", DoesntModifyDocument);
     std::unique_ptr<Mask> mask(generateMask(*document->mask(),
-                                            sprite, image, xpos, ypos,
+                                            *reader.site(),
                                             m_selMode->selectionMode()));
     tx(new cmd::SetMask(document, mask.get()));
     tx.commit();
 
     set_config_int(ConfigSection, "Tolerance", m_sliderTolerance->getValue());
     set_config_bool(ConfigSection, "Preview", m_checkPreview->isSelected());
+    if (m_checkSelectedCels->isEnabled())
+      set_config_bool(ConfigSection, "SelectedCels", m_checkSelectedCels->isSelected());
   }
   else {
     document->generateMaskBoundaries();
@@ -210,18 +227,49 @@ void MaskByColorCommand::onExecute(Context* context)
 }
 
 Mask* MaskByColorCommand::generateMask(const Mask& origMask,
-                                       const Sprite* sprite,
-                                       const Image* image,
-                                       int xpos, int ypos,
+                                       const Site& site,
                                        gen::SelectionMode mode)
 {
+  const Sprite* sprite = site.sprite();
   int color = color_utils::color_for_image(m_buttonColor->getColor(),
                                            sprite->pixelFormat());
   int tolerance = m_sliderTolerance->getValue();
 
   std::unique_ptr<Mask> mask(new Mask());
-  mask->byColor(image, color, tolerance);
-  mask->offsetOrigin(xpos, ypos);
+
+  // Union of the masks of all selected cels (each one generated in
+  // a different thread)
+  if (m_checkSelectedCels->isSelected() && site.range().enabled()) {
+    const CelList cels = get_unique_cels(sprite, site.range());
+    std::vector<Mask> masks(cels.size());
+    {
+      base::thread_pool pool(
+        std::clamp<int>(std::thread::hardware_concurrency(), 1,
+                        std::max<int>(1, cels.size())));
+      for (size_t i=0; i<cels.size(); ++i) {
+        const Cel* cel = cels[i];
+        if (cel->image()->pixelFormat() != sprite->pixelFormat())
+          continue;             // Skip tilemaps
+
+        pool.execute([cel, &cellMask = masks[i], color, tolerance]{
+          cellMask.byColor(cel->image(), color, tolerance);
+          cellMask.offsetOrigin(cel->x(), cel->y());
+        });
+      }
+      pool.wait_all();
+    }
+    for (const Mask& cellMask : masks) {
+      if (!cellMask.isEmpty())
+        mask->add(cellMask);
+    }
+  }
+  else {
+    int xpos, ypos;
+    if (const Image* image = site.image(&xpos, &ypos)) {
+      mask->byColor(image, color, tolerance);
+      mask->offsetOrigin(xpos, ypos);
+    }
+  }
 
   if (!origMask.isEmpty() && m_isOrigMaskVisible) {
     switch (mode) {
@@ -255,11 +303,8 @@ void MaskByColorCommand::maskPreview(const ContextReader& reader)
 {
   ASSERT(m_window);
   if (m_window && m_checkPreview->isSelected()) {
-    int xpos, ypos;
-    const Image* image = reader.image(&xpos, &ypos);
     std::unique_ptr<Mask> mask(generateMask(*reader.document()->mask(),
-                                            reader.sprite(), image,
-                                            xpos, ypos,
+                                            *reader.site(),
                                             m_selMode->selectionMode()));
 
     ContextWriter writer(reader);
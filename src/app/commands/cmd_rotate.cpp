@@ -27,6 +27,7 @@
 #include "app/ui/toolbar.h"
 #include "app/util/range_utils.h"
 #include "base/convert_to.h"
+#include "base/thread_pool.h"
 #include "doc/cel.h"
 #include "doc/cels_range.h"
 #include "doc/image.h"
@@ -34,6 +35,10 @@
 #include "doc/sprite.h"
 #include "ui/ui.h"
 
+#include <algorithm>
+#include <thread>
+#include <vector>
+
 namespace app {
 
 class RotateJob : public SpriteJob {
@@ -103,22 +108,41 @@ protected:
       }
     }
 
-    // 2) Rotate images
-    int i = 0;
-    for (Cel* cel : m_cels) {
-      Image* image = cel->image();
-      if (image) {
-        ImageRef new_image(Image::create(image->pixelFormat(),
+    // 2) Rotate images (in parallel, in batches of cels to report the
+    // progress and check if the job was canceled)
+    const int nthreads =
+      std::clamp<int>(std::thread::hardware_concurrency(), 1,
+                      std::max<int>(1, m_cels.size()));
+    const int batchSize = 8*nthreads;
+    base::thread_pool pool(nthreads);
+    std::vector<ImageRef> newImages;
+
+    for (int i=0; i<int(m_cels.size()); i+=batchSize) {
+      const int n = std::min<int>(batchSize, m_cels.size()-i);
+      newImages.clear();
+      newImages.resize(n);
+
+      for (int j=0; j<n; ++j) {
+        const Image* image = m_cels[i+j]->image();
+        if (!image)
+          continue;
+
+        pool.execute([this, image, &newImage = newImages[j]]{
+          newImage.reset(Image::create(image->pixelFormat(),
             m_angle == 180 ? image->width(): image->height(),
             m_angle == 180 ? image->height(): image->width()));
-        new_image->setMaskColor(image->maskColor());
+          newImage->setMaskColor(image->maskColor());
+          doc::rotate_image(image, newImage.get(), m_angle);
+        });
+      }
+      pool.wait_all();
 
-        doc::rotate_image(image, new_image.get(), m_angle);
-        api.replaceImage(sprite(), cel->imageRef(), new_image);
+      for (int j=0; j<n; ++j) {
+        if (newImages[j])
+          api.replaceImage(sprite(), m_cels[i+j]->imageRef(), newImages[j]);
       }
 
-      jobProgress((float)i / m_cels.size());
-      ++i;
+      jobProgress(double(i+n) / m_cels.size());
 
       // cancel all the operation?
       if (isCanceled())
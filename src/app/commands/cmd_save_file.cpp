@@ -539,6 +539,7 @@ void SaveFileCopyAsCommand::moveToUndoState(Doc* doc,
     doc->undoHistory()->moveToState(state);
     doc->generateMaskBoundaries();
     doc->notifyGeneralUpdate();
+    doc->notifyChanges();
   }
   catch (const std::exception& ex) {
     Console::showException(ex);
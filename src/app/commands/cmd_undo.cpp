@@ -154,6 +154,7 @@ void UndoCommand::onExecute(Context* context)
 
   document->generateMaskBoundaries();
   document->setExtraCel(ExtraCelRef(nullptr));
+  document->notifyChanges();
 
   update_screen_for_document(document);
   set_current_palette(writer.palette(), false);
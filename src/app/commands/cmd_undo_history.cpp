@@ -378,6 +378,7 @@ private:
         set_current_palette(m_doc->sprite()->palette(m_frame), false);
 
         m_doc->notifyGeneralUpdate();
+        m_doc->notifyChanges();
         m_actions.invalidate();
       }
       catch (const std::exception& ex) {
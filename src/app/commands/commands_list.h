@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -47,6 +47,7 @@ FOR_EACH_COMMAND(ExportSpriteSheet)
 FOR_EACH_COMMAND(ExportTileset)
 FOR_EACH_COMMAND(Eyedropper)
 FOR_EACH_COMMAND(Fill)
+FOR_EACH_COMMAND(FilterChain)
 FOR_EACH_COMMAND(FitScreen)
 FOR_EACH_COMMAND(FlattenLayers)
 FOR_EACH_COMMAND(Flip)
@@ -0,0 +1,37 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_COMMANDS_FILTERS_CHAINABLE_FILTER_H_INCLUDED
+#define APP_COMMANDS_FILTERS_CHAINABLE_FILTER_H_INCLUDED
+#pragma once
+
+#include "filters/filter.h"
+#include "filters/target.h"
+
+#include <memory>
+
+namespace app {
+  class Context;
+  class Params;
+
+  // Implemented by the commands of per-pixel filters that can be used
+  // as steps of the FilterChain command.
+  class ChainableFilter {
+  public:
+    virtual ~ChainableFilter() { }
+
+    // Creates the filter configured with the given "params" (the same
+    // params that the command accepts without UI), and returns in
+    // "target" the channels that the filter will modify.
+    virtual std::unique_ptr<filters::Filter> createFilterForChain(
+      Context* ctx,
+      const Params& params,
+      filters::Target& target) = 0;
+  };
+
+} // namespace app
+
+#endif
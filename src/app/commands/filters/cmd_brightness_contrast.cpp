@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2017  David Capello
 //
 // This program is distributed under the terms of
@@ -11,6 +11,7 @@
 
 #include "app/color.h"
 #include "app/commands/command.h"
+#include "app/commands/filters/chainable_filter.h"
 #include "app/commands/filters/filter_manager_impl.h"
 #include "app/commands/filters/filter_window.h"
 #include "app/commands/filters/filter_worker.h"
@@ -42,6 +43,23 @@ struct BrightnessContrastParams : public NewParams {
 
 static const char* ConfigSection = "BrightnessContrast";
 
+// Configures the filter from the params, returns the target channels
+static filters::Target setup_filter(BrightnessContrastFilter& filter,
+                                    const BrightnessContrastParams& params)
+{
+  filters::Target target =
+    TARGET_RED_CHANNEL |
+    TARGET_GREEN_CHANNEL |
+    TARGET_BLUE_CHANNEL |
+    TARGET_GRAY_CHANNEL |
+    TARGET_ALPHA_CHANNEL;
+
+  if (params.channels.isSet()) target = params.channels();
+  if (params.brightness.isSet()) filter.setBrightness(params.brightness() / 100.0);
+  if (params.contrast.isSet()) filter.setContrast(params.contrast() / 100.0);
+  return target;
+}
+
 class BrightnessContrastWindow : public FilterWindow {
 public:
   BrightnessContrastWindow(BrightnessContrastFilter& filter,
@@ -79,10 +97,17 @@ private:
   BrightnessContrastFilter& m_filter;
 };
 
-class BrightnessContrastCommand : public CommandWithNewParams<BrightnessContrastParams> {
+class BrightnessContrastCommand : public CommandWithNewParams<BrightnessContrastParams>,
+                                  public ChainableFilter {
 public:
   BrightnessContrastCommand();
 
+  // ChainableFilter impl
+  std::unique_ptr<filters::Filter> createFilterForChain(
+    Context* context,
+    const Params& params,
+    filters::Target& target) override;
+
 protected:
   bool onEnabled(Context* context) override;
   void onExecute(Context* context) override;
@@ -105,15 +130,7 @@ void BrightnessContrastCommand::onExecute(Context* context)
 
   BrightnessContrastFilter filter;
   FilterManagerImpl filterMgr(context, &filter);
-  filterMgr.setTarget(TARGET_RED_CHANNEL |
-                      TARGET_GREEN_CHANNEL |
-                      TARGET_BLUE_CHANNEL |
-                      TARGET_GRAY_CHANNEL |
-                      TARGET_ALPHA_CHANNEL);
-
-  if (params().channels.isSet()) filterMgr.setTarget(params().channels());
-  if (params().brightness.isSet()) filter.setBrightness(params().brightness() / 100.0);
-  if (params().contrast.isSet()) filter.setContrast(params().contrast() / 100.0);
+  filterMgr.setTarget(setup_filter(filter, params()));
 
   if (ui) {
     BrightnessContrastWindow window(filter, filterMgr);
@@ -124,6 +141,19 @@ void BrightnessContrastCommand::onExecute(Context* context)
   }
 }
 
+std::unique_ptr<filters::Filter>
+BrightnessContrastCommand::createFilterForChain(Context* context,
+                                                const Params& params,
+                                                filters::Target& target)
+{
+  BrightnessContrastParams filterParams;
+  filterParams.loadParams(params);
+
+  auto filter = std::make_unique<BrightnessContrastFilter>();
+  target = setup_filter(*filter, filterParams);
+  return filter;
+}
+
 Command* CommandFactory::createBrightnessContrastCommand()
 {
   return new BrightnessContrastCommand;
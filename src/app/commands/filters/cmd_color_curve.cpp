@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -11,6 +11,7 @@
 
 #include "app/color.h"
 #include "app/commands/command.h"
+#include "app/commands/filters/chainable_filter.h"
 #include "app/commands/filters/color_curve_editor.h"
 #include "app/commands/filters/filter_manager_impl.h"
 #include "app/commands/filters/filter_window.h"
@@ -70,10 +71,29 @@ private:
   ColorCurveEditor m_editor;
 };
 
-class ColorCurveCommand : public CommandWithNewParams<ColorCurveParams> {
+// Returns the target channels from the params
+static filters::Target get_target(const ColorCurveParams& params)
+{
+  if (params.channels.isSet())
+    return params.channels();
+  return
+    TARGET_RED_CHANNEL |
+    TARGET_GREEN_CHANNEL |
+    TARGET_BLUE_CHANNEL |
+    TARGET_GRAY_CHANNEL;
+}
+
+class ColorCurveCommand : public CommandWithNewParams<ColorCurveParams>,
+                          public ChainableFilter {
 public:
   ColorCurveCommand();
 
+  // ChainableFilter impl
+  std::unique_ptr<filters::Filter> createFilterForChain(
+    Context* context,
+    const Params& params,
+    filters::Target& target) override;
+
 protected:
   bool onEnabled(Context* context) override;
   void onExecute(Context* context) override;
@@ -108,13 +128,7 @@ void ColorCurveCommand::onExecute(Context* context)
 
   FilterManagerImpl filterMgr(context, &filter);
 
-  filters::Target channels =
-    TARGET_RED_CHANNEL |
-    TARGET_GREEN_CHANNEL |
-    TARGET_BLUE_CHANNEL |
-    TARGET_GRAY_CHANNEL;
-  if (params().channels.isSet()) channels = params().channels();
-  filterMgr.setTarget(channels);
+  filterMgr.setTarget(get_target(params()));
 
   if (params().curve.isSet()) filter.setCurve(params().curve());
   else if (!ui) {
@@ -134,6 +148,26 @@ void ColorCurveCommand::onExecute(Context* context)
   }
 }
 
+std::unique_ptr<filters::Filter>
+ColorCurveCommand::createFilterForChain(Context* context,
+                                        const Params& params,
+                                        filters::Target& target)
+{
+  ColorCurveParams filterParams;
+  filterParams.loadParams(params);
+
+  auto filter = std::make_unique<ColorCurveFilter>();
+  if (filterParams.curve.isSet())
+    filter->setCurve(filterParams.curve());
+  else {
+    ColorCurve curve;
+    curve.addDefaultPoints();
+    filter->setCurve(curve);
+  }
+  target = get_target(filterParams);
+  return filter;
+}
+
 Command* CommandFactory::createColorCurveCommand()
 {
   return new ColorCurveCommand;
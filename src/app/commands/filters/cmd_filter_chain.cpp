@@ -0,0 +1,82 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/commands/command.h"
+#include "app/commands/commands.h"
+#include "app/commands/filters/chainable_filter.h"
+#include "app/commands/filters/filter_manager_impl.h"
+#include "app/commands/filters/filter_worker.h"
+#include "app/commands/new_params.h"
+#include "app/context.h"
+#include "base/exception.h"
+#include "filters/filter_chain.h"
+
+#include <vector>
+
+namespace app {
+
+struct FilterChainParams : public NewParams {
+  Param<filters::Target> channels { this, 0, "channels" };
+  Param<std::vector<app::Params>> steps { this, std::vector<app::Params>(), "filters" };
+};
+
+// Applies several per-pixel filters (BrightnessContrast,
+// HueSaturation, InvertColor, etc.) in just one pass through the
+// image and one undoable transaction.
+class FilterChainCommand : public CommandWithNewParams<FilterChainParams> {
+public:
+  FilterChainCommand();
+
+protected:
+  bool onEnabled(Context* context) override;
+  void onExecute(Context* context) override;
+};
+
+FilterChainCommand::FilterChainCommand()
+  : CommandWithNewParams<FilterChainParams>(CommandId::FilterChain(), CmdRecordableFlag)
+{
+}
+
+bool FilterChainCommand::onEnabled(Context* context)
+{
+  return context->checkFlags(ContextFlags::ActiveDocumentIsWritable |
+                             ContextFlags::HasActiveSprite);
+}
+
+void FilterChainCommand::onExecute(Context* context)
+{
+  FilterChain chain;
+  for (const app::Params& step : params().steps()) {
+    const std::string id = step.get("id");
+    auto chainable = dynamic_cast<ChainableFilter*>(
+      Commands::instance()->byId(id.c_str()));
+    if (!chainable)
+      throw base::Exception("Command '%s' cannot be used in a filter chain",
+                            id.c_str());
+
+    filters::Target target = 0;
+    auto filter = chainable->createFilterForChain(context, step, target);
+    chain.addFilter(std::move(filter), target);
+  }
+  if (chain.empty())
+    return;
+
+  FilterManagerImpl filterMgr(context, &chain);
+  filterMgr.setTarget(params().channels.isSet() ? params().channels():
+                                                  chain.target());
+  start_filter_worker(&filterMgr);
+}
+
+Command* CommandFactory::createFilterChainCommand()
+{
+  return new FilterChainCommand;
+}
+
+} // namespace app
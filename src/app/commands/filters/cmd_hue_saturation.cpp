@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2017-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -11,6 +11,7 @@
 
 #include "app/color.h"
 #include "app/commands/command.h"
+#include "app/commands/filters/chainable_filter.h"
 #include "app/commands/filters/filter_manager_impl.h"
 #include "app/commands/filters/filter_window.h"
 #include "app/commands/filters/filter_worker.h"
@@ -48,6 +49,26 @@ struct HueSaturationParams : public NewParams {
 
 static const char* ConfigSection = "HueSaturation";
 
+// Configures the filter from the params, returns the target channels
+static filters::Target setup_filter(HueSaturationFilter& filter,
+                                    const HueSaturationParams& params)
+{
+  if (params.mode.isSet()) filter.setMode(params.mode());
+  if (params.hue.isSet()) filter.setHue(params.hue());
+  if (params.saturation.isSet()) filter.setSaturation(params.saturation() / 100.0);
+  if (params.lightness.isSet()) filter.setLightness(params.lightness() / 100.0);
+  if (params.alpha.isSet()) filter.setAlpha(params.alpha() / 100.0);
+
+  filters::Target channels =
+    TARGET_RED_CHANNEL |
+    TARGET_GREEN_CHANNEL |
+    TARGET_BLUE_CHANNEL |
+    TARGET_GRAY_CHANNEL |
+    TARGET_ALPHA_CHANNEL;
+  if (params.channels.isSet()) channels = params.channels();
+  return channels;
+}
+
 class HueSaturationWindow : public FilterWindow {
 public:
   HueSaturationWindow(HueSaturationFilter& filter,
@@ -137,10 +158,17 @@ private:
   ColorSliders m_sliders;
 };
 
-class HueSaturationCommand : public CommandWithNewParams<HueSaturationParams> {
+class HueSaturationCommand : public CommandWithNewParams<HueSaturationParams>,
+                             public ChainableFilter {
 public:
   HueSaturationCommand();
 
+  // ChainableFilter impl
+  std::unique_ptr<filters::Filter> createFilterForChain(
+    Context* ctx,
+    const Params& params,
+    filters::Target& target) override;
+
 protected:
   bool onEnabled(Context* ctx) override;
   void onExecute(Context* ctx) override;
@@ -163,20 +191,7 @@ void HueSaturationCommand::onExecute(Context* ctx)
 
   HueSaturationFilter filter;
   FilterManagerImpl filterMgr(ctx, &filter);
-  if (params().mode.isSet()) filter.setMode(params().mode());
-  if (params().hue.isSet()) filter.setHue(params().hue());
-  if (params().saturation.isSet()) filter.setSaturation(params().saturation() / 100.0);
-  if (params().lightness.isSet()) filter.setLightness(params().lightness() / 100.0);
-  if (params().alpha.isSet()) filter.setAlpha(params().alpha() / 100.0);
-
-  filters::Target channels =
-    TARGET_RED_CHANNEL |
-    TARGET_GREEN_CHANNEL |
-    TARGET_BLUE_CHANNEL |
-    TARGET_GRAY_CHANNEL |
-    TARGET_ALPHA_CHANNEL;
-  if (params().channels.isSet()) channels = params().channels();
-  filterMgr.setTarget(channels);
+  filterMgr.setTarget(setup_filter(filter, params()));
 
   if (ui) {
     HueSaturationWindow window(filter, filterMgr);
@@ -187,6 +202,19 @@ void HueSaturationCommand::onExecute(Context* ctx)
   }
 }
 
+std::unique_ptr<filters::Filter>
+HueSaturationCommand::createFilterForChain(Context* ctx,
+                                           const Params& params,
+                                           filters::Target& target)
+{
+  HueSaturationParams filterParams;
+  filterParams.loadParams(params);
+
+  auto filter = std::make_unique<HueSaturationFilter>();
+  target = setup_filter(*filter, filterParams);
+  return filter;
+}
+
 Command* CommandFactory::createHueSaturationCommand()
 {
   return new HueSaturationCommand;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -11,6 +11,7 @@
 
 #include "app/color.h"
 #include "app/commands/command.h"
+#include "app/commands/filters/chainable_filter.h"
 #include "app/commands/filters/filter_manager_impl.h"
 #include "app/commands/filters/filter_window.h"
 #include "app/commands/filters/filter_worker.h"
@@ -38,6 +39,18 @@ struct InvertColorParams : public NewParams {
 
 static const char* ConfigSection = "InvertColor";
 
+// Returns the target channels from the params
+static filters::Target get_target(const InvertColorParams& params)
+{
+  if (params.channels.isSet())
+    return params.channels();
+  return
+    TARGET_RED_CHANNEL |
+    TARGET_GREEN_CHANNEL |
+    TARGET_BLUE_CHANNEL |
+    TARGET_GRAY_CHANNEL;
+}
+
 class InvertColorWindow : public FilterWindow {
 public:
   InvertColorWindow(FilterManagerImpl& filterMgr)
@@ -47,10 +60,17 @@ public:
   }
 };
 
-class InvertColorCommand : public CommandWithNewParams<InvertColorParams> {
+class InvertColorCommand : public CommandWithNewParams<InvertColorParams>,
+                           public ChainableFilter {
 public:
   InvertColorCommand();
 
+  // ChainableFilter impl
+  std::unique_ptr<filters::Filter> createFilterForChain(
+    Context* context,
+    const Params& params,
+    filters::Target& target) override;
+
 protected:
   bool onEnabled(Context* context) override;
   void onExecute(Context* context) override;
@@ -73,12 +93,7 @@ void InvertColorCommand::onExecute(Context* context)
 
   InvertColorFilter filter;
   FilterManagerImpl filterMgr(context, &filter);
-  filterMgr.setTarget(TARGET_RED_CHANNEL |
-                      TARGET_GREEN_CHANNEL |
-                      TARGET_BLUE_CHANNEL |
-                      TARGET_GRAY_CHANNEL);
-
-  if (params().channels.isSet()) filterMgr.setTarget(params().channels());
+  filterMgr.setTarget(get_target(params()));
 
   if (ui) {
     InvertColorWindow window(filterMgr);
@@ -89,6 +104,18 @@ void InvertColorCommand::onExecute(Context* context)
   }
 }
 
+std::unique_ptr<filters::Filter>
+InvertColorCommand::createFilterForChain(Context* context,
+                                         const Params& params,
+                                         filters::Target& target)
+{
+  InvertColorParams filterParams;
+  filterParams.loadParams(params);
+
+  target = get_target(filterParams);
+  return std::make_unique<InvertColorFilter>();
+}
+
 Command* CommandFactory::createInvertColorCommand()
 {
   return new InvertColorCommand;
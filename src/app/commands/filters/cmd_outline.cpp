@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -48,6 +48,7 @@ struct OutlineParams : public NewParams {
   Param<app::Color> color { this, app::Color(), "color" };
   Param<app::Color> bgColor { this, app::Color(), "bgColor" };
   Param<filters::TiledMode> tiledMode { this, filters::TiledMode::NONE, "tiledMode" };
+  Param<int> thickness { this, 1, "thickness" };
 };
 
 // Wrapper for ReplaceColorFilter to handle colors in an easy way
@@ -92,6 +93,7 @@ public:
     m_panel.color()->setColor(m_filter.color());
     m_panel.bgColor()->setColor(m_filter.bgColor());
     m_panel.place()->setSelectedItem((int)m_filter.place());
+    m_panel.thickness()->setValue(m_filter.thickness());
     updateButtonsFromMatrix();
 
     m_panel.color()->Change.connect(&OutlineWindow::onColorChange, this);
@@ -108,6 +110,10 @@ public:
       [this](ButtonSet::Item*){
         onPlaceChange((OutlineFilter::Place)m_panel.place()->selectedItem());
       });
+    m_panel.thickness()->Change.connect(
+      [this]{
+        onThicknessChange(m_panel.thickness()->getValue());
+      });
   }
 
 private:
@@ -152,6 +158,12 @@ private:
     restartPreview();
   }
 
+  void onThicknessChange(const int thickness) {
+    stopPreview();
+    m_filter.thickness(thickness);
+    restartPreview();
+  }
+
   void onMatrixTypeChange() {
     stopPreview();
 
@@ -224,6 +236,7 @@ void OutlineCommand::onExecute(Context* context)
   if (ui) {
     filter.place((OutlineFilter::Place)get_config_int(ConfigSection, "Place", int(OutlineFilter::Place::Outside)));
     filter.matrix((OutlineFilter::Matrix)get_config_int(ConfigSection, "Matrix", int(OutlineFilter::Matrix::Circle)));
+    filter.thickness(get_config_int(ConfigSection, "Thickness", 1));
     filter.color(ColorBar::instance()->getFgColor());
 
     DocumentPreferences& docPref = Preferences::instance()
@@ -236,6 +249,7 @@ void OutlineCommand::onExecute(Context* context)
   if (params().color.isSet()) filter.color(params().color());
   if (params().bgColor.isSet()) filter.bgColor(params().bgColor());
   if (params().tiledMode.isSet()) filter.tiledMode(params().tiledMode());
+  if (params().thickness.isSet()) filter.thickness(params().thickness());
 
   FilterManagerImpl filterMgr(context, &filter);
   filterMgr.setTarget(
@@ -254,6 +268,7 @@ void OutlineCommand::onExecute(Context* context)
     if (window.doModal()) {
       set_config_int(ConfigSection, "Place", int(filter.place()));
       set_config_int(ConfigSection, "Matrix", int(filter.matrix()));
+      set_config_int(ConfigSection, "Thickness", filter.thickness());
     }
   }
   else {
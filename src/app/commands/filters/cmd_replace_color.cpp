@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -16,6 +16,7 @@
 #include "app/color_utils.h"
 #include "app/commands/command.h"
 #include "app/commands/commands.h"
+#include "app/commands/filters/chainable_filter.h"
 #include "app/commands/filters/filter_manager_impl.h"
 #include "app/commands/filters/filter_window.h"
 #include "app/commands/filters/filter_worker.h"
@@ -74,6 +75,33 @@ private:
 
 static const char* ConfigSection = "ReplaceColor";
 
+// Configures the filter from the params, returns the target channels
+static filters::Target setup_filter(ReplaceColorFilterWrapper& filter,
+                                    const ReplaceColorParams& params,
+                                    const Sprite* sprite,
+                                    const bool ui)
+{
+  filters::Target target =
+    sprite->pixelFormat() == IMAGE_INDEXED ?
+    TARGET_INDEX_CHANNEL:
+    TARGET_RED_CHANNEL |
+    TARGET_GREEN_CHANNEL |
+    TARGET_BLUE_CHANNEL |
+    TARGET_GRAY_CHANNEL |
+    TARGET_ALPHA_CHANNEL;
+
+  filter.setFrom(Preferences::instance().colorBar.fgColor());
+  filter.setTo(Preferences::instance().colorBar.bgColor());
+  if (ui)
+    filter.setTolerance(get_config_int(ConfigSection, "Tolerance", 0));
+
+  if (params.from.isSet()) filter.setFrom(params.from());
+  if (params.to.isSet())  filter.setTo(params.to());
+  if (params.tolerance.isSet()) filter.setTolerance(params.tolerance());
+  if (params.channels.isSet()) target = params.channels();
+  return target;
+}
+
 class ReplaceColorWindow : public FilterWindow {
 public:
   ReplaceColorWindow(ReplaceColorFilterWrapper& filter, FilterManagerImpl& filterMgr)
@@ -144,10 +172,17 @@ private:
   ui::Slider* m_toleranceSlider;
 };
 
-class ReplaceColorCommand : public CommandWithNewParams<ReplaceColorParams> {
+class ReplaceColorCommand : public CommandWithNewParams<ReplaceColorParams>,
+                            public ChainableFilter {
 public:
   ReplaceColorCommand();
 
+  // ChainableFilter impl
+  std::unique_ptr<filters::Filter> createFilterForChain(
+    Context* context,
+    const Params& params,
+    filters::Target& target) override;
+
 protected:
   bool onEnabled(Context* context) override;
   void onExecute(Context* context) override;
@@ -171,24 +206,7 @@ void ReplaceColorCommand::onExecute(Context* context)
 
   ReplaceColorFilterWrapper filter(site.layer());
   FilterManagerImpl filterMgr(context, &filter);
-  filterMgr.setTarget(
-    site.sprite()->pixelFormat() == IMAGE_INDEXED ?
-    TARGET_INDEX_CHANNEL:
-    TARGET_RED_CHANNEL |
-    TARGET_GREEN_CHANNEL |
-    TARGET_BLUE_CHANNEL |
-    TARGET_GRAY_CHANNEL |
-    TARGET_ALPHA_CHANNEL);
-
-  filter.setFrom(Preferences::instance().colorBar.fgColor());
-  filter.setTo(Preferences::instance().colorBar.bgColor());
-  if (ui)
-    filter.setTolerance(get_config_int(ConfigSection, "Tolerance", 0));
-
-  if (params().from.isSet()) filter.setFrom(params().from());
-  if (params().to.isSet())  filter.setTo(params().to());
-  if (params().tolerance.isSet()) filter.setTolerance(params().tolerance());
-  if (params().channels.isSet()) filterMgr.setTarget(params().channels());
+  filterMgr.setTarget(setup_filter(filter, params(), site.sprite(), ui));
 
   if (ui) {
     ReplaceColorWindow window(filter, filterMgr);
@@ -200,6 +218,20 @@ void ReplaceColorCommand::onExecute(Context* context)
   }
 }
 
+std::unique_ptr<filters::Filter>
+ReplaceColorCommand::createFilterForChain(Context* context,
+                                          const Params& params,
+                                          filters::Target& target)
+{
+  ReplaceColorParams filterParams;
+  filterParams.loadParams(params);
+
+  Site site = context->activeSite();
+  auto filter = std::make_unique<ReplaceColorFilterWrapper>(site.layer());
+  target = setup_filter(*filter, filterParams, site.sprite(), false);
+  return filter;
+}
+
 Command* CommandFactory::createReplaceColorCommand()
 {
   return new ReplaceColorCommand;
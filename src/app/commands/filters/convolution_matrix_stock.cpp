@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -125,6 +125,8 @@ void ConvolutionMatrixStock::reloadStock()
         if (*buf != '}')
           break;
 
+        matrix->updateSeparable();
+
         if (div > 0)
           bias = 0;
         else if (div == 0) {
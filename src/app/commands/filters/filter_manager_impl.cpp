@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -20,36 +20,147 @@
 #include "app/doc.h"
 #include "app/ini_file.h"
 #include "app/modules/palettes.h"
+#include "app/profiler.h"
+#include "app/render/shader_filters.h"
 #include "app/site.h"
 #include "app/transaction.h"
 #include "app/ui/color_bar.h"
 #include "app/ui/editor/editor.h"
+#include "app/ui/editor/editor_render.h"
 #include "app/ui/palette_view.h"
 #include "app/ui/timeline/timeline.h"
 #include "app/ui_context.h"
 #include "app/util/cel_ops.h"
 #include "app/util/range_utils.h"
+#include "base/log.h"
+#include "base/thread_pool.h"
 #include "doc/algorithm/shrink_bounds.h"
 #include "doc/cel.h"
 #include "doc/cels_range.h"
 #include "doc/image.h"
 #include "doc/layer.h"
+#include "doc/layer_tilemap.h"
 #include "doc/mask.h"
 #include "doc/sprite.h"
+#include "doc/tileset.h"
 #include "filters/filter.h"
 #include "ui/manager.h"
 #include "ui/view.h"
 #include "ui/widget.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
+#include <future>
+#include <map>
+#include <memory>
 #include <set>
+#include <thread>
 
 namespace app {
 
 using namespace std;
 using namespace ui;
 
+// Minimum number of pixels to apply a filter from several threads,
+// and minimum number of pixels filtered by each task.
+static constexpr int kMinPixelsForThreads = 256*256;
+static constexpr int kMinPixelsPerTask = 64*1024;
+
+// The preview of big areas is filtered in two passes: first one row
+// of each kPreviewStep rows (copying it to the next rows to show a
+// coarse version of the whole area as soon as possible), and then
+// the remaining rows.
+static constexpr int kPreviewStep = 4;
+static constexpr int kMinPixelsForCoarsePreview = 256*256;
+
+class FilterManagerImpl::RowBand : public FilterManager {
+public:
+  RowBand(FilterManagerImpl* mgr)
+    : RowBand(mgr, mgr->m_src.get(), mgr->m_dst.get(),
+              mgr->m_bounds, mgr->m_target) { }
+
+  // Band to filter other cel image (src) in other destination
+  // image (dst).
+  RowBand(FilterManagerImpl* mgr,
+          const doc::Image* src,
+          doc::Image* dst,
+          const gfx::Rect& bounds,
+          const Target target)
+    : m_mgr(mgr)
+    , m_src(src)
+    , m_dst(dst)
+    , m_bounds(bounds)
+    , m_target(target) { }
+
+  // Applies the filter to rows [fromRow, toRow) in the same way as
+  // FilterManagerImpl::applyStep() does.
+  void applyRows(const int fromRow, const int toRow) {
+    const Mask* mask = m_mgr->m_mask;
+    const gfx::Rect& bounds = m_bounds;
+
+    for (m_row=fromRow; m_row<toRow; ++m_row) {
+      if (mask && mask->bitmap()) {
+        int x = bounds.x - mask->bounds().x;
+        int y = bounds.y - mask->bounds().y + m_row;
+        if ((x >= bounds.w) ||
+            (y >= bounds.h))
+          break;
+
+        m_maskBits = mask->bitmap()
+          ->lockBits<BitmapTraits>(Image::ReadLock,
+            gfx::Rect(x, y, bounds.w - x, bounds.h - y));
+
+        m_maskIterator = m_maskBits.begin();
+      }
+
+      switch (m_mgr->m_site.sprite()->pixelFormat()) {
+        case IMAGE_RGB:       m_mgr->m_filter->applyToRgba(this); break;
+        case IMAGE_GRAYSCALE: m_mgr->m_filter->applyToGrayscale(this); break;
+        case IMAGE_INDEXED:   m_mgr->m_filter->applyToIndexed(this); break;
+      }
+    }
+  }
+
+  // FilterManager implementation
+  doc::PixelFormat pixelFormat() const override { return m_mgr->pixelFormat(); }
+  const void* getSourceAddress() override {
+    return m_src->getPixelAddress(x(), y());
+  }
+  void* getDestinationAddress() override {
+    return m_dst->getPixelAddress(x(), y());
+  }
+  int getWidth() override { return m_bounds.w; }
+  Target getTarget() override { return m_target; }
+  FilterIndexedData* getIndexedData() override { return m_mgr; }
+  bool skipPixel() override {
+    bool skip = false;
+    if (m_mgr->m_mask && m_mgr->m_mask->bitmap()) {
+      if (!*m_maskIterator)
+        skip = true;
+      ++m_maskIterator;
+    }
+    return skip;
+  }
+  const doc::Image* getSourceImage() override { return m_src; }
+  int x() const override { return m_bounds.x; }
+  int y() const override { return m_bounds.y+m_row; }
+  bool isFirstRow() const override { return m_row == 0; }
+  bool isMaskActive() const override { return m_mgr->isMaskActive(); }
+  base::task_token& taskToken() const override { return m_mgr->taskToken(); }
+
+private:
+  FilterManagerImpl* m_mgr;
+  const doc::Image* m_src;
+  doc::Image* m_dst;
+  gfx::Rect m_bounds;
+  Target m_target;
+  int m_row = 0;
+  doc::ImageBits<doc::BitmapTraits> m_maskBits;
+  doc::ImageBits<doc::BitmapTraits>::iterator m_maskIterator;
+};
+
 FilterManagerImpl::FilterManagerImpl(Context* context, Filter* filter)
   : m_reader(context)
   , m_site(*const_cast<Site*>(m_reader.site()))
@@ -58,6 +169,11 @@ FilterManagerImpl::FilterManagerImpl(Context* context, Filter* filter)
   , m_src(nullptr)
   , m_dst(nullptr)
   , m_row(0)
+  , m_nextRowToFlush(0)
+  , m_endRowToFlush(0)
+  , m_previewStep(1)
+  , m_coarsePass(false)
+  , m_previewWithShader(false)
   , m_mask(nullptr)
   , m_previewMask(nullptr)
   , m_targetOrig(TARGET_ALL_CHANNELS)
@@ -121,6 +237,9 @@ void FilterManagerImpl::begin()
   Doc* document = m_site.document();
 
   m_row = 0;
+  m_previewStep = 1;
+  m_coarsePass = false;
+  m_previewWithShader = false;
   m_mask = (document->isMaskVisible() ? document->mask(): nullptr);
   m_taskToken = &m_noToken; // Don't use the preview token (which can be canceled)
   updateBounds(m_mask);
@@ -137,7 +256,10 @@ void FilterManagerImpl::beginForPreview()
     m_previewMask->replace(m_site.sprite()->bounds());
   }
 
-  m_row = m_nextRowToFlush = 0;
+  m_row = m_nextRowToFlush = m_endRowToFlush = 0;
+  m_previewStep = 1;
+  m_coarsePass = false;
+  m_previewWithShader = false;
   m_mask = m_previewMask.get();
 
   // If we have a tiled mode enabled, we'll apply the filter to the whole areaes
@@ -162,6 +284,25 @@ void FilterManagerImpl::beginForPreview()
     m_row = -1;
     return;
   }
+
+  // The area to preview is limited to the visible viewport, so when
+  // the editor is zoomed in there are less pixels to filter and the
+  // coarse pass is not needed.
+  if (m_bounds.w*m_bounds.h >= kMinPixelsForCoarsePreview &&
+      m_bounds.h > kPreviewStep) {
+    m_previewStep = kPreviewStep;
+    m_coarsePass = true;
+  }
+
+#if SK_ENABLE_SKSL && ENABLE_DEVMODE
+  // With the shader renderer we try to calculate the whole preview
+  // with a shader (only with rectangular selections, as the shader
+  // doesn't use the mask bitmap).
+  m_previewWithShader =
+    (Editor::renderEngine().type() == EditorRender::kShaderRenderer &&
+     pixelFormat() == IMAGE_RGB &&
+     (!m_mask->bitmap() || m_mask->isRectangular()));
+#endif
 }
 
 void FilterManagerImpl::end()
@@ -171,9 +312,29 @@ void FilterManagerImpl::end()
 
 bool FilterManagerImpl::applyStep()
 {
-  if (m_row < 0 || m_row >= m_bounds.h)
+  if (m_row < 0)
+    return false;
+
+  if (m_previewWithShader) {
+    m_previewWithShader = false;
+    if (applyWithShader())
+      return true;
+  }
+
+  if (m_previewStep > 1)
+    return applyPreviewStep();
+
+  if (m_row >= m_bounds.h || !applyToRow())
     return false;
 
+  addRowsToFlush(m_row, m_row+1);
+  ++m_row;
+  return true;
+}
+
+// Applies the filter to the current row (m_row).
+bool FilterManagerImpl::applyToRow()
+{
   if (m_mask && m_mask->bitmap()) {
     int x = m_bounds.x - m_mask->bounds().x;
     int y = m_bounds.y - m_mask->bounds().y + m_row;
@@ -197,24 +358,132 @@ bool FilterManagerImpl::applyStep()
     case IMAGE_GRAYSCALE: m_filter->applyToGrayscale(this); break;
     case IMAGE_INDEXED:   m_filter->applyToIndexed(this); break;
   }
-  ++m_row;
+  return true;
+}
+
+// Applies the filter to all rows at once with a shader (if the
+// filter has a shader version). Returns false if the filter must be
+// applied row by row.
+bool FilterManagerImpl::applyWithShader()
+{
+#if SK_ENABLE_SKSL && ENABLE_DEVMODE
+  applyToPaletteIfNeeded();
+
+  try {
+    if (!shader_apply_filter(m_filter, m_src.get(), m_dst.get(),
+                             m_bounds, m_target))
+      return false;
+  }
+  catch (const std::exception& ex) {
+    LOG(ERROR, "FILT: Error applying filter with a shader: %s\n", ex.what());
+    return false;
+  }
+
+  addRowsToFlush(0, m_bounds.h);
+  m_row = m_bounds.h;
+  m_previewStep = 1;
+  m_coarsePass = false;
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Applies one step of the two passes of the preview.
+bool FilterManagerImpl::applyPreviewStep()
+{
+  const int step = m_previewStep;
+
+  if (m_coarsePass) {
+    if (m_row < m_bounds.h) {
+      if (!applyToRow())
+        return false;
+
+      const int toRow = std::min(m_row+step, m_bounds.h);
+      for (int row=m_row+1; row<toRow; ++row)
+        copyPreviewRow(m_row, row);
+
+      addRowsToFlush(m_row, toRow);
+      m_row = toRow;
+      return true;
+    }
+
+    // Start the second pass from the first row that wasn't filtered
+    m_coarsePass = false;
+    m_row = 1;
+  }
+
+  // Skip rows already filtered in the coarse pass
+  if (m_row % step == 0)
+    ++m_row;
 
+  if (m_row >= m_bounds.h || !applyToRow())
+    return false;
+
+  addRowsToFlush(m_row, m_row+1);
+  ++m_row;
   return true;
 }
 
+// Copies the pixels of the already filtered "fromRow" to "toRow"
+// (only the pixels inside the mask, as the filter would do).
+void FilterManagerImpl::copyPreviewRow(const int fromRow, const int toRow)
+{
+  const int bpp = m_dst->bytesPerPixel();
+  const uint8_t* src = m_dst->getPixelAddress(m_bounds.x, m_bounds.y+fromRow);
+  uint8_t* dst = m_dst->getPixelAddress(m_bounds.x, m_bounds.y+toRow);
+
+  if (!m_mask || !m_mask->bitmap()) {
+    std::memcpy(dst, src, bpp*m_bounds.w);
+    return;
+  }
+
+  const int x = m_bounds.x - m_mask->bounds().x;
+  const int y = m_bounds.y - m_mask->bounds().y + toRow;
+  if (x >= m_mask->bounds().w ||
+      y >= m_mask->bounds().h)
+    return;
+
+  const auto bits = m_mask->bitmap()
+    ->lockBits<BitmapTraits>(Image::ReadLock,
+      gfx::Rect(x, y, std::min(m_bounds.w, m_mask->bounds().w - x), 1));
+  for (auto it=bits.begin(), end=bits.end(); it!=end; ++it, src+=bpp, dst+=bpp) {
+    if (*it)
+      std::memcpy(dst, src, bpp);
+  }
+}
+
+void FilterManagerImpl::addRowsToFlush(const int fromRow, const int toRow)
+{
+  if (m_nextRowToFlush < m_endRowToFlush) {
+    m_nextRowToFlush = std::min(m_nextRowToFlush, fromRow);
+    m_endRowToFlush = std::max(m_endRowToFlush, toRow);
+  }
+  else {
+    m_nextRowToFlush = fromRow;
+    m_endRowToFlush = toRow;
+  }
+}
+
 void FilterManagerImpl::apply()
 {
   CommandResult result;
   bool cancelled = false;
 
   begin();
-  while (!cancelled && applyStep()) {
-    if (m_progressDelegate) {
-      // Report progress.
-      m_progressDelegate->reportProgress(m_progressBase + m_progressWidth * (m_row+1) / m_bounds.h);
+  const int threads = threadsToApply();
+  if (threads > 1) {
+    cancelled = !applyInThreads(threads);
+  }
+  else {
+    while (!cancelled && applyStep()) {
+      if (m_progressDelegate) {
+        // Report progress.
+        m_progressDelegate->reportProgress(m_progressBase + m_progressWidth * (m_row+1) / m_bounds.h);
 
-      // Does the user cancelled the whole process?
-      cancelled = m_progressDelegate->isCancelled();
+        // Does the user cancelled the whole process?
+        cancelled = m_progressDelegate->isCancelled();
+      }
     }
   }
 
@@ -222,39 +491,7 @@ void FilterManagerImpl::apply()
     gfx::Rect output;
     if (algorithm::shrink_bounds2(m_src.get(), m_dst.get(),
                                   m_bounds, output)) {
-      if (m_cel->layer()->isTilemap()) {
-        modify_tilemap_cel_region(
-          *m_tx,
-          m_cel, nullptr,
-          gfx::Region(output),
-          m_site.tilesetMode(),
-          [this](const doc::ImageRef& origTile,
-                 const gfx::Rect& tileBoundsInCanvas) -> doc::ImageRef {
-            return ImageRef(
-              crop_image(m_dst.get(),
-                         tileBoundsInCanvas.x,
-                         tileBoundsInCanvas.y,
-                         tileBoundsInCanvas.w,
-                         tileBoundsInCanvas.h,
-                         m_dst->maskColor()));
-          });
-      }
-      else if (m_cel->layer()->isBackground()) {
-        (*m_tx)(
-          new cmd::CopyRegion(
-            m_cel->image(),
-            m_dst.get(),
-            gfx::Region(output),
-            position()));
-      }
-      else {
-        // Patch "m_cel"
-        (*m_tx)(
-          new cmd::PatchCel(
-            m_cel, m_dst.get(),
-            gfx::Region(output),
-            position()));
-      }
+      applyChangesToCel(m_cel, m_dst.get(), output);
     }
 
     result = CommandResult(CommandResult::kOk);
@@ -267,8 +504,103 @@ void FilterManagerImpl::apply()
   m_reader.context()->setCommandResult(result);
 }
 
+// Adds the commands to the transaction to copy the "output" region
+// of the filtered image "dst" to the given cel.
+void FilterManagerImpl::applyChangesToCel(doc::Cel* cel,
+                                          doc::Image* dst,
+                                          const gfx::Rect& output)
+{
+  if (cel->layer()->isTilemap()) {
+    modify_tilemap_cel_region(
+      *m_tx,
+      cel, nullptr,
+      gfx::Region(output),
+      m_site.tilesetMode(),
+      [dst](const doc::ImageRef& origTile,
+            const gfx::Rect& tileBoundsInCanvas) -> doc::ImageRef {
+        return ImageRef(
+          crop_image(dst,
+                     tileBoundsInCanvas.x,
+                     tileBoundsInCanvas.y,
+                     tileBoundsInCanvas.w,
+                     tileBoundsInCanvas.h,
+                     dst->maskColor()));
+      });
+  }
+  else if (cel->layer()->isBackground()) {
+    (*m_tx)(
+      new cmd::CopyRegion(
+        cel->image(),
+        dst,
+        gfx::Region(output),
+        position()));
+  }
+  else {
+    // Patch "cel"
+    (*m_tx)(
+      new cmd::PatchCel(
+        cel, dst,
+        gfx::Region(output),
+        position()));
+  }
+}
+
+// Indexed images are filtered in one thread because the RgbMap is
+// not thread-safe (it caches results lazily in mapColor()).
+int FilterManagerImpl::threadsToApply() const
+{
+  if (!m_filter->canApplyToRowsInParallel() ||
+      m_site.sprite()->pixelFormat() == IMAGE_INDEXED ||
+      m_bounds.w*m_bounds.h < kMinPixelsForThreads)
+    return 1;
+
+  return std::clamp<int>(std::thread::hardware_concurrency(), 1,
+                         m_bounds.h / std::max(1, kMinPixelsPerTask / m_bounds.w));
+}
+
+// Applies the filter to bands of rows from several threads, each
+// band with its own RowBand. Returns false if the process was
+// canceled.
+bool FilterManagerImpl::applyInThreads(const int threads)
+{
+  // The palette is modified only from the main thread
+  applyToPaletteIfNeeded();
+
+  const int h = m_bounds.h;
+  const int rowsPerTask = std::max(1, kMinPixelsPerTask / m_bounds.w);
+
+  std::vector<std::unique_ptr<RowBand>> bands(threads);
+  for (auto& band : bands)
+    band = std::make_unique<RowBand>(this);
+
+  base::thread_pool pool(threads);
+  for (int row=0; row<h; ) {
+    for (int i=0; i<threads && row<h; ++i) {
+      const int fromRow = row;
+      const int toRow = std::min(h, row+rowsPerTask);
+      row = toRow;
+
+      RowBand* band = bands[i].get();
+      pool.execute([band, fromRow, toRow]{
+        band->applyRows(fromRow, toRow);
+      });
+    }
+    pool.wait_all();
+    m_row = row;
+
+    if (m_progressDelegate) {
+      m_progressDelegate->reportProgress(m_progressBase + m_progressWidth * m_row / h);
+      if (m_progressDelegate->isCancelled())
+        return false;
+    }
+  }
+  return true;
+}
+
 void FilterManagerImpl::applyToTarget()
 {
+  PROFILE_ZONE("FilterManagerImpl::applyToTarget");
+
   applyToPaletteIfNeeded();
 
   const bool paletteChange = paletteHasChanged();
@@ -307,8 +639,26 @@ void FilterManagerImpl::applyToTarget()
     return;
   }
 
+  // Tilemap cels are filtered tile by tile (each unique tile once)
+  CelList tilemapCels;
+  if (canApplyToTiles()) {
+    CelList otherCels;
+    for (Cel* cel : cels) {
+      if (cel->layer()->isTilemap() &&
+          !static_cast<LayerTilemap*>(cel->layer())->tileset()->grid().hasMask())
+        tilemapCels.push_back(cel);
+      else
+        otherCels.push_back(cel);
+    }
+    std::swap(cels, otherCels);
+  }
+
   m_progressBase = 0.0f;
-  m_progressWidth = (cels.size() > 0 ? 1.0f / cels.size(): 1.0f);
+  m_progressWidth = (cels.size() + tilemapCels.size() > 0 ?
+                     1.0f / (cels.size() + tilemapCels.size()): 1.0f);
+
+  if (!tilemapCels.empty())
+    cancelled = !applyToTiles(tilemapCels);
 
   std::set<ObjectId> visited;
 
@@ -321,30 +671,222 @@ void FilterManagerImpl::applyToTarget()
                           m_site.frame(), &newPalette));
   }
 
-  // For each target image
-  for (auto it = cels.begin();
-       it != cels.end() && !cancelled;
-       ++it) {
-    Image* image = (*it)->image();
-
+  if (canApplyToCelsInParallel(cels)) {
     // Avoid applying the filter two times to the same image
-    if (visited.find(image->id()) == visited.end()) {
-      visited.insert(image->id());
-      applyToCel(*it);
+    CelList uniqueCels;
+    for (Cel* cel : cels) {
+      if (visited.insert(cel->image()->id()).second)
+        uniqueCels.push_back(cel);
     }
+    applyToCelsInParallel(uniqueCels);
+  }
+  else {
+    // For each target image
+    for (auto it = cels.begin();
+         it != cels.end() && !cancelled;
+         ++it) {
+      Image* image = (*it)->image();
+
+      // Avoid applying the filter two times to the same image
+      if (visited.find(image->id()) == visited.end()) {
+        visited.insert(image->id());
+        applyToCel(*it);
+      }
 
-    // Is there a delegate to know if the process was cancelled by the user?
-    if (m_progressDelegate)
-      cancelled = m_progressDelegate->isCancelled();
+      // Is there a delegate to know if the process was cancelled by the user?
+      if (m_progressDelegate)
+        cancelled = m_progressDelegate->isCancelled();
 
-    // Make progress
-    m_progressBase += m_progressWidth;
+      // Make progress
+      m_progressBase += m_progressWidth;
+    }
   }
 
   // Reset m_oldPalette to avoid restoring the color palette
   m_oldPalette.reset(nullptr);
 }
 
+// Filtering the pixels of a tilemap cel in Manual mode modifies the
+// tiles of the tileset, so a per-pixel filter can be applied just
+// once to each tile used by the cels instead of each tile instance
+// (the result is the same). This is not possible with a selection
+// or in the Auto/Stack modes (where modified instances can be
+// converted to new tiles).
+bool FilterManagerImpl::canApplyToTiles() const
+{
+  return (m_filter->isPerPixel() &&
+          m_site.tilesetMode() == TilesetMode::Manual &&
+          !isMaskActive());
+}
+
+// Applies the filter to each unique tile used by the given tilemap
+// cels. Returns false if the process was canceled.
+bool FilterManagerImpl::applyToTiles(const CelList& cels)
+{
+  // Tiles used by the cels of each tileset
+  std::map<Tileset*, std::vector<bool>> usedTiles;
+  for (Cel* cel : cels) {
+    Tileset* tileset = static_cast<LayerTilemap*>(cel->layer())->tileset();
+    std::vector<bool>& used = usedTiles[tileset];
+    used.resize(tileset->size(), false);
+
+    for (const tile_t t : LockImageBits<TilemapTraits>(cel->image())) {
+      if (t == notile)
+        continue;
+      const tile_index ti = tile_geti(t);
+      if (ti < used.size())
+        used[ti] = true;
+    }
+  }
+
+  m_mask = nullptr;
+  m_row = 0;
+  for (auto& [tileset, used] : usedTiles) {
+    tileset->unshareTiles();
+    for (tile_index ti=1; ti<used.size(); ++ti) {
+      if (!used[ti])
+        continue;
+
+      const ImageRef tileImage = tileset->get(ti);
+      if (!tileImage)
+        continue;
+
+      ImageRef dst(Image::createCopy(tileImage.get()));
+      RowBand band(this, tileImage.get(), dst.get(),
+                   tileImage->bounds(), m_targetOrig);
+      band.applyRows(0, tileImage->height());
+
+      // The hash table of the tileset is updated by CopyTileRegion
+      gfx::Rect output;
+      if (algorithm::shrink_bounds2(tileImage.get(), dst.get(),
+                                    tileImage->bounds(), output)) {
+        (*m_tx)(
+          new cmd::CopyTileRegion(
+            tileImage.get(), dst.get(),
+            gfx::Region(output),
+            gfx::Point(0, 0),
+            false, ti, tileset));
+      }
+
+      if (m_progressDelegate && m_progressDelegate->isCancelled())
+        return false;
+    }
+    m_site.document()->notifyTilesetChanged(tileset);
+  }
+
+  m_progressBase += m_progressWidth * cels.size();
+  if (m_progressDelegate)
+    m_progressDelegate->reportProgress(m_progressBase);
+  return true;
+}
+
+// Several cels are filtered at the same time only if the filter
+// can be used from several threads, and the cels aren't indexed
+// (the RgbMap isn't thread-safe) or tilemaps (filtered tiles change
+// the tileset used to render the next cels).
+bool FilterManagerImpl::canApplyToCelsInParallel(const CelList& cels) const
+{
+  if (cels.size() < 2 ||
+      std::thread::hardware_concurrency() < 2 ||
+      !m_filter->canApplyToRowsInParallel() ||
+      m_site.sprite()->pixelFormat() == IMAGE_INDEXED)
+    return false;
+
+  for (const Cel* cel : cels) {
+    if (cel->layer()->isTilemap())
+      return false;
+  }
+  return true;
+}
+
+// Applies the filter to all cels in a pipeline: cel images are
+// cropped, filtered, and compared with the original image (to get
+// the modified region) in a pool of threads, meanwhile this thread
+// adds the commands to the transaction for each finished cel (in
+// the same order as the cels are given).
+void FilterManagerImpl::applyToCelsInParallel(const CelList& cels)
+{
+  struct CelJob {
+    Cel* cel;
+    ImageRef dst;
+    gfx::Rect output;
+    bool modified = false;
+    std::future<void> ready;
+  };
+
+  Doc* doc = m_site.document();
+  m_mask = (doc->isMaskVisible() ? doc->mask(): nullptr);
+  m_taskToken = &m_noToken;
+  if (!updateBounds(m_mask))
+    throw InvalidAreaException();
+
+  const int n = int(cels.size());
+  const int threads = std::clamp<int>(std::thread::hardware_concurrency(), 1, n);
+  // Maximum number of cels in memory at the same time (filtered
+  // images waiting for the transaction)
+  const int maxJobs = 2*threads;
+  std::atomic<bool> cancelled(false);
+  std::vector<std::shared_ptr<CelJob>> jobs(n);
+
+  base::thread_pool pool(threads);
+  auto addJob = [this, &pool, &cels, &jobs, &cancelled](const int i) {
+    auto job = std::make_shared<CelJob>();
+    job->cel = cels[i];
+
+    auto task = std::make_shared<std::packaged_task<void()>>(
+      [this, job, &cancelled]{
+        if (cancelled)
+          return;
+
+        ImageRef src = crop_cel_image(job->cel, 0);
+        job->dst.reset(Image::createCopy(src.get()));
+
+        // The alpha channel of the background layer can't be modified
+        Target target = m_targetOrig;
+        if (job->cel->layer()->isBackground())
+          target &= ~TARGET_ALPHA_CHANNEL;
+
+        RowBand band(this, src.get(), job->dst.get(), m_bounds, target);
+        band.applyRows(0, m_bounds.h);
+
+        job->modified =
+          algorithm::shrink_bounds2(src.get(), job->dst.get(),
+                                    m_bounds, job->output);
+      });
+    job->ready = task->get_future();
+    jobs[i] = job;
+
+    pool.execute([task]{ (*task)(); });
+  };
+
+  try {
+    int nextJob = 0;
+    for (int i=0; i<n; ++i) {
+      for (; nextJob<n && nextJob<i+maxJobs; ++nextJob)
+        addJob(nextJob);
+
+      std::shared_ptr<CelJob> job = std::move(jobs[i]);
+      job->ready.get();             // Can throw the filter exception
+      if (job->modified)
+        applyChangesToCel(job->cel, job->dst.get(), job->output);
+
+      if (m_progressDelegate) {
+        m_progressDelegate->reportProgress(float(i+1) / n);
+        if (m_progressDelegate->isCancelled()) {
+          cancelled = true;
+          break;
+        }
+      }
+    }
+  }
+  catch (...) {
+    cancelled = true;
+    pool.wait_all();
+    throw;
+  }
+  pool.wait_all();
+}
+
 void FilterManagerImpl::initTransaction()
 {
   ASSERT(!m_tx);
@@ -370,7 +912,7 @@ void FilterManagerImpl::commitTransaction()
 
 void FilterManagerImpl::flush()
 {
-  int h = m_row - m_nextRowToFlush;
+  int h = m_endRowToFlush - m_nextRowToFlush;
 
   if (m_row >= 0 && h > 0) {
     // Redraw the color palette
@@ -379,7 +921,7 @@ void FilterManagerImpl::flush()
 
     for (Editor* editor : UIContext::instance()->getAllEditorsIncludingPreview(document())) {
       // We expand the region one pixel at the top and bottom of the
-      // region [m_row,m_nextRowToFlush) to be updated on the screen to
+      // region [m_nextRowToFlush,m_endRowToFlush) to be updated on the screen to
       // avoid screen artifacts when we apply filters like convolution
       // matrices.
       gfx::Rect rect(
@@ -402,7 +944,7 @@ void FilterManagerImpl::flush()
       editor->invalidateRegion(reg1);
     }
 
-    m_nextRowToFlush = m_row+1;
+    m_nextRowToFlush = m_endRowToFlush = 0;
   }
 }
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -15,6 +15,7 @@
 #include "app/tx.h"
 #include "base/exception.h"
 #include "base/task.h"
+#include "doc/cel_list.h"
 #include "doc/image_impl.h"
 #include "doc/image_ref.h"
 #include "doc/pixel_format.h"
@@ -126,9 +127,27 @@ namespace app {
     doc::PalettePicks getPalettePicks() override;
 
   private:
+    // FilterManager used from other threads to apply the filter to a
+    // band of rows.
+    class RowBand;
+
     void init(doc::Cel* cel);
     void apply();
+    bool applyToRow();
+    bool applyWithShader();
+    bool applyPreviewStep();
+    void copyPreviewRow(const int fromRow, const int toRow);
+    void addRowsToFlush(const int fromRow, const int toRow);
+    int threadsToApply() const;
+    bool applyInThreads(const int threads);
     void applyToCel(doc::Cel* cel);
+    void applyChangesToCel(doc::Cel* cel,
+                           doc::Image* dst,
+                           const gfx::Rect& output);
+    bool canApplyToCelsInParallel(const doc::CelList& cels) const;
+    bool canApplyToTiles() const;
+    bool applyToTiles(const doc::CelList& cels);
+    void applyToCelsInParallel(const doc::CelList& cels);
     bool updateBounds(doc::Mask* mask);
 
     // Returns true if the palette was changed (true when the filter
@@ -147,7 +166,11 @@ namespace app {
     doc::ImageRef m_src;
     doc::ImageRef m_dst;
     int m_row;
-    int m_nextRowToFlush;
+    int m_nextRowToFlush;         // Rows [m_nextRowToFlush, m_endRowToFlush) to flush
+    int m_endRowToFlush;
+    int m_previewStep;            // Rows filtered by the coarse preview pass (1 = no coarse pass)
+    bool m_coarsePass;
+    bool m_previewWithShader;     // Try to apply the filter with a shader in the next step
     gfx::Rect m_bounds;
     doc::Mask* m_mask;
     std::unique_ptr<doc::Mask> m_previewMask;
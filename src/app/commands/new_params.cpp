@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -25,9 +25,14 @@
 #include "filters/hue_saturation_filter.h"
 #include "filters/outline_filter.h"
 #include "filters/tiled_mode.h"
+#include "fmt/format.h"
+#include "gfx/point.h"
 #include "gfx/rect.h"
 #include "gfx/size.h"
 
+#include <cctype>
+#include <vector>
+
 #ifdef ENABLE_SCRIPTING
 #include "app/script/engine.h"
 #include "app/script/luacpp.h"
@@ -128,6 +133,8 @@ void Param<app::SpriteSheetDataFormat>::fromString(const std::string& value)
       base::utf8_icmp(value, "json-array") == 0 ||
       base::utf8_icmp(value, "json_array") == 0)
     setValue(app::SpriteSheetDataFormat::JsonArray);
+  else if (base::utf8_icmp(value, "MsgPack") == 0)
+    setValue(app::SpriteSheetDataFormat::MsgPack);
   else
     setValue(app::SpriteSheetDataFormat::JsonHash);
 }
@@ -198,7 +205,10 @@ void Param<filters::OutlineFilter::Matrix>::fromString(const std::string& value)
 template<>
 void Param<filters::HueSaturationFilter::Mode>::fromString(const std::string& value)
 {
-  if (base::utf8_icmp(value, "hsv") == 0 ||
+  // Numeric values (e.g. HueSaturationMode values converted from Lua)
+  if (!value.empty() && std::isdigit(value[0]))
+    setValue((filters::HueSaturationFilter::Mode)base::convert_to<int>(value));
+  else if (base::utf8_icmp(value, "hsv") == 0 ||
       base::utf8_icmp(value, "hsv_mul") == 0)
     setValue(filters::HueSaturationFilter::Mode::HSV_MUL);
   else if (base::utf8_icmp(value, "hsv_add") == 0)
@@ -224,6 +234,32 @@ void Param<filters::ColorCurve>::fromString(const std::string& value)
   setValue(curve);
 }
 
+// Steps of a filter chain separated by ';', each step is a command ID
+// followed by its params, e.g. "InvertColor;HueSaturation hue=30"
+template<>
+void Param<std::vector<app::Params>>::fromString(const std::string& value)
+{
+  std::vector<app::Params> steps;
+  std::vector<std::string> stepStrs, parts;
+  base::split_string(value, stepStrs, ";");
+  for (const auto& stepStr : stepStrs) {
+    base::split_string(stepStr, parts, " ");
+    app::Params step;
+    for (const auto& part : parts) {
+      if (part.empty())
+        continue;
+      const std::size_t i = part.find('=');
+      if (i != std::string::npos)
+        step.set(part.substr(0, i).c_str(), part.substr(i+1).c_str());
+      else if (!step.has_param("id"))
+        step.set("id", part.c_str());
+    }
+    if (step.has_param("id"))
+      steps.push_back(step);
+  }
+  setValue(steps);
+}
+
 template<>
 void Param<tools::InkType>::fromString(const std::string& value)
 {
@@ -237,6 +273,8 @@ void Param<doc::RgbMapAlgorithm>::fromString(const std::string& value)
     setValue(doc::RgbMapAlgorithm::OCTREE);
   else if (base::utf8_icmp(value, "rgb5a3") == 0)
     setValue(doc::RgbMapAlgorithm::RGB5A3);
+  else if (base::utf8_icmp(value, "kdtree") == 0)
+    setValue(doc::RgbMapAlgorithm::KDTREE);
   else
     setValue(doc::RgbMapAlgorithm::DEFAULT);
 }
@@ -390,6 +428,69 @@ void Param<filters::ColorCurve>::fromLua(lua_State* L, int index)
   }
 }
 
+// Array of tables, each table is a step of the filter chain with
+// the command ID in the first element, and its params,
+// e.g. { { "InvertColor" }, { "HueSaturation", hue=30 } }
+template<>
+void Param<std::vector<app::Params>>::fromLua(lua_State* L, int index)
+{
+  std::vector<app::Params> steps;
+  index = lua_absindex(L, index);
+  if (lua_istable(L, index)) {
+    const int n = int(luaL_len(L, index));
+    for (int i=1; i<=n; ++i) {
+      if (lua_geti(L, index, i) != LUA_TTABLE) {
+        lua_pop(L, 1);
+        continue;
+      }
+
+      app::Params step;
+      if (lua_geti(L, -1, 1) == LUA_TSTRING)
+        step.set("id", lua_tostring(L, -1));
+      lua_pop(L, 1);
+
+      // Convert all params to strings, as the command would receive
+      // them from a gui.xml file
+      lua_pushnil(L);
+      while (lua_next(L, -2) != 0) {
+        if (lua_type(L, -2) == LUA_TSTRING) {
+          const char* k = lua_tostring(L, -2);
+          switch (lua_type(L, -1)) {
+            case LUA_TUSERDATA:
+              step.set(k, script::convert_args_into_color(L, -1).toString().c_str());
+              break;
+            case LUA_TTABLE: {
+              // Array of points (e.g. the curve of ColorCurve)
+              std::string points;
+              lua_pushnil(L);
+              while (lua_next(L, -2) != 0) {
+                const gfx::Point pt = script::convert_args_into_point(L, -1);
+                if (!points.empty())
+                  points += ",";
+                points += fmt::format("{},{}", pt.x, pt.y);
+                lua_pop(L, 1);
+              }
+              step.set(k, points.c_str());
+              break;
+            }
+            default:
+              if (const char* v = luaL_tolstring(L, -1, nullptr))
+                step.set(k, v);
+              lua_pop(L, 1);    // Pop the value generated by luaL_tolstring()
+              break;
+          }
+        }
+        lua_pop(L, 1);          // Pop the value, leave the key
+      }
+      lua_pop(L, 1);            // Pop the step table
+
+      if (step.has_param("id"))
+        steps.push_back(step);
+    }
+  }
+  setValue(steps);
+}
+
 template<>
 void Param<tools::InkType>::fromLua(lua_State* L, int index)
 {
@@ -50,6 +50,15 @@ namespace app {
         return nullptr;
     }
 
+    // Resets all values and loads the given string values.
+    void loadParams(const Params& params) {
+      resetValues();
+      for (const auto& pair : params) {
+        if (ParamBase* p = getParam(pair.first))
+          p->fromString(pair.second);
+      }
+    }
+
   private:
     std::map<std::string, ParamBase*> m_params;
   };
@@ -174,7 +174,11 @@ void Context::executeCommand(Command* command, const Params& params)
     command->loadParams(params);
 
     CommandExecutionEvent ev(command, params);
-    BeforeCommandExecution(ev);
+
+    // Inside a batch only the first command is notified before its
+    // execution (see beginCommandBatch())
+    if (m_batchLevel == 0 || !m_batchCommand)
+      BeforeCommandExecution(ev);
 
     if (ev.isCanceled()) {
       LOG(VERBOSE, "CTXT: Command %s was canceled/simulated.\n", command->id().c_str());
@@ -187,11 +191,17 @@ void Context::executeCommand(Command* command, const Params& params)
       LOG(VERBOSE, "CTXT: Command %s is disabled\n", command->id().c_str());
     }
 
-    AfterCommandExecution(ev);
+    if (m_batchLevel > 0) {
+      m_batchCommand = command;
+      m_batchParams = params;
+    }
+    else {
+      AfterCommandExecution(ev);
 
-    // TODO move this code to another place (e.g. a Workplace/Tabs widget)
-    if (isUIAvailable())
-      app_rebuild_documents_tabs();
+      // TODO move this code to another place (e.g. a Workplace/Tabs widget)
+      if (isUIAvailable())
+        app_rebuild_documents_tabs();
+    }
 
 #ifdef _DEBUG // Special checks for debugging purposes
     {
@@ -237,6 +247,27 @@ void Context::executeCommand(Command* command, const Params& params)
 #endif
 }
 
+void Context::beginCommandBatch()
+{
+  ++m_batchLevel;
+}
+
+void Context::endCommandBatch()
+{
+  ASSERT(m_batchLevel > 0);
+  if (--m_batchLevel > 0 || !m_batchCommand)
+    return;
+
+  Command* command = m_batchCommand;
+  m_batchCommand = nullptr;
+
+  CommandExecutionEvent ev(command, m_batchParams);
+  AfterCommandExecution(ev);
+
+  if (isUIAvailable())
+    app_rebuild_documents_tabs();
+}
+
 void Context::setCommandResult(const CommandResult& result)
 {
   m_result = result;
@@ -126,6 +126,16 @@ namespace app {
     void setCommandResult(const CommandResult& result);
     const CommandResult& commandResult() { return m_result; }
 
+    // Merges the notifications of several executeCommand() calls in
+    // just one: BeforeCommandExecution is notified only for the first
+    // command of the batch, and AfterCommandExecution (and the UI
+    // update) only once in endCommandBatch() with the last executed
+    // command. Used by app.batch() to execute a lot of commands from
+    // scripts. Batches can be nested.
+    void beginCommandBatch();
+    void endCommandBatch();
+    bool isInCommandBatch() const { return m_batchLevel > 0; }
+
     virtual DocView* getFirstDocView(Doc* document) const {
       return nullptr;
     }
@@ -163,6 +173,12 @@ namespace app {
     // Result of the execution of a command.
     CommandResult m_result;
 
+    // Command batch (see beginCommandBatch()), the last executed
+    // command in the batch is notified in endCommandBatch().
+    int m_batchLevel = 0;
+    Command* m_batchCommand = nullptr;
+    Params m_batchParams;
+
     DISABLE_COPYING(Context);
   };
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -26,18 +26,36 @@
 #include "app/doc.h"
 #include "app/doc_access.h"
 #include "app/doc_diff.h"
+#include "app/doc_event.h"
+#include "app/doc_undo.h"
 #include "app/pref/preferences.h"
 #include "base/chrono.h"
 #include "base/remove_from_container.h"
 #include "base/thread.h"
+#include "doc/cel.h"
+#include "doc/layer.h"
 #include "ui/app_state.h"
 #include "ui/system.h"
 
+#include <algorithm>
+
 namespace app {
 namespace crash {
 
 namespace {
 
+// Each N backups we check all the objects of each document (in case
+// that some modification wasn't notified through the journal of
+// changes).
+constexpr int kFullBackupEvery = 10;
+
+// Minimum/maximum time without modifications in documents (in
+// milliseconds) to consider that the user is idle and start the
+// backup. Bigger documents (i.e. backups that take more time) need a
+// bigger idle gap.
+constexpr base::tick_t kMinIdleTime = 2000;
+constexpr base::tick_t kMaxIdleTime = 10000;
+
 class SwitchBackupIcon {
 public:
   SwitchBackupIcon() {
@@ -65,6 +83,8 @@ BackupObserver::BackupObserver(RecoveryConfig* config,
   , m_session(session)
   , m_ctx(ctx)
   , m_done(false)
+  , m_lastChangeTick(0)
+  , m_lastBackupTime(0)
   , m_thread([this]{ backgroundThread(); })
 {
   m_ctx->add_observer(this);
@@ -76,6 +96,11 @@ BackupObserver::~BackupObserver()
   m_thread.join();
   m_ctx->documents().remove_observer(this);
   m_ctx->remove_observer(this);
+
+  for (Doc* doc : m_documents) {
+    doc->undoHistory()->remove_observer(this);
+    doc->remove_observer(this);
+  }
 }
 
 void BackupObserver::stop()
@@ -88,13 +113,29 @@ void BackupObserver::onAddDocument(Doc* document)
 {
   RECO_TRACE("RECO: Observe document %p\n", document);
 
-  std::unique_lock<std::mutex> lock(m_mutex);
-  m_documents.push_back(document);
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_documents.push_back(document);
+  }
+  {
+    std::unique_lock<std::mutex> lock(m_changesMutex);
+    m_changes[document] = DocChanges(); // First backup checks everything
+  }
+
+  document->add_observer(this);
+  document->undoHistory()->add_observer(this);
 }
 
 void BackupObserver::onRemoveDocument(Doc* doc)
 {
   RECO_TRACE("RECO: Remove document %p\n", doc);
+
+  doc->undoHistory()->remove_observer(this);
+  doc->remove_observer(this);
+  {
+    std::unique_lock<std::mutex> lock(m_changesMutex);
+    m_changes.erase(doc);
+  }
   {
     std::unique_lock<std::mutex> lock(m_mutex);
     base::remove_from_container(m_documents, doc);
@@ -141,10 +182,15 @@ void BackupObserver::backgroundThread()
 #endif
 
   int waitFor = normalPeriod;
+  int backupCount = 0;
 
   while (!m_done) {
     m_wakeup.wait_for(lock, std::chrono::seconds(waitFor));
 
+    // The backup can be delayed up to one more period (so it's never
+    // more than two periods old) waiting for the user to be idle.
+    waitUserIdle(lock, normalPeriod);
+
     RECO_TRACE("RECO: Start backup process for %d documents\n",
                m_documents.size() + m_closedDocs.size());
 
@@ -152,9 +198,18 @@ void BackupObserver::backgroundThread()
     base::Chrono chrono;
     bool somethingLocked = false;
 
+    const bool fullBackup = ((++backupCount % kFullBackupEvery) == 0);
+
     for (Doc* doc : m_documents) {
-      if (!saveDocData(doc))
+      DocChanges changes = takeChanges(doc);
+      if (fullBackup)
+        changes.markAll();
+
+      if (!saveDocData(doc, &changes)) {
+        // Keep the changes for the next try
+        restoreChanges(doc, changes);
         somethingLocked = true;
+      }
     }
 
     if (!m_closedDocs.empty()) {
@@ -163,7 +218,9 @@ void BackupObserver::backgroundThread()
 
         RECO_TRACE("RECO: Save backup data for %p...\n", doc);
 
-        if (saveDocData(doc)) {
+        // Closed documents are completely checked (we don't receive
+        // notifications from them anymore)
+        if (saveDocData(doc, nullptr)) {
           RECO_TRACE("RECO: Doc %p is fully backed up\n", doc);
 
           it = m_closedDocs.erase(it);
@@ -177,13 +234,152 @@ void BackupObserver::backgroundThread()
     }
 
     waitFor = (somethingLocked ? lockedPeriod: normalPeriod);
+    m_lastBackupTime = base::tick_t(1000.0 * chrono.elapsed());
 
     RECO_TRACE("RECO: Backup process done (%.16g)\n", chrono.elapsed());
   }
 }
 
+// Waits until documents are not modified for a while (so the backup
+// doesn't compete with the user editing the sprite), or until
+// "maxDelay" seconds have passed.
+void BackupObserver::waitUserIdle(std::unique_lock<std::mutex>& lock,
+                                  const int maxDelay)
+{
+  const base::tick_t idleTime =
+    std::clamp<base::tick_t>(2*m_lastBackupTime, kMinIdleTime, kMaxIdleTime);
+  const base::tick_t deadline = base::current_tick() + 1000*base::tick_t(maxDelay);
+
+  while (!m_done) {
+    const base::tick_t now = base::current_tick();
+    const base::tick_t idle = now - m_lastChangeTick;
+    if (idle >= idleTime || now >= deadline)
+      break;
+
+    RECO_TRACE("RECO: Waiting the user to be idle\n");
+    m_wakeup.wait_for(
+      lock, std::chrono::milliseconds(std::min(idleTime - idle, deadline - now)));
+  }
+}
+
+void BackupObserver::onGeneralUpdate(DocEvent& ev) { markAllChanged(ev.document()); }
+void BackupObserver::onColorSpaceChanged(DocEvent& ev) { markAllChanged(ev.document()); }
+void BackupObserver::onPixelFormatChanged(DocEvent& ev) { markAllChanged(ev.document()); }
+void BackupObserver::onAddLayer(DocEvent& ev) { markEventChanges(ev); }
+void BackupObserver::onAddFrame(DocEvent& ev) { markAllChanged(ev.document()); }
+void BackupObserver::onAddCel(DocEvent& ev) { markEventChanges(ev); }
+void BackupObserver::onAfterRemoveLayer(DocEvent& ev) { markAllChanged(ev.document()); }
+void BackupObserver::onRemoveFrame(DocEvent& ev) { markAllChanged(ev.document()); }
+void BackupObserver::onAfterRemoveCel(DocEvent& ev) { markEventChanges(ev); }
+void BackupObserver::onSpriteSizeChanged(DocEvent& ev) { markAllChanged(ev.document()); }
+void BackupObserver::onLayerRestacked(DocEvent& ev) { markEventChanges(ev); }
+void BackupObserver::onLayerMergedDown(DocEvent& ev) { markEventChanges(ev); }
+void BackupObserver::onCelMoved(DocEvent& ev) { markEventChanges(ev); }
+void BackupObserver::onCelCopied(DocEvent& ev) { markEventChanges(ev); }
+void BackupObserver::onCelFrameChanged(DocEvent& ev) { markEventChanges(ev); }
+void BackupObserver::onCelPositionChanged(DocEvent& ev) { markEventChanges(ev); }
+void BackupObserver::onCelOpacityChange(DocEvent& ev) { markEventChanges(ev); }
+void BackupObserver::onCelZIndexChange(DocEvent& ev) { markEventChanges(ev); }
+void BackupObserver::onUserDataChange(DocEvent& ev) { markEventChanges(ev); }
+void BackupObserver::onImagePixelsModified(DocEvent& ev) { markEventChanges(ev); }
+void BackupObserver::onTotalFramesChanged(DocEvent& ev) { markAllChanged(ev.document()); }
+
+void BackupObserver::onRemapTileset(DocEvent& ev, const doc::Remap& remap)
+{
+  // All tilemaps that use the tileset were modified
+  markAllChanged(ev.document());
+}
+
+// Most modifications (e.g. drawing with tools) don't generate
+// DocObserver notifications, so we identify them by the active layer
+// at the moment the transaction was executed/undone/redone. Changes
+// that affect other layers are checked in the next full backup.
+void BackupObserver::onAddUndoState(DocUndo* history)
+{
+  markUndoChanges(history);
+}
+
+void BackupObserver::onCurrentUndoStateChange(DocUndo* history)
+{
+  markUndoChanges(history);
+}
+
+void BackupObserver::markUndoChanges(DocUndo* history)
+{
+  const doc::ObjectId undoLayerId = history->nextUndoSpritePosition().layerId();
+  const doc::ObjectId redoLayerId = history->nextRedoSpritePosition().layerId();
+
+  m_lastChangeTick = base::current_tick();
+
+  std::unique_lock<std::mutex> lock(m_changesMutex);
+  for (auto& it : m_changes) {
+    if (it.first->undoHistory() == history) {
+      it.second.markLayer(undoLayerId);
+      it.second.markLayer(redoLayerId);
+      break;
+    }
+  }
+}
+
+void BackupObserver::markAllChanged(Doc* doc)
+{
+  m_lastChangeTick = base::current_tick();
+
+  std::unique_lock<std::mutex> lock(m_changesMutex);
+  auto it = m_changes.find(doc);
+  if (it != m_changes.end())
+    it->second.markAll();
+}
+
+void BackupObserver::markLayerChanged(Doc* doc, const doc::ObjectId layerId)
+{
+  m_lastChangeTick = base::current_tick();
+
+  std::unique_lock<std::mutex> lock(m_changesMutex);
+  auto it = m_changes.find(doc);
+  if (it != m_changes.end())
+    it->second.markLayer(layerId);
+}
+
+void BackupObserver::markEventChanges(DocEvent& ev)
+{
+  // Events without a specific layer affect the whole document
+  if (!ev.layer() && !ev.targetLayer() && !ev.cel()) {
+    markAllChanged(ev.document());
+    return;
+  }
+
+  if (ev.layer())
+    markLayerChanged(ev.document(), ev.layer()->id());
+  if (ev.targetLayer())
+    markLayerChanged(ev.document(), ev.targetLayer()->id());
+  if (ev.cel() && ev.cel()->layer())
+    markLayerChanged(ev.document(), ev.cel()->layer()->id());
+}
+
+DocChanges BackupObserver::takeChanges(Doc* doc)
+{
+  std::unique_lock<std::mutex> lock(m_changesMutex);
+  DocChanges changes;
+  auto it = m_changes.find(doc);
+  if (it != m_changes.end()) {
+    changes = std::move(it->second);
+    it->second = DocChanges();
+    it->second.all = false;
+  }
+  return changes;
+}
+
+void BackupObserver::restoreChanges(Doc* doc, const DocChanges& changes)
+{
+  std::unique_lock<std::mutex> lock(m_changesMutex);
+  auto it = m_changes.find(doc);
+  if (it != m_changes.end())
+    it->second.merge(changes);
+}
+
 // Executed from the backgroundThread() (non-UI thread)
-bool BackupObserver::saveDocData(Doc* doc)
+bool BackupObserver::saveDocData(Doc* doc, const DocChanges* changes)
 {
   try {
     if (!doc->needsBackup())
@@ -192,7 +388,7 @@ bool BackupObserver::saveDocData(Doc* doc)
     if (doc->inhibitBackup()) {
       RECO_TRACE("RECO: Document '%d' backup is temporarily inhibited\n", doc->id());
     }
-    else if (!m_session->saveDocumentChanges(doc)) {
+    else if (!m_session->saveDocumentChanges(doc, changes)) {
       RECO_TRACE("RECO: Document '%d' backup was canceled by UI\n", doc->id());
     }
     else {
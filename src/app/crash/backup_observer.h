@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -10,11 +10,15 @@
 #pragma once
 
 #include "app/context_observer.h"
+#include "app/crash/write_document.h"
 #include "app/doc_observer.h"
+#include "app/doc_undo_observer.h"
 #include "app/docs_observer.h"
+#include "base/time.h"
 
 #include <atomic>
 #include <condition_variable>
+#include <map>
 #include <mutex>
 #include <thread>
 #include <vector>
@@ -28,7 +32,8 @@ namespace crash {
 
   class BackupObserver : public ContextObserver
                        , public DocsObserver
-                       , public DocObserver {
+                       , public DocObserver
+                       , public DocUndoObserver {
   public:
     BackupObserver(RecoveryConfig* config,
                    Session* session,
@@ -40,9 +45,47 @@ namespace crash {
     void onAddDocument(Doc* document) override;
     void onRemoveDocument(Doc* document) override;
 
+    // DocObserver impl (to record the journal of changes)
+    void onGeneralUpdate(DocEvent& ev) override;
+    void onColorSpaceChanged(DocEvent& ev) override;
+    void onPixelFormatChanged(DocEvent& ev) override;
+    void onAddLayer(DocEvent& ev) override;
+    void onAddFrame(DocEvent& ev) override;
+    void onAddCel(DocEvent& ev) override;
+    void onAfterRemoveLayer(DocEvent& ev) override;
+    void onRemoveFrame(DocEvent& ev) override;
+    void onAfterRemoveCel(DocEvent& ev) override;
+    void onSpriteSizeChanged(DocEvent& ev) override;
+    void onLayerRestacked(DocEvent& ev) override;
+    void onLayerMergedDown(DocEvent& ev) override;
+    void onCelMoved(DocEvent& ev) override;
+    void onCelCopied(DocEvent& ev) override;
+    void onCelFrameChanged(DocEvent& ev) override;
+    void onCelPositionChanged(DocEvent& ev) override;
+    void onCelOpacityChange(DocEvent& ev) override;
+    void onCelZIndexChange(DocEvent& ev) override;
+    void onUserDataChange(DocEvent& ev) override;
+    void onImagePixelsModified(DocEvent& ev) override;
+    void onTotalFramesChanged(DocEvent& ev) override;
+    void onRemapTileset(DocEvent& ev, const doc::Remap& remap) override;
+
+    // DocUndoObserver impl
+    void onAddUndoState(DocUndo* history) override;
+    void onCurrentUndoStateChange(DocUndo* history) override;
+
   private:
     void backgroundThread();
-    bool saveDocData(Doc* doc);
+    void waitUserIdle(std::unique_lock<std::mutex>& lock,
+                      const int maxDelay);
+    bool saveDocData(Doc* doc, const DocChanges* changes);
+
+    // Functions to modify the journal of changes (m_changes)
+    void markAllChanged(Doc* doc);
+    void markLayerChanged(Doc* doc, const doc::ObjectId layerId);
+    void markEventChanges(DocEvent& ev);
+    void markUndoChanges(DocUndo* history);
+    DocChanges takeChanges(Doc* doc);
+    void restoreChanges(Doc* doc, const DocChanges& changes);
 
     RecoveryConfig* m_config;
     Session* m_session;
@@ -53,6 +96,19 @@ namespace crash {
 
     std::mutex m_mutex;
 
+    // Journal of changes of each document since its last backup. It
+    // is modified from the UI thread (with DocObserver notifications)
+    // and consumed from the backgroundThread(), so it has its own
+    // mutex (m_mutex is locked during the whole backup process).
+    std::map<Doc*, DocChanges> m_changes;
+    std::mutex m_changesMutex;
+
+    // Last time a document was modified (to save backups when the
+    // user is idle), and the time that the last backup took (in
+    // milliseconds).
+    std::atomic<base::tick_t> m_lastChangeTick;
+    base::tick_t m_lastBackupTime;
+
     // Used to wakeup the backgroundThread() when we have to stop the
     // thread that saves backups (i.e. when we are closing the application).
     std::condition_variable m_wakeup;
@@ -21,6 +21,7 @@
 #include "base/fstream_path.h"
 #include "base/serialization.h"
 #include "base/string.h"
+#include "base/thread_pool.h"
 #include "doc/cel.h"
 #include "doc/cel_data_io.h"
 #include "doc/cel_io.h"
@@ -46,8 +47,13 @@
 #include "doc/util.h"
 #include "fixmath/fixmath.h"
 
+#include <algorithm>
 #include <fstream>
+#include <future>
 #include <map>
+#include <set>
+#include <thread>
+#include <vector>
 
 namespace app {
 namespace crash {
@@ -113,10 +119,16 @@ public:
 
         m_docVersions = &versions;
       }
+      else if (fn.compare(0, 4, "img-") == 0) {
+        m_imageIds.insert(id);
+      }
     }
   }
 
   Doc* loadDocument() {
+    if (m_taskToken)
+      preloadImages();
+
     Doc* doc = loadObject<Doc*>("doc", m_docId, &Reader::readDocument);
     if (doc)
       fixUndetectedDocumentIssues(doc);
@@ -162,6 +174,83 @@ private:
     return m_celdatas[celdataId] = celData;
   }
 
+  // Decompresses all images in a pool of threads before the sprite
+  // is loaded (images are the biggest objects of the document), so
+  // getImageRef() will find them already loaded. Images that cannot
+  // be preloaded are loaded later with loadObject() as usual.
+  void preloadImages() {
+    const int threads = std::min<int>(std::thread::hardware_concurrency(),
+                                      int(m_imageIds.size()));
+    if (threads < 2)
+      return;
+
+    std::vector<std::pair<ObjectId, std::future<Image*>>> items;
+    items.reserve(m_imageIds.size());
+    {
+      base::thread_pool pool(threads);
+      for (const ObjectId id : m_imageIds) {
+        auto task = std::make_shared<std::packaged_task<Image*()>>(
+          [this, id]() -> Image* {
+            if (canceled())
+              return nullptr;
+            return preloadImage(id);
+          });
+        items.emplace_back(id, task->get_future());
+        pool.execute([task]{ (*task)(); });
+      }
+
+      // Wait the images in order to report the progress
+      for (size_t i=0; i<items.size(); ++i) {
+        items[i].second.wait();
+        if (m_taskToken)
+          m_taskToken->set_progress(0.5f * float(i+1) / float(items.size()));
+      }
+    }
+
+    for (auto& [id, future] : items) {
+      try {
+        if (Image* image = future.get())
+          m_images[id] = ImageRef(image);
+      }
+      catch (const std::exception&) {
+        // Ignore the error, loadObject() will try to load it again
+        // and report the error.
+      }
+    }
+    m_celsProgressStart = 0.5f;
+  }
+
+  // Reads the most recent valid version of the given image. It's
+  // called from a worker thread, so it doesn't modify the Reader.
+  Image* preloadImage(const ObjectId id) const {
+    auto it = m_objVersions.find(id);
+    if (it == m_objVersions.end())
+      return nullptr;
+
+    const ObjVersions& versions = it->second;
+    for (size_t i=0; i<versions.size(); ++i) {
+      ObjectVersion ver = versions[i];
+      if (!ver)
+        continue;
+
+      std::ifstream s(FSTREAM_PATH(objectFilename("img", id, ver)), std::ifstream::binary);
+      if (read32(s) == MAGIC_NUMBER) {
+        if (Image* image = read_image(s, false))
+          return image;
+      }
+    }
+    return nullptr;
+  }
+
+  std::string objectFilename(const char* prefix, ObjectId id, ObjectVersion ver) const {
+    std::string fn = prefix;
+    fn.push_back('-');
+    fn += base::convert_to<std::string>(id);
+    fn.push_back('.');
+    fn += base::convert_to<std::string>(ver);
+    return base::join_path(m_dir, fn);
+  }
+
   template<typename T>
   T loadObject(const char* prefix, ObjectId id, T (Reader::*readMember)(std::ifstream&)) {
     const ObjVersions& versions = m_objVersions[id];
@@ -173,13 +262,7 @@ private:
 
       RECO_TRACE("RECO: Restoring %s #%d v%d\n", prefix, id, ver);
 
-      std::string fn = prefix;
-      fn.push_back('-');
-      fn += base::convert_to<std::string>(id);
-      fn.push_back('.');
-      fn += base::convert_to<std::string>(ver);
-
-      std::ifstream s(FSTREAM_PATH(base::join_path(m_dir, fn)), std::ifstream::binary);
+      std::ifstream s(FSTREAM_PATH(objectFilename(prefix, id, ver)), std::ifstream::binary);
       T obj = nullptr;
       if (read32(s) == MAGIC_NUMBER)
         obj = (this->*readMember)(s);
@@ -342,7 +425,9 @@ private:
       }
 
       if (m_taskToken) {
-        m_taskToken->set_progress(float(i) / float(m_celsToLoad.size()));
+        m_taskToken->set_progress(
+          m_celsProgressStart +
+          (1.0f - m_celsProgressStart) * float(i) / float(m_celsToLoad.size()));
       }
     }
 
@@ -601,6 +686,9 @@ private:
   DocumentInfo* m_loadInfo;
   std::vector<std::pair<ObjectId, ObjectId> > m_celsToLoad;
   std::map<ObjectId, ImageRef> m_images;
+  // IDs of all "img" files (to preload them in parallel)
+  std::set<ObjectId> m_imageIds;
+  float m_celsProgressStart = 0.0f;
   std::map<ObjectId, CelDataRef> m_celdatas;
   // Each ObjectId is a tileset ID that didn't contain the empty tile
   // as the first tile (this was an old format used in internal betas)
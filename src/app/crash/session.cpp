@@ -20,6 +20,7 @@
 #include "app/doc.h"
 #include "app/doc_access.h"
 #include "app/file/file.h"
+#include "app/profiler.h"
 #include "app/ui_context.h"
 #include "base/convert_to.h"
 #include "base/fs.h"
@@ -30,20 +31,40 @@
 #include "base/thread.h"
 #include "base/time.h"
 #include "doc/cancel_io.h"
+#include "doc/sprite.h"
 #include "ui/app_state.h"
 #include "fmt/format.h"
 #include "ver/info.h"
 
+#include <sstream>
+
 namespace app {
 namespace crash {
 
 static const char* kPidFilename = "pid";   // Process ID running the session (or non-existent if the PID was closed correctly)
 static const char* kVerFilename = "ver";   // File that indicates the Aseprite version used in the session
 static const char* kOpenFilename = "open"; // File that indicates if the document is/was open in the session (or non-existent if the document was closed correctly)
+static const char* kIndexFilename = "index"; // File with the information of each document of the session (one document per line)
+
+static std::string document_info_desc(const DocumentInfo& info)
+{
+  return fmt::format("{} Sprite {}x{}, {} {}",
+                     info.mode == ColorMode::RGB ? "RGB":
+                     info.mode == ColorMode::GRAYSCALE ? "Grayscale":
+                     info.mode == ColorMode::INDEXED ? "Indexed":
+                     info.mode == ColorMode::BITMAP ? "Bitmap": "Unknown",
+                     info.width, info.height, info.frames,
+                     info.frames == 1 ? "frame": "frames");
+}
 
-Session::Backup::Backup(const std::string& dir)
+Session::Backup::Backup(const std::string& dir,
+                        const DocumentInfo* info)
   : m_dir(dir)
 {
+  if (info) {
+    m_fn = info->filename;
+    m_desc = document_info_desc(*info);
+  }
 }
 
 std::string Session::Backup::description(const bool withFullPath) const
@@ -53,14 +74,7 @@ std::string Session::Backup::description(const bool withFullPath) const
     DocumentInfo info;
     read_document_info(m_dir, info);
     m_fn = info.filename;
-    m_desc =
-      fmt::format("{} Sprite {}x{}, {} {}",
-                  info.mode == ColorMode::RGB ? "RGB":
-                  info.mode == ColorMode::GRAYSCALE ? "Grayscale":
-                  info.mode == ColorMode::INDEXED ? "Indexed":
-                  info.mode == ColorMode::BITMAP ? "Bitmap": "Unknown",
-                  info.width, info.height, info.frames,
-                  info.frames == 1 ? "frame": "frames");
+    m_desc = document_info_desc(info);
   }
   return fmt::format("{}: {}",
                      m_desc,
@@ -117,12 +131,17 @@ std::string Session::version()
 const Session::Backups& Session::backups()
 {
   if (m_backups.empty()) {
+    loadIndex();
+
     for (const auto& item : base::list_files(m_path, base::ItemType::Directories)) {
       if (ui::is_app_state_closing())
         continue;
 
       std::string docDir = base::join_path(m_path, item);
-      m_backups.push_back(std::make_shared<Backup>(docDir));
+      auto it = m_index.find(item);
+      m_backups.push_back(
+        std::make_shared<Backup>(docDir,
+                                 it != m_index.end() ? &it->second: nullptr));
     }
   }
   return m_backups;
@@ -230,6 +249,9 @@ void Session::removeFromDisk()
     if (base::is_file(verFilename()))
       base::delete_file(verFilename());
 
+    if (base::is_file(indexFilename()))
+      base::delete_file(indexFilename());
+
     base::remove_directory(m_path);
   }
   catch (const std::exception& ex) {
@@ -252,33 +274,53 @@ public:
   }
 };
 
-bool Session::saveDocumentChanges(Doc* doc)
+bool Session::saveDocumentChanges(Doc* doc, const DocChanges* changes)
 {
-  CustomWeakDocReader reader(doc);
-  if (!reader.isLocked())
-    return false;
-
-  app::Context ctx;
-  std::string dir = base::join_path(m_path,
-    base::convert_to<std::string>(doc->id()));
-  RECO_TRACE("RECO: Saving document '%s'...\n", dir.c_str());
+  PROFILE_ZONE("Session::saveDocumentChanges");
 
-  // Create directory for document
-  if (!base::is_directory(dir))
-    base::make_directory(dir);
-
-  // Create "open" file to indicate that the document is open in this session
+  DocSnapshotPtr snapshot;
   {
-    std::string openfile = base::join_path(dir, kOpenFilename);
-    if (!base::is_file(openfile)) {
-      std::ofstream of(FSTREAM_PATH(openfile));
-      if (of)
-        of << "open";
+    CustomWeakDocReader reader(doc);
+    if (!reader.isLocked())
+      return false;
+
+    app::Context ctx;
+    const std::string docDirName = base::convert_to<std::string>(doc->id());
+    std::string dir = base::join_path(m_path, docDirName);
+    RECO_TRACE("RECO: Saving document '%s'...\n", dir.c_str());
+
+    // Create directory for document
+    if (!base::is_directory(dir))
+      base::make_directory(dir);
+
+    // Create "open" file to indicate that the document is open in this session
+    {
+      std::string openfile = base::join_path(dir, kOpenFilename);
+      if (!base::is_file(openfile)) {
+        std::ofstream of(FSTREAM_PATH(openfile));
+        if (of)
+          of << "open";
+      }
     }
+
+    // Copy the modified objects of the document
+    snapshot = take_document_snapshot(dir, doc, &reader, changes);
+    if (!snapshot)
+      return false;
+
+    DocumentInfo info;
+    info.mode = doc->sprite()->colorMode();
+    info.width = doc->sprite()->width();
+    info.height = doc->sprite()->height();
+    info.frames = doc->sprite()->totalFrames();
+    info.filename = doc->filename();
+    updateIndex(docDirName, info);
   }
 
-  // Save document information
-  return write_document(dir, doc, &reader);
+  // Save document information (compress images and write files)
+  // without locking the document, so the UI thread can modify it
+  // in the meantime.
+  return write_document_snapshot(snapshot);
 }
 
 void Session::removeDocument(Doc* doc)
@@ -389,6 +431,65 @@ std::string Session::verFilename() const
   return base::join_path(m_path, kVerFilename);
 }
 
+std::string Session::indexFilename() const
+{
+  return base::join_path(m_path, kIndexFilename);
+}
+
+// Each line of the index file is "<dir> <mode> <width> <height>
+// <frames> <filename>". Invalid lines are ignored, the information
+// of those documents is read from the document files.
+void Session::loadIndex()
+{
+  std::string fn = indexFilename();
+  if (!m_index.empty() || !base::is_file(fn))
+    return;
+
+  std::ifstream f(FSTREAM_PATH(fn));
+  std::string line;
+  while (std::getline(f, line)) {
+    std::istringstream s(line);
+    std::string dir;
+    int mode;
+    DocumentInfo info;
+    if (!(s >> dir >> mode >> info.width >> info.height >> info.frames) ||
+        mode < int(ColorMode::RGB) || mode > int(ColorMode::TILEMAP) ||
+        info.width <= 0 || info.height <= 0 || info.frames <= 0)
+      continue;
+
+    s.get();                    // Skip the space before the filename
+    std::getline(s, info.filename);
+    info.mode = ColorMode(mode);
+    m_index[dir] = info;
+  }
+}
+
+void Session::updateIndex(const std::string& docDirName,
+                          const DocumentInfo& info)
+{
+  auto it = m_index.find(docDirName);
+  if (it != m_index.end() &&
+      it->second.mode == info.mode &&
+      it->second.width == info.width &&
+      it->second.height == info.height &&
+      it->second.frames == info.frames &&
+      it->second.filename == info.filename) {
+    return;                     // Nothing to update
+  }
+
+  m_index[docDirName] = info;
+
+  std::ofstream f(FSTREAM_PATH(indexFilename()));
+  for (const auto& [dir, i] : m_index) {
+    f << dir << ' '
+      << int(i.mode) << ' '
+      << i.width << ' '
+      << i.height << ' '
+      << i.frames << ' '
+      << i.filename << '\n';
+  }
+}
+
 void Session::markDocumentAsCorrectlyClosed(app::Doc* doc)
 {
   std::string dir = base::join_path(
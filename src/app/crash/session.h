@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -10,12 +10,14 @@
 #pragma once
 
 #include "app/crash/raw_images_as.h"
+#include "app/crash/read_document.h"
 #include "base/disable_copying.h"
 #include "base/process.h"
 #include "base/task.h"
 #include "doc/object_id.h"
 
 #include <fstream>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -23,6 +25,7 @@
 namespace app {
 class Doc;
 namespace crash {
+  struct DocChanges;
   struct RecoveryConfig;
 
   // A class to record/restore session information.
@@ -30,7 +33,11 @@ namespace crash {
   public:
     class Backup {
     public:
-      Backup(const std::string& dir);
+      // The "info" (if it's not nullptr) is the document information
+      // from the session index, so we don't need to read the
+      // document files to get its description.
+      Backup(const std::string& dir,
+             const DocumentInfo* info = nullptr);
       const std::string& dir() const { return m_dir; }
       std::string description(const bool withFullPath) const;
     private:
@@ -58,7 +65,7 @@ namespace crash {
     void close();
     void removeFromDisk();
 
-    bool saveDocumentChanges(Doc* doc);
+    bool saveDocumentChanges(Doc* doc, const DocChanges* changes = nullptr);
     void removeDocument(Doc* doc);
 
     Doc* restoreBackupDoc(const BackupPtr& backup,
@@ -75,6 +82,9 @@ namespace crash {
     void loadPid();
     std::string pidFilename() const;
     std::string verFilename() const;
+    std::string indexFilename() const;
+    void loadIndex();
+    void updateIndex(const std::string& docDirName, const DocumentInfo& info);
     void markDocumentAsCorrectlyClosed(Doc* doc);
     void deleteDirectory(const std::string& dir);
     void fixFilename(Doc* doc);
@@ -84,6 +94,9 @@ namespace crash {
     std::string m_path;
     std::string m_version;
     Backups m_backups;
+    // Information of each document (key=document directory name) to
+    // list backups without reading each document.
+    std::map<std::string, DocumentInfo> m_index;
     RecoveryConfig* m_config;
 
     DISABLE_COPYING(Session);
@@ -26,6 +26,7 @@
 #include "doc/cels_range.h"
 #include "doc/frame.h"
 #include "doc/image_io.h"
+#include "doc/image_ref.h"
 #include "doc/layer.h"
 #include "doc/layer_tilemap.h"
 #include "doc/palette.h"
@@ -43,8 +44,10 @@
 #include "doc/user_data_io.h"
 #include "fixmath/fixmath.h"
 
+#include <deque>
 #include <fstream>
 #include <map>
+#include <sstream>
 
 namespace app {
 namespace crash {
@@ -58,14 +61,31 @@ namespace {
 static std::map<ObjectId, ObjVersionsMap> g_docVersions;
 static std::map<ObjectId, base::paths> g_deleteFiles;
 
+// An object that must be written in the backup. It's created while
+// the document is locked, and written to disk later (without the
+// document lock).
+struct PendingObject {
+  std::string prefix;
+  ObjectId id = NullId;
+  ObjectVersion version = 0;
+  std::string data;             // Serialized object
+  ImageRef image;               // Copy of the image to be compressed
+};
+
 class Writer {
 public:
-  Writer(const std::string& dir, Doc* doc, doc::CancelIO* cancel)
+  Writer(const std::string& dir, Doc* doc, doc::CancelIO* cancel,
+         const DocChanges* changes)
     : m_dir(dir)
     , m_doc(doc)
     , m_objVersions(g_docVersions[doc->id()])
     , m_deleteFiles(g_deleteFiles[doc->id()])
-    , m_cancel(cancel) {
+    , m_cancel(cancel)
+    , m_changes(changes) {
+    // If this document wasn't saved before we have to check all the
+    // objects anyway.
+    if (m_objVersions.empty())
+      m_changes = nullptr;
   }
 
   bool saveDocument() {
@@ -102,6 +122,9 @@ public:
 
     // Save original cel data (skip links)
     for (Layer* lay : layers) {
+      if (!isLayerModified(lay))
+        continue;
+
       CelList cels;
       lay->getCels(cels);
 
@@ -109,7 +132,7 @@ public:
         if (cel->link())        // Skip link
           continue;
 
-        if (!saveObject("img", cel->image(), &Writer::writeImage))
+        if (!saveImage(cel->image()))
           return false;
 
         if (!saveObject("celdata", cel->data(), &Writer::writeCelData))
@@ -119,6 +142,9 @@ public:
 
     // Save all cels (original and links)
     for (Layer* lay : layers) {
+      if (!isLayerModified(lay))
+        continue;
+
       CelList cels;
       lay->getCels(cels);
 
@@ -138,6 +164,24 @@ public:
     if (!saveObject("doc", m_doc, &Writer::writeDocumentFile))
       return false;
 
+    return true;
+  }
+
+  // Writes all the objects collected in saveDocument() to disk. This
+  // doesn't access the document, so it can be called without the
+  // document lock.
+  bool writePendingObjects() {
+    // We don't use the CancelIO anymore, it was used to cancel the
+    // snapshot creation when the UI needs the document.
+    m_cancel = nullptr;
+
+    while (!m_pending.empty()) {
+      const PendingObject& obj = m_pending.front();
+      if (!writeObjectFile(obj))
+        return false;
+      m_pending.pop_front();
+    }
+
     // Delete old files after all files are correctly saved.
     deleteOldVersions();
     return true;
@@ -149,14 +193,30 @@ private:
     return (m_cancel && m_cancel->isCanceled());
   }
 
-  bool writeDocumentFile(std::ofstream& s, Doc* doc) {
+  // Returns true if we have to check the cels of the given layer
+  // (i.e. it's in the journal of changes or the layer itself was
+  // modified). Other layers keep their cels/images from the previous
+  // backup.
+  bool isLayerModified(const Layer* lay) const {
+    if (!m_changes || m_changes->all)
+      return true;
+
+    if (m_changes->layers.find(lay->id()) != m_changes->layers.end())
+      return true;
+
+    auto it = m_objVersions.find(lay->id());
+    return (it == m_objVersions.end() ||
+            it->second.newer() != lay->version());
+  }
+
+  bool writeDocumentFile(std::ostream& s, Doc* doc) {
     write32(s, doc->sprite()->id());
     write_string(s, doc->filename());
     write16(s, uint16_t(doc::SerialFormat::LastVer));
     return true;
   }
 
-  bool writeSprite(std::ofstream& s, Sprite* spr) {
+  bool writeSprite(std::ostream& s, Sprite* spr) {
     // Header
     write8(s, int(spr->colorMode()));
     write16(s, spr->width());
@@ -210,7 +270,7 @@ private:
     return true;
   }
 
-  bool writeGridBounds(std::ofstream& s, const gfx::Rect& grid) {
+  bool writeGridBounds(std::ostream& s, const gfx::Rect& grid) {
     write16(s, (int16_t)grid.x);
     write16(s, (int16_t)grid.y);
     write16(s, grid.w);
@@ -218,7 +278,7 @@ private:
     return true;
   }
 
-  bool writeColorSpace(std::ofstream& s, const gfx::ColorSpaceRef& colorSpace) {
+  bool writeColorSpace(std::ostream& s, const gfx::ColorSpaceRef& colorSpace) {
     write16(s, colorSpace->type());
     write16(s, colorSpace->flags());
     write32(s, fixmath::ftofix(colorSpace->gamma()));
@@ -232,7 +292,7 @@ private:
     return true;
   }
 
-  void writeAllLayersID(std::ofstream& s, ObjectId parentId, const LayerGroup* group) {
+  void writeAllLayersID(std::ostream& s, ObjectId parentId, const LayerGroup* group) {
     for (const Layer* lay : group->layers()) {
       write32(s, lay->id());
       write32(s, parentId);
@@ -242,7 +302,7 @@ private:
     }
   }
 
-  bool writeLayerStructure(std::ofstream& s, Layer* lay) {
+  bool writeLayerStructure(std::ostream& s, Layer* lay) {
     write32(s, static_cast<int>(lay->flags())); // Flags
     write16(s, static_cast<int>(lay->type()));  // Type
     write_string(s, lay->name());
@@ -282,64 +342,105 @@ private:
     return true;
   }
 
-  bool writeCel(std::ofstream& s, Cel* cel) {
+  bool writeCel(std::ostream& s, Cel* cel) {
     write_cel(s, cel);
     return true;
   }
 
-  bool writeCelData(std::ofstream& s, CelData* celdata) {
+  bool writeCelData(std::ostream& s, CelData* celdata) {
     write_celdata(s, celdata);
     return true;
   }
 
-  bool writeImage(std::ofstream& s, Image* img) {
-    return write_image(s, img, m_cancel);
-  }
-
-  bool writePalette(std::ofstream& s, Palette* pal) {
+  bool writePalette(std::ostream& s, Palette* pal) {
     write_palette(s, pal);
     return true;
   }
 
-  bool writeTileset(std::ofstream& s, Tileset* tileset) {
+  bool writeTileset(std::ostream& s, Tileset* tileset) {
     write_tileset(s, tileset);
     return true;
   }
 
-  bool writeFrameTag(std::ofstream& s, Tag* frameTag) {
+  bool writeFrameTag(std::ostream& s, Tag* frameTag) {
     write_tag(s, frameTag);
     return true;
   }
 
-  bool writeSlice(std::ofstream& s, Slice* slice) {
+  bool writeSlice(std::ostream& s, Slice* slice) {
     write_slice(s, slice);
     return true;
   }
 
   template<typename T>
-  bool saveObject(const char* prefix, T* obj, bool (Writer::*writeMember)(std::ofstream&, T*)) {
+  bool saveObject(const char* prefix, T* obj, bool (Writer::*writeMember)(std::ostream&, T*)) {
+    if (isCanceled())
+      return false;
+
+    if (!isObjectModified(obj))
+      return true;
+
+    // Small objects are serialized now (while the document is locked)
+    std::ostringstream s;
+    if (!(this->*writeMember)(s, obj)) // Write the object
+      return false;
+
+    PendingObject pending;
+    pending.prefix = prefix;
+    pending.id = obj->id();
+    pending.version = obj->version();
+    pending.data = s.str();
+    m_pending.push_back(std::move(pending));
+    return true;
+  }
+
+  // Images are copied as-is (which is a lot faster than compressing
+  // them), and compressed later in writePendingObjects().
+  bool saveImage(Image* img) {
     if (isCanceled())
       return false;
 
+    if (!isObjectModified(img))
+      return true;
+
+    PendingObject pending;
+    pending.prefix = "img";
+    pending.id = img->id();
+    pending.version = img->version();
+    pending.image.reset(Image::createCopy(img));
+    m_pending.push_back(std::move(pending));
+    return true;
+  }
+
+  template<typename T>
+  bool isObjectModified(T* obj) {
     if (!obj->version())
       obj->incrementVersion();
 
-    ObjVersions& versions = m_objVersions[obj->id()];
-    if (versions.newer() == obj->version())
-      return true;
+    const ObjVersions& versions = m_objVersions[obj->id()];
+    return (versions.newer() != obj->version());
+  }
 
-    std::string fn = prefix;
+  bool writeObjectFile(const PendingObject& obj) {
+    ObjVersions& versions = m_objVersions[obj.id];
+
+    std::string fn = obj.prefix;
     fn.push_back('-');
-    fn += base::convert_to<std::string>(obj->id());
+    fn += base::convert_to<std::string>(obj.id);
 
     std::string fullfn = base::join_path(m_dir, fn);
     std::string oldfn = fullfn + "." + base::convert_to<std::string>(versions.older());
-    fullfn += "." + base::convert_to<std::string>(obj->version());
+    fullfn += "." + base::convert_to<std::string>(obj.version);
 
     std::ofstream s(FSTREAM_PATH(fullfn), std::ofstream::binary);
     write32(s, 0);                // Leave a room for the magic number
-    if (!(this->*writeMember)(s, obj)) // Write the object
-      return false;
+    if (obj.image) {
+      if (!write_image(s, obj.image.get(), obj.id, m_cancel))
+        return false;
+    }
+    else {
+      s.write(obj.data.c_str(), obj.data.size());
+    }
 
     // Flush all data. In this way we ensure that the magic number is
     // the last thing being written in the file.
@@ -354,9 +455,9 @@ private:
       m_deleteFiles.push_back(oldfn);
 
     // Rotate versions and add the latest one
-    versions.rotateRevisions(obj->version());
+    versions.rotateRevisions(obj.version);
 
-    RECO_TRACE(" - Saved %s #%d v%d\n", prefix, obj->id(), obj->version());
+    RECO_TRACE(" - Saved %s #%d v%d\n", obj.prefix.c_str(), obj.id, obj.version);
     return true;
   }
 
@@ -380,6 +481,8 @@ private:
   ObjVersionsMap& m_objVersions;
   base::paths& m_deleteFiles;
   doc::CancelIO* m_cancel;
+  const DocChanges* m_changes;
+  std::deque<PendingObject> m_pending;
 };
 
 } // anonymous namespace
@@ -387,12 +490,44 @@ private:
 //////////////////////////////////////////////////////////////////////
 // Public API
 
+class DocSnapshot {
+public:
+  DocSnapshot(const std::string& dir, Doc* doc, doc::CancelIO* cancel,
+              const DocChanges* changes)
+    : m_writer(dir, doc, cancel, changes) {
+  }
+
+  bool take() { return m_writer.saveDocument(); }
+  bool write() { return m_writer.writePendingObjects(); }
+
+private:
+  Writer m_writer;
+};
+
+DocSnapshotPtr take_document_snapshot(const std::string& dir,
+                                      Doc* doc,
+                                      doc::CancelIO* cancel,
+                                      const DocChanges* changes)
+{
+  auto snapshot = std::make_shared<DocSnapshot>(dir, doc, cancel, changes);
+  if (!snapshot->take())
+    return nullptr;
+  return snapshot;
+}
+
+bool write_document_snapshot(const DocSnapshotPtr& snapshot)
+{
+  ASSERT(snapshot);
+  return snapshot->write();
+}
+
 bool write_document(const std::string& dir,
                     Doc* doc,
-                    doc::CancelIO* cancel)
+                    doc::CancelIO* cancel,
+                    const DocChanges* changes)
 {
-  Writer writer(dir, doc, cancel);
-  return writer.saveDocument();
+  DocSnapshotPtr snapshot = take_document_snapshot(dir, doc, cancel, changes);
+  return (snapshot && write_document_snapshot(snapshot));
 }
 
 void delete_document_internals(Doc* doc)
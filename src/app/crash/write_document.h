@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -8,6 +9,10 @@
 #define APP_CRASH_WRITE_DOCUMENT_H_INCLUDED
 #pragma once
 
+#include "doc/object_id.h"
+
+#include <memory>
+#include <set>
 #include <string>
 
 namespace doc {
@@ -19,7 +24,55 @@ namespace app {
 
   namespace crash {
 
-    bool write_document(const std::string& dir, Doc* doc, doc::CancelIO* cancel);
+    // Journal of the document changes between two backups (collected
+    // from DocObserver/DocUndoObserver notifications). It's used to
+    // avoid walking all the cels of the sprite when only a couple of
+    // layers were modified.
+    struct DocChanges {
+      // True if we have to check all the objects of the document
+      // (e.g. on the first backup or when we don't know exactly what
+      // was modified).
+      bool all = true;
+
+      // Layers with modified cels/images (only used if all=false).
+      std::set<doc::ObjectId> layers;
+
+      void markAll() {
+        all = true;
+        layers.clear();
+      }
+
+      void markLayer(const doc::ObjectId layerId) {
+        if (!all && layerId != doc::NullId)
+          layers.insert(layerId);
+      }
+
+      void merge(const DocChanges& other) {
+        if (other.all)
+          markAll();
+        else if (!all)
+          layers.insert(other.layers.begin(), other.layers.end());
+      }
+    };
+
+    // Copy of the modified objects of a document that must be written
+    // in the backup. It's taken while the document is locked
+    // (take_document_snapshot()), and then it can be written to disk
+    // without the document lock (write_document_snapshot()), so the
+    // UI thread doesn't have to wait the compression of images.
+    class DocSnapshot;
+    using DocSnapshotPtr = std::shared_ptr<DocSnapshot>;
+
+    // Returns nullptr if the snapshot was canceled. If "changes" is
+    // nullptr all the objects are checked.
+    DocSnapshotPtr take_document_snapshot(const std::string& dir, Doc* doc,
+                                          doc::CancelIO* cancel,
+                                          const DocChanges* changes = nullptr);
+    bool write_document_snapshot(const DocSnapshotPtr& snapshot);
+
+    // Takes a snapshot and writes it (all with the document locked).
+    bool write_document(const std::string& dir, Doc* doc, doc::CancelIO* cancel,
+                        const DocChanges* changes = nullptr);
     void delete_document_internals(Doc* doc);
 
   } // namespace crash
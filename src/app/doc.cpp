@@ -60,6 +60,7 @@ Doc::Doc(Sprite* sprite)
   , m_lastDrawingPoint(Doc::NoLastDrawingPoint())
 {
   setFilename("Sprite");
+  m_undo->setDocChanges(&m_changes);
 
   if (sprite)
     sprites().add(sprite);
@@ -212,6 +213,23 @@ void Doc::notifyGeneralUpdate()
   notify_observers<DocEvent&>(&DocObserver::onGeneralUpdate, ev);
 }
 
+void Doc::notifyChanges()
+{
+  if (m_changes.empty())
+    return;
+
+  m_changes.resolveImages(sprite());
+
+  // Observers could modify the document again (e.g. scripts), so we
+  // start collecting new changes before notifying these ones.
+  DocChanges changes;
+  std::swap(changes, m_changes);
+
+  DocEvent ev(this);
+  ev.sprite(sprite());
+  notify_observers<DocEvent&, const DocChanges&>(&DocObserver::onDocChanges, ev, changes);
+}
+
 void Doc::notifyColorSpaceChanged()
 {
   updateOSColorSpace(true);
@@ -418,12 +436,12 @@ void Doc::destroyMaskBoundaries()
 
 void Doc::generateMaskBoundaries(const Mask* mask)
 {
-  m_maskBoundaries.reset();
-
   // No mask specified? Use the current one in the document
   if (!mask) {
-    if (!isMaskVisible())       // The mask is hidden
+    if (!isMaskVisible()) {     // The mask is hidden
+      m_maskBoundaries.reset();
       return;                   // Done, without boundaries
+    }
     else
       mask = this->mask();      // Use the document mask
   }
@@ -431,10 +449,13 @@ void Doc::generateMaskBoundaries(const Mask* mask)
   ASSERT(mask);
 
   if (!mask->isEmpty()) {
-    m_maskBoundaries.regen(mask->bitmap());
-    m_maskBoundaries.offset(mask->bounds().x,
-                            mask->bounds().y);
+    // Only the modified area of the previous boundaries is
+    // regenerated.
+    m_maskBoundaries.regen(mask->bitmap(),
+                           mask->bounds().origin());
   }
+  else
+    m_maskBoundaries.reset();
 
   notifySelectionBoundariesChanged();
 }
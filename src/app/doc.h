@@ -9,6 +9,7 @@
 #define APP_DOC_H_INCLUDED
 #pragma once
 
+#include "app/doc_changes.h"
 #include "app/doc_observer.h"
 #include "app/extra_cel.h"
 #include "app/file/format_options.h"
@@ -100,6 +101,10 @@ namespace app {
     const DocUndo* undoHistory() const { return m_undo.get(); }
     DocUndo* undoHistory() { return m_undo.get(); }
 
+    // Changes collected from the executed commands that weren't
+    // notified yet with notifyChanges().
+    DocChanges& changes() { return m_changes; }
+
     bool isUndoing() const;
 
     color_t bgColor() const;
@@ -119,6 +124,7 @@ namespace app {
     // Notifications
 
     void notifyGeneralUpdate();
+    void notifyChanges();
     void notifyColorSpaceChanged();
     void notifyPaletteChanged();
     void notifySpritePixelsModified(Sprite* sprite, const gfx::Region& region, frame_t frame);
@@ -267,6 +273,9 @@ namespace app {
     // Undo and redo information about the document.
     std::unique_ptr<DocUndo> m_undo;
 
+    // Modified regions since the last notifyChanges().
+    DocChanges m_changes;
+
     // Current transaction for this document (when this is commit(), a
     // new undo command is added to m_undo).
     Transaction* m_transaction;
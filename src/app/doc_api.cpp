@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2021  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -25,6 +25,7 @@
 #include "app/cmd/remove_frame.h"
 #include "app/cmd/remove_layer.h"
 #include "app/cmd/remove_tag.h"
+#include "app/cmd/reorder_frames.h"
 #include "app/cmd/replace_image.h"
 #include "app/cmd/set_cel_bounds.h"
 #include "app/cmd/set_cel_frame.h"
@@ -48,6 +49,7 @@
 #include "app/snap_to_grid.h"
 #include "app/transaction.h"
 #include "app/util/autocrop.h"
+#include "base/thread_pool.h"
 #include "doc/algorithm/flip_image.h"
 #include "doc/algorithm/shrink_bounds.h"
 #include "doc/cel.h"
@@ -60,7 +62,9 @@
 
 #include <algorithm>
 #include <iterator>
+#include <numeric>
 #include <set>
+#include <thread>
 #include <vector>
 
 #include "gfx/rect_io.h"
@@ -181,68 +185,50 @@ void DocApi::cropSprite(Sprite* sprite,
   }
 }
 
-void DocApi::cropImageLayer(LayerImage* layer,
-                            const gfx::Rect& bounds,
-                            const bool trimOutside)
-{
-  std::set<ObjectId> visited;
-  CelList cels, clearCels;
-  layer->getCels(cels);
-  for (Cel* cel : cels) {
-    if (visited.find(cel->data()->id()) != visited.end())
-      continue;
-    visited.insert(cel->data()->id());
+namespace {
 
-    if (!cropCel(layer, cel, bounds, trimOutside)) {
-      // Delete this cel and its links
-      clearCels.push_back(cel);
-    }
-  }
-
-  for (Cel* cel : clearCels)
-    clearCelAndAllLinks(cel);
-}
+// New image and position of a cel after cropping the canvas.
+struct CelCrop {
+  bool remove = false;   // The cel (and its links) must be deleted
+  ImageRef newImage;     // Nullptr if the cel image doesn't change
+  gfx::Point newPos;     // New cel position (if it's not a background)
+};
 
-// Returns false if the cel (and its links) must be deleted after this
-bool DocApi::cropCel(LayerImage* layer,
-                     Cel* cel,
-                     const gfx::Rect& bounds,
-                     const bool trimOutside)
+// Calculates how a cel must be cropped. It doesn't modify the cel so
+// it can be called for several cels in parallel.
+CelCrop calc_cel_crop(const LayerImage* layer,
+                      const Cel* cel,
+                      const gfx::Rect& bounds,
+                      const bool trimOutside,
+                      const color_t bgColor)
 {
+  CelCrop crop;
+
   if (layer->isBackground()) {
-    Image* image = cel->image();
+    const Image* image = cel->image();
     if (image && !cel->link()) {
       ASSERT(cel->x() == 0);
       ASSERT(cel->y() == 0);
 
-      ImageRef newImage(
+      crop.newImage.reset(
         crop_image(image,
                    bounds.x, bounds.y,
                    bounds.w, bounds.h,
-                   m_document->bgColor(layer)));
-
-      replaceImage(cel->sprite(),
-                   cel->imageRef(),
-                   newImage);
+                   bgColor));
     }
-    return true;
+    return crop;
   }
 
-  if (layer->isReference()) {
-    // Update the ref cel's bounds
-    gfx::RectF newBounds = cel->boundsF();
-    newBounds.x -= bounds.x;
-    newBounds.y -= bounds.y;
-    m_transaction.execute(new cmd::SetCelBoundsF(cel, newBounds));
-    return true;
-  }
+  // Reference cels are moved with its floating point bounds
+  if (layer->isReference())
+    return crop;
 
-  gfx::Point newCelPos(cel->position() - bounds.origin());
+  crop.newPos = cel->position() - bounds.origin();
 
   // This is the complex case: we want to crop a transparent cel and
   // remove the content that is outside the sprite canvas. This might
   // generate one or two of the following Cmd:
-  // 1. Clear the cel ("return false" will generate a "cmd::ClearCel"
+  // 1. Clear the cel ("remove" will generate a "cmd::ClearCel"
   //    then) if the cel bounds will be totally outside in the new
   //    canvas size
   // 2. Replace the cel image if the cel must be cut in
@@ -251,81 +237,153 @@ bool DocApi::cropCel(LayerImage* layer,
   //    if the cel image will be completely inside the new
   //    canvas
   if (trimOutside) {
-    Image* image = cel->image();
-    if (image && !cel->link()) {
-      gfx::Rect newCelBounds = (bounds & cel->bounds());
+    const Image* image = cel->image();
 
-      if (newCelBounds.isEmpty())
-        return false;
+    // The cel will be completely inside the new canvas, it's just
+    // a translation (no need to touch its pixels).
+    if (!image || cel->link() || bounds.contains(cel->bounds()))
+      return crop;
 
-      newCelBounds.offset(-bounds.origin());
+    gfx::Rect newCelBounds = (bounds & cel->bounds());
+    if (newCelBounds.isEmpty()) {
+      crop.remove = true;
+      return crop;
+    }
 
-      gfx::Point paintPos(newCelBounds.x - newCelPos.x,
-                          newCelBounds.y - newCelPos.y);
+    newCelBounds.offset(-bounds.origin());
 
-      const color_t bg = image->pixelFormat() == IMAGE_TILEMAP ?
-                           notile :
-                           m_document->bgColor(layer);
-      newCelPos = newCelBounds.origin();
+    gfx::Point paintPos(newCelBounds.x - crop.newPos.x,
+                        newCelBounds.y - crop.newPos.y);
 
-      doc::Grid grid;
-      if (layer->isTilemap()) {
-        const Tileset* tileset = static_cast<LayerTilemap*>(layer)->tileset();
-        grid = tileset->grid();
-        grid.origin(cel->position());
+    const color_t bg = image->pixelFormat() == IMAGE_TILEMAP ?
+                         notile : bgColor;
+    crop.newPos = newCelBounds.origin();
 
-        newCelBounds.setOrigin(bounds.origin() + newCelPos);
-        newCelBounds = grid.canvasToTile(newCelBounds);
-        paintPos = newCelBounds.origin();
-        newCelPos = grid.tileToCanvas(paintPos) - bounds.origin();
-      }
+    doc::Grid grid;
+    if (layer->isTilemap()) {
+      const Tileset* tileset = static_cast<const LayerTilemap*>(layer)->tileset();
+      grid = tileset->grid();
+      grid.origin(cel->position());
 
-      // crop the image
-      ImageRef newImage(
-        crop_image(image,
-                   paintPos.x, paintPos.y,
-                   newCelBounds.w, newCelBounds.h,
-                   bg));
-
-      // Try to shrink the image ignoring transparent borders
-      gfx::Rect frameBounds;
-      if (doc::algorithm::shrink_bounds(newImage.get(),
-                                        newImage->maskColor(),
-                                        layer, frameBounds)) {
-        // In this case the new cel image can be even smaller
-        if (frameBounds != newImage->bounds()) {
-          newImage = ImageRef(
-            crop_image(newImage.get(),
-                       frameBounds.x, frameBounds.y,
-                       frameBounds.w, frameBounds.h,
-                       bg));
-          if (layer->isTilemap())
-            newCelPos += grid.tileToCanvas(frameBounds.origin()) - grid.origin();
-          else
-            newCelPos += frameBounds.origin();
-        }
-      }
-      else {
-        // Delete this cel and its links
-        return false;
-      }
+      newCelBounds.setOrigin(bounds.origin() + crop.newPos);
+      newCelBounds = grid.canvasToTile(newCelBounds);
+      paintPos = newCelBounds.origin();
+      crop.newPos = grid.tileToCanvas(paintPos) - bounds.origin();
+    }
 
-      // If it's the same image, we can re-use the cel image and just
-      // move the cel position.
-      if (!is_same_image(cel->image(), newImage.get())) {
-        replaceImage(cel->sprite(),
-                     cel->imageRef(),
-                     newImage);
+    // crop the image
+    ImageRef newImage(
+      crop_image(image,
+                 paintPos.x, paintPos.y,
+                 newCelBounds.w, newCelBounds.h,
+                 bg));
+
+    // Try to shrink the image ignoring transparent borders
+    gfx::Rect frameBounds;
+    if (doc::algorithm::shrink_bounds(newImage.get(),
+                                      newImage->maskColor(),
+                                      layer,
+                                      frameBounds)) {
+      // In this case the new cel image can be even smaller
+      if (frameBounds != newImage->bounds()) {
+        newImage = ImageRef(
+          crop_image(newImage.get(),
+                     frameBounds.x, frameBounds.y,
+                     frameBounds.w, frameBounds.h,
+                     bg));
+        if (layer->isTilemap())
+          crop.newPos += grid.tileToCanvas(frameBounds.origin()) - grid.origin();
+        else
+          crop.newPos += frameBounds.origin();
       }
     }
+    else {
+      // Delete this cel and its links
+      crop.remove = true;
+      return crop;
+    }
+
+    // If it's the same image, we can re-use the cel image and just
+    // move the cel position.
+    if (!is_same_image(image, newImage.get()))
+      crop.newImage = newImage;
   }
+  return crop;
+}
 
-  // Update the cel's position
-  setCelPosition(
-    cel->sprite(), cel,
-    newCelPos.x,
-    newCelPos.y);
-  return true;
+} // anonymous namespace
+
+void DocApi::cropImageLayer(LayerImage* layer,
+                            const gfx::Rect& bounds,
+                            const bool trimOutside)
+{
+  std::set<ObjectId> visited;
+  CelList cels, uniqueCels, clearCels;
+  layer->getCels(cels);
+  for (Cel* cel : cels) {
+    if (visited.find(cel->data()->id()) != visited.end())
+      continue;
+    visited.insert(cel->data()->id());
+    uniqueCels.push_back(cel);
+  }
+
+  // Crop the cel images in parallel when we have to copy pixels
+  // (background layers or cels partially outside the new canvas),
+  // then apply the changes in this thread.
+  const color_t bgColor = m_document->bgColor(layer);
+  std::vector<CelCrop> crops(uniqueCels.size());
+  const int nthreads =
+    ((layer->isBackground() || trimOutside) && !layer->isReference() ?
+     std::clamp<int>(std::thread::hardware_concurrency(), 1,
+                     std::max<int>(1, uniqueCels.size())): 1);
+  if (nthreads > 1) {
+    base::thread_pool pool(nthreads);
+    for (size_t i=0; i<uniqueCels.size(); ++i) {
+      pool.execute([layer, cel = uniqueCels[i], &crop = crops[i],
+                    bounds, trimOutside, bgColor]{
+        crop = calc_cel_crop(layer, cel, bounds, trimOutside, bgColor);
+      });
+    }
+    pool.wait_all();
+  }
+  else {
+    for (size_t i=0; i<uniqueCels.size(); ++i)
+      crops[i] = calc_cel_crop(layer, uniqueCels[i], bounds, trimOutside, bgColor);
+  }
+
+  for (size_t i=0; i<uniqueCels.size(); ++i) {
+    Cel* cel = uniqueCels[i];
+    const CelCrop& crop = crops[i];
+
+    if (crop.remove) {
+      clearCels.push_back(cel);
+      continue;
+    }
+
+    if (crop.newImage)
+      replaceImage(cel->sprite(), cel->imageRef(), crop.newImage);
+
+    if (layer->isBackground())
+      continue;
+
+    if (layer->isReference()) {
+      // Update the ref cel's bounds
+      gfx::RectF newBounds = cel->boundsF();
+      newBounds.x -= bounds.x;
+      newBounds.y -= bounds.y;
+      m_transaction.execute(new cmd::SetCelBoundsF(cel, newBounds));
+      continue;
+    }
+
+    // Update the cel's position
+    setCelPosition(cel->sprite(), cel,
+                   crop.newPos.x,
+                   crop.newPos.y);
+  }
+
+  // Delete these cels and their links
+  for (Cel* cel : clearCels)
+    clearCelAndAllLinks(cel);
 }
 
 void DocApi::trimSprite(Sprite* sprite, const bool byGrid)
@@ -461,6 +519,51 @@ void DocApi::moveFrame(Sprite* sprite,
   }
 }
 
+void DocApi::moveFrames(Sprite* sprite,
+                        const std::vector<std::pair<frame_t, frame_t>>& moves,
+                        const DropFramePlace dropFramePlace,
+                        const TagsHandling tagsHandling)
+{
+  // order[i] is the original frame that will be in the i-th position
+  std::vector<frame_t> order(sprite->totalFrames());
+  std::iota(order.begin(), order.end(), 0);
+  bool reordered = false;
+
+  for (auto [frame, targetFrame] : moves) {
+    const frame_t beforeFrame =
+      (dropFramePlace == kDropBeforeFrame ? targetFrame: targetFrame+1);
+
+    if (frame       >= 0 && frame       <= sprite->lastFrame()   &&
+        beforeFrame >= 0 && beforeFrame <= sprite->lastFrame()+1 &&
+        ((frame != beforeFrame) ||
+         (!sprite->tags().empty() &&
+          tagsHandling != kDontAdjustTags))) {
+      if (tagsHandling != kDontAdjustTags) {
+        adjustTags(sprite, frame, -1, dropFramePlace, tagsHandling);
+        if (targetFrame >= frame)
+          --targetFrame;
+        adjustTags(sprite, targetFrame, +1, dropFramePlace, tagsHandling);
+      }
+
+      if (frame != beforeFrame) {
+        const frame_t original = order[frame];
+        order.erase(order.begin()+frame);
+        order.insert(order.begin()+(frame < beforeFrame ? beforeFrame-1:
+                                                          beforeFrame),
+                     original);
+        reordered = true;
+      }
+    }
+  }
+
+  if (reordered) {
+    std::vector<frame_t> newFrames(order.size());
+    for (frame_t i=0; i<frame_t(order.size()); ++i)
+      newFrames[order[i]] = i;
+    m_transaction.execute(new cmd::ReorderFrames(sprite, newFrames));
+  }
+}
+
 void DocApi::moveFrameLayer(Layer* layer, frame_t frame, frame_t beforeFrame)
 {
   ASSERT(layer);
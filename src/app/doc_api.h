@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -18,6 +18,8 @@
 #include "gfx/rect.h"
 
 #include <map>
+#include <utility>
+#include <vector>
 
 namespace doc {
   class Cel;
@@ -71,6 +73,13 @@ namespace app {
                    frame_t targetFrame,
                    const DropFramePlace dropFramePlace,
                    const TagsHandling tagsHandling);
+    // Same as calling moveFrame() for each (frame, targetFrame) pair,
+    // but frame durations and cels are moved at the end with just one
+    // cmd::ReorderFrames.
+    void moveFrames(Sprite* sprite,
+                    const std::vector<std::pair<frame_t, frame_t>>& moves,
+                    const DropFramePlace dropFramePlace,
+                    const TagsHandling tagsHandling);
 
     // Cels API
     void addCel(LayerImage* layer, Cel* cel);
@@ -118,10 +127,6 @@ namespace app {
     void cropImageLayer(LayerImage* layer,
                         const gfx::Rect& bounds,
                         const bool trimOutside);
-    bool cropCel(LayerImage* layer,
-                 Cel* cel,
-                 const gfx::Rect& bounds,
-                 const bool trimOutside);
     void setCelFramePosition(Cel* cel, frame_t frame);
     void moveFrameLayer(Layer* layer, frame_t frame, frame_t beforeFrame);
     void adjustTags(Sprite* sprite,
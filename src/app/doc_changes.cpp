@@ -0,0 +1,110 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/doc_changes.h"
+
+#include "doc/cel.h"
+#include "doc/grid.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/sprite.h"
+
+#include <set>
+
+namespace app {
+
+gfx::Region DocChanges::frameRegion(const doc::frame_t frame) const
+{
+  gfx::Region rgn;
+  for (const auto& it : m_regions) {
+    if (it.first.frame == frame)
+      rgn |= it.second;
+  }
+  return rgn;
+}
+
+void DocChanges::addCelBounds(const doc::Layer* layer,
+                              const doc::frame_t frame,
+                              const gfx::Rect& bounds)
+{
+  if (!layer) {
+    addAll();
+    return;
+  }
+  if (!bounds.isEmpty())
+    m_regions[Key(layer->id(), frame)] |= gfx::Region(bounds);
+}
+
+void DocChanges::addCel(const doc::Cel* cel)
+{
+  if (!cel || !cel->layer()) {
+    addAll();
+    return;
+  }
+  addCelBounds(cel->layer(), cel->frame(), cel->bounds());
+}
+
+void DocChanges::addImageRegion(const doc::Image* image,
+                                const gfx::Region& region)
+{
+  if (!image) {
+    addAll();
+    return;
+  }
+  m_images[image->id()] |= region;
+}
+
+void DocChanges::resolveImages(const doc::Sprite* sprite)
+{
+  if (m_images.empty())
+    return;
+
+  if (!m_all && sprite) {
+    // Linked cels share the same image, so all of them are modified
+    std::set<doc::ObjectId> found;
+    for (const doc::Cel* cel : sprite->cels()) {
+      const doc::Image* image = cel->image();
+      if (!image)
+        continue;
+
+      auto it = m_images.find(image->id());
+      if (it == m_images.end())
+        continue;
+
+      found.insert(it->first);
+
+      gfx::Region rgn(it->second);
+      if (image->pixelFormat() == doc::IMAGE_TILEMAP) {
+        // Tilemap regions are in tiles
+        doc::Grid grid = cel->grid();
+        rgn = grid.tileToCanvas(rgn);
+      }
+      else
+        rgn.offset(cel->position());
+      m_regions[Key(cel->layer()->id(), cel->frame())] |= rgn;
+    }
+
+    if (found.size() != m_images.size())
+      addAll();
+  }
+  else {
+    addAll();
+  }
+  m_images.clear();
+}
+
+void DocChanges::clear()
+{
+  m_all = false;
+  m_regions.clear();
+  m_images.clear();
+}
+
+} // namespace app
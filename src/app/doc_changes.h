@@ -0,0 +1,92 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_DOC_CHANGES_H_INCLUDED
+#define APP_DOC_CHANGES_H_INCLUDED
+#pragma once
+
+#include "doc/frame.h"
+#include "doc/object_id.h"
+#include "gfx/rect.h"
+#include "gfx/region.h"
+
+#include <map>
+
+namespace doc {
+  class Cel;
+  class Image;
+  class Layer;
+  class Sprite;
+}
+
+namespace app {
+
+  // Regions of a document modified by a transaction (or by
+  // undo/redo), collected from each executed command (see
+  // Cmd::collectChanges()) and notified to observers with
+  // DocObserver::onDocChanges(), so each one can update only the
+  // modified areas.
+  class DocChanges {
+  public:
+    // Layer/frame of the modified cels
+    struct Key {
+      doc::ObjectId layerId;
+      doc::frame_t frame;
+
+      Key(doc::ObjectId layerId, doc::frame_t frame)
+        : layerId(layerId), frame(frame) { }
+
+      bool operator<(const Key& other) const {
+        return (layerId < other.layerId ||
+                (layerId == other.layerId && frame < other.frame));
+      }
+    };
+
+    // Modified region (in sprite coordinates) of each layer/frame.
+    using Regions = std::map<Key, gfx::Region>;
+
+    bool empty() const {
+      return (!m_all && m_regions.empty() && m_images.empty());
+    }
+
+    // True if anything in the document could be changed (a command
+    // that doesn't report its exact changes was executed).
+    bool all() const { return m_all; }
+
+    const Regions& regions() const { return m_regions; }
+
+    // Returns the union of the modified regions of all layers in the
+    // given frame (it's not useful if all() is true).
+    gfx::Region frameRegion(const doc::frame_t frame) const;
+
+    void addAll() { m_all = true; }
+    void addCelBounds(const doc::Layer* layer,
+                      const doc::frame_t frame,
+                      const gfx::Rect& bounds);
+    void addCel(const doc::Cel* cel);
+
+    // Adds a modified region of an image (in image coordinates). The
+    // image is mapped to the cels that are using it in
+    // resolveImages().
+    void addImageRegion(const doc::Image* image,
+                        const gfx::Region& region);
+
+    // Converts the modified image regions to cels regions. If an
+    // image is not used by any cel (e.g. a tileset tile), we mark
+    // the whole document as modified.
+    void resolveImages(const doc::Sprite* sprite);
+
+    void clear();
+
+  private:
+    bool m_all = false;
+    Regions m_regions;
+    std::map<doc::ObjectId, gfx::Region> m_images;
+  };
+
+} // namespace app
+
+#endif
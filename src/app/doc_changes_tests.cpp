@@ -0,0 +1,74 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/cmd/flip_image.h"
+#include "app/cmd/set_mask_position.h"
+#include "app/context.h"
+#include "app/doc.h"
+#include "app/doc_changes.h"
+#include "app/doc_observer.h"
+#include "app/doc_undo.h"
+#include "app/test_context.h"
+#include "app/tx.h"
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+
+using namespace app;
+using namespace doc;
+
+class DocChangesObserver : public DocObserver {
+public:
+  void onDocChanges(DocEvent& ev, const DocChanges& changes) override {
+    this->changes = changes;
+    ++count;
+  }
+  DocChanges changes;
+  int count = 0;
+};
+
+TEST(DocChanges, FlipImageRegion)
+{
+  TestContextT<Context> ctx;
+  Doc* doc = ctx.documents().add(32, 16);
+  Sprite* sprite = doc->sprite();
+  LayerImage* layer = static_cast<LayerImage*>(sprite->root()->firstLayer());
+  Cel* cel = layer->cel(0);
+  cel->setPosition(4, 2);
+
+  DocChangesObserver obs;
+  doc->add_observer(&obs);
+
+  {
+    Tx tx(sprite, "");
+    tx(new cmd::FlipImage(cel->image(), gfx::Rect(1, 1, 3, 3),
+                          doc::algorithm::FlipHorizontal));
+    tx.commit();
+  }
+  EXPECT_EQ(1, obs.count);
+  EXPECT_FALSE(obs.changes.all());
+  EXPECT_EQ(gfx::Region(gfx::Rect(5, 3, 3, 3)), obs.changes.frameRegion(0));
+  EXPECT_TRUE(obs.changes.frameRegion(1).isEmpty());
+
+  // Undo reports the same region
+  doc->undoHistory()->undo();
+  doc->notifyChanges();
+  EXPECT_EQ(2, obs.count);
+  EXPECT_EQ(gfx::Region(gfx::Rect(5, 3, 3, 3)), obs.changes.frameRegion(0));
+
+  // Selection changes don't modify pixels
+  {
+    Tx tx(sprite, "");
+    tx(new cmd::SetMaskPosition(doc, gfx::Point(1, 1)));
+    tx.commit();
+  }
+  EXPECT_EQ(2, obs.count);
+
+  doc->remove_observer(&obs);
+  doc->close();
+}
@@ -24,6 +24,8 @@
 #include "doc/tilesets.h"
 #include "doc/user_data.h"
 
+#include <set>
+
 #ifdef _DEBUG
 namespace doc {
 
@@ -45,10 +47,75 @@ namespace app {
   #define TRACEDIFF(a, b)
 #endif
 
+uint64_t DocDiffHashCache::imageHash(const doc::Image* image)
+{
+  {
+    const std::lock_guard lock(m_mutex);
+    auto it = m_hashes.find(image->id());
+    if (it != m_hashes.end() &&
+        it->second.first == image->version()) {
+      return it->second.second;
+    }
+  }
+
+  // Calculate the hash outside the lock
+  const uint64_t hash = calculate_image_hash64(image);
+
+  const std::lock_guard lock(m_mutex);
+  m_hashes[image->id()] = std::make_pair(image->version(), hash);
+  return hash;
+}
+
+namespace {
+
+// Compares the pixels of two images only if it's needed, i.e. if
+// the hashes (when available) are equal and the same pair of images
+// wasn't compared before (e.g. linked cels, or tiles shared between
+// tilesets).
+class ImagesComparer {
+public:
+  ImagesComparer(const DocDiffOptions& options)
+    : m_options(options) { }
+
+  bool isSameImage(const Image* a, const Image* b) {
+    if (a == b)
+      return true;
+
+    if (a->pixelFormat() != b->pixelFormat() ||
+        a->bounds() != b->bounds())
+      return false;
+
+    const auto key = std::make_pair(a->id(), b->id());
+    if (m_sameImages.find(key) != m_sameImages.end())
+      return true;
+
+    if (m_options.hashCache) {
+      if (m_options.hashCache->imageHash(a) !=
+          m_options.hashCache->imageHash(b))
+        return false;
+    }
+
+    if ((m_options.hashCache && m_options.trustHashes) ||
+        is_same_image(a, b)) {
+      m_sameImages.insert(key);
+      return true;
+    }
+    return false;
+  }
+
+private:
+  const DocDiffOptions& m_options;
+  std::set<std::pair<ObjectId, ObjectId>> m_sameImages;
+};
+
+} // anonymous namespace
+
 DocDiff compare_docs(const Doc* a,
-                     const Doc* b)
+                     const Doc* b,
+                     const DocDiffOptions& options)
 {
   DocDiff diff;
+  ImagesComparer images(options);
 
   // Don't compare filenames
   //if (a->filename() != b->filename())...
@@ -163,8 +230,8 @@ DocDiff compare_docs(const Doc* a,
       }
       else {
         for (tile_index ti=0; ti<aTileset->size(); ++ti) {
-          if (!is_same_image(aTileset->get(ti).get(),
-                             bTileset->get(ti).get())) {
+          if (!images.isSameImage(aTileset->get(ti).get(),
+                                  bTileset->get(ti).get())) {
             diff.anything = diff.tilesets = true;
             goto done;
           }
@@ -222,9 +289,13 @@ DocDiff compare_docs(const Doc* a,
               TRACEDIFF(aCel->opacity(), bCel->opacity());
               TRACEDIFF(aCel->data()->userData(), bCel->data()->userData());
             }
-            if (aCel->image() && bCel->image()) {
-              if (aCel->image()->bounds() != bCel->image()->bounds() ||
-                  !is_same_image(aCel->image(), bCel->image()))
+            // Once we know that some image is different, there is
+            // no need to compare more pixels.
+            if (diff.images) {
+              // Do nothing
+            }
+            else if (aCel->image() && bCel->image()) {
+              if (!images.isSameImage(aCel->image(), bCel->image()))
                 diff.anything = diff.images = true;
             }
             // In case one is nullptr and the other not
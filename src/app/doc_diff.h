@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2018  David Capello
 //
 // This program is distributed under the terms of
@@ -9,6 +9,18 @@
 #define APP_DOC_DIFF_H_INCLUDED
 #pragma once
 
+#include "doc/object_id.h"
+#include "doc/object_version.h"
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace doc {
+  class Image;
+}
+
 namespace app {
   class Doc;
 
@@ -42,10 +54,36 @@ namespace app {
     }
   };
 
+  // Hashes of images (calculate_image_hash64()) associated to the
+  // image ID/version, so images that don't change between calls to
+  // compare_docs() (e.g. a reference document compared with several
+  // re-exported files) are hashed only once. It can be shared
+  // between threads.
+  class DocDiffHashCache {
+  public:
+    uint64_t imageHash(const doc::Image* image);
+
+  private:
+    std::mutex m_mutex;
+    std::unordered_map<doc::ObjectId,
+                       std::pair<doc::ObjectVersion, uint64_t>> m_hashes;
+  };
+
+  struct DocDiffOptions {
+    // If it's not nullptr, images with different hashes are reported
+    // as different without comparing their pixels.
+    DocDiffHashCache* hashCache = nullptr;
+
+    // Images with the same hash are considered equal without
+    // comparing their pixels (requires a "hashCache").
+    bool trustHashes = false;
+  };
+
   // Useful for testing purposes to detect if two documents (after
   // some kind of operation) are equivalent.
   DocDiff compare_docs(const Doc* a,
-                       const Doc* b);
+                       const Doc* b,
+                       const DocDiffOptions& options = DocDiffOptions());
 
 } // namespace app
 
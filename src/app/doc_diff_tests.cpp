@@ -0,0 +1,97 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/context.h"
+#include "app/doc.h"
+#include "app/doc_diff.h"
+#include "app/test_context.h"
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/primitives.h"
+#include "doc/sprite.h"
+
+#include <memory>
+
+using namespace app;
+using namespace doc;
+
+class DocDiffTest : public ::testing::Test {
+public:
+  DocDiffTest()
+    : a(ctx.documents().add(32, 16))
+    , b(ctx.documents().add(32, 16)) {
+    draw(a.get());
+    draw(b.get());
+  }
+
+  ~DocDiffTest() {
+    a->close();
+    b->close();
+  }
+
+  static Image* image(Doc* doc) {
+    return doc->sprite()->root()->firstLayer()->cel(0)->image();
+  }
+
+  static void draw(Doc* doc) {
+    Image* img = image(doc);
+    for (int y=0; y<img->height(); ++y)
+      for (int x=0; x<img->width(); ++x)
+        put_pixel(img, x, y, rgba(x*8, y*16, 0, 255));
+  }
+
+  TestContextT<Context> ctx;
+  std::unique_ptr<Doc> a;
+  std::unique_ptr<Doc> b;
+};
+
+TEST_F(DocDiffTest, SameDocs)
+{
+  EXPECT_FALSE(compare_docs(a.get(), b.get()).anything);
+
+  DocDiffHashCache cache;
+  DocDiffOptions options;
+  options.hashCache = &cache;
+  EXPECT_FALSE(compare_docs(a.get(), b.get(), options).anything);
+
+  options.trustHashes = true;
+  EXPECT_FALSE(compare_docs(a.get(), b.get(), options).anything);
+}
+
+TEST_F(DocDiffTest, DifferentImages)
+{
+  put_pixel(image(b.get()), 3, 4, rgba(255, 255, 255, 255));
+
+  DocDiff diff = compare_docs(a.get(), b.get());
+  EXPECT_TRUE(diff.anything);
+  EXPECT_TRUE(diff.images);
+  EXPECT_FALSE(diff.cels);
+
+  DocDiffHashCache cache;
+  DocDiffOptions options;
+  options.hashCache = &cache;
+  diff = compare_docs(a.get(), b.get(), options);
+  EXPECT_TRUE(diff.images);
+}
+
+TEST_F(DocDiffTest, HashCacheUsesImageVersion)
+{
+  DocDiffHashCache cache;
+  DocDiffOptions options;
+  options.hashCache = &cache;
+  options.trustHashes = true;
+  EXPECT_FALSE(compare_docs(a.get(), b.get(), options).anything);
+
+  // Modify the image and its version, the cached hash of "b" must be
+  // discarded.
+  Image* img = image(b.get());
+  put_pixel(img, 0, 0, rgba(1, 2, 3, 4));
+  img->incrementVersion();
+  EXPECT_TRUE(compare_docs(a.get(), b.get(), options).images);
+}
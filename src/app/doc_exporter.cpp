@@ -21,17 +21,20 @@
 #include "app/restore_visible_layers.h"
 #include "app/snap_to_grid.h"
 #include "app/util/autocrop.h"
+#include "app/util/msgpack_writer.h"
+#include "app/util/sheet_packer.h"
+#include "app/util/thread_budget.h"
 #include "base/convert_to.h"
 #include "base/fs.h"
 #include "base/fstream_path.h"
 #include "base/replace_string.h"
 #include "base/string.h"
+#include "base/thread_pool.h"
 #include "doc/algorithm/shrink_bounds.h"
 #include "doc/cel.h"
 #include "doc/image.h"
-#include "doc/images_map.h"
-#include "doc/images_map.h"
 #include "doc/layer.h"
+#include "doc/layer_tilemap.h"
 #include "doc/palette.h"
 #include "doc/primitives.h"
 #include "doc/selected_frames.h"
@@ -39,7 +42,7 @@
 #include "doc/slice.h"
 #include "doc/sprite.h"
 #include "doc/tag.h"
-#include "gfx/packing_rects.h"
+#include "doc/tileset.h"
 #include "gfx/rect_io.h"
 #include "gfx/size.h"
 #include "render/dithering.h"
@@ -47,13 +50,24 @@
 #include "render/render.h"
 #include "ver/info.h"
 
+#include "json11.hpp"
+
 #include <algorithm>
 #include <cstdio>
+#include <deque>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #define DX_TRACE(...) // TRACEARGS
@@ -70,30 +84,64 @@ std::string escape_for_json(const std::string& path)
   return res;
 }
 
+// Returns the color of the user data as "#rrggbbaa"
+std::string user_data_color(const doc::UserData& data)
+{
+  const doc::color_t color = data.color();
+  std::ostringstream os;
+  os << "#"
+     << std::hex << std::setfill('0')
+     << std::setw(2) << (int)doc::rgba_getr(color)
+     << std::setw(2) << (int)doc::rgba_getg(color)
+     << std::setw(2) << (int)doc::rgba_getb(color)
+     << std::setw(2) << (int)doc::rgba_geta(color);
+  return os.str();
+}
+
 std::ostream& operator<<(std::ostream& os, const doc::UserData& data)
 {
-  doc::color_t color = data.color();
-  if (doc::rgba_geta(color)) {
-    os << ", \"color\": \"#"
-       << std::hex << std::setfill('0')
-       << std::setw(2) << (int)doc::rgba_getr(color)
-       << std::setw(2) << (int)doc::rgba_getg(color)
-       << std::setw(2) << (int)doc::rgba_getb(color)
-       << std::setw(2) << (int)doc::rgba_geta(color)
-       << std::dec
-       << "\"";
-  }
+  if (doc::rgba_geta(data.color()))
+    os << ", \"color\": \"" << user_data_color(data) << "\"";
   if (!data.text().empty())
     os << ", \"data\": \"" << escape_for_json(data.text()) << "\"";
   return os;
 }
 
+// Number of fields (map entries) written by write_user_data()
+int user_data_fields(const doc::UserData& data)
+{
+  return ((doc::rgba_geta(data.color()) ? 1: 0) +
+          (!data.text().empty() ? 1: 0));
+}
+
+// Same fields of the JSON user data (see operator<<) for the
+// MessagePack data format
+void write_user_data(app::MsgPackWriter& w, const doc::UserData& data)
+{
+  if (doc::rgba_geta(data.color()))
+    w.str("color").str(user_data_color(data));
+  if (!data.text().empty())
+    w.str("data").str(data.text());
+}
+
 } // anonymous namespace
 
 namespace app {
 
 typedef std::shared_ptr<gfx::Rect> SharedRectPtr;
 
+// Hash of each image (by ID) and the image version used to calculate it
+typedef std::unordered_map<doc::ObjectId,
+                           std::pair<doc::ObjectVersion, uint64_t>> ImageHashes;
+
+static void add_to_key(uint64_t& key, const uint64_t value)
+{
+  key ^= value + 0x9e3779b97f4a7c15ull + (key << 6) + (key >> 2);
+}
+
+// Version of the "<texture>.manifest" file format
+static constexpr int kManifestVersion = 1;
+
 DocExporter::Item::Item(Doc* doc,
                         const doc::Tag* tag,
                         const doc::SelectedLayers* selLayers,
@@ -170,6 +218,7 @@ public:
     m_extrude(extrude),
     m_isLinked(false),
     m_isDuplicated(false),
+    m_renderSource(-1),
     m_originalSize(size),
     m_trimmedBounds(size),
     m_inTextureBounds(std::make_shared<gfx::Rect>(size)) {
@@ -223,6 +272,7 @@ public:
     m_inTextureBounds = bounds;
   }
 
+  bool hasImage() const { return m_image != nullptr; }
   bool isLinked() const { return m_isLinked; }
   bool isDuplicated() const { return m_isDuplicated; }
   bool isEmpty() const {
@@ -235,7 +285,24 @@ public:
   void setLinked() { m_isLinked = true; }
   void setDuplicated() { m_isDuplicated = true; }
 
-  ImageRef createRender(ImageBufferPtr& imageBuf) {
+  // Index of a previous sample that renders exactly the same pixels
+  // (e.g. the same frame/layer exported in two different tags), or
+  // -1 if this sample must be rendered.
+  int renderSource() const { return m_renderSource; }
+  void setRenderSource(const int i) { m_renderSource = i; }
+
+  // Returns true if both samples render the same pixels of the
+  // sprite canvas (without taking care of the trimmed bounds).
+  bool hasSameRender(const Sample& other) const {
+    return (!m_image && !other.m_image &&
+            m_sprite == other.m_sprite &&
+            m_frame == other.m_frame &&
+            (m_selLayers && other.m_selLayers ?
+             *m_selLayers == *other.m_selLayers:
+             m_selLayers == other.m_selLayers));
+  }
+
+  ImageRef createRender(ImageBufferPtr& imageBuf) const {
     ASSERT(m_sprite);
 
     // We use the m_image as it is, it doesn't require a special
@@ -256,16 +323,146 @@ public:
 
   void renderSample(doc::Image* dst, int x, int y, bool extrude) const {
     RestoreVisibleLayers layersVisibility;
+    showSelectedLayers(layersVisibility);
+
+    render::Render render;
+    renderSample(render, dst, x, y, extrude);
+  }
+
+  // Shows only the selected layers of this sample (until the given
+  // "layersVisibility" is destroyed).
+  void showSelectedLayers(RestoreVisibleLayers& layersVisibility) const {
     if (m_selLayers)
       layersVisibility.showSelectedLayers(m_sprite,
                                           *m_selLayers);
+  }
 
-    render::Render render;
-
+  // Renders the sample without changing the visibility of layers, so
+  // it can be called from several threads at the same time (each one
+  // with its own "render") to render samples of the same sprite.
+  void renderSample(render::Render& render,
+                    doc::Image* dst, int x, int y, bool extrude) const {
     // 1) We cannot use the Preferences because this is called from a non-UI thread
     // 2) We should use the new blend mode always when we're saving files
     //render.setNewBlend(Preferences::instance().experimental.newBlend());
 
+    forEachClip(
+      x, y, extrude,
+      [this, &render, dst](const gfx::Clip& clip) {
+        if (m_image) {
+          dst->copy(m_image.get(), clip);
+        }
+        else {
+          render.renderSprite(dst, m_sprite, m_frame, clip);
+        }
+      });
+  }
+
+  // Copies the sample from a previous render "src" which contains
+  // the pixels of the sprite canvas starting at "srcOrigin".
+  void copySample(const doc::Image* src, const gfx::Point& srcOrigin,
+                  doc::Image* dst, int x, int y, bool extrude) const {
+    forEachClip(
+      x, y, extrude,
+      [src, &srcOrigin, dst](gfx::Clip clip) {
+        clip.src -= srcOrigin;
+        dst->copy(src, clip);
+      });
+  }
+
+  // Returns a hash of everything that modifies the pixels of this
+  // sample in the sprite canvas (pixels of cels/tiles, layer
+  // properties, palette, etc.), so we can know if a previous render
+  // of the sample is still valid without rendering it again. The
+  // hash of each image is calculated just one time (per image
+  // version) using the given "imageHashes" map.
+  uint64_t renderKey(ImageHashes& imageHashes) const {
+    uint64_t key = 0;
+    auto add = [&key](const uint64_t value) {
+      add_to_key(key, value);
+    };
+    auto addImage = [&add, &imageHashes](const Image* image) {
+      if (!image) {
+        add(0);
+        return;
+      }
+      auto it = imageHashes.find(image->id());
+      if (it == imageHashes.end() ||
+          it->second.first != image->version()) {
+        auto& entry = imageHashes[image->id()];
+        entry.first = image->version();
+        entry.second = calculate_image_hash64(image);
+        add(entry.second);
+      }
+      else
+        add(it->second.second);
+    };
+
+    if (m_image) {
+      addImage(m_image.get());
+      return key;
+    }
+
+    ASSERT(m_sprite);
+    add(int(m_sprite->pixelFormat()));
+    add(m_sprite->width());
+    add(m_sprite->height());
+    add(m_sprite->transparentColor());
+
+    const Palette* palette = m_sprite->palette(m_frame);
+    add(palette->size());
+    for (int i=0; i<palette->size(); ++i)
+      add(palette->getEntry(i));
+
+    for (const Layer* layer : m_sprite->allLayers()) {
+      add(int(layer->flags()));
+      add(m_selLayers && m_selLayers->contains(layer));
+      if (!layer->isImage())
+        continue;
+
+      auto layerImage = static_cast<const LayerImage*>(layer);
+      add(layerImage->opacity());
+      add(int(layerImage->blendMode()));
+
+      if (layer->isTilemap()) {
+        const Tileset* tileset =
+          static_cast<const LayerTilemap*>(layer)->tileset();
+        add(tileset->size());
+        for (tile_index ti=0; ti<tileset->size(); ++ti)
+          addImage(tileset->get(ti).get());
+      }
+
+      if (const Cel* cel = layer->cel(m_frame)) {
+        add(cel->x());
+        add(cel->y());
+        add(cel->opacity());
+        add(cel->zIndex());
+        addImage(cel->image());
+      }
+      else
+        add(0);
+    }
+    return key;
+  }
+
+  // Returns a hash of the pixels of this sample in the texture (its
+  // render, trimmed bounds, inner padding, and extrude option).
+  uint64_t contentKey(ImageHashes& imageHashes) const {
+    uint64_t key = renderKey(imageHashes);
+    add_to_key(key, m_innerPadding);
+    add_to_key(key, m_extrude);
+    add_to_key(key, m_trimmedBounds.x);
+    add_to_key(key, m_trimmedBounds.y);
+    add_to_key(key, m_trimmedBounds.w);
+    add_to_key(key, m_trimmedBounds.h);
+    return key;
+  }
+
+private:
+  // Calls "func" with each area of the sprite canvas that must be
+  // copied to the texture at (x, y) to render this sample.
+  template<typename Func>
+  void forEachClip(int x, int y, bool extrude, Func&& func) const {
     if (extrude) {
       const gfx::Rect& trim = m_trimmedBounds;
 
@@ -287,28 +484,16 @@ public:
       // side.
       for (int j=0; j<3; ++j) {
         for (int i=0; i<3; ++i) {
-          gfx::Clip clip(x+dx[i], y+dy[j], gfx::RectT<int>(srcx[i], srcy[j], szx[i], szy[j]));
-          if (m_image) {
-            dst->copy(m_image.get(), clip);
-          }
-          else {
-            render.renderSprite(dst, m_sprite, m_frame, clip);
-          }
+          func(gfx::Clip(x+dx[i], y+dy[j],
+                         gfx::RectT<int>(srcx[i], srcy[j], szx[i], szy[j])));
         }
       }
     }
     else {
-      gfx::Clip clip(x, y, m_trimmedBounds);
-      if (m_image) {
-        dst->copy(m_image.get(), clip);
-      }
-      else {
-        render.renderSprite(dst, m_sprite, m_frame, clip);
-      }
+      func(gfx::Clip(x, y, m_trimmedBounds));
     }
   }
 
-private:
   Doc* m_document;
   Sprite* m_sprite;
   // In case that this Sample references just one image to export
@@ -322,11 +507,95 @@ private:
   bool m_extrude;
   bool m_isLinked;
   bool m_isDuplicated;
+  int m_renderSource;
   gfx::Size m_originalSize;
   gfx::Rect m_trimmedBounds;
   SharedRectPtr m_inTextureBounds;
 };
 
+// Renders and trimmed bounds of samples from previous exports,
+// keyed by Sample::renderKey().
+class DocExporter::RenderCache {
+public:
+  // Render key, trim by the first pixel (background color), size of
+  // the render, and bounds where the sample is trimmed.
+  typedef std::tuple<uint64_t, bool, int, int, int, int, int, int> TrimKey;
+
+  // Max memory used by cached renders, when we reach this limit new
+  // renders are not cached.
+  static constexpr std::size_t kMaxBytes = 256*1024*1024;
+
+  ImageHashes& imageHashes() { return m_imageHashes; }
+
+  static TrimKey trimKey(const uint64_t renderKey,
+                         const bool trimBackground,
+                         const gfx::Size& renderSize,
+                         const gfx::Rect& bounds) {
+    return std::make_tuple(renderKey, trimBackground,
+                           renderSize.w, renderSize.h,
+                           bounds.x, bounds.y, bounds.w, bounds.h);
+  }
+
+  // Returns the bounds calculated by shrink_bounds() (an empty
+  // rectangle if the whole sample was trimmed).
+  bool findTrimmedBounds(const TrimKey& key, gfx::Rect& bounds) const {
+    auto it = m_trimmedBounds.find(key);
+    if (it == m_trimmedBounds.end())
+      return false;
+    bounds = it->second;
+    return true;
+  }
+
+  void addTrimmedBounds(const TrimKey& key, const gfx::Rect& bounds) {
+    m_trimmedBounds[key] = bounds;
+  }
+
+  // Returns a render which contains the given bounds of the sprite
+  // canvas, "origin" is the position of the render in the canvas.
+  ImageRef findRender(const uint64_t renderKey,
+                      const gfx::Rect& bounds,
+                      gfx::Point& origin) const {
+    const std::lock_guard lock(m_mutex);
+    auto it = m_renders.find(renderKey);
+    if (it == m_renders.end() ||
+        !it->second.bounds.contains(bounds))
+      return nullptr;
+    origin = it->second.bounds.origin();
+    return it->second.image;
+  }
+
+  // Can be called from several threads at the same time
+  void addRender(const uint64_t renderKey,
+                 const gfx::Rect& bounds,
+                 const ImageRef& image) {
+    const std::size_t size = image->getMemSize();
+    const std::lock_guard lock(m_mutex);
+    auto& render = m_renders[renderKey];
+    if (render.image)
+      m_bytes -= render.image->getMemSize();
+
+    if (m_bytes + size > kMaxBytes) {
+      m_renders.erase(renderKey);
+      return;
+    }
+    render.bounds = bounds;
+    render.image = image;
+    m_bytes += size;
+  }
+
+private:
+  struct CachedRender {
+    gfx::Rect bounds;
+    ImageRef image;
+  };
+
+  ImageHashes m_imageHashes;
+  std::map<TrimKey, gfx::Rect> m_trimmedBounds;
+  mutable std::mutex m_mutex;
+  std::unordered_map<uint64_t, CachedRender> m_renders;
+  std::size_t m_bytes = 0;
+};
+
 class DocExporter::Samples {
 public:
   typedef std::vector<Sample> List;
@@ -336,7 +605,22 @@ public:
   bool empty() const { return m_samples.empty(); }
   int size() const { return int(m_samples.size()); }
 
-  void addSample(const Sample& sample) {
+  // If "canShareRender" is true, the sample can be used as the
+  // render source of next samples (see findRenderSource()).
+  void addSample(const Sample& sample,
+                 const bool canShareRender = false) {
+    const Key key(sample.sprite(),
+                  sample.layer(),
+                  sample.frame());
+
+    // Only the first sample of each sprite/layer/frame is indexed
+    m_index.insert(std::make_pair(key, m_samples.size()));
+
+    if (canShareRender &&
+        !sample.isLinked() &&
+        sample.renderSource() < 0) {
+      m_renders[key].push_back(m_samples.size());
+    }
     m_samples.push_back(sample);
   }
 
@@ -344,13 +628,116 @@ public:
     return m_samples[i];
   }
 
+  // Returns the first added sample of the given sprite/layer/frame
+  // (used to find the original sample of linked cels).
+  const Sample* findSample(const Sprite* sprite,
+                           const Layer* layer,
+                           const frame_t frame) const {
+    auto it = m_index.find(Key(sprite, layer, frame));
+    if (it != m_index.end())
+      return &m_samples[it->second];
+    return nullptr;
+  }
+
+  // Returns the index of the first added sample that renders the
+  // same pixels as the given one, or -1 if there is no such sample.
+  int findRenderSource(const Sample& sample) const {
+    auto it = m_renders.find(Key(sample.sprite(),
+                                 sample.layer(),
+                                 sample.frame()));
+    if (it != m_renders.end()) {
+      for (const size_t i : it->second) {
+        if (m_samples[i].hasSameRender(sample))
+          return int(i);
+      }
+    }
+    return -1;
+  }
+
   iterator begin() { return m_samples.begin(); }
   iterator end() { return m_samples.end(); }
   const_iterator begin() const { return m_samples.begin(); }
   const_iterator end() const { return m_samples.end(); }
 
 private:
+  struct Key {
+    const Sprite* sprite;
+    const Layer* layer;
+    frame_t frame;
+
+    Key(const Sprite* sprite, const Layer* layer, const frame_t frame)
+      : sprite(sprite), layer(layer), frame(frame) { }
+
+    bool operator==(const Key& other) const {
+      return (sprite == other.sprite &&
+              layer == other.layer &&
+              frame == other.frame);
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      size_t h = std::hash<const Sprite*>()(key.sprite);
+      h = h*31 + std::hash<const Layer*>()(key.layer);
+      h = h*31 + std::hash<frame_t>()(key.frame);
+      return h;
+    }
+  };
+
   List m_samples;
+  std::unordered_map<Key, size_t, KeyHash> m_index;
+  std::unordered_map<Key, std::vector<size_t>, KeyHash> m_renders;
+};
+
+// Finds samples with the same rendered pixels. Only a hash of each
+// render is kept in memory, the candidate samples are rendered again
+// to compare their pixels when two hashes match.
+class DocExporter::DuplicateSamples {
+public:
+  DuplicateSamples(const Samples& samples)
+    : m_samples(samples)
+    , m_sampleBuf(std::make_shared<doc::ImageBuffer>())
+    , m_otherBuf(std::make_shared<doc::ImageBuffer>()) {
+  }
+
+  // Returns the index of a previous sample with the same pixels as
+  // samples[i], or -1 if it's the first sample with these pixels (in
+  // this case it's added as a candidate for the next samples).
+  int findOrAdd(const uint32_t i) {
+    // Samples with the same render source (and trimmed bounds) have
+    // the same pixels, we don't need to render them to compare them.
+    const int source = m_samples[i].renderSource();
+    if (source >= 0 &&
+        m_samples[source].trimmedBounds() == m_samples[i].trimmedBounds()) {
+      auto it = m_found.find(source);
+      if (it != m_found.end()) {
+        m_found[i] = it->second;
+        return it->second;
+      }
+    }
+
+    doc::ImageRef render(m_samples[i].createRender(m_sampleBuf));
+    auto& candidates = m_candidates[doc::calculate_image_hash64(render.get())];
+    for (const uint32_t j : candidates) {
+      doc::ImageRef other(m_samples[j].createRender(m_otherBuf));
+      if (doc::is_same_image(render.get(), other.get())) {
+        m_found[i] = int(j);
+        return int(j);
+      }
+    }
+    candidates.push_back(i);
+    m_found[i] = int(i);
+    return -1;
+  }
+
+private:
+  const Samples& m_samples;
+  doc::ImageBufferPtr m_sampleBuf;
+  doc::ImageBufferPtr m_otherBuf;
+  std::unordered_map<uint64_t, std::vector<uint32_t>> m_candidates;
+  // Index of the first sample with the same pixels of each sample
+  // that was already processed by findOrAdd().
+  std::unordered_map<uint32_t, int> m_found;
 };
 
 class DocExporter::LayoutSamples {
@@ -392,7 +779,7 @@ public:
     const Layer* oldLayer = nullptr;
     const Tag* oldTag = nullptr;
 
-    doc::ImagesMap duplicates;
+    DuplicateSamples duplicates(samples);
     gfx::Point framePt(borderPadding, borderPadding);
     gfx::Size rowSize(0, 0);
 
@@ -418,20 +805,13 @@ public:
       }
 
       if (m_mergeDups || sample.isLinked()) {
-        doc::ImageBufferPtr sampleBuf = std::make_shared<doc::ImageBuffer>();
-        doc::ImageRef sampleRender(sample.createRender(sampleBuf));
-        auto it = duplicates.find(sampleRender);
-        if (it != duplicates.end()) {
-          const uint32_t j = it->second;
-
+        const int j = duplicates.findOrAdd(i);
+        if (j >= 0) {
           sample.setDuplicated();
           sample.setSharedBounds(samples[j].sharedBounds());
           ++i;
           continue;
         }
-        else {
-          duplicates[sampleRender] = i;
-        }
       }
 
       const Sprite* sprite = sample.sprite();
@@ -528,13 +908,31 @@ private:
 
 class DocExporter::BestFitLayoutSamples : public DocExporter::LayoutSamples {
 public:
+  // Maximum time (in seconds) used to look for the best texture size
+  static constexpr double kBestFitTimeBudget = 1.0;
+
+  BestFitLayoutSamples(const PreviousLayout* previousLayout)
+    : m_previousLayout(previousLayout) {
+  }
+
   void layoutSamples(Samples& samples,
                      int borderPadding,
                      int shapePadding,
                      int& width, int& height,
                      base::task_token& token) override {
-    gfx::PackingRects pr(borderPadding, shapePadding);
-    doc::ImagesMap duplicates;
+    SheetPacker packer(borderPadding, shapePadding);
+    DuplicateSamples duplicates(samples);
+    std::vector<Sample*> packedSamples;
+
+    // Bounds of the previous layout that are re-used by some sample
+    std::set<std::tuple<int, int, int, int>> reused;
+    auto key = [](const gfx::Rect& rc) {
+      return std::make_tuple(rc.x, rc.y, rc.w, rc.h);
+    };
+    const gfx::Rect validBounds(
+      borderPadding, borderPadding,
+      (width > 0 ? width-2*borderPadding: std::numeric_limits<int>::max()/2),
+      (height > 0 ? height-2*borderPadding: std::numeric_limits<int>::max()/2));
 
     uint32_t i = 0;
     for (auto& sample : samples) {
@@ -548,46 +946,78 @@ public:
         continue;
       }
 
-      // We have to use one ImageBuffer for each image because we're
-      // going to store all images in the "duplicates" map.
-      doc::ImageBufferPtr sampleBuf = std::make_shared<doc::ImageBuffer>();
-      doc::ImageRef sampleRender(sample.createRender(sampleBuf));
-      auto it = duplicates.find(sampleRender);
-      if (it != duplicates.end()) {
-        const uint32_t j = it->second;
-
+      // The render of the sample is released after finding
+      // duplicates, it will be rendered again in renderTexture().
+      const int j = duplicates.findOrAdd(i);
+      if (j >= 0) {
         sample.setDuplicated();
         sample.setSharedBounds(samples[j].sharedBounds());
+        ++i;
+        continue;
       }
-      else {
-        duplicates[sampleRender] = i;
-        pr.add(sample.requiredSize());
+
+      // Keep the sample in the same position of the previous layout
+      const gfx::Size size = sample.requiredSize();
+      if (m_previousLayout) {
+        auto it = m_previousLayout->bounds.find(sample.filename());
+        if (it != m_previousLayout->bounds.end()) {
+          const gfx::Rect& bounds = it->second;
+          if (bounds.size() == size &&
+              validBounds.contains(bounds) &&
+              reused.insert(key(bounds)).second) {
+            sample.setInTextureBounds(bounds);
+            packer.addFixed(bounds);
+            ++i;
+            continue;
+          }
+        }
       }
+
+      packer.add(size);
+      packedSamples.push_back(&sample);
       ++i;
     }
 
+    // Areas of the previous layout that are not used anymore
+    if (m_previousLayout) {
+      std::set<std::tuple<int, int, int, int>> freeAreas;
+      for (const auto& it : m_previousLayout->bounds) {
+        const gfx::Rect& bounds = it.second;
+        if (validBounds.contains(bounds) &&
+            reused.find(key(bounds)) == reused.end() &&
+            freeAreas.insert(key(bounds)).second) {
+          packer.addFreeArea(bounds);
+        }
+      }
+
+      // Keep the width of the previous texture to pack the new
+      // samples in just one pass.
+      if (width == 0 && height == 0)
+        width = m_previousLayout->textureSize.w;
+    }
+
     token.set_progress_range(0.3f, 0.4f);
     if (width == 0 || height == 0) {
-      gfx::Size sz = pr.bestFit(token, width, height);
+      gfx::Size sz = packer.bestFit(token, width, height,
+                                    kBestFitTimeBudget);
       width = sz.w;
       height = sz.h;
     }
     else {
-      pr.pack(gfx::Size(width, height), token);
+      packer.pack(gfx::Size(width, height), token);
     }
     token.set_progress_range(0.0f, 1.0f);
 
-    auto it = pr.begin();
-    for (auto& sample : samples) {
-      if (sample.isLinked() ||
-          sample.isDuplicated() ||
-          sample.isEmpty())
-        continue;
-
-      ASSERT(it != pr.end());
-      sample.setInTextureBounds(*(it++));
+    const std::vector<gfx::Rect>& rects = packer.rects();
+    ASSERT(rects.size() == packedSamples.size());
+    for (size_t k=0; k<packedSamples.size() && k<rects.size(); ++k) {
+      if (!rects[k].isEmpty())
+        packedSamples[k]->setInTextureBounds(rects[k]);
     }
   }
+
+private:
+  const PreviousLayout* m_previousLayout;
 };
 
 DocExporter::DocExporter()
@@ -598,6 +1028,10 @@ DocExporter::DocExporter()
   reset();
 }
 
+DocExporter::~DocExporter()
+{
+}
+
 void DocExporter::reset()
 {
   m_sheetType = SpriteSheetType::None;
@@ -625,7 +1059,18 @@ void DocExporter::reset()
   m_listLayers = false;
   m_listLayerHierarchy = false;
   m_listSlices = false;
+  m_incrementalLayout = false;
+  m_incrementalRender = false;
   m_documents.clear();
+  m_previousLayout = PreviousLayout();
+}
+
+void DocExporter::setCacheRenders(bool value)
+{
+  if (!value)
+    m_renderCache.reset();
+  else if (!m_renderCache)
+    m_renderCache = std::make_unique<RenderCache>();
 }
 
 void DocExporter::setDocImageBuffer(const doc::ImageBufferPtr& docBuf)
@@ -658,7 +1103,16 @@ Doc* DocExporter::exportSheet(Context* ctx, base::task_token& token)
       }
     }
 
-    fos.open(FSTREAM_PATH(m_dataFilename), std::ios::out);
+    // Read the previous layout before we overwrite the file (only
+    // JSON data files can be read)
+    if (m_incrementalLayout &&
+        m_dataFormat != SpriteSheetDataFormat::MsgPack)
+      readPreviousLayout();
+
+    std::ios::openmode mode = std::ios::out;
+    if (m_dataFormat == SpriteSheetDataFormat::MsgPack)
+      mode |= std::ios::binary;
+    fos.open(FSTREAM_PATH(m_dataFilename), mode);
     osbuf = fos.rdbuf();
   }
   std::ostream os(osbuf);
@@ -695,7 +1149,19 @@ Doc* DocExporter::exportSheet(Context* ctx, base::task_token& token)
   Image* textureImage = texture->root()->firstLayer()
     ->cel(frame_t(0))->image();
 
-  renderTexture(ctx, samples, textureImage, token);
+  // Use the previous texture file to avoid rendering the samples
+  // that didn't change.
+  PreviousTexture previous;
+  const bool incremental =
+    (m_incrementalRender &&
+     !m_textureFilename.empty() &&
+     readPreviousTexture(previous));
+  std::vector<uint64_t> keys;
+
+  renderTexture(ctx, samples, textureImage,
+                (incremental ? &previous: nullptr),
+                (m_incrementalRender ? &keys: nullptr),
+                token);
   if (token.canceled())
     return nullptr;
   token.set_progress(0.8f);
@@ -715,8 +1181,11 @@ Doc* DocExporter::exportSheet(Context* ctx, base::task_token& token)
     DX_TRACE("DX: exportSheet", m_textureFilename);
     textureDocument->setFilename(m_textureFilename.c_str());
     int ret = save_document(ctx, textureDocument.get());
-    if (ret == 0)
+    if (ret == 0) {
       textureDocument->markAsSaved();
+      if (m_incrementalRender)
+        saveManifest(samples, keys, texture);
+    }
   }
 
   token.set_progress(1.0f);
@@ -984,62 +1453,86 @@ void DocExporter::captureSamples(Samples& samples,
       bool alreadyTrimmed = false;
       if (link && m_mergeDuplicates &&
           !item.isOneImageOnly()) {
-        for (const Sample& other : samples) {
-          if (token.canceled())
-            return;
+        if (const Sample* other = samples.findSample(sprite, layer,
+                                                     link->frame())) {
+          ASSERT(!other->isLinked());
 
-          if (other.sprite() == sprite &&
-              other.layer() == layer &&
-              other.frame() == link->frame()) {
-            ASSERT(!other.isLinked());
-
-            sample.setLinked();
-            sample.setTrimmedBounds(other.trimmedBounds());
-            sample.setSharedBounds(other.sharedBounds());
-            alreadyTrimmed = true;
-            done = true;
-            break;
-          }
+          sample.setLinked();
+          sample.setTrimmedBounds(other->trimmedBounds());
+          sample.setSharedBounds(other->sharedBounds());
+          alreadyTrimmed = true;
+          done = true;
         }
         // "done" variable can be false here, e.g. when we export a
         // frame tag and the first linked cel is outside the tag range.
         ASSERT(done || (!done && tag));
       }
 
-      if (!done && (m_ignoreEmptyCels || m_trimCels) &&
-          !item.isOneImageOnly()) {
+      // Re-use the trimmed bounds (and the render in the texture) of
+      // a previous sample of the same frame/layers (e.g. a frame that
+      // is in several tags when we use --split-tags).
+      const Sample* renderSource = nullptr;
+      if (!done && !item.isOneImageOnly() && !item.splitGrid) {
+        const int j = samples.findRenderSource(sample);
+        if (j >= 0) {
+          sample.setRenderSource(j);
+          renderSource = &samples[j];
+        }
+      }
+
+      if (renderSource) {
+        if (m_trimCels) {
+          sample.setTrimmedBounds(renderSource->trimmedBounds());
+          alreadyTrimmed = true;
+        }
+      }
+      else if (!done && (m_ignoreEmptyCels || m_trimCels) &&
+               !item.isOneImageOnly()) {
         // Ignore empty cels
         if (layer && layer->isImage() && !cel && m_ignoreEmptyCels)
           continue;
 
-        ImageRef sampleRender(sample.createRender(m_sampleBuf));
+        // Trim the background color (the first pixel of the render)
+        // or the transparent color.
+        const bool trimBackground =
+          (m_trimCels &&
+           ((layer &&
+             layer->isBackground()) ||
+            (!layer &&
+             sprite->backgroundLayer() &&
+             sprite->backgroundLayer()->isVisible())));
 
         gfx::Rect frameBounds;
-        doc::color_t refColor = 0;
-
-        if (m_trimCels) {
-          if ((layer &&
-               layer->isBackground()) ||
-              (!layer &&
-               sprite->backgroundLayer() &&
-               sprite->backgroundLayer()->isVisible())) {
-            refColor = get_pixel(sampleRender.get(), 0, 0);
-          }
-          else {
-            refColor = sprite->transparentColor();
-          }
+        RenderCache::TrimKey trimKey;
+        if (m_renderCache) {
+          trimKey = RenderCache::trimKey(
+            sample.renderKey(m_renderCache->imageHashes()),
+            trimBackground, sample.trimmedBounds().size(), spriteBounds);
         }
-        else if (m_ignoreEmptyCels)
-          refColor = sprite->transparentColor();
-
-        if (!algorithm::shrink_bounds(sampleRender.get(),
-                                      refColor,
-                                      nullptr,        // layer
-                                      spriteBounds,   // startBounds
-                                      frameBounds)) { // output bounds
+
+        if (!m_renderCache ||
+            !m_renderCache->findTrimmedBounds(trimKey, frameBounds)) {
+          ImageRef sampleRender(sample.createRender(m_sampleBuf));
+
+          const doc::color_t refColor =
+            (trimBackground ? get_pixel(sampleRender.get(), 0, 0):
+                              sprite->transparentColor());
+
           // If shrink_bounds() returns false, it's because the whole
           // image is transparent (equal to the mask color).
+          if (!algorithm::shrink_bounds(sampleRender.get(),
+                                        refColor,
+                                        nullptr,         // layer
+                                        spriteBounds,    // startBounds
+                                        frameBounds)) {  // output bounds
+            frameBounds = gfx::Rect();
+          }
 
+          if (m_renderCache)
+            m_renderCache->addTrimmedBounds(trimKey, frameBounds);
+        }
+
+        if (frameBounds.isEmpty()) {
           // Should we ignore this empty frame? (i.e. don't include
           // the frame in the sprite sheet)
           if (m_ignoreEmptyCels)
@@ -1095,7 +1588,7 @@ void DocExporter::captureSamples(Samples& samples,
         }
       }
       else {
-        samples.addSample(sample);
+        samples.addSample(sample, !item.isOneImageOnly());
       }
 
       DX_TRACE("DX:   - Sample:",
@@ -1115,7 +1608,9 @@ void DocExporter::layoutSamples(Samples& samples,
 
   switch (m_sheetType) {
     case SpriteSheetType::Packed: {
-      BestFitLayoutSamples layout;
+      BestFitLayoutSamples layout(
+        m_incrementalLayout && !m_previousLayout.bounds.empty() ?
+        &m_previousLayout: nullptr);
       layout.layoutSamples(
         samples, m_borderPadding, m_shapePadding,
         width, height, token);
@@ -1269,25 +1764,27 @@ Doc* DocExporter::createEmptyTexture(const Samples& samples,
 void DocExporter::renderTexture(Context* ctx,
                                 const Samples& samples,
                                 Image* textureImage,
+                                const PreviousTexture* previous,
+                                std::vector<uint64_t>* keys,
                                 base::task_token& token) const
 {
   textureImage->clear(textureImage->maskColor());
 
-  int i = 0;
+  auto skipSample = [](const Sample& sample) {
+    return (sample.isLinked() ||
+            sample.isDuplicated() ||
+            sample.isEmpty());
+  };
+
+  // Make the sprites compatible with the texture so the render()
+  // works correctly. This modifies the sprites, so it must be done
+  // before rendering samples in parallel.
   for (const auto& sample : samples) {
     if (token.canceled())
       return;
-    token.set_progress(0.6f + 0.2f * i / int(samples.size()));
-
-    if (sample.isLinked() ||
-        sample.isDuplicated() ||
-        sample.isEmpty()) {
-      ++i;
+    if (skipSample(sample))
       continue;
-    }
 
-    // Make the sprite compatible with the texture so the render()
-    // works correctly.
     if (sample.sprite()->pixelFormat() != textureImage->pixelFormat()) {
       RgbMapAlgorithm rgbmapAlgo =
         Preferences::instance().quantization.rgbmapAlgorithm();
@@ -1303,13 +1800,192 @@ void DocExporter::renderTexture(Context* ctx,
         fc)
         .execute(ctx);
     }
+  }
+
+  // Content hash of each sample (to know which samples can be copied
+  // from the previous texture).
+  if (keys) {
+    ImageHashes imageHashes;
+    keys->assign(samples.size(), 0);
+    int j = 0;
+    for (const auto& sample : samples) {
+      if (token.canceled())
+        return;
+      if (!skipSample(sample))
+        (*keys)[j] = sample.contentKey(imageHashes);
+      ++j;
+    }
+  }
+  if (previous &&
+      previous->image->pixelFormat() != textureImage->pixelFormat())
+    previous = nullptr;
+
+  // Render key of each sample (to re-use renders of previous exports)
+  std::vector<uint64_t> renderKeys;
+  if (m_renderCache) {
+    renderKeys.assign(samples.size(), 0);
+    int j = 0;
+    for (const auto& sample : samples) {
+      if (token.canceled())
+        return;
+      if (!skipSample(sample) && !sample.hasImage())
+        renderKeys[j] = sample.renderKey(m_renderCache->imageHashes());
+      ++j;
+    }
+  }
+
+  // Samples are in disjoint rectangles of the texture, so they can
+  // be rendered in parallel. Each worker takes one of these Render
+  // instances (which keep their own scratch buffers) to render each
+  // sample.
+  const ThreadBudget budget(std::thread::hardware_concurrency(),
+                             ThreadPriority::Export);
+  const int threads = budget.threads();
+  std::mutex rendersMutex;
+  std::vector<std::unique_ptr<render::Render>> renders;
+
+  base::thread_pool pool(threads);
+  std::deque<std::future<void>> pending;
+  int i = 0;
+  int index = 0;
+
+  // Samples that are copied from the render of other samples in the
+  // same texture (after rendering all samples).
+  std::vector<std::pair<const Sample*, const Sample*>> copies;
+
+  // Waits the oldest rendering task (and if it fails, waits all
+  // tasks before re-throwing the exception because they use local
+  // variables of this function).
+  auto waitOne = [&]{
+    std::future<void> f = std::move(pending.front());
+    pending.pop_front();
+    try {
+      f.get();
+    }
+    catch (...) {
+      pool.wait_all();
+      throw;
+    }
+    token.set_progress(0.6f + 0.2f * (++i) / int(samples.size()));
+  };
+
+  for (auto it=samples.begin(), end=samples.end(); it != end; ) {
+    // The visibility of layers is changed in the sprite itself, so
+    // we render in parallel groups of consecutive samples that show
+    // the same layers of the same sprite.
+    auto groupEnd = it;
+    while (groupEnd != end &&
+           groupEnd->sprite() == it->sprite() &&
+           groupEnd->selectedLayers() == it->selectedLayers())
+      ++groupEnd;
+
+    RestoreVisibleLayers layersVisibility;
+    it->showSelectedLayers(layersVisibility);
+
+    for (; it != groupEnd; ++it, ++index) {
+      if (token.canceled())
+        break;
+
+      const Sample* sample = &(*it);
+      if (skipSample(*sample)) {
+        ++i;
+        continue;
+      }
+
+      // Copy the same pixels of the previous texture if this sample
+      // didn't change and it's in the same position.
+      if (previous) {
+        const gfx::Rect& rc = sample->inTextureBounds();
+        if (previous->image->bounds().contains(rc) &&
+            previous->samples.count(
+              std::make_tuple((*keys)[index], rc.x, rc.y, rc.w, rc.h)) > 0) {
+          textureImage->copy(previous->image.get(),
+                             gfx::Clip(rc.x, rc.y, rc));
+          ++i;
+          continue;
+        }
+      }
+
+      if (sample->renderSource() >= 0) {
+        const Sample* source = &samples[sample->renderSource()];
+        if (source->trimmedBounds() == sample->trimmedBounds() &&
+            source->inTextureBounds().size() == sample->inTextureBounds().size()) {
+          copies.push_back(std::make_pair(sample, source));
+          ++i;
+          continue;
+        }
+      }
+
+      const gfx::Point pos(sample->inTextureBounds().x+m_innerPadding,
+                           sample->inTextureBounds().y+m_innerPadding);
+
+      // Copy the sample from a render of a previous export
+      const bool cacheRender = (m_renderCache && !sample->hasImage());
+      if (cacheRender) {
+        gfx::Point origin;
+        if (ImageRef render = m_renderCache->findRender(
+              renderKeys[index], sample->trimmedBounds(), origin)) {
+          sample->copySample(render.get(), origin,
+                             textureImage, pos.x, pos.y, m_extrude);
+          ++i;
+          continue;
+        }
+      }
+
+      const uint64_t renderKey = (cacheRender ? renderKeys[index]: 0);
+      auto task = std::make_shared<std::packaged_task<void()>>(
+        [&, sample, pos, cacheRender, renderKey]{
+          if (token.canceled())
+            return;
+
+          std::unique_ptr<render::Render> render;
+          {
+            const std::lock_guard lock(rendersMutex);
+            if (!renders.empty()) {
+              render = std::move(renders.back());
+              renders.pop_back();
+            }
+          }
+          if (!render)
+            render = std::make_unique<render::Render>();
+
+          sample->renderSample(*render, textureImage,
+                               pos.x, pos.y, m_extrude);
+
+          if (cacheRender) {
+            const gfx::Rect& trim = sample->trimmedBounds();
+            const int extrude = (m_extrude ? 1: 0);
+            ImageRef copy(
+              crop_image(textureImage,
+                         gfx::Rect(pos.x+extrude, pos.y+extrude,
+                                   trim.w, trim.h),
+                         textureImage->maskColor()));
+            m_renderCache->addRender(renderKey, trim, copy);
+          }
+
+          const std::lock_guard lock(rendersMutex);
+          renders.push_back(std::move(render));
+        });
+      pending.push_back(task->get_future());
+      pool.execute([task]{ (*task)(); });
+
+      while (int(pending.size()) >= 2*threads)
+        waitOne();
+    }
+
+    // Wait the whole group before restoring the layers visibility
+    while (!pending.empty())
+      waitOne();
+
+    if (token.canceled())
+      return;
+  }
 
-    sample.renderSample(
-      textureImage,
-      sample.inTextureBounds().x+m_innerPadding,
-      sample.inTextureBounds().y+m_innerPadding,
-      m_extrude);
-    ++i;
+  for (const auto& copy : copies) {
+    const gfx::Rect& rc = copy.first->inTextureBounds();
+    const gfx::Rect& src = copy.second->inTextureBounds();
+    textureImage->copy(textureImage,
+                       gfx::Clip(rc.x, rc.y, src));
   }
 }
 
@@ -1348,10 +2024,149 @@ void DocExporter::trimTexture(const Samples& samples,
                    m_textureHeight > 0 ? m_textureHeight: size.h);
 }
 
+void DocExporter::readPreviousLayout()
+{
+  m_previousLayout = PreviousLayout();
+  if (m_dataFilename.empty() || !base::is_file(m_dataFilename))
+    return;
+
+  std::ifstream in(FSTREAM_PATH(m_dataFilename), std::ifstream::binary);
+  std::stringstream text;
+  text << in.rdbuf();
+
+  std::string err;
+  const json11::Json json = json11::Json::parse(text.str(), err);
+  if (!err.empty()) {
+    // We cannot use an invalid data file, all samples will be packed
+    // again
+    DX_TRACE("DX: readPreviousLayout error", err);
+    return;
+  }
+
+  // The "frame" bounds of the data file don't include the extruded
+  // pixels (see createDataFile())
+  const int extrude = (m_extrude ? 1: 0);
+  auto readFrame = [this, extrude](const std::string& filename,
+                                   const json11::Json& item) {
+    const json11::Json& frame = item["frame"];
+    if (filename.empty() || !frame.is_object())
+      return;
+
+    const gfx::Rect bounds(frame["x"].int_value() - extrude,
+                           frame["y"].int_value() - extrude,
+                           frame["w"].int_value() + 2*extrude,
+                           frame["h"].int_value() + 2*extrude);
+    if (!bounds.isEmpty())
+      m_previousLayout.bounds[filename] = bounds;
+  };
+
+  const json11::Json& frames = json["frames"];
+  if (frames.is_object()) {     // JsonHash
+    for (const auto& it : frames.object_items())
+      readFrame(it.first, it.second);
+  }
+  else if (frames.is_array()) { // JsonArray
+    for (const auto& item : frames.array_items())
+      readFrame(item["filename"].string_value(), item);
+  }
+
+  const json11::Json& size = json["meta"]["size"];
+  m_previousLayout.textureSize = gfx::Size(size["w"].int_value(),
+                                           size["h"].int_value());
+}
+
+std::string DocExporter::manifestFilename() const
+{
+  return m_textureFilename + ".manifest";
+}
+
+bool DocExporter::readPreviousTexture(PreviousTexture& previous) const
+{
+  const std::string manifestFn = manifestFilename();
+  if (!base::is_file(manifestFn) ||
+      !base::is_file(m_textureFilename))
+    return false;
+
+  std::ifstream in(FSTREAM_PATH(manifestFn));
+  int version = 0;
+  uint64_t textureHash = 0;
+  in >> version >> std::hex >> textureHash >> std::dec;
+  if (!in || version != kManifestVersion)
+    return false;
+
+  uint64_t key;
+  int x, y, w, h;
+  while (in >> std::hex >> key >> std::dec >> x >> y >> w >> h)
+    previous.samples.insert(std::make_tuple(key, x, y, w, h));
+  if (previous.samples.empty())
+    return false;
+
+  std::unique_ptr<Doc> document(load_document(nullptr, m_textureFilename));
+  if (!document)
+    return false;
+
+  const Sprite* sprite = document->sprite();
+  const Layer* layer = sprite->root()->firstLayer();
+  const Cel* cel = (layer ? layer->cel(frame_t(0)): nullptr);
+  if (!cel ||
+      cel->position() != gfx::Point(0, 0) ||
+      cel->image()->size() != sprite->size())
+    return false;
+
+  // The texture file was modified after the manifest was saved (or it
+  // cannot be loaded without changes, e.g. a lossy file format).
+  if (calculate_image_hash64(cel->image()) != textureHash) {
+    DX_TRACE("DX: readPreviousTexture hash doesn't match", manifestFn);
+    return false;
+  }
+
+  previous.image = cel->imageRef();
+  return true;
+}
+
+void DocExporter::saveManifest(const Samples& samples,
+                               const std::vector<uint64_t>& keys,
+                               const doc::Sprite* texture) const
+{
+  ASSERT(int(keys.size()) == samples.size());
+
+  // The texture image can be bigger than the texture sprite if it
+  // was trimmed (see trimTexture())
+  const Image* image = texture->root()->firstLayer()
+    ->cel(frame_t(0))->image();
+  ImageRef trimmed;
+  if (image->size() != texture->size()) {
+    trimmed.reset(crop_image(image, texture->bounds(), image->maskColor()));
+    image = trimmed.get();
+  }
+
+  std::ofstream out(FSTREAM_PATH(manifestFilename()), std::ios::out);
+  out << kManifestVersion << ' '
+      << std::hex << calculate_image_hash64(image) << std::dec << '\n';
+
+  int i = 0;
+  for (const auto& sample : samples) {
+    const uint64_t key = keys[i++];
+    if (sample.isLinked() ||
+        sample.isDuplicated() ||
+        sample.isEmpty())
+      continue;
+
+    const gfx::Rect& rc = sample.inTextureBounds();
+    out << std::hex << key << std::dec << ' '
+        << rc.x << ' ' << rc.y << ' ' << rc.w << ' ' << rc.h << '\n';
+  }
+}
+
 void DocExporter::createDataFile(const Samples& samples,
                                  std::ostream& os,
                                  doc::Sprite* texture)
 {
+  if (m_dataFormat == SpriteSheetDataFormat::MsgPack) {
+    createMsgPackDataFile(samples, os, texture);
+    return;
+  }
+
   std::string frames_begin;
   std::string frames_end;
   bool filename_as_key = false;
@@ -1381,6 +2196,9 @@ void DocExporter::createDataFile(const Samples& samples,
       filename_as_key = false;
       filename_as_attr = true;
       break;
+    case SpriteSheetDataFormat::MsgPack:
+      ASSERT(false);
+      break;
   }
 
   os << "{ \"frames\": " << frames_begin << "\n";
@@ -1445,96 +2263,34 @@ void DocExporter::createDataFile(const Samples& samples,
     os << ",\n"
        << "  \"frameTags\": ["; // TODO rename this someday in the future
 
-    std::set<doc::ObjectId> includedSprites;
-
     bool firstTag = true;
-    for (auto& item : m_documents) {
-      if (item.isOneImageOnly())
-        continue;
-
-      Doc* doc = item.doc;
-      Sprite* sprite = doc->sprite();
+    for (const auto& it : metaTags()) {
+      const std::string& tagname = it.first;
+      const Tag* tag = it.second;
 
-      // Avoid including tags two or more times in the list (e.g. when
-      // -split-layers is specified, several calls of addDocument()
-      // are used for each layer, so we have to avoid iterating the
-      // same sprite several times)
-      if (includedSprites.find(sprite->id()) != includedSprites.end())
-        continue;
-      includedSprites.insert(sprite->id());
-
-      for (Tag* tag : sprite->tags()) {
-        if (firstTag)
-          firstTag = false;
-        else
-          os << ",";
-
-        std::string format = m_tagnameFormat;
-        if (format.empty()) {
-          format = "{tag}";
-        }
+      if (firstTag)
+        firstTag = false;
+      else
+        os << ",";
 
-        FilenameInfo fnInfo;
-        fnInfo
-          .filename(doc->filename())
-          .innerTagName(tag->name());
-        std::string tagname = filename_formatter(format, fnInfo);
-        os << "\n   { \"name\": \"" << escape_for_json(tagname) << "\","
-           << " \"from\": " << (tag->fromFrame()) << ","
-           << " \"to\": " << (tag->toFrame()) << ","
-           " \"direction\": \"" << escape_for_json(convert_anidir_to_string(tag->aniDir())) << "\"";
-        if (tag->repeat() > 0) {
-          os << ", \"repeat\": \"" << tag->repeat() << "\"";
-        }
-        os << tag->userData() << " }";
+      os << "\n   { \"name\": \"" << escape_for_json(tagname) << "\","
+         << " \"from\": " << (tag->fromFrame()) << ","
+         << " \"to\": " << (tag->toFrame()) << ","
+         " \"direction\": \"" << escape_for_json(convert_anidir_to_string(tag->aniDir())) << "\"";
+      if (tag->repeat() > 0) {
+        os << ", \"repeat\": \"" << tag->repeat() << "\"";
       }
+      os << tag->userData() << " }";
     }
     os << "\n  ]";
   }
 
   // meta.layers
   if (m_listLayers || m_listLayerHierarchy) {
-    LayerList metaLayers;
-    for (auto& item : m_documents) {
-      if (item.isOneImageOnly())
-        continue;
-
-      Doc* doc = item.doc;
-      Sprite* sprite = doc->sprite();
-      Layer* root = sprite->root();
-
-      LayerList layers;
-      if (item.selLayers) {
-        // Select all layers (not only browseable ones)
-        layers = item.selLayers->toAllLayersList();
-      }
-      else {
-        // Select all visible layers by default
-        layers = sprite->allVisibleLayers();
-      }
-
-      for (Layer* layer : layers) {
-        // If this layer is inside a group, check that the group will
-        // be included in the meta data too.
-        Layer* group = layer->parent();
-        int pos = int(metaLayers.size());
-        while (group && group != root) {
-          if (std::find(metaLayers.begin(), metaLayers.end(), group) == metaLayers.end()) {
-            metaLayers.insert(metaLayers.begin()+pos, group);
-          }
-          group = group->parent();
-        }
-        // Insert the layer
-        if (std::find(metaLayers.begin(), metaLayers.end(), layer) == metaLayers.end()) {
-          metaLayers.push_back(layer);
-        }
-      }
-    }
-
     bool firstLayer = true;
     os << ",\n"
        << "  \"layers\": [";
-    for (Layer* layer : metaLayers) {
+    for (Layer* layer : metaLayers()) {
       if (firstLayer)
         firstLayer = false;
       else
@@ -1551,41 +2307,28 @@ void DocExporter::createDataFile(const Samples& samples,
       os << layer->userData();
 
       // Cels
-      CelList cels;
-      layer->getCels(cels);
-      bool someCelWithData = false;
-      for (const Cel* cel : cels) {
-        if (cel->zIndex() != 0 ||
-            !cel->data()->userData().isEmpty()) {
-          someCelWithData = true;
-          break;
-        }
-      }
-
-      if (someCelWithData) {
+      const CelList cels = metaCels(layer);
+      if (!cels.empty()) {
         bool firstCel = true;
 
         os << ", \"cels\": [";
         for (const Cel* cel : cels) {
-          if (cel->zIndex() != 0 ||
-              !cel->data()->userData().isEmpty()) {
-            if (firstCel)
-              firstCel = false;
-            else
-              os << ", ";
-
-            os << "{ \"frame\": " << cel->frame();
-            if (cel->opacity() != 255) {
-              os << ", \"opacity\": " << cel->opacity();
-            }
-            if (cel->zIndex() != 0) {
-              os << ", \"zIndex\": " << cel->zIndex();
-            }
-            if (!cel->data()->userData().isEmpty()) {
-              os << cel->data()->userData();
-            }
-            os << " }";
+          if (firstCel)
+            firstCel = false;
+          else
+            os << ", ";
+
+          os << "{ \"frame\": " << cel->frame();
+          if (cel->opacity() != 255) {
+            os << ", \"opacity\": " << cel->opacity();
+          }
+          if (cel->zIndex() != 0) {
+            os << ", \"zIndex\": " << cel->zIndex();
           }
+          if (!cel->data()->userData().isEmpty()) {
+            os << cel->data()->userData();
+          }
+          os << " }";
         }
         os << "]";
       }
@@ -1600,74 +2343,54 @@ void DocExporter::createDataFile(const Samples& samples,
     os << ",\n"
        << "  \"slices\": [";
 
-    std::set<doc::ObjectId> includedSprites;
-
     bool firstSlice = true;
-    for (auto& item : m_documents) {
-      if (item.isOneImageOnly())
-        continue;
-
-      Doc* doc = item.doc;
-      Sprite* sprite = doc->sprite();
-
-      // Avoid including slices two or more times in the list
-      // (e.g. when -split-layers is specified, several calls of
-      // addDocument() are used for each layer, so we have to avoid
-      // iterating the same sprite several times)
-      if (includedSprites.find(sprite->id()) != includedSprites.end())
-        continue;
-      includedSprites.insert(sprite->id());
-
-      // TODO add possibility to export some slices
-
-      for (Slice* slice : sprite->slices()) {
-        if (firstSlice)
-          firstSlice = false;
-        else
-          os << ",";
-        os << "\n   { \"name\": \"" << escape_for_json(slice->name()) << "\""
-           << slice->userData();
-
-        // Keys
-        if (!slice->empty()) {
-          bool firstKey = true;
-
-          os << ", \"keys\": [";
-          for (const auto& key : *slice) {
-            if (firstKey)
-              firstKey = false;
-            else
-              os << ", ";
-
-            const SliceKey* sliceKey = key.value();
-
-            os << "{ \"frame\": " << key.frame() << ", "
-               << "\"bounds\": {"
-               << "\"x\": " << sliceKey->bounds().x << ", "
-               << "\"y\": " << sliceKey->bounds().y << ", "
-               << "\"w\": " << sliceKey->bounds().w << ", "
-               << "\"h\": " << sliceKey->bounds().h << " }";
-
-            if (!sliceKey->center().isEmpty()) {
-              os << ", \"center\": {"
-                 << "\"x\": " << sliceKey->center().x << ", "
-                 << "\"y\": " << sliceKey->center().y << ", "
-                 << "\"w\": " << sliceKey->center().w << ", "
-                 << "\"h\": " << sliceKey->center().h << " }";
-            }
-
-            if (sliceKey->hasPivot()) {
-              os << ", \"pivot\": {"
-                 << "\"x\": " << sliceKey->pivot().x << ", "
-                 << "\"y\": " << sliceKey->pivot().y << " }";
-            }
+    for (const Slice* slice : metaSlices()) {
+      if (firstSlice)
+        firstSlice = false;
+      else
+        os << ",";
+      os << "\n   { \"name\": \"" << escape_for_json(slice->name()) << "\""
+         << slice->userData();
+
+      // Keys
+      if (!slice->empty()) {
+        bool firstKey = true;
+
+        os << ", \"keys\": [";
+        for (const auto& key : *slice) {
+          if (firstKey)
+            firstKey = false;
+          else
+            os << ", ";
+
+          const SliceKey* sliceKey = key.value();
+
+          os << "{ \"frame\": " << key.frame() << ", "
+             << "\"bounds\": {"
+             << "\"x\": " << sliceKey->bounds().x << ", "
+             << "\"y\": " << sliceKey->bounds().y << ", "
+             << "\"w\": " << sliceKey->bounds().w << ", "
+             << "\"h\": " << sliceKey->bounds().h << " }";
+
+          if (!sliceKey->center().isEmpty()) {
+            os << ", \"center\": {"
+               << "\"x\": " << sliceKey->center().x << ", "
+               << "\"y\": " << sliceKey->center().y << ", "
+               << "\"w\": " << sliceKey->center().w << ", "
+               << "\"h\": " << sliceKey->center().h << " }";
+          }
 
-            os << " }";
+          if (sliceKey->hasPivot()) {
+            os << ", \"pivot\": {"
+               << "\"x\": " << sliceKey->pivot().x << ", "
+               << "\"y\": " << sliceKey->pivot().y << " }";
           }
-          os << "]";
+
+          os << " }";
         }
-        os << " }";
+        os << "]";
       }
+      os << " }";
     }
     os << "\n  ]";
   }
@@ -1676,4 +2399,292 @@ void DocExporter::createDataFile(const Samples& samples,
      << "}\n";
 }
 
+// Writes the same data of the "JSON Array" format, but using
+// MessagePack, so runtime loaders can parse it faster. Each frame is
+// written to the stream as soon as it's generated (the data is never
+// accumulated in memory).
+void DocExporter::createMsgPackDataFile(const Samples& samples,
+                                        std::ostream& os,
+                                        doc::Sprite* texture)
+{
+  MsgPackWriter w(os);
+  const int nonExtrudedPosition = (m_extrude ? 1: 0);
+  const int nonExtrudedSize = (m_extrude ? -2: 0);
+
+  w.map(2);
+
+  w.str("frames").array(samples.size());
+  for (const Sample& sample : samples) {
+    const gfx::Size srcSize = sample.originalSize();
+    const gfx::Rect spriteSourceBounds = sample.trimmedBounds();
+    const gfx::Rect frameBounds = sample.inTextureBounds();
+
+    w.map(7);
+    w.str("filename").str(sample.filename());
+    w.str("frame").map(4)
+      .str("x").integer(frameBounds.x + nonExtrudedPosition)
+      .str("y").integer(frameBounds.y + nonExtrudedPosition)
+      .str("w").integer(frameBounds.w + nonExtrudedSize)
+      .str("h").integer(frameBounds.h + nonExtrudedSize);
+    w.str("rotated").boolean(false);
+    w.str("trimmed").boolean(sample.trimmed());
+    w.str("spriteSourceSize").map(4)
+      .str("x").integer(spriteSourceBounds.x)
+      .str("y").integer(spriteSourceBounds.y)
+      .str("w").integer(spriteSourceBounds.w)
+      .str("h").integer(spriteSourceBounds.h);
+    w.str("sourceSize").map(2)
+      .str("w").integer(srcSize.w)
+      .str("h").integer(srcSize.h);
+    w.str("duration").integer(sample.sprite()->frameDuration(sample.frame()));
+  }
+
+  // "meta" property
+  const bool listLayers = (m_listLayers || m_listLayerHierarchy);
+  w.str("meta").map(5 +
+                    (!m_textureFilename.empty() ? 1: 0) +
+                    (m_listTags ? 1: 0) +
+                    (listLayers ? 1: 0) +
+                    (m_listSlices ? 1: 0));
+  w.str("app").str(get_app_url());
+  w.str("version").str(get_app_version());
+  if (!m_textureFilename.empty())
+    w.str("image").str(base::get_file_name(m_textureFilename));
+  w.str("format").str(texture->pixelFormat() == IMAGE_RGB ? "RGBA8888": "I8");
+  w.str("size").map(2)
+    .str("w").integer(texture->width())
+    .str("h").integer(texture->height());
+  w.str("scale").str("1");
+
+  // meta.frameTags
+  if (m_listTags) {
+    const auto tags = metaTags();
+    w.str("frameTags").array(tags.size());
+    for (const auto& it : tags) {
+      const Tag* tag = it.second;
+      w.map(4 +
+            (tag->repeat() > 0 ? 1: 0) +
+            user_data_fields(tag->userData()));
+      w.str("name").str(it.first);
+      w.str("from").integer(tag->fromFrame());
+      w.str("to").integer(tag->toFrame());
+      w.str("direction").str(convert_anidir_to_string(tag->aniDir()));
+      if (tag->repeat() > 0)
+        w.str("repeat").str(base::convert_to<std::string>(tag->repeat()));
+      write_user_data(w, tag->userData());
+    }
+  }
+
+  // meta.layers
+  if (listLayers) {
+    const LayerList layers = metaLayers();
+    w.str("layers").array(layers.size());
+    for (const Layer* layer : layers) {
+      const bool hasGroup = (layer->parent() != layer->sprite()->root());
+      const auto layerImg = dynamic_cast<const LayerImage*>(layer);
+      const CelList cels = metaCels(layer);
+
+      w.map(1 +
+            (hasGroup ? 1: 0) +
+            (layerImg ? 2: 0) +
+            user_data_fields(layer->userData()) +
+            (!cels.empty() ? 1: 0));
+      w.str("name").str(layer->name());
+      if (hasGroup)
+        w.str("group").str(layer->parent()->name());
+      if (layerImg) {
+        w.str("opacity").integer(layerImg->opacity());
+        w.str("blendMode").str(blend_mode_to_string(layerImg->blendMode()));
+      }
+      write_user_data(w, layer->userData());
+
+      if (!cels.empty()) {
+        w.str("cels").array(cels.size());
+        for (const Cel* cel : cels) {
+          const UserData& userData = cel->data()->userData();
+          w.map(1 +
+                (cel->opacity() != 255 ? 1: 0) +
+                (cel->zIndex() != 0 ? 1: 0) +
+                user_data_fields(userData));
+          w.str("frame").integer(cel->frame());
+          if (cel->opacity() != 255)
+            w.str("opacity").integer(cel->opacity());
+          if (cel->zIndex() != 0)
+            w.str("zIndex").integer(cel->zIndex());
+          write_user_data(w, userData);
+        }
+      }
+    }
+  }
+
+  // meta.slices
+  if (m_listSlices) {
+    const auto slices = metaSlices();
+    w.str("slices").array(slices.size());
+    for (const Slice* slice : slices) {
+      w.map(1 +
+            user_data_fields(slice->userData()) +
+            (!slice->empty() ? 1: 0));
+      w.str("name").str(slice->name());
+      write_user_data(w, slice->userData());
+
+      if (!slice->empty()) {
+        w.str("keys").array(slice->size());
+        for (const auto& key : *slice) {
+          const SliceKey* sliceKey = key.value();
+          const gfx::Rect& bounds = sliceKey->bounds();
+          const gfx::Rect& center = sliceKey->center();
+
+          w.map(2 +
+                (!center.isEmpty() ? 1: 0) +
+                (sliceKey->hasPivot() ? 1: 0));
+          w.str("frame").integer(key.frame());
+          w.str("bounds").map(4)
+            .str("x").integer(bounds.x)
+            .str("y").integer(bounds.y)
+            .str("w").integer(bounds.w)
+            .str("h").integer(bounds.h);
+          if (!center.isEmpty()) {
+            w.str("center").map(4)
+              .str("x").integer(center.x)
+              .str("y").integer(center.y)
+              .str("w").integer(center.w)
+              .str("h").integer(center.h);
+          }
+          if (sliceKey->hasPivot()) {
+            w.str("pivot").map(2)
+              .str("x").integer(sliceKey->pivot().x)
+              .str("y").integer(sliceKey->pivot().y);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Returns the tags of all exported sprites (with their final names
+// using the m_tagnameFormat).
+std::vector<std::pair<std::string, const doc::Tag*>> DocExporter::metaTags() const
+{
+  std::vector<std::pair<std::string, const doc::Tag*>> result;
+  std::set<doc::ObjectId> includedSprites;
+
+  for (auto& item : m_documents) {
+    if (item.isOneImageOnly())
+      continue;
+
+    Doc* doc = item.doc;
+    Sprite* sprite = doc->sprite();
+
+    // Avoid including tags two or more times in the list (e.g. when
+    // -split-layers is specified, several calls of addDocument()
+    // are used for each layer, so we have to avoid iterating the
+    // same sprite several times)
+    if (includedSprites.find(sprite->id()) != includedSprites.end())
+      continue;
+    includedSprites.insert(sprite->id());
+
+    for (const Tag* tag : sprite->tags()) {
+      std::string format = m_tagnameFormat;
+      if (format.empty()) {
+        format = "{tag}";
+      }
+
+      FilenameInfo fnInfo;
+      fnInfo
+        .filename(doc->filename())
+        .innerTagName(tag->name());
+      result.push_back(std::make_pair(filename_formatter(format, fnInfo), tag));
+    }
+  }
+  return result;
+}
+
+// Returns the exported layers and their parent groups.
+doc::LayerList DocExporter::metaLayers() const
+{
+  LayerList metaLayers;
+  for (auto& item : m_documents) {
+    if (item.isOneImageOnly())
+      continue;
+
+    Doc* doc = item.doc;
+    Sprite* sprite = doc->sprite();
+    Layer* root = sprite->root();
+
+    LayerList layers;
+    if (item.selLayers) {
+      // Select all layers (not only browseable ones)
+      layers = item.selLayers->toAllLayersList();
+    }
+    else {
+      // Select all visible layers by default
+      layers = sprite->allVisibleLayers();
+    }
+
+    for (Layer* layer : layers) {
+      // If this layer is inside a group, check that the group will
+      // be included in the meta data too.
+      Layer* group = layer->parent();
+      int pos = int(metaLayers.size());
+      while (group && group != root) {
+        if (std::find(metaLayers.begin(), metaLayers.end(), group) == metaLayers.end()) {
+          metaLayers.insert(metaLayers.begin()+pos, group);
+        }
+        group = group->parent();
+      }
+      // Insert the layer
+      if (std::find(metaLayers.begin(), metaLayers.end(), layer) == metaLayers.end()) {
+        metaLayers.push_back(layer);
+      }
+    }
+  }
+  return metaLayers;
+}
+
+// Returns the cels of the layer with extra data (z-index or user
+// data) to be included in the meta data.
+doc::CelList DocExporter::metaCels(const doc::Layer* layer) const
+{
+  CelList cels;
+  layer->getCels(cels);
+  cels.erase(
+    std::remove_if(cels.begin(), cels.end(),
+                   [](const Cel* cel){
+                     return (cel->zIndex() == 0 &&
+                             cel->data()->userData().isEmpty());
+                   }),
+    cels.end());
+  return cels;
+}
+
+// Returns the slices of all exported sprites.
+std::vector<const doc::Slice*> DocExporter::metaSlices() const
+{
+  std::vector<const doc::Slice*> result;
+  std::set<doc::ObjectId> includedSprites;
+
+  for (auto& item : m_documents) {
+    if (item.isOneImageOnly())
+      continue;
+
+    Doc* doc = item.doc;
+    Sprite* sprite = doc->sprite();
+
+    // Avoid including slices two or more times in the list
+    // (e.g. when -split-layers is specified, several calls of
+    // addDocument() are used for each layer, so we have to avoid
+    // iterating the same sprite several times)
+    if (includedSprites.find(sprite->id()) != includedSprites.end())
+      continue;
+    includedSprites.insert(sprite->id());
+
+    // TODO add possibility to export some slices
+
+    for (const Slice* slice : sprite->slices())
+      result.push_back(slice);
+  }
+  return result;
+}
+
 } // namespace app
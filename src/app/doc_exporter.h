@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -13,24 +13,33 @@
 #include "app/sprite_sheet_type.h"
 #include "base/disable_copying.h"
 #include "base/task.h"
+#include "doc/cel_list.h"
 #include "doc/frame.h"
 #include "doc/image_ref.h"
 #include "doc/image_buffer.h"
+#include "doc/layer_list.h"
 #include "doc/object_id.h"
 #include "doc/object_version.h"
 #include "gfx/fwd.h"
 #include "gfx/rect.h"
+#include "gfx/size.h"
 
+#include <cstdint>
 #include <iosfwd>
 #include <memory>
+#include <set>
 #include <string>
+#include <tuple>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace doc {
   class Image;
+  class Layer;
   class SelectedFrames;
   class SelectedLayers;
+  class Slice;
   class Sprite;
   class Tag;
 }
@@ -43,6 +52,7 @@ namespace app {
   class DocExporter {
   public:
     DocExporter();
+    ~DocExporter();
 
     void reset();
     void setDocImageBuffer(const doc::ImageBufferPtr& docBuf);
@@ -80,6 +90,24 @@ namespace app {
     void setListLayerHierarchy(bool value) { m_listLayerHierarchy = value; }
     void setListSlices(bool value) { m_listSlices = value; }
 
+    // Keeps the samples of a packed sprite sheet in the same position
+    // of the previous data file (if they have the same filename and
+    // size), so only new/modified samples are packed.
+    void setIncrementalLayout(bool value) { m_incrementalLayout = value; }
+
+    // Re-uses the pixels of the previous texture file for samples
+    // that didn't change (checking the content hash of each sample
+    // saved in a "<texture>.manifest" file), so only new/modified
+    // samples are rendered.
+    void setIncrementalRender(bool value) { m_incrementalRender = value; }
+
+    // Keeps the renders and trimmed bounds of samples between
+    // exportSheet() calls (this option is not changed by reset()), so
+    // a new export with other layout options (e.g. a new preview of
+    // the sprite sheet with other padding) doesn't render the same
+    // samples again.
+    void setCacheRenders(bool value);
+
     void addImage(
       Doc* doc,
       const doc::ImageRef& image);
@@ -103,9 +131,11 @@ namespace app {
   private:
     class Sample;
     class Samples;
+    class DuplicateSamples;
     class LayoutSamples;
     class SimpleLayoutSamples;
     class BestFitLayoutSamples;
+    class RenderCache;
 
     void addDocument(
       Doc* doc,
@@ -121,12 +151,26 @@ namespace app {
                                  base::task_token& token) const;
     Doc* createEmptyTexture(const Samples& samples,
                             base::task_token& token) const;
+    struct PreviousTexture;
     void renderTexture(Context* ctx,
                        const Samples& samples,
                        doc::Image* textureImage,
+                       const PreviousTexture* previous,
+                       std::vector<uint64_t>* keys,
                        base::task_token& token) const;
     void trimTexture(const Samples& samples, doc::Sprite* texture) const;
     void createDataFile(const Samples& samples, std::ostream& os, doc::Sprite* texture);
+    void createMsgPackDataFile(const Samples& samples, std::ostream& os, doc::Sprite* texture);
+    std::vector<std::pair<std::string, const doc::Tag*>> metaTags() const;
+    doc::LayerList metaLayers() const;
+    doc::CelList metaCels(const doc::Layer* layer) const;
+    std::vector<const doc::Slice*> metaSlices() const;
+    void readPreviousLayout();
+    std::string manifestFilename() const;
+    bool readPreviousTexture(PreviousTexture& previous) const;
+    void saveManifest(const Samples& samples,
+                      const std::vector<uint64_t>& keys,
+                      const doc::Sprite* texture) const;
 
     class Item {
     public:
@@ -183,8 +227,24 @@ namespace app {
     bool m_listLayers;
     bool m_listLayerHierarchy;
     bool m_listSlices;
+    bool m_incrementalLayout;
+    bool m_incrementalRender;
     Items m_documents;
 
+    // Position of each sample (by filename) in the texture of the
+    // previous data file (for the incremental layout).
+    struct PreviousLayout {
+      gfx::Size textureSize;
+      std::unordered_map<std::string, gfx::Rect> bounds;
+    } m_previousLayout;
+
+    // Pixels of the previous texture file and the content hash and
+    // bounds of each sample in it (for the incremental render).
+    struct PreviousTexture {
+      doc::ImageRef image;
+      std::set<std::tuple<uint64_t, int, int, int, int>> samples;
+    };
+
     // Buffers used
     doc::ImageBufferPtr m_docBuf;
     doc::ImageBufferPtr m_sampleBuf;
@@ -198,6 +258,9 @@ namespace app {
       bool trimmedByGrid;
     } m_cache;
 
+    // Renders of samples from previous exports (see setCacheRenders())
+    std::unique_ptr<RenderCache> m_renderCache;
+
     DISABLE_COPYING(DocExporter);
   };
 
@@ -0,0 +1,72 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/context.h"
+#include "app/doc.h"
+#include "app/doc_exporter.h"
+#include "base/fs.h"
+#include "base/task.h"
+#include "tests/benchmark_fixtures.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+
+using namespace app;
+using namespace doc;
+
+// Exports a packed (best fit) sprite sheet of the given number of
+// frames, with and without merging duplicated frames.
+static void BM_ExportSpriteSheet(benchmark::State& state)
+{
+  const int size = state.range(0);
+  const int nframes = state.range(1);
+  const bool mergeDuplicates = (state.range(2) != 0);
+  const char* dataFn = "_bench_sheet.json";
+
+  Context ctx;
+  std::unique_ptr<Doc> doc(
+    new Doc(tests::create_fixture_sprite(ColorMode::RGB, size, size, nframes, 3)));
+  ctx.documents().add(doc.get());
+
+  for (auto _ : state) {
+    DocExporter exporter;
+    exporter.setDataFilename(dataFn);
+    exporter.setDataFormat(SpriteSheetDataFormat::JsonHash);
+    exporter.setSpriteSheetType(SpriteSheetType::Packed);
+    exporter.setMergeDuplicates(mergeDuplicates);
+    exporter.setShapePadding(1);
+    exporter.addDocumentSamples(doc.get(), nullptr,
+                                false, false, false,
+                                nullptr, nullptr);
+
+    base::task_token token;
+    std::unique_ptr<Doc> sheet(exporter.exportSheet(&ctx, token));
+    benchmark::DoNotOptimize(sheet.get());
+  }
+
+  doc->close();
+  base::delete_file(dataFn);
+}
+
+BENCHMARK(BM_ExportSpriteSheet)
+  ->Args({ 32, 64, 0 })
+  ->Args({ 32, 64, 1 })
+  ->Args({ 64, 256, 0 })
+  ->Args({ 64, 256, 1 })
+  ->Args({ 256, 64, 0 })
+  ->Args({ 256, 64, 1 })
+  ->Unit(benchmark::kMillisecond);
+
+int app_main(int argc, char* argv[])
+{
+  ::benchmark::Initialize(&argc, argv);
+  return ::benchmark::RunSpecifiedBenchmarks();
+}
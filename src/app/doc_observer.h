@@ -15,6 +15,7 @@ namespace doc {
 
 namespace app {
   class Doc;
+  class DocChanges;
   class DocEvent;
 
   class DocObserver {
@@ -28,6 +29,11 @@ namespace app {
     // anything in the document could be changed.
     virtual void onGeneralUpdate(DocEvent& ev) { }
 
+    // Called after a transaction is committed/rolled back, or after
+    // undo/redo, with the regions of the document that were modified.
+    // If changes.all() is true, anything could be changed.
+    virtual void onDocChanges(DocEvent& ev, const DocChanges& changes) { }
+
     virtual void onColorSpaceChanged(DocEvent& ev) { }
     virtual void onPixelFormatChanged(DocEvent& ev) { }
     virtual void onPaletteChanged(DocEvent& ev) { }
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -24,6 +24,8 @@
 #include "doc/sprite.h"
 
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #ifdef TRACE_RANGE_OPS
 #include <iostream>
@@ -107,6 +109,11 @@ static DocRange move_or_copy_frames(
     (place == kDocRangeBefore ? dstFrame:
                                 dstFrame+1);
 
+  // Frames to move, all of them are moved at the end with one
+  // DocApi::moveFrames() call (instead of moving all cels after each
+  // frame movement)
+  std::vector<std::pair<frame_t, frame_t>> moves;
+
   for (; srcFrame != srcFrameEnd; ++srcFrame) {
     frame_t fromFrame = (*srcFrame)+srcDelta;
 
@@ -143,10 +150,7 @@ static DocRange move_or_copy_frames(
     switch (op) {
 
       case Move:
-        api.moveFrame(sprite, fromFrame, dstFrame,
-                      (place == kDocRangeBefore ? kDropBeforeFrame:
-                                                  kDropAfterFrame),
-                      tagsHandling);
+        moves.emplace_back(fromFrame, dstFrame);
 
         if (fromFrame < dstBeforeFrame-1) {
           --srcDelta;
@@ -183,6 +187,13 @@ static DocRange move_or_copy_frames(
 #endif
   }
 
+  if (!moves.empty()) {
+    api.moveFrames(sprite, moves,
+                   (place == kDocRangeBefore ? kDropBeforeFrame:
+                                               kDropAfterFrame),
+                   tagsHandling);
+  }
+
   DocRange result;
   if (!srcRange.selectedLayers().empty())
     result.selectLayers(srcRange.selectedLayers());
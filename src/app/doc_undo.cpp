@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -16,8 +16,11 @@
 #include "app/cmd_transaction.h"
 #include "app/console.h"
 #include "app/context.h"
+#include "app/doc_changes.h"
 #include "app/doc_undo_observer.h"
+#include "app/doc_undo_spill_file.h"
 #include "app/pref/preferences.h"
+#include "base/log.h"
 #include "base/mem_utils.h"
 #include "base/scoped_value.h"
 #include "undo/undo_history.h"
@@ -36,6 +39,10 @@ DocUndo::DocUndo()
 {
 }
 
+DocUndo::~DocUndo()
+{
+}
+
 void DocUndo::setContext(Context* ctx)
 {
   m_ctx = ctx;
@@ -68,6 +75,16 @@ void DocUndo::add(CmdTransaction* cmd)
   notify_observers(&DocUndoObserver::onTotalUndoSizeChange, this);
 
   if (App::instance()) {
+    // Move old states to disk (so they don't count in the undo size
+    // limit) when we are over the memory budget.
+    const size_t memoryBudget =
+      size_t(App::instance()->preferences().undo.memoryBudget())
+      * 1024 * 1024;
+    if (memoryBudget > 0 &&
+        m_totalUndoSize > memoryBudget) {
+      spillOldStates(memoryBudget);
+    }
+
     const size_t undoLimitSize =
       int(App::instance()->preferences().undo.sizeLimit())
       * 1024 * 1024;
@@ -110,10 +127,12 @@ void DocUndo::undo()
   {
     const undo::UndoState* state = nextUndo();
     ASSERT(state);
-    const Cmd* cmd = STATE_CMD(state);
+    Cmd* cmd = STATE_CMD(state);
     m_totalUndoSize -= cmd->memSize();
     m_undoHistory.undo();
     m_totalUndoSize += cmd->memSize();
+    if (m_changes)
+      cmd->collectChanges(*m_changes);
   }
   // This notification could execute a script that modifies the sprite
   // again (e.g. a script that is listening the "change" event, check
@@ -132,10 +151,12 @@ void DocUndo::redo()
   {
     const undo::UndoState* state = nextRedo();
     ASSERT(state);
-    const Cmd* cmd = STATE_CMD(state);
+    Cmd* cmd = STATE_CMD(state);
     m_totalUndoSize -= cmd->memSize();
     m_undoHistory.redo();
     m_totalUndoSize += cmd->memSize();
+    if (m_changes)
+      cmd->collectChanges(*m_changes);
   }
   notify_observers(&DocUndoObserver::onCurrentUndoStateChange, this);
   if (m_totalUndoSize != oldSize)
@@ -283,6 +304,10 @@ void DocUndo::moveToState(const undo::UndoState* state)
 
   m_undoHistory.moveTo(state);
 
+  // We don't know exactly which states were undone/redone
+  if (m_changes)
+    m_changes->addAll();
+
   // After onCurrentUndoStateChange don't use the "state" argument, it
   // might be deleted because some script might have modified the
   // sprite on its "change" event.
@@ -314,6 +339,36 @@ const undo::UndoState* DocUndo::nextRedo() const
     return m_undoHistory.firstState();
 }
 
+void DocUndo::spillOldStates(const size_t memoryBudget)
+{
+  try {
+    if (!m_spillFile)
+      m_spillFile = std::make_unique<DocUndoSpillFile>();
+
+    // Oldest states first, the current state is kept in memory as
+    // it's the next one to be undone.
+    const undo::UndoState* state = firstState();
+    while (state &&
+           state != currentState() &&
+           m_totalUndoSize > memoryBudget) {
+      Cmd* cmd = STATE_CMD(state);
+      m_totalUndoSize -= cmd->memSize();
+      cmd->spill(m_spillFile.get());
+      m_totalUndoSize += cmd->memSize();
+      state = state->next();
+    }
+
+    UNDO_TRACE("UNDO: Spilled undo states, new undo size %s (%s on disk)\n",
+               base::get_pretty_memory_size(m_totalUndoSize).c_str(),
+               base::get_pretty_memory_size(m_spillFile->size()).c_str());
+  }
+  catch (const std::exception& ex) {
+    // Keep the states in memory (the undo size limit will discard
+    // them if it's needed)
+    LOG(ERROR, "UNDO: Cannot spill the undo history to disk: %s\n", ex.what());
+  }
+}
+
 void DocUndo::onDeleteUndoState(undo::UndoState* state)
 {
   ASSERT(state);
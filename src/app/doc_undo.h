@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -17,6 +17,7 @@
 #include "undo/undo_history.h"
 
 #include <iosfwd>
+#include <memory>
 #include <string>
 
 namespace app {
@@ -25,7 +26,9 @@ namespace app {
   class Cmd;
   class CmdTransaction;
   class Context;
+  class DocChanges;
   class DocUndoObserver;
+  class DocUndoSpillFile;
 
   // Exception thrown when we want to modify the sprite (add new
   // app::Cmd objects) when we are undoing/redoing/moving throw the
@@ -40,11 +43,16 @@ namespace app {
                   public undo::UndoHistoryDelegate {
   public:
     DocUndo();
+    ~DocUndo();
 
     size_t totalUndoSize() const { return m_totalUndoSize; }
 
     void setContext(Context* ctx);
 
+    // Where the changes of undone/redone commands are collected (the
+    // document must call Doc::notifyChanges() after undo/redo).
+    void setDocChanges(DocChanges* changes) { m_changes = changes; }
+
     void add(CmdTransaction* cmd);
 
     bool canUndo() const;
@@ -103,13 +111,19 @@ namespace app {
   private:
     const undo::UndoState* nextUndo() const;
     const undo::UndoState* nextRedo() const;
+    void spillOldStates(const size_t memoryBudget);
 
     // undo::UndoHistoryDelegate impl
     void onDeleteUndoState(undo::UndoState* state) override;
 
+    // Declared before m_undoHistory as spilled commands keep a
+    // pointer to this file.
+    std::unique_ptr<DocUndoSpillFile> m_spillFile;
+
     undo::UndoHistory m_undoHistory;
     const undo::UndoState* m_savedState = nullptr;
     Context* m_ctx = nullptr;
+    DocChanges* m_changes = nullptr;
     size_t m_totalUndoSize = 0;
 
     // True when we are undoing/redoing. Used to avoid adding new undo
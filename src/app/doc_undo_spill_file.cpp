@@ -0,0 +1,65 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/doc_undo_spill_file.h"
+
+#include "base/debug.h"
+#include "base/exception.h"
+
+namespace app {
+
+DocUndoSpillFile::DocUndoSpillFile()
+  : m_file(std::tmpfile())
+{
+  if (!m_file)
+    throw base::Exception("Cannot create a temporary file for the undo history");
+}
+
+DocUndoSpillFile::~DocUndoSpillFile()
+{
+  std::fclose(m_file);
+}
+
+uint64_t DocUndoSpillFile::write(const base::buffer& data)
+{
+  const uint64_t offset = m_size;
+  seek(offset);
+  if (!data.empty() &&
+      std::fwrite(&data[0], 1, data.size(), m_file) != data.size())
+    throw base::Exception("Error writing the undo history in a temporary file");
+
+  m_size += data.size();
+  return offset;
+}
+
+void DocUndoSpillFile::read(const uint64_t offset, const size_t size,
+                            base::buffer& data)
+{
+  ASSERT(offset+size <= m_size);
+
+  data.resize(size);
+  seek(offset);
+  if (size > 0 &&
+      std::fread(&data[0], 1, size, m_file) != size)
+    throw base::Exception("Error reading the undo history from a temporary file");
+}
+
+void DocUndoSpillFile::seek(const uint64_t offset)
+{
+#ifdef _WIN32
+  const int res = _fseeki64(m_file, int64_t(offset), SEEK_SET);
+#else
+  const int res = fseeko(m_file, off_t(offset), SEEK_SET);
+#endif
+  if (res != 0)
+    throw base::Exception("Error seeking the undo history temporary file");
+}
+
+} // namespace app
@@ -0,0 +1,47 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_DOC_UNDO_SPILL_FILE_H_INCLUDED
+#define APP_DOC_UNDO_SPILL_FILE_H_INCLUDED
+#pragma once
+
+#include "base/buffer.h"
+#include "base/disable_copying.h"
+
+#include <cstdint>
+#include <cstdio>
+
+namespace app {
+
+  // Temporary file where DocUndo moves the payload of old undo states
+  // (see Cmd::spill()) when the undo history exceeds the
+  // "undo.memory_budget" option. Data is only appended (and read
+  // back on demand), the file is deleted when the DocUndo is
+  // destroyed.
+  class DocUndoSpillFile {
+  public:
+    DocUndoSpillFile();
+    ~DocUndoSpillFile();
+
+    // Returns the offset of the written data in the file.
+    uint64_t write(const base::buffer& data);
+    void read(const uint64_t offset, const size_t size,
+              base::buffer& data);
+
+    uint64_t size() const { return m_size; }
+
+  private:
+    void seek(const uint64_t offset);
+
+    std::FILE* m_file;
+    uint64_t m_size = 0;
+
+    DISABLE_COPYING(DocUndoSpillFile);
+  };
+
+} // namespace app
+
+#endif
@@ -0,0 +1,35 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/doc_undo_spill_file.h"
+
+using namespace app;
+
+TEST(DocUndoSpillFile, WriteAndRead)
+{
+  DocUndoSpillFile file;
+  EXPECT_EQ(0, file.size());
+
+  const base::buffer a = { 1, 2, 3 };
+  const base::buffer b(10000, 7);
+  const uint64_t offsetA = file.write(a);
+  const uint64_t offsetB = file.write(b);
+  const uint64_t offsetEmpty = file.write(base::buffer());
+  EXPECT_EQ(0, offsetA);
+  EXPECT_EQ(3, offsetB);
+  EXPECT_EQ(10003, offsetEmpty);
+  EXPECT_EQ(10003, file.size());
+
+  base::buffer data;
+  file.read(offsetB, b.size(), data);
+  EXPECT_EQ(b, data);
+  file.read(offsetA, a.size(), data);
+  EXPECT_EQ(a, data);
+  file.read(offsetEmpty, 0, data);
+  EXPECT_TRUE(data.empty());
+}
@@ -25,6 +25,8 @@
 #include "base/file_handle.h"
 #include "base/fs.h"
 #include "base/fstream_path.h"
+#include "base/time.h"
+#include "fmt/format.h"
 #include "render/dithering_matrix.h"
 #include "ui/widget.h"
 
@@ -44,6 +46,7 @@
 
 #include <fstream>
 #include <queue>
+#include <set>
 #include <sstream>
 #include <string>
 
@@ -59,6 +62,8 @@ namespace {
 const char* kPackageJson = "package.json";
 const char* kInfoJson = "__info.json";
 const char* kPrefLua = "__pref.lua";
+const char* kIndexJson = "__index.json";
+const int kIndexVersion = 1;
 
 class ReadArchive {
 public:
@@ -202,6 +207,84 @@ void write_json_file(const std::string& path, const json11::Json& json)
   out.write(text.c_str(), text.size());
 }
 
+// Returns a string that changes when the file is modified.
+std::string file_stamp(const std::string& fn)
+{
+  const base::Time t = base::get_modification_time(fn);
+  return fmt::format("{:04}{:02}{:02}{:02}{:02}{:02}-{}",
+                     t.year, t.month, t.day,
+                     t.hour, t.minute, t.second,
+                     base::file_size(fn));
+}
+
+// Parsed package.json files of all the installed extensions, saved
+// in the user extensions directory so we don't need to read and
+// parse each package.json file on startup. Each entry is used while
+// the package.json modification time/size doesn't change.
+class PackageIndex {
+public:
+  PackageIndex(const std::string& fn) : m_fn(fn) {
+    if (m_fn.empty() || !base::is_file(m_fn))
+      return;
+    try {
+      json11::Json json;
+      read_json_file(m_fn, json);
+      if (json["version"].int_value() == kIndexVersion)
+        m_entries = json["packages"].object_items();
+    }
+    catch (const std::exception& ex) {
+      LOG("EXT: Error reading extensions index: %s\n", ex.what());
+    }
+  }
+
+  json11::Json package(const std::string& packageFn) {
+    m_used.insert(packageFn);
+
+    const std::string stamp = file_stamp(packageFn);
+    auto it = m_entries.find(packageFn);
+    if (it != m_entries.end() &&
+        it->second["stamp"].string_value() == stamp) {
+      return it->second["package"];
+    }
+
+    json11::Json json;
+    read_json_file(packageFn, json);
+    m_entries[packageFn] = json11::Json::object{ { "stamp", stamp },
+                                                 { "package", json } };
+    m_modified = true;
+    return json;
+  }
+
+  // Saves the index if some package.json was added, modified, or
+  // removed.
+  void save() {
+    for (auto it=m_entries.begin(); it!=m_entries.end(); ) {
+      if (m_used.find(it->first) == m_used.end()) {
+        it = m_entries.erase(it);
+        m_modified = true;
+      }
+      else
+        ++it;
+    }
+
+    if (!m_modified || m_fn.empty())
+      return;
+    try {
+      write_json_file(m_fn, json11::Json::object{ { "version", kIndexVersion },
+                                                  { "packages", m_entries } });
+    }
+    catch (const std::exception& ex) {
+      LOG("EXT: Error writing extensions index: %s\n", ex.what());
+    }
+  }
+
+private:
+  std::string m_fn;
+  json11::Json::object m_entries;
+  std::set<std::string> m_used;
+  bool m_modified = false;
+};
+
 } // anonymous namespace
 
 //////////////////////////////////////////////////////////////////////
@@ -804,6 +887,10 @@ Extensions::Extensions()
     LOG("EXT: User extensions path '%s'\n", m_userExtensionsPath.c_str());
   }
 
+  PackageIndex index(
+    m_userExtensionsPath.empty() ? std::string():
+                                   base::join_path(m_userExtensionsPath, kIndexJson));
+
   ResourceFinder rf;
   rf.includeUserDir("extensions");
   rf.includeDataDir("extensions");
@@ -831,7 +918,7 @@ Extensions::Extensions()
       }
 
       try {
-        loadExtension(dir, fullFn, isBuiltinExtension);
+        loadExtension(dir, index.package(fullFn), isBuiltinExtension);
       }
       catch (const std::exception& ex) {
         LOG("EXT: Error loading JSON file: %s\n",
@@ -839,6 +926,8 @@ Extensions::Extensions()
       }
     }
   }
+
+  index.save();
 }
 
 Extensions::~Extensions()
@@ -1090,10 +1179,9 @@ Extension* Extensions::installCompressedExtension(const std::string& zipFn,
   }
 
   // Load the extension
-  Extension* extension = loadExtension(
-    info.dstPath,
-    base::join_path(info.dstPath, kPackageJson),
-    false);
+  json11::Json json;
+  read_json_file(base::join_path(info.dstPath, kPackageJson), json);
+  Extension* extension = loadExtension(info.dstPath, json, false);
   if (!extension)
     throw base::Exception("Error adding the new extension");
 
@@ -1105,11 +1193,9 @@ Extension* Extensions::installCompressedExtension(const std::string& zipFn,
 }
 
 Extension* Extensions::loadExtension(const std::string& path,
-                                     const std::string& fullPackageFilename,
+                                     const json11::Json& json,
                                      const bool isBuiltinExtension)
 {
-  json11::Json json;
-  read_json_file(fullPackageFilename, json);
   auto name = json["name"].string_value();
   auto version = json["version"].string_value();
   auto displayName = json["displayName"].string_value();
@@ -17,6 +17,10 @@
 #include <string>
 #include <vector>
 
+namespace json11 {
+  class Json;
+}
+
 namespace ui {
   class Widget;
 }
@@ -240,7 +244,7 @@ namespace app {
 
   private:
     Extension* loadExtension(const std::string& path,
-                             const std::string& fullPackageFilename,
+                             const json11::Json& json,
                              const bool isBuiltinExtension);
     void generateExtensionSignals(Extension* extension);
 
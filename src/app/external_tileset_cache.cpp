@@ -0,0 +1,107 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/external_tileset_cache.h"
+
+#include "base/fs.h"
+#include "doc/image.h"
+#include "doc/primitives.h"
+#include "doc/tileset.h"
+#include "fmt/format.h"
+
+#include <algorithm>
+
+namespace app {
+
+namespace {
+
+bool same_time(const base::Time& a, const base::Time& b)
+{
+  return (a.year == b.year &&
+          a.month == b.month &&
+          a.day == b.day &&
+          a.hour == b.hour &&
+          a.minute == b.minute &&
+          a.second == b.second);
+}
+
+} // anonymous namespace
+
+// static
+ExternalTilesetCache* ExternalTilesetCache::instance()
+{
+  static ExternalTilesetCache cache;
+  return &cache;
+}
+
+void ExternalTilesetCache::shareTiles(const std::string& docFilename,
+                                      doc::Tileset* tileset)
+{
+  if (tileset->externalFilename().empty())
+    return;
+
+  std::string filename = tileset->externalFilename();
+  if (!base::is_file(filename))
+    filename = base::join_path(base::get_file_path(docFilename), filename);
+  filename = base::normalize_path(filename);
+
+  const base::Time mtime = base::get_modification_time(filename);
+  const std::string key = fmt::format("{}:{}", filename,
+                                      tileset->externalTileset());
+
+  const std::lock_guard lock(m_mutex);
+  removeUnusedEntries();
+
+  Entry& entry = m_entries[key];
+  if (!same_time(entry.mtime, mtime)) {
+    entry.mtime = mtime;
+    entry.tiles.clear();
+  }
+  if (entry.tiles.size() < tileset->size())
+    entry.tiles.resize(tileset->size());
+
+  bool shared = false;
+  for (doc::tile_index ti=0; ti<tileset->size(); ++ti) {
+    doc::ImageRef tile = tileset->get(ti);
+    if (!tile)
+      continue;
+
+    doc::ImageRef cached = entry.tiles[ti].lock();
+    if (cached && cached != tile &&
+        doc::is_same_image(cached.get(), tile.get())) {
+      tileset->set(ti, cached);
+      shared = true;
+    }
+    else if (!cached) {
+      entry.tiles[ti] = tile;
+      shared = true;
+    }
+  }
+  if (shared)
+    tileset->setSharedTiles(true);
+}
+
+void ExternalTilesetCache::removeUnusedEntries()
+{
+  for (auto it=m_entries.begin(); it!=m_entries.end(); ) {
+    const auto& tiles = it->second.tiles;
+    if (!tiles.empty() &&
+        std::all_of(tiles.begin(), tiles.end(),
+                    [](const std::weak_ptr<doc::Image>& tile) {
+                      return tile.expired();
+                    })) {
+      it = m_entries.erase(it);
+    }
+    else
+      ++it;
+  }
+}
+
+} // namespace app
@@ -0,0 +1,61 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_EXTERNAL_TILESET_CACHE_H_INCLUDED
+#define APP_EXTERNAL_TILESET_CACHE_H_INCLUDED
+#pragma once
+
+#include "base/time.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace doc {
+  class Image;
+  class Tileset;
+}
+
+namespace app {
+
+  // Tile images of external tilesets shared between all documents
+  // loaded in the process. Entries are associated to the path and
+  // modification time of the external file, and to the tileset index
+  // in that file. The cache keeps weak references only, so tile
+  // images are released when the last document using them is closed
+  // (or when all documents have modified their own copies, see
+  // doc::Tileset::unshareTiles()).
+  //
+  // It can be used from several threads at the same time.
+  class ExternalTilesetCache {
+  public:
+    static ExternalTilesetCache* instance();
+
+    // Replaces the tiles of the given tileset (linked to an external
+    // file) with the images already loaded by other documents when
+    // they have the same pixels, and adds the rest of tiles to the
+    // cache. "docFilename" is the file where the tileset was loaded
+    // (used to resolve a relative external filename).
+    void shareTiles(const std::string& docFilename,
+                    doc::Tileset* tileset);
+
+  private:
+    struct Entry {
+      base::Time mtime;
+      std::vector<std::weak_ptr<doc::Image>> tiles;
+    };
+
+    void removeUnusedEntries();
+
+    std::map<std::string, Entry> m_entries;
+    std::mutex m_mutex;
+  };
+
+} // namespace app
+
+#endif
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -11,6 +11,7 @@
 
 #include "app/extra_cel.h"
 
+#include "doc/image_buffer_pool.h"
 #include "doc/sprite.h"
 
 namespace app {
@@ -40,8 +41,15 @@ void ExtraCel::create(const TilemapMode tilemapMode,
       m_image->pixelFormat() != pixelFormat ||
       m_image->width() != imageSize.w ||
       m_image->height() != imageSize.h) {
-    if (!m_imageBuffer)
-      m_imageBuffer.reset(new doc::ImageBuffer(1));
+    // The buffer is taken from the pool the first time, and it goes
+    // back to the pool when this ExtraCel is destroyed, so the next
+    // stroke/transformation reuses its memory. ImageBuffers never
+    // shrink, so resizing the extra cel doesn't re-allocate memory.
+    if (!m_imageBuffer) {
+      m_imageBuffer = doc::ImageBufferPool::instance()->get(
+        std::size_t(imageSize.w) * imageSize.h *
+        doc::bytes_per_pixel_for_colormode(doc::ColorMode(pixelFormat)));
+    }
     doc::Image* newImage = doc::Image::create(pixelFormat,
                                               imageSize.w, imageSize.h,
                                               m_imageBuffer);
@@ -11,18 +11,22 @@
 
 #include "app/context.h"
 #include "app/doc.h"
+#include "app/external_tileset_cache.h"
 #include "app/file/file.h"
 #include "app/file/file_format.h"
 #include "app/file/format_options.h"
+#include "app/util/thread_budget.h"
 #include "base/cfile.h"
 #include "base/exception.h"
 #include "base/file_handle.h"
 #include "base/fs.h"
 #include "base/mem_utils.h"
+#include "base/thread_pool.h"
 #include "dio/aseprite_common.h"
 #include "dio/aseprite_decoder.h"
 #include "dio/decode_delegate.h"
 #include "dio/file_interface.h"
+#include "dio/zlib_stream.h"
 #include "doc/doc.h"
 #include "fixmath/fixmath.h"
 #include "fmt/format.h"
@@ -30,8 +34,14 @@
 #include "ver/info.h"
 #include "zlib.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <thread>
+#include <unordered_map>
 #include <variant>
 
 #define ASEFILE_TRACE(...) // TRACE(__VA_ARGS__)
@@ -88,6 +98,14 @@ public:
     return m_fop->config().cacheCompressedTilesets;
   }
 
+  bool lazyLoadCels() const override {
+    return m_fop->config().lazyLoadCels;
+  }
+
+  bool lazyLoadProperties() const override {
+    return m_fop->config().lazyLoadProperties;
+  }
+
 private:
   FileOp* m_fop;
   doc::Sprite* m_sprite;
@@ -117,6 +135,46 @@ public:
   }
 };
 
+// Scanlines of a tilemap converted to 16-bit tiles (see
+// can_use_16bit_tiles()), written as IMAGE_GRAYSCALE pixels (2 bytes
+// in little-endian).
+class Tilemap16Scanlines : public ScanlinesGen {
+  const Image* m_image;
+  mutable std::vector<uint16_t> m_row;
+public:
+  Tilemap16Scanlines(const Image* image)
+    : m_image(image)
+    , m_row(image->width()) { }
+  gfx::Size getImageSize() const override {
+    return gfx::Size(m_image->width(),
+                     m_image->height());
+  }
+  int getScanlineSize() const override {
+    return 2 * m_image->width();
+  }
+  const uint8_t* getScanlineAddress(int y) const override {
+    auto src = (TilemapTraits::const_address_t)m_image->getPixelAddress(0, y);
+    std::copy(src, src+m_image->width(), m_row.begin());
+    return (const uint8_t*)&m_row[0];
+  }
+};
+
+// Returns true if the tilemap can be saved with 16-bit tiles: all
+// tile indexes are smaller than 64K and there are no flipped tiles.
+// Empty runs are already compressed by zlib.
+static bool can_use_16bit_tiles(const Image* image)
+{
+  ASSERT(image->pixelFormat() == IMAGE_TILEMAP);
+  for (int y=0; y<image->height(); ++y) {
+    auto p = (TilemapTraits::const_address_t)image->getPixelAddress(0, y);
+    for (int x=0; x<image->width(); ++x, ++p) {
+      if (*p > 0xffff)
+        return false;
+    }
+  }
+  return true;
+}
+
 class TilesetScanlines : public ScanlinesGen {
   const Tileset* m_tileset;
 public:
@@ -142,6 +200,100 @@ public:
   }
 };
 
+// Compresses images (cels and tilesets) in a pool of threads before
+// they are written in the file. Each image is identified by its
+// pointer (Image* or Tileset*), and its compressed data can be
+// retrieved with take() from the thread that writes the file.
+class ParallelImageCompressor {
+public:
+  ParallelImageCompressor(const int threads, const int level)
+    : m_pool(threads)
+    , m_level(level) {
+  }
+
+  ~ParallelImageCompressor() {
+    m_pool.wait_all();
+  }
+
+  void add(const void* key,
+           std::unique_ptr<ScanlinesGen>&& gen,
+           const PixelFormat pixelFormat);
+
+  // Waits the compressed data of the given image and removes it from
+  // the queue. Returns false if the image wasn't added to the
+  // compressor. Rethrows any exception that happened compressing
+  // the image.
+  bool take(const void* key, base::buffer& output);
+
+private:
+  struct Item {
+    std::unique_ptr<ScanlinesGen> gen;
+    base::buffer data;
+    std::future<void> ready;
+  };
+
+  base::thread_pool m_pool;
+  int m_level;
+  std::map<const void*, std::shared_ptr<Item>> m_items;
+};
+
+// Returns the zlib compression level to save images (the
+// FileOpConfig::aseCompressionLevel value clamped to a valid level).
+static int compression_level(const FileOp* fop)
+{
+  const int level = fop->config().aseCompressionLevel;
+  if (level < 0)
+    return Z_DEFAULT_COMPRESSION;
+  return std::clamp(level, Z_NO_COMPRESSION, Z_BEST_COMPRESSION);
+}
+
+// Cels that can be saved as a link to a previous cel of the same
+// layer (duplicated cel -> original cel)
+using DuplicatedCels = std::map<const Cel*, const Cel*>;
+
+static void find_duplicated_cels(const Layer* layer,
+                                 const frame_t fromFrame,
+                                 const frame_t toFrame,
+                                 DuplicatedCels& dups)
+{
+  if (layer->isImage()) {
+    // Unlinked cels indexed by the hash of their image
+    std::unordered_multimap<uint64_t, const Cel*> cels;
+
+    for (frame_t frame=fromFrame; frame<=toFrame; ++frame) {
+      const Cel* cel = layer->cel(frame);
+      if (!cel || cel->link() || !cel->image())
+        continue;
+
+      const Image* image = cel->image();
+      const uint64_t hash = calculate_image_hash64(image);
+      const Cel* original = nullptr;
+
+      auto range = cels.equal_range(hash);
+      for (auto it=range.first; it!=range.second; ++it) {
+        const Cel* other = it->second;
+        if (other->bounds() == cel->bounds() &&
+            other->opacity() == cel->opacity() &&
+            other->zIndex() == cel->zIndex() &&
+            other->data()->userData() == cel->data()->userData() &&
+            is_same_image(other->image(), image)) {
+          original = other;
+          break;
+        }
+      }
+
+      if (original)
+        dups[cel] = original;
+      else
+        cels.insert(std::make_pair(hash, cel));
+    }
+  }
+  else if (layer->isGroup()) {
+    for (const Layer* child : static_cast<const LayerGroup*>(layer)->layers())
+      find_duplicated_cels(child, fromFrame, toFrame, dups);
+  }
+}
+
 } // anonymous namespace
 
 static void ase_file_prepare_header(FILE* f, dio::AsepriteHeader* header, const Sprite* sprite,
@@ -156,9 +308,15 @@ static void ase_file_write_layers(FILE* f, FileOp* fop,
                                   dio::AsepriteFrameHeader* frame_header,
                                   const dio::AsepriteExternalFiles& ext_files,
                                   const Layer* layer, int child_level);
+static void ase_file_compress_images(FileOp* fop,
+                                     const Sprite* sprite,
+                                     const DuplicatedCels& dups,
+                                     ParallelImageCompressor& compressor);
 static layer_t ase_file_write_cels(FILE* f,  FileOp* fop,
                                    dio::AsepriteFrameHeader* frame_header,
                                    const dio::AsepriteExternalFiles& ext_files,
+                                   ParallelImageCompressor* compressor,
+                                   const DuplicatedCels& dups,
                                    const Sprite* sprite, const Layer* layer,
                                    layer_t layer_index,
                                    const frame_t frame);
@@ -172,8 +330,11 @@ static void ase_file_write_close_chunk(FILE* f, dio::AsepriteChunk* chunk);
 static void ase_file_write_color2_chunk(FILE* f, dio::AsepriteFrameHeader* frame_header, const Palette* pal);
 static void ase_file_write_palette_chunk(FILE* f, dio::AsepriteFrameHeader* frame_header, const Palette* pal, int from, int to);
 static void ase_file_write_layer_chunk(FILE* f, dio::AsepriteFrameHeader* frame_header, const Layer* layer, int child_level);
-static void ase_file_write_cel_chunk(FILE* f, dio::AsepriteFrameHeader* frame_header,
+static void ase_file_write_cel_chunk(FILE* f, FileOp* fop,
+                                     dio::AsepriteFrameHeader* frame_header,
+                                     ParallelImageCompressor* compressor,
                                      const Cel* cel,
+                                     const Cel* duplicateOf,
                                      const LayerImage* layer,
                                      const layer_t layer_index,
                                      const Sprite* sprite,
@@ -206,10 +367,12 @@ static void ase_file_write_external_files_chunk(FILE* f, FileOp* fop,
 static void ase_file_write_tileset_chunks(FILE* f, FileOp* fop,
                                           dio::AsepriteFrameHeader* frame_header,
                                           const dio::AsepriteExternalFiles& ext_files,
+                                          ParallelImageCompressor* compressor,
                                           const Tilesets* tilesets);
 static void ase_file_write_tileset_chunk(FILE* f, FileOp* fop,
                                          dio::AsepriteFrameHeader* frame_header,
                                          const dio::AsepriteExternalFiles& ext_files,
+                                         ParallelImageCompressor* compressor,
                                          const Tileset* tileset,
                                          const tileset_index si);
 static void ase_file_write_properties_maps(FILE* f, FileOp* fop,
@@ -291,6 +454,14 @@ bool AseFormat::onLoad(FileOp* fop)
 
   Sprite* sprite = delegate.sprite();
 
+  // Share tiles of external tilesets with other documents
+  if (sprite->hasTilesets()) {
+    for (Tileset* tileset : *sprite->tilesets()) {
+      if (tileset && !tileset->externalFilename().empty())
+        ExternalTilesetCache::instance()->shareTiles(fop->filename(), tileset);
+    }
+  }
+
   // Assign RgbMap
   if (sprite->pixelFormat() == IMAGE_INDEXED)
     sprite->rgbMap(0, Sprite::RgbMapFor(sprite->isOpaque()),
@@ -350,7 +521,7 @@ bool AseFormat::onPostLoad(FileOp* fop)
 bool AseFormat::onSave(FileOp* fop)
 {
   const Sprite* sprite = fop->document()->sprite();
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(open_file_with_exception_sync_on_close(fop->outputFilename(), "wb"));
   FILE* f = handle.get();
 
   // Write the header
@@ -360,6 +531,26 @@ bool AseFormat::onSave(FileOp* fop)
                           fop->roi().frames());
   ase_file_write_header(f, &header);
 
+  // Identical cels are saved as linked cels
+  DuplicatedCels dups;
+  if (fop->config().aseDedupeCels) {
+    find_duplicated_cels(sprite->root(),
+                         fop->roi().fromFrame(),
+                         fop->roi().toFrame(), dups);
+  }
+
+  // Compress all cels/tilesets in parallel (they are written in the
+  // file in order as soon as they are ready)
+  const ThreadBudget budget(std::thread::hardware_concurrency(),
+                           ThreadPriority::Export);
+  const int threads = budget.threads();
+  std::unique_ptr<ParallelImageCompressor> compressor;
+  if (threads > 1) {
+    compressor = std::make_unique<ParallelImageCompressor>(
+      threads, compression_level(fop));
+    ase_file_compress_images(fop, sprite, dups, *compressor);
+  }
+
   bool require_new_palette_chunk = false;
   for (Palette* pal : sprite->getPalettes()) {
     if (pal->size() > 256 || pal->hasAlpha()) {
@@ -416,6 +607,7 @@ bool AseFormat::onSave(FileOp* fop)
 
       // Write tilesets
       ase_file_write_tileset_chunks(f, fop, &frame_header, ext_files,
+                                    compressor.get(),
                                     sprite->tilesets());
 
       // Writer frame tags
@@ -446,6 +638,7 @@ bool AseFormat::onSave(FileOp* fop)
 
     // Write cel chunks
     ase_file_write_cels(f, fop, &frame_header, ext_files,
+                        compressor.get(), dups,
                         sprite, sprite->root(),
                         0, frame);
 
@@ -590,9 +783,64 @@ static void ase_file_write_layers(FILE* f, FileOp* fop,
   }
 }
 
+static void ase_file_compress_layer_images(const Layer* layer,
+                                           const frame_t frame,
+                                           const DuplicatedCels& dups,
+                                           ParallelImageCompressor& compressor)
+{
+  if (layer->isImage()) {
+    const Cel* cel = layer->cel(frame);
+    // Linked cels are added only once (as we use the image pointer as
+    // the key in the compressor), and duplicated cels are not added
+    // (they are saved as links).
+    if (cel && cel->image() && dups.find(cel) == dups.end()) {
+      const Image* image = cel->image();
+      if (image->pixelFormat() == IMAGE_TILEMAP &&
+          can_use_16bit_tiles(image)) {
+        compressor.add(image,
+                       std::make_unique<Tilemap16Scanlines>(image),
+                       IMAGE_GRAYSCALE);
+      }
+      else {
+        compressor.add(image,
+                       std::make_unique<ImageScanlines>(image),
+                       image->pixelFormat());
+      }
+    }
+  }
+  else if (layer->isGroup()) {
+    for (const Layer* child : static_cast<const LayerGroup*>(layer)->layers())
+      ase_file_compress_layer_images(child, frame, dups, compressor);
+  }
+}
+
+static void ase_file_compress_images(FileOp* fop,
+                                     const Sprite* sprite,
+                                     const DuplicatedCels& dups,
+                                     ParallelImageCompressor& compressor)
+{
+  // Tilesets are written in the first frame
+  for (const Tileset* tileset : *sprite->tilesets()) {
+    if (tileset &&
+        tileset->externalFilename().empty() &&
+        (tileset->compressedData().empty() ||
+         tileset->compressedDataVersion() != tileset->version())) {
+      compressor.add(tileset,
+                     std::make_unique<TilesetScanlines>(tileset),
+                     tileset->sprite()->pixelFormat());
+    }
+  }
+
+  // Cels in the same order they are written
+  for (frame_t frame : fop->roi().framesSequence())
+    ase_file_compress_layer_images(sprite->root(), frame, dups, compressor);
+}
+
 static layer_t ase_file_write_cels(FILE* f, FileOp* fop,
                                    dio::AsepriteFrameHeader* frame_header,
                                    const dio::AsepriteExternalFiles& ext_files,
+                                   ParallelImageCompressor* compressor,
+                                   const DuplicatedCels& dups,
                                    const Sprite* sprite, const Layer* layer,
                                    layer_t layer_index,
                                    const frame_t frame)
@@ -600,14 +848,18 @@ static layer_t ase_file_write_cels(FILE* f, FileOp* fop,
   if (layer->isImage()) {
     const Cel* cel = layer->cel(frame);
     if (cel) {
-      ase_file_write_cel_chunk(f, frame_header, cel,
+      auto dup = dups.find(cel);
+      const Cel* duplicateOf = (dup != dups.end() ? dup->second: nullptr);
+
+      ase_file_write_cel_chunk(f, fop, frame_header, compressor,
+                               cel, duplicateOf,
                                static_cast<const LayerImage*>(layer),
                                layer_index, sprite, fop->roi().fromFrame());
 
       if (layer->isReference())
         ase_file_write_cel_extra_chunk(f, frame_header, cel);
 
-      if (!cel->link() &&
+      if (!cel->link() && !duplicateOf &&
           !cel->data()->userData().isEmpty()) {
         ase_file_write_user_data_chunk(f, fop, frame_header, ext_files,
                                        &cel->data()->userData());
@@ -621,8 +873,8 @@ static layer_t ase_file_write_cels(FILE* f, FileOp* fop,
   if (layer->isGroup()) {
     for (const Layer* child : static_cast<const LayerGroup*>(layer)->layers()) {
       layer_index =
-        ase_file_write_cels(f, fop, frame_header, ext_files, sprite, child,
-                            layer_index, frame);
+        ase_file_write_cels(f, fop, frame_header, ext_files, compressor,
+                            dups, sprite, child, layer_index, frame);
     }
   }
 
@@ -873,22 +1125,15 @@ static void write_raw_image(FILE* f, ScanlinesGen* gen, PixelFormat pixelFormat)
 // Compressed Image
 //////////////////////////////////////////////////////////////////////
 
-template<typename ImageTraits>
-static void write_compressed_image_templ(FILE* f,
-                                         ScanlinesGen* gen,
-                                         base::buffer* compressedOutput)
+template<typename ImageTraits, typename Output>
+static void compress_image_templ(const ScanlinesGen* gen,
+                                 const int level,
+                                 Output output)
 {
   PixelIO<ImageTraits> pixel_io;
-  z_stream zstream;
+  dio::DeflateStream zstream(level);
   int y, err;
 
-  zstream.zalloc = (alloc_func)0;
-  zstream.zfree  = (free_func)0;
-  zstream.opaque = (voidpf)0;
-  err = deflateInit(&zstream, Z_DEFAULT_COMPRESSION);
-  if (err != Z_OK)
-    throw base::Exception("ZLib error %d in deflateInit().", err);
-
   std::vector<uint8_t> scanline(gen->getScanlineSize());
   std::vector<uint8_t> compressed(4096);
 
@@ -899,64 +1144,142 @@ static void write_compressed_image_templ(FILE* f,
 
     pixel_io.write_scanline(address, imgSize.w, &scanline[0]);
 
-    zstream.next_in = (Bytef*)&scanline[0];
-    zstream.avail_in = scanline.size();
+    zstream->next_in = (Bytef*)&scanline[0];
+    zstream->avail_in = scanline.size();
     int flush = (y == imgSize.h-1 ? Z_FINISH: Z_NO_FLUSH);
 
     do {
-      zstream.next_out = (Bytef*)&compressed[0];
-      zstream.avail_out = compressed.size();
+      zstream->next_out = (Bytef*)&compressed[0];
+      zstream->avail_out = compressed.size();
 
       // Compress
-      err = deflate(&zstream, flush);
+      err = deflate(zstream.get(), flush);
       if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
         throw base::Exception("ZLib error %d in deflate().", err);
 
-      int output_bytes = compressed.size() - zstream.avail_out;
-      if (output_bytes > 0) {
-        if ((fwrite(&compressed[0], 1, output_bytes, f) != (size_t)output_bytes)
-            || ferror(f))
-          throw base::Exception("Error writing compressed image pixels.\n");
-
-        // Save the whole compressed buffer to re-use in following
-        // save options (so we don't have to re-compress the whole
-        // tileset)
-        if (compressedOutput) {
-          std::size_t n = compressedOutput->size();
-          compressedOutput->resize(n + output_bytes);
-          std::copy(compressed.begin(),
-                    compressed.begin() + output_bytes,
-                    compressedOutput->begin() + n);
-        }
+      int output_bytes = compressed.size() - zstream->avail_out;
+      if (output_bytes > 0)
+        output(&compressed[0], output_bytes);
+    } while (zstream->avail_out == 0);
+  }
+}
+
+template<typename ImageTraits>
+static void write_compressed_image_templ(FILE* f,
+                                         ScanlinesGen* gen,
+                                         const int level,
+                                         base::buffer* compressedOutput)
+{
+  compress_image_templ<ImageTraits>(
+    gen, level,
+    [f, compressedOutput](const uint8_t* data, const int output_bytes) {
+      if ((fwrite(data, 1, output_bytes, f) != (size_t)output_bytes)
+          || ferror(f))
+        throw base::Exception("Error writing compressed image pixels.\n");
+
+      // Save the whole compressed buffer to re-use in following
+      // save options (so we don't have to re-compress the whole
+      // tileset)
+      if (compressedOutput) {
+        std::size_t n = compressedOutput->size();
+        compressedOutput->resize(n + output_bytes);
+        std::copy(data, data + output_bytes,
+                  compressedOutput->begin() + n);
       }
-    } while (zstream.avail_out == 0);
+    });
+}
+
+template<typename ImageTraits>
+static void compress_image_to_buffer_templ(const ScanlinesGen* gen,
+                                           const int level,
+                                           base::buffer& output)
+{
+  compress_image_templ<ImageTraits>(
+    gen, level,
+    [&output](const uint8_t* data, const int output_bytes) {
+      output.insert(output.end(), data, data + output_bytes);
+    });
+}
+
+static void compress_image_to_buffer(const ScanlinesGen* gen,
+                                     PixelFormat pixelFormat,
+                                     const int level,
+                                     base::buffer& output)
+{
+  switch (pixelFormat) {
+    case IMAGE_RGB:
+      compress_image_to_buffer_templ<RgbTraits>(gen, level, output);
+      break;
+
+    case IMAGE_GRAYSCALE:
+      compress_image_to_buffer_templ<GrayscaleTraits>(gen, level, output);
+      break;
+
+    case IMAGE_INDEXED:
+      compress_image_to_buffer_templ<IndexedTraits>(gen, level, output);
+      break;
+
+    case IMAGE_TILEMAP:
+      compress_image_to_buffer_templ<TilemapTraits>(gen, level, output);
+      break;
   }
+}
+
+void ParallelImageCompressor::add(const void* key,
+                                  std::unique_ptr<ScanlinesGen>&& gen,
+                                  const PixelFormat pixelFormat)
+{
+  if (m_items.find(key) != m_items.end())
+    return;
+
+  auto item = std::make_shared<Item>();
+  item->gen = std::move(gen);
 
-  err = deflateEnd(&zstream);
-  if (err != Z_OK)
-    throw base::Exception("ZLib error %d in deflateEnd().", err);
+  auto task = std::make_shared<std::packaged_task<void()>>(
+    [item, pixelFormat, level = m_level]{
+      compress_image_to_buffer(item->gen.get(), pixelFormat, level, item->data);
+    });
+  item->ready = task->get_future();
+  m_items[key] = item;
+
+  m_pool.execute([task]{ (*task)(); });
+}
+
+bool ParallelImageCompressor::take(const void* key, base::buffer& output)
+{
+  auto it = m_items.find(key);
+  if (it == m_items.end())
+    return false;
+
+  std::shared_ptr<Item> item = it->second;
+  m_items.erase(it);
+
+  item->ready.get();            // Can throw the compression exception
+  output = std::move(item->data);
+  return true;
 }
 
 static void write_compressed_image(FILE* f,
                                    ScanlinesGen* gen,
                                    PixelFormat pixelFormat,
+                                   const int level,
                                    base::buffer* compressedOutput = nullptr)
 {
   switch (pixelFormat) {
     case IMAGE_RGB:
-      write_compressed_image_templ<RgbTraits>(f, gen, compressedOutput);
+      write_compressed_image_templ<RgbTraits>(f, gen, level, compressedOutput);
       break;
 
     case IMAGE_GRAYSCALE:
-      write_compressed_image_templ<GrayscaleTraits>(f, gen, compressedOutput);
+      write_compressed_image_templ<GrayscaleTraits>(f, gen, level, compressedOutput);
       break;
 
     case IMAGE_INDEXED:
-      write_compressed_image_templ<IndexedTraits>(f, gen, compressedOutput);
+      write_compressed_image_templ<IndexedTraits>(f, gen, level, compressedOutput);
       break;
 
     case IMAGE_TILEMAP:
-      write_compressed_image_templ<TilemapTraits>(f, gen, compressedOutput);
+      write_compressed_image_templ<TilemapTraits>(f, gen, level, compressedOutput);
       break;
   }
 }
@@ -965,8 +1288,11 @@ static void write_compressed_image(FILE* f,
 // Cel Chunk
 //////////////////////////////////////////////////////////////////////
 
-static void ase_file_write_cel_chunk(FILE* f, dio::AsepriteFrameHeader* frame_header,
+static void ase_file_write_cel_chunk(FILE* f, FileOp* fop,
+                                     dio::AsepriteFrameHeader* frame_header,
+                                     ParallelImageCompressor* compressor,
                                      const Cel* cel,
+                                     const Cel* duplicateOf,
                                      const LayerImage* layer,
                                      const layer_t layer_index,
                                      const Sprite* sprite,
@@ -974,7 +1300,7 @@ static void ase_file_write_cel_chunk(FILE* f, dio::AsepriteFrameHeader* frame_he
 {
   ChunkWriter chunk(f, frame_header, ASE_FILE_CHUNK_CEL);
 
-  const Cel* link = cel->link();
+  const Cel* link = (duplicateOf ? duplicateOf: cel->link());
 
   // In case the original link is outside the ROI, we've to find the
   // first linked cel that is inside the ROI.
@@ -1036,8 +1362,15 @@ static void ase_file_write_cel_chunk(FILE* f, dio::AsepriteFrameHeader* frame_he
         fputw(image->width(), f);
         fputw(image->height(), f);
 
-        ImageScanlines scan(image);
-        write_compressed_image(f, &scan, image->pixelFormat());
+        base::buffer data;
+        if (compressor && compressor->take(image, data)) {
+          fwrite(&data[0], 1, data.size(), f);
+        }
+        else {
+          ImageScanlines scan(image);
+          write_compressed_image(f, &scan, image->pixelFormat(),
+                                 compression_level(fop));
+        }
       }
       else {
         // Width and height
@@ -1052,17 +1385,41 @@ static void ase_file_write_cel_chunk(FILE* f, dio::AsepriteFrameHeader* frame_he
       ASSERT(image);
       ASSERT(image->pixelFormat() == IMAGE_TILEMAP);
 
+      // TODO use 8-bit tiles when possible
+      const bool use16bits = can_use_16bit_tiles(image);
+
       fputw(image->width(), f);
       fputw(image->height(), f);
-      fputw(32, f);             // TODO use different bpp when possible
-      fputl(tile_i_mask, f);
-      fputl(tile_f_xflip, f);
-      fputl(tile_f_yflip, f);
-      fputl(tile_f_dflip, f);
+      if (use16bits) {
+        fputw(16, f);
+        fputl(0xffff, f);
+        fputl(0, f);            // No flags in 16-bit tiles
+        fputl(0, f);
+        fputl(0, f);
+      }
+      else {
+        fputw(32, f);
+        fputl(tile_i_mask, f);
+        fputl(tile_f_xflip, f);
+        fputl(tile_f_yflip, f);
+        fputl(tile_f_dflip, f);
+      }
       ase_file_write_padding(f, 10);
 
-      ImageScanlines scan(image);
-      write_compressed_image(f, &scan, IMAGE_TILEMAP);
+      base::buffer data;
+      if (compressor && compressor->take(image, data)) {
+        fwrite(&data[0], 1, data.size(), f);
+      }
+      else if (use16bits) {
+        Tilemap16Scanlines scan(image);
+        write_compressed_image(f, &scan, IMAGE_GRAYSCALE,
+                               compression_level(fop));
+      }
+      else {
+        ImageScanlines scan(image);
+        write_compressed_image(f, &scan, IMAGE_TILEMAP,
+                               compression_level(fop));
+      }
     }
   }
 }
@@ -1413,13 +1770,14 @@ static void ase_file_write_external_files_chunk(
 static void ase_file_write_tileset_chunks(FILE* f, FileOp* fop,
                                           dio::AsepriteFrameHeader* frame_header,
                                           const dio::AsepriteExternalFiles& ext_files,
+                                          ParallelImageCompressor* compressor,
                                           const Tilesets* tilesets)
 {
   tileset_index si = 0;
   for (const Tileset* tileset : *tilesets) {
     if (tileset) {
       ase_file_write_tileset_chunk(f, fop, frame_header, ext_files,
-                                   tileset, si);
+                                   compressor, tileset, si);
 
       ase_file_write_user_data_chunk(f, fop, frame_header, ext_files, &tileset->userData());
 
@@ -1436,6 +1794,7 @@ static void ase_file_write_tileset_chunks(FILE* f, FileOp* fop,
 static void ase_file_write_tileset_chunk(FILE* f, FileOp* fop,
                                          dio::AsepriteFrameHeader* frame_header,
                                          const dio::AsepriteExternalFiles& ext_files,
+                                         ParallelImageCompressor* compressor,
                                          const Tileset* tileset,
                                          const tileset_index si)
 {
@@ -1496,6 +1855,17 @@ static void ase_file_write_tileset_chunk(FILE* f, FileOp* fop,
       fputl(data.size(), f); // Compressed data length
       fwrite(&data[0], 1, data.size(), f);
     }
+    // Save the tileset compressed in the pool of threads
+    else if (base::buffer data;
+             compressor && compressor->take(tileset, data)) {
+      ASEFILE_TRACE("[%d] saving tileset compressed in parallel\n", tileset->id());
+
+      fputl(data.size(), f); // Compressed data length
+      fwrite(&data[0], 1, data.size(), f);
+
+      if (fop->config().cacheCompressedTilesets)
+        tileset->setCompressedData(data);
+    }
     // Compress and save the tileset now
     else {
       fputl(0, f);                  // Field for compressed data length (completed later)
@@ -1509,6 +1879,7 @@ static void ase_file_write_tileset_chunk(FILE* f, FileOp* fop,
         compressedDataPtr = &compressedData;
 
       write_compressed_image(f, &gen, tileset->sprite()->pixelFormat(),
+                             compression_level(fop),
                              compressedDataPtr);
 
       // As we've just compressed the tileset, we can cache this same
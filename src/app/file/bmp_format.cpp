@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -21,9 +21,13 @@
 #include "app/file/format_options.h"
 #include "base/cfile.h"
 #include "base/file_handle.h"
+#include "dio/pixel_io.h"
 #include "doc/doc.h"
 #include "fmt/format.h"
 
+#include <algorithm>
+#include <vector>
+
 namespace app {
 
 // Max supported .bmp size (to filter out invalid image sizes)
@@ -621,61 +625,51 @@ static void read_8bit_line(int length, FILE *f, Image *image, int line)
   }
 }
 
-static void read_16bit_line(int length, FILE *f, Image *image, int line, bool& withAlpha)
+// Reads a whole row of 16/24/32 bpp pixels (including the padding
+// to 4 bytes) in "buffer". The pixels that cannot be read (truncated
+// file) are zeroed.
+static const uint8_t* read_rgb_row(int length, int bpp, FILE *f,
+                                   std::vector<uint8_t>& buffer)
 {
-  int i, r, g, b, a, word;
-
-  for (i=0; i<length; i++) {
-    word = fgetw(f);
-
-    r = (word >> 10) & 0x1f;
-    g = (word >> 5) & 0x1f;
-    b = (word) & 0x1f;
-    a = (word & 0x8000 ? 255 : 0);
-    if (a)
-      withAlpha = true;
-    put_pixel(image, i, line,
-              rgba(scale_5bits_to_8bits(r),
-                   scale_5bits_to_8bits(g),
-                   scale_5bits_to_8bits(b), a));
-  }
-
-  i = (2*i) % 4;
-  if (i > 0)
-    while (i++ < 4)
-      fgetc(f);
+  const size_t rowSize = ((size_t(length)*bpp + 31) / 32) * 4;
+  buffer.resize(rowSize);
+  const size_t n = fread(buffer.data(), 1, rowSize, f);
+  if (n < rowSize)
+    std::fill(buffer.begin()+n, buffer.end(), 0);
+  return buffer.data();
 }
 
-static void read_24bit_line(int length, FILE *f, Image *image, int line)
+static void read_16bit_line(int length, FILE *f, Image *image, int line,
+                            std::vector<uint8_t>& buffer, bool& withAlpha)
 {
-  int i, r, g, b;
-
-  for (i=0; i<length; i++) {
-    b = fgetc(f);
-    g = fgetc(f);
-    r = fgetc(f);
-    put_pixel(image, i, line, rgba(r, g, b, 255));
-  }
+  const uint8_t* src = read_rgb_row(length, 16, f, buffer);
+  auto dst = (RgbTraits::address_t)image->getPixelAddress(0, line);
+  if (dio::read_rgb555_scanline(src, length, dst))
+    withAlpha = true;
+}
 
-  i = (3*i) % 4;
-  if (i > 0)
-    while (i++ < 4)
-      fgetc(f);
+static void read_24bit_line(int length, FILE *f, Image *image, int line,
+                            std::vector<uint8_t>& buffer)
+{
+  const uint8_t* src = read_rgb_row(length, 24, f, buffer);
+  auto dst = (RgbTraits::address_t)image->getPixelAddress(0, line);
+  dio::read_rgb_scanline(src, length, dio::ScanlineLayout::BGR, dst);
 }
 
 static void read_32bit_line(int length, FILE *f, Image *image, int line,
-                            bool& withAlpha)
+                            std::vector<uint8_t>& buffer, bool& withAlpha)
 {
-  int i, r, g, b, a;
+  const uint8_t* src = read_rgb_row(length, 32, f, buffer);
+  auto dst = (RgbTraits::address_t)image->getPixelAddress(0, line);
+  dio::read_rgb_scanline(src, length, dio::ScanlineLayout::BGRA, dst);
 
-  for (i=0; i<length; i++) {
-    b = fgetc(f);
-    g = fgetc(f);
-    r = fgetc(f);
-    a = fgetc(f);
-    if (a)
-      withAlpha = true;
-    put_pixel(image, i, line, rgba(r, g, b, a));
+  if (!withAlpha) {
+    for (int i=0; i<length; ++i) {
+      if (rgba_geta(dst[i])) {
+        withAlpha = true;
+        break;
+      }
+    }
   }
 }
 
@@ -685,6 +679,7 @@ static void read_32bit_line(int length, FILE *f, Image *image, int line,
 static void read_image(FILE *f, Image *image, const BITMAPINFOHEADER *infoheader, FileOp *fop, bool& withAlpha)
 {
   int i, line, height, dir;
+  std::vector<uint8_t> buffer;
 
   height = (int)infoheader->biHeight;
   line   = height < 0 ? 0: height-1;
@@ -697,9 +692,9 @@ static void read_image(FILE *f, Image *image, const BITMAPINFOHEADER *infoheader
       case 2: read_2bit_line(infoheader->biWidth, f, image, line); break;
       case 4: read_4bit_line(infoheader->biWidth, f, image, line); break;
       case 8: read_8bit_line(infoheader->biWidth, f, image, line); break;
-      case 16: read_16bit_line(infoheader->biWidth, f, image, line, withAlpha); break;
-      case 24: read_24bit_line(infoheader->biWidth, f, image, line); break;
-      case 32: read_32bit_line(infoheader->biWidth, f, image, line, withAlpha); break;
+      case 16: read_16bit_line(infoheader->biWidth, f, image, line, buffer, withAlpha); break;
+      case 24: read_24bit_line(infoheader->biWidth, f, image, line, buffer); break;
+      case 32: read_32bit_line(infoheader->biWidth, f, image, line, buffer, withAlpha); break;
     }
 
     fop->setProgress((float)(i+1) / (float)(height));
@@ -1223,7 +1218,7 @@ bool BmpFormat::onSave(FileOp *fop)
                OS2FILEHEADERSIZE + biSizeImage;  // header + image data
   }
 
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(open_file_with_exception_sync_on_close(fop->outputFilename(), "wb"));
   FILE* f = handle.get();
 
   /* file_header */
@@ -1295,19 +1290,21 @@ bool BmpFormat::onSave(FileOp *fop)
     default: colorMask = 0; break;
   }
 
+  // Only used in RGB mode to write each row with just one fwrite()
+  std::vector<uint8_t> buffer;
+  if (spec.colorMode() == ColorMode::RGB)
+    buffer.resize(size_t(w) * (bpp/8));
+
   // Save image pixels (from bottom to top)
   for (i=h-1; i>=0; i--) {
     switch (spec.colorMode()) {
       case ColorMode::RGB: {
         auto scanline = (const uint32_t*)img->getScanline(i);
-        for (j=0; j<w; ++j) {
-          c = scanline[j];
-          fputc(rgba_getb(c), f);
-          fputc(rgba_getg(c), f);
-          fputc(rgba_getr(c), f);
-          if (withAlpha)
-            fputc(rgba_geta(c), f);
-        }
+        dio::write_rgb_scanline(scanline, w,
+                                (withAlpha ? dio::ScanlineLayout::BGRA:
+                                             dio::ScanlineLayout::BGR),
+                                buffer.data());
+        fwrite(buffer.data(), 1, buffer.size(), f);
         break;
       }
       case ColorMode::GRAYSCALE: {
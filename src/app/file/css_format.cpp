@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (c) 2018-2023  Igara Studio S.A.
+// Copyright (c) 2018-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -23,6 +23,10 @@
 #include "doc/doc.h"
 #include "ui/window.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
 #include "css_options.xml.h"
 
 
@@ -91,70 +95,88 @@ bool CssFormat::onSave(FileOp* fop)
   const ImageRef image = fop->sequenceImageToSave();
   int x, y, c, r, g, b, a, alpha;
   const auto css_options = std::static_pointer_cast<CssOptions>(fop->formatOptions());
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(open_file_with_exception_sync_on_close(fop->outputFilename(), "wb"));
   FILE* f = handle.get();
-  auto print_color = [f](int r, int g, int b, int a) {
+
+  // The output is accumulated in a big buffer and written in chunks
+  // (instead of several fprintf() calls for each pixel).
+  const size_t kBufferSize = 1024*1024;
+  std::string buf;
+  buf.reserve(kBufferSize + 256);
+  auto flush = [f, &buf]() {
+    fwrite(buf.data(), 1, buf.size(), f);
+    buf.clear();
+  };
+  auto print = [&buf, &flush](const char* fmt, auto... args) {
+    char tmp[256];
+    const int n = std::snprintf(tmp, sizeof(tmp), fmt, args...);
+    if (n > 0)
+      buf.append(tmp, std::min<int>(n, sizeof(tmp)-1));
+    if (buf.size() >= kBufferSize)
+      flush();
+  };
+  auto print_color = [&print](int r, int g, int b, int a) {
     if (a == 255) {
-      fprintf(f, "#%02X%02X%02X", r, g, b);
+      print("#%02X%02X%02X", r, g, b);
     }
     else {
-      fprintf(f, "rgba(%d, %d, %d, %d)", r, g, b, a);
+      print("rgba(%d, %d, %d, %d)", r, g, b, a);
     }
   };
-  auto print_shadow_color = [f, css_options, print_color](int x, int y, int r,
-                                                          int g, int b, int a,
-                                                          bool comma = true) {
-    fprintf(f, comma?",\n":"\n");
+  auto print_shadow_color = [&print, css_options, print_color](int x, int y, int r,
+                                                               int g, int b, int a,
+                                                               bool comma = true) {
+    print(comma?",\n":"\n");
     if (css_options->withVars) {
-      fprintf(f, "\tcalc(%d*var(--shadow-mult)) calc(%d*var(--shadow-mult)) var(--blur) var(--spread) ",
-              x, y);
+      print("\tcalc(%d*var(--shadow-mult)) calc(%d*var(--shadow-mult)) var(--blur) var(--spread) ",
+            x, y);
     }
     else {
       int x_loc = x * (css_options->pixelScale + css_options->gutterSize);
       int y_loc = y * (css_options->pixelScale + css_options->gutterSize);
-      fprintf(f, "%dpx %dpx ", x_loc, y_loc);
+      print("%dpx %dpx ", x_loc, y_loc);
     }
     print_color(r, g, b, a);
   };
-  auto print_shadow_index = [f, css_options](int x, int y, int i, bool comma=true) {
-    fprintf(f, comma?",\n":"\n");
-    fprintf(f, "\tcalc(%d*var(--shadow-mult)) calc(%d*var(--shadow-mult)) var(--blur) var(--spread) var(--color-%d)",
-            x, y, i);
+  auto print_shadow_index = [&print, css_options](int x, int y, int i, bool comma=true) {
+    print(comma?",\n":"\n");
+    print("\tcalc(%d*var(--shadow-mult)) calc(%d*var(--shadow-mult)) var(--blur) var(--spread) var(--color-%d)",
+          x, y, i);
   };
   if (css_options->withVars) {
-    fprintf(f, ":root {\n"
-               "\t--blur: 0px;\n"
-               "\t--spread: 0px;\n"
-               "\t--pixel-size: %dpx;\n"
-               "\t--gutter-size: %dpx;\n",
-            css_options->pixelScale,
-            css_options->gutterSize);
-    fprintf(f, "\t--shadow-mult: calc(var(--gutter-size) + var(--pixel-size));\n");
+    print(":root {\n"
+          "\t--blur: 0px;\n"
+          "\t--spread: 0px;\n"
+          "\t--pixel-size: %dpx;\n"
+          "\t--gutter-size: %dpx;\n",
+          css_options->pixelScale,
+          css_options->gutterSize);
+    print("\t--shadow-mult: calc(var(--gutter-size) + var(--pixel-size));\n");
     if (image->pixelFormat() == IMAGE_INDEXED) {
       for (y = 0; y < 256; y++) {
         fop->sequenceGetColor(y, &r, &g, &b);
         fop->sequenceGetAlpha(y, &a);
-        fprintf(f, "\t--color-%d: ", y);
+        print("\t--color-%d: ", y);
         print_color(r, g, b, a);
-        fprintf(f, ";\n");
+        print(";\n");
       }
     }
-    fprintf(f, "}\n\n");
+    print("}\n\n");
   }
 
-  fprintf(f, ".pixel-art {\n");
-  fprintf(f, "\tposition: relative;\n");
-  fprintf(f, "\ttop: 0;\n");
-  fprintf(f, "\tleft: 0;\n");
+  print(".pixel-art {\n");
+  print("\tposition: relative;\n");
+  print("\ttop: 0;\n");
+  print("\tleft: 0;\n");
   if (css_options->withVars) {
-    fprintf(f, "\theight: var(--pixel-size);\n");
-    fprintf(f, "\twidth: var(--pixel-size);\n");
+    print("\theight: var(--pixel-size);\n");
+    print("\twidth: var(--pixel-size);\n");
   }
   else {
-    fprintf(f, "\theight: %dpx;\n", css_options->pixelScale);
-    fprintf(f, "\twidth: %dpx;\n", css_options->pixelScale);
+    print("\theight: %dpx;\n", css_options->pixelScale);
+    print("\twidth: %dpx;\n", css_options->pixelScale);
   }
-  fprintf(f, "\tbox-shadow:\n");
+  print("\tbox-shadow:\n");
   int num_printed_pixels = 0;
   switch (image->pixelFormat()) {
     case IMAGE_RGB: {
@@ -225,7 +247,8 @@ bool CssFormat::onSave(FileOp* fop)
       break;
     }
   }
-  fprintf(f, ";\n}\n");
+  print(";\n}\n");
+  flush();
   if (ferror(f)) {
     fop->setError("Error writing file.\n");
     return false;
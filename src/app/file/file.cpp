@@ -27,12 +27,15 @@
 #include "app/modules/gui.h"
 #include "app/modules/palettes.h"
 #include "app/pref/preferences.h"
+#include "app/profiler.h"
 #include "app/tx.h"
 #include "app/ui/incompat_file_window.h"
 #include "app/ui/optional_alert.h"
 #include "app/ui/status_bar.h"
+#include "app/util/thread_budget.h"
 #include "base/fs.h"
 #include "base/string.h"
+#include "base/thread_pool.h"
 #include "dio/detect_format.h"
 #include "doc/algorithm/resize_image.h"
 #include "doc/doc.h"
@@ -47,14 +50,63 @@
 #include "ask_for_color_profile.xml.h"
 #include "open_sequence.xml.h"
 
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <sys/stat.h>
+#endif
+
 #include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <cstring>
 #include <cstdarg>
+#include <deque>
+#include <future>
+#include <memory>
+#include <thread>
 
 namespace app {
 
 using namespace base;
 
+namespace {
+
+// Returns false if the given file is a symbolic link (we cannot
+// replace the link with a new file).
+bool can_replace_file_atomically(const std::string& filename)
+{
+#ifndef _WIN32
+  struct stat st;
+  if (::lstat(filename.c_str(), &st) == 0 && S_ISLNK(st.st_mode))
+    return false;
+#endif
+  return true;
+}
+
+// Replaces the "dst" file with "src" in just one operation.
+bool replace_file(const std::string& src, const std::string& dst)
+{
+#ifdef _WIN32
+  return (MoveFileExW(base::from_utf8(src).c_str(),
+                      base::from_utf8(dst).c_str(),
+                      MOVEFILE_REPLACE_EXISTING) != 0);
+#else
+  return (std::rename(src.c_str(), dst.c_str()) == 0);
+#endif
+}
+
+std::atomic<int64_t> g_savedFrames(0);
+std::atomic<int64_t> g_savedBytes(0);
+
+void add_saved_file(const std::string& filename, const frame_t frames)
+{
+  g_savedFrames += frames;
+  g_savedBytes += int64_t(base::file_size(filename));
+}
+
+} // anonymous namespace
+
 class FileOp::FileAbstractImageImpl : public FileAbstractImage {
 public:
   FileAbstractImageImpl(FileOp* fop)
@@ -62,9 +114,11 @@ public:
     , m_sprite(m_doc->sprite())
     , m_spec(m_sprite->spec())
     , m_supportAnimation(fop->fileFormat()->support(FILE_SUPPORT_FRAMES))
-    , m_newBlend(fop->newBlend())
   {
     ASSERT(m_doc && m_sprite);
+    m_render.setNewBlend(fop->newBlend());
+    m_render.setBgOptions(render::BgOptions::MakeNone());
+    m_render.setParallelTiles(fop->config().renderThreads);
   }
 
   void setSpecSize(const gfx::Size& fullCanvasSize,
@@ -162,10 +216,7 @@ public:
       m_tmpUnscaledRender.reset(doc::Image::create(spec));
     }
 
-    render::Render render;
-    render.setNewBlend(m_newBlend);
-    render.setBgOptions(render::BgOptions::MakeNone());
-    render.renderSprite(
+    m_render.renderSprite(
       (needResize ? m_tmpUnscaledRender.get(): dst),
       m_sprite, frame,
       gfx::Clip(gfx::Point(0, 0), frameBounds));
@@ -181,6 +232,10 @@ public:
     }
   }
 
+  const gfx::PointF& scale() const {
+    return m_scale;
+  }
+
   void setScale(const gfx::PointF& scale) {
     m_scale = scale;
     m_spec.setWidth(m_spec.width() * m_scale.x);
@@ -196,7 +251,9 @@ private:
   const doc::Sprite* m_sprite;
   doc::ImageSpec m_spec;
   const bool m_supportAnimation;
-  const bool m_newBlend;
+  // The render is reused between frames (so the pool of threads of
+  // the tile-parallel mode is created only once).
+  mutable render::Render m_render;
   doc::ImageRef m_tmpScaledImage = nullptr;
   mutable doc::ImageRef m_tmpUnscaledRender = nullptr;
   gfx::PointF m_scale = gfx::PointF(1.0, 1.0);
@@ -224,6 +281,14 @@ base::paths get_writable_extensions(const int requiredFormatFlag)
   return paths;
 }
 
+FileSaveStats get_file_save_stats()
+{
+  FileSaveStats stats;
+  stats.frames = g_savedFrames;
+  stats.bytes = g_savedBytes;
+  return stats;
+}
+
 Doc* load_document(Context* context, const std::string& filename)
 {
   /* TODO add a option to configure what to do with the sequence */
@@ -830,6 +895,7 @@ bool FileOp::checkIfFormatSupportResizeOnTheFly(const std::string& filename)
 // TODO refactor this code
 void FileOp::operate(IFileOpProgress* progress)
 {
+  ProfileZone zone(m_type == FileOpLoad ? "FileOp::load": "FileOp::save");
   ASSERT(!isDone());
 
   m_progressInterface = progress;
@@ -874,11 +940,57 @@ void FileOp::operate(IFileOpProgress* progress)
 
       auto it = m_seq.filename_list.begin(),
            end = m_seq.filename_list.end();
+
+      // The first file is loaded in this thread (it creates the
+      // document), and the next files are decoded in a pool of
+      // threads (each one with its own FileOp) and added to the
+      // document in the same order of the sequence.
+      struct LoadedFile {
+        std::unique_ptr<FileOp> fop;
+        bool ok;
+      };
+      const ThreadBudget budget(std::thread::hardware_concurrency(),
+                                 ThreadPriority::Export);
+      const int threads = budget.threads();
+      const int maxFilesInFlight = 2*threads;
+      std::atomic<bool> cancel(false);
+      base::thread_pool pool(threads);
+      std::deque<std::future<LoadedFile>> loadedFiles;
+      auto nextFileToLoad = it+1;
+      auto loadNextFiles = [&]{
+        for (; nextFileToLoad != end &&
+               int(loadedFiles.size()) < maxFilesInFlight; ++nextFileToLoad) {
+          auto task = std::make_shared<std::packaged_task<LoadedFile()>>(
+            [this, &cancel, filename = *nextFileToLoad]{
+              LoadedFile loaded;
+              loaded.fop.reset(createSequenceFileOperation(filename));
+              loaded.ok = (!cancel && !isStop() &&
+                           m_format->load(loaded.fop.get()));
+              return loaded;
+            });
+          loadedFiles.push_back(task->get_future());
+          pool.execute([task]{ (*task)(); });
+        }
+      };
+      loadNextFiles();
+
       for (; it != end; ++it) {
         m_filename = it->c_str();
 
+        bool loadres;
         // Call the "load" procedure to read the first bitmap.
-        bool loadres = m_format->load(this);
+        if (it == m_seq.filename_list.begin()) {
+          loadres = m_format->load(this);
+        }
+        // Take the next bitmap loaded by the pool of threads.
+        else {
+          LoadedFile loaded = loadedFiles.front().get();
+          loadedFiles.pop_front();
+          loadNextFiles();
+
+          loadres = loaded.ok;
+          takeSequenceFile(loaded.fop.get());
+        }
         if (!loadres) {
           setError("Error loading frame %d from file \"%s\"\n",
                    frame+1, m_filename.c_str());
@@ -934,9 +1046,24 @@ void FileOp::operate(IFileOpProgress* progress)
 
         ++frame;
         m_seq.progress_offset += m_seq.progress_fraction;
+        setProgress(0.0);
       }
       m_filename = *m_seq.filename_list.begin();
 
+      // Discard the files that were loaded after an error
+      cancel = true;
+      for (auto& loadedFile : loadedFiles) {
+        try {
+          LoadedFile loaded = loadedFile.get();
+          delete loaded.fop->releaseDocument();
+          delete loaded.fop->m_seq.last_cel;
+        }
+        catch (...) {
+          // Ignore errors of files that will not be used
+        }
+      }
+      loadedFiles.clear();
+
       // Final setup
       if (m_document) {
         // Configure the layer as the 'Background'
@@ -1004,32 +1131,60 @@ void FileOp::operate(IFileOpProgress* progress)
 
       Sprite* sprite = m_document->sprite();
 
-      // Create a temporary bitmap
-      m_seq.image.reset(Image::create(sprite->pixelFormat(),
-                                      m_roi.fileCanvasSize().w,
-                                      m_roi.fileCanvasSize().h));
-
       m_seq.progress_offset = 0.0f;
       m_seq.progress_fraction = 1.0f / (double)sprite->totalFrames();
 
+      // Each frame is rendered in this thread, and encoded in a pool
+      // of threads (each file with its own FileOp).
+      struct SavedFile {
+        std::shared_ptr<FileOp> fop;
+        frame_t outputFrame;
+        std::future<bool> ok;
+      };
+      const ThreadBudget budget(std::thread::hardware_concurrency(),
+                                 ThreadPriority::Export);
+      const int threads = budget.threads();
+      const int maxFilesInFlight = 2*threads;
+      std::deque<SavedFile> savedFiles;
+      base::thread_pool pool(threads);
+      bool failed = false;
+      auto waitSavedFile = [&]{
+        SavedFile saved = std::move(savedFiles.front());
+        savedFiles.pop_front();
+
+        const bool ok = saved.ok.get();
+        if (saved.fop->hasError())
+          setError("%s", saved.fop->error().c_str());
+        if (!ok) {
+          setError("Error saving frame %d in the file \"%s\"\n",
+                   saved.outputFrame+1, saved.fop->filename().c_str());
+          failed = true;
+        }
+        else
+          add_saved_file(saved.fop->filename(), 1);
+
+        m_seq.progress_offset += m_seq.progress_fraction;
+        setProgress(0.0);
+      };
+
       // For each frame in the sprite.
       render::Render render;
       render.setNewBlend(m_config.newBlend);
+      render.setParallelTiles(m_config.renderThreads);
 
       frame_t outputFrame = 0;
+      frame_t savedFrames = 0;
       for (frame_t frame : m_roi.framesSequence()) {
         gfx::Rect bounds = m_roi.frameBounds(frame);
         if (bounds.isEmpty())
           continue; // Skip frame because there is no slice key
 
-        if (m_abstractImage) {
-          m_abstractImage->setSpecSize(m_roi.fileCanvasSize(),
-                                       bounds.size());
-        }
-
         // Render the (unscaled) sequenced image.
+        ImageRef image(Image::create(sprite->pixelFormat(),
+                                     m_roi.fileCanvasSize().w,
+                                     m_roi.fileCanvasSize().h));
         render.renderSprite(
-          m_seq.image.get(), sprite, frame,
+          image.get(), sprite, frame,
           gfx::Clip(gfx::Point(0, 0), bounds));
 
         bool save = true;
@@ -1037,36 +1192,58 @@ void FileOp::operate(IFileOpProgress* progress)
         // Check if we have to ignore empty frames
         if (m_ignoreEmpty &&
             !sprite->isOpaque() &&
-            doc::is_empty_image(m_seq.image.get())) {
+            doc::is_empty_image(image.get())) {
           save = false;
         }
 
         if (save) {
-          // Setup the palette.
-          sprite->palette(frame)->copyColorsTo(m_seq.palette);
-
           // Setup the filename to be used.
           m_filename = m_seq.filename_list[outputFrame];
 
           // Make directories
           makeDirectories();
 
-          // Call the "save" procedure... did it fail?
-          if (!m_format->save(this)) {
-            setError("Error saving frame %d in the file \"%s\"\n",
-                     outputFrame+1, m_filename.c_str());
-            break;
+          std::shared_ptr<FileOp> fop(createSequenceFileOperation(m_filename));
+          fop->m_document = m_document;
+          fop->m_formatOptions = m_formatOptions;
+          fop->m_seq.image = image;
+          fop->m_seq.frame = savedFrames++;
+
+          // Setup the palette.
+          sprite->palette(frame)->copyColorsTo(fop->m_seq.palette);
+
+          if (m_format->support(FILE_ENCODE_ABSTRACT_IMAGE)) {
+            fop->makeAbstractImage();
+            if (m_abstractImage)
+              fop->m_abstractImage->setScale(m_abstractImage->scale());
+            fop->m_abstractImage->setSpecSize(m_roi.fileCanvasSize(),
+                                              bounds.size());
           }
-        }
 
-        m_seq.progress_offset += m_seq.progress_fraction;
+          // Call the "save" procedure in the pool of threads
+          auto task = std::make_shared<std::packaged_task<bool()>>(
+            [this, fop]{
+              return m_format->save(fop.get());
+            });
+          savedFiles.push_back(SavedFile{ fop, outputFrame, task->get_future() });
+          pool.execute([task]{ (*task)(); });
+
+          // Limit the number of rendered frames in memory
+          while (!failed && int(savedFiles.size()) > maxFilesInFlight)
+            waitSavedFile();
+          if (failed)
+            break;
+        }
+        else {
+          m_seq.progress_offset += m_seq.progress_fraction;
+        }
         ++outputFrame;
       }
 
-      m_filename = *m_seq.filename_list.begin();
+      while (!savedFiles.empty())
+        waitSavedFile();
 
-      // Destroy the image
-      m_seq.image.reset();
+      m_filename = *m_seq.filename_list.begin();
     }
     // Direct save to a file.
     else {
@@ -1077,11 +1254,40 @@ void FileOp::operate(IFileOpProgress* progress)
                                      m_roi.fileCanvasSize());
       }
 
+      // Save in a temporary file, so the original file is kept
+      // intact if there is an error (or a crash) saving the new one.
+      if (can_replace_file_atomically(m_filename))
+        m_outputFilename = m_filename + ".tmp";
+
       // Call the "save" procedure.
-      if (!m_format->save(this)) {
+      const bool ok = m_format->save(this);
+      if (!ok) {
         setError("Error saving the sprite in the file \"%s\"\n",
                  m_filename.c_str());
       }
+
+      if (!m_outputFilename.empty()) {
+        // Formats that don't use outputFilename() write the final
+        // file directly.
+        if (base::is_file(m_outputFilename)) {
+          if (ok && !hasError()) {
+            if (!replace_file(m_outputFilename, m_filename))
+              setError("Error replacing the file \"%s\"\n", m_filename.c_str());
+          }
+          else {
+            try {
+              base::delete_file(m_outputFilename);
+            }
+            catch (const std::exception&) {
+              // Ignore errors deleting the temporary file
+            }
+          }
+        }
+        m_outputFilename.clear();
+      }
+
+      if (ok && !hasError())
+        add_saved_file(m_filename, m_roi.frames());
     }
 
     // Save special data from .aseprite-data file
@@ -1391,6 +1597,59 @@ ImageRef FileOp::sequenceImageToLoad(
   return m_seq.image;
 }
 
+FileOp* FileOp::createSequenceFileOperation(const std::string& filename) const
+{
+  auto fop = new FileOp(m_type, m_context, &m_config);
+  fop->m_format = m_format;
+  fop->m_filename = filename;
+  fop->m_roi = m_roi;
+  fop->prepareForSequence();
+  fop->m_seq.palette->makeBlack();
+  fop->m_seq.filename_list.push_back(filename);
+  fop->m_seq.duration = m_seq.duration;
+  fop->m_seq.flags = m_seq.flags;
+  return fop;
+}
+
+void FileOp::takeSequenceFile(FileOp* fop)
+{
+  if (fop->hasError())
+    setError("%s", fop->error().c_str());
+
+  std::unique_ptr<Doc> doc(fop->releaseDocument());
+  ImageRef image = fop->m_seq.image;
+  delete fop->m_seq.last_cel;
+  fop->m_seq.last_cel = nullptr;
+  if (!doc || !image)
+    return;
+
+  // Do the same as sequenceImageToLoad() would do if the file were
+  // loaded with this FileOp.
+  Sprite* sprite = m_document->sprite();
+  const Sprite* fileSprite = doc->sprite();
+  if (sprite->pixelFormat() != fileSprite->pixelFormat()) {
+    setError("Error: image does not match color mode\n");
+    return;
+  }
+  if (m_seq.last_cel) {
+    setError("Error: called two times FileOp::sequenceImageToLoad()\n");
+    return;
+  }
+
+  m_seq.image = image;
+  m_seq.last_cel = new Cel(m_seq.frame++, ImageRef(nullptr));
+
+  fop->m_seq.palette->copyColorsTo(m_seq.palette);
+  if (fop->m_seq.has_alpha)
+    m_seq.has_alpha = true;
+  if (sprite->pixelFormat() == IMAGE_INDEXED)
+    sprite->setTransparentColor(fileSprite->transparentColor());
+  if (fop->m_embeddedColorProfile)
+    m_embeddedColorProfile = true;
+  if (fop->m_formatOptions)
+    m_formatOptions = fop->m_formatOptions;
+}
+
 void FileOp::makeAbstractImage()
 {
   ASSERT(m_format->support(FILE_ENCODE_ABSTRACT_IMAGE));
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -19,8 +19,10 @@
 #include "doc/image_ref.h"
 #include "doc/pixel_format.h"
 #include "doc/frames_sequence.h"
+#include "gfx/size.h"
 #include "os/color_space.h"
 
+#include <cstdint>
 #include <cstdio>
 #include <memory>
 #include <mutex>
@@ -169,10 +171,23 @@ namespace app {
 
     bool isSequence() const { return !m_seq.filename_list.empty(); }
     bool isOneFrame() const { return m_oneframe; }
+
+    // Loads a smaller version of the file to create a thumbnail of
+    // the given size (see FileFormat::onLoadThumbnail()).
+    bool isThumbnail() const { return !m_thumbnailSize.isEmpty(); }
+    const gfx::Size& thumbnailSize() const { return m_thumbnailSize; }
+    void setThumbnailSize(const gfx::Size& size) { m_thumbnailSize = size; }
     bool preserveColorProfile() const { return m_config.preserveColorProfile; }
     const FileFormat* fileFormat() const { return m_format; }
 
     const std::string& filename() const { return m_filename; }
+    // File where the format must write the saved file. When we save
+    // directly to a file (not a sequence) it's a temporary file in
+    // the same directory, which replaces the filename() file only if
+    // the whole file was saved correctly.
+    const std::string& outputFilename() const {
+      return (m_outputFilename.empty() ? m_filename: m_outputFilename);
+    }
     const base::paths& filenames() const { return m_seq.filename_list; }
     Context* context() const { return m_context; }
     Doc* document() const { return m_document; }
@@ -298,6 +313,7 @@ namespace app {
     //      releaseDocument() member function)
     Doc* m_document;            // Loaded document, or document to be saved.
     std::string m_filename;     // File-name to load/save.
+    std::string m_outputFilename; // Temporary file-name to save (see outputFilename())
     std::string m_dataFilename; // File-name for a special XML .aseprite-data where extra sprite data can be stored
     FileOpROI m_roi;
 
@@ -312,6 +328,7 @@ namespace app {
     bool m_oneframe;            // Load just one frame (in formats
                                 // that support animation like
                                 // GIF/FLI/ASE).
+    gfx::Size m_thumbnailSize;  // Size of the thumbnail to load (or empty)
     bool m_createPaletteFromRgba;
     bool m_ignoreEmpty;
 
@@ -348,6 +365,12 @@ namespace app {
     std::unique_ptr<FileAbstractImageImpl> m_abstractImage;
 
     void prepareForSequence();
+
+    // Creates a FileOp to load/save just one file of the sequence in
+    // a background thread, and takes the result of a loaded file
+    // into this FileOp (as if the file were loaded with this FileOp).
+    FileOp* createSequenceFileOperation(const std::string& filename) const;
+    void takeSequenceFile(FileOp* fop);
     void makeAbstractImage();
     void makeDirectories();
   };
@@ -368,6 +391,15 @@ namespace app {
   // Returns true if the given file format supports palette/s
   bool format_supports_palette(const std::string& filename);
 
+  // Number of frames and bytes written by all the save operations
+  // since the program started (used by --stats to report the
+  // throughput of each --save-as).
+  struct FileSaveStats {
+    int64_t frames = 0;
+    int64_t bytes = 0;
+  };
+  FileSaveStats get_file_save_stats();
+
 } // namespace app
 
 #endif
@@ -0,0 +1,134 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/context.h"
+#include "app/doc.h"
+#include "app/file/file.h"
+#include "base/fs.h"
+#include "tests/benchmark_fixtures.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+
+using namespace app;
+using namespace doc;
+
+static std::unique_ptr<Doc> create_fixture_doc(Context& ctx,
+                                               ColorMode colorMode,
+                                               int w, int h,
+                                               int nframes, int nlayers)
+{
+  std::unique_ptr<Doc> doc(
+    new Doc(tests::create_fixture_sprite(colorMode, w, h, nframes, nlayers)));
+  ctx.documents().add(doc.get());
+  return doc;
+}
+
+static void save_fixture(Context& ctx, Doc* doc, const char* fn)
+{
+  doc->setFilename(fn);
+  save_document(&ctx, doc);
+}
+
+static void BM_LoadAse(benchmark::State& state)
+{
+  const int size = state.range(0);
+  const int nframes = state.range(1);
+  const int nlayers = state.range(2);
+  const char* fn = "_bench_load.aseprite";
+  Context ctx;
+  {
+    auto doc = create_fixture_doc(ctx, ColorMode::RGB, size, size, nframes, nlayers);
+    save_fixture(ctx, doc.get(), fn);
+    doc->close();
+  }
+
+  for (auto _ : state) {
+    std::unique_ptr<Doc> doc(load_document(&ctx, fn));
+    benchmark::DoNotOptimize(doc.get());
+    doc->close();
+  }
+  base::delete_file(fn);
+}
+
+static void BM_SaveAse(benchmark::State& state)
+{
+  const int size = state.range(0);
+  const int nframes = state.range(1);
+  const int nlayers = state.range(2);
+  const char* fn = "_bench_save.aseprite";
+  Context ctx;
+  auto doc = create_fixture_doc(ctx, ColorMode::RGB, size, size, nframes, nlayers);
+
+  for (auto _ : state)
+    save_fixture(ctx, doc.get(), fn);
+
+  doc->close();
+  base::delete_file(fn);
+}
+
+// Exports the given color mode and format (one file for all frames
+// for .gif, one file per frame for .png)
+static void BM_Export(benchmark::State& state,
+                      const ColorMode colorMode,
+                      const char* fn)
+{
+  const int size = state.range(0);
+  const int nframes = state.range(1);
+  Context ctx;
+  auto doc = create_fixture_doc(ctx, colorMode, size, size, nframes, 2);
+
+  for (auto _ : state)
+    save_fixture(ctx, doc.get(), fn);
+
+  doc->close();
+  for (const auto& item : base::list_files(base::get_current_path())) {
+    if (base::get_file_title(item).find("_bench_export") == 0)
+      base::delete_file(item);
+  }
+}
+
+BENCHMARK(BM_LoadAse)
+  ->Args({ 64, 16, 4 })
+  ->Args({ 256, 16, 4 })
+  ->Args({ 1024, 4, 4 })
+  ->Args({ 4096, 1, 1 })
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_SaveAse)
+  ->Args({ 64, 16, 4 })
+  ->Args({ 256, 16, 4 })
+  ->Args({ 1024, 4, 4 })
+  ->Args({ 4096, 1, 1 })
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(BM_Export, gif_indexed, ColorMode::INDEXED, "_bench_export.gif")
+  ->Args({ 64, 16 })
+  ->Args({ 256, 16 })
+  ->Args({ 1024, 4 })
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(BM_Export, gif_rgb, ColorMode::RGB, "_bench_export.gif")
+  ->Args({ 64, 16 })
+  ->Args({ 256, 16 })
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(BM_Export, png_rgb, ColorMode::RGB, "_bench_export.png")
+  ->Args({ 64, 16 })
+  ->Args({ 256, 16 })
+  ->Args({ 1024, 4 })
+  ->Unit(benchmark::kMillisecond);
+
+int app_main(int argc, char* argv[])
+{
+  ::benchmark::Initialize(&argc, argv);
+  return ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -10,6 +10,7 @@
 #endif
 
 #include "app/drm.h"
+#include "app/file/file.h"
 #include "app/file/file_format.h"
 #include "app/file/format_options.h"
 
@@ -43,6 +44,8 @@ dio::FileFormat FileFormat::dioFormat() const
 bool FileFormat::load(FileOp* fop)
 {
   ASSERT(support(FILE_SUPPORT_LOAD));
+  if (fop->isThumbnail())
+    return onLoadThumbnail(fop, fop->thumbnailSize());
   return onLoad(fop);
 }
 
@@ -61,4 +64,14 @@ bool FileFormat::postLoad(FileOp* fop)
   return onPostLoad(fop);
 }
 
+// static
+int FileFormat::thumbnailDecimation(const gfx::Size& imageSize,
+                                    const gfx::Size& thumbnailSize)
+{
+  const int thumbMax = std::max(thumbnailSize.w, thumbnailSize.h);
+  if (thumbMax <= 0)
+    return 1;
+  return std::max(1, std::max(imageSize.w, imageSize.h) / thumbMax);
+}
+
 } // namespace app
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -12,6 +12,7 @@
 #include "app/file/format_options.h"
 #include "base/paths.h"
 #include "dio/file_format.h"
+#include "gfx/size.h"
 
 #include <vector>
 
@@ -74,6 +75,13 @@ namespace app {
       return ((onGetFlags() & f) == f);
     }
 
+    // Returns the number of pixels in each axis that can be skipped
+    // (1 = no decimation) to load an image of "imageSize" as a
+    // thumbnail of "thumbnailSize" (the decimated image will be
+    // bigger than the final thumbnail).
+    static int thumbnailDecimation(const gfx::Size& imageSize,
+                                   const gfx::Size& thumbnailSize);
+
   protected:
     virtual const char* onGetName() const = 0;
     virtual void onGetExtensions(base::paths& exts) const = 0;
@@ -82,6 +90,14 @@ namespace app {
 
     virtual bool onLoad(FileOp* fop) = 0;
     virtual bool onPostLoad(FileOp* fop) { return true; }
+
+    // Loads a smaller version of the image (using
+    // thumbnailDecimation()) to generate a thumbnail of the given
+    // size. The FileOp is already configured to load just the first
+    // frame, so by default this just loads the file.
+    virtual bool onLoadThumbnail(FileOp* fop, const gfx::Size& thumbnailSize) {
+      return onLoad(fop);
+    }
 #ifdef ENABLE_SAVE
     virtual bool onSave(FileOp* fop) = 0;
 #endif
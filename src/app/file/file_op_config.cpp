@@ -22,11 +22,17 @@ void FileOpConfig::fillFromPreferences()
   filesWithProfile = pref.color.filesWithProfile();
   missingProfile = pref.color.missingProfile();
   newBlend = pref.experimental.newBlend();
+  renderThreads = pref.experimental.renderThreads();
   defaultSliceColor = pref.slices.defaultColor();
   workingCS = get_working_rgb_space_from_preferences();
   rgbMapAlgorithm = pref.quantization.rgbmapAlgorithm();
   fitCriteria = pref.quantization.fitCriteria();
   cacheCompressedTilesets = pref.tileset.cacheCompressedTilesets();
+  aseCompressionLevel = pref.saveFile.compressionLevel();
+  aseDedupeCels = pref.saveFile.dedupeCels();
+  lazyLoadCels = pref.experimental.lazyLoadCels();
+  lazyLoadProperties = pref.experimental.lazyLoadProperties();
+  keepIndexedGifs = pref.experimental.keepIndexedGifs();
 }
 
 } // namespace app
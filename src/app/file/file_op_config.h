@@ -31,6 +31,10 @@ namespace app {
     // blend mode.h
     bool newBlend = true;
 
+    // Number of threads used to render each frame in tiles before
+    // saving it (1 = render the whole frame in the calling thread).
+    int renderThreads = 1;
+
     app::Color defaultSliceColor = app::Color::fromRgb(0, 0, 255);
 
     // Algorithm used to fit any color into the available palette colors in
@@ -47,6 +51,29 @@ namespace app {
     // compressed data that was loaded as-is).
     bool cacheCompressedTilesets = true;
 
+    // zlib compression level used to save images in .aseprite files
+    // (-1 = zlib default, 0 = uncompressed, 1 = fastest, 9 = smallest).
+    int aseCompressionLevel = -1;
+
+    // Save cels with the same pixels/properties in the same layer as
+    // linked cels in .aseprite files (each unique image is written
+    // once, and they are loaded as linked cels sharing the image).
+    bool aseDedupeCels = false;
+
+    // Keep the compressed pixels of .aseprite cels in memory and
+    // decompress them the first time each cel is used.
+    bool lazyLoadCels = false;
+
+    // Keep the encoded user data properties of .aseprite files in
+    // memory and decode them the first time they are used.
+    bool lazyLoadProperties = false;
+
+    // Load GIF files with more than 256 colors in Indexed mode,
+    // starting a new palette in each frame where the colors don't fit
+    // in the previous palette (instead of converting the whole sprite
+    // to RGB).
+    bool keepIndexedGifs = false;
+
     void fillFromPreferences();
   };
 
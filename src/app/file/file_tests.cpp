@@ -341,3 +341,60 @@ TEST(File, CustomProperties)
     }
   }
 }
+
+TEST(File, TilemapTiles)
+{
+  app::Context ctx;
+
+  // 16-bit tiles are used when there are no flipped tiles
+  for (const doc::tile_flags flags : { doc::tile_flags(0),
+                                       doc::tile_flags(doc::tile_f_xflip) }) {
+    {
+      std::unique_ptr<Doc> doc(
+        ctx.documents().add(32, 32, doc::ColorMode::RGB, 256));
+      doc->setFilename("test_tilemap.ase");
+
+      Sprite* sprite = doc->sprite();
+      auto tileset = new doc::Tileset(sprite, doc::Grid(gfx::Size(8, 8)), 3);
+      doc::put_pixel(tileset->get(1).get(), 0, 0, doc::rgba(255, 0, 0, 255));
+      doc::put_pixel(tileset->get(2).get(), 1, 1, doc::rgba(0, 255, 0, 255));
+      const doc::tileset_index tsi = sprite->tilesets()->add(tileset);
+
+      auto layer = new doc::LayerTilemap(sprite, tsi);
+      sprite->root()->addLayer(layer);
+
+      doc::ImageRef tilemap(doc::Image::create(IMAGE_TILEMAP, 4, 4));
+      tilemap->setMaskColor(doc::notile);
+      tilemap->clear(doc::notile);
+      doc::put_pixel(tilemap.get(), 1, 1, doc::tile(1, flags));
+      doc::put_pixel(tilemap.get(), 2, 3, doc::tile(2, 0));
+      layer->addCel(new doc::Cel(0, tilemap));
+
+      save_document(&ctx, doc.get());
+      doc->close();
+    }
+
+    {
+      std::unique_ptr<Doc> doc(load_document(&ctx, "test_tilemap.ase"));
+      Layer* layer = doc->sprite()->root()->lastLayer();
+      ASSERT_TRUE(layer != nullptr);
+      ASSERT_TRUE(layer->isTilemap());
+
+      const Image* tilemap = layer->cel(frame_t(0))->image();
+      ASSERT_EQ(4, tilemap->width());
+      ASSERT_EQ(4, tilemap->height());
+      for (int y=0; y<4; ++y) {
+        for (int x=0; x<4; ++x) {
+          doc::tile_t expected = doc::notile;
+          if (x == 1 && y == 1)
+            expected = doc::tile(1, flags);
+          else if (x == 2 && y == 3)
+            expected = doc::tile(2, 0);
+          EXPECT_EQ(expected, get_pixel_fast<TilemapTraits>(tilemap, x, y));
+        }
+      }
+
+      doc->close();
+    }
+  }
+}
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -209,7 +209,7 @@ bool FliFormat::onSave(FileOp* fop)
   const FileAbstractImage* sprite = fop->abstractImageToSave();
 
   // Open the file to write in binary mode
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(open_file_with_exception_sync_on_close(fop->outputFilename(), "wb"));
   FILE* f = handle.get();
   flic::StdioFileInterface finterface(f);
   flic::Encoder encoder(&finterface);
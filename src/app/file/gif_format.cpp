@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -21,8 +21,10 @@
 #include "app/modules/gui.h"
 #include "app/pref/preferences.h"
 #include "app/util/autocrop.h"
+#include "app/util/thread_budget.h"
 #include "base/file_handle.h"
 #include "base/fs.h"
+#include "base/thread_pool.h"
 #include "doc/doc.h"
 #include "doc/octree_map.h"
 #include "gfx/clip.h"
@@ -35,6 +37,11 @@
 #include "gif_options.xml.h"
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <future>
+#include <memory>
+#include <thread>
 
 #include <gif_lib.h>
 
@@ -274,7 +281,8 @@ public:
             global = m_firstLocalColormap;
           if (global &&
               global->ColorCount >= m_sprite->palette(0)->size() &&
-              !m_hasLocalColormaps) {
+              !m_hasLocalColormaps &&
+              m_sprite->getPalettes().size() == 1) {
             remapToGlobalColormap(global);
           }
           break;
@@ -370,6 +378,15 @@ private:
         m_opaque = true;
     }
 
+    // Keep a copy of the palette to start a new one from it in case
+    // that the colors of this frame don't fit in it.
+    std::unique_ptr<Palette> oldPalette;
+    if (m_fop->config().keepIndexedGifs &&
+        m_sprite->pixelFormat() == IMAGE_INDEXED &&
+        m_frameNum > 0) {
+      oldPalette = std::make_unique<Palette>(*m_sprite->palette(m_frameNum));
+    }
+
     // Merge this frame colors with the current palette
     if (frameImage && m_sprite->palette(m_frameNum)->size() <= 256)
       updatePalette(frameImage.get());
@@ -377,10 +394,16 @@ private:
     // Convert the sprite to RGB if we have more than 256 colors
     if ((m_sprite->pixelFormat() == IMAGE_INDEXED) &&
         (m_sprite->palette(m_frameNum)->size() > 256)) {
-      GIF_TRACE("GIF: Converting to RGB because we have %d colors\n",
-                m_sprite->palette(m_frameNum)->size());
+      if (oldPalette && frameImage &&
+          startNewPalette(frameImage.get(), *oldPalette)) {
+        GIF_TRACE("GIF: New palette in frame %d\n", (int)m_frameNum);
+      }
+      else {
+        GIF_TRACE("GIF: Converting to RGB because we have %d colors\n",
+                  m_sprite->palette(m_frameNum)->size());
 
-      convertIndexedSpriteToRgb();
+        convertIndexedSpriteToRgb();
+      }
     }
 
     // Composite frame with previous frame
@@ -649,6 +672,76 @@ private:
     m_sprite->setPalette(palette.get(), false);
   }
 
+  // Called when the colors of the given frame don't fit in the
+  // current palette ("oldPalette", before updatePalette() was called
+  // for this frame) to start a new palette in this frame instead of
+  // converting the whole sprite to RGB. The entries used by the
+  // previous composited frame (m_currentImage) and the background
+  // entry keep their index, and the unused entries are replaced with
+  // the new colors, so we don't need to remap any image (the previous
+  // cels use the old palette). Returns false if the colors of the
+  // previous frame and this frame cannot be represented with 256
+  // entries.
+  bool startNewPalette(const Image* frameImage,
+                       const Palette& oldPalette) {
+    ColorMapObject* colormap = getFrameColormap();
+    const int ncolors = colormap->ColorCount;
+
+    // Restore the palette modified by updatePalette() (which is the
+    // palette of the previous frames)
+    m_sprite->setPalette(&oldPalette, false);
+
+    Palette palette(oldPalette);
+    palette.setFrame(m_frameNum);
+
+    // Entries that cannot be replaced with new colors
+    PalettePicks keep(256);
+    if (m_bgIndex < keep.size())
+      keep[m_bgIndex] = true;
+    for (const auto& i : LockImageBits<IndexedTraits>(m_currentImage.get()))
+      keep[i] = true;
+
+    PalettePicks usedEntries(ncolors);
+    for (const auto& i : LockImageBits<IndexedTraits>(frameImage)) {
+      if (i < ncolors && int(i) != m_localTransparentIndex)
+        usedEntries[i] = true;
+    }
+
+    resetRemap(256);
+
+    int freeEntry = 0;
+    for (int i=0; i<ncolors; ++i) {
+      if (!usedEntries[i])
+        continue;
+
+      const color_t color = colormap2rgba(colormap, i);
+      int j = palette.findExactMatch(
+        colormap->Colors[i].Red,
+        colormap->Colors[i].Green,
+        colormap->Colors[i].Blue, 255,
+        m_opaque ? -1: m_bgIndex);
+      if (j < 0) {
+        while (freeEntry < palette.size() && keep[freeEntry])
+          ++freeEntry;
+        if (freeEntry < palette.size()) {
+          j = freeEntry;
+        }
+        else if (palette.size() < 256) {
+          j = palette.size();
+          palette.resize(j+1);
+        }
+        else
+          return false;
+        palette.setEntry(j, color);
+      }
+      keep[j] = true;
+      m_remap.map(i, j);
+    }
+
+    m_sprite->setPalette(&palette, true);
+    return true;
+  }
+
   void compositeIndexedImageToIndexed(const gfx::Rect& frameBounds,
                                       const Image* frameImage) {
     gfx::Clip clip(frameBounds.x, frameBounds.y, 0, 0,
@@ -950,6 +1043,28 @@ class GifEncoder {
 public:
   typedef int gifframe_t;
 
+  // Frame converted to indexed (by quantizeFrame() in the pool of
+  // threads) ready to be written in the file (by writeFrame()).
+  struct QuantizedFrame {
+    struct ColorMapDeleter {
+      void operator()(ColorMapObject* colormap) {
+        GifFreeMapObject(colormap);
+      }
+    };
+
+    gifframe_t gifFrame = 0;
+    frame_t frame = 0;
+    gfx::Rect frameBounds;
+    DisposalMethod disposal = DisposalMethod::NONE;
+    bool fixDuration = false;
+    std::unique_ptr<Image> deltaImage;
+    ImageRef frameImage;
+    // Local colormap for this frame (nullptr to use the global one)
+    std::unique_ptr<ColorMapObject, ColorMapDeleter> localColormap;
+    int localTransparent = -1;
+    Remap remap;
+  };
+
   GifEncoder(FileOp* fop, GifFileType* gifFile)
     : m_fop(fop)
     , m_gifFile(gifFile)
@@ -1110,41 +1225,102 @@ public:
 #endif
     auto frame_it = frame_beg;
 
+    // The frames are rendered and compared with the previous one in
+    // this thread, converted to indexed (quantized) in a pool of
+    // threads, and encoded (LZW) in the file by one extra thread in
+    // the same order of the frames.
+    const ThreadBudget budget(std::thread::hardware_concurrency(),
+                               ThreadPriority::Export);
+    const int threads = budget.threads();
+    const int maxFramesInFlight = 2*threads;
+    base::thread_pool quantizePool(threads);
+    base::thread_pool writerPool(1);
+    std::deque<std::future<void>> writtenFrames;
+    std::atomic<bool> writeFailed(false);
+
     // In this code "gifFrame" will be the GIF frame, and "frame" will
     // be the doc::Sprite frame.
     gifframe_t nframes = totalFrames();
-    for (gifframe_t gifFrame=0; gifFrame<nframes; ++gifFrame) {
-      ASSERT(frame_it != frame_end);
-      frame_t frame = *frame_it;
-      ++frame_it;
-
-      if (gifFrame == 0)
-        renderFrame(frame, m_nextImage);
-      else
-        std::swap(m_previousImage, m_currentImage);
-
-      // Render next frame
-      std::swap(m_currentImage, m_nextImage);
-      if (gifFrame+1 < nframes)
-        renderFrame(*frame_it, m_nextImage);
+    gifframe_t nwritten = 0;
+    auto waitWrittenFrame = [&]{
+      std::future<void> written = std::move(writtenFrames.front());
+      writtenFrames.pop_front();
+      written.get();          // Can throw the writing exception
 
-      gfx::Rect frameBounds = m_spriteBounds;
-      DisposalMethod disposal = DisposalMethod::DO_NOT_DISPOSE;
+      ++nwritten;
+      m_fop->setProgress(double(nwritten) / double(nframes));
+    };
 
-      // Creation of the deltaImage (difference image result respect
-      // to current VS previous frame image).  At the same time we
-      // must scan the next image, to check if some pixel turns to
-      // transparent (0), if the case, we need to force disposal
-      // method of the current image to RESTORE_BG.  Further, at the
-      // same time, we must check if we can go without color zero (0).
-
-      calculateDeltaImageFrameBoundsDisposal(gifFrame, frameBounds, disposal);
+    try {
+      for (gifframe_t gifFrame=0; gifFrame<nframes; ++gifFrame) {
+        ASSERT(frame_it != frame_end);
+        frame_t frame = *frame_it;
+        ++frame_it;
 
-      writeImage(gifFrame, frame, frameBounds, disposal,
-                 // Only the last frame in the animation needs the fix
-                 (fix_last_frame_duration && gifFrame == nframes-1));
+        if (gifFrame == 0)
+          renderFrame(frame, m_nextImage);
+        else
+          std::swap(m_previousImage, m_currentImage);
+
+        // Render next frame
+        std::swap(m_currentImage, m_nextImage);
+        if (gifFrame+1 < nframes)
+          renderFrame(*frame_it, m_nextImage);
+
+        auto qf = std::make_shared<QuantizedFrame>();
+        qf->gifFrame = gifFrame;
+        qf->frame = frame;
+        qf->frameBounds = m_spriteBounds;
+        qf->disposal = DisposalMethod::DO_NOT_DISPOSE;
+        // Only the last frame in the animation needs the fix
+        qf->fixDuration = (fix_last_frame_duration && gifFrame == nframes-1);
+
+        // Creation of the deltaImage (difference image result respect
+        // to current VS previous frame image).  At the same time we
+        // must scan the next image, to check if some pixel turns to
+        // transparent (0), if the case, we need to force disposal
+        // method of the current image to RESTORE_BG.  Further, at the
+        // same time, we must check if we can go without color zero (0).
+
+        calculateDeltaImageFrameBoundsDisposal(gifFrame, qf->frameBounds, qf->disposal);
+        qf->deltaImage = std::move(m_deltaImage);
+
+        auto quantizeTask = std::make_shared<std::packaged_task<void()>>(
+          [this, qf]{ quantizeFrame(*qf); });
+        std::shared_future<void> quantized = quantizeTask->get_future().share();
+        quantizePool.execute([quantizeTask]{ (*quantizeTask)(); });
+
+        auto writeTask = std::make_shared<std::packaged_task<void()>>(
+          [this, qf, quantized, &writeFailed]{
+            // Don't write anything after an error (the file is broken)
+            if (writeFailed)
+              return;
+            try {
+              quantized.get();
+              writeFrame(*qf);
+            }
+            catch (...) {
+              writeFailed = true;
+              throw;
+            }
+          });
+        writtenFrames.push_back(writeTask->get_future());
+        writerPool.execute([writeTask]{ (*writeTask)(); });
+
+        // Limit the number of frames waiting to be written (each one
+        // keeps its delta image in memory).
+        while (int(writtenFrames.size()) > maxFramesInFlight)
+          waitWrittenFrame();
+      }
 
-      m_fop->setProgress(double(gifFrame+1) / double(nframes));
+      while (!writtenFrames.empty())
+        waitWrittenFrame();
+    }
+    catch (...) {
+      writeFailed = true;
+      writerPool.wait_all();
+      quantizePool.wait_all();
+      throw;
     }
     return true;
   }
@@ -1366,35 +1542,37 @@ private:
   }
 
 
-  void writeImage(const gifframe_t gifFrame,
-                  const frame_t frame,
-                  const gfx::Rect& frameBounds,
-                  const DisposalMethod disposal,
-                  const bool fixDuration) {
+  // Converts the delta image of the given frame to indexed, this is
+  // called from the pool of threads, so it cannot modify the state of
+  // the encoder.
+  void quantizeFrame(QuantizedFrame& qf) const {
+    const Image* deltaImage = qf.deltaImage.get();
+    const gfx::Rect& frameBounds = qf.frameBounds;
+
+    int transparentIndex = m_transparentIndex;
     Palette framePalette;
     if (m_globalColormap)
       framePalette = m_globalColormapPalette;
     else
-      framePalette = calculatePalette();
+      framePalette = calculatePalette(deltaImage, transparentIndex);
 
     OctreeMap octree;
-    octree.regenerateMap(&framePalette, m_transparentIndex);
+    octree.regenerateMap(&framePalette, transparentIndex);
     ImageRef frameImage(Image::create(IMAGE_INDEXED,
                                       frameBounds.w,
-                                      frameBounds.h,
-                                      m_frameImageBuf));
+                                      frameBounds.h));
 
     // Every frame might use a small portion of the global palette,
     // to optimize the gif file size, we will analize which colors
     // will be used in each processed frame.
     PalettePicks usedColors(framePalette.size());
 
-    int localTransparent = m_transparentIndex;
+    int localTransparent = transparentIndex;
     ColorMapObject* colormap = m_globalColormap;
     Remap remap(256);
 
     if (!m_preservePaletteOrder) {
-      const LockImageBits<RgbTraits> srcBits(m_deltaImage.get());
+      const LockImageBits<RgbTraits> srcBits(deltaImage);
       LockImageBits<IndexedTraits> dstBits(frameImage.get());
 
       auto srcIt = srcBits.begin();
@@ -1414,13 +1592,13 @@ private:
               rgba_getg(color),
               rgba_getb(color),
               255,
-              m_transparentIndex);
+              transparentIndex);
             if (i < 0)
               i = octree.mapColor(color | rgba_a_mask); // alpha=255
           }
           else {
-            if (m_transparentIndex >= 0)
-              i = m_transparentIndex;
+            if (transparentIndex >= 0)
+              i = transparentIndex;
             else
               i = m_bgIndex;
           }
@@ -1459,25 +1637,40 @@ private:
           localTransparent = remap[localTransparent];
       }
 
-      if (localTransparent >= 0 && m_transparentIndex != localTransparent)
-        remap.map(m_transparentIndex, localTransparent);
+      if (localTransparent >= 0 && transparentIndex != localTransparent)
+        remap.map(transparentIndex, localTransparent);
     }
     else {
-      frameImage.reset(Image::createCopy(m_deltaImage.get()));
+      frameImage.reset(Image::createCopy(deltaImage));
       for (int i=0; i<colormap->ColorCount; ++i)
         remap.map(i, i);
     }
 
+    qf.deltaImage.reset();
+    qf.frameImage = frameImage;
+    qf.localColormap.reset(colormap != m_globalColormap ? colormap: nullptr);
+    qf.localTransparent = localTransparent;
+    qf.remap = remap;
+  }
+
+  // Writes the given quantized frame in the file, this is called from
+  // the writer thread (one frame after the other).
+  void writeFrame(const QuantizedFrame& qf) {
+    const gifframe_t gifFrame = qf.gifFrame;
+    const gfx::Rect& frameBounds = qf.frameBounds;
+    const Image* frameImage = qf.frameImage.get();
+    const Remap& remap = qf.remap;
+
     // Write extension record.
-    writeExtension(gifFrame, frame, localTransparent,
-                   disposal, fixDuration);
+    writeExtension(gifFrame, qf.frame, qf.localTransparent,
+                   qf.disposal, qf.fixDuration);
 
     // Write the image record.
     if (EGifPutImageDesc(m_gifFile,
                          frameBounds.x, frameBounds.y,
                          frameBounds.w, frameBounds.h,
                          m_interlaced ? 1: 0,
-                         (colormap != m_globalColormap ? colormap: nullptr)) == GIF_ERROR) {
+                         qf.localColormap.get()) == GIF_ERROR) {
       throw Exception("Error writing GIF frame %d.\n", gifFrame);
     }
 
@@ -1488,8 +1681,8 @@ private:
       // Need to perform 4 passes on the images.
       for (int i=0; i<4; ++i)
         for (int y=interlaced_offset[i]; y<frameBounds.h; y+=interlaced_jumps[i]) {
-          IndexedTraits::address_t addr =
-            (IndexedTraits::address_t)frameImage->getPixelAddress(0, y);
+          IndexedTraits::const_address_t addr =
+            (IndexedTraits::const_address_t)frameImage->getPixelAddress(0, y);
 
           for (int i=0; i<frameBounds.w; ++i, ++addr)
             scanline[i] = remap[*addr];
@@ -1501,8 +1694,8 @@ private:
     else {
       // Write all image scanlines (not interlaced in this case).
       for (int y=0; y<frameBounds.h; ++y) {
-        IndexedTraits::address_t addr =
-          (IndexedTraits::address_t)frameImage->getPixelAddress(0, y);
+        IndexedTraits::const_address_t addr =
+          (IndexedTraits::const_address_t)frameImage->getPixelAddress(0, y);
 
         for (int i=0; i<frameBounds.w; ++i, ++addr)
           scanline[i] = remap[*addr];
@@ -1511,14 +1704,14 @@ private:
           throw Exception("Error writing GIF image scanlines for frame %d.\n", gifFrame);
       }
     }
-
-    if (colormap && colormap != m_globalColormap)
-      GifFreeMapObject(colormap);
   }
 
-  Palette calculatePalette() {
+  // Creates a palette for the given delta image, and returns the
+  // transparent index to use with it in "transparentIndex".
+  static Palette calculatePalette(const Image* deltaImage,
+                                  int& transparentIndex) {
     OctreeMap octree;
-    const LockImageBits<RgbTraits> imageBits(m_deltaImage.get());
+    const LockImageBits<RgbTraits> imageBits(deltaImage);
     auto it = imageBits.begin(), end = imageBits.end();
     bool maskColorFounded = false;
     for (; it != end; ++it) {
@@ -1534,7 +1727,7 @@ private:
       // If there is a mask color, the OctreeMap::makePalette adds it
       // by default at entry == 0.
       octree.makePalette(&palette, 256, 8);
-      m_transparentIndex = 0;
+      transparentIndex = 0;
       return palette;
     }
     else {
@@ -1544,7 +1737,7 @@ private:
       Palette paletteWithoutMask(0, palette.size() - 1);
       for (int i=0; i < paletteWithoutMask.size(); i++)
         paletteWithoutMask.setEntry(i, palette.entry(i+1));
-      m_transparentIndex = -1;
+      transparentIndex = -1;
       return paletteWithoutMask;
     }
   }
@@ -1559,7 +1752,7 @@ private:
 
 private:
 
-  ColorMapObject* createColorMap(const Palette* palette) {
+  ColorMapObject* createColorMap(const Palette* palette) const {
     int n = 1 << GifBitSizeLimited(palette->size());
     ColorMapObject* colormap = GifMakeMapObject(n, nullptr);
 
@@ -1602,7 +1795,6 @@ private:
   bool m_preservePaletteOrder;
   gfx::Rect m_lastFrameBounds;
   DisposalMethod m_lastDisposal;
-  ImageBufferPtr m_frameImageBuf;
   ImageRef m_images[3];
   Image* m_previousImage;
   Image* m_currentImage;
@@ -1615,7 +1807,7 @@ bool GifFormat::onSave(FileOp* fop)
 #if GIFLIB_MAJOR >= 5
   int errCode = 0;
 #endif
-  int fd = base::open_file_descriptor_with_exception(fop->filename(), "wb");
+  int fd = base::open_file_descriptor_with_exception(fop->outputFilename(), "wb");
   GifFilePtr gif_file(EGifOpenFileHandle(fd
 #if GIFLIB_MAJOR >= 5
                                          , &errCode
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -32,6 +32,12 @@
 
 #include "jpeglib.h"
 
+// libjpeg-turbo can decode RGB images directly in the same memory
+// layout of doc::rgba() pixels (R, G, B, and A=255 bytes).
+#ifdef JCS_ALPHA_EXTENSIONS
+  #define JPEG_DECODE_TO_RGBA 1
+#endif
+
 namespace app {
 
 using namespace base;
@@ -69,6 +75,8 @@ class JpegFormat : public FileFormat {
   }
 
   bool onLoad(FileOp* fop) override;
+  bool onLoadThumbnail(FileOp* fop, const gfx::Size& thumbnailSize) override;
+  bool loadImage(FileOp* fop, const gfx::Size& thumbnailSize);
   gfx::ColorSpaceRef loadColorSpace(FileOp* fop, jpeg_decompress_struct* dinfo);
 #ifdef ENABLE_SAVE
   bool onSave(FileOp* fop) override;
@@ -132,6 +140,16 @@ static bool is_icc_marker(jpeg_marker_struct* marker)
 }
 
 bool JpegFormat::onLoad(FileOp* fop)
+{
+  return loadImage(fop, gfx::Size(0, 0));
+}
+
+bool JpegFormat::onLoadThumbnail(FileOp* fop, const gfx::Size& thumbnailSize)
+{
+  return loadImage(fop, thumbnailSize);
+}
+
+bool JpegFormat::loadImage(FileOp* fop, const gfx::Size& thumbnailSize)
 {
   struct jpeg_decompress_struct dinfo;
   struct error_mgr jerr;
@@ -172,15 +190,33 @@ bool JpegFormat::onLoad(FileOp* fop)
   if (dinfo.jpeg_color_space == JCS_GRAYSCALE)
     dinfo.out_color_space = JCS_GRAYSCALE;
   else
+#if JPEG_DECODE_TO_RGBA
+    dinfo.out_color_space = JCS_EXT_RGBA;
+#else
     dinfo.out_color_space = JCS_RGB;
+#endif
+
+  // For thumbnails we can decode a scaled down image (1/2, 1/4, or
+  // 1/8) directly in the IDCT, which is a lot faster than decoding
+  // the whole image.
+  if (!thumbnailSize.isEmpty()) {
+    const int decimation = thumbnailDecimation(
+      gfx::Size(dinfo.image_width, dinfo.image_height), thumbnailSize);
+    dinfo.scale_num = 1;
+    dinfo.scale_denom = 1;
+    while (dinfo.scale_denom < 8 && int(dinfo.scale_denom*2) <= decimation)
+      dinfo.scale_denom *= 2;
+    dinfo.dct_method = JDCT_IFAST;
+    dinfo.do_fancy_upsampling = false;
+  }
 
   // Start decompressor.
   jpeg_start_decompress(&dinfo);
 
   // Create the image.
   ImageRef image = fop->sequenceImageToLoad(
-    (dinfo.out_color_space == JCS_RGB ? IMAGE_RGB:
-                                        IMAGE_GRAYSCALE),
+    (dinfo.out_color_space != JCS_GRAYSCALE ? IMAGE_RGB:
+                                              IMAGE_GRAYSCALE),
     dinfo.output_width,
     dinfo.output_height);
   if (!image) {
@@ -188,6 +224,11 @@ bool JpegFormat::onLoad(FileOp* fop)
     return false;
   }
 
+  // RGBA scanlines are decoded directly in the image rows, so we
+  // don't need to allocate the rows of the buffer.
+  const bool decodeToImage = (dinfo.output_components == 4);
+  ASSERT(!decodeToImage || image->pixelFormat() == IMAGE_RGB);
+
   // Create the buffer.
   buffer_height = dinfo.rec_outbuf_height;
   buffer = (JSAMPARRAY)base_malloc(sizeof(JSAMPROW) * buffer_height);
@@ -196,7 +237,7 @@ bool JpegFormat::onLoad(FileOp* fop)
     return false;
   }
 
-  for (c=0; c<(int)buffer_height; c++) {
+  for (c=0; !decodeToImage && c<(int)buffer_height; c++) {
     buffer[c] = (JSAMPROW)base_malloc(sizeof(JSAMPLE) *
                                       dinfo.output_width * dinfo.output_components);
     if (!buffer[c]) {
@@ -215,10 +256,20 @@ bool JpegFormat::onLoad(FileOp* fop)
 
   // Read each scan line.
   while (dinfo.output_scanline < dinfo.output_height) {
+    if (decodeToImage) {
+      for (c=0; c<(int)buffer_height; c++) {
+        const int y = std::min<int>(dinfo.output_scanline+c, dinfo.output_height-1);
+        buffer[c] = (JSAMPROW)image->getPixelAddress(0, y);
+      }
+    }
+
     num_scanlines = jpeg_read_scanlines(&dinfo, buffer, buffer_height);
 
+    if (decodeToImage) {
+      // Nothing to do, pixels are already in the image
+    }
     // RGB
-    if (image->pixelFormat() == IMAGE_RGB) {
+    else if (image->pixelFormat() == IMAGE_RGB) {
       uint8_t* src_address;
       uint32_t* dst_address;
       int x, y, r, g, b;
@@ -268,7 +319,7 @@ bool JpegFormat::onLoad(FileOp* fop)
     fop->document()->notifyColorSpaceChanged();
   }
 
-  for (c=0; c<(int)buffer_height; c++)
+  for (c=0; !decodeToImage && c<(int)buffer_height; c++)
     base_free(buffer[c]);
   base_free(buffer);
 
@@ -367,7 +418,7 @@ bool JpegFormat::onSave(FileOp* fop)
   LOG("JPEG: Saving with options: quality=%d\n", qualityValue);
 
   // Open the file for write in it.
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(open_file_with_exception_sync_on_close(fop->outputFilename(), "wb"));
   FILE* file = handle.get();
 
   // Allocate and initialize JPEG compression object.
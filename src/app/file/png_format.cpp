@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2022  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -16,12 +16,24 @@
 #include "app/file/format_options.h"
 #include "app/file/png_format.h"
 #include "app/file/png_options.h"
+#include "app/pref/preferences.h"
+#include "app/util/thread_budget.h"
+#include "base/exception.h"
 #include "base/file_handle.h"
+#include "base/thread_pool.h"
 #include "doc/doc.h"
 #include "gfx/color_space.h"
+#include "zlib.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <future>
+#include <limits>
+#include <memory>
 #include <stdio.h>
 #include <stdlib.h>
+#include <thread>
+#include <vector>
 
 #include "png.h"
 
@@ -55,15 +67,19 @@ class PngFormat : public FileFormat {
       FILE_SUPPORT_INDEXED |
       FILE_SUPPORT_SEQUENCES |
       FILE_SUPPORT_PALETTE_WITH_ALPHA |
+      FILE_SUPPORT_GET_FORMAT_OPTIONS |
       FILE_ENCODE_ABSTRACT_IMAGE;
   }
 
   bool onLoad(FileOp* fop) override;
+  bool onLoadThumbnail(FileOp* fop, const gfx::Size& thumbnailSize) override;
+  bool loadImage(FileOp* fop, const gfx::Size& thumbnailSize);
   gfx::ColorSpaceRef loadColorSpace(png_structp png, png_infop info);
 #ifdef ENABLE_SAVE
   bool onSave(FileOp* fop) override;
   void saveColorSpace(png_structp png, png_infop info, const gfx::ColorSpace* colorSpace);
 #endif
+  FormatOptionsPtr onAskUserForFormatOptions(FileOp* fop) override;
 };
 
 FileFormat* CreatePngFormat()
@@ -155,6 +171,16 @@ int png_user_chunk(png_structp png, png_unknown_chunkp unknown)
 } // anonymous namespace
 
 bool PngFormat::onLoad(FileOp* fop)
+{
+  return loadImage(fop, gfx::Size(0, 0));
+}
+
+bool PngFormat::onLoadThumbnail(FileOp* fop, const gfx::Size& thumbnailSize)
+{
+  return loadImage(fop, thumbnailSize);
+}
+
+bool PngFormat::loadImage(FileOp* fop, const gfx::Size& thumbnailSize)
 {
   png_uint_32 width, height, y;
   unsigned int sig_read = 0;
@@ -220,6 +246,21 @@ bool PngFormat::onLoad(FileOp* fop)
   png_get_IHDR(png, info, &width, &height, &bit_depth, &color_type,
                &interlace_type, NULL, NULL);
 
+  // To load a thumbnail we keep only some rows/columns of the image
+  // (1 of each "decimation" pixels). Interlaced images are decoded
+  // only until the end of the first Adam7 pass (1/8 of the pixels in
+  // each axis) when the thumbnail is small enough.
+  png_uint_32 decimation = 1;
+  bool firstPassOnly = false;
+  if (!thumbnailSize.isEmpty()) {
+    decimation = thumbnailDecimation(gfx::Size(width, height), thumbnailSize);
+    if (interlace_type == PNG_INTERLACE_ADAM7) {
+      firstPassOnly = (decimation >= 8);
+      decimation = (firstPassOnly ? decimation / 8: 1);
+    }
+  }
+  const png_uint_32 srcWidth = (firstPassOnly ? PNG_PASS_COLS(width, 0): width);
+  const png_uint_32 srcHeight = (firstPassOnly ? PNG_PASS_ROWS(height, 0): height);
 
   /* Set up the data transformations you want.  Note that these are all
    * optional.  Only call them if you want/need them.  Many of the
@@ -243,7 +284,7 @@ bool PngFormat::onLoad(FileOp* fop)
    * png_read_image().  To see how to handle interlacing passes,
    * see the png_read_row() method below:
    */
-  int number_passes = png_set_interlace_handling(png);
+  int number_passes = (firstPassOnly ? 1: png_set_interlace_handling(png));
 
   /* Optional call to gamma correct and add the background to the palette
    * and update info structure.
@@ -276,8 +317,8 @@ bool PngFormat::onLoad(FileOp* fop)
       return false;
   }
 
-  int imageWidth = png_get_image_width(png, info);
-  int imageHeight = png_get_image_height(png, info);
+  const int imageWidth = (srcWidth + decimation - 1) / decimation;
+  const int imageHeight = (srcHeight + decimation - 1) / decimation;
   ImageRef image = fop->sequenceImageToLoad(
     pixelFormat, imageWidth, imageHeight);
   if (!image)
@@ -324,33 +365,17 @@ bool PngFormat::onLoad(FileOp* fop)
     png_get_tRNS(png, info, nullptr, nullptr, &png_trans_color);
   }
 
-  // Allocate the memory to hold the image using the fields of info.
-  rows_pointer = (png_bytepp)png_malloc(png, sizeof(png_bytep) * height);
-  for (y = 0; y < height; y++)
-    rows_pointer[y] = (png_bytep)png_malloc(png, png_get_rowbytes(png, info));
-
-  for (int pass=0; pass<number_passes; ++pass) {
-    for (y = 0; y < height; y++) {
-      png_read_rows(png, rows_pointer+y, nullptr, 1);
-
-      fop->setProgress(
-        (double)((double)pass + (double)(y+1) / (double)(height))
-        / (double)number_passes);
-
-      if (fop->isStop())
-        break;
-    }
-  }
-
-  // Convert rows_pointer into the doc::Image
-  for (y = 0; y < height; y++) {
+  // Converts a row of pixels read by libpng into the doc::Image
+  const png_uint_32 dst_width = imageWidth;
+  const png_uint_32 src_skip = (decimation-1) * png_get_channels(png, info);
+  auto convertRow = [&](const png_bytep src_row, const png_uint_32 dst_y) {
     // RGB_ALPHA
     if (png_get_color_type(png, info) == PNG_COLOR_TYPE_RGB_ALPHA) {
-      uint8_t* src_address = rows_pointer[y];
-      uint32_t* dst_address = (uint32_t*)image->getPixelAddress(0, y);
+      const uint8_t* src_address = src_row;
+      uint32_t* dst_address = (uint32_t*)image->getPixelAddress(0, dst_y);
       unsigned int x, r, g, b, a;
 
-      for (x=0; x<width; x++) {
+      for (x=0; x<dst_width; x++, src_address+=src_skip) {
         r = *(src_address++);
         g = *(src_address++);
         b = *(src_address++);
@@ -360,11 +385,11 @@ bool PngFormat::onLoad(FileOp* fop)
     }
     // RGB
     else if (png_get_color_type(png, info) == PNG_COLOR_TYPE_RGB) {
-      uint8_t* src_address = rows_pointer[y];
-      uint32_t* dst_address = (uint32_t*)image->getPixelAddress(0, y);
+      const uint8_t* src_address = src_row;
+      uint32_t* dst_address = (uint32_t*)image->getPixelAddress(0, dst_y);
       unsigned int x, r, g, b, a;
 
-      for (x=0; x<width; x++) {
+      for (x=0; x<dst_width; x++, src_address+=src_skip) {
         r = *(src_address++);
         g = *(src_address++);
         b = *(src_address++);
@@ -386,11 +411,11 @@ bool PngFormat::onLoad(FileOp* fop)
     }
     // GRAY_ALPHA
     else if (png_get_color_type(png, info) == PNG_COLOR_TYPE_GRAY_ALPHA) {
-      uint8_t* src_address = rows_pointer[y];
-      uint16_t* dst_address = (uint16_t*)image->getPixelAddress(0, y);
+      const uint8_t* src_address = src_row;
+      uint16_t* dst_address = (uint16_t*)image->getPixelAddress(0, dst_y);
       unsigned int x, k, a;
 
-      for (x=0; x<width; x++) {
+      for (x=0; x<dst_width; x++, src_address+=src_skip) {
         k = *(src_address++);
         a = *(src_address++);
         *(dst_address++) = graya(k, a);
@@ -398,11 +423,11 @@ bool PngFormat::onLoad(FileOp* fop)
     }
     // GRAY
     else if (png_get_color_type(png, info) == PNG_COLOR_TYPE_GRAY) {
-      uint8_t* src_address = rows_pointer[y];
-      uint16_t* dst_address = (uint16_t*)image->getPixelAddress(0, y);
+      const uint8_t* src_address = src_row;
+      uint16_t* dst_address = (uint16_t*)image->getPixelAddress(0, dst_y);
       unsigned int x, k, a;
 
-      for (x=0; x<width; x++) {
+      for (x=0; x<dst_width; x++, src_address+=src_skip) {
         k = *(src_address++);
 
         // Transparent color
@@ -420,16 +445,55 @@ bool PngFormat::onLoad(FileOp* fop)
     }
     // PALETTE
     else if (png_get_color_type(png, info) == PNG_COLOR_TYPE_PALETTE) {
-      uint8_t* src_address = rows_pointer[y];
-      uint8_t* dst_address = (uint8_t*)image->getPixelAddress(0, y);
+      const uint8_t* src_address = src_row;
+      uint8_t* dst_address = (uint8_t*)image->getPixelAddress(0, dst_y);
       unsigned int x;
 
-      for (x=0; x<width; x++)
+      for (x=0; x<dst_width; x++, src_address+=src_skip)
         *(dst_address++) = *(src_address++);
     }
-    png_free(png, rows_pointer[y]);
+  };
+
+  // Decimated image (thumbnail), we need just one row in memory
+  if (decimation > 1 || firstPassOnly) {
+    png_bytep row = (png_bytep)png_malloc(png, png_get_rowbytes(png, info));
+    for (y = 0; y < srcHeight; y++) {
+      png_read_rows(png, &row, nullptr, 1);
+      if ((y % decimation) == 0)
+        convertRow(row, y / decimation);
+
+      fop->setProgress((double)(y+1) / (double)srcHeight);
+      if (fop->isStop())
+        break;
+    }
+    png_free(png, row);
+  }
+  else {
+    // Allocate the memory to hold the image using the fields of info.
+    rows_pointer = (png_bytepp)png_malloc(png, sizeof(png_bytep) * height);
+    for (y = 0; y < height; y++)
+      rows_pointer[y] = (png_bytep)png_malloc(png, png_get_rowbytes(png, info));
+
+    for (int pass=0; pass<number_passes; ++pass) {
+      for (y = 0; y < height; y++) {
+        png_read_rows(png, rows_pointer+y, nullptr, 1);
+
+        fop->setProgress(
+          (double)((double)pass + (double)(y+1) / (double)(height))
+          / (double)number_passes);
+
+        if (fop->isStop())
+          break;
+      }
+    }
+
+    // Convert rows_pointer into the doc::Image
+    for (y = 0; y < height; y++) {
+      convertRow(rows_pointer[y], y);
+      png_free(png, rows_pointer[y]);
+    }
+    png_free(png, rows_pointer);
   }
-  png_free(png, rows_pointer);
 
   // Setup the color space.
   auto colorSpace = PngFormat::loadColorSpace(png, info);
@@ -523,6 +587,256 @@ gfx::ColorSpaceRef PngFormat::loadColorSpace(png_structp png_ptr, png_infop info
 
 #ifdef ENABLE_SAVE
 
+// Images with more filtered bytes than two chunks of this size are
+// compressed in chunks by a pool of threads.
+static constexpr size_t kParallelChunkSize = 1024*1024;
+
+// Size of the zlib window (previous bytes that can be referenced by
+// the compressed data).
+static constexpr size_t kZlibWindowSize = 32*1024;
+
+static int png_zlib_level(const PngOptions& opts)
+{
+  const int level = opts.compressionLevel();
+  if (level < 0)
+    return Z_DEFAULT_COMPRESSION;
+  return std::clamp(level, Z_NO_COMPRESSION, Z_BEST_COMPRESSION);
+}
+
+static int png_zlib_strategy(const PngOptions& opts,
+                             const PngOptions::Filter filter)
+{
+  switch (opts.strategy()) {
+    case PngOptions::Strategy::Filtered:    return Z_FILTERED;
+    case PngOptions::Strategy::HuffmanOnly: return Z_HUFFMAN_ONLY;
+    case PngOptions::Strategy::RLE:         return Z_RLE;
+    default:
+      // Same default strategy as libpng
+      return (filter == PngOptions::Filter::None ? Z_DEFAULT_STRATEGY:
+                                                   Z_FILTERED);
+  }
+}
+
+static inline int paeth_predictor(int a, int b, int c)
+{
+  const int p = a + b - c;
+  const int pa = std::abs(p - a);
+  const int pb = std::abs(p - b);
+  const int pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc)
+    return a;
+  if (pb <= pc)
+    return b;
+  return c;
+}
+
+// Filters one "row" with the given PNG filter "type" (0=none, 1=sub,
+// 2=up, 3=average, 4=paeth) in "out" (which must have room for the
+// filter type byte + rowbytes). "prior" is the previous unfiltered
+// row (nullptr for the first row).
+static void filter_png_row(const int type, const int bpp,
+                           const uint8_t* row, const uint8_t* prior,
+                           const size_t rowbytes, uint8_t* out)
+{
+  *(out++) = type;
+  for (size_t i=0; i<rowbytes; ++i) {
+    const int a = (i >= size_t(bpp) ? row[i-bpp]: 0);
+    const int b = (prior ? prior[i]: 0);
+    const int c = (prior && i >= size_t(bpp) ? prior[i-bpp]: 0);
+    int predictor = 0;
+    switch (type) {
+      case 1: predictor = a; break;
+      case 2: predictor = b; break;
+      case 3: predictor = (a + b) / 2; break;
+      case 4: predictor = paeth_predictor(a, b, c); break;
+    }
+    out[i] = uint8_t(row[i] - predictor);
+  }
+}
+
+// Filters the rows [y0, y1) of "rows" (unfiltered rows of "rowbytes"
+// each one) in "out" (each filtered row has 1+rowbytes bytes). The
+// "Adaptive" filter uses the libpng heuristic: the filter type with
+// the minimum sum of absolute differences for each row.
+static void filter_png_rows(const PngOptions::Filter filter, const int bpp,
+                            const uint8_t* rows, const size_t rowbytes,
+                            const int y0, const int y1, uint8_t* out)
+{
+  std::vector<uint8_t> candidate;
+  if (filter == PngOptions::Filter::Adaptive)
+    candidate.resize(1+rowbytes);
+
+  for (int y=y0; y<y1; ++y, out += 1+rowbytes) {
+    const uint8_t* row = rows + y*rowbytes;
+    const uint8_t* prior = (y > 0 ? row - rowbytes: nullptr);
+
+    switch (filter) {
+      case PngOptions::Filter::Sub:
+        filter_png_row(1, bpp, row, prior, rowbytes, out);
+        break;
+      case PngOptions::Filter::Adaptive: {
+        size_t bestSum = std::numeric_limits<size_t>::max();
+        for (int type=0; type<5; ++type) {
+          filter_png_row(type, bpp, row, prior, rowbytes, &candidate[0]);
+
+          size_t sum = 0;
+          for (size_t i=1; i<=rowbytes; ++i)
+            sum += std::abs(int(int8_t(candidate[i])));
+
+          if (sum < bestSum) {
+            bestSum = sum;
+            std::copy(candidate.begin(), candidate.end(), out);
+          }
+        }
+        break;
+      }
+      default:
+        filter_png_row(0, bpp, row, prior, rowbytes, out);
+        break;
+    }
+  }
+}
+
+// Compresses the filtered "data" as a piece of a raw deflate stream
+// using the previous filtered bytes as dictionary. Only the last
+// piece finishes the stream, the others are flushed to a byte
+// boundary so all of them can be concatenated.
+static void deflate_png_chunk(const uint8_t* data, const size_t size,
+                              const uint8_t* dict, const size_t dictSize,
+                              const bool last, const int level,
+                              const int strategy,
+                              std::vector<uint8_t>& output)
+{
+  z_stream zstream;
+  zstream.zalloc = (alloc_func)0;
+  zstream.zfree  = (free_func)0;
+  zstream.opaque = (voidpf)0;
+  if (deflateInit2(&zstream, level, Z_DEFLATED,
+                   -MAX_WBITS, 8, strategy) != Z_OK)
+    throw base::Exception("Error initializing zlib to save PNG file");
+
+  if (dictSize > 0)
+    deflateSetDictionary(&zstream, dict, uInt(dictSize));
+
+  output.resize(deflateBound(&zstream, uLong(size)) + 16);
+  zstream.next_in = (Bytef*)data;
+  zstream.avail_in = uInt(size);
+  zstream.next_out = (Bytef*)&output[0];
+  zstream.avail_out = uInt(output.size());
+
+  const int flush = (last ? Z_FINISH: Z_SYNC_FLUSH);
+  int ret;
+  while (true) {
+    ret = deflate(&zstream, flush);
+    if (ret == Z_STREAM_ERROR)
+      break;
+    if (last ? ret == Z_STREAM_END:
+               zstream.avail_in == 0 && zstream.avail_out > 0)
+      break;
+
+    // Output buffer is too small
+    const size_t used = zstream.total_out;
+    output.resize(2*output.size());
+    zstream.next_out = (Bytef*)&output[used];
+    zstream.avail_out = uInt(output.size() - used);
+  }
+
+  output.resize(zstream.total_out);
+  deflateEnd(&zstream);
+
+  if (ret == Z_STREAM_ERROR)
+    throw base::Exception("Error compressing PNG image data");
+}
+
+// Filters and compresses the given unfiltered "rows" in a pool of
+// threads, and returns the pieces of the zlib (deflate) stream to
+// be written in IDAT chunks (including the zlib header in the first
+// piece and the Adler-32 checksum in the last one).
+static std::vector<std::vector<uint8_t>>
+compress_png_rows_in_parallel(const PngOptions& opts,
+                              PngOptions::Filter filter,
+                              const int bpp,
+                              const uint8_t* rows,
+                              const size_t rowbytes,
+                              const int height,
+                              const int threads)
+{
+  const int level = png_zlib_level(opts);
+  const int strategy = png_zlib_strategy(opts, filter);
+  const size_t filteredRowbytes = 1+rowbytes;
+  const int rowsPerChunk = std::max<int>(1, kParallelChunkSize / filteredRowbytes);
+  const int dictRows = int((kZlibWindowSize + filteredRowbytes - 1) / filteredRowbytes);
+  const int nchunks = (height + rowsPerChunk - 1) / rowsPerChunk;
+
+  struct Chunk {
+    std::vector<uint8_t> data;
+    uLong adler = 0;
+    size_t size = 0;
+  };
+  std::vector<Chunk> chunks(nchunks);
+  {
+    base::thread_pool pool(threads);
+    std::vector<std::future<void>> done;
+    for (int i=0; i<nchunks; ++i) {
+      auto task = std::make_shared<std::packaged_task<void()>>(
+        [&, i]{
+          const int y0 = i*rowsPerChunk;
+          const int y1 = std::min(height, y0+rowsPerChunk);
+          const int yd = std::max(0, y0-dictRows);
+
+          // Filter the rows of the dictionary (the previous rows) and
+          // the rows of this chunk in the same buffer.
+          std::vector<uint8_t> filtered((y1-yd)*filteredRowbytes);
+          filter_png_rows(filter, bpp, rows, rowbytes, yd, y1, &filtered[0]);
+
+          const size_t dictBytes = std::min(kZlibWindowSize,
+                                            (y0-yd)*filteredRowbytes);
+          const uint8_t* data = &filtered[(y0-yd)*filteredRowbytes];
+          const size_t size = (y1-y0)*filteredRowbytes;
+
+          Chunk& chunk = chunks[i];
+          deflate_png_chunk(data, size, data-dictBytes, dictBytes,
+                            (i == nchunks-1), level, strategy, chunk.data);
+          chunk.adler = adler32(adler32(0L, Z_NULL, 0), data, uInt(size));
+          chunk.size = size;
+        });
+      done.push_back(task->get_future());
+      pool.execute([task]{ (*task)(); });
+    }
+    // Wait all chunks (rethrowing the first error after that)
+    pool.wait_all();
+    for (auto& f : done)
+      f.get();
+  }
+
+  // zlib header (CMF + FLG with the compression level hint)
+  const uint8_t flevel =
+    (level == Z_DEFAULT_COMPRESSION || level == 6 ? 0x9C:
+     level <= 1 ? 0x01:
+     level <= 5 ? 0x5E:
+                  0xDA);
+
+  uLong adler = adler32(0L, Z_NULL, 0);
+  std::vector<std::vector<uint8_t>> output(nchunks);
+  for (int i=0; i<nchunks; ++i) {
+    adler = adler32_combine(adler, chunks[i].adler, z_off_t(chunks[i].size));
+
+    std::vector<uint8_t>& piece = output[i];
+    if (i == 0) {
+      piece.push_back(0x78);
+      piece.push_back(flevel);
+    }
+    piece.insert(piece.end(), chunks[i].data.begin(), chunks[i].data.end());
+    chunks[i].data.clear();
+    chunks[i].data.shrink_to_fit();
+  }
+  output.back().push_back((adler >> 24) & 0xff);
+  output.back().push_back((adler >> 16) & 0xff);
+  output.back().push_back((adler >> 8) & 0xff);
+  output.back().push_back(adler & 0xff);
+  return output;
+}
+
 bool PngFormat::onSave(FileOp* fop)
 {
   png_infop info;
@@ -530,7 +844,7 @@ bool PngFormat::onSave(FileOp* fop)
   png_bytep row_pointer;
   int color_type = 0;
 
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(open_file_with_exception_sync_on_close(fop->outputFilename(), "wb"));
   FILE* fp = handle.get();
 
   png_structp png =
@@ -584,9 +898,27 @@ bool PngFormat::onSave(FileOp* fop)
   png_set_IHDR(png, info, width, height, 8, color_type,
                PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 
-  // User chunks
   auto opts = fop->formatOptionsOfDocument<PngOptions>();
-  if (opts && !opts->isEmpty()) {
+
+  // Compression options
+  PngOptions::Filter filter = opts->filter();
+  if (filter == PngOptions::Filter::Default) {
+    filter = (color_type == PNG_COLOR_TYPE_PALETTE ? PngOptions::Filter::None:
+                                                     PngOptions::Filter::Adaptive);
+  }
+  else {
+    png_set_filter(png, PNG_FILTER_TYPE_BASE,
+                   (filter == PngOptions::Filter::None ? PNG_FILTER_NONE:
+                    filter == PngOptions::Filter::Sub ? PNG_FILTER_SUB:
+                                                        PNG_ALL_FILTERS));
+  }
+  if (opts->compressionLevel() >= 0)
+    png_set_compression_level(png, png_zlib_level(*opts));
+  if (opts->strategy() != PngOptions::Strategy::Default)
+    png_set_compression_strategy(png, png_zlib_strategy(*opts, filter));
+
+  // User chunks
+  if (!opts->isEmpty()) {
     int num_unknowns = opts->size();
     ASSERT(num_unknowns > 0);
     std::vector<png_unknown_chunk> unknowns(num_unknowns);
@@ -663,11 +995,8 @@ bool PngFormat::onSave(FileOp* fop)
   png_write_info(png, info);
   png_set_packing(png);
 
-  row_pointer = (png_bytep)png_malloc(png, png_get_rowbytes(png, info));
-
-  for (png_uint_32 y=0; y<height; ++y) {
-    uint8_t* dst_address = row_pointer;
-
+  // Converts the "y" scanline of the image to the PNG row format
+  auto fillRow = [&](const png_uint_32 y, uint8_t* dst_address) {
     if (png_get_color_type(png, info) == PNG_COLOR_TYPE_RGB_ALPHA) {
       unsigned int x, c, a;
       bool opaque = true;
@@ -767,13 +1096,55 @@ bool PngFormat::onSave(FileOp* fop)
         *(dst_address++) = *(src_address++);
     }
 
-    png_write_rows(png, &row_pointer, 1);
+  };
+
+  const size_t rowbytes = png_get_rowbytes(png, info);
+  const ThreadBudget budget(std::thread::hardware_concurrency(),
+                           ThreadPriority::Export);
+  const int threads = budget.threads();
+
+  // Big images are filtered and compressed in a pool of threads
+  if (threads > 1 &&
+      (1+rowbytes)*height > 2*kParallelChunkSize) {
+    const int bpp = std::max<int>(1, rowbytes / width);
+    std::vector<uint8_t> rows(rowbytes*height);
+    for (png_uint_32 y=0; y<height; ++y)
+      fillRow(y, &rows[y*rowbytes]);
+
+    auto idat = compress_png_rows_in_parallel(
+      *opts, filter, bpp, &rows[0], rowbytes, height, threads);
+    rows.clear();
+    rows.shrink_to_fit();
+
+    for (const auto& data : idat)
+      png_write_chunk(png, (png_const_bytep)"IDAT", &data[0], data.size());
 
-    fop->setProgress((double)(y+1) / (double)(height));
+    // As we've written the IDAT chunks by ourselves, we cannot use
+    // png_write_end() (it fails because libpng didn't write any
+    // IDAT), so we write the user chunks after IDAT and IEND here.
+    for (const auto& chunk : opts->chunks()) {
+      if ((chunk.location & PNG_AFTER_IDAT) && chunk.name.size() >= 4) {
+        png_write_chunk(png, (png_const_bytep)chunk.name.c_str(),
+                        (png_const_bytep)chunk.data.data(), chunk.data.size());
+      }
+    }
+    png_write_chunk(png, (png_const_bytep)"IEND", nullptr, 0);
+
+    fop->setProgress(1.0);
   }
+  else {
+    row_pointer = (png_bytep)png_malloc(png, rowbytes);
+
+    for (png_uint_32 y=0; y<height; ++y) {
+      fillRow(y, row_pointer);
+      png_write_rows(png, &row_pointer, 1);
 
-  png_free(png, row_pointer);
-  png_write_end(png, info);
+      fop->setProgress((double)(y+1) / (double)(height));
+    }
+
+    png_free(png, row_pointer);
+    png_write_end(png, info);
+  }
 
   if (spec.colorMode() == ColorMode::INDEXED) {
     png_free(png, palette);
@@ -832,4 +1203,22 @@ void PngFormat::saveColorSpace(png_structp png_ptr, png_infop info_ptr,
 
 #endif  // ENABLE_SAVE
 
+// There is no dialog to configure the PNG compression, we just take
+// the options from the preferences (png section).
+FormatOptionsPtr PngFormat::onAskUserForFormatOptions(FileOp* fop)
+{
+  auto opts = fop->formatOptionsOfDocument<PngOptions>();
+  auto& pref = Preferences::instance();
+  opts->setCompressionLevel(pref.png.compressionLevel());
+  opts->setFilter(PngOptions::Filter(
+    std::clamp(pref.png.filter(),
+               int(PngOptions::Filter::Default),
+               int(PngOptions::Filter::Adaptive))));
+  opts->setStrategy(PngOptions::Strategy(
+    std::clamp(pref.png.strategy(),
+               int(PngOptions::Strategy::Default),
+               int(PngOptions::Strategy::RLE))));
+  return opts;
+}
+
 } // namespace app
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -25,6 +25,22 @@ namespace app {
 
     using Chunks = std::vector<Chunk>;
 
+    // Filter applied to each row before compressing it.
+    enum class Filter {
+      Default,    // libpng default (none for indexed images, adaptive for others)
+      None,
+      Sub,
+      Adaptive,   // The filter that generates the smallest row is used
+    };
+
+    // zlib strategy to compress the filtered rows.
+    enum class Strategy {
+      Default,
+      Filtered,
+      HuffmanOnly,
+      RLE,        // Faster for images with big flat areas (e.g. pixel-art)
+    };
+
     void addChunk(Chunk&& chunk) {
       m_userChunks.emplace_back(std::move(chunk));
     }
@@ -39,8 +55,21 @@ namespace app {
 
     const Chunks& chunks() const { return m_userChunks; }
 
+    // zlib compression level (-1 = zlib default, 0 = uncompressed,
+    // 1 = fastest, 9 = smallest).
+    int compressionLevel() const { return m_compressionLevel; }
+    Filter filter() const { return m_filter; }
+    Strategy strategy() const { return m_strategy; }
+
+    void setCompressionLevel(int level) { m_compressionLevel = level; }
+    void setFilter(Filter filter) { m_filter = filter; }
+    void setStrategy(Strategy strategy) { m_strategy = strategy; }
+
   private:
     Chunks m_userChunks;
+    int m_compressionLevel = -1;
+    Filter m_filter = Filter::Default;
+    Strategy m_strategy = Strategy::Default;
   };
 
 } // namespace app
@@ -1,13 +1,19 @@
 // Aseprite
-// Copyright (C) 2021  Igara Studio S.A.
+// Copyright (C) 2021-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
 
 #include "app/file/file.h"
 #include "app/file/file_format.h"
+#include "app/file/file_op_config.h"
 #include "base/file_handle.h"
+#include "base/string.h"
+#include "base/thread_pool.h"
+#include "dio/zlib_stream.h"
 #include "doc/blend_mode.h"
+#include "doc/cel.h"
+#include "doc/cel_data.h"
 #include "doc/image_impl.h"
 #include "doc/layer.h"
 #include "doc/palette.h"
@@ -15,6 +21,14 @@
 #include "doc/sprite.h"
 #include "psd/psd.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
 namespace app {
 
 doc::PixelFormat psd_cmode_to_ase_format(const psd::ColorMode mode)
@@ -431,11 +445,612 @@ private:
   bool m_layerHasTransparentChannel;
 };
 
+
+//////////////////////////////////////////////////////////////////////
+// Indexed PSD import
+//
+// The first pass reads only the layer records and the position of
+// the channel data of each layer in the file. The channels of each
+// layer are read and decoded (in parallel) the first time its cel
+// image is needed, so opening a big file to use only some of its
+// layers is fast. Files with features that are not supported here
+// (animation, slices, 16-bit layers in "Lr16" blocks, color modes
+// other than RGB/grayscale, etc.) are loaded with psd::Decoder.
+//////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct PsdChannel {
+  int16_t id;
+  uint64_t offset;              // Offset of the compression field
+  uint64_t length;              // Including the compression field
+};
+
+struct PsdIndexHeader {
+  int width = 0;
+  int height = 0;
+  int depth = 0;
+  doc::PixelFormat pixelFormat = doc::IMAGE_RGB;
+};
+
+struct PsdLayerPixels {
+  std::string filename;
+  bool psb;
+  int depth;
+  doc::PixelFormat pixelFormat;
+  gfx::Size size;
+  std::vector<PsdChannel> channels;
+};
+
+struct PsdLayerIndex {
+  gfx::Rect bounds;
+  std::vector<PsdChannel> channels;
+  doc::BlendMode blendMode = doc::BlendMode::NORMAL;
+  int opacity = 255;
+  std::string name;
+  int sectionType = 0;          // 1/2 = group, 3 = end of group marker
+};
+
+bool psd_seek(FILE* f, const uint64_t pos)
+{
+#ifdef _WIN32
+  return (_fseeki64(f, int64_t(pos), SEEK_SET) == 0);
+#else
+  return (fseeko(f, off_t(pos), SEEK_SET) == 0);
+#endif
+}
+
+doc::BlendMode psd_blendkey_to_ase(const char* key)
+{
+  static const struct {
+    const char* key;
+    doc::BlendMode mode;
+  } modes[] = {
+    { "mul ", doc::BlendMode::MULTIPLY },
+    { "dark", doc::BlendMode::DARKEN },
+    { "idiv", doc::BlendMode::COLOR_BURN },
+    { "lite", doc::BlendMode::LIGHTEN },
+    { "scrn", doc::BlendMode::SCREEN },
+    { "div ", doc::BlendMode::COLOR_DODGE },
+    { "over", doc::BlendMode::OVERLAY },
+    { "sLit", doc::BlendMode::SOFT_LIGHT },
+    { "hLit", doc::BlendMode::HARD_LIGHT },
+    { "diff", doc::BlendMode::DIFFERENCE },
+    { "smud", doc::BlendMode::EXCLUSION },
+    { "fsub", doc::BlendMode::SUBTRACT },
+    { "fdiv", doc::BlendMode::DIVIDE },
+    { "hue ", doc::BlendMode::HSL_HUE },
+    { "sat ", doc::BlendMode::HSL_SATURATION },
+    { "colr", doc::BlendMode::HSL_COLOR },
+    { "lum ", doc::BlendMode::HSL_LUMINOSITY },
+  };
+  for (const auto& m : modes) {
+    if (std::strncmp(key, m.key, 4) == 0)
+      return m.mode;
+  }
+  return doc::BlendMode::NORMAL;
+}
+
+// Reads big-endian values from the file keeping track of the
+// position (to calculate the offsets of the channel data without
+// seeking). The "ok" flag is false after trying to read beyond the
+// end of the file.
+class PsdIndexReader {
+public:
+  PsdIndexReader(FILE* f) : m_f(f) { }
+
+  bool ok() const { return m_ok; }
+  uint64_t tell() const { return m_pos; }
+  bool psb() const { return m_psb; }
+  void setPsb(const bool psb) { m_psb = psb; }
+
+  uint8_t read8() {
+    int c = std::fgetc(m_f);
+    if (c == EOF) {
+      m_ok = false;
+      return 0;
+    }
+    ++m_pos;
+    return uint8_t(c);
+  }
+  uint16_t read16() {
+    uint16_t v = read8() << 8;
+    return v | read8();
+  }
+  uint32_t read32() {
+    uint32_t v = read16() << 16;
+    return v | read16();
+  }
+  uint64_t read64() {
+    uint64_t v = uint64_t(read32()) << 32;
+    return v | read32();
+  }
+  // Lengths of sections are 64-bit in PSB files.
+  uint64_t readLength() {
+    return (m_psb ? read64(): read32());
+  }
+  void readKey(char key[4]) {
+    for (int i=0; i<4; ++i)
+      key[i] = char(read8());
+  }
+  void seek(const uint64_t pos) {
+    if (m_ok && !psd_seek(m_f, pos))
+      m_ok = false;
+    m_pos = pos;
+  }
+  void skip(const uint64_t n) { seek(m_pos + n); }
+
+private:
+  FILE* m_f;
+  uint64_t m_pos = 0;
+  bool m_psb = false;
+  bool m_ok = true;
+};
+
+bool read_psd_layer_record(PsdIndexReader& r, PsdLayerIndex& layer)
+{
+  const int32_t top = int32_t(r.read32());
+  const int32_t left = int32_t(r.read32());
+  const int32_t bottom = int32_t(r.read32());
+  const int32_t right = int32_t(r.read32());
+  layer.bounds = gfx::Rect(left, top,
+                           std::max(0, right - left),
+                           std::max(0, bottom - top));
+
+  const int nchannels = r.read16();
+  for (int i=0; i<nchannels && r.ok(); ++i) {
+    PsdChannel chan;
+    chan.id = int16_t(r.read16());
+    chan.offset = 0;
+    chan.length = r.readLength();
+    layer.channels.push_back(chan);
+  }
+
+  char key[4];
+  r.readKey(key);
+  if (std::strncmp(key, "8BIM", 4) != 0)
+    return false;
+  r.readKey(key);
+  layer.blendMode = psd_blendkey_to_ase(key);
+  layer.opacity = r.read8();
+  r.read8();                    // Clipping
+  r.read8();                    // Flags
+  r.read8();                    // Filler
+
+  const uint64_t extraEnd = r.read32() + r.tell();
+  r.skip(r.read32());           // Layer mask data
+  r.skip(r.read32());           // Layer blending ranges
+
+  // Pascal string padded to 4 bytes
+  const int nameLen = r.read8();
+  for (int i=0; i<nameLen; ++i)
+    layer.name.push_back(char(r.read8()));
+  r.skip((4 - ((nameLen+1) % 4)) % 4);
+
+  // Additional layer information
+  while (r.ok() && r.tell()+12 <= extraEnd) {
+    r.readKey(key);
+    if (std::strncmp(key, "8BIM", 4) != 0 &&
+        std::strncmp(key, "8B64", 4) != 0)
+      break;
+
+    r.readKey(key);
+    // Some blocks have a 64-bit length in PSB files
+    bool len64 = false;
+    if (r.psb()) {
+      for (const char* k : { "LMsk", "Lr16", "Lr32", "Layr", "Mt16", "Mt32",
+                             "Mtrn", "Alph", "FMsk", "lnk2", "FEid", "FXid",
+                             "PxSD" }) {
+        if (std::strncmp(key, k, 4) == 0) {
+          len64 = true;
+          break;
+        }
+      }
+    }
+    const uint64_t len = (len64 ? r.read64(): r.read32());
+    const uint64_t end = r.tell() + len;
+
+    if (std::strncmp(key, "luni", 4) == 0) {
+      // Unicode name (UTF-16)
+      const uint32_t n = r.read32();
+      std::wstring name;
+      for (uint32_t i=0; i<n && r.tell()+2 <= end; ++i)
+        name.push_back(wchar_t(r.read16()));
+      while (!name.empty() && name.back() == 0)
+        name.pop_back();
+      layer.name = base::to_utf8(name);
+    }
+    else if (std::strncmp(key, "lsct", 4) == 0 ||
+             std::strncmp(key, "lsdk", 4) == 0) {
+      layer.sectionType = int(r.read32());
+    }
+    // Blocks with layer data (e.g. "Lr16") or animation/linked
+    // data are not supported.
+    else if (std::strncmp(key, "shmd", 4) == 0 ||
+             std::strncmp(key, "Layr", 4) == 0 ||
+             std::strncmp(key, "Lr16", 4) == 0 ||
+             std::strncmp(key, "Lr32", 4) == 0) {
+      return false;
+    }
+    r.seek(end);
+  }
+  r.seek(extraEnd);
+  return r.ok();
+}
+
+// Reads the layer records of the file. Returns false if the file
+// must be loaded with psd::Decoder.
+bool read_psd_layers_index(FILE* f,
+                           PsdIndexHeader& header,
+                           bool& psb,
+                           std::vector<PsdLayerIndex>& layers)
+{
+  PsdIndexReader r(f);
+
+  char key[4];
+  r.readKey(key);
+  if (std::strncmp(key, "8BPS", 4) != 0)
+    return false;
+
+  const int version = r.read16();
+  if (version != 1 && version != 2)
+    return false;
+  psb = (version == 2);
+  r.setPsb(psb);
+  r.skip(6);                    // Reserved
+
+  r.read16();                   // Number of channels
+  header.height = int(r.read32());
+  header.width = int(r.read32());
+  header.depth = r.read16();
+  switch (r.read16()) {
+    case 1: header.pixelFormat = doc::IMAGE_GRAYSCALE; break;
+    case 3: header.pixelFormat = doc::IMAGE_RGB; break;
+    default:
+      return false;
+  }
+  if ((header.depth != 8 && header.depth != 16) ||
+      header.width <= 0 || header.height <= 0)
+    return false;
+
+  r.skip(r.read32());           // Color mode data
+
+  // Image resources: slices (1050) and animation data (4000) are
+  // loaded only by psd::Decoder.
+  const uint64_t resourcesEnd = r.read32() + r.tell();
+  while (r.ok() && r.tell()+12 <= resourcesEnd) {
+    r.readKey(key);
+    if (std::strncmp(key, "8BIM", 4) != 0)
+      return false;
+    const int id = r.read16();
+    if (id == 1050 || id == 4000)
+      return false;
+    const int nameLen = r.read8();
+    r.skip(nameLen + ((nameLen+1) & 1)); // Padded to even size
+    const uint32_t size = r.read32();
+    r.skip(size + (size & 1));
+  }
+  r.seek(resourcesEnd);
+
+  // Layer and mask information
+  if (r.readLength() == 0)
+    return false;
+  const uint64_t layerInfoLen = r.readLength();
+  if (layerInfoLen == 0)
+    return false;
+  const uint64_t layerInfoEnd = r.tell() + layerInfoLen;
+
+  const int nlayers = std::abs(int16_t(r.read16()));
+  if (nlayers == 0)
+    return false;
+
+  layers.resize(nlayers);
+  for (auto& layer : layers) {
+    if (!read_psd_layer_record(r, layer))
+      return false;
+  }
+
+  // The channel image data is stored just after the layer records,
+  // in the same order, starting with the compression field.
+  uint64_t offset = r.tell();
+  for (auto& layer : layers) {
+    for (auto& chan : layer.channels) {
+      chan.offset = offset;
+      offset += chan.length;
+    }
+  }
+  return (r.ok() && offset <= layerInfoEnd);
+}
+
+// Converts a row of samples of the given depth to 8-bit samples.
+void psd_row_to_8bit(const uint8_t* src, const int w, const int depth,
+                     uint8_t* dst)
+{
+  if (depth == 8)
+    std::copy(src, src+w, dst);
+  else {
+    // Use the most significant byte of each 16-bit sample
+    for (int x=0; x<w; ++x, src+=2)
+      *(dst++) = src[0];
+  }
+}
+
+// Decodes the "data" of a channel (starting at the compression field)
+// as w*h 8-bit samples.
+bool decode_psd_channel(const uint8_t* data, const size_t size,
+                        const int w, const int h,
+                        const int depth, const bool psb,
+                        std::vector<uint8_t>& output)
+{
+  if (size < 2)
+    return false;
+
+  const size_t rowBytes = size_t(w) * (depth / 8);
+  const int compression = (data[0] << 8) | data[1];
+  const uint8_t* src = data + 2;
+  const uint8_t* const srcEnd = data + size;
+
+  output.resize(size_t(w) * h);
+  std::vector<uint8_t> row(rowBytes);
+
+  switch (compression) {
+
+    // Raw data
+    case 0:
+      if (size_t(srcEnd - src) < rowBytes*h)
+        return false;
+      for (int y=0; y<h; ++y, src+=rowBytes)
+        psd_row_to_8bit(src, w, depth, &output[size_t(y)*w]);
+      return true;
+
+    // RLE (PackBits) with the byte count of each row first
+    case 1: {
+      const uint8_t* counts = src;
+      const int countSize = (psb ? 4: 2);
+      src += size_t(h) * countSize;
+      if (src > srcEnd)
+        return false;
+      for (int y=0; y<h; ++y, counts+=countSize) {
+        size_t rowSize = (counts[0] << 8) | counts[1];
+        if (psb)
+          rowSize = (rowSize << 16) | (counts[2] << 8) | counts[3];
+        if (size_t(srcEnd - src) < rowSize)
+          return false;
+
+        const uint8_t* p = src;
+        const uint8_t* const pEnd = src + rowSize;
+        size_t x = 0;
+        while (x < rowBytes && p < pEnd) {
+          const int n = int8_t(*(p++));
+          if (n >= 0) {
+            if (pEnd - p < n+1)
+              return false;
+            const size_t count = std::min<size_t>(n+1, rowBytes-x);
+            std::copy(p, p+count, &row[x]);
+            p += n+1;
+            x += count;
+          }
+          else if (n != -128) {
+            if (p >= pEnd)
+              return false;
+            const size_t count = std::min<size_t>(1-n, rowBytes-x);
+            std::fill(&row[x], &row[x]+count, *(p++));
+            x += count;
+          }
+        }
+        if (x < rowBytes)
+          return false;
+        psd_row_to_8bit(&row[0], w, depth, &output[size_t(y)*w]);
+        src = pEnd;
+      }
+      return true;
+    }
+
+    // ZIP without/with prediction
+    case 2:
+    case 3: {
+      std::vector<uint8_t> raw(rowBytes*h);
+      dio::InflateStream zstream;
+      zstream->next_in = (Bytef*)src;
+      zstream->avail_in = uInt(srcEnd - src);
+      zstream->next_out = (Bytef*)&raw[0];
+      zstream->avail_out = uInt(raw.size());
+      const int err = inflate(zstream.get(), Z_FINISH);
+      if ((err != Z_STREAM_END && err != Z_OK && err != Z_BUF_ERROR) ||
+          zstream->avail_out != 0)
+        return false;
+
+      for (int y=0; y<h; ++y) {
+        uint8_t* p = &raw[y*rowBytes];
+        if (compression == 3) {
+          if (depth == 8) {
+            for (int x=1; x<w; ++x)
+              p[x] += p[x-1];
+          }
+          else {
+            for (int x=1; x<w; ++x) {
+              const uint16_t v = ((p[2*x] << 8) | p[2*x+1]) +
+                                 ((p[2*x-2] << 8) | p[2*x-1]);
+              p[2*x] = v >> 8;
+              p[2*x+1] = v & 0xff;
+            }
+          }
+        }
+        psd_row_to_8bit(p, w, depth, &output[size_t(y)*w]);
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+// Reads and decodes the channels of one layer. Errors are ignored
+// (the pixels of the channel are left transparent/black), we cannot
+// report them to the user in the middle of any operation that needs
+// the cel image (e.g. if the file was modified after it was loaded).
+doc::ImageRef load_psd_layer_pixels(const PsdLayerPixels& pixels)
+{
+  const int w = pixels.size.w;
+  const int h = pixels.size.h;
+  doc::ImageRef image(doc::Image::create(pixels.pixelFormat, w, h));
+  doc::clear_image(image.get(), 0);
+
+  // Read the compressed data of all channels (sequentially) and
+  // decode each one in a different thread.
+  const int n = int(pixels.channels.size());
+  if (n == 0)
+    return image;
+
+  std::vector<std::vector<uint8_t>> compressed(n);
+  std::vector<std::vector<uint8_t>> planes(n);
+  std::vector<char> decoded(n, false);
+  {
+    base::FileHandle handle(base::open_file(pixels.filename, "rb"));
+    FILE* f = handle.get();
+    if (!f)
+      return image;
+    for (int i=0; i<n; ++i) {
+      const PsdChannel& chan = pixels.channels[i];
+      compressed[i].resize(chan.length);
+      if (!psd_seek(f, chan.offset) ||
+          std::fread(compressed[i].data(), 1, chan.length, f) != chan.length)
+        compressed[i].clear();
+    }
+  }
+  {
+    base::thread_pool pool(
+      std::clamp<int>(std::thread::hardware_concurrency(), 1, n));
+    for (int i=0; i<n; ++i) {
+      pool.execute([&pixels, &compressed, &planes, &decoded, i, w, h]{
+        decoded[i] = decode_psd_channel(
+          compressed[i].data(), compressed[i].size(),
+          w, h, pixels.depth, pixels.psb, planes[i]);
+        compressed[i] = std::vector<uint8_t>();
+      });
+    }
+    pool.wait_all();
+  }
+
+  // Channels of each pixel component (-1 = alpha)
+  const uint8_t* r = nullptr;
+  const uint8_t* g = nullptr;
+  const uint8_t* b = nullptr;
+  const uint8_t* a = nullptr;
+  for (int i=0; i<n; ++i) {
+    if (!decoded[i])
+      continue;
+    switch (pixels.channels[i].id) {
+      case 0: r = planes[i].data(); break;
+      case 1: g = planes[i].data(); break;
+      case 2: b = planes[i].data(); break;
+      case -1: a = planes[i].data(); break;
+    }
+  }
+
+  size_t i = 0;
+  for (int y=0; y<h; ++y) {
+    if (pixels.pixelFormat == doc::IMAGE_RGB) {
+      auto dst = (RgbTraits::address_t)image->getPixelAddress(0, y);
+      for (int x=0; x<w; ++x, ++i)
+        *(dst++) = doc::rgba(r ? r[i]: 0,
+                             g ? g[i]: 0,
+                             b ? b[i]: 0,
+                             a ? a[i]: 255);
+    }
+    else {
+      auto dst = (GrayscaleTraits::address_t)image->getPixelAddress(0, y);
+      for (int x=0; x<w; ++x, ++i)
+        *(dst++) = doc::graya(r ? r[i]: 0,
+                              a ? a[i]: 255);
+    }
+  }
+  return image;
+}
+
+// Creates the sprite with lazy loaded cels, or returns nullptr if the
+// file must be loaded with psd::Decoder.
+doc::Sprite* load_indexed_psd(FileOp* fop, FILE* f)
+{
+  PsdIndexHeader header;
+  bool psb = false;
+  std::vector<PsdLayerIndex> layers;
+  if (!read_psd_layers_index(f, header, psb, layers))
+    return nullptr;
+
+  const doc::PixelFormat pixelFormat = header.pixelFormat;
+  std::unique_ptr<doc::Sprite> sprite(
+    new doc::Sprite(ImageSpec(ColorMode(pixelFormat),
+                              header.width, header.height)));
+
+  // Layer records are stored from bottom to top, and groups start
+  // with the "end of group" marker.
+  std::vector<doc::LayerGroup*> groups;
+  doc::LayerGroup* parent = sprite->root();
+  for (const auto& record : layers) {
+    if (record.sectionType == 3) {
+      auto group = new doc::LayerGroup(sprite.get());
+      parent->addLayer(group);
+      groups.push_back(parent);
+      parent = group;
+    }
+    else if (record.sectionType == 1 ||
+             record.sectionType == 2) {
+      if (groups.empty())
+        return nullptr;
+      parent->setName(record.name);
+      parent = groups.back();
+      groups.pop_back();
+    }
+    else {
+      auto layer = new doc::LayerImage(sprite.get());
+      layer->setName(record.name);
+      layer->setBlendMode(record.blendMode);
+      parent->addLayer(layer);
+
+      if (record.bounds.isEmpty())
+        continue;
+
+      auto pixels = std::make_shared<PsdLayerPixels>();
+      pixels->filename = fop->filename();
+      pixels->psb = psb;
+      pixels->depth = header.depth;
+      pixels->pixelFormat = pixelFormat;
+      pixels->size = record.bounds.size();
+      for (const auto& chan : record.channels) {
+        // Only color/alpha channels (masks are ignored)
+        if (chan.id >= -1 && chan.id <= 2)
+          pixels->channels.push_back(chan);
+      }
+
+      // The loader keeps only the channel offsets in memory
+      auto celData = std::make_shared<doc::CelData>(
+        pixels->size,
+        int(sizeof(PsdLayerPixels) + sizeof(PsdChannel)*pixels->channels.size()),
+        [pixels]{ return load_psd_layer_pixels(*pixels); });
+      celData->setPosition(record.bounds.origin());
+      celData->setOpacity(record.opacity);
+      layer->addCel(new doc::Cel(frame_t(0), celData));
+    }
+  }
+  return sprite.release();
+}
+
+} // anonymous namespace
+
 bool PsdFormat::onLoad(FileOp* fop)
 {
   base::FileHandle fileHandle =
     base::open_file_with_exception(fop->filename(), "rb");
   FILE* f = fileHandle.get();
+
+  if (fop->config().lazyLoadCels) {
+    if (Sprite* sprite = load_indexed_psd(fop, f)) {
+      fop->createDocument(sprite);
+      return true;
+    }
+    psd_seek(f, 0);
+  }
+
   psd::StdioFileInterface fileInterface(f);
   PsdDecoderDelegate pDelegate;
   psd::Decoder decoder(&fileInterface, &pDelegate);
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2023  Igara Studio S.A.
+// Copyright (C) 2023-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -11,6 +11,7 @@
 #include "app/file/file.h"
 #include "app/file/file_format.h"
 #include "base/file_handle.h"
+#include "dio/pixel_io.h"
 
 #define QOI_NO_STDIO
 #define QOI_IMPLEMENTATION
@@ -84,22 +85,12 @@ bool QoiFormat::onLoad(FileOp* fop)
     return false;
 
   auto src = (const uint8_t*)pixels;
+  const auto layout = (desc.channels == 4 ? dio::ScanlineLayout::RGBA:
+                                            dio::ScanlineLayout::RGB);
   for (int y=0; y<desc.height; ++y) {
     auto dst = (uint32_t*)image->getPixelAddress(0, y);
-    switch (desc.channels) {
-      case 4:
-        for (int x=0; x<desc.width; ++x, ++dst) {
-          *dst = doc::rgba(src[0], src[1], src[2], src[3]);
-          src += 4;
-        }
-        break;
-      case 3:
-        for (int x=0; x<desc.width; ++x, ++dst) {
-          *dst = doc::rgba(src[0], src[1], src[2], 255);
-          src += 3;
-        }
-        break;
-    }
+    dio::read_rgb_scanline(src, desc.width, layout, dst);
+    src += desc.width * desc.channels;
   }
 
   QOI_FREE(pixels);
@@ -138,7 +129,7 @@ bool QoiFormat::onLoad(FileOp* fop)
 bool QoiFormat::onSave(FileOp* fop)
 {
   const FileAbstractImage* img = fop->abstractImageToSave();
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(open_file_with_exception_sync_on_close(fop->outputFilename(), "wb"));
   FILE* f = handle.get();
   doc::ImageRef image = img->getScaledImage();
 
@@ -161,29 +152,12 @@ bool QoiFormat::onSave(FileOp* fop)
     return false;
 
   auto dst = pixels;
+  const auto layout = (desc.channels == 4 ? dio::ScanlineLayout::RGBA:
+                                            dio::ScanlineLayout::RGB);
   for (int y=0; y<desc.height; ++y) {
-    auto src = (uint32_t*)image->getPixelAddress(0, y);
-    switch (desc.channels) {
-      case 4:
-        for (int x=0; x<desc.width; ++x, ++src) {
-          uint32_t c = *src;
-          dst[0] = doc::rgba_getr(c);
-          dst[1] = doc::rgba_getg(c);
-          dst[2] = doc::rgba_getb(c);
-          dst[3] = doc::rgba_geta(c);
-          dst += 4;
-        }
-        break;
-      case 3:
-        for (int x=0; x<desc.width; ++x, ++src) {
-          uint32_t c = *src;
-          dst[0] = doc::rgba_getr(c);
-          dst[1] = doc::rgba_getg(c);
-          dst[2] = doc::rgba_getb(c);
-          dst += 3;
-        }
-        break;
-    }
+    auto src = (const uint32_t*)image->getPixelAddress(0, y);
+    dio::write_rgb_scanline(src, desc.width, layout, dst);
+    dst += desc.width * desc.channels;
   }
 
   int size = 0;
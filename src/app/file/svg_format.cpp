@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (c) 2018-2023  Igara Studio S.A.
+// Copyright (c) 2018-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -21,6 +21,11 @@
 #include "doc/doc.h"
 #include "ui/window.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
 #include "svg_options.xml.h"
 
 namespace app {
@@ -31,8 +36,10 @@ class SvgFormat : public FileFormat {
   // Data for SVG files
   class SvgOptions : public FormatOptions {
   public:
-    SvgOptions() : pixelScale(1) { }
+    SvgOptions() : pixelScale(1), mergePixels(true) { }
     int pixelScale;
+    // Merge adjacent pixels with the same color in one <rect>
+    bool mergePixels;
   };
 
   const char* onGetName() const override {
@@ -82,80 +89,128 @@ bool SvgFormat::onLoad(FileOp* fop)
 bool SvgFormat::onSave(FileOp* fop)
 {
   const ImageRef image = fop->sequenceImageToSave();
-  int x, y, c, r, g, b, a, alpha;
+  const int w = image->width();
+  const int h = image->height();
+  int x, y, r, g, b, a;
   const auto svg_options = std::static_pointer_cast<SvgOptions>(fop->formatOptions());
   const int pixelScaleValue = std::clamp(svg_options->pixelScale, 0, 10000);
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(open_file_with_exception_sync_on_close(fop->outputFilename(), "wb"));
   FILE* f = handle.get();
-  auto printcol = [f](int x, int y,int r, int g, int b, int a, int pxScale) {
-    fprintf(f, "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" fill=\"#%02X%02X%02X\" ",
-            x*pxScale, y*pxScale, pxScale, pxScale, r, g, b);
-    if (a != 255)
-      fprintf(f, "opacity=\"%f\" ", (float)a / 255.0);
-    fprintf(f, "/>\n");
+
+  // The output is accumulated in a big buffer and written in chunks
+  // (instead of several fprintf() calls for each pixel).
+  const size_t kBufferSize = 1024*1024;
+  std::string buf;
+  buf.reserve(kBufferSize + 256);
+  auto flush = [f, &buf]() {
+    fwrite(buf.data(), 1, buf.size(), f);
+    buf.clear();
+  };
+  auto print = [&buf, &flush](const char* fmt, auto... args) {
+    char tmp[256];
+    const int n = std::snprintf(tmp, sizeof(tmp), fmt, args...);
+    if (n > 0)
+      buf.append(tmp, std::min<int>(n, sizeof(tmp)-1));
+    if (buf.size() >= kBufferSize)
+      flush();
   };
-  fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n");
-  fprintf(f, "<svg version=\"1.1\" width=\"%d\" height=\"%d\" xmlns=\"http://www.w3.org/2000/svg\" shape-rendering=\"crispEdges\">\n",
-          image->width()*pixelScaleValue, image->height()*pixelScaleValue);
+  auto printrect = [&](int x, int y, int w, int h, color_t c) {
+    print("<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" fill=\"#%02X%02X%02X\" ",
+          x*pixelScaleValue, y*pixelScaleValue,
+          w*pixelScaleValue, h*pixelScaleValue,
+          rgba_getr(c), rgba_getg(c), rgba_getb(c));
+    if (rgba_geta(c) != 255)
+      print("opacity=\"%f\" ", (float)rgba_geta(c) / 255.0);
+    print("/>\n");
+  };
+  print("<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n");
+  print("<svg version=\"1.1\" width=\"%d\" height=\"%d\" xmlns=\"http://www.w3.org/2000/svg\" shape-rendering=\"crispEdges\">\n",
+        w*pixelScaleValue, h*pixelScaleValue);
+
+  // RGBA color of each pixel (pixels with alpha=0 are not exported)
+  std::vector<color_t> pixels(size_t(w)*h);
+  auto dst = pixels.begin();
 
   switch (image->pixelFormat()) {
 
     case IMAGE_RGB: {
-      for (y=0; y<image->height(); y++) {
-        for (x=0; x<image->width(); x++) {
-          c = get_pixel_fast<RgbTraits>(image.get(), x, y);
-          alpha = rgba_geta(c);
-          if (alpha != 0x00)
-            printcol(x, y, rgba_getr(c), rgba_getg(c), rgba_getb(c), alpha, pixelScaleValue);
-        }
-        fop->setProgress((float)y / (float)(image->height()));
-      }
+      for (const color_t c : LockImageBits<RgbTraits>(image.get()))
+        *(dst++) = (rgba_geta(c) != 0 ? c: 0);
       break;
     }
     case IMAGE_GRAYSCALE: {
-      for (y=0; y<image->height(); y++) {
-        for (x=0; x<image->width(); x++) {
-          c = get_pixel_fast<GrayscaleTraits>(image.get(), x, y);
-          auto v = graya_getv(c);
-          alpha = graya_geta(c);
-          if (alpha != 0x00)
-            printcol(x, y, v, v, v, alpha, pixelScaleValue);
-        }
-        fop->setProgress((float)y / (float)(image->height()));
+      for (const color_t c : LockImageBits<GrayscaleTraits>(image.get())) {
+        const int v = graya_getv(c);
+        *(dst++) = rgba(v, v, v, graya_geta(c));
       }
       break;
     }
     case IMAGE_INDEXED: {
-      unsigned char image_palette[256][4];
-      for (y=0; y<256; y++) {
-        fop->sequenceGetColor(y, &r, &g, &b);
-        image_palette[y][0] = r;
-        image_palette[y][1] = g;
-        image_palette[y][2] = b;
-        fop->sequenceGetAlpha(y, &a);
-        image_palette[y][3] = a;
+      color_t image_palette[256];
+      for (int i=0; i<256; i++) {
+        fop->sequenceGetColor(i, &r, &g, &b);
+        fop->sequenceGetAlpha(i, &a);
+        image_palette[i] = rgba(r & 0xff, g & 0xff, b & 0xff, a & 0xff);
       }
       color_t mask_color = -1;
       if (fop->document()->sprite()->backgroundLayer() == NULL ||
           !fop->document()->sprite()->backgroundLayer()->isVisible()) {
         mask_color = fop->document()->sprite()->transparentColor();
       }
-      for (y=0; y<image->height(); y++) {
-        for (x=0; x<image->width(); x++) {
-          c = get_pixel_fast<IndexedTraits>(image.get(), x, y);
-          if (c != mask_color)
-            printcol(x, y, image_palette[c][0] & 0xff,
-                     image_palette[c][1] & 0xff,
-                     image_palette[c][2] & 0xff,
-                     image_palette[c][3] & 0xff,
-                     pixelScaleValue);
+      for (const color_t c : LockImageBits<IndexedTraits>(image.get()))
+        *(dst++) = (c != mask_color ? image_palette[c]: 0);
+      break;
+    }
+  }
+
+  if (svg_options->mergePixels) {
+    // Greedy rectangles: a horizontal run of pixels with the same
+    // color is expanded to the rows below while the whole run has
+    // the same color.
+    std::vector<bool> used(pixels.size(), false);
+    for (y=0; y<h; y++) {
+      for (x=0; x<w; x++) {
+        const size_t i = size_t(y)*w + x;
+        const color_t c = pixels[i];
+        if (rgba_geta(c) == 0 || used[i])
+          continue;
+
+        int rw = 1;
+        while (x+rw < w && pixels[i+rw] == c && !used[i+rw])
+          ++rw;
+
+        int rh = 1;
+        for (; y+rh < h; ++rh) {
+          const size_t j = size_t(y+rh)*w + x;
+          int u = 0;
+          while (u < rw && pixels[j+u] == c && !used[j+u])
+            ++u;
+          if (u < rw)
+            break;
         }
-        fop->setProgress((float)y / (float)(image->height()));
+
+        for (int v=0; v<rh; ++v)
+          std::fill_n(used.begin() + size_t(y+v)*w + x, rw, true);
+
+        printrect(x, y, rw, rh, c);
+        x += rw-1;
       }
-      break;
+      fop->setProgress((float)y / (float)h);
     }
   }
-  fprintf(f, "</svg>");
+  else {
+    for (y=0; y<h; y++) {
+      for (x=0; x<w; x++) {
+        const color_t c = pixels[size_t(y)*w + x];
+        if (rgba_geta(c) != 0)
+          printrect(x, y, 1, 1, c);
+      }
+      fop->setProgress((float)y / (float)h);
+    }
+  }
+
+  print("</svg>");
+  flush();
   if (ferror(f)) {
     fop->setError("Error writing file.\n");
     return false;
@@ -177,16 +232,21 @@ FormatOptionsPtr SvgFormat::onAskUserForFormatOptions(FileOp* fop)
       if (pref.isSet(pref.svg.pixelScale))
         opts->pixelScale = pref.svg.pixelScale();
 
+      opts->mergePixels = pref.svg.mergePixels();
+
      if (pref.svg.showAlert()) {
         app::gen::SvgOptions win;
         win.pxsc()->setTextf("%d", opts->pixelScale);
+        win.mergePixels()->setSelected(opts->mergePixels);
         win.openWindowInForeground();
 
         if (win.closer() == win.ok()) {
           pref.svg.pixelScale((int)win.pxsc()->textInt());
+          pref.svg.mergePixels(win.mergePixels()->isSelected());
           pref.svg.showAlert(!win.dontShow()->isSelected());
 
           opts->pixelScale = pref.svg.pixelScale();
+          opts->mergePixels = pref.svg.mergePixels();
         }
         else {
           opts.reset();
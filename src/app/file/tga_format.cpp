@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -292,7 +292,7 @@ bool TgaFormat::onSave(FileOp* fop)
   const FileAbstractImage* img = fop->abstractImageToSave();
   const Palette* palette = fop->sequenceGetPalette();
 
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(open_file_with_exception_sync_on_close(fop->outputFilename(), "wb"));
   tga::StdioFileInterface finterface(handle.get());
   tga::Encoder encoder(&finterface);
   tga::Header header;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2015-2018  David Capello
 // Copyright (C) 2015  Gabriel Rauter
 //
@@ -20,8 +20,10 @@
 #include "app/file/webp_options.h"
 #include "app/ini_file.h"
 #include "app/pref/preferences.h"
+#include "app/util/thread_budget.h"
 #include "base/convert_to.h"
 #include "base/file_handle.h"
+#include "base/thread_pool.h"
 #include "doc/doc.h"
 #include "ui/manager.h"
 
@@ -30,7 +32,11 @@
 #include <cstdio>
 #include <cstdlib>
 #include <algorithm>
+#include <deque>
+#include <future>
 #include <map>
+#include <memory>
+#include <thread>
 
 #include <webp/demux.h>
 #include <webp/mux.h>
@@ -255,9 +261,159 @@ static int progress_report(int percent, const WebPPicture* pic)
     return true;
 }
 
+// Encodes each frame as an independent keyframe (without the
+// sub-rectangles/blending of WebPAnimEncoder) in a pool of threads,
+// and assembles the animation with WebPMux in the same order of the
+// frames.
+static bool encode_keyframes_in_parallel(FileOp* fop,
+                                         const FileAbstractImage* sprite,
+                                         const WebPConfig& config,
+                                         const bool loop,
+                                         WebPData* webp_data)
+{
+  const int w = sprite->width();
+  const int h = sprite->height();
+
+  std::unique_ptr<WebPMux, decltype(&WebPMuxDelete)>
+    mux(WebPMuxNew(), WebPMuxDelete);
+  if (!mux) {
+    fop->setError("Error creating WebP muxer\n");
+    return false;
+  }
+
+  WebPMuxAnimParams anim_params;
+  anim_params.bgcolor = 0xffffffff; // Same as WebPAnimEncoder
+  anim_params.loop_count = (loop ? 0:  // 0 = infinite
+                                   1); // 1 = loop once
+  if (WebPMuxSetCanvasSize(mux.get(), w, h) != WEBP_MUX_OK ||
+      WebPMuxSetAnimationParams(mux.get(), &anim_params) != WEBP_MUX_OK) {
+    fop->setError("Error in WebP animation parameters\n");
+    return false;
+  }
+
+  struct EncodedFrame {
+    frame_t frame;
+    int duration;
+    std::shared_ptr<WebPMemoryWriter> writer;
+    std::future<bool> encoded;
+  };
+
+  const frame_t totalFrames = fop->roi().frames();
+  const ThreadBudget budget(std::thread::hardware_concurrency(),
+                             ThreadPriority::Export);
+  const int threads = budget.threads();
+  const int maxFramesInFlight = 2*threads;
+  base::thread_pool pool(threads);
+  std::deque<EncodedFrame> frames;
+  frame_t nmuxed = 0;
+  bool ok = true;
+
+  auto muxFrame = [&]{
+    EncodedFrame ef = std::move(frames.front());
+    frames.pop_front();
+    if (!ef.encoded.get()) {
+      if (ok && !fop->isStop())
+        fop->setError("Error saving frame %d info\n", ef.frame);
+      ok = false;
+    }
+    if (!ok)
+      return;
+
+    WebPMuxFrameInfo info;
+    info.bitstream.bytes = ef.writer->mem;
+    info.bitstream.size = ef.writer->size;
+    info.x_offset = 0;
+    info.y_offset = 0;
+    info.duration = ef.duration;
+    info.id = WEBP_CHUNK_ANMF;
+    info.dispose_method = WEBP_MUX_DISPOSE_NONE;
+    info.blend_method = WEBP_MUX_NO_BLEND;
+    if (WebPMuxPushFrame(mux.get(), &info, 1) != WEBP_MUX_OK) {
+      fop->setError("Error saving frame %d info\n", ef.frame);
+      ok = false;
+      return;
+    }
+
+    ++nmuxed;
+    fop->setProgress(double(nmuxed) / double(totalFrames));
+  };
+
+  try {
+    for (frame_t frame : fop->roi().framesSequence()) {
+      if (!ok || fop->isStop())
+        break;
+
+      // Render the frame in this thread (the renderer of the abstract
+      // image is not thread-safe), and encode it in the pool.
+      ImageRef image(Image::create(IMAGE_RGB, w, h));
+      clear_image(image.get(), image->maskColor());
+      sprite->renderFrame(frame, fop->roi().frameBounds(frame), image.get());
+
+      EncodedFrame ef;
+      ef.frame = frame;
+      ef.duration = sprite->frameDuration(frame);
+      ef.writer.reset(new WebPMemoryWriter, [](WebPMemoryWriter* writer){
+        WebPMemoryWriterClear(writer);
+        delete writer;
+      });
+      WebPMemoryWriterInit(ef.writer.get());
+
+      auto task = std::make_shared<std::packaged_task<bool()>>(
+        [image, writer=ef.writer, config]{
+          // Switch R <-> B channels because WebPEncode() expects
+          // ARGB pixels.
+          {
+            LockImageBits<RgbTraits> bits(image.get(), Image::ReadWriteLock);
+            for (auto it=bits.begin(), end=bits.end(); it != end; ++it) {
+              auto c = *it;
+              *it = rgba(rgba_getb(c), rgba_getg(c), rgba_getr(c), rgba_geta(c));
+            }
+          }
+
+          WebPPicture pic;
+          WebPPictureInit(&pic);
+          pic.width = image->width();
+          pic.height = image->height();
+          pic.use_argb = true;
+          pic.argb = (uint32_t*)image->getPixelAddress(0, 0);
+          pic.argb_stride = image->rowPixels(); // Stride in pixels (not bytes)
+          pic.writer = WebPMemoryWrite;
+          pic.custom_ptr = writer.get();
+
+          const bool result = WebPEncode(&config, &pic);
+          WebPPictureFree(&pic);
+          return result;
+        });
+      ef.encoded = task->get_future();
+      pool.execute([task]{ (*task)(); });
+      frames.push_back(std::move(ef));
+
+      // Limit the number of rendered/encoded frames in memory
+      while (int(frames.size()) > maxFramesInFlight)
+        muxFrame();
+    }
+
+    while (!frames.empty())
+      muxFrame();
+  }
+  catch (...) {
+    pool.wait_all();
+    throw;
+  }
+
+  if (!ok || fop->isStop())
+    return ok;
+
+  if (WebPMuxAssemble(mux.get(), webp_data) != WEBP_MUX_OK) {
+    fop->setError("Error assembling WebP animation\n");
+    return false;
+  }
+  return true;
+}
+
 bool WebPFormat::onSave(FileOp* fop)
 {
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(open_file_with_exception_sync_on_close(fop->outputFilename(), "wb"));
   FILE* fp = handle.get();
 
   const FileAbstractImage* sprite = fop->abstractImageToSave();
@@ -285,6 +441,8 @@ bool WebPFormat::onSave(FileOp* fop)
         return false;
       }
       config.image_hint = opts->imageHint();
+      if (opts->type() == WebPOptions::Lossless)
+        config.near_lossless = std::clamp(opts->nearLossless(), 0, 100);
       break;
 
     case WebPOptions::Lossy:
@@ -297,6 +455,30 @@ bool WebPFormat::onSave(FileOp* fop)
       break;
   }
 
+  if (opts->method() != WebPOptions::kDefaultMethod)
+    config.method = std::clamp(opts->method(), 0, 6);
+  config.thread_level = (opts->threadLevel() ? 1: 0);
+
+  const doc::frame_t totalFrames = fop->roi().frames();
+  if (opts->parallelKeyframes() &&
+      totalFrames > 1 &&
+      std::thread::hardware_concurrency() > 1) {
+    WebPData webp_data;
+    WebPDataInit(&webp_data);
+    if (!encode_keyframes_in_parallel(fop, sprite, config, opts->loop(), &webp_data))
+      return false;
+    if (fop->isStop())
+      return true;
+
+    bool written = (fwrite(webp_data.bytes, 1, webp_data.size, fp) == webp_data.size);
+    WebPDataClear(&webp_data);
+    if (!written) {
+      fop->setError("Error saving content into file\n");
+      return false;
+    }
+    return true;
+  }
+
   WebPAnimEncoderOptions enc_options;
   WebPAnimEncoderOptionsInit(&enc_options);
   enc_options.anim_params.loop_count =
@@ -305,7 +487,6 @@ bool WebPFormat::onSave(FileOp* fop)
 
   ImageRef image(Image::create(IMAGE_RGB, w, h));
 
-  const doc::frame_t totalFrames = fop->roi().frames();
   WriterData wd(fp, fop, totalFrames);
   WebPPicture pic;
   WebPPictureInit(&pic);
@@ -393,6 +574,10 @@ FormatOptionsPtr WebPFormat::onAskUserForFormatOptions(FileOp* fop)
           break;
       }
 
+      if (pref.isSet(pref.webp.nearLossless) &&
+          opts->type() == WebPOptions::Lossless)
+        opts->setNearLossless(pref.webp.nearLossless());
+
       if (pref.webp.showAlert()) {
         app::gen::WebpOptions win;
 
@@ -440,6 +625,7 @@ FormatOptionsPtr WebPFormat::onAskUserForFormatOptions(FileOp* fop)
             case WebPOptions::Lossless:
               opts->setCompression(pref.webp.compression());
               opts->setImageHint(WebPImageHint(pref.webp.imageHint()));
+              opts->setNearLossless(pref.webp.nearLossless());
               break;
             case WebPOptions::Lossy:
               opts->setQuality(pref.webp.quality());
@@ -457,6 +643,14 @@ FormatOptionsPtr WebPFormat::onAskUserForFormatOptions(FileOp* fop)
       return std::shared_ptr<WebPOptions>(nullptr);
     }
   }
+
+  // Encoder options (without UI, they are used in the CLI too)
+  if (opts) {
+    auto& pref = Preferences::instance();
+    opts->setMethod(std::clamp(pref.webp.method(), -1, 6));
+    opts->setThreadLevel(pref.webp.threadLevel());
+    opts->setParallelKeyframes(pref.webp.parallelKeyframes());
+  }
   return opts;
 }
 
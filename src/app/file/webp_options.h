@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2018  David Capello
 // Copyright (C) 2015  Gabriel Rauter
 //
@@ -24,12 +25,21 @@ namespace app {
     // By default we use 6, because 9 is too slow
     const int kDefaultCompression = 6;
 
+    // Values to use the method/near lossless value of the preset
+    // selected by the compression (or quality) level.
+    static constexpr int kDefaultMethod = -1;
+    static constexpr int kNoNearLossless = 100;
+
     WebPOptions() : m_loop(true),
                     m_type(Type::Simple),
                     m_compression(kDefaultCompression),
                     m_imageHint(WEBP_HINT_DEFAULT),
                     m_quality(100),
-                    m_imagePreset(WEBP_PRESET_DEFAULT) { }
+                    m_imagePreset(WEBP_PRESET_DEFAULT),
+                    m_nearLossless(kNoNearLossless),
+                    m_method(kDefaultMethod),
+                    m_threadLevel(true),
+                    m_parallelKeyframes(false) { }
 
     bool loop() const { return m_loop; }
     Type type() const { return m_type; }
@@ -37,6 +47,10 @@ namespace app {
     WebPImageHint imageHint() const { return m_imageHint; }
     int quality() const { return m_quality; }
     WebPPreset imagePreset() const { return m_imagePreset; }
+    int nearLossless() const { return m_nearLossless; }
+    int method() const { return m_method; }
+    bool threadLevel() const { return m_threadLevel; }
+    bool parallelKeyframes() const { return m_parallelKeyframes; }
 
     void setLoop(const bool loop) {
       m_loop = loop;
@@ -48,6 +62,7 @@ namespace app {
       if (m_type == Type::Simple) {
         m_compression = kDefaultCompression;
         m_imageHint = WEBP_HINT_DEFAULT;
+        m_nearLossless = kNoNearLossless;
       }
     }
 
@@ -71,6 +86,23 @@ namespace app {
       m_imagePreset = imagePreset;
     }
 
+    void setNearLossless(const int nearLossless) {
+      ASSERT(m_type == Type::Lossless);
+      m_nearLossless = nearLossless;
+    }
+
+    void setMethod(const int method) {
+      m_method = method;
+    }
+
+    void setThreadLevel(const bool threadLevel) {
+      m_threadLevel = threadLevel;
+    }
+
+    void setParallelKeyframes(const bool parallelKeyframes) {
+      m_parallelKeyframes = parallelKeyframes;
+    }
+
   private:
     bool m_loop;
     Type m_type;
@@ -80,6 +112,14 @@ namespace app {
     // Lossy options
     int m_quality;      // Between 0 (smallest file) and 100 (biggest)
     WebPPreset m_imagePreset;  // Image Preset for lossy webp.
+    int m_nearLossless; // Pre-processing for lossless (0=max, 100=off)
+    // Encoder options
+    int m_method;       // Quality/speed trade-off (0=fast, 6=slower-better, -1=use preset)
+    bool m_threadLevel; // Use multi-threaded encoding of each frame
+    // Encode each frame as an independent keyframe in a pool of
+    // threads (faster but the file is bigger because frames don't
+    // re-use the pixels of the previous frame).
+    bool m_parallelKeyframes;
   };
 
 } // namespace app
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -24,8 +24,12 @@
 #include "os/window.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cstdio>
+#include <ctime>
 #include <map>
+#include <memory>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -60,6 +64,26 @@ namespace {
 class FileItem;
 using FileItemMap = std::map<std::string, FileItem*>;
 
+#ifndef _WIN32
+// Entries of a directory listed in a background thread. The thread
+// only fills the "entries" vector, FileItems are created in the
+// main thread with FileItem::pollChildren().
+struct DirListing {
+  struct Entry {
+    std::string name;
+    bool isFolder;
+  };
+
+  // Number of entries to list before making them available
+  static constexpr size_t kBatchSize = 256;
+
+  std::mutex mutex;
+  std::vector<Entry> entries;   // Entries not yet added as FileItems
+  bool done = false;
+  std::atomic<bool> canceled { false };
+};
+#endif
+
 // the root of the file-system
 FileItem* rootitem = nullptr;
 FileItemMap* fileitems_map = nullptr;
@@ -89,6 +113,13 @@ public:
   LPITEMIDLIST m_fullpidl;        // relative to the Desktop folder
                                   // (like a full path-name, because the
                                   // desktop is the root on Windows)
+#else
+  std::shared_ptr<DirListing> m_listing;
+  // Modification time of the directory when the children were listed
+  // and when the listing started, to avoid listing it again if it
+  // wasn't modified (see isListingUpToDate()).
+  time_t m_listedMtime;
+  time_t m_listedTime;
 #endif
 
   FileItem(FileItem* parent);
@@ -97,6 +128,15 @@ public:
   void insertChildSorted(FileItem* child);
   int compare(const FileItem& that) const;
 
+  bool areChildrenOutdated() const;
+  void markChildrenAsRemoved();
+  void deleteRemovedChildren();
+#ifndef _WIN32
+  bool isListingUpToDate() const;
+  void startListing();
+  void addListedChildren(const std::vector<DirListing::Entry>& entries);
+#endif
+
   bool operator<(const FileItem& that) const { return compare(that) < 0; }
   bool operator>(const FileItem& that) const { return compare(that) > 0; }
   bool operator==(const FileItem& that) const { return compare(that) == 0; }
@@ -114,6 +154,8 @@ public:
 
   IFileItem* parent() const override;
   const FileItemList& children() override;
+  bool loadChildrenAsync() override;
+  bool pollChildren() override;
   void createDirectory(const std::string& dirname) override;
 
   bool hasExtension(const base::paths& extensions) override;
@@ -137,6 +179,11 @@ public:
   void deleteItem() {
     FileSystemModule::instance()->ItemRemoved(this);
 
+#ifndef _WIN32
+    if (m_listing)
+      m_listing->canceled = true;
+#endif
+
     if (m_parent) {
       auto& container = m_parent->m_children;
       auto it = std::find(container.begin(), container.end(), this);
@@ -181,6 +228,10 @@ public:
   static std::string remove_backslash_if_needed(const std::string& filename);
   static std::string get_key_for_filename(const std::string& filename);
   static void put_fileitem(FileItem* fileitem);
+  static bool is_folder_path(const std::string& fullfn);
+  static time_t get_dir_mtime(const std::string& path);
+  static void list_directory(std::shared_ptr<DirListing> listing,
+                             std::string path);
 #endif
 
 FileSystemModule* FileSystemModule::m_instance = nullptr;
@@ -428,17 +479,23 @@ const FileItemList& FileItem::children()
       // if the children list is empty, or the file-system version
       // change (it's like to say: the current m_children list
       // is outdated)...
-      (m_children.empty() ||
-       current_file_system_version > m_version)) {
-    FileItemList::iterator it;
+      areChildrenOutdated()) {
+#ifndef _WIN32
+    // The children are being listed in a background thread (we
+    // return the items found so far), or the directory wasn't
+    // modified since the last time we've listed it.
+    if (m_listing)
+      return m_children;
+    if (isListingUpToDate()) {
+      m_version = current_file_system_version;
+      return m_children;
+    }
+#endif
+
     FileItem* child;
 
     // we have to mark current items as deprecated
-    for (it=m_children.begin();
-         it!=m_children.end(); ++it) {
-      child = static_cast<FileItem*>(*it);
-      child->m_removed = true;
-    }
+    markChildrenAsRemoved();
 
     //LOG("FS: Loading files for %p (%s)\n", fileitem, fileitem->displayname);
 #ifdef _WIN32
@@ -509,11 +566,13 @@ const FileItemList& FileItem::children()
     }
 #else
     {
+      m_listedTime = std::time(nullptr);
+      m_listedMtime = get_dir_mtime(m_filename);
+
       DIR* dir = opendir(m_filename.c_str());
       if (dir) {
         dirent* entry;
         while ((entry = readdir(dir)) != NULL) {
-          FileItem* child;
           std::string fn = entry->d_name;
           std::string fullfn = base::join_path(m_filename, fn);
 
@@ -523,22 +582,9 @@ const FileItemList& FileItem::children()
           child = get_fileitem_by_path(fullfn, false);
           if (!child) {
             child = new FileItem(this);
-
-            bool is_folder;
-            struct stat fileStat;
-
-            stat(fullfn.c_str(), &fileStat);
-
-            if ((fileStat.st_mode & S_IFMT) == S_IFLNK) {
-              is_folder = base::is_directory(fullfn);
-            }
-            else {
-              is_folder = ((fileStat.st_mode & S_IFMT) == S_IFDIR);
-            }
-
             child->m_filename = fullfn;
             child->m_displayname = fn;
-            child->m_is_folder = is_folder;
+            child->m_is_folder = is_folder_path(fullfn);
 
             put_fileitem(child);
           }
@@ -554,19 +600,7 @@ const FileItemList& FileItem::children()
 #endif
 
     // check old file-items (maybe removed directories or file-items)
-    for (it=m_children.begin();
-         it!=m_children.end(); ) {
-      child = static_cast<FileItem*>(*it);
-      ASSERT(child);
-
-      if (child && child->m_removed) {
-        it = m_children.erase(it);
-        child->m_parent = nullptr;
-        child->deleteItem();
-      }
-      else
-        ++it;
-    }
+    deleteRemovedChildren();
 
     // now this file-item is updated
     m_version = current_file_system_version;
@@ -575,6 +609,59 @@ const FileItemList& FileItem::children()
   return m_children;
 }
 
+bool FileItem::loadChildrenAsync()
+{
+#ifdef _WIN32
+  // TODO list the PIDLs in a background thread (it needs its own
+  //      COM apartment/IShellFolder instances)
+  children();
+  return false;
+#else
+  if (m_listing)
+    return true;
+
+  if (!isFolder() || !areChildrenOutdated())
+    return false;
+
+  if (isListingUpToDate()) {
+    m_version = current_file_system_version;
+    return false;
+  }
+
+  markChildrenAsRemoved();
+  startListing();
+  return true;
+#endif
+}
+
+bool FileItem::pollChildren()
+{
+#ifdef _WIN32
+  return false;
+#else
+  if (!m_listing)
+    return false;
+
+  std::vector<DirListing::Entry> entries;
+  bool done;
+  {
+    const std::lock_guard lock(m_listing->mutex);
+    entries.swap(m_listing->entries);
+    done = m_listing->done;
+  }
+
+  addListedChildren(entries);
+
+  if (done) {
+    m_listing.reset();
+    deleteRemovedChildren();
+    m_version = current_file_system_version;
+    return true;
+  }
+  return !entries.empty();
+#endif
+}
+
 void FileItem::createDirectory(const std::string& dirname)
 {
   base::make_directory(base::join_path(m_filename, dirname));
@@ -625,6 +712,9 @@ FileItem::FileItem(FileItem* parent)
 #ifdef _WIN32
   m_pidl = NULL;
   m_fullpidl = NULL;
+#else
+  m_listedMtime = 0;
+  m_listedTime = 0;
 #endif
 }
 
@@ -644,6 +734,9 @@ FileItem::~FileItem()
     free_pidl(m_pidl);
     m_pidl = NULL;
   }
+#else
+  if (m_listing)
+    m_listing->canceled = true;
 #endif
 }
 
@@ -678,6 +771,112 @@ int FileItem::compare(const FileItem& that) const
   return base::compare_filenames(m_displayname, that.m_displayname);
 }
 
+bool FileItem::areChildrenOutdated() const
+{
+  return (m_children.empty() ||
+          current_file_system_version > m_version);
+}
+
+void FileItem::markChildrenAsRemoved()
+{
+  for (auto child : m_children)
+    static_cast<FileItem*>(child)->m_removed = true;
+}
+
+void FileItem::deleteRemovedChildren()
+{
+  for (auto it=m_children.begin(); it!=m_children.end(); ) {
+    FileItem* child = static_cast<FileItem*>(*it);
+    ASSERT(child);
+
+    if (child && child->m_removed) {
+      it = m_children.erase(it);
+      child->m_parent = nullptr;
+      child->deleteItem();
+    }
+    else
+      ++it;
+  }
+}
+
+#ifndef _WIN32
+
+// Returns true if the directory wasn't modified since we've listed
+// its children. As the modification time has a precision of seconds,
+// we cannot trust it if the directory was modified in the same
+// second that it was listed.
+bool FileItem::isListingUpToDate() const
+{
+  if (m_listedTime == 0)
+    return false;
+
+  const time_t mtime = get_dir_mtime(m_filename);
+  return (mtime != 0 &&
+          mtime == m_listedMtime &&
+          mtime < m_listedTime);
+}
+
+void FileItem::startListing()
+{
+  ASSERT(!m_listing);
+
+  m_listedTime = std::time(nullptr);
+  m_listedMtime = get_dir_mtime(m_filename);
+  m_listing = std::make_shared<DirListing>();
+
+  std::thread(list_directory, m_listing, m_filename).detach();
+}
+
+void FileItem::addListedChildren(const std::vector<DirListing::Entry>& entries)
+{
+  FileItemList added;
+  for (const auto& entry : entries) {
+    std::string fullfn = base::join_path(m_filename, entry.name);
+
+    // We don't use get_fileitem_by_path() to avoid checking if the
+    // file exists again (we've just listed it)
+    FileItem* child;
+    auto it = fileitems_map->find(get_key_for_filename(fullfn));
+    if (it != fileitems_map->end()) {
+      child = it->second;
+      ASSERT(child->m_parent == this);
+
+      // Items marked as removed are already in m_children
+      if (child->m_removed) {
+        child->m_removed = false;
+        continue;
+      }
+    }
+    else {
+      child = new FileItem(this);
+      child->m_filename = fullfn;
+      child->m_displayname = entry.name;
+      child->m_is_folder = entry.isFolder;
+
+      put_fileitem(child);
+    }
+    added.push_back(child);
+  }
+
+  if (added.empty())
+    return;
+
+  // Sort the new items and merge them with the existing ones (faster
+  // than insertChildSorted() for big folders)
+  auto less = [](const IFileItem* a, const IFileItem* b) {
+    return *static_cast<const FileItem*>(a) < *static_cast<const FileItem*>(b);
+  };
+  std::sort(added.begin(), added.end(), less);
+
+  const size_t n = m_children.size();
+  m_children.insert(m_children.end(), added.begin(), added.end());
+  std::inplace_merge(m_children.begin(),
+                     m_children.begin() + n,
+                     m_children.end(), less);
+}
+
+#endif
+
 //////////////////////////////////////////////////////////////////////
 // PIDLS: Only for Win32
 //////////////////////////////////////////////////////////////////////
@@ -1101,6 +1300,61 @@ static void put_fileitem(FileItem* fileitem)
   fileitems_map->insert(std::make_pair(fileitem->m_keyname, fileitem));
 }
 
+static bool is_folder_path(const std::string& fullfn)
+{
+  struct stat fileStat;
+  if (stat(fullfn.c_str(), &fileStat) != 0)
+    return false;
+
+  if ((fileStat.st_mode & S_IFMT) == S_IFLNK)
+    return base::is_directory(fullfn);
+  else
+    return ((fileStat.st_mode & S_IFMT) == S_IFDIR);
+}
+
+static time_t get_dir_mtime(const std::string& path)
+{
+  struct stat fileStat;
+  if (stat(path.c_str(), &fileStat) != 0)
+    return 0;
+  return fileStat.st_mtime;
+}
+
+// Lists the directory in a background thread, making the entries
+// available in batches.
+static void list_directory(std::shared_ptr<DirListing> listing,
+                           std::string path)
+{
+  std::vector<DirListing::Entry> batch;
+
+  auto flush = [&listing, &batch](const bool done) {
+    const std::lock_guard lock(listing->mutex);
+    listing->entries.insert(listing->entries.end(),
+                            std::make_move_iterator(batch.begin()),
+                            std::make_move_iterator(batch.end()));
+    listing->done = done;
+    batch.clear();
+  };
+
+  DIR* dir = opendir(path.c_str());
+  if (dir) {
+    dirent* entry;
+    while (!listing->canceled &&
+           (entry = readdir(dir)) != NULL) {
+      std::string fn = entry->d_name;
+      if (fn == "." || fn == "..")
+        continue;
+
+      // stat() is the slowest part on network drives
+      batch.push_back({ fn, is_folder_path(base::join_path(path, fn)) });
+      if (batch.size() == DirListing::kBatchSize)
+        flush(false);
+    }
+    closedir(dir);
+  }
+  flush(true);
+}
+
 #endif
 
 } // namespace app
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -80,6 +80,17 @@ namespace app {
 
     virtual IFileItem* parent() const = 0;
     virtual const FileItemList& children() = 0;
+
+    // Starts listing the children of this folder in a background
+    // thread if they are outdated. Returns true if the children are
+    // being listed, in that case children() returns the items found
+    // so far and pollChildren() must be called to add the new ones.
+    virtual bool loadChildrenAsync() = 0;
+
+    // Adds the children listed by the background thread until now.
+    // Returns true if the children() list was modified.
+    virtual bool pollChildren() = 0;
+
     virtual void createDirectory(const std::string& dirname) = 0;
 
     virtual bool hasExtension(const base::paths& extensions) = 0;
@@ -19,12 +19,109 @@
 #include "app/xml_exception.h"
 #include "base/debug.h"
 #include "base/fs.h"
+#include "base/fstream_path.h"
+#include "base/serialization.h"
+#include "base/time.h"
 #include "cfg/cfg.h"
+#include "fmt/format.h"
 
 #include <algorithm>
+#include <fstream>
+#include <utility>
+#include <vector>
 
 namespace app {
 
+using namespace base::serialization;
+using namespace base::serialization::little_endian;
+
+namespace {
+
+// Parsed .ini files are saved in the "strings-cache" user directory
+// (one file for each .ini file) so we don't need to parse the
+// strings of the current language each time the program starts.
+// Each entry is associated to the absolute path of the .ini file and
+// its modification time/size.
+
+using StringEntries = std::vector<std::pair<std::string, std::string>>;
+
+const uint32_t kEntryMagic = 0x4E495341; // "ASIN"
+const int kEntryVersion = 1;
+
+std::string entry_key(const std::string& fn)
+{
+  const base::Time t = base::get_modification_time(fn);
+  return fmt::format("{}\n{:04}{:02}{:02}{:02}{:02}{:02}-{}",
+                     fn, t.year, t.month, t.day,
+                     t.hour, t.minute, t.second,
+                     base::file_size(fn));
+}
+
+std::string entry_filename(const std::string& dir, const std::string& fn)
+{
+  // FNV-1a hash of the .ini path (it must give the same name in each
+  // session)
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (const char chr : fn) {
+    hash ^= uint8_t(chr);
+    hash *= 0x100000001b3ull;
+  }
+  return base::join_path(dir, fmt::format("{:016x}.bin", hash));
+}
+
+void write_string(std::ostream& os, const std::string& str)
+{
+  write32(os, str.size());
+  os.write(str.c_str(), str.size());
+}
+
+bool read_string(std::istream& is, std::string& str)
+{
+  str.resize(read32(is));
+  if (!str.empty())
+    is.read(&str[0], str.size());
+  return bool(is);
+}
+
+bool read_cache_entry(const std::string& cacheFn,
+                      const std::string& key,
+                      StringEntries& entries)
+{
+  std::ifstream s(FSTREAM_PATH(cacheFn), std::ifstream::binary);
+  std::string cachedKey;
+  if (!s ||
+      read32(s) != kEntryMagic ||
+      read8(s) != kEntryVersion ||
+      !read_string(s, cachedKey) ||
+      cachedKey != key)
+    return false;
+
+  entries.resize(read32(s));
+  for (auto& entry : entries) {
+    if (!read_string(s, entry.first) ||
+        !read_string(s, entry.second))
+      return false;
+  }
+  return true;
+}
+
+void write_cache_entry(const std::string& cacheFn,
+                       const std::string& key,
+                       const StringEntries& entries)
+{
+  std::ofstream s(FSTREAM_PATH(cacheFn), std::ofstream::binary);
+  write32(s, kEntryMagic);
+  write8(s, kEntryVersion);
+  write_string(s, key);
+  write32(s, entries.size());
+  for (const auto& entry : entries) {
+    write_string(s, entry.first);
+    write_string(s, entry.second);
+  }
+}
+
+} // anonymous namespace
+
 static Strings* singleton = nullptr;
 
 const char* Strings::kDefLanguage = "en";
@@ -185,6 +282,49 @@ void Strings::loadStringsFromExtension(const std::string& langId)
 }
 
 void Strings::loadStringsFromFile(const std::string& fn)
+{
+  const std::string absFn = base::get_absolute_path(fn);
+  const std::string key = entry_key(absFn);
+  std::string cacheFn;
+  StringEntries entries;
+
+  try {
+    ResourceFinder rf;
+    rf.includeUserDir(base::join_path("strings-cache", ".").c_str());
+    cacheFn = entry_filename(rf.getFirstOrCreateDefault(), absFn);
+
+    if (read_cache_entry(cacheFn, key, entries)) {
+      for (auto& entry : entries)
+        m_strings[entry.first] = std::move(entry.second);
+      return;
+    }
+  }
+  catch (const std::exception&) {
+    // Ignore errors, we parse the .ini file
+  }
+
+  entries.clear();
+  parseStringsFile(fn, entries);
+  for (const auto& entry : entries)
+    m_strings[entry.first] = entry.second;
+
+  if (!cacheFn.empty()) {
+    try {
+      const std::string dir = base::get_file_path(cacheFn);
+      if (!base::is_directory(dir))
+        base::make_all_directories(dir);
+
+      write_cache_entry(cacheFn, key, entries);
+    }
+    catch (const std::exception&) {
+      // Ignore errors, the file will be parsed again next time
+    }
+  }
+}
+
+// static
+void Strings::parseStringsFile(const std::string& fn,
+                               std::vector<std::pair<std::string, std::string>>& entries)
 {
   cfg::CfgFile cfg;
   cfg.load(fn);
@@ -223,9 +363,9 @@ void Strings::loadStringsFromFile(const std::string& fn)
           ++i;
         }
       }
-      m_strings[textId] = value;
+      entries.emplace_back(textId, value);
 
-      //TRACE("I18N: Reading string %s -> %s\n", textId.c_str(), m_strings[textId].c_str());
+      //TRACE("I18N: Reading string %s -> %s\n", textId.c_str(), value.c_str());
 
       textId.erase(section.size()+1);
     }
@@ -17,6 +17,8 @@
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace app {
 
@@ -67,6 +69,8 @@ namespace app {
     void loadStringsFromDataDir(const std::string& langId);
     void loadStringsFromExtension(const std::string& langId);
     void loadStringsFromFile(const std::string& fn);
+    static void parseStringsFile(const std::string& fn,
+                                 std::vector<std::pair<std::string, std::string>>& entries);
 
     Preferences& m_pref;
     Extensions& m_exts;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -12,7 +12,9 @@
 #include "app/ini_file.h"
 
 #include "app/resource_finder.h"
+#include "base/file_handle.h"
 #include "base/fs.h"
+#include "base/log.h"
 #include "base/split_string.h"
 #include "base/string.h"
 #include "cfg/cfg.h"
@@ -27,7 +29,18 @@
   #include "base/fs.h"
 #endif
 
+#ifdef _WIN32
+  #include <windows.h>
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
 #include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 namespace app {
@@ -37,6 +50,134 @@ using namespace gfx;
 static std::string g_configFilename;
 static std::vector<cfg::CfgFile*> g_configs;
 
+// Writes the file in a temporary file and then replaces the original
+// one, so we never leave a half-written configuration file.
+static void write_file_atomically(const std::string& filename,
+                                  const std::string& content)
+{
+  const std::string tmp = filename + ".tmp";
+  {
+    base::FileHandle file(base::open_file(tmp, "wb"));
+    if (!file ||
+        std::fwrite(content.data(), 1, content.size(), file.get()) != content.size()) {
+      LOG(ERROR, "INI: Error saving configuration into %s\n", tmp.c_str());
+      return;
+    }
+  }
+
+#ifdef _WIN32
+  const bool ok = (MoveFileExW(base::from_utf8(tmp).c_str(),
+                               base::from_utf8(filename).c_str(),
+                               MOVEFILE_REPLACE_EXISTING) != 0);
+#else
+  const bool ok = (std::rename(tmp.c_str(), filename.c_str()) == 0);
+#endif
+  if (!ok)
+    LOG(ERROR, "INI: Error replacing configuration file %s\n", filename.c_str());
+}
+
+// Writes configuration files in a background thread. Several
+// flush_config_file() calls in a short period of time for the same
+// file are merged in just one write, and files with the same content
+// that was already written are not written again.
+class ConfigWriter {
+public:
+  // Time to wait for more changes before writing the files
+  static constexpr auto kDelay = std::chrono::milliseconds(500);
+
+  ConfigWriter() : m_thread([this]{ threadLoop(); }) { }
+
+  // Writes all pending files before returning
+  ~ConfigWriter() {
+    {
+      const std::lock_guard lock(m_mutex);
+      m_exit = true;
+    }
+    m_cv.notify_one();
+    m_thread.join();
+  }
+
+  void write(const std::string& filename, std::string&& content) {
+    {
+      const std::lock_guard lock(m_mutex);
+      m_pending[filename] = std::move(content);
+      m_lastChange = std::chrono::steady_clock::now();
+    }
+    m_cv.notify_one();
+  }
+
+  // Writes the pending content of the given file right now (e.g. if
+  // we are going to load it again).
+  void writeNow(const std::string& filename) {
+    std::string content;
+    const std::lock_guard writeLock(m_writeMutex);
+    {
+      const std::lock_guard lock(m_mutex);
+      auto it = m_pending.find(filename);
+      if (it == m_pending.end())
+        return;
+      content = std::move(it->second);
+      m_pending.erase(it);
+    }
+    writeFile(filename, content);
+  }
+
+private:
+  void threadLoop() {
+    std::unique_lock lock(m_mutex);
+    while (true) {
+      if (m_pending.empty()) {
+        if (m_exit)
+          break;
+        m_cv.wait(lock);
+        continue;
+      }
+
+      // Wait more changes (unless we are closing the app)
+      const auto until = m_lastChange + kDelay;
+      if (!m_exit && std::chrono::steady_clock::now() < until) {
+        m_cv.wait_until(lock, until);
+        continue;
+      }
+
+      std::map<std::string, std::string> pending;
+      std::swap(pending, m_pending);
+      lock.unlock();
+      {
+        const std::lock_guard writeLock(m_writeMutex);
+        for (const auto& [filename, content] : pending)
+          writeFile(filename, content);
+      }
+      lock.lock();
+    }
+  }
+
+  // Must be called with m_writeMutex locked
+  void writeFile(const std::string& filename, const std::string& content) {
+    auto& written = m_written[filename];
+    if (written == content && base::is_file(filename))
+      return;
+
+    write_file_atomically(filename, content);
+    written = content;
+  }
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::map<std::string, std::string> m_pending;
+  std::chrono::steady_clock::time_point m_lastChange;
+  bool m_exit = false;
+
+  // Locked while files are being written
+  std::mutex m_writeMutex;
+  // Last content written in each file
+  std::map<std::string, std::string> m_written;
+
+  std::thread m_thread;
+};
+
+static std::unique_ptr<ConfigWriter> g_writer;
+
 ConfigModule::ConfigModule()
 {
   ResourceFinder rf;
@@ -93,6 +234,8 @@ ConfigModule::ConfigModule()
 
 #endif
 
+  g_writer = std::make_unique<ConfigWriter>();
+
   set_config_file(fn.c_str());
   g_configFilename = fn;
 }
@@ -101,6 +244,9 @@ ConfigModule::~ConfigModule()
 {
   flush_config_file();
 
+  // Wait the background writer to save all files
+  g_writer.reset();
+
   for (auto cfg : g_configs)
     delete cfg;
   g_configs.clear();
@@ -126,7 +272,14 @@ void flush_config_file()
 {
   ASSERT(!g_configs.empty());
 
-  g_configs.back()->save();
+  // The content is serialized in this thread (the CfgFile can be
+  // modified later), but the file is written in the background.
+  std::string content;
+  cfg::CfgFile* cfg = g_configs.back();
+  if (g_writer && cfg->saveToString(content))
+    g_writer->write(cfg->filename(), std::move(content));
+  else
+    cfg->save();
 }
 
 void set_config_file(const char* filename)
@@ -134,6 +287,10 @@ void set_config_file(const char* filename)
   if (g_configs.empty())
     g_configs.push_back(new cfg::CfgFile());
 
+  // Load the latest content of the file
+  if (g_writer)
+    g_writer->writeNow(filename);
+
   g_configs.back()->load(filename);
 }
 
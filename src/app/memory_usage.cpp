@@ -0,0 +1,84 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/memory_usage.h"
+
+#include "app/doc.h"
+#include "app/doc_undo.h"
+#include "app/docs.h"
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/memory_account.h"
+#include "doc/sprite.h"
+#include "doc/tileset.h"
+#include "doc/tilesets.h"
+#include "fmt/format.h"
+
+namespace app {
+
+static std::string mb(const std::size_t bytes)
+{
+  return fmt::format("{:.2f} MB", bytes / 1024.0 / 1024.0);
+}
+
+DocMemoryUsage get_doc_memory_usage(const Doc* doc)
+{
+  DocMemoryUsage usage;
+  const doc::Sprite* sprite = doc->sprite();
+
+  for (const doc::Cel* cel : sprite->uniqueCels()) {
+    const doc::Image* image = cel->image();
+    if (image && !image->isTilemap())
+      usage.cels += image->getMemSize();
+  }
+
+  if (sprite->hasTilesets()) {
+    for (const doc::Tileset* tileset : *sprite->tilesets()) {
+      if (tileset)
+        usage.tilesets += tileset->getMemSize();
+    }
+  }
+
+  if (const DocUndo* undo = doc->undoHistory())
+    usage.undo = undo->totalUndoSize();
+
+  return usage;
+}
+
+std::string get_memory_usage_report(const Docs& docs)
+{
+  std::string report;
+  std::size_t total = 0;
+
+  for (const Doc* doc : docs) {
+    const DocMemoryUsage usage = get_doc_memory_usage(doc);
+    report += fmt::format("{}: {} (cels {}, tilesets {}, undo {})\n",
+                          doc->name(), mb(usage.total()),
+                          mb(usage.cels), mb(usage.tilesets),
+                          mb(usage.undo));
+    total += usage.total();
+  }
+
+  std::size_t pools = 0;
+  for (int i=0; i<int(doc::MemoryPool::Count); ++i) {
+    const auto pool = doc::MemoryPool(i);
+    const std::size_t bytes = doc::get_memory_pool_bytes(pool);
+    report += fmt::format("{}: {}\n", doc::memory_pool_name(pool), mb(bytes));
+    pools += bytes;
+  }
+
+  const std::size_t limit = doc::get_memory_soft_limit();
+  report += fmt::format("Total: {} (documents {}, caches {}, cache limit {})",
+                        mb(total + pools), mb(total), mb(pools),
+                        limit ? mb(limit): std::string("none"));
+  return report;
+}
+
+} // namespace app
@@ -0,0 +1,35 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_MEMORY_USAGE_H_INCLUDED
+#define APP_MEMORY_USAGE_H_INCLUDED
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace app {
+  class Doc;
+  class Docs;
+
+  // Memory used by the pixels of a document.
+  struct DocMemoryUsage {
+    std::size_t cels = 0;       // Images of unique cels (no tilemaps)
+    std::size_t tilesets = 0;   // Tiles of all tilesets
+    std::size_t undo = 0;       // Undo history
+
+    std::size_t total() const { return cels + tilesets + undo; }
+  };
+
+  DocMemoryUsage get_doc_memory_usage(const Doc* doc);
+
+  // Returns a human-readable report of the memory used by each
+  // document and each doc::MemoryPool (for the Developer Console).
+  std::string get_memory_usage_report(const Docs& docs);
+
+} // namespace app
+
+#endif
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -23,6 +23,7 @@
 #include "app/modules/gui.h"
 #include "app/modules/palettes.h"
 #include "app/pref/preferences.h"
+#include "app/profiler.h"
 #include "app/tools/ink.h"
 #include "app/tools/tool_box.h"
 #include "app/ui/editor/editor.h"
@@ -87,6 +88,8 @@ public:
     : ui::Manager(nativeWindow) {
   }
 
+  void flipAllDisplays() override;
+
 protected:
   bool onProcessMessage(Message* msg) override;
 #if ENABLE_DEVMODE
@@ -199,6 +202,7 @@ int init_module_gui()
 
   // Create the default-manager
   manager = new CustomizedGuiManager(main_window);
+  manager->setMaxFrameRate(pref.experimental.maxFrameRate());
 
   // Setup the GUI theme for all widgets
   gui_theme = new SkinTheme;
@@ -700,6 +704,12 @@ void CustomizedGuiManager::onInitTheme(InitThemeEvent& ev)
   AppMenus::instance()->initTheme();
 }
 
+void CustomizedGuiManager::flipAllDisplays()
+{
+  PROFILE_ZONE("flip");
+  Manager::flipAllDisplays();
+}
+
 void CustomizedGuiManager::onNewDisplayConfiguration(Display* display)
 {
   Manager::onNewDisplayConfiguration(display);
@@ -32,6 +32,16 @@ static Palette* ase_default_palette = NULL;
 // Palette in current sprite frame.
 static Palette* ase_current_palette = NULL;
 
+// True if the default palette file wasn't loaded yet (see
+// defer_default_palette_loading()).
+static bool ase_default_palette_pending = false;
+
+static void load_pending_default_palette()
+{
+  if (ase_default_palette_pending)
+    load_default_palette();
+}
+
 int init_module_palette()
 {
   ase_default_palette = new Palette(frame_t(0), 256);
@@ -47,6 +57,8 @@ void exit_module_palette()
 
 void load_default_palette()
 {
+  ase_default_palette_pending = false;
+
   std::unique_ptr<Palette> pal;
   std::string defaultPalName = get_preset_palette_filename(
     get_default_palette_preset_name(), ".ase");
@@ -122,18 +134,26 @@ void load_default_palette()
   set_current_palette(nullptr, true);
 }
 
+void defer_default_palette_loading()
+{
+  ase_default_palette_pending = true;
+}
+
 Palette* get_current_palette()
 {
+  load_pending_default_palette();
   return ase_current_palette;
 }
 
 Palette* get_default_palette()
 {
+  load_pending_default_palette();
   return ase_default_palette;
 }
 
 void set_default_palette(const Palette* palette)
 {
+  load_pending_default_palette();
   palette->copyColorsTo(ase_default_palette);
 }
 
@@ -143,6 +163,8 @@ void set_default_palette(const Palette* palette)
 // If "_palette" is nullptr the default palette is set.
 bool set_current_palette(const Palette *_palette, bool forced)
 {
+  load_pending_default_palette();
+
   const Palette* palette = (_palette ? _palette: ase_default_palette);
   bool ret = false;
 
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -24,6 +25,10 @@ namespace app {
   // palette if the palette format changes, etc.
   void load_default_palette();
 
+  // Delays the load_default_palette() call until the default or
+  // current palette is used for first time (used in batch mode).
+  void defer_default_palette_loading();
+
   Palette* get_default_palette();
   Palette* get_current_palette();
 
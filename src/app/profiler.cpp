@@ -0,0 +1,230 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/profiler.h"
+
+#include "base/fstream_path.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace app {
+
+namespace profiler_details {
+  std::atomic<int> flags(0);
+}
+
+namespace {
+
+// Number of zones recorded per thread (older zones are overwritten)
+const size_t kRingSize = 64*1024;
+
+struct Zone {
+  const char* name;
+  int64_t begin;
+  int64_t end;
+};
+
+// Ring buffer of one thread. Only its thread writes zones in it
+// (without locks), and the "count" is published with release
+// semantics so the exporter sees complete zones.
+struct ThreadBuffer {
+  int tid;
+  std::vector<Zone> zones;
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> generation;
+
+  ThreadBuffer(int tid)
+    : tid(tid)
+    , zones(kRingSize)
+    , count(0)
+    , generation(0) {
+  }
+};
+
+// All the thread buffers, they are kept alive after their thread
+// finishes so the zones of worker threads can be exported too.
+std::mutex g_mutex;
+std::vector<std::shared_ptr<ThreadBuffer>> g_buffers;
+std::atomic<uint64_t> g_generation(0);
+const auto g_epoch = std::chrono::steady_clock::now();
+
+ThreadBuffer* get_thread_buffer()
+{
+  thread_local std::shared_ptr<ThreadBuffer> buffer;
+  if (!buffer) {
+    std::lock_guard lock(g_mutex);
+    buffer = std::make_shared<ThreadBuffer>(int(g_buffers.size()+1));
+    g_buffers.push_back(buffer);
+  }
+  return buffer.get();
+}
+
+// Last durations (ring buffer) of one zone
+struct ZoneSamples {
+  std::vector<int64_t> durations;
+  size_t next = 0;
+};
+
+std::mutex g_statsMutex;
+std::map<std::string, ZoneSamples> g_stats;
+
+void record_trace(const char* name, int64_t begin, int64_t end)
+{
+  ThreadBuffer* buffer = get_thread_buffer();
+
+  // Discard zones from a previous start_profiler()
+  const uint64_t generation = g_generation.load(std::memory_order_relaxed);
+  if (buffer->generation.load(std::memory_order_relaxed) != generation) {
+    buffer->count.store(0, std::memory_order_relaxed);
+    buffer->generation.store(generation, std::memory_order_relaxed);
+  }
+
+  const uint64_t i = buffer->count.load(std::memory_order_relaxed);
+  buffer->zones[i % kRingSize] = Zone{ name, begin, end };
+  buffer->count.store(i+1, std::memory_order_release);
+}
+
+void record_stats(const char* name, int64_t duration)
+{
+  std::lock_guard lock(g_statsMutex);
+  ZoneSamples& samples = g_stats[name];
+  if (int(samples.durations.size()) < kProfilerStatsSamples)
+    samples.durations.push_back(duration);
+  else
+    samples.durations[samples.next] = duration;
+  samples.next = (samples.next+1) % kProfilerStatsSamples;
+}
+
+void write_json_string(std::ostream& os, const char* s)
+{
+  os << '"';
+  for (; *s; ++s) {
+    switch (*s) {
+      case '"': os << "\\\""; break;
+      case '\\': os << "\\\\"; break;
+      default:
+        if (uint8_t(*s) >= 0x20)
+          os << *s;
+        break;
+    }
+  }
+  os << '"';
+}
+
+} // anonymous namespace
+
+void start_profiler()
+{
+  // Old zones in the buffers are discarded lazily (when each thread
+  // records a new zone, or when the trace is exported).
+  ++g_generation;
+  profiler_details::flags |= profiler_details::kTrace;
+}
+
+void stop_profiler()
+{
+  profiler_details::flags &= ~profiler_details::kTrace;
+}
+
+bool save_profiler_trace(const std::string& filename)
+{
+  std::ofstream f(FSTREAM_PATH(filename), std::ofstream::binary);
+  if (!f)
+    return false;
+
+  const uint64_t generation = g_generation;
+  bool first = true;
+
+  f << "{\"traceEvents\":[\n";
+  {
+    std::lock_guard lock(g_mutex);
+    for (const auto& buffer : g_buffers) {
+      if (buffer->generation != generation)
+        continue;
+
+      const uint64_t count = buffer->count.load(std::memory_order_acquire);
+      const uint64_t from = (count > kRingSize ? count - kRingSize: 0);
+      for (uint64_t i=from; i<count; ++i) {
+        const Zone& zone = buffer->zones[i % kRingSize];
+        if (!first)
+          f << ",\n";
+        first = false;
+
+        f << "{\"name\":";
+        write_json_string(f, zone.name);
+        f << ",\"ph\":\"X\",\"pid\":1"
+          << ",\"tid\":" << buffer->tid
+          << ",\"ts\":" << zone.begin
+          << ",\"dur\":" << (zone.end - zone.begin) << '}';
+      }
+    }
+  }
+  f << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return bool(f);
+}
+
+void enable_profiler_stats(bool state)
+{
+  if (state) {
+    {
+      std::lock_guard lock(g_statsMutex);
+      g_stats.clear();
+    }
+    profiler_details::flags |= profiler_details::kStats;
+  }
+  else
+    profiler_details::flags &= ~profiler_details::kStats;
+}
+
+ProfilerZoneStats get_profiler_zone_stats(const char* name)
+{
+  std::vector<int64_t> durations;
+  {
+    std::lock_guard lock(g_statsMutex);
+    auto it = g_stats.find(name);
+    if (it == g_stats.end())
+      return ProfilerZoneStats();
+    durations = it->second.durations;
+  }
+
+  std::sort(durations.begin(), durations.end());
+  const int n = int(durations.size());
+
+  ProfilerZoneStats stats;
+  stats.samples = n;
+  stats.p50 = durations[n/2] / 1000.0;
+  stats.p95 = durations[std::min(n-1, n*95/100)] / 1000.0;
+  stats.max = durations[n-1] / 1000.0;
+  return stats;
+}
+
+int64_t profiler_now()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - g_epoch).count();
+}
+
+void add_profiler_zone(const char* name, int64_t begin, int64_t end)
+{
+  const int flags = profiler_details::flags.load(std::memory_order_relaxed);
+  if (flags & profiler_details::kTrace)
+    record_trace(name, begin, end);
+  if (flags & profiler_details::kStats)
+    record_stats(name, end - begin);
+}
+
+} // namespace app
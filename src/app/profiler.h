@@ -0,0 +1,108 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_PROFILER_H_INCLUDED
+#define APP_PROFILER_H_INCLUDED
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace app {
+
+  // Low-overhead profiler of hot paths (rendering, tool loop, file
+  // I/O, filters, backups, etc.). Each thread records its zones in
+  // its own ring buffer (without locks), and then the whole trace
+  // can be exported in the Chrome Trace Event format (JSON) to be
+  // inspected with chrome://tracing or https://ui.perfetto.dev/
+  //
+  // It can also keep rolling statistics of the last durations of
+  // each zone (e.g. for the frame-time HUD of the Editor).
+  //
+  // When the profiler is disabled a PROFILE_ZONE() costs just one
+  // atomic load.
+
+  namespace profiler_details {
+    enum { kTrace = 1, kStats = 2 };
+    extern std::atomic<int> flags;
+  }
+
+  inline bool is_profiler_enabled() {
+    return (profiler_details::flags.load(std::memory_order_relaxed)
+            & profiler_details::kTrace) != 0;
+  }
+
+  inline bool is_profiler_stats_enabled() {
+    return (profiler_details::flags.load(std::memory_order_relaxed)
+            & profiler_details::kStats) != 0;
+  }
+
+  // Returns true if zones are being recorded (in the trace or stats).
+  inline bool is_profiler_active() {
+    return profiler_details::flags.load(std::memory_order_relaxed) != 0;
+  }
+
+  // Clears all recorded zones and starts recording new ones.
+  void start_profiler();
+  void stop_profiler();
+
+  // Saves the recorded zones (of all threads) as a Chrome Trace
+  // JSON file. It should be called after stop_profiler() (zones that
+  // are being recorded in other threads are ignored).
+  bool save_profiler_trace(const std::string& filename);
+
+  // Statistics of the last kProfilerStatsSamples durations of a zone
+  // (in milliseconds).
+  constexpr int kProfilerStatsSamples = 120;
+  struct ProfilerZoneStats {
+    int samples = 0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double max = 0.0;
+  };
+
+  // Starts/stops collecting statistics of all zones (the old
+  // statistics are discarded when they are enabled again).
+  void enable_profiler_stats(bool state);
+  ProfilerZoneStats get_profiler_zone_stats(const char* name);
+
+  // Current time in microseconds, and function to add zones measured
+  // manually (e.g. when the begin and end of the zone are in
+  // different functions).
+  int64_t profiler_now();
+  void add_profiler_zone(const char* name, int64_t begin, int64_t end);
+
+  class ProfileZone {
+  public:
+    // The "name" must be a string literal (only the pointer is
+    // recorded).
+    explicit ProfileZone(const char* name)
+      : m_name(is_profiler_active() ? name: nullptr)
+      , m_begin(m_name ? profiler_now(): 0) {
+    }
+
+    ~ProfileZone() {
+      if (m_name)
+        add_profiler_zone(m_name, m_begin, profiler_now());
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+  private:
+    const char* m_name;
+    int64_t m_begin;
+  };
+
+} // namespace app
+
+#define PROFILE_ZONE_CONCAT2(a, b) a##b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT2(a, b)
+#define PROFILE_ZONE(name)                                              \
+  app::ProfileZone PROFILE_ZONE_CONCAT(profileZone, __LINE__)(name)
+
+#endif
@@ -0,0 +1,85 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/profiler.h"
+#include "base/fs.h"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+using namespace app;
+
+static std::string read_trace(const char* fn)
+{
+  std::ifstream f(fn);
+  return std::string((std::istreambuf_iterator<char>(f)),
+                     std::istreambuf_iterator<char>());
+}
+
+TEST(Profiler, Disabled)
+{
+  stop_profiler();
+  EXPECT_FALSE(is_profiler_enabled());
+  { PROFILE_ZONE("disabledZone"); }
+
+  start_profiler();
+  stop_profiler();
+  EXPECT_TRUE(save_profiler_trace("_test_trace.json"));
+  EXPECT_EQ(std::string::npos, read_trace("_test_trace.json").find("disabledZone"));
+  base::delete_file("_test_trace.json");
+}
+
+TEST(Profiler, SaveTrace)
+{
+  start_profiler();
+  EXPECT_TRUE(is_profiler_enabled());
+  {
+    PROFILE_ZONE("outerZone");
+    { PROFILE_ZONE("innerZone"); }
+  }
+  std::thread([]{ PROFILE_ZONE("threadZone"); }).join();
+  stop_profiler();
+
+  EXPECT_TRUE(save_profiler_trace("_test_trace.json"));
+  const std::string trace = read_trace("_test_trace.json");
+  EXPECT_EQ(0, trace.find("{\"traceEvents\":["));
+  EXPECT_NE(std::string::npos, trace.find("\"name\":\"outerZone\",\"ph\":\"X\""));
+  EXPECT_NE(std::string::npos, trace.find("\"name\":\"innerZone\""));
+  EXPECT_NE(std::string::npos, trace.find("\"name\":\"threadZone\""));
+  base::delete_file("_test_trace.json");
+}
+
+TEST(Profiler, Stats)
+{
+  enable_profiler_stats(true);
+  EXPECT_TRUE(is_profiler_stats_enabled());
+  EXPECT_FALSE(is_profiler_enabled());
+
+  for (int i=1; i<=100; ++i)
+    add_profiler_zone("statsZone", 0, i*1000);
+  { PROFILE_ZONE("statsZone"); }
+
+  ProfilerZoneStats stats = get_profiler_zone_stats("statsZone");
+  EXPECT_EQ(101, stats.samples);
+  EXPECT_NEAR(50.0, stats.p50, 1.0);
+  EXPECT_NEAR(95.0, stats.p95, 1.0);
+  EXPECT_EQ(100.0, stats.max);
+  EXPECT_EQ(0, get_profiler_zone_stats("unknownZone").samples);
+
+  // Only the last samples are kept
+  for (int i=0; i<kProfilerStatsSamples; ++i)
+    add_profiler_zone("statsZone", 0, 1000);
+  stats = get_profiler_zone_stats("statsZone");
+  EXPECT_EQ(kProfilerStatsSamples, stats.samples);
+  EXPECT_EQ(1.0, stats.max);
+
+  enable_profiler_stats(false);
+  EXPECT_FALSE(is_profiler_stats_enabled());
+}
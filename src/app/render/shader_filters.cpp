@@ -0,0 +1,412 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/render/shader_filters.h"
+
+#if SK_ENABLE_SKSL
+
+#include "app/util/shader_helpers.h"
+#include "doc/image.h"
+#include "filters/brightness_contrast_filter.h"
+#include "filters/color_curve_filter.h"
+#include "filters/convolution_matrix.h"
+#include "filters/convolution_matrix_filter.h"
+#include "filters/hue_saturation_filter.h"
+#include "filters/invert_color_filter.h"
+#include "filters/outline_filter.h"
+
+#include "include/core/SkCanvas.h"
+#include "include/effects/SkRuntimeEffect.h"
+
+#include <string>
+#include <vector>
+
+namespace app {
+
+using namespace doc;
+using namespace filters;
+
+namespace {
+
+// All shaders receive the unpremultiplied colors of the source image
+// in iImg, and return premultiplied colors (Skia unpremultiplies them
+// to store them in the destination RGBA image). The iTarget uniform
+// has 1 for each channel to modify.
+
+// The channel map is a 256x1 alpha image.
+const char* kChannelMapShaderCode = R"(
+uniform shader iImg;
+uniform shader iMap;
+uniform half4 iTarget;
+
+half map(float v) {
+ return iMap.eval(float2(floor(v*255.0 + 0.5) + 0.5, 0.5)).a;
+}
+
+half4 main(float2 fragcoord) {
+ half4 c = iImg.eval(fragcoord);
+ c = mix(c, half4(map(c.r), map(c.g), map(c.b), map(c.a)), iTarget);
+ return half4(c.rgb*c.a, c.a);
+}
+)";
+
+const char* kInvertShaderCode = R"(
+uniform shader iImg;
+uniform half4 iTarget;
+
+half4 main(float2 fragcoord) {
+ half4 c = iImg.eval(fragcoord);
+ c = mix(c, 1.0 - c, iTarget);
+ return half4(c.rgb*c.a, c.a);
+}
+)";
+
+// Same steps as HueSaturationFilter::applyFilterToRgbT() (iHsla.x
+// is the hue offset in the [0, 1] range).
+const char* kHueSaturationShaderCode = R"(
+uniform shader iImg;
+uniform int iHsl;
+uniform int iMultiply;
+uniform float4 iHsla;
+uniform half4 iTarget;
+
+half4 main(float2 fragcoord) {
+ half4 c = iImg.eval(fragcoord);
+ half3 v = (iHsl != 0 ? rgb_to_hsl(c.rgb): rgb_to_hsv(c.rgb));
+ v.x = fract(v.x + iHsla.x);
+ if (iMultiply != 0) {
+   v.y = v.y*(1.0+iHsla.y);
+   v.z = v.z*(1.0+iHsla.z);
+ }
+ else {
+   v.y = v.y+iHsla.y;
+   v.z = v.z+iHsla.z;
+ }
+ v.yz = clamp(v.yz, 0.0, 1.0);
+ half3 rgb = (iHsl != 0 ? hsl_to_rgb(v): hsv_to_rgb(v));
+ half a = (c.a > 0.0 ? clamp(c.a*(1.0+iHsla.w), 0.0, 1.0): 0.0);
+ c = mix(c, half4(rgb, a), iTarget);
+ return half4(c.rgb*c.a, c.a);
+}
+)";
+
+const char* kNeighboringCoordCode = R"(
+uniform float2 iImgSize;
+uniform int iTiledX;
+uniform int iTiledY;
+
+// Like filters::get_neighboring_coord()
+float2 coord(float2 p) {
+ return float2(iTiledX != 0 ? mod(p.x, iImgSize.x): clamp(p.x, 0.0, iImgSize.x-1.0),
+               iTiledY != 0 ? mod(p.y, iImgSize.y): clamp(p.y, 0.0, iImgSize.y-1.0));
+}
+)";
+
+// Same steps as ConvolutionMatrixFilter::applyToRgba() with integer
+// values of the channels in the [0, 255] range. The matrix values
+// are in a 16x16 array.
+const char* kConvolutionShaderCode = R"(
+uniform shader iImg;
+uniform float iMatrix[256];
+uniform float2 iMatrixSize;
+uniform float2 iCenter;
+uniform float iDiv;
+uniform float iBias;
+uniform half4 iTarget;
+
+float idiv(float a, float b) {
+ float q = a / b;
+ return (q < 0.0 ? ceil(q): floor(q));
+}
+
+half4 main(float2 fragcoord) {
+ float2 xy = floor(fragcoord) - iCenter;
+ float4 sum = float4(0);
+ float div = iDiv;
+ for (int j=0; j<16; ++j) {
+   if (float(j) >= iMatrixSize.y)
+     break;
+   for (int i=0; i<16; ++i) {
+     if (float(i) >= iMatrixSize.x)
+       break;
+     float k = iMatrix[j*16 + i];
+     if (k != 0.0) {
+       float4 c = floor(iImg.eval(coord(xy + float2(i, j)) + 0.5)*255.0 + 0.5);
+       if (c.a == 0.0)
+         div -= k;
+       else
+         sum += c*k;
+     }
+   }
+ }
+
+ half4 c = iImg.eval(fragcoord);
+ if (div != 0.0) {
+   float4 r = float4(idiv(sum.r, div),
+                     idiv(sum.g, div),
+                     idiv(sum.b, div),
+                     idiv(sum.a, iDiv)) + iBias;
+   c = mix(c, half4(clamp(r, 0.0, 255.0) / 255.0), iTarget);
+ }
+ return half4(c.rgb*c.a, c.a);
+}
+)";
+
+// Same steps as OutlineFilter::applyToRgba() (iBgColor is in the
+// [0, 255] range to compare it with integer values).
+const char* kOutlineShaderCode = R"(
+uniform shader iImg;
+uniform float iMatrix[9];
+uniform half4 iColor;
+uniform float4 iBgColor;
+uniform int iInside;
+uniform half4 iTarget;
+
+bool isTransparent(half4 c) {
+ float4 v = floor(c*255.0 + 0.5);
+ return (v.a == 0.0 || v == iBgColor);
+}
+
+half4 main(float2 fragcoord) {
+ float2 xy = floor(fragcoord) - 1.0;
+ float transparent = 0.0;
+ float opaque = 0.0;
+ for (int j=0; j<3; ++j) {
+   for (int i=0; i<3; ++i) {
+     if (iMatrix[j*3 + i] != 0.0) {
+       if (isTransparent(iImg.eval(coord(xy + float2(i, j)) + 0.5)))
+         transparent += 1.0;
+       else
+         opaque += 1.0;
+     }
+   }
+ }
+
+ half4 c = iImg.eval(fragcoord);
+ bool t = isTransparent(c);
+ float n = (iInside != 0 ? transparent: opaque);
+ if (n >= 1.0 && ((iInside == 0 && t) || (iInside != 0 && !t)))
+   c = mix(c, iColor, iTarget);
+ return half4(c.rgb*c.a, c.a);
+}
+)";
+
+// Each effect is compiled the first time it's used (from any
+// thread).
+sk_sp<SkRuntimeEffect> channel_map_effect() {
+  static const sk_sp<SkRuntimeEffect> effect = make_shader(kChannelMapShaderCode);
+  return effect;
+}
+
+sk_sp<SkRuntimeEffect> invert_effect() {
+  static const sk_sp<SkRuntimeEffect> effect = make_shader(kInvertShaderCode);
+  return effect;
+}
+
+sk_sp<SkRuntimeEffect> hue_saturation_effect() {
+  static const sk_sp<SkRuntimeEffect> effect =
+    make_shader((std::string(kRGB_to_HSL_sksl) +
+                 kHSL_to_RGB_sksl +
+                 kRGB_to_HSV_sksl +
+                 kHSV_to_RGB_sksl +
+                 kHueSaturationShaderCode).c_str());
+  return effect;
+}
+
+sk_sp<SkRuntimeEffect> convolution_effect() {
+  static const sk_sp<SkRuntimeEffect> effect =
+    make_shader((std::string(kNeighboringCoordCode) +
+                 kConvolutionShaderCode).c_str());
+  return effect;
+}
+
+sk_sp<SkRuntimeEffect> outline_effect() {
+  static const sk_sp<SkRuntimeEffect> effect =
+    make_shader((std::string(kNeighboringCoordCode) +
+                 kOutlineShaderCode).c_str());
+  return effect;
+}
+
+SkV4 target_to_SkV4(const Target target) {
+  return SkV4{(target & TARGET_RED_CHANNEL   ? 1.0f: 0.0f),
+              (target & TARGET_GREEN_CHANNEL ? 1.0f: 0.0f),
+              (target & TARGET_BLUE_CHANNEL  ? 1.0f: 0.0f),
+              (target & TARGET_ALPHA_CHANNEL ? 1.0f: 0.0f)};
+}
+
+void set_neighboring_uniforms(SkRuntimeShaderBuilder& builder,
+                              const Image* srcImage,
+                              const TiledMode tiledMode) {
+  builder.uniform("iImgSize") = SkV2{float(srcImage->width()),
+                                     float(srcImage->height())};
+  builder.uniform("iTiledX") = (int(tiledMode) & int(TiledMode::X_AXIS) ? 1: 0);
+  builder.uniform("iTiledY") = (int(tiledMode) & int(TiledMode::Y_AXIS) ? 1: 0);
+}
+
+sk_sp<SkShader> make_channel_map_shader(sk_sp<SkShader> img,
+                                        const ChannelMap& map,
+                                        const Target target) {
+  auto skMap = SkImage::MakeRasterCopy(
+    SkPixmap(SkImageInfo::MakeA8(int(map.size()), 1),
+             map.data(), map.size()));
+  if (!skMap)
+    return nullptr;
+
+  SkRuntimeShaderBuilder builder(channel_map_effect());
+  builder.child("iImg") = img;
+  builder.child("iMap") = skMap->makeRawShader(SkSamplingOptions(SkFilterMode::kNearest));
+  builder.uniform("iTarget") = target_to_SkV4(target);
+  return builder.makeShader();
+}
+
+sk_sp<SkShader> make_filter_shader(Filter* filter,
+                                   const Image* srcImage,
+                                   sk_sp<SkShader> img,
+                                   Target target) {
+  if (auto* f = dynamic_cast<FilterWithPalette*>(filter)) {
+    // Colors are replaced with the modified palette
+    if (f->usePaletteOnRGB())
+      return nullptr;
+  }
+
+  if (auto* f = dynamic_cast<BrightnessContrastFilter*>(filter)) {
+    // This filter doesn't modify the alpha channel
+    return make_channel_map_shader(img, f->channelMap(),
+                                   target & ~TARGET_ALPHA_CHANNEL);
+  }
+
+  if (auto* f = dynamic_cast<ColorCurveFilter*>(filter))
+    return make_channel_map_shader(img, f->getChannelMap(), target);
+
+  if (dynamic_cast<InvertColorFilter*>(filter)) {
+    SkRuntimeShaderBuilder builder(invert_effect());
+    builder.child("iImg") = img;
+    builder.uniform("iTarget") = target_to_SkV4(target);
+    return builder.makeShader();
+  }
+
+  if (auto* f = dynamic_cast<HueSaturationFilter*>(filter)) {
+    using Mode = HueSaturationFilter::Mode;
+    const Mode mode = f->mode();
+
+    SkRuntimeShaderBuilder builder(hue_saturation_effect());
+    builder.child("iImg") = img;
+    builder.uniform("iHsl") = (mode == Mode::HSL_MUL || mode == Mode::HSL_ADD ? 1: 0);
+    builder.uniform("iMultiply") = (mode == Mode::HSV_MUL || mode == Mode::HSL_MUL ? 1: 0);
+    builder.uniform("iHsla") = SkV4{float(f->hue() / 360.0),
+                                    float(f->saturation()),
+                                    float(f->lightness()),
+                                    float(f->alpha())};
+    builder.uniform("iTarget") = target_to_SkV4(target);
+    return builder.makeShader();
+  }
+
+  if (auto* f = dynamic_cast<ConvolutionMatrixFilter*>(filter)) {
+    const auto matrix = f->getMatrix();
+    // Matrices wider than the image are handled in a special way
+    // by get_neighboring_pixels()
+    if (!matrix ||
+        matrix->getWidth() > 16 ||
+        matrix->getHeight() > 16 ||
+        matrix->getWidth() > srcImage->width() ||
+        matrix->getDiv() == 0)
+      return nullptr;
+
+    std::vector<float> values(16*16, 0.0f);
+    for (int y=0; y<matrix->getHeight(); ++y)
+      for (int x=0; x<matrix->getWidth(); ++x)
+        values[y*16 + x] = float(matrix->value(x, y));
+
+    SkRuntimeShaderBuilder builder(convolution_effect());
+    builder.child("iImg") = img;
+    builder.uniform("iMatrix").set(values.data(), int(values.size()));
+    builder.uniform("iMatrixSize") = SkV2{float(matrix->getWidth()),
+                                          float(matrix->getHeight())};
+    builder.uniform("iCenter") = SkV2{float(matrix->getCenterX()),
+                                      float(matrix->getCenterY())};
+    builder.uniform("iDiv") = float(matrix->getDiv());
+    builder.uniform("iBias") = float(matrix->getBias());
+    builder.uniform("iTarget") = target_to_SkV4(target);
+    set_neighboring_uniforms(builder, srcImage, f->getTiledMode());
+    return builder.makeShader();
+  }
+
+  if (auto* f = dynamic_cast<OutlineFilter*>(filter)) {
+    if (srcImage->width() < 3 || f->thickness() > 1)
+      return nullptr;
+
+    float values[9];
+    for (int i=0; i<9; ++i)
+      values[i] = ((int(f->matrix()) & (1 << i)) ? 1.0f: 0.0f);
+
+    const color_t color = f->color();
+    const color_t bg = f->bgColor();
+    SkRuntimeShaderBuilder builder(outline_effect());
+    builder.child("iImg") = img;
+    builder.uniform("iMatrix").set(values, 9);
+    builder.uniform("iColor") = SkV4{rgba_getr(color) / 255.0f,
+                                     rgba_getg(color) / 255.0f,
+                                     rgba_getb(color) / 255.0f,
+                                     rgba_geta(color) / 255.0f};
+    builder.uniform("iBgColor") = SkV4{float(rgba_getr(bg)),
+                                       float(rgba_getg(bg)),
+                                       float(rgba_getb(bg)),
+                                       float(rgba_geta(bg))};
+    builder.uniform("iInside") = (f->place() == OutlineFilter::Place::Inside ? 1: 0);
+    builder.uniform("iTarget") = target_to_SkV4(target);
+    set_neighboring_uniforms(builder, srcImage, f->tiledMode());
+    return builder.makeShader();
+  }
+
+  return nullptr;
+}
+
+} // anonymous namespace
+
+bool shader_apply_filter(Filter* filter,
+                         const doc::Image* srcImage,
+                         doc::Image* dstImage,
+                         const gfx::Rect& bounds,
+                         const Target target)
+{
+  ASSERT(srcImage->size() == dstImage->size());
+  if (srcImage->pixelFormat() != IMAGE_RGB ||
+      dstImage->pixelFormat() != IMAGE_RGB ||
+      srcImage->size() != dstImage->size() ||
+      bounds.isEmpty())
+    return false;
+
+  auto skImg = make_skimage_for_docimage(srcImage);
+  if (!skImg)
+    return false;
+
+  sk_sp<SkShader> shader = make_filter_shader(
+    filter, srcImage,
+    skImg->makeRawShader(SkSamplingOptions(SkFilterMode::kNearest)),
+    target);
+  if (!shader)
+    return false;
+
+  auto canvas = make_skcanvas_for_docimage(dstImage);
+  if (!canvas)
+    return false;
+
+  SkPaint p;
+  p.setBlendMode(SkBlendMode::kSrc);
+  p.setStyle(SkPaint::kFill_Style);
+  p.setShader(shader);
+
+  canvas->drawRect(SkRect::MakeXYWH(bounds.x, bounds.y, bounds.w, bounds.h), p);
+  return true;
+}
+
+} // namespace app
+
+#endif // SK_ENABLE_SKSL
@@ -0,0 +1,44 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_RENDER_SHADER_FILTERS_H_INCLUDED
+#define APP_RENDER_SHADER_FILTERS_H_INCLUDED
+#pragma once
+
+#if SK_ENABLE_SKSL
+
+#include "filters/target.h"
+#include "gfx/rect.h"
+
+namespace doc {
+  class Image;
+}
+
+namespace filters {
+  class Filter;
+}
+
+namespace app {
+
+  // Applies the "filter" to the "bounds" of the RGB "srcImage" and
+  // writes the result in "dstImage" (of the same size) with a SkSL
+  // shader. The supported filters are brightness/contrast, color
+  // curve, hue/saturation, invert color, convolution matrix, and
+  // outline. The result is similar to the CPU version of each filter
+  // but it's not equal (the shader uses float precision), so it's
+  // useful only for previews. Returns false if the filter cannot be
+  // applied with a shader (the CPU version must be used).
+  bool shader_apply_filter(filters::Filter* filter,
+                           const doc::Image* srcImage,
+                           doc::Image* dstImage,
+                           const gfx::Rect& bounds,
+                           const filters::Target target);
+
+} // namespace app
+
+#endif // SK_ENABLE_SKSL
+
+#endif
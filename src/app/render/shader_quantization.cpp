@@ -0,0 +1,174 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/render/shader_quantization.h"
+
+#if SK_ENABLE_SKSL
+
+#include "app/util/shader_helpers.h"
+#include "doc/image.h"
+#include "doc/palette.h"
+#include "render/dithering_matrix.h"
+
+#include "include/core/SkCanvas.h"
+#include "include/effects/SkRuntimeEffect.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace app {
+
+using namespace doc;
+
+namespace {
+
+// The palette is a "size x 1" image, and the dithering matrix is
+// an alpha image with the thresholds normalized to the [0, 1] range.
+// The palette index is returned in the alpha channel (to be written
+// in a kAlpha_8_SkColorType canvas).
+const char* kQuantizationShaderCode = R"(
+uniform shader iImg;
+uniform shader iPal;
+uniform shader iMatrix;
+uniform int iPalSize;
+uniform int iMaskIndex;
+uniform int iDither;
+uniform float2 iMatrixSize;
+
+float4 pal(int i) {
+ return iPal.eval(float2(float(i) + 0.5, 0.5));
+}
+
+// Same weights used in doc::Palette::findBestfit()
+float bestfitDistance(float4 a, float4 b) {
+ float4 d = a - b;
+ return dot(d*d, float4(0.09, 0.3481, 0.0121, 0.0064));
+}
+
+// Same factors used in render::OrderedDither
+float ditherDistance(float4 a, float4 b) {
+ float4 d = abs(a - b);
+ float result = 2.0 * d.a;
+ if (a.a > 0.0 && b.a > 0.0)
+   result += dot(d.rgb, float3(0.2126, 0.7152, 0.0722));
+ return result;
+}
+
+int nearest(float4 c) {
+ int best = 0;
+ float lowest = 1000.0;
+ for (int i=0; i<256; ++i) {
+   if (i >= iPalSize)
+     break;
+   if (i == iMaskIndex)
+     continue;
+   float d = bestfitDistance(c, pal(i));
+   if (d < lowest) {
+     lowest = d;
+     best = i;
+   }
+ }
+ return best;
+}
+
+half4 main(float2 fragcoord) {
+ float4 c = iImg.eval(fragcoord);
+ if (iMaskIndex >= 0 && c.a == 0.0)
+   return half4(0, 0, 0, float(iMaskIndex) / 255.0);
+
+ int index = nearest(c);
+ if (iDither != 0) {
+   float4 c1 = pal(index);
+   int index2 = nearest(clamp(2.0*c - c1, 0.0, 1.0));
+   if (index2 != index) {
+     float D = ditherDistance(c1, pal(index2));
+     if (D > 0.0) {
+       float threshold = iMatrix.eval(mod(fragcoord, iMatrixSize)).a;
+       if (ditherDistance(c1, c) / D > threshold)
+         index = index2;
+     }
+   }
+ }
+ return half4(0, 0, 0, float(index) / 255.0);
+}
+)";
+
+} // anonymous namespace
+
+bool shader_convert_rgb_to_indexed(const doc::Image* srcImage,
+                                   doc::Image* dstImage,
+                                   const doc::Palette* palette,
+                                   const render::DitheringMatrix* matrix,
+                                   const int maskIndex)
+{
+  ASSERT(srcImage->pixelFormat() == IMAGE_RGB);
+  ASSERT(dstImage->pixelFormat() == IMAGE_INDEXED);
+  ASSERT(srcImage->size() == dstImage->size());
+  if (!palette || palette->size() == 0 ||
+      srcImage->pixelFormat() != IMAGE_RGB ||
+      dstImage->pixelFormat() != IMAGE_INDEXED ||
+      srcImage->size() != dstImage->size())
+    return false;
+
+  static sk_sp<SkRuntimeEffect> effect;
+  if (!effect)
+    effect = make_shader(kQuantizationShaderCode);
+
+  const int palSize = std::min(palette->size(), 256);
+  auto skPal = SkImage::MakeRasterData(
+    SkImageInfo::Make(palSize, 1,
+                      kRGBA_8888_SkColorType,
+                      kUnpremul_SkAlphaType),
+    SkData::MakeWithoutCopy((const void*)palette->rawColorsData(),
+                            sizeof(color_t) * palSize),
+    sizeof(color_t) * palSize);
+
+  // Thresholds of the dithering matrix (a 1x1 matrix if we don't
+  // use dithering)
+  const int rows = (matrix ? matrix->rows(): 1);
+  const int cols = (matrix ? matrix->cols(): 1);
+  std::vector<uint8_t> thresholds(rows*cols, 0);
+  if (matrix) {
+    for (int i=0; i<rows; ++i)
+      for (int j=0; j<cols; ++j)
+        thresholds[i*cols + j] =
+          uint8_t(std::clamp(255 * (*matrix)(i, j) / matrix->maxValue(), 0, 255));
+  }
+  auto skMatrix = SkImage::MakeRasterCopy(
+    SkPixmap(SkImageInfo::MakeA8(cols, rows),
+             thresholds.data(), cols));
+  if (!skPal || !skMatrix)
+    return false;
+
+  auto skImg = make_skimage_for_docimage(srcImage);
+  const SkSamplingOptions nearest(SkFilterMode::kNearest);
+
+  SkRuntimeShaderBuilder builder(effect);
+  builder.child("iImg") = skImg->makeRawShader(nearest);
+  builder.child("iPal") = skPal->makeRawShader(nearest);
+  builder.child("iMatrix") = skMatrix->makeRawShader(nearest);
+  builder.uniform("iPalSize") = palSize;
+  builder.uniform("iMaskIndex") = maskIndex;
+  builder.uniform("iDither") = (matrix ? 1: 0);
+  builder.uniform("iMatrixSize") = SkV2{float(cols), float(rows)};
+
+  SkPaint p;
+  p.setBlendMode(SkBlendMode::kSrc);
+  p.setStyle(SkPaint::kFill_Style);
+  p.setShader(builder.makeShader());
+
+  auto canvas = make_skcanvas_for_docimage(dstImage);
+  canvas->drawRect(SkRect::MakeWH(dstImage->width(), dstImage->height()), p);
+  return true;
+}
+
+} // namespace app
+
+#endif // SK_ENABLE_SKSL
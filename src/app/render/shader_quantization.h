@@ -0,0 +1,42 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_RENDER_SHADER_QUANTIZATION_H_INCLUDED
+#define APP_RENDER_SHADER_QUANTIZATION_H_INCLUDED
+#pragma once
+
+#if SK_ENABLE_SKSL
+
+namespace doc {
+  class Image;
+  class Palette;
+}
+
+namespace render {
+  class DitheringMatrix;
+}
+
+namespace app {
+
+  // Converts the RGB "srcImage" to the indexed "dstImage" (of the
+  // same size) using a SkSL shader that finds the nearest palette
+  // entry of each pixel, and optionally mixes two entries with an
+  // ordered dithering "matrix" (like render::OrderedDither). The
+  // result is similar to render::convert_pixel_format() but it's not
+  // equal (the shader uses the full 8-bit precision of each color
+  // component), so it's useful only for previews. Returns false if
+  // the conversion cannot be done.
+  bool shader_convert_rgb_to_indexed(const doc::Image* srcImage,
+                                     doc::Image* dstImage,
+                                     const doc::Palette* palette,
+                                     const render::DitheringMatrix* matrix,
+                                     const int maskIndex);
+
+} // namespace app
+
+#endif // SK_ENABLE_SKSL
+
+#endif
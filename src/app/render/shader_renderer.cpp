@@ -17,6 +17,7 @@
 #include "doc/render_plan.h"
 #include "os/skia/skia_surface.h"
 
+#include "include/core/SkBlender.h"
 #include "include/core/SkCanvas.h"
 #include "include/effects/SkRuntimeEffect.h"
 
@@ -55,6 +56,31 @@ half4 main(vec2 fragcoord) {
 }
 )";
 
+// Blend modes that don't exist in Skia, using the general formula
+// for separable blend modes with premultiplied colors:
+//   src*(1-dst.a) + dst*(1-src.a) + src.a*dst.a*B(dst/dst.a, src/src.a)
+const char* kSubtractBlenderCode = R"(
+half4 main(half4 src, half4 dst) {
+ half3 s = (src.a > 0.0 ? src.rgb / src.a: half3(0));
+ half3 b = (dst.a > 0.0 ? dst.rgb / dst.a: half3(0));
+ half3 r = max(b - s, 0.0);
+ return half4(src.rgb*(1.0-dst.a) + dst.rgb*(1.0-src.a) + src.a*dst.a*r,
+              src.a + dst.a*(1.0-src.a));
+}
+)";
+
+const char* kDivideBlenderCode = R"(
+half4 main(half4 src, half4 dst) {
+ half3 s = (src.a > 0.0 ? src.rgb / src.a: half3(0));
+ half3 b = (dst.a > 0.0 ? dst.rgb / dst.a: half3(0));
+ half3 r = half3(b.r == 0.0 ? 0.0: (b.r >= s.r ? 1.0: b.r / s.r),
+                 b.g == 0.0 ? 0.0: (b.g >= s.g ? 1.0: b.g / s.g),
+                 b.b == 0.0 ? 0.0: (b.b >= s.b ? 1.0: b.b / s.b));
+ return half4(src.rgb*(1.0-dst.a) + dst.rgb*(1.0-src.a) + src.a*dst.a*r,
+              src.a + dst.a*(1.0-src.a));
+}
+)";
+
 inline SkBlendMode to_skia(const doc::BlendMode bm) {
   switch (bm) {
     case doc::BlendMode::NORMAL: return SkBlendMode::kSrcOver;
@@ -74,8 +100,8 @@ inline SkBlendMode to_skia(const doc::BlendMode bm) {
     case doc::BlendMode::HSL_COLOR: return SkBlendMode::kColor;
     case doc::BlendMode::HSL_LUMINOSITY: return SkBlendMode::kLuminosity;
     case doc::BlendMode::ADDITION: return SkBlendMode::kPlus;
-    case doc::BlendMode::SUBTRACT: break; // TODO
-    case doc::BlendMode::DIVIDE: break; // TODO
+    case doc::BlendMode::SUBTRACT: break; // Uses m_subtractBlender
+    case doc::BlendMode::DIVIDE: break;   // Uses m_divideBlender
   }
   return SkBlendMode::kSrc;
 }
@@ -90,18 +116,20 @@ ShaderRenderer::ShaderRenderer()
   m_bgEffect = make_shader(kBgShaderCode);
   m_indexedEffect = make_shader(kIndexedShaderCode);
   m_grayscaleEffect = make_shader(kGrayscaleShaderCode);
+  m_subtractBlender = make_blender(kSubtractBlenderCode)->makeBlender(nullptr);
+  m_divideBlender = make_blender(kDivideBlenderCode)->makeBlender(nullptr);
 }
 
 ShaderRenderer::~ShaderRenderer() = default;
 
 void ShaderRenderer::setRefLayersVisiblity(const bool visible)
 {
-  // TODO impl
+  m_showRefLayers = visible;
 }
 
 void ShaderRenderer::setNonactiveLayersOpacity(const int opacity)
 {
-  // TODO impl
+  m_nonactiveLayersOpacity = opacity;
 }
 
 void ShaderRenderer::setNewBlendMethod(const bool newBlend)
@@ -121,7 +149,7 @@ void ShaderRenderer::setProjection(const render::Projection& projection)
 
 void ShaderRenderer::setSelectedLayer(const doc::Layer* layer)
 {
-  // TODO impl
+  m_selectedLayerForOpacity = layer;
 }
 
 void ShaderRenderer::setPreviewImage(const doc::Layer* layer,
@@ -152,12 +180,19 @@ void ShaderRenderer::setExtraImage(render::ExtraType type,
                                    const doc::Layer* currentLayer,
                                    const doc::frame_t currentFrame)
 {
-  // TODO impl
+  m_extraType = type;
+  m_extraCel = cel;
+  m_extraImage = image;
+  m_extraBlendMode = blendMode;
+  m_currentLayer = currentLayer;
+  m_currentFrame = currentFrame;
 }
 
 void ShaderRenderer::removeExtraImage()
 {
-  // TODO impl
+  m_extraType = render::ExtraType::NONE;
+  m_extraCel = nullptr;
+  m_extraImage = nullptr;
 }
 
 void ShaderRenderer::setOnionskin(const render::OnionskinOptions& options)
@@ -213,6 +248,16 @@ void ShaderRenderer::renderSprite(os::Surface* dstSurface,
     renderPlan(canvas, sprite, plan, frame, area);
   }
   canvas->restore();
+
+  // Remove the images that were not used in this frame (e.g. deleted
+  // images or old versions of modified images)
+  for (auto it=m_images.begin(); it!=m_images.end(); ) {
+    if (it->second.lastUse != m_renderCount)
+      it = m_images.erase(it);
+    else
+      ++it;
+  }
+  ++m_renderCount;
 }
 
 void ShaderRenderer::renderPlan(SkCanvas* canvas,
@@ -225,6 +270,27 @@ void ShaderRenderer::renderPlan(SkCanvas* canvas,
     const Cel* cel = item.cel;
     const Layer* layer = item.layer;
 
+    if (!m_showRefLayers && layer->isReference())
+      continue;
+
+    // Opacity of non-active layers
+    int layerOpacity = layer->opacity();
+    if (m_selectedLayerForOpacity != layer &&
+        m_nonactiveLayersOpacity != 255) {
+      int t;
+      layerOpacity = MUL_UN8(layerOpacity, m_nonactiveLayersOpacity, t);
+    }
+
+    // Extra cel (e.g. brush preview) in the current layer
+    const bool drawExtra =
+      (m_extraType != render::ExtraType::NONE &&
+       m_extraCel && m_extraImage &&
+       layer == m_currentLayer &&
+       layer->type() == doc::ObjectType::LayerImage &&
+       m_extraImage->pixelFormat() != IMAGE_TILEMAP &&
+       frame == m_extraCel->frame() &&
+       frame == m_currentFrame);
+
     switch (layer->type()) {
 
       case doc::ObjectType::LayerImage: {
@@ -254,7 +320,15 @@ void ShaderRenderer::renderPlan(SkCanvas* canvas,
 
           int t;
           int opacity = cel->opacity();
-          opacity = MUL_UN8(opacity, imgLayer->opacity(), t);
+          opacity = MUL_UN8(opacity, layerOpacity, t);
+
+          // The extra cel replaces the cel pixels in its area
+          canvas->save();
+          if (drawExtra && m_extraType == render::ExtraType::PATCH) {
+            const gfx::Rect rc = m_extraCel->bounds();
+            canvas->clipRect(SkRect::MakeXYWH(rc.x, rc.y, rc.w, rc.h),
+                             SkClipOp::kDifference);
+          }
 
           drawImage(canvas,
                     celImage,
@@ -262,6 +336,26 @@ void ShaderRenderer::renderPlan(SkCanvas* canvas,
                     celBounds.y,
                     opacity,
                     imgLayer->blendMode());
+
+          // Second pass with the extra blend mode
+          if (drawExtra && m_extraType == render::ExtraType::OVER_COMPOSITE) {
+            drawImage(canvas,
+                      celImage,
+                      celBounds.x,
+                      celBounds.y,
+                      opacity,
+                      m_extraBlendMode);
+          }
+          canvas->restore();
+        }
+
+        if (drawExtra && m_extraCel->opacity() > 0) {
+          const gfx::Point pos = m_extraCel->position();
+          drawImage(canvas,
+                    m_extraImage,
+                    pos.x, pos.y,
+                    m_extraCel->opacity(),
+                    m_extraBlendMode);
         }
         break;
       }
@@ -326,7 +420,7 @@ void ShaderRenderer::renderPlan(SkCanvas* canvas,
 
               int t;
               int opacity = cel->opacity();
-              opacity = MUL_UN8(opacity, tilemapLayer->opacity(), t);
+              opacity = MUL_UN8(opacity, layerOpacity, t);
 
               drawImage(canvas,
                         tileImage.get(),
@@ -406,14 +500,14 @@ void ShaderRenderer::drawImage(SkCanvas* canvas,
                                const int opacity,
                                const doc::BlendMode blendMode)
 {
-  auto skImg = make_skimage_for_docimage(srcImage);
+  auto skImg = getSkImage(srcImage);
 
   switch (srcImage->colorMode()) {
 
     case doc::ColorMode::RGB: {
       SkPaint p;
       p.setAlpha(opacity);
-      p.setBlendMode(to_skia(blendMode));
+      setPaintBlendMode(p, blendMode);
       canvas->drawImage(skImg.get(),
                         SkIntToScalar(x),
                         SkIntToScalar(y),
@@ -428,7 +522,7 @@ void ShaderRenderer::drawImage(SkCanvas* canvas,
 
       SkPaint p;
       p.setAlpha(opacity);
-      p.setBlendMode(to_skia(blendMode));
+      setPaintBlendMode(p, blendMode);
       p.setStyle(SkPaint::kFill_Style);
       p.setShader(builder.makeShader());
 
@@ -461,7 +555,7 @@ void ShaderRenderer::drawImage(SkCanvas* canvas,
 
       SkPaint p;
       p.setAlpha(opacity);
-      p.setBlendMode(to_skia(blendMode));
+      setPaintBlendMode(p, blendMode);
       p.setStyle(SkPaint::kFill_Style);
       p.setShader(builder.makeShader());
 
@@ -477,6 +571,42 @@ void ShaderRenderer::drawImage(SkCanvas* canvas,
   }
 }
 
+void ShaderRenderer::setPaintBlendMode(SkPaint& paint,
+                                       const doc::BlendMode blendMode) const
+{
+  switch (blendMode) {
+    case doc::BlendMode::SUBTRACT: paint.setBlender(m_subtractBlender); break;
+    case doc::BlendMode::DIVIDE:   paint.setBlender(m_divideBlender); break;
+    default:                       paint.setBlendMode(to_skia(blendMode)); break;
+  }
+}
+
+// Returns a SkImage for the given doc::Image. Images are cached by
+// ID and version, so the GPU backend can keep the texture uploaded
+// while the image doesn't change. The preview and extra images are
+// not cached because they are modified without changing their
+// version.
+sk_sp<SkImage> ShaderRenderer::getSkImage(const doc::Image* image)
+{
+  if (image == m_previewImage ||
+      image == m_extraImage)
+    return make_skimage_for_docimage(image);
+
+  const void* addr = image->getPixelAddress(0, 0);
+  auto& cached = m_images[image->id()];
+  if (!cached.image ||
+      cached.version != image->version() ||
+      cached.addr != addr ||
+      cached.image->width() != image->width() ||
+      cached.image->height() != image->height()) {
+    cached.image = make_skimage_for_docimage(image);
+    cached.version = image->version();
+    cached.addr = addr;
+  }
+  cached.lastUse = m_renderCount;
+  return cached.image;
+}
+
 // TODO this is equal to Render::checkIfWeShouldUsePreview(const Cel*),
 //      we might think in a way to merge both functions
 bool ShaderRenderer::checkIfWeShouldUsePreview(const doc::Cel* cel) const
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -11,11 +11,18 @@
 #if SK_ENABLE_SKSL
 
 #include "app/render/renderer.h"
+#include "doc/object_id.h"
+#include "doc/object_version.h"
 #include "doc/palette.h"
 
 #include "include/core/SkRefCnt.h"
 
+#include <unordered_map>
+
+class SkBlender;
 class SkCanvas;
+class SkImage;
+class SkPaint;
 class SkRuntimeEffect;
 
 namespace doc {
@@ -88,6 +95,9 @@ namespace app {
                    const int opacity,
                    const doc::BlendMode blendMode);
 
+    void setPaintBlendMode(SkPaint& paint,
+                           const doc::BlendMode blendMode) const;
+    sk_sp<SkImage> getSkImage(const doc::Image* image);
     bool checkIfWeShouldUsePreview(const doc::Cel* cel) const;
     void afterBackgroundLayerIsPainted();
 
@@ -97,6 +107,8 @@ namespace app {
     sk_sp<SkRuntimeEffect> m_bgEffect;
     sk_sp<SkRuntimeEffect> m_indexedEffect;
     sk_sp<SkRuntimeEffect> m_grayscaleEffect;
+    sk_sp<SkBlender> m_subtractBlender;
+    sk_sp<SkBlender> m_divideBlender;
     const doc::Sprite* m_sprite = nullptr;
     const doc::LayerImage* m_bgLayer = nullptr;
     // TODO these members are the same as in render::Render, we should
@@ -107,6 +119,25 @@ namespace app {
     const doc::Tileset* m_previewTileset = nullptr;
     gfx::Point m_previewPos;
     doc::BlendMode m_previewBlendMode = doc::BlendMode::NORMAL;
+    const doc::Layer* m_selectedLayerForOpacity = nullptr;
+    bool m_showRefLayers = true;
+    int m_nonactiveLayersOpacity = 255;
+    render::ExtraType m_extraType = render::ExtraType::NONE;
+    const doc::Cel* m_extraCel = nullptr;
+    const doc::Image* m_extraImage = nullptr;
+    doc::BlendMode m_extraBlendMode = doc::BlendMode::NORMAL;
+    const doc::Layer* m_currentLayer = nullptr;
+    doc::frame_t m_currentFrame = 0;
+
+    // SkImages of the rendered doc::Images (see getSkImage())
+    struct CachedImage {
+      sk_sp<SkImage> image;
+      doc::ObjectVersion version = 0;
+      const void* addr = nullptr;
+      int lastUse = 0;
+    };
+    std::unordered_map<doc::ObjectId, CachedImage> m_images;
+    int m_renderCount = 0;
 
     // Palette of 256 colors (useful for the indexed shader to set all
     // colors outside the valid range as transparent RGBA=0 values)
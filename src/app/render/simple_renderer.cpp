@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -20,6 +20,19 @@ using namespace doc;
 SimpleRenderer::SimpleRenderer()
 {
   m_properties.outputsUnpremultiplied = true;
+
+  // Cache the layers below the active one (the editor renders the
+  // same sprite/frame several times while we paint in one layer).
+  m_render.setCompositeCache(true);
+
+  // Reduced cel images for zoom levels like 50%, 25%, 12.5%, etc.
+  m_render.setMipmapCache(true);
+
+  // Tiles converted to RGB and flipped to composite tilemaps.
+  m_render.setTileCache(true);
+
+  // Reference layers scaled down to the current zoom level.
+  m_render.setScaledImageCache(true);
 }
 
 void SimpleRenderer::setRefLayersVisiblity(const bool visible)
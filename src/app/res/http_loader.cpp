@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2022  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -27,7 +27,7 @@ namespace app {
 HttpLoader::HttpLoader(const std::string& url)
   : m_url(url)
   , m_done(false)
-  , m_request(nullptr)
+  , m_request(std::make_unique<net::HttpRequest>(url))
   , m_thread([this]{ threadHttpRequest(); })
 {
 }
@@ -39,8 +39,7 @@ HttpLoader::~HttpLoader()
 
 void HttpLoader::abort()
 {
-  if (m_request)
-    m_request->abort();
+  m_request->abort();
 }
 
 void HttpLoader::threadHttpRequest()
@@ -61,7 +60,6 @@ void HttpLoader::threadHttpRequest()
     fn = base::join_path(dir, fn);
 
     std::ofstream output(FSTREAM_PATH(fn), std::ofstream::binary);
-    m_request = new net::HttpRequest(m_url);
     net::HttpResponse response(&output);
     if (m_request->send(response) &&
         response.status() == 200) {
@@ -76,9 +74,6 @@ void HttpLoader::threadHttpRequest()
   catch (...) {
     LOG(ERROR, "HTTP: Unexpected unknown exception sending http request\n");
   }
-
-  delete m_request;
-  m_request = nullptr;
 }
 
 } // namespace app
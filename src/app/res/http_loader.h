@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <atomic>
+#include <memory>
 #include <string>
 #include <thread>
 
@@ -33,7 +34,7 @@ namespace app {
 
     std::string m_url;
     std::atomic<bool> m_done;
-    net::HttpRequest* m_request;
+    std::unique_ptr<net::HttpRequest> m_request;
     std::thread m_thread;
     std::string m_filename;
   };
@@ -26,6 +26,7 @@
 #include "app/script/engine.h"
 #include "app/script/luacpp.h"
 #include "app/script/security.h"
+#include "app/script/workers.h"
 #include "app/site.h"
 #include "app/tools/active_tool.h"
 #include "app/tools/ink.h"
@@ -178,6 +179,46 @@ int App_transaction(lua_State* L)
   return nresults;
 }
 
+// app.batch(function) executes the function merging the
+// notifications and UI updates of all the commands executed inside
+// (app.command.X() calls) in just one update at the end.
+int App_batch(lua_State* L)
+{
+  luaL_checktype(L, 1, LUA_TFUNCTION);
+  const int top = lua_gettop(L);
+
+  app::Context* ctx = App::instance()->context();
+  if (!ctx)
+    return luaL_error(L, "no context");
+
+  ctx->beginCommandBatch();
+  lua_pushvalue(L, 1);
+  const int status = lua_pcall(L, 0, LUA_MULTRET, 0);
+  ctx->endCommandBatch();
+
+  if (status != LUA_OK)
+    return lua_error(L); // pcall already put an error object on the stack
+  return lua_gettop(L) - top;
+}
+
+// app.parallel(function, items [, { threads=n }]) calls the function
+// for each item in worker threads and returns the array of results
+// (see run_parallel()).
+int App_parallel(lua_State* L)
+{
+  app::Context* ctx = App::instance()->context();
+  if (ctx && ctx->isUIAvailable())
+    return luaL_error(L, "app.parallel() can be used only in batch mode");
+
+  int nthreads = 0;
+  if (lua_istable(L, 3)) {
+    if (lua_getfield(L, 3, "threads") != LUA_TNIL)
+      nthreads = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+  }
+  return run_parallel(L, 1, 2, nthreads);
+}
+
 int App_undo(lua_State* L)
 {
   app::Context* ctx = App::instance()->context();
@@ -820,6 +861,8 @@ const luaL_Reg App_methods[] = {
   { "open",        App_open },
   { "exit",        App_exit },
   { "transaction", App_transaction },
+  { "batch",       App_batch },
+  { "parallel",    App_parallel },
   { "undo",        App_undo },
   { "redo",        App_redo },
   { "alert",       App_alert },
@@ -8,10 +8,15 @@
 #include "config.h"
 #endif
 
+#include "app/app.h"
+#include "app/context.h"
+#include "app/doc.h"
+#include "app/memory_usage.h"
 #include "app/script/engine.h"
 #include "app/script/luacpp.h"
 #include "base/config.h"
 #include "base/platform.h"
+#include "doc/memory_account.h"
 #include "updater/user_agent.h"
 
 namespace app {
@@ -84,6 +89,34 @@ int AppOS_get_arm64(lua_State* L)
   return 1;
 }
 
+// Returns a table with the memory (in bytes) used by the documents
+// (cels, tilesets, undo) and each cache (renderCache, editorCache,
+// thumbnails, clipboard), and the cache soft limit (softLimit).
+int AppOS_get_memory(lua_State* L)
+{
+  DocMemoryUsage docs;
+  if (auto ctx = App::instance()->context()) {
+    for (const Doc* doc : ctx->documents()) {
+      const DocMemoryUsage usage = get_doc_memory_usage(doc);
+      docs.cels += usage.cels;
+      docs.tilesets += usage.tilesets;
+      docs.undo += usage.undo;
+    }
+  }
+
+  lua_newtable(L);
+  setfield_uinteger(L, "cels", docs.cels);
+  setfield_uinteger(L, "tilesets", docs.tilesets);
+  setfield_uinteger(L, "undo", docs.undo);
+  for (int i=0; i<int(doc::MemoryPool::Count); ++i) {
+    const auto pool = doc::MemoryPool(i);
+    setfield_uinteger(L, doc::memory_pool_name(pool),
+                      doc::get_memory_pool_bytes(pool));
+  }
+  setfield_uinteger(L, "softLimit", doc::get_memory_soft_limit());
+  return 1;
+}
+
 const Property AppOS_properties[] = {
   { "name", AppOS_get_name, nullptr },
   { "version", AppOS_get_version, nullptr },
@@ -94,6 +127,7 @@ const Property AppOS_properties[] = {
   { "x64", AppOS_get_x64, nullptr },
   { "x86", AppOS_get_x86, nullptr },
   { "arm64", AppOS_get_arm64, nullptr },
+  { "memory", AppOS_get_memory, nullptr },
   { nullptr, nullptr, nullptr }
 };
 
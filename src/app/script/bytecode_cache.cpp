@@ -0,0 +1,177 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/script/bytecode_cache.h"
+
+#include "app/script/luacpp.h"
+#include "base/fs.h"
+#include "base/fstream_path.h"
+#include "base/serialization.h"
+#include "base/time.h"
+#include "fmt/format.h"
+
+#include <fstream>
+#include <iterator>
+
+namespace app {
+namespace script {
+
+using namespace base::serialization;
+using namespace base::serialization::little_endian;
+
+namespace {
+
+const uint32_t kEntryMagic = 0x43554C41; // "ALUC"
+const int kEntryVersion = 1;
+const char* kEntryExtension = "luac";
+
+// Information of the script file saved in each entry to know if the
+// bytecode is still valid.
+struct EntryKey {
+  std::string filename;
+  base::Time mtime;
+  uint64_t fileSize = 0;
+  int luaVersion = LUA_VERSION_NUM;
+
+  EntryKey() { }
+  EntryKey(const std::string& filename)
+    : filename(filename)
+    , mtime(base::get_modification_time(filename))
+    , fileSize(base::file_size(filename)) {
+  }
+
+  bool operator==(const EntryKey& o) const {
+    return (filename == o.filename &&
+            mtime.year == o.mtime.year &&
+            mtime.month == o.mtime.month &&
+            mtime.day == o.mtime.day &&
+            mtime.hour == o.mtime.hour &&
+            mtime.minute == o.mtime.minute &&
+            mtime.second == o.mtime.second &&
+            fileSize == o.fileSize &&
+            luaVersion == o.luaVersion);
+  }
+};
+
+void write_entry_key(std::ostream& os, const EntryKey& key)
+{
+  write32(os, kEntryMagic);
+  write8(os, kEntryVersion);
+  write16(os, key.luaVersion);
+  write16(os, key.mtime.year);
+  write8(os, key.mtime.month);
+  write8(os, key.mtime.day);
+  write8(os, key.mtime.hour);
+  write8(os, key.mtime.minute);
+  write8(os, key.mtime.second);
+  write32(os, uint32_t(key.fileSize));
+  write32(os, uint32_t(key.fileSize >> 32));
+  write16(os, key.filename.size());
+  os.write(key.filename.c_str(), key.filename.size());
+}
+
+bool read_entry_key(std::istream& is, EntryKey& key)
+{
+  if (read32(is) != kEntryMagic ||
+      read8(is) != kEntryVersion)
+    return false;
+
+  key.luaVersion = read16(is);
+  key.mtime.year = read16(is);
+  key.mtime.month = read8(is);
+  key.mtime.day = read8(is);
+  key.mtime.hour = read8(is);
+  key.mtime.minute = read8(is);
+  key.mtime.second = read8(is);
+  key.fileSize = read32(is);
+  key.fileSize |= uint64_t(read32(is)) << 32;
+  key.filename.resize(read16(is));
+  is.read(&key.filename[0], key.filename.size());
+  return bool(is);
+}
+
+int append_to_string(lua_State* L, const void* p, size_t size, void* ud)
+{
+  static_cast<std::string*>(ud)->append((const char*)p, size);
+  return 0;
+}
+
+} // anonymous namespace
+
+BytecodeCache::BytecodeCache(const std::string& dir)
+  : m_dir(dir)
+{
+}
+
+int BytecodeCache::loadFile(lua_State* L, const std::string& filename)
+{
+  const std::string chunkname = "@" + filename;
+  const std::string fn = entryFilename(filename);
+  const EntryKey key(filename);
+
+  try {
+    std::ifstream s(FSTREAM_PATH(fn), std::ifstream::binary);
+    EntryKey cachedKey;
+    if (s &&
+        read_entry_key(s, cachedKey) &&
+        cachedKey == key) {
+      const std::string bytecode((std::istreambuf_iterator<char>(s)),
+                                 std::istreambuf_iterator<char>());
+      if (luaL_loadbufferx(L, bytecode.c_str(), bytecode.size(),
+                           chunkname.c_str(), "b") == LUA_OK)
+        return LUA_OK;
+
+      // Broken entry (e.g. truncated file), we compile the script
+      // again.
+      lua_pop(L, 1);
+    }
+  }
+  catch (const std::exception&) {
+    // Ignore errors, we compile the script again
+  }
+
+  const int status = luaL_loadfile(L, filename.c_str());
+  if (status != LUA_OK)
+    return status;
+
+  // Save the debug information (strip=0) so error messages and
+  // tracebacks contain line numbers.
+  std::string bytecode;
+  if (lua_dump(L, append_to_string, &bytecode, 0) != 0)
+    return LUA_OK;
+
+  try {
+    if (!base::is_directory(m_dir))
+      base::make_all_directories(m_dir);
+
+    std::ofstream s(FSTREAM_PATH(fn), std::ofstream::binary);
+    write_entry_key(s, key);
+    s.write(bytecode.c_str(), bytecode.size());
+  }
+  catch (const std::exception&) {
+    // Ignore errors, the script will be compiled again next time
+  }
+  return LUA_OK;
+}
+
+std::string BytecodeCache::entryFilename(const std::string& filename) const
+{
+  // FNV-1a hash of the script path (it must give the same name in
+  // each session)
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (const char chr : filename) {
+    hash ^= uint8_t(chr);
+    hash *= 0x100000001b3ull;
+  }
+  return base::join_path(m_dir, fmt::format("{:016x}.{}", hash, kEntryExtension));
+}
+
+} // namespace script
+} // namespace app
@@ -0,0 +1,42 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_SCRIPT_BYTECODE_CACHE_H_INCLUDED
+#define APP_SCRIPT_BYTECODE_CACHE_H_INCLUDED
+#pragma once
+
+#include <string>
+
+struct lua_State;
+
+namespace app {
+namespace script {
+
+  // Compiled Lua chunks (lua_dump() output) of script files stored in
+  // a directory (one file for each script), so we don't need to parse
+  // the same scripts/plugins each time the program starts. Each entry
+  // is associated to the absolute path of the script and its
+  // modification time/size, so it's compiled again when the script
+  // changes.
+  class BytecodeCache {
+  public:
+    BytecodeCache(const std::string& dir);
+
+    // Works like luaL_loadfile() (pushes the compiled chunk or an
+    // error message) but uses the cached bytecode when it's up to
+    // date. "filename" must be an absolute path.
+    int loadFile(lua_State* L, const std::string& filename);
+
+  private:
+    std::string entryFilename(const std::string& filename) const;
+
+    std::string m_dir;
+  };
+
+} // namespace script
+} // namespace app
+
+#endif
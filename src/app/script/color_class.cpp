@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2018  David Capello
 //
 // This program is distributed under the terms of
@@ -195,12 +195,6 @@ int Color_new(lua_State* L)
   return 1;
 }
 
-int Color_gc(lua_State* L)
-{
-  get_obj<app::Color>(L, 1)->~Color();
-  return 0;
-}
-
 int Color_eq(lua_State* L)
 {
   const auto a = get_obj<app::Color>(L, 1);
@@ -459,8 +453,10 @@ int Color_set_index(lua_State* L)
   return 0;
 }
 
+// Without __gc metamethod (see push_obj())
+static_assert(std::is_trivially_destructible_v<app::Color>);
+
 const luaL_Reg Color_methods[] = {
-  { "__gc", Color_gc },
   { "__eq", Color_eq },
   { nullptr, nullptr }
 };
@@ -16,7 +16,9 @@
 #include "app/doc_exporter.h"
 #include "app/doc_range.h"
 #include "app/pref/preferences.h"
+#include "app/resource_finder.h"
 #include "app/script/blend_mode.h"
+#include "app/script/bytecode_cache.h"
 #include "app/script/luacpp.h"
 #include "app/script/require.h"
 #include "app/script/security.h"
@@ -38,6 +40,7 @@
 #include "ui/mouse_button.h"
 
 #include <fstream>
+#include <memory>
 #include <sstream>
 #include <stack>
 #include <string>
@@ -71,6 +74,9 @@ std::stack<std::string> current_script_dirs;
 // Just one debugger delegate is possible.
 DebuggerDelegate* g_debuggerDelegate = nullptr;
 
+// Compiled scripts (created the first time a script file is loaded).
+std::unique_ptr<BytecodeCache> g_bytecodeCache;
+
 class AddScriptFilename {
 public:
   AddScriptFilename(const std::string& fn) {
@@ -135,7 +141,7 @@ int dofile(lua_State *L)
   }
 
   lua_settop(L, 1);
-  if (luaL_loadfile(L, fname.c_str()) != LUA_OK)
+  if (load_script_file(L, fname) != LUA_OK)
     return lua_error(L);
   {
     AddScriptFilename add(fname);
@@ -169,6 +175,24 @@ int os_clock(lua_State* L)
 
 } // anonymous namespace
 
+int load_script_file(lua_State* L, const std::string& filename)
+{
+  auto app = App::instance();
+  if (!app ||
+      !app->preferences().scripts.bytecodeCache() ||
+      // The debugger needs the source code of each file
+      g_debuggerDelegate) {
+    return luaL_loadfile(L, filename.c_str());
+  }
+
+  if (!g_bytecodeCache) {
+    ResourceFinder rf;
+    rf.includeUserDir(base::join_path("scripts-cache", ".").c_str());
+    g_bytecodeCache = std::make_unique<BytecodeCache>(rf.getFirstOrCreateDefault());
+  }
+  return g_bytecodeCache->loadFile(L, base::get_absolute_path(filename));
+}
+
 void register_app_object(lua_State* L);
 void register_app_pixel_color_object(lua_State* L);
 void register_app_fs_object(lua_State* L);
@@ -225,7 +249,7 @@ void register_websocket_class(lua_State* L);
 void set_app_params(lua_State* L, const Params& params);
 
 Engine::Engine()
-  : L(luaL_newstate())
+  : L(new_lua_state())
   , m_delegate(nullptr)
   , m_printLastResult(false)
 {
@@ -357,6 +381,7 @@ Engine::Engine()
   lua_setglobal(L, "SpriteSheetDataFormat");
   setfield_integer(L, "JSON_HASH", SpriteSheetDataFormat::JsonHash);
   setfield_integer(L, "JSON_ARRAY", SpriteSheetDataFormat::JsonArray);
+  setfield_integer(L, "MSGPACK", SpriteSheetDataFormat::MsgPack);
   lua_pop(L, 1);
 
   lua_newtable(L);
@@ -536,7 +561,7 @@ Engine::~Engine()
 void Engine::destroy()
 {
   close_all_dialogs();
-  lua_close(L);
+  close_lua_state(L);
   L = nullptr;
 }
 
@@ -565,10 +590,18 @@ void Engine::printLastResult()
 
 bool Engine::evalCode(const std::string& code,
                       const std::string& filename)
+{
+  return evalChunk(
+    [this, &code, &filename]{
+      return luaL_loadbuffer(L, code.c_str(), code.size(), filename.c_str());
+    });
+}
+
+bool Engine::evalChunk(const std::function<int()>& loadChunk)
 {
   bool ok = true;
   try {
-    if (luaL_loadbuffer(L, code.c_str(), code.size(), filename.c_str()) ||
+    if (loadChunk() != LUA_OK ||
         lua_pcall(L, 0, 1, 0)) {
       const char* s = lua_tostring(L, -1);
       if (s)
@@ -620,26 +653,34 @@ void Engine::handleException(const std::exception& ex)
 bool Engine::evalFile(const std::string& filename,
                       const Params& params)
 {
+  // Returns false if we cannot open the file
+  if (!base::is_file(filename))
+    return false;
+
+  std::string absFilename = base::get_absolute_path(filename);
+
+  AddScriptFilename addScript(absFilename);
+  set_app_params(L, params);
+
+  // Without debugger we can load the file from the bytecode cache
+  if (!g_debuggerDelegate) {
+    return evalChunk(
+      [this, &absFilename]{
+        return load_script_file(L, absFilename);
+      });
+  }
+
   std::stringstream buf;
   {
     std::ifstream s(FSTREAM_PATH(filename));
-    // Returns false if we cannot open the file
     if (!s)
       return false;
     buf << s.rdbuf();
   }
-  std::string absFilename = base::get_absolute_path(filename);
-
-  AddScriptFilename addScript(absFilename);
-  set_app_params(L, params);
-
-  if (g_debuggerDelegate)
-    g_debuggerDelegate->startFile(absFilename, buf.str());
 
+  g_debuggerDelegate->startFile(absFilename, buf.str());
   bool result = evalCode(buf.str(), "@" + absFilename);
-
-  if (g_debuggerDelegate)
-    g_debuggerDelegate->endFile(absFilename);
+  g_debuggerDelegate->endFile(absFilename);
 
   return result;
 }
@@ -24,6 +24,7 @@
 #include "doc/tile.h"
 #include "gfx/fwd.h"
 
+#include <cstdint>
 #include <cstdio>
 #include <functional>
 #include <map>
@@ -124,6 +125,9 @@ namespace app {
     void stopDebugger();
 
   private:
+    // Calls the function to load a chunk (e.g. luaL_loadbuffer()) and
+    // executes it.
+    bool evalChunk(const std::function<int()>& loadChunk);
     void onConsoleError(const char* text);
     void onConsolePrint(const char* text);
 
@@ -199,12 +203,18 @@ namespace app {
   doc::Image* get_image_from_arg(lua_State* L, int index);
   doc::Cel* get_image_cel_from_arg(lua_State* L, int index);
   doc::Tileset* get_image_tileset_from_arg(lua_State* L, int index);
+  const uint8_t* may_get_image_bytes_from_arg(lua_State* L, int index, size_t& size);
   doc::frame_t get_frame_number_from_arg(lua_State* L, int index);
   const doc::Mask* get_mask_from_arg(lua_State* L, int index);
   app::tools::Tool* get_tool_from_arg(lua_State* L, int index);
   doc::BrushRef get_brush_from_arg(lua_State* L, int index);
   doc::Tileset* get_tile_index_from_arg(lua_State* L, int index, doc::tile_index& ts);
 
+  // Loads a script file like luaL_loadfile() but using the bytecode
+  // cache (if it's enabled). Used by Engine::evalFile(), dofile(),
+  // and require().
+  int load_script_file(lua_State* L, const std::string& filename);
+
   // Used by App.open(), Sprite{ fromFile }, and Image{ fromFile }
   enum class LoadSpriteFromFileParam { FullAniAsSprite,
                                        OneFrameAsSprite,
@@ -23,16 +23,22 @@
 #include "app/script/values.h"
 #include "app/site.h"
 #include "app/ui/main_window.h"
+#include "base/time.h"
 #include "doc/document.h"
 #include "doc/sprite.h"
 #include "ui/app_state.h"
+#include "ui/manager.h"
 #include "ui/resize_event.h"
+#include "ui/timer.h"
 
+#include <algorithm>
 #include <any>
 #include <cstring>
 #include <initializer_list>
 #include <map>
 #include <memory>
+#include <set>
+#include <vector>
 
 // This event was disabled because it can be triggered in a background thread
 // when any effect (e.g. like Replace Color or Convolution Matrix) is running.
@@ -59,29 +65,46 @@ class Events {
 public:
   using EventType = int;
 
+  // Result of deliverPending()
+  enum class Pending { None, NotReady, Delivered };
+
+  // Options of each listener, events:on(name, function, options)
+  struct Options {
+    // Coalesce several events in just one call (delivered once per
+    // UI frame)
+    bool coalesce = false;
+    // Min time between calls of a coalesced listener (maxRate option)
+    base::tick_t minInterval = 0;
+  };
+
   Events() { }
-  virtual ~Events() { }
+  virtual ~Events();
   Events(const Events&) = delete;
   Events& operator=(const Events&) = delete;
 
   virtual EventType eventType(const char* eventName) const = 0;
 
+  // Events that must be notified synchronously (e.g. "beforecommand"
+  // because the listener can cancel the command).
+  virtual bool canCoalesce(EventType eventType) const { return true; }
+
   bool hasListener(EventListener callbackRef) const {
     for (auto& listeners : m_listeners) {
-      for (EventListener listener : listeners) {
-        if (listener == callbackRef)
+      for (const Listener& listener : listeners) {
+        if (listener.ref == callbackRef)
           return true;
       }
     }
     return false;
   }
 
-  void add(EventType eventType, EventListener callbackRef) {
+  void add(EventType eventType, EventListener callbackRef,
+           const Options& options = Options()) {
     if (eventType >= m_listeners.size())
       m_listeners.resize(eventType+1);
 
     auto& listeners = m_listeners[eventType];
-    listeners.push_back(callbackRef);
+    listeners.push_back(Listener{ callbackRef, options });
     if (listeners.size() == 1)
       onAddFirstListener(eventType);
   }
@@ -93,8 +116,9 @@ public:
       auto end = listeners.end();
       bool removed = false;
       for (; it != end; ) {
-        if (*it == callbackRef) {
+        if (it->ref == callbackRef) {
           removed = true;
+          unrefPendingArgs(*it);
           it = listeners.erase(it);
           end = listeners.end();
         }
@@ -106,48 +130,224 @@ public:
     }
   }
 
+  // Calls one coalesced listener which has pending events and whose
+  // interval has elapsed. It doesn't use "this" after calling the
+  // Lua function (as the listener can delete this Events instance,
+  // e.g. closing the sprite).
+  Pending deliverPending(const base::tick_t now);
+
 protected:
   void call(EventType eventType,
-            const std::initializer_list<std::pair<const std::string, std::any>>& args = {}) {
-    if (eventType >= m_listeners.size())
-      return;
+            const std::initializer_list<std::pair<const std::string, std::any>>& args = {});
 
-    script::Engine* engine = App::instance()->scriptEngine();
-    lua_State* L = engine->luaState();
+private:
+  struct Listener {
+    EventListener ref;
+    Options options;
+    base::tick_t lastCall = 0;
+    int pendingCount = 0;
+    // "ev" table of the last coalesced event
+    int pendingArgsRef = LUA_NOREF;
+  };
 
-    try {
-      for (EventListener callbackRef : m_listeners[eventType]) {
-        // Get user-defined callback function
-        lua_rawgeti(L, LUA_REGISTRYINDEX, callbackRef);
+  virtual void onAddFirstListener(EventType eventType) = 0;
+  virtual void onRemoveLastListener(EventType eventType) = 0;
 
-        int callbackArgs = 0;
-        if (args.size() > 0) {
-          ++callbackArgs;
-          lua_newtable(L);       // Create "ev" argument with fields about the event
-          for (const auto& kv : args) {
-            push_value_to_lua(L, kv.second);
-            lua_setfield(L, -2, kv.first.c_str());
-          }
-        }
+  static void pushArgs(lua_State* L,
+                       const std::initializer_list<std::pair<const std::string, std::any>>& args);
+  static void callListener(int nargs);
+  static void unrefPendingArgs(Listener& listener);
 
-        if (lua_pcall(L, callbackArgs, 0, 0)) {
-          if (const char* s = lua_tostring(L, -1))
-            engine->consolePrint(s);
-        }
+  using EventListeners = std::vector<Listener>;
+  std::vector<EventListeners> m_listeners;
+};
+
+// Events with coalesced events pending to be delivered in the next
+// tick of g_flushTimer.
+static std::set<Events*> g_pendingEvents;
+static std::unique_ptr<ui::Timer> g_flushTimer;
+
+// Coalesced events are delivered at most once per UI frame
+const int kFlushInterval = 16;
+
+static bool can_postpone_events()
+{
+  auto app = App::instance();
+  return (app && app->isGui() && ui::Manager::getDefault());
+}
+
+static void flush_pending_events()
+{
+  const base::tick_t now = base::current_tick();
+  const std::vector<Events*> events(g_pendingEvents.begin(),
+                                    g_pendingEvents.end());
+  for (Events* evs : events) {
+    Events::Pending result;
+    do {
+      // This Events instance was deleted by a previous listener
+      if (g_pendingEvents.find(evs) == g_pendingEvents.end())
+        break;
+
+      result = evs->deliverPending(now);
+      if (result == Events::Pending::None)
+        g_pendingEvents.erase(evs);
+    } while (result == Events::Pending::Delivered);
+  }
+
+  if (g_pendingEvents.empty() && g_flushTimer)
+    g_flushTimer->stop();
+}
+
+static void schedule_pending_events(Events* evs)
+{
+  g_pendingEvents.insert(evs);
+
+  if (!g_flushTimer) {
+    g_flushTimer = std::make_unique<ui::Timer>(kFlushInterval,
+                                               ui::Manager::getDefault());
+    g_flushTimer->Tick.connect([]{ flush_pending_events(); });
+    App::instance()->ExitGui.connect([]{
+      g_pendingEvents.clear();
+      g_flushTimer.reset();
+    });
+  }
+  if (!g_flushTimer->isRunning())
+    g_flushTimer->start();
+}
+
+Events::~Events()
+{
+  g_pendingEvents.erase(this);
+
+  if (auto app = App::instance(); app && app->scriptEngine()) {
+    for (auto& listeners : m_listeners)
+      for (Listener& listener : listeners)
+        unrefPendingArgs(listener);
+  }
+}
+
+Events::Pending Events::deliverPending(const base::tick_t now)
+{
+  bool notReady = false;
+  for (auto& listeners : m_listeners) {
+    for (Listener& listener : listeners) {
+      if (listener.pendingCount == 0)
+        continue;
+
+      // Each listener is called once per tick at most
+      if (now - listener.lastCall < std::max<base::tick_t>(listener.options.minInterval, 1)) {
+        notReady = true;
+        continue;
       }
+
+      const EventListener callbackRef = listener.ref;
+      const int argsRef = listener.pendingArgsRef;
+      const int count = listener.pendingCount;
+      listener.pendingArgsRef = LUA_NOREF;
+      listener.pendingCount = 0;
+      listener.lastCall = now;
+
+      lua_State* L = App::instance()->scriptEngine()->luaState();
+      lua_rawgeti(L, LUA_REGISTRYINDEX, callbackRef);
+      lua_rawgeti(L, LUA_REGISTRYINDEX, argsRef);
+      luaL_unref(L, LUA_REGISTRYINDEX, argsRef);
+      lua_pushinteger(L, count);
+      lua_setfield(L, -2, "count");
+      callListener(1);
+      return Pending::Delivered;
     }
-    catch (const std::exception& ex) {
-      engine->consolePrint(ex.what());
+  }
+  return (notReady ? Pending::NotReady: Pending::None);
+}
+
+void Events::call(EventType eventType,
+                  const std::initializer_list<std::pair<const std::string, std::any>>& args)
+{
+  if (eventType >= m_listeners.size())
+    return;
+
+  script::Engine* engine = App::instance()->scriptEngine();
+  lua_State* L = engine->luaState();
+  const bool postpone = can_postpone_events();
+
+  try {
+    auto& listeners = m_listeners[eventType];
+    for (size_t i=0; i<listeners.size(); ++i) {
+      Listener& listener = listeners[i];
+      const EventListener callbackRef = listener.ref;
+
+      if (listener.options.coalesce) {
+        // Save the "ev" table to call the listener in the next tick
+        // (the table is created now because the event arguments
+        // could be invalid later).
+        if (postpone) {
+          pushArgs(L, args);
+          unrefPendingArgs(listener);
+          listener.pendingArgsRef = luaL_ref(L, LUA_REGISTRYINDEX);
+          ++listener.pendingCount;
+          schedule_pending_events(this);
+          continue;
+        }
+
+        // Without UI (e.g. --batch mode) we call the listener
+        // immediately (with ev.count=1)
+        lua_rawgeti(L, LUA_REGISTRYINDEX, callbackRef);
+        pushArgs(L, args);
+        lua_pushinteger(L, 1);
+        lua_setfield(L, -2, "count");
+        callListener(1);
+        continue;
+      }
+
+      // Get user-defined callback function
+      lua_rawgeti(L, LUA_REGISTRYINDEX, callbackRef);
+
+      int callbackArgs = 0;
+      if (args.size() > 0) {
+        ++callbackArgs;
+        pushArgs(L, args);
+      }
+      callListener(callbackArgs);
     }
   }
+  catch (const std::exception& ex) {
+    engine->consolePrint(ex.what());
+  }
+}
 
-private:
-  virtual void onAddFirstListener(EventType eventType) = 0;
-  virtual void onRemoveLastListener(EventType eventType) = 0;
+// static
+void Events::pushArgs(lua_State* L,
+                      const std::initializer_list<std::pair<const std::string, std::any>>& args)
+{
+  lua_newtable(L);       // Create "ev" argument with fields about the event
+  for (const auto& kv : args) {
+    push_value_to_lua(L, kv.second);
+    lua_setfield(L, -2, kv.first.c_str());
+  }
+}
 
-  using EventListeners = std::vector<EventListener>;
-  std::vector<EventListeners> m_listeners;
-};
+// static
+void Events::callListener(int nargs)
+{
+  script::Engine* engine = App::instance()->scriptEngine();
+  lua_State* L = engine->luaState();
+  if (lua_pcall(L, nargs, 0, 0)) {
+    if (const char* s = lua_tostring(L, -1))
+      engine->consolePrint(s);
+    lua_pop(L, 1);
+  }
+}
+
+// static
+void Events::unrefPendingArgs(Listener& listener)
+{
+  if (listener.pendingArgsRef != LUA_NOREF) {
+    lua_State* L = App::instance()->scriptEngine()->luaState();
+    luaL_unref(L, LUA_REGISTRYINDEX, listener.pendingArgsRef);
+    listener.pendingArgsRef = LUA_NOREF;
+    listener.pendingCount = 0;
+  }
+}
 
 // Used in BeforeCommand
 static bool s_stopPropagationFlag = false;
@@ -182,6 +382,12 @@ public:
       return Unknown;
   }
 
+  // The "beforecommand" listener can cancel the command with
+  // ev.stopPropagation(), so it must be called synchronously.
+  bool canCoalesce(EventType eventType) const override {
+    return (eventType != BeforeCommand);
+  }
+
 private:
 
   void onAddFirstListener(EventType eventType) override {
@@ -462,10 +668,31 @@ int Events_on(lua_State* L)
   if (!lua_isfunction(L, 3))
     return luaL_error(L, "second argument must be a function");
 
+  // Options to coalesce/throttle events, e.g.
+  //   events:on('change', function, { coalesce=true, maxRate=30 })
+  Events::Options options;
+  if (lua_istable(L, 4)) {
+    if (lua_getfield(L, 4, "coalesce") != LUA_TNIL)
+      options.coalesce = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+
+    if (lua_getfield(L, 4, "maxRate") != LUA_TNIL) {
+      const double maxRate = lua_tonumber(L, -1);
+      if (maxRate > 0.0) {
+        options.coalesce = true;
+        options.minInterval = base::tick_t(1000.0 / maxRate);
+      }
+    }
+    lua_pop(L, 1);
+
+    if (options.coalesce && !evs->canCoalesce(type))
+      return luaL_error(L, "'%s' events cannot be coalesced", eventName);
+  }
+
   // Copy the callback function to add it to the global registry
   lua_pushvalue(L, 3);
   int callbackRef = luaL_ref(L, LUA_REGISTRYINDEX);
-  evs->add(type, callbackRef);
+  evs->add(type, callbackRef, options);
 
   // Return the callback ref (this is an EventListener easier to use
   // in Events_off())
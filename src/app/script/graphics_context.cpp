@@ -31,6 +31,9 @@ namespace script {
 
 void GraphicsContext::fillText(const std::string& text, int x, int y)
 {
+  if (record([text, x, y](GraphicsContext& gc){ gc.fillText(text, x, y); }))
+    return;
+
   os::draw_text(m_surface.get(), m_font.get(),
                 text, m_paint.color(), 0, x, y, nullptr);
 }
@@ -43,7 +46,7 @@ gfx::Size GraphicsContext::measureText(const std::string& text) const
 
 void GraphicsContext::drawImage(const doc::Image* img, int x, int y)
 {
-  if (m_paint.blendMode() == os::BlendMode::Src) {
+  if (!m_recording && m_paint.blendMode() == os::BlendMode::Src) {
     convert_image_to_surface(
       img,
       m_palette ? m_palette : get_current_palette(),
@@ -64,6 +67,28 @@ void GraphicsContext::drawImage(const doc::Image* img,
   if (srcRc.isEmpty() || dstRc.isEmpty())
     return;                     // Do nothing for empty rectangles
 
+  // Convert the image to a new surface that is kept in the display
+  // list (the image can be modified/deleted after this)
+  if (m_recording) {
+    os::SurfaceRef surface = os::instance()->makeRgbaSurface(srcRc.w, srcRc.h);
+    if (!surface)
+      return;
+
+    convert_image_to_surface(
+      img,
+      m_palette ? m_palette : get_current_palette(),
+      surface.get(),
+      srcRc.x, srcRc.y,
+      0, 0,
+      srcRc.w, srcRc.h);
+
+    const gfx::Rect rc(0, 0, srcRc.w, srcRc.h);
+    record([surface, rc, dstRc](GraphicsContext& gc){
+      gc.drawSurface(surface.get(), rc, dstRc);
+    });
+    return;
+  }
+
   static os::SurfaceRef tmpSurface = nullptr;
   if (!tmpSurface ||
       tmpSurface->width() < srcRc.w ||
@@ -81,13 +106,22 @@ void GraphicsContext::drawImage(const doc::Image* img,
       0, 0,
       srcRc.w, srcRc.h);
 
-    m_surface->drawSurface(tmpSurface.get(), gfx::Rect(0, 0, srcRc.w, srcRc.h),
-                           dstRc, os::Sampling(), &m_paint);
+    drawSurface(tmpSurface.get(), gfx::Rect(0, 0, srcRc.w, srcRc.h), dstRc);
   }
 }
 
+void GraphicsContext::drawSurface(const os::Surface* surface,
+                                  const gfx::Rect& srcRc,
+                                  const gfx::Rect& dstRc)
+{
+  m_surface->drawSurface(surface, srcRc, dstRc, os::Sampling(), &m_paint);
+}
+
 void GraphicsContext::drawThemeImage(const std::string& partId, const gfx::Point& pt)
 {
+  if (record([partId, pt](GraphicsContext& gc){ gc.drawThemeImage(partId, pt); }))
+    return;
+
   if (auto theme = skin::SkinTheme::instance()) {
     skin::SkinPartPtr part = (m_uiscale > 1 ? theme->getUnscaledPartById(partId):
                                               theme->getPartById(partId));
@@ -100,6 +134,9 @@ void GraphicsContext::drawThemeImage(const std::string& partId, const gfx::Point
 
 void GraphicsContext::drawThemeRect(const std::string& partId, const gfx::Rect& rc)
 {
+  if (record([partId, rc](GraphicsContext& gc){ gc.drawThemeRect(partId, rc); }))
+    return;
+
   if (auto theme = skin::SkinTheme::instance()) {
     skin::SkinPartPtr part = (m_uiscale > 1 ? theme->getUnscaledPartById(partId):
                                               theme->getPartById(partId));
@@ -141,14 +178,34 @@ void GraphicsContext::drawThemeRect(const std::string& partId, const gfx::Rect&
   }
 }
 
+void GraphicsContext::drawList(const DisplayList& list)
+{
+  if (record([list](GraphicsContext& gc){ gc.drawList(list); }))
+    return;
+
+  // Restore the state even if the list contains unbalanced
+  // save()/restore() calls
+  const size_t n = m_saved.size();
+  save();
+  list.replay(*this);
+  while (m_saved.size() > n)
+    restore();
+}
+
 void GraphicsContext::stroke()
 {
+  if (record([](GraphicsContext& gc){ gc.stroke(); }))
+    return;
+
   m_paint.style(os::Paint::Stroke);
   m_surface->drawPath(m_path, m_paint);
 }
 
 void GraphicsContext::fill()
 {
+  if (record([](GraphicsContext& gc){ gc.fill(); }))
+    return;
+
   m_paint.style(os::Paint::Fill);
   m_surface->drawPath(m_path, m_paint);
 }
@@ -273,6 +330,38 @@ int GraphicsContext_drawImage(lua_State* L)
   return 0;
 }
 
+// gc:record(function(gc) ... end) calls the function with a context
+// that records the drawing commands, and returns the DisplayList to be
+// drawn with gc:drawList(list) (e.g. in each onpaint) without running
+// the Lua code again.
+int GraphicsContext_record(lua_State* L)
+{
+  auto gc = get_obj<GraphicsContext>(L, 1);
+  luaL_checktype(L, 2, LUA_TFUNCTION);
+
+  DisplayList list;
+  lua_pushvalue(L, 2);
+  auto recorder = push_new<GraphicsContext>(L, GraphicsContext(*gc, list));
+  // The recorder can be saved by the script, but it will not record
+  // anything else after this call
+  if (lua_pcall(L, 1, 0, 0) != LUA_OK) {
+    recorder->stopRecording();
+    return lua_error(L);
+  }
+  recorder->stopRecording();
+
+  push_obj(L, list);
+  return 1;
+}
+
+int GraphicsContext_drawList(lua_State* L)
+{
+  auto gc = get_obj<GraphicsContext>(L, 1);
+  const auto list = get_obj<DisplayList>(L, 2);
+  gc->drawList(*list);
+  return 0;
+}
+
 int GraphicsContext_theme(lua_State* L)
 {
   auto gc = get_obj<GraphicsContext>(L, 1);
@@ -509,6 +598,8 @@ const luaL_Reg GraphicsContext_methods[] = {
   { "drawImage", GraphicsContext_drawImage },
   { "drawThemeImage", GraphicsContext_drawThemeImage },
   { "drawThemeRect", GraphicsContext_drawThemeRect },
+  { "record", GraphicsContext_record },
+  { "drawList", GraphicsContext_drawList },
   { "beginPath", GraphicsContext_beginPath },
   { "closePath", GraphicsContext_closePath },
   { "moveTo", GraphicsContext_moveTo },
@@ -522,6 +613,25 @@ const luaL_Reg GraphicsContext_methods[] = {
   { nullptr, nullptr }
 };
 
+int DisplayList_gc(lua_State* L)
+{
+  get_obj<DisplayList>(L, 1)->~DisplayList();
+  return 0;
+}
+
+int DisplayList_len(lua_State* L)
+{
+  auto list = get_obj<DisplayList>(L, 1);
+  lua_pushinteger(L, list->size());
+  return 1;
+}
+
+const luaL_Reg DisplayList_methods[] = {
+  { "__gc", DisplayList_gc },
+  { "__len", DisplayList_len },
+  { nullptr, nullptr }
+};
+
 const Property GraphicsContext_properties[] = {
   { "width", GraphicsContext_get_width, nullptr },
   { "height", GraphicsContext_get_height, nullptr },
@@ -538,11 +648,14 @@ const Property GraphicsContext_properties[] = {
 } // anonymous namespace
 
 DEF_MTNAME(GraphicsContext);
+DEF_MTNAME(DisplayList);
 
 void register_graphics_context_class(lua_State* L)
 {
   REG_CLASS(L, GraphicsContext);
   REG_CLASS_PROPERTIES(L, GraphicsContext);
+
+  REG_CLASS(L, DisplayList);
 }
 
 } // namespace script
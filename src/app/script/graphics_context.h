@@ -14,7 +14,11 @@
 #include "os/paint.h"
 #include "os/surface.h"
 
+#include <functional>
+#include <memory>
 #include <stack>
+#include <string>
+#include <vector>
 
 namespace doc {
   class Image;
@@ -23,6 +27,29 @@ namespace doc {
 namespace app {
 namespace script {
 
+class GraphicsContext;
+
+// Drawing commands recorded with gc:record() that can be replayed
+// (with gc:drawList()) without calling Lua code again. Images are
+// converted to surfaces when they are recorded, so each replay is
+// just a blit. Copies share the same list of commands.
+class DisplayList {
+public:
+  using Command = std::function<void(GraphicsContext&)>;
+
+  DisplayList() : m_cmds(std::make_shared<std::vector<Command>>()) { }
+
+  void add(Command&& cmd) { m_cmds->push_back(std::move(cmd)); }
+  void replay(GraphicsContext& gc) const {
+    for (const auto& cmd : *m_cmds)
+      cmd(gc);
+  }
+  int size() const { return int(m_cmds->size()); }
+
+private:
+  std::shared_ptr<std::vector<Command>> m_cmds;
+};
+
 class GraphicsContext {
 private:
   struct State {
@@ -37,59 +64,109 @@ public:
     std::swap(m_paint, gc.m_paint);
     std::swap(m_font, gc.m_font);
     std::swap(m_path, gc.m_path);
+    std::swap(m_list, gc.m_list);
     m_uiscale = gc.m_uiscale;
+    m_palette = gc.m_palette;
+    m_recording = gc.m_recording;
+  }
+
+  // Creates a context that records the drawing commands in the given
+  // list instead of drawing in the surface of "gc" (its current state
+  // is used as the initial state).
+  GraphicsContext(const GraphicsContext& gc, const DisplayList& list)
+    : m_surface(gc.m_surface)
+    , m_uiscale(gc.m_uiscale)
+    , m_paint(gc.m_paint)
+    , m_font(gc.m_font)
+    , m_palette(gc.m_palette)
+    , m_list(list)
+    , m_recording(true) { }
+
+  // Detaches the display list that was being recorded, the next
+  // commands are discarded (they will not be drawn in the surface).
+  void stopRecording() {
+    if (m_recording)
+      m_list = DisplayList();
   }
 
   os::FontRef font() const { return m_font; }
-  void font(const os::FontRef& font) { m_font = font; }
+  void font(const os::FontRef& font) {
+    record([font](GraphicsContext& gc){ gc.font(font); });
+    m_font = font;
+  }
 
   doc::Palette* palette() const { return m_palette; }
+  // The palette is not recorded, images are converted to surfaces
+  // when they are recorded.
   void palette(doc::Palette* palette) { m_palette = palette; }
 
   int width() const { return m_surface->width(); }
   int height() const { return m_surface->height(); }
 
   void save() {
+    record([](GraphicsContext& gc){ gc.save(); });
     m_saved.push(State{m_paint, m_palette});
-    m_surface->save();
+    if (!m_recording)
+      m_surface->save();
   }
 
   void restore() {
+    record([](GraphicsContext& gc){ gc.restore(); });
     if (!m_saved.empty()) {
       auto state = m_saved.top();
       m_paint = state.paint;
       m_palette = state.palette;
       m_saved.pop();
-      m_surface->restore();
+      if (!m_recording)
+        m_surface->restore();
     }
   }
 
   bool antialias() const { return m_paint.antialias(); }
-  void antialias(bool value) { m_paint.antialias(value); }
+  void antialias(bool value) {
+    record([value](GraphicsContext& gc){ gc.antialias(value); });
+    m_paint.antialias(value);
+  }
 
   gfx::Color color() const { return m_paint.color(); }
-  void color(gfx::Color color) { m_paint.color(color); }
+  void color(gfx::Color color) {
+    record([color](GraphicsContext& gc){ gc.color(color); });
+    m_paint.color(color);
+  }
 
   float strokeWidth() const { return m_paint.strokeWidth(); }
-  void strokeWidth(float value) { m_paint.strokeWidth(value); }
+  void strokeWidth(float value) {
+    record([value](GraphicsContext& gc){ gc.strokeWidth(value); });
+    m_paint.strokeWidth(value);
+  }
 
 #if LAF_SKIA
   int opacity() const { return m_paint.skPaint().getAlpha(); }
-  void opacity(int value) { m_paint.skPaint().setAlpha(value); }
+  void opacity(int value) {
+    record([value](GraphicsContext& gc){ gc.opacity(value); });
+    m_paint.skPaint().setAlpha(value);
+  }
 #else
   int opacity() const { return 255; }
   void opacity(int) { }
 #endif
 
   os::BlendMode blendMode() const { return m_paint.blendMode(); }
-  void blendMode(const os::BlendMode bm) { m_paint.blendMode(bm); }
+  void blendMode(const os::BlendMode bm) {
+    record([bm](GraphicsContext& gc){ gc.blendMode(bm); });
+    m_paint.blendMode(bm);
+  }
 
   void strokeRect(const gfx::Rect& rc) {
+    if (record([rc](GraphicsContext& gc){ gc.strokeRect(rc); }))
+      return;
     m_paint.style(os::Paint::Stroke);
     m_surface->drawRect(rc, m_paint);
   }
 
   void fillRect(const gfx::Rect& rc) {
+    if (record([rc](GraphicsContext& gc){ gc.fillRect(rc); }))
+      return;
     m_paint.style(os::Paint::Fill);
     m_surface->drawRect(rc, m_paint);
   }
@@ -105,27 +182,50 @@ public:
   void drawThemeImage(const std::string& partId, const gfx::Point& pt);
   void drawThemeRect(const std::string& partId, const gfx::Rect& rc);
 
-  // Path
-  void beginPath() { m_path.reset(); }
-  void closePath() { m_path.close(); }
-  void moveTo(float x, float y) { m_path.moveTo(x, y); }
-  void lineTo(float x, float y) { m_path.lineTo(x, y); }
+  // Replays the commands of the list (the state of this context is
+  // restored after that).
+  void drawList(const DisplayList& list);
+
+  // Path (the path is recorded as it's built, so it's available in
+  // the replay when it's stroked/filled)
+  void beginPath() {
+    record([](GraphicsContext& gc){ gc.beginPath(); });
+    m_path.reset();
+  }
+  void closePath() {
+    record([](GraphicsContext& gc){ gc.closePath(); });
+    m_path.close();
+  }
+  void moveTo(float x, float y) {
+    record([x, y](GraphicsContext& gc){ gc.moveTo(x, y); });
+    m_path.moveTo(x, y);
+  }
+  void lineTo(float x, float y) {
+    record([x, y](GraphicsContext& gc){ gc.lineTo(x, y); });
+    m_path.lineTo(x, y);
+  }
   void cubicTo(float cp1x, float cp1y, float cp2x, float cp2y, float x, float y) {
+    record([=](GraphicsContext& gc){ gc.cubicTo(cp1x, cp1y, cp2x, cp2y, x, y); });
     m_path.cubicTo(cp1x, cp1y, cp2x, cp2y, x, y);
   }
   void oval(const gfx::Rect& rc) {
+    record([rc](GraphicsContext& gc){ gc.oval(rc); });
     m_path.oval(rc);
   }
   void rect(const gfx::Rect& rc) {
+    record([rc](GraphicsContext& gc){ gc.rect(rc); });
     m_path.rect(rc);
   }
   void roundedRect(const gfx::Rect& rc, float rx, float ry) {
+    record([rc, rx, ry](GraphicsContext& gc){ gc.roundedRect(rc, rx, ry); });
     m_path.roundedRect(rc, rx, ry);
   }
   void stroke();
   void fill();
 
   void clip() {
+    if (record([](GraphicsContext& gc){ gc.clip(); }))
+      return;
     m_surface->clipPath(m_path);
   }
 
@@ -134,6 +234,20 @@ public:
   }
 
 private:
+  // Adds the command to the display list if we are recording,
+  // returns true in that case (so the command must not be executed
+  // in the surface).
+  bool record(DisplayList::Command&& cmd) {
+    if (!m_recording)
+      return false;
+    m_list.add(std::move(cmd));
+    return true;
+  }
+
+  void drawSurface(const os::Surface* surface,
+                   const gfx::Rect& srcRc,
+                   const gfx::Rect& dstRc);
+
   os::SurfaceRef m_surface = nullptr;
   // Keeps the UI Scale currently in use when canvas autoScaling is enabled.
   int m_uiscale;
@@ -142,6 +256,8 @@ private:
   gfx::Path m_path;
   std::stack<State> m_saved;
   doc::Palette* m_palette = nullptr;
+  DisplayList m_list;
+  bool m_recording = false;
 };
 
 } // namespace script
@@ -32,8 +32,12 @@
 #include "doc/algorithm/shrink_bounds.h"
 #include "doc/blend_image.h"
 #include "doc/cel.h"
+#include "doc/color.h"
 #include "doc/image.h"
+#include "doc/image_bits.h"
+#include "doc/image_buffer_pool.h"
 #include "doc/image_ref.h"
+#include "doc/palette.h"
 #include "doc/primitives.h"
 #include "doc/sprite.h"
 #include "render/render.h"
@@ -41,19 +45,19 @@
 #include <algorithm>
 #include <cstring>
 #include <memory>
+#include <unordered_map>
 
 namespace app {
 namespace script {
 
 namespace {
 
-static ImageBufferPtr buf; // TODO non-thread safe
-
 struct ImageObj {
   doc::ObjectId imageId = 0;
   doc::ObjectId celId = 0;
   doc::ObjectId tilesetId = 0;
   doc::tile_index ti = 0;
+  int batchLevel = 0;           // Inside Image:batch()
   ImageObj(doc::Image* image)
     : imageId(image->id()) {
   }
@@ -98,8 +102,97 @@ struct ImageObj {
     else
       return nullptr;
   }
+
+  // Rehashes the tileset when a tile image is modified (postponed to
+  // the end of Image:batch()).
+  void notifyPixelsChange(lua_State* L) {
+    if (tilesetId && batchLevel == 0) {
+      if (doc::Tileset* ts = tileset(L)) {
+        ts->incrementVersion();
+        ts->notifyTileContentChange(ti);
+      }
+    }
+  }
 };
 
+// View of the pixels buffer of an image (Image.byteView) to read and
+// write bytes without copying the whole buffer into a Lua string. The
+// view is invalidated when the image is resized or deleted (or when
+// the cel image is replaced).
+struct ImageBytesObj {
+  doc::ObjectId imageId = 0;
+  doc::ObjectId celId = 0;
+  doc::ObjectId tilesetId = 0;
+  doc::tile_index ti = 0;
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+  ImageBytesObj(ImageObj* obj, doc::Image* image)
+    : imageId(obj->imageId)
+    , celId(obj->celId)
+    , tilesetId(obj->tilesetId)
+    , ti(obj->ti)
+    , data(image->getPixelAddress(0, 0))
+    , size(size_t(image->rowBytes()) * image->height()) {
+  }
+  ImageBytesObj(const ImageBytesObj&) = delete;
+  ImageBytesObj& operator=(const ImageBytesObj&) = delete;
+
+  // Returns nullptr if the view is not valid anymore.
+  doc::Image* image() const {
+    doc::Image* image = doc::get<doc::Image>(imageId);
+    if (!image ||
+        image->getPixelAddress(0, 0) != data ||
+        size_t(image->rowBytes()) * image->height() != size)
+      return nullptr;
+    if (celId) {
+      doc::Cel* cel = doc::get<doc::Cel>(celId);
+      if (!cel || cel->image() != image)
+        return nullptr;
+    }
+    return image;
+  }
+
+  uint8_t* bytes(lua_State* L) const {
+    doc::Image* image = this->image();
+    if (!image)
+      luaL_error(L, "the image was resized or deleted, the byte view is not valid anymore");
+    return image->getPixelAddress(0, 0);
+  }
+
+  // Checks that the range [pos, pos+n) (pos is 1-based) is inside the
+  // buffer.
+  void checkRange(lua_State* L, lua_Integer pos, lua_Integer n) const {
+    if (pos < 1 || n < 0 || pos-1+n > lua_Integer(size))
+      luaL_error(L, "bytes range [%d, %d] is outside the image buffer (%d bytes)",
+                 int(pos), int(pos+n-1), int(size));
+  }
+
+  void notifyPixelsChange() {
+    if (tilesetId) {
+      if (doc::Tileset* ts = doc::get<doc::Tileset>(tilesetId)) {
+        ts->incrementVersion();
+        ts->notifyTileContentChange(ti);
+      }
+    }
+  }
+};
+
+// Returns the rectangle of the image specified in the argument
+// "index" (or the whole image if it's not specified). Raises an error
+// if the rectangle is not inside the image bounds.
+gfx::Rect get_pixels_rect_arg(lua_State* L, int index, const doc::Image* img)
+{
+  if (lua_isnone(L, index) || lua_isnil(L, index))
+    return img->bounds();
+
+  const gfx::Rect rc = convert_args_into_rect(L, index);
+  if (rc.isEmpty() || !img->bounds().contains(rc)) {
+    luaL_error(L, "rectangle (%d, %d, %d, %d) is outside the image bounds",
+               rc.x, rc.y, rc.w, rc.h);
+  }
+  return rc;
+}
+
 void render_sprite(Image* dst,
                    const Sprite* sprite,
                    const frame_t frame,
@@ -271,13 +364,90 @@ int Image_drawPixel(lua_State* L)
     color = convert_args_into_pixel_color(L, 4, img->pixelFormat());
   doc::put_pixel(img, x, y, color);
 
-  // Rehash tileset
-  if (obj->tilesetId) {
-    if (doc::Tileset* ts = obj->tileset(L)) {
-      ts->incrementVersion();
-      ts->notifyTileContentChange(obj->ti);
+  obj->notifyPixelsChange(L);
+  return 0;
+}
+
+// Returns the pixels of the given rectangle as a string of packed
+// bytes (bytesPerPixel bytes for each pixel, row by row, without
+// padding).
+int Image_getPixels(lua_State* L)
+{
+  const auto obj = get_obj<ImageObj>(L, 1);
+  const doc::Image* img = obj->image(L);
+  const gfx::Rect rc = get_pixels_rect_arg(L, 2, img);
+  const size_t rowBytes = size_t(img->bytesPerPixel()) * rc.w;
+
+  luaL_Buffer b;
+  char* dst = luaL_buffinitsize(L, &b, rowBytes * rc.h);
+  for (int y=0; y<rc.h; ++y, dst+=rowBytes)
+    std::memcpy(dst, img->getPixelAddress(rc.x, rc.y+y), rowBytes);
+  luaL_pushresultsize(&b, rowBytes * rc.h);
+  return 1;
+}
+
+// Puts the pixels of the given rectangle from a string with the same
+// format returned by Image:getPixels(), or from an array of integer
+// pixel values (row by row).
+int Image_putPixels(lua_State* L)
+{
+  auto obj = get_obj<ImageObj>(L, 1);
+  doc::Image* img = obj->image(L);
+  int i = 2;
+  gfx::Rect rc = img->bounds();
+  if (!lua_isnone(L, i+1))
+    rc = get_pixels_rect_arg(L, i++, img);
+
+  const size_t n = size_t(rc.w) * rc.h;
+  if (lua_type(L, i) == LUA_TSTRING) {
+    const size_t rowBytes = size_t(img->bytesPerPixel()) * rc.w;
+    size_t size;
+    const char* src = lua_tolstring(L, i, &size);
+    if (size != rowBytes * rc.h)
+      return luaL_error(L, "data size does not match: given %d, needed %d",
+                        int(size), int(rowBytes * rc.h));
+
+    for (int y=0; y<rc.h; ++y, src+=rowBytes)
+      std::memcpy(img->getPixelAddress(rc.x, rc.y+y), src, rowBytes);
+  }
+  else if (lua_istable(L, i)) {
+    if (luaL_len(L, i) != lua_Integer(n))
+      return luaL_error(L, "number of pixels does not match: given %d, needed %d",
+                        int(luaL_len(L, i)), int(n));
+
+    lua_Integer k = 1;
+    for (int y=0; y<rc.h; ++y) {
+      for (int x=0; x<rc.w; ++x, ++k) {
+        lua_geti(L, i, k);
+        doc::put_pixel(img, rc.x+x, rc.y+y, doc::color_t(lua_tointeger(L, -1)));
+        lua_pop(L, 1);
+      }
     }
   }
+  else {
+    return luaL_error(L, "expected a string or an array of pixels");
+  }
+
+  obj->notifyPixelsChange(L);
+  return 0;
+}
+
+// Calls the given function postponing the tileset rehash (when this
+// is a tile image) until the function ends, so several pixels can be
+// modified with drawPixel() without rehashing the tileset each time.
+int Image_batch(lua_State* L)
+{
+  auto obj = get_obj<ImageObj>(L, 1);
+  luaL_checktype(L, 2, LUA_TFUNCTION);
+
+  ++obj->batchLevel;
+  lua_pushvalue(L, 2);
+  const int status = lua_pcall(L, 0, 0, 0);
+  --obj->batchLevel;
+
+  obj->notifyPixelsChange(L);
+  if (status != LUA_OK)
+    return lua_error(L); // pcall already put an error object on the stack
   return 0;
 }
 
@@ -316,12 +486,10 @@ int Image_drawImage(lua_State* L)
   if (auto cel = obj->cel(L)) {
     gfx::Rect bounds(src->size());
 
-    // Create the ImageBuffer only when it doesn't exist so we can
-    // cache the allocated buffer.
-    if (!buf)
-      buf = std::make_shared<doc::ImageBuffer>();
-
-    ImageRef tmp_src(doc::crop_image(dst, gfx::Rect(pos, src->size()), 0, buf));
+    // Use a buffer from the pool to avoid allocating memory each
+    // time we draw in a cel.
+    ImageRef tmp_src(doc::crop_image(dst, gfx::Rect(pos, src->size()), 0,
+                                     ImageBufferPool::instance()->get()));
     doc::blend_image(tmp_src.get(), src,
                      gfx::Clip(src->size()),
                      cel->sprite()->palette(0),
@@ -346,6 +514,275 @@ int Image_drawImage(lua_State* L)
   return 0;
 }
 
+// Modifies the pixels of the image with the given "op" function. In
+// case of a cel image we modify a copy, and then the copy is patched
+// in the original image with undo information (as drawImage() does).
+template<typename Op>
+void modify_image_pixels(lua_State* L, ImageObj* obj, Op op)
+{
+  Image* dst = obj->image(L);
+  if (auto cel = obj->cel(L)) {
+    ImageRef tmp(doc::crop_image(dst, dst->bounds(), 0,
+                                 ImageBufferPool::instance()->get()));
+    op(tmp.get());
+
+    gfx::Rect bounds;
+    if (doc::algorithm::shrink_bounds2(dst, tmp.get(), dst->bounds(), bounds)) {
+      Tx tx(cel->sprite());
+      tx(new cmd::CopyRegion(dst, tmp.get(), gfx::Region(bounds),
+                             gfx::Point(0, 0)));
+      tx.commit();
+    }
+  }
+  else {
+    op(dst);
+    obj->notifyPixelsChange(L);
+  }
+}
+
+const doc::Palette* get_image_palette(lua_State* L, ImageObj* obj)
+{
+  if (auto cel = obj->cel(L))
+    return cel->sprite()->palette(cel->frame());
+  return get_current_palette();
+}
+
+// Reads a lookup table with entries from lut[0] to lut[255] (missing
+// entries are the identity).
+void read_lut(lua_State* L, int index, uint8_t lut[256])
+{
+  for (int i=0; i<256; ++i) {
+    lua_geti(L, index, i);
+    lut[i] = (lua_isinteger(L, -1) ? std::clamp<int>(lua_tointeger(L, -1), 0, 255): i);
+    lua_pop(L, 1);
+  }
+}
+
+// Reads the lookup table of a channel from the field "name" of the
+// table in "index" (if the field is present).
+void read_channel_lut(lua_State* L, int index, const char* name, uint8_t lut[256])
+{
+  if (lua_getfield(L, index, name) == LUA_TTABLE)
+    read_lut(L, -1, lut);
+  lua_pop(L, 1);
+}
+
+// Applies lookup tables to the channels of each pixel:
+//   image:map(lut) for color channels (or indexes)
+//   image:map{ red=lut, green=lut, blue=lut, gray=lut, alpha=lut, index=lut }
+int Image_map(lua_State* L)
+{
+  auto obj = get_obj<ImageObj>(L, 1);
+  luaL_checktype(L, 2, LUA_TTABLE);
+
+  uint8_t r[256], g[256], b[256], a[256], k[256];
+  for (int i=0; i<256; ++i)
+    r[i] = g[i] = b[i] = a[i] = k[i] = i;
+
+  lua_getfield(L, 2, "red");
+  lua_getfield(L, 2, "green");
+  lua_getfield(L, 2, "blue");
+  lua_getfield(L, 2, "gray");
+  lua_getfield(L, 2, "alpha");
+  lua_getfield(L, 2, "index");
+  bool channels = false;
+  for (int i=-6; i<0; ++i)
+    channels |= !lua_isnil(L, i);
+  lua_pop(L, 6);
+
+  if (channels) {
+    read_channel_lut(L, 2, "red", r);
+    read_channel_lut(L, 2, "green", g);
+    read_channel_lut(L, 2, "blue", b);
+    read_channel_lut(L, 2, "gray", k);
+    read_channel_lut(L, 2, "alpha", a);
+    read_channel_lut(L, 2, "index", k);
+  }
+  else {
+    read_lut(L, 2, r);
+    std::copy(r, r+256, g);
+    std::copy(r, r+256, b);
+    std::copy(r, r+256, k);
+  }
+
+  const doc::PixelFormat pixelFormat = obj->image(L)->pixelFormat();
+  if (pixelFormat != doc::IMAGE_RGB &&
+      pixelFormat != doc::IMAGE_GRAYSCALE &&
+      pixelFormat != doc::IMAGE_INDEXED)
+    return luaL_error(L, "map() is not supported for this color mode");
+
+  modify_image_pixels(
+    L, obj, [&](Image* img){
+      switch (img->pixelFormat()) {
+        case doc::IMAGE_RGB:
+          doc::transform_image<doc::RgbTraits>(
+            img, [&](doc::color_t c) -> doc::color_t {
+              return doc::rgba(r[doc::rgba_getr(c)],
+                               g[doc::rgba_getg(c)],
+                               b[doc::rgba_getb(c)],
+                               a[doc::rgba_geta(c)]);
+            });
+          break;
+        case doc::IMAGE_GRAYSCALE:
+          doc::transform_image<doc::GrayscaleTraits>(
+            img, [&](doc::color_t c) -> doc::color_t {
+              return doc::graya(k[doc::graya_getv(c)],
+                                a[doc::graya_geta(c)]);
+            });
+          break;
+        case doc::IMAGE_INDEXED:
+          doc::transform_image<doc::IndexedTraits>(
+            img, [&](doc::color_t c) -> doc::color_t {
+              return k[c & 0xff];
+            });
+          break;
+      }
+    });
+  return 0;
+}
+
+// Replaces pixel values: image:remap{ [oldPixel]=newPixel, ... }
+int Image_remap(lua_State* L)
+{
+  auto obj = get_obj<ImageObj>(L, 1);
+  luaL_checktype(L, 2, LUA_TTABLE);
+
+  std::unordered_map<doc::color_t, doc::color_t> map;
+  lua_pushnil(L);
+  while (lua_next(L, 2) != 0) {
+    if (lua_isinteger(L, -2) && lua_isinteger(L, -1))
+      map[doc::color_t(lua_tointeger(L, -2))] = doc::color_t(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+  }
+  if (map.empty())
+    return 0;
+
+  modify_image_pixels(
+    L, obj, [&map](Image* img){
+      auto f = [&map](doc::color_t c) -> doc::color_t {
+        auto it = map.find(c);
+        return (it != map.end() ? it->second: c);
+      };
+      switch (img->pixelFormat()) {
+        case doc::IMAGE_RGB:       doc::transform_image<doc::RgbTraits>(img, f); break;
+        case doc::IMAGE_GRAYSCALE: doc::transform_image<doc::GrayscaleTraits>(img, f); break;
+        case doc::IMAGE_INDEXED: {
+          // Flat table for indexed images
+          doc::color_t table[256];
+          for (int i=0; i<256; ++i)
+            table[i] = f(i);
+          doc::transform_image<doc::IndexedTraits>(
+            img, [&table](doc::color_t c) -> doc::color_t {
+              return table[c & 0xff];
+            });
+          break;
+        }
+        case doc::IMAGE_TILEMAP:   doc::transform_image<doc::TilemapTraits>(img, f); break;
+      }
+    });
+  return 0;
+}
+
+// Replaces each pixel with "low" or "high" depending on its luma:
+//   image:threshold(level [, low, high])
+// Transparent pixels are not modified.
+int Image_threshold(lua_State* L)
+{
+  auto obj = get_obj<ImageObj>(L, 1);
+  const int level = luaL_checkinteger(L, 2);
+  const doc::PixelFormat pixelFormat = obj->image(L)->pixelFormat();
+  const doc::Palette* pal = get_image_palette(L, obj);
+
+  doc::color_t low, high;
+  switch (pixelFormat) {
+    case doc::IMAGE_RGB:
+      low = doc::rgba(0, 0, 0, 255);
+      high = doc::rgba(255, 255, 255, 255);
+      break;
+    case doc::IMAGE_GRAYSCALE:
+      low = doc::graya(0, 255);
+      high = doc::graya(255, 255);
+      break;
+    case doc::IMAGE_INDEXED:
+      low = pal->findBestfit(0, 0, 0, 255, -1);
+      high = pal->findBestfit(255, 255, 255, 255, -1);
+      break;
+    default:
+      return luaL_error(L, "threshold() is not supported for this color mode");
+  }
+  if (!lua_isnoneornil(L, 3))
+    low = (lua_isinteger(L, 3) ? lua_tointeger(L, 3):
+           convert_args_into_pixel_color(L, 3, pixelFormat));
+  if (!lua_isnoneornil(L, 4))
+    high = (lua_isinteger(L, 4) ? lua_tointeger(L, 4):
+            convert_args_into_pixel_color(L, 4, pixelFormat));
+
+  modify_image_pixels(
+    L, obj, [&](Image* img){
+      switch (img->pixelFormat()) {
+        case doc::IMAGE_RGB:
+          doc::transform_image<doc::RgbTraits>(
+            img, [&](doc::color_t c) -> doc::color_t {
+              if (doc::rgba_geta(c) == 0)
+                return c;
+              return (doc::rgba_luma(c) >= level ? high: low);
+            });
+          break;
+        case doc::IMAGE_GRAYSCALE:
+          doc::transform_image<doc::GrayscaleTraits>(
+            img, [&](doc::color_t c) -> doc::color_t {
+              if (doc::graya_geta(c) == 0)
+                return c;
+              return (doc::graya_getv(c) >= level ? high: low);
+            });
+          break;
+        case doc::IMAGE_INDEXED: {
+          // Precalculated result for each palette entry
+          const doc::color_t mask = img->maskColor();
+          doc::color_t table[256];
+          for (int i=0; i<256; ++i) {
+            const doc::color_t c = pal->getEntry(std::min(i, pal->size()-1));
+            table[i] = (doc::color_t(i) == mask ? doc::color_t(i):
+                        doc::rgba_luma(c) >= level ? high: low);
+          }
+          doc::transform_image<doc::IndexedTraits>(
+            img, [&table](doc::color_t c) -> doc::color_t {
+              return table[c & 0xff];
+            });
+          break;
+        }
+      }
+    });
+  return 0;
+}
+
+// Blends the other image in the whole image:
+//   image:blend(other [, blendMode [, opacity]])
+int Image_blend(lua_State* L)
+{
+  auto obj = get_obj<ImageObj>(L, 1);
+  const Image* src = get_obj<ImageObj>(L, 2)->image(L);
+
+  doc::BlendMode blendMode = doc::BlendMode::NORMAL;
+  if (lua_isinteger(L, 3)) {
+    blendMode = base::convert_to<doc::BlendMode>(
+                  app::script::BlendMode(lua_tointeger(L, 3)));
+  }
+
+  int opacity = 255;
+  if (lua_isinteger(L, 4))
+    opacity = std::clamp(int(lua_tointeger(L, 4)), 0, 255);
+
+  const doc::Palette* pal = get_image_palette(L, obj);
+  modify_image_pixels(
+    L, obj, [&](Image* img){
+      doc::blend_image(img, src,
+                       gfx::Clip(src->bounds()),
+                       pal, opacity, blendMode);
+    });
+  return 0;
+}
+
 int Image_drawSprite(lua_State* L)
 {
   auto obj = get_obj<ImageObj>(L, 1);
@@ -699,6 +1136,18 @@ int Image_set_bytes(lua_State* L)
   return 0;
 }
 
+int Image_get_byteView(lua_State* L)
+{
+  auto obj = get_obj<ImageObj>(L, 1);
+  push_new<ImageBytesObj>(L, obj, obj->image(L));
+
+  // Keep a reference to the Image userdata so the image is not
+  // deleted while the view is alive.
+  lua_pushvalue(L, 1);
+  lua_setiuservalue(L, -2, 1);
+  return 1;
+}
+
 int Image_get_width(lua_State* L)
 {
   const auto obj = get_obj<ImageObj>(L, 1);
@@ -746,6 +1195,13 @@ const luaL_Reg Image_methods[] = {
   { "clear", Image_clear },
   { "getPixel", Image_getPixel },
   { "drawPixel", Image_drawPixel }, { "putPixel", Image_drawPixel },
+  { "getPixels", Image_getPixels },
+  { "putPixels", Image_putPixels },
+  { "batch", Image_batch },
+  { "map", Image_map },
+  { "remap", Image_remap },
+  { "threshold", Image_threshold },
+  { "blend", Image_blend },
   { "drawImage", Image_drawImage }, { "putImage", Image_drawImage }, // TODO putImage is deprecated
   { "drawSprite", Image_drawSprite }, { "putSprite", Image_drawSprite }, // TODO putSprite is deprecated
   { "pixels", Image_pixels },
@@ -773,6 +1229,179 @@ const Property Image_properties[] = {
   { "colorMode", Image_get_colorMode, nullptr },
   { "spec", Image_get_spec, nullptr },
   { "cel", Image_get_cel, nullptr },
+  { "byteView", Image_get_byteView, nullptr },
+  { nullptr, nullptr, nullptr }
+};
+
+int ImageBytes_gc(lua_State* L)
+{
+  get_obj<ImageBytesObj>(L, 1)->~ImageBytesObj();
+  return 0;
+}
+
+int ImageBytes_len(lua_State* L)
+{
+  auto obj = get_obj<ImageBytesObj>(L, 1);
+  obj->bytes(L);
+  lua_pushinteger(L, obj->size);
+  return 1;
+}
+
+// view:byte(i [, j]) returns the bytes from i to j (like string.byte())
+int ImageBytes_byte(lua_State* L)
+{
+  auto obj = get_obj<ImageBytesObj>(L, 1);
+  const uint8_t* bytes = obj->bytes(L);
+  const lua_Integer i = luaL_optinteger(L, 2, 1);
+  const lua_Integer j = luaL_optinteger(L, 3, i);
+  if (j < i)
+    return 0;
+
+  obj->checkRange(L, i, j-i+1);
+  const int n = int(j-i+1);
+  luaL_checkstack(L, n, "too many bytes");
+  for (int k=0; k<n; ++k)
+    lua_pushinteger(L, bytes[i-1+k]);
+  return n;
+}
+
+// view:setByte(i, byte1, byte2, ...) modifies the bytes starting
+// from i
+int ImageBytes_setByte(lua_State* L)
+{
+  auto obj = get_obj<ImageBytesObj>(L, 1);
+  uint8_t* bytes = obj->bytes(L);
+  const lua_Integer i = luaL_checkinteger(L, 2);
+  const int n = lua_gettop(L) - 2;
+  obj->checkRange(L, i, n);
+  for (int k=0; k<n; ++k)
+    bytes[i-1+k] = uint8_t(luaL_checkinteger(L, 3+k));
+
+  obj->notifyPixelsChange();
+  return 0;
+}
+
+// view:sub(i [, j]) returns a string with a copy of the bytes from i
+// to j (like string.sub(), but only positive indexes)
+int ImageBytes_sub(lua_State* L)
+{
+  auto obj = get_obj<ImageBytesObj>(L, 1);
+  const uint8_t* bytes = obj->bytes(L);
+  const lua_Integer i = luaL_optinteger(L, 2, 1);
+  const lua_Integer j = luaL_optinteger(L, 3, lua_Integer(obj->size));
+  if (j < i) {
+    lua_pushliteral(L, "");
+    return 1;
+  }
+
+  obj->checkRange(L, i, j-i+1);
+  lua_pushlstring(L, (const char*)bytes+i-1, size_t(j-i+1));
+  return 1;
+}
+
+// view:write(i, string) copies the given string starting from byte i
+int ImageBytes_write(lua_State* L)
+{
+  auto obj = get_obj<ImageBytesObj>(L, 1);
+  uint8_t* bytes = obj->bytes(L);
+  const lua_Integer i = luaL_checkinteger(L, 2);
+  size_t n;
+  const char* src = luaL_checklstring(L, 3, &n);
+  obj->checkRange(L, i, lua_Integer(n));
+  std::memcpy(bytes+i-1, src, n);
+
+  obj->notifyPixelsChange();
+  return 0;
+}
+
+// view:unpack(fmt [, pos]) works like string.unpack() reading only
+// the string.packsize(fmt) bytes needed from the buffer
+int ImageBytes_unpack(lua_State* L)
+{
+  auto obj = get_obj<ImageBytesObj>(L, 1);
+  const uint8_t* bytes = obj->bytes(L);
+  luaL_checkstring(L, 2);
+  const lua_Integer pos = luaL_optinteger(L, 3, 1);
+
+  lua_getglobal(L, "string");
+  lua_getfield(L, -1, "packsize");
+  lua_pushvalue(L, 2);
+  lua_call(L, 1, 1);
+  const lua_Integer n = lua_tointeger(L, -1);
+  lua_pop(L, 1);
+  obj->checkRange(L, pos, n);
+
+  const int base = lua_gettop(L);
+  lua_getfield(L, -1, "unpack");
+  lua_pushvalue(L, 2);
+  lua_pushlstring(L, (const char*)bytes+pos-1, size_t(n));
+  lua_call(L, 2, LUA_MULTRET);
+
+  // Convert the last returned value (next position) to a position
+  // in the whole buffer
+  const int nresults = lua_gettop(L) - base;
+  lua_pushinteger(L, pos + n);
+  lua_replace(L, -2);
+  return nresults;
+}
+
+// view:pack(pos, fmt, v1, v2, ...) works like string.pack() writing
+// the packed values starting from byte "pos", returns the next
+// position
+int ImageBytes_pack(lua_State* L)
+{
+  auto obj = get_obj<ImageBytesObj>(L, 1);
+  uint8_t* bytes = obj->bytes(L);
+  const lua_Integer pos = luaL_checkinteger(L, 2);
+  luaL_checkstring(L, 3);
+  const int nargs = lua_gettop(L) - 2;
+
+  lua_getglobal(L, "string");
+  lua_getfield(L, -1, "pack");
+  for (int k=0; k<nargs; ++k)
+    lua_pushvalue(L, 3+k);
+  lua_call(L, nargs, 1);
+
+  size_t n;
+  const char* src = lua_tolstring(L, -1, &n);
+  obj->checkRange(L, pos, lua_Integer(n));
+  std::memcpy(bytes+pos-1, src, n);
+
+  obj->notifyPixelsChange();
+  lua_pushinteger(L, pos + lua_Integer(n));
+  return 1;
+}
+
+int ImageBytes_get_rowStride(lua_State* L)
+{
+  const auto obj = get_obj<ImageBytesObj>(L, 1);
+  obj->bytes(L);                // Check that the view is valid
+  lua_pushinteger(L, obj->image()->rowBytes());
+  return 1;
+}
+
+int ImageBytes_get_isValid(lua_State* L)
+{
+  const auto obj = get_obj<ImageBytesObj>(L, 1);
+  lua_pushboolean(L, obj->image() != nullptr);
+  return 1;
+}
+
+const luaL_Reg ImageBytes_methods[] = {
+  { "byte", ImageBytes_byte },
+  { "setByte", ImageBytes_setByte },
+  { "sub", ImageBytes_sub },
+  { "write", ImageBytes_write },
+  { "unpack", ImageBytes_unpack },
+  { "pack", ImageBytes_pack },
+  { "__gc", ImageBytes_gc },
+  { "__len", ImageBytes_len },
+  { nullptr, nullptr }
+};
+
+const Property ImageBytes_properties[] = {
+  { "rowStride", ImageBytes_get_rowStride, nullptr },
+  { "isValid", ImageBytes_get_isValid, nullptr },
   { nullptr, nullptr, nullptr }
 };
 
@@ -780,6 +1409,7 @@ const Property Image_properties[] = {
 
 DEF_MTNAME(ImageObj);
 DEF_MTNAME_ALIAS(ImageObj, Image);
+DEF_MTNAME(ImageBytesObj);
 
 void register_image_class(lua_State* L)
 {
@@ -787,6 +1417,10 @@ void register_image_class(lua_State* L)
   REG_CLASS(L, Image);
   REG_CLASS_NEW(L, Image);
   REG_CLASS_PROPERTIES(L, Image);
+
+  using ImageBytes = ImageBytesObj;
+  REG_CLASS(L, ImageBytes);
+  REG_CLASS_PROPERTIES(L, ImageBytes);
 }
 
 void push_cel_image(lua_State* L, doc::Cel* cel)
@@ -801,6 +1435,9 @@ void push_image(lua_State* L, doc::Image* image)
 
 void push_tileset_image(lua_State* L, doc::Tileset* tileset, doc::tile_index ti)
 {
+  // Scripts can modify the tile image in-place
+  tileset->unshareTiles();
+
   doc::ImageRef image = tileset->get(ti);
   if (image)
     push_new<ImageObj>(L, tileset, ti, image.get());
@@ -832,5 +1469,15 @@ doc::Tileset* get_image_tileset_from_arg(lua_State* L, int index)
   return get_obj<ImageObj>(L, index)->tileset(L);
 }
 
+const uint8_t* may_get_image_bytes_from_arg(lua_State* L, int index, size_t& size)
+{
+  auto obj = may_get_obj<ImageBytesObj>(L, index);
+  if (!obj)
+    return nullptr;
+
+  size = obj->size;
+  return obj->bytes(L);
+}
+
 } // namespace script
 } // namespace app
@@ -11,7 +11,16 @@
 #include "app/script/luacpp.h"
 #include "app/script/values.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "json11.hpp"
 
@@ -99,6 +108,453 @@ JsonObj get_json_value(lua_State* L, int index)
   return JsonObj();
 }
 
+// Max nesting level of arrays/objects (the same limit as json11)
+const int kMaxDepth = 200;
+
+// Parses JSON text creating Lua values directly (without an
+// intermediate json11::Json DOM), used by json.decode(text, { table=true }).
+class TableDecoder {
+public:
+  TableDecoder(lua_State* L, const char* begin, const char* end)
+    : L(L), m_begin(begin), m_ptr(begin), m_end(end) { }
+
+  // Pushes the decoded value
+  void decode() {
+    parseValue(0);
+    skipSpaces();
+    if (m_ptr != m_end)
+      error("unexpected trailing character");
+  }
+
+private:
+  void error(const char* msg) {
+    luaL_error(L, "json parse error at offset %d: %s",
+               int(m_ptr - m_begin), msg);
+  }
+
+  void skipSpaces() {
+    while (m_ptr != m_end &&
+           (*m_ptr == ' ' || *m_ptr == '\t' ||
+            *m_ptr == '\n' || *m_ptr == '\r'))
+      ++m_ptr;
+  }
+
+  bool expect(const char* literal) {
+    const size_t n = std::strlen(literal);
+    if (size_t(m_end - m_ptr) < n ||
+        std::strncmp(m_ptr, literal, n) != 0)
+      return false;
+    m_ptr += n;
+    return true;
+  }
+
+  void parseValue(const int depth) {
+    if (depth > kMaxDepth)
+      error("exceeded maximum nesting depth");
+    luaL_checkstack(L, 3, "too many nested JSON values");
+
+    skipSpaces();
+    if (m_ptr == m_end)
+      error("unexpected end of input");
+
+    switch (*m_ptr) {
+      case '{': parseObject(depth); break;
+      case '[': parseArray(depth); break;
+      case '"': parseString(); break;
+      case 't':
+        if (!expect("true")) error("invalid literal");
+        lua_pushboolean(L, true);
+        break;
+      case 'f':
+        if (!expect("false")) error("invalid literal");
+        lua_pushboolean(L, false);
+        break;
+      case 'n':
+        if (!expect("null")) error("invalid literal");
+        lua_pushnil(L);
+        break;
+      default:
+        parseNumber();
+        break;
+    }
+  }
+
+  void parseObject(const int depth) {
+    ++m_ptr;                    // Skip '{'
+    lua_newtable(L);
+    skipSpaces();
+    if (m_ptr != m_end && *m_ptr == '}') {
+      ++m_ptr;
+      return;
+    }
+    while (true) {
+      skipSpaces();
+      if (m_ptr == m_end || *m_ptr != '"')
+        error("expected '\"' in object");
+      parseString();
+      skipSpaces();
+      if (m_ptr == m_end || *m_ptr != ':')
+        error("expected ':' in object");
+      ++m_ptr;
+      parseValue(depth+1);
+      lua_rawset(L, -3);
+
+      skipSpaces();
+      if (m_ptr == m_end)
+        error("unexpected end of input in object");
+      if (*m_ptr == '}') {
+        ++m_ptr;
+        return;
+      }
+      if (*m_ptr != ',')
+        error("expected ',' in object");
+      ++m_ptr;
+    }
+  }
+
+  void parseArray(const int depth) {
+    ++m_ptr;                    // Skip '['
+    lua_newtable(L);
+    skipSpaces();
+    if (m_ptr != m_end && *m_ptr == ']') {
+      ++m_ptr;
+      return;
+    }
+    for (lua_Integer i=1; ; ++i) {
+      parseValue(depth+1);
+      lua_rawseti(L, -2, i);
+
+      skipSpaces();
+      if (m_ptr == m_end)
+        error("unexpected end of input in array");
+      if (*m_ptr == ']') {
+        ++m_ptr;
+        return;
+      }
+      if (*m_ptr != ',')
+        error("expected ',' in array");
+      ++m_ptr;
+    }
+  }
+
+  void parseNumber() {
+    const char* start = m_ptr;
+    bool isInteger = true;
+    if (m_ptr != m_end && *m_ptr == '-')
+      ++m_ptr;
+    if (m_ptr == m_end || !std::isdigit(uint8_t(*m_ptr)))
+      error("invalid number");
+    while (m_ptr != m_end &&
+           (std::isdigit(uint8_t(*m_ptr)) ||
+            *m_ptr == '.' || *m_ptr == 'e' || *m_ptr == 'E' ||
+            *m_ptr == '+' || *m_ptr == '-')) {
+      if (!std::isdigit(uint8_t(*m_ptr)))
+        isInteger = false;
+      ++m_ptr;
+    }
+
+    // Copy the number to a null-terminated buffer (the input is not
+    // null-terminated)
+    char buf[64];
+    const size_t n = m_ptr - start;
+    if (n >= sizeof(buf))
+      isInteger = false;
+    std::string longNumber;
+    const char* str;
+    if (n < sizeof(buf)) {
+      std::copy(start, m_ptr, buf);
+      buf[n] = 0;
+      str = buf;
+    }
+    else {
+      longNumber.assign(start, n);
+      str = longNumber.c_str();
+    }
+
+    char* endptr;
+    if (isInteger) {
+      errno = 0;
+      const long long value = std::strtoll(str, &endptr, 10);
+      if (errno == 0 && *endptr == 0) {
+        lua_pushinteger(L, lua_Integer(value));
+        return;
+      }
+    }
+    const double value = std::strtod(str, &endptr);
+    if (*endptr != 0)
+      error("invalid number");
+    lua_pushnumber(L, value);
+  }
+
+  static void appendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+      out.push_back(char(cp));
+    }
+    else if (cp < 0x800) {
+      out.push_back(char(0xC0 | (cp >> 6)));
+      out.push_back(char(0x80 | (cp & 0x3F)));
+    }
+    else if (cp < 0x10000) {
+      out.push_back(char(0xE0 | (cp >> 12)));
+      out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+      out.push_back(char(0x80 | (cp & 0x3F)));
+    }
+    else {
+      out.push_back(char(0xF0 | (cp >> 18)));
+      out.push_back(char(0x80 | ((cp >> 12) & 0x3F)));
+      out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+      out.push_back(char(0x80 | (cp & 0x3F)));
+    }
+  }
+
+  uint32_t parseHex4() {
+    if (m_end - m_ptr < 4)
+      error("invalid \\u escape");
+    uint32_t cp = 0;
+    for (int i=0; i<4; ++i, ++m_ptr) {
+      const char c = *m_ptr;
+      cp <<= 4;
+      if (c >= '0' && c <= '9') cp |= c - '0';
+      else if (c >= 'a' && c <= 'f') cp |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F') cp |= c - 'A' + 10;
+      else error("invalid \\u escape");
+    }
+    return cp;
+  }
+
+  void parseString() {
+    ++m_ptr;                    // Skip '"'
+
+    // Fast path: strings without escape sequences are pushed directly
+    // from the input buffer
+    const char* start = m_ptr;
+    while (m_ptr != m_end && *m_ptr != '"' && *m_ptr != '\\')
+      ++m_ptr;
+    if (m_ptr == m_end)
+      error("unterminated string");
+    if (*m_ptr == '"') {
+      lua_pushlstring(L, start, m_ptr - start);
+      ++m_ptr;
+      return;
+    }
+
+    m_str.assign(start, m_ptr);
+    while (true) {
+      if (m_ptr == m_end)
+        error("unterminated string");
+
+      const char c = *(m_ptr++);
+      if (c == '"')
+        break;
+      if (c != '\\') {
+        m_str.push_back(c);
+        continue;
+      }
+      if (m_ptr == m_end)
+        error("unterminated string");
+      switch (*(m_ptr++)) {
+        case '"': m_str.push_back('"'); break;
+        case '\\': m_str.push_back('\\'); break;
+        case '/': m_str.push_back('/'); break;
+        case 'b': m_str.push_back('\b'); break;
+        case 'f': m_str.push_back('\f'); break;
+        case 'n': m_str.push_back('\n'); break;
+        case 'r': m_str.push_back('\r'); break;
+        case 't': m_str.push_back('\t'); break;
+        case 'u': {
+          uint32_t cp = parseHex4();
+          // Surrogate pair
+          if (cp >= 0xD800 && cp <= 0xDBFF &&
+              m_end - m_ptr >= 6 && m_ptr[0] == '\\' && m_ptr[1] == 'u') {
+            m_ptr += 2;
+            const uint32_t lo = parseHex4();
+            if (lo >= 0xDC00 && lo <= 0xDFFF)
+              cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+            else {
+              appendUtf8(m_str, cp);
+              cp = lo;
+            }
+          }
+          appendUtf8(m_str, cp);
+          break;
+        }
+        default:
+          error("invalid escape character");
+      }
+    }
+    lua_pushlstring(L, m_str.c_str(), m_str.size());
+  }
+
+  lua_State* L;
+  const char* m_begin;
+  const char* m_ptr;
+  const char* m_end;
+  std::string m_str;            // Buffer for strings with escape sequences
+};
+
+// Writes a Lua value as JSON text directly in a std::string (without
+// creating an intermediate json11::Json object). The output is the
+// same as json11::Json::dump() (object keys are sorted).
+class TableEncoder {
+public:
+  TableEncoder(lua_State* L) : L(L) { }
+
+  const std::string& encode(const int index) {
+    writeValue(lua_absindex(L, index), 0);
+    return m_out;
+  }
+
+private:
+  void writeValue(const int index, const int depth) {
+    switch (lua_type(L, index)) {
+
+      case LUA_TBOOLEAN:
+        m_out += (lua_toboolean(L, index) ? "true": "false");
+        break;
+
+      case LUA_TNUMBER:
+        writeNumber(lua_tonumber(L, index));
+        break;
+
+      case LUA_TSTRING: {
+        size_t len;
+        const char* str = lua_tolstring(L, index, &len);
+        writeString(str, len);
+        break;
+      }
+
+      case LUA_TTABLE:
+        if (depth > kMaxDepth)
+          luaL_error(L, "table too deep (or with cycles) to be encoded as JSON");
+        luaL_checkstack(L, 3, "too many nested tables");
+        if (is_array_table(L, index))
+          writeArray(index, depth);
+        else
+          writeObject(index, depth);
+        break;
+
+      case LUA_TUSERDATA:
+        if (auto obj = may_get_obj<JsonObj>(L, index)) {
+          obj->dump(m_out);
+          break;
+        }
+        // TODO convert rectangles, point, size, uuids?
+        [[fallthrough]];
+
+      default:
+        m_out += "null";
+        break;
+    }
+  }
+
+  void writeNumber(const double value) {
+    if (std::isfinite(value)) {
+      char buf[32];
+      std::snprintf(buf, sizeof(buf), "%.17g", value);
+      m_out += buf;
+    }
+    else
+      m_out += "null";
+  }
+
+  void writeString(const char* str, const size_t len) {
+    m_out.push_back('"');
+    for (size_t i=0; i<len; ++i) {
+      const char ch = str[i];
+      switch (ch) {
+        case '\\': m_out += "\\\\"; break;
+        case '"': m_out += "\\\""; break;
+        case '\b': m_out += "\\b"; break;
+        case '\f': m_out += "\\f"; break;
+        case '\n': m_out += "\\n"; break;
+        case '\r': m_out += "\\r"; break;
+        case '\t': m_out += "\\t"; break;
+        default:
+          if (uint8_t(ch) <= 0x1f) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", ch);
+            m_out += buf;
+          }
+          // U+2028 and U+2029 (like json11)
+          else if (uint8_t(ch) == 0xe2 && i+2 < len &&
+                   uint8_t(str[i+1]) == 0x80 &&
+                   (uint8_t(str[i+2]) == 0xa8 || uint8_t(str[i+2]) == 0xa9)) {
+            m_out += (uint8_t(str[i+2]) == 0xa8 ? "\\u2028": "\\u2029");
+            i += 2;
+          }
+          else
+            m_out.push_back(ch);
+          break;
+      }
+    }
+    m_out.push_back('"');
+  }
+
+  void writeArray(const int index, const int depth) {
+    const lua_Integer n = lua_rawlen(L, index);
+    m_out.push_back('[');
+    for (lua_Integer i=1; i<=n; ++i) {
+      if (i > 1)
+        m_out += ", ";
+      lua_rawgeti(L, index, i);
+      writeValue(lua_gettop(L), depth+1);
+      lua_pop(L, 1);
+    }
+    m_out.push_back(']');
+  }
+
+  void writeObject(const int index, const int depth) {
+    // Collect and sort the keys (json11::Json::object is a std::map)
+    std::vector<std::pair<std::string, int>> keys;
+    lua_pushnil(L);
+    while (lua_next(L, index) != 0) {
+      lua_pop(L, 1);            // Pop the value
+      const int keyType = lua_type(L, -1);
+      if (keyType == LUA_TSTRING || keyType == LUA_TNUMBER) {
+        // Convert a copy of the key (lua_tostring() on the key itself
+        // would break lua_next())
+        lua_pushvalue(L, -1);
+        size_t len;
+        const char* k = lua_tolstring(L, -1, &len);
+        keys.emplace_back(std::string(k, len), keyType);
+        lua_pop(L, 1);
+      }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end(),
+                           [](const auto& a, const auto& b){
+                             return a.first == b.first;
+                           }),
+               keys.end());
+
+    m_out.push_back('{');
+    bool first = true;
+    for (const auto& key : keys) {
+      if (key.second == LUA_TNUMBER) {
+        lua_pushlstring(L, key.first.c_str(), key.first.size());
+        if (!lua_stringtonumber(L, key.first.c_str()))
+          lua_pushnil(L);
+        lua_remove(L, -2);
+      }
+      else
+        lua_pushlstring(L, key.first.c_str(), key.first.size());
+      lua_rawget(L, index);
+
+      if (!first)
+        m_out += ", ";
+      first = false;
+      writeString(key.first.c_str(), key.first.size());
+      m_out += ": ";
+      writeValue(lua_gettop(L), depth+1);
+      lua_pop(L, 1);
+    }
+    m_out.push_back('}');
+  }
+
+  lua_State* L;
+  std::string m_out;
+};
+
 int JsonObj_gc(lua_State* L)
 {
   get_obj<JsonObj>(L, 1)->~JsonObj();
@@ -232,11 +688,27 @@ int JsonArrayIterator_gc(lua_State* L)
   return 0;
 }
 
+// json.decode(text [, { table=true }]) returns a JsonObj proxy to the
+// parsed data (the default), or Lua tables if table=true (faster to
+// iterate/access, and without a copy of the whole DOM in memory).
 int Json_decode(lua_State* L)
 {
-  if (const char* s = lua_tostring(L, 1)) {
+  size_t len;
+  if (const char* s = lua_tolstring(L, 1, &len)) {
+    bool asTable = false;
+    if (lua_istable(L, 2)) {
+      lua_getfield(L, 2, "table");
+      asTable = lua_toboolean(L, -1);
+      lua_pop(L, 1);
+    }
+    if (asTable) {
+      TableDecoder decoder(L, s, s+len);
+      decoder.decode();
+      return 1;
+    }
+
     std::string err;
-    auto json = json11::Json::parse(s, std::strlen(s), err);
+    auto json = json11::Json::parse(s, len, err);
     if (!err.empty())
       return luaL_error(L, err.c_str());
     push_obj(L, json);
@@ -254,7 +726,9 @@ int Json_encode(lua_State* L)
   }
   // Encode a Lua table
   else if (lua_istable(L, 1)) {
-    lua_pushstring(L, get_json_value(L, 1).dump().c_str());
+    TableEncoder encoder(L);
+    const std::string& out = encoder.encode(1);
+    lua_pushlstring(L, out.c_str(), out.size());
     return 1;
   }
   return 0;
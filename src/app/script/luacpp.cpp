@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2018  David Capello
 //
 // This program is distributed under the terms of
@@ -11,11 +11,150 @@
 
 #include "app/script/luacpp.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
 
 namespace app {
 namespace script {
 
+namespace {
+
+class LuaAllocator {
+public:
+  static constexpr size_t kAlign = 16;
+  static constexpr size_t kMaxSmallSize = 128;
+  static constexpr size_t kClasses = kMaxSmallSize / kAlign;
+  static constexpr size_t kChunkSize = 64*1024;
+
+  ~LuaAllocator() {
+    for (void* chunk : m_chunks)
+      std::free(chunk);
+  }
+
+  // lua_Alloc function
+  static void* alloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+    auto self = (LuaAllocator*)ud;
+
+    // When ptr is nullptr, osize is the type of the new object
+    if (!ptr)
+      osize = 0;
+
+    if (nsize == 0) {
+      if (ptr)
+        self->release(ptr, osize);
+      return nullptr;
+    }
+
+    if (ptr) {
+      // The block is big enough
+      if (osize <= kMaxSmallSize && nsize <= kMaxSmallSize &&
+          sizeClass(osize) == sizeClass(nsize))
+        return ptr;
+      if (osize > kMaxSmallSize && nsize > kMaxSmallSize)
+        return std::realloc(ptr, nsize);
+    }
+
+    void* newPtr = self->allocate(nsize);
+    if (newPtr && ptr) {
+      std::memcpy(newPtr, ptr, std::min(osize, nsize));
+      self->release(ptr, osize);
+    }
+    return newPtr;
+  }
+
+private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  static size_t sizeClass(size_t size) {
+    return (size + kAlign - 1) / kAlign - 1;
+  }
+
+  void* allocate(size_t size) {
+    if (size > kMaxSmallSize)
+      return std::malloc(size);
+
+    const size_t c = sizeClass(size);
+    if (!m_free[c] && !refill(c))
+      return nullptr;
+
+    FreeBlock* block = m_free[c];
+    m_free[c] = block->next;
+    return block;
+  }
+
+  void release(void* ptr, size_t size) {
+    if (size > kMaxSmallSize) {
+      std::free(ptr);
+      return;
+    }
+
+    const size_t c = sizeClass(size);
+    auto block = (FreeBlock*)ptr;
+    block->next = m_free[c];
+    m_free[c] = block;
+  }
+
+  // Splits a new chunk of memory in blocks of the given size class
+  bool refill(size_t c) {
+    const size_t blockSize = (c+1) * kAlign;
+    auto chunk = (uint8_t*)std::malloc(kChunkSize);
+    if (!chunk)
+      return false;
+
+    try {
+      m_chunks.push_back(chunk);
+    }
+    catch (const std::bad_alloc&) {
+      std::free(chunk);
+      return false;
+    }
+
+    for (size_t i=0; i+blockSize<=kChunkSize; i+=blockSize)
+      release(chunk+i, blockSize);
+    return true;
+  }
+
+  FreeBlock* m_free[kClasses] = { };
+  std::vector<void*> m_chunks;
+};
+
+int panic(lua_State* L)
+{
+  const char* msg = lua_tostring(L, -1);
+  std::fprintf(stderr,
+               "PANIC: unprotected error in call to Lua API (%s)\n",
+               msg ? msg: "error object is not a string");
+  return 0;
+}
+
+} // anonymous namespace
+
+lua_State* new_lua_state()
+{
+  auto allocator = new LuaAllocator;
+  lua_State* L = lua_newstate(&LuaAllocator::alloc, allocator);
+  if (L)
+    lua_atpanic(L, &panic);
+  else
+    delete allocator;
+  return L;
+}
+
+void close_lua_state(lua_State* L)
+{
+  void* allocator = nullptr;
+  lua_getallocf(L, &allocator);
+  lua_close(L);
+  delete (LuaAllocator*)allocator;
+}
+
 static const char mt_index_code[] =
   "__generic_mt_index = function(t, k) "
   "  local mt = getmetatable(t) "
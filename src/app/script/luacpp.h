@@ -54,6 +54,10 @@ template <typename T, typename... Args> T* push_new(lua_State* L, Args&&... args
   return addr;
 }
 
+// Value types that are trivially destructible (gfx::Point, gfx::Size,
+// gfx::Rect, app::Color) are registered without a __gc metamethod,
+// because userdata with finalizers need an extra GC cycle to be
+// collected.
 template <typename T> void push_obj(lua_State* L, const T& obj) {
   new (lua_newuserdata(L, sizeof(T))) T(obj);
   luaL_getmetatable(L, get_mtname<T>());
@@ -130,6 +134,14 @@ struct Property {
   lua_CFunction setter;
 };
 
+// Creates/closes a Lua state that uses free lists of fixed size
+// classes for small blocks (tables, strings, closures, and userdata
+// like Point/Size/Rectangle/Color), so scripts creating lots of
+// temporary objects reuse memory instead of calling malloc/free for
+// each one. The state must be used from one thread at a time.
+lua_State* new_lua_state();
+void close_lua_state(lua_State* L);
+
 void run_mt_index_code(lua_State* L);
 void create_mt_getters_setters(lua_State* L,
                                const char* tname,
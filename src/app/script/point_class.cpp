@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2017-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -65,12 +65,6 @@ int Point_new(lua_State* L)
   return 1;
 }
 
-int Point_gc(lua_State* L)
-{
-  get_obj<gfx::Point>(L, 1)->~PointT();
-  return 0;
-}
-
 int Point_eq(lua_State* L)
 {
   const auto a = get_obj<gfx::Point>(L, 1);
@@ -189,8 +183,10 @@ int Point_set_y(lua_State* L)
   return 0;
 }
 
+// Without __gc metamethod (see push_obj())
+static_assert(std::is_trivially_destructible_v<gfx::Point>);
+
 const luaL_Reg Point_methods[] = {
-  { "__gc", Point_gc },
   { "__eq", Point_eq },
   { "__tostring", Point_tostring },
   { "__unm", Point_unm },
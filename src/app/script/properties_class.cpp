@@ -82,7 +82,11 @@ struct Properties {
 
 };
 
-using PropertiesIterator = doc::UserData::Properties::iterator;
+// Index of the next property to iterate in pairs() (an index instead
+// of an iterator so it's safe to modify the properties in the loop)
+struct PropertiesIterator {
+  size_t index = 0;
+};
 
 int Properties_len(lua_State* L)
 {
@@ -191,11 +195,12 @@ int Properties_pairs_next(lua_State* L)
   auto propObj = get_obj<Properties>(L, 1);
   auto& properties = propObj->properties(L);
   auto& it = *get_obj<PropertiesIterator>(L, lua_upvalueindex(1));
-  if (it == properties.end())
+  if (it.index >= properties.size())
     return 0;
-  lua_pushstring(L, (*it).first.c_str());
-  push_value_to_lua(L, (*it).second);
-  ++it;
+  const auto& kv = *(properties.begin() + it.index);
+  lua_pushstring(L, kv.first.c_str());
+  push_value_to_lua(L, kv.second);
+  ++it.index;
   return 2;
 }
 
@@ -206,9 +211,7 @@ int Properties_pairs(lua_State* L)
   if (!obj)
     return luaL_error(L, "the object with these properties was destroyed");
 
-  auto& properties = propObj->properties(L);
-
-  push_obj(L, properties.begin());
+  push_obj(L, PropertiesIterator());
   lua_pushcclosure(L, Properties_pairs_next, 1);
   lua_pushvalue(L, 1); // Copy the same propObj as the second return value
   return 2;
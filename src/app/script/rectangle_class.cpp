@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2017-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -84,12 +84,6 @@ int Rectangle_new(lua_State* L)
   return 1;
 }
 
-int Rectangle_gc(lua_State* L)
-{
-  get_obj<gfx::Rect>(L, 1)->~RectT();
-  return 0;
-}
-
 int Rectangle_eq(lua_State* L)
 {
   const auto a = get_obj<gfx::Rect>(L, 1);
@@ -235,8 +229,10 @@ int Rectangle_get_isEmpty(lua_State* L)
   return 1;
 }
 
+// Without __gc metamethod (see push_obj())
+static_assert(std::is_trivially_destructible_v<gfx::Rect>);
+
 const luaL_Reg Rectangle_methods[] = {
-  { "__gc", Rectangle_gc },
   { "__eq", Rectangle_eq },
   { "__tostring", Rectangle_tostring },
   { "__band", Rectangle_intersect },
@@ -11,6 +11,7 @@
 #include "app/script/require.h"
 
 #include "app/extensions.h"
+#include "app/script/engine.h"
 
 #include <cstring>
 
@@ -30,8 +31,38 @@ static void eval_code(lua_State* L, const char* code)
   }
 }
 
+// Replacement of the Lua searcher (package.searchers[2]) to load Lua
+// modules using the bytecode cache.
+static int lua_file_searcher(lua_State* L)
+{
+  const char* name = luaL_checkstring(L, 1);
+
+  lua_getglobal(L, "package");
+  lua_getfield(L, -1, "searchpath");
+  lua_pushvalue(L, 1);
+  lua_getfield(L, -3, "path");
+  lua_call(L, 2, 2);
+  if (lua_isnil(L, -2))
+    return 1;                   // Error message from searchpath()
+
+  lua_pop(L, 1);
+  const std::string filename = lua_tostring(L, -1);
+  if (load_script_file(L, filename) != LUA_OK) {
+    return luaL_error(L, "error loading module '%s' from file '%s':\n\t%s",
+                      name, filename.c_str(), lua_tostring(L, -1));
+  }
+  lua_pushstring(L, filename.c_str());
+  return 2;                     // Loader function + file name
+}
+
 void custom_require_function(lua_State* L)
 {
+  lua_getglobal(L, "package");
+  lua_getfield(L, -1, "searchers");
+  lua_pushcfunction(L, lua_file_searcher);
+  lua_rawseti(L, -2, 2);
+  lua_pop(L, 2);
+
   eval_code(L, R"(
 _PACKAGE_PATH_STACK = {}
 
@@ -10,15 +10,27 @@
 
 #include "app/app.h"
 #include "app/console.h"
+#include "app/context.h"
+#include "app/script/docobj.h"
 #include "app/script/engine.h"
 #include "app/script/luacpp.h"
 #include "app/script/security.h"
+#include "app/site.h"
+#include "doc/algorithm/shrink_bounds.h"
+#include "doc/image.h"
+#include "doc/image_ref.h"
+#include "doc/primitives.h"
+#include "doc/sprite.h"
+#include "render/render.h"
 #include "ui/timer.h"
 #include "ui/manager.h"
 #include "ui/system.h"
 
 #include <ixwebsocket/IXNetSystem.h>
 #include <ixwebsocket/IXWebSocket.h>
+#include <algorithm>
+#include <map>
+#include <memory>
 #include <sstream>
 #include <set>
 
@@ -33,8 +45,185 @@ namespace {
 static std::unique_ptr<ui::Timer> g_timer;
 static std::set<ix::WebSocket*> g_connections;
 
+// Live preview of a sprite sent through a WebSocket. Each message
+// contains the pixels of the region that changed since the last
+// message (the whole sprite in the first one), with this format
+// (little-endian):
+//
+//   char[4]  "ASPV"
+//   uint8    version (1)
+//   uint8    flags (1 = keyframe, the region is the whole sprite)
+//   uint16   reserved (0)
+//   uint32   sequence number of the message
+//   uint16   frame number (0-based)
+//   uint16   sprite width
+//   uint16   sprite height
+//   uint16   region x, y, width, height
+//   ...      RLE encoded RGBA pixels of the region, row by row: a
+//            byte n, if n & 0x80 the next RGBA pixel is repeated
+//            (n & 0x7f)+1 times, in other case n+1 RGBA pixels
+//            follow.
+class PreviewStream {
+public:
+  PreviewStream(ix::WebSocket* ws) : m_ws(ws) { }
+
+  void reset() {
+    m_last.reset();
+  }
+
+  // Renders the given frame and sends the changed region. Returns
+  // false if nothing was sent (no changes or not connected).
+  bool sendFrame(const doc::Sprite* sprite, const doc::frame_t frame) {
+    if (m_ws->getReadyState() != ix::ReadyState::Open)
+      return false;
+
+    doc::ImageRef image(
+      doc::Image::create(doc::IMAGE_RGB, sprite->width(), sprite->height()));
+    doc::clear_image(image.get(), 0);
+
+    render::Render render;
+    render.setNewBlend(true);
+    render.renderSprite(image.get(), sprite, frame);
+
+    gfx::Rect rc = image->bounds();
+    const bool keyframe = (!m_last ||
+                           m_last->size() != image->size() ||
+                           m_lastFrame != frame);
+    if (!keyframe &&
+        !doc::algorithm::shrink_bounds2(m_last.get(), image.get(),
+                                        image->bounds(), rc)) {
+      return false;             // No changes
+    }
+
+    m_data.clear();
+    m_data.append("ASPV", 4);
+    write8(1);
+    write8(keyframe ? 1: 0);
+    write16(0);
+    write32(++m_seq);
+    write16(frame);
+    write16(sprite->width());
+    write16(sprite->height());
+    write16(rc.x);
+    write16(rc.y);
+    write16(rc.w);
+    write16(rc.h);
+    encodeRle(image.get(), rc);
+
+    m_last = image;
+    m_lastFrame = frame;
+    return m_ws->sendBinary(m_data).success;
+  }
+
+  // Starts sending the frame that is being edited of the given
+  // sprite "fps" times per second (only when it changes).
+  void start(const doc::Sprite* sprite, const int fps) {
+    m_spriteId = sprite->id();
+    m_timer = std::make_unique<ui::Timer>(std::max(1, 1000 / fps),
+                                          ui::Manager::getDefault());
+    m_timer->Tick.connect([this]{ onTick(); });
+    m_timer->start();
+  }
+
+  void stop() {
+    m_timer.reset();
+    m_spriteId = doc::NullId;
+  }
+
+private:
+  void onTick() {
+    auto sprite = doc::get<doc::Sprite>(m_spriteId);
+    if (!sprite) {
+      stop();
+      return;
+    }
+
+    doc::frame_t frame = 0;
+    const Site site = App::instance()->context()->activeSite();
+    if (site.sprite() == sprite)
+      frame = site.frame();
+
+    try {
+      sendFrame(sprite, frame);
+    }
+    catch (const std::exception& ex) {
+      Console::showException(ex);
+      stop();
+    }
+  }
+
+  void write8(const int value) {
+    m_data.push_back(char(value));
+  }
+
+  void write16(const int value) {
+    write8(value & 0xff);
+    write8((value >> 8) & 0xff);
+  }
+
+  void write32(const uint32_t value) {
+    write16(value & 0xffff);
+    write16((value >> 16) & 0xffff);
+  }
+
+  void writePixel(const doc::color_t c) {
+    write8(doc::rgba_getr(c));
+    write8(doc::rgba_getg(c));
+    write8(doc::rgba_getb(c));
+    write8(doc::rgba_geta(c));
+  }
+
+  void encodeRle(const doc::Image* image, const gfx::Rect& rc) {
+    for (int y=rc.y; y<rc.y2(); ++y) {
+      auto row = (const doc::color_t*)image->getPixelAddress(rc.x, y);
+      int x = 0;
+      while (x < rc.w) {
+        // Run of equal pixels
+        int n = 1;
+        while (x+n < rc.w && n < 128 && row[x+n] == row[x])
+          ++n;
+        if (n > 1) {
+          write8(0x80 | (n-1));
+          writePixel(row[x]);
+          x += n;
+          continue;
+        }
+
+        // Literal pixels until the next run
+        n = 1;
+        while (x+n < rc.w && n < 128 &&
+               !(x+n+1 < rc.w && row[x+n] == row[x+n+1]))
+          ++n;
+        write8(n-1);
+        for (int i=0; i<n; ++i)
+          writePixel(row[x+i]);
+        x += n;
+      }
+    }
+  }
+
+  ix::WebSocket* m_ws;
+  doc::ImageRef m_last;         // Last sent frame
+  doc::frame_t m_lastFrame = 0;
+  uint32_t m_seq = 0;
+  std::string m_data;           // Reused buffer for each message
+  doc::ObjectId m_spriteId = doc::NullId;
+  std::unique_ptr<ui::Timer> m_timer;
+};
+
+static std::map<ix::WebSocket*, std::unique_ptr<PreviewStream>> g_previews;
+
+static PreviewStream* get_preview_stream(ix::WebSocket* ws)
+{
+  auto& preview = g_previews[ws];
+  if (!preview)
+    preview = std::make_unique<PreviewStream>(ws);
+  return preview.get();
+}
+
 static void close_ws(ix::WebSocket* ws)
 {
+  g_previews.erase(ws);
   ws->stop();
 
   g_connections.erase(ws);
@@ -160,7 +349,10 @@ int WebSocket_sendBinary(lua_State* L)
 
   for (int i = 2; i <= argc; i++) {
     size_t bufLen;
-    const char* buf = lua_tolstring(L, i, &bufLen);
+    // Image.byteView can be sent directly without a Lua string copy
+    const char* buf = (const char*)may_get_image_bytes_from_arg(L, i, bufLen);
+    if (!buf)
+      buf = lua_tolstring(L, i, &bufLen);
     data.write(buf, bufLen);
   }
 
@@ -211,6 +403,58 @@ int WebSocket_close(lua_State* L)
   return 0;
 }
 
+// ws:sendFrame(sprite [, frameNumber [, keyframe]]) renders the
+// sprite frame and sends the region that changed since the last
+// sendFrame() (see PreviewStream). Returns true if a message was
+// sent.
+int WebSocket_sendFrame(lua_State* L)
+{
+  auto ws = get_ptr<ix::WebSocket>(L, 1);
+  auto sprite = get_docobj<doc::Sprite>(L, 2);
+  const doc::frame_t frame = get_frame_number_from_arg(L, 3);
+  if (frame < 0 || frame >= sprite->totalFrames())
+    return luaL_error(L, "invalid frame number %d", frame+1);
+
+  PreviewStream* preview = get_preview_stream(ws);
+  if (lua_toboolean(L, 4))
+    preview->reset();
+  lua_pushboolean(L, preview->sendFrame(sprite, frame));
+  return 1;
+}
+
+// ws:startStream{ sprite=sprite, fps=30 } sends the edited frame of
+// the sprite automatically when it changes (GUI only).
+int WebSocket_startStream(lua_State* L)
+{
+  auto ws = get_ptr<ix::WebSocket>(L, 1);
+  if (!App::instance()->isGui())
+    return luaL_error(L, "WebSocket:startStream() can be used only in GUI mode");
+
+  luaL_checktype(L, 2, LUA_TTABLE);
+  lua_getfield(L, 2, "sprite");
+  auto sprite = get_docobj<doc::Sprite>(L, -1);
+  lua_pop(L, 1);
+
+  int fps = 30;
+  if (lua_getfield(L, 2, "fps") != LUA_TNIL)
+    fps = std::clamp(int(lua_tointeger(L, -1)), 1, 1000);
+  lua_pop(L, 1);
+
+  PreviewStream* preview = get_preview_stream(ws);
+  preview->reset();
+  preview->start(sprite, fps);
+  return 0;
+}
+
+int WebSocket_stopStream(lua_State* L)
+{
+  auto ws = get_ptr<ix::WebSocket>(L, 1);
+  auto it = g_previews.find(ws);
+  if (it != g_previews.end())
+    it->second->stop();
+  return 0;
+}
+
 int WebSocket_get_url(lua_State* L)
 {
   auto ws = get_ptr<ix::WebSocket>(L, 1);
@@ -225,6 +469,9 @@ const luaL_Reg WebSocket_methods[] = {
   { "sendText", WebSocket_sendText },
   { "sendBinary", WebSocket_sendBinary },
   { "sendPing", WebSocket_sendPing },
+  { "sendFrame", WebSocket_sendFrame },
+  { "startStream", WebSocket_startStream },
+  { "stopStream", WebSocket_stopStream },
   { nullptr, nullptr }
 };
 
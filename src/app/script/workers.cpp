@@ -0,0 +1,298 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/script/workers.h"
+
+#include "app/script/engine.h"
+#include "app/script/luacpp.h"
+#include "app/script/security.h"
+#include "doc/color_mode.h"
+#include "doc/image.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace app {
+namespace script {
+
+void register_app_pixel_color_object(lua_State* L);
+void register_app_fs_object(lua_State* L);
+void register_json_object(lua_State* L);
+void register_image_class(lua_State* L);
+void register_image_iterator_class(lua_State* L);
+void register_image_spec_class(lua_State* L);
+void register_point_class(lua_State* L);
+void register_rect_class(lua_State* L);
+void register_size_class(lua_State* L);
+
+namespace {
+
+// Max depth of tables copied between Lua states (to avoid infinite
+// recursion with cycles).
+const int kMaxTableDepth = 64;
+
+// A Lua value copied from one lua_State to be pushed in another one.
+struct Value {
+  int type = LUA_TNIL;
+  bool boolean = false;
+  bool isInteger = false;
+  lua_Integer integer = 0;
+  lua_Number number = 0.0;
+  std::string string;
+  std::vector<std::pair<Value, Value>> table;
+  std::unique_ptr<doc::Image> image;
+};
+
+void read_value(lua_State* L, int index, Value& value, int depth = 0)
+{
+  index = lua_absindex(L, index);
+  value.type = lua_type(L, index);
+  switch (value.type) {
+    case LUA_TNONE:
+    case LUA_TNIL:
+      value.type = LUA_TNIL;
+      break;
+    case LUA_TBOOLEAN:
+      value.boolean = lua_toboolean(L, index);
+      break;
+    case LUA_TNUMBER:
+      value.isInteger = lua_isinteger(L, index);
+      if (value.isInteger)
+        value.integer = lua_tointeger(L, index);
+      else
+        value.number = lua_tonumber(L, index);
+      break;
+    case LUA_TSTRING: {
+      size_t len;
+      const char* s = lua_tolstring(L, index, &len);
+      value.string.assign(s, len);
+      break;
+    }
+    case LUA_TTABLE:
+      if (depth >= kMaxTableDepth)
+        luaL_error(L, "table too deep (or with cycles) to be copied to/from a worker");
+
+      lua_pushnil(L);
+      while (lua_next(L, index) != 0) {
+        value.table.emplace_back();
+        read_value(L, -2, value.table.back().first, depth+1);
+        read_value(L, -1, value.table.back().second, depth+1);
+        lua_pop(L, 1);
+      }
+      break;
+    case LUA_TUSERDATA:
+      if (doc::Image* image = may_get_image_from_arg(L, index)) {
+        value.image.reset(doc::Image::createCopy(image));
+        break;
+      }
+      [[fallthrough]];
+    default:
+      luaL_error(L, "a value of type '%s' cannot be copied to/from a worker (only nil, booleans, numbers, strings, tables, and images)",
+                 luaL_typename(L, index));
+      break;
+  }
+}
+
+// Pushes the value (and moves the images to the lua_State).
+void push_value(lua_State* L, Value& value)
+{
+  switch (value.type) {
+    case LUA_TNIL:
+      lua_pushnil(L);
+      break;
+    case LUA_TBOOLEAN:
+      lua_pushboolean(L, value.boolean);
+      break;
+    case LUA_TNUMBER:
+      if (value.isInteger)
+        lua_pushinteger(L, value.integer);
+      else
+        lua_pushnumber(L, value.number);
+      break;
+    case LUA_TSTRING:
+      lua_pushlstring(L, value.string.c_str(), value.string.size());
+      break;
+    case LUA_TTABLE:
+      lua_createtable(L, 0, int(value.table.size()));
+      for (auto& kv : value.table) {
+        push_value(L, kv.first);
+        push_value(L, kv.second);
+        lua_rawset(L, -3);
+      }
+      break;
+    case LUA_TUSERDATA:
+      // The Image userdata takes the ownership of the image
+      push_image(L, value.image.release());
+      break;
+  }
+}
+
+struct Task {
+  Value arg;
+  Value result;
+  std::string error;
+  bool failed = false;
+};
+
+int append_to_string(lua_State* L, const void* p, size_t size, void* ud)
+{
+  static_cast<std::string*>(ud)->append((const char*)p, size);
+  return 0;
+}
+
+// Calls the function (1st argument) with the task (2nd argument)
+// argument and saves its result. Executed with lua_pcall() so any
+// error (even copying values) is handled.
+int run_task(lua_State* L)
+{
+  auto task = (Task*)lua_touserdata(L, 2);
+  lua_pushvalue(L, 1);
+  push_value(L, task->arg);
+  lua_call(L, 1, 1);
+  read_value(L, -1, task->result);
+  return 0;
+}
+
+lua_State* create_worker_state()
+{
+  lua_State* L = new_lua_state();
+  luaL_openlibs(L);
+  overwrite_unsecure_functions(L);
+  run_mt_index_code(L);
+
+  // Reduced "app" object (only functions that don't need the app
+  // context)
+  lua_newtable(L);
+  lua_setglobal(L, "app");
+  register_app_pixel_color_object(L);
+  register_app_fs_object(L);
+  register_json_object(L);
+
+  register_image_class(L);
+  register_image_iterator_class(L);
+  register_image_spec_class(L);
+  register_point_class(L);
+  register_rect_class(L);
+  register_size_class(L);
+
+  // Image methods that need the app context/active site
+  luaL_getmetatable(L, "ImageObj");
+  for (const char* name : { "saveAs", "resize", "drawSprite", "putSprite" }) {
+    lua_pushnil(L);
+    lua_setfield(L, -2, name);
+  }
+  lua_pop(L, 1);
+
+  lua_newtable(L);
+  lua_pushvalue(L, -1);
+  lua_setglobal(L, "ColorMode");
+  setfield_integer(L, "RGB", doc::ColorMode::RGB);
+  setfield_integer(L, "GRAY", doc::ColorMode::GRAYSCALE);
+  setfield_integer(L, "GRAYSCALE", doc::ColorMode::GRAYSCALE);
+  setfield_integer(L, "INDEXED", doc::ColorMode::INDEXED);
+  lua_pop(L, 1);
+  return L;
+}
+
+} // anonymous namespace
+
+int run_parallel(lua_State* L, int funcIndex, int argsIndex, int nthreads)
+{
+  funcIndex = lua_absindex(L, funcIndex);
+  argsIndex = lua_absindex(L, argsIndex);
+  luaL_checktype(L, funcIndex, LUA_TFUNCTION);
+  luaL_checktype(L, argsIndex, LUA_TTABLE);
+
+  if (lua_iscfunction(L, funcIndex))
+    return luaL_error(L, "a Lua function is expected");
+
+  // Only the _ENV upvalue (globals) can be used, it will be the
+  // globals table of each worker.
+  for (int i=1; const char* name = lua_getupvalue(L, funcIndex, i); ++i) {
+    lua_pop(L, 1);
+    if (std::strcmp(name, "_ENV") != 0)
+      return luaL_error(L, "the function cannot use local variables from outside its body ('%s'), use arguments", name);
+  }
+
+  std::string bytecode;
+  lua_pushvalue(L, funcIndex);
+  lua_dump(L, append_to_string, &bytecode, 0);
+  lua_pop(L, 1);
+
+  const lua_Integer n = luaL_len(L, argsIndex);
+  std::vector<Task> tasks(n);
+  for (lua_Integer i=0; i<n; ++i) {
+    lua_geti(L, argsIndex, i+1);
+    read_value(L, -1, tasks[i].arg);
+    lua_pop(L, 1);
+  }
+
+  if (nthreads <= 0)
+    nthreads = std::max<int>(1, std::thread::hardware_concurrency());
+  nthreads = std::clamp<int>(nthreads, 1, std::max<int>(1, int(n)));
+
+  std::atomic<size_t> next(0);
+  auto worker = [&tasks, &next, &bytecode]{
+    lua_State* W = create_worker_state();
+    if (luaL_loadbufferx(W, bytecode.c_str(), bytecode.size(), "=worker", "b") != LUA_OK) {
+      const char* msg = lua_tostring(W, -1);
+      for (size_t i; (i = next++) < tasks.size(); ) {
+        tasks[i].error = (msg ? msg: "cannot load function");
+        tasks[i].failed = true;
+      }
+    }
+    else {
+      for (size_t i; (i = next++) < tasks.size(); ) {
+        Task& task = tasks[i];
+        lua_pushcfunction(W, run_task);
+        lua_pushvalue(W, 1);
+        lua_pushlightuserdata(W, &task);
+        if (lua_pcall(W, 2, 0, 0) != LUA_OK) {
+          const char* msg = lua_tostring(W, -1);
+          task.error = (msg ? msg: "unknown error");
+          task.failed = true;
+        }
+        lua_settop(W, 1);
+      }
+    }
+    close_lua_state(W);
+  };
+
+  {
+    std::vector<std::thread> threads;
+    for (int i=1; i<nthreads; ++i)
+      threads.emplace_back(worker);
+    worker();                   // Use this thread too
+    for (auto& thread : threads)
+      thread.join();
+  }
+
+  for (lua_Integer i=0; i<n; ++i) {
+    if (tasks[i].failed)
+      return luaL_error(L, "error in worker (item %d): %s",
+                        int(i+1), tasks[i].error.c_str());
+  }
+
+  lua_createtable(L, int(n), 0);
+  for (lua_Integer i=0; i<n; ++i) {
+    push_value(L, tasks[i].result);
+    lua_seti(L, -2, i+1);
+  }
+  return 1;
+}
+
+} // namespace script
+} // namespace app
@@ -0,0 +1,30 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_SCRIPT_WORKERS_H_INCLUDED
+#define APP_SCRIPT_WORKERS_H_INCLUDED
+#pragma once
+
+struct lua_State;
+
+namespace app {
+namespace script {
+
+  // Calls the Lua function in "funcIndex" for each element of the
+  // array in "argsIndex" using "nthreads" worker threads (or one
+  // thread per core if it's 0). Each worker thread has its own
+  // lua_State with a reduced API (no app context, sprites, or UI),
+  // and arguments/results are copied between states (images are
+  // copied as snapshots). Pushes the array of results.
+  //
+  // The function cannot have upvalues (only globals), as it's
+  // transferred to the workers with lua_dump().
+  int run_parallel(lua_State* L, int funcIndex, int argsIndex, int nthreads);
+
+} // namespace script
+} // namespace app
+
+#endif
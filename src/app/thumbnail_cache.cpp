@@ -0,0 +1,314 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/thumbnail_cache.h"
+
+#include "base/fs.h"
+#include "base/fstream_path.h"
+#include "base/serialization.h"
+#include "base/time.h"
+#include "doc/image.h"
+#include "doc/image_io.h"
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+namespace app {
+
+using namespace base::serialization;
+using namespace base::serialization::little_endian;
+
+namespace {
+
+const uint32_t kEntryMagic = 0x43485441; // "ATHC"
+const int kEntryVersion = 1;
+const char* kIndexFilename = "index.txt";
+const char* kEntryExtension = "thumb";
+
+// Information of the original file saved in each entry to know if
+// the thumbnail is still valid.
+struct EntryKey {
+  std::string filename;
+  gfx::Size thumbnailSize;
+  base::Time mtime;
+  uint64_t fileSize = 0;
+
+  EntryKey() { }
+  EntryKey(const std::string& filename,
+           const gfx::Size& thumbnailSize)
+    : filename(filename)
+    , thumbnailSize(thumbnailSize)
+    , mtime(base::get_modification_time(filename))
+    , fileSize(base::file_size(filename)) {
+  }
+
+  bool operator==(const EntryKey& o) const {
+    return (filename == o.filename &&
+            thumbnailSize == o.thumbnailSize &&
+            mtime.year == o.mtime.year &&
+            mtime.month == o.mtime.month &&
+            mtime.day == o.mtime.day &&
+            mtime.hour == o.mtime.hour &&
+            mtime.minute == o.mtime.minute &&
+            mtime.second == o.mtime.second &&
+            fileSize == o.fileSize);
+  }
+};
+
+void write_entry_key(std::ostream& os, const EntryKey& key)
+{
+  write32(os, kEntryMagic);
+  write8(os, kEntryVersion);
+  write16(os, key.thumbnailSize.w);
+  write16(os, key.thumbnailSize.h);
+  write16(os, key.mtime.year);
+  write8(os, key.mtime.month);
+  write8(os, key.mtime.day);
+  write8(os, key.mtime.hour);
+  write8(os, key.mtime.minute);
+  write8(os, key.mtime.second);
+  write32(os, uint32_t(key.fileSize));
+  write32(os, uint32_t(key.fileSize >> 32));
+  write16(os, key.filename.size());
+  os.write(key.filename.c_str(), key.filename.size());
+}
+
+bool read_entry_key(std::istream& is, EntryKey& key)
+{
+  if (read32(is) != kEntryMagic ||
+      read8(is) != kEntryVersion)
+    return false;
+
+  key.thumbnailSize.w = read16(is);
+  key.thumbnailSize.h = read16(is);
+  key.mtime.year = read16(is);
+  key.mtime.month = read8(is);
+  key.mtime.day = read8(is);
+  key.mtime.hour = read8(is);
+  key.mtime.minute = read8(is);
+  key.mtime.second = read8(is);
+  key.fileSize = read32(is);
+  key.fileSize |= uint64_t(read32(is)) << 32;
+  key.filename.resize(read16(is));
+  is.read(&key.filename[0], key.filename.size());
+  return bool(is);
+}
+
+} // anonymous namespace
+
+ThumbnailCache::ThumbnailCache(const std::string& dir,
+                               const size_t maxBytes)
+  : m_dir(dir)
+  , m_maxBytes(maxBytes)
+{
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+  const std::lock_guard lock(m_mutex);
+  saveIndex();
+}
+
+doc::ImageRef ThumbnailCache::get(const std::string& filename,
+                                  const gfx::Size& thumbnailSize)
+{
+  const std::string name = entryName(filename, thumbnailSize);
+  {
+    const std::lock_guard lock(m_mutex);
+    loadIndex();
+    if (m_entries.find(name) == m_entries.end())
+      return nullptr;
+  }
+
+  doc::ImageRef image;
+  try {
+    std::ifstream s(FSTREAM_PATH(base::join_path(m_dir, name)),
+                    std::ifstream::binary);
+    EntryKey key;
+    if (s &&
+        read_entry_key(s, key) &&
+        key == EntryKey(filename, thumbnailSize)) {
+      image.reset(doc::read_image(s, false));
+      if (image && image->pixelFormat() != doc::IMAGE_RGB)
+        image.reset();
+    }
+  }
+  catch (const std::exception&) {
+    image.reset();
+  }
+
+  const std::lock_guard lock(m_mutex);
+  if (image) {
+    auto it = m_entries.find(name);
+    if (it != m_entries.end()) {
+      it->second.lastUse = ++m_useCounter;
+      m_modified = true;
+    }
+  }
+  // The file was modified (or the entry is broken)
+  else
+    removeEntry(name);
+  return image;
+}
+
+void ThumbnailCache::put(const std::string& filename,
+                         const gfx::Size& thumbnailSize,
+                         const doc::Image* thumbnail)
+{
+  ASSERT(thumbnail->pixelFormat() == doc::IMAGE_RGB);
+
+  const std::string name = entryName(filename, thumbnailSize);
+  const std::string fn = base::join_path(m_dir, name);
+  size_t bytes = 0;
+  try {
+    if (!base::is_directory(m_dir))
+      base::make_all_directories(m_dir);
+    {
+      std::ofstream s(FSTREAM_PATH(fn), std::ofstream::binary);
+      write_entry_key(s, EntryKey(filename, thumbnailSize));
+      if (!doc::write_image(s, thumbnail) || !s)
+        return;
+    }
+    bytes = base::file_size(fn);
+  }
+  catch (const std::exception&) {
+    return;
+  }
+
+  const std::lock_guard lock(m_mutex);
+  loadIndex();
+
+  Entry& entry = m_entries[name];
+  m_totalBytes -= entry.bytes;
+  entry.bytes = bytes;
+  entry.lastUse = ++m_useCounter;
+  m_totalBytes += bytes;
+  m_modified = true;
+
+  shrink();
+}
+
+std::string ThumbnailCache::entryName(const std::string& filename,
+                                      const gfx::Size& thumbnailSize) const
+{
+  // FNV-1a hash of the file name and the thumbnail size (it must
+  // give the same name in each session/platform)
+  const std::string key =
+    fmt::format("{}|{}x{}", filename, thumbnailSize.w, thumbnailSize.h);
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (const char chr : key) {
+    hash ^= uint8_t(chr);
+    hash *= 0x100000001b3ull;
+  }
+  return fmt::format("{:016x}.{}", hash, kEntryExtension);
+}
+
+void ThumbnailCache::loadIndex()
+{
+  if (m_indexLoaded)
+    return;
+  m_indexLoaded = true;
+
+  // Last use of each entry
+  std::map<std::string, uint64_t> lastUse;
+  {
+    std::ifstream s(FSTREAM_PATH(base::join_path(m_dir, kIndexFilename)));
+    std::string name;
+    uint64_t use;
+    while (s >> name >> use) {
+      lastUse[name] = use;
+      m_useCounter = std::max(m_useCounter, use);
+    }
+  }
+
+  // Entries that are not in the index (e.g. the index wasn't saved
+  // because the program crashed) are the first ones to be deleted.
+  if (base::is_directory(m_dir)) {
+    for (const auto& name : base::list_files(m_dir)) {
+      if (base::get_file_extension(name) != kEntryExtension)
+        continue;
+
+      Entry entry;
+      entry.bytes = base::file_size(base::join_path(m_dir, name));
+      auto it = lastUse.find(name);
+      if (it != lastUse.end())
+        entry.lastUse = it->second;
+
+      m_entries[name] = entry;
+      m_totalBytes += entry.bytes;
+    }
+  }
+
+  shrink();
+}
+
+void ThumbnailCache::saveIndex()
+{
+  if (!m_modified)
+    return;
+
+  try {
+    if (!base::is_directory(m_dir))
+      base::make_all_directories(m_dir);
+
+    std::ofstream s(FSTREAM_PATH(base::join_path(m_dir, kIndexFilename)));
+    for (const auto& it : m_entries)
+      s << it.first << ' ' << it.second.lastUse << '\n';
+    m_modified = false;
+  }
+  catch (const std::exception&) {
+    // Ignore errors, the entries will be indexed again in the next
+    // session
+  }
+}
+
+void ThumbnailCache::removeEntry(const std::string& name)
+{
+  auto it = m_entries.find(name);
+  if (it == m_entries.end())
+    return;
+
+  try {
+    const std::string fn = base::join_path(m_dir, name);
+    if (base::is_file(fn))
+      base::delete_file(fn);
+  }
+  catch (const std::exception&) {
+    // Ignore errors
+  }
+
+  m_totalBytes -= it->second.bytes;
+  m_entries.erase(it);
+  m_modified = true;
+}
+
+void ThumbnailCache::shrink()
+{
+  if (m_totalBytes <= m_maxBytes)
+    return;
+
+  // Delete the least recently used entries until the cache uses 3/4
+  // of the limit (so we don't need to shrink it in each put())
+  std::vector<std::pair<uint64_t, std::string>> entries;
+  entries.reserve(m_entries.size());
+  for (const auto& it : m_entries)
+    entries.emplace_back(it.second.lastUse, it.first);
+  std::sort(entries.begin(), entries.end());
+
+  for (const auto& entry : entries) {
+    if (m_totalBytes <= m_maxBytes/4*3)
+      break;
+    removeEntry(entry.second);
+  }
+}
+
+} // namespace app
@@ -0,0 +1,71 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_THUMBNAIL_CACHE_H_INCLUDED
+#define APP_THUMBNAIL_CACHE_H_INCLUDED
+#pragma once
+
+#include "doc/image_ref.h"
+#include "gfx/size.h"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace app {
+
+  // Thumbnails of the file selector stored in a directory (one file
+  // for each thumbnail) so we don't have to generate them again in
+  // each session. Each thumbnail is associated to the path of the
+  // file, the thumbnail size, and the modification time/size of the
+  // file (so it's invalidated when the file changes). When the cache
+  // is bigger than the given limit the least recently used
+  // thumbnails are deleted.
+  //
+  // It can be used from several threads at the same time.
+  class ThumbnailCache {
+  public:
+    ThumbnailCache(const std::string& dir,
+                   const size_t maxBytes);
+    ~ThumbnailCache();
+
+    // Returns the RGB thumbnail of the given file, or nullptr if it's
+    // not in the cache (or the file was modified).
+    doc::ImageRef get(const std::string& filename,
+                      const gfx::Size& thumbnailSize);
+
+    // Saves the RGB thumbnail of the given file.
+    void put(const std::string& filename,
+             const gfx::Size& thumbnailSize,
+             const doc::Image* thumbnail);
+
+  private:
+    struct Entry {
+      size_t bytes = 0;
+      uint64_t lastUse = 0;
+    };
+
+    std::string entryName(const std::string& filename,
+                          const gfx::Size& thumbnailSize) const;
+    void loadIndex();
+    void saveIndex();
+    void removeEntry(const std::string& name);
+    void shrink();
+
+    std::string m_dir;
+    size_t m_maxBytes;
+    size_t m_totalBytes = 0;
+    uint64_t m_useCounter = 0;
+    bool m_indexLoaded = false;
+    bool m_modified = false;
+    std::map<std::string, Entry> m_entries; // Indexed by file name in m_dir
+    std::mutex m_mutex;
+  };
+
+} // namespace app
+
+#endif
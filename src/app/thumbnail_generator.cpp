@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -16,7 +16,12 @@
 #include "app/doc.h"
 #include "app/file/file.h"
 #include "app/file_system.h"
+#include "app/pref/preferences.h"
+#include "app/resource_finder.h"
+#include "app/thumbnail_cache.h"
 #include "app/util/conversion_to_surface.h"
+#include "app/util/thread_budget.h"
+#include "base/fs.h"
 #include "base/thread.h"
 #include "doc/algorithm/rotate.h"
 #include "doc/image.h"
@@ -38,10 +43,34 @@
 
 namespace app {
 
+// Converts the thumbnail to RGB to save it in the cache.
+static ImageRef convert_thumbnail_to_rgb(const Image* image,
+                                         const Palette* palette)
+{
+  ImageRef rgb(Image::create(IMAGE_RGB, image->width(), image->height()));
+  for (int y=0; y<image->height(); ++y) {
+    for (int x=0; x<image->width(); ++x) {
+      color_t c = get_pixel(image, x, y);
+      switch (image->pixelFormat()) {
+        case IMAGE_GRAYSCALE:
+          c = rgba(graya_getv(c), graya_getv(c), graya_getv(c), graya_geta(c));
+          break;
+        case IMAGE_INDEXED:
+          c = (int(c) < palette->size() ? palette->getEntry(c): 0);
+          break;
+      }
+      put_pixel(rgb.get(), x, y, c);
+    }
+  }
+  return rgb;
+}
+
 class ThumbnailGenerator::Worker {
 public:
-  Worker(base::concurrent_queue<ThumbnailGenerator::Item>& queue)
+  Worker(base::concurrent_queue<ThumbnailGenerator::Item>& queue,
+         ThumbnailCache* cache)
     : m_queue(queue)
+    , m_cache(cache)
     , m_fop(nullptr)
     , m_isDone(false)
     , m_thread([this]{ loadBgThread(); }) {
@@ -85,11 +114,20 @@ private:
         ASSERT(m_fop);
       }
 
-      THUMB_TRACE("FOP loading thumbnail: %s\n",
-                  m_item.fileitem->fileName().c_str());
+      const std::string filename = m_item.fileitem->fileName();
+      const gfx::Size thumbnailSize(MAX_THUMBNAIL_SIZE, MAX_THUMBNAIL_SIZE);
+
+      // Use the thumbnail generated in a previous session
+      ImageRef cachedImage;
+      if (m_cache)
+        cachedImage = m_cache->get(filename, thumbnailSize);
+
+      THUMB_TRACE("FOP loading thumbnail: %s%s\n",
+                  filename.c_str(), (cachedImage ? " (cached)": ""));
 
       // Load the file
-      m_fop->operate(nullptr);
+      if (!cachedImage)
+        m_fop->operate(nullptr);
 
       // Don't call post-load because postLoad() needs user interaction.
       //m_fop->postLoad();
@@ -100,9 +138,12 @@ private:
          m_fop->document()->sprite() ?
          m_fop->document()->sprite(): nullptr);
 
-      std::unique_ptr<Image> thumbnailImage;
+      ImageRef thumbnailImage;
       std::unique_ptr<Palette> palette;
-      if (!m_fop->isStop() && sprite) {
+      if (cachedImage) {
+        thumbnailImage = cachedImage;
+      }
+      else if (!m_fop->isStop() && sprite) {
         // The palette to convert the Image
         palette.reset(new Palette(*sprite->palette(frame_t(0))));
 
@@ -150,6 +191,12 @@ private:
             thumbnailImage.get(), palette.get(),
             cs, gfx::ColorSpace::MakeSRGB());
         }
+
+        if (m_cache) {
+          m_cache->put(filename, thumbnailSize,
+                       convert_thumbnail_to_rgb(thumbnailImage.get(),
+                                                palette.get()).get());
+        }
       }
 
       // Close file
@@ -224,6 +271,7 @@ private:
   }
 
   base::concurrent_queue<Item>& m_queue;
+  ThumbnailCache* m_cache;
   app::ThumbnailGenerator::Item m_item;
   FileOp* m_fop;
   mutable std::mutex m_mutex;
@@ -246,9 +294,22 @@ ThumbnailGenerator* ThumbnailGenerator::instance()
 
 ThumbnailGenerator::ThumbnailGenerator()
 {
-  int n = std::thread::hardware_concurrency()-1;
-  if (n < 1) n = 1;
-  m_maxWorkers = n;
+  m_maxWorkers = ThreadBudget::maxThreads(ThreadPriority::Thumbnails);
+
+  const int cacheSize = Preferences::instance().fileSelector.thumbnailCacheSize();
+  if (cacheSize > 0) {
+    ResourceFinder rf;
+    rf.includeUserDir(base::join_path("thumbnails", ".").c_str());
+    m_cache = std::make_unique<ThumbnailCache>(
+      rf.getFirstOrCreateDefault(),
+      size_t(cacheSize) * 1024 * 1024);
+  }
+}
+
+ThumbnailGenerator::~ThumbnailGenerator()
+{
+  // Join all workers before we destroy the cache
+  m_workers.clear();
 }
 
 bool ThumbnailGenerator::checkWorkers()
@@ -318,6 +379,9 @@ void ThumbnailGenerator::generateThumbnail(IFileItem* fileitem)
     return;
   }
 
+  // Formats can decode a smaller version of the image
+  fop->setThumbnailSize(gfx::Size(MAX_THUMBNAIL_SIZE, MAX_THUMBNAIL_SIZE));
+
   m_remainingItems.push(Item(fileitem, fop.get()));
   fop.release();
 
@@ -348,7 +412,7 @@ void ThumbnailGenerator::startWorker()
 {
   const std::lock_guard lock(m_workersAccess);
   if (m_workers.size() < m_maxWorkers) {
-    m_workers.push_back(std::make_unique<Worker>(m_remainingItems));
+    m_workers.push_back(std::make_unique<Worker>(m_remainingItems, m_cache.get()));
   }
 }
 
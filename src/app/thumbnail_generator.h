@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -22,10 +22,13 @@ namespace base {
 namespace app {
   class FileOp;
   class IFileItem;
+  class ThumbnailCache;
 
   class ThumbnailGenerator {
     ThumbnailGenerator();
   public:
+    ~ThumbnailGenerator();
+
     static ThumbnailGenerator* instance();
 
     // Generate a thumbnail for the given file-item.  It must be called
@@ -61,6 +64,9 @@ namespace app {
     };
 
     int m_maxWorkers;
+    // Thumbnails from previous sessions (it's destroyed after the
+    // workers that use it)
+    std::unique_ptr<ThumbnailCache> m_cache;
     WorkerList m_workers;
     std::mutex m_workersAccess;
     base::concurrent_queue<Item> m_remainingItems;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2018  David Capello
 // Copyright (C) 2016  Carlo Caputo
 //
@@ -10,20 +10,30 @@
 #include "config.h"
 #endif
 
+#include "app/thumbnails.h"
+
+#include "app/doc_access.h"
 #include "app/util/conversion_to_surface.h"
+#include "base/log.h"
 #include "doc/blend_mode.h"
 #include "doc/cel.h"
 #include "doc/layer.h"
+#include "doc/palette.h"
 #include "doc/sprite.h"
 #include "os/surface.h"
 #include "os/system.h"
 #include "render/render.h"
+#include "ui/system.h"
+
+#include <algorithm>
 
 namespace app {
 namespace thumb {
 
-os::SurfaceRef get_cel_thumbnail(const doc::Cel* cel,
-                                 const gfx::Size& fitInSize)
+namespace {
+
+doc::ImageRef render_cel_thumbnail(const doc::Cel* cel,
+                                   const gfx::Size& fitInSize)
 {
   gfx::Size newSize;
 
@@ -58,11 +68,17 @@ os::SurfaceRef get_cel_thumbnail(const doc::Cel* cel,
     gfx::Clip(gfx::Rect(gfx::Point(0, 0), newSize)),
     255, doc::BlendMode::NORMAL);
 
+  return thumbnailImage;
+}
+
+os::SurfaceRef make_thumbnail_surface(const doc::Image* thumbnailImage)
+{
   if (os::SurfaceRef thumbnail = os::instance()->makeRgbaSurface(
         thumbnailImage->width(),
         thumbnailImage->height())) {
+    // The thumbnail is an RGB image, so the palette is not used
     convert_image_to_surface(
-      thumbnailImage.get(), palette, thumbnail.get(),
+      thumbnailImage, nullptr, thumbnail.get(),
       0, 0, 0, 0, thumbnailImage->width(), thumbnailImage->height());
     return thumbnail;
   }
@@ -70,5 +86,219 @@ os::SurfaceRef get_cel_thumbnail(const doc::Cel* cel,
     return nullptr;
 }
 
+} // anonymous namespace
+
+os::SurfaceRef get_cel_thumbnail(const doc::Cel* cel,
+                                 const gfx::Size& fitInSize)
+{
+  doc::ImageRef thumbnailImage = render_cel_thumbnail(cel, fitInSize);
+  if (!thumbnailImage)
+    return nullptr;
+
+  return make_thumbnail_surface(thumbnailImage.get());
+}
+
+//////////////////////////////////////////////////////////////////////
+// CelThumbnailCache
+
+static std::size_t surface_bytes(const os::Surface* surface)
+{
+  return (surface ? std::size_t(surface->width()) * surface->height() * 4: 0);
+}
+
+bool CelThumbnailCache::Key::operator==(const Key& other) const
+{
+  return (imageId == other.imageId &&
+          imageVersion == other.imageVersion &&
+          paletteId == other.paletteId &&
+          paletteModifications == other.paletteModifications &&
+          celSize == other.celSize &&
+          fitInSize == other.fitInSize);
+}
+
+CelThumbnailCache::CelThumbnailCache(std::function<void()>&& onThumbnailsReady)
+  : m_onThumbnailsReady(std::move(onThumbnailsReady))
+  , m_pool(1)
+{
+}
+
+CelThumbnailCache::~CelThumbnailCache()
+{
+  clear();
+  m_pool.wait_all();
+}
+
+os::SurfaceRef CelThumbnailCache::get(Doc* doc,
+                                      const doc::Cel* cel,
+                                      const gfx::Size& fitInSize)
+{
+  ui::assert_ui_thread();
+
+  const Key key = makeKey(cel, fitInSize);
+  Entry& entry = m_entries[cel->id()];
+  entry.lastUse = ++m_useCounter;
+
+  if (entry.surface && entry.key == key)
+    return entry.surface;
+
+  if (!entry.pending || entry.pendingKey != key) {
+    entry.pending = true;
+    entry.pendingKey = key;
+
+    Job job;
+    job.doc = doc;
+    job.celId = cel->id();
+    job.key = key;
+    {
+      const std::lock_guard lock(m_mutex);
+      m_jobs.erase(
+        std::remove_if(
+          m_jobs.begin(), m_jobs.end(),
+          [&job](const Job& other){
+            return (other.celId == job.celId);
+          }),
+        m_jobs.end());
+      m_jobs.push_back(std::move(job));
+    }
+    m_pool.execute([this]{ renderNextJob(); });
+
+    shrink();
+  }
+
+  // Return the old version of the thumbnail (or nullptr) until the
+  // new one is ready.
+  return entry.surface;
+}
+
+void CelThumbnailCache::clear()
+{
+  {
+    const std::lock_guard lock(m_mutex);
+    m_jobs.clear();
+  }
+  m_entries.clear();
+  m_memSize = 0;
+}
+
+// static
+CelThumbnailCache::Key CelThumbnailCache::makeKey(const doc::Cel* cel,
+                                                  const gfx::Size& fitInSize)
+{
+  Key key;
+  if (const doc::Image* image = cel->image()) {
+    key.imageId = image->id();
+    key.imageVersion = image->version();
+  }
+  if (const doc::Palette* palette = cel->sprite()->palette(cel->frame())) {
+    key.paletteId = palette->id();
+    key.paletteModifications = palette->getModifications();
+  }
+  key.celSize = cel->bounds().size();
+  key.fitInSize = fitInSize;
+  return key;
+}
+
+// Called from the worker thread
+void CelThumbnailCache::renderNextJob()
+{
+  Job job;
+  {
+    const std::lock_guard lock(m_mutex);
+    if (m_jobs.empty())         // Canceled
+      return;
+
+    // The last requested thumbnails are the ones that are visible
+    // right now (e.g. when the user is scrolling the timeline).
+    job = std::move(m_jobs.back());
+    m_jobs.pop_back();
+  }
+
+  try {
+    WeakDocReader reader(job.doc);
+    if (reader.isLocked()) {
+      const auto* cel = doc::get<doc::Cel>(job.celId);
+      if (cel && cel->image() &&
+          makeKey(cel, job.key.fitInSize) == job.key) {
+        doc::ImageRef image = render_cel_thumbnail(cel, job.key.fitInSize);
+
+        // If the UI thread wanted to modify the document in the
+        // meantime, we cannot trust in the rendered thumbnail.
+        if (reader.isLocked())
+          job.image = image;
+      }
+    }
+  }
+  catch (const std::exception& ex) {
+    LOG(ERROR, "THUMB: Error rendering thumbnail of cel %d: %s\n",
+        int(job.celId), ex.what());
+  }
+
+  bool notify = false;
+  {
+    const std::lock_guard lock(m_mutex);
+    m_results.push_back(std::move(job));
+    if (!m_notifyPending)
+      m_notifyPending = notify = true;
+  }
+
+  if (notify) {
+    ui::execute_from_ui_thread(
+      [weak = weak_from_this()]{
+        if (auto cache = weak.lock())
+          cache->notifyResults();
+      });
+  }
+}
+
+void CelThumbnailCache::notifyResults()
+{
+  std::vector<Job> results;
+  {
+    const std::lock_guard lock(m_mutex);
+    std::swap(results, m_results);
+    m_notifyPending = false;
+  }
+
+  bool updated = false;
+  for (Job& job : results) {
+    auto it = m_entries.find(job.celId);
+    if (it == m_entries.end())  // Cleared/discarded
+      continue;
+
+    Entry& entry = it->second;
+    if (entry.pending && entry.pendingKey == job.key)
+      entry.pending = false;
+
+    // If the thumbnail couldn't be rendered (e.g. the document was
+    // locked), it will be requested again in the next paint.
+    if (!job.image)
+      continue;
+
+    if (os::SurfaceRef surface = make_thumbnail_surface(job.image.get())) {
+      m_memSize -= surface_bytes(entry.surface.get());
+      m_memSize += surface_bytes(surface.get());
+      entry.key = job.key;
+      entry.surface = surface;
+      updated = true;
+    }
+  }
+
+  if (updated)
+    m_onThumbnailsReady();
+}
+
+void CelThumbnailCache::shrink()
+{
+  while (int(m_entries.size()) > kMaxThumbnails) {
+    auto lru = std::min_element(
+      m_entries.begin(), m_entries.end(),
+      [](const auto& a, const auto& b){
+        return a.second.lastUse < b.second.lastUse;
+      });
+    m_memSize -= surface_bytes(lru->second.surface.get());
+    m_entries.erase(lru);
+  }
+}
+
 } // thumb
 } // app
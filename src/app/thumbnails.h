@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2016  Carlo Caputo
 //
 // This program is distributed under the terms of
@@ -9,9 +9,24 @@
 #define APP_THUMBNAILS_H_INCLUDED
 #pragma once
 
+#include "base/disable_copying.h"
+#include "base/thread_pool.h"
+#include "doc/image_ref.h"
+#include "doc/memory_account.h"
+#include "doc/object_id.h"
+#include "doc/object_version.h"
 #include "gfx/size.h"
 #include "os/surface.h"
 
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 namespace doc {
   class Cel;
 }
@@ -21,11 +36,94 @@ namespace os {
 }
 
 namespace app {
+  class Doc;
+
 namespace thumb {
 
   os::SurfaceRef get_cel_thumbnail(const doc::Cel* cel,
                                    const gfx::Size& fitInSize);
 
+  // Thumbnails of cels generated in a background thread (used by the
+  // Timeline). When a thumbnail is not ready, get() returns the
+  // previous version of it (or nullptr), and the "onThumbnailsReady"
+  // callback is called from the UI thread when new thumbnails are
+  // available.
+  class CelThumbnailCache
+    : public std::enable_shared_from_this<CelThumbnailCache> {
+  public:
+    // Maximum number of thumbnails in the cache (the least recently
+    // used ones are discarded).
+    static constexpr int kMaxThumbnails = 4096;
+
+    explicit CelThumbnailCache(std::function<void()>&& onThumbnailsReady);
+    ~CelThumbnailCache();
+
+    // The cel must be from the given document. It can be called
+    // only from the UI thread.
+    os::SurfaceRef get(Doc* doc,
+                       const doc::Cel* cel,
+                       const gfx::Size& fitInSize);
+
+    // Removes all thumbnails and cancels all the queued jobs.
+    void clear();
+
+  private:
+    // Everything that changes the thumbnail of a cel
+    struct Key {
+      doc::ObjectId imageId = doc::NullId;
+      doc::ObjectVersion imageVersion = 0;
+      doc::ObjectId paletteId = doc::NullId;
+      int paletteModifications = 0;
+      gfx::Size celSize;
+      gfx::Size fitInSize;
+
+      bool operator==(const Key& other) const;
+      bool operator!=(const Key& other) const {
+        return !operator==(other);
+      }
+    };
+
+    struct Entry {
+      Key key;                  // Key of the "surface"
+      os::SurfaceRef surface;   // Can be an old version of the thumbnail
+      Key pendingKey;
+      bool pending = false;     // A job was requested for "pendingKey"
+      uint64_t lastUse = 0;
+    };
+
+    struct Job {
+      Doc* doc = nullptr;
+      doc::ObjectId celId = doc::NullId;
+      Key key;
+      doc::ImageRef image;      // Result
+    };
+
+    static Key makeKey(const doc::Cel* cel, const gfx::Size& fitInSize);
+    void renderNextJob();
+    void notifyResults();
+    void shrink();
+
+    std::function<void()> m_onThumbnailsReady;
+    std::map<doc::ObjectId, Entry> m_entries; // Cel ID -> Entry
+    uint64_t m_useCounter = 0;
+
+    // Jobs/results shared with the worker thread
+    std::mutex m_mutex;
+    std::deque<Job> m_jobs;
+    std::vector<Job> m_results;
+    bool m_notifyPending = false;
+
+    base::thread_pool m_pool;
+
+    // Memory of all thumbnail surfaces (read from any thread)
+    std::atomic<std::size_t> m_memSize = 0;
+    doc::MemoryAccount m_memoryAccount{
+      doc::MemoryPool::Thumbnails,
+      [this]{ return m_memSize.load(); } };
+
+    DISABLE_COPYING(CelThumbnailCache);
+  };
+
 } // thumb
 } // app
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -60,8 +60,13 @@ public:
 
   Stroke::Pt getLastPoint() const override { return m_last; }
 
+  void prepareController(ToolLoop* loop) override {
+    m_newPoints = 0;
+  }
+
   void pressButton(ToolLoop* loop, Stroke& stroke, const Stroke::Pt& pt) override {
     m_last = pt;
+    m_newPoints = 0;
     stroke.addPoint(pt);
   }
 
@@ -71,6 +76,7 @@ public:
 
   void movement(ToolLoop* loop, Stroke& stroke, const Stroke::Pt& pt) override {
     m_last = pt;
+    ++m_newPoints;
     stroke.addPoint(pt);
   }
 
@@ -79,13 +85,17 @@ public:
       output.addPoint(input[0]);
     }
     else if (input.size() >= 2) {
-      // The freehand controller returns only the last two points to
-      // interwine because we accumulate (TracePolicy::Accumulate) the
-      // previously painted points (i.e. don't want to redraw all the
-      // stroke from the very beginning)
-      output.addPoint(input[input.size()-2]);
-      output.addPoint(input[input.size()-1]);
+      // The freehand controller returns only the new points (plus the
+      // last interwined one) because we accumulate
+      // (TracePolicy::Accumulate) the previously painted points
+      // (i.e. don't want to redraw all the stroke from the very
+      // beginning). Several points can be added between two loop
+      // steps when pen movements are coalesced.
+      const int n = std::clamp(m_newPoints+1, 2, input.size());
+      for (int i=input.size()-n; i<input.size(); ++i)
+        output.addPoint(input[i]);
     }
+    m_newPoints = 0;
   }
 
   void getStatusBarText(ToolLoop* loop, const Stroke& stroke, std::string& text) override {
@@ -104,6 +114,8 @@ public:
 
 private:
   Stroke::Pt m_last;
+  // Points added with movement() since the last getStrokeToInterwine()
+  int m_newPoints = 0;
 };
 
 // Controls clicks for tools like line
@@ -475,6 +487,7 @@ public:
 
   void prepareController(ToolLoop* loop) override {
     m_controller = nullptr;
+    m_freehand.prepareController(loop);
   }
 
   void pressButton(ToolLoop* loop, Stroke& stroke, const Stroke::Pt& pt) override {
@@ -10,6 +10,7 @@
 #include "app/util/wrap_value.h"
 #include "doc/blend_funcs.h"
 #include "doc/blend_internals.h"
+#include "doc/image_buffer_pool.h"
 #include "doc/image_impl.h"
 #include "doc/layer.h"
 #include "doc/palette.h"
@@ -908,21 +909,16 @@ private:
 // Gradient Ink
 //////////////////////////////////////////////////////////////////////
 
-static ImageBufferPtr tmpGradientBuffer; // TODO non-thread safe
-
 class GradientRenderer {
 public:
   GradientRenderer(ToolLoop* loop)
     : m_tiledMode(loop->getTiledMode())
   {
-    if (!tmpGradientBuffer)
-      tmpGradientBuffer.reset(new ImageBuffer(1));
-
     m_tmpImage.reset(
       Image::create(IMAGE_RGB,
                     loop->getDstImage()->width(),
                     loop->getDstImage()->height(),
-                    tmpGradientBuffer));
+                    ImageBufferPool::instance()->get()));
     m_tmpImage->clear(0);
   }
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2020  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -67,7 +67,7 @@ void Intertwine::doTransformPoint(const Stroke::Pt& pt, ToolLoop* loop)
 void Intertwine::doPointshapeStrokePt(const Stroke::Pt& pt, ToolLoop* loop)
 {
   Symmetry* symmetry = loop->getSymmetry();
-  if (symmetry) {
+  if (symmetry && !loop->getPointShape()->handlesSymmetry()) {
     // Convert the point to the sprite position so we can apply the
     // symmetry transformation.
     Stroke main_stroke;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2021  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -28,6 +28,11 @@ namespace app {
       virtual bool snapByAngle() { return false; }
       virtual void prepareIntertwine(ToolLoop* loop) { }
 
+      // False if each point must be drawn before transforming the
+      // next one (i.e. the point shape cannot draw all the points of
+      // a joinStroke() call together, see PointShape::beginBatch()).
+      virtual bool canBatchPoints() { return true; }
+
       // The given stroke must be relative to the cel origin.
       virtual void joinStroke(ToolLoop* loop, const Stroke& stroke) = 0;
       virtual void fillStroke(ToolLoop* loop, const Stroke& stroke) = 0;
@@ -449,6 +449,8 @@ class IntertwineAsPixelPerfect : public Intertwine {
   gfx::Region m_restoredRegion;
   // Last point index.
   int m_lastPti;
+  // Maximum number of points kept in m_pts for non-filled strokes.
+  static constexpr int kMaxPts = 1024;
 
   // Temporal tileset with latest changes to be used by pixel perfect only when
   // modifying a tilemap in Manual mode.
@@ -462,6 +464,10 @@ public:
   // angle when "pixel perfect" is selected.
   bool snapByAngle() override { return true; }
 
+  // The area of each point is saved before drawing it (to restore it
+  // in case that the point is removed)
+  bool canBatchPoints() override { return false; }
+
   void prepareIntertwine(ToolLoop* loop) override {
     m_pts.reset();
     m_retainedTracePolicyLast = false;
@@ -513,6 +519,15 @@ public:
       if (stroke.firstPoint() == stroke.lastPoint())
         return;
 
+      // Only the last points can be removed by the pixel-perfect
+      // algorithm, so we can discard the old ones when they are not
+      // needed to fill the stroke (fillStroke() uses all of them).
+      if (!loop->getFilled() && m_pts.size() > kMaxPts) {
+        const int n = m_pts.size() - 3;
+        m_pts.eraseFirst(n);
+        m_lastPti -= n;
+      }
+
       nextPt = m_pts.size();
       thirdFromLastPt = (m_pts.size() > 2 ? m_pts.size() - 3 : m_pts.size() - 1);
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -30,6 +30,18 @@ namespace app {
       virtual void transformPoint(ToolLoop* loop, const Stroke::Pt& pt) = 0;
       virtual void getModifiedArea(ToolLoop* loop, int x, int y, gfx::Rect& area) = 0;
 
+      // Called before/after all the points of one step of the tool
+      // loop are transformed. A point shape can accumulate the
+      // covered pixels between these calls and draw them in
+      // endBatch(), processing each pixel with the ink only once.
+      virtual void beginBatch(ToolLoop* loop) { }
+      virtual void endBatch(ToolLoop* loop) { }
+
+      // True if the symmetrical points are generated mirroring the
+      // current batch in endBatch(), so only the original points must
+      // be transformed.
+      virtual bool handlesSymmetry() { return false; }
+
     protected:
       // Calls loop->getInk()->inkHline() function for each horizontal-scanline
       // that should be drawn (applying the "tiled" mode loop->getTiledMode())
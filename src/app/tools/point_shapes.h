@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -8,11 +8,17 @@
 #include "app/util/wrap_point.h"
 
 #include "app/tools/ink.h"
+#include "app/tools/symmetry.h"
 #include "doc/algorithm/flip_image.h"
 #include "render/gradient.h"
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <list>
 #include <memory>
+#include <tuple>
+#include <vector>
 
 namespace app {
 namespace tools {
@@ -63,9 +69,19 @@ public:
 
 class BrushPointShape : public PointShape {
   bool m_firstPoint;
+  using CompressedImages = std::array<std::shared_ptr<CompressedImage>, 4>;
   Brush* m_lastBrush;
-  BrushType m_origBrushType;
-  std::array<std::shared_ptr<CompressedImage>, 4> m_compressedImages;
+  BrushType m_origBrushType = kCircleBrushType;
+  CompressedImages m_compressedImages;
+  CompressedImages* m_lastCompressedImages = &m_compressedImages;
+  // Brushes created for dynamics (and their compressed images), so
+  // they aren't re-created each time the pressure changes the brush
+  // size. The most recently used brush is the first one.
+  struct CachedBrush {
+    BrushRef brush;
+    CompressedImages compressedImages;
+  };
+  std::list<CachedBrush> m_brushCache;
   // For dynamics
   DynamicsOptions m_dynamics;
   bool m_useDynamics;
@@ -73,12 +89,36 @@ class BrushPointShape : public PointShape {
   color_t m_primaryColor;
   color_t m_secondaryColor;
   float m_lastGradientValue;
+  // Scanlines of the dabs accumulated between beginBatch() and
+  // endBatch()
+  struct BatchedScanline {
+    int y, x1, x2;
+    bool operator<(const BatchedScanline& other) const {
+      return (y < other.y || (y == other.y && x1 < other.x1));
+    }
+  };
+  bool m_batching = false;
+  std::vector<BatchedScanline> m_batch;
+  // Symmetry applied to the whole batch in endBatch() (instead of
+  // transforming each symmetrical point), pixels are mirrored as
+  // x' = m_mirrorX - x and y' = m_mirrorY - y.
+  gen::SymmetryMode m_batchSymmetry = gen::SymmetryMode::NONE;
+  int m_mirrorX = 0;
+  int m_mirrorY = 0;
 
 public:
+  static constexpr int kMaxCachedBrushes = 32;
+
+  // Brushes smaller than this are drawn immediately (there are not
+  // enough overlapped pixels between dabs to justify the batch)
+  static constexpr int kMinBatchBrushSize = 4;
 
   void preparePointShape(ToolLoop* loop) override {
     m_firstPoint = true;
     m_lastBrush = nullptr;
+    m_lastCompressedImages = &m_compressedImages;
+    if (m_origBrushType != loop->getBrush()->type())
+      m_brushCache.clear();
     m_origBrushType = loop->getBrush()->type();
 
     m_dynamics = loop->getDynamics();
@@ -177,15 +217,15 @@ public:
       if ((brush->size() != size) ||
           (brush->angle() != angle && m_origBrushType != kCircleBrushType) ||
           (m_hasDynamicGradient && pt.gradient != m_lastGradientValue)) {
-        // TODO cache brushes
-        BrushRef newBrush = std::make_shared<Brush>(
-          m_origBrushType, size, angle);
-
         // Dynamic gradient with dithering
         bool prepareInk = false;
+        BrushRef newBrush;
         if (m_hasDynamicGradient && !ink->isEraser() &&
             (m_dynamics.ditheringMatrix.rows() > 1 ||
              m_dynamics.ditheringMatrix.cols() > 1)) {
+          // Dithering brushes depend on the gradient value, so they
+          // cannot be cached.
+          newBrush = std::make_shared<Brush>(m_origBrushType, size, angle);
           convert_bitmap_brush_to_dithering_brush(
             newBrush.get(),
             loop->sprite()->pixelFormat(),
@@ -195,6 +235,9 @@ public:
             m_primaryColor);
           prepareInk = true;
         }
+        else {
+          newBrush = getCachedBrush(size, angle);
+        }
         m_lastGradientValue = pt.gradient;
 
         loop->setBrush(newBrush);
@@ -207,11 +250,8 @@ public:
       }
     }
 
-    // TODO cache compressed images (or remove them completelly)
-    if (m_lastBrush != brush) {
-      m_lastBrush = brush;
-      m_compressedImages.fill(nullptr);
-    }
+    if (m_lastBrush != brush)
+      setLastBrush(brush);
 
     x += brush->bounds().x;
     y += brush->bounds().y;
@@ -243,14 +283,93 @@ public:
 
     ink->prepareForPointShape(loop, m_firstPoint, x, y);
 
-    for (auto scanline : getCompressedImage(pt.symmetry)) {
-      int u = x+scanline.x;
-      ink->prepareVForPointShape(loop, y+scanline.y);
-      doInkHline(u, y+scanline.y, u+scanline.w-1, loop);
+    if (m_batching) {
+      for (auto scanline : getCompressedImage(pt.symmetry)) {
+        int u = x+scanline.x;
+        m_batch.push_back({ y+scanline.y, u, u+scanline.w-1 });
+      }
+    }
+    else {
+      for (auto scanline : getCompressedImage(pt.symmetry)) {
+        int u = x+scanline.x;
+        ink->prepareVForPointShape(loop, y+scanline.y);
+        doInkHline(u, y+scanline.y, u+scanline.w-1, loop);
+      }
     }
     m_firstPoint = false;
   }
 
+  // All the dabs of one step are painted over the same source image
+  // (the destination is copied to the source only between steps), so
+  // painting the union of their scanlines gives the same result as
+  // painting each dab, but without processing the overlapped pixels
+  // several times. This is not true if the ink depends on the
+  // position of each dab (image brushes) or the brush/color changes
+  // between dabs (dynamics).
+  void beginBatch(ToolLoop* loop) override {
+    Ink* ink = loop->getInk();
+    Brush* brush = loop->getBrush();
+    m_batch.clear();
+    m_batching = (!m_useDynamics &&
+                  m_origBrushType != kImageBrushType &&
+                  brush->size() >= kMinBatchBrushSize &&
+                  (ink->isPaint() ||
+                   ink->isEffect() ||
+                   ink->isEraser() ||
+                   ink->isSelection()));
+
+    m_batchSymmetry = gen::SymmetryMode::NONE;
+    if (m_batching && loop->getSymmetry()) {
+      if (m_lastBrush != brush)
+        setLastBrush(brush);
+      prepareBatchSymmetry(loop->getSymmetry());
+    }
+  }
+
+  void endBatch(ToolLoop* loop) override {
+    if (!m_batching)
+      return;
+    m_batching = false;
+
+    mergeBatch();
+
+    // Mirror the merged scanlines of the original stroke
+    if (m_batchSymmetry != gen::SymmetryMode::NONE) {
+      const bool both = (m_batchSymmetry == gen::SymmetryMode::BOTH);
+      const std::size_t n = m_batch.size();
+      for (std::size_t i=0; i<n; ++i) {
+        const BatchedScanline s = m_batch[i];
+        const BatchedScanline h = { s.y, m_mirrorX - s.x2, m_mirrorX - s.x1 };
+        const BatchedScanline v = { m_mirrorY - s.y, s.x1, s.x2 };
+        if (both || m_batchSymmetry == gen::SymmetryMode::HORIZONTAL)
+          m_batch.push_back(h);
+        if (both || m_batchSymmetry == gen::SymmetryMode::VERTICAL)
+          m_batch.push_back(v);
+        if (both)
+          m_batch.push_back({ v.y, h.x1, h.x2 });
+      }
+      mergeBatch();
+    }
+
+    // The ink was prepared for the last dab, and all dabs use the
+    // same color.
+    Ink* ink = loop->getInk();
+    int lastY = 0;
+    for (std::size_t i=0; i<m_batch.size(); ++i) {
+      const BatchedScanline& s = m_batch[i];
+      if (i == 0 || s.y != lastY) {
+        ink->prepareVForPointShape(loop, s.y);
+        lastY = s.y;
+      }
+      doInkHline(s.x1, s.y, s.x2, loop);
+    }
+    m_batch.clear();
+  }
+
+  bool handlesSymmetry() override {
+    return (m_batching && m_batchSymmetry != gen::SymmetryMode::NONE);
+  }
+
   void getModifiedArea(ToolLoop* loop, int x, int y, Rect& area) override {
     area = loop->getBrush()->bounds();
     area.x += x;
@@ -258,8 +377,115 @@ public:
   }
 
 private:
+  // Returns a brush with the original type and the given size/angle
+  // from the cache (creating it if it's needed).
+  BrushRef getCachedBrush(const int size, const int angle) {
+    for (auto it=m_brushCache.begin(); it!=m_brushCache.end(); ++it) {
+      if (it->brush->size() == size &&
+          it->brush->angle() == angle) {
+        m_brushCache.splice(m_brushCache.begin(), m_brushCache, it);
+        return it->brush;
+      }
+    }
+
+    // Remove the least recently used brush (but not the current one,
+    // as m_lastCompressedImages can be pointing to its images)
+    if (int(m_brushCache.size()) >= kMaxCachedBrushes &&
+        m_brushCache.back().brush.get() != m_lastBrush)
+      m_brushCache.pop_back();
+
+    m_brushCache.push_front(
+      CachedBrush{ std::make_shared<Brush>(m_origBrushType, size, angle), {} });
+    return m_brushCache.front().brush;
+  }
+
+  // Uses the compressed images of the cached brush (if it's in the
+  // cache) or new ones.
+  void setLastBrush(Brush* brush) {
+    m_lastBrush = brush;
+    for (auto& cached : m_brushCache) {
+      if (cached.brush.get() == brush) {
+        m_lastCompressedImages = &cached.compressedImages;
+        return;
+      }
+    }
+    m_compressedImages.fill(nullptr);
+    m_lastCompressedImages = &m_compressedImages;
+  }
+
+  // Sorts the batch and joins the overlapped/adjacent scanlines
+  void mergeBatch() {
+    std::sort(m_batch.begin(), m_batch.end());
+    auto out = m_batch.begin();
+    for (auto it = m_batch.begin(); it != m_batch.end(); ++it) {
+      if (out != m_batch.begin() &&
+          (out-1)->y == it->y &&
+          it->x1 <= (out-1)->x2+1) {
+        (out-1)->x2 = std::max((out-1)->x2, it->x2);
+      }
+      else {
+        *out = *it;
+        ++out;
+      }
+    }
+    m_batch.erase(out, m_batch.end());
+  }
+
+  // The batch can be mirrored only if each symmetrical dab drawn by
+  // transformPoint() covers exactly the mirrored pixels of the
+  // original dab (Symmetry::calculateSymmetricalStroke() mirrors the
+  // dab position, but the brush mask isn't flipped), and if the
+  // mirror axis gives integer coordinates.
+  void prepareBatchSymmetry(const Symmetry* symmetry) {
+    const gen::SymmetryMode mode = symmetry->mode();
+    const gfx::Rect& bounds = m_lastBrush->bounds();
+    const gfx::Point& center = m_lastBrush->center();
+    const bool hasX = (mode == gen::SymmetryMode::HORIZONTAL ||
+                       mode == gen::SymmetryMode::BOTH);
+    const bool hasY = (mode == gen::SymmetryMode::VERTICAL ||
+                       mode == gen::SymmetryMode::BOTH);
+
+    const double mirrorX = 2.0*(symmetry->x() + center.x + bounds.x) - 1.0;
+    const double mirrorY = 2.0*(symmetry->y() + center.y + bounds.y) - 1.0;
+    if ((hasX && mirrorX != std::floor(mirrorX)) ||
+        (hasY && mirrorY != std::floor(mirrorY)))
+      return;
+
+    using Coverage = std::vector<std::tuple<int, int, int>>; // y, x, w
+    auto coverage = [this](const gen::SymmetryMode mode) {
+      Coverage result;
+      for (const auto& scanline : getCompressedImage(mode))
+        result.emplace_back(scanline.y, scanline.x, scanline.w);
+      std::sort(result.begin(), result.end());
+      return result;
+    };
+    auto reflect = [&bounds](const Coverage& cov, bool x, bool y) {
+      Coverage result;
+      for (const auto& [v, u, w] : cov)
+        result.emplace_back(y ? bounds.h-1-v: v,
+                            x ? bounds.w-u-w: u, w);
+      std::sort(result.begin(), result.end());
+      return result;
+    };
+
+    const Coverage original = coverage(gen::SymmetryMode::NONE);
+    if (hasX && (reflect(original, true, false) != original ||
+                 coverage(gen::SymmetryMode::HORIZONTAL) != original))
+      return;
+    if (hasY && (reflect(original, false, true) != original ||
+                 coverage(gen::SymmetryMode::VERTICAL) != original))
+      return;
+    if (hasX && hasY &&
+        coverage(gen::SymmetryMode::BOTH) != original)
+      return;
+
+    m_batchSymmetry = mode;
+    m_mirrorX = int(mirrorX);
+    m_mirrorY = int(mirrorY);
+  }
+
   CompressedImage& getCompressedImage(gen::SymmetryMode symmetryMode) {
-    auto& compressPtr = m_compressedImages[int(symmetryMode)];
+    auto& compressPtr = (*m_lastCompressedImages)[int(symmetryMode)];
     if (!compressPtr) {
       switch (symmetryMode) {
         case gen::SymmetryMode::NONE: {
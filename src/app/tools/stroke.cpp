@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -11,6 +11,8 @@
 
 #include "app/tools/stroke.h"
 
+#include <algorithm>
+
 namespace app {
 namespace tools {
 
@@ -44,6 +46,13 @@ void Stroke::erase(int index)
     m_pts.erase(m_pts.begin()+index);
 }
 
+void Stroke::eraseFirst(int n)
+{
+  ASSERT(0 <= n && n <= m_pts.size());
+  n = std::clamp(n, 0, int(m_pts.size()));
+  m_pts.erase(m_pts.begin(), m_pts.begin()+n);
+}
+
 gfx::Rect Stroke::bounds() const
 {
   if (m_pts.empty())
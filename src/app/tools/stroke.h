@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2021  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -71,6 +71,9 @@ namespace app {
       // Erase the point "index".
       void erase(int index);
 
+      // Erase the first "n" points.
+      void eraseFirst(int n);
+
       // Returns the bounds of the stroke (minimum/maximum position).
       gfx::Rect bounds() const;
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2021  Igara Studio S.A.
+// Copyright (C) 2021-2024  Igara Studio S.A.
 // Copyright (C) 2015  David Capello
 //
 // This program is distributed under the terms of
@@ -28,6 +28,8 @@ public:
   void generateStrokes(const Stroke& stroke, Strokes& strokes, ToolLoop* loop);
 
   gen::SymmetryMode mode() const { return m_symmetryMode; }
+  double x() const { return m_x; }
+  double y() const { return m_y; }
 
 private:
   void calculateSymmetricalStroke(const Stroke& refStroke, Stroke& stroke,
@@ -0,0 +1,163 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/app.h"
+#include "app/cli/app_options.h"
+#include "app/color.h"
+#include "app/context.h"
+#include "app/doc.h"
+#include "app/doc_undo.h"
+#include "app/inline_command_execution.h"
+#include "app/site.h"
+#include "app/tools/active_tool.h"
+#include "app/tools/tool_box.h"
+#include "app/tools/tool_loop.h"
+#include "app/tools/tool_loop_manager.h"
+#include "app/ui/editor/tool_loop_impl.h"
+#include "base/pi.h"
+#include "doc/brush.h"
+#include "os/system.h"
+#include "tests/benchmark_fixtures.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+using namespace app;
+using namespace doc;
+
+#ifdef ENABLE_SCRIPTING
+
+// Uses the tool in the first layer/frame of the document as
+// app.useTool() does (a ToolLoop without editor/UI), and then undoes
+// the change (the undo is not measured).
+static void use_tool(benchmark::State& state,
+                     Doc* doc,
+                     const char* toolId,
+                     const int brushSize,
+                     const std::vector<gfx::Point>& points)
+{
+  Context* ctx = App::instance()->context();
+  Sprite* sprite = doc->sprite();
+
+  Site site;
+  site.document(doc);
+  site.sprite(sprite);
+  site.layer(sprite->root()->firstLayer());
+  site.frame(0);
+
+  ToolLoopParams params;
+  params.tool = App::instance()->toolBox()->getToolById(toolId);
+  params.ink = params.tool->getInk(0);
+  params.controller = params.tool->getController(0);
+  params.fg = app::Color::fromRgb(255, 0, 0);
+  params.bg = app::Color::fromRgb(0, 0, 0);
+  params.ink = App::instance()->activeToolManager()
+    ->adjustToolInkDependingOnSelectedInkType(params.ink, params.inkType, params.fg);
+  params.brush = std::make_shared<Brush>(BrushType::kCircleBrushType, brushSize, 0);
+  params.tolerance = 16;
+
+  {
+    InlineCommandExecution inlineCmd(ctx);
+    std::unique_ptr<tools::ToolLoop> loop(
+      create_tool_loop_for_script(ctx, site, params));
+    tools::ToolLoopManager manager(loop.get());
+
+    auto pointer = [](const gfx::Point& pt) {
+      return tools::Pointer(pt, tools::Vec2(0.0f, 0.0f),
+                            tools::Pointer::Button::Left,
+                            tools::Pointer::Type::Unknown, 0.0f);
+    };
+    manager.prepareLoop(pointer(points.front()));
+    manager.pressButton(pointer(points.front()));
+    for (size_t i=1; i<points.size(); ++i)
+      manager.movement(pointer(points[i]));
+    manager.releaseButton(pointer(points.back()));
+    manager.end();
+  }
+
+  state.PauseTiming();
+  doc->undoHistory()->undo();
+  state.ResumeTiming();
+}
+
+static std::unique_ptr<Doc> create_fixture_doc(int size)
+{
+  std::unique_ptr<Doc> doc(
+    new Doc(tests::create_fixture_sprite(ColorMode::RGB, size, size)));
+  App::instance()->context()->documents().add(doc.get());
+  return doc;
+}
+
+// Fills the area of the background band in the middle of the image.
+static void BM_FloodFill(benchmark::State& state)
+{
+  const int size = state.range(0);
+  auto doc = create_fixture_doc(size);
+  const std::vector<gfx::Point> points = { gfx::Point(size/2, size/2) };
+
+  for (auto _ : state)
+    use_tool(state, doc.get(), "paint_bucket", 1, points);
+
+  doc->close();
+}
+
+// Replays a freehand stroke (a spiral of "npoints" mouse positions)
+// with the pencil tool.
+static void BM_FreehandStroke(benchmark::State& state)
+{
+  const int size = state.range(0);
+  const int npoints = state.range(1);
+  const int brushSize = state.range(2);
+  auto doc = create_fixture_doc(size);
+
+  std::vector<gfx::Point> points(npoints);
+  for (int i=0; i<npoints; ++i) {
+    const double t = double(i) / npoints;
+    const double r = size * (0.05 + 0.4*t);
+    points[i] = gfx::Point(int(size/2 + r*std::cos(t * 8 * PI)),
+                           int(size/2 + r*std::sin(t * 8 * PI)));
+  }
+
+  for (auto _ : state)
+    use_tool(state, doc.get(), tools::WellKnownTools::Pencil, brushSize, points);
+
+  doc->close();
+}
+
+BENCHMARK(BM_FloodFill)
+  ->Arg(256)->Arg(1024)->Arg(4096)
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_FreehandStroke)
+  ->Args({ 256, 100, 1 })
+  ->Args({ 256, 100, 16 })
+  ->Args({ 1024, 1000, 1 })
+  ->Args({ 1024, 1000, 16 })
+  ->Args({ 4096, 1000, 64 })
+  ->Unit(benchmark::kMillisecond);
+
+#endif // ENABLE_SCRIPTING
+
+int app_main(int argc, char* argv[])
+{
+  os::SystemRef system(os::make_system());
+  App app;
+  const char* argv2[] = { argv[0], "--batch" };
+  app.initialize(AppOptions(2, argv2));
+
+  ::benchmark::Initialize(&argc, argv);
+  int status = ::benchmark::RunSpecifiedBenchmarks();
+
+  app.close();
+  return status;
+}
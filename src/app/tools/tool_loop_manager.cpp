@@ -12,6 +12,7 @@
 #include "app/tools/tool_loop_manager.h"
 
 #include "app/context.h"
+#include "app/profiler.h"
 #include "app/snap_to_grid.h"
 #include "app/tools/controller.h"
 #include "app/tools/ink.h"
@@ -124,10 +125,7 @@ void ToolLoopManager::pressButton(const Pointer& pointer)
 
   Stroke::Pt spritePoint = getSpriteStrokePt(pointer);
   m_toolLoop->getController()->pressButton(m_toolLoop, m_stroke, spritePoint);
-
-  std::string statusText;
-  m_toolLoop->getController()->getStatusBarText(m_toolLoop, m_stroke, statusText);
-  m_toolLoop->updateStatusBar(statusText.c_str());
+  updateStatusBar();
 
   // We evaluate if the trace policy has changed compared with
   // the initial trace policy.
@@ -174,6 +172,31 @@ bool ToolLoopManager::releaseButton(const Pointer& pointer)
 }
 
 void ToolLoopManager::movement(Pointer pointer)
+{
+  if (!addMovement(pointer))
+    return;
+
+  updateStatusBar();
+  doLoopStep(false);
+}
+
+void ToolLoopManager::movement(const std::vector<Pointer>& pointers)
+{
+  if (pointers.empty())
+    return;
+
+  for (const Pointer& pointer : pointers) {
+    if (!addMovement(pointer))
+      return;
+  }
+
+  updateStatusBar();
+  doLoopStep(false);
+}
+
+// Returns false if the pointer cannot be added because the loop was
+// canceled.
+bool ToolLoopManager::addMovement(Pointer pointer)
 {
   // Filter points with the stabilizer
   if (m_dynamics.stabilizer && m_dynamics.stabilizerFactor > 0) {
@@ -197,16 +220,18 @@ void ToolLoopManager::movement(Pointer pointer)
   m_lastPointer = pointer;
 
   if (isCanceled())
-    return;
+    return false;
 
   Stroke::Pt spritePoint = getSpriteStrokePt(pointer);
   m_toolLoop->getController()->movement(m_toolLoop, m_stroke, spritePoint);
+  return true;
+}
 
+void ToolLoopManager::updateStatusBar()
+{
   std::string statusText;
   m_toolLoop->getController()->getStatusBarText(m_toolLoop, m_stroke, statusText);
   m_toolLoop->updateStatusBar(statusText.c_str());
-
-  doLoopStep(false);
 }
 
 void ToolLoopManager::disableMouseStabilizer() 
@@ -217,6 +242,8 @@ void ToolLoopManager::disableMouseStabilizer()
 
 void ToolLoopManager::doLoopStep(bool lastStep)
 {
+  PROFILE_ZONE("ToolLoopManager::doLoopStep");
+
   // Original set of points to interwine (original user stroke,
   // relative to sprite origin).
   Stroke main_stroke;
@@ -284,6 +311,12 @@ void ToolLoopManager::doLoopStep(bool lastStep)
   // Join or fill user points
   if (fillStrokes)
     m_toolLoop->getIntertwine()->fillStroke(m_toolLoop, main_stroke);
+  else if (m_toolLoop->getIntertwine()->canBatchPoints()) {
+    PointShape* pointShape = m_toolLoop->getPointShape();
+    pointShape->beginBatch(m_toolLoop);
+    m_toolLoop->getIntertwine()->joinStroke(m_toolLoop, main_stroke);
+    pointShape->endBatch(m_toolLoop);
+  }
   else
     m_toolLoop->getIntertwine()->joinStroke(m_toolLoop, main_stroke);
 
@@ -78,6 +78,11 @@ public:
   // Should be called each time the user moves the mouse inside the editor.
   void movement(Pointer pointer);
 
+  // Adds all the given pointers to the stroke and does just one loop
+  // step to draw them (useful to coalesce the high-frequency
+  // movements of a pen in one rendered frame).
+  void movement(const std::vector<Pointer>& pointers);
+
   // Should be called when Shift+brush tool is used to disable stabilizer
   // on the line preview
   void disableMouseStabilizer();
@@ -85,6 +90,8 @@ public:
   const Pointer& lastPointer() const { return m_lastPointer; }
 
 private:
+  bool addMovement(Pointer pointer);
+  void updateStatusBar();
   void doLoopStep(bool lastStep);
   void snapToGrid(Stroke::Pt& pt);
   Stroke::Pt getSpriteStrokePt(const Pointer& pointer);
@@ -97,6 +97,7 @@ void Transaction::commit()
   m_cmds->updateSpritePositionAfter();
   const SpritePosition sprPos = m_cmds->spritePositionAfterExecute();
 
+  m_cmds->collectChanges(m_doc->changes());
   m_undo->add(m_cmds);
   m_cmds = nullptr;
 
@@ -120,6 +121,8 @@ void Transaction::commit()
     if (m_ctx->isUIAvailable())
       ui::Manager::getDefault()->invalidate();
   }
+
+  m_doc->notifyChanges();
 }
 
 void Transaction::rollbackAndStartAgain()
@@ -135,9 +138,12 @@ void Transaction::rollback(CmdTransaction* newCmds)
   TX_TRACE("TX: Rollback <%s>\n", m_cmds->label().c_str());
 
   m_cmds->undo();
+  m_cmds->collectChanges(m_doc->changes());
 
   delete m_cmds;
   m_cmds = newCmds;
+
+  m_doc->notifyChanges();
 }
 
 void Transaction::execute(Cmd* cmd)
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2016-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -25,6 +25,7 @@
 #include "base/scoped_value.h"
 #include "base/thread.h"
 #include "os/surface.h"
+#include "os/surface_format.h"
 #include "os/system.h"
 #include "ui/manager.h"
 #include "ui/message.h"
@@ -39,10 +40,13 @@
 #include <condition_variable>
 #include <cstdio>
 #include <thread>
+#include <vector>
 
-#if SK_ENABLE_SKSL
+#if LAF_SKIA || SK_ENABLE_SKSL
   #include "os/skia/skia_surface.h"
+#endif
 
+#if SK_ENABLE_SKSL
   #include "include/core/SkCanvas.h"
   #include "include/effects/SkRuntimeEffect.h"
 #endif
@@ -568,6 +572,57 @@ void ColorSelector::onPaintSurfaceInBgThread(
   }
 }
 
+// static
+bool ColorSelector::paintRowsInBgThread(
+  os::Surface* s,
+  const gfx::Rect& rc,
+  const bool& stop,
+  const std::function<void(int y, gfx::Color* row)>& fillRow)
+{
+  std::vector<gfx::Color> row(rc.w);
+
+  os::SurfaceLock lock(s);
+  os::SurfaceFormatData fd;
+  s->getFormat(&fd);
+
+  const bool rgba32 =
+    (fd.bitsPerPixel == 32 &&
+     fd.redMask   == (uint32_t(0xff) << fd.redShift) &&
+     fd.greenMask == (uint32_t(0xff) << fd.greenShift) &&
+     fd.blueMask  == (uint32_t(0xff) << fd.blueShift) &&
+     fd.alphaMask == (uint32_t(0xff) << fd.alphaShift));
+
+  for (int y=0; y<rc.h; ++y) {
+    if (stop)
+      return false;
+
+    fillRow(y, row.data());
+
+    if (rgba32) {
+      auto dst = (uint32_t*)s->getData(rc.x, rc.y+y);
+      for (int x=0; x<rc.w; ++x) {
+        const gfx::Color c = row[x];
+        dst[x] = ((uint32_t(gfx::getr(c)) << fd.redShift) |
+                  (uint32_t(gfx::getg(c)) << fd.greenShift) |
+                  (uint32_t(gfx::getb(c)) << fd.blueShift) |
+                  (uint32_t(gfx::geta(c)) << fd.alphaShift));
+      }
+    }
+    else {
+      for (int x=0; x<rc.w; ++x)
+        s->putPixel(row[x], rc.x+x, rc.y+y);
+    }
+  }
+
+#if LAF_SKIA
+  // Increment SkBitmap generation ID so it's re-uploaded to the GPU
+  // as a texture if it's needed.
+  if (rgba32)
+    static_cast<os::SkiaSurface*>(s)->bitmap().notifyPixelsChanged();
+#endif
+  return true;
+}
+
 int ColorSelector::onNeedsSurfaceRepaint(const app::Color& newColor)
 {
   return (m_color.getRed()   != newColor.getRed()   ||
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2022  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2016-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -20,6 +20,7 @@
 
 #include <atomic>
 #include <cmath>
+#include <functional>
 
 // TODO We should wrap the SkRuntimeEffect in laf-os, SkRuntimeEffect
 //      and SkRuntimeShaderBuilder might change in future Skia
@@ -90,6 +91,16 @@ namespace app {
                              const gfx::Point& pos,
                              const bool white);
 
+    // Paints the "rc" area of the surface row by row (from the
+    // background thread), "fillRow(y, row)" must fill the rc.w colors
+    // of the y-th row (relative to rc). Pixels are written directly
+    // in 32bpp surfaces. Returns false if the painting was stopped.
+    static bool paintRowsInBgThread(
+      os::Surface* s,
+      const gfx::Rect& rc,
+      const bool& stop,
+      const std::function<void(int y, gfx::Color* row)>& fillRow);
+
     // Returns the 255 if m_color is the mask color, or the
     // m_color.getAlpha() if it's really a color.
     int getCurrentAlphaForNewColor() const;
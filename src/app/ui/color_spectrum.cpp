@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2022  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -15,6 +15,8 @@
 #include "app/ui/skin/skin_theme.h"
 #include "app/ui/status_bar.h"
 #include "app/util/shader_helpers.h"
+#include "gfx/hsv.h"
+#include "gfx/rgb.h"
 #include "os/surface.h"
 #include "ui/graphics.h"
 #include "ui/message.h"
@@ -24,6 +26,8 @@
 #include "ui/system.h"
 
 #include <algorithm>
+#include <cmath>
+#include <vector>
 
 namespace app {
 
@@ -133,25 +137,35 @@ void ColorSpectrum::onPaintSurfaceInBgThread(
   bool& stop)
 {
   if (m_paintFlags & MainAreaFlag) {
-    double sat = m_color.getHslSaturation();
-    int umax = std::max(1, main.w-1);
-    int vmax = std::max(1, main.h-1);
-
-    for (int y=0; y<main.h && !stop; ++y) {
-      for (int x=0; x<main.w && !stop; ++x) {
-        double hue = 360.0 * double(x) / double(umax);
-        double lit = 1.0 - double(y) / double(vmax);
-
-        gfx::Color color = color_utils::color_for_ui(
-          app::Color::fromHsl(
-            std::clamp(hue, 0.0, 360.0),
-            sat,
-            std::clamp(lit, 0.0, 1.0)));
-
-        s->putPixel(color, main.x+x, main.y+y);
-      }
+    const double sat = m_color.getHslSaturation();
+    const int umax = std::max(1, main.w-1);
+    const int vmax = std::max(1, main.h-1);
+
+    // Each component of a HSL color is lit + chroma*(hueRgb - 0.5),
+    // where hueRgb is the component of the pure hue (full saturation
+    // and value), so we convert the hue of each column just once.
+    std::vector<double> hues(3*main.w);
+    for (int x=0; x<main.w; ++x) {
+      const double hue = 360.0 * double(x) / double(umax);
+      const gfx::Rgb rgb(gfx::Hsv(std::clamp(hue, 0.0, 360.0), 1.0, 1.0));
+      hues[3*x  ] = rgb.red()   / 255.0 - 0.5;
+      hues[3*x+1] = rgb.green() / 255.0 - 0.5;
+      hues[3*x+2] = rgb.blue()  / 255.0 - 0.5;
     }
-    if (stop)
+
+    if (!paintRowsInBgThread(
+          s, main, stop,
+          [&hues, sat, vmax](const int y, gfx::Color* row) {
+            const double lit = std::clamp(1.0 - double(y) / double(vmax), 0.0, 1.0);
+            const double l = 255.0 * lit + 0.5;
+            const double c = 255.0 * (1.0 - std::fabs(2.0*lit - 1.0)) * sat;
+            const double* h = hues.data();
+            for (int x=0; x<int(hues.size()/3); ++x, h+=3) {
+              row[x] = gfx::rgba(std::clamp(int(l + c*h[0]), 0, 255),
+                                 std::clamp(int(l + c*h[1]), 0, 255),
+                                 std::clamp(int(l + c*h[2]), 0, 255));
+            }
+          }))
       return;
     m_paintFlags ^= MainAreaFlag;
   }
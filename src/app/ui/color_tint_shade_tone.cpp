@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2022  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2016-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -15,9 +15,12 @@
 #include "app/pref/preferences.h"
 #include "app/ui/skin/skin_theme.h"
 #include "app/util/shader_helpers.h"
+#include "gfx/hsv.h"
+#include "gfx/rgb.h"
 #include "ui/graphics.h"
 
 #include <algorithm>
+#include <vector>
 
 namespace app {
 
@@ -162,21 +165,34 @@ void ColorTintShadeTone::onPaintSurfaceInBgThread(
   int vmax = std::max(1, main.h-1);
 
   if (m_paintFlags & MainAreaFlag) {
-    for (int y=0; y<main.h && !stop; ++y) {
-      for (int x=0; x<main.w && !stop; ++x) {
-        double sat = double(x) / double(umax);
-        double val = 1.0 - double(y) / double(vmax);
-
-        gfx::Color color = color_utils::color_for_ui(
-          app::Color::fromHsv(
-            hue,
-            std::clamp(sat, 0.0, 1.0),
-            std::clamp(val, 0.0, 1.0)));
-
-        s->putPixel(color, main.x+x, main.y+y);
-      }
+    // Each component of a HSV color is val*(1 - sat*(1 - hueRgb)),
+    // where hueRgb is the component of the pure hue, so we calculate
+    // the (1 - sat*(1 - hueRgb)) factors of each column once and
+    // then each row is just scaled by its value.
+    const gfx::Rgb hueRgb(gfx::Hsv(hue, 1.0, 1.0));
+    const double hr = 1.0 - hueRgb.red()   / 255.0;
+    const double hg = 1.0 - hueRgb.green() / 255.0;
+    const double hb = 1.0 - hueRgb.blue()  / 255.0;
+
+    std::vector<double> factors(3*main.w);
+    for (int x=0; x<main.w; ++x) {
+      const double sat = std::clamp(double(x) / double(umax), 0.0, 1.0);
+      factors[3*x  ] = 1.0 - sat*hr;
+      factors[3*x+1] = 1.0 - sat*hg;
+      factors[3*x+2] = 1.0 - sat*hb;
     }
-    if (stop)
+
+    if (!paintRowsInBgThread(
+          s, main, stop,
+          [&factors, vmax](const int y, gfx::Color* row) {
+            const double val = 255.0 * std::clamp(1.0 - double(y) / double(vmax), 0.0, 1.0);
+            const double* f = factors.data();
+            for (int x=0; x<int(factors.size()/3); ++x, f+=3) {
+              row[x] = gfx::rgba(int(val*f[0] + 0.5),
+                                 int(val*f[1] + 0.5),
+                                 int(val*f[2] + 0.5));
+            }
+          }))
       return;
     m_paintFlags ^= MainAreaFlag;
   }
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2022  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -18,6 +18,8 @@
 #include "app/ui/status_bar.h"
 #include "app/util/shader_helpers.h"
 #include "base/pi.h"
+#include "gfx/hsv.h"
+#include "gfx/rgb.h"
 #include "os/surface.h"
 #include "ui/graphics.h"
 #include "ui/menu.h"
@@ -280,33 +282,12 @@ app::Color ColorWheel::getMainAreaColor(const int _u, const int umax,
 
   // Pick from the wheel
   if (d <= m_wheelRadius) {
-    double a = std::atan2(-v, u);
-
-    int hue = (int(180.0 * a / PI)
-               + 180            // To avoid [-180,0) range
-               + 180 + 30       // To locate green at 12 o'clock
-               );
-    if (m_discrete) {
-      hue += 15;
-      hue /= 30;
-      hue *= 30;
-    }
-    hue %= 360;                 // To leave hue in [0,360) range
-    hue = convertHueAngle(hue, 1);
-
-    int sat;
-    if (m_discrete) {
-      sat = int(120.0 * d / m_wheelRadius);
-      sat /= 20;
-      sat *= 20;
-    }
-    else {
-      sat = int(100.0 * d / m_wheelRadius);
-    }
+    int hue;
+    double sat;
+    getWheelHueSat(u, v, d, hue, sat);
 
     return app::Color::fromHsv(
-      std::clamp(hue, 0, 360),
-      std::clamp(sat / 100.0, 0.0, 1.0),
+      hue, sat,
       (m_color.getType() != Color::MaskType ? m_color.getHsvValue(): 1.0),
       getCurrentAlphaForNewColor());
   }
@@ -314,6 +295,74 @@ app::Color ColorWheel::getMainAreaColor(const int _u, const int umax,
   return app::Color::fromMask();
 }
 
+void ColorWheel::getWheelHueSat(const int u, const int v, const double d,
+                                int& hue, double& sat) const
+{
+  double a = std::atan2(-v, u);
+
+  hue = (int(180.0 * a / PI)
+         + 180            // To avoid [-180,0) range
+         + 180 + 30       // To locate green at 12 o'clock
+         );
+  if (m_discrete) {
+    hue += 15;
+    hue /= 30;
+    hue *= 30;
+  }
+  hue %= 360;             // To leave hue in [0,360) range
+  hue = convertHueAngle(hue, 1);
+  hue = std::clamp(hue, 0, 360);
+
+  int isat;
+  if (m_discrete) {
+    isat = int(120.0 * d / m_wheelRadius);
+    isat /= 20;
+    isat *= 20;
+  }
+  else {
+    isat = int(100.0 * d / m_wheelRadius);
+  }
+  sat = std::clamp(isat / 100.0, 0.0, 1.0);
+}
+
+void ColorWheel::updateWheelCache(const gfx::Size& size)
+{
+  WheelCache& cache = m_wheelCache;
+  if (cache.size == size &&
+      cache.radius == m_wheelRadius &&
+      cache.discrete == m_discrete &&
+      cache.colorModel == m_colorModel) {
+    return;
+  }
+
+  cache.size = size;
+  cache.radius = m_wheelRadius;
+  cache.discrete = m_discrete;
+  cache.colorModel = m_colorModel;
+  cache.colors.resize(size.w*size.h);
+
+  const int umax = std::max(1, size.w-1);
+  const int vmax = std::max(1, size.h-1);
+  gfx::Color* dst = cache.colors.data();
+  for (int y=0; y<size.h; ++y) {
+    const int v = y - vmax/2;
+    for (int x=0; x<size.w; ++x, ++dst) {
+      const int u = x - umax/2;
+      const double d = std::sqrt(u*u + v*v);
+      if (d <= m_wheelRadius) {
+        int hue;
+        double sat;
+        getWheelHueSat(u, v, d, hue, sat);
+
+        const gfx::Rgb rgb(gfx::Hsv(hue, sat, 1.0));
+        *dst = gfx::rgba(rgb.red(), rgb.green(), rgb.blue());
+      }
+      else
+        *dst = gfx::ColorNone;
+    }
+  }
+}
+
 app::Color ColorWheel::getBottomBarColor(const int u, const int umax)
 {
   double val = double(u) / double(umax);
@@ -414,28 +463,54 @@ void ColorWheel::onPaintSurfaceInBgThread(os::Surface* s,
                                           bool& stop)
 {
   if (m_paintFlags & MainAreaFlag) {
-    int umax = std::max(1, main.w-1);
-    int vmax = std::max(1, main.h-1);
-
-    for (int y=0; y<main.h && !stop; ++y) {
-      for (int x=0; x<main.w && !stop; ++x) {
-        app::Color appColor =
-          getMainAreaColor(x, umax,
-                           y, vmax);
-
-        gfx::Color color;
-        if (appColor.getType() != app::Color::MaskType) {
-          appColor.setAlpha(255);
-          color = color_utils::color_for_ui(appColor);
-        }
-        else {
-          color = m_bgColor;
-        }
-
-        s->putPixel(color, main.x+x, main.y+y);
-      }
+    bool painted;
+
+    if (m_colorModel == ColorModel::NORMAL_MAP) {
+      const int umax = std::max(1, main.w-1);
+      const int vmax = std::max(1, main.h-1);
+
+      painted = paintRowsInBgThread(
+        s, main, stop,
+        [this, &main, umax, vmax](const int y, gfx::Color* row) {
+          for (int x=0; x<main.w; ++x) {
+            app::Color appColor =
+              getMainAreaColor(x, umax,
+                               y, vmax);
+
+            if (appColor.getType() != app::Color::MaskType) {
+              appColor.setAlpha(255);
+              row[x] = color_utils::color_for_ui(appColor);
+            }
+            else {
+              row[x] = m_bgColor;
+            }
+          }
+        });
     }
-    if (stop)
+    else {
+      updateWheelCache(main.size());
+
+      const double val =
+        (m_color.getType() != Color::MaskType ? m_color.getHsvValue(): 1.0);
+      const gfx::Color* colors = m_wheelCache.colors.data();
+      const gfx::Color bgColor = m_bgColor;
+
+      painted = paintRowsInBgThread(
+        s, main, stop,
+        [colors, &main, val, bgColor](const int y, gfx::Color* row) {
+          const gfx::Color* src = colors + y*main.w;
+          for (int x=0; x<main.w; ++x) {
+            const gfx::Color c = src[x];
+            if (c == gfx::ColorNone)
+              row[x] = bgColor;
+            else
+              row[x] = gfx::rgba(int(gfx::getr(c)*val + 0.5),
+                                 int(gfx::getg(c)*val + 0.5),
+                                 int(gfx::getb(c)*val + 0.5));
+          }
+        });
+    }
+    if (!painted)
       return;
     m_paintFlags ^= MainAreaFlag;
   }
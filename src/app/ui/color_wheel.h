@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2021-2022  Igara Studio S.A.
+// Copyright (C) 2021-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -10,8 +10,11 @@
 #pragma once
 
 #include "app/ui/color_selector.h"
+#include "gfx/size.h"
 #include "ui/button.h"
 
+#include <vector>
+
 namespace app {
 
   class ColorWheel : public ColorSelector {
@@ -72,6 +75,14 @@ namespace app {
     // With dir == -1, the angle came from HSV and is converted to the current color model.
     float convertHueAngle(float angle, int dir) const;
 
+    // Returns the HSV hue/saturation of the wheel at the given
+    // position relative to the wheel center, where "d" is the
+    // distance to the center.
+    void getWheelHueSat(const int u, const int v, const double d,
+                        int& hue, double& sat) const;
+
+    void updateWheelCache(const gfx::Size& size);
+
     std::string m_mainShader;
     std::string m_bottomShader;
     gfx::Rect m_wheelBounds;
@@ -82,6 +93,19 @@ namespace app {
     Harmony m_harmony;
     ui::Button m_options;
 
+    // Colors of the wheel with value=1.0 (gfx::ColorNone outside the
+    // wheel) to paint the main area from the background thread. The
+    // RGB components of a HSV color are proportional to its value, so
+    // when the value of the selected color changes we just scale
+    // these colors.
+    struct WheelCache {
+      gfx::Size size;
+      double radius = 0.0;
+      bool discrete = false;
+      ColorModel colorModel = ColorModel::RGB;
+      std::vector<gfx::Color> colors;
+    } m_wheelCache;
+
     // Internal flag used to know if after pickColor() we selected an
     // harmony.
     mutable bool m_harmonyPicked;
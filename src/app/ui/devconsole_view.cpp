@@ -17,8 +17,12 @@
 
 #include "app/app.h"
 #include "app/app_menus.h"
+#include "app/context.h"
+#include "app/memory_usage.h"
+#include "app/profiler.h"
 #include "app/ui/skin/skin_theme.h"
 #include "app/ui/workspace.h"
+#include "base/fs.h"
 #include "fmt/format.h"
 #include "ui/entry.h"
 #include "ui/message.h"
@@ -71,6 +75,8 @@ DevConsoleView::DevConsoleView()
                           get_app_name(), get_app_version()), LEFT)
   , m_label(">")
   , m_entry(new CommmandEntry)
+  , m_trace("Trace")
+  , m_memory("Memory")
   , m_engine(App::instance()->scriptEngine())
 {
   m_engine->setDelegate(this);
@@ -80,6 +86,8 @@ DevConsoleView::DevConsoleView()
 
   m_bottomBox.addChild(&m_label);
   m_bottomBox.addChild(m_entry);
+  m_bottomBox.addChild(&m_trace);
+  m_bottomBox.addChild(&m_memory);
 
   m_view.attachToView(&m_textBox);
   m_view.setExpansive(true);
@@ -87,6 +95,10 @@ DevConsoleView::DevConsoleView()
   m_entry->setExpansive(true);
   m_entry->ExecuteCommand.connect(&DevConsoleView::onExecuteCommand, this);
 
+  m_trace.setSelected(is_profiler_enabled());
+  m_trace.Click.connect(&DevConsoleView::onToggleTrace, this);
+  m_memory.Click.connect(&DevConsoleView::onMemoryReport, this);
+
   InitTheme.connect(
     [this]{
       auto theme = SkinTheme::get(this);
@@ -154,6 +166,31 @@ void DevConsoleView::onExecuteCommand(const std::string& cmd)
   m_engine->evalCode(cmd);
 }
 
+void DevConsoleView::onToggleTrace()
+{
+  if (m_trace.isSelected()) {
+    start_profiler();
+    onConsolePrint("Profiler started, uncheck \"Trace\" to save the trace file");
+  }
+  else {
+    stop_profiler();
+
+    const std::string fn =
+      base::join_path(base::get_temp_path(),
+                      fmt::format("{}-trace.json", get_app_name()));
+    if (save_profiler_trace(fn))
+      onConsolePrint(fmt::format("Trace saved in {}", fn).c_str());
+    else
+      onConsoleError(fmt::format("Error saving trace file {}", fn).c_str());
+  }
+}
+
+void DevConsoleView::onMemoryReport()
+{
+  onConsolePrint(
+    get_memory_usage_report(App::instance()->context()->documents()).c_str());
+}
+
 void DevConsoleView::onConsoleError(const char* text)
 {
   onConsolePrint(text);
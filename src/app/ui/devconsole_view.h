@@ -16,6 +16,7 @@
 #include "app/ui/tabs.h"
 #include "app/ui/workspace_view.h"
 #include "ui/box.h"
+#include "ui/button.h"
 #include "ui/label.h"
 #include "ui/textbox.h"
 #include "ui/view.h"
@@ -49,6 +50,8 @@ namespace app {
   protected:
     bool onProcessMessage(ui::Message* msg) override;
     void onExecuteCommand(const std::string& cmd);
+    void onToggleTrace();
+    void onMemoryReport();
 
   private:
     class CommmandEntry;
@@ -58,6 +61,8 @@ namespace app {
     ui::HBox m_bottomBox;
     ui::Label m_label;
     CommmandEntry* m_entry;
+    ui::CheckBox m_trace;
+    ui::Button m_memory;
     script::Engine* m_engine;
   };
 
@@ -20,6 +20,7 @@
 #include "app/console.h"
 #include "app/context_access.h"
 #include "app/doc_access.h"
+#include "app/doc_changes.h"
 #include "app/doc_event.h"
 #include "app/i18n/strings.h"
 #include "app/modules/palettes.h"
@@ -403,6 +404,16 @@ void DocView::onGeneralUpdate(DocEvent& ev)
     m_editor->updateEditor(true);
 }
 
+void DocView::onDocChanges(DocEvent& ev, const DocChanges& changes)
+{
+  // Redraw only the modified region of the current frame
+  if (m_editor->isVisible() && !changes.all()) {
+    const gfx::Region rgn = changes.frameRegion(m_editor->frame());
+    if (!rgn.isEmpty())
+      m_editor->drawSpriteClipped(rgn);
+  }
+}
+
 void DocView::onSpritePixelsModified(DocEvent& ev)
 {
   if (m_editor->isVisible() &&
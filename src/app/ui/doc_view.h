@@ -80,6 +80,7 @@ namespace app {
 
     // DocObserver implementation
     void onGeneralUpdate(DocEvent& ev) override;
+    void onDocChanges(DocEvent& ev, const DocChanges& changes) override;
     void onSpritePixelsModified(DocEvent& ev) override;
     void onLayerMergedDown(DocEvent& ev) override;
     void onAddLayer(DocEvent& ev) override;
@@ -43,6 +43,7 @@
 #include "os/window.h"
 #include "render/render.h"
 #include "ui/manager.h"
+#include "ui/overlay_manager.h"
 #include "ui/system.h"
 
 #include <array>
@@ -103,6 +104,7 @@ BrushPreview::BrushPreview(Editor* editor)
 
 BrushPreview::~BrushPreview()
 {
+  hideBoundariesOverlay();
 }
 
 BrushRef BrushPreview::getCurrentBrush()
@@ -422,6 +424,10 @@ void BrushPreview::show(const gfx::Point& screenPos)
       createCrosshairCursor(&g, uiCursorColor);
     }
 
+    if (m_type & BRUSH_BOUNDARIES)
+      m_boundariesInOverlay =
+        showBoundariesInOverlay(spritePos, uiCursorColor, tilemapMode);
+
     forEachBrushPixel(&g, spritePos, uiCursorColor, &BrushPreview::savePixelDelegate);
     forEachBrushPixel(&g, spritePos, uiCursorColor, &BrushPreview::drawPixelDelegate);
     m_withModifiedPixels = true;
@@ -472,6 +478,8 @@ void BrushPreview::hide()
                       &BrushPreview::clearPixelDelegate);
   }
 
+  hideBoundariesOverlay();
+
   // Clean pixel/brush preview
   if (m_withRealPreview) {
     Doc* document = m_editor->document();
@@ -577,6 +585,7 @@ void BrushPreview::generateBoundaries(const Site& site,
   }
 
   m_brushBoundaries.regen(mask ? mask: brushImage);
+  ++m_boundariesGen;
   if (tilemapMode == TilemapMode::Pixels) {
     if (!isOnePixel)
       m_brushBoundaries.offset(-brush->center().x,
@@ -589,6 +598,107 @@ void BrushPreview::generateBoundaries(const Site& site,
     delete mask;
 }
 
+bool BrushPreview::showBoundariesInOverlay(const gfx::Point& spritePos,
+                                           const gfx::Color color,
+                                           const TilemapMode tilemapMode)
+{
+  ASSERT(!m_boundariesInOverlay);
+
+  // The black & white negative color depends on each display pixel,
+  // and tiles boundaries change their offset in each position.
+  if (m_blackAndWhiteNegative ||
+      tilemapMode != TilemapMode::Pixels ||
+      m_brushBoundaries.isEmpty())
+    return false;
+
+  // With an integer scale each segment is translated to the screen
+  // with the same offset, so the same surface can be used in any
+  // position.
+  const render::Projection& proj = m_editor->projection();
+  const double scaleX = proj.scaleX();
+  const double scaleY = proj.scaleY();
+  if (scaleX < 1.0 || scaleX != int(scaleX) ||
+      scaleY < 1.0 || scaleY != int(scaleY))
+    return false;
+
+  ui::Display* display = m_editor->display();
+  if (!m_overlay ||
+      m_overlayDisplay != display ||
+      m_overlayBoundariesGen != m_boundariesGen ||
+      m_overlayScaleX != scaleX ||
+      m_overlayScaleY != scaleY ||
+      m_overlayColor != color) {
+    // Lines of each segment (in the same way traceBrushBoundaries()
+    // does) relative to the sprite position
+    std::vector<gfx::Rect> lines;
+    gfx::Rect linesBounds;
+    for (const auto& seg : m_brushBoundaries) {
+      gfx::Rect bounds = proj.apply(seg.bounds());
+      if (seg.open()) {
+        if (seg.vertical()) --bounds.x;
+        else --bounds.y;
+      }
+      if (seg.vertical())
+        bounds.w = 1;
+      else
+        bounds.h = 1;
+      lines.push_back(bounds);
+      linesBounds |= bounds;
+    }
+    if (linesBounds.isEmpty())
+      return false;
+
+    os::SurfaceRef surface = os::instance()->makeRgbaSurface(
+      linesBounds.w, linesBounds.h);
+    {
+      os::SurfaceLock lock(surface.get());
+      os::Paint paint;
+      paint.color(gfx::rgba(0, 0, 0, 0));
+      paint.style(os::Paint::Fill);
+      surface->drawRect(gfx::Rect(0, 0, surface->width(), surface->height()), paint);
+
+      paint.color(color);
+      for (gfx::Rect line : lines) {
+        line.offset(-linesBounds.origin());
+        surface->drawRect(line, paint);
+      }
+    }
+    surface->setImmutable();
+
+    m_overlay = base::make_ref<ui::Overlay>(
+      display, surface, gfx::Point(),
+      (ui::Overlay::ZOrder)(ui::Overlay::MouseZOrder-1));
+    m_overlayDisplay = display;
+    m_overlayBoundariesGen = m_boundariesGen;
+    m_overlayScaleX = scaleX;
+    m_overlayScaleY = scaleY;
+    m_overlayColor = color;
+    m_overlayOffset = linesBounds.origin();
+  }
+
+  const gfx::Point pos = m_editor->editorToScreen(spritePos) + m_overlayOffset;
+  const gfx::Rect bounds(pos, m_overlay->bounds().size());
+
+  // Use the pixel delegates if some part of the boundaries must be
+  // clipped (e.g. there is a window above the editor).
+  gfx::Region hidden(bounds);
+  hidden.createSubtraction(hidden, m_clippingRegion);
+  if (!hidden.isEmpty())
+    return false;
+
+  m_overlay->moveOverlay(pos);
+  ui::OverlayManager::instance()->addOverlay(m_overlay);
+  return true;
+}
+
+void BrushPreview::hideBoundariesOverlay()
+{
+  if (m_boundariesInOverlay) {
+    ui::OverlayManager::instance()->removeOverlay(m_overlay);
+    m_boundariesInOverlay = false;
+  }
+}
+
 void BrushPreview::createCrosshairCursor(ui::Graphics* g,
                                          const gfx::Color cursorColor)
 {
@@ -771,7 +881,7 @@ void BrushPreview::forEachBrushPixel(
   if (m_type & SELECTION_CROSSHAIR)
     traceSelectionCrossPixels(g, spritePos, color, 1, pixelDelegate);
 
-  if (m_type & BRUSH_BOUNDARIES)
+  if ((m_type & BRUSH_BOUNDARIES) && !m_boundariesInOverlay)
     traceBrushBoundaries(g, spritePos, color, pixelDelegate);
 
   m_savedPixelsLimit = m_savedPixelsIterator;
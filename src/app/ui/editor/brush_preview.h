@@ -20,6 +20,7 @@
 #include "gfx/region.h"
 #include "os/surface.h"
 #include "ui/cursor.h"
+#include "ui/overlay.h"
 
 #include <vector>
 
@@ -29,6 +30,7 @@ namespace doc {
 }
 
 namespace ui {
+  class Display;
   class Graphics;
 }
 
@@ -99,6 +101,16 @@ namespace app {
     void generateBoundaries(const Site& site,
                             const gfx::Point& spritePos);
 
+    // Shows the brush boundaries in a ui::Overlay instead of
+    // modifying the display pixels. Returns false if the boundaries
+    // cannot be displayed in the overlay (e.g. black & white
+    // negative, a non-integer zoom level, or the boundaries are
+    // partially hidden by a window).
+    bool showBoundariesInOverlay(const gfx::Point& spritePos,
+                                 const gfx::Color color,
+                                 const TilemapMode tilemapMode);
+    void hideBoundariesOverlay();
+
     // Creates a little native cursor to draw the CROSSHAIR
     void createCrosshairCursor(ui::Graphics* g, const gfx::Color cursorColor);
 
@@ -133,6 +145,21 @@ namespace app {
     doc::MaskBoundaries m_brushBoundaries;
     int m_brushGen;
 
+    // Incremented each time m_brushBoundaries is regenerated.
+    int m_boundariesGen = 0;
+
+    // Brush boundaries rendered in a surface (cached for the
+    // boundaries generation, zoom level, and color) and displayed in
+    // an overlay, so moving the mouse doesn't touch the display pixels.
+    ui::OverlayRef m_overlay;
+    ui::Display* m_overlayDisplay = nullptr;
+    bool m_boundariesInOverlay = false;
+    int m_overlayBoundariesGen = -1;
+    double m_overlayScaleX = 0.0;
+    double m_overlayScaleY = 0.0;
+    gfx::Color m_overlayColor = gfx::ColorNone;
+    gfx::Point m_overlayOffset;
+
     // True if we've modified pixels in the display surface
     // (e.g. drawing the selection crosshair or the brush edges).
     bool m_withModifiedPixels = false;
@@ -14,6 +14,7 @@
 #include "app/commands/command.h"
 #include "app/commands/commands.h"
 #include "app/commands/params.h"
+#include "app/pref/preferences.h"
 #include "app/tools/controller.h"
 #include "app/tools/ink.h"
 #include "app/tools/tool.h"
@@ -28,6 +29,7 @@
 #include "app/ui_context.h"
 #include "base/scoped_value.h"
 #include "doc/layer.h"
+#include "ui/manager.h"
 #include "ui/message.h"
 #include "ui/system.h"
 
@@ -59,6 +61,23 @@ static int get_delay_interval_for_tool_loop(tools::ToolLoop* toolLoop)
   }
 }
 
+// Coalesce the movements of freehand tools that accumulate the
+// painted points (the result is the same drawing the points one by
+// one or all together).
+static bool can_coalesce_movements_for_tool_loop(tools::ToolLoop* toolLoop)
+{
+  return (Preferences::instance().experimental.coalescePointerEvents() &&
+          toolLoop->getTracePolicy() == tools::TracePolicy::Accumulate &&
+          toolLoop->getController()->isFreehand());
+}
+
+static int get_frame_interval()
+{
+  // Use the max frame rate of the UI (or 60 fps if there is no limit)
+  const int fps = Manager::getDefault()->maxFrameRate();
+  return (fps > 0 ? std::max(1, 1000 / fps): 16);
+}
+
 DrawingState::DrawingState(Editor* editor,
                            tools::ToolLoop* toolLoop,
                            const DrawingType type)
@@ -69,9 +88,13 @@ DrawingState::DrawingState(Editor* editor,
   , m_toolLoop(toolLoop)
   , m_toolLoopManager(new tools::ToolLoopManager(toolLoop))
   , m_mouseMoveReceived(false)
+  , m_coalesceMovements(can_coalesce_movements_for_tool_loop(toolLoop))
+  , m_frameTimer(get_frame_interval())
   , m_mousePressedReceived(false)
   , m_processScrollChange(true)
 {
+  m_frameTimer.Tick.connect([this]{ onFrameTick(); });
+
   m_beforeCmdConn =
     UIContext::instance()->BeforeCommandExecution.connect(
       &DrawingState::onBeforeCommandExecution, this);
@@ -138,14 +161,17 @@ void DrawingState::disableMouseStabilizer()
 void DrawingState::sendMovementToToolLoop(const tools::Pointer& pointer)
 {
   ASSERT(m_toolLoopManager);
+  flushPendingMovements();
   m_lastPointer = pointer;
   m_toolLoopManager->movement(pointer);
 }
 
 void DrawingState::notifyToolLoopModifiersChange(Editor* editor)
 {
-  if (!m_toolLoopManager->isCanceled())
+  if (!m_toolLoopManager->isCanceled()) {
+    flushPendingMovements();
     m_toolLoopManager->notifyToolLoopModifiersChange();
+  }
 }
 
 void DrawingState::onBeforePopState(Editor* editor)
@@ -210,6 +236,10 @@ bool DrawingState::onMouseUp(Editor* editor, MouseMessage* msg)
   m_lastPointer = pointer_from_msg(editor, msg, m_velocity.velocity());
   m_delayedMouseMove.onMouseUp(msg);
 
+  // Draw the pending movements before releasing the button
+  flushPendingMovements();
+  m_frameTimer.stop();
+
   // Selection tools with Replace mode are cancelled with a simple click.
   // ("one point" controller selection tool i.e. the magic wand, and
   // selection tools with Add or Subtract mode aren't cancelled with
@@ -289,11 +319,30 @@ bool DrawingState::onMouseMove(Editor* editor, MouseMessage* msg)
 void DrawingState::onCommitMouseMove(Editor* editor,
                                      const gfx::PointF& spritePos)
 {
-  if (m_toolLoop &&
-      m_toolLoopManager &&
-      !m_toolLoopManager->isCanceled()) {
-    handleMouseMovement();
+  if (!m_toolLoop ||
+      !m_toolLoopManager ||
+      m_toolLoopManager->isCanceled())
+    return;
+
+  editor->markToolLoopInput();
+
+  // Use the position that was just committed (m_lastPointer was
+  // created with the previous one in onMouseMove())
+  m_lastPointer = tools::Pointer(gfx::Point(spritePos),
+                                 m_lastPointer.velocity(),
+                                 m_lastPointer.button(),
+                                 m_lastPointer.type(),
+                                 m_lastPointer.pressure());
+
+  if (m_coalesceMovements) {
+    m_pendingPointers.push_back(m_lastPointer);
+    if (!m_frameTimer.isRunning()) {
+      flushPendingMovements();
+      m_frameTimer.start();
+    }
   }
+  else
+    handleMouseMovement();
 }
 
 bool DrawingState::onSetCursor(Editor* editor, const gfx::Point& mouseScreenPos)
@@ -392,9 +441,41 @@ void DrawingState::handleMouseMovement()
 {
   // Notify mouse movement to the tool
   ASSERT(m_toolLoopManager);
+  flushPendingMovements();
   m_toolLoopManager->movement(m_lastPointer);
 }
 
+void DrawingState::flushPendingMovements()
+{
+  if (m_pendingPointers.empty())
+    return;
+
+  std::vector<tools::Pointer> pointers;
+  std::swap(pointers, m_pendingPointers);
+
+  if (m_toolLoopManager &&
+      !m_toolLoopManager->isCanceled()) {
+    m_toolLoopManager->movement(pointers);
+  }
+}
+
+void DrawingState::onFrameTick()
+{
+  // Stop the timer when the pen doesn't move in a whole frame, so the
+  // next movement is sent immediately.
+  if (m_pendingPointers.empty()) {
+    m_frameTimer.stop();
+    return;
+  }
+
+  try {
+    flushPendingMovements();
+  }
+  catch (const std::exception& ex) {
+    m_editor->showUnhandledException(ex, nullptr);
+  }
+}
+
 bool DrawingState::canInterpretMouseMovementAsJustOneClick()
 {
   // If the user clicked (pressed and released the mouse button) in
@@ -453,6 +534,9 @@ void DrawingState::destroyLoopIfCanceled(Editor* editor)
 
 void DrawingState::destroyLoop(Editor* editor)
 {
+  m_frameTimer.stop();
+  m_pendingPointers.clear();
+
   if (editor)
     editor->renderEngine().removePreviewImage();
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -15,7 +15,10 @@
 #include "app/ui/editor/standby_state.h"
 #include "base/time.h"
 #include "obs/connection.h"
+#include "ui/timer.h"
+
 #include <memory>
+#include <vector>
 
 namespace app {
   namespace tools {
@@ -72,6 +75,8 @@ namespace app {
 
   private:
     void handleMouseMovement();
+    void flushPendingMovements();
+    void onFrameTick();
     bool canInterpretMouseMovementAsJustOneClick();
     bool canExecuteCommands();
     void onBeforeCommandExecution(CommandExecutionEvent& ev);
@@ -104,6 +109,16 @@ namespace app {
     // button when onScrollChange() event is received.
     tools::Pointer m_lastPointer;
 
+    // Freehand movements received in the same frame are coalesced in
+    // just one ToolLoopManager::movement() call, so a high-frequency
+    // pen doesn't produce one loop step + invalidation per event. The
+    // first movement is sent immediately (to avoid adding latency
+    // when the pen moves slowly) and then the timer sends the pending
+    // ones once per frame.
+    bool m_coalesceMovements;
+    std::vector<tools::Pointer> m_pendingPointers;
+    ui::Timer m_frameTimer;
+
     // Used to calculate the velocity of the mouse (whch is a sensor
     // to generate dynamic parameters).
     tools::VelocitySensor m_velocity;
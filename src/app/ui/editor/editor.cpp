@@ -27,6 +27,7 @@
 #include "app/modules/gui.h"
 #include "app/modules/palettes.h"
 #include "app/pref/preferences.h"
+#include "app/profiler.h"
 #include "app/snap_to_grid.h"
 #include "app/tools/active_tool.h"
 #include "app/tools/controller.h"
@@ -40,10 +41,13 @@
 #include "app/ui/editor/editor_customization_delegate.h"
 #include "app/ui/editor/editor_decorator.h"
 #include "app/ui/editor/editor_render.h"
+#include "app/ui/editor/editor_render_worker.h"
+#include "app/ui/editor/editor_tile_cache.h"
 #include "app/ui/editor/glue.h"
 #include "app/ui/editor/moving_pixels_state.h"
 #include "app/ui/editor/pixels_movement.h"
 #include "app/ui/editor/play_state.h"
+#include "app/ui/editor/playback_frame_cache.h"
 #include "app/ui/editor/scrolling_state.h"
 #include "app/ui/editor/standby_state.h"
 #include "app/ui/editor/zooming_state.h"
@@ -73,6 +77,9 @@
 #include <cstdio>
 #include <limits>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace app {
 
@@ -169,6 +176,8 @@ Editor::Editor(Doc* document, EditorFlags flags, EditorStatePtr state)
   if (!m_renderEngine)
     m_renderEngine = std::make_unique<EditorRender>();
 
+  m_tileCache = std::make_unique<EditorTileCache>();
+
   m_proj.setPixelRatio(m_sprite->pixelRatio());
 
   // Add the first state into the history.
@@ -228,6 +237,10 @@ Editor::~Editor()
     m_docPref.site.layer(layerIndex);
   }
 
+  // Wait the tile/frames that are being rendered in background
+  m_renderWorker.reset();
+  m_playbackCache.reset();
+
   m_observers.notifyDestroyEditor(this);
   m_document->remove_observer(this);
   App::instance()->activeToolManager()->remove_observer(this);
@@ -349,6 +362,11 @@ void Editor::getInvalidDecoratoredRegion(gfx::Region& region)
       region |= gfx::Region(m_perfInfoBounds);
   }
 #endif // ENABLE_DEVMODE
+
+  if (Preferences::instance().perf.showFrameStats()) {
+    if (!m_frameStatsBounds.isEmpty())
+      region |= gfx::Region(m_frameStatsBounds);
+  }
 }
 
 void Editor::setLayer(const Layer* layer)
@@ -664,6 +682,8 @@ void Editor::drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& sprite
   // Convert the render to a os::Surface
   static os::SurfaceRef rendered = nullptr; // TODO move this to other centralized place
   const auto& renderProperties = m_renderEngine->properties();
+  bool useTileCache = false;
+  os::SurfaceRef playbackFrame; // Frame rendered ahead by the PlayState
   try {
     // Generate a "expose sprite pixels" notification. This is used by
     // tool managers that need to validate this region (copy pixels from
@@ -677,8 +697,10 @@ void Editor::drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& sprite
     m_renderEngine->setupBackground(m_document, IMAGE_RGB);
     m_renderEngine->disableOnionskin();
 
+    bool onionskin = false;
     if ((m_flags & kShowOnionskin) == kShowOnionskin) {
       if (m_docPref.onionskin.active()) {
+        onionskin = true;
         OnionskinOptions opts(
           (m_docPref.onionskin.type() == app::gen::OnionskinType::MERGE ?
            render::OnionskinType::MERGE:
@@ -713,6 +735,18 @@ void Editor::drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& sprite
         m_layer, m_frame);
     }
 
+    // The tile cache is used when the render depends only on the
+    // sprite cels (without previews of tools, extra cels, or onion
+    // skin) and the rendered tiles can be drawn separately on the
+    // screen (without linear filtering between tiles).
+    useTileCache =
+      (!onionskin &&
+       !(extraCel && extraCel->type() != render::ExtraType::NONE) &&
+       !m_renderEngine->hasPreviewImage() &&
+       !(newEngine &&
+         (m_proj.scaleX() < 1.0 || m_proj.scaleY() < 1.0) &&
+         pref.editor.downsampling() != gen::Downsampling::NEAREST));
+
     // Render background first (e.g. new ShaderRenderer will paint the
     // background on the screen first and then composite the rendered
     // sprite on it.)
@@ -726,21 +760,66 @@ void Editor::drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& sprite
                   m_proj.apply(rc2)));
     }
 
-    // Create a temporary surface to draw the sprite on it
-    if (!rendered ||
-        rendered->width() < rc2.w ||
-        rendered->height() < rc2.h ||
-        rendered->colorSpace() != m_document->osColorSpace()) {
-      const int maxw = std::max(rc2.w, rendered ? rendered->width(): 0);
-      const int maxh = std::max(rc2.h, rendered ? rendered->height(): 0);
-      rendered = os::instance()->makeRgbaSurface(
-        maxw, maxh, m_document->osColorSpace());
-    }
-
     m_renderEngine->setProjection(
       newEngine ? render::Projection(): m_proj);
-    m_renderEngine->renderSprite(
-      rendered.get(), m_sprite, m_frame, gfx::Clip(0, 0, rc2));
+
+    if (useTileCache && newEngine && m_playbackCache) {
+      playbackFrame = m_playbackCache->frame(
+        m_frame,
+        makeTileCacheState(newEngine, m_frame),
+        EditorTileCache::makeItems(m_sprite, m_frame));
+    }
+
+    if (playbackFrame) {
+      // Nothing to render
+    }
+    else if (useTileCache) {
+      updateTileCache(newEngine);
+
+      // The async render is only available for the SimpleRenderer
+      // (the ShaderRenderer must be used from the UI thread).
+      const bool async =
+        (pref.experimental.asyncRender() &&
+         m_renderEngine->type() == EditorRender::kSimpleRenderer);
+      if (!async && m_renderWorker)
+        m_renderWorker->cancel();
+
+      // Render the tiles that are not in the cache yet
+      const gfx::Rect renderBounds =
+        (newEngine ? m_sprite->bounds(): m_proj.apply(m_sprite->bounds()));
+      forEachCacheTile(
+        rc2, [this, async, newEngine, &renderBounds](
+          const int tx, const int ty, const gfx::Rect& tileBounds) {
+          if (m_tileCache->tile(tx, ty))
+            return;
+
+          if (async) {
+            requestTileRender(tx, ty, tileBounds & renderBounds, newEngine);
+            return;
+          }
+
+          os::Surface* tile = m_tileCache->createTile(
+            tx, ty, m_document->osColorSpace());
+          m_renderEngine->renderSprite(
+            tile, m_sprite, m_frame,
+            gfx::Clip(0, 0, tileBounds & renderBounds));
+        });
+    }
+    else {
+      // Create a temporary surface to draw the sprite on it
+      if (!rendered ||
+          rendered->width() < rc2.w ||
+          rendered->height() < rc2.h ||
+          rendered->colorSpace() != m_document->osColorSpace()) {
+        const int maxw = std::max(rc2.w, rendered ? rendered->width(): 0);
+        const int maxh = std::max(rc2.h, rendered ? rendered->height(): 0);
+        rendered = os::instance()->makeRgbaSurface(
+          maxw, maxh, m_document->osColorSpace());
+      }
+
+      m_renderEngine->renderSprite(
+        rendered.get(), m_sprite, m_frame, gfx::Clip(0, 0, rc2));
+    }
 
     m_renderEngine->removeExtraImage();
 
@@ -750,13 +829,18 @@ void Editor::drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& sprite
       m_docPref.bg.forceSection();
   }
   catch (const std::exception& e) {
+    // Some tiles could be incomplete
+    if (useTileCache) {
+      m_tileCache->invalidate();
+      useTileCache = false;
+    }
     Console::showException(e);
   }
 
-  if (rendered && rendered->nativeHandle()) {
+  {
     os::Paint p;
+    os::Sampling sampling;
     if (newEngine) {
-      os::Sampling sampling;
       p.srcEdges(os::Paint::SrcEdges::Fast); // Enable mipmaps if possible
 
       if (m_proj.scaleX() < 1.0) {
@@ -782,20 +866,59 @@ void Editor::drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& sprite
         p.blendMode(os::BlendMode::SrcOver);
       else
         p.blendMode(os::BlendMode::Src);
+    }
+    else {
+      sampling = os::Sampling(os::Sampling::Filter::Nearest);
+    }
+
+    if (playbackFrame) {
+      g->drawSurface(playbackFrame.get(), rc2, dest, sampling, &p);
+    }
+    else if (useTileCache) {
+      // Blit the part of each tile inside rc2 on its position of the
+      // screen (the stale version of the tiles that are being
+      // rendered in background)
+      forEachCacheTile(
+        rc2, [&](const int tx, const int ty,
+                 const gfx::Rect& tileBounds) {
+          os::Surface* tile = m_tileCache->staleTile(tx, ty);
+          const gfx::Rect part = (rc2 & tileBounds);
+          gfx::Rect partDest;
+          if (newEngine) {
+            partDest.x = dx + m_padding.x + m_proj.applyX(part.x);
+            partDest.y = dy + m_padding.y + m_proj.applyY(part.y);
+            partDest.w = m_proj.applyX(part.x2()) - m_proj.applyX(part.x);
+            partDest.h = m_proj.applyY(part.y2()) - m_proj.applyY(part.y);
+          }
+          else {
+            partDest = gfx::Rect(dest.x + part.x - rc2.x,
+                                 dest.y + part.y - rc2.y,
+                                 part.w, part.h);
+          }
 
+          // The tile was never rendered, we show the background
+          // color until it's ready
+          if (!tile) {
+            g->fillRect(color_utils::color_for_ui(m_docPref.bg.color1()),
+                        partDest);
+            return;
+          }
+
+          g->drawSurface(tile,
+                         gfx::Rect(part).offset(-tileBounds.origin()),
+                         partDest,
+                         sampling,
+                         &p);
+        });
+    }
+    else if (rendered && rendered->nativeHandle()) {
       g->drawSurface(rendered.get(),
-                     gfx::Rect(0, 0, rc2.w, rc2.h),
+                     (newEngine ? gfx::Rect(0, 0, rc2.w, rc2.h):
+                                  gfx::Rect(0, 0, dest.w, dest.h)),
                      dest,
                      sampling,
                      &p);
     }
-    else {
-      g->drawSurface(rendered.get(),
-                     gfx::Rect(0, 0, dest.w, dest.h),
-                     gfx::Rect(dest.x, dest.y, dest.w, dest.h),
-                     os::Sampling(os::Sampling::Filter::Nearest),
-                     &p);
-    }
   }
 
   // Draw grids
@@ -856,6 +979,145 @@ void Editor::drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& sprite
   }
 }
 
+EditorTileCache::State Editor::makeTileCacheState(const bool newEngine,
+                                                  const doc::frame_t frame)
+{
+  const auto& pref = Preferences::instance();
+
+  EditorTileCache::State state;
+  state.sprite = m_sprite;
+  state.spriteId = m_sprite->id();
+  state.frame = frame;
+  state.activeLayer = m_layer;
+  state.spriteSize = m_sprite->size();
+  state.pixelFormat = m_sprite->pixelFormat();
+  state.transparentColor = m_sprite->transparentColor();
+  state.palette = m_sprite->palette(frame);
+  state.paletteVersion = state.palette->version();
+  state.colorSpace = m_document->osColorSpace().get();
+  state.rendererType = int(m_renderEngine->type());
+  state.newEngine = newEngine;
+  if (!newEngine) {
+    state.scaleX = m_proj.scaleX();
+    state.scaleY = m_proj.scaleY();
+  }
+  state.newBlend = pref.experimental.newBlend();
+  state.nonactiveLayersOpacity = otherLayersOpacity();
+  state.bgType = int(m_docPref.bg.type());
+  state.bgSize = m_docPref.bg.size();
+  state.bgZoom = m_docPref.bg.zoom();
+  state.bgColor1 = m_docPref.bg.color1();
+  state.bgColor2 = m_docPref.bg.color2();
+  return state;
+}
+
+void Editor::updateTileCache(const bool newEngine)
+{
+  m_tileCache->update(makeTileCacheState(newEngine, m_frame),
+                      EditorTileCache::makeItems(m_sprite, m_frame),
+                      m_proj);
+}
+
+void Editor::requestTileRender(const int tx, const int ty,
+                               const gfx::Rect& bounds,
+                               const bool newEngine)
+{
+  if (!m_renderWorker) {
+    m_renderWorker = std::make_shared<EditorRenderWorker>(
+      [this]{ onRenderWorkerTiles(); });
+  }
+
+  const uint64_t version = m_tileCache->tileVersion(tx, ty);
+  if (m_renderWorker->isPending(tx, ty, version))
+    return;
+
+  EditorRenderWorker::Job job;
+  job.doc = m_document;
+  job.sprite = m_sprite;
+  job.frame = m_frame;
+  job.layer = m_layer;
+  job.proj = (newEngine ? render::Projection(): m_proj);
+  job.bg = EditorRender::makeBgOptions(m_document, IMAGE_RGB);
+  job.newBlend = Preferences::instance().experimental.newBlend();
+  job.nonactiveLayersOpacity = otherLayersOpacity();
+  job.tx = tx;
+  job.ty = ty;
+  job.version = version;
+  job.generation = m_tileCache->generation();
+  job.bounds = bounds;
+  job.surface = os::instance()->makeRgbaSurface(
+    EditorTileCache::kTileSize,
+    EditorTileCache::kTileSize,
+    m_document->osColorSpace());
+  m_renderWorker->request(std::move(job));
+}
+
+void Editor::renderFramesAhead(const std::vector<doc::frame_t>& frames)
+{
+  // Frames are rendered in sprite coordinates with the SimpleRenderer
+  // in background threads (like async tiles)
+  if (!isUsingNewRenderEngine() ||
+      m_renderEngine->type() != EditorRender::kSimpleRenderer)
+    return;
+
+  if (!m_playbackCache)
+    m_playbackCache = std::make_unique<PlaybackFrameCache>();
+
+  for (const doc::frame_t frame : frames) {
+    if (frame < 0 || frame > m_sprite->lastFrame())
+      continue;
+
+    EditorTileCache::State state = makeTileCacheState(true, frame);
+    EditorTileCache::Items items = EditorTileCache::makeItems(m_sprite, frame);
+    if (m_playbackCache->contains(frame, state, items))
+      continue;
+
+    PlaybackFrameCache::Job job;
+    job.doc = m_document;
+    job.sprite = m_sprite;
+    job.frame = frame;
+    job.layer = m_layer;
+    job.bg = EditorRender::makeBgOptions(m_document, IMAGE_RGB);
+    job.newBlend = Preferences::instance().experimental.newBlend();
+    job.nonactiveLayersOpacity = otherLayersOpacity();
+    job.state = std::move(state);
+    job.items = std::move(items);
+    job.surface = os::instance()->makeRgbaSurface(
+      m_sprite->width(), m_sprite->height(),
+      m_document->osColorSpace());
+    m_playbackCache->request(std::move(job));
+  }
+}
+
+void Editor::discardFramesAhead()
+{
+  m_playbackCache.reset();
+}
+
+void Editor::onRenderWorkerTiles()
+{
+  bool redraw = false;
+  for (auto& job : m_renderWorker->takeResults()) {
+    if (m_tileCache->setTile(job.tx, job.ty, job.version, job.surface))
+      redraw = true;
+  }
+  if (redraw)
+    invalidateCanvas();
+}
+
+// Calls "func" for each tile of the tile cache that intersects the
+// given rectangle (in the coordinates of the rendered sprite).
+void Editor::forEachCacheTile(
+  const gfx::Rect& rc,
+  const std::function<void(int, int, const gfx::Rect&)>& func)
+{
+  const int size = EditorTileCache::kTileSize;
+  for (int ty=rc.y/size; ty*size < rc.y2(); ++ty) {
+    for (int tx=rc.x/size; tx*size < rc.x2(); ++tx)
+      func(tx, ty, gfx::Rect(tx*size, ty*size, size, size));
+  }
+}
+
 void Editor::drawBackground(ui::Graphics* g)
 {
   if (!(m_flags & kShowOutside))
@@ -991,6 +1253,44 @@ void Editor::drawSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& _rc)
   }
 }
 
+// Draws the rolling percentiles of the profiler zones of each stage
+// of a frame in the top-right corner of the viewport.
+void Editor::drawFrameStats(ui::Graphics* g)
+{
+  static const std::pair<const char*, const char*> stages[] = {
+    { "render", "renderSprite" },
+    { "convert", "convert_image_to_surface" },
+    { "flip", "flip" },
+    { "input", "inputToPaint" },
+  };
+
+  std::vector<std::string> lines;
+  gfx::Size size;
+  for (const auto& [label, zone] : stages) {
+    const ProfilerZoneStats stats = get_profiler_zone_stats(zone);
+    lines.push_back(
+      fmt::format("{:8} p50 {:6.2f} p95 {:6.2f} max {:6.2f} ms",
+                  label, stats.p50, stats.p95, stats.max));
+    const gfx::Size sz = g->measureUIText(lines.back());
+    size.w = std::max(size.w, sz.w);
+    size.h += sz.h;
+  }
+
+  View* view = View::getView(this);
+  const gfx::Rect vp = view->viewportBounds();
+  gfx::Point pt(vp.x2() - size.w, vp.y);
+  m_frameStatsBounds = gfx::Rect(pt, size);
+
+  pt -= bounds().origin();
+  for (const auto& line : lines) {
+    g->drawText(line,
+                gfx::rgba(255, 255, 255, 255),
+                gfx::rgba(0, 0, 0, 255),
+                pt);
+    pt.y += size.h / int(lines.size());
+  }
+}
+
 void Editor::drawSpriteClipped(const gfx::Region& updateRegion)
 {
   Region screenRegion;
@@ -1108,21 +1408,53 @@ void Editor::drawGrid(Graphics* g, const gfx::Rect& spriteBounds, const Rect& gr
     gfx::getg(grid_color),
     gfx::getb(grid_color), alpha);
 
-  // Draw horizontal lines
-  int x1 = spriteBounds.x;
-  int y1 = gridF.y;
-  int x2 = spriteBounds.x + spriteBounds.w;
-  int y2 = spriteBounds.y + spriteBounds.h;
+  // Only the lines inside the clipping area are drawn (at high zoom
+  // levels the sprite bounds can contain thousands of lines).
+  const gfx::Rect visible = (spriteBounds & g->getClipBounds());
+  if (visible.isEmpty())
+    return;
 
-  for (double c=y1; c<=y2; c+=gridF.h)
-    g->drawHLine(grid_color, x1, c, spriteBounds.w);
+  // All lines are drawn with just one path, which is re-used while
+  // the visible area and the grid position/zoom don't change. We keep
+  // two paths: one for the pixel grid and other for the grid.
+  GridPath* cache = nullptr;
+  for (GridPath& gp : m_gridPaths) {
+    if (gp.visible == visible && gp.gridF == gridF)
+      cache = &gp;
+  }
+  if (!cache) {
+    // Replace the least recently created path
+    std::swap(m_gridPaths[0], m_gridPaths[1]);
+    cache = &m_gridPaths[0];
+    cache->visible = visible;
+    cache->gridF = gridF;
+    cache->path = gfx::Path();
+
+    // Horizontal lines
+    double c = gridF.y;
+    if (c < visible.y)
+      c += std::floor((visible.y - c) / gridF.h) * gridF.h;
+    for (; c<=visible.y2(); c+=gridF.h) {
+      const float y = int(c) + 0.5f;
+      cache->path.moveTo(visible.x, y);
+      cache->path.lineTo(visible.x2(), y);
+    }
 
-  // Draw vertical lines
-  x1 = gridF.x;
-  y1 = spriteBounds.y;
+    // Vertical lines
+    c = gridF.x;
+    if (c < visible.x)
+      c += std::floor((visible.x - c) / gridF.w) * gridF.w;
+    for (; c<=visible.x2(); c+=gridF.w) {
+      const float x = int(c) + 0.5f;
+      cache->path.moveTo(x, visible.y);
+      cache->path.lineTo(x, visible.y2());
+    }
+  }
 
-  for (double c=x1; c<=x2; c+=gridF.w)
-    g->drawVLine(grid_color, c, y1, spriteBounds.h);
+  ui::Paint paint;
+  paint.style(ui::Paint::Stroke);
+  paint.color(grid_color);
+  g->drawPath(cache->path, paint);
 }
 
 void Editor::drawSlices(ui::Graphics* g)
@@ -1136,20 +1468,39 @@ void Editor::drawSlices(ui::Graphics* g)
   auto theme = SkinTheme::get(this);
   gfx::Point mainOffset(mainTilePosition());
 
+  // Slices outside the clipping area are skipped (documents can
+  // contain thousands of slices and we repaint small areas)
+  const gfx::Rect clipBounds = g->getClipBounds();
+  if (clipBounds.isEmpty())
+    return;
+
   for (auto slice : m_sprite->slices()) {
     auto key = slice->getByFrame(m_frame);
     if (!key)
       continue;
 
+    gfx::Rect out = key->bounds();
+    out.offset(mainOffset);
+    out = editorToScreen(out);
+    out.offset(-bounds().origin());
+
+    // The pivot can be outside the slice bounds, and the selected
+    // slice is painted with a border that can be a little bigger
+    gfx::Rect sliceArea = out;
+    if (key->hasPivot()) {
+      sliceArea |= editorToScreen(
+        gfx::Rect(key->pivot(), gfx::Size(1, 1)).offset(key->bounds().origin()))
+        .offset(-bounds().origin());
+    }
+    sliceArea.enlarge(4*guiscale());
+    if (!clipBounds.intersects(sliceArea))
+      continue;
+
     doc::color_t docColor = slice->userData().color();
     gfx::Color color = gfx::rgba(doc::rgba_getr(docColor),
                                  doc::rgba_getg(docColor),
                                  doc::rgba_getb(docColor),
                                  doc::rgba_geta(docColor));
-    gfx::Rect out = key->bounds();
-    out.offset(mainOffset);
-    out = editorToScreen(out);
-    out.offset(-bounds().origin());
 
     // Center slices
     if (key->hasCenter()) {
@@ -2276,6 +2627,11 @@ void Editor::onPaint(ui::PaintEvent& ev)
       drawSpriteUnclippedRect(g, gfx::Rect(0, 0, m_sprite->width(), m_sprite->height()));
       renderElapsed = renderChrono.elapsed();
 
+      if (m_toolLoopInputTime) {
+        add_profiler_zone("inputToPaint", m_toolLoopInputTime, profiler_now());
+        m_toolLoopInputTime = 0;
+      }
+
 #if ENABLE_DEVMODE
       // Show performance stats (TODO show performance stats in other widget)
       if (Preferences::instance().perf.showRenderTime()) {
@@ -2296,6 +2652,9 @@ void Editor::onPaint(ui::PaintEvent& ev)
       }
 #endif // ENABLE_DEVMODE
 
+      if (Preferences::instance().perf.showFrameStats())
+        drawFrameStats(g);
+
       // Draw the mask boundaries
       if (m_document->hasMaskBoundaries()) {
         drawMask(g);
@@ -2930,6 +3289,12 @@ void Editor::showMouseCursor(CursorType cursorType,
   ui::set_mouse_cursor(cursorType, cursor);
 }
 
+void Editor::markToolLoopInput()
+{
+  if (is_profiler_active() && !m_toolLoopInputTime)
+    m_toolLoopInputTime = profiler_now();
+}
+
 void Editor::showBrushPreview(const gfx::Point& screenPos)
 {
   m_brushPreview.show(screenPos);
@@ -21,6 +21,7 @@
 #include "app/ui/editor/editor_observers.h"
 #include "app/ui/editor/editor_state.h"
 #include "app/ui/editor/editor_states_history.h"
+#include "app/ui/editor/editor_tile_cache.h"
 #include "app/ui/tile_source.h"
 #include "app/util/tiled_mode.h"
 #include "doc/algorithm/flip_type.h"
@@ -29,6 +30,8 @@
 #include "doc/selected_objects.h"
 #include "filters/tiled_mode.h"
 #include "gfx/fwd.h"
+#include "gfx/path.h"
+#include "gfx/rect.h"
 #include "obs/connection.h"
 #include "os/color_space.h"
 #include "render/projection.h"
@@ -39,8 +42,10 @@
 #include "ui/timer.h"
 #include "ui/widget.h"
 
+#include <functional>
 #include <memory>
 #include <set>
+#include <vector>
 
 namespace doc {
   class Layer;
@@ -60,6 +65,8 @@ namespace app {
   class DocView;
   class EditorCustomizationDelegate;
   class EditorRender;
+  class EditorRenderWorker;
+  class PlaybackFrameCache;
   class PixelsMovement;
   class Site;
   class Transformation;
@@ -281,6 +288,11 @@ namespace app {
     void stop();
     bool isPlaying() const;
 
+    // Renders the given frames in background threads before they are
+    // displayed by the PlayState (see PlaybackFrameCache).
+    void renderFramesAhead(const std::vector<doc::frame_t>& frames);
+    void discardFramesAhead();
+
     // Shows a popup menu to change the editor animation speed.
     void showAnimationSpeedMultiplierPopup();
     double getAnimationSpeedMultiplier() const;
@@ -294,6 +306,11 @@ namespace app {
     // Gets the brush preview controller.
     BrushPreview& brushPreview() { return m_brushPreview; }
 
+    // Marks the time of an input processed by the tool loop to
+    // measure the input-to-paint latency (when profiler zones are
+    // being recorded).
+    void markToolLoopInput();
+
     static EditorRender& renderEngine() { return *m_renderEngine; }
 
     // IColorSource
@@ -377,6 +394,7 @@ namespace app {
                   const app::Color& color, int alpha);
     void drawSlices(ui::Graphics* g);
     void drawTileNumbers(ui::Graphics* g, const Cel* cel);
+    void drawFrameStats(ui::Graphics* g);
     void drawCelBounds(ui::Graphics* g, const Cel* cel, const gfx::Color color);
     void drawCelGuides(ui::Graphics* g, const Cel* cel, const Cel* mouseCel);
     void drawCelHGuide(ui::Graphics* g,
@@ -397,6 +415,16 @@ namespace app {
     // You should setup the clip of the screen before calling this
     // routine.
     void drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& rc, int dx, int dy);
+    EditorTileCache::State makeTileCacheState(const bool newEngine,
+                                              const doc::frame_t frame);
+    void updateTileCache(const bool newEngine);
+    void requestTileRender(const int tx, const int ty,
+                           const gfx::Rect& bounds,
+                           const bool newEngine);
+    void onRenderWorkerTiles();
+    void forEachCacheTile(
+      const gfx::Rect& rc,
+      const std::function<void(int, int, const gfx::Rect&)>& func);
 
     gfx::Point calcExtraPadding(const render::Projection& proj);
 
@@ -438,6 +466,14 @@ namespace app {
     ui::Timer m_antsTimer;
     int m_antsOffset;
 
+    // Cached paths to draw the pixel grid and the grid lines.
+    struct GridPath {
+      gfx::Rect visible;
+      gfx::RectF gridF;
+      gfx::Path path;
+    };
+    GridPath m_gridPaths[2];
+
     obs::scoped_connection m_samplingChangeConn;
     obs::scoped_connection m_fgColorChangeConn;
     obs::scoped_connection m_contextBarBrushChangeConn;
@@ -490,9 +526,22 @@ namespace app {
     gfx::Rect m_perfInfoBounds;
 #endif
 
+    // Frame-time HUD (perf.show_frame_stats)
+    gfx::Rect m_frameStatsBounds;
+    int64_t m_toolLoopInputTime = 0;
+
     // For slices
     doc::SelectedObjects m_selectedSlices;
 
+    // Tiles of the rendered sprite that didn't change
+    std::unique_ptr<EditorTileCache> m_tileCache;
+
+    // Renders the tiles in background (experimental.async_render)
+    std::shared_ptr<EditorRenderWorker> m_renderWorker;
+
+    // Frames rendered ahead while the animation is played
+    std::unique_ptr<PlaybackFrameCache> m_playbackCache;
+
     // Active sprite editor with the keyboard focus.
     static Editor* m_activeEditor;
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2018  David Capello
 //
 // This program is distributed under the terms of
@@ -13,12 +13,13 @@
 
 #include "app/color_utils.h"
 #include "app/pref/preferences.h"
+#include "app/profiler.h"
 #include "app/render/shader_renderer.h"
 #include "app/render/simple_renderer.h"
 
 namespace app {
 
-static doc::ImageBufferPtr g_renderBuffer;
+static thread_local doc::ImageBufferPtr g_renderBuffer;
 
 EditorRender::EditorRender()
   // TODO create a switch in the preferences
@@ -78,6 +79,23 @@ void EditorRender::setProjection(const render::Projection& projection)
 }
 
 void EditorRender::setupBackground(Doc* doc, doc::PixelFormat pixelFormat)
+{
+  m_renderer->setBgOptions(makeBgOptions(doc, pixelFormat));
+}
+
+void EditorRender::setTransparentBackground()
+{
+  m_renderer->setBgOptions(render::BgOptions::MakeTransparent());
+}
+
+void EditorRender::setBgOptions(const render::BgOptions& bg)
+{
+  m_renderer->setBgOptions(bg);
+}
+
+// static
+render::BgOptions EditorRender::makeBgOptions(Doc* doc,
+                                              doc::PixelFormat pixelFormat)
 {
   DocumentPreferences& docPref = Preferences::instance().document(doc);
   render::BgType bgType;
@@ -120,12 +138,7 @@ void EditorRender::setupBackground(Doc* doc, doc::PixelFormat pixelFormat)
   bg.color1 = color_utils::color_for_image_without_alpha(docPref.bg.color1(), pixelFormat);
   bg.color2 = color_utils::color_for_image_without_alpha(docPref.bg.color2(), pixelFormat);
   bg.stripeSize = tile;
-  m_renderer->setBgOptions(bg);
-}
-
-void EditorRender::setTransparentBackground()
-{
-  m_renderer->setBgOptions(render::BgOptions::MakeTransparent());
+  return bg;
 }
 
 void EditorRender::setSelectedLayer(const doc::Layer* layer)
@@ -142,11 +155,13 @@ void EditorRender::setPreviewImage(const doc::Layer* layer,
 {
   m_renderer->setPreviewImage(layer, frame, image, tileset,
                               pos, blendMode);
+  m_hasPreviewImage = true;
 }
 
 void EditorRender::removePreviewImage()
 {
   m_renderer->removePreviewImage();
+  m_hasPreviewImage = false;
 }
 
 void EditorRender::setExtraImage(
@@ -182,6 +197,7 @@ void EditorRender::renderSprite(
   doc::frame_t frame,
   const gfx::ClipF& area)
 {
+  PROFILE_ZONE("renderSprite");
   m_renderer->renderSprite(dstSurface, sprite, frame, area);
 }
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2018  David Capello
 //
 // This program is distributed under the terms of
@@ -17,6 +17,7 @@
 #include "doc/pixel_format.h"
 #include "gfx/clip.h"
 #include "gfx/point.h"
+#include "render/bg_options.h"
 #include "render/extra_type.h"
 #include "render/onionskin_options.h"
 #include "render/projection.h"
@@ -62,6 +63,11 @@ namespace app {
 
     void setupBackground(Doc* doc, doc::PixelFormat pixelFormat);
     void setTransparentBackground();
+    void setBgOptions(const render::BgOptions& bg);
+
+    // Background options from the document preferences.
+    static render::BgOptions makeBgOptions(Doc* doc,
+                                           doc::PixelFormat pixelFormat);
 
     void setSelectedLayer(const doc::Layer* layer);
 
@@ -72,6 +78,7 @@ namespace app {
                          const gfx::Point& pos,
                          const doc::BlendMode blendMode);
     void removePreviewImage();
+    bool hasPreviewImage() const { return m_hasPreviewImage; }
 
     void setExtraImage(
       render::ExtraType type,
@@ -103,10 +110,12 @@ namespace app {
       const int opacity,
       const doc::BlendMode blendMode);
 
+    // Buffer used to render images in the current thread.
     static doc::ImageBufferPtr getRenderImageBuffer();
 
   private:
     std::unique_ptr<Renderer> m_renderer;
+    bool m_hasPreviewImage = false;
   };
 
 } // namespace app
@@ -0,0 +1,167 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/ui/editor/editor_render_worker.h"
+
+#include "app/doc_access.h"
+#include "app/ui/editor/editor_render.h"
+#include "base/log.h"
+#include "gfx/clip.h"
+#include "ui/system.h"
+
+#include <algorithm>
+
+namespace app {
+
+EditorRenderWorker::EditorRenderWorker(std::function<void()>&& onTilesReady)
+  : m_onTilesReady(std::move(onTilesReady))
+  , m_render(std::make_unique<EditorRender>())
+  , m_pool(1)
+{
+}
+
+EditorRenderWorker::~EditorRenderWorker()
+{
+  cancel();
+  m_pool.wait_all();
+}
+
+bool EditorRenderWorker::isPending(const int tx, const int ty,
+                                   const uint64_t version)
+{
+  const std::lock_guard lock(m_mutex);
+  return isPendingUnlocked(tx, ty, version);
+}
+
+void EditorRenderWorker::request(Job&& job)
+{
+  {
+    const std::lock_guard lock(m_mutex);
+    if (isPendingUnlocked(job.tx, job.ty, job.version))
+      return;
+
+    m_jobs.erase(
+      std::remove_if(
+        m_jobs.begin(), m_jobs.end(),
+        [&job](const Job& other){
+          return ((other.tx == job.tx && other.ty == job.ty) ||
+                  other.generation != job.generation);
+        }),
+      m_jobs.end());
+
+    m_jobs.push_back(std::move(job));
+  }
+  m_pool.execute([this]{ renderNextJob(); });
+}
+
+void EditorRenderWorker::cancel()
+{
+  const std::lock_guard lock(m_mutex);
+  m_jobs.clear();
+}
+
+std::vector<EditorRenderWorker::Job> EditorRenderWorker::takeResults()
+{
+  const std::lock_guard lock(m_mutex);
+  std::vector<Job> results;
+  std::swap(results, m_results);
+  return results;
+}
+
+bool EditorRenderWorker::isPendingUnlocked(const int tx, const int ty,
+                                           const uint64_t version) const
+{
+  if (m_rendering &&
+      m_renderingTx == tx &&
+      m_renderingTy == ty &&
+      m_renderingVersion == version)
+    return true;
+
+  return std::any_of(
+    m_jobs.begin(), m_jobs.end(),
+    [tx, ty, version](const Job& job){
+      return (job.tx == tx &&
+              job.ty == ty &&
+              job.version == version);
+    });
+}
+
+// Called from the worker thread
+void EditorRenderWorker::renderNextJob()
+{
+  Job job;
+  {
+    const std::lock_guard lock(m_mutex);
+    if (m_jobs.empty())         // Canceled
+      return;
+
+    job = std::move(m_jobs.front());
+    m_jobs.pop_front();
+
+    m_rendering = true;
+    m_renderingTx = job.tx;
+    m_renderingTy = job.ty;
+    m_renderingVersion = job.version;
+  }
+
+  bool rendered = false;
+  try {
+    WeakDocReader reader(job.doc);
+    if (reader.isLocked()) {
+      m_render->setNewBlendMethod(job.newBlend);
+      m_render->setRefLayersVisiblity(true);
+      m_render->setSelectedLayer(job.layer);
+      m_render->setNonactiveLayersOpacity(job.nonactiveLayersOpacity);
+      m_render->setBgOptions(job.bg);
+      m_render->disableOnionskin();
+      m_render->setProjection(job.proj);
+      m_render->renderSprite(job.surface.get(), job.sprite, job.frame,
+                             gfx::Clip(0, 0, job.bounds));
+
+      // If the UI thread wanted to modify the document in the
+      // meantime, we cannot trust in the rendered tile.
+      rendered = reader.isLocked();
+    }
+  }
+  catch (const std::exception& ex) {
+    LOG(ERROR, "EDIT: Error rendering tile %d,%d: %s\n",
+        job.tx, job.ty, ex.what());
+  }
+
+  bool notify = false;
+  {
+    const std::lock_guard lock(m_mutex);
+    m_rendering = false;
+    if (rendered) {
+      m_results.push_back(std::move(job));
+      if (!m_notifyPending)
+        m_notifyPending = notify = true;
+    }
+  }
+
+  if (notify) {
+    ui::execute_from_ui_thread(
+      [weak = weak_from_this()]{
+        if (auto worker = weak.lock())
+          worker->notifyResults();
+      });
+  }
+}
+
+void EditorRenderWorker::notifyResults()
+{
+  {
+    const std::lock_guard lock(m_mutex);
+    m_notifyPending = false;
+  }
+  m_onTilesReady();
+}
+
+} // namespace app
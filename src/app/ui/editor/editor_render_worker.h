@@ -0,0 +1,110 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_UI_EDITOR_RENDER_WORKER_H_INCLUDED
+#define APP_UI_EDITOR_RENDER_WORKER_H_INCLUDED
+#pragma once
+
+#include "base/disable_copying.h"
+#include "base/thread_pool.h"
+#include "doc/frame.h"
+#include "gfx/rect.h"
+#include "os/surface.h"
+#include "render/bg_options.h"
+#include "render/projection.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace doc {
+  class Layer;
+  class Sprite;
+}
+
+namespace app {
+  class Doc;
+  class EditorRender;
+
+  // Renders tiles of the EditorTileCache in a background thread (see
+  // the "experimental.async_render" option), so the Editor can keep
+  // responding to the user input displaying the stale version of
+  // those tiles in the meantime.
+  //
+  // The document is accessed with a weak lock (as the data recovery
+  // does), so the UI thread can modify the document at any time: the
+  // tile that was being rendered is just discarded.
+  class EditorRenderWorker
+    : public std::enable_shared_from_this<EditorRenderWorker> {
+  public:
+    // Everything needed to render one tile (it can be used only from
+    // the UI thread before and after the tile is rendered).
+    struct Job {
+      Doc* doc = nullptr;
+      const doc::Sprite* sprite = nullptr;
+      doc::frame_t frame = 0;
+      const doc::Layer* layer = nullptr;
+      render::Projection proj;
+      render::BgOptions bg;
+      bool newBlend = true;
+      int nonactiveLayersOpacity = 255;
+      int tx = 0, ty = 0;
+      uint64_t version = 0;     // EditorTileCache::tileVersion()
+      uint64_t generation = 0;  // EditorTileCache::generation()
+      gfx::Rect bounds;         // Area of the tile to be rendered
+      os::SurfaceRef surface;
+    };
+
+    // The callback is called from the UI thread when some tiles are
+    // ready to be taken with takeResults().
+    explicit EditorRenderWorker(std::function<void()>&& onTilesReady);
+    ~EditorRenderWorker();
+
+    // Adds a tile to be rendered. Queued jobs for the same tile, or
+    // for other generations of the tile cache, are out of date and
+    // canceled.
+    void request(Job&& job);
+
+    // True if the given version of the tile is queued or is being
+    // rendered.
+    bool isPending(const int tx, const int ty, const uint64_t version);
+
+    // Cancels all the queued jobs.
+    void cancel();
+
+    std::vector<Job> takeResults();
+
+  private:
+    bool isPendingUnlocked(const int tx, const int ty,
+                           const uint64_t version) const;
+    void renderNextJob();
+    void notifyResults();
+
+    std::function<void()> m_onTilesReady;
+    std::unique_ptr<EditorRender> m_render;
+    std::mutex m_mutex;
+    std::deque<Job> m_jobs;
+    std::vector<Job> m_results;
+    bool m_notifyPending = false;
+
+    // Tile being rendered (to avoid requesting it again)
+    bool m_rendering = false;
+    int m_renderingTx = 0;
+    int m_renderingTy = 0;
+    uint64_t m_renderingVersion = 0;
+
+    // One thread to render the jobs in order
+    base::thread_pool m_pool;
+
+    DISABLE_COPYING(EditorRenderWorker);
+  };
+
+} // namespace app
+
+#endif
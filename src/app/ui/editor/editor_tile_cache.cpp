@@ -0,0 +1,282 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/ui/editor/editor_tile_cache.h"
+
+#include "doc/cel.h"
+#include "doc/layer.h"
+#include "doc/layer_tilemap.h"
+#include "doc/sprite.h"
+#include "doc/tileset.h"
+#include "os/system.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace app {
+
+bool EditorTileCache::State::operator==(const State& o) const
+{
+  return (sprite == o.sprite &&
+          spriteId == o.spriteId &&
+          frame == o.frame &&
+          activeLayer == o.activeLayer &&
+          spriteSize == o.spriteSize &&
+          pixelFormat == o.pixelFormat &&
+          transparentColor == o.transparentColor &&
+          palette == o.palette &&
+          paletteVersion == o.paletteVersion &&
+          colorSpace == o.colorSpace &&
+          rendererType == o.rendererType &&
+          newEngine == o.newEngine &&
+          scaleX == o.scaleX &&
+          scaleY == o.scaleY &&
+          newBlend == o.newBlend &&
+          nonactiveLayersOpacity == o.nonactiveLayersOpacity &&
+          bgType == o.bgType &&
+          bgSize == o.bgSize &&
+          bgZoom == o.bgZoom &&
+          bgColor1 == o.bgColor1 &&
+          bgColor2 == o.bgColor2);
+}
+
+// static
+EditorTileCache::Items EditorTileCache::makeItems(const doc::Sprite* sprite,
+                                                  const doc::frame_t frame)
+{
+  Items items;
+  for (const doc::Layer* layer : sprite->allLayers()) {
+    Item item;
+    item.layer = layer;
+    item.layerVersion = layer->version();
+    item.layerFlags = int(layer->flags());
+    if (layer->isImage()) {
+      auto imgLayer = static_cast<const doc::LayerImage*>(layer);
+      item.layerOpacity = imgLayer->opacity();
+      item.blendMode = imgLayer->blendMode();
+    }
+    if (const doc::Cel* cel = layer->cel(frame)) {
+      item.cel = cel;
+      item.celVersion = cel->version();
+      item.celDataVersion = cel->data()->version();
+      item.image = cel->image();
+      item.imageVersion = (item.image ? item.image->version(): 0);
+      item.bounds = cel->boundsF();
+      item.opacity = cel->opacity();
+      item.zIndex = cel->zIndex();
+    }
+    if (layer->isTilemap()) {
+      const doc::Tileset* tileset =
+        static_cast<const doc::LayerTilemap*>(layer)->tileset();
+      item.tileset = tileset;
+      if (tileset) {
+        item.tilesetVersion = tileset->version();
+        for (const auto& tile : *tileset) {
+          if (tile.image)
+            item.tilesetVersion += tile.image->version();
+        }
+      }
+    }
+    items.push_back(item);
+  }
+  return items;
+}
+
+void EditorTileCache::update(const State& state,
+                             Items&& items,
+                             const render::Projection& proj)
+{
+  bool sameLayers = (m_state == state &&
+                     m_items.size() == items.size());
+  for (size_t i=0; sameLayers && i<items.size(); ++i) {
+    if (m_items[i].layer != items[i].layer)
+      sameLayers = false;
+  }
+  if (!sameLayers) {
+    // Stale tiles can be displayed only if they are in the same
+    // coordinates (e.g. the previous frame, or the previous state of
+    // the active layer).
+    const bool sameCoords = (m_state.sprite == state.sprite &&
+                             m_state.spriteSize == state.spriteSize &&
+                             m_state.colorSpace == state.colorSpace &&
+                             m_state.newEngine == state.newEngine &&
+                             m_state.scaleX == state.scaleX &&
+                             m_state.scaleY == state.scaleY);
+    invalidate(sameCoords);
+    m_state = state;
+    m_items = std::move(items);
+    return;
+  }
+
+  for (size_t i=0; i<items.size() && !m_tiles.empty(); ++i) {
+    const Item& oldItem = m_items[i];
+    const Item& newItem = items[i];
+    if (oldItem == newItem)
+      continue;
+
+    // Groups don't have cels, we don't know the modified area.
+    if (!oldItem.cel && !newItem.cel) {
+      if (newItem.layer->isGroup())
+        invalidate();
+      continue;
+    }
+
+    if (oldItem.cel)
+      invalidateBounds(oldItem.bounds, proj);
+    if (newItem.cel)
+      invalidateBounds(newItem.bounds, proj);
+  }
+  m_items = std::move(items);
+}
+
+os::Surface* EditorTileCache::tile(const int tx, const int ty)
+{
+  auto it = m_tiles.find(TileIndex(tx, ty));
+  if (it == m_tiles.end() || !it->second.valid)
+    return nullptr;
+
+  it->second.lastUse = ++m_useCounter;
+  return it->second.surface.get();
+}
+
+os::Surface* EditorTileCache::staleTile(const int tx, const int ty)
+{
+  auto it = m_tiles.find(TileIndex(tx, ty));
+  if (it == m_tiles.end())
+    return nullptr;
+
+  it->second.lastUse = ++m_useCounter;
+  return it->second.surface.get();
+}
+
+os::Surface* EditorTileCache::createTile(const int tx, const int ty,
+                                         const os::ColorSpaceRef& colorSpace)
+{
+  os::SurfaceRef freeSurface;
+  Tile& tile = getTile(tx, ty, &freeSurface);
+  if (!tile.surface) {
+    if (freeSurface)
+      tile.surface = std::move(freeSurface);
+    else
+      tile.surface = os::instance()->makeRgbaSurface(kTileSize, kTileSize,
+                                                     colorSpace);
+  }
+  tile.valid = true;
+  updateMemSize();
+  return tile.surface.get();
+}
+
+uint64_t EditorTileCache::tileVersion(const int tx, const int ty)
+{
+  return getTile(tx, ty).version;
+}
+
+bool EditorTileCache::setTile(const int tx, const int ty,
+                              const uint64_t version,
+                              const os::SurfaceRef& surface)
+{
+  auto it = m_tiles.find(TileIndex(tx, ty));
+  if (it == m_tiles.end() ||
+      it->second.version != version)
+    return false;
+
+  it->second.surface = surface;
+  it->second.valid = true;
+  updateMemSize();
+  return true;
+}
+
+void EditorTileCache::invalidate(const bool keepStaleTiles)
+{
+  if (keepStaleTiles) {
+    for (auto& it : m_tiles)
+      invalidateTile(it.second);
+  }
+  else {
+    m_tiles.clear();
+    m_memSize = 0;
+  }
+  ++m_generation;
+}
+
+// Returns the given tile (creating it if needed). When a new tile
+// is created and we have too many tiles, the least recently used one
+// is discarded, and its surface is returned in "freeSurface" so it
+// can be re-used.
+EditorTileCache::Tile& EditorTileCache::getTile(const int tx, const int ty,
+                                                os::SurfaceRef* freeSurface)
+{
+  auto it = m_tiles.find(TileIndex(tx, ty));
+  if (it == m_tiles.end()) {
+    if (int(m_tiles.size()) >= kMaxTiles) {
+      auto lru = std::min_element(
+        m_tiles.begin(), m_tiles.end(),
+        [](const auto& a, const auto& b){
+          return a.second.lastUse < b.second.lastUse;
+        });
+      if (freeSurface)
+        *freeSurface = std::move(lru->second.surface);
+      m_tiles.erase(lru);
+      updateMemSize();
+    }
+
+    it = m_tiles.emplace(TileIndex(tx, ty), Tile()).first;
+    it->second.version = ++m_versionCounter;
+  }
+  it->second.lastUse = ++m_useCounter;
+  return it->second;
+}
+
+void EditorTileCache::invalidateTile(Tile& tile)
+{
+  tile.valid = false;
+  tile.version = ++m_versionCounter;
+}
+
+void EditorTileCache::invalidateBounds(const gfx::RectF& spriteBounds,
+                                       const render::Projection& proj)
+{
+  // Extra pixels that can be modified around the cel bounds (e.g. to
+  // sample pixels with zoom levels less than 100%)
+  const int margin = 1 + int(1.0 / std::min(1.0, std::min(proj.scaleX(),
+                                                          proj.scaleY())));
+  gfx::Rect bounds(int(std::floor(spriteBounds.x)),
+                   int(std::floor(spriteBounds.y)),
+                   int(std::ceil(spriteBounds.w)) + 1,
+                   int(std::ceil(spriteBounds.h)) + 1);
+  bounds.enlarge(margin);
+
+  // Tiles of the old engine are zoomed
+  if (!m_state.newEngine)
+    bounds = proj.apply(bounds);
+
+  const int tx1 = int(std::floor(double(bounds.x) / kTileSize));
+  const int ty1 = int(std::floor(double(bounds.y) / kTileSize));
+  const int tx2 = int(std::floor(double(bounds.x2()-1) / kTileSize));
+  const int ty2 = int(std::floor(double(bounds.y2()-1) / kTileSize));
+  for (auto& it : m_tiles) {
+    const TileIndex& i = it.first;
+    if (i.first >= tx1 && i.first <= tx2 &&
+        i.second >= ty1 && i.second <= ty2)
+      invalidateTile(it.second);
+  }
+}
+
+void EditorTileCache::updateMemSize()
+{
+  std::size_t bytes = 0;
+  for (const auto& it : m_tiles) {
+    if (const os::Surface* surface = it.second.surface.get())
+      bytes += std::size_t(surface->width()) * surface->height() * 4;
+  }
+  m_memSize = bytes;
+}
+
+} // namespace app
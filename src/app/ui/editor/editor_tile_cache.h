@@ -0,0 +1,171 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_UI_EDITOR_TILE_CACHE_H_INCLUDED
+#define APP_UI_EDITOR_TILE_CACHE_H_INCLUDED
+#pragma once
+
+#include "app/color.h"
+#include "doc/frame.h"
+#include "doc/memory_account.h"
+#include "doc/object_id.h"
+#include "doc/object_version.h"
+#include "doc/pixel_format.h"
+#include "gfx/rect.h"
+#include "gfx/size.h"
+#include "os/color_space.h"
+#include "os/surface.h"
+#include "render/composite_cache.h"
+#include "render/projection.h"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace doc {
+  class Layer;
+  class Palette;
+  class Sprite;
+}
+
+namespace app {
+
+  // Retained tiles of the rendered sprite used by the Editor to blit
+  // the areas of the canvas that didn't change (e.g. when we scroll
+  // the editor or uncover some area of it) instead of rendering them
+  // again.
+  //
+  // Tiles are in the coordinates of the surface given to
+  // EditorRender::renderSprite(), i.e. sprite pixels for the new
+  // render engine, or the zoomed canvas for the old engine.
+  //
+  // Invalidated tiles keep their surface (when the tile coordinates
+  // are still the same) as a stale version of the tile that can be
+  // displayed while the new version is rendered in background (see
+  // EditorRenderWorker).
+  class EditorTileCache {
+  public:
+    static constexpr int kTileSize = 256;
+
+    // Maximum number of tiles kept in memory (the least recently
+    // used tiles are discarded).
+    static constexpr int kMaxTiles = 256;
+
+    // Render properties that affect all tiles.
+    struct State {
+      const doc::Sprite* sprite = nullptr;
+      doc::ObjectId spriteId = doc::NullId;
+      doc::frame_t frame = 0;
+      const doc::Layer* activeLayer = nullptr;
+      gfx::Size spriteSize;
+      doc::PixelFormat pixelFormat = doc::IMAGE_RGB;
+      doc::color_t transparentColor = 0;
+      const doc::Palette* palette = nullptr;
+      doc::ObjectVersion paletteVersion = 0;
+      const os::ColorSpace* colorSpace = nullptr;
+      int rendererType = 0;
+      bool newEngine = true;
+      double scaleX = 1.0;  // Only for the old engine (zoomed tiles)
+      double scaleY = 1.0;
+      bool newBlend = true;
+      int nonactiveLayersOpacity = 255;
+      int bgType = 0;
+      gfx::Size bgSize;
+      bool bgZoom = false;
+      app::Color bgColor1;
+      app::Color bgColor2;
+
+      bool operator==(const State& o) const;
+      bool operator!=(const State& o) const { return !operator==(o); }
+    };
+
+    // One item for each layer of the sprite (including hidden
+    // layers and groups).
+    struct Item : render::CompositeCache::Item {
+      int layerFlags = 0;
+
+      bool operator==(const Item& o) const {
+        return (render::CompositeCache::Item::operator==(o) &&
+                layerFlags == o.layerFlags);
+      }
+      bool operator!=(const Item& o) const { return !operator==(o); }
+    };
+    typedef std::vector<Item> Items;
+
+    static Items makeItems(const doc::Sprite* sprite,
+                           const doc::frame_t frame);
+
+    // Updates the render state. All tiles are discarded if the state
+    // or the layers structure changed, or only the tiles that
+    // intersect the cels that were modified.
+    void update(const State& state,
+                Items&& items,
+                const render::Projection& proj);
+
+    // Returns the rendered tile or nullptr if it's not available.
+    os::Surface* tile(const int tx, const int ty);
+
+    // Returns the rendered tile even if it was invalidated (i.e. the
+    // last good version of the tile), or nullptr if there is no
+    // rendered version of it.
+    os::Surface* staleTile(const int tx, const int ty);
+
+    // Creates (or re-uses) the surface of a tile to render it.
+    os::Surface* createTile(const int tx, const int ty,
+                            const os::ColorSpaceRef& colorSpace);
+
+    // Returns the current version of the given tile (to render it
+    // asynchronously). The version changes each time the tile is
+    // invalidated.
+    uint64_t tileVersion(const int tx, const int ty);
+
+    // Replaces the surface of a tile rendered asynchronously, only
+    // if the tile wasn't invalidated since tileVersion() was called.
+    bool setTile(const int tx, const int ty,
+                 const uint64_t version,
+                 const os::SurfaceRef& surface);
+
+    // Incremented each time all the tiles are invalidated.
+    uint64_t generation() const { return m_generation; }
+
+    void invalidate(const bool keepStaleTiles = true);
+
+  private:
+    typedef std::pair<int, int> TileIndex;
+
+    struct Tile {
+      os::SurfaceRef surface;
+      uint64_t lastUse = 0;
+      uint64_t version = 0;
+      bool valid = false;
+    };
+
+    Tile& getTile(const int tx, const int ty,
+                  os::SurfaceRef* freeSurface = nullptr);
+    void invalidateTile(Tile& tile);
+    void invalidateBounds(const gfx::RectF& spriteBounds,
+                          const render::Projection& proj);
+    void updateMemSize();
+
+    State m_state;
+    Items m_items;
+    std::map<TileIndex, Tile> m_tiles;
+    uint64_t m_useCounter = 0;
+    uint64_t m_versionCounter = 0;
+    uint64_t m_generation = 0;
+
+    // Memory of all tile surfaces (read from any thread)
+    std::atomic<std::size_t> m_memSize = 0;
+    doc::MemoryAccount m_memoryAccount{
+      doc::MemoryPool::EditorCache,
+      [this]{ return m_memSize.load(); } };
+  };
+
+} // namespace app
+
+#endif
@@ -24,6 +24,7 @@
 #include "app/pref/preferences.h"
 #include "app/site.h"
 #include "app/snap_to_grid.h"
+#include "app/task.h"
 #include "app/ui/editor/pivot_helpers.h"
 #include "app/ui/editor/vec2.h"
 #include "app/ui/status_bar.h"
@@ -33,6 +34,7 @@
 #include "app/util/new_image_from_mask.h"
 #include "app/util/range_utils.h"
 #include "base/pi.h"
+#include "base/thread.h"
 #include "doc/algorithm/flip_image.h"
 #include "doc/algorithm/rotate.h"
 #include "doc/algorithm/rotsprite.h"
@@ -46,6 +48,7 @@
 #include "doc/util.h"
 #include "gfx/region.h"
 #include "render/render.h"
+#include "ui/system.h"
 
 #include <algorithm>
 
@@ -131,6 +134,7 @@ PixelsMovement::PixelsMovement(
   , m_canHandleFrameChange(false)
   , m_fastMode(false)
   , m_needsRotSpriteRedraw(false)
+  , m_alive(std::make_shared<bool>(true))
 {
   // Save and Lock the TilemapMode.
   // TODO: enable TilemapMode exchanges during PixelMovement.
@@ -179,6 +183,8 @@ PixelsMovement::PixelsMovement(
 
 PixelsMovement::~PixelsMovement()
 {
+  cancelRotSpriteTask();
+
   if (ColorBar::instance())
     ColorBar::instance()->unlockTilemapMode();
 }
@@ -201,9 +207,11 @@ void PixelsMovement::setFastMode(const bool fastMode)
   bool redraw = (m_fastMode && !fastMode);
   m_fastMode = fastMode;
   if (m_needsRotSpriteRedraw && redraw) {
-    redrawExtraImage();
-    update_screen_for_document(m_document);
     m_needsRotSpriteRedraw = false;
+    if (!startRotSpriteTask()) {
+      redrawExtraImage();
+      update_screen_for_document(m_document);
+    }
   }
 }
 
@@ -1130,6 +1138,10 @@ void PixelsMovement::setMaskColor(bool opaque, color_t mask_color)
 
 void PixelsMovement::redrawExtraImage(Transformation* transformation)
 {
+  // The extra cel is going to be replaced, so the result of the
+  // RotSprite task is not needed anymore.
+  cancelRotSpriteTask();
+
   if (!transformation)
     transformation = &m_currentData;
 
@@ -1180,6 +1192,109 @@ void PixelsMovement::redrawExtraImage(Transformation* transformation)
   }
 }
 
+// Renders the RotSprite version of the current transformation in a
+// background task. Returns false if the extra cel must be redrawn
+// from the UI thread.
+bool PixelsMovement::startRotSpriteTask()
+{
+  cancelRotSpriteTask();
+
+  if (m_site.tilemapMode() == TilemapMode::Tiles ||
+      !m_extraCel ||
+      !m_extraCel->image())
+    return false;
+
+  // The original layer and the source pixels are prepared here (as
+  // we cannot access the document from the background thread), and
+  // the task works with copies of the images so the UI thread can
+  // keep modifying the originals.
+  const Transformation& transformation = m_currentData;
+  const Transformation::Corners corners = transformation.transformedCorners();
+  const gfx::PointF pt(transformation.transformedBounds().origin());
+  const Image* extraImage = m_extraCel->image();
+
+  ImageRef dst(Image::create(extraImage->pixelFormat(),
+                             extraImage->width(),
+                             extraImage->height()));
+  drawImageBackground(transformation, dst.get(), pt, true);
+  ImageRef src(Image::createCopy(m_originalImage.get()));
+  std::shared_ptr<Mask> mask(
+    m_initialMask ? std::make_shared<Mask>(*m_initialMask): nullptr);
+
+  const int executionID = ++m_rotspriteExecutionID;
+  std::weak_ptr<bool> alive(m_alive);
+
+  m_rotspriteTask = std::make_unique<Task>();
+  m_rotspriteTask->run(
+    [this, alive, executionID, dst, src, mask, corners, pt](base::task_token& token){
+      // Warning: This is executed from a worker thread
+      try {
+        doc::algorithm::rotsprite_image(
+          dst.get(), src.get(), (mask ? mask->bitmap(): nullptr),
+          int(corners.leftTop().x-pt.x),
+          int(corners.leftTop().y-pt.y),
+          int(corners.rightTop().x-pt.x),
+          int(corners.rightTop().y-pt.y),
+          int(corners.rightBottom().x-pt.x),
+          int(corners.rightBottom().y-pt.y),
+          int(corners.leftBottom().x-pt.x),
+          int(corners.leftBottom().y-pt.y),
+          &token);
+      }
+      catch (const std::bad_alloc&) {
+        // Keep the fast version
+        ui::execute_from_ui_thread(
+          []{
+            StatusBar::instance()->showTip(
+              1000,
+              Strings::statusbar_tips_not_enough_rotsprite_memory());
+          });
+        return;
+      }
+
+      if (token.canceled())
+        return;
+
+      ui::execute_from_ui_thread(
+        [this, alive, executionID, dst]{
+          if (alive.lock())
+            onRotSpriteTaskDone(executionID, dst);
+        });
+    });
+  return true;
+}
+
+void PixelsMovement::cancelRotSpriteTask()
+{
+  if (m_rotspriteTask) {
+    m_rotspriteTask->cancel();
+    while (!m_rotspriteTask->completed())
+      base::this_thread::sleep_for(0.01);
+    m_rotspriteTask.reset();
+  }
+}
+
+void PixelsMovement::onRotSpriteTaskDone(const int executionID,
+                                         const doc::ImageRef& image)
+{
+  // Other task was started or the extra cel was redrawn in the
+  // meantime
+  if (executionID != m_rotspriteExecutionID ||
+      !m_rotspriteTask)
+    return;
+
+  cancelRotSpriteTask();
+
+  Image* extraImage = (m_extraCel ? m_extraCel->image(): nullptr);
+  if (!extraImage ||
+      extraImage->size() != image->size() ||
+      extraImage->pixelFormat() != image->pixelFormat())
+    return;
+
+  extraImage->copy(image.get(), gfx::Clip(image->bounds()));
+  update_screen_for_document(m_document);
+}
+
 void PixelsMovement::redrawCurrentMask()
 {
   drawMask(m_currentMask.get(), true);
@@ -1212,32 +1327,7 @@ void PixelsMovement::drawImage(
       m_initialMask.get());
   }
   else {
-    dst->setMaskColor(m_site.sprite()->transparentColor());
-    dst->clear(dst->maskColor());
-
-    if (renderOriginalLayer) {
-      render::Render render;
-      render.renderLayer(
-        dst, m_site.layer(), m_site.frame(),
-        gfx::Clip(bounds.x-pt.x, bounds.y-pt.y, bounds),
-        BlendMode::SRC);
-    }
-
-    color_t maskColor = m_maskColor;
-
-    // In case that Opaque option is enabled, or if we are drawing the
-    // image for the clipboard (renderOriginalLayer is false), we use a
-    // dummy mask color to call drawParallelogram(). In this way all
-    // pixels will be opaqued (all colors are copied)
-    if (m_opaque ||
-        !renderOriginalLayer) {
-      if (m_originalImage->pixelFormat() == IMAGE_INDEXED)
-        maskColor = -1;
-      else
-        maskColor = 0;
-    }
-    m_originalImage->setMaskColor(maskColor);
-
+    drawImageBackground(transformation, dst, pt, renderOriginalLayer);
     drawParallelogram(
       transformation,
       dst, m_originalImage.get(),
@@ -1245,6 +1335,42 @@ void PixelsMovement::drawImage(
   }
 }
 
+// Draws the pixels below the transformed image, and prepares the
+// mask color of m_originalImage to draw it over them.
+void PixelsMovement::drawImageBackground(
+  const Transformation& transformation,
+  doc::Image* dst, const gfx::PointF& pt,
+  const bool renderOriginalLayer)
+{
+  dst->setMaskColor(m_site.sprite()->transparentColor());
+  dst->clear(dst->maskColor());
+
+  if (renderOriginalLayer) {
+    gfx::Rect bounds =
+      transformation.transformedCorners().bounds(transformation.cornerThick());
+    render::Render render;
+    render.renderLayer(
+      dst, m_site.layer(), m_site.frame(),
+      gfx::Clip(bounds.x-pt.x, bounds.y-pt.y, bounds),
+      BlendMode::SRC);
+  }
+
+  color_t maskColor = m_maskColor;
+
+  // In case that Opaque option is enabled, or if we are drawing the
+  // image for the clipboard (renderOriginalLayer is false), we use a
+  // dummy mask color to call drawParallelogram(). In this way all
+  // pixels will be opaqued (all colors are copied)
+  if (m_opaque ||
+      !renderOriginalLayer) {
+    if (m_originalImage->pixelFormat() == IMAGE_INDEXED)
+      maskColor = -1;
+    else
+      maskColor = 0;
+  }
+  m_originalImage->setMaskColor(maskColor);
+}
+
 void PixelsMovement::drawMask(doc::Mask* mask, bool shrink)
 {
   auto corners = m_currentData.transformedCorners();
@@ -31,6 +31,7 @@ namespace doc {
 
 namespace app {
   class Doc;
+  class Task;
 
   namespace cmd {
     class SetMask;
@@ -140,11 +141,19 @@ namespace app {
     void onPivotChange();
     void onRotationAlgorithmChange();
     void redrawExtraImage(Transformation* transformation = nullptr);
+    bool startRotSpriteTask();
+    void cancelRotSpriteTask();
+    void onRotSpriteTaskDone(const int executionID,
+                             const doc::ImageRef& image);
     void redrawCurrentMask();
     void drawImage(
       const Transformation& transformation,
       doc::Image* dst, const gfx::PointF& pt,
       const bool renderOriginalLayer);
+    void drawImageBackground(
+      const Transformation& transformation,
+      doc::Image* dst, const gfx::PointF& pt,
+      const bool renderOriginalLayer);
     void drawMask(doc::Mask* dst, bool shrink);
     void drawParallelogram(
       const Transformation& transformation,
@@ -203,6 +212,14 @@ namespace app {
     bool m_fastMode;
     bool m_needsRotSpriteRedraw;
 
+    // When the fast mode is disabled, the RotSprite version is
+    // rendered in a background task (the fast version is displayed
+    // in the meantime). m_alive is used to know if the PixelsMovement
+    // still exists when the task result arrives to the UI thread.
+    std::unique_ptr<Task> m_rotspriteTask;
+    int m_rotspriteExecutionID = 0;
+    std::shared_ptr<bool> m_alive;
+
     // Commands used in the interaction with the transformed pixels.
     // This is used to re-create the whole interaction on each
     // modified cel when we are modifying multiples cels at the same
@@ -26,6 +26,9 @@
 #include "ui/message.h"
 #include "ui/system.h"
 
+#include <algorithm>
+#include <vector>
+
 namespace app {
 
 using namespace ui;
@@ -114,6 +117,8 @@ void PlayState::onEnterState(Editor* editor)
       m_playAll  ? doc::Playback::PlayWithoutTagsInLoop :
                   doc::Playback::PlayInLoop,
       m_tag);
+    m_aheadFrames.clear();
+    fillAheadFrames();
     m_nextFrameTime = getNextFrameTime();
     m_curFrameTick = base::current_tick();
     m_playTimer.start();
@@ -126,6 +131,7 @@ EditorState::LeaveAction PlayState::onLeaveState(Editor* editor, EditorState* ne
   // (we keep playing the animation).
   if (!m_toScroll) {
     m_playTimer.stop();
+    m_editor->discardFramesAhead();
 
     if (m_playOnce || Preferences::instance().general.rewindOnStop())
       m_editor->setFrame(m_refFrame);
@@ -222,19 +228,29 @@ void PlayState::onPlaybackTick()
   m_nextFrameTime -= (base::current_tick() - m_curFrameTick);
 
   while (m_nextFrameTime <= 0) {
-    doc::frame_t frame = m_playback.nextFrame();
-    if (m_playback.isStopped() ||
-        // TODO invalid frame from Playback::nextFrame(), in this way
+    if (m_aheadFrames.empty())
+      fillAheadFrames();
+
+    // The playback was stopped
+    if (m_aheadFrames.empty()) {
+      m_editor->stop();
+      return;
+    }
+
+    doc::frame_t frame = m_aheadFrames.front();
+    m_aheadFrames.pop_front();
+    if (// TODO invalid frame from Playback::nextFrame(), in this way
         //      we avoid any kind of crash or assert fail
         frame < 0 || frame > m_editor->sprite()->lastFrame()) {
       TRACEARGS("!!! PlayState: invalid frame from Playback::nextFrame() frame=", frame);
       m_editor->stop();
-      break;
+      return;
     }
     m_editor->setFrame(frame);
     m_nextFrameTime += getNextFrameTime();
   }
 
+  fillAheadFrames();
   m_curFrameTick = base::current_tick();
 }
 
@@ -268,6 +284,28 @@ void PlayState::onBeforeCommandExecution(CommandExecutionEvent& ev)
   m_editor->stop();
 }
 
+// Advances the playback to keep "experimental.render_ahead_frames"
+// frames (at least one) ahead of the displayed frame, and asks the
+// editor to render them in background.
+void PlayState::fillAheadFrames()
+{
+  const int renderAhead =
+    Preferences::instance().experimental.renderAheadFrames();
+
+  while (int(m_aheadFrames.size()) < std::max(1, renderAhead)) {
+    const doc::frame_t frame = m_playback.nextFrame();
+    if (m_playback.isStopped())
+      break;
+    m_aheadFrames.push_back(frame);
+  }
+
+  if (renderAhead > 0) {
+    m_editor->renderFramesAhead(
+      std::vector<doc::frame_t>(m_aheadFrames.begin(),
+                                m_aheadFrames.end()));
+  }
+}
+
 double PlayState::getNextFrameTime()
 {
   return
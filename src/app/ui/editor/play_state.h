@@ -16,6 +16,8 @@
 #include "obs/connection.h"
 #include "ui/timer.h"
 
+#include <deque>
+
 namespace doc {
   class Tag;
 }
@@ -50,9 +52,15 @@ namespace app {
     void onBeforeCommandExecution(CommandExecutionEvent& ev);
 
     double getNextFrameTime();
+    void fillAheadFrames();
 
     Editor* m_editor;
+
+    // The playback is ahead of the displayed frame, the frames in
+    // between are in m_aheadFrames (they are rendered in background
+    // before they are displayed).
     doc::Playback m_playback;
+    std::deque<doc::frame_t> m_aheadFrames;
     bool m_playOnce;
     bool m_playAll;
     bool m_playSubtags;
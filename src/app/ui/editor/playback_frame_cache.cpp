@@ -0,0 +1,219 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/ui/editor/playback_frame_cache.h"
+
+#include "app/doc_access.h"
+#include "app/ui/editor/editor_render.h"
+#include "base/log.h"
+#include "doc/sprite.h"
+#include "gfx/clip.h"
+#include "render/projection.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace app {
+
+// Maximum memory used by the rendered frames
+static constexpr std::size_t kMaxBytes = 256*1024*1024;
+
+static int get_worker_threads()
+{
+  return std::clamp(int(std::thread::hardware_concurrency())/2, 1, 4);
+}
+
+PlaybackFrameCache::PlaybackFrameCache()
+  : m_pool(get_worker_threads())
+{
+  for (int i=0; i<get_worker_threads(); ++i)
+    m_renders.push_back(std::make_unique<EditorRender>());
+}
+
+PlaybackFrameCache::~PlaybackFrameCache()
+{
+  clear();
+  m_pool.wait_all();
+}
+
+bool PlaybackFrameCache::contains(const doc::frame_t frame,
+                                  const EditorTileCache::State& state,
+                                  const EditorTileCache::Items& items)
+{
+  const std::lock_guard lock(m_mutex);
+  auto it = m_frames.find(frame);
+  if (it != m_frames.end() &&
+      it->second.state == state &&
+      it->second.items == items)
+    return true;
+
+  return isPendingUnlocked(frame, state, items);
+}
+
+void PlaybackFrameCache::request(Job&& job)
+{
+  {
+    const std::lock_guard lock(m_mutex);
+    if (isPendingUnlocked(job.frame, job.state, job.items))
+      return;
+
+    // Jobs with other render state are out of date
+    m_jobs.erase(
+      std::remove_if(
+        m_jobs.begin(), m_jobs.end(),
+        [&job](const Job& other){
+          return (other.frame == job.frame ||
+                  other.state != job.state);
+        }),
+      m_jobs.end());
+
+    if (m_maxFrames == 0) {
+      const std::size_t frameBytes =
+        std::size_t(job.surface->width()) * job.surface->height() * 4;
+      m_maxFrames = int(std::clamp<std::size_t>(kMaxBytes / frameBytes, 2, 64));
+    }
+
+    m_jobs.push_back(std::move(job));
+  }
+  m_pool.execute([this]{ renderNextJob(); });
+}
+
+os::SurfaceRef PlaybackFrameCache::frame(const doc::frame_t frame,
+                                         const EditorTileCache::State& state,
+                                         const EditorTileCache::Items& items)
+{
+  const std::lock_guard lock(m_mutex);
+  auto it = m_frames.find(frame);
+  if (it == m_frames.end() ||
+      it->second.state != state ||
+      it->second.items != items)
+    return nullptr;
+
+  it->second.lastUse = ++m_useCounter;
+  return it->second.surface;
+}
+
+void PlaybackFrameCache::clear()
+{
+  const std::lock_guard lock(m_mutex);
+  m_jobs.clear();
+  m_frames.clear();
+  m_memSize = 0;
+}
+
+bool PlaybackFrameCache::isPendingUnlocked(const doc::frame_t frame,
+                                           const EditorTileCache::State& state,
+                                           const EditorTileCache::Items& items) const
+{
+  auto isSameJob = [&](const Job& job){
+    return (job.frame == frame &&
+            job.state == state &&
+            job.items == items);
+  };
+  return (std::any_of(m_jobs.begin(), m_jobs.end(), isSameJob) ||
+          std::any_of(m_rendering.begin(), m_rendering.end(), isSameJob));
+}
+
+// Called from a worker thread
+void PlaybackFrameCache::renderNextJob()
+{
+  std::unique_ptr<EditorRender> render;
+  Job job;
+  {
+    const std::lock_guard lock(m_mutex);
+    if (m_jobs.empty())         // Canceled
+      return;
+
+    job = std::move(m_jobs.front());
+    m_jobs.pop_front();
+
+    // There is one renderer for each worker thread
+    ASSERT(!m_renders.empty());
+    render = std::move(m_renders.back());
+    m_renders.pop_back();
+
+    // Copy of the job (without the surface) to avoid requesting
+    // the same frame while it's being rendered
+    Job info;
+    info.frame = job.frame;
+    info.state = job.state;
+    info.items = job.items;
+    m_rendering.push_back(std::move(info));
+  }
+
+  bool rendered = false;
+  try {
+    WeakDocReader reader(job.doc);
+    if (reader.isLocked()) {
+      render->setNewBlendMethod(job.newBlend);
+      render->setRefLayersVisiblity(true);
+      render->setSelectedLayer(job.layer);
+      render->setNonactiveLayersOpacity(job.nonactiveLayersOpacity);
+      render->setBgOptions(job.bg);
+      render->disableOnionskin();
+      render->setProjection(render::Projection());
+      render->renderSprite(job.surface.get(), job.sprite, job.frame,
+                           gfx::Clip(job.sprite->bounds()));
+
+      // If the UI thread wanted to modify the document in the
+      // meantime, we cannot trust in the rendered frame.
+      rendered = reader.isLocked();
+    }
+  }
+  catch (const std::exception& ex) {
+    LOG(ERROR, "EDIT: Error rendering frame %d ahead: %s\n",
+        job.frame, ex.what());
+  }
+
+  {
+    const std::lock_guard lock(m_mutex);
+    m_renders.push_back(std::move(render));
+    m_rendering.erase(
+      std::find_if(m_rendering.begin(), m_rendering.end(),
+                   [&job](const Job& other){
+                     return (other.frame == job.frame &&
+                             other.state == job.state);
+                   }));
+
+    if (rendered) {
+      Entry& entry = m_frames[job.frame];
+      if (entry.surface)
+        m_memSize -= std::size_t(entry.surface->width()) * entry.surface->height() * 4;
+      m_memSize += std::size_t(job.surface->width()) * job.surface->height() * 4;
+
+      entry.state = std::move(job.state);
+      entry.items = std::move(job.items);
+      entry.surface = std::move(job.surface);
+      entry.lastUse = ++m_useCounter;
+      shrink();
+    }
+  }
+
+  if (rendered)
+    doc::check_memory_soft_limit();
+}
+
+void PlaybackFrameCache::shrink()
+{
+  while (int(m_frames.size()) > m_maxFrames) {
+    auto lru = std::min_element(
+      m_frames.begin(), m_frames.end(),
+      [](const auto& a, const auto& b){
+        return a.second.lastUse < b.second.lastUse;
+      });
+    if (lru->second.surface) {
+      const os::Surface* surface = lru->second.surface.get();
+      m_memSize -= std::size_t(surface->width()) * surface->height() * 4;
+    }
+    m_frames.erase(lru);
+  }
+}
+
+} // namespace app
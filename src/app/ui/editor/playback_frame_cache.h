@@ -0,0 +1,119 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_UI_EDITOR_PLAYBACK_FRAME_CACHE_H_INCLUDED
+#define APP_UI_EDITOR_PLAYBACK_FRAME_CACHE_H_INCLUDED
+#pragma once
+
+#include "app/ui/editor/editor_tile_cache.h"
+#include "base/disable_copying.h"
+#include "base/thread_pool.h"
+#include "doc/frame.h"
+#include "doc/memory_account.h"
+#include "os/surface.h"
+#include "render/bg_options.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace doc {
+  class Layer;
+  class Sprite;
+}
+
+namespace app {
+  class Doc;
+  class EditorRender;
+
+  // Frames of the sprite rendered ahead of time in worker threads
+  // while the animation is being played (PlayState), so heavy frames
+  // can be displayed without rendering them in the UI thread.
+  //
+  // Frames are rendered in sprite coordinates (only for the new
+  // render engine and the SimpleRenderer). Each frame keeps the
+  // render state and the layers/cels it was rendered with, so it's
+  // used only if nothing changed in the meantime. The least recently
+  // used frames are discarded when the cache is full (so all frames
+  // of short animations are kept after the first loop).
+  class PlaybackFrameCache {
+  public:
+    // Everything needed to render one frame (it can be used only
+    // from the UI thread before the frame is rendered).
+    struct Job {
+      Doc* doc = nullptr;
+      const doc::Sprite* sprite = nullptr;
+      doc::frame_t frame = 0;
+      const doc::Layer* layer = nullptr;
+      render::BgOptions bg;
+      bool newBlend = true;
+      int nonactiveLayersOpacity = 255;
+      EditorTileCache::State state;
+      EditorTileCache::Items items;
+      os::SurfaceRef surface;
+    };
+
+    PlaybackFrameCache();
+    ~PlaybackFrameCache();
+
+    // Returns true if the given frame (with the given render state
+    // and layers/cels) is already rendered or queued to be rendered.
+    bool contains(const doc::frame_t frame,
+                  const EditorTileCache::State& state,
+                  const EditorTileCache::Items& items);
+
+    // Adds a frame to be rendered in background.
+    void request(Job&& job);
+
+    // Returns the rendered frame or nullptr if it's not available.
+    os::SurfaceRef frame(const doc::frame_t frame,
+                         const EditorTileCache::State& state,
+                         const EditorTileCache::Items& items);
+
+    // Cancels all the queued jobs and discards all frames.
+    void clear();
+
+  private:
+    struct Entry {
+      EditorTileCache::State state;
+      EditorTileCache::Items items;
+      os::SurfaceRef surface;
+      uint64_t lastUse = 0;
+    };
+
+    bool isPendingUnlocked(const doc::frame_t frame,
+                           const EditorTileCache::State& state,
+                           const EditorTileCache::Items& items) const;
+    void renderNextJob();
+    void shrink();
+
+    std::mutex m_mutex;
+    std::deque<Job> m_jobs;
+    std::vector<Job> m_rendering;
+    std::map<doc::frame_t, Entry> m_frames;
+    uint64_t m_useCounter = 0;
+    int m_maxFrames = 0;
+
+    // Renderers (one for each worker thread) created in the UI thread
+    std::vector<std::unique_ptr<EditorRender>> m_renders;
+
+    std::atomic<std::size_t> m_memSize = 0;
+    base::thread_pool m_pool;
+    doc::MemoryAccount m_memoryAccount{
+      doc::MemoryPool::EditorCache,
+      [this]{ return m_memSize.load(); },
+      [this]{ clear(); } };
+
+    DISABLE_COPYING(PlaybackFrameCache);
+  };
+
+} // namespace app
+
+#endif
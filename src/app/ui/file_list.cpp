@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -35,6 +35,7 @@ using namespace ui;
 FileList::FileList()
   : Widget(kGenericWidget)
   , m_currentFolder(FileSystemModule::instance()->getRootFileItem())
+  , m_loadingChildren(false)
   , m_req_valid(false)
   , m_selected(nullptr)
   , m_isearchClock(0)
@@ -661,6 +662,9 @@ void FileList::onCurrentFolderChanged()
 
 void FileList::onMonitoringTick()
 {
+  if (m_loadingChildren)
+    updateListedChildren();
+
   auto start = base::current_tick();
   while (!m_generateThumbnailsForTheseItems.empty() &&
          // No more than 200ms launching thumbnail generators
@@ -848,7 +852,9 @@ void FileList::makeSelectedFileitemVisible()
 
 void FileList::regenerateList()
 {
-  // get the children of the current folder
+  // get the children of the current folder (they are listed in a
+  // background thread, updateListedChildren() will add new items)
+  m_loadingChildren = m_currentFolder->loadChildrenAsync();
   m_list = m_currentFolder->children();
 
   // filter the list by the available extensions
@@ -879,6 +885,44 @@ void FileList::regenerateList()
     m_selectedItems.clear();
 }
 
+void FileList::updateListedChildren()
+{
+  if (!m_currentFolder->pollChildren())
+    return;
+
+  // Keep the selected items (regenerateList() deselects them)
+  const FileItemList selectedItems =
+    (m_multiselect ? selectedFileItems(): FileItemList());
+
+  regenerateList();
+
+  auto inList = [this](const IFileItem* fi) {
+    return (std::find(m_list.begin(), m_list.end(), fi) != m_list.end());
+  };
+
+  // Forget items that were removed from the folder
+  if (m_selected && !inList(m_selected))
+    m_selected = nullptr;
+  if (m_itemToGenerateThumbnail && !inList(m_itemToGenerateThumbnail))
+    m_itemToGenerateThumbnail = nullptr;
+  m_generateThumbnailsForTheseItems.erase(
+    std::remove_if(m_generateThumbnailsForTheseItems.begin(),
+                   m_generateThumbnailsForTheseItems.end(),
+                   [&inList](const IFileItem* fi){ return !inList(fi); }),
+    m_generateThumbnailsForTheseItems.end());
+
+  if (m_multiselect) {
+    for (int i=0; i<int(m_list.size()); ++i) {
+      if (std::find(selectedItems.begin(), selectedItems.end(), m_list[i])
+          != selectedItems.end())
+        m_selectedItems[i] = true;
+    }
+  }
+
+  invalidate();
+  View::getView(this)->updateView();
+}
+
 int FileList::selectedIndex() const
 {
   for (auto it = m_list.begin(), end = m_list.end();
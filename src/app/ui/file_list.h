@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -87,6 +87,7 @@ namespace app {
     ItemInfo getFileItemInfo(int i) const;
     void makeSelectedFileitemVisible();
     void regenerateList();
+    void updateListedChildren();
     int selectedIndex() const;
     void selectIndex(int index);
     void generateThumbnailForFileItem(IFileItem* fi);
@@ -101,6 +102,10 @@ namespace app {
 
     IFileItem* m_currentFolder;
     FileItemList m_list;
+
+    // True if the children of the current folder are being listed in
+    // a background thread (m_list is updated in onMonitoringTick()).
+    bool m_loadingChildren;
     std::vector<ItemInfo> m_info;
 
     bool m_req_valid;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2022  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -63,10 +63,6 @@ public:
     , m_filename(fn) {
   }
 
-  const std::string& filename() const {
-    return m_filename;
-  }
-
 private:
   void onPaint(PaintEvent& ev) override {
     ListItem::onPaint(ev);
@@ -98,17 +94,15 @@ private:
     if (!selected || m_image)
       return;
 
-    ListBox* listbox = static_cast<ListBox*>(parent());
-    if (!listbox)
-      return;
-
     auto theme = app::skin::SkinTheme::get(this);
     gfx::Color color = theme->colors.text();
 
     try {
+      // All rows of the VirtualListBox have the same height, so the
+      // thumbnail is rendered to fit the height of the text.
       m_image.reset(
         render_text(
-          m_filename, 16,
+          m_filename, std::max(1, textHeight()),
           "ABCDEabcde",             // TODO custom text
           doc::rgba(gfx::getr(color),
                     gfx::getg(color),
@@ -116,12 +110,9 @@ private:
                     gfx::geta(color)),
           true));                   // antialias
 
-      View* view = View::getView(listbox);
-      view->updateView();
-      listbox->makeChildVisible(this);
-
       // Save the thumbnail for future FontPopups
       g_thumbnails[m_filename] = m_image;
+      invalidate();
     }
     catch (const std::exception&) {
       // Ignore errors
@@ -138,6 +129,7 @@ FontPopup::FontPopup()
                 ClickBehavior::CloseOnClickInOtherWindow,
                 EnterBehavior::DoNothingOnEnter)
   , m_popup(new gen::FontPopup())
+  , m_listBox(this)
 {
   setAutoRemap(false);
   setBorder(gfx::Border(4*guiscale()));
@@ -157,37 +149,34 @@ FontPopup::FontPopup()
 
   // Create a list of fullpaths to every font found in all font
   // directories (fontDirs)
-  base::paths files;
   for (const auto& fontDir : fontDirs) {
     for (const auto& file : base::list_files(fontDir, base::ItemType::Files)) {
-      files.push_back(base::join_path(fontDir, file));
+      std::string ext = base::string_to_lower(base::get_file_extension(file));
+      if (ext == "ttf" || ext == "ttc" ||
+          ext == "otf" || ext == "dfont")
+        m_files.push_back(base::join_path(fontDir, file));
     }
   }
 
   // Sort all files by "file title"
   std::sort(
-    files.begin(), files.end(),
+    m_files.begin(), m_files.end(),
     [](const std::string& a, const std::string& b){
       return base::utf8_icmp(base::get_file_title(a), base::get_file_title(b)) < 0;
     });
 
-  // Create one FontItem for each font
-  for (auto& file : files) {
-    std::string ext = base::string_to_lower(base::get_file_extension(file));
-    if (ext == "ttf" || ext == "ttc" ||
-        ext == "otf" || ext == "dfont")
-      m_listBox.addChild(new FontItem(file));
-  }
-
-  if (m_listBox.children().empty())
-    m_listBox.addChild(new ListItem(Strings::font_popup_empty_fonts()));
+  // FontItems are created only for the visible rows of the list
+  m_filteredFiles.resize(m_files.size());
+  for (int i=0; i<int(m_files.size()); ++i)
+    m_filteredFiles[i] = i;
+  m_listBox.modelChanged();
 }
 
 void FontPopup::showPopup(Display* display,
                           const gfx::Rect& buttonBounds)
 {
   m_popup->loadFont()->setEnabled(false);
-  m_listBox.selectChild(NULL);
+  m_listBox.selectIndex(-1);
 
   ui::fit_bounds(display, this,
                  gfx::Rect(buttonBounds.x, buttonBounds.y2(), 32, 32),
@@ -204,20 +193,36 @@ void FontPopup::showPopup(Display* display,
   openWindow();
 }
 
+int FontPopup::listSize() const
+{
+  // One row to show the "no fonts" message
+  if (m_files.empty())
+    return 1;
+
+  return int(m_filteredFiles.size());
+}
+
+ui::ListItem* FontPopup::createListItem(int index)
+{
+  if (m_files.empty())
+    return new ListItem(Strings::font_popup_empty_fonts());
+
+  return new FontItem(m_files[m_filteredFiles[index]]);
+}
+
 void FontPopup::onSearchChange()
 {
   std::string searchText = m_popup->search()->text();
-  Widget* firstItem = nullptr;
 
   MatchWords match(searchText);
-  for (auto child : m_listBox.children()) {
-    bool visible = match(child->text());
-    if (visible && !firstItem)
-      firstItem = child;
-    child->setVisible(visible);
+  m_filteredFiles.clear();
+  for (int i=0; i<int(m_files.size()); ++i) {
+    if (match(base::get_file_title(m_files[i])))
+      m_filteredFiles.push_back(i);
   }
 
-  m_listBox.selectChild(firstItem);
+  m_listBox.modelChanged();
+  m_listBox.selectIndex(m_filteredFiles.empty() || m_files.empty() ? -1: 0);
   layout();
 }
 
@@ -228,11 +233,11 @@ void FontPopup::onChangeFont()
 
 void FontPopup::onLoadFont()
 {
-  FontItem* child = dynamic_cast<FontItem*>(m_listBox.getSelectedChild());
-  if (!child)
+  const int index = m_listBox.getSelectedIndex();
+  if (index < 0 || m_files.empty())
     return;
 
-  std::string filename = child->filename();
+  std::string filename = m_files[m_filteredFiles[index]];
   if (base::is_file(filename))
     Load(filename);             // Fire Load signal
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2021  Igara Studio S.A.
+// Copyright (C) 2021-2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -9,8 +9,11 @@
 #define APP_UI_FONT_POPUP_H_INCLUDED
 #pragma once
 
-#include "ui/listbox.h"
+#include "base/paths.h"
 #include "ui/popup_window.h"
+#include "ui/virtual_listbox.h"
+
+#include <vector>
 
 namespace ui {
   class Button;
@@ -23,7 +26,8 @@ namespace app {
     class FontPopup;
   }
 
-  class FontPopup : public ui::PopupWindow {
+  class FontPopup : public ui::PopupWindow
+                  , public ui::VirtualListBox::Model {
   public:
     FontPopup();
 
@@ -33,13 +37,22 @@ namespace app {
     obs::signal<void(const std::string&)> Load;
 
   protected:
+    // ui::VirtualListBox::Model impl
+    int listSize() const override;
+    ui::ListItem* createListItem(int index) override;
+
     void onSearchChange();
     void onChangeFont();
     void onLoadFont();
 
   private:
     gen::FontPopup* m_popup;
-    ui::ListBox m_listBox;
+    ui::VirtualListBox m_listBox;
+
+    // Fullpaths of all fonts, and indexes of the fonts that match the
+    // search text (the rows of m_listBox).
+    base::paths m_files;
+    std::vector<int> m_filteredFiles;
   };
 
 } // namespace app
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2022  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -841,7 +841,19 @@ void PaletteView::onPaint(ui::PaintEvent& ev)
   if (dragging && !m_copy) palSize -= picksCount;
   if (resizing) palSize = m_hot.color;
 
-  for (int i=0; i<palSize; ++i) {
+  // Only entries inside the clipping region are drawn (e.g. the
+  // visible rows of a big palette inside the view).
+  const gfx::Rect clipBounds = g->getClipBounds();
+  const int spacing = childSpacing();
+  int firstEntry = 0;
+  if (!dragging) {
+    const int step = boxSizePx() + spacing;
+    const int firstRow = (clipBounds.y - getPaletteEntryBounds(0).y) / step;
+    if (firstRow > 0)
+      firstEntry = std::min(firstRow*m_columns, palSize);
+  }
+
+  for (int i=firstEntry; i<palSize; ++i) {
     if (dragging) {
       if (!m_copy) {
         while (i+idxOffset < m_selectedEntries.size() &&
@@ -854,9 +866,16 @@ void PaletteView::onPaint(ui::PaintEvent& ev)
     }
 
     gfx::Rect box = getPaletteEntryBounds(i + boxOffset);
+    if (!clipBounds.intersects(gfx::Rect(box).enlarge(spacing))) {
+      // The next entries are below the clipping region
+      if (box.y > clipBounds.y2())
+        break;
+      continue;
+    }
+
     gfx::Color negColor;
     m_adapter->drawEntry(g, theme, i + idxOffset, i + boxOffset,
-                         childSpacing(), box, negColor);
+                         spacing, box, negColor);
     const int boxsize = boxSizePx();
     const int scale = guiscale();
 
@@ -1122,18 +1141,19 @@ PaletteView::Hit PaletteView::hitTest(const gfx::Point& pos)
   View* view = View::getView(this);
   ASSERT(view);
   gfx::Rect vp = view->viewportBounds();
-  for (int i=0; ; ++i) {
-    gfx::Rect box = getPaletteEntryBounds(i);
-    if (i >= size && box.y2() > vp.h)
-      break;
-
-    box.w += childSpacing();
-    box.h += childSpacing();
-    if (box.contains(pos))
-      return Hit(Hit::COLOR, i);
-  }
-
   gfx::Rect box = getPaletteEntryBounds(0);
+  {
+    // Each entry box is expanded with the child spacing, so we can
+    // calculate the column/row directly from the position.
+    const int step = boxSizePx() + childSpacing();
+    const int dx = pos.x - box.x;
+    const int dy = pos.y - box.y;
+    if (dx >= 0 && dy >= 0 && dx/step < m_columns) {
+      const int i = (dy/step)*m_columns + dx/step;
+      if (i < size || getPaletteEntryBounds(i).y2() <= vp.h)
+        return Hit(Hit::COLOR, i);
+    }
+  }
 
   int colsLimit = m_columns;
   if (m_state == State::DRAGGING_OUTLINE)
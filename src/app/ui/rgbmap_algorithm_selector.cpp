@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2021  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -19,12 +19,14 @@ RgbMapAlgorithmSelector::RgbMapAlgorithmSelector()
   // addItem() must match the RgbMapAlgorithm enum
   static_assert(int(doc::RgbMapAlgorithm::DEFAULT) == 0 &&
                 int(doc::RgbMapAlgorithm::RGB5A3) == 1 &&
-                int(doc::RgbMapAlgorithm::OCTREE) == 2,
+                int(doc::RgbMapAlgorithm::OCTREE) == 2 &&
+                int(doc::RgbMapAlgorithm::KDTREE) == 3,
                 "Unexpected doc::RgbMapAlgorithm values");
 
   addItem(Strings::rgbmap_algorithm_selector_default());
   addItem(Strings::rgbmap_algorithm_selector_rgb5a3());
   addItem(Strings::rgbmap_algorithm_selector_octree());
+  addItem(Strings::rgbmap_algorithm_selector_kdtree());
 
   algorithm(doc::RgbMapAlgorithm::DEFAULT);
 }
@@ -108,6 +108,7 @@ struct Timeline::DrawCelData {
   CelIterator activeIt;         // Active Cel iterator
   CelIterator firstLink;        // First link to the active cel
   CelIterator lastLink;         // Last link to the active cel
+  bool thumbnails = false;      // Draw thumbnails of the cels
 };
 
 namespace {
@@ -288,6 +289,7 @@ Timeline::~Timeline()
   m_context->documents().remove_observer(this);
   m_context->remove_observer(this);
   m_confPopup.reset();
+  m_thumbnails.reset();
 }
 
 void Timeline::setZoom(const double zoom)
@@ -412,6 +414,9 @@ void Timeline::detachDocument()
     m_document = nullptr;
   }
 
+  if (m_thumbnails)
+    m_thumbnails->clear();
+
   // Reset all pointers to this document, even DocRanges, we don't
   // want to store a pointer to a layer of a document that we are not
   // observing anymore (because the document might be deleted soon).
@@ -1757,6 +1762,7 @@ void Timeline::onPaint(ui::PaintEvent& ev)
 
     // Draw each visible layer.
     DrawCelData data;
+    data.thumbnails = (m_zoom > 1 && docPref().thumbnails.enabled());
     for (layer=lastLayer; layer>=firstLayer; --layer) {
       {
         IntersectClip clip(g, getLayerHeadersBounds());
@@ -2479,16 +2485,24 @@ void Timeline::drawCel(ui::Graphics* g,
   drawPart(g, bounds, nullptr, style, is_loosely_active, is_hover);
 
   // Draw thumbnail
-  if ((docPref().thumbnails.enabled() && m_zoom > 1) && image) {
+  if (data && data->thumbnails && image) {
     gfx::Rect thumb_bounds =
       gfx::Rect(bounds).shrink(
         skinTheme()->calcBorder(this, style));
 
     if (!thumb_bounds.isEmpty()) {
-      if (os::SurfaceRef surface = thumb::get_cel_thumbnail(cel, thumb_bounds.size())) {
-        const int t = std::clamp(thumb_bounds.w/8, 4, 16);
-        draw_checkered_grid(g, thumb_bounds, gfx::Size(t, t), docPref());
+      if (!m_thumbnails) {
+        m_thumbnails = std::make_shared<thumb::CelThumbnailCache>(
+          [this]{ invalidate(); });
+      }
 
+      // The checkered background is the placeholder until the
+      // thumbnail is generated in the background.
+      const int t = std::clamp(thumb_bounds.w/8, 4, 16);
+      draw_checkered_grid(g, thumb_bounds, gfx::Size(t, t), docPref());
+
+      if (os::SurfaceRef surface = m_thumbnails->get(m_document, cel,
+                                                     thumb_bounds.size())) {
         g->drawRgbaSurface(surface.get(),
                            thumb_bounds.center().x-surface->width()/2,
                            thumb_bounds.center().y-surface->height()/2);
@@ -2650,9 +2664,15 @@ void Timeline::drawTags(ui::Graphics* g)
     g->fillRect(theme->colors.timelineBandHighlight(), bandBounds);
   }
 
+  frame_t firstFrame, lastFrame;
+  getDrawableFrames(&firstFrame, &lastFrame);
+
   int passes = (m_tagFocusBand >= 0 ? 2: 1);
   for (int pass=0; pass<passes; ++pass) {
     for (Tag* tag : m_sprite->tags()) {
+      if (!isTagVisible(tag, firstFrame, lastFrame))
+        continue;
+
       int band = -1;
       if (m_tagFocusBand >= 0) {
         auto it = m_tagBand.find(tag);
@@ -3238,25 +3258,13 @@ void Timeline::regenerateRows()
   ASSERT(m_document);
   ASSERT(m_sprite);
 
-  size_t nlayers = 0;
-  for_each_expanded_layer(
-    m_sprite->root(),
-    [&nlayers](Layer* layer, int level, LayerFlags flags) {
-      ++nlayers;
-    });
-
-  if (m_rows.size() != nlayers) {
-    if (nlayers > 0)
-      m_rows.resize(nlayers);
-    else
-      m_rows.clear();
-  }
-
-  size_t i = 0;
+  m_rows.clear();
+  m_rowIndex.clear();
   for_each_expanded_layer(
     m_sprite->root(),
-    [&i, this](Layer* layer, int level, LayerFlags flags) {
-      m_rows[i++] = Row(layer, level, flags);
+    [this](Layer* layer, int level, LayerFlags flags) {
+      m_rowIndex[layer] = layer_t(m_rows.size());
+      m_rows.push_back(Row(layer, level, flags));
     });
 
   regenerateTagBands();
@@ -3418,7 +3426,13 @@ Timeline::Hit Timeline::hitTest(ui::Message* msg, const gfx::Point& mousePos)
 
       // Mouse in frame tags
       if (hit.part == PART_NOTHING) {
+        frame_t firstFrame, lastFrame;
+        getDrawableFrames(&firstFrame, &lastFrame);
+
         for (Tag* tag : m_sprite->tags()) {
+          if (!isTagVisible(tag, firstFrame, lastFrame))
+            continue;
+
           const int band = m_tagBand[tag];
 
           // Skip unfocused bands
@@ -3973,10 +3987,11 @@ doc::Layer* Timeline::getLayer(int layerIndex) const
 
 layer_t Timeline::getLayerIndex(const Layer* layer) const
 {
-  for (int i=0; i<(int)m_rows.size(); i++)
-    if (m_rows[i].layer() == layer)
-      return i;
-
+  auto it = m_rowIndex.find(layer);
+  if (it != m_rowIndex.end()) {
+    ASSERT(m_rows[it->second].layer() == layer);
+    return it->second;
+  }
   return -1;
 }
 
@@ -4320,6 +4335,26 @@ int Timeline::calcTagVisibleToFrame(Tag* tag) const
              font()->textLength(tag->name())/frameBoxWidth());
 }
 
+bool Timeline::isTagVisible(Tag* tag,
+                            const frame_t firstFrame,
+                            const frame_t lastFrame) const
+{
+  frame_t fromFrame = tag->fromFrame();
+  frame_t toFrame = tag->toFrame();
+  if (m_resizeTagData.tag == tag->id()) {
+    fromFrame = m_resizeTagData.from;
+    toFrame = m_resizeTagData.to;
+  }
+
+  if (fromFrame > lastFrame)
+    return false;
+
+  // The tag name can be wider than the tag frames (we check the
+  // text width only when it's needed).
+  return (toFrame >= firstFrame ||
+          calcTagVisibleToFrame(tag) >= firstFrame);
+}
+
 int Timeline::topHeight() const
 {
   int h = 0;
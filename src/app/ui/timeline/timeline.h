@@ -33,6 +33,7 @@
 #include "ui/timer.h"
 #include "ui/widget.h"
 
+#include <map>
 #include <memory>
 #include <vector>
 
@@ -54,6 +55,10 @@ namespace app {
     class SkinTheme;
   }
 
+  namespace thumb {
+    class CelThumbnailCache;
+  }
+
   using namespace doc;
 
   class CommandExecutionEvent;
@@ -371,6 +376,9 @@ namespace app {
     int outlineWidth() const;
     int oneTagHeight() const;
     int calcTagVisibleToFrame(Tag* tag) const;
+    bool isTagVisible(Tag* tag,
+                      const frame_t firstFrame,
+                      const frame_t lastFrame) const;
 
     void updateCelOverlayBounds(const Hit& hit);
     void drawCelOverlay(ui::Graphics* g);
@@ -417,6 +425,7 @@ namespace app {
 
     // Data used to display each row in the timeline
     std::vector<Row> m_rows;
+    std::map<const Layer*, layer_t> m_rowIndex; // Layer -> index in m_rows
 
     // Data used to display frame tags
     int m_tagBands;
@@ -433,6 +442,9 @@ namespace app {
     gfx::Point m_oldPos;
     // Configure timeline
     std::unique_ptr<ConfigureTimelinePopup> m_confPopup;
+
+    // Thumbnails of cels (created when they're displayed)
+    std::shared_ptr<thumb::CelThumbnailCache> m_thumbnails;
     obs::scoped_connection m_ctxConn1, m_ctxConn2;
     obs::connection m_firstFrameConn;
     obs::connection m_onionskinConn;
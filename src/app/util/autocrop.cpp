@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -12,14 +12,24 @@
 #include "app/util/autocrop.h"
 
 #include "app/snap_to_grid.h"
+#include "base/thread_pool.h"
 #include "doc/algorithm/shrink_bounds.h"
+#include "doc/cel.h"
+#include "doc/cel_data.h"
 #include "doc/image.h"
+#include "doc/layer.h"
 #include "doc/mask.h"
+#include "doc/palette.h"
 #include "doc/sprite.h"
 #include "render/render.h"
 
 #include <algorithm>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace app {
 
@@ -87,6 +97,103 @@ bool analize_if_image_has_solid_borders(const Image* image,
   return true;
 }
 
+// Trimmed bounds of each frame of each sprite calculated in
+// get_trimmed_bounds(), so trimming the same sprite again only
+// renders the modified frames. Each entry is valid while the frame
+// key (IDs/versions of the layers, cels, and images used to render
+// the frame) doesn't change.
+class TrimmedBoundsCache {
+public:
+  using FrameKey = std::vector<uint64_t>;
+
+  // Maximum number of entries before the whole cache is discarded.
+  static constexpr size_t kMaxEntries = 16384;
+
+  bool find(const ObjectId spriteId,
+            const frame_t frame,
+            const FrameKey& key,
+            bool& found,
+            gfx::Rect& bounds) {
+    const std::lock_guard lock(m_mutex);
+    auto it = m_entries.find(std::make_pair(spriteId, frame));
+    if (it == m_entries.end() || it->second.key != key)
+      return false;
+    found = it->second.found;
+    bounds = it->second.bounds;
+    return true;
+  }
+
+  void insert(const ObjectId spriteId,
+              const frame_t frame,
+              const FrameKey& key,
+              const bool found,
+              const gfx::Rect& bounds) {
+    const std::lock_guard lock(m_mutex);
+    if (m_entries.size() >= kMaxEntries)
+      m_entries.clear();
+    m_entries[std::make_pair(spriteId, frame)] = Entry{ key, found, bounds };
+  }
+
+private:
+  struct Entry {
+    FrameKey key;
+    bool found;
+    gfx::Rect bounds;
+  };
+
+  std::mutex m_mutex;
+  std::map<std::pair<ObjectId, frame_t>, Entry> m_entries;
+};
+
+TrimmedBoundsCache g_trimmedBoundsCache;
+
+// Returns false if the frame cannot be cached (it contains tilemaps,
+// where the tileset images would be part of the key).
+bool get_frame_key(const Sprite* sprite,
+                   const frame_t frame,
+                   TrimmedBoundsCache::FrameKey& key)
+{
+  const Palette* palette = sprite->palette(frame);
+
+  key.clear();
+  key.push_back(int(sprite->pixelFormat()));
+  key.push_back(sprite->width());
+  key.push_back(sprite->height());
+  key.push_back(sprite->transparentColor());
+  key.push_back(palette->id());
+  key.push_back(palette->version());
+
+  for (const Layer* layer : sprite->allLayers()) {
+    if (layer->isTilemap())
+      return false;
+
+    key.push_back(layer->id());
+    key.push_back(layer->version());
+    key.push_back(int(layer->flags()));
+    if (!layer->isImage())
+      continue;
+
+    auto layerImage = static_cast<const LayerImage*>(layer);
+    key.push_back(layerImage->opacity());
+    key.push_back(int(layerImage->blendMode()));
+
+    if (const Cel* cel = layer->cel(frame)) {
+      key.push_back(cel->id());
+      key.push_back(cel->version());
+      key.push_back(cel->data()->version());
+      key.push_back(uint32_t(cel->x()));
+      key.push_back(uint32_t(cel->y()));
+      key.push_back(cel->opacity());
+      key.push_back(uint32_t(cel->zIndex()));
+      key.push_back(cel->image()->id());
+      key.push_back(cel->image()->version());
+    }
+    else
+      key.push_back(NullId);
+  }
+  return true;
+}
+
 } // anonymous namespace
 
 bool get_shrink_rect(int *x1, int *y1, int *x2, int *y2,
@@ -263,22 +370,71 @@ gfx::Rect get_trimmed_bounds(
   const doc::Sprite* sprite,
   const bool byGrid)
 {
-  gfx::Rect bounds;
+  using FrameKey = TrimmedBoundsCache::FrameKey;
+
+  struct FrameBounds {
+    bool cached = false;
+    FrameKey key;
+    bool found = false;
+    gfx::Rect bounds;
+  };
+
+  // Use the cached bounds of the frames that weren't modified
+  const frame_t nframes = sprite->totalFrames();
+  std::vector<FrameBounds> frames(nframes);
+  std::vector<frame_t> pending;
+  for (frame_t frame(0); frame<nframes; ++frame) {
+    FrameBounds& fb = frames[frame];
+    fb.cached = get_frame_key(sprite, frame, fb.key);
+    if (!fb.cached ||
+        !g_trimmedBoundsCache.find(sprite->id(), frame, fb.key,
+                                   fb.found, fb.bounds)) {
+      pending.push_back(frame);
+    }
+  }
+
+  // Render and shrink the rest of frames in several threads (each
+  // thread with its own render and image)
+  if (!pending.empty()) {
+    const int threads =
+      std::clamp<int>(std::thread::hardware_concurrency(), 1, int(pending.size()));
 
-  std::unique_ptr<Image> image_wrap(Image::create(sprite->spec()));
-  Image* image = image_wrap.get();
+    auto shrinkFrames = [sprite, &frames, &pending, threads](const int k){
+      std::unique_ptr<Image> image(Image::create(sprite->spec()));
+      render::Render render;
 
-  render::Render render;
+      for (size_t i=k; i<pending.size(); i+=threads) {
+        FrameBounds& fb = frames[pending[i]];
+        render.renderSprite(image.get(), sprite, pending[i]);
 
-  for (frame_t frame(0); frame<sprite->totalFrames(); ++frame) {
-    render.renderSprite(image, sprite, frame);
+        doc::color_t refColor;
+        fb.found =
+          (get_best_refcolor_for_trimming(image.get(), refColor) &&
+           doc::algorithm::shrink_bounds(image.get(), refColor, nullptr, fb.bounds));
+      }
+    };
+
+    if (threads > 1) {
+      base::thread_pool pool(threads);
+      for (int k=0; k<threads; ++k)
+        pool.execute([&shrinkFrames, k]{ shrinkFrames(k); });
+      pool.wait_all();
+    }
+    else
+      shrinkFrames(0);
 
-    gfx::Rect frameBounds;
-    doc::color_t refColor;
-    if (get_best_refcolor_for_trimming(image, refColor) &&
-        doc::algorithm::shrink_bounds(image, refColor, nullptr, frameBounds)) {
-      bounds = bounds.createUnion(frameBounds);
+    for (const frame_t frame : pending) {
+      const FrameBounds& fb = frames[frame];
+      if (fb.cached)
+        g_trimmedBoundsCache.insert(sprite->id(), frame, fb.key,
+                                    fb.found, fb.bounds);
     }
+  }
+
+  gfx::Rect bounds;
+  for (const FrameBounds& fb : frames) {
+    if (fb.found)
+      bounds = bounds.createUnion(fb.bounds);
 
     // TODO merge this code with the code in DocExporter::captureSamples()
     if (byGrid) {
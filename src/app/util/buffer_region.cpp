@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -17,6 +17,35 @@
 
 namespace app {
 
+namespace {
+
+void write_varint(size_t value, base::buffer& output)
+{
+  while (value >= 0x80) {
+    output.push_back(uint8_t(value | 0x80));
+    value >>= 7;
+  }
+  output.push_back(uint8_t(value));
+}
+
+size_t read_varint(base::buffer::const_iterator& it,
+                   const base::buffer::const_iterator& end)
+{
+  size_t value = 0;
+  int shift = 0;
+  while (it != end) {
+    const uint8_t byte = *it;
+    ++it;
+    value |= size_t(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      break;
+    shift += 7;
+  }
+  return value;
+}
+
+} // anonymous namespace
+
 void save_image_region_in_buffer(
   const gfx::Region& region,
   const doc::Image* image,
@@ -60,4 +89,92 @@ void swap_image_region_with_buffer(
   }
 }
 
+void xor_buffer_with_image_region(
+  const gfx::Region& region,
+  const doc::Image* image,
+  const gfx::Point& imagePos,
+  base::buffer& buffer)
+{
+  const size_t bytesPerPixel = image->bytesPerPixel();
+  auto it = buffer.begin();
+  for (const auto& rc : region) {
+    for (int y=0; y<rc.h; ++y) {
+      auto p = (const uint8_t*)image->getPixelAddress(rc.x-imagePos.x,
+                                                      rc.y-imagePos.y+y);
+      const size_t rowBytes = bytesPerPixel*rc.w;
+      for (size_t i=0; i<rowBytes; ++i, ++it)
+        *it ^= p[i];
+    }
+  }
+}
+
+void xor_image_region_with_buffer(
+  const gfx::Region& region,
+  doc::Image* image,
+  const base::buffer& buffer)
+{
+  const size_t bytesPerPixel = image->bytesPerPixel();
+  auto it = buffer.begin();
+  for (const auto& rc : region) {
+    for (int y=0; y<rc.h; ++y) {
+      auto p = (uint8_t*)image->getPixelAddress(rc.x, rc.y+y);
+      const size_t rowBytes = bytesPerPixel*rc.w;
+      for (size_t i=0; i<rowBytes; ++i, ++it)
+        p[i] ^= *it;
+    }
+  }
+}
+
+// The compressed buffer is a sequence of (zeros count, literal bytes
+// count, literal bytes) where both counts are varints.
+void compress_buffer(const base::buffer& input,
+                     base::buffer& output)
+{
+  output.clear();
+
+  auto it = input.begin();
+  const auto end = input.end();
+  while (it != end) {
+    auto literals = std::find_if(it, end, [](uint8_t b){ return b != 0; });
+    const size_t zeros = literals - it;
+
+    // A literal run finishes with at least 4 zeros (shorter runs of
+    // zeros are cheaper as literals than as a new zeros count).
+    auto literalsEnd = literals;
+    while (literalsEnd != end) {
+      literalsEnd = std::find(literalsEnd, end, 0);
+      const auto window = literalsEnd + std::min<ptrdiff_t>(4, end-literalsEnd);
+      auto nextNonZero = std::find_if(literalsEnd, window,
+                                      [](uint8_t b){ return b != 0; });
+      if (nextNonZero == end ||
+          nextNonZero-literalsEnd >= 4)
+        break;
+      literalsEnd = nextNonZero;
+    }
+
+    write_varint(zeros, output);
+    write_varint(literalsEnd - literals, output);
+    output.insert(output.end(), literals, literalsEnd);
+    it = literalsEnd;
+  }
+
+  output.shrink_to_fit();
+}
+
+void decompress_buffer(const base::buffer& input,
+                       base::buffer& output)
+{
+  output.clear();
+
+  auto it = input.begin();
+  const auto end = input.end();
+  while (it != end) {
+    const size_t zeros = read_varint(it, end);
+    const size_t literals = std::min<size_t>(read_varint(it, end), end - it);
+    output.insert(output.end(), zeros, 0);
+    output.insert(output.end(), it, it+literals);
+    it += literals;
+  }
+}
+
 } // namespace app
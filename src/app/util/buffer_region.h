@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -28,6 +28,31 @@ namespace app {
     doc::Image* image,
     base::buffer& buffer);
 
+  // XORs the buffer (saved with save_image_region_in_buffer()) with
+  // the region pixels of the image, so the buffer contains only the
+  // differences between both versions of the pixels (zeros where
+  // they are equal).
+  void xor_buffer_with_image_region(
+    const gfx::Region& region,
+    const doc::Image* image,
+    const gfx::Point& imagePos,
+    base::buffer& buffer);
+
+  // XORs the region pixels of the image with the differences
+  // calculated with xor_buffer_with_image_region(), going from one
+  // version of the pixels to the other one.
+  void xor_image_region_with_buffer(
+    const gfx::Region& region,
+    doc::Image* image,
+    const base::buffer& buffer);
+
+  // Compresses the runs of zeros of the buffer (useful to compress
+  // the XOR differences between two images).
+  void compress_buffer(const base::buffer& input,
+                       base::buffer& output);
+  void decompress_buffer(const base::buffer& input,
+                         base::buffer& output);
+
 } // namespace app
 
 #endif
@@ -0,0 +1,87 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/util/buffer_region.h"
+#include "doc/image.h"
+#include "doc/image_ref.h"
+#include "doc/primitives.h"
+#include "gfx/region.h"
+
+using namespace app;
+using namespace doc;
+
+namespace {
+
+base::buffer roundtrip(const base::buffer& input,
+                       size_t* compressedSize = nullptr)
+{
+  base::buffer compressed, output;
+  compress_buffer(input, compressed);
+  decompress_buffer(compressed, output);
+  if (compressedSize)
+    *compressedSize = compressed.size();
+  return output;
+}
+
+} // anonymous namespace
+
+TEST(BufferRegion, CompressEmpty)
+{
+  base::buffer compressed;
+  compress_buffer(base::buffer(), compressed);
+  EXPECT_TRUE(compressed.empty());
+  EXPECT_TRUE(roundtrip(base::buffer()).empty());
+}
+
+TEST(BufferRegion, CompressZeros)
+{
+  size_t compressedSize = 0;
+  base::buffer input(100000, 0);
+  EXPECT_EQ(input, roundtrip(input, &compressedSize));
+  EXPECT_LT(compressedSize, 8);
+}
+
+TEST(BufferRegion, CompressMixedRuns)
+{
+  base::buffer input;
+  for (int i=0; i<1000; ++i) {
+    input.insert(input.end(), i % 7, 0);
+    input.insert(input.end(), i % 5, uint8_t(i+1));
+    if (i % 13 == 0)
+      input.insert(input.end(), 300, 0);
+  }
+  input.push_back(0);
+  EXPECT_EQ(input, roundtrip(input));
+
+  input.push_back(1);
+  EXPECT_EQ(input, roundtrip(input));
+}
+
+TEST(BufferRegion, XorDifferences)
+{
+  ImageRef a(Image::create(IMAGE_RGB, 32, 32));
+  ImageRef b(Image::create(IMAGE_RGB, 32, 32));
+  clear_image(a.get(), rgba(255, 0, 0, 255));
+  clear_image(b.get(), rgba(255, 0, 0, 255));
+  fill_rect(b.get(), 4, 4, 9, 9, rgba(0, 0, 255, 255));
+
+  const gfx::Region region(gfx::Rect(2, 2, 16, 16));
+  base::buffer diff, compressed;
+  save_image_region_in_buffer(region, b.get(), gfx::Point(0, 0), diff);
+  xor_buffer_with_image_region(region, a.get(), gfx::Point(0, 0), diff);
+  compress_buffer(diff, compressed);
+  EXPECT_LT(compressed.size(), diff.size() / 2);
+
+  ImageRef c(Image::createCopy(a.get()));
+  decompress_buffer(compressed, diff);
+  xor_image_region_with_buffer(region, c.get(), diff);
+  EXPECT_EQ(0, count_diff_between_images(b.get(), c.get()));
+
+  xor_image_region_with_buffer(region, c.get(), diff);
+  EXPECT_EQ(0, count_diff_between_images(a.get(), c.get()));
+}
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -22,6 +22,7 @@
 #include "app/cmd/set_cel_position.h"
 #include "app/cmd_sequence.h"
 #include "app/doc.h"
+#include "base/thread_pool.h"
 #include "doc/algorithm/fill_selection.h"
 #include "doc/algorithm/flip_image.h"
 #include "doc/algorithm/resize_image.h"
@@ -46,6 +47,8 @@
 #include <algorithm>
 #include <cmath>
 #include <memory>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #define OPS_TRACE(...) // TRACE(__VA_ARGS__)
@@ -56,6 +59,23 @@ using namespace doc;
 
 namespace {
 
+// Tiles of draw_image_into_new_tilemap_cel() are extracted in
+// parallel in batches of this size
+constexpr int kTilesPerBatch = 4096;
+constexpr int kMinTilesPerThread = 64;
+
+// Minimum number of tilemap pixels to scan in each thread in
+// reduce_tiles_using_tileset()
+constexpr int kMinTilemapPixelsPerThread = 16384;
+
+struct ExtractedTile {
+  gfx::Point tilePt;
+  doc::ImageRef image;
+  uint64_t hash = 0;
+  doc::tile_index tileIndex = doc::notile;
+  doc::tile_flags tileFlags = 0;
+};
+
 template<typename ImageTraits>
 void mask_image_templ(Image* image, const Image* bitmap)
 {
@@ -99,20 +119,70 @@ void create_region_with_differences_templ(const Image* a,
   }
 }
 
+// Calls f(partial, tile) for each tile of the tilemaps that use the
+// given tileset. Tilemaps are scanned in parallel, each thread with
+// its own "partial" result (a copy of "init"), and the partial
+// results are combined at the end with merge(result, partial).
+//
 // TODO merge this with Sprite::getTilemapsByTileset()
-template<typename UnaryFunction>
-void for_each_tile_using_tileset(Tileset* tileset, UnaryFunction f)
+template<typename Partial, typename Func, typename Merge>
+Partial reduce_tiles_using_tileset(Tileset* tileset,
+                                   const Partial& init,
+                                   Func f,
+                                   Merge merge)
 {
+  std::vector<Image*> tilemaps;
+  size_t pixels = 0;
   for (Cel* cel : tileset->sprite()->uniqueCels()) {
     if (!cel->layer()->isTilemap() ||
         static_cast<LayerTilemap*>(cel->layer())->tileset() != tileset)
       continue;
 
     Image* tilemapImage = cel->image();
-    for_each_pixel<TilemapTraits>(tilemapImage, f);
+    tilemaps.push_back(tilemapImage);
+    pixels += size_t(tilemapImage->width()) * tilemapImage->height();
+  }
+
+  const int threads =
+    std::clamp<int>(std::thread::hardware_concurrency(), 1,
+                    std::max<int>(1, int(std::min<size_t>(tilemaps.size(),
+                                                          pixels / kMinTilemapPixelsPerThread))));
+
+  std::vector<Partial> partials(threads, init);
+  auto scan = [&tilemaps, &partials, &f, threads](const int k) {
+    Partial& partial = partials[k];
+    for (size_t i=k; i<tilemaps.size(); i+=threads) {
+      for_each_pixel<TilemapTraits>(
+        tilemaps[i], [&partial, &f](const doc::tile_t t){
+                       f(partial, t);
+                     });
+    }
+  };
+
+  if (threads > 1) {
+    base::thread_pool pool(threads);
+    for (int k=0; k<threads; ++k)
+      pool.execute([&scan, k]{ scan(k); });
+    pool.wait_all();
   }
+  else {
+    scan(0);
+  }
+
+  Partial result = std::move(partials[0]);
+  for (int k=1; k<threads; ++k)
+    merge(result, partials[k]);
+  return result;
 }
 
+// Usage of tiles calculated in remove_unused_tiles_from_tileset()
+struct TilesUsage {
+  int n = 0;                    // Max used tile index + 1
+#ifdef _DEBUG
+  std::vector<size_t> histogram;
+#endif
+};
+
 struct Mod {
   tile_index tileIndex;
   ImageRef tileDstImage;
@@ -149,13 +219,14 @@ private:
   doc::algorithm::FlipType m_flipType;
 };
 
-// This is a terrible way to find tiles, i.e. flipping several times
-// the image, instead of searching for flipped hashes. In the future
-// we could try to improve it.
-bool find_tile(doc::Tileset* tileset,
-               doc::ImageRef& tileImage,
-               doc::tile_index& tileIndex,
-               doc::tile_flags& tileFlags)
+// Finds tiles flipping several times the image. It's used only for
+// diagonal flips of non-square tiles (flip_image() transposes just
+// the square part of the image, and it cannot be indexed with
+// Tileset::findFlippedTileIndex()).
+bool find_tile_flipping_image(doc::Tileset* tileset,
+                              doc::ImageRef& tileImage,
+                              doc::tile_index& tileIndex,
+                              doc::tile_flags& tileFlags)
 {
   // Find without flags
   if (tileset->findTileIndex(tileImage, tileIndex)) {
@@ -250,6 +321,29 @@ bool find_tile(doc::Tileset* tileset,
   return false;
 }
 
+bool find_tile(doc::Tileset* tileset,
+               doc::ImageRef& tileImage,
+               doc::tile_index& tileIndex,
+               doc::tile_flags& tileFlags)
+{
+  // Find without flags
+  if (tileset->findTileIndex(tileImage, tileIndex)) {
+    tileFlags = 0;
+    return true;
+  }
+
+  if (tileset->matchFlags() == 0) // In case we don't allow flipped tiles
+    return false;
+
+  if ((tileset->matchFlags() & doc::tile_f_dflip) &&
+      tileImage->width() != tileImage->height()) {
+    return find_tile_flipping_image(tileset, tileImage, tileIndex, tileFlags);
+  }
+
+  // Find all the flipped versions with just one lookup
+  return tileset->findFlippedTileIndex(tileImage, tileIndex, tileFlags);
+}
+
 } // anonymous namespace
 
 void create_region_with_differences(const Image* a,
@@ -447,7 +541,18 @@ Cel* create_cel_copy(CmdSequence* cmds,
       srcCel->layer()->isBackground(),
       dstSprite->transparentColor());
   }
-  // Simple case, where we copy both images
+  // Simple case, where we copy both images with the same pixel
+  // format. Copying rows directly gives the same result as
+  // compositing them with BlendMode::SRC (the destination image is
+  // cleared with 0, which is the transparent color of RGB/Grayscale
+  // images, and indexed images are copied as they are), but it's a
+  // lot faster to duplicate big sprites/layers.
+  else if (dstCel->image()->pixelFormat() == srcImage->pixelFormat() &&
+           dstCel->image()->size() == srcImage->size() &&
+           (srcImage->pixelFormat() == IMAGE_INDEXED ||
+            srcImage->maskColor() == 0)) {
+    dstCel->image()->copy(srcImage, gfx::Clip(0, 0, srcImage->bounds()));
+  }
   else {
     render::composite_image(
       dstCel->image(),
@@ -519,49 +624,115 @@ void draw_image_into_new_tilemap_cel(
     ASSERT(tilemapBounds.h == newTilemap->height());
   }
 
-  for (const gfx::Point& tilePt : grid.tilesInCanvasRegion(gfx::Region(canvasBounds))) {
-    const gfx::Point tilePtInCanvas = grid.tileToCanvas(tilePt);
-    doc::ImageRef tileImage(
+  std::vector<gfx::Point> tilePts;
+  for (const gfx::Point& tilePt : grid.tilesInCanvasRegion(gfx::Region(canvasBounds)))
+    tilePts.push_back(tilePt);
+
+  // Extracts, preprocesses, and hashes the given tile (this can be
+  // done in parallel for several tiles as the source image is only
+  // read).
+  auto extractTile = [&](ExtractedTile& tile) {
+    const gfx::Point tilePtInCanvas = grid.tileToCanvas(tile.tilePt);
+    tile.image.reset(
       doc::crop_image(srcImage,
                       tilePtInCanvas.x-srcImagePos.x,
                       tilePtInCanvas.y-srcImagePos.y,
                       tileSize.w, tileSize.h,
                       srcImage->maskColor()));
     if (grid.hasMask())
-      mask_image(tileImage.get(), grid.mask().get());
+      mask_image(tile.image.get(), grid.mask().get());
+
+    preprocess_transparent_pixels(tile.image.get());
+    tile.hash = doc::calculate_image_hash64(tile.image.get());
+  };
+
+  const int threads =
+    std::clamp<int>(std::thread::hardware_concurrency(), 1,
+                    std::max<int>(1, int(tilePts.size()) / kMinTilesPerThread));
+  std::unique_ptr<base::thread_pool> pool;
+  if (threads > 1)
+    pool = std::make_unique<base::thread_pool>(threads);
+
+  // Tiles are processed in batches to limit the memory used by the
+  // extracted tile images.
+  std::vector<ExtractedTile> batch;
+  std::unordered_multimap<uint64_t, int> uniqueTiles;
+  for (size_t b=0; b<tilePts.size(); b+=kTilesPerBatch) {
+    const int n = int(std::min<size_t>(kTilesPerBatch, tilePts.size()-b));
+    batch.clear();
+    batch.resize(n);
+    for (int i=0; i<n; ++i)
+      batch[i].tilePt = tilePts[b+i];
+
+    if (pool) {
+      const int chunk = (n + threads - 1) / threads;
+      for (int i=0; i<n; i+=chunk) {
+        const int end = std::min(n, i+chunk);
+        pool->execute([&batch, &extractTile, i, end]{
+          for (int k=i; k<end; ++k)
+            extractTile(batch[k]);
+        });
+      }
+      pool->wait_all();
+    }
+    else {
+      for (ExtractedTile& tile : batch)
+        extractTile(tile);
+    }
 
-    preprocess_transparent_pixels(tileImage.get());
+    // Merge step: find the tiles in the tileset (or add them) in the
+    // same order as they appear in the image, but only one time for
+    // each group of identical tiles of this batch.
+    uniqueTiles.clear();
+    for (int i=0; i<n; ++i) {
+      ExtractedTile& tile = batch[i];
+
+      const ExtractedTile* same = nullptr;
+      auto range = uniqueTiles.equal_range(tile.hash);
+      for (auto it=range.first; it != range.second; ++it) {
+        if (is_same_image(batch[it->second].image.get(), tile.image.get())) {
+          same = &batch[it->second];
+          break;
+        }
+      }
 
-    doc::tile_index tileIndex;
-    doc::tile_flags tileFlag = 0;
+      if (same) {
+        tile.tileIndex = same->tileIndex;
+        tile.tileFlags = same->tileFlags;
+      }
+      else {
+        uniqueTiles.insert(std::make_pair(tile.hash, i));
+        tile.tileFlags = 0;
 
-    if (!find_tile(tileset, tileImage, tileIndex, tileFlag)) {
-      auto addTile = new cmd::AddTile(tileset, tileImage);
+        if (!find_tile(tileset, tile.image, tile.tileIndex, tile.tileFlags)) {
+          auto addTile = new cmd::AddTile(tileset, tile.image);
 
-      if (cmds)
-        cmds->executeAndAdd(addTile);
-      else {
-        // TODO a little hacky
-        addTile->execute(doc->context());
-      }
+          if (cmds)
+            cmds->executeAndAdd(addTile);
+          else {
+            // TODO a little hacky
+            addTile->execute(doc->context());
+          }
 
-      tileIndex = addTile->tileIndex();
+          tile.tileIndex = addTile->tileIndex();
 
-      if (!cmds)
-        delete addTile;
+          if (!cmds)
+            delete addTile;
 
-      doc->notifyAfterAddTile(dstLayer, dstCel->frame(), tileIndex);
-    }
+          doc->notifyAfterAddTile(dstLayer, dstCel->frame(), tile.tileIndex);
+        }
+      }
 
-    // We were using newTilemap->putPixel() directly but received a
-    // crash report about an "access violation". So now we've added
-    // some checks to the operation.
-    {
-      const int u = tilePt.x-tilemapBounds.x;
-      const int v = tilePt.y-tilemapBounds.y;
-      ASSERT((u >= 0) && (v >= 0) && (u < newTilemap->width()) && (v < newTilemap->height()));
-      doc::put_pixel(newTilemap.get(), u, v,
-                     doc::tile(tileIndex, tileFlag));
+      // We were using newTilemap->putPixel() directly but received a
+      // crash report about an "access violation". So now we've added
+      // some checks to the operation.
+      {
+        const int u = tile.tilePt.x-tilemapBounds.x;
+        const int v = tile.tilePt.y-tilemapBounds.y;
+        ASSERT((u >= 0) && (v >= 0) && (u < newTilemap->width()) && (v < newTilemap->height()));
+        doc::put_pixel(newTilemap.get(), u, v,
+                       doc::tile(tile.tileIndex, tile.tileFlags));
+      }
     }
   }
 
@@ -596,6 +767,7 @@ void modify_tilemap_cel_region(
   bool addUndoToTileset = false;
   if (!tileset) {
     tileset = tilemapLayer->tileset();
+    tileset->unshareTiles();
     addUndoToTileset = true;
   }
   doc::Grid grid = tileset->grid();
@@ -649,14 +821,19 @@ void modify_tilemap_cel_region(
     std::vector<bool> modifiedTileIndexes(tileset->size(), false);
     std::vector<size_t> tilesHistogram(tileset->size(), 0);
     if (tilesetMode == TilesetMode::Auto) {
-      for_each_tile_using_tileset(
-        tileset, [tileset, &tilesHistogram](const doc::tile_t t){
-                   if (t != doc::notile) {
-                     doc::tile_index ti = doc::tile_geti(t);
-                     if (ti >= 0 && ti < tileset->size())
-                       ++tilesHistogram[ti];
-                   }
-                 });
+      tilesHistogram = reduce_tiles_using_tileset(
+        tileset, tilesHistogram,
+        [](std::vector<size_t>& histogram, const doc::tile_t t){
+          if (t != doc::notile) {
+            doc::tile_index ti = doc::tile_geti(t);
+            if (ti >= 0 && ti < histogram.size())
+              ++histogram[ti];
+          }
+        },
+        [](std::vector<size_t>& histogram, const std::vector<size_t>& partial){
+          for (size_t i=0; i<histogram.size(); ++i)
+            histogram[i] += partial[i];
+        });
     }
 
     for (const gfx::Point& tilePt : grid.tilesInCanvasRegion(regionToPatch)) {
@@ -956,32 +1133,41 @@ static void remove_unused_tiles_from_tileset(
 {
   OPS_TRACE("remove_unused_tiles_from_tileset\n");
 
-  int n = tileset->size();
+  TilesUsage init;
+  init.n = tileset->size();
 #ifdef _DEBUG
   // Histogram just to check that we've a correct tilesHistogram
-  std::vector<size_t> tilesHistogram2(n, 0);
+  init.histogram.resize(init.n, 0);
 #endif
 
-  for_each_tile_using_tileset(
-    tileset,
-    [&n
-#ifdef _DEBUG
-     , &tilesHistogram2
-#endif
-     ](const doc::tile_t t){
+  const TilesUsage usage = reduce_tiles_using_tileset(
+    tileset, init,
+    [](TilesUsage& usage, const doc::tile_t t){
       if (t != doc::notile) {
         const doc::tile_index ti = doc::tile_geti(t);
-        n = std::max<int>(n, ti+1);
+        usage.n = std::max<int>(usage.n, ti+1);
 #ifdef _DEBUG
         // This check is necessary in case the tilemap has a reference
         // to a tile outside the valid range (e.g. when we resize the
         // tileset deleting tiles that will not be present anymore)
-        if (ti >= 0 && ti < tilesHistogram2.size())
-          ++tilesHistogram2[ti];
+        if (ti >= 0 && ti < usage.histogram.size())
+          ++usage.histogram[ti];
 #endif
       }
+    },
+    [](TilesUsage& usage, const TilesUsage& partial){
+      usage.n = std::max(usage.n, partial.n);
+#ifdef _DEBUG
+      for (size_t i=0; i<usage.histogram.size(); ++i)
+        usage.histogram[i] += partial.histogram[i];
+#endif
     });
 
+  const int n = usage.n;
+#ifdef _DEBUG
+  const std::vector<size_t>& tilesHistogram2 = usage.histogram;
+#endif
+
 #ifdef _DEBUG
   for (int k=0; k<tilesHistogram.size(); ++k) {
     OPS_TRACE("comparing [%d] -> %d vs %d\n", k, tilesHistogram[k], tilesHistogram2[k]);
@@ -37,10 +37,12 @@
 #include "doc/algorithm/shrink_bounds.h"
 #include "doc/blend_image.h"
 #include "doc/doc.h"
+#include "doc/memory_account.h"
 #include "render/dithering.h"
 #include "render/ordered_dither.h"
 #include "render/quantization.h"
 
+#include <atomic>
 #include <memory>
 #include <stdexcept>
 
@@ -123,6 +125,12 @@ struct Clipboard::Data {
   // Selected set of layers/layers/cels
   ClipboardRange range;
 
+  // Memory of the copied images (read from any thread)
+  std::atomic<std::size_t> memSize = 0;
+  doc::MemoryAccount memoryAccount{
+    doc::MemoryPool::Clipboard,
+    [this]{ return memSize.load(); } };
+
   Data() {
     range.observeUIContext();
   }
@@ -141,6 +149,20 @@ struct Clipboard::Data {
     picks.clear();
     mask.reset();
     range.invalidate();
+    memSize = 0;
+  }
+
+  void updateMemSize() {
+    std::size_t bytes = 0;
+    if (image)
+      bytes += image->getMemSize();
+    if (tilemap)
+      bytes += tilemap->getMemSize();
+    if (tileset)
+      bytes += tileset->getMemSize();
+    if (mask && mask->bitmap())
+      bytes += mask->bitmap()->getMemSize();
+    memSize = bytes;
   }
 
   ClipboardFormat format() const {
@@ -224,6 +246,7 @@ void Clipboard::setData(Image* image,
     m_data->tilemap.reset(image);
   else
     m_data->image.reset(image);
+  m_data->updateMemSize();
 
   if (set_native_clipboard &&
       use_native_clipboard()) {
@@ -567,7 +590,7 @@ void Clipboard::paste(Context* ctx,
         if (isAnImageOnDstCel)
           api.clearCel(ctx->activeSite().cel());
         else
-          result.reset(Image::createCopy(src_image.get()));
+          result = src_image; // Not modified, crop_image() creates a new image
 
         // Calculate the active image + pasted image bounds
         const gfx::Rect startBounds(gfx::Point(), result->size());
@@ -822,8 +845,11 @@ void Clipboard::paste(Context* ctx,
 
 ImageRef Clipboard::getImage(Palette* palette)
 {
-  // Get the image from the native clipboard.
-  if (use_native_clipboard()) {
+  // Get the image from the native clipboard (if it's not the same
+  // image that we've copied, in that case we can use m_data->image
+  // directly without decoding it again).
+  if (use_native_clipboard() &&
+      !(m_data->image && isNativeBitmapFromThisProcess())) {
     Image* native_image = nullptr;
     Mask* native_mask = nullptr;
     Palette* native_palette = nullptr;
@@ -847,7 +873,9 @@ ImageRef Clipboard::getImage(Palette* palette)
 
 bool Clipboard::getImageSize(gfx::Size& size)
 {
-  if (use_native_clipboard() && getNativeBitmapSize(&size))
+  if (use_native_clipboard() &&
+      !(m_data->image && isNativeBitmapFromThisProcess()) &&
+      getNativeBitmapSize(&size))
     return true;
 
   if (m_data->image) {
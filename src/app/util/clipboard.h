@@ -105,6 +105,7 @@ namespace app {
     void clearNativeContent();
     void registerNativeFormats();
     bool hasNativeBitmap() const;
+    bool isNativeBitmapFromThisProcess() const;
     bool setNativeBitmap(const doc::Image* image,
                          const doc::Mask* mask,
                          const doc::Palette* palette,
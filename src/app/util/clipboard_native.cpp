@@ -27,6 +27,8 @@
 #include "os/window.h"
 #include "ui/alert.h"
 
+#include <cstdint>
+#include <random>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -40,6 +42,21 @@ namespace {
   clip::format custom_image_format = 0;
   bool show_clip_errors = true;
 
+  // Token saved in the clipboard with each image we copy, to know
+  // if the clipboard still contains the last image we've copied
+  // (so we can paste it directly without decoding the clipboard).
+  clip::format custom_token_format = 0;
+  uint64_t last_token = 0;
+
+  uint64_t make_token() {
+    static std::mt19937_64 gen(std::random_device{}());
+    uint64_t token;
+    do {
+      token = gen();
+    } while (token == 0);
+    return token;
+  }
+
   class InhibitClipErrors {
     bool m_saved;
   public:
@@ -84,6 +101,7 @@ void Clipboard::registerNativeFormats()
 {
   clip::set_error_handler(custom_error_handler);
   custom_image_format = clip::register_format("org.aseprite.Image");
+  custom_token_format = clip::register_format("org.aseprite.ImageToken");
 }
 
 bool Clipboard::hasNativeBitmap() const
@@ -92,6 +110,23 @@ bool Clipboard::hasNativeBitmap() const
   return clip::has(clip::image_format());
 }
 
+bool Clipboard::isNativeBitmapFromThisProcess() const
+{
+  if (!last_token || !custom_token_format)
+    return false;
+
+  InhibitClipErrors ice;
+  clip::lock l(native_window_handle());
+  if (!l.locked() ||
+      !l.is_convertible(custom_token_format) ||
+      l.get_data_length(custom_token_format) != sizeof(last_token))
+    return false;
+
+  uint64_t token = 0;
+  return (l.get_data(custom_token_format, (char*)&token, sizeof(token)) &&
+          token == last_token);
+}
+
 bool Clipboard::setNativeBitmap(const doc::Image* image,
                                 const doc::Mask* mask,
                                 const doc::Palette* palette,
@@ -103,10 +138,17 @@ bool Clipboard::setNativeBitmap(const doc::Image* image,
     return false;
 
   l.clear();
+  last_token = 0;
 
   if (!image)
     return false;
 
+  if (custom_token_format) {
+    const uint64_t token = make_token();
+    if (l.set_data(custom_token_format, (const char*)&token, sizeof(token)))
+      last_token = token;
+  }
+
   // Set custom clipboard formats
   if (custom_image_format) {
     std::stringstream os;
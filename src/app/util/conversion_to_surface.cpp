@@ -11,6 +11,7 @@
 
 #include "app/util/conversion_to_surface.h"
 
+#include "app/profiler.h"
 #include "base/24bits.h"
 #include "doc/algo.h"
 #include "doc/color_scales.h"
@@ -25,8 +26,13 @@
 #endif
 
 #include <algorithm>
+#include <cstring>
 #include <stdexcept>
 
+#if defined(__x86_64__) || defined(_WIN64)
+  #include <emmintrin.h>
+#endif
+
 namespace app {
 
 using namespace doc;
@@ -81,22 +87,34 @@ template<typename ImageTraits, typename AddressType>
 void convert_image_to_surface_templ(const Image* image, os::Surface* dst,
   int src_x, int src_y, int dst_x, int dst_y, int w, int h, const Palette* palette, const os::SurfaceFormatData* fd)
 {
-  const LockImageBits<ImageTraits> bits(image, gfx::Rect(src_x, src_y, w, h));
-  typename LockImageBits<ImageTraits>::const_iterator src_it = bits.begin();
+  if constexpr (ImageTraits::pixels_per_byte == 8) {
+    const LockImageBits<ImageTraits> bits(image, gfx::Rect(src_x, src_y, w, h));
+    typename LockImageBits<ImageTraits>::const_iterator src_it = bits.begin();
 #ifdef _DEBUG
-  typename LockImageBits<ImageTraits>::const_iterator src_end = bits.end();
+    typename LockImageBits<ImageTraits>::const_iterator src_end = bits.end();
 #endif
 
-  for (int v=0; v<h; ++v, ++dst_y) {
-    AddressType dst_address = AddressType(dst->getData(dst_x, dst_y));
-    for (int u=0; u<w; ++u) {
-      ASSERT(src_it != src_end);
+    for (int v=0; v<h; ++v, ++dst_y) {
+      AddressType dst_address = AddressType(dst->getData(dst_x, dst_y));
+      for (int u=0; u<w; ++u) {
+        ASSERT(src_it != src_end);
 
-      *dst_address = convert_color_to_surface<ImageTraits, os::kRgbaSurfaceFormat>(*src_it, palette, image->spec(), fd);
-      ++dst_address;
-      ++src_it;
+        *dst_address = convert_color_to_surface<ImageTraits, os::kRgbaSurfaceFormat>(*src_it, palette, image->spec(), fd);
+        ++dst_address;
+        ++src_it;
+      }
     }
   }
+  else {
+    const ImageSpec& spec = image->spec();
+    for_each_row<ImageTraits>(
+      image, gfx::Rect(src_x, src_y, w, h),
+      [&](typename ImageTraits::const_address_t src_address, const int w) {
+        AddressType dst_address = AddressType(dst->getData(dst_x, dst_y++));
+        for (int u=0; u<w; ++u, ++dst_address)
+          *dst_address = convert_color_to_surface<ImageTraits, os::kRgbaSurfaceFormat>(src_address[u], palette, spec, fd);
+      });
+  }
 }
 
 struct Address24bpp
@@ -111,6 +129,123 @@ struct Address24bpp
   }
 };
 
+// True if it's a 32bpp surface with 8 bits for each RGBA channel
+// (in any order), which is the format that we use in practice, so
+// each color can be converted just shifting its components.
+bool is_rgba32_format(const os::SurfaceFormatData* fd)
+{
+  return (fd->bitsPerPixel == 32 &&
+          fd->redMask   == (uint32_t(0xff) << fd->redShift) &&
+          fd->greenMask == (uint32_t(0xff) << fd->greenShift) &&
+          fd->blueMask  == (uint32_t(0xff) << fd->blueShift) &&
+          fd->alphaMask == (uint32_t(0xff) << fd->alphaShift));
+}
+
+void convert_rgb_to_rgba32(const Image* image, os::Surface* dst,
+  int src_x, int src_y, int dst_x, int dst_y, int w, int h, const os::SurfaceFormatData* fd)
+{
+  // Same layout, just copy each row
+  if (gfx::ColorRShift == fd->redShift &&
+      gfx::ColorGShift == fd->greenShift &&
+      gfx::ColorBShift == fd->blueShift &&
+      gfx::ColorAShift == fd->alphaShift) {
+    for (int v=0; v<h; ++v, ++src_y, ++dst_y) {
+      std::memcpy(dst->getData(dst_x, dst_y),
+                  image->getPixelAddress(src_x, src_y),
+                  RgbTraits::bytes_per_pixel * w);
+    }
+    return;
+  }
+
+  // Swizzle the components (e.g. RGBA -> BGRA), this loop can be
+  // vectorized by the compiler
+  const int rs = fd->redShift;
+  const int gs = fd->greenShift;
+  const int bs = fd->blueShift;
+  const int as = fd->alphaShift;
+  for (int v=0; v<h; ++v, ++src_y, ++dst_y) {
+    auto src = (const uint32_t*)image->getPixelAddress(src_x, src_y);
+    auto dst_address = (uint32_t*)dst->getData(dst_x, dst_y);
+    for (int u=0; u<w; ++u) {
+      const color_t c = src[u];
+      dst_address[u] = ((rgba_getr(c) << rs) |
+                        (rgba_getg(c) << gs) |
+                        (rgba_getb(c) << bs) |
+                        (rgba_geta(c) << as));
+    }
+  }
+}
+
+void convert_grayscale_to_rgba32(const Image* image, os::Surface* dst,
+  int src_x, int src_y, int dst_x, int dst_y, int w, int h, const os::SurfaceFormatData* fd)
+{
+  const int rs = fd->redShift;
+  const int gs = fd->greenShift;
+  const int bs = fd->blueShift;
+  const int as = fd->alphaShift;
+
+  for (int v=0; v<h; ++v, ++src_y, ++dst_y) {
+    auto src = (const uint16_t*)image->getPixelAddress(src_x, src_y);
+    auto dst_address = (uint32_t*)dst->getData(dst_x, dst_y);
+    int u = 0;
+
+#if defined(__x86_64__) || defined(_WIN64)
+    // Use SSE2 to convert 8 pixels in each iteration
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vmask = _mm_set1_epi32(0xff);
+    const __m128i rshift = _mm_cvtsi32_si128(rs);
+    const __m128i gshift = _mm_cvtsi32_si128(gs);
+    const __m128i bshift = _mm_cvtsi32_si128(bs);
+    const __m128i ashift = _mm_cvtsi32_si128(as);
+
+    auto convert4 = [&](const __m128i va) {
+      const __m128i val = _mm_and_si128(va, vmask);
+      const __m128i alpha = _mm_srli_epi32(va, 8);
+      return _mm_or_si128(
+        _mm_or_si128(_mm_sll_epi32(val, rshift),
+                     _mm_sll_epi32(val, gshift)),
+        _mm_or_si128(_mm_sll_epi32(val, bshift),
+                     _mm_sll_epi32(alpha, ashift)));
+    };
+
+    for (; u+8<=w; u+=8) {
+      const __m128i px = _mm_loadu_si128((const __m128i*)(src+u));
+      _mm_storeu_si128((__m128i*)(dst_address+u),
+                       convert4(_mm_unpacklo_epi16(px, zero)));
+      _mm_storeu_si128((__m128i*)(dst_address+u+4),
+                       convert4(_mm_unpackhi_epi16(px, zero)));
+    }
+#endif
+
+    for (; u<w; ++u) {
+      const color_t c = src[u];
+      dst_address[u] = ((graya_getv(c) << rs) |
+                        (graya_getv(c) << gs) |
+                        (graya_getv(c) << bs) |
+                        (graya_geta(c) << as));
+    }
+  }
+}
+
+void convert_indexed_to_rgba32(const Image* image, os::Surface* dst,
+  int src_x, int src_y, int dst_x, int dst_y, int w, int h, const Palette* palette, const os::SurfaceFormatData* fd)
+{
+  // Convert the whole palette to the surface format just one time
+  uint32_t table[256];
+  for (int i=0; i<256; ++i) {
+    table[i] = convert_color_to_surface<IndexedTraits, os::kRgbaSurfaceFormat>(
+      (i < palette->size() ? i: image->maskColor()),
+      palette, image->spec(), fd);
+  }
+
+  for (int v=0; v<h; ++v, ++src_y, ++dst_y) {
+    auto src = (const uint8_t*)image->getPixelAddress(src_x, src_y);
+    auto dst_address = (uint32_t*)dst->getData(dst_x, dst_y);
+    for (int u=0; u<w; ++u)
+      dst_address[u] = table[src[u]];
+  }
+}
+
 template<typename ImageTraits>
 void convert_image_to_surface_selector(const Image* image, os::Surface* surface,
   int src_x, int src_y, int dst_x, int dst_y, int w, int h, const Palette* palette, const os::SurfaceFormatData* fd)
@@ -147,6 +282,7 @@ void convert_image_to_surface(
   int dst_x, int dst_y,
   int w, int h)
 {
+  PROFILE_ZONE("convert_image_to_surface");
   gfx::Rect srcBounds(src_x, src_y, w, h);
   srcBounds = srcBounds.createIntersection(image->bounds());
   if (srcBounds.isEmpty())
@@ -173,32 +309,30 @@ void convert_image_to_surface(
   os::SurfaceFormatData fd;
   surface->getFormat(&fd);
 
+  // Fast paths for 32bpp surfaces
+  const bool rgba32 = is_rgba32_format(&fd);
+
   switch (image->pixelFormat()) {
 
     case IMAGE_RGB:
-      // Fast path
-      if (gfx::ColorRShift == fd.redShift &&
-          gfx::ColorGShift == fd.greenShift &&
-          gfx::ColorBShift == fd.blueShift &&
-          gfx::ColorAShift == fd.alphaShift) {
-        for (int v=0; v<h; ++v, ++src_y, ++dst_y) {
-          uint8_t* src_address = image->getPixelAddress(src_x, src_y);
-          uint8_t* dst_address = surface->getData(dst_x, dst_y);
-          std::copy(src_address,
-                    src_address + RgbTraits::bytes_per_pixel * w,
-                    dst_address);
-        }
-        return;
-      }
-      convert_image_to_surface_selector<RgbTraits>(image, surface, src_x, src_y, dst_x, dst_y, w, h, palette, &fd);
+      if (rgba32)
+        convert_rgb_to_rgba32(image, surface, src_x, src_y, dst_x, dst_y, w, h, &fd);
+      else
+        convert_image_to_surface_selector<RgbTraits>(image, surface, src_x, src_y, dst_x, dst_y, w, h, palette, &fd);
       break;
 
     case IMAGE_GRAYSCALE:
-      convert_image_to_surface_selector<GrayscaleTraits>(image, surface, src_x, src_y, dst_x, dst_y, w, h, palette, &fd);
+      if (rgba32)
+        convert_grayscale_to_rgba32(image, surface, src_x, src_y, dst_x, dst_y, w, h, &fd);
+      else
+        convert_image_to_surface_selector<GrayscaleTraits>(image, surface, src_x, src_y, dst_x, dst_y, w, h, palette, &fd);
       break;
 
     case IMAGE_INDEXED:
-      convert_image_to_surface_selector<IndexedTraits>(image, surface, src_x, src_y, dst_x, dst_y, w, h, palette, &fd);
+      if (rgba32)
+        convert_indexed_to_rgba32(image, surface, src_x, src_y, dst_x, dst_y, w, h, palette, &fd);
+      else
+        convert_image_to_surface_selector<IndexedTraits>(image, surface, src_x, src_y, dst_x, dst_y, w, h, palette, &fd);
       break;
 
     case IMAGE_BITMAP:
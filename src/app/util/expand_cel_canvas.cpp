@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -66,6 +66,30 @@ static void create_buffers()
   }
 }
 
+// Source/destination canvases are validated in tiles of this size,
+// so the first dabs of a stroke in a huge canvas copy only the
+// tiles below the brush (and we get regions with few rectangles).
+constexpr int kCanvasTileSize = 64;
+
+static int floor_to_tile(const int v)
+{
+  return (v >= 0 ? v / kCanvasTileSize:
+                   -((-v + kCanvasTileSize - 1) / kCanvasTileSize)) * kCanvasTileSize;
+}
+
+static gfx::Region expand_to_canvas_tiles(const gfx::Region& rgn)
+{
+  gfx::Region result;
+  for (const auto& rc : rgn) {
+    const int x1 = floor_to_tile(rc.x);
+    const int y1 = floor_to_tile(rc.y);
+    const int x2 = floor_to_tile(rc.x2() + kCanvasTileSize - 1);
+    const int y2 = floor_to_tile(rc.y2() + kCanvasTileSize - 1);
+    result |= gfx::Region(gfx::Rect(x1, y1, x2-x1, y2-y1));
+  }
+  return result;
+}
+
 }
 
 namespace app {
@@ -345,9 +369,10 @@ void ExpandCelCanvas::commit()
       else {
         ASSERT(m_celImage.get() == m_cel->image());
 
-        const Tileset* srcTileset = static_cast<LayerTilemap*>(m_layer)->tileset();
+        Tileset* srcTileset = static_cast<LayerTilemap*>(m_layer)->tileset();
         ASSERT(srcTileset);
         ASSERT(srcTileset->size() == m_dstTileset->size());
+        srcTileset->unshareTiles();
 
         // Patch tiles
         for (tile_index ti=1; ti<srcTileset->size(); ++ti) {
@@ -471,7 +496,8 @@ Image* ExpandCelCanvas::getSourceCanvas()
                                      m_bounds.w, m_bounds.h, src_buffer));
       m_srcImage->setMaskColor(m_sprite->transparentColor());
     }
-    m_srcImage->clear(m_srcImage->maskColor());
+    if (needsClearedCanvas())
+      m_srcImage->clear(m_srcImage->maskColor());
   }
   return m_srcImage.get();
 }
@@ -489,7 +515,8 @@ Image* ExpandCelCanvas::getDestCanvas()
                                      m_bounds.w, m_bounds.h, dst_buffer));
       m_dstImage->setMaskColor(m_sprite->transparentColor());
     }
-    m_dstImage->clear(m_dstImage->maskColor());
+    if (needsClearedCanvas())
+      m_dstImage->clear(m_dstImage->maskColor());
   }
   return m_dstImage.get();
 }
@@ -536,6 +563,8 @@ void ExpandCelCanvas::validateSourceCanvas(const gfx::Region& rgn)
   EXP_TRACE(" ->", rgnToValidate.bounds());
 
   rgnToValidate.offset(zeroPos);
+  if (m_tilemapMode != TilemapMode::Tiles)
+    rgnToValidate = expand_to_canvas_tiles(rgnToValidate);
   rgnToValidate.createSubtraction(rgnToValidate, m_validSrcRegion);
   rgnToValidate.createIntersection(rgnToValidate, gfx::Region(m_srcImage->bounds()));
 
@@ -635,8 +664,10 @@ void ExpandCelCanvas::validateDestCanvas(const gfx::Region& rgn)
   }
   EXP_TRACE(" ->", rgnToValidate.bounds());
 
-  if (m_tilemapMode != TilemapMode::Tiles)
+  if (m_tilemapMode != TilemapMode::Tiles) {
     rgnToValidate.offset(-m_bounds.origin());
+    rgnToValidate = expand_to_canvas_tiles(rgnToValidate);
+  }
   rgnToValidate.createSubtraction(rgnToValidate, m_validDstRegion);
   rgnToValidate.createIntersection(rgnToValidate, gfx::Region(m_dstImage->bounds()));
 
@@ -722,6 +753,20 @@ void ExpandCelCanvas::copyValidDestToSourceCanvas(const gfx::Region& rgn)
   m_canCompareSrcVsDst = false;
 }
 
+bool ExpandCelCanvas::needsClearedCanvas() const
+{
+  // When m_dstImage is used as the cel image (a new cel, or the
+  // pixels of a tilemap), it can be rendered from anywhere (other
+  // editors, timeline thumbnails, etc.), and tiles of a tilemap are
+  // cropped entirely from the canvas. In other cases the pixels are
+  // read only from the valid regions (the Editor validates the
+  // exposed areas, see DrawingState::onExposeSpritePixels()), so
+  // there is no need to clear the whole canvas.
+  return (m_celCreated ||
+          !m_layer ||
+          m_layer->isTilemap());
+}
+
 gfx::Rect ExpandCelCanvas::getTrimDstImageBounds() const
 {
   if (m_layer->isBackground())
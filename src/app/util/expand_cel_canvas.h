@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2021  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -94,6 +94,7 @@ namespace app {
     const doc::Grid& getGrid() const { return m_grid; }
 
   private:
+    bool needsClearedCanvas() const;
     gfx::Rect getTrimDstImageBounds() const;
     ImageRef trimDstImage(const gfx::Rect& bounds) const;
     void copySourceTilestToDestTileset();
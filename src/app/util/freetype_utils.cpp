@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -21,87 +21,199 @@
 #include "ft/hb_shaper.h"
 #include "ft/lib.h"
 
+#include <algorithm>
+#include <list>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 namespace app {
 
-doc::Image* render_text(const std::string& fontfile, int fontsize,
-                        const std::string& text,
-                        doc::color_t color,
-                        bool antialias)
-{
-  std::unique_ptr<doc::Image> image(nullptr);
-  ft::Lib ft;
-
-  ft::Face face(ft.open(fontfile));
-  if (face.isValid()) {
-    // Set font size
-    face.setSize(fontsize);
-    face.setAntialias(antialias);
+namespace {
+
+// A glyph of a text already rasterized and positioned relative to the
+// text bounds, with its coverage expanded to one byte per pixel.
+struct RunGlyph {
+  gfx::Rect bounds;
+  std::vector<uint8_t> alpha;
+};
+
+// Result of shaping and rasterizing a text with a specific font face,
+// size, and antialias option.
+struct GlyphRun {
+  gfx::Size size;
+  std::vector<RunGlyph> glyphs;
+};
+
+struct RunKey {
+  std::string fontfile;
+  int fontsize;
+  bool antialias;
+  std::string text;
+
+  bool operator==(const RunKey& o) const {
+    return (fontsize == o.fontsize &&
+            antialias == o.antialias &&
+            fontfile == o.fontfile &&
+            text == o.text);
+  }
+};
+
+// Caches opened font faces and glyph runs so rendering the same text
+// again (e.g. while the user changes the text color, or from the
+// live preview) doesn't need to load the font and rasterize the
+// glyphs again.
+class TextCache {
+public:
+  // Max number of opened faces/runs (least recently used are removed)
+  static constexpr size_t kMaxFaces = 8;
+  static constexpr size_t kMaxRuns = 256;
+
+  std::shared_ptr<const GlyphRun> getRun(const RunKey& key) {
+    const std::lock_guard lock(m_mutex);
+
+    auto it = std::find_if(m_runs.begin(), m_runs.end(),
+                           [&key](const auto& r){ return r.first == key; });
+    if (it != m_runs.end()) {
+      m_runs.splice(m_runs.begin(), m_runs, it);
+      return m_runs.front().second;
+    }
 
-    // Calculate text size
-    gfx::Rect bounds = ft::calc_text_bounds(face, text);
+    auto run = createRun(key);
+    m_runs.emplace_front(key, run);
+    if (m_runs.size() > kMaxRuns)
+      m_runs.pop_back();
+    return run;
+  }
 
-    // Render the image and copy it to the clipboard
-    if (!bounds.isEmpty()) {
-      image.reset(doc::Image::create(doc::IMAGE_RGB, bounds.w, bounds.h));
-      doc::clear_image(image.get(), 0);
+private:
+  struct FaceEntry {
+    std::string fontfile;
+    int fontsize;
+    bool antialias;
+    std::unique_ptr<ft::Face> face;
+  };
+
+  ft::Face& getFace(const RunKey& key) {
+    auto it = std::find_if(m_faces.begin(), m_faces.end(),
+                           [&key](const FaceEntry& f){
+                             return (f.fontsize == key.fontsize &&
+                                     f.antialias == key.antialias &&
+                                     f.fontfile == key.fontfile);
+                           });
+    if (it != m_faces.end()) {
+      m_faces.splice(m_faces.begin(), m_faces, it);
+      return *m_faces.front().face;
+    }
 
-      ft::ForEachGlyph<ft::Face> feg(face, text);
-      while (feg.next()) {
-        auto glyph = feg.glyph();
-        if (!glyph)
-          continue;
+    auto face = std::make_unique<ft::Face>(m_ft.open(key.fontfile));
+    if (!face->isValid())
+      throw std::runtime_error("Error loading font face");
 
-        int t, yimg = - bounds.y + int(glyph->y);
+    face->setSize(key.fontsize);
+    face->setAntialias(key.antialias);
 
-        for (int v=0; v<int(glyph->bitmap->rows); ++v, ++yimg) {
-          const uint8_t* p = glyph->bitmap->buffer + v*glyph->bitmap->pitch;
-          int ximg = - bounds.x + int(glyph->x);
-          int bit = 0;
+    m_faces.push_front(FaceEntry{ key.fontfile, key.fontsize,
+                                  key.antialias, std::move(face) });
+    if (m_faces.size() > kMaxFaces)
+      m_faces.pop_back();
+    return *m_faces.front().face;
+  }
 
-          for (int u=0; u<int(glyph->bitmap->width); ++u, ++ximg) {
-            int alpha;
+  std::shared_ptr<const GlyphRun> createRun(const RunKey& key) {
+    ft::Face& face = getFace(key);
 
-            if (antialias) {
-              alpha = *(p++);
-            }
-            else {
-              alpha = ((*p) & (1 << (7 - (bit++))) ? 255: 0);
-              if (bit == 8) {
-                bit = 0;
-                ++p;
-              }
-            }
+    // Calculate text size
+    gfx::Rect bounds = ft::calc_text_bounds(face, key.text);
+    if (bounds.isEmpty())
+      throw std::runtime_error("There is no text");
 
-            int output_alpha = MUL_UN8(doc::rgba_geta(color), alpha, t);
-            if (output_alpha) {
-              doc::color_t output_color =
-                doc::rgba(doc::rgba_getr(color),
-                          doc::rgba_getg(color),
-                          doc::rgba_getb(color),
-                          output_alpha);
-
-              doc::put_pixel(
-                image.get(), ximg, yimg,
-                doc::rgba_blender_normal(
-                  doc::get_pixel(image.get(), ximg, yimg),
-                  output_color));
+    auto run = std::make_shared<GlyphRun>();
+    run->size = bounds.size();
+
+    ft::ForEachGlyph<ft::Face> feg(face, key.text);
+    while (feg.next()) {
+      auto glyph = feg.glyph();
+      if (!glyph)
+        continue;
+
+      RunGlyph g;
+      g.bounds = gfx::Rect(- bounds.x + int(glyph->x),
+                           - bounds.y + int(glyph->y),
+                           int(glyph->bitmap->width),
+                           int(glyph->bitmap->rows));
+      g.alpha.resize(g.bounds.w * g.bounds.h);
+
+      auto dst = g.alpha.begin();
+      for (int v=0; v<g.bounds.h; ++v) {
+        const uint8_t* p = glyph->bitmap->buffer + v*glyph->bitmap->pitch;
+        int bit = 0;
+
+        for (int u=0; u<g.bounds.w; ++u, ++dst) {
+          if (key.antialias) {
+            *dst = *(p++);
+          }
+          else {
+            *dst = ((*p) & (1 << (7 - (bit++))) ? 255: 0);
+            if (bit == 8) {
+              bit = 0;
+              ++p;
             }
           }
         }
       }
+      run->glyphs.push_back(std::move(g));
     }
-    else {
-      throw std::runtime_error("There is no text");
-    }
+    return run;
   }
-  else {
-    throw std::runtime_error("Error loading font face");
+
+  std::mutex m_mutex;
+  ft::Lib m_ft;
+  std::list<FaceEntry> m_faces;
+  std::list<std::pair<RunKey, std::shared_ptr<const GlyphRun>>> m_runs;
+};
+
+} // anonymous namespace
+
+doc::Image* render_text(const std::string& fontfile, int fontsize,
+                        const std::string& text,
+                        doc::color_t color,
+                        bool antialias)
+{
+  static TextCache cache;
+  auto run = cache.getRun(RunKey{ fontfile, fontsize, antialias, text });
+
+  std::unique_ptr<doc::Image> image(
+    doc::Image::create(doc::IMAGE_RGB, run->size.w, run->size.h));
+  doc::clear_image(image.get(), 0);
+
+  // Render the glyphs with the given color
+  for (const RunGlyph& g : run->glyphs) {
+    auto alphaIt = g.alpha.begin();
+    for (int yimg=g.bounds.y; yimg<g.bounds.y2(); ++yimg) {
+      for (int ximg=g.bounds.x; ximg<g.bounds.x2(); ++ximg, ++alphaIt) {
+        int t;
+        int output_alpha = MUL_UN8(doc::rgba_geta(color), *alphaIt, t);
+        if (output_alpha) {
+          doc::color_t output_color =
+            doc::rgba(doc::rgba_getr(color),
+                      doc::rgba_getg(color),
+                      doc::rgba_getb(color),
+                      output_alpha);
+
+          doc::put_pixel(
+            image.get(), ximg, yimg,
+            doc::rgba_blender_normal(
+              doc::get_pixel(image.get(), ximg, yimg),
+              output_color));
+        }
+      }
+    }
   }
 
-  return (image ? image.release(): nullptr);
+  return image.release();
 }
 
 } // namespace app
@@ -18,6 +18,9 @@ namespace doc {
 
 namespace app {
 
+  // Renders the text in a new RGB image. Font faces and rasterized
+  // glyph runs are cached, so rendering the same text again (with
+  // any color) is fast.
   doc::Image* render_text(const std::string& fontfile, int fontsize,
                           const std::string& text,
                           doc::color_t color,
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2018  David Capello
 //
 // This program is distributed under the terms of
@@ -24,10 +24,107 @@
 #include "doc/layer.h"
 #include "doc/mask.h"
 
+#include <cstring>
+#include <memory>
+
 using namespace doc;
 
 namespace app {
 
+namespace {
+
+// Packs 8 pixels per byte of the mask bitmap (one row at a time)
+// instead of iterating bit by bit.
+template<typename ImageTraits, typename Predicate>
+void create_mask_bits(const Image* image, Image* bitmap, Predicate pred)
+{
+  const int w = image->width();
+  const int h = image->height();
+  for (int y=0; y<h; ++y) {
+    auto src = (typename ImageTraits::const_address_t)image->getPixelAddress(0, y);
+    uint8_t* dst = bitmap->getPixelAddress(0, y);
+    std::memset(dst, 0, (w+7) / 8);
+    for (int x=0; x<w; ++x, ++src) {
+      if (pred(*src))
+        dst[x >> 3] |= (1 << (x & 7));
+    }
+  }
+}
+
+// The last mask created from a cel image, so selecting the
+// boundaries of the same cel again (e.g. Add/Subtract/Intersect
+// after Replace) doesn't need to process the image again.
+struct LastCelMask {
+  ObjectId imageId = NullId;
+  ObjectVersion imageVersion = 0;
+  gfx::Rect bounds;
+  PixelFormat pixelFormat = IMAGE_RGB;
+  color_t maskColor = 0;
+  std::unique_ptr<Mask> mask;
+
+  bool match(const Cel* cel) const {
+    const Image* image = cel->image();
+    return (mask &&
+            imageId == image->id() &&
+            imageVersion == image->version() &&
+            bounds == cel->bounds() &&
+            pixelFormat == image->pixelFormat() &&
+            maskColor == image->maskColor());
+  }
+};
+
+LastCelMask g_lastCelMask;
+
+void create_mask_from_cel(const Cel* cel, Mask& newMask)
+{
+  const Image* image = cel->image();
+
+  if (g_lastCelMask.match(cel)) {
+    newMask.copyFrom(g_lastCelMask.mask.get());
+    return;
+  }
+
+  newMask.replace(cel->bounds());
+  newMask.freeze();
+
+  switch (image->pixelFormat()) {
+
+    case IMAGE_RGB:
+      create_mask_bits<RgbTraits>(
+        image, newMask.bitmap(),
+        [](color_t c) { return rgba_geta(c) >= 128; }); // TODO configurable threshold
+      break;
+
+    case IMAGE_GRAYSCALE:
+      create_mask_bits<GrayscaleTraits>(
+        image, newMask.bitmap(),
+        [](color_t c) { return graya_geta(c) >= 128; }); // TODO configurable threshold
+      break;
+
+    case IMAGE_INDEXED: {
+      const color_t maskColor = image->maskColor();
+      create_mask_bits<IndexedTraits>(
+        image, newMask.bitmap(),
+        [maskColor](color_t c) { return c != maskColor; });
+      break;
+    }
+
+  }
+
+  newMask.unfreeze();
+
+  g_lastCelMask.imageId = image->id();
+  g_lastCelMask.imageVersion = image->version();
+  g_lastCelMask.bounds = cel->bounds();
+  g_lastCelMask.pixelFormat = image->pixelFormat();
+  g_lastCelMask.maskColor = image->maskColor();
+  if (!g_lastCelMask.mask)
+    g_lastCelMask.mask = std::make_unique<Mask>();
+  g_lastCelMask.mask->copyFrom(&newMask);
+}
+
+} // anonymous namespace
+
 void select_layer_boundaries(Layer* layer,
                              const frame_t frame,
                              const SelectLayerBoundariesOp op)
@@ -35,66 +132,8 @@ void select_layer_boundaries(Layer* layer,
   Mask newMask;
 
   const Cel* cel = layer->cel(frame);
-  if (cel) {
-    const Image* image = cel->image();
-    if (image) {
-      newMask.replace(cel->bounds());
-      newMask.freeze();
-      {
-        LockImageBits<BitmapTraits> maskBits(newMask.bitmap());
-        auto maskIt = maskBits.begin();
-        auto maskEnd = maskBits.end();
-
-        switch (image->pixelFormat()) {
-
-          case IMAGE_RGB: {
-            LockImageBits<RgbTraits> rgbBits(image);
-            auto rgbIt = rgbBits.begin();
-#if _DEBUG
-            auto rgbEnd = rgbBits.end();
-#endif
-            for (; maskIt != maskEnd; ++maskIt, ++rgbIt) {
-              ASSERT(rgbIt != rgbEnd);
-              color_t c = *rgbIt;
-              *maskIt = (rgba_geta(c) >= 128); // TODO configurable threshold
-            }
-            break;
-          }
-
-          case IMAGE_GRAYSCALE: {
-            LockImageBits<GrayscaleTraits> grayBits(image);
-            auto grayIt = grayBits.begin();
-#if _DEBUG
-            auto grayEnd = grayBits.end();
-#endif
-            for (; maskIt != maskEnd; ++maskIt, ++grayIt) {
-              ASSERT(grayIt != grayEnd);
-              color_t c = *grayIt;
-              *maskIt = (graya_geta(c) >= 128); // TODO configurable threshold
-            }
-            break;
-          }
-
-          case IMAGE_INDEXED: {
-            const doc::color_t maskColor = image->maskColor();
-            LockImageBits<IndexedTraits> idxBits(image);
-            auto idxIt = idxBits.begin();
-#if _DEBUG
-            auto idxEnd = idxBits.end();
-#endif
-            for (; maskIt != maskEnd; ++maskIt, ++idxIt) {
-              ASSERT(idxIt != idxEnd);
-              color_t c = *idxIt;
-              *maskIt = (c != maskColor);
-            }
-            break;
-          }
-
-        }
-      }
-      newMask.unfreeze();
-    }
-  }
+  if (cel && cel->image())
+    create_mask_from_cel(cel, newMask);
 
   try {
     ContextWriter writer(UIContext::instance());
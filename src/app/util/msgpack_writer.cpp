@@ -0,0 +1,141 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/util/msgpack_writer.h"
+
+#include <ostream>
+
+namespace app {
+
+MsgPackWriter::MsgPackWriter(std::ostream& os)
+  : m_os(os)
+{
+}
+
+MsgPackWriter& MsgPackWriter::nil()
+{
+  put(0xc0);
+  return *this;
+}
+
+MsgPackWriter& MsgPackWriter::boolean(const bool value)
+{
+  put(value ? 0xc3: 0xc2);
+  return *this;
+}
+
+MsgPackWriter& MsgPackWriter::integer(const int64_t value)
+{
+  if (value >= 0) {
+    if (value <= 0x7f)                // positive fixint
+      put(uint8_t(value));
+    else if (value <= 0xff) {         // uint 8
+      put(0xcc);
+      putBigEndian(value, 1);
+    }
+    else if (value <= 0xffff) {       // uint 16
+      put(0xcd);
+      putBigEndian(value, 2);
+    }
+    else if (value <= 0xffffffffll) { // uint 32
+      put(0xce);
+      putBigEndian(value, 4);
+    }
+    else {                            // uint 64
+      put(0xcf);
+      putBigEndian(value, 8);
+    }
+  }
+  else {
+    if (value >= -32)                 // negative fixint
+      put(uint8_t(value));
+    else if (value >= INT8_MIN) {     // int 8
+      put(0xd0);
+      putBigEndian(uint64_t(value), 1);
+    }
+    else if (value >= INT16_MIN) {    // int 16
+      put(0xd1);
+      putBigEndian(uint64_t(value), 2);
+    }
+    else if (value >= INT32_MIN) {    // int 32
+      put(0xd2);
+      putBigEndian(uint64_t(value), 4);
+    }
+    else {                            // int 64
+      put(0xd3);
+      putBigEndian(uint64_t(value), 8);
+    }
+  }
+  return *this;
+}
+
+MsgPackWriter& MsgPackWriter::str(const std::string& value)
+{
+  const uint64_t size = value.size();
+  if (size < 32)                      // fixstr
+    put(uint8_t(0xa0 | size));
+  else if (size <= 0xff) {            // str 8
+    put(0xd9);
+    putBigEndian(size, 1);
+  }
+  else if (size <= 0xffff) {          // str 16
+    put(0xda);
+    putBigEndian(size, 2);
+  }
+  else {                              // str 32
+    put(0xdb);
+    putBigEndian(size, 4);
+  }
+  m_os.write(value.data(), value.size());
+  return *this;
+}
+
+MsgPackWriter& MsgPackWriter::array(const uint32_t size)
+{
+  if (size < 16)                      // fixarray
+    put(uint8_t(0x90 | size));
+  else if (size <= 0xffff) {          // array 16
+    put(0xdc);
+    putBigEndian(size, 2);
+  }
+  else {                              // array 32
+    put(0xdd);
+    putBigEndian(size, 4);
+  }
+  return *this;
+}
+
+MsgPackWriter& MsgPackWriter::map(const uint32_t size)
+{
+  if (size < 16)                      // fixmap
+    put(uint8_t(0x80 | size));
+  else if (size <= 0xffff) {          // map 16
+    put(0xde);
+    putBigEndian(size, 2);
+  }
+  else {                              // map 32
+    put(0xdf);
+    putBigEndian(size, 4);
+  }
+  return *this;
+}
+
+void MsgPackWriter::put(const uint8_t byte)
+{
+  m_os.put(char(byte));
+}
+
+void MsgPackWriter::putBigEndian(const uint64_t value, const int bytes)
+{
+  for (int i=bytes-1; i>=0; --i)
+    put(uint8_t((value >> (8*i)) & 0xff));
+}
+
+} // namespace app
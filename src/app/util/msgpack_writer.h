@@ -0,0 +1,41 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_UTIL_MSGPACK_WRITER_H_INCLUDED
+#define APP_UTIL_MSGPACK_WRITER_H_INCLUDED
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace app {
+
+  // Writes values in MessagePack format (https://msgpack.org/)
+  // directly to the given stream. Maps and arrays are started with
+  // the number of elements they contain (for maps, the number of
+  // key/value pairs), and then each element must be written.
+  class MsgPackWriter {
+  public:
+    MsgPackWriter(std::ostream& os);
+
+    MsgPackWriter& nil();
+    MsgPackWriter& boolean(const bool value);
+    MsgPackWriter& integer(const int64_t value);
+    MsgPackWriter& str(const std::string& value);
+    MsgPackWriter& array(const uint32_t size);
+    MsgPackWriter& map(const uint32_t size);
+
+  private:
+    void put(const uint8_t byte);
+    void putBigEndian(const uint64_t value, const int bytes);
+
+    std::ostream& m_os;
+  };
+
+} // namespace app
+
+#endif
@@ -0,0 +1,54 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/util/msgpack_writer.h"
+
+#include <sstream>
+
+using namespace app;
+
+TEST(MsgPackWriter, Integers)
+{
+  std::ostringstream os;
+  MsgPackWriter w(os);
+  w.integer(0).integer(127).integer(128).integer(256).integer(65536);
+  EXPECT_EQ(std::string("\x00\x7f"
+                        "\xcc\x80"
+                        "\xcd\x01\x00"
+                        "\xce\x00\x01\x00\x00", 12),
+            os.str());
+
+  os.str("");
+  w.integer(-1).integer(-32).integer(-33).integer(-129).integer(-32769);
+  EXPECT_EQ(std::string("\xff\xe0"
+                        "\xd0\xdf"
+                        "\xd1\xff\x7f"
+                        "\xd2\xff\xff\x7f\xff", 12),
+            os.str());
+}
+
+TEST(MsgPackWriter, StringsAndContainers)
+{
+  std::ostringstream os;
+  MsgPackWriter w(os);
+  w.map(2)
+    .str("a").array(2).boolean(true).nil()
+    .str("bc").boolean(false);
+  EXPECT_EQ(std::string("\x82"
+                        "\xa1" "a" "\x92\xc3\xc0"
+                        "\xa2" "bc" "\xc2", 10),
+            os.str());
+
+  os.str("");
+  w.str(std::string(32, 'x'));
+  EXPECT_EQ(std::string("\xd9\x20", 2) + std::string(32, 'x'), os.str());
+
+  os.str("");
+  w.array(16);
+  EXPECT_EQ(std::string("\xdc\x00\x10", 3), os.str());
+}
@@ -33,6 +33,19 @@ sk_sp<SkRuntimeEffect> make_shader(const char* code)
   return result.effect;
 }
 
+sk_sp<SkRuntimeEffect> make_blender(const char* code)
+{
+  auto result = SkRuntimeEffect::MakeForBlender(SkString(code));
+  if (!result.errorText.isEmpty()) {
+    std::string error = fmt::format("Error compiling blender.\nError: {}\n",
+                                    result.errorText.c_str());
+    LOG(ERROR, error.c_str());
+    std::printf("%s", error.c_str());
+    throw base::Exception(error);
+  }
+  return result.effect;
+}
+
 SkImageInfo get_skimageinfo_for_docimage(const doc::Image* img)
 {
   switch (img->colorMode()) {
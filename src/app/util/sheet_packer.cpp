@@ -0,0 +1,317 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/util/sheet_packer.h"
+
+#include "base/chrono.h"
+#include "base/task.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace app {
+
+// To simplify the packing, each rectangle occupies its size plus the
+// shape padding (to the right and below), and rectangles are packed
+// in a "bin" of inner coordinates (without the border padding) that
+// is "shape padding" pixels bigger than the texture inner area.
+
+SheetPacker::SheetPacker(const int borderPadding,
+                         const int shapePadding)
+  : m_borderPadding(borderPadding)
+  , m_shapePadding(shapePadding)
+{
+}
+
+void SheetPacker::add(const gfx::Size& size)
+{
+  m_sizes.push_back(size);
+}
+
+void SheetPacker::addFixed(const gfx::Rect& bounds)
+{
+  m_fixed.push_back(bounds);
+}
+
+void SheetPacker::addFreeArea(const gfx::Rect& bounds)
+{
+  m_freeAreas.push_back(bounds);
+}
+
+gfx::Size SheetPacker::bestFit(base::task_token& token,
+                               const int fixedWidth,
+                               const int fixedHeight,
+                               const double timeBudget)
+{
+  const int border2 = 2*m_borderPadding;
+  const int pad = m_shapePadding;
+
+  if (fixedWidth > 0 && fixedHeight > 0) {
+    const gfx::Size size(fixedWidth, fixedHeight);
+    pack(size, token);
+    return size;
+  }
+
+  // Pack columns of rectangles of the given height as if they were
+  // rows of the transposed texture.
+  if (fixedHeight > 0) {
+    transpose();
+    gfx::Size size = bestFit(token, fixedHeight, 0, timeBudget);
+    transpose();
+    for (auto& rc : m_rects) {
+      std::swap(rc.x, rc.y);
+      std::swap(rc.w, rc.h);
+    }
+    return gfx::Size(size.h, size.w);
+  }
+
+  if (fixedWidth > 0) {
+    const gfx::Size used = packWithWidth(fixedWidth - border2 + pad, token);
+    return gfx::Size(fixedWidth,
+                     std::max(1, used.h - pad + border2));
+  }
+
+  // Minimum width of the bin (the widest rectangle) and the area
+  // required for all rectangles
+  int minWidth = 1;
+  double area = 0.0;
+  for (const auto& sz : m_sizes) {
+    minWidth = std::max(minWidth, sz.w + pad);
+    area += double(sz.w + pad) * double(sz.h + pad);
+  }
+  for (const auto& rc : m_fixed) {
+    minWidth = std::max(minWidth, rc.x2() - m_borderPadding + pad);
+    area += double(rc.w + pad) * double(rc.h + pad);
+  }
+
+  // Try wider textures (starting from a square one) until the time
+  // budget is consumed, and keep the layout of the smallest texture.
+  base::Chrono chrono;
+  const int startWidth = std::max(minWidth, int(std::ceil(std::sqrt(area))));
+  gfx::Size bestSize;
+  std::vector<gfx::Rect> bestRects;
+  for (int k=0; k<=10; ++k) {
+    const int binWidth = std::max(minWidth, startWidth * (10+k) / 10);
+    const gfx::Size used = packWithWidth(binWidth, token);
+    if (token.canceled())
+      break;
+
+    const gfx::Size size(std::max(1, used.w - pad + border2),
+                         std::max(1, used.h - pad + border2));
+    const double sizeArea = double(size.w) * double(size.h);
+    const double bestArea = double(bestSize.w) * double(bestSize.h);
+    if (bestRects.empty() ||
+        sizeArea < bestArea ||
+        (sizeArea == bestArea &&
+         std::abs(size.w - size.h) < std::abs(bestSize.w - bestSize.h))) {
+      bestSize = size;
+      bestRects = m_rects;
+    }
+
+    if (chrono.elapsed() >= timeBudget)
+      break;
+  }
+  if (!bestRects.empty())
+    m_rects = std::move(bestRects);
+  return bestSize;
+}
+
+bool SheetPacker::pack(const gfx::Size& size,
+                       base::task_token& token)
+{
+  const int border2 = 2*m_borderPadding;
+  const int pad = m_shapePadding;
+  const gfx::Size used = packWithWidth(size.w - border2 + pad, token);
+  return (used.w - pad + border2 <= size.w &&
+          used.h - pad + border2 <= size.h);
+}
+
+gfx::Size SheetPacker::packWithWidth(const int binWidth,
+                                     base::task_token& token)
+{
+  const int border = m_borderPadding;
+  const int pad = m_shapePadding;
+
+  // Pack the tallest rectangles first
+  if (m_order.size() != m_sizes.size()) {
+    m_order.resize(m_sizes.size());
+    std::iota(m_order.begin(), m_order.end(), 0);
+    std::stable_sort(
+      m_order.begin(), m_order.end(),
+      [this](const int a, const int b){
+        const gfx::Size& sa = m_sizes[a];
+        const gfx::Size& sb = m_sizes[b];
+        return (sa.h > sb.h || (sa.h == sb.h && sa.w > sb.w));
+      });
+  }
+
+  m_rects.assign(m_sizes.size(), gfx::Rect());
+  gfx::Size used(0, 0);
+
+  // Initial skyline over the fixed rectangles
+  std::vector<Segment> skyline = { Segment{ 0, 0, binWidth } };
+  for (const auto& rc : m_fixed) {
+    const gfx::Rect bin(rc.x - border, rc.y - border, rc.w + pad, rc.h + pad);
+    raiseSkyline(skyline, bin.x, bin.w, bin.y2());
+    used.w = std::max(used.w, bin.x2());
+    used.h = std::max(used.h, bin.y2());
+  }
+
+  // Free areas are used only by placeInFreeArea(), so the skyline
+  // is over them too.
+  std::vector<gfx::Rect> freeAreas;
+  freeAreas.reserve(m_freeAreas.size());
+  for (const auto& rc : m_freeAreas) {
+    const gfx::Rect bin(rc.x - border, rc.y - border, rc.w + pad, rc.h + pad);
+    raiseSkyline(skyline, bin.x, bin.w, bin.y2());
+    freeAreas.push_back(bin);
+  }
+
+  for (const int i : m_order) {
+    if (token.canceled())
+      break;
+
+    if (placeInFreeArea(freeAreas, i)) {
+      const gfx::Rect& rc = m_rects[i];
+      used.w = std::max(used.w, rc.x2() - border + pad);
+      used.h = std::max(used.h, rc.y2() - border + pad);
+      continue;
+    }
+
+    const int w = m_sizes[i].w + pad;
+    const int h = m_sizes[i].h + pad;
+
+    // Find the position where the rectangle top-side is the lowest
+    // one (and then the leftmost one).
+    int bestX = 0;
+    int bestY = -1;
+    for (int s=0; s<int(skyline.size()); ++s) {
+      const int x = skyline[s].x;
+      if (x + w > binWidth)
+        break;
+
+      int y = 0;
+      for (int j=s, left=w; left > 0; ++j) {
+        y = std::max(y, skyline[j].y);
+        left -= skyline[j].w;
+      }
+      if (bestY < 0 || y < bestY) {
+        bestX = x;
+        bestY = y;
+      }
+    }
+
+    // The rectangle doesn't fit in the bin width, we put it below
+    // all the other rectangles (it will be outside the texture).
+    if (bestY < 0) {
+      bestX = 0;
+      bestY = used.h;
+      raiseSkyline(skyline, 0, binWidth, bestY + h);
+    }
+    else
+      raiseSkyline(skyline, bestX, w, bestY + h);
+
+    m_rects[i] = gfx::Rect(border + bestX, border + bestY,
+                           m_sizes[i].w, m_sizes[i].h);
+    used.w = std::max(used.w, bestX + w);
+    used.h = std::max(used.h, bestY + h);
+  }
+  return used;
+}
+
+bool SheetPacker::placeInFreeArea(std::vector<gfx::Rect>& freeAreas,
+                                  const int i)
+{
+  const int border = m_borderPadding;
+  const int pad = m_shapePadding;
+  const int w = m_sizes[i].w + pad;
+  const int h = m_sizes[i].h + pad;
+
+  // Use the smallest free area where the rectangle fits
+  int best = -1;
+  for (int j=0; j<int(freeAreas.size()); ++j) {
+    const gfx::Rect& area = freeAreas[j];
+    if (w <= area.w && h <= area.h &&
+        (best < 0 || area.w*area.h < freeAreas[best].w*freeAreas[best].h)) {
+      best = j;
+    }
+  }
+  if (best < 0)
+    return false;
+
+  const gfx::Rect area = freeAreas[best];
+  freeAreas.erase(freeAreas.begin()+best);
+
+  m_rects[i] = gfx::Rect(border + area.x, border + area.y,
+                         m_sizes[i].w, m_sizes[i].h);
+
+  // Split the rest of the free area in two (right and bottom sides)
+  if (area.w > w)
+    freeAreas.push_back(gfx::Rect(area.x+w, area.y, area.w-w, h));
+  if (area.h > h)
+    freeAreas.push_back(gfx::Rect(area.x, area.y+h, area.w, area.h-h));
+  return true;
+}
+
+// Sets the skyline height to "y" (if it's lower) in the [x, x+w) range.
+void SheetPacker::raiseSkyline(std::vector<Segment>& skyline,
+                               const int x, const int w, const int y)
+{
+  const int x2 = x + w;
+  std::vector<Segment> result;
+  result.reserve(skyline.size()+2);
+
+  auto push = [&result](const Segment& seg) {
+    if (seg.w <= 0)
+      return;
+    if (!result.empty() &&
+        result.back().y == seg.y &&
+        result.back().x + result.back().w == seg.x) {
+      result.back().w += seg.w;
+    }
+    else
+      result.push_back(seg);
+  };
+
+  for (const Segment& seg : skyline) {
+    const int s1 = seg.x;
+    const int s2 = seg.x + seg.w;
+    if (s2 <= x || s1 >= x2) {
+      push(seg);
+      continue;
+    }
+    if (s1 < x)
+      push(Segment{ s1, seg.y, x - s1 });
+    const int i1 = std::max(s1, x);
+    const int i2 = std::min(s2, x2);
+    push(Segment{ i1, std::max(seg.y, y), i2 - i1 });
+    if (s2 > x2)
+      push(Segment{ x2, seg.y, s2 - x2 });
+  }
+  skyline = std::move(result);
+}
+
+void SheetPacker::transpose()
+{
+  for (auto& sz : m_sizes)
+    std::swap(sz.w, sz.h);
+  for (auto& rc : m_fixed) {
+    std::swap(rc.x, rc.y);
+    std::swap(rc.w, rc.h);
+  }
+  for (auto& rc : m_freeAreas) {
+    std::swap(rc.x, rc.y);
+    std::swap(rc.w, rc.h);
+  }
+  m_order.clear();
+}
+
+} // namespace app
@@ -0,0 +1,90 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_UTIL_SHEET_PACKER_H_INCLUDED
+#define APP_UTIL_SHEET_PACKER_H_INCLUDED
+#pragma once
+
+#include "gfx/rect.h"
+#include "gfx/size.h"
+
+#include <vector>
+
+namespace base {
+  class task_token;
+}
+
+namespace app {
+
+  // Packs rectangles in a texture using a skyline (bottom-left)
+  // heuristic, so each rectangle is placed in O(skyline segments).
+  //
+  // Some areas of the texture can be occupied in advance with
+  // addFixed() and the holes between them can be given with
+  // addFreeArea() (e.g. to pack only the new rectangles of a sprite
+  // sheet and keep the old rectangles in the same position).
+  class SheetPacker {
+  public:
+    SheetPacker(const int borderPadding,
+                const int shapePadding);
+
+    // Adds a new rectangle to be packed.
+    void add(const gfx::Size& size);
+
+    // Marks the given bounds of the texture as occupied (the new
+    // rectangles will not be placed there).
+    void addFixed(const gfx::Rect& bounds);
+
+    // Adds a free area that can be used to place new rectangles
+    // before looking for space below the fixed rectangles.
+    void addFreeArea(const gfx::Rect& bounds);
+
+    // Returns the bounds of the added rectangles (in the same order
+    // they were added) after calling bestFit() or pack().
+    const std::vector<gfx::Rect>& rects() const { return m_rects; }
+
+    // Finds a small texture size to contain all rectangles. If
+    // "fixedWidth" or "fixedHeight" are greater than 0, that
+    // dimension of the texture is not modified. Several widths are
+    // tried until the "timeBudget" (in seconds) is consumed.
+    gfx::Size bestFit(base::task_token& token,
+                      const int fixedWidth,
+                      const int fixedHeight,
+                      const double timeBudget);
+
+    // Packs the rectangles in a texture of the given size. Returns
+    // false if some rectangles don't fit (they are placed outside
+    // the texture bounds).
+    bool pack(const gfx::Size& size,
+              base::task_token& token);
+
+  private:
+    struct Segment {
+      int x, y, w;
+    };
+
+    // Packs all rectangles in a bin of the given width, returns the
+    // used size of the bin.
+    gfx::Size packWithWidth(const int binWidth,
+                            base::task_token& token);
+    bool placeInFreeArea(std::vector<gfx::Rect>& freeAreas,
+                         const int i);
+    void raiseSkyline(std::vector<Segment>& skyline,
+                      const int x, const int w, const int y);
+    void transpose();
+
+    int m_borderPadding;
+    int m_shapePadding;
+    std::vector<gfx::Size> m_sizes;
+    std::vector<gfx::Rect> m_rects;
+    std::vector<gfx::Rect> m_fixed;
+    std::vector<gfx::Rect> m_freeAreas;
+    std::vector<int> m_order;
+  };
+
+} // namespace app
+
+#endif
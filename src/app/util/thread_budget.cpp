@@ -0,0 +1,53 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/util/thread_budget.h"
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+namespace app {
+
+static std::mutex g_mutex;
+static int g_threadsInUse = 0;
+
+ThreadBudget::ThreadBudget(const int wanted, const ThreadPriority priority)
+{
+  const std::lock_guard lock(g_mutex);
+
+  int available = maxThreads(priority);
+  if (priority != ThreadPriority::Interactive)
+    available -= g_threadsInUse;
+
+  m_threads = std::clamp(available, 1, std::max(1, wanted));
+  g_threadsInUse += m_threads;
+}
+
+ThreadBudget::~ThreadBudget()
+{
+  const std::lock_guard lock(g_mutex);
+  g_threadsInUse -= m_threads;
+}
+
+// static
+int ThreadBudget::maxThreads(const ThreadPriority priority)
+{
+  const int cores = std::max<int>(1, std::thread::hardware_concurrency());
+  switch (priority) {
+    case ThreadPriority::Interactive: return cores;
+    case ThreadPriority::Export:      return std::max(1, cores-1);
+    case ThreadPriority::Thumbnails:  return std::max(1, cores/2);
+    case ThreadPriority::Backup:      return 1;
+  }
+  return 1;
+}
+
+} // namespace app
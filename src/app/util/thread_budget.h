@@ -0,0 +1,48 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_UTIL_THREAD_BUDGET_H_INCLUDED
+#define APP_UTIL_THREAD_BUDGET_H_INCLUDED
+#pragma once
+
+#include "base/disable_copying.h"
+
+namespace app {
+
+  // Kind of background work that uses a pool of threads. Less urgent
+  // work can use less threads.
+  enum class ThreadPriority {
+    Interactive,                // The user is waiting the result
+    Export,                     // Saving/exporting files
+    Thumbnails,                 // File selector thumbnails
+    Backup,                     // Data recovery
+  };
+
+  // Reserves threads for a base::thread_pool from an app-wide budget
+  // (the number of cores), so concurrent pools (e.g. an export that
+  // saves several files, each one compressed in parallel) don't
+  // create more threads than cores. Non-interactive work leaves one
+  // core for the UI. Threads are given back in the destructor.
+  class ThreadBudget {
+  public:
+    ThreadBudget(const int wanted, const ThreadPriority priority);
+    ~ThreadBudget();
+
+    // Number of threads to use (at least 1).
+    int threads() const { return m_threads; }
+
+    // Maximum number of threads for the given kind of work.
+    static int maxThreads(const ThreadPriority priority);
+
+  private:
+    int m_threads;
+
+    DISABLE_COPYING(ThreadBudget);
+  };
+
+} // namespace app
+
+#endif
@@ -0,0 +1,33 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/util/thread_budget.h"
+
+using namespace app;
+
+TEST(ThreadBudget, ConcurrentPoolsShareCores)
+{
+  const int n = ThreadBudget::maxThreads(ThreadPriority::Export);
+  {
+    const ThreadBudget a(1000, ThreadPriority::Export);
+    EXPECT_EQ(n, a.threads());
+
+    // All threads are in use, but we always get at least one
+    const ThreadBudget b(1000, ThreadPriority::Export);
+    EXPECT_EQ(1, b.threads());
+
+    // Interactive work is not limited by other pools
+    const ThreadBudget c(1000, ThreadPriority::Interactive);
+    EXPECT_EQ(ThreadBudget::maxThreads(ThreadPriority::Interactive), c.threads());
+  }
+
+  // Threads were released
+  const ThreadBudget d(2, ThreadPriority::Export);
+  EXPECT_EQ(std::min(2, n), d.threads());
+  EXPECT_EQ(1, ThreadBudget(0, ThreadPriority::Backup).threads());
+}
@@ -1,5 +1,5 @@
 // Aseprite Config Library
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2014-2017  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -115,6 +115,16 @@ public:
     }
   }
 
+  bool saveToString(std::string& buffer) const {
+    SI_Error err = m_ini.Save(buffer);
+    if (err != SI_OK) {
+      LOG(ERROR, "CFG: Error %d saving configuration of %s\n",
+          (int)err, m_filename.c_str());
+      return false;
+    }
+    return true;
+  }
+
 private:
   std::string m_filename;
   CSimpleIniA m_ini;
@@ -205,4 +215,9 @@ void CfgFile::save()
   m_impl->save();
 }
 
+bool CfgFile::saveToString(std::string& buffer) const
+{
+  return m_impl->saveToString(buffer);
+}
+
 } // namespace cfg
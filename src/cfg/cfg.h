@@ -1,5 +1,5 @@
 // Aseprite Config Library
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2014-2016  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -40,6 +40,9 @@ namespace cfg {
     bool load(const std::string& filename);
     void save();
 
+    // Returns the content that save() would write in the file.
+    bool saveToString(std::string& buffer) const;
+
   private:
     class CfgFileImpl;
     CfgFileImpl* m_impl;
@@ -1,5 +1,5 @@
 // Aseprite Document IO Library
-// Copyright (c) 2018-2023 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -16,10 +16,12 @@
 #include "base/file_handle.h"
 #include "base/fs.h"
 #include "base/mask_shift.h"
+#include "base/thread_pool.h"
 #include "dio/aseprite_common.h"
 #include "dio/decode_delegate.h"
 #include "dio/file_interface.h"
 #include "dio/pixel_io.h"
+#include "dio/zlib_stream.h"
 #include "doc/doc.h"
 #include "doc/util.h"
 #include "fixmath/fixmath.h"
@@ -27,7 +29,11 @@
 #include "gfx/color_space.h"
 #include "zlib.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
+#include <memory>
+#include <thread>
 #include <vector>
 
 namespace dio {
@@ -89,6 +95,9 @@ bool AsepriteDecoder::decode()
   auto tag_end = sprite->tags().end();
 
   m_allLayers.clear();
+  m_lazyExtFiles.reset();
+  m_pendingCelImages.clear();
+  m_pendingCelBytes = 0;
 
   int current_level = -1;
   AsepriteExternalFiles extFiles;
@@ -310,6 +319,8 @@ bool AsepriteDecoder::decode()
       break;
   }
 
+  decodePendingCelImages();
+
   delegate()->onSprite(sprite.release());
   return true;
 }
@@ -700,6 +711,35 @@ void read_raw_image(FileInterface* f,
 // Compressed Image
 //////////////////////////////////////////////////////////////////////
 
+// Used to decompress the pixels of lazy loaded cels from memory.
+class BufferFileInterface : public FileInterface {
+public:
+  BufferFileInterface(const base::buffer& buffer)
+    : m_buffer(buffer) { }
+  bool ok() const override { return m_pos <= m_buffer.size(); }
+  size_t tell() override { return m_pos; }
+  void seek(size_t absPos) override { m_pos = absPos; }
+  uint8_t read8() override {
+    if (m_pos < m_buffer.size())
+      return m_buffer[m_pos++];
+    return 0;
+  }
+  size_t readBytes(uint8_t* buf, size_t n) override {
+    if (m_pos >= m_buffer.size())
+      return 0;
+    n = std::min(n, m_buffer.size() - m_pos);
+    std::copy(m_buffer.begin()+m_pos, m_buffer.begin()+m_pos+n, buf);
+    m_pos += n;
+    return n;
+  }
+  void write8(uint8_t value) override {
+    ASSERT(false);              // Read-only
+  }
+private:
+  const base::buffer& m_buffer;
+  size_t m_pos = 0;
+};
+
 template<typename ImageTraits>
 void read_compressed_image_templ(FileInterface* f,
                                  DecodeDelegate* delegate,
@@ -708,14 +748,8 @@ void read_compressed_image_templ(FileInterface* f,
                                  const size_t chunk_end)
 {
   PixelIO<ImageTraits> pixel_io;
-  z_stream zstream;
-  zstream.zalloc = (alloc_func)0;
-  zstream.zfree  = (free_func)0;
-  zstream.opaque = (voidpf)0;
-
-  int err = inflateInit(&zstream);
-  if (err != Z_OK)
-    throw base::Exception("ZLib error %d in inflateInit().", err);
+  InflateStream zstream;
+  int err;
 
   const int width = image->width();
   const int widthBytes = image->widthBytes();
@@ -750,18 +784,18 @@ void read_compressed_image_templ(FileInterface* f,
       break;
     }
 
-    zstream.next_in = (Bytef*)&compressed[0];
-    zstream.avail_in = bytes_read;
+    zstream->next_in = (Bytef*)&compressed[0];
+    zstream->avail_in = bytes_read;
 
     do {
-      zstream.next_out = (Bytef*)&uncompressed[0];
-      zstream.avail_out = uncompressed.size();
+      zstream->next_out = (Bytef*)&uncompressed[0];
+      zstream->avail_out = uncompressed.size();
 
-      err = inflate(&zstream, Z_NO_FLUSH);
+      err = inflate(zstream.get(), Z_NO_FLUSH);
       if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
         throw base::Exception("ZLib error %d in inflate().", err);
 
-      size_t uncompressed_bytes = uncompressed.size() - zstream.avail_out;
+      size_t uncompressed_bytes = uncompressed.size() - zstream->avail_out;
       if (uncompressed_bytes > 0) {
         int i = 0;
         while (y < image->height()) {
@@ -791,14 +825,10 @@ void read_compressed_image_templ(FileInterface* f,
           }
         }
       }
-    } while (zstream.avail_in != 0 && zstream.avail_out == 0);
+    } while (zstream->avail_in != 0 && zstream->avail_out == 0);
 
     delegate->progress((float)f->tell() / (float)header->size);
   }
-
-  err = inflateEnd(&zstream);
-  if (err != Z_OK)
-    throw base::Exception("ZLib error %d in inflateEnd().", err);
 }
 
 void read_compressed_image(FileInterface* f,
@@ -913,6 +943,9 @@ doc::Cel* AsepriteDecoder::readCelChunk(doc::Sprite* sprite,
           cel.reset(doc::Cel::MakeLink(frame, link));
         }
         else {
+          // We need the pixels of the linked cel to copy them
+          decodePendingCelImages();
+
           cel.reset(doc::Cel::MakeCopy(frame, link));
           cel->setPosition(x, y);
           cel->setOpacity(opacity);
@@ -932,10 +965,17 @@ doc::Cel* AsepriteDecoder::readCelChunk(doc::Sprite* sprite,
       int h = read16();
 
       if (w > 0 && h > 0) {
-        doc::ImageRef image(doc::Image::create(pixelFormat, w, h));
-        read_compressed_image(f(), delegate(), image.get(), header, chunk_end);
+        if (delegate()->lazyLoadCels() &&
+            f()->tell() < chunk_end) {
+          cel = readLazyCompressedCel(frame, pixelFormat, w, h, chunk_end);
+        }
+        if (!cel) {
+          doc::ImageRef image(doc::Image::create(pixelFormat, w, h));
+          if (!readPendingCelImage(image, chunk_end))
+            read_compressed_image(f(), delegate(), image.get(), header, chunk_end);
 
-        cel = std::make_unique<doc::Cel>(frame, image);
+          cel = std::make_unique<doc::Cel>(frame, image);
+        }
         cel->setPosition(x, y);
         cel->setOpacity(opacity);
         cel->setZIndex(zIndex);
@@ -956,9 +996,9 @@ doc::Cel* AsepriteDecoder::readCelChunk(doc::Sprite* sprite,
       uint32_t flagsMask = (xflipMask | yflipMask | dflipMask);
       readPadding(10);
 
-      // We only support 32bpp at the moment
-      // TODO add support for other bpp (8-bit, 16-bpp)
-      if (bitsPerTile != 32) {
+      // We support 32-bit and 16-bit tiles
+      // TODO add support for 8-bit tiles
+      if (bitsPerTile != 32 && bitsPerTile != 16) {
         delegate()->incompatibilityError(
           fmt::format("Unsupported tile format: {0} bits per tile", bitsPerTile));
         break;
@@ -968,7 +1008,23 @@ doc::Cel* AsepriteDecoder::readCelChunk(doc::Sprite* sprite,
         doc::ImageRef image(doc::Image::create(doc::IMAGE_TILEMAP, w, h));
         image->setMaskColor(doc::notile);
         image->clear(doc::notile);
-        read_compressed_image(f(), delegate(), image.get(), header, chunk_end);
+
+        if (bitsPerTile == 16) {
+          // 16-bit tiles are read as a grayscale image (2 bytes per
+          // pixel in little-endian), and then expanded to 32-bit.
+          doc::ImageRef tiles16(doc::Image::create(doc::IMAGE_GRAYSCALE, w, h));
+          tiles16->clear(0);
+          read_compressed_image(f(), delegate(), tiles16.get(), header, chunk_end);
+
+          for (int v=0; v<h; ++v) {
+            auto src = (doc::GrayscaleTraits::const_address_t)tiles16->getPixelAddress(0, v);
+            auto dst = (doc::TilemapTraits::address_t)image->getPixelAddress(0, v);
+            std::copy(src, src+w, dst);
+          }
+        }
+        else {
+          read_compressed_image(f(), delegate(), image.get(), header, chunk_end);
+        }
 
         // Check if the tileset of this tilemap has the
         // "ASE_TILESET_FLAG_ZERO_IS_NOTILE" we have to adjust all
@@ -1006,11 +1062,12 @@ doc::Cel* AsepriteDecoder::readCelChunk(doc::Sprite* sprite,
             }
 
             // Convert read index to doc::tile_i_mask, and flags to doc::tile_f_mask
+            // (16-bit tiles don't have flags, their masks are zero)
             tile = doc::tile(
               ti,
-              ((tile & xflipMask) == xflipMask ? doc::tile_f_xflip: 0) |
-              ((tile & yflipMask) == yflipMask ? doc::tile_f_yflip: 0) |
-              ((tile & dflipMask) == dflipMask ? doc::tile_f_dflip: 0));
+              (xflipMask && (tile & xflipMask) == xflipMask ? doc::tile_f_xflip: 0) |
+              (yflipMask && (tile & yflipMask) == yflipMask ? doc::tile_f_yflip: 0) |
+              (dflipMask && (tile & dflipMask) == dflipMask ? doc::tile_f_dflip: 0));
 
             return tile;
           });
@@ -1037,6 +1094,132 @@ doc::Cel* AsepriteDecoder::readCelChunk(doc::Sprite* sprite,
   return cel.release();
 }
 
+std::unique_ptr<doc::Cel> AsepriteDecoder::readLazyCompressedCel(
+  const doc::frame_t frame,
+  const doc::PixelFormat pixelFormat,
+  const int w, const int h,
+  const size_t chunk_end)
+{
+  const size_t beg = f()->tell();
+  auto compressed = std::make_shared<base::buffer>(chunk_end - beg);
+  if (f()->readBytes(&(*compressed)[0], compressed->size()) != compressed->size()) {
+    f()->seek(beg);
+    return nullptr;
+  }
+
+  auto celData = std::make_shared<doc::CelData>(
+    gfx::Size(w, h), int(compressed->size()),
+    [compressed, pixelFormat, w, h]{
+      doc::ImageRef image(doc::Image::create(pixelFormat, w, h));
+
+      AsepriteHeader header;
+      header.size = compressed->size();
+
+      // Errors are ignored here, we cannot report them to the user in
+      // the middle of any operation that needs the cel image.
+      BufferFileInterface bufferFile(*compressed);
+      DecodeDelegate delegate;
+      read_compressed_image(&bufferFile, &delegate, image.get(),
+                            &header, compressed->size());
+      return image;
+    });
+
+  return std::make_unique<doc::Cel>(frame, celData);
+}
+
+// Collects the errors found decoding pixels in a worker thread to
+// report them later from the main decoder thread.
+class PendingCelImageDelegate : public DecodeDelegate {
+public:
+  void error(const std::string& msg) override {
+    m_errors.push_back(msg);
+  }
+  const std::vector<std::string>& errors() const { return m_errors; }
+private:
+  std::vector<std::string> m_errors;
+};
+
+bool AsepriteDecoder::readPendingCelImage(const doc::ImageRef& image,
+                                          const size_t chunk_end)
+{
+  const size_t beg = f()->tell();
+  if (std::thread::hardware_concurrency() < 2 ||
+      beg >= chunk_end)
+    return false;
+
+  PendingCelImage pending;
+  pending.image = image;
+  pending.compressed.resize(chunk_end - beg);
+  if (f()->readBytes(&pending.compressed[0], pending.compressed.size())
+      != pending.compressed.size()) {
+    f()->seek(beg);
+    return false;
+  }
+
+  m_pendingCelBytes += pending.compressed.size();
+  m_pendingCelImages.push_back(std::move(pending));
+
+  // Limit the memory used by compressed data that is waiting to be
+  // decoded.
+  if (m_pendingCelBytes >= kMaxPendingCelBytes)
+    decodePendingCelImages();
+  return true;
+}
+
+void AsepriteDecoder::decodePendingCelImages()
+{
+  if (m_pendingCelImages.empty())
+    return;
+
+  auto decode = [](PendingCelImage& pending) {
+    try {
+      AsepriteHeader header;
+      header.size = pending.compressed.size();
+
+      BufferFileInterface bufferFile(pending.compressed);
+      PendingCelImageDelegate delegate;
+      read_compressed_image(&bufferFile, &delegate, pending.image.get(),
+                            &header, pending.compressed.size());
+      pending.errors = delegate.errors();
+    }
+    catch (...) {
+      pending.exception = std::current_exception();
+    }
+  };
+
+  const int threads =
+    std::clamp<int>(std::thread::hardware_concurrency(), 1,
+                    int(m_pendingCelImages.size()));
+  if (threads > 1) {
+    std::atomic<size_t> next(0);
+    base::thread_pool pool(threads);
+    for (int k=0; k<threads; ++k) {
+      pool.execute([this, &next, &decode]{
+        for (size_t i; (i = next++) < m_pendingCelImages.size(); )
+          decode(m_pendingCelImages[i]);
+      });
+    }
+    pool.wait_all();
+  }
+  else {
+    for (auto& pending : m_pendingCelImages)
+      decode(pending);
+  }
+
+  // Report errors in the same order as they were found in the file
+  // (and rethrow the first exception as read_compressed_image()
+  // would do if it was called from the decoder thread).
+  std::vector<PendingCelImage> pendings;
+  std::swap(pendings, m_pendingCelImages);
+  m_pendingCelBytes = 0;
+  for (auto& pending : pendings) {
+    for (const auto& msg : pending.errors)
+      delegate()->error(msg);
+    if (pending.exception)
+      std::rethrow_exception(pending.exception);
+  }
+}
+
 void AsepriteDecoder::readCelExtraChunk(doc::Cel* cel)
 {
   // Read chunk data
@@ -1204,10 +1387,50 @@ void AsepriteDecoder::readUserDataChunk(doc::UserData* userData,
   }
 
   if (flags & ASE_USER_DATA_FLAG_HAS_PROPERTIES) {
-    readPropertiesMaps(userData->propertiesMaps(), extFiles);
+    if (!delegate()->lazyLoadProperties() ||
+        !readLazyPropertiesMaps(userData, extFiles)) {
+      readPropertiesMaps(userData->propertiesMaps(), extFiles);
+    }
   }
 }
 
+bool AsepriteDecoder::readLazyPropertiesMaps(doc::UserData* userData,
+                                             const AsepriteExternalFiles& extFiles)
+{
+  const size_t beg = f()->tell();
+  const size_t size = read32();
+  f()->seek(beg);
+  if (size < 8)                 // Size + number of maps
+    return false;
+
+  auto data = std::make_shared<base::buffer>(size);
+  if (f()->readBytes(&(*data)[0], data->size()) != data->size()) {
+    f()->seek(beg);
+    return false;
+  }
+
+  // The same external files are shared by all properties (we only
+  // need a new copy if there are new external files).
+  if (!m_lazyExtFiles ||
+      m_lazyExtFiles->items().size() != extFiles.items().size()) {
+    m_lazyExtFiles = std::make_shared<const AsepriteExternalFiles>(extFiles);
+  }
+
+  userData->setPropertiesLoader(
+    [data, extFiles = m_lazyExtFiles]{
+      doc::UserData::PropertiesMaps propertiesMaps;
+
+      // Errors are ignored here as in lazy loaded cels.
+      BufferFileInterface bufferFile(*data);
+      DecodeDelegate delegate;
+      AsepriteDecoder decoder;
+      decoder.initialize(&delegate, &bufferFile);
+      decoder.readPropertiesMaps(propertiesMaps, *extFiles);
+      return propertiesMaps;
+    });
+  return true;
+}
+
 void AsepriteDecoder::readSlicesChunk(doc::Slices& slices)
 {
   size_t nslices = read32();    // Number of slices
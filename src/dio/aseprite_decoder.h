@@ -1,5 +1,5 @@
 // Aseprite Document IO Library
-// Copyright (c) 2018-2023 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -9,8 +9,10 @@
 #define DIO_ASEPRITE_DECODER_H_INCLUDED
 #pragma once
 
+#include "base/buffer.h"
 #include "dio/decoder.h"
 #include "doc/frame.h"
+#include "doc/image_ref.h"
 #include "doc/layer_list.h"
 #include "doc/pixel_format.h"
 #include "doc/slices.h"
@@ -18,6 +20,8 @@
 #include "doc/tileset.h"
 #include "doc/user_data.h"
 
+#include <exception>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -42,6 +46,17 @@ public:
   bool decode() override;
 
 private:
+  struct PendingCelImage {
+    doc::ImageRef image;
+    base::buffer compressed;
+    std::vector<std::string> errors;
+    std::exception_ptr exception;
+  };
+
+  // Max size of compressed cel data to keep in memory before
+  // decoding it.
+  static constexpr size_t kMaxPendingCelBytes = 64*1024*1024;
+
   bool readHeader(AsepriteHeader* header);
   void readFrameHeader(AsepriteFrameHeader* frame_header);
   void readPadding(const int bytes);
@@ -57,6 +72,13 @@ private:
                          doc::PixelFormat pixelFormat,
                          const AsepriteHeader* header,
                          const size_t chunk_end);
+  std::unique_ptr<doc::Cel> readLazyCompressedCel(const doc::frame_t frame,
+                                                  const doc::PixelFormat pixelFormat,
+                                                  const int w, const int h,
+                                                  const size_t chunk_end);
+  bool readPendingCelImage(const doc::ImageRef& image,
+                           const size_t chunk_end);
+  void decodePendingCelImages();
   void readCelExtraChunk(doc::Cel* cel);
   void readColorProfile(doc::Sprite* sprite);
   void readExternalFiles(AsepriteExternalFiles& extFiles);
@@ -71,11 +93,19 @@ private:
                                  const AsepriteExternalFiles& extFiles);
   void readPropertiesMaps(doc::UserData::PropertiesMaps& propertiesMaps,
                           const AsepriteExternalFiles& extFiles);
+  bool readLazyPropertiesMaps(doc::UserData* userData,
+                              const AsepriteExternalFiles& extFiles);
   const doc::UserData::Variant readPropertyValue(uint16_t type);
   void readTilesData(doc::Tileset* tileset, const AsepriteExternalFiles& extFiles);
 
   doc::LayerList m_allLayers;
   std::vector<uint32_t> m_tilesetFlags;
+  std::shared_ptr<const AsepriteExternalFiles> m_lazyExtFiles;
+
+  // Compressed cel images read sequentially from the file, that are
+  // decompressed in parallel by decodePendingCelImages().
+  std::vector<PendingCelImage> m_pendingCelImages;
+  size_t m_pendingCelBytes = 0;
 };
 
 } // namespace dio
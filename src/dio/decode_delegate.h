@@ -1,5 +1,5 @@
 // Aseprite Document IO Library
-// Copyright (c) 2023 Igara Studio S.A.
+// Copyright (c) 2023-2024 Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -56,6 +56,20 @@ public:
   virtual bool cacheCompressedTilesets() const {
     return false;
   }
+
+  // Returns true if we want to keep the compressed pixels of cels in
+  // memory and decompress them the first time each cel image is
+  // used (instead of decompressing all cels when the file is
+  // loaded).
+  virtual bool lazyLoadCels() const {
+    return false;
+  }
+
+  // Returns true if we want to keep the encoded user data properties
+  // in memory and decode them the first time they are accessed.
+  virtual bool lazyLoadProperties() const {
+    return false;
+  }
 };
 
 } // namespace dio
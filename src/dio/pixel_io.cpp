@@ -0,0 +1,198 @@
+// Aseprite Document IO Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dio/pixel_io.h"
+
+#include "doc/color_scales.h"
+
+#if defined(__x86_64__) || defined(_WIN64)
+  #define DIO_USE_SSE2 1
+  #include <emmintrin.h>
+#endif
+
+namespace dio {
+
+using namespace doc;
+
+namespace {
+
+// Swaps the R and B channels of 4 bytes per pixel scanlines (RGBA
+// <-> BGRA), it's the same operation in both directions.
+void swap_rb(const uint8_t* src, int w, uint8_t* dst)
+{
+  int x = 0;
+#if DIO_USE_SSE2
+  const __m128i agMask = _mm_set1_epi32(int(0xff00ff00));
+  const __m128i rbMask = _mm_set1_epi32(0x00ff00ff);
+  for (; x+4<=w; x+=4) {
+    const __m128i c = _mm_loadu_si128((const __m128i*)(src+4*x));
+    const __m128i rb = _mm_and_si128(c, rbMask);
+    const __m128i r =
+      _mm_or_si128(_mm_and_si128(c, agMask),
+                   _mm_or_si128(_mm_slli_epi32(rb, 16),
+                                _mm_srli_epi32(rb, 16)));
+    _mm_storeu_si128((__m128i*)(dst+4*x), r);
+  }
+#endif
+  for (; x<w; ++x) {
+    const uint8_t* s = src+4*x;
+    uint8_t* d = dst+4*x;
+    const uint8_t r = s[0];
+    d[0] = s[2];
+    d[1] = s[1];
+    d[2] = r;
+    d[3] = s[3];
+  }
+}
+
+} // anonymous namespace
+
+void read_rgb_scanline(const uint8_t* src, int w,
+                       const ScanlineLayout layout,
+                       RgbTraits::address_t dst)
+{
+  switch (layout) {
+
+    case ScanlineLayout::RGB:
+      for (int x=0; x<w; ++x, src+=3)
+        dst[x] = rgba(src[0], src[1], src[2], 255);
+      break;
+
+    case ScanlineLayout::RGBA:
+#if DIO_USE_SSE2
+      // The bytes of a RGBA pixel are in the same order as the
+      // doc::rgba() value in a little-endian machine.
+      std::memcpy(dst, src, 4*w);
+#else
+      for (int x=0; x<w; ++x, src+=4)
+        dst[x] = rgba(src[0], src[1], src[2], src[3]);
+#endif
+      break;
+
+    case ScanlineLayout::BGR:
+      for (int x=0; x<w; ++x, src+=3)
+        dst[x] = rgba(src[2], src[1], src[0], 255);
+      break;
+
+    case ScanlineLayout::BGRA:
+#if DIO_USE_SSE2
+      swap_rb(src, w, (uint8_t*)dst);
+#else
+      for (int x=0; x<w; ++x, src+=4)
+        dst[x] = rgba(src[2], src[1], src[0], src[3]);
+#endif
+      break;
+  }
+}
+
+void write_rgb_scanline(RgbTraits::const_address_t src, int w,
+                        const ScanlineLayout layout,
+                        uint8_t* dst)
+{
+  switch (layout) {
+
+    case ScanlineLayout::RGB:
+      for (int x=0; x<w; ++x, dst+=3) {
+        const color_t c = src[x];
+        dst[0] = rgba_getr(c);
+        dst[1] = rgba_getg(c);
+        dst[2] = rgba_getb(c);
+      }
+      break;
+
+    case ScanlineLayout::RGBA:
+#if DIO_USE_SSE2
+      std::memcpy(dst, src, 4*w);
+#else
+      for (int x=0; x<w; ++x, dst+=4) {
+        const color_t c = src[x];
+        dst[0] = rgba_getr(c);
+        dst[1] = rgba_getg(c);
+        dst[2] = rgba_getb(c);
+        dst[3] = rgba_geta(c);
+      }
+#endif
+      break;
+
+    case ScanlineLayout::BGR:
+      for (int x=0; x<w; ++x, dst+=3) {
+        const color_t c = src[x];
+        dst[0] = rgba_getb(c);
+        dst[1] = rgba_getg(c);
+        dst[2] = rgba_getr(c);
+      }
+      break;
+
+    case ScanlineLayout::BGRA:
+#if DIO_USE_SSE2
+      swap_rb((const uint8_t*)src, w, dst);
+#else
+      for (int x=0; x<w; ++x, dst+=4) {
+        const color_t c = src[x];
+        dst[0] = rgba_getb(c);
+        dst[1] = rgba_getg(c);
+        dst[2] = rgba_getr(c);
+        dst[3] = rgba_geta(c);
+      }
+#endif
+      break;
+  }
+}
+
+bool read_rgb555_scanline(const uint8_t* src, int w,
+                          RgbTraits::address_t dst)
+{
+  bool withAlpha = false;
+  int x = 0;
+#if DIO_USE_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i mask5 = _mm_set1_epi32(0x1f);
+  const __m128i alphaBit = _mm_set1_epi32(0x8000);
+  const __m128i alphaMask = _mm_set1_epi32(int(0xff000000));
+  __m128i anyAlpha = zero;
+  for (; x+8<=w; x+=8) {
+    const __m128i words = _mm_loadu_si128((const __m128i*)(src+2*x));
+    const __m128i halves[2] = { _mm_unpacklo_epi16(words, zero),
+                                _mm_unpackhi_epi16(words, zero) };
+    for (int i=0; i<2; ++i) {
+      const __m128i v = halves[i];
+      __m128i r = _mm_and_si128(_mm_srli_epi32(v, 10), mask5);
+      __m128i g = _mm_and_si128(_mm_srli_epi32(v, 5), mask5);
+      __m128i b = _mm_and_si128(v, mask5);
+      // Same as scale_5bits_to_8bits()
+      r = _mm_or_si128(_mm_slli_epi32(r, 3), _mm_srli_epi32(r, 2));
+      g = _mm_or_si128(_mm_slli_epi32(g, 3), _mm_srli_epi32(g, 2));
+      b = _mm_or_si128(_mm_slli_epi32(b, 3), _mm_srli_epi32(b, 2));
+      const __m128i a =
+        _mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(v, alphaBit), alphaBit),
+                      alphaMask);
+      anyAlpha = _mm_or_si128(anyAlpha, a);
+      const __m128i c =
+        _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)),
+                     _mm_or_si128(_mm_slli_epi32(b, 16), a));
+      _mm_storeu_si128((__m128i*)(dst+x+4*i), c);
+    }
+  }
+  if (_mm_movemask_epi8(anyAlpha))
+    withAlpha = true;
+#endif
+  for (; x<w; ++x) {
+    const int word = (src[2*x] | (src[2*x+1] << 8));
+    const int a = (word & 0x8000 ? 255: 0);
+    if (a)
+      withAlpha = true;
+    dst[x] = rgba(scale_5bits_to_8bits((word >> 10) & 0x1f),
+                  scale_5bits_to_8bits((word >> 5) & 0x1f),
+                  scale_5bits_to_8bits(word & 0x1f), a);
+  }
+  return withAlpha;
+}
+
+} // namespace dio
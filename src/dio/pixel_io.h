@@ -1,5 +1,5 @@
 // Aseprite Document IO Library
-// Copyright (c) 2019 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2017-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -16,6 +16,28 @@
 
 namespace dio {
 
+// Order of the bytes of each pixel in a file scanline (e.g. .bmp
+// files use BGR/BGRA, .qoi files use RGB/RGBA).
+enum class ScanlineLayout { RGB, RGBA, BGR, BGRA };
+
+// Converts "w" pixels from the "src" file bytes to RGBA image
+// pixels. RGB/BGR pixels are converted as opaque pixels.
+void read_rgb_scanline(const uint8_t* src, int w,
+                       const ScanlineLayout layout,
+                       doc::RgbTraits::address_t dst);
+
+// Converts "w" RGBA image pixels to the "dst" file bytes (the alpha
+// channel is discarded for RGB/BGR layouts).
+void write_rgb_scanline(doc::RgbTraits::const_address_t src, int w,
+                        const ScanlineLayout layout,
+                        uint8_t* dst);
+
+// Converts "w" 16-bit little-endian X1R5G5B5 pixels to RGBA image
+// pixels (the X bit is used as alpha, 0 or 255). Returns true if
+// some pixel has the alpha bit set.
+bool read_rgb555_scanline(const uint8_t* src, int w,
+                          doc::RgbTraits::address_t dst);
+
 template<typename ImageTraits>
 class PixelIO {
 public:
@@ -46,22 +68,11 @@ public:
   }
   void read_scanline(doc::RgbTraits::address_t address,
                      int w, uint8_t* buffer) {
-    for (int x=0; x<w; ++x, ++address) {
-      r = *(buffer++);
-      g = *(buffer++);
-      b = *(buffer++);
-      a = *(buffer++);
-      *address = doc::rgba(r, g, b, a);
-    }
+    read_rgb_scanline(buffer, w, ScanlineLayout::RGBA, address);
   }
   void write_scanline(doc::RgbTraits::address_t address,
                       int w, uint8_t* buffer) {
-    for (int x=0; x<w; ++x, ++address) {
-      *(buffer++) = doc::rgba_getr(*address);
-      *(buffer++) = doc::rgba_getg(*address);
-      *(buffer++) = doc::rgba_getb(*address);
-      *(buffer++) = doc::rgba_geta(*address);
-    }
+    write_rgb_scanline(address, w, ScanlineLayout::RGBA, buffer);
   }
 };
 
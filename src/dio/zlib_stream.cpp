@@ -0,0 +1,105 @@
+// Aseprite Document IO Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dio/zlib_stream.h"
+
+#include "base/exception.h"
+
+#include <memory>
+
+namespace dio {
+
+namespace {
+
+// Free streams of the current thread (at most one of each kind, the
+// other ones are destroyed when they are returned to the cache).
+struct StreamsCache {
+  std::unique_ptr<z_stream> deflate;
+  int deflateLevel = Z_DEFAULT_COMPRESSION;
+  std::unique_ptr<z_stream> inflate;
+
+  ~StreamsCache() {
+    if (deflate)
+      deflateEnd(deflate.get());
+    if (inflate)
+      inflateEnd(inflate.get());
+  }
+};
+
+thread_local StreamsCache cache;
+
+std::unique_ptr<z_stream> new_stream()
+{
+  auto zstream = std::make_unique<z_stream>();
+  zstream->zalloc = (alloc_func)0;
+  zstream->zfree  = (free_func)0;
+  zstream->opaque = (voidpf)0;
+  return zstream;
+}
+
+} // anonymous namespace
+
+DeflateStream::DeflateStream(const int level)
+{
+  std::unique_ptr<z_stream> zstream = std::move(cache.deflate);
+  if (zstream) {
+    // The cached stream was reset when it was returned, we can
+    // change its level before compressing any data.
+    if (cache.deflateLevel != level) {
+      int err = deflateParams(zstream.get(), level, Z_DEFAULT_STRATEGY);
+      if (err != Z_OK) {
+        deflateEnd(zstream.get());
+        zstream.reset();
+      }
+    }
+  }
+  if (!zstream) {
+    zstream = new_stream();
+    int err = deflateInit(zstream.get(), level);
+    if (err != Z_OK)
+      throw base::Exception("ZLib error %d in deflateInit().", err);
+  }
+  m_stream = zstream.release();
+  m_level = level;
+}
+
+DeflateStream::~DeflateStream()
+{
+  std::unique_ptr<z_stream> zstream(m_stream);
+  if (!cache.deflate && deflateReset(zstream.get()) == Z_OK) {
+    cache.deflate = std::move(zstream);
+    cache.deflateLevel = m_level;
+  }
+  else
+    deflateEnd(zstream.get());
+}
+
+InflateStream::InflateStream()
+{
+  std::unique_ptr<z_stream> zstream = std::move(cache.inflate);
+  if (!zstream) {
+    zstream = new_stream();
+    int err = inflateInit(zstream.get());
+    if (err != Z_OK)
+      throw base::Exception("ZLib error %d in inflateInit().", err);
+  }
+  m_stream = zstream.release();
+}
+
+InflateStream::~InflateStream()
+{
+  std::unique_ptr<z_stream> zstream(m_stream);
+  if (!cache.inflate && inflateReset(zstream.get()) == Z_OK)
+    cache.inflate = std::move(zstream);
+  else
+    inflateEnd(zstream.get());
+}
+
+} // namespace dio
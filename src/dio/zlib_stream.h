@@ -0,0 +1,57 @@
+// Aseprite Document IO Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DIO_ZLIB_STREAM_H_INCLUDED
+#define DIO_ZLIB_STREAM_H_INCLUDED
+#pragma once
+
+#include "zlib.h"
+
+namespace dio {
+
+// zlib streams borrowed from a per-thread cache. Initializing a
+// deflate stream allocates ~256KB of state (and ~40KB for an inflate
+// stream), so when we load/save a lot of small files/images (e.g.
+// batch conversions from the CLI) we reset and reuse the same stream
+// instead of creating a new one for each image.
+//
+// The stream is ready to be used (like after deflateInit() or
+// inflateInit()) and it's returned to the cache in the destructor
+// (so deflateEnd()/inflateEnd() must not be called).
+class DeflateStream {
+public:
+  explicit DeflateStream(const int level);
+  ~DeflateStream();
+
+  z_stream* operator->() { return m_stream; }
+  z_stream* get() { return m_stream; }
+
+private:
+  DeflateStream(const DeflateStream&) = delete;
+  DeflateStream& operator=(const DeflateStream&) = delete;
+
+  z_stream* m_stream;
+  int m_level;
+};
+
+class InflateStream {
+public:
+  InflateStream();
+  ~InflateStream();
+
+  z_stream* operator->() { return m_stream; }
+  z_stream* get() { return m_stream; }
+
+private:
+  InflateStream(const InflateStream&) = delete;
+  InflateStream& operator=(const InflateStream&) = delete;
+
+  z_stream* m_stream;
+};
+
+} // namespace dio
+
+#endif
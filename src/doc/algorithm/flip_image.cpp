@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2023 Igara Studio S.A.
+// Copyright (c) 2023-2024 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -20,13 +20,64 @@
 #include "gfx/rect.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <memory>
 #include <utility>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define DOC_FLIP_SSE2 1
+  #include <emmintrin.h>
+#else
+  #define DOC_FLIP_SSE2 0
+#endif
+
 namespace doc {
 namespace algorithm {
 
+#if DOC_FLIP_SSE2
+
+// Reverses the order of the pixels in a 16 bytes register.
+template<typename pixel_t>
+static inline __m128i reverse_pixels(__m128i v)
+{
+  if constexpr (sizeof(pixel_t) == 4) {
+    return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+  }
+  else {
+    // Reverse 16-bit words
+    v = _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+    // Swap the bytes of each word
+    if constexpr (sizeof(pixel_t) == 1)
+      v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    return v;
+  }
+}
+
+#endif
+
+// Reverses the "n" pixels of a row in place, swapping 16 bytes
+// from each side at the same time.
+template<typename pixel_t>
+static void reverse_row(pixel_t* l, const int n)
+{
+  pixel_t* r = l+n;             // One past the last pixel
+#if DOC_FLIP_SSE2
+  constexpr int kLanes = 16 / sizeof(pixel_t);
+  while (r-l >= 2*kLanes) {
+    r -= kLanes;
+    const __m128i a = _mm_loadu_si128((const __m128i*)l);
+    const __m128i b = _mm_loadu_si128((const __m128i*)r);
+    _mm_storeu_si128((__m128i*)l, reverse_pixels<pixel_t>(b));
+    _mm_storeu_si128((__m128i*)r, reverse_pixels<pixel_t>(a));
+    l += kLanes;
+  }
+#endif
+  std::reverse(l, r);
+}
+
 template<typename ImageTraits>
 void flip_image_with_put_pixel_fast_templ(Image* image, const gfx::Rect& bounds, FlipType flipType)
 {
@@ -81,26 +132,19 @@ void flip_image_with_rawptr_templ(Image* image, const gfx::Rect& bounds, FlipTyp
 
     case FlipHorizontal:
       for (int y=bounds.y; y<bounds.y2(); ++y) {
-        const int n = bounds.w/2;
-        auto l = (address_t)image->getPixelAddress(bounds.x, y);
-        auto r = (address_t)image->getPixelAddress(bounds.x2()-1, y);
-
-        for (int x=0; x<n; ++x, ++l, --r) {
-          std::swap(*l, *r);
-        }
+        reverse_row(
+          (address_t)image->getPixelAddress(bounds.x, y), bounds.w);
       }
       break;
 
     case FlipVertical: {
+      // Swap whole rows (swap_ranges() is vectorized by the compiler)
       const int n = bounds.w;
       int v = bounds.y2()-1;
       for (int y=bounds.y; y<bounds.y+bounds.h/2; ++y, --v) {
         auto t = (address_t)image->getPixelAddress(bounds.x, y);
         auto b = (address_t)image->getPixelAddress(bounds.x, v);
-
-        for (int x=0; x<n; ++x, ++t, ++b) {
-          std::swap(*t, *b);
-        }
+        std::swap_ranges(t, t+n, b);
       }
       break;
     }
@@ -6,6 +6,10 @@
 // - Added non-contiguous mode
 // - Added mask parameter
 //
+// Changes by Igara Studio:
+// - Span search comparing several pixels at the same time
+// - Non-contiguous mode finds spans in parallel bands of rows
+//
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
 //
@@ -17,14 +21,17 @@
 
 #include "base/base.h"
 #include "doc/algo.h"
+#include "doc/color_matcher.h"
 #include "doc/image.h"
 #include "doc/mask.h"
 #include "doc/primitives.h"
 #include "doc/primitives_fast.h"
 
+#include <algorithm>
 #include <climits>
 #include <cmath>
 #include <limits>
+#include <thread>
 #include <vector>
 
 namespace doc {
@@ -132,6 +139,97 @@ inline bool color_equal<TilemapTraits>(color_t c1, color_t c2, int tolerance)
   return color_equal_32_raw(c1, c2);
 }
 
+// Number of pixels compared at the same time with a ColorMatcher.
+constexpr int kSpanChunk = 16;
+
+// Returns the first x in [x, x2) where match(pixel) != expected (or
+// x2 if all pixels are in the span).
+template<typename ImageTraits>
+static int find_span_end(typename ImageTraits::const_address_t address,
+                         int x, const int x2,
+                         const ColorMatcher<ImageTraits>& match,
+                         const bool expected)
+{
+  for (; x+kSpanChunk <= x2; x+=kSpanChunk) {
+    bool all = true;
+    for (int i=0; i<kSpanChunk; ++i)
+      all &= (match(address[x+i]) == expected);
+    if (!all)
+      break;
+  }
+  for (; x<x2 && match(address[x]) == expected; ++x)
+    ;
+  return x;
+}
+
+// Returns the first x in [x1, x] (going to the left) where the pixel
+// doesn't match (or x1-1 if all pixels match).
+template<typename ImageTraits>
+static int find_span_begin(typename ImageTraits::const_address_t address,
+                           int x, const int x1,
+                           const ColorMatcher<ImageTraits>& match)
+{
+  for (; x-kSpanChunk+1 >= x1; x-=kSpanChunk) {
+    bool all = true;
+    for (int i=0; i<kSpanChunk; ++i)
+      all &= match(address[x-i]);
+    if (!all)
+      break;
+  }
+  for (; x>=x1 && match(address[x]); --x)
+    ;
+  return x;
+}
+
+#define MASKED(u, v)                                                    \
+        (mask &&                                                        \
+         (!mask->bounds().contains(u, v) ||                             \
+          (mask->bitmap() &&                                            \
+           !get_pixel_fast<BitmapTraits>(mask->bitmap(),                \
+                                         (u)-mask->bounds().x,          \
+                                         (v)-mask->bounds().y))))
+
+// Finds the span of pixels around (x, y) that match the source
+// color. Returns false if the (x, y) pixel doesn't match. "left" and
+// "right" are the first pixels that don't match on each side.
+template<typename ImageTraits>
+static bool find_flood_span(const Image* image,
+                            const Mask* mask,
+                            const int x, const int y,
+                            const gfx::Rect& bounds,
+                            const color_t src_color,
+                            const int tolerance,
+                            int& left, int& right)
+{
+  const ColorMatcher<ImageTraits> match(src_color, tolerance);
+  auto address = reinterpret_cast<typename ImageTraits::const_address_t>(
+    image->getPixelAddress(0, y));
+
+  // Check start pixel
+  if (!match(address[x]) || MASKED(x, y))
+    return false;
+
+  left = find_span_begin<ImageTraits>(address, x-1, bounds.x, match);
+  right = find_span_end<ImageTraits>(address, x+1, bounds.x2(), match, true);
+
+  // Cut the span with the mask
+  if (mask) {
+    for (int u=x-1; u>left; --u) {
+      if (MASKED(u, y)) {
+        left = u;
+        break;
+      }
+    }
+    for (int u=x+1; u<right; ++u) {
+      if (MASKED(u, y)) {
+        right = u;
+        break;
+      }
+    }
+  }
+  return true;
+}
+
 
 
 /* flooder:
@@ -145,14 +243,6 @@ static int flooder(const Image* image,
                    const gfx::Rect& bounds,
                    color_t src_color, int tolerance, void *data, AlgoHLine proc)
 {
-#define MASKED(u, v)                                                    \
-        (mask &&                                                        \
-         (!mask->bounds().contains(u, v) ||                             \
-          (mask->bitmap() &&                                            \
-           !get_pixel_fast<BitmapTraits>(mask->bitmap(),                \
-                                         (u)-mask->bounds().x,          \
-                                         (v)-mask->bounds().y))))
-
   FLOODED_LINE *p;
   int left = 0, right = 0;
   int c;
@@ -160,93 +250,28 @@ static int flooder(const Image* image,
   switch (image->pixelFormat()) {
 
     case IMAGE_RGB:
-      {
-        uint32_t* address = reinterpret_cast<uint32_t*>(image->getPixelAddress(0, y));
-
-        // Check start pixel
-        if (!color_equal_32((int)*(address+x), src_color, tolerance) || MASKED(x, y))
-          return x+1;
-
-        // Work left from starting point
-        for (left=x-1; left>=bounds.x; left--) {
-          if (!color_equal_32((int)*(address+left), src_color, tolerance) || MASKED(left, y))
-            break;
-        }
-
-        // Work right from starting point
-        for (right=x+1; right<bounds.x2(); right++) {
-          if (!color_equal_32((int)*(address+right), src_color, tolerance) || MASKED(right, y))
-            break;
-        }
-      }
+      if (!find_flood_span<RgbTraits>(image, mask, x, y, bounds,
+                                      src_color, tolerance, left, right))
+        return x+1;
       break;
 
     case IMAGE_GRAYSCALE:
-      {
-        uint16_t* address = reinterpret_cast<uint16_t*>(image->getPixelAddress(0, y));
-
-        // Check start pixel
-        if (!color_equal_16((int)*(address+x), src_color, tolerance) || MASKED(x, y))
-          return x+1;
-
-        // Work left from starting point
-        for (left=x-1; left>=bounds.x; left--) {
-          if (!color_equal_16((int)*(address+left), src_color, tolerance) || MASKED(left, y))
-            break;
-        }
-
-        // Work right from starting point
-        for (right=x+1; right<bounds.x2(); right++) {
-          if (!color_equal_16((int)*(address+right), src_color, tolerance) || MASKED(right, y))
-            break;
-        }
-      }
+      if (!find_flood_span<GrayscaleTraits>(image, mask, x, y, bounds,
+                                            src_color, tolerance, left, right))
+        return x+1;
       break;
 
     case IMAGE_INDEXED:
-      {
-        uint8_t* address = image->getPixelAddress(0, y);
-
-        // Check start pixel
-        if (!color_equal_8((int)*(address+x), src_color, tolerance) || MASKED(x, y))
-          return x+1;
-
-        // Work left from starting point
-        for (left=x-1; left>=bounds.x; left--) {
-          if (!color_equal_8((int)*(address+left), src_color, tolerance) || MASKED(left, y))
-            break;
-        }
-
-        // Work right from starting point
-        for (right=x+1; right<bounds.x2(); right++) {
-          if (!color_equal_8((int)*(address+right), src_color, tolerance) || MASKED(right, y))
-            break;
-        }
-      }
+      if (!find_flood_span<IndexedTraits>(image, mask, x, y, bounds,
+                                          src_color, tolerance, left, right))
+        return x+1;
       break;
 
     case IMAGE_TILEMAP:
-      {
-        // TODO add support for mask
-
-        uint32_t* address = reinterpret_cast<uint32_t*>(image->getPixelAddress(0, y));
-
-        // Check start pixel
-        if (!color_equal_32_raw((int)*(address+x), src_color))
-          return x+1;
-
-        // Work left from starting point
-        for (left=x-1; left>=bounds.x; left--) {
-          if (!color_equal_32_raw((int)*(address+left), src_color))
-            break;
-        }
-
-        // Work right from starting point
-        for (right=x+1; right<bounds.x2(); right++) {
-          if (!color_equal_32_raw((int)*(address+right), src_color))
-            break;
-        }
-      }
+      // TODO add support for mask
+      if (!find_flood_span<TilemapTraits>(image, nullptr, x, y, bounds,
+                                          src_color, tolerance, left, right))
+        return x+1;
       break;
 
     default:
@@ -345,30 +370,73 @@ static int check_flood_line(const Image* image,
   return ret;
 }
 
+struct FloodSpan {
+  int x1, y, x2;
+};
+
+// Images with fewer pixels are not worth to be processed in threads.
+constexpr int kMinParallelPixels = 512*512;
+
 template<typename ImageTraits>
-static void replace_color(const Image* image, const gfx::Rect& bounds, int src_color, int tolerance, void* data, AlgoHLine proc)
+static void find_color_spans(const Image* image, const gfx::Rect& bounds,
+                             const ColorMatcher<ImageTraits>& match,
+                             std::vector<FloodSpan>& spans)
 {
-  typename ImageTraits::address_t address;
-
   for (int y=bounds.y; y<bounds.y2(); ++y) {
-    address = reinterpret_cast<typename ImageTraits::address_t>(image->getPixelAddress(bounds.x, y));
+    auto address = reinterpret_cast<typename ImageTraits::const_address_t>(
+      image->getPixelAddress(0, y));
 
-    for (int x=bounds.x; x<bounds.x2(); ++x, ++address) {
-      int right = -1;
+    int x = bounds.x;
+    while (x < bounds.x2()) {
+      x = find_span_end<ImageTraits>(address, x, bounds.x2(), match, false);
+      if (x == bounds.x2())
+        break;
 
-      if (color_equal<ImageTraits>((int)(*address), src_color, tolerance)) {
-        ++address;
-        for (right=x+1; right<bounds.x2(); ++right, ++address) {
-          if (!color_equal<ImageTraits>((int)(*address), src_color, tolerance))
-            break;
-        }
-        (*proc)(x, y, right-1, data);
-        x = right;
-      }
+      const int right = find_span_end<ImageTraits>(address, x+1, bounds.x2(), match, true);
+      spans.push_back(FloodSpan{ x, y, right-1 });
+      x = right;
     }
   }
 }
 
+template<typename ImageTraits>
+static void replace_color(const Image* image, const gfx::Rect& bounds, int src_color, int tolerance, void* data, AlgoHLine proc)
+{
+  const ColorMatcher<ImageTraits> match(src_color, tolerance);
+  const int nthreads =
+    (bounds.w*bounds.h >= kMinParallelPixels ?
+     std::clamp(int(std::thread::hardware_concurrency()), 1,
+                std::min(8, bounds.h)): 1);
+
+  // First we find the matching spans of each band of rows in
+  // parallel, then we call "proc" from this thread in the same order
+  // (as it's not thread-safe).
+  std::vector<std::vector<FloodSpan>> bands(nthreads);
+  if (nthreads > 1) {
+    std::vector<std::thread> threads;
+    threads.reserve(nthreads);
+    const int bandHeight = (bounds.h + nthreads - 1) / nthreads;
+    for (int i=0; i<nthreads; ++i) {
+      gfx::Rect band(bounds.x, bounds.y + i*bandHeight,
+                     bounds.w, bandHeight);
+      band &= bounds;
+      threads.emplace_back(
+        [image, band, &match, &spans = bands[i]]{
+          find_color_spans<ImageTraits>(image, band, match, spans);
+        });
+    }
+    for (auto& thread : threads)
+      thread.join();
+  }
+  else {
+    find_color_spans<ImageTraits>(image, bounds, match, bands[0]);
+  }
+
+  for (const auto& spans : bands)
+    for (const auto& span : spans)
+      (*proc)(span.x1, span.y, span.x2, data);
+}
+
 /* floodfill:
  *  Fills an enclosed area (starting at point x, y) with the specified color.
  */
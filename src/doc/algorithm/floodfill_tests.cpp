@@ -0,0 +1,154 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "gtest/gtest.h"
+
+#include "doc/algorithm/floodfill.h"
+#include "doc/image.h"
+#include "doc/image_ref.h"
+#include "doc/primitives.h"
+#include "gfx/rect.h"
+
+#include <cstdlib>
+#include <deque>
+#include <vector>
+
+using namespace doc;
+
+namespace {
+
+struct Filled {
+  int w;
+  std::vector<int> pixels;
+};
+
+void hline(int x1, int y, int x2, void* data)
+{
+  auto filled = (Filled*)data;
+  for (int x=x1; x<=x2; ++x)
+    ++filled->pixels[y*filled->w + x];
+}
+
+bool rgb_match(color_t c, color_t src, int tolerance)
+{
+  if (rgba_geta(c) == 0 && rgba_geta(src) == 0)
+    return true;
+  return (std::abs(rgba_getr(c) - rgba_getr(src)) <= tolerance &&
+          std::abs(rgba_getg(c) - rgba_getg(src)) <= tolerance &&
+          std::abs(rgba_getb(c) - rgba_getb(src)) <= tolerance &&
+          std::abs(rgba_geta(c) - rgba_geta(src)) <= tolerance);
+}
+
+// Reference flood fill (pixel by pixel)
+std::vector<int> reference_fill(const Image* image,
+                                const int x0, const int y0,
+                                const color_t src, const int tolerance,
+                                const bool contiguous,
+                                const bool eightConnected)
+{
+  const int w = image->width();
+  const int h = image->height();
+  std::vector<int> result(w*h, 0);
+
+  if (!contiguous) {
+    for (int y=0; y<h; ++y)
+      for (int x=0; x<w; ++x)
+        if (rgb_match(get_pixel(image, x, y), src, tolerance))
+          result[y*w + x] = 1;
+    return result;
+  }
+
+  std::deque<gfx::Point> queue;
+  if (rgb_match(get_pixel(image, x0, y0), src, tolerance)) {
+    result[y0*w + x0] = 1;
+    queue.push_back(gfx::Point(x0, y0));
+  }
+  while (!queue.empty()) {
+    const gfx::Point pt = queue.front();
+    queue.pop_front();
+    for (int v=-1; v<=1; ++v) {
+      for (int u=-1; u<=1; ++u) {
+        if ((u == 0 && v == 0) ||
+            (!eightConnected && u != 0 && v != 0))
+          continue;
+        const int x = pt.x+u;
+        const int y = pt.y+v;
+        if (x < 0 || y < 0 || x >= w || y >= h ||
+            result[y*w + x] ||
+            !rgb_match(get_pixel(image, x, y), src, tolerance))
+          continue;
+        result[y*w + x] = 1;
+        queue.push_back(gfx::Point(x, y));
+      }
+    }
+  }
+  return result;
+}
+
+ImageRef random_image(const int w, const int h, const int colors)
+{
+  std::srand(w*h + colors);
+  ImageRef image(Image::create(IMAGE_RGB, w, h));
+  for (int y=0; y<h; ++y) {
+    for (int x=0; x<w; ++x) {
+      const int i = std::rand() % colors;
+      put_pixel(image.get(), x, y,
+                rgba(i*10, i*5, 255-i*10, (i == 0 ? 0: 255)));
+    }
+  }
+  return image;
+}
+
+void test_fill(const Image* image, const int x, const int y,
+               const int tolerance, const bool contiguous,
+               const bool eightConnected)
+{
+  const color_t src = get_pixel(image, x, y);
+  Filled filled{ image->width(),
+                 std::vector<int>(image->width()*image->height(), 0) };
+  algorithm::floodfill(image, nullptr, x, y, image->bounds(),
+                       src, tolerance, contiguous, eightConnected,
+                       &filled, hline);
+
+  EXPECT_EQ(reference_fill(image, x, y, src, tolerance,
+                           contiguous, eightConnected),
+            filled.pixels)
+    << "tolerance=" << tolerance
+    << " contiguous=" << contiguous
+    << " eightConnected=" << eightConnected;
+}
+
+} // anonymous namespace
+
+TEST(FloodFill, Contiguous)
+{
+  ImageRef image = random_image(97, 61, 3);
+  for (int tolerance : { 0, 10, 60 }) {
+    test_fill(image.get(), 50, 30, tolerance, true, false);
+    test_fill(image.get(), 0, 0, tolerance, true, true);
+  }
+}
+
+TEST(FloodFill, LongSpans)
+{
+  ImageRef image(Image::create(IMAGE_RGB, 200, 40));
+  clear_image(image.get(), rgba(0, 0, 0, 255));
+  for (int y=0; y<40; y+=3)
+    for (int x=(y*7) % 200; x<200; x+=37)
+      put_pixel(image.get(), x, y, rgba(255, 0, 0, 255));
+
+  test_fill(image.get(), 100, 20, 0, true, false);
+  test_fill(image.get(), 100, 20, 0, true, true);
+  test_fill(image.get(), 1, 1, 0, false, false);
+}
+
+TEST(FloodFill, NonContiguousInBands)
+{
+  // Big enough to find the spans in several threads
+  ImageRef image = random_image(600, 600, 4);
+  for (int tolerance : { 0, 12 })
+    test_fill(image.get(), 10, 10, tolerance, false, false);
+}
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2021 Igara Studio S.A.
+// Copyright (c) 2021-2024 Igara Studio S.A.
 // Copyright (c) 2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -15,13 +15,131 @@
 #include "doc/mask.h"
 #include "doc/primitives.h"
 
-#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
 
 namespace doc {
 namespace algorithm {
 
+namespace {
+
+// Returns a w*h vector with 1 in each pixel that is at most "radius"
+// pixels away from a pixel where isFeature(x, y) is true (Euclidean
+// distance for a circle brush, Chebyshev distance for a square
+// brush).
+//
+// It's the linear-time distance transform of Meijster et al.: first
+// the vertical distance to the nearest feature of each column, then
+// the lower envelope of parabolas (circle) or a 1D dilation (square)
+// in each row. So the cost doesn't depend on the radius.
+template<typename IsFeature>
+std::vector<uint8_t> near_features(const int w, const int h,
+                                   const int radius,
+                                   const BrushType brush,
+                                   IsFeature isFeature)
+{
+  std::vector<uint8_t> result(std::size_t(w)*h, 0);
+  if (w <= 0 || h <= 0)
+    return result;
+
+  // Bigger than any possible distance inside the grid and than the
+  // radius (so columns without features are never near)
+  const int inf = w+h+radius+1;
+
+  // Vertical distance to the nearest feature in the same column (two
+  // sweeps, row by row to access memory sequentially).
+  std::vector<int> g(std::size_t(w)*h);
+  for (int y=0; y<h; ++y) {
+    int* row = &g[std::size_t(y)*w];
+    const int* prev = (y > 0 ? row-w: nullptr);
+    for (int x=0; x<w; ++x) {
+      if (isFeature(x, y))
+        row[x] = 0;
+      else
+        row[x] = (prev ? std::min(prev[x]+1, inf): inf);
+    }
+  }
+  for (int y=h-2; y>=0; --y) {
+    int* row = &g[std::size_t(y)*w];
+    const int* next = row+w;
+    for (int x=0; x<w; ++x)
+      row[x] = std::min(row[x], next[x]+1);
+  }
+
+  if (brush == kCircleBrushType) {
+    // The same shape as the brush ellipse drawn with fill_ellipse():
+    // a radius of 1 is a 4-connected cross (used by stroke_selection()
+    // to get a thin outline), bigger radii include the pixels inside
+    // a circle of radius+0.5.
+    const int64_t r2 = int64_t(radius)*radius + (radius > 1 ? radius: 0);
+
+    std::vector<int> s(w), t(w);
+    for (int y=0; y<h; ++y) {
+      const int* gy = &g[std::size_t(y)*w];
+      uint8_t* dst = &result[std::size_t(y)*w];
+
+      auto f = [gy](int64_t x, int i) -> int64_t {
+        return (x-i)*(x-i) + int64_t(gy[i])*gy[i];
+      };
+      auto sep = [gy](int64_t i, int64_t u) -> int64_t {
+        return (u*u - i*i + int64_t(gy[u])*gy[u] - int64_t(gy[i])*gy[i])
+          / (2*(u-i));
+      };
+
+      // Lower envelope of the parabolas of each column
+      int q = 0;
+      s[0] = t[0] = 0;
+      for (int u=1; u<w; ++u) {
+        while (q >= 0 && f(t[q], s[q]) > f(t[q], u))
+          --q;
+        if (q < 0) {
+          q = 0;
+          s[0] = u;
+        }
+        else {
+          const int64_t v = 1 + sep(s[q], u);
+          if (v < w) {
+            ++q;
+            s[q] = u;
+            t[q] = int(v);
+          }
+        }
+      }
+      for (int u=w-1; u>=0; --u) {
+        dst[u] = (f(u, s[q]) <= r2 ? 1: 0);
+        if (u == t[q])
+          --q;
+      }
+    }
+  }
+  else {
+    // A square brush is separable: dilate each row with the columns
+    // that have a feature at most "radius" pixels away vertically.
+    for (int y=0; y<h; ++y) {
+      const int* gy = &g[std::size_t(y)*w];
+      uint8_t* dst = &result[std::size_t(y)*w];
+
+      int d = inf;
+      for (int x=0; x<w; ++x) {
+        d = (gy[x] <= radius ? 0: std::min(d+1, inf));
+        dst[x] = (d <= radius ? 1: 0);
+      }
+      d = inf;
+      for (int x=w-1; x>=0; --x) {
+        d = (gy[x] <= radius ? 0: std::min(d+1, inf));
+        if (d <= radius)
+          dst[x] = 1;
+      }
+    }
+  }
+
+  return result;
+}
+
+} // anonymous namespace
+
 // TODO create morphological operators/functions in "doc" namespace
-// TODO the impl is not optimal, but is good enough as a first version
 void modify_selection(const SelectionModifier modifier,
                       const Mask* srcMask,
                       Mask* dstMask,
@@ -34,61 +152,62 @@ void modify_selection(const SelectionModifier modifier,
     srcMask->bounds().origin() -
     dstMask->bounds().origin();
 
-  // Image bounds to clip get/put pixels
-  const gfx::Rect srcBounds = srcImage->bounds();
-
-  // Create a kernel
-  const int size = 2*radius+1;
-  std::unique_ptr<doc::Image> kernel(doc::Image::create(IMAGE_BITMAP, size, size));
-  doc::clear_image(kernel.get(), 0);
-  if (brush == doc::kCircleBrushType)
-    doc::fill_ellipse(kernel.get(), 0, 0, size-1, size-1, 0, 0, 1);
-  else
-    doc::fill_rect(kernel.get(), 0, 0, size-1, size-1, 1);
-  doc::put_pixel(kernel.get(), radius, radius, 0);
-
-  int total = 0;                // Number of 1s in the kernel image
-  for (int v=0; v<size; ++v)
-    for (int u=0; u<size; ++u)
-      total += kernel->getPixel(u, v);
-
-  for (int y=-radius; y<srcBounds.h+radius; ++y) {
-    for (int x=-radius; x<srcBounds.w+radius; ++x) {
-      doc::color_t c;
-      if (srcBounds.contains(x, y))
-        c = srcImage->getPixel(x, y);
-      else
-        c = 0;
-
-      int accum = 0;
-      for (int v=0; v<size; ++v) {
-        for (int u=0; u<size; ++u) {
-          if (kernel->getPixel(u, v)) {
-            if (srcBounds.contains(x+u-radius, y+v-radius))
-              accum += srcImage->getPixel(x-radius+u, y-radius+v);
-          }
+  const int w = srcImage->width();
+  const int h = srcImage->height();
+  auto isSelected = [srcImage, w, h](const int x, const int y) -> bool {
+    return (x >= 0 && y >= 0 && x < w && y < h &&
+            get_pixel_fast<BitmapTraits>(srcImage, x, y));
+  };
+
+  switch (modifier) {
+
+    case SelectionModifier::Expand: {
+      // Pixels at most "radius" pixels away from the selection (the
+      // grid is bigger than the source mask to include the expansion)
+      const int gw = w+2*radius;
+      const int gh = h+2*radius;
+      const std::vector<uint8_t> near = near_features(
+        gw, gh, radius, brush,
+        [&isSelected, radius](const int x, const int y) {
+          return isSelected(x-radius, y-radius);
+        });
+
+      for (int y=0; y<gh; ++y) {
+        const uint8_t* row = &near[std::size_t(y)*gw];
+        for (int x=0; x<gw; ++x) {
+          if (row[x])
+            doc::put_pixel(dstImage,
+                           offset.x+x-radius,
+                           offset.y+y-radius, 1);
         }
       }
+      break;
+    }
 
-      switch (modifier) {
-        case SelectionModifier::Border: {
-          c = (c && accum < total) ? 1: 0;
-          break;
-        }
-        case SelectionModifier::Expand: {
-          c = (c || accum > 0) ? 1: 0;
-          break;
-        }
-        case SelectionModifier::Contract: {
-          c = (c && accum == total) ? 1: 0;
-          break;
+    case SelectionModifier::Border:
+    case SelectionModifier::Contract: {
+      // Selected pixels at most "radius" pixels away from a
+      // non-selected pixel (pixels outside the source mask are
+      // non-selected, a 1 pixel margin is enough to include them).
+      const int gw = w+2;
+      const int gh = h+2;
+      const std::vector<uint8_t> near = near_features(
+        gw, gh, radius, brush,
+        [&isSelected](const int x, const int y) {
+          return !isSelected(x-1, y-1);
+        });
+
+      const bool border = (modifier == SelectionModifier::Border);
+      for (int y=0; y<h; ++y) {
+        const uint8_t* row = &near[std::size_t(y+1)*gw + 1];
+        for (int x=0; x<w; ++x) {
+          if (isSelected(x, y) && (row[x] != 0) == border)
+            doc::put_pixel(dstImage,
+                           offset.x+x,
+                           offset.y+y, 1);
         }
       }
-
-      if (c)
-        doc::put_pixel(dstImage,
-                       offset.x+x,
-                       offset.y+y, 1);
+      break;
     }
   }
 }
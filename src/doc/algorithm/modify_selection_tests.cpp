@@ -0,0 +1,108 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "gtest/gtest.h"
+
+#include "doc/algorithm/modify_selection.h"
+#include "doc/image.h"
+#include "doc/mask.h"
+
+#include <cstdlib>
+
+using namespace doc;
+using namespace doc::algorithm;
+using namespace gfx;
+
+namespace {
+
+// Brute force version of modify_selection() to compare results
+bool expected_pixel(const SelectionModifier modifier,
+                    const Mask& src, const int radius,
+                    const BrushType brush,
+                    const int x, const int y)
+{
+  const int r2 = radius*radius + (radius > 1 ? radius: 0);
+  bool selected = src.containsPoint(x, y);
+  bool nearSelected = false;
+  bool nearUnselected = false;
+  for (int v=-radius; v<=radius; ++v) {
+    for (int u=-radius; u<=radius; ++u) {
+      if (brush == kCircleBrushType && u*u+v*v > r2)
+        continue;
+      if (src.containsPoint(x+u, y+v))
+        nearSelected = true;
+      else
+        nearUnselected = true;
+    }
+  }
+  switch (modifier) {
+    case SelectionModifier::Expand: return nearSelected;
+    case SelectionModifier::Contract: return selected && !nearUnselected;
+    case SelectionModifier::Border: return selected && nearUnselected;
+  }
+  return false;
+}
+
+void test_modify_selection(const SelectionModifier modifier,
+                           const Mask& src, const int radius,
+                           const BrushType brush)
+{
+  const Rect bounds = Rect(src.bounds()).enlarge(radius+1);
+  Mask dst;
+  dst.reserve(bounds);
+  dst.freeze();
+  modify_selection(modifier, &src, &dst, radius, brush);
+  dst.unfreeze();
+
+  for (int y=bounds.y; y<bounds.y2(); ++y) {
+    for (int x=bounds.x; x<bounds.x2(); ++x) {
+      ASSERT_EQ(expected_pixel(modifier, src, radius, brush, x, y),
+                dst.containsPoint(x, y))
+        << "modifier=" << int(modifier) << " radius=" << radius
+        << " brush=" << int(brush) << " x=" << x << " y=" << y;
+    }
+  }
+}
+
+} // anonymous namespace
+
+TEST(ModifySelection, BorderOfRadiusOneIsFourConnected)
+{
+  Mask src;
+  src.replace(Rect(2, 3, 4, 4));
+
+  Mask dst;
+  dst.reserve(Rect(0, 0, 10, 10));
+  dst.freeze();
+  modify_selection(SelectionModifier::Border, &src, &dst, 1, kCircleBrushType);
+  dst.unfreeze();
+
+  EXPECT_EQ(Rect(2, 3, 4, 4), dst.bounds());
+  EXPECT_TRUE(dst.containsPoint(2, 3));
+  EXPECT_TRUE(dst.containsPoint(5, 6));
+  EXPECT_FALSE(dst.containsPoint(3, 4));
+  EXPECT_FALSE(dst.containsPoint(4, 5));
+}
+
+TEST(ModifySelection, CompareWithBruteForce)
+{
+  std::srand(1);
+  for (int i=0; i<20; ++i) {
+    Mask src;
+    src.replace(Rect(3, 5, 1, 1));
+    for (int j=0; j<8; ++j)
+      src.add(Rect(std::rand() % 30, std::rand() % 30,
+                   1 + std::rand() % 10, 1 + std::rand() % 10));
+
+    for (int radius : { 0, 1, 2, 5, 9 }) {
+      for (BrushType brush : { kCircleBrushType, kSquareBrushType }) {
+        test_modify_selection(SelectionModifier::Expand, src, radius, brush);
+        test_modify_selection(SelectionModifier::Contract, src, radius, brush);
+        test_modify_selection(SelectionModifier::Border, src, radius, brush);
+      }
+    }
+  }
+}
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019  Igara Studio S.A.
+// Copyright (c) 2019-2024  Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -18,28 +18,175 @@
 #include "doc/rgbmap.h"
 #include "gfx/point.h"
 
+#include <algorithm>
 #include <cmath>
+#include <thread>
+#include <vector>
 
 namespace doc {
 namespace algorithm {
 
+// Images with fewer pixels are not worth to be processed in threads.
+constexpr int kMinParallelPixels = 256*256;
+
+// Calls "func(y1, y2)" for bands of rows of an image of the given
+// size, in several threads if the image is big enough. Each thread
+// writes only its own rows of the destination image.
+template<typename Func>
+static void for_each_row_band(const int w, const int h,
+                              const bool parallel,
+                              Func&& func)
+{
+  const int nthreads =
+    (parallel && w*h >= kMinParallelPixels ?
+     std::clamp(int(std::thread::hardware_concurrency()), 1,
+                std::min(8, h)): 1);
+  if (nthreads > 1) {
+    std::vector<std::thread> threads;
+    threads.reserve(nthreads);
+    const int bandHeight = (h + nthreads - 1) / nthreads;
+    for (int i=0; i<nthreads; ++i) {
+      const int y1 = std::min(h, i*bandHeight);
+      const int y2 = std::min(h, y1+bandHeight);
+      threads.emplace_back([&func, y1, y2]{ func(y1, y2); });
+    }
+    for (auto& thread : threads)
+      thread.join();
+  }
+  else {
+    func(0, h);
+  }
+}
+
 template<typename ImageTraits>
-void resize_image_nearest(const Image* src, Image* dst)
+static void resize_image_nearest(const Image* src, Image* dst)
 {
-  double x_ratio = double(src->width()) / double(dst->width());
-  double y_ratio = double(src->height()) / double(dst->height());
-  double px, py;
-
-  LockImageBits<ImageTraits> dstBits(dst);
-  auto dstIt = dstBits.begin();
-
-  for (int y=0; y<dst->height(); ++y) {
-    py = std::floor(y * y_ratio);
-    for (int x=0; x<dst->width(); ++x, ++dstIt) {
-      px = std::floor(x * x_ratio);
-      *dstIt = get_pixel_fast<ImageTraits>(src, int(px), int(py));
+  using pixel_t = typename ImageTraits::pixel_t;
+
+  const int dst_w = dst->width();
+  const double x_ratio = double(src->width()) / double(dst_w);
+  const double y_ratio = double(src->height()) / double(dst->height());
+
+  // Source column of each destination column
+  std::vector<int> xs(dst_w);
+  for (int x=0; x<dst_w; ++x)
+    xs[x] = int(std::floor(x * x_ratio));
+
+  for_each_row_band(
+    dst_w, dst->height(), true,
+    [&](const int y1, const int y2) {
+      int prev_py = -1;
+      for (int y=y1; y<y2; ++y) {
+        const int py = int(std::floor(y * y_ratio));
+        auto dstRow = (pixel_t*)dst->getPixelAddress(0, y);
+
+        // Same source row, just copy the previous destination row
+        if (py == prev_py) {
+          std::copy(dstRow - dst->rowPixels(),
+                    dstRow - dst->rowPixels() + dst_w,
+                    dstRow);
+          continue;
+        }
+        prev_py = py;
+
+        auto srcRow = (const pixel_t*)src->getPixelAddress(0, py);
+        for (int x=0; x<dst_w; ++x)
+          dstRow[x] = srcRow[xs[x]];
+      }
+    });
+}
+
+// Bitmaps use 1 bit per pixel
+template<>
+void resize_image_nearest<BitmapTraits>(const Image* src, Image* dst)
+{
+  const double x_ratio = double(src->width()) / double(dst->width());
+  const double y_ratio = double(src->height()) / double(dst->height());
+
+  for_each_row_band(
+    dst->width(), dst->height(), true,
+    [&](const int y1, const int y2) {
+      for (int y=y1; y<y2; ++y) {
+        const int py = int(std::floor(y * y_ratio));
+        for (int x=0; x<dst->width(); ++x) {
+          const int px = int(std::floor(x * x_ratio));
+          put_pixel_fast<BitmapTraits>(
+            dst, x, y, get_pixel_fast<BitmapTraits>(src, px, py));
+        }
+      }
+    });
+}
+
+// Bilinear interpolation of the 4 colors with weights u1/v1 for the
+// second column/row.
+static inline int lerp2(const int c0, const int c1,
+                        const int c2, const int c3,
+                        const double u1, const double v1)
+{
+  const double u2 = 1 - u1;
+  const double v2 = 1 - v1;
+  return int((c0*u2 + c1*u1)*v2 +
+             (c2*u2 + c3*u1)*v1);
+}
+
+// Source coordinates for the bilinear interpolation of each
+// destination column or row. The coordinates are accumulated in the
+// same way as the original (sequential) algorithm to get the exact
+// same results.
+struct BilinearCoords {
+  int floor1, floor2;
+  double t;                     // Weight of floor2
+};
+
+static std::vector<BilinearCoords> calc_bilinear_coords(const int srcSize,
+                                                        const int dstSize)
+{
+  std::vector<BilinearCoords> coords(dstSize);
+  const double d = (srcSize-1) * 1.0 / (dstSize-1);
+  double u = 0.0;
+  for (int i=0; i<dstSize; ++i, u+=d) {
+    BilinearCoords& c = coords[i];
+    c.floor1 = (int)std::floor(u);
+    if (c.floor1 > srcSize-1) {
+      c.floor1 = srcSize-1;
+      c.floor2 = srcSize-1;
     }
+    else if (c.floor1 == srcSize-1)
+      c.floor2 = c.floor1;
+    else
+      c.floor2 = c.floor1+1;
+    c.t = u - c.floor1;
   }
+  return coords;
+}
+
+template<typename ImageTraits, typename MapColor>
+static void resize_image_bilinear(const Image* src, Image* dst,
+                                  const bool parallel,
+                                  MapColor&& mapColor)
+{
+  using pixel_t = typename ImageTraits::pixel_t;
+
+  const auto xs = calc_bilinear_coords(src->width(), dst->width());
+  const auto ys = calc_bilinear_coords(src->height(), dst->height());
+
+  for_each_row_band(
+    dst->width(), dst->height(), parallel,
+    [&](const int y1, const int y2) {
+      for (int y=y1; y<y2; ++y) {
+        const BilinearCoords& v = ys[y];
+        auto srcRow1 = (const pixel_t*)src->getPixelAddress(0, v.floor1);
+        auto srcRow2 = (const pixel_t*)src->getPixelAddress(0, v.floor2);
+        auto dstRow = (pixel_t*)dst->getPixelAddress(0, y);
+
+        for (int x=0; x<dst->width(); ++x) {
+          const BilinearCoords& u = xs[x];
+          dstRow[x] = mapColor(srcRow1[u.floor1], srcRow1[u.floor2],
+                               srcRow2[u.floor1], srcRow2[u.floor2],
+                               u.t, v.t);
+        }
+      }
+    });
 }
 
 void resize_image(const Image* src,
@@ -51,7 +198,6 @@ void resize_image(const Image* src,
 {
   switch (method) {
 
-    // TODO optimize this
     case RESIZE_METHOD_NEAREST_NEIGHBOR: {
       ASSERT(src->pixelFormat() == dst->pixelFormat());
 
@@ -64,18 +210,12 @@ void resize_image(const Image* src,
       break;
     }
 
-    // TODO optimize this
     case RESIZE_METHOD_BILINEAR: {
-      uint32_t color[4], dst_color = 0;
-      double u, v, du, dv;
-      int u_floor, u_floor2;
-      int v_floor, v_floor2;
-      int x, y;
-
       // We cannot do interpolations between RGB values on indexed
-      // images without a palette/rgbmap.
-      if (dst->pixelFormat() == IMAGE_INDEXED &&
-          (!pal || !rgbmap)) {
+      // images without a palette/rgbmap (or on bitmaps).
+      if ((dst->pixelFormat() == IMAGE_INDEXED &&
+           (!pal || !rgbmap)) ||
+          dst->pixelFormat() == IMAGE_BITMAP) {
         resize_image(
           src, dst,
           RESIZE_METHOD_NEAREST_NEIGHBOR,
@@ -83,92 +223,54 @@ void resize_image(const Image* src,
         return;
       }
 
-      u = v = 0.0;
-      du = (src->width()-1) * 1.0 / (dst->width()-1);
-      dv = (src->height()-1) * 1.0 / (dst->height()-1);
-      for (y=0; y<dst->height(); ++y) {
-        for (x=0; x<dst->width(); ++x) {
-          u_floor = (int)std::floor(u);
-          v_floor = (int)std::floor(v);
-
-          if (u_floor > src->width()-1) {
-            u_floor = src->width()-1;
-            u_floor2 = src->width()-1;
-          }
-          else if (u_floor == src->width()-1)
-            u_floor2 = u_floor;
-          else
-            u_floor2 = u_floor+1;
-
-          if (v_floor > src->height()-1) {
-            v_floor = src->height()-1;
-            v_floor2 = src->height()-1;
-          }
-          else if (v_floor == src->height()-1)
-            v_floor2 = v_floor;
-          else
-            v_floor2 = v_floor+1;
-
-          // get the four colors
-          color[0] = src->getPixel(u_floor,  v_floor);
-          color[1] = src->getPixel(u_floor2, v_floor);
-          color[2] = src->getPixel(u_floor,  v_floor2);
-          color[3] = src->getPixel(u_floor2, v_floor2);
-
-          // calculate the interpolated color
-          double u1 = u - u_floor;
-          double v1 = v - v_floor;
-          double u2 = 1 - u1;
-          double v2 = 1 - v1;
-
-          switch (dst->pixelFormat()) {
-            case IMAGE_RGB: {
-              int r = int((rgba_getr(color[0])*u2 + rgba_getr(color[1])*u1)*v2 +
-                          (rgba_getr(color[2])*u2 + rgba_getr(color[3])*u1)*v1);
-              int g = int((rgba_getg(color[0])*u2 + rgba_getg(color[1])*u1)*v2 +
-                          (rgba_getg(color[2])*u2 + rgba_getg(color[3])*u1)*v1);
-              int b = int((rgba_getb(color[0])*u2 + rgba_getb(color[1])*u1)*v2 +
-                          (rgba_getb(color[2])*u2 + rgba_getb(color[3])*u1)*v1);
-              int a = int((rgba_geta(color[0])*u2 + rgba_geta(color[1])*u1)*v2 +
-                          (rgba_geta(color[2])*u2 + rgba_geta(color[3])*u1)*v1);
-              dst_color = rgba(r, g, b, a);
-              break;
-            }
-            case IMAGE_GRAYSCALE: {
-              int v = int((graya_getv(color[0])*u2 + graya_getv(color[1])*u1)*v2 +
-                          (graya_getv(color[2])*u2 + graya_getv(color[3])*u1)*v1);
-              int a = int((graya_geta(color[0])*u2 + graya_geta(color[1])*u1)*v2 +
-                          (graya_geta(color[2])*u2 + graya_geta(color[3])*u1)*v1);
-              dst_color = graya(v, a);
-              break;
-            }
-            case IMAGE_INDEXED: {
-              // Convert index to RGBA values
-              for (int i=0; i<4; ++i) {
-                if (color[i] == maskColor)
-                  color[i] = pal->getEntry(color[i]) & rgba_rgb_mask; // Set alpha = 0
-                else
-                  color[i] = pal->getEntry(color[i]);
-              }
-
-              int r = int((rgba_getr(color[0])*u2 + rgba_getr(color[1])*u1)*v2 +
-                          (rgba_getr(color[2])*u2 + rgba_getr(color[3])*u1)*v1);
-              int g = int((rgba_getg(color[0])*u2 + rgba_getg(color[1])*u1)*v2 +
-                          (rgba_getg(color[2])*u2 + rgba_getg(color[3])*u1)*v1);
-              int b = int((rgba_getb(color[0])*u2 + rgba_getb(color[1])*u1)*v2 +
-                          (rgba_getb(color[2])*u2 + rgba_getb(color[3])*u1)*v1);
-              int a = int((rgba_geta(color[0])*u2 + rgba_geta(color[1])*u1)*v2 +
-                          (rgba_geta(color[2])*u2 + rgba_geta(color[3])*u1)*v1);
-              dst_color = rgbmap->mapColor(r, g, b, a);
-              break;
-            }
-          }
-
-          dst->putPixel(x, y, dst_color);
-          u += du;
-        }
-        u = 0.0;
-        v += dv;
+      switch (dst->pixelFormat()) {
+        case IMAGE_RGB:
+          resize_image_bilinear<RgbTraits>(
+            src, dst, true,
+            [](color_t c0, color_t c1, color_t c2, color_t c3,
+               double u1, double v1) -> color_t {
+              return rgba(
+                lerp2(rgba_getr(c0), rgba_getr(c1), rgba_getr(c2), rgba_getr(c3), u1, v1),
+                lerp2(rgba_getg(c0), rgba_getg(c1), rgba_getg(c2), rgba_getg(c3), u1, v1),
+                lerp2(rgba_getb(c0), rgba_getb(c1), rgba_getb(c2), rgba_getb(c3), u1, v1),
+                lerp2(rgba_geta(c0), rgba_geta(c1), rgba_geta(c2), rgba_geta(c3), u1, v1));
+            });
+          break;
+
+        case IMAGE_GRAYSCALE:
+          resize_image_bilinear<GrayscaleTraits>(
+            src, dst, true,
+            [](color_t c0, color_t c1, color_t c2, color_t c3,
+               double u1, double v1) -> uint16_t {
+              return graya(
+                lerp2(graya_getv(c0), graya_getv(c1), graya_getv(c2), graya_getv(c3), u1, v1),
+                lerp2(graya_geta(c0), graya_geta(c1), graya_geta(c2), graya_geta(c3), u1, v1));
+            });
+          break;
+
+        // Indexed images are resized in one thread because the
+        // RgbMap is not thread-safe (it can be filled lazily)
+        case IMAGE_INDEXED:
+          resize_image_bilinear<IndexedTraits>(
+            src, dst, false,
+            [pal, rgbmap, maskColor](color_t c0, color_t c1, color_t c2, color_t c3,
+                                     double u1, double v1) -> uint8_t {
+              // Convert index to RGBA values (alpha = 0 for the mask color)
+              auto toRgba = [pal, maskColor](color_t i) -> color_t {
+                return (i == maskColor ? pal->getEntry(i) & rgba_rgb_mask:
+                                         pal->getEntry(i));
+              };
+              c0 = toRgba(c0);
+              c1 = toRgba(c1);
+              c2 = toRgba(c2);
+              c3 = toRgba(c3);
+              return rgbmap->mapColor(
+                lerp2(rgba_getr(c0), rgba_getr(c1), rgba_getr(c2), rgba_getr(c3), u1, v1),
+                lerp2(rgba_getg(c0), rgba_getg(c1), rgba_getg(c2), rgba_getg(c3), u1, v1),
+                lerp2(rgba_getb(c0), rgba_getb(c1), rgba_getb(c2), rgba_getb(c3), u1, v1),
+                lerp2(rgba_geta(c0), rgba_geta(c1), rgba_geta(c2), rgba_geta(c3), u1, v1));
+            });
+          break;
       }
       break;
     }
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2020-2023  Igara Studio S.A.
+// Copyright (c) 2020-2024  Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -9,22 +9,31 @@
 #include "config.h"
 #endif
 
+#include "doc/algorithm/rotsprite.h"
+
+#include "base/task.h"
 #include "doc/algorithm/rotate.h"
 #include "doc/image_impl.h"
 #include "doc/primitives.h"
 
 #include <algorithm>
 #include <memory>
+#include <thread>
+#include <vector>
 
 namespace doc {
 namespace algorithm {
 
+// Images with fewer pixels are not worth to be processed in threads.
+constexpr int kMinParallelPixels = 256*256;
+
 // More information about EPX/Scale2x:
 // http://en.wikipedia.org/wiki/Pixel_art_scaling_algorithms#EPX.2FScale2.C3.97.2FAdvMAME2.C3.97
 // http://scale2x.sourceforge.net/algorithm.html
 // http://scale2x.sourceforge.net/scale2xandepx.html
 template<typename ImageTraits>
-static void image_scale2x_tpl(Image* dst, const Image* src, int src_w, int src_h)
+static void image_scale2x_tpl(Image* dst, const Image* src, int src_w, int src_h,
+                              base::task_token* token)
 {
 #if 0      // TODO complete this implementation that should be faster
            // than using a lot of get/put_pixel_fast calls.
@@ -124,51 +133,78 @@ static void image_scale2x_tpl(Image* dst, const Image* src, int src_w, int src_h
 #define D c[3]
 #define P c[4]
 
-  LockImageBits<ImageTraits> dstBits(dst, gfx::Rect(0, 0, src_w*2, src_h*2));
-  auto dstIt = dstBits.begin();
-  auto dstIt2 = dstIt;
-
-  color_t c[5];
-  for (int y=0; y<src_h; ++y) {
-    dstIt2 += src_w*2;
-    for (int x=0; x<src_w; ++x) {
-      P = get_pixel_fast<ImageTraits>(src, x, y);
-      A = (y > 0 ? get_pixel_fast<ImageTraits>(src, x, y-1): P);
-      B = (x < src_w-1 ? get_pixel_fast<ImageTraits>(src, x+1, y): P);
-      C = (x > 0 ? get_pixel_fast<ImageTraits>(src, x-1, y): P);
-      D = (y < src_h-1 ? get_pixel_fast<ImageTraits>(src, x, y+1): P);
-
-      *dstIt = (C == A && C != D && A != B ? A: P);
-      ++dstIt;
-      *dstIt = (A == B && A != C && B != D ? B: P);
-      ++dstIt;
-
-      *dstIt2 = (D == C && D != B && C != A ? C: P);
-      ++dstIt2;
-      *dstIt2 = (B == D && B != A && D != C ? D: P);
-      ++dstIt2;
+  // Each band of source rows is converted to a different band of
+  // destination rows, so bands can be processed in parallel.
+  auto scale_rows =
+    [dst, src, src_w, src_h, token](const int y1, const int y2) {
+      color_t c[5];
+      for (int y=y1; y<y2; ++y) {
+        if (token && token->canceled())
+          return;
+
+        for (int x=0; x<src_w; ++x) {
+          P = get_pixel_fast<ImageTraits>(src, x, y);
+          A = (y > 0 ? get_pixel_fast<ImageTraits>(src, x, y-1): P);
+          B = (x < src_w-1 ? get_pixel_fast<ImageTraits>(src, x+1, y): P);
+          C = (x > 0 ? get_pixel_fast<ImageTraits>(src, x-1, y): P);
+          D = (y < src_h-1 ? get_pixel_fast<ImageTraits>(src, x, y+1): P);
+
+          put_pixel_fast<ImageTraits>(dst, 2*x,   2*y,   (C == A && C != D && A != B ? A: P));
+          put_pixel_fast<ImageTraits>(dst, 2*x+1, 2*y,   (A == B && A != C && B != D ? B: P));
+          put_pixel_fast<ImageTraits>(dst, 2*x,   2*y+1, (D == C && D != B && C != A ? C: P));
+          put_pixel_fast<ImageTraits>(dst, 2*x+1, 2*y+1, (B == D && B != A && D != C ? D: P));
+        }
+      }
+    };
+
+  const int nthreads =
+    (src_w*src_h >= kMinParallelPixels ?
+     std::clamp(int(std::thread::hardware_concurrency()), 1,
+                std::min(8, src_h)): 1);
+  if (nthreads > 1) {
+    std::vector<std::thread> threads;
+    threads.reserve(nthreads);
+    const int bandHeight = (src_h + nthreads - 1) / nthreads;
+    for (int i=0; i<nthreads; ++i) {
+      const int y1 = std::min(src_h, i*bandHeight);
+      const int y2 = std::min(src_h, y1+bandHeight);
+      threads.emplace_back([&scale_rows, y1, y2]{ scale_rows(y1, y2); });
     }
-    dstIt += src_w*2;
+    for (auto& thread : threads)
+      thread.join();
+  }
+  else {
+    scale_rows(0, src_h);
   }
 
+#undef A
+#undef B
+#undef C
+#undef D
+#undef P
+
 #endif
 }
 
-static void image_scale2x(Image* dst, const Image* src, int src_w, int src_h)
+static void image_scale2x(Image* dst, const Image* src, int src_w, int src_h,
+                          base::task_token* token)
 {
   switch (src->pixelFormat()) {
-    case IMAGE_RGB:       image_scale2x_tpl<RgbTraits>(dst, src, src_w, src_h); break;
-    case IMAGE_GRAYSCALE: image_scale2x_tpl<GrayscaleTraits>(dst, src, src_w, src_h); break;
-    case IMAGE_INDEXED:   image_scale2x_tpl<IndexedTraits>(dst, src, src_w, src_h); break;
-    case IMAGE_BITMAP:    image_scale2x_tpl<BitmapTraits>(dst, src, src_w, src_h); break;
+    case IMAGE_RGB:       image_scale2x_tpl<RgbTraits>(dst, src, src_w, src_h, token); break;
+    case IMAGE_GRAYSCALE: image_scale2x_tpl<GrayscaleTraits>(dst, src, src_w, src_h, token); break;
+    case IMAGE_INDEXED:   image_scale2x_tpl<IndexedTraits>(dst, src, src_w, src_h, token); break;
+    case IMAGE_BITMAP:    image_scale2x_tpl<BitmapTraits>(dst, src, src_w, src_h, token); break;
   }
 }
 
 void rotsprite_image(Image* bmp, const Image* spr, const Image* mask,
   int x1, int y1, int x2, int y2,
-  int x3, int y3, int x4, int y4)
+  int x3, int y3, int x4, int y4,
+  base::task_token* token)
 {
-  static ImageBufferPtr buf[3]; // TODO non-thread safe
+  // One set of buffers for each thread (as RotSprite can be used
+  // from background tasks)
+  static thread_local ImageBufferPtr buf[3];
 
   for (int i=0; i<3; ++i)
     if (!buf[i])
@@ -201,7 +237,9 @@ void rotsprite_image(Image* bmp, const Image* spr, const Image* mask,
 
   for (int i=0; i<3; ++i) {
     // clear_image(tmp_copy, maskColor);
-    image_scale2x(tmp_copy.get(), spr_copy.get(), spr->width()*(1<<i), spr->height()*(1<<i));
+    image_scale2x(tmp_copy.get(), spr_copy.get(), spr->width()*(1<<i), spr->height()*(1<<i), token);
+    if (token && token->canceled())
+      return;
     spr_copy->copy(tmp_copy.get(), gfx::Clip(tmp_copy->bounds()));
   }
 
@@ -219,6 +257,8 @@ void rotsprite_image(Image* bmp, const Image* spr, const Image* mask,
     bmp_copy.get(), spr_copy.get(), msk_copy.get(),
     (x1-xmin)*scale, (y1-ymin)*scale, (x2-xmin)*scale, (y2-ymin)*scale,
     (x3-xmin)*scale, (y3-ymin)*scale, (x4-xmin)*scale, (y4-ymin)*scale);
+  if (token && token->canceled())
+    return;
 
   scale_image(bmp, bmp_copy.get(),
               std::max(0, xmin),
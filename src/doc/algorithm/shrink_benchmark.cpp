@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -12,6 +12,7 @@
 
 #include "doc/color.h"
 #include "doc/image.h"
+#include "doc/primitives.h"
 
 #include <benchmark/benchmark.h>
 #include <memory>
@@ -31,6 +32,18 @@ void BM_ShrinkBounds(benchmark::State& state) {
   }
 }
 
+void BM_IsPlainImage(benchmark::State& state) {
+  const PixelFormat pixelFormat = (PixelFormat)state.range(0);
+  const int w = state.range(1);
+  const int h = state.range(2);
+
+  std::unique_ptr<Image> img(Image::create(pixelFormat, w, h));
+  img->clear(0);
+  while (state.KeepRunning()) {
+    doc::is_plain_image(img.get(), 0);
+  }
+}
+
 #define DEFARGS(MODE)                      \
   ->Args({ MODE, 100, 100 })               \
   ->Args({ MODE, 200, 200 })               \
@@ -56,4 +69,11 @@ BENCHMARK(BM_ShrinkBounds)
   ->Unit(benchmark::kMicrosecond)
   ->UseRealTime();
 
+BENCHMARK(BM_IsPlainImage)
+  DEFARGS(IMAGE_RGB)
+  DEFARGS(IMAGE_GRAYSCALE)
+  DEFARGS(IMAGE_INDEXED)
+  ->Unit(benchmark::kMicrosecond)
+  ->UseRealTime();
+
 BENCHMARK_MAIN();
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019-2023 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -19,9 +19,13 @@
 #include "doc/layer_tilemap.h"
 #include "doc/primitives.h"
 #include "doc/primitives_fast.h"
+#include "doc/scan_row.h"
 #include "doc/tileset.h"
 
+#include <algorithm>
 #include <thread>
+#include <type_traits>
+#include <vector>
 
 namespace doc {
 namespace algorithm {
@@ -59,9 +63,112 @@ bool is_same_pixel<BitmapTraits>(color_t pixel1, color_t pixel2)
   return pixel1 == pixel2;
 }
 
+// Rows are scanned with scan_row_first/last_diff() to skip quickly
+// the pixels that are bitwise equal to the reference pixel (big empty
+// areas), and only the different ones are compared with
+// is_same_pixel() (e.g. transparent pixels with different RGB values).
+template<typename ImageTraits>
+class RefRow {
+public:
+  using pixel_t = typename ImageTraits::pixel_t;
+
+  RefRow(const color_t refpixel)
+    : m_refpixel(pixel_t(refpixel)) {
+  }
+
+  // Returns the index of the first pixel in ptr[0,n) that is not
+  // equal to the reference pixel, or n if all pixels are equal.
+  int findFirstDiff(const pixel_t* ptr, const int n) const {
+    for (int i=0; ; ++i) {
+      i += scan_row_first_diff(ptr+i, n-i, m_refpixel);
+      if (i >= n)
+        return n;
+      if (!is_same_pixel<ImageTraits>(ptr[i], m_refpixel))
+        return i;
+    }
+  }
+
+  // Returns the index of the last pixel in ptr[0,n) that is not
+  // equal to the reference pixel, or -1 if all pixels are equal.
+  int findLastDiff(const pixel_t* ptr, const int n) const {
+    for (int i=n; ; ) {
+      i = scan_row_last_diff(ptr, i, m_refpixel);
+      if (i < 0)
+        return -1;
+      if (!is_same_pixel<ImageTraits>(ptr[i], m_refpixel))
+        return i;
+    }
+  }
+
+private:
+  pixel_t m_refpixel;
+};
+
+// The left/right sides are calculated scanning rows (instead of
+// columns) to access the memory sequentially.
+template<typename ImageTraits>
+bool shrink_bounds_left_rows_templ(const Image* image, gfx::Rect& bounds, color_t refpixel)
+{
+  const RefRow<ImageTraits> ref(refpixel);
+  int left = bounds.x2();
+  for (int v=bounds.y; v<bounds.y2() && left > bounds.x; ++v) {
+    auto ptr = get_pixel_address_fast<ImageTraits>(image, bounds.x, v);
+    left = bounds.x + ref.findFirstDiff(ptr, left - bounds.x);
+  }
+  bounds.w -= left - bounds.x;
+  bounds.x = left;
+  return (!bounds.isEmpty());
+}
+
+template<typename ImageTraits>
+bool shrink_bounds_right_rows_templ(const Image* image, gfx::Rect& bounds, color_t refpixel)
+{
+  const RefRow<ImageTraits> ref(refpixel);
+  int right = bounds.x-1;         // Last non-empty column
+  for (int v=bounds.y; v<bounds.y2() && right < bounds.x2()-1; ++v) {
+    const int from = right+1;
+    auto ptr = get_pixel_address_fast<ImageTraits>(image, from, v);
+    const int i = ref.findLastDiff(ptr, bounds.x2() - from);
+    if (i >= 0)
+      right = from + i;
+  }
+  bounds.w = right - bounds.x + 1;
+  return (!bounds.isEmpty());
+}
+
+template<typename ImageTraits>
+bool shrink_bounds_top_rows_templ(const Image* image, gfx::Rect& bounds, color_t refpixel)
+{
+  const RefRow<ImageTraits> ref(refpixel);
+  for (int v=bounds.y; v<bounds.y2(); ++v) {
+    auto ptr = get_pixel_address_fast<ImageTraits>(image, bounds.x, v);
+    if (ref.findFirstDiff(ptr, bounds.w) < bounds.w)
+      break;
+    ++bounds.y;
+    --bounds.h;
+  }
+  return (!bounds.isEmpty());
+}
+
+template<typename ImageTraits>
+bool shrink_bounds_bottom_rows_templ(const Image* image, gfx::Rect& bounds, color_t refpixel)
+{
+  const RefRow<ImageTraits> ref(refpixel);
+  for (int v=bounds.y2()-1; v>=bounds.y; --v) {
+    auto ptr = get_pixel_address_fast<ImageTraits>(image, bounds.x, v);
+    if (ref.findFirstDiff(ptr, bounds.w) < bounds.w)
+      break;
+    --bounds.h;
+  }
+  return (!bounds.isEmpty());
+}
+
 template<typename ImageTraits>
 bool shrink_bounds_left_templ(const Image* image, gfx::Rect& bounds, color_t refpixel, int rowPixels)
 {
+  if constexpr (!std::is_same_v<ImageTraits, BitmapTraits>)
+    return shrink_bounds_left_rows_templ<ImageTraits>(image, bounds, refpixel);
+
   int u, v;
   // Shrink left side
   for (u=bounds.x; u<bounds.x2(); ++u) {
@@ -80,6 +187,9 @@ bool shrink_bounds_left_templ(const Image* image, gfx::Rect& bounds, color_t ref
 template<typename ImageTraits>
 bool shrink_bounds_right_templ(const Image* image, gfx::Rect& bounds, color_t refpixel, int rowPixels)
 {
+  if constexpr (!std::is_same_v<ImageTraits, BitmapTraits>)
+    return shrink_bounds_right_rows_templ<ImageTraits>(image, bounds, refpixel);
+
   int u, v;
   // Shrink right side
   for (u=bounds.x2()-1; u>=bounds.x; --u) {
@@ -97,6 +207,9 @@ bool shrink_bounds_right_templ(const Image* image, gfx::Rect& bounds, color_t re
 template<typename ImageTraits>
 bool shrink_bounds_top_templ(const Image* image, gfx::Rect& bounds, color_t refpixel)
 {
+  if constexpr (!std::is_same_v<ImageTraits, BitmapTraits>)
+    return shrink_bounds_top_rows_templ<ImageTraits>(image, bounds, refpixel);
+
   int u, v;
   // Shrink top side
   for (v=bounds.y; v<bounds.y2(); ++v) {
@@ -115,6 +228,9 @@ bool shrink_bounds_top_templ(const Image* image, gfx::Rect& bounds, color_t refp
 template<typename ImageTraits>
 bool shrink_bounds_bottom_templ(const Image* image, gfx::Rect& bounds, color_t refpixel)
 {
+  if constexpr (!std::is_same_v<ImageTraits, BitmapTraits>)
+    return shrink_bounds_bottom_rows_templ<ImageTraits>(image, bounds, refpixel);
+
   int u, v;
   // Shrink bottom side
   for (v=bounds.y2()-1; v>=bounds.y; --v) {
@@ -0,0 +1,79 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/algorithm/shrink_bounds.h"
+#include "doc/image.h"
+#include "doc/image_ref.h"
+#include "doc/primitives.h"
+#include "doc/primitives_fast.h"
+#include "gfx/rect.h"
+
+#include <random>
+
+using namespace doc;
+using namespace doc::algorithm;
+
+template<typename T>
+class ShrinkBounds : public testing::Test {
+protected:
+  ShrinkBounds() { }
+};
+
+using ImageAllTraits = testing::Types<RgbTraits, GrayscaleTraits, IndexedTraits, BitmapTraits>;
+TYPED_TEST_SUITE(ShrinkBounds, ImageAllTraits);
+
+TYPED_TEST(ShrinkBounds, RandomPixels)
+{
+  using ImageTraits = TypeParam;
+
+  std::mt19937 gen(1);
+  for (int h=1; h<40; h+=7) {
+    for (int w=1; w<140; w+=9) {
+      ImageRef img(Image::create(ImageTraits::pixel_format, w, h));
+      clear_image(img.get(), 0);
+
+      gfx::Rect rc;
+      EXPECT_FALSE(shrink_bounds(img.get(), 0, nullptr, rc));
+
+      gfx::Rect expected;
+      for (int i=0; i<3; ++i) {
+        const int x = int(gen() % w);
+        const int y = int(gen() % h);
+        put_pixel_fast<ImageTraits>(img.get(), x, y, 1);
+        expected |= gfx::Rect(x, y, 1, 1);
+
+        EXPECT_TRUE(shrink_bounds(img.get(), 0, nullptr, rc));
+        EXPECT_EQ(expected, rc);
+      }
+    }
+  }
+}
+
+TEST(ShrinkBounds, TransparentPixels)
+{
+  // Transparent pixels with different RGB values are considered empty
+  ImageRef img(Image::create(IMAGE_RGB, 100, 10));
+  clear_image(img.get(), rgba(0, 0, 0, 0));
+  put_pixel_fast<RgbTraits>(img.get(), 2, 1, rgba(255, 0, 0, 0));
+  put_pixel_fast<RgbTraits>(img.get(), 90, 8, rgba(0, 255, 0, 0));
+  put_pixel_fast<RgbTraits>(img.get(), 50, 5, rgba(0, 0, 255, 255));
+
+  gfx::Rect rc;
+  EXPECT_TRUE(shrink_bounds(img.get(), rgba(0, 0, 0, 0), nullptr, rc));
+  EXPECT_EQ(gfx::Rect(50, 5, 1, 1), rc);
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
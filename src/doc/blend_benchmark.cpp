@@ -1,4 +1,5 @@
 // Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -12,6 +13,8 @@
 
 #include <benchmark/benchmark.h>
 
+#include <vector>
+
 using namespace doc;
 
 static void CustomArguments(benchmark::internal::Benchmark* b) {
@@ -53,4 +56,50 @@ BENCHMARK_TEMPLATE(BM_Rgba, rgba_blender_hsl_saturation)->Apply(CustomArguments)
 BENCHMARK_TEMPLATE(BM_Rgba, rgba_blender_hsl_color)->Apply(CustomArguments);
 BENCHMARK_TEMPLATE(BM_Rgba, rgba_blender_hsl_luminosity)->Apply(CustomArguments);
 
+// Compares the scalar and SIMD versions of row blenders (the SIMD
+// version is the same as the scalar one if the blend mode doesn't
+// have a vectorized implementation).
+template<BlendMode M, bool SIMD>
+void BM_RgbaRow(benchmark::State& state) {
+  const int n = state.range(0);
+  const int opacity = state.range(1);
+  std::vector<color_t> dst(n), src(n);
+  for (int i=0; i<n; ++i) {
+    dst[i] = rgba(200, 128, i & 0xff, 255 - (i & 0x7f));
+    src[i] = rgba(32, i & 0xff, 200, i & 0xff);
+  }
+  const BlendRowFunc func = get_rgba_row_blender(M, true, SIMD);
+  while (state.KeepRunning()) {
+    func(dst.data(), src.data(), n, opacity, 0);
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+#define BENCHMARK_ROW(mode)                                             \
+  BENCHMARK_TEMPLATE(BM_RgbaRow, BlendMode::mode, false)                \
+    ->Args({ 4096, 255 })->Args({ 4096, 128 });                         \
+  BENCHMARK_TEMPLATE(BM_RgbaRow, BlendMode::mode, true)                 \
+    ->Args({ 4096, 255 })->Args({ 4096, 128 });
+
+BENCHMARK_ROW(NORMAL)
+BENCHMARK_ROW(MULTIPLY)
+BENCHMARK_ROW(SCREEN)
+BENCHMARK_ROW(OVERLAY)
+BENCHMARK_ROW(DARKEN)
+BENCHMARK_ROW(LIGHTEN)
+BENCHMARK_ROW(COLOR_DODGE)
+BENCHMARK_ROW(COLOR_BURN)
+BENCHMARK_ROW(HARD_LIGHT)
+BENCHMARK_ROW(SOFT_LIGHT)
+BENCHMARK_ROW(DIFFERENCE)
+BENCHMARK_ROW(EXCLUSION)
+BENCHMARK_ROW(HSL_HUE)
+BENCHMARK_ROW(HSL_SATURATION)
+BENCHMARK_ROW(HSL_COLOR)
+BENCHMARK_ROW(HSL_LUMINOSITY)
+BENCHMARK_ROW(ADDITION)
+BENCHMARK_ROW(SUBTRACT)
+BENCHMARK_ROW(DIVIDE)
+
 BENCHMARK_MAIN();
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019-2022 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -25,6 +25,13 @@
 #include <algorithm>
 #include <cmath>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define DOC_BLEND_SSE2 1
+  #include <emmintrin.h>
+#else
+  #define DOC_BLEND_SSE2 0
+#endif
+
 namespace  {
 
 #define blend_multiply(b, s, t)   (MUL_UN8((b), (s), (t)))
@@ -830,4 +837,314 @@ BlendFunc get_indexed_blender(BlendMode blendmode, const bool newBlend)
   return indexed_blender_src;
 }
 
+//////////////////////////////////////////////////////////////////////
+// Row blenders
+
+namespace {
+
+template<BlendFunc F>
+void rgba_row_blender_scalar(color_t* dst, const color_t* src, int n,
+                             int opacity, color_t maskColor)
+{
+  for (int x=0; x<n; ++x, ++dst, ++src) {
+    if (*src != maskColor)
+      *dst = F(*dst, *src, opacity);
+  }
+}
+
+#if DOC_BLEND_SSE2
+
+// Vectorized versions work with 4 RGBA pixels at the same time,
+// each channel is unpacked in the four 32-bit lanes of a __m128i.
+
+inline __m128i v_getr(__m128i c) { return _mm_and_si128(c, _mm_set1_epi32(0xff)); }
+inline __m128i v_getg(__m128i c) { return _mm_and_si128(_mm_srli_epi32(c, rgba_g_shift), _mm_set1_epi32(0xff)); }
+inline __m128i v_getb(__m128i c) { return _mm_and_si128(_mm_srli_epi32(c, rgba_b_shift), _mm_set1_epi32(0xff)); }
+inline __m128i v_geta(__m128i c) { return _mm_srli_epi32(c, rgba_a_shift); }
+
+inline __m128i v_rgba(__m128i r, __m128i g, __m128i b, __m128i a)
+{
+  return _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, rgba_g_shift)),
+                      _mm_or_si128(_mm_slli_epi32(b, rgba_b_shift),
+                                   _mm_slli_epi32(a, rgba_a_shift)));
+}
+
+// if (mask) a else b
+inline __m128i v_select(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// MUL_UN8() for 0 <= a,b <= 255 (the product fits in the low 16-bits
+// of each 32-bit lane, so _mm_mullo_epi16() is enough)
+inline __m128i v_mul_un8(__m128i a, __m128i b)
+{
+  __m128i t = _mm_add_epi32(_mm_mullo_epi16(a, b), _mm_set1_epi32(ONE_HALF));
+  return _mm_srli_epi32(_mm_add_epi32(_mm_srli_epi32(t, G_SHIFT), t), G_SHIFT);
+}
+
+// MUL_UN8() for -255 <= a <= 255 and 0 <= b <= 255. The product is
+// calculated with floats (it's exact as it fits in 24 bits).
+inline __m128i v_mul_un8_signed(__m128i a, __m128i b)
+{
+  __m128i t = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(a),
+                                         _mm_cvtepi32_ps(b)));
+  t = _mm_add_epi32(t, _mm_set1_epi32(ONE_HALF));
+  return _mm_srai_epi32(_mm_add_epi32(_mm_srai_epi32(t, G_SHIFT), t), G_SHIFT);
+}
+
+inline __m128i v_min(__m128i a, __m128i b) { return _mm_min_epi16(a, b); }
+inline __m128i v_max(__m128i a, __m128i b) { return _mm_max_epi16(a, b); }
+
+// Same as rgba_blender_normal()
+inline __m128i v_rgba_blender_normal(__m128i backdrop, __m128i src, __m128i opacity)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i Ba = v_geta(backdrop);
+  const __m128i Sa0 = v_geta(src);
+  const __m128i Sa = v_mul_un8(Sa0, opacity);
+
+  // Transparent backdrop: src with alpha*opacity
+  const __m128i transparentBackdrop =
+    _mm_or_si128(_mm_and_si128(src, _mm_set1_epi32(rgba_rgb_mask)),
+                 _mm_slli_epi32(Sa, rgba_a_shift));
+
+  const __m128i Ra = _mm_sub_epi32(_mm_add_epi32(Sa, Ba), v_mul_un8(Ba, Sa));
+
+  // Rc = Bc + (Sc-Bc) * Sa / Ra
+  //
+  // (Sc-Bc) * Sa is exact using floats, and as the result of the
+  // division is less than 256, the truncation of the float quotient
+  // gives the same result as the integer division.
+  const __m128 SaF = _mm_cvtepi32_ps(Sa);
+  const __m128 RaF = _mm_cvtepi32_ps(v_max(Ra, _mm_set1_epi32(1)));
+  const __m128i Br = v_getr(backdrop);
+  const __m128i Bg = v_getg(backdrop);
+  const __m128i Bb = v_getb(backdrop);
+  const __m128i Rr = _mm_add_epi32(Br, _mm_cvttps_epi32(_mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(v_getr(src), Br)), SaF), RaF)));
+  const __m128i Rg = _mm_add_epi32(Bg, _mm_cvttps_epi32(_mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(v_getg(src), Bg)), SaF), RaF)));
+  const __m128i Rb = _mm_add_epi32(Bb, _mm_cvttps_epi32(_mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(v_getb(src), Bb)), SaF), RaF)));
+  const __m128i result = v_rgba(Rr, Rg, Rb, Ra);
+
+  return v_select(_mm_cmpeq_epi32(Ba, zero),
+                  transparentBackdrop,
+                  v_select(_mm_cmpeq_epi32(Sa0, zero), backdrop, result));
+}
+
+// Same as rgba_blender_merge() but with a different opacity for each pixel
+inline __m128i v_rgba_blender_merge(__m128i backdrop, __m128i src, __m128i opacity)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i Br = v_getr(backdrop);
+  const __m128i Bg = v_getg(backdrop);
+  const __m128i Bb = v_getb(backdrop);
+  const __m128i Ba = v_geta(backdrop);
+  const __m128i Sa = v_geta(src);
+
+  __m128i rgb =
+    v_rgba(_mm_add_epi32(Br, v_mul_un8_signed(_mm_sub_epi32(v_getr(src), Br), opacity)),
+           _mm_add_epi32(Bg, v_mul_un8_signed(_mm_sub_epi32(v_getg(src), Bg), opacity)),
+           _mm_add_epi32(Bb, v_mul_un8_signed(_mm_sub_epi32(v_getb(src), Bb), opacity)),
+           zero);
+  rgb = v_select(_mm_cmpeq_epi32(Sa, zero),
+                 _mm_and_si128(backdrop, _mm_set1_epi32(rgba_rgb_mask)), rgb);
+  rgb = v_select(_mm_cmpeq_epi32(Ba, zero),
+                 _mm_and_si128(src, _mm_set1_epi32(rgba_rgb_mask)), rgb);
+
+  const __m128i Ra = _mm_add_epi32(Ba, v_mul_un8_signed(_mm_sub_epi32(Sa, Ba), opacity));
+  rgb = _mm_andnot_si128(_mm_cmpeq_epi32(Ra, zero), rgb);
+  return _mm_or_si128(rgb, _mm_slli_epi32(Ra, rgba_a_shift));
+}
+
+// Separable blend functions for each channel (b=backdrop, s=source)
+struct v_blend_normal {
+  static __m128i apply(__m128i b, __m128i s) { return s; }
+};
+
+struct v_blend_multiply {
+  static __m128i apply(__m128i b, __m128i s) { return v_mul_un8(b, s); }
+};
+
+struct v_blend_screen {
+  static __m128i apply(__m128i b, __m128i s) {
+    return _mm_sub_epi32(_mm_add_epi32(b, s), v_mul_un8(b, s));
+  }
+};
+
+struct v_blend_hard_light {
+  static __m128i apply(__m128i b, __m128i s) {
+    const __m128i s2 = _mm_slli_epi32(s, 1);
+    return v_select(_mm_cmplt_epi32(s, _mm_set1_epi32(128)),
+                    v_blend_multiply::apply(b, s2),
+                    v_blend_screen::apply(b, _mm_sub_epi32(s2, _mm_set1_epi32(255))));
+  }
+};
+
+struct v_blend_overlay {
+  static __m128i apply(__m128i b, __m128i s) { return v_blend_hard_light::apply(s, b); }
+};
+
+struct v_blend_darken {
+  static __m128i apply(__m128i b, __m128i s) { return v_min(b, s); }
+};
+
+struct v_blend_lighten {
+  static __m128i apply(__m128i b, __m128i s) { return v_max(b, s); }
+};
+
+struct v_blend_difference {
+  static __m128i apply(__m128i b, __m128i s) {
+    return _mm_sub_epi32(v_max(b, s), v_min(b, s));
+  }
+};
+
+struct v_blend_exclusion {
+  static __m128i apply(__m128i b, __m128i s) {
+    const __m128i t = v_mul_un8(b, s);
+    return _mm_sub_epi32(_mm_add_epi32(b, s), _mm_add_epi32(t, t));
+  }
+};
+
+struct v_blend_addition {
+  static __m128i apply(__m128i b, __m128i s) {
+    return v_min(_mm_add_epi32(b, s), _mm_set1_epi32(255));
+  }
+};
+
+struct v_blend_subtract {
+  static __m128i apply(__m128i b, __m128i s) {
+    return v_max(_mm_sub_epi32(b, s), _mm_setzero_si128());
+  }
+};
+
+// Same as rgba_blender_[name]() functions: the blend function is
+// applied to each channel and then the result is composited with the
+// normal blender
+template<class Blend>
+inline __m128i v_rgba_blender(__m128i backdrop, __m128i src, __m128i opacity)
+{
+  src = v_rgba(Blend::apply(v_getr(backdrop), v_getr(src)),
+               Blend::apply(v_getg(backdrop), v_getg(src)),
+               Blend::apply(v_getb(backdrop), v_getb(src)),
+               v_geta(src));
+  return v_rgba_blender_normal(backdrop, src, opacity);
+}
+
+// Same as rgba_blender_[name]_n() functions (RGBA_BLENDER_N)
+template<class Blend>
+inline __m128i v_rgba_blender_n(__m128i backdrop, __m128i src, __m128i opacity)
+{
+  const __m128i normal = v_rgba_blender_normal(backdrop, src, opacity);
+  const __m128i blend = v_rgba_blender<Blend>(backdrop, src, opacity);
+  const __m128i Ba = v_geta(backdrop);
+  const __m128i normalToBlendMerge = v_rgba_blender_merge(normal, blend, Ba);
+  const __m128i srcTotalAlpha = v_mul_un8(v_geta(src), opacity);
+  const __m128i compositeAlpha = v_mul_un8(Ba, srcTotalAlpha);
+  const __m128i result = v_rgba_blender_merge(normalToBlendMerge, blend, compositeAlpha);
+  return v_select(_mm_cmpeq_epi32(Ba, _mm_setzero_si128()), normal, result);
+}
+
+template<__m128i (*V)(__m128i, __m128i, __m128i), BlendFunc F>
+void rgba_row_blender_sse2(color_t* dst, const color_t* src, int n,
+                           int opacity, color_t maskColor)
+{
+  const __m128i opacityV = _mm_set1_epi32(opacity);
+  const __m128i maskV = _mm_set1_epi32(int(maskColor));
+  int x = 0;
+  for (; x+4<=n; x+=4, dst+=4, src+=4) {
+    const __m128i s = _mm_loadu_si128((const __m128i*)src);
+    const __m128i b = _mm_loadu_si128((const __m128i*)dst);
+    _mm_storeu_si128((__m128i*)dst,
+                     v_select(_mm_cmpeq_epi32(s, maskV), b, V(b, s, opacityV)));
+  }
+  rgba_row_blender_scalar<F>(dst, src, n-x, opacity, maskColor);
+}
+
+#define RGBA_ROW_BLENDER_SSE2(name)                                           \
+  rgba_row_blender_sse2<v_rgba_blender<v_blend_##name>,                      \
+                        rgba_blender_##name>
+#define RGBA_ROW_BLENDER_SSE2_N(name)                                         \
+  rgba_row_blender_sse2<v_rgba_blender_n<v_blend_##name>,                    \
+                        rgba_blender_##name##_n>
+
+BlendRowFunc get_rgba_row_blender_sse2(BlendMode blendmode, const bool newBlend)
+{
+  switch (blendmode) {
+    case BlendMode::NORMAL:     return RGBA_ROW_BLENDER_SSE2(normal);
+    case BlendMode::MULTIPLY:   return newBlend? RGBA_ROW_BLENDER_SSE2_N(multiply): RGBA_ROW_BLENDER_SSE2(multiply);
+    case BlendMode::SCREEN:     return newBlend? RGBA_ROW_BLENDER_SSE2_N(screen): RGBA_ROW_BLENDER_SSE2(screen);
+    case BlendMode::OVERLAY:    return newBlend? RGBA_ROW_BLENDER_SSE2_N(overlay): RGBA_ROW_BLENDER_SSE2(overlay);
+    case BlendMode::DARKEN:     return newBlend? RGBA_ROW_BLENDER_SSE2_N(darken): RGBA_ROW_BLENDER_SSE2(darken);
+    case BlendMode::LIGHTEN:    return newBlend? RGBA_ROW_BLENDER_SSE2_N(lighten): RGBA_ROW_BLENDER_SSE2(lighten);
+    case BlendMode::HARD_LIGHT: return newBlend? RGBA_ROW_BLENDER_SSE2_N(hard_light): RGBA_ROW_BLENDER_SSE2(hard_light);
+    case BlendMode::DIFFERENCE: return newBlend? RGBA_ROW_BLENDER_SSE2_N(difference): RGBA_ROW_BLENDER_SSE2(difference);
+    case BlendMode::EXCLUSION:  return newBlend? RGBA_ROW_BLENDER_SSE2_N(exclusion): RGBA_ROW_BLENDER_SSE2(exclusion);
+    case BlendMode::ADDITION:   return newBlend? RGBA_ROW_BLENDER_SSE2_N(addition): RGBA_ROW_BLENDER_SSE2(addition);
+    case BlendMode::SUBTRACT:   return newBlend? RGBA_ROW_BLENDER_SSE2_N(subtract): RGBA_ROW_BLENDER_SSE2(subtract);
+    default:
+      // Blend modes with divisions (dodge, burn, divide) or with
+      // floating point math (soft light, HSL) use the scalar version.
+      return nullptr;
+  }
+}
+
+#endif // DOC_BLEND_SSE2
+
+} // anonymous namespace
+
+#define RGBA_ROW_BLENDER(name)   rgba_row_blender_scalar<rgba_blender_##name>
+#define RGBA_ROW_BLENDER_N(name) (newBlend? rgba_row_blender_scalar<rgba_blender_##name##_n>: \
+                                            rgba_row_blender_scalar<rgba_blender_##name>)
+
+BlendRowFunc get_rgba_row_blender(BlendMode blendmode, const bool newBlend,
+                                  const bool simd)
+{
+#if DOC_BLEND_SSE2
+  if (simd) {
+    if (BlendRowFunc func = get_rgba_row_blender_sse2(blendmode, newBlend))
+      return func;
+  }
+#endif
+
+  switch (blendmode) {
+    case BlendMode::SRC:            return RGBA_ROW_BLENDER(src);
+    case BlendMode::MERGE:          return RGBA_ROW_BLENDER(merge);
+    case BlendMode::NEG_BW:         return RGBA_ROW_BLENDER(neg_bw);
+    case BlendMode::RED_TINT:       return RGBA_ROW_BLENDER(red_tint);
+    case BlendMode::BLUE_TINT:      return RGBA_ROW_BLENDER(blue_tint);
+    case BlendMode::DST_OVER:       return RGBA_ROW_BLENDER(normal_dst_over);
+
+    case BlendMode::NORMAL:         return RGBA_ROW_BLENDER(normal);
+    case BlendMode::MULTIPLY:       return RGBA_ROW_BLENDER_N(multiply);
+    case BlendMode::SCREEN:         return RGBA_ROW_BLENDER_N(screen);
+    case BlendMode::OVERLAY:        return RGBA_ROW_BLENDER_N(overlay);
+    case BlendMode::DARKEN:         return RGBA_ROW_BLENDER_N(darken);
+    case BlendMode::LIGHTEN:        return RGBA_ROW_BLENDER_N(lighten);
+    case BlendMode::COLOR_DODGE:    return RGBA_ROW_BLENDER_N(color_dodge);
+    case BlendMode::COLOR_BURN:     return RGBA_ROW_BLENDER_N(color_burn);
+    case BlendMode::HARD_LIGHT:     return RGBA_ROW_BLENDER_N(hard_light);
+    case BlendMode::SOFT_LIGHT:     return RGBA_ROW_BLENDER_N(soft_light);
+    case BlendMode::DIFFERENCE:     return RGBA_ROW_BLENDER_N(difference);
+    case BlendMode::EXCLUSION:      return RGBA_ROW_BLENDER_N(exclusion);
+    case BlendMode::HSL_HUE:        return RGBA_ROW_BLENDER_N(hsl_hue);
+    case BlendMode::HSL_SATURATION: return RGBA_ROW_BLENDER_N(hsl_saturation);
+    case BlendMode::HSL_COLOR:      return RGBA_ROW_BLENDER_N(hsl_color);
+    case BlendMode::HSL_LUMINOSITY: return RGBA_ROW_BLENDER_N(hsl_luminosity);
+    case BlendMode::ADDITION:       return RGBA_ROW_BLENDER_N(addition);
+    case BlendMode::SUBTRACT:       return RGBA_ROW_BLENDER_N(subtract);
+    case BlendMode::DIVIDE:         return RGBA_ROW_BLENDER_N(divide);
+  }
+  ASSERT(false);
+  return RGBA_ROW_BLENDER(src);
+}
+
+bool has_rgba_simd_row_blender(BlendMode blendmode, const bool newBlend)
+{
+#if DOC_BLEND_SSE2
+  return (get_rgba_row_blender_sse2(blendmode, newBlend) != nullptr);
+#else
+  return false;
+#endif
+}
+
 } // namespace doc
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (c) 2001-2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -16,6 +16,13 @@ namespace doc {
 
   typedef color_t (*BlendFunc)(color_t backdrop, color_t src, int opacity);
 
+  // Blends a whole row of "n" RGBA pixels from "src" into "dst"
+  // (which is the backdrop and the output at the same time). Pixels
+  // in "src" equal to "maskColor" are skipped, as BlenderHelper does
+  // for the pixel-by-pixel functions.
+  typedef void (*BlendRowFunc)(color_t* dst, const color_t* src, int n,
+                               int opacity, color_t maskColor);
+
   color_t rgba_blender_src(color_t backdrop, color_t src, int opacity);
   color_t rgba_blender_merge(color_t backdrop, color_t src, int opacity);
   color_t rgba_blender_neg_bw(color_t backdrop, color_t src, int opacity);
@@ -68,6 +75,18 @@ namespace doc {
   BlendFunc get_graya_blender(BlendMode blendmode, const bool newBlend);
   BlendFunc get_indexed_blender(BlendMode blendmode, const bool newBlend);
 
+  // Returns a row blender for the given blend mode. The result of a
+  // row blender is bit-by-bit equal to the result of calling
+  // get_rgba_blender() for each pixel. If "simd" is true (and the
+  // library was compiled with SIMD support) a vectorized version is
+  // returned for the blend modes that have one.
+  BlendRowFunc get_rgba_row_blender(BlendMode blendmode, const bool newBlend,
+                                    const bool simd = true);
+
+  // Returns true if the row blender for the given blend mode has a
+  // vectorized implementation.
+  bool has_rgba_simd_row_blender(BlendMode blendmode, const bool newBlend);
+
 } // namespace doc
 
 #endif
@@ -0,0 +1,90 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/blend_funcs.h"
+
+#include <random>
+#include <vector>
+
+using namespace doc;
+
+static const BlendMode kBlendModes[] = {
+  BlendMode::SRC, BlendMode::MERGE, BlendMode::NEG_BW,
+  BlendMode::RED_TINT, BlendMode::BLUE_TINT, BlendMode::DST_OVER,
+  BlendMode::NORMAL, BlendMode::MULTIPLY, BlendMode::SCREEN,
+  BlendMode::OVERLAY, BlendMode::DARKEN, BlendMode::LIGHTEN,
+  BlendMode::COLOR_DODGE, BlendMode::COLOR_BURN, BlendMode::HARD_LIGHT,
+  BlendMode::SOFT_LIGHT, BlendMode::DIFFERENCE, BlendMode::EXCLUSION,
+  BlendMode::HSL_HUE, BlendMode::HSL_SATURATION, BlendMode::HSL_COLOR,
+  BlendMode::HSL_LUMINOSITY, BlendMode::ADDITION, BlendMode::SUBTRACT,
+  BlendMode::DIVIDE
+};
+
+static void expect_same_as_pixel_blender(BlendMode mode, bool newBlend, bool simd)
+{
+  std::mt19937 rng(1);
+  const BlendFunc pixelFunc = get_rgba_blender(mode, newBlend);
+  const BlendRowFunc rowFunc = get_rgba_row_blender(mode, newBlend, simd);
+  const color_t maskColor = 0;
+
+  // Odd size to test the scalar tail of SIMD versions
+  const int n = 61;
+  std::vector<color_t> dst(n), src(n), expected(n);
+
+  for (int i=0; i<256; ++i) {
+    const int opacity = (i == 0 ? 0: i == 1 ? 255: int(rng() & 0xff));
+    for (int x=0; x<n; ++x) {
+      dst[x] = rng();
+      src[x] = rng();
+      // Test special cases for alpha
+      switch (rng() % 6) {
+        case 0: dst[x] &= rgba_rgb_mask; break;
+        case 1: src[x] &= rgba_rgb_mask; break;
+        case 2: src[x] |= rgba_a_mask; break;
+        case 3: src[x] = maskColor; break;
+      }
+      expected[x] = (src[x] != maskColor ? pixelFunc(dst[x], src[x], opacity): dst[x]);
+    }
+
+    rowFunc(dst.data(), src.data(), n, opacity, maskColor);
+
+    for (int x=0; x<n; ++x) {
+      ASSERT_EQ(expected[x], dst[x])
+        << " blend mode " << int(mode)
+        << " new blend " << newBlend
+        << " opacity " << opacity
+        << " x=" << x;
+    }
+  }
+}
+
+TEST(BlendFuncs, ScalarRowBlenders)
+{
+  for (BlendMode mode : kBlendModes) {
+    expect_same_as_pixel_blender(mode, false, false);
+    expect_same_as_pixel_blender(mode, true, false);
+  }
+}
+
+TEST(BlendFuncs, SimdRowBlenders)
+{
+  for (BlendMode mode : kBlendModes) {
+    expect_same_as_pixel_blender(mode, false, true);
+    expect_same_as_pixel_blender(mode, true, true);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -15,6 +15,7 @@
 #include "doc/image.h"
 #include "doc/layer.h"
 #include "doc/layer_tilemap.h"
+#include "doc/render_plan.h"
 #include "doc/sprite.h"
 #include "doc/tile.h"
 #include "gfx/rect.h"
@@ -98,7 +99,10 @@ void Cel::setOpacity(int opacity)
 
 void Cel::setZIndex(int zindex)
 {
-  m_zIndex = zindex;
+  if (m_zIndex != zindex) {
+    m_zIndex = zindex;
+    RenderPlan::incrementStructureVersion();
+  }
 }
 
 Document* Cel::document() const
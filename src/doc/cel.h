@@ -82,6 +82,9 @@ namespace doc {
 
     Cel();
     DISABLE_COPYING(Cel);
+
+    // To displace frames of cels in place (LayerImage::displaceFrames())
+    friend class LayerImage;
   };
 
 } // namespace doc
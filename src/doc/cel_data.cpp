@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019-2022 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -31,9 +31,23 @@ CelData::CelData(const ImageRef& image)
 {
 }
 
+CelData::CelData(const gfx::Size& imageSize,
+                 const int loaderMemSize,
+                 ImageLoader&& loader)
+  : WithUserData(ObjectType::CelData)
+  , m_opacity(255)
+  , m_bounds(0, 0, imageSize.w, imageSize.h)
+  , m_boundsF(nullptr)
+  , m_lazy(new LazyImage)
+{
+  m_lazy->size = imageSize;
+  m_lazy->memSize = loaderMemSize;
+  m_lazy->loader = std::move(loader);
+}
+
 CelData::CelData(const CelData& celData)
   : WithUserData(ObjectType::CelData)
-  , m_image(celData.m_image)
+  , m_image(celData.imageRef())
   , m_opacity(celData.m_opacity)
   , m_bounds(celData.m_bounds)
   , m_boundsF(celData.m_boundsF ? std::make_unique<gfx::RectF>(*celData.m_boundsF):
@@ -50,6 +64,7 @@ void CelData::setImage(const ImageRef& image, Layer* layer)
   ASSERT(image.get());
 
   m_image = image;
+  m_lazy.reset();
   adjustBounds(layer);
 }
 
@@ -60,8 +75,24 @@ void CelData::setPosition(const gfx::Point& pos)
     m_boundsF->setOrigin(gfx::PointF(pos));
 }
 
+void CelData::loadLazyImage() const
+{
+  std::call_once(
+    m_lazy->loaded,
+    [this]{
+      m_image = m_lazy->loader();
+      m_lazy->loader = nullptr; // Free the loader data
+
+      // The loader must return an image with the expected size even
+      // if it cannot decode the pixels (cels must have an image).
+      ASSERT(m_image);
+      ASSERT(m_image->size() == m_lazy->size);
+    });
+}
+
 void CelData::adjustBounds(Layer* layer)
 {
+  loadImage();
   ASSERT(m_image);
   if (m_image->pixelFormat() == IMAGE_TILEMAP) {
     Tileset* tileset = nullptr;
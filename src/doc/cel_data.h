@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -14,7 +14,9 @@
 #include "doc/with_user_data.h"
 #include "gfx/rect.h"
 
+#include <functional>
 #include <memory>
+#include <mutex>
 
 namespace doc {
 
@@ -23,25 +25,58 @@ namespace doc {
 
   class CelData : public WithUserData {
   public:
+    // Function used to create the image the first time it's needed
+    // (e.g. to decompress the pixels of a file loaded lazily).
+    using ImageLoader = std::function<ImageRef()>;
+
     CelData(const ImageRef& image);
+
+    // Creates a cel data with an image of the given size that is
+    // created with the "loader" the first time it's requested.
+    // "loaderMemSize" is the memory used by the loader (e.g. the size
+    // of the compressed pixels).
+    CelData(const gfx::Size& imageSize,
+            const int loaderMemSize,
+            ImageLoader&& loader);
+
     CelData(const CelData& celData);
     ~CelData();
 
     gfx::Point position() const { return m_bounds.origin(); }
     const gfx::Rect& bounds() const { return m_bounds; }
     int opacity() const { return m_opacity; }
-    Image* image() const { return const_cast<Image*>(m_image.get()); };
-    ImageRef imageRef() const { return m_image; }
+    Image* image() const {
+      loadImage();
+      return const_cast<Image*>(m_image.get());
+    };
+    ImageRef imageRef() const {
+      loadImage();
+      return m_image;
+    }
+
+    // Returns false if the image is waiting to be loaded.
+    bool isImageLoaded() const { return (m_image != nullptr); }
 
     // Returns a rectangle with the bounds of the image (width/height
     // of the image) in the position of the cel (useful to compare
     // active tilemap bounds when we have to change the tilemap cel
     // bounds).
     gfx::Rect imageBounds() const {
+      const gfx::Size size = imageSize();
       return gfx::Rect(m_bounds.x,
                        m_bounds.y,
-                       m_image->width(),
-                       m_image->height());
+                       size.w,
+                       size.h);
+    }
+
+    // Size of the image (without loading it).
+    gfx::Size imageSize() const {
+      if (m_image)
+        return m_image->size();
+      else if (m_lazy)
+        return m_lazy->size;
+      else
+        return gfx::Size(0, 0);
     }
 
     void setImage(const ImageRef& image, Layer* layer);
@@ -81,6 +116,9 @@ namespace doc {
     }
 
     virtual int getMemSize() const override {
+      if (!m_image && m_lazy)
+        return sizeof(CelData) + m_lazy->memSize;
+
       ASSERT(m_image);
       return sizeof(CelData) + m_image->getMemSize();
     }
@@ -88,7 +126,23 @@ namespace doc {
     void adjustBounds(Layer* layer);
 
   private:
-    ImageRef m_image;
+    struct LazyImage {
+      gfx::Size size;
+      int memSize;
+      ImageLoader loader;
+      std::once_flag loaded;
+    };
+
+    void loadImage() const {
+      if (m_lazy)
+        loadLazyImage();
+    }
+    void loadLazyImage() const;
+
+    // The image can be loaded by different threads at the same time
+    // (e.g. rendering tiles in parallel), so it's created only once.
+    mutable ImageRef m_image;
+    std::unique_ptr<LazyImage> m_lazy;
     int m_opacity;
     gfx::Rect m_bounds;
 
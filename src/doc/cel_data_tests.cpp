@@ -0,0 +1,90 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/cel_data.h"
+#include "doc/image.h"
+#include "doc/primitives.h"
+#include "gfx/rect_io.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace doc;
+
+TEST(CelData, LazyImage)
+{
+  int calls = 0;
+  CelData data(
+    gfx::Size(4, 3), 16,
+    [&calls]{
+      ++calls;
+      ImageRef image(Image::create(IMAGE_RGB, 4, 3));
+      clear_image(image.get(), rgba(255, 0, 0, 255));
+      return image;
+    });
+
+  EXPECT_FALSE(data.isImageLoaded());
+  EXPECT_EQ(gfx::Rect(0, 0, 4, 3), data.bounds());
+  EXPECT_EQ(gfx::Rect(0, 0, 4, 3), data.imageBounds());
+  EXPECT_EQ(0, calls);
+
+  Image* image = data.image();
+  ASSERT_TRUE(image != nullptr);
+  EXPECT_TRUE(data.isImageLoaded());
+  EXPECT_EQ(1, calls);
+  EXPECT_EQ(rgba(255, 0, 0, 255), get_pixel(image, 2, 1));
+
+  // The loader is called only once
+  EXPECT_EQ(image, data.imageRef().get());
+  EXPECT_EQ(1, calls);
+}
+
+TEST(CelData, LazyImageFromThreads)
+{
+  std::atomic<int> calls(0);
+  CelData data(
+    gfx::Size(8, 8), 16,
+    [&calls]{
+      ++calls;
+      return ImageRef(Image::create(IMAGE_RGB, 8, 8));
+    });
+
+  std::vector<std::thread> threads;
+  std::vector<Image*> images(8, nullptr);
+  for (int i=0; i<int(images.size()); ++i)
+    threads.emplace_back([&data, &images, i]{ images[i] = data.image(); });
+  for (auto& t : threads)
+    t.join();
+
+  EXPECT_EQ(1, calls);
+  for (Image* image : images)
+    EXPECT_EQ(images[0], image);
+}
+
+TEST(CelData, CopyLazyImage)
+{
+  CelData data(
+    gfx::Size(2, 2), 16,
+    []{ return ImageRef(Image::create(IMAGE_GRAYSCALE, 2, 2)); });
+
+  CelData copy(data);
+  EXPECT_TRUE(data.isImageLoaded());
+  EXPECT_TRUE(copy.isImageLoaded());
+  EXPECT_EQ(data.image(), copy.image());
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
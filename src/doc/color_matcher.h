@@ -0,0 +1,168 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_COLOR_MATCHER_H_INCLUDED
+#define DOC_COLOR_MATCHER_H_INCLUDED
+#pragma once
+
+#include "doc/color.h"
+#include "doc/image_traits.h"
+
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define DOC_COLOR_MATCHER_SSE2 1
+  #include <emmintrin.h>
+#else
+  #define DOC_COLOR_MATCHER_SSE2 0
+#endif
+
+namespace doc {
+
+  // Branchless comparison of pixels against a color with a
+  // tolerance (each channel in the [c-tolerance, c+tolerance] range).
+  // As there are no branches, the compiler can vectorize comparisons
+  // of several pixels in a row.
+  //
+  // A channel is in the "v-tolerance <= ch <= v+tolerance" range when
+  // "unsigned(ch - (v-tolerance)) <= unsigned(2*tolerance)".
+  //
+  // With "matchTransparent", all transparent pixels match a
+  // transparent color (as the floodfill/magic wand does).
+  template<typename ImageTraits>
+  struct ColorMatcher;
+
+  template<>
+  struct ColorMatcher<RgbTraits> {
+    color_t color;
+    int tolerance;
+    uint32_t r, g, b, a, range, srcTransparent;
+
+    ColorMatcher(color_t src, int tolerance, bool matchTransparent = true)
+      : color(src)
+      , tolerance(tolerance)
+      , r(rgba_getr(src) - tolerance)
+      , g(rgba_getg(src) - tolerance)
+      , b(rgba_getb(src) - tolerance)
+      , a(rgba_geta(src) - tolerance)
+      , range(2*tolerance)
+      , srcTransparent(matchTransparent && rgba_geta(src) == 0) { }
+
+    bool operator()(uint32_t c) const {
+      return ((srcTransparent & ((c >> rgba_a_shift) == 0)) |
+              ((rgba_getr(c) - r <= range) &
+               (rgba_getg(c) - g <= range) &
+               (rgba_getb(c) - b <= range) &
+               (rgba_geta(c) - a <= range)));
+    }
+  };
+
+  template<>
+  struct ColorMatcher<GrayscaleTraits> {
+    uint32_t v, a, range, srcTransparent;
+
+    ColorMatcher(color_t src, int tolerance, bool matchTransparent = true)
+      : v(graya_getv(src) - tolerance)
+      , a(graya_geta(src) - tolerance)
+      , range(2*tolerance)
+      , srcTransparent(matchTransparent && graya_geta(src) == 0) { }
+
+    bool operator()(uint16_t c) const {
+      return ((srcTransparent & ((c >> graya_a_shift) == 0)) |
+              ((graya_getv(c) - v <= range) &
+               (graya_geta(c) - a <= range)));
+    }
+  };
+
+  template<>
+  struct ColorMatcher<IndexedTraits> {
+    uint32_t i, range;
+
+    ColorMatcher(color_t src, int tolerance, bool matchTransparent = true)
+      : i(src - tolerance)
+      , range(2*tolerance) { }
+
+    bool operator()(uint8_t c) const {
+      return (c - i <= range);
+    }
+  };
+
+  template<>
+  struct ColorMatcher<TilemapTraits> {
+    uint32_t src;
+
+    ColorMatcher(color_t src, int tolerance, bool matchTransparent = true)
+      : src(src) { }
+
+    bool operator()(uint32_t c) const {
+      return (c == src);
+    }
+  };
+
+  // Writes one bit for each of the "w" pixels of "src" in "dstBits"
+  // (BitmapTraits row format, the first pixel in the least
+  // significant bit), 1 when the pixel matches.
+  template<typename ImageTraits>
+  inline void match_row_bits(typename ImageTraits::const_address_t src,
+                             const int w,
+                             const ColorMatcher<ImageTraits>& match,
+                             uint8_t* dstBits) {
+    int x = 0;
+    for (; x+8 <= w; x+=8, src+=8) {
+      uint8_t bits = 0;
+      for (int i=0; i<8; ++i)
+        bits |= uint8_t(match(src[i])) << i;
+      *(dstBits++) = bits;
+    }
+    if (x < w) {
+      uint8_t bits = 0;
+      for (int i=0; x<w; ++i, ++x)
+        bits |= uint8_t(match(*(src++))) << i;
+      *dstBits = bits;
+    }
+  }
+
+#if DOC_COLOR_MATCHER_SSE2
+  // RGBA version comparing 4 pixels at the same time: a channel
+  // matches if its saturated absolute difference minus the
+  // tolerance is zero.
+  template<>
+  inline void match_row_bits<RgbTraits>(RgbTraits::const_address_t src,
+                                        const int w,
+                                        const ColorMatcher<RgbTraits>& match,
+                                        uint8_t* dstBits) {
+    const __m128i ref = _mm_set1_epi32(int(match.color));
+    const __m128i tol = _mm_set1_epi8(char(match.tolerance));
+    const __m128i alpha = _mm_set1_epi32(int(rgba_a_mask));
+    const __m128i transparent = _mm_set1_epi32(match.srcTransparent ? -1: 0);
+    const __m128i zero = _mm_setzero_si128();
+
+    auto match4 = [&](const uint32_t* p) -> int {
+      const __m128i c = _mm_loadu_si128((const __m128i*)p);
+      const __m128i diff = _mm_or_si128(_mm_subs_epu8(c, ref),
+                                        _mm_subs_epu8(ref, c));
+      __m128i eq = _mm_cmpeq_epi32(_mm_subs_epu8(diff, tol), zero);
+      eq = _mm_or_si128(
+        eq, _mm_and_si128(transparent,
+                          _mm_cmpeq_epi32(_mm_and_si128(c, alpha), zero)));
+      return _mm_movemask_ps(_mm_castsi128_ps(eq));
+    };
+
+    int x = 0;
+    for (; x+8 <= w; x+=8, src+=8)
+      *(dstBits++) = uint8_t(match4(src) | (match4(src+4) << 4));
+    if (x < w) {
+      uint8_t bits = 0;
+      for (int i=0; x<w; ++i, ++x)
+        bits |= uint8_t(match(*(src++))) << i;
+      *dstBits = bits;
+    }
+  }
+#endif
+
+} // namespace doc
+
+#endif
@@ -0,0 +1,136 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_FLAT_MAP_H_INCLUDED
+#define DOC_FLAT_MAP_H_INCLUDED
+#pragma once
+
+#include <algorithm>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace doc {
+
+  // A std::map-like container that stores its elements in a vector
+  // sorted by key. It uses one allocation for all the elements (zero
+  // when it's empty) instead of one tree node for each element, so
+  // it's more compact and faster to iterate/search when there are
+  // few elements (e.g. the user defined properties of each tile).
+  //
+  // Warning: as in a std::vector, inserting/erasing elements
+  // invalidates iterators and references to other elements.
+  template<typename Key, typename Value>
+  class FlatMap {
+  public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = std::pair<Key, Value>;
+    using container = std::vector<value_type>;
+    using iterator = typename container::iterator;
+    using const_iterator = typename container::const_iterator;
+    using size_type = typename container::size_type;
+
+    FlatMap() { }
+    FlatMap(std::initializer_list<value_type> items) {
+      for (const auto& item : items)
+        insert(item);
+    }
+
+    iterator begin() { return m_items.begin(); }
+    iterator end() { return m_items.end(); }
+    const_iterator begin() const { return m_items.begin(); }
+    const_iterator end() const { return m_items.end(); }
+
+    size_type size() const { return m_items.size(); }
+    bool empty() const { return m_items.empty(); }
+    void clear() { m_items.clear(); }
+    void reserve(size_type n) { m_items.reserve(n); }
+
+    iterator find(const Key& key) {
+      auto it = lowerBound(key);
+      return (it != end() && it->first == key ? it: end());
+    }
+
+    const_iterator find(const Key& key) const {
+      return const_cast<FlatMap*>(this)->find(key);
+    }
+
+    size_type count(const Key& key) const {
+      return (find(key) != end() ? 1: 0);
+    }
+
+    Value& at(const Key& key) {
+      auto it = find(key);
+      if (it == end())
+        throw std::out_of_range("FlatMap::at");
+      return it->second;
+    }
+
+    const Value& at(const Key& key) const {
+      return const_cast<FlatMap*>(this)->at(key);
+    }
+
+    Value& operator[](const Key& key) {
+      auto it = lowerBound(key);
+      if (it == end() || it->first != key)
+        it = m_items.insert(it, value_type(key, Value()));
+      return it->second;
+    }
+
+    std::pair<iterator, bool> insert(const value_type& item) {
+      auto it = lowerBound(item.first);
+      if (it != end() && it->first == item.first)
+        return std::make_pair(it, false);
+      return std::make_pair(m_items.insert(it, item), true);
+    }
+
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args) {
+      return insert(value_type(std::forward<Args>(args)...));
+    }
+
+    iterator erase(const_iterator it) {
+      return m_items.erase(it);
+    }
+
+    size_type erase(const Key& key) {
+      auto it = find(key);
+      if (it == end())
+        return 0;
+      m_items.erase(it);
+      return 1;
+    }
+
+    bool operator==(const FlatMap& other) const {
+      return m_items == other.m_items;
+    }
+
+    bool operator!=(const FlatMap& other) const {
+      return !operator==(other);
+    }
+
+  private:
+    iterator lowerBound(const Key& key) {
+      // Fast path to append elements that are inserted in order
+      // (e.g. when they are loaded from a file)
+      if (m_items.empty() || m_items.back().first < key)
+        return m_items.end();
+
+      return std::lower_bound(
+        m_items.begin(), m_items.end(), key,
+        [](const value_type& item, const Key& key) {
+          return item.first < key;
+        });
+    }
+
+    container m_items;
+  };
+
+} // namespace doc
+
+#endif
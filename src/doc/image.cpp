@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018-2020 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -64,8 +64,16 @@ Image* Image::create(const ImageSpec& spec,
 Image* Image::createCopy(const Image* image, const ImageBufferPtr& buffer)
 {
   ASSERT(image);
-  return crop_image(image, 0, 0, image->width(), image->height(),
-                    image->maskColor(), buffer);
+
+  // We don't need to clear the new image (as crop_image() does)
+  // because all its pixels are replaced with the copy.
+  Image* copy = Image::create(image->pixelFormat(),
+                              image->width(), image->height(), buffer);
+  if (copy) {
+    copy->setMaskColor(image->maskColor());
+    copy->copy(image, gfx::Clip(0, 0, image->bounds()));
+  }
+  return copy;
 }
 
 } // namespace doc
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2014  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -155,18 +155,92 @@ namespace doc {
     LockImageBits();            // Undefined
   };
 
+  // Calls f(address, width) for each row of the given area of the
+  // image. Each row is a contiguous span of pixels, so (unlike
+  // ImageIterator) loops inside "f" can be auto-vectorized by the
+  // compiler. Not available for BitmapTraits (8 pixels per byte).
+  template<class ImageTraits,
+           class RowFunction>
+  inline void for_each_row(Image* image, const gfx::Rect& area, RowFunction f) {
+    static_assert(ImageTraits::pixels_per_byte != 8);
+    ASSERT(image->bounds().contains(area));
+    using address_t = typename ImageTraits::address_t;
+    for (int y=area.y; y<area.y2(); ++y)
+      f((address_t)image->getPixelAddress(area.x, y), area.w);
+  }
+
+  template<class ImageTraits,
+           class RowFunction>
+  inline void for_each_row(const Image* image, const gfx::Rect& area, RowFunction f) {
+    static_assert(ImageTraits::pixels_per_byte != 8);
+    ASSERT(image->bounds().contains(area));
+    using const_address_t = typename ImageTraits::const_address_t;
+    for (int y=area.y; y<area.y2(); ++y)
+      f((const_address_t)image->getPixelAddress(area.x, y), area.w);
+  }
+
+  // Calls f(srcAddress, dstAddress, width) for each row of two images
+  // of the same size.
+  template<class SrcTraits,
+           class DstTraits,
+           class RowFunction>
+  inline void for_each_row_pair(const Image* src, Image* dst, RowFunction f) {
+    static_assert(SrcTraits::pixels_per_byte != 8 &&
+                  DstTraits::pixels_per_byte != 8);
+    ASSERT(src->width() == dst->width());
+    ASSERT(src->height() == dst->height());
+    using src_address_t = typename SrcTraits::const_address_t;
+    using dst_address_t = typename DstTraits::address_t;
+    const int w = src->width();
+    for (int y=0; y<src->height(); ++y)
+      f((src_address_t)src->getPixelAddress(0, y),
+        (dst_address_t)dst->getPixelAddress(0, y), w);
+  }
+
   template<class ImageTraits,
            class UnaryFunction>
   inline void for_each_pixel(const Image* image, UnaryFunction f) {
-    const LockImageBits<ImageTraits> bits(image);
-    std::for_each(bits.begin(), bits.end(), f);
+    if constexpr (ImageTraits::pixels_per_byte == 8) {
+      const LockImageBits<ImageTraits> bits(image);
+      std::for_each(bits.begin(), bits.end(), f);
+    }
+    else {
+      for_each_row<ImageTraits>(
+        image, image->bounds(),
+        [&f](typename ImageTraits::const_address_t p, const int w) {
+          std::for_each(p, p+w, f);
+        });
+    }
   }
 
   template<class ImageTraits,
            class UnaryOperation>
   inline void transform_image(Image* image, UnaryOperation f) {
-    LockImageBits<ImageTraits> bits(image);
-    std::transform(bits.begin(), bits.end(), bits.begin(), f);
+    if constexpr (ImageTraits::pixels_per_byte == 8) {
+      LockImageBits<ImageTraits> bits(image);
+      std::transform(bits.begin(), bits.end(), bits.begin(), f);
+    }
+    else {
+      for_each_row<ImageTraits>(
+        image, image->bounds(),
+        [&f](typename ImageTraits::address_t p, const int w) {
+          std::transform(p, p+w, p, f);
+        });
+    }
+  }
+
+  // Converts each pixel of "src" into "dst" (images of the same size
+  // with different pixel formats).
+  template<class SrcTraits,
+           class DstTraits,
+           class UnaryOperation>
+  inline void transform_image(const Image* src, Image* dst, UnaryOperation f) {
+    for_each_row_pair<SrcTraits, DstTraits>(
+      src, dst,
+      [&f](typename SrcTraits::const_address_t s,
+           typename DstTraits::address_t d, const int w) {
+        std::transform(s, s+w, d, f);
+      });
   }
 
 } // namespace doc
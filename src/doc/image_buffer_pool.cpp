@@ -0,0 +1,91 @@
+// Aseprite Document Library
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/image_buffer_pool.h"
+
+#include <iterator>
+
+namespace doc {
+
+// static
+ImageBufferPool* ImageBufferPool::instance()
+{
+  // Buffers that are released after this pool is destroyed (at exit)
+  // are just deleted (they keep a weak reference to the pool).
+  static std::shared_ptr<ImageBufferPool> pool =
+    std::make_shared<ImageBufferPool>();
+  return pool.get();
+}
+
+ImageBufferPool::~ImageBufferPool()
+{
+  clear();
+}
+
+ImageBufferPtr ImageBufferPool::get(std::size_t size)
+{
+  std::unique_ptr<ImageBuffer> buffer;
+  {
+    const std::lock_guard lock(m_mutex);
+    if (!m_free.empty()) {
+      auto it = m_free.lower_bound(size);
+      if (it == m_free.end())
+        it = std::prev(it);
+      buffer.reset(it->second);
+      m_free.erase(it);
+    }
+  }
+
+  if (buffer)
+    buffer->resizeIfNecessary(size);
+  else
+    buffer = std::make_unique<ImageBuffer>(size);
+
+  std::weak_ptr<ImageBufferPool> pool = weak_from_this();
+  return ImageBufferPtr(
+    buffer.release(),
+    [pool](ImageBuffer* buffer) {
+      if (auto p = pool.lock())
+        p->release(buffer);
+      else
+        delete buffer;
+    });
+}
+
+std::size_t ImageBufferPool::freeBuffers() const
+{
+  const std::lock_guard lock(m_mutex);
+  return m_free.size();
+}
+
+void ImageBufferPool::clear()
+{
+  std::multimap<std::size_t, ImageBuffer*> buffers;
+  {
+    const std::lock_guard lock(m_mutex);
+    buffers.swap(m_free);
+  }
+  for (auto& it : buffers)
+    delete it.second;
+}
+
+void ImageBufferPool::release(ImageBuffer* buffer)
+{
+  {
+    const std::lock_guard lock(m_mutex);
+    if (m_free.size() < kMaxFreeBuffers) {
+      m_free.insert(std::make_pair(buffer->size(), buffer));
+      return;
+    }
+  }
+  delete buffer;
+}
+
+} // namespace doc
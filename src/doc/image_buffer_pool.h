@@ -0,0 +1,54 @@
+// Aseprite Document Library
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_IMAGE_BUFFER_POOL_H_INCLUDED
+#define DOC_IMAGE_BUFFER_POOL_H_INCLUDED
+#pragma once
+
+#include "base/disable_copying.h"
+#include "doc/image_buffer.h"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace doc {
+
+  // Thread-safe pool of buffers for temporary images. get() returns
+  // a buffer that nobody else is using, and it goes back to the pool
+  // automatically when its last ImageBufferPtr reference is destroyed
+  // (e.g. when the Image created with it is deleted).
+  class ImageBufferPool : public std::enable_shared_from_this<ImageBufferPool> {
+  public:
+    // Maximum number of unused buffers kept in the pool.
+    static constexpr std::size_t kMaxFreeBuffers = 8;
+
+    static ImageBufferPool* instance();
+
+    ImageBufferPool() { }
+    ~ImageBufferPool();
+
+    // Returns the smallest unused buffer with at least "size" bytes,
+    // or the biggest one resized to "size".
+    ImageBufferPtr get(std::size_t size = 1);
+
+    std::size_t freeBuffers() const;
+    void clear();
+
+  private:
+    void release(ImageBuffer* buffer);
+
+    mutable std::mutex m_mutex;
+    // Unused buffers sorted by size
+    std::multimap<std::size_t, ImageBuffer*> m_free;
+
+    DISABLE_COPYING(ImageBufferPool);
+  };
+
+} // namespace doc
+
+#endif
@@ -0,0 +1,93 @@
+// Aseprite Document Library
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/image_buffer_pool.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace doc;
+
+TEST(ImageBufferPool, ReuseBuffers)
+{
+  auto pool = std::make_shared<ImageBufferPool>();
+
+  ImageBuffer* raw;
+  {
+    ImageBufferPtr a = pool->get(1000);
+    EXPECT_LE(1000, a->size());
+    raw = a.get();
+    EXPECT_EQ(0, pool->freeBuffers());
+  }
+  EXPECT_EQ(1, pool->freeBuffers());
+
+  // The same buffer is returned (resized if needed)
+  ImageBufferPtr b = pool->get(500);
+  EXPECT_EQ(raw, b.get());
+  EXPECT_EQ(0, pool->freeBuffers());
+
+  ImageBufferPtr c = pool->get(4000);
+  EXPECT_NE(raw, c.get());
+  EXPECT_LE(4000, c->size());
+
+  b.reset();
+  c.reset();
+  EXPECT_EQ(2, pool->freeBuffers());
+
+  // The smallest buffer that fits is used
+  ImageBufferPtr d = pool->get(100);
+  EXPECT_EQ(raw, d.get());
+}
+
+TEST(ImageBufferPool, MaxFreeBuffers)
+{
+  auto pool = std::make_shared<ImageBufferPool>();
+  {
+    std::vector<ImageBufferPtr> bufs;
+    for (int i=0; i<20; ++i)
+      bufs.push_back(pool->get(64));
+  }
+  EXPECT_EQ(ImageBufferPool::kMaxFreeBuffers, pool->freeBuffers());
+
+  // Buffers released after the pool is destroyed are deleted
+  ImageBufferPtr a = pool->get(64);
+  pool.reset();
+  a.reset();
+}
+
+TEST(ImageBufferPool, Threads)
+{
+  auto pool = std::make_shared<ImageBufferPool>();
+  std::vector<std::thread> threads;
+  for (int t=0; t<4; ++t) {
+    threads.emplace_back([pool]{
+      for (int i=0; i<1000; ++i) {
+        ImageBufferPtr a = pool->get(16*(i % 8 + 1));
+        ImageBufferPtr b = pool->get(32);
+        EXPECT_NE(a.get(), b.get());
+        a->buffer()[0] = 1;
+        b->buffer()[0] = 2;
+        EXPECT_EQ(1, a->buffer()[0]);
+      }
+    });
+  }
+  for (auto& t : threads)
+    t.join();
+  EXPECT_GE(ImageBufferPool::kMaxFreeBuffers, pool->freeBuffers());
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -30,7 +30,12 @@ using namespace base::serialization::little_endian;
 
 bool write_image(std::ostream& os, const Image* image, CancelIO* cancel)
 {
-  write32(os, image->id());
+  return write_image(os, image, image->id(), cancel);
+}
+
+bool write_image(std::ostream& os, const Image* image, ObjectId id, CancelIO* cancel)
+{
+  write32(os, id);
   write8(os, image->pixelFormat());    // Pixel format
   write16(os, image->width());         // Width
   write16(os, image->height());        // Height
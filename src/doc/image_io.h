@@ -1,4 +1,5 @@
 // Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -8,6 +9,8 @@
 #define DOC_IMAGE_IO_H_INCLUDED
 #pragma once
 
+#include "doc/object_id.h"
+
 #include <iosfwd>
 
 namespace doc {
@@ -16,6 +19,10 @@ namespace doc {
   class Image;
 
   bool write_image(std::ostream& os, const Image* image, CancelIO* cancel = nullptr);
+
+  // Writes the image with the given ID (e.g. to write a copy of an
+  // image as if it were the original one).
+  bool write_image(std::ostream& os, const Image* image, ObjectId id, CancelIO* cancel = nullptr);
   Image* read_image(std::istream& is, bool setId = true);
 
 } // namespace doc
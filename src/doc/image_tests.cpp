@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -225,6 +225,35 @@ TYPED_TEST(ImageAllTypes, FillRect)
   }
 }
 
+TEST(Image, RowSpans)
+{
+  std::unique_ptr<Image> a(Image::create(IMAGE_INDEXED, 7, 5));
+  for (int y=0; y<5; ++y)
+    for (int x=0; x<7; ++x)
+      put_pixel_fast<IndexedTraits>(a.get(), x, y, y*7+x);
+
+  // Each row span of the area contains the pixels of that row
+  int y = 1;
+  for_each_row<IndexedTraits>(
+    (const Image*)a.get(), gfx::Rect(2, 1, 4, 3),
+    [&y](const uint8_t* p, const int w) {
+      EXPECT_EQ(4, w);
+      for (int x=0; x<w; ++x)
+        EXPECT_EQ(y*7+x+2, p[x]);
+      ++y;
+    });
+  EXPECT_EQ(4, y);
+
+  // Conversion between different pixel formats
+  std::unique_ptr<Image> b(Image::create(IMAGE_RGB, 7, 5));
+  transform_image<IndexedTraits, RgbTraits>(
+    a.get(), b.get(),
+    [](const color_t c) -> color_t { return rgba(c, 0, 0, 255); });
+  for (int y=0; y<5; ++y)
+    for (int x=0; x<7; ++x)
+      EXPECT_EQ(rgba(y*7+x, 0, 0, 255), get_pixel_fast<RgbTraits>(b.get(), x, y));
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -19,7 +19,11 @@ namespace doc {
 
     struct image_hash {
       size_t operator()(const ImageRef& i) const {
-        return calculate_image_hash(i.get(), i->bounds());
+        const uint64_t hash = calculate_image_hash64(i.get());
+        if constexpr (sizeof(size_t) < sizeof(uint64_t))
+          return size_t(hash ^ (hash >> 32));
+        else
+          return size_t(hash);
       }
     };
 
@@ -11,6 +11,7 @@
 
 #include "doc/frame.h"
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -163,20 +164,18 @@ namespace doc {
     std::size_t size() const { return m_keys.size(); }
     bool empty() const { return m_keys.empty(); }
 
+    // Returns the last key with a frame less than or equal to the
+    // given frame, or the first key if the frame is before all keys.
+    // Keys are sorted by frame, so we use a binary search.
     iterator getIterator(const frame_t frame) {
-      auto
-        it = m_keys.begin(),
-        end = m_keys.end();
-      auto next = it;
-      for (; it != end; it=next) {
-        ++next;
-        if (((frame >= it->frame()) &&
-             (next == end || frame < next->frame())) ||
-            (frame < it->frame())) {
-          return it;
-        }
-      }
-      return end;
+      auto it = std::upper_bound(
+        m_keys.begin(), m_keys.end(), frame,
+        [](const frame_t frame, const Key& key) {
+          return frame < key.frame();
+        });
+      if (it != m_keys.begin())
+        --it;
+      return it;
     }
 
     frame_t fromFrame() const {
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2022 Igara Studio S.A.
+// Copyright (c) 2022-2024 Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -139,6 +139,21 @@ TEST(Keyframes, BugEmptyCount)
   EXPECT_EQ(5, **k.range(8, 9).begin());
 }
 
+TEST(Keyframes, ManyKeys)
+{
+  Keyframes<int> k;
+  for (int i=1; i<1000; i+=3)
+    k.insert(i, std::make_unique<int>(i));
+
+  EXPECT_EQ(nullptr, k[0]);
+  for (int frame=1; frame<1100; ++frame)
+    EXPECT_EQ(std::min(997, frame - (frame-1)%3), *k[frame]);
+
+  k.remove(500);
+  EXPECT_EQ(496, *k[500]);
+  EXPECT_EQ(502, *k[502]);
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019-2021  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -15,6 +15,7 @@
 #include "doc/grid.h"
 #include "doc/image.h"
 #include "doc/primitives.h"
+#include "doc/render_plan.h"
 #include "doc/sprite.h"
 
 #include <algorithm>
@@ -158,6 +159,22 @@ Layer* Layer::getNextInWholeHierarchy() const
   return nullptr;
 }
 
+void Layer::setFlags(LayerFlags flags)
+{
+  if (m_flags != flags) {
+    m_flags = flags;
+    RenderPlan::incrementStructureVersion();
+  }
+}
+
+void Layer::switchFlags(LayerFlags flags, bool state)
+{
+  if (state)
+    setFlags(LayerFlags(int(m_flags) | int(flags)));
+  else
+    setFlags(LayerFlags(int(m_flags) & ~int(flags)));
+}
+
 bool Layer::isVisibleHierarchy() const
 {
   const Layer* layer = this;
@@ -270,6 +287,7 @@ void LayerImage::destroyAllCels()
     delete cel;
   }
   m_cels.clear();
+  RenderPlan::incrementStructureVersion();
 }
 
 Cel* LayerImage::cel(frame_t frame) const
@@ -351,6 +369,7 @@ void LayerImage::addCel(Cel* cel)
   m_cels.insert(it, cel);
 
   cel->setParentLayer(this);
+  RenderPlan::incrementStructureVersion();
 }
 
 /**
@@ -368,6 +387,7 @@ void LayerImage::removeCel(Cel* cel)
   m_cels.erase(it);
 
   cel->setParentLayer(NULL);
+  RenderPlan::incrementStructureVersion();
 }
 
 void LayerImage::moveCel(Cel* cel, frame_t frame)
@@ -398,20 +418,50 @@ void LayerImage::configureAsBackground()
 
 void LayerImage::displaceFrames(frame_t fromThis, frame_t delta)
 {
-  Sprite* sprite = this->sprite();
+  // All cels from "fromThis" are displaced by the same delta, so
+  // their order in m_cels is kept and we can change their frames in
+  // place in one pass (instead of removing/inserting each cel, which
+  // was O(n^2) for layers with a lot of cels).
+  CelIterator it = findFirstCelIteratorAfter(fromThis-1);
+  CelIterator end = getCelEnd();
 
-  if (delta > 0) {
-    for (frame_t c=sprite->lastFrame(); c>=fromThis; --c) {
+  // The cels would not be sorted anymore if a cel before "fromThis"
+  // ends in the same or a later frame than the first displaced cel.
+  if (delta < 0 && it != end && it != getCelBegin() &&
+      (*(it-1))->frame() >= (*it)->frame()+delta) {
+    Sprite* sprite = this->sprite();
+    for (frame_t c=fromThis; c<=sprite->lastFrame(); ++c) {
       if (Cel* cel = this->cel(c))
         moveCel(cel, c+delta);
     }
+    return;
   }
-  else {
-    for (frame_t c=fromThis; c<=sprite->lastFrame(); ++c) {
-      if (Cel* cel = this->cel(c))
-        moveCel(cel, c+delta);
+
+  for (; it != end; ++it) {
+    Cel* cel = *it;
+    cel->m_frame += delta;
+    cel->incrementVersion();    // TODO this should be in app::cmd module
+  }
+  RenderPlan::incrementStructureVersion();
+}
+
+void LayerImage::reorderFrames(const std::vector<frame_t>& newFrames)
+{
+  // Change all frames in place and sort the cels just once (instead
+  // of a moveCel() for each cel).
+  for (Cel* cel : m_cels) {
+    ASSERT(cel->m_frame >= 0 && cel->m_frame < frame_t(newFrames.size()));
+    const frame_t newFrame = newFrames[cel->m_frame];
+    if (cel->m_frame != newFrame) {
+      cel->m_frame = newFrame;
+      cel->incrementVersion();  // TODO this should be in app::cmd module
     }
   }
+  std::sort(m_cels.begin(), m_cels.end(),
+            [](const Cel* a, const Cel* b) {
+              return a->frame() < b->frame();
+            });
+  RenderPlan::incrementStructureVersion();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -433,6 +483,7 @@ void LayerGroup::destroyAllLayers()
   for (Layer* layer : m_layers)
     delete layer;
   m_layers.clear();
+  RenderPlan::incrementStructureVersion();
 }
 
 int LayerGroup::getMemSize() const
@@ -564,6 +615,7 @@ void LayerGroup::addLayer(Layer* layer)
 {
   m_layers.push_back(layer);
   layer->setParent(this);
+  RenderPlan::incrementStructureVersion();
 }
 
 void LayerGroup::removeLayer(Layer* layer)
@@ -573,6 +625,7 @@ void LayerGroup::removeLayer(Layer* layer)
   m_layers.erase(it);
 
   layer->setParent(nullptr);
+  RenderPlan::incrementStructureVersion();
 }
 
 void LayerGroup::insertLayer(Layer* layer, Layer* after)
@@ -586,6 +639,7 @@ void LayerGroup::insertLayer(Layer* layer, Layer* after)
   m_layers.insert(after_it, layer);
 
   layer->setParent(this);
+  RenderPlan::incrementStructureVersion();
 }
 
 void LayerGroup::stackLayer(Layer* layer, Layer* after)
@@ -604,4 +658,10 @@ void LayerGroup::displaceFrames(frame_t fromThis, frame_t delta)
     layer->displaceFrames(fromThis, delta);
 }
 
+void LayerGroup::reorderFrames(const std::vector<frame_t>& newFrames)
+{
+  for (Layer* layer : m_layers)
+    layer->reorderFrames(newFrames);
+}
+
 } // namespace doc
@@ -17,6 +17,7 @@
 #include "doc/with_user_data.h"
 
 #include <string>
+#include <vector>
 
 namespace doc {
 
@@ -114,22 +115,18 @@ namespace doc {
       return (int(m_flags) & int(flags)) == int(flags);
     }
 
-    void setFlags(LayerFlags flags) {
-      m_flags = flags;
-    }
-
-    void switchFlags(LayerFlags flags, bool state) {
-      if (state)
-        m_flags = LayerFlags(int(m_flags) | int(flags));
-      else
-        m_flags = LayerFlags(int(m_flags) & ~int(flags));
-    }
+    void setFlags(LayerFlags flags);
+    void switchFlags(LayerFlags flags, bool state);
 
     virtual Grid grid() const;
     virtual Cel* cel(frame_t frame) const;
     virtual void getCels(CelList& cels) const = 0;
     virtual void displaceFrames(frame_t fromThis, frame_t delta) = 0;
 
+    // Moves the cel of each frame "i" to the frame "newFrames[i]"
+    // ("newFrames" must be a permutation of all sprite frames).
+    virtual void reorderFrames(const std::vector<frame_t>& newFrames) = 0;
+
   private:
     std::string m_name;           // layer name
     Sprite* m_sprite;             // owner of the layer
@@ -164,6 +161,7 @@ namespace doc {
     Cel* cel(frame_t frame) const override;
     void getCels(CelList& cels) const override;
     void displaceFrames(frame_t fromThis, frame_t delta) override;
+    void reorderFrames(const std::vector<frame_t>& newFrames) override;
 
     Cel* getLastCel() const;
     CelConstIterator findCelIterator(frame_t frame) const;
@@ -219,6 +217,7 @@ namespace doc {
 
     void getCels(CelList& cels) const override;
     void displaceFrames(frame_t fromThis, frame_t delta) override;
+    void reorderFrames(const std::vector<frame_t>& newFrames) override;
 
     bool isBrowsable() const override {
       return isGroup() && isExpanded() && !m_layers.empty();
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -12,35 +12,149 @@
 #include "doc/mask.h"
 
 #include "base/memory.h"
+#include "doc/color_matcher.h"
 #include "doc/image_impl.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <thread>
+#include <vector>
 
 namespace doc {
 
 namespace {
 
-  template<typename Func>
-  void for_each_mask_pixel(Mask& a, const Mask& b, Func f) {
-    a.reserve(b.bounds());
-
-    {
-      LockImageBits<BitmapTraits> aBits(a.bitmap());
-      auto aIt = aBits.begin();
-
-      auto bounds = a.bounds();
-      for (int y=0; y<bounds.h; ++y) {
-        for (int x=0; x<bounds.w; ++x, ++aIt) {
-          color_t aColor = *aIt;
-          color_t bColor = (b.containsPoint(bounds.x+x,
-                                            bounds.y+y) ? 1: 0);
-          *aIt = f(aColor, bColor);
-        }
+  // Images with fewer pixels are not worth to be processed in threads.
+  constexpr int kMinParallelPixels = 512*512;
+
+  // Sets each bit of the "dst" bitmap to 1 if the pixel of "src"
+  // matches the color with the given tolerance (in parallel bands of
+  // rows for big images, each row of the bitmap is independent).
+  template<typename ImageTraits>
+  void by_color_rows(const Image* src, Image* dst,
+                     const color_t color, const int tolerance) {
+    const ColorMatcher<ImageTraits> match(color, tolerance, false);
+    const int w = src->width();
+    const int h = src->height();
+
+    auto matchRows = [src, dst, w, &match](const int y1, const int y2) {
+      for (int y=y1; y<y2; ++y) {
+        match_row_bits<ImageTraits>(
+          (typename ImageTraits::const_address_t)src->getPixelAddress(0, y),
+          w, match, dst->getPixelAddress(0, y));
+      }
+    };
+
+    const int nthreads =
+      (w*h >= kMinParallelPixels ?
+       std::clamp(int(std::thread::hardware_concurrency()), 1,
+                  std::min(8, h)): 1);
+    if (nthreads > 1) {
+      std::vector<std::thread> threads;
+      threads.reserve(nthreads);
+      const int bandHeight = (h + nthreads - 1) / nthreads;
+      for (int i=0; i<nthreads; ++i) {
+        const int y1 = std::min(h, i*bandHeight);
+        const int y2 = std::min(h, y1+bandHeight);
+        threads.emplace_back(matchRows, y1, y2);
+      }
+      for (auto& thread : threads)
+        thread.join();
+    }
+    else {
+      matchRows(0, h);
+    }
+  }
+
+  enum class MaskOp { Add, Subtract, Intersect };
+
+  // Returns the bits of the last byte of a bitmap row that are
+  // inside the image (bits of pixels at the right side are garbage).
+  inline uint8_t last_byte_mask(const int width) {
+    return (width % 8 ? uint8_t((1 << (width % 8)) - 1): uint8_t(0xff));
+  }
+
+  // Copies the "srcW" pixels of the "src" bitmap row in the "dst"
+  // row starting at the "dx" pixel (which can be negative), clearing
+  // all other pixels of "dst". Bitmaps have 8 pixels per byte with
+  // the first pixel in the least significant bit, so each dst byte
+  // is the combination of two src bytes.
+  void shift_bitmap_row(const uint8_t* src, const int srcW, const int dx,
+                        uint8_t* dst, const int dstW) {
+    const int dstBytes = BitmapTraits::width_bytes(dstW);
+    const int srcBytes = BitmapTraits::width_bytes(srcW);
+    std::fill(dst, dst+dstBytes, 0);
+
+    const int x1 = std::max(0, dx);
+    const int x2 = std::min(dstW, dx+srcW);
+    if (x1 >= x2)
+      return;
+
+    const int s = ((-dx) % 8 + 8) % 8;  // Bit shift of src bytes
+    int k = (x1/8*8 - dx - s) / 8;      // First src byte to read
+    for (int j=x1/8; j<=(x2-1)/8; ++j, ++k) {
+      const uint8_t lo = (k >= 0 && k < srcBytes ? src[k]: 0);
+      const uint8_t hi = (k+1 >= 0 && k+1 < srcBytes ? src[k+1]: 0);
+      uint8_t bits = uint8_t((lo >> s) | (s ? hi << (8-s): 0));
+
+      // Remove the bits outside [x1, x2)
+      if (j*8 < x1) bits &= uint8_t(0xff << (x1 - j*8));
+      if (j*8+8 > x2) bits &= uint8_t(0xff >> (j*8+8 - x2));
+      dst[j] = bits;
+    }
+  }
+
+  // Combines the "src" row with the "dst" row, 64 pixels at a time.
+  void combine_bitmap_rows(uint8_t* dst, const uint8_t* src,
+                           const int nbytes, const MaskOp op) {
+    int i = 0;
+    for (; i+8<=nbytes; i+=8) {
+      uint64_t a, b;
+      std::memcpy(&a, dst+i, 8);
+      std::memcpy(&b, src+i, 8);
+      switch (op) {
+        case MaskOp::Add:       a |= b; break;
+        case MaskOp::Subtract:  a &= ~b; break;
+        case MaskOp::Intersect: a &= b; break;
+      }
+      std::memcpy(dst+i, &a, 8);
+    }
+    for (; i<nbytes; ++i) {
+      switch (op) {
+        case MaskOp::Add:       dst[i] |= src[i]; break;
+        case MaskOp::Subtract:  dst[i] &= ~src[i]; break;
+        case MaskOp::Intersect: dst[i] &= src[i]; break;
       }
     }
+  }
+
+  // Combines the bitmap of "b" in the bitmap of "a" (which must
+  // contain the bounds of "b" for the Add operation).
+  void combine_masks(Mask& a, const Mask& b, const MaskOp op) {
+    Image* dst = a.bitmap();
+    const Image* src = b.bitmap();
+    const gfx::Rect aBounds = a.bounds();
+    const gfx::Rect bBounds = b.bounds();
+    const int dstBytes = BitmapTraits::width_bytes(aBounds.w);
+    const int dx = bBounds.x - aBounds.x;
+    std::vector<uint8_t> row(dstBytes);
+
+    for (int y=0; y<aBounds.h; ++y) {
+      uint8_t* dstRow = dst->getPixelAddress(0, y);
+      const int v = aBounds.y + y - bBounds.y;
+
+      if (v < 0 || v >= bBounds.h) {
+        if (op == MaskOp::Intersect)
+          std::fill(dstRow, dstRow+dstBytes, 0);
+        continue;
+      }
 
-    a.shrink();
+      shift_bitmap_row(src->getPixelAddress(0, v), bBounds.w, dx,
+                       row.data(), aBounds.w);
+      combine_bitmap_rows(dstRow, row.data(), dstBytes, op);
+    }
   }
 
 } // namespace namespace
@@ -100,11 +214,16 @@ bool Mask::isRectangular() const
   if (!m_bitmap)
     return false;
 
-  LockImageBits<BitmapTraits> bits(m_bitmap.get());
-  LockImageBits<BitmapTraits>::iterator it = bits.begin(), end = bits.end();
+  const int nbytes = BitmapTraits::width_bytes(m_bounds.w);
+  const uint8_t lastMask = last_byte_mask(m_bounds.w);
 
-  for (; it != end; ++it) {
-    if (*it == 0)
+  for (int y=0; y<m_bounds.h; ++y) {
+    const uint8_t* row = m_bitmap->getPixelAddress(0, y);
+    for (int i=0; i<nbytes-1; ++i) {
+      if (row[i] != 0xff)
+        return false;
+    }
+    if ((row[nbytes-1] & lastMask) != lastMask)
       return false;
   }
 
@@ -145,11 +264,15 @@ void Mask::invert()
   if (!m_bitmap)
     return;
 
-  LockImageBits<BitmapTraits> bits(m_bitmap.get());
-  LockImageBits<BitmapTraits>::iterator it = bits.begin(), end = bits.end();
+  const int nbytes = BitmapTraits::width_bytes(m_bounds.w);
+  const uint8_t lastMask = last_byte_mask(m_bounds.w);
 
-  for (; it != end; ++it)
-    *it = (*it ? 0: 1);
+  for (int y=0; y<m_bounds.h; ++y) {
+    uint8_t* row = m_bitmap->getPixelAddress(0, y);
+    for (int i=0; i<nbytes; ++i)
+      row[i] = ~row[i];
+    row[nbytes-1] &= lastMask;
+  }
 
   shrink();
 }
@@ -169,32 +292,35 @@ void Mask::replace(const gfx::Rect& bounds)
 
 void Mask::add(const doc::Mask& mask)
 {
-  for_each_mask_pixel(
-    *this, mask,
-    [](color_t a, color_t b) -> color_t {
-      return a | b;
-    });
+  if (!mask.bitmap())
+    return;
+
+  reserve(mask.bounds());
+  combine_masks(*this, mask, MaskOp::Add);
+  shrink();
 }
 
 void Mask::subtract(const doc::Mask& mask)
 {
-  for_each_mask_pixel(
-    *this, mask,
-    [](color_t a, color_t b) -> color_t {
-      if (a)
-        return a - b;
-      else
-        return 0;
-    });
+  if (!m_bitmap || !mask.bitmap())
+    return;
+
+  combine_masks(*this, mask, MaskOp::Subtract);
+  shrink();
 }
 
 void Mask::intersect(const doc::Mask& mask)
 {
-  for_each_mask_pixel(
-    *this, mask,
-    [](color_t a, color_t b) -> color_t {
-      return a & b;
-    });
+  if (!m_bitmap)
+    return;
+
+  if (!mask.bitmap()) {
+    clear();
+    return;
+  }
+
+  combine_masks(*this, mask, MaskOp::Intersect);
+  shrink();
 }
 
 void Mask::add(const gfx::Rect& bounds)
@@ -258,99 +384,15 @@ void Mask::byColor(const Image *src, int color, int fuzziness)
   Image* dst = m_bitmap.get();
 
   switch (src->pixelFormat()) {
-
-    case IMAGE_RGB: {
-      const LockImageBits<RgbTraits> srcBits(src);
-      LockImageBits<BitmapTraits> dstBits(dst, Image::WriteLock);
-      LockImageBits<RgbTraits>::const_iterator src_it = srcBits.begin(), src_end = srcBits.end();
-      LockImageBits<BitmapTraits>::iterator dst_it = dstBits.begin();
-#ifdef _DEBUG
-      LockImageBits<BitmapTraits>::iterator dst_end = dstBits.end();
-#endif
-      int src_r, src_g, src_b, src_a;
-      int dst_r, dst_g, dst_b, dst_a;
-      color_t c;
-
-      dst_r = rgba_getr(color);
-      dst_g = rgba_getg(color);
-      dst_b = rgba_getb(color);
-      dst_a = rgba_geta(color);
-
-      for (; src_it != src_end; ++src_it, ++dst_it) {
-        ASSERT(dst_it != dst_end);
-        c = *src_it;
-
-        src_r = rgba_getr(c);
-        src_g = rgba_getg(c);
-        src_b = rgba_getb(c);
-        src_a = rgba_geta(c);
-
-        if (!((src_r >= dst_r-fuzziness) && (src_r <= dst_r+fuzziness) &&
-              (src_g >= dst_g-fuzziness) && (src_g <= dst_g+fuzziness) &&
-              (src_b >= dst_b-fuzziness) && (src_b <= dst_b+fuzziness) &&
-              (src_a >= dst_a-fuzziness) && (src_a <= dst_a+fuzziness)))
-          *dst_it = 0;
-      }
-      ASSERT(dst_it == dst_end);
+    case IMAGE_RGB:
+      by_color_rows<RgbTraits>(src, dst, color, fuzziness);
       break;
-    }
-
-    case IMAGE_GRAYSCALE: {
-      const LockImageBits<GrayscaleTraits> srcBits(src);
-      LockImageBits<BitmapTraits> dstBits(dst, Image::WriteLock);
-      LockImageBits<GrayscaleTraits>::const_iterator src_it = srcBits.begin(), src_end = srcBits.end();
-      LockImageBits<BitmapTraits>::iterator dst_it = dstBits.begin();
-#ifdef _DEBUG
-      LockImageBits<BitmapTraits>::iterator dst_end = dstBits.end();
-#endif
-      int src_k, src_a;
-      int dst_k, dst_a;
-      color_t c;
-
-      dst_k = graya_getv(color);
-      dst_a = graya_geta(color);
-
-      for (; src_it != src_end; ++src_it, ++dst_it) {
-        ASSERT(dst_it != dst_end);
-        c = *src_it;
-
-        src_k = graya_getv(c);
-        src_a = graya_geta(c);
-
-        if (!((src_k >= dst_k-fuzziness) && (src_k <= dst_k+fuzziness) &&
-              (src_a >= dst_a-fuzziness) && (src_a <= dst_a+fuzziness)))
-          *dst_it = 0;
-      }
-      ASSERT(dst_it == dst_end);
+    case IMAGE_GRAYSCALE:
+      by_color_rows<GrayscaleTraits>(src, dst, color, fuzziness);
       break;
-    }
-
-    case IMAGE_INDEXED: {
-      const LockImageBits<IndexedTraits> srcBits(src);
-      LockImageBits<BitmapTraits> dstBits(dst, Image::WriteLock);
-      LockImageBits<IndexedTraits>::const_iterator src_it = srcBits.begin(), src_end = srcBits.end();
-      LockImageBits<BitmapTraits>::iterator dst_it = dstBits.begin();
-#ifdef _DEBUG
-      LockImageBits<BitmapTraits>::iterator dst_end = dstBits.end();
-#endif
-      color_t c, min, max;
-
-      for (; src_it != src_end; ++src_it, ++dst_it) {
-        ASSERT(dst_it != dst_end);
-        c = *src_it;
-
-        if (color > fuzziness)
-          min = color-fuzziness;
-        else
-          min = 0;
-        max = color + fuzziness;
-
-        if (!((c >= min) && (c <= max)))
-          *dst_it = 0;
-      }
-      ASSERT(dst_it == dst_end);
+    case IMAGE_INDEXED:
+      by_color_rows<IndexedTraits>(src, dst, color, fuzziness);
       break;
-    }
   }
 
   shrink();
@@ -452,61 +494,64 @@ void Mask::shrink()
   if (m_freeze_count > 0)
     return;
 
-#define SHRINK_SIDE(u_begin, u_op, u_final, u_add,                      \
-                    v_begin, v_op, v_final, v_add, U, V, var)           \
-  {                                                                     \
-    for (u = u_begin; u u_op u_final; u u_add) {                        \
-      for (v = v_begin; v v_op v_final; v v_add) {                      \
-        if (get_pixel_fast<BitmapTraits>(m_bitmap.get(), U, V))         \
-          break;                                                        \
-      }                                                                 \
-      if (v == v_final)                                                 \
-        var;                                                            \
-      else                                                              \
-        break;                                                          \
-    }                                                                   \
-  }
-
-  int u, v, x1, y1, x2, y2;
-
-  x1 = m_bounds.x;
-  y1 = m_bounds.y;
-  x2 = m_bounds.x+m_bounds.w-1;
-  y2 = m_bounds.y+m_bounds.h-1;
-
-  SHRINK_SIDE(0, <, m_bounds.w, ++,
-              0, <, m_bounds.h, ++, u, v, x1++);
-
-  SHRINK_SIDE(0, <, m_bounds.h, ++,
-              0, <, m_bounds.w, ++, v, u, y1++);
-
-  SHRINK_SIDE(m_bounds.w-1, >, 0, --,
-              0, <, m_bounds.h, ++, u, v, x2--);
+  if (!m_bitmap)
+    return;
 
-  SHRINK_SIDE(m_bounds.h-1, >, 0, --,
-              0, <, m_bounds.w, ++, v, u, y2--);
+  // Find the first/last rows with selected pixels, and accumulate
+  // the bits of all rows to find the first/last selected columns.
+  const int nbytes = BitmapTraits::width_bytes(m_bounds.w);
+  const uint8_t lastMask = last_byte_mask(m_bounds.w);
+  std::vector<uint8_t> cols(nbytes, 0);
+  int y1 = -1, y2 = -1;
+
+  for (int y=0; y<m_bounds.h; ++y) {
+    const uint8_t* row = m_bitmap->getPixelAddress(0, y);
+    uint8_t any = (row[nbytes-1] & lastMask);
+    cols[nbytes-1] |= any;
+    for (int i=0; i<nbytes-1; ++i) {
+      cols[i] |= row[i];
+      any |= row[i];
+    }
+    if (any) {
+      if (y1 < 0)
+        y1 = y;
+      y2 = y;
+    }
+  }
 
-  if ((x1 > x2) || (y1 > y2)) {
+  if (y1 < 0) {
     clear();
+    return;
   }
-  else if ((x1 != m_bounds.x) || (x2 != m_bounds.x+m_bounds.w-1) ||
-           (y1 != m_bounds.y) || (y2 != m_bounds.y+m_bounds.h-1)) {
-    u = m_bounds.x;
-    v = m_bounds.y;
-
-    m_bounds.x = x1;
-    m_bounds.y = y1;
-    m_bounds.w = x2 - x1 + 1;
-    m_bounds.h = y2 - y1 + 1;
 
+  int x1 = 0, x2 = m_bounds.w-1;
+  int i = 0;
+  while (!cols[i])
+    ++i;
+  x1 = i*8;
+  while (!(cols[i] & (1 << (x1 % 8))))
+    ++x1;
+
+  i = nbytes-1;
+  while (!cols[i])
+    --i;
+  x2 = i*8+7;
+  while (!(cols[i] & (1 << (x2 % 8))))
+    --x2;
+
+  if (x1 != 0 || y1 != 0 ||
+      x2 != m_bounds.w-1 || y2 != m_bounds.h-1) {
     Image* image = crop_image(
       m_bitmap.get(),
-      m_bounds.x-u, m_bounds.y-v,
-      m_bounds.w, m_bounds.h, 0);
+      x1, y1,
+      x2 - x1 + 1, y2 - y1 + 1, 0);
     m_bitmap.reset(image);
-  }
 
-#undef SHRINK_SIDE
+    m_bounds.x += x1;
+    m_bounds.y += y1;
+    m_bounds.w = x2 - x1 + 1;
+    m_bounds.h = y2 - y1 + 1;
+  }
 }
 
 } // namespace doc
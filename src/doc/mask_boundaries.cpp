@@ -1,4 +1,5 @@
 // Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
 // Copyright (c) 2001-2015 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -11,14 +12,261 @@
 #include "doc/mask_boundaries.h"
 
 #include "doc/image_impl.h"
+#include "doc/primitives.h"
+
+#include <algorithm>
+#include <cstring>
 
 namespace doc {
 
+namespace {
+
+// Returns the pixel of a bitmap placed in "origin" (pixels outside
+// the bitmap are 0).
+inline bool get_bit(const Image* bitmap,
+                    const gfx::Point& origin,
+                    int x, int y)
+{
+  x -= origin.x;
+  y -= origin.y;
+  return (x >= 0 && y >= 0 &&
+          x < bitmap->width() &&
+          y < bitmap->height() &&
+          get_pixel_fast<BitmapTraits>(bitmap, x, y));
+}
+
+// Returns the bounds (in the bitmaps coordinates) of the pixels that
+// are different between two bitmaps.
+gfx::Rect calc_modified_area(const Image* a, const gfx::Point& aOrigin,
+                             const Image* b, const gfx::Point& bOrigin)
+{
+  const gfx::Rect aBounds(aOrigin, a->size());
+  const gfx::Rect bBounds(bOrigin, b->size());
+  const gfx::Rect bounds = aBounds.createUnion(bBounds);
+  gfx::Rect result;
+
+  for (int y=bounds.y; y<bounds.y2(); ++y) {
+    // Fast path: compare the bytes of rows with the same X position
+    // and bit alignment.
+    int x1 = bounds.x;
+    int x2 = bounds.x2();
+    if (aOrigin.x == bOrigin.x &&
+        y >= aBounds.y && y < aBounds.y2() &&
+        y >= bBounds.y && y < bBounds.y2()) {
+      const uint8_t* aRow = a->getPixelAddress(0, y-aOrigin.y);
+      const uint8_t* bRow = b->getPixelAddress(0, y-bOrigin.y);
+      const int nbytes = std::min(a->width(), b->width()) / 8;
+      if (std::memcmp(aRow, bRow, nbytes) == 0)
+        x1 = aOrigin.x + nbytes*8;
+      else {
+        int i = 0;
+        while (aRow[i] == bRow[i])
+          ++i;
+        int j = nbytes-1;
+        while (aRow[j] == bRow[j])
+          --j;
+        result |= gfx::Rect(aOrigin.x + i*8, y, (j-i+1)*8, 1);
+        x1 = aOrigin.x + nbytes*8;
+      }
+    }
+
+    // Compare the rest of pixels one by one
+    int first = -1, last = -1;
+    for (int x=x1; x<x2; ++x) {
+      if (get_bit(a, aOrigin, x, y) != get_bit(b, bOrigin, x, y)) {
+        if (first < 0)
+          first = x;
+        last = x;
+      }
+    }
+    if (first >= 0)
+      result |= gfx::Rect(first, y, last-first+1, 1);
+  }
+  return result;
+}
+
+inline bool get_row_bit(const uint8_t* row, const int x)
+{
+  return (row[x >> 3] & (1 << (x & 7))) ? true: false;
+}
+
+// Returns the first byte (from "i") of the given bitmap rows where
+// some pixel of "row" or "prevRow" is not equal to "color" (or
+// "nbytes" if all pixels are equal). Bytes are compared 8 at a
+// time when it's possible.
+int skip_equal_bytes(const uint8_t* row,
+                     const uint8_t* prevRow,
+                     int i,
+                     const int nbytes,
+                     const bool color)
+{
+  const uint8_t fill = (color ? 0xff: 0);
+  const uint64_t fill64 = (color ? ~uint64_t(0): 0);
+  for (; i+8 <= nbytes; i+=8) {
+    uint64_t a, b;
+    std::memcpy(&a, row+i, 8);
+    std::memcpy(&b, prevRow+i, 8);
+    if (a != fill64 || b != fill64)
+      break;
+  }
+  for (; i < nbytes; ++i) {
+    if (row[i] != fill || prevRow[i] != fill)
+      break;
+  }
+  return i;
+}
+
+} // anonymous namespace
+
 void MaskBoundaries::reset()
 {
   m_segs.clear();
   if (!m_path.isEmpty())
     m_path.rewind();
+  m_bitmap.reset();
+}
+
+void MaskBoundaries::regen(const Image* bitmap, const gfx::Point& origin)
+{
+  ASSERT(bitmap->pixelFormat() == IMAGE_BITMAP);
+
+  gfx::Rect area;
+  if (m_bitmap) {
+    area = calc_modified_area(m_bitmap.get(), m_origin, bitmap, origin);
+
+    // Nothing to do
+    if (area.isEmpty()) {
+      m_bitmap.reset(Image::createCopy(bitmap));
+      m_origin = origin;
+      return;
+    }
+
+    // Regenerate everything if a big part of the bitmap was modified
+    const gfx::Rect bounds =
+      gfx::Rect(m_origin, m_bitmap->size()).createUnion(
+        gfx::Rect(origin, bitmap->size()));
+    if (int64_t(area.w) * area.h > int64_t(bounds.w) * bounds.h / 2)
+      area = gfx::Rect();
+  }
+
+  if (area.isEmpty()) {
+    regen(bitmap);
+    offset(origin.x, origin.y);
+  }
+  else {
+    regenArea(bitmap, origin, area);
+  }
+
+  if (bitmap->width() * bitmap->height() >= kMinIncrementalPixels) {
+    m_bitmap.reset(Image::createCopy(bitmap));
+    m_origin = origin;
+  }
+  else
+    m_bitmap.reset();
+}
+
+// Replaces the segments that are in the edges of the pixels in the
+// given area (sprite coordinates) with the new segments of the
+// bitmap. The new segments are not merged with the old ones that are
+// adjacent to the area (so there can be more segments than in a full
+// regen(), but the same path is drawn).
+void MaskBoundaries::regenArea(const Image* bitmap,
+                               const gfx::Point& origin,
+                               const gfx::Rect& area)
+{
+  // Remove the old segments (or parts of segments) in the area
+  list_type segs;
+  segs.reserve(m_segs.size());
+  for (const Segment& seg : m_segs) {
+    const gfx::Rect& rc = seg.bounds();
+    int pos, from, to;            // Position and range of the segment
+    int areaFrom, areaTo;         // Range of the area in that axis
+    bool inside;
+    if (seg.vertical()) {
+      pos = rc.x;
+      from = rc.y;
+      to = rc.y2();
+      inside = (pos >= area.x && pos <= area.x2());
+      areaFrom = area.y;
+      areaTo = area.y2();
+    }
+    else {
+      pos = rc.y;
+      from = rc.x;
+      to = rc.x2();
+      inside = (pos >= area.y && pos <= area.y2());
+      areaFrom = area.x;
+      areaTo = area.x2();
+    }
+
+    if (!inside || to <= areaFrom || from >= areaTo) {
+      segs.push_back(seg);
+      continue;
+    }
+
+    auto addPart = [&segs, &seg, pos](int a, int b){
+      if (a >= b)
+        return;
+      if (seg.vertical())
+        segs.push_back(Segment(seg.open(), gfx::Rect(pos, a, 0, b-a)));
+      else
+        segs.push_back(Segment(seg.open(), gfx::Rect(a, pos, b-a, 0)));
+    };
+    addPart(from, areaFrom);
+    addPart(areaTo, to);
+  }
+
+  // Horizontal segments (between rows y-1 and y) in the area
+  for (int y=area.y; y<=area.y2(); ++y) {
+    bool inSeg = false;
+    bool segOpen = false;
+    int segStart = 0;
+    for (int x=area.x; x<=area.x2(); ++x) {
+      bool edge = false, open = false;
+      if (x < area.x2()) {
+        const bool above = get_bit(bitmap, origin, x, y-1);
+        open = get_bit(bitmap, origin, x, y);
+        edge = (above != open);
+      }
+      if (inSeg && (!edge || open != segOpen)) {
+        segs.push_back(Segment(segOpen, gfx::Rect(segStart, y, x-segStart, 0)));
+        inSeg = false;
+      }
+      if (edge && !inSeg) {
+        inSeg = true;
+        segOpen = open;
+        segStart = x;
+      }
+    }
+  }
+
+  // Vertical segments (between columns x-1 and x) in the area
+  for (int x=area.x; x<=area.x2(); ++x) {
+    bool inSeg = false;
+    bool segOpen = false;
+    int segStart = 0;
+    for (int y=area.y; y<=area.y2(); ++y) {
+      bool edge = false, open = false;
+      if (y < area.y2()) {
+        const bool left = get_bit(bitmap, origin, x-1, y);
+        open = get_bit(bitmap, origin, x, y);
+        edge = (left != open);
+      }
+      if (inSeg && (!edge || open != segOpen)) {
+        segs.push_back(Segment(segOpen, gfx::Rect(x, segStart, 0, y-segStart)));
+        inSeg = false;
+      }
+      if (edge && !inSeg) {
+        inSeg = true;
+        segOpen = open;
+        segStart = y;
+      }
+    }
+  }
+
+  std::swap(m_segs, segs);
+  if (!m_path.isEmpty())
+    m_path.rewind();
 }
 
 void MaskBoundaries::regen(const Image* bitmap)
@@ -27,12 +275,6 @@ void MaskBoundaries::regen(const Image* bitmap)
 
   int x, y, w = bitmap->width(), h = bitmap->height();
 
-  const LockImageBits<BitmapTraits> bits(bitmap);
-  auto it = bits.begin();       // Current pixel iterator
-#if _DEBUG
-  auto prevIt = bits.begin();   // Previous row iterator (same X pos)
-#endif
-
   // Vertical segments being expanded from the previous row.
   std::vector<int> vertSegs(w+1, -1);
 
@@ -63,13 +305,30 @@ void MaskBoundaries::regen(const Image* bitmap)
   }
 
   for (y=0; y<=h; ++y) {
+    const uint8_t* row = (y < h ? bitmap->getPixelAddress(0, y): nullptr);
+    const uint8_t* prevRow = (y > 0 ? bitmap->getPixelAddress(0, y-1): nullptr);
     bool prevColor = false;         // Previous color (X-1) same Y row
     horzSeg = -1;
 
     for (x=0; x<=w; ++x) {
-      bool color = (x < w && y < h && *it ? true: false);
+      // Skip the bytes where all pixels of this and the previous row
+      // are equal to the previous pixel (X-1) of both rows. There are
+      // no edges there, so no segment is created/expanded (the
+      // horizontal segment and the vertical segments of those
+      // columns are already stopped).
+      if (row && prevRow && x > 0 && (x & 7) == 0 &&
+          horzSeg < 0 && get_row_bit(prevRow, x-1) == prevColor) {
+        const int i = skip_equal_bytes(row, prevRow, x >> 3, w >> 3, prevColor);
+#if _DEBUG
+        for (int u=x; u<(i << 3); ++u)
+          ASSERT(vertSegs[u] < 0);
+#endif
+        x = (i << 3);
+      }
+
+      bool color = (x < w && row && get_row_bit(row, x));
 #if _DEBUG
-      bool prevRowColor = (x < w && y > 0 && *prevIt ? true: false);
+      bool prevRowColor = (x < w && prevRow && get_row_bit(prevRow, x));
 #endif
       Segment* hseg = (horzSeg >= 0 ? &m_segs[horzSeg]: nullptr);
       Segment* vseg = (vertSegs[x] >= 0 ? &m_segs[vertSegs[x]]: nullptr);
@@ -326,17 +585,8 @@ void MaskBoundaries::regen(const Image* bitmap)
       }
 
       prevColor = color;
-      if (x < w) {
-#if _DEBUG
-        if (y > 0) ++prevIt;
-#endif
-        if (y < h) ++it;
-      }
     }
   }
-
-  ASSERT(it == bits.end());
-  ASSERT(prevIt == bits.end());
 }
 
 void MaskBoundaries::offset(int x, int y)
@@ -345,6 +595,7 @@ void MaskBoundaries::offset(int x, int y)
     seg.offset(x, y);
 
   m_path.offset(x, y);
+  m_origin += gfx::Point(x, y);
 }
 
 void MaskBoundaries::createPathIfNeeeded()
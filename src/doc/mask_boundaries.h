@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2020 Igara Studio S.A.
+// Copyright (c) 2020-2024 Igara Studio S.A.
 // Copyright (c) 2001-2015 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -9,7 +9,9 @@
 #define DOC_MASK_BOUNDARIES_H_INCLUDED
 #pragma once
 
+#include "doc/image_ref.h"
 #include "gfx/path.h"
+#include "gfx/point.h"
 #include "gfx/rect.h"
 
 #include <vector>
@@ -43,10 +45,19 @@ namespace doc {
     typedef list_type::iterator iterator;
     typedef list_type::const_iterator const_iterator;
 
+    // Bitmaps with fewer pixels are always regenerated completely.
+    static constexpr int kMinIncrementalPixels = 256*256;
+
     bool isEmpty() const { return m_segs.empty(); }
     void reset();
     void regen(const Image* bitmap);
 
+    // Regenerates the boundaries of the given bitmap placed in
+    // "origin". If the previous boundaries were generated with this
+    // function too, only the segments in the area where the bitmaps
+    // are different are regenerated.
+    void regen(const Image* bitmap, const gfx::Point& origin);
+
     const_iterator begin() const { return m_segs.begin(); }
     const_iterator end() const { return m_segs.end(); }
     iterator begin() { return m_segs.begin(); }
@@ -58,8 +69,17 @@ namespace doc {
     void createPathIfNeeeded();
 
   private:
+    void regenArea(const Image* bitmap,
+                   const gfx::Point& origin,
+                   const gfx::Rect& area);
+
     list_type m_segs;
     gfx::Path m_path;
+
+    // Copy of the bitmap used to generate the segments (to calculate
+    // the modified area in the next regen())
+    ImageRef m_bitmap;
+    gfx::Point m_origin;
   };
 
 } // namespace doc
@@ -0,0 +1,159 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/image.h"
+#include "doc/mask_boundaries.h"
+#include "doc/primitives.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+#include <tuple>
+
+using namespace doc;
+
+// Unit edges (vertical, open, x, y) of all segments, so boundaries
+// with segments split in different places can be compared.
+using Edges = std::set<std::tuple<bool, bool, int, int>>;
+
+static Edges get_edges(const MaskBoundaries& boundaries)
+{
+  Edges edges;
+  for (const auto& seg : boundaries) {
+    const gfx::Rect& rc = seg.bounds();
+    if (seg.vertical()) {
+      for (int y=rc.y; y<rc.y2(); ++y)
+        EXPECT_TRUE(edges.insert({ true, seg.open(), rc.x, y }).second);
+    }
+    else {
+      for (int x=rc.x; x<rc.x2(); ++x)
+        EXPECT_TRUE(edges.insert({ false, seg.open(), x, rc.y }).second);
+    }
+  }
+  return edges;
+}
+
+static Image* random_bitmap(int w, int h)
+{
+  Image* bitmap = Image::create(IMAGE_BITMAP, w, h);
+  clear_image(bitmap, 0);
+  for (int i=0; i<8; ++i) {
+    const int x = std::rand() % w;
+    const int y = std::rand() % h;
+    fill_rect(bitmap, x, y,
+              x + std::rand() % (w-x),
+              y + std::rand() % (h-y), 1);
+  }
+  return bitmap;
+}
+
+TEST(MaskBoundaries, IncrementalRegenGivesSameEdges)
+{
+  std::srand(1);
+  for (int t=0; t<50; ++t) {
+    const int w = 200 + std::rand() % 300;
+    const int h = 200 + std::rand() % 300;
+    const gfx::Point origin(std::rand() % 16, std::rand() % 16);
+
+    ImageRef bitmap(random_bitmap(w, h));
+    MaskBoundaries incremental;
+    incremental.regen(bitmap.get(), origin);
+
+    for (int step=0; step<4; ++step) {
+      // Modify a small area of the bitmap
+      const int x = std::rand() % w;
+      const int y = std::rand() % h;
+      fill_rect(bitmap.get(), x, y,
+                std::min(w-1, x + std::rand() % 32),
+                std::min(h-1, y + std::rand() % 32),
+                std::rand() & 1);
+      put_pixel(bitmap.get(), 0, std::rand() % h, std::rand() & 1);
+
+      incremental.regen(bitmap.get(), origin);
+
+      MaskBoundaries full;
+      full.regen(bitmap.get());
+      full.offset(origin.x, origin.y);
+
+      EXPECT_EQ(get_edges(full), get_edges(incremental));
+    }
+  }
+}
+
+TEST(MaskBoundaries, IncrementalRegenWithNewBounds)
+{
+  std::srand(2);
+  for (int t=0; t<20; ++t) {
+    const int w = 300, h = 300;
+    ImageRef bitmap(random_bitmap(w, h));
+    MaskBoundaries incremental;
+    incremental.regen(bitmap.get(), gfx::Point(8, 8));
+
+    // Same pixels with a bigger bitmap (as Mask::add() can do)
+    const int dx = std::rand() % 24;
+    const int dy = std::rand() % 24;
+    ImageRef bigger(Image::create(IMAGE_BITMAP, w+dx+5, h+dy+5));
+    clear_image(bigger.get(), 0);
+    copy_image(bigger.get(), bitmap.get(), dx, dy);
+    put_pixel(bigger.get(), std::rand() % bigger->width(), 0, 1);
+
+    const gfx::Point origin(8-dx, 8-dy);
+    incremental.regen(bigger.get(), origin);
+
+    MaskBoundaries full;
+    full.regen(bigger.get());
+    full.offset(origin.x, origin.y);
+
+    EXPECT_EQ(get_edges(full), get_edges(incremental));
+  }
+}
+
+// Edges calculated pixel by pixel (an edge is "open" when the pixel
+// to the right/bottom of the edge is inside the mask).
+static Edges get_pixel_edges(const Image* bitmap)
+{
+  const int w = bitmap->width();
+  const int h = bitmap->height();
+  auto pixel = [bitmap, w, h](int x, int y) -> bool {
+    return (x >= 0 && y >= 0 && x < w && y < h &&
+            get_pixel(bitmap, x, y));
+  };
+
+  Edges edges;
+  for (int y=0; y<=h; ++y) {
+    for (int x=0; x<=w; ++x) {
+      const bool c = pixel(x, y);
+      if (y < h && c != pixel(x-1, y))
+        edges.insert({ true, c, x, y });
+      if (x < w && c != pixel(x, y-1))
+        edges.insert({ false, c, x, y });
+    }
+  }
+  return edges;
+}
+
+TEST(MaskBoundaries, BigUniformAreas)
+{
+  std::srand(3);
+  for (int t=0; t<50; ++t) {
+    // Widths that are and aren't multiple of 8 (and 64) pixels
+    const int w = 1 + std::rand() % 300;
+    const int h = 1 + std::rand() % 100;
+    ImageRef bitmap(random_bitmap(w, h));
+    if (t & 1)
+      put_pixel(bitmap.get(), std::rand() % w, std::rand() % h, 0);
+
+    MaskBoundaries boundaries;
+    boundaries.regen(bitmap.get());
+    EXPECT_EQ(get_pixel_edges(bitmap.get()), get_edges(boundaries));
+  }
+}
@@ -0,0 +1,134 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/mask.h"
+
+#include <random>
+#include <vector>
+
+using namespace doc;
+
+namespace {
+
+// Selected pixels of a mask in a fixed area (used as a reference)
+class Pixels {
+public:
+  Pixels(const gfx::Rect& area) : m_area(area), m_bits(area.w*area.h, false) { }
+  Pixels(const gfx::Rect& area, const Mask& mask) : Pixels(area) {
+    for (int y=0; y<area.h; ++y)
+      for (int x=0; x<area.w; ++x)
+        set(area.x+x, area.y+y, mask.containsPoint(area.x+x, area.y+y));
+  }
+
+  bool get(int x, int y) const {
+    return m_bits[(y-m_area.y)*m_area.w + (x-m_area.x)];
+  }
+  void set(int x, int y, bool v) {
+    m_bits[(y-m_area.y)*m_area.w + (x-m_area.x)] = v;
+  }
+  bool operator==(const Pixels& o) const { return m_bits == o.m_bits; }
+
+  // Bounds of the selected pixels
+  gfx::Rect bounds() const {
+    gfx::Rect rc;
+    for (int y=0; y<m_area.h; ++y)
+      for (int x=0; x<m_area.w; ++x)
+        if (m_bits[y*m_area.w + x])
+          rc |= gfx::Rect(m_area.x+x, m_area.y+y, 1, 1);
+    return rc;
+  }
+
+private:
+  gfx::Rect m_area;
+  std::vector<bool> m_bits;
+};
+
+void random_mask(Mask& mask, const gfx::Rect& bounds, std::mt19937& gen)
+{
+  mask.replace(bounds);
+  std::uniform_int_distribution<int> dist(0, 1);
+  Image* bitmap = mask.bitmap();
+  for (int y=0; y<bounds.h; ++y)
+    for (int x=0; x<bounds.w; ++x)
+      put_pixel(bitmap, x, y, dist(gen));
+  mask.shrink();
+}
+
+} // anonymous namespace
+
+TEST(Mask, CombineWithOffsets)
+{
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> pos(-20, 20);
+  std::uniform_int_distribution<int> size(1, 90);
+  const gfx::Rect area(-40, -40, 200, 200);
+
+  for (int i=0; i<300; ++i) {
+    Mask a, b;
+    random_mask(a, gfx::Rect(pos(gen), pos(gen), size(gen), size(gen)), gen);
+    random_mask(b, gfx::Rect(pos(gen), pos(gen), size(gen), size(gen)), gen);
+
+    const Pixels pa(area, a);
+    const Pixels pb(area, b);
+    Pixels add(area), sub(area), inter(area);
+    for (int y=area.y; y<area.y2(); ++y) {
+      for (int x=area.x; x<area.x2(); ++x) {
+        add.set(x, y, pa.get(x, y) || pb.get(x, y));
+        sub.set(x, y, pa.get(x, y) && !pb.get(x, y));
+        inter.set(x, y, pa.get(x, y) && pb.get(x, y));
+      }
+    }
+
+    Mask m;
+    m.copyFrom(&a);
+    m.add(b);
+    EXPECT_TRUE(add == Pixels(area, m));
+    EXPECT_EQ(add.bounds(), m.bounds());
+
+    m.copyFrom(&a);
+    m.subtract(b);
+    EXPECT_TRUE(sub == Pixels(area, m));
+    EXPECT_EQ(sub.bounds(), m.bounds());
+
+    m.copyFrom(&a);
+    m.intersect(b);
+    EXPECT_TRUE(inter == Pixels(area, m));
+    EXPECT_EQ(inter.bounds(), m.bounds());
+  }
+}
+
+TEST(Mask, Invert)
+{
+  Mask a;
+  a.replace(gfx::Rect(3, 5, 13, 7));
+  EXPECT_TRUE(a.isRectangular());
+
+  // Removing the first column shrinks the bounds
+  a.subtract(gfx::Rect(3, 5, 1, 7));
+  EXPECT_EQ(gfx::Rect(4, 5, 12, 7), a.bounds());
+
+  a.subtract(gfx::Rect(8, 6, 2, 2));
+  EXPECT_FALSE(a.isRectangular());
+
+  a.invert();
+  EXPECT_EQ(gfx::Rect(8, 6, 2, 2), a.bounds());
+  EXPECT_TRUE(a.isRectangular());
+
+  a.invert();
+  EXPECT_TRUE(a.isEmpty());
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
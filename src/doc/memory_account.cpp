@@ -0,0 +1,116 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/memory_account.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace doc {
+
+namespace {
+
+// Registered accounts, the mutex is locked while the bytes()/release()
+// functions are called so accounts cannot be destroyed in the middle.
+std::recursive_mutex g_mutex;
+std::vector<MemoryAccount*> g_accounts;
+std::atomic<std::size_t> g_softLimit(0);
+
+} // anonymous namespace
+
+const char* memory_pool_name(MemoryPool pool)
+{
+  switch (pool) {
+    case MemoryPool::RenderCache: return "renderCache";
+    case MemoryPool::EditorCache: return "editorCache";
+    case MemoryPool::Thumbnails: return "thumbnails";
+    case MemoryPool::Clipboard: return "clipboard";
+  }
+  return "";
+}
+
+MemoryAccount::MemoryAccount(MemoryPool pool,
+                             BytesFunc&& bytes,
+                             ReleaseFunc&& release)
+  : m_pool(pool)
+  , m_bytes(std::move(bytes))
+  , m_release(std::move(release))
+{
+  const std::lock_guard lock(g_mutex);
+  g_accounts.push_back(this);
+}
+
+MemoryAccount::~MemoryAccount()
+{
+  const std::lock_guard lock(g_mutex);
+  auto it = std::find(g_accounts.begin(), g_accounts.end(), this);
+  if (it != g_accounts.end())
+    g_accounts.erase(it);
+}
+
+std::size_t get_memory_pool_bytes(MemoryPool pool)
+{
+  const std::lock_guard lock(g_mutex);
+  std::size_t total = 0;
+  for (const MemoryAccount* account : g_accounts) {
+    if (account->pool() == pool)
+      total += account->bytes();
+  }
+  return total;
+}
+
+void set_memory_soft_limit(std::size_t bytes)
+{
+  g_softLimit = bytes;
+  check_memory_soft_limit();
+}
+
+std::size_t get_memory_soft_limit()
+{
+  return g_softLimit;
+}
+
+void check_memory_soft_limit()
+{
+  const std::size_t limit = g_softLimit;
+  if (limit == 0)
+    return;
+
+  const std::lock_guard lock(g_mutex);
+  std::vector<std::pair<std::size_t, MemoryAccount*>> sizes;
+  std::size_t total = 0;
+  for (MemoryAccount* account : g_accounts) {
+    const std::size_t bytes = account->bytes();
+    total += bytes;
+    if (account->canRelease() && bytes > 0)
+      sizes.emplace_back(bytes, account);
+  }
+  if (total <= limit)
+    return;
+
+  // Release the biggest caches first
+  std::sort(sizes.begin(), sizes.end(),
+            [](const auto& a, const auto& b){ return a.first > b.first; });
+  for (auto& [bytes, account] : sizes) {
+    // The account could be destroyed releasing a previous one
+    if (std::find(g_accounts.begin(), g_accounts.end(), account) == g_accounts.end())
+      continue;
+
+    account->release();
+    total -= std::min(total, bytes - std::min(bytes, account->bytes()));
+    if (total <= limit)
+      break;
+  }
+}
+
+} // namespace doc
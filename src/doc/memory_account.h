@@ -0,0 +1,77 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_MEMORY_ACCOUNT_H_INCLUDED
+#define DOC_MEMORY_ACCOUNT_H_INCLUDED
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace doc {
+
+  // Subsystems that keep image memory outside the documents (the
+  // memory of cels, tilesets, and undo history is calculated for
+  // each document).
+  enum class MemoryPool {
+    RenderCache,                // Mipmaps, tiles, composited layers
+    EditorCache,                // Rendered tiles of each editor
+    Thumbnails,                 // Cel thumbnails of the timeline
+    Clipboard,                  // Copied images/tilesets
+    Count
+  };
+
+  const char* memory_pool_name(MemoryPool pool);
+
+  // Registers a holder of memory (e.g. a cache) in the given pool
+  // while the MemoryAccount is alive. It should be the last member of
+  // the owner class, so it's unregistered before the memory it
+  // measures is destroyed.
+  //
+  // "bytes" returns the memory used by the holder, and "release"
+  // (optional, it's only for caches) frees as much memory as
+  // possible. Both functions can be called from any thread, so they
+  // must lock the owner if needed.
+  class MemoryAccount {
+  public:
+    using BytesFunc = std::function<std::size_t()>;
+    using ReleaseFunc = std::function<void()>;
+
+    MemoryAccount(MemoryPool pool,
+                  BytesFunc&& bytes,
+                  ReleaseFunc&& release = nullptr);
+    ~MemoryAccount();
+
+    MemoryAccount(const MemoryAccount&) = delete;
+    MemoryAccount& operator=(const MemoryAccount&) = delete;
+
+    MemoryPool pool() const { return m_pool; }
+    std::size_t bytes() const { return m_bytes(); }
+    bool canRelease() const { return bool(m_release); }
+    void release() { m_release(); }
+
+  private:
+    MemoryPool m_pool;
+    BytesFunc m_bytes;
+    ReleaseFunc m_release;
+  };
+
+  // Returns the memory used by all the holders of the given pool.
+  std::size_t get_memory_pool_bytes(MemoryPool pool);
+
+  // Soft limit for the memory of all pools (0 = no limit). When the
+  // limit is exceeded, check_memory_soft_limit() releases the memory
+  // of the biggest caches first.
+  void set_memory_soft_limit(std::size_t bytes);
+  std::size_t get_memory_soft_limit();
+
+  // Must be called by caches after they grow, without locking their
+  // own mutex (as the cache itself can be released).
+  void check_memory_soft_limit();
+
+} // namespace doc
+
+#endif
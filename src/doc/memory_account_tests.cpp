@@ -0,0 +1,59 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/memory_account.h"
+
+using namespace doc;
+
+TEST(MemoryAccount, PoolBytes)
+{
+  EXPECT_EQ(0, get_memory_pool_bytes(MemoryPool::RenderCache));
+  {
+    MemoryAccount a(MemoryPool::RenderCache, []{ return 100; });
+    MemoryAccount b(MemoryPool::RenderCache, []{ return 20; });
+    MemoryAccount c(MemoryPool::Clipboard, []{ return 3; });
+    EXPECT_EQ(120, get_memory_pool_bytes(MemoryPool::RenderCache));
+    EXPECT_EQ(3, get_memory_pool_bytes(MemoryPool::Clipboard));
+    EXPECT_EQ(0, get_memory_pool_bytes(MemoryPool::Thumbnails));
+  }
+  EXPECT_EQ(0, get_memory_pool_bytes(MemoryPool::RenderCache));
+  EXPECT_EQ(0, get_memory_pool_bytes(MemoryPool::Clipboard));
+}
+
+TEST(MemoryAccount, SoftLimitReleasesBiggestCachesFirst)
+{
+  std::size_t small = 100, big = 300, fixed = 50;
+  MemoryAccount a(MemoryPool::RenderCache,
+                  [&]{ return small; }, [&]{ small = 0; });
+  MemoryAccount b(MemoryPool::EditorCache,
+                  [&]{ return big; }, [&]{ big = 0; });
+  MemoryAccount c(MemoryPool::Clipboard,
+                  [&]{ return fixed; });
+
+  set_memory_soft_limit(1000);
+  EXPECT_EQ(100, small);
+  EXPECT_EQ(300, big);
+
+  // Releasing "big" is enough to be under the limit
+  set_memory_soft_limit(200);
+  EXPECT_EQ(100, small);
+  EXPECT_EQ(0, big);
+
+  // The clipboard cannot be released
+  big = 300;
+  set_memory_soft_limit(10);
+  EXPECT_EQ(0, small);
+  EXPECT_EQ(0, big);
+  EXPECT_EQ(50, fixed);
+
+  set_memory_soft_limit(0);
+}
@@ -11,6 +11,7 @@
 #include "doc/object_id.h"
 #include "doc/object_type.h"
 #include "doc/object_version.h"
+#include "doc/small_object_pool.h"
 
 namespace doc {
 
@@ -20,6 +21,10 @@ namespace doc {
     Object(const Object& other);
     virtual ~Object();
 
+    // Cels, tags, slices, etc. are allocated from the small object
+    // pool (bigger objects like sprites use the global allocator)
+    DOC_SMALL_OBJECT_ALLOCATOR()
+
     const ObjectType type() const { return m_type; }
     const ObjectId id() const;
     const ObjectVersion version() const { return m_version; }
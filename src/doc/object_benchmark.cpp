@@ -0,0 +1,79 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/object.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+using namespace doc;
+
+// Creates and registers objects (assigns an ID to each one) and
+// deletes them (unregisters them)
+void BM_ObjectCreateDelete(benchmark::State& state) {
+  const int n = state.range(0);
+  std::vector<std::unique_ptr<Object>> objs(n);
+  while (state.KeepRunning()) {
+    for (auto& obj : objs) {
+      obj = std::make_unique<Object>(ObjectType::Unknown);
+      benchmark::DoNotOptimize(obj->id());
+    }
+    for (auto& obj : objs)
+      obj.reset();
+  }
+}
+
+// Registered objects shared by all lookup benchmarks/threads
+static const std::vector<std::unique_ptr<Object>>& registered_objects()
+{
+  static std::vector<std::unique_ptr<Object>> objs = []{
+    std::vector<std::unique_ptr<Object>> objs(1000000);
+    for (auto& obj : objs) {
+      obj = std::make_unique<Object>(ObjectType::Unknown);
+      obj->id();
+    }
+    return objs;
+  }();
+  return objs;
+}
+
+// Looks up objects by ID (like scripts or the undo history do)
+void BM_ObjectGet(benchmark::State& state) {
+  const int n = state.range(0);
+  const auto& objs = registered_objects();
+  while (state.KeepRunning()) {
+    for (int i=0; i<n; i+=16)
+      benchmark::DoNotOptimize(get_object(objs[i]->id()));
+  }
+}
+
+BENCHMARK(BM_ObjectCreateDelete)
+  ->Arg(1000)
+  ->Arg(100000)
+  ->UseRealTime();
+
+BENCHMARK(BM_ObjectCreateDelete)
+  ->Arg(10000)
+  ->Threads(4)
+  ->UseRealTime();
+
+BENCHMARK(BM_ObjectGet)
+  ->Arg(1000)
+  ->Arg(1000000)
+  ->UseRealTime();
+
+BENCHMARK(BM_ObjectGet)
+  ->Arg(100000)
+  ->Threads(4)
+  ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -68,6 +68,25 @@ void OctreeNode::collectLeafNodes(OctreeNodes& leavesVector, int& paletteIndex)
   }
 }
 
+void OctreeNode::merge(const OctreeNode& other, OctreeNode* parent)
+{
+  // Nodes without parent weren't reached by addColor()
+  if (!other.m_parent)
+    return;
+
+  m_parent = parent;
+  if (other.m_leafColor.pixelCount() > 0) {
+    m_leafColor.add(other.m_leafColor);
+    m_paletteIndex = other.m_paletteIndex;
+  }
+  if (other.m_children) {
+    if (!m_children)
+      m_children.reset(new std::array<OctreeNode, 16>());
+    for (int i=0; i<16; ++i)
+      (*m_children)[i].merge((*other.m_children)[i], this);
+  }
+}
+
 // removeLeaves(): remove leaves from a common parent
 // auxParentVector: i/o addreess of an auxiliary parent leaf Vector from outside this function.
 // rootLeavesVector: i/o address of the m_root->m_leavesVector
@@ -263,6 +282,12 @@ void OctreeMap::feedWithImage(const Image* image,
   m_maskColor = maskColor;
 }
 
+void OctreeMap::merge(const OctreeMap& other)
+{
+  m_root.merge(other.m_root, &m_root);
+  m_maskColor = other.m_maskColor;
+}
+
 int OctreeMap::mapColor(color_t rgba) const
 {
   return m_root.mapColor(rgba_getr(rgba),
@@ -291,6 +316,7 @@ void OctreeMap::regenerateMap(const Palette* palette,
 
   m_palette = palette;
   m_fitCriteria = fitCriteria;
+  regenerateFitPalette();
   m_root = OctreeNode();
   m_leavesVector.clear();
   m_maskIndex = maskIndex;
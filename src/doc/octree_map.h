@@ -101,6 +101,10 @@ public:
 
   void collectLeafNodes(OctreeNodes& leavesVector, int& paletteIndex);
 
+  // Adds all colors of the "other" node (and its children) to this
+  // node, as if they were added with addColor().
+  void merge(const OctreeNode& other, OctreeNode* parent);
+
   // removeLeaves(): remove leaves from a common parent
   // auxParentVector: i/o addreess of an auxiliary parent leaf Vector from outside.
   // rootLeavesVector: i/o address of the m_root->m_leavesVector
@@ -138,6 +142,11 @@ public:
                      const color_t maskColor,
                      const int levelDeep = 7);
 
+  // Adds the colors fed to other octree (with the same levelDeep),
+  // e.g. to feed several octrees from different threads. The result
+  // is the same as feeding the images of both octrees in this one.
+  void merge(const OctreeMap& other);
+
   // RgbMap impl
   void regenerateMap(const Palette* palette,
                      const int maskIndex,
@@ -0,0 +1,71 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/image_ref.h"
+#include "doc/octree_map.h"
+#include "doc/palette.h"
+
+#include <cstdlib>
+
+using namespace doc;
+
+static ImageRef random_image(int w, int h)
+{
+  ImageRef image(Image::create(IMAGE_RGB, w, h));
+  for (int y=0; y<h; ++y)
+    for (int x=0; x<w; ++x)
+      image->putPixel(x, y, rgba(std::rand() & 255, std::rand() & 255,
+                                 std::rand() & 255, std::rand() & 255));
+  return image;
+}
+
+// Merging octrees fed with different images must give the same
+// palette as feeding all the images in only one octree.
+TEST(OctreeMap, MergeIsLikeFeedingInOrder)
+{
+  std::srand(1);
+  for (int levelDeep : { 7, 8 }) {
+    ImageRef a = random_image(64, 32);
+    ImageRef b = random_image(16, 48);
+    ImageRef c = random_image(32, 32);
+
+    OctreeMap all;
+    for (const ImageRef& image : { a, b, c })
+      all.feedWithImage(image.get(), true, 0, levelDeep);
+
+    OctreeMap merged, partial1, partial2;
+    merged.feedWithImage(a.get(), true, 0, levelDeep);
+    partial1.feedWithImage(b.get(), true, 0, levelDeep);
+    partial2.feedWithImage(c.get(), true, 0, levelDeep);
+    merged.merge(partial1);
+    merged.merge(partial2);
+
+    for (int colors : { 16, 256 }) {
+      Palette palAll(0, colors), palMerged(0, colors);
+      OctreeMap all2, merged2;
+      all2.merge(all);
+      merged2.merge(merged);
+
+      EXPECT_EQ(all2.makePalette(&palAll, colors, levelDeep),
+                merged2.makePalette(&palMerged, colors, levelDeep));
+      ASSERT_EQ(palAll.size(), palMerged.size());
+      for (int i=0; i<palAll.size(); ++i)
+        EXPECT_EQ(palAll.getEntry(i), palMerged.getEntry(i));
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -22,6 +22,13 @@
 #include <limits>
 #include <cmath>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define DOC_BESTFIT_SSE2 1
+  #include <emmintrin.h>
+#else
+  #define DOC_BESTFIT_SSE2 0
+#endif
+
 namespace doc {
 
 using namespace gfx;
@@ -37,7 +44,7 @@ Palette::Palette(frame_t frame, int ncolors)
   ASSERT(ncolors >= 0);
 
   m_frame = frame;
-  m_colors.resize(ncolors, doc::rgba(0, 0, 0, 255));
+  m_colors = std::make_shared<Colors>(ncolors, doc::rgba(0, 0, 0, 255));
   m_modifications = 0;
 }
 
@@ -55,6 +62,7 @@ Palette::Palette(const Palette& palette, const Remap& remap)
   , m_comment(palette.m_comment)
 {
   m_frame = palette.m_frame;
+  m_colors = std::make_shared<Colors>();
 
   resize(palette.size());
   for (int i=0; i<size(); ++i)
@@ -91,7 +99,7 @@ void Palette::resize(int ncolors, color_t color)
 {
   ASSERT(ncolors >= 0);
 
-  m_colors.resize(ncolors, color);
+  modifyColors().resize(ncolors, color);
   ++m_modifications;
 }
 
@@ -103,7 +111,7 @@ void Palette::addEntry(color_t color)
 
 bool Palette::hasAlpha() const
 {
-  for (int i=0; i<(int)m_colors.size(); ++i)
+  for (int i=0; i<(int)m_colors->entries.size(); ++i)
     if (rgba_geta(getEntry(i)) < 255)
       return true;
   return false;
@@ -111,7 +119,7 @@ bool Palette::hasAlpha() const
 
 bool Palette::hasSemiAlpha() const
 {
-  for (int i=0; i<(int)m_colors.size(); ++i) {
+  for (int i=0; i<(int)m_colors->entries.size(); ++i) {
     int a = rgba_geta(getEntry(i));
     if (a > 0 && a < 255)
       return true;
@@ -130,7 +138,9 @@ void Palette::setEntry(int i, color_t color)
 {
   ASSERT(i >= 0 && i < size());
 
-  m_colors[i] = color;
+  // Avoid detaching shared colors when the entry is the same
+  if (m_colors->entries[i] != color)
+    modifyColors()[i] = color;
   ++m_modifications;
 }
 
@@ -140,18 +150,51 @@ void Palette::copyColorsTo(Palette* dst) const
   ++dst->m_modifications;
 }
 
-int Palette::countDiff(const Palette* other, int* from, int* to) const
+size_t Palette::hash() const
 {
-  int c, diff = 0;
-  int min = std::min(this->m_colors.size(), other->m_colors.size());
-  int max = std::max(this->m_colors.size(), other->m_colors.size());
+  size_t hash = m_colors->hash;
+  if (hash == 0) {
+    // FNV-1a hash of all entries
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (color_t c : m_colors->entries) {
+      h ^= c;
+      h *= 0x100000001b3ull;
+    }
+    h ^= m_colors->entries.size();
+    hash = size_t(h ? h: 1);    // 0 is used as "not calculated yet"
+    m_colors->hash = hash;
+  }
+  return hash;
+}
 
+bool Palette::operator==(const Palette& other) const
+{
+  if (m_colors == other.m_colors)
+    return true;
+  if (size() != other.size() ||
+      hash() != other.hash())
+    return false;
+  return (m_colors->entries == other.m_colors->entries);
+}
+
+int Palette::countDiff(const Palette* other, int* from, int* to) const
+{
   if (from) *from = -1;
   if (to) *to = -1;
 
+  // Same shared colors
+  if (m_colors == other->m_colors)
+    return 0;
+
+  const auto& colors = m_colors->entries;
+  const auto& otherColors = other->m_colors->entries;
+  int c, diff = 0;
+  int min = std::min(colors.size(), otherColors.size());
+  int max = std::max(colors.size(), otherColors.size());
+
   // Compare palettes
   for (c=0; c<min; ++c) {
-    if (this->m_colors[c] != other->m_colors[c]) {
+    if (colors[c] != otherColors[c]) {
       if (from && *from < 0) *from = c;
       if (to) *to = c;
       ++diff;
@@ -185,7 +228,7 @@ void Palette::addNonRepeatedColors(const Palette* palette,
 
 bool Palette::isBlack() const
 {
-  for (std::size_t c=0; c<m_colors.size(); ++c)
+  for (std::size_t c=0; c<m_colors->entries.size(); ++c)
     if (getEntry(c) != rgba(0, 0, 0, 255))
       return false;
 
@@ -194,7 +237,8 @@ bool Palette::isBlack() const
 
 void Palette::makeBlack()
 {
-  std::fill(m_colors.begin(), m_colors.end(), rgba(0, 0, 0, 255));
+  auto& colors = modifyColors();
+  std::fill(colors.begin(), colors.end(), rgba(0, 0, 0, 255));
   ++m_modifications;
 }
 
@@ -294,10 +338,27 @@ void Palette::makeHueGradient(int from, int to)
   }
 }
 
+// Palettes with more entries use Colors::exactMatchIndex to find
+// exact matches.
+static constexpr int kExactMatchIndexMinSize = 256;
+
 int Palette::findExactMatch(int r, int g, int b, int a, int mask_index) const
 {
-  for (int i=0; i<(int)m_colors.size(); ++i)
-    if (getEntry(i) == rgba(r, g, b, a) && i != mask_index)
+  const color_t color = rgba(r, g, b, a);
+
+  if (size() > kExactMatchIndexMinSize) {
+    const auto& index = exactMatchIndex();
+    auto it = std::lower_bound(index.begin(), index.end(),
+                               std::make_pair(color, 0));
+    for (; it != index.end() && it->first == color; ++it) {
+      if (it->second != mask_index)
+        return it->second;
+    }
+    return -1;
+  }
+
+  for (int i=0; i<(int)m_colors->entries.size(); ++i)
+    if (getEntry(i) == color && i != mask_index)
       return i;
 
   return -1;
@@ -305,13 +366,34 @@ int Palette::findExactMatch(int r, int g, int b, int a, int mask_index) const
 
 bool Palette::findExactMatch(color_t color) const
 {
-  for (int i=0; i<(int)m_colors.size(); ++i) {
+  if (size() > kExactMatchIndexMinSize) {
+    const auto& index = exactMatchIndex();
+    auto it = std::lower_bound(index.begin(), index.end(),
+                               std::make_pair(color, 0));
+    return (it != index.end() && it->first == color);
+  }
+
+  for (int i=0; i<(int)m_colors->entries.size(); ++i) {
     if (getEntry(i) == color)
       return true;
   }
   return false;
 }
 
+const std::vector<std::pair<color_t, int>>& Palette::exactMatchIndex() const
+{
+  const std::lock_guard lock(m_colors->exactMatchIndexMutex);
+  auto& index = m_colors->exactMatchIndex;
+  if (index.empty()) {
+    const auto& entries = m_colors->entries;
+    index.resize(entries.size());
+    for (int i=0; i<int(entries.size()); ++i)
+      index[i] = std::make_pair(entries[i], i);
+    std::sort(index.begin(), index.end());
+  }
+  return index;
+}
+
 //////////////////////////////////////////////////////////////////////
 // Based on Allegro's bestfit_color
 
@@ -338,6 +420,107 @@ void Palette::initBestfit()
   }
 }
 
+#if DOC_BESTFIT_SSE2
+
+// Same result as the col_diff loop of Palette::findBestfit() (the
+// first entry with the lowest weighted distance, skipping
+// mask_index), but comparing 4 palette entries in each iteration.
+// r/g/b/a are 5-bit components.
+static int find_bestfit_sse2(const color_t* colors, const int size,
+                             const int r, const int g, const int b, const int a,
+                             const int mask_index)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i mask5 = _mm_set1_epi8(0x1f);
+  const __m128i target = _mm_setr_epi16(r, g, b, a, r, g, b, a);
+  const __m128i weights = _mm_setr_epi16(30*30, 59*59, 11*11, 8*8,
+                                         30*30, 59*59, 11*11, 8*8);
+  const __m128i maxDiff = _mm_set1_epi32(std::numeric_limits<int>::max());
+  const __m128i maskIndex = _mm_set1_epi32(mask_index);
+  const __m128i four = _mm_set1_epi32(4);
+
+  __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+  __m128i lowest = maxDiff;
+  __m128i bestfit = zero;
+
+  int i = 0;
+  for (; i+4<=size; i+=4) {
+    // 5-bit components of 4 entries (R, G, B, A bytes)
+    __m128i c = _mm_loadu_si128((const __m128i*)(colors+i));
+    c = _mm_and_si128(_mm_srli_epi16(c, 3), mask5);
+
+    // Squared differences of each component (as 16-bit values),
+    // multiplied by the weight of each component and added in pairs
+    // (r+g, b+a) as 32-bit values.
+    __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(c, zero), target);
+    __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(c, zero), target);
+    lo = _mm_madd_epi16(_mm_mullo_epi16(lo, lo), weights);
+    hi = _mm_madd_epi16(_mm_mullo_epi16(hi, hi), weights);
+
+    const __m128 lof = _mm_castsi128_ps(lo);
+    const __m128 hif = _mm_castsi128_ps(hi);
+    __m128i diff = _mm_add_epi32(
+      _mm_castps_si128(_mm_shuffle_ps(lof, hif, _MM_SHUFFLE(2, 0, 2, 0))),
+      _mm_castps_si128(_mm_shuffle_ps(lof, hif, _MM_SHUFFLE(3, 1, 3, 1))));
+
+    // The mask entry can't be selected
+    const __m128i isMask = _mm_cmpeq_epi32(index, maskIndex);
+    diff = _mm_or_si128(_mm_andnot_si128(isMask, diff),
+                        _mm_and_si128(isMask, maxDiff));
+
+    const __m128i lt = _mm_cmplt_epi32(diff, lowest);
+    lowest = _mm_or_si128(_mm_andnot_si128(lt, lowest), _mm_and_si128(lt, diff));
+    bestfit = _mm_or_si128(_mm_andnot_si128(lt, bestfit), _mm_and_si128(lt, index));
+    index = _mm_add_epi32(index, four);
+
+    // Exact match
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(lowest, zero)))
+      break;
+  }
+
+  // Each lane has the first entry with the lowest distance of its
+  // own subset of entries, here we pick the first one of all lanes.
+  alignas(16) int lowests[4];
+  alignas(16) int bestfits[4];
+  _mm_store_si128((__m128i*)lowests, lowest);
+  _mm_store_si128((__m128i*)bestfits, bestfit);
+
+  int result = 0;
+  int resultDiff = std::numeric_limits<int>::max();
+  for (int j=0; j<4; ++j) {
+    if (lowests[j] < resultDiff ||
+        (lowests[j] == resultDiff && bestfits[j] < result)) {
+      resultDiff = lowests[j];
+      result = bestfits[j];
+    }
+  }
+  if (resultDiff == 0)
+    return result;
+
+  for (; i<size; ++i) {
+    if (i == mask_index)
+      continue;
+
+    const color_t rgb = colors[i];
+    const int dr = (rgba_getr(rgb)>>3) - r;
+    const int dg = (rgba_getg(rgb)>>3) - g;
+    const int db = (rgba_getb(rgb)>>3) - b;
+    const int da = (rgba_geta(rgb)>>3) - a;
+    const int diff = (dr*dr*30*30 + dg*dg*59*59 +
+                      db*db*11*11 + da*da*8*8);
+    if (diff < resultDiff) {
+      if (diff == 0)
+        return i;
+
+      resultDiff = diff;
+      result = i;
+    }
+  }
+  return result;
+}
+
+#endif // DOC_BESTFIT_SSE2
+
 int Palette::findBestfit(int r, int g, int b, int a, int mask_index) const
 {
   ASSERT(r >= 0 && r <= 255);
@@ -355,12 +538,16 @@ int Palette::findBestfit(int r, int g, int b, int a, int mask_index) const
   if (a == 0 && mask_index >= 0)
     return mask_index;
 
+  int size = std::min(256, int(m_colors->entries.size()));
+
+#if DOC_BESTFIT_SSE2
+  return find_bestfit_sse2(m_colors->entries.data(), size, r, g, b, a, mask_index);
+#else
   int bestfit = 0;
   int lowest = std::numeric_limits<int>::max();
-  int size = std::min(256, int(m_colors.size()));
 
   for (int i=0; i<size; ++i) {
-    color_t rgb = m_colors[i];
+    color_t rgb = m_colors->entries[i];
 
     int coldiff = col_diff_g[((rgba_getg(rgb)>>3) - g) & 127];
     if (coldiff < lowest) {
@@ -381,18 +568,33 @@ int Palette::findBestfit(int r, int g, int b, int a, int mask_index) const
     }
   }
   return bestfit;
+#endif
 }
 
 int Palette::findMaskColor() const
 {
-  int size = m_colors.size();
+  int size = m_colors->entries.size();
   for (int i = 0; i < size; ++i) {
-    if (m_colors[i] == 0)
+    if (m_colors->entries[i] == 0)
       return i;
   }
   return -1;
 }
 
+std::vector<color_t>& Palette::modifyColors()
+{
+  // Detach the colors from other palettes that share them
+  if (m_colors.use_count() > 1)
+    m_colors = std::make_shared<Colors>(m_colors->entries);
+  else {
+    m_colors->hash = 0;
+
+    const std::lock_guard lock(m_colors->exactMatchIndexMutex);
+    m_colors->exactMatchIndex.clear();
+  }
+  return m_colors->entries;
+}
+
 void Palette::applyRemap(const Remap& remap)
 {
   Palette original(*this);
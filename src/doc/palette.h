@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2020-2023  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -15,8 +15,12 @@
 #include "doc/object.h"
 #include "doc/palette_gradient_type.h"
 
-#include <vector>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace doc {
 
@@ -36,11 +40,11 @@ namespace doc {
 
     static Palette* createGrayscale();
 
-    int size() const { return (int)m_colors.size(); }
+    int size() const { return (int)m_colors->entries.size(); }
     void resize(int ncolors, color_t color = doc::rgba(0, 0, 0, 255));
 
     // Used to share the palette data with a SkSL shader
-    const color_t* rawColorsData() const { return m_colors.data(); }
+    const color_t* rawColorsData() const { return m_colors->entries.data(); }
 
     const std::string& filename() const { return m_filename; }
     const std::string& comment() const { return m_comment; }
@@ -72,7 +76,7 @@ namespace doc {
       //ASSERT(i < size());
       ASSERT(i >= 0);
       if (i >= 0 && i < size())
-        return m_colors[i];
+        return m_colors->entries[i];
       return 0;
     }
     color_t getEntry(int i) const {
@@ -81,16 +85,20 @@ namespace doc {
     void setEntry(int i, color_t color);
     void addEntry(color_t color);
 
+    // Shares the colors with "dst" (they are copied only when one of
+    // the palettes is modified).
     void copyColorsTo(Palette* dst) const;
 
+    // Hash of the palette colors, it's cached until the colors are
+    // modified.
+    size_t hash() const;
+
     int countDiff(const Palette* other, int* from, int* to) const;
 
     void addNonRepeatedColors(const Palette* palette,
                               const int max = 256);
 
-    bool operator==(const Palette& other) const {
-      return (countDiff(&other, nullptr, nullptr) == 0);
-    }
+    bool operator==(const Palette& other) const;
 
     bool operator!=(const Palette& other) const {
       return !operator==(other);
@@ -115,8 +123,32 @@ namespace doc {
     const std::string& getEntryName(const int i) const;
 
   private:
+    // Colors can be shared between copies of the same palette
+    // (e.g. palettes of each frame in a palette animation) until one
+    // of them is modified (copy-on-write).
+    struct Colors {
+      std::vector<color_t> entries;
+      std::atomic<size_t> hash = 0; // 0 = not calculated yet
+
+      // Entries sorted by (color, index) to find exact matches in big
+      // palettes with a binary search. Created on demand (see
+      // Palette::exactMatchIndex()).
+      std::mutex exactMatchIndexMutex;
+      std::vector<std::pair<color_t, int>> exactMatchIndex;
+
+      Colors() { }
+      Colors(size_t n, color_t color) : entries(n, color) { }
+      Colors(const std::vector<color_t>& entries) : entries(entries) { }
+    };
+
+    // Returns the colors to be modified (detaching them from other
+    // palettes if needed).
+    std::vector<color_t>& modifyColors();
+
+    const std::vector<std::pair<color_t, int>>& exactMatchIndex() const;
+
     frame_t m_frame;
-    std::vector<color_t> m_colors;
+    std::shared_ptr<Colors> m_colors;
     std::vector<std::string> m_names;
     int m_modifications;
     std::string m_filename; // If the palette is associated with a file.
@@ -0,0 +1,140 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/palette.h"
+
+#include <cstdlib>
+#include <limits>
+
+using namespace doc;
+
+// Brute force version of the weighted distance used by Palette::findBestfit()
+static int bestfit_reference(const Palette& pal, int r, int g, int b, int a, int mask_index)
+{
+  r >>= 3; g >>= 3; b >>= 3; a >>= 3;
+  if (a == 0 && mask_index >= 0)
+    return mask_index;
+
+  int bestfit = 0;
+  int lowest = std::numeric_limits<int>::max();
+  for (int i=0; i<pal.size(); ++i) {
+    if (i == mask_index)
+      continue;
+
+    const color_t c = pal.getEntry(i);
+    const int dr = (rgba_getr(c)>>3) - r;
+    const int dg = (rgba_getg(c)>>3) - g;
+    const int db = (rgba_getb(c)>>3) - b;
+    const int da = (rgba_geta(c)>>3) - a;
+    const int diff = dr*dr*30*30 + dg*dg*59*59 + db*db*11*11 + da*da*8*8;
+    if (diff < lowest) {
+      lowest = diff;
+      bestfit = i;
+    }
+  }
+  return bestfit;
+}
+
+TEST(Palette, FindBestfitExactAndMask)
+{
+  Palette pal(0, 7);
+  for (int i=0; i<7; ++i)
+    pal.setEntry(i, rgba(i*40, 255-i*40, i*20, 255));
+  pal.setEntry(5, pal.getEntry(2));
+
+  EXPECT_EQ(2, pal.findBestfit(80, 175, 40, 255, -1));
+  EXPECT_EQ(5, pal.findBestfit(80, 175, 40, 255, 2));
+  EXPECT_EQ(6, pal.findBestfit(240, 15, 120, 255, -1));
+  EXPECT_EQ(3, pal.findBestfit(0, 0, 0, 0, 3));
+}
+
+TEST(Palette, FindBestfitLikeReference)
+{
+  std::srand(1);
+  for (int t=0; t<200; ++t) {
+    Palette pal(0, 1 + (std::rand() % 256));
+    for (int i=0; i<pal.size(); ++i)
+      pal.setEntry(i, rgba(std::rand() & 255, std::rand() & 255,
+                           std::rand() & 255, std::rand() & 255));
+
+    for (int k=0; k<50; ++k) {
+      const int r = std::rand() & 255;
+      const int g = std::rand() & 255;
+      const int b = std::rand() & 255;
+      const int a = std::rand() & 255;
+      const int mask = (std::rand() % (pal.size()+1)) - 1;
+      EXPECT_EQ(bestfit_reference(pal, r, g, b, a, mask),
+                pal.findBestfit(r, g, b, a, mask));
+    }
+  }
+}
+
+TEST(Palette, SharedColors)
+{
+  Palette a(0, 256);
+  a.setEntry(1, rgba(255, 0, 0, 255));
+
+  Palette b(a);
+  EXPECT_EQ(a.rawColorsData(), b.rawColorsData());
+  EXPECT_TRUE(a == b);
+  EXPECT_EQ(a.hash(), b.hash());
+
+  b.setEntry(1, rgba(0, 255, 0, 255));
+  EXPECT_NE(a.rawColorsData(), b.rawColorsData());
+  EXPECT_TRUE(a != b);
+  EXPECT_EQ(rgba(255, 0, 0, 255), a.getEntry(1));
+  EXPECT_EQ(rgba(0, 255, 0, 255), b.getEntry(1));
+
+  b.setEntry(1, rgba(255, 0, 0, 255));
+  EXPECT_TRUE(a == b);
+  EXPECT_EQ(a.hash(), b.hash());
+  EXPECT_EQ(0, a.countDiff(&b, nullptr, nullptr));
+}
+
+TEST(Palette, FindExactMatchInBigPalette)
+{
+  Palette pal(0, 4096);
+  for (int i=0; i<pal.size(); ++i)
+    pal.setEntry(i, rgba((i*37) & 255, (i*11) & 255, i >> 4, 255));
+
+  // Duplicated colors
+  pal.setEntry(100, pal.getEntry(3000));
+  pal.setEntry(4000, pal.getEntry(3000));
+
+  for (int i=0; i<pal.size(); i+=7) {
+    const color_t c = pal.getEntry(i);
+    int expected = -1;
+    for (int j=0; j<pal.size(); ++j)
+      if (pal.getEntry(j) == c) { expected = j; break; }
+
+    EXPECT_EQ(expected, pal.findExactMatch(rgba_getr(c), rgba_getg(c), rgba_getb(c), 255, -1));
+    EXPECT_TRUE(pal.findExactMatch(c));
+  }
+
+  const color_t c = pal.getEntry(3000);
+  EXPECT_EQ(100, pal.findExactMatch(rgba_getr(c), rgba_getg(c), rgba_getb(c), 255, -1));
+  EXPECT_EQ(3000, pal.findExactMatch(rgba_getr(c), rgba_getg(c), rgba_getb(c), 255, 100));
+  EXPECT_EQ(-1, pal.findExactMatch(1, 2, 3, 4, -1));
+  EXPECT_FALSE(pal.findExactMatch(rgba(1, 2, 3, 4)));
+
+  // The index is updated when the palette changes
+  pal.setEntry(5, rgba(1, 2, 3, 4));
+  EXPECT_EQ(5, pal.findExactMatch(1, 2, 3, 4, -1));
+  EXPECT_TRUE(pal.findExactMatch(rgba(1, 2, 3, 4)));
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  doc::Palette::initBestfit();
+  return RUN_ALL_TESTS();
+}
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018-2023 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -16,14 +16,20 @@
 #include "doc/dispatch.h"
 #include "doc/image_impl.h"
 #include "doc/palette.h"
+#include "doc/primitives_fast.h"
 #include "doc/remap.h"
 #include "doc/rgbmap.h"
+#include "doc/scan_row.h"
 #include "doc/tile.h"
 #include "gfx/region.h"
 
 #include <city.h>
 
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
+#include <type_traits>
+#include <vector>
 
 #if defined(__x86_64__) || defined(_WIN64)
   #include <emmintrin.h>
@@ -99,46 +105,94 @@ Image* crop_image(const Image* image, const gfx::Rect& bounds, color_t bg, const
   return crop_image(image, bounds.x, bounds.y, bounds.w, bounds.h, bg, buffer);
 }
 
+// Size of the square blocks of pixels rotated 90 degrees together,
+// so the rows of the source and destination blocks stay in the cache
+// (instead of walking the whole destination column for each pixel).
+static constexpr int kRotateBlockSize = 32;
+
+template<typename ImageTraits>
+static void rotate_image_templ(const Image* src, Image* dst, int angle)
+{
+  using address_t = typename ImageTraits::address_t;
+  using const_address_t = typename ImageTraits::const_address_t;
+  const int w = src->width();
+  const int h = src->height();
+
+  if (angle == 180) {
+    for (int y=0; y<h; ++y) {
+      auto s = (const_address_t)src->getPixelAddress(0, y);
+      auto d = (address_t)dst->getPixelAddress(0, h-y-1);
+      std::reverse_copy(s, s+w, d);
+    }
+    return;
+  }
+
+  for (int by=0; by<h; by+=kRotateBlockSize) {
+    const int by2 = std::min(by+kRotateBlockSize, h);
+    for (int bx=0; bx<w; bx+=kRotateBlockSize) {
+      const int bx2 = std::min(bx+kRotateBlockSize, w);
+      for (int y=by; y<by2; ++y) {
+        auto s = (const_address_t)src->getPixelAddress(0, y);
+        if (angle == 90) {
+          // (x, y) -> (h-y-1, x)
+          for (int x=bx; x<bx2; ++x)
+            *((address_t)dst->getPixelAddress(h-y-1, x)) = s[x];
+        }
+        else {
+          // (x, y) -> (y, w-x-1)
+          for (int x=bx; x<bx2; ++x)
+            *((address_t)dst->getPixelAddress(y, w-x-1)) = s[x];
+        }
+      }
+    }
+  }
+}
+
+template<>
+void rotate_image_templ<BitmapTraits>(const Image* src, Image* dst, int angle)
+{
+  const int w = src->width();
+  const int h = src->height();
+  for (int y=0; y<h; ++y) {
+    for (int x=0; x<w; ++x) {
+      const color_t c = get_pixel_fast<BitmapTraits>(src, x, y);
+      switch (angle) {
+        case 180: put_pixel_fast<BitmapTraits>(dst, w-x-1, h-y-1, c); break;
+        case 90:  put_pixel_fast<BitmapTraits>(dst, h-y-1, x, c); break;
+        case -90: put_pixel_fast<BitmapTraits>(dst, y, w-x-1, c); break;
+      }
+    }
+  }
+}
+
 void rotate_image(const Image* src, Image* dst, int angle)
 {
   ASSERT(src);
   ASSERT(dst);
-  int x, y;
+  ASSERT(src->pixelFormat() == dst->pixelFormat());
 
   switch (angle) {
 
     case 180:
       ASSERT(dst->width() == src->width());
       ASSERT(dst->height() == src->height());
-
-      for (y=0; y<src->height(); ++y)
-        for (x=0; x<src->width(); ++x)
-          dst->putPixel(src->width() - x - 1,
-                        src->height() - y - 1, src->getPixel(x, y));
       break;
 
     case 90:
-      ASSERT(dst->width() == src->height());
-      ASSERT(dst->height() == src->width());
-
-      for (y=0; y<src->height(); ++y)
-        for (x=0; x<src->width(); ++x)
-          dst->putPixel(src->height() - y - 1, x, src->getPixel(x, y));
-      break;
-
     case -90:
       ASSERT(dst->width() == src->height());
       ASSERT(dst->height() == src->width());
-
-      for (y=0; y<src->height(); ++y)
-        for (x=0; x<src->width(); ++x)
-          dst->putPixel(y, src->width() - x - 1, src->getPixel(x, y));
       break;
 
     // bad angle
     default:
       throw std::invalid_argument("Invalid angle specified to rotate the image");
   }
+
+  DOC_DISPATCH_BY_COLOR_MODE(
+    src->colorMode(),
+    rotate_image_templ,
+    src, dst, angle);
 }
 
 void draw_hline(Image* image, int x1, int y, int x2, color_t color)
@@ -314,6 +368,27 @@ namespace {
 template<typename ImageTraits>
 bool is_plain_image_templ(const Image* img, const color_t color)
 {
+  // Skip the pixels bitwise equal to the color with
+  // scan_row_first_diff() (fast path), and compare the different ones
+  // with same_color() (e.g. transparent pixels with different RGB
+  // values).
+  if constexpr (!std::is_same_v<ImageTraits, BitmapTraits>) {
+    using pixel_t = typename ImageTraits::pixel_t;
+    const int w = img->width();
+    const pixel_t ref = pixel_t(color);
+    for (int y=0; y<img->height(); ++y) {
+      auto ptr = (const pixel_t*)img->getPixelAddress(0, y);
+      for (int x=0; ; ++x) {
+        x += scan_row_first_diff(ptr+x, w-x, ref);
+        if (x >= w)
+          break;
+        if (!ImageTraits::same_color(ptr[x], color))
+          return false;
+      }
+    }
+    return true;
+  }
+
   const LockImageBits<ImageTraits> bits(img);
   typename LockImageBits<ImageTraits>::const_iterator it, end;
   for (it=bits.begin(), end=bits.end(); it!=end; ++it) {
@@ -514,74 +589,180 @@ void remap_image(Image* image, const Remap& remap)
          image->pixelFormat() == IMAGE_TILEMAP);
 
   switch (image->pixelFormat()) {
-    case IMAGE_INDEXED:
-      transform_image<IndexedTraits>(
-        image, [&remap](color_t c) -> color_t {
-          auto to = remap[c];
-          if (to != Remap::kUnused)
-            return to;
-          else
-            return c;
-        });
+    case IMAGE_INDEXED: {
+      // Table with all the 256 indexes (unused entries keep their
+      // index) so each pixel needs just one lookup.
+      uint8_t table[256];
+      for (int i=0; i<256; ++i) {
+        const int to = remap[i];
+        table[i] = uint8_t(to == Remap::kUnused ? i: to);
+      }
+
+      const int w = image->width();
+      const int h = image->height();
+      for (int y=0; y<h; ++y) {
+        auto p = (IndexedTraits::address_t)image->getPixelAddress(0, y);
+        for (int x=0; x<w; ++x, ++p)
+          *p = table[*p];
+      }
       break;
-    case IMAGE_TILEMAP:
-      transform_image<TilemapTraits>(
-        image, [&remap](color_t c) -> color_t {
-          auto to = remap[tile_geti(c)];
-          if (c == notile || to == Remap::kNoTile)
-            return notile;
-          else if (to != Remap::kUnused)
-            return tile(to, tile_getf(c));
-          else
-            return c;
-        });
+    }
+    case IMAGE_TILEMAP: {
+      // Flat table of the remap (without the kUnused entries) so each
+      // pixel needs just one lookup in a tight loop over each row.
+      const int n = remap.size();
+      std::vector<int> table(n);
+      for (int i=0; i<n; ++i) {
+        const int to = remap[i];
+        table[i] = (to == Remap::kUnused ? i: to);
+      }
+
+      const int w = image->width();
+      const int h = image->height();
+      for (int y=0; y<h; ++y) {
+        auto p = (TilemapTraits::address_t)image->getPixelAddress(0, y);
+        for (int x=0; x<w; ++x, ++p) {
+          const tile_t t = *p;
+          if (t == notile)
+            continue;
+
+          const tile_index ti = tile_geti(t);
+          if (ti < tile_index(n)) {
+            const int to = table[ti];
+            *p = (to == Remap::kNoTile ? notile: tile(to, tile_getf(t)));
+          }
+        }
+      }
       break;
+    }
   }
 }
 
-// TODO test this hash routine and find a better alternative
+uint64_t calculate_image_hash(const Image* image, const gfx::Rect& bounds)
+{
+  // The hash is calculated row by row (chaining the hash of each row
+  // as the seed of the next one), so we don't need to copy the
+  // sub-rectangle in a temporary buffer, and the result doesn't
+  // depend on the row stride of the image.
+  const int widthBytes =
+    (image->pixelFormat() == IMAGE_BITMAP ?
+     BitmapTraits::width_bytes(bounds.w):
+     image->bytesPerPixel() * bounds.w);
+  uint64_t hash = ((uint64_t(bounds.w) << 32) |
+                   (uint64_t(bounds.h) << 8) |
+                   uint64_t(image->pixelFormat()));
+  for (int y=0; y<bounds.h; ++y) {
+    hash = CityHash64WithSeed(
+      (const char*)image->getPixelAddress(bounds.x, bounds.y+y),
+      widthBytes, hash);
+  }
+  return hash;
+}
 
-template <typename ImageTraits, uint32_t Mask>
-static uint32_t calculate_image_hash_templ(const Image* image,
-                                           const gfx::Rect& bounds)
+uint64_t calculate_image_hash64(const Image* image)
 {
-#if defined(__LP64__) || defined(__x86_64__) || defined(_WIN64)
-  #define CITYHASH(buf, len) (CityHash64(buf, len) & 0xffffffff)
-  static_assert(sizeof(void*) == 8, "This CPU is not 64-bit");
-#else
-  #define CITYHASH(buf, len) CityHash32(buf, len)
-  static_assert(sizeof(void*) == 4, "This CPU is not 32-bit");
-#endif
+  return calculate_image_hash(image, image->bounds());
+}
 
-  const uint32_t widthBytes = ImageTraits::bytes_per_pixel * bounds.w;
-  const uint32_t len = widthBytes * bounds.h;
-  if (bounds == image->bounds() &&
-      widthBytes == image->rowBytes()) {
-    return CITYHASH((const char*)image->getPixelAddress(0, 0), len);
-  }
-  else {
-    std::vector<uint8_t> buf(len);
-    uint8_t* dst = &buf[0];
-    for (int y=0; y<bounds.h; ++y, dst+=widthBytes) {
-      auto src = (const uint8_t*)image->getPixelAddress(bounds.x, bounds.y+y);
-      std::copy(src, src+widthBytes, dst);
+namespace {
+
+// splitmix64 finalizer
+inline uint64_t mix_hash(uint64_t x)
+{
+  x ^= (x >> 30);
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= (x >> 27);
+  x *= 0x94d049bb133111ebull;
+  x ^= (x >> 31);
+  return x;
+}
+
+template<typename ImageTraits>
+uint64_t calculate_flip_invariant_hash_templ(const Image* image)
+{
+  const int w = image->width();
+  const int h = image->height();
+  const bool square = (w == h);
+
+  // Each pixel is mixed with the orbit of its position (all the
+  // positions where the pixel can be moved by the flips), and the
+  // results are added, so the order of the pixels in each orbit
+  // doesn't matter.
+  uint64_t hash = 0;
+  for (int y=0; y<h; ++y) {
+    const int b0 = std::min(y, h-1-y);
+    for (int x=0; x<w; ++x) {
+      int a = std::min(x, w-1-x);
+      int b = b0;
+      if (square && a > b)
+        std::swap(a, b);
+
+      const uint64_t orbit = (uint64_t(a) << 16) | uint64_t(b);
+      const uint64_t c = get_pixel_fast<ImageTraits>(image, x, y);
+      hash += mix_hash((orbit << 32) ^ c);
     }
-    return CITYHASH((const char*)&buf[0], buf.size());
   }
+  return hash ^ ((uint64_t(w) << 32) |
+                 (uint64_t(h) << 8) |
+                 uint64_t(image->pixelFormat()));
 }
 
-uint32_t calculate_image_hash(const Image* img, const gfx::Rect& bounds)
+template<typename ImageTraits>
+bool is_same_flipped_tile_templ(const Image* tile, const Image* image,
+                                const tile_flags flags)
 {
-  switch (img->pixelFormat()) {
-    case IMAGE_RGB:       return calculate_image_hash_templ<RgbTraits, rgba_rgb_mask>(img, bounds);
-    case IMAGE_GRAYSCALE: return calculate_image_hash_templ<GrayscaleTraits, graya_v_mask>(img, bounds);
-    case IMAGE_INDEXED:   return calculate_image_hash_templ<IndexedTraits, 0xff>(img, bounds);
-    case IMAGE_BITMAP:    return calculate_image_hash_templ<BitmapTraits, 1>(img, bounds);
+  const int w = tile->width();
+  const int h = tile->height();
+  for (int y=0; y<h; ++y) {
+    for (int x=0; x<w; ++x) {
+      // Position in "image" of the pixel that is moved to x,y
+      int u = x, v = y;
+      if (flags & tile_f_dflip)
+        std::swap(u, v);
+      if (flags & tile_f_yflip)
+        v = h-1-v;
+      if (flags & tile_f_xflip)
+        u = w-1-u;
+
+      if (get_pixel_fast<ImageTraits>(tile, x, y) !=
+          get_pixel_fast<ImageTraits>(image, u, v))
+        return false;
+    }
   }
+  return true;
+}
+
+} // anonymous namespace
+
+uint64_t calculate_flip_invariant_hash(const Image* image)
+{
+  DOC_DISPATCH_BY_COLOR_MODE(
+    image->colorMode(),
+    calculate_flip_invariant_hash_templ,
+    image);
   ASSERT(false);
   return 0;
 }
 
+bool is_same_flipped_tile(const Image* tile, const Image* image,
+                          const tile_flags flags)
+{
+  ASSERT(tile->pixelFormat() == image->pixelFormat());
+  ASSERT(tile->size() == image->size());
+  ASSERT((flags & tile_f_dflip) == 0 || tile->width() == tile->height());
+  if (tile->pixelFormat() != image->pixelFormat() ||
+      tile->size() != image->size() ||
+      ((flags & tile_f_dflip) && tile->width() != tile->height()))
+    return false;
+
+  DOC_DISPATCH_BY_COLOR_MODE(
+    tile->colorMode(),
+    is_same_flipped_tile_templ,
+    tile, image, flags);
+  ASSERT(false);
+  return false;
+}
+
 void preprocess_transparent_pixels(Image* image)
 {
   switch (image->pixelFormat()) {
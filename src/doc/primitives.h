@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018-2023 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -12,6 +12,7 @@
 #include "base/ints.h"
 #include "doc/color.h"
 #include "doc/image_buffer.h"
+#include "doc/tile.h"
 #include "gfx/fwd.h"
 
 namespace doc {
@@ -50,9 +51,31 @@ namespace doc {
 
   void remap_image(Image* image, const Remap& remap);
 
-  uint32_t calculate_image_hash(const Image* image,
+  // Returns a 64-bit hash of the pixels, size, and pixel format of
+  // the given bounds of the image. It doesn't allocate memory, and
+  // the same pixels give the same hash if they are a sub-rectangle
+  // of a bigger image.
+  uint64_t calculate_image_hash(const Image* image,
                                 const gfx::Rect& bounds);
 
+  // Returns a 64-bit hash of the whole image. It can be used to find
+  // duplicated images without keeping all of them in memory (the
+  // pixels of two images with the same hash must be compared with
+  // is_same_image() anyway).
+  uint64_t calculate_image_hash64(const Image* image);
+
+  // Returns a hash of the pixels of the image that doesn't change if
+  // the image is flipped in X or Y (or transposed if it's a square
+  // image), i.e. the hash is the same for all the orientations of a
+  // tile that can be matched with tile flags.
+  uint64_t calculate_flip_invariant_hash(const Image* image);
+
+  // Returns true if "image" flipped with the given tile flags (first
+  // X, then Y, and finally D) is equal to "tile". Images must have
+  // the same size and pixel format (and must be square for D flips).
+  bool is_same_flipped_tile(const Image* tile, const Image* image,
+                            const tile_flags flags);
+
   // Sets RGB values to 0 when alpha=0 (to match images with alpha=0
   // in tilesets/calculate_image_hash)
   void preprocess_transparent_pixels(Image* image);
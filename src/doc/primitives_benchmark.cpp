@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2023 Igara Studio S.A.
+// Copyright (c) 2023-2024 Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -41,6 +41,22 @@ void BM_IsSameImageNew(benchmark::State& state) {
   }
 }
 
+// Hashes all the 16x16 tiles of the image (like the tileset matching
+// does with each tile of a tilemap)
+void BM_ImageHashTiles(benchmark::State& state) {
+  const auto pf = (PixelFormat)state.range(0);
+  const int w = state.range(1);
+  const int h = state.range(2);
+  ImageRef a(Image::create(pf, w, h));
+  doc::algorithm::random_image(a.get());
+  while (state.KeepRunning()) {
+    for (int y=0; y+16<=h; y+=16)
+      for (int x=0; x+16<=w; x+=16)
+        benchmark::DoNotOptimize(
+          calculate_image_hash(a.get(), gfx::Rect(x, y, 16, 16)));
+  }
+}
+
 #define DEFARGS()                                                \
    ->Args({ IMAGE_RGB, 16, 16 })                                 \
    ->Args({ IMAGE_RGB, 1024, 1024 })                             \
@@ -60,4 +76,8 @@ BENCHMARK(BM_IsSameImageNew)
   DEFARGS()
   ->UseRealTime();
 
+BENCHMARK(BM_ImageHashTiles)
+  DEFARGS()
+  ->UseRealTime();
+
 BENCHMARK_MAIN();
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2023  Igara Studio S.A.
+// Copyright (c) 2023-2024  Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -12,10 +12,12 @@
 
 #include "doc/primitives.h"
 
+#include "doc/algorithm/flip_image.h"
 #include "doc/algorithm/random_image.h"
 #include "doc/image_impl.h"
 #include "doc/image_ref.h"
 #include "doc/primitives_fast.h"
+#include "doc/remap.h"
 
 #include <random>
 
@@ -80,6 +82,161 @@ TYPED_TEST(Primitives, IsSameImage)
   }
 }
 
+TYPED_TEST(Primitives, ImageHash64)
+{
+  using ImageTraits = TypeParam;
+
+  ImageRef a(Image::create(ImageTraits::pixel_format, 32, 16));
+  ImageRef b(Image::create(ImageTraits::pixel_format, 32, 16));
+  clear_image(a.get(), 0);
+  clear_image(b.get(), 0);
+  EXPECT_EQ(calculate_image_hash64(a.get()),
+            calculate_image_hash64(b.get()));
+
+  put_pixel_fast<ImageTraits>(b.get(), 5, 7, 1);
+  EXPECT_NE(calculate_image_hash64(a.get()),
+            calculate_image_hash64(b.get()));
+
+  // Same pixels with a different size
+  ImageRef c(Image::create(ImageTraits::pixel_format, 16, 32));
+  clear_image(c.get(), 0);
+  EXPECT_NE(calculate_image_hash64(a.get()),
+            calculate_image_hash64(c.get()));
+}
+
+TYPED_TEST(Primitives, ImageHashOfSubRect)
+{
+  using ImageTraits = TypeParam;
+
+  ImageRef a(Image::create(ImageTraits::pixel_format, 40, 20));
+  doc::algorithm::random_image(a.get());
+
+  // The hash of a sub-rectangle must be equal to the hash of the
+  // same pixels in its own image.
+  const gfx::Rect bounds(8, 3, 16, 10);
+  ImageRef b(crop_image(a.get(), bounds, 0));
+  EXPECT_EQ(calculate_image_hash(a.get(), bounds),
+            calculate_image_hash64(b.get()));
+
+  put_pixel_fast<ImageTraits>(b.get(), 5, 7,
+                              get_pixel_fast<ImageTraits>(b.get(), 5, 7) ^ 1);
+  EXPECT_NE(calculate_image_hash(a.get(), bounds),
+            calculate_image_hash64(b.get()));
+}
+
+TYPED_TEST(Primitives, FlippedTiles)
+{
+  using ImageTraits = TypeParam;
+  using namespace doc::algorithm;
+
+  ImageRef a(Image::create(ImageTraits::pixel_format, 8, 8));
+  doc::algorithm::random_image(a.get());
+  const uint64_t hash = calculate_flip_invariant_hash(a.get());
+
+  for (int i=1; i<8; ++i) {
+    const tile_flags flags = ((i & 1 ? tile_f_xflip: 0) |
+                              (i & 2 ? tile_f_yflip: 0) |
+                              (i & 4 ? tile_f_dflip: 0));
+
+    // Same order used by find_tile() to flip the image: X, Y, and D
+    ImageRef b(Image::createCopy(a.get()));
+    if (flags & tile_f_xflip) flip_image(b.get(), b->bounds(), FlipHorizontal);
+    if (flags & tile_f_yflip) flip_image(b.get(), b->bounds(), FlipVertical);
+    if (flags & tile_f_dflip) flip_image(b.get(), b->bounds(), FlipDiagonal);
+
+    EXPECT_EQ(hash, calculate_flip_invariant_hash(b.get()));
+    EXPECT_TRUE(is_same_flipped_tile(b.get(), a.get(), flags));
+  }
+
+  EXPECT_TRUE(is_same_flipped_tile(a.get(), a.get(), 0));
+}
+
+TYPED_TEST(Primitives, IsPlainImage)
+{
+  using ImageTraits = TypeParam;
+
+  for (int w=1; w<70; w+=3) {
+    ImageRef a(Image::create(ImageTraits::pixel_format, w, 3));
+    clear_image(a.get(), 0);
+    EXPECT_TRUE(is_plain_image(a.get(), 0));
+
+    for (int x=0; x<w; ++x) {
+      put_pixel_fast<ImageTraits>(a.get(), x, 1, 1);
+      EXPECT_FALSE(is_plain_image(a.get(), 0));
+      put_pixel_fast<ImageTraits>(a.get(), x, 1, 0);
+    }
+  }
+}
+
+TYPED_TEST(Primitives, RotateImage)
+{
+  using ImageTraits = TypeParam;
+
+  // Sizes that are not multiple of the rotation block size
+  const int w = 75, h = 41;
+  ImageRef a(Image::create(ImageTraits::pixel_format, w, h));
+  doc::algorithm::random_image(a.get());
+
+  ImageRef b(Image::create(ImageTraits::pixel_format, w, h));
+  rotate_image(a.get(), b.get(), 180);
+  for (int y=0; y<h; ++y)
+    for (int x=0; x<w; ++x)
+      ASSERT_EQ(get_pixel_fast<ImageTraits>(a.get(), x, y),
+                get_pixel_fast<ImageTraits>(b.get(), w-x-1, h-y-1));
+
+  ImageRef c(Image::create(ImageTraits::pixel_format, h, w));
+  rotate_image(a.get(), c.get(), 90);
+  for (int y=0; y<h; ++y)
+    for (int x=0; x<w; ++x)
+      ASSERT_EQ(get_pixel_fast<ImageTraits>(a.get(), x, y),
+                get_pixel_fast<ImageTraits>(c.get(), h-y-1, x));
+
+  ImageRef d(Image::create(ImageTraits::pixel_format, h, w));
+  rotate_image(a.get(), d.get(), -90);
+  for (int y=0; y<h; ++y)
+    for (int x=0; x<w; ++x)
+      ASSERT_EQ(get_pixel_fast<ImageTraits>(a.get(), x, y),
+                get_pixel_fast<ImageTraits>(d.get(), y, w-x-1));
+}
+
+TEST(Primitives, IsPlainImageTransparentPixels)
+{
+  // Transparent pixels with different RGB values are the same color
+  ImageRef a(Image::create(IMAGE_RGB, 40, 2));
+  clear_image(a.get(), rgba(0, 0, 0, 0));
+  put_pixel_fast<RgbTraits>(a.get(), 37, 1, rgba(255, 0, 0, 0));
+  EXPECT_TRUE(is_plain_image(a.get(), rgba(0, 0, 0, 0)));
+
+  put_pixel_fast<RgbTraits>(a.get(), 38, 1, rgba(255, 0, 0, 1));
+  EXPECT_FALSE(is_plain_image(a.get(), rgba(0, 0, 0, 0)));
+}
+
+TEST(Primitives, RemapIndexedImage)
+{
+  ImageRef a(Image::create(IMAGE_INDEXED, 300, 2));
+  for (int x=0; x<300; ++x) {
+    put_pixel_fast<IndexedTraits>(a.get(), x, 0, x & 255);
+    put_pixel_fast<IndexedTraits>(a.get(), x, 1, 255 - (x & 255));
+  }
+
+  // Remap with less entries than indexes, and an unused entry
+  Remap remap(4);
+  remap.map(0, 3);
+  remap.map(1, 2);
+  remap.map(2, 1);
+  remap.unused(3);
+  remap_image(a.get(), remap);
+
+  const int expected[] = { 3, 2, 1, 3 };
+  for (int x=0; x<300; ++x) {
+    const int i = (x & 255);
+    EXPECT_EQ(i < 4 ? expected[i]: i,
+              get_pixel_fast<IndexedTraits>(a.get(), x, 0));
+    EXPECT_EQ(255-i < 4 ? expected[255-i]: 255-i,
+              get_pixel_fast<IndexedTraits>(a.get(), x, 1));
+  }
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
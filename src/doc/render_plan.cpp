@@ -14,10 +14,25 @@
 #include "doc/layer.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 
 namespace doc {
 
+static std::atomic<uint32_t> g_structureVersion(0);
+
+// static
+uint32_t RenderPlan::structureVersion()
+{
+  return g_structureVersion;
+}
+
+// static
+void RenderPlan::incrementStructureVersion()
+{
+  ++g_structureVersion;
+}
+
 RenderPlan::RenderPlan()
 {
 }
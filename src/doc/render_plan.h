@@ -12,6 +12,8 @@
 #include "doc/cel_list.h"
 #include "doc/frame.h"
 
+#include <cstdint>
+
 namespace doc {
   class Layer;
 
@@ -43,6 +45,13 @@ namespace doc {
     void addLayer(const Layer* layer,
                   const frame_t frame);
 
+    // Returns a number that changes each time something used to
+    // create render plans is modified in any sprite (layers
+    // added/removed/moved/hidden, cels added/removed/moved, or cel
+    // z-indexes), so a plan can be reused while it doesn't change.
+    static uint32_t structureVersion();
+    static void incrementStructureVersion();
+
   private:
     void processZIndexes() const;
 
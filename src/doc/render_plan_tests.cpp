@@ -134,6 +134,38 @@ TEST(RenderPlan, ZIndexBugWithEmptyCels)
   d->setZIndex(-3); EXPECT_PLAN(d, a, b);
 }
 
+TEST(RenderPlan, StructureVersion)
+{
+  auto doc = std::make_shared<Document>();
+  ImageSpec spec(ColorMode::INDEXED, 2, 2);
+  Sprite* spr;
+  doc->sprites().add(spr = Sprite::MakeStdSprite(spec));
+
+  LayerImage* lay0 = static_cast<LayerImage*>(spr->root()->firstLayer());
+  Cel* cel = lay0->cel(0);
+
+  uint32_t v = RenderPlan::structureVersion();
+  cel->setZIndex(cel->zIndex());
+  lay0->setVisible(lay0->isVisible());
+  EXPECT_EQ(v, RenderPlan::structureVersion());
+
+  cel->setZIndex(1);
+  EXPECT_NE(v, RenderPlan::structureVersion());
+
+  v = RenderPlan::structureVersion();
+  lay0->setVisible(false);
+  EXPECT_NE(v, RenderPlan::structureVersion());
+
+  v = RenderPlan::structureVersion();
+  auto lay1 = new LayerImage(spr);
+  spr->root()->addLayer(lay1);
+  EXPECT_NE(v, RenderPlan::structureVersion());
+
+  v = RenderPlan::structureVersion();
+  lay1->addCel(new Cel(0, ImageRef(Image::create(spec))));
+  EXPECT_NE(v, RenderPlan::structureVersion());
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
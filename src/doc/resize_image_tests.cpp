@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2022 Igara Studio S.A.
+// Copyright (c) 2022-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -17,6 +17,8 @@
 #include "doc/image_ref.h"
 #include "doc/primitives.h"
 
+#include <cmath>
+
 using namespace std;
 using namespace doc;
 
@@ -86,6 +88,30 @@ TEST(ResizeImage, NearestNeighborInterp)
   ASSERT_EQ(0, count_diff_between_images(src.get(), dst2.get()));
 }
 
+// Big enough image to be resized in several threads
+TEST(ResizeImage, NearestNeighborBigImage)
+{
+  for (PixelFormat format : { IMAGE_RGB, IMAGE_GRAYSCALE, IMAGE_INDEXED }) {
+    ImageRef src(Image::create(format, 301, 257));
+    for (int y=0; y<src->height(); ++y)
+      for (int x=0; x<src->width(); ++x)
+        src->putPixel(x, y, (x*7 + y*13) & 0xff);
+
+    ImageRef dst(Image::create(format, 700, 513));
+    algorithm::resize_image(src.get(), dst.get(),
+                            algorithm::RESIZE_METHOD_NEAREST_NEIGHBOR,
+                            nullptr, nullptr, -1);
+
+    const double x_ratio = double(src->width()) / double(dst->width());
+    const double y_ratio = double(src->height()) / double(dst->height());
+    for (int y=0; y<dst->height(); ++y)
+      for (int x=0; x<dst->width(); ++x)
+        ASSERT_EQ(src->getPixel(int(std::floor(x * x_ratio)),
+                                int(std::floor(y * y_ratio))),
+                  dst->getPixel(x, y));
+  }
+}
+
 #if 0                           // TODO complete this test
 TEST(ResizeImage, BilinearInterpRGBType)
 {
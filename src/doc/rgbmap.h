@@ -13,6 +13,8 @@
 #include "doc/fit_criteria.h"
 #include "doc/rgbmap_algorithm.h"
 
+#include <memory>
+
 namespace doc {
 
   class Palette;
@@ -34,6 +36,9 @@ namespace doc {
 
     virtual int maskIndex() const = 0;
 
+    // Palette used in the last regenerateMap() call.
+    virtual const Palette* palette() const = 0;
+
     virtual RgbMapAlgorithm rgbmapAlgorithm() const = 0;
 
     virtual int modifications() const = 0;
@@ -55,6 +60,10 @@ namespace doc {
 
   };
 
+  // Creates a new RgbMap that uses the given algorithm (the DEFAULT
+  // one is the octree). Returns nullptr for unknown algorithms.
+  std::unique_ptr<RgbMap> create_rgbmap(const RgbMapAlgorithm mapAlgo);
+
 } // namespace doc
 
 #endif
@@ -10,10 +10,26 @@
 
 #include "doc/rgbmap_base.h"
 
+#include "doc/octree_map.h"
+#include "doc/rgbmap_kdtree.h"
+#include "doc/rgbmap_rgb5a3.h"
+
+#include <algorithm>
 #include <cmath>
 
 namespace doc {
 
+std::unique_ptr<RgbMap> create_rgbmap(const RgbMapAlgorithm mapAlgo)
+{
+  switch (mapAlgo) {
+    case RgbMapAlgorithm::RGB5A3: return std::make_unique<RgbMapRGB5A3>();
+    case RgbMapAlgorithm::DEFAULT:
+    case RgbMapAlgorithm::OCTREE: return std::make_unique<OctreeMap>();
+    case RgbMapAlgorithm::KDTREE: return std::make_unique<RgbMapKdTree>();
+  }
+  return nullptr;
+}
+
 // Auxiliary function for rgbToOtherSpace()
 double f(double t)
 {
@@ -83,6 +99,100 @@ void RgbMapBase::rgbToOtherSpace(double& r, double& g, double& b) const
   }
 }
 
+void RgbMapBase::regenerateFitPalette()
+{
+  m_fitPalette.clear();
+  m_fitPaletteSource = m_palette;
+  m_fitPaletteCriteria = m_fitCriteria;
+  if (!m_palette || m_fitCriteria == FitCriteria::DEFAULT)
+    return;
+
+  m_fitPaletteModifications = m_palette->getModifications();
+
+  const int size = m_palette->size();
+  m_fitPalette.resize(4*size);
+  double* p = m_fitPalette.data();
+  for (int i=0; i<size; ++i, p+=4) {
+    color_t rgb = m_palette->getEntry(i);
+    p[0] = double(rgba_getr(rgb));
+    p[1] = double(rgba_getg(rgb));
+    p[2] = double(rgba_getb(rgb));
+    p[3] = double(rgba_geta(rgb));
+    rgbToOtherSpace(p[0], p[1], p[2]);
+  }
+}
+
+bool RgbMapBase::isFitPaletteValid() const
+{
+  return (m_fitPaletteSource == m_palette &&
+          m_fitPaletteCriteria == m_fitCriteria &&
+          m_fitPaletteModifications == m_palette->getModifications() &&
+          int(m_fitPalette.size()) == 4*m_palette->size());
+}
+
+bool RgbMapBase::hasBetterFit(int r, int g, int b, int a,
+                              int mask_index, int bestfit,
+                              const std::vector<int>& candidates) const
+{
+  if (m_fitCriteria == FitCriteria::DEFAULT) {
+    // Same weighted distance between 5-bit components used in
+    // Palette::findBestfit()
+    r >>= 3;
+    g >>= 3;
+    b >>= 3;
+    a >>= 3;
+    auto distance = [this, r, g, b, a](const int i){
+      const color_t c = m_palette->getEntry(i);
+      const int dr = (rgba_getr(c)>>3) - r;
+      const int dg = (rgba_getg(c)>>3) - g;
+      const int db = (rgba_getb(c)>>3) - b;
+      const int da = (rgba_geta(c)>>3) - a;
+      return dr*dr*30*30 + dg*dg*59*59 + db*db*11*11 + da*da*8*8;
+    };
+
+    const int size = std::min(256, m_palette->size());
+    if (bestfit >= size)
+      return true;
+
+    const int lowest = distance(bestfit);
+    for (int i : candidates) {
+      if (i == mask_index || i >= size)
+        continue;
+      const int diff = distance(i);
+      if (diff < lowest || (diff == lowest && i < bestfit))
+        return true;
+    }
+    return false;
+  }
+
+  if (!isFitPaletteValid() || bestfit >= m_palette->size())
+    return true;
+
+  double x = double(r);
+  double y = double(g);
+  double z = double(b);
+  rgbToOtherSpace(x, y, z);
+
+  auto distance = [this, x, y, z, a](const int i){
+    const double* p = &m_fitPalette[4*i];
+    const double xDiff = x - p[0];
+    const double yDiff = y - p[1];
+    const double zDiff = z - p[2];
+    const double aDiff = (double(a) - p[3]) / 128.0;
+    return xDiff * xDiff + yDiff * yDiff + zDiff * zDiff + aDiff * aDiff;
+  };
+
+  const double lowest = distance(bestfit);
+  for (int i : candidates) {
+    if (i >= m_palette->size())
+      continue;
+    const double diff = distance(i);
+    if (diff < lowest || (diff == lowest && i < bestfit))
+      return true;
+  }
+  return false;
+}
+
 int RgbMapBase::findBestfit(int r, int g, int b, int a,
                             int mask_index) const
 {
@@ -107,6 +217,23 @@ int RgbMapBase::findBestfit(int r, int g, int b, int a,
 
   rgbToOtherSpace(x, y, z);
 
+  if (isFitPaletteValid()) {
+    const double* p = m_fitPalette.data();
+    for (int i=0; i<size; ++i, p+=4) {
+      const double xDiff = x - p[0];
+      const double yDiff = y - p[1];
+      const double zDiff = z - p[2];
+      const double aDiff = (double(a) - p[3]) / 128.0;
+
+      double diff = xDiff * xDiff + yDiff * yDiff + zDiff * zDiff + aDiff * aDiff;
+      if (diff < lowest) {
+        lowest = diff;
+        bestfit = i;
+      }
+    }
+    return bestfit;
+  }
+
   for (int i=0; i<size; ++i) {
     color_t rgb = m_palette->getEntry(i);
     double Xpal = double(rgba_getr(rgb));
@@ -12,6 +12,8 @@
 #include "doc/palette.h"
 #include "doc/rgbmap.h"
 
+#include <vector>
+
 namespace doc {
 
 class RgbMapBase : public RgbMap {
@@ -22,19 +24,48 @@ public:
   // RgbMap impl
   int modifications() const override { return m_modifications; }
   int maskIndex() const override { return m_maskIndex; }
+  const Palette* palette() const override { return m_palette; }
   FitCriteria fitCriteria() const override { return m_fitCriteria; }
   void fitCriteria(const FitCriteria fitCriteria) override {
     m_fitCriteria = fitCriteria;
   }
 
-private:
+protected:
+  // Converts all palette entries to the color space of the current
+  // fit criteria, so findBestfit() doesn't need to convert each
+  // entry in each call. Must be called from regenerateMap() after
+  // m_palette and m_fitCriteria are updated.
+  void regenerateFitPalette();
+
+  // Converts the given RGB values to the color space of the current
+  // fit criteria.
   void rgbToOtherSpace(double& r, double& g, double& b) const;
 
+  // Returns true if findBestfit(r, g, b, a, mask_index) could return
+  // one of the given "candidates" instead of "bestfit" (i.e. if some
+  // candidate entry is nearer than "bestfit", or at the same distance
+  // with a lower index). Used to know if a cached result must be
+  // regenerated when only the candidates entries were modified.
+  bool hasBetterFit(int r, int g, int b, int a,
+                    int mask_index, int bestfit,
+                    const std::vector<int>& candidates) const;
+
+private:
+  bool isFitPaletteValid() const;
+
 protected:
   FitCriteria m_fitCriteria;
   const Palette* m_palette = nullptr;
   int m_modifications = 0;
   int m_maskIndex = 0;
+
+private:
+  // Palette entries converted with rgbToOtherSpace() (4 values for
+  // each entry: x, y, z, and alpha).
+  std::vector<double> m_fitPalette;
+  const Palette* m_fitPaletteSource = nullptr;
+  int m_fitPaletteModifications = 0;
+  FitCriteria m_fitPaletteCriteria = FitCriteria::DEFAULT;
 };
 
 } // namespace doc
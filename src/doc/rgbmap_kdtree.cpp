@@ -0,0 +1,203 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/rgbmap_kdtree.h"
+
+#include "doc/palette.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace doc {
+
+// Squared distance between two points. It must be calculated in the
+// same order as in RgbMapBase::findBestfit() to get the same
+// results (and ties) with floating point values.
+static inline double distance(const double* a, const double* b)
+{
+  const double xDiff = a[0] - b[0];
+  const double yDiff = a[1] - b[1];
+  const double zDiff = a[2] - b[2];
+  const double aDiff = a[3] - b[3];
+  return xDiff * xDiff + yDiff * yDiff + zDiff * zDiff + aDiff * aDiff;
+}
+
+RgbMapKdTree::RgbMapKdTree()
+{
+  m_fitCriteria = FitCriteria::DEFAULT;
+}
+
+void RgbMapKdTree::regenerateMap(const Palette* palette,
+                                 const int maskIndex,
+                                 const FitCriteria fitCriteria)
+{
+  ASSERT(palette);
+  if (!palette)
+    return;
+
+  // Skip useless regenerations
+  if (m_palette == palette &&
+      m_modifications == palette->getModifications() &&
+      m_maskIndex == maskIndex &&
+      m_fitCriteria == fitCriteria)
+    return;
+
+  m_palette = palette;
+  m_fitCriteria = fitCriteria;
+  m_modifications = palette->getModifications();
+  m_maskIndex = maskIndex;
+
+  m_nodes.clear();
+
+  if (m_fitCriteria == FitCriteria::DEFAULT) {
+    // Same weighted distance between 5-bit components used by
+    // Palette::findBestfit(), which never returns the mask index
+    // (except for transparent colors) and only uses the first 256
+    // entries.
+    const int size = std::min(256, palette->size());
+    m_nodes.reserve(size);
+    for (int i=0; i<size; ++i) {
+      if (i == maskIndex)
+        continue;
+
+      const color_t c = palette->getEntry(i);
+      m_nodes.push_back(Node{ { double((rgba_getr(c)>>3) * 30),
+                                double((rgba_getg(c)>>3) * 59),
+                                double((rgba_getb(c)>>3) * 11),
+                                double((rgba_geta(c)>>3) * 8) },
+                              i, 0 });
+    }
+  }
+  else {
+    const int size = palette->size();
+    m_nodes.reserve(size);
+    for (int i=0; i<size; ++i) {
+      const color_t c = palette->getEntry(i);
+      Node node{ { double(rgba_getr(c)),
+                   double(rgba_getg(c)),
+                   double(rgba_getb(c)),
+                   double(rgba_geta(c)) / 128.0 },
+                 i, 0 };
+      rgbToOtherSpace(node.pos[0], node.pos[1], node.pos[2]);
+      m_nodes.push_back(node);
+    }
+  }
+
+  build(0, int(m_nodes.size()));
+}
+
+int RgbMapKdTree::mapColor(const color_t rgba) const
+{
+  const int r = rgba_getr(rgba);
+  const int g = rgba_getg(rgba);
+  const int b = rgba_getb(rgba);
+  const int a = rgba_geta(rgba);
+  double pos[4];
+
+  if (m_fitCriteria == FitCriteria::DEFAULT) {
+    if ((a>>3) == 0 && m_maskIndex >= 0)
+      return m_maskIndex;
+
+    pos[0] = double((r>>3) * 30);
+    pos[1] = double((g>>3) * 59);
+    pos[2] = double((b>>3) * 11);
+    pos[3] = double((a>>3) * 8);
+  }
+  else {
+    if (a == 0 && m_maskIndex >= 0)
+      return m_maskIndex;
+
+    pos[0] = double(r);
+    pos[1] = double(g);
+    pos[2] = double(b);
+    pos[3] = double(a) / 128.0;
+    rgbToOtherSpace(pos[0], pos[1], pos[2]);
+  }
+
+  int bestfit = std::numeric_limits<int>::max();
+  double lowest = std::numeric_limits<double>::max();
+  search(0, int(m_nodes.size()), pos, bestfit, lowest);
+
+  // Empty tree (e.g. a palette with just the mask color)
+  if (bestfit == std::numeric_limits<int>::max())
+    return 0;
+  return bestfit;
+}
+
+void RgbMapKdTree::build(const int begin, const int end)
+{
+  if (end - begin < 2)
+    return;
+
+  // Split by the axis with the biggest extent
+  double lo[4], hi[4];
+  std::copy(m_nodes[begin].pos, m_nodes[begin].pos+4, lo);
+  std::copy(m_nodes[begin].pos, m_nodes[begin].pos+4, hi);
+  for (int i=begin+1; i<end; ++i) {
+    for (int k=0; k<4; ++k) {
+      lo[k] = std::min(lo[k], m_nodes[i].pos[k]);
+      hi[k] = std::max(hi[k], m_nodes[i].pos[k]);
+    }
+  }
+  int axis = 0;
+  for (int k=1; k<4; ++k)
+    if (hi[k]-lo[k] > hi[axis]-lo[axis])
+      axis = k;
+
+  const int mid = (begin + end) / 2;
+  std::nth_element(m_nodes.begin()+begin,
+                   m_nodes.begin()+mid,
+                   m_nodes.begin()+end,
+                   [axis](const Node& a, const Node& b){
+                     return a.pos[axis] < b.pos[axis];
+                   });
+  m_nodes[mid].axis = axis;
+
+  build(begin, mid);
+  build(mid+1, end);
+}
+
+void RgbMapKdTree::search(const int begin, const int end,
+                          const double* pos,
+                          int& bestfit, double& lowest) const
+{
+  if (begin >= end)
+    return;
+
+  const int mid = (begin + end) / 2;
+  const Node& node = m_nodes[mid];
+
+  // Ties are resolved with the lowest palette index (like
+  // findBestfit() does iterating the palette in order).
+  const double diff = distance(pos, node.pos);
+  if (diff < lowest || (diff == lowest && node.index < bestfit)) {
+    lowest = diff;
+    bestfit = node.index;
+  }
+
+  if (end - begin == 1)
+    return;
+
+  // Visit the side of the query point first, and the other side
+  // only if it can contain a nearer (or equal) entry.
+  const double delta = pos[node.axis] - node.pos[node.axis];
+  if (delta < 0.0) {
+    search(begin, mid, pos, bestfit, lowest);
+    if (delta*delta <= lowest)
+      search(mid+1, end, pos, bestfit, lowest);
+  }
+  else {
+    search(mid+1, end, pos, bestfit, lowest);
+    if (delta*delta <= lowest)
+      search(begin, mid, pos, bestfit, lowest);
+  }
+}
+
+} // namespace doc
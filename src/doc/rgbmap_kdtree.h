@@ -0,0 +1,65 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_RGBMAP_KDTREE_H_INCLUDED
+#define DOC_RGBMAP_KDTREE_H_INCLUDED
+#pragma once
+
+#include "base/disable_copying.h"
+#include "doc/rgbmap_base.h"
+
+#include <vector>
+
+namespace doc {
+
+  class Palette;
+
+  // Maps colors searching the nearest palette entry in a k-d tree.
+  // The tree is created from the palette entries converted to the
+  // space of the current FitCriteria, so the result is the same as
+  // RgbMapBase::findBestfit() but each search visits O(log n)
+  // entries, and regenerating the map only needs to sort the palette
+  // (there is no big table to invalidate).
+  class RgbMapKdTree : public RgbMapBase {
+  public:
+    RgbMapKdTree();
+
+    // RgbMap impl
+    void regenerateMap(const Palette* palette,
+                       const int maskIndex,
+                       const FitCriteria fitCriteria) override;
+    void regenerateMap(const Palette* palette,
+                       const int maskIndex) override {
+      regenerateMap(palette, maskIndex, m_fitCriteria);
+    }
+
+    int mapColor(const color_t rgba) const override;
+
+    RgbMapAlgorithm rgbmapAlgorithm() const override {
+      return RgbMapAlgorithm::KDTREE;
+    }
+
+  private:
+    struct Node {
+      double pos[4];    // Palette entry in the fit criteria space
+      int index;        // Palette index
+      int axis;         // Axis used to split the children of this node
+    };
+
+    void build(int begin, int end);
+    void search(int begin, int end, const double* pos,
+                int& bestfit, double& lowest) const;
+
+    // Balanced tree: the root of each range [begin, end) is the
+    // node in the middle.
+    std::vector<Node> m_nodes;
+
+    DISABLE_COPYING(RgbMapKdTree);
+  };
+
+} // namespace doc
+
+#endif
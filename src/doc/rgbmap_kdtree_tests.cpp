@@ -0,0 +1,75 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/palette.h"
+#include "doc/rgbmap_kdtree.h"
+
+#include <cstdlib>
+
+using namespace doc;
+
+static color_t random_color()
+{
+  return rgba(std::rand() & 255, std::rand() & 255,
+              std::rand() & 255, std::rand() & 255);
+}
+
+TEST(RgbMapKdTree, SameAsFindBestfit)
+{
+  std::srand(1);
+  for (int fc=int(FitCriteria::DEFAULT); fc<=int(FitCriteria::CIELAB); ++fc) {
+    for (int t=0; t<50; ++t) {
+      Palette pal(0, 1 + (std::rand() % 256));
+      for (int i=0; i<pal.size(); ++i) {
+        // Repeat some entries to test ties
+        if (i > 0 && (std::rand() % 8) == 0)
+          pal.setEntry(i, pal.getEntry(std::rand() % i));
+        else
+          pal.setEntry(i, random_color());
+      }
+
+      const int maskIndex = (std::rand() % (pal.size()+1)) - 1;
+      RgbMapKdTree rgbmap;
+      rgbmap.regenerateMap(&pal, maskIndex, FitCriteria(fc));
+
+      for (int k=0; k<100; ++k) {
+        const color_t c = ((k & 3) == 0 ? pal.getEntry(std::rand() % pal.size()):
+                                          random_color());
+        EXPECT_EQ(rgbmap.findBestfit(rgba_getr(c), rgba_getg(c),
+                                     rgba_getb(c), rgba_geta(c), maskIndex),
+                  rgbmap.mapColor(c));
+      }
+    }
+  }
+}
+
+TEST(RgbMapKdTree, RegenerateWhenPaletteChanges)
+{
+  Palette pal(0, 2);
+  pal.setEntry(0, rgba(0, 0, 0, 255));
+  pal.setEntry(1, rgba(255, 255, 255, 255));
+
+  RgbMapKdTree rgbmap;
+  rgbmap.regenerateMap(&pal, -1, FitCriteria::DEFAULT);
+  EXPECT_EQ(1, rgbmap.mapColor(rgba(250, 250, 250, 255)));
+
+  pal.setEntry(0, rgba(250, 250, 250, 255));
+  rgbmap.regenerateMap(&pal, -1);
+  EXPECT_EQ(0, rgbmap.mapColor(rgba(250, 250, 250, 255)));
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  doc::Palette::initBestfit();
+  return RUN_ALL_TESTS();
+}
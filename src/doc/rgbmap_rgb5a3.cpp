@@ -22,6 +22,11 @@ namespace doc {
 #define ASIZE   8
 #define MAPSIZE (RSIZE*GSIZE*BSIZE*ASIZE)
 
+// Maximum number of modified palette entries to check which table
+// entries must be regenerated (with more modified entries the whole
+// table is invalidated).
+static constexpr int kMaxIncrementalChanges = 32;
+
 RgbMapRGB5A3::RgbMapRGB5A3() : m_map(MAPSIZE) {}
 
 void RgbMapRGB5A3::regenerateMap(const Palette* palette,
@@ -35,14 +40,73 @@ void RgbMapRGB5A3::regenerateMap(const Palette* palette,
       m_fitCriteria == fitCriteria)
     return;
 
+  // If only a few colors were modified, we can keep the table entries
+  // that cannot be affected by the new colors.
+  const bool incremental =
+    (!m_colors.empty() &&
+     int(m_colors.size()) == palette->size() &&
+     m_maskIndex == maskIndex &&
+     m_fitCriteria == fitCriteria);
+
   m_palette = palette;
   m_fitCriteria = fitCriteria;
   m_modifications = palette->getModifications();
   m_maskIndex = maskIndex;
+  regenerateFitPalette();
+
+  if (!incremental || !invalidateModifiedEntries()) {
+    // Mark all entries as invalid (need to be regenerated)
+    for (uint16_t& entry : m_map)
+      entry |= INVALID;
+  }
+
+  m_colors.resize(palette->size());
+  for (int i=0; i<palette->size(); ++i)
+    m_colors[i] = palette->getEntry(i);
+}
+
+bool RgbMapRGB5A3::invalidateModifiedEntries()
+{
+  std::vector<int> modified;
+  std::vector<bool> isModified(m_colors.size(), false);
+  for (int i=0; i<int(m_colors.size()); ++i) {
+    if (m_colors[i] != m_palette->getEntry(i)) {
+      if (modified.size() == kMaxIncrementalChanges)
+        return false;
+      modified.push_back(i);
+      isModified[i] = true;
+    }
+  }
+  if (modified.empty())
+    return true;
+
+  for (int i=0; i<MAPSIZE; ++i) {
+    uint16_t& entry = m_map[i];
+    if (entry & INVALID)
+      continue;
+
+    // The best fit itself was modified
+    const int bestfit = entry;
+    if (bestfit >= int(isModified.size()) || isModified[bestfit]) {
+      entry |= INVALID;
+      continue;
+    }
+
+    // Same RGBA values used in generateEntry()
+    const int r = scale_5bits_to_8bits((i >> 13) & 0x1f);
+    const int g = scale_5bits_to_8bits((i >> 8) & 0x1f);
+    const int b = scale_5bits_to_8bits((i >> 3) & 0x1f);
+    const int a = scale_3bits_to_8bits(i & 0x7);
+
+    // Transparent colors are mapped to the mask index
+    if (m_maskIndex >= 0 &&
+        (m_fitCriteria == FitCriteria::DEFAULT ? (a >> 3) == 0: a == 0))
+      continue;
 
-  // Mark all entries as invalid (need to be regenerated)
-  for (uint16_t& entry : m_map)
-    entry |= INVALID;
+    if (hasBetterFit(r, g, b, a, m_maskIndex, bestfit, modified))
+      entry |= INVALID;
+  }
+  return true;
 }
 
 int RgbMapRGB5A3::generateEntry(int i, int r, int g, int b, int a) const
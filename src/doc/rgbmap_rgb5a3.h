@@ -56,9 +56,14 @@ namespace doc {
 
   private:
     int generateEntry(int i, int r, int g, int b, int a) const;
+    bool invalidateModifiedEntries();
 
     mutable std::vector<uint16_t> m_map;
 
+    // Palette colors used in the last regenerateMap() call, to
+    // invalidate only the entries affected by modified colors.
+    std::vector<color_t> m_colors;
+
     DISABLE_COPYING(RgbMapRGB5A3);
   };
 
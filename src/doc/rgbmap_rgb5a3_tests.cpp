@@ -0,0 +1,66 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/palette.h"
+#include "doc/rgbmap_rgb5a3.h"
+
+#include <cstdlib>
+
+using namespace doc;
+
+static color_t random_color()
+{
+  return rgba(std::rand() & 255, std::rand() & 255,
+              std::rand() & 255, std::rand() & 255);
+}
+
+// Modifying a few palette entries invalidates only some entries of
+// the table, the result must be the same as a new table.
+TEST(RgbMapRGB5A3, RegenerateModifiedEntries)
+{
+  std::srand(1);
+  for (FitCriteria fc : { FitCriteria::DEFAULT, FitCriteria::CIELAB }) {
+    for (int maskIndex : { -1, 0 }) {
+      Palette pal(0, 64);
+      for (int i=0; i<pal.size(); ++i)
+        pal.setEntry(i, random_color());
+
+      RgbMapRGB5A3 rgbmap;
+      rgbmap.regenerateMap(&pal, maskIndex, fc);
+      for (int k=0; k<20000; ++k)
+        rgbmap.mapColor(random_color());
+
+      for (int step=0; step<4; ++step) {
+        for (int k=0; k<3; ++k) {
+          const int i = std::rand() % pal.size();
+          pal.setEntry(i, (k == 0 ? pal.getEntry(std::rand() % pal.size()):
+                                    random_color()));
+        }
+        rgbmap.regenerateMap(&pal, maskIndex, fc);
+
+        RgbMapRGB5A3 expected;
+        expected.regenerateMap(&pal, maskIndex, fc);
+        for (int k=0; k<5000; ++k) {
+          const color_t c = random_color();
+          ASSERT_EQ(expected.mapColor(c), rgbmap.mapColor(c));
+        }
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  doc::Palette::initBestfit();
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,102 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_SCAN_ROW_H_INCLUDED
+#define DOC_SCAN_ROW_H_INCLUDED
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define DOC_SCAN_ROW_SSE2 1
+  #include <emmintrin.h>
+#else
+  #define DOC_SCAN_ROW_SSE2 0
+#endif
+
+namespace doc {
+
+#if DOC_SCAN_ROW_SSE2
+  namespace details {
+
+    template<typename pixel_t>
+    inline __m128i scan_row_splat(const pixel_t ref) {
+      if constexpr (sizeof(pixel_t) == 4)
+        return _mm_set1_epi32(int(ref));
+      else if constexpr (sizeof(pixel_t) == 2)
+        return _mm_set1_epi16(short(ref));
+      else
+        return _mm_set1_epi8(char(ref));
+    }
+
+    // True if the 16 bytes in ptr are equal to "r"
+    inline bool scan_row_block_eq(const void* ptr, const __m128i r) {
+      const __m128i a = _mm_loadu_si128((const __m128i*)ptr);
+      return (_mm_movemask_epi8(_mm_cmpeq_epi8(a, r)) == 0xffff);
+    }
+
+  } // namespace details
+#endif
+
+  // Returns the index of the first pixel in ptr[0,n) that is not
+  // bitwise equal to "ref", or n if all pixels are equal. With SSE2,
+  // blocks of 32 and 16 bytes are compared at once.
+  template<typename pixel_t>
+  inline int scan_row_first_diff(const pixel_t* ptr, const int n,
+                                 const pixel_t ref) {
+    static_assert(std::is_integral_v<pixel_t>);
+    int i = 0;
+#if DOC_SCAN_ROW_SSE2
+    constexpr int k = 16 / sizeof(pixel_t); // Pixels per block
+    const __m128i r = details::scan_row_splat(ref);
+    for (; i+2*k<=n; i+=2*k) {
+      if (!details::scan_row_block_eq(ptr+i, r) ||
+          !details::scan_row_block_eq(ptr+i+k, r))
+        break;
+    }
+    for (; i+k<=n; i+=k) {
+      if (!details::scan_row_block_eq(ptr+i, r))
+        break;
+    }
+#endif
+    for (; i<n; ++i) {
+      if (ptr[i] != ref)
+        return i;
+    }
+    return n;
+  }
+
+  // Returns the index of the last pixel in ptr[0,n) that is not
+  // bitwise equal to "ref", or -1 if all pixels are equal.
+  template<typename pixel_t>
+  inline int scan_row_last_diff(const pixel_t* ptr, const int n,
+                                const pixel_t ref) {
+    static_assert(std::is_integral_v<pixel_t>);
+    int i = n;                  // Pixels in ptr[i,n) are equal to ref
+#if DOC_SCAN_ROW_SSE2
+    constexpr int k = 16 / sizeof(pixel_t);
+    const __m128i r = details::scan_row_splat(ref);
+    for (; i-2*k>=0; i-=2*k) {
+      if (!details::scan_row_block_eq(ptr+i-k, r) ||
+          !details::scan_row_block_eq(ptr+i-2*k, r))
+        break;
+    }
+    for (; i-k>=0; i-=k) {
+      if (!details::scan_row_block_eq(ptr+i-k, r))
+        break;
+    }
+#endif
+    for (--i; i>=0; --i) {
+      if (ptr[i] != ref)
+        return i;
+    }
+    return -1;
+  }
+
+} // namespace doc
+
+#endif
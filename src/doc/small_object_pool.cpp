@@ -0,0 +1,99 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/small_object_pool.h"
+
+#include <mutex>
+#include <new>
+
+// With AddressSanitizer we use the global allocator to detect
+// use-after-free errors of these objects.
+#if defined(__SANITIZE_ADDRESS__)
+  #define DOC_SMALL_OBJECT_POOL_DISABLED 1
+#elif defined(__has_feature)
+  #if __has_feature(address_sanitizer)
+    #define DOC_SMALL_OBJECT_POOL_DISABLED 1
+  #endif
+#endif
+
+namespace doc {
+
+namespace {
+
+const std::size_t kGranularity = 16;
+const std::size_t kClasses = kMaxSmallObjectSize / kGranularity;
+const std::size_t kBlockSize = 64*1024;
+
+struct FreeChunk {
+  FreeChunk* next;
+};
+
+struct SizeClass {
+  std::mutex mutex;
+  FreeChunk* freeList = nullptr;
+};
+
+SizeClass g_classes[kClasses];
+
+inline std::size_t size_class_index(std::size_t size)
+{
+  return (size + kGranularity - 1) / kGranularity - 1;
+}
+
+// Allocates a new block and splits it in chunks of the given size
+// (the lock of the size class must be acquired).
+void refill(SizeClass& sc, const std::size_t chunkSize)
+{
+  auto block = static_cast<char*>(::operator new(kBlockSize));
+  const std::size_t n = kBlockSize / chunkSize;
+  for (std::size_t i=0; i<n; ++i) {
+    auto chunk = reinterpret_cast<FreeChunk*>(block + i*chunkSize);
+    chunk->next = sc.freeList;
+    sc.freeList = chunk;
+  }
+}
+
+} // anonymous namespace
+
+void* small_object_alloc(std::size_t size)
+{
+#ifndef DOC_SMALL_OBJECT_POOL_DISABLED
+  if (size > 0 && size <= kMaxSmallObjectSize) {
+    const std::size_t i = size_class_index(size);
+    SizeClass& sc = g_classes[i];
+    const std::lock_guard lock(sc.mutex);
+    if (!sc.freeList)
+      refill(sc, (i+1) * kGranularity);
+    FreeChunk* chunk = sc.freeList;
+    sc.freeList = chunk->next;
+    return chunk;
+  }
+#endif
+  return ::operator new(size);
+}
+
+void small_object_free(void* ptr, std::size_t size)
+{
+  if (!ptr)
+    return;
+#ifndef DOC_SMALL_OBJECT_POOL_DISABLED
+  if (size > 0 && size <= kMaxSmallObjectSize) {
+    SizeClass& sc = g_classes[size_class_index(size)];
+    const std::lock_guard lock(sc.mutex);
+    auto chunk = static_cast<FreeChunk*>(ptr);
+    chunk->next = sc.freeList;
+    sc.freeList = chunk;
+    return;
+  }
+#endif
+  ::operator delete(ptr);
+}
+
+} // namespace doc
@@ -0,0 +1,47 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_SMALL_OBJECT_POOL_H_INCLUDED
+#define DOC_SMALL_OBJECT_POOL_H_INCLUDED
+#pragma once
+
+#include <cstddef>
+
+namespace doc {
+
+  // Allocator for the small objects that are created by thousands
+  // when a document is loaded or modified (cels, tags, undo commands,
+  // etc.). Memory is taken from big blocks split by size classes, and
+  // freed chunks are reused by the next allocations of the same size
+  // class (blocks are never returned to the system), so we avoid one
+  // malloc()/free() call for each object and the fragmentation of the
+  // heap in long sessions. Sizes bigger than
+  // kMaxSmallObjectSize use the global operator new/delete.
+  const std::size_t kMaxSmallObjectSize = 512;
+
+  void* small_object_alloc(std::size_t size);
+  void small_object_free(void* ptr, std::size_t size);
+
+  // Class-specific operator new/delete to allocate instances of the
+  // class (and derived classes) with the small object pool. The class
+  // must have a virtual destructor if objects are deleted through a
+  // pointer to a base class (so the size of the dynamic type is used).
+  #define DOC_SMALL_OBJECT_ALLOCATOR()                          \
+    static void* operator new(std::size_t size) {               \
+      return doc::small_object_alloc(size);                     \
+    }                                                           \
+    static void operator delete(void* ptr, std::size_t size) {  \
+      doc::small_object_free(ptr, size);                        \
+    }                                                           \
+    /* Placement new is hidden by the previous operator new */  \
+    static void* operator new(std::size_t, void* ptr) {         \
+      return ptr;                                               \
+    }                                                           \
+    static void operator delete(void*, void*) { }
+
+} // namespace doc
+
+#endif
@@ -0,0 +1,65 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/small_object_pool.h"
+
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <vector>
+
+using namespace doc;
+
+TEST(SmallObjectPool, DifferentChunks)
+{
+  std::vector<void*> ptrs;
+  std::set<void*> unique;
+  for (std::size_t size=1; size<=kMaxSmallObjectSize+64; size+=7) {
+    for (int i=0; i<100; ++i) {
+      void* p = small_object_alloc(size);
+      EXPECT_EQ(0, uintptr_t(p) % 16);
+      std::memset(p, 0xff, size);
+      ptrs.push_back(p);
+      unique.insert(p);
+    }
+  }
+  EXPECT_EQ(ptrs.size(), unique.size());
+
+  std::size_t i = 0;
+  for (std::size_t size=1; size<=kMaxSmallObjectSize+64; size+=7)
+    for (int j=0; j<100; ++j)
+      small_object_free(ptrs[i++], size);
+}
+
+namespace {
+
+struct Base {
+  DOC_SMALL_OBJECT_ALLOCATOR()
+  virtual ~Base() { }
+  int a = 1;
+};
+
+struct Derived : Base {
+  char data[200] = { 0 };
+};
+
+} // anonymous namespace
+
+TEST(SmallObjectPool, ClassAllocator)
+{
+  Base* a = new Derived;
+  Base* b = new Base;
+  EXPECT_NE(a, b);
+  EXPECT_EQ(1, a->a);
+  delete a;                     // Uses the size of Derived
+  delete b;
+}
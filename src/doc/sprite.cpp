@@ -13,6 +13,7 @@
 
 #include "base/memory.h"
 #include "base/remove_from_container.h"
+#include "base/thread_pool.h"
 #include "doc/cel.h"
 #include "doc/cels_range.h"
 #include "doc/image_impl.h"
@@ -23,7 +24,7 @@
 #include "doc/primitives.h"
 #include "doc/remap.h"
 #include "doc/render_plan.h"
-#include "doc/rgbmap_rgb5a3.h"
+#include "doc/rgbmap.h"
 #include "doc/tag.h"
 #include "doc/tile_primitives.h"
 #include "doc/tilesets.h"
@@ -32,12 +33,42 @@
 #include <cstring>
 #include <functional>
 #include <memory>
+#include <thread>
 #include <vector>
 
 namespace doc {
 
 static gfx::Rect g_defaultGridBounds(0, 0, 16, 16);
 
+// Minimum number of pixels to remap in each thread in remapImages()
+// and remapTilemaps()
+static const int kMinRemapPixelsPerThread = 16384;
+
+// Remaps the given images, each image is remapped in just one thread.
+static void remap_images(const std::vector<Image*>& images,
+                         const size_t pixels,
+                         const Remap& remap)
+{
+  const int threads =
+    std::clamp<int>(std::thread::hardware_concurrency(), 1,
+                    std::max<int>(1, int(std::min<size_t>(images.size(),
+                                                          pixels / kMinRemapPixelsPerThread))));
+  if (threads > 1) {
+    base::thread_pool pool(threads);
+    for (int k=0; k<threads; ++k) {
+      pool.execute([&images, &remap, threads, k]{
+        for (size_t i=k; i<images.size(); i+=threads)
+          remap_image(images[i], remap);
+      });
+    }
+    pool.wait_all();
+  }
+  else {
+    for (Image* image : images)
+      remap_image(image, remap);
+  }
+}
+
 // static
 gfx::Rect Sprite::DefaultGridBounds()
 {
@@ -336,20 +367,15 @@ Palette* Sprite::palette(frame_t frame) const
 {
   ASSERT(frame >= 0);
 
-  Palette* found = NULL;
-
-  PalettesList::const_iterator end = m_palettes.end();
-  PalettesList::const_iterator it = m_palettes.begin();
-  for (; it != end; ++it) {
-    Palette* pal = *it;
-    if (frame < pal->frame())
-      break;
-
-    found = pal;
-    if (frame == pal->frame())
-      break;
-  }
+  // Palettes are sorted by frame, we look for the last palette with
+  // pal->frame() <= frame.
+  auto it = std::upper_bound(
+    m_palettes.begin(), m_palettes.end(), frame,
+    [](const frame_t frame, const Palette* pal) {
+      return frame < pal->frame();
+    });
 
+  Palette* found = (it != m_palettes.begin() ? *(it-1): nullptr);
   ASSERT(found != NULL);
   return found;
 }
@@ -447,14 +473,10 @@ RgbMap* Sprite::rgbMap(const frame_t frame,
   if (!m_rgbMap ||
       m_rgbMap->rgbmapAlgorithm() != mapAlgo ||
       m_rgbMap->fitCriteria() != fitCriteria) {
-    switch (mapAlgo) {
-      case RgbMapAlgorithm::RGB5A3: m_rgbMap.reset(new RgbMapRGB5A3); break;
-      case RgbMapAlgorithm::DEFAULT:
-      case RgbMapAlgorithm::OCTREE: m_rgbMap.reset(new OctreeMap); break;
-      default:
-        m_rgbMap.reset(nullptr);
-        ASSERT(false);
-        return nullptr;
+    m_rgbMap = create_rgbmap(mapAlgo);
+    if (!m_rgbMap) {
+      ASSERT(false);
+      return nullptr;
     }
     m_rgbMap->fitCriteria(fitCriteria);
   }
@@ -648,21 +670,32 @@ void Sprite::remapImages(const Remap& remap)
   ASSERT(pixelFormat() == IMAGE_INDEXED);
   //ASSERT(remap.size() == 256);
 
-  std::vector<ImageRef> images;
-  getImages(images);
-  for (ImageRef& image : images)
-    remap_image(image.get(), remap);
+  std::vector<ImageRef> imageRefs;
+  getImages(imageRefs);
+
+  std::vector<Image*> images;
+  size_t pixels = 0;
+  images.reserve(imageRefs.size());
+  for (const ImageRef& image : imageRefs) {
+    images.push_back(image.get());
+    pixels += size_t(image->width()) * image->height();
+  }
+  remap_images(images, pixels, remap);
 }
 
 void Sprite::remapTilemaps(const Tileset* tileset,
                            const Remap& remap)
 {
+  std::vector<Image*> tilemaps;
+  size_t pixels = 0;
   for (Cel* cel : uniqueCels()) {
     if (cel->layer()->isTilemap() &&
         static_cast<LayerTilemap*>(cel->layer())->tileset() == tileset) {
-      remap_image(cel->image(), remap);
+      tilemaps.push_back(cel->image());
+      pixels += size_t(cel->image()->width()) * cel->image()->height();
     }
   }
+  remap_images(tilemaps, pixels, remap);
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018-2022 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -193,6 +193,41 @@ TEST(Sprite, CelsRange)
   EXPECT_EQ(3, i);
 }
 
+TEST(Sprite, AddRemoveFrameDisplacesCels)
+{
+  std::shared_ptr<Sprite> sprPtr(std::make_shared<Sprite>(
+                                   ImageSpec(ColorMode::RGB, 32, 32), 256));
+  Sprite* spr = sprPtr.get();
+  spr->setTotalFrames(4);
+
+  LayerImage* lay = new LayerImage(spr);
+  spr->root()->addLayer(lay);
+
+  ImageRef img(Image::create(IMAGE_RGB, 32, 32));
+  Cel* celA = new Cel(frame_t(0), img);
+  Cel* celB = Cel::MakeLink(frame_t(1), celA);
+  Cel* celC = Cel::MakeLink(frame_t(3), celA);
+  lay->addCel(celA);
+  lay->addCel(celB);
+  lay->addCel(celC);
+
+  spr->addFrame(frame_t(1));
+  EXPECT_EQ(5, spr->totalFrames());
+  EXPECT_EQ(celA, lay->cel(0));
+  EXPECT_EQ(nullptr, lay->cel(1));
+  EXPECT_EQ(celB, lay->cel(2));
+  EXPECT_EQ(celC, lay->cel(4));
+  EXPECT_EQ(2, celB->frame());
+  EXPECT_EQ(4, celC->frame());
+
+  spr->removeFrame(frame_t(1));
+  EXPECT_EQ(4, spr->totalFrames());
+  EXPECT_EQ(celA, lay->cel(0));
+  EXPECT_EQ(celB, lay->cel(1));
+  EXPECT_EQ(nullptr, lay->cel(2));
+  EXPECT_EQ(celC, lay->cel(3));
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
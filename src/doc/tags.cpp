@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -42,6 +42,9 @@ void Tags::add(Tag* tag)
   }
   m_tags.insert(it, tag);
   tag->setOwner(this);
+
+  m_maxToFrame.resize(m_tags.size());
+  updateIndex(0, int(m_tags.size()));
 }
 
 void Tags::remove(Tag* tag)
@@ -52,6 +55,9 @@ void Tags::remove(Tag* tag)
     m_tags.erase(it);
 
   tag->setOwner(nullptr);
+
+  m_maxToFrame.resize(m_tags.size());
+  updateIndex(0, int(m_tags.size()));
 }
 
 Tag* Tags::getByName(const std::string& name) const
@@ -75,31 +81,68 @@ Tag* Tags::getById(ObjectId id) const
 Tag* Tags::innerTag(const frame_t frame) const
 {
   const Tag* found = nullptr;
-  for (const Tag* tag : *this) {
-    if (frame >= tag->fromFrame() &&
-        frame <= tag->toFrame()) {
-      if (!found ||
-          (tag->toFrame() - tag->fromFrame()) < (found->toFrame() - found->fromFrame())) {
-        found = tag;
-      }
+  forEachTagAt(frame, 0, int(m_tags.size()), [&found](const Tag* tag){
+    if (!found ||
+        (tag->toFrame() - tag->fromFrame()) < (found->toFrame() - found->fromFrame())) {
+      found = tag;
     }
-  }
+  });
   return const_cast<Tag*>(found);
 }
 
 Tag* Tags::outerTag(const frame_t frame) const
 {
   const Tag* found = nullptr;
-  for (const Tag* tag : *this) {
-    if (frame >= tag->fromFrame() &&
-        frame <= tag->toFrame()) {
-      if (!found ||
-          (tag->toFrame() - tag->fromFrame()) > (found->toFrame() - found->fromFrame())) {
-        found = tag;
-      }
+  forEachTagAt(frame, 0, int(m_tags.size()), [&found](const Tag* tag){
+    if (!found ||
+        (tag->toFrame() - tag->fromFrame()) > (found->toFrame() - found->fromFrame())) {
+      found = tag;
     }
-  }
+  });
   return const_cast<Tag*>(found);
 }
 
+void Tags::getTagsAt(const frame_t frame, TagsList& result) const
+{
+  forEachTagAt(frame, 0, int(m_tags.size()), [&result](Tag* tag){
+    result.push_back(tag);
+  });
+}
+
+// Calls f(tag) for each tag in m_tags[lo,hi) that contains the frame
+// (in order).
+template<typename F>
+void Tags::forEachTagAt(const frame_t frame, int lo, int hi, F&& f) const
+{
+  while (lo < hi) {
+    const int mid = (lo + hi) / 2;
+    if (m_maxToFrame[mid] < frame)
+      return;                   // No tag in this range reaches the frame
+
+    forEachTagAt(frame, lo, mid, f);
+
+    // The tags after "mid" start after the frame too
+    Tag* tag = m_tags[mid];
+    if (tag->fromFrame() > frame)
+      return;
+    if (tag->toFrame() >= frame)
+      f(tag);
+
+    lo = mid+1;                 // Continue with the right subtree
+  }
+}
+
+frame_t Tags::updateIndex(int lo, int hi)
+{
+  if (lo >= hi)
+    return -1;
+
+  const int mid = (lo + hi) / 2;
+  const frame_t maxTo = std::max({ m_tags[mid]->toFrame(),
+                                   updateIndex(lo, mid),
+                                   updateIndex(mid+1, hi) });
+  m_maxToFrame[mid] = maxTo;
+  return maxTo;
+}
+
 } // namespace doc
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -50,12 +50,27 @@ namespace doc {
     Tag* innerTag(const frame_t frame) const;
     Tag* outerTag(const frame_t frame) const;
 
+    // Adds to "result" all tags that contain the given frame (in the
+    // same order of the list of tags).
+    void getTagsAt(const frame_t frame, TagsList& result) const;
+
     const TagsList& getInternalList() const { return m_tags; }
 
   private:
+    template<typename F>
+    void forEachTagAt(const frame_t frame, int lo, int hi, F&& f) const;
+    frame_t updateIndex(int lo, int hi);
+
     Sprite* m_sprite;
     TagsList m_tags;
 
+    // Interval index over m_tags (which are sorted by fromFrame()):
+    // an implicit balanced binary tree where the element "mid" of each
+    // [lo,hi) range is the node, and m_maxToFrame[mid] is the max
+    // toFrame() of the tags in the range. It's used to find the tags
+    // that contain a frame in O(log n + k).
+    std::vector<frame_t> m_maxToFrame;
+
     DISABLE_COPYING(Tags);
   };
 
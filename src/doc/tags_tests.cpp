@@ -0,0 +1,81 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/tag.h"
+#include "doc/tags.h"
+
+#include <cstdlib>
+
+using namespace doc;
+
+TEST(Tags, InnerOuterTags)
+{
+  Tags tags(nullptr);
+  Tag* a = new Tag(0, 9);
+  Tag* b = new Tag(2, 4);
+  Tag* c = new Tag(3, 3);
+  Tag* d = new Tag(7, 12);
+  tags.add(a);
+  tags.add(b);
+  tags.add(c);
+  tags.add(d);
+
+  EXPECT_EQ(a, tags.innerTag(0));
+  EXPECT_EQ(a, tags.outerTag(0));
+  EXPECT_EQ(b, tags.innerTag(2));
+  EXPECT_EQ(c, tags.innerTag(3));
+  EXPECT_EQ(a, tags.outerTag(3));
+  EXPECT_EQ(d, tags.innerTag(8));
+  EXPECT_EQ(a, tags.outerTag(8));
+  EXPECT_EQ(d, tags.innerTag(12));
+  EXPECT_EQ(nullptr, tags.innerTag(13));
+
+  TagsList result;
+  tags.getTagsAt(3, result);
+  ASSERT_EQ(3, result.size());
+  EXPECT_EQ(a, result[0]);
+  EXPECT_EQ(b, result[1]);
+  EXPECT_EQ(c, result[2]);
+
+  // Change the range of a tag (it's removed and added again)
+  b->setFrameRange(10, 20);
+  EXPECT_EQ(c, tags.innerTag(3));
+  EXPECT_EQ(a, tags.innerTag(2));
+  EXPECT_EQ(d, tags.innerTag(11));
+  EXPECT_EQ(b, tags.outerTag(11));
+  EXPECT_EQ(b, tags.innerTag(20));
+
+  tags.remove(a);
+  EXPECT_EQ(nullptr, tags.innerTag(0));
+  delete a;
+}
+
+TEST(Tags, CompareWithLinearSearch)
+{
+  std::srand(1);
+  Tags tags(nullptr);
+  for (int i=0; i<500; ++i) {
+    const frame_t from = std::rand() % 1000;
+    tags.add(new Tag(from, from + std::rand() % 50));
+  }
+
+  for (frame_t frame=0; frame<1100; ++frame) {
+    TagsList expected;
+    for (Tag* tag : tags) {
+      if (frame >= tag->fromFrame() && frame <= tag->toFrame())
+        expected.push_back(tag);
+    }
+    TagsList result;
+    tags.getTagsAt(frame, result);
+    EXPECT_EQ(expected, result);
+  }
+}
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019-2023  Igara Studio S.A.
+// Copyright (c) 2019-2024  Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -18,7 +18,9 @@
 #include "doc/remap.h"
 #include "doc/sprite.h"
 
+#include <algorithm>
 #include <memory>
+#include <unordered_set>
 
 #define TS_TRACE(...) // TRACE(__VA_ARGS__)
 
@@ -125,12 +127,21 @@ void Tileset::resize(const tile_index ntiles)
 {
   int oldSize = m_tiles.size();
   m_tiles.resize(ntiles);
-  for (tile_index ti=oldSize; ti<ntiles; ++ti)
+  for (tile_index ti=oldSize; ti<ntiles; ++ti) {
     m_tiles[ti].image = makeEmptyTile();
+    markDirtyTile(ti);
+  }
+
+  // Removed tiles could be referenced from the hash tables
+  if (ntiles < oldSize)
+    rehash();
 }
 
 void Tileset::remap(const Remap& remap)
 {
+  // Dirty tiles use the indexes previous to the remap
+  updateDirtyTiles();
+
   Tiles tmp = m_tiles;
 
   // The notile cannot be remapped
@@ -149,7 +160,33 @@ void Tileset::remap(const Remap& remap)
     }
   }
 
-  rehash();
+  // When each tile has its own hash entry (there are no duplicated
+  // tiles) and the remap is a permutation, we can move the indexes
+  // of the hash tables instead of re-hashing all images.
+  bool permutation = (!m_hash.empty() &&
+                      m_hash.size() == m_tiles.size());
+  if (permutation) {
+    std::vector<bool> used(m_tiles.size(), false);
+    for (tile_index ti=1; ti<size() && permutation; ++ti) {
+      const int j = remap[ti];
+      if (j <= 0 || j >= int(m_tiles.size()) || used[j])
+        permutation = false;
+      else
+        used[j] = true;
+    }
+  }
+  if (permutation) {
+    for (auto& it : m_hash)
+      if (it.second != notile)
+        it.second = remap[it.second];
+    for (auto& it : m_flipHash)
+      if (it.second != notile)
+        it.second = remap[it.second];
+    discardCompressedData();
+  }
+  else {
+    rehash();
+  }
 }
 
 void Tileset::setTileData(const tile_index ti,
@@ -172,13 +209,9 @@ void Tileset::set(const tile_index ti,
   }
 #endif
 
-  removeFromHash(ti, false);
-
   preprocess_transparent_pixels(image.get());
   m_tiles[ti].image = image;
-
-  if (!m_hash.empty())
-    hashImage(ti, image);
+  markDirtyTile(ti);
 }
 
 tile_index Tileset::add(const ImageRef& image,
@@ -192,8 +225,7 @@ tile_index Tileset::add(const ImageRef& image,
   m_tiles.push_back(Tile(image, userData));
 
   const tile_index newIndex = tile_index(m_tiles.size()-1);
-  if (!m_hash.empty())
-    hashImage(newIndex, image);
+  markDirtyTile(newIndex);
   return newIndex;
 }
 
@@ -220,18 +252,21 @@ void Tileset::insert(const tile_index ti,
     for (auto& it : m_hash)
       if (it.second >= ti)
         ++it.second;
+    for (auto& it : m_flipHash)
+      if (it.second >= ti)
+        ++it.second;
+    for (auto& i : m_dirtyTiles)
+      if (i >= ti)
+        ++i;
 
     // And now we can add the new image with the "ti" index
-    hashImage(ti, image);
+    markDirtyTile(ti);
   }
 }
 
 void Tileset::erase(const tile_index ti)
 {
   ASSERT(ti >= 0 && ti < size());
-  // TODO check why this doesn't work
-  //removeFromHash(ti, true);
-
   m_tiles.erase(m_tiles.begin()+ti);
   rehash();
 }
@@ -250,6 +285,23 @@ void Tileset::setExternal(const std::string& filename,
   m_external.tileset = tsi;
 }
 
+void Tileset::unshareTiles()
+{
+  if (!m_sharedTiles)
+    return;
+
+  // Images referenced only by this tileset are not shared anymore
+  // (e.g. the other documents were closed).
+  for (auto& tile : m_tiles) {
+    if (tile.image && tile.image.use_count() > 1)
+      tile.image.reset(Image::createCopy(tile.image.get()));
+  }
+  m_sharedTiles = false;
+
+  // Keys of the hash table are the old tile images
+  rehash();
+}
+
 bool Tileset::findTileIndex(const ImageRef& tileImage,
                             tile_index& ti)
 {
@@ -273,47 +325,72 @@ bool Tileset::findTileIndex(const ImageRef& tileImage,
   }
 }
 
-void Tileset::notifyTileContentChange(const tile_index ti)
+bool Tileset::findFlippedTileIndex(const ImageRef& tileImage,
+                                   tile_index& ti,
+                                   tile_flags& flags)
 {
-#if 0 // TODO Try to do less work
+  ti = notile;
+  flags = 0;
 
-  ASSERT(ti >= 0 && ti < size());
+  ASSERT(tileImage);
+  if (!tileImage || m_matchFlags == 0)
+    return false;
 
-  // If two or more tiles are exactly the same, they will have the
-  // same hash, so the m_hash table can be smaller than the m_tiles
-  // array.
-  if (m_hash.size() < m_tiles.size()) {
-    // Count how many hash elements are poiting to this tile index
-    int tilesWithSameHash = 0;
-    for (auto item : m_hash)
-      if (item.second == ti)
-        ++tilesWithSameHash;
-
-    // In this case we re-generate the whole hash table because one or
-    // more tiles tile are using the hash of the modified tile.
-    if (tilesWithSameHash >= 2) {
-      rehash();
-      return;
+  auto& h = flipHashTable();
+  auto range = h.equal_range(calculate_flip_invariant_hash(tileImage.get()));
+  if (range.first == range.second)
+    return false;
+
+  // Candidates sorted by index, so we return the first tile of the
+  // tileset that matches (as findTileIndex() does)
+  std::vector<tile_index> candidates;
+  for (auto it=range.first; it!=range.second; ++it)
+    candidates.push_back(it->second);
+  std::sort(candidates.begin(), candidates.end());
+
+  // Same order used to try the flips in previous versions (flipping
+  // the image several times)
+  static const tile_flags kFlags[] = {
+    tile_f_xflip,
+    tile_f_yflip,
+    tile_f_xflip | tile_f_yflip,
+    tile_f_dflip,
+    tile_f_xflip | tile_f_dflip,
+    tile_f_xflip | tile_f_yflip | tile_f_dflip,
+    tile_f_yflip | tile_f_dflip,
+  };
+
+  const bool square = (tileImage->width() == tileImage->height());
+  for (const tile_flags f : kFlags) {
+    if ((f & m_matchFlags) != f ||
+        ((f & tile_f_dflip) && !square))
+      continue;
+
+    for (const tile_index i : candidates) {
+      const Image* tile = m_tiles[i].image.get();
+      if (tile &&
+          tile->pixelFormat() == tileImage->pixelFormat() &&
+          tile->size() == tileImage->size() &&
+          is_same_flipped_tile(tile, tileImage.get(), f)) {
+        ti = i;
+        flags = f;
+        return true;
+      }
     }
   }
+  return false;
+}
 
-  // In other case we can do a fast-path, just removing and
-  // re-adding the tile to the hash table.
-  removeFromHash(ti, false);
-  if (!m_hash.empty())
-    hashImage(ti, m_tiles[ti]);
-
-#else // Regenerate the whole hash map (at the moment this is the
-      // only way to make it work correctly)
-
-  (void)ti;                     // unused
-
-  if (ti >= 0 && ti < m_tiles.size() && m_tiles[ti].image)
+void Tileset::notifyTileContentChange(const tile_index ti)
+{
+  if (ti >= 0 && ti < m_tiles.size() && m_tiles[ti].image) {
     preprocess_transparent_pixels(m_tiles[ti].image.get());
-
-  rehash();
-
-#endif
+    markDirtyTile(ti);
+    discardCompressedData();
+  }
+  else {
+    rehash();
+  }
 }
 
 void Tileset::notifyRegenerateEmptyTile()
@@ -324,29 +401,99 @@ void Tileset::notifyRegenerateEmptyTile()
   ImageRef image = get(doc::notile);
   if (image)
     doc::clear_image(image.get(), image->maskColor());
-  rehash();
+  markDirtyTile(doc::notile);
+  discardCompressedData();
 }
 
-void Tileset::removeFromHash(const tile_index ti,
-                             const bool adjustIndexes)
+void Tileset::markDirtyTile(const tile_index ti)
 {
-  auto end = m_hash.end();
-  for (auto it=m_hash.begin(); it!=end; ) {
-    if (it->second == ti) {
+  // An empty hash table will be re-generated from scratch anyway
+  if (!m_hash.empty() &&
+      // Avoid growing the list when the same tile is modified several
+      // times (e.g. a script modifying pixel by pixel)
+      (m_dirtyTiles.empty() || m_dirtyTiles.back() != ti)) {
+    m_dirtyTiles.push_back(ti);
+  }
+}
+
+void Tileset::updateDirtyTiles()
+{
+  if (m_dirtyTiles.empty())
+    return;
+
+  const tile_index n = size();
+  std::vector<bool> dirty(n, false);
+  std::unordered_set<const Image*> dirtyImages;
+  tile_index ndirty = 0;
+  for (const tile_index ti : m_dirtyTiles) {
+    if (ti < n && !dirty[ti]) {
+      dirty[ti] = true;
+      dirtyImages.insert(m_tiles[ti].image.get());
+      ++ndirty;
+    }
+  }
+  m_dirtyTiles.clear();
+
+  // Tiles sharing the image of a dirty tile were modified too
+  for (tile_index ti=0; ti<n; ++ti) {
+    if (!dirty[ti] &&
+        dirtyImages.find(m_tiles[ti].image.get()) != dirtyImages.end()) {
+      dirty[ti] = true;
+      ++ndirty;
+    }
+  }
+
+  TS_TRACE("TS: [%d] updateDirtyTiles ndirty=%d\n", id(), ndirty);
+
+  // With several modified tiles it's faster to re-generate the whole
+  // hash table when it's used.
+  if (m_hash.empty() || ndirty > n/2) {
+    m_hash.clear();
+    m_flipHash.clear();
+    return;
+  }
+
+  // Remove the entries of dirty tiles. Keys are the tile images, so
+  // they can contain modified pixels (the entry hash is outdated).
+  bool removed = false;
+  for (auto it=m_hash.begin(); it!=m_hash.end(); ) {
+    if (dirty[it->second]) {
       it = m_hash.erase(it);
-      end = m_hash.end();
+      removed = true;
     }
-    else {
-      if (adjustIndexes && it->second > ti)
-        --it->second;
+    else
+      ++it;
+  }
+  for (auto it=m_flipHash.begin(); it!=m_flipHash.end(); ) {
+    if (dirty[it->second])
+      it = m_flipHash.erase(it);
+    else
       ++it;
-    }
+  }
+
+  // Duplicated tiles don't have an entry in m_hash, so if we've
+  // removed the entry that they were sharing with a dirty tile, we
+  // have to add them again.
+  std::vector<bool> hashed;
+  if (removed) {
+    hashed.resize(n, false);
+    for (const auto& it : m_hash)
+      hashed[it.second] = true;
+  }
+
+  for (tile_index ti=0; ti<n; ++ti) {
+    if (dirty[ti])
+      hashImage(ti, m_tiles[ti].image);
+    else if (removed && !hashed[ti] && m_tiles[ti].image)
+      hashImage(ti, m_tiles[ti].image, false);
   }
 }
 
 #ifdef _DEBUG
 void Tileset::assertValidHashTable()
 {
+  updateDirtyTiles();
+
   // And empty hash table means that we've to re-generate it when it's
   // needed (when findTileIndex() is used).
   if (m_hash.empty())
@@ -381,10 +528,24 @@ void Tileset::assertValidHashTable()
 #endif
 
 void Tileset::hashImage(const tile_index ti,
-                        const ImageRef& tileImage)
+                        const ImageRef& tileImage,
+                        const bool addToFlipHash)
 {
-  if (m_hash.find(tileImage) == m_hash.end())
+  auto it = m_hash.find(tileImage);
+  if (it == m_hash.end())
+    m_hash[tileImage] = ti;
+  // Keep the first tile of the tileset with these pixels (as when the
+  // hash table is created from scratch). The key is replaced too, so
+  // it's always the image of the tile in the entry.
+  else if (ti < it->second) {
+    m_hash.erase(it);
     m_hash[tileImage] = ti;
+  }
+
+  if (addToFlipHash && !m_flipHash.empty()) {
+    m_flipHash.insert(
+      std::make_pair(calculate_flip_invariant_hash(tileImage.get()), ti));
+  }
 }
 
 void Tileset::rehash()
@@ -392,6 +553,8 @@ void Tileset::rehash()
   // Clear the hash table, we'll lazy-rehash it when
   // hashTable()/findTileIndex() is used.
   m_hash.clear();
+  m_flipHash.clear();
+  m_dirtyTiles.clear();
 
   // Reset the compressed data (just in case we have cached the data
   // from a loaded .aseprite file or when saving the file).
@@ -400,8 +563,11 @@ void Tileset::rehash()
 
 TilesetHashTable& Tileset::hashTable()
 {
+  updateDirtyTiles();
+
   if (m_hash.empty()) {
     // Re-hash/create the whole hash table from scratch
+    m_flipHash.clear();
     tile_index ti = 0;
     for (auto& tile : m_tiles)
       hashImage(ti++, tile.image);
@@ -409,6 +575,25 @@ TilesetHashTable& Tileset::hashTable()
   return m_hash;
 }
 
+std::unordered_multimap<uint64_t, tile_index>& Tileset::flipHashTable()
+{
+  // The main hash table must exist so new tiles are added to both
+  // tables (see hashImage()).
+  hashTable();
+
+  if (m_flipHash.empty()) {
+    tile_index ti = 0;
+    for (auto& tile : m_tiles) {
+      if (tile.image) {
+        m_flipHash.insert(
+          std::make_pair(calculate_flip_invariant_hash(tile.image.get()), ti));
+      }
+      ++ti;
+    }
+  }
+  return m_flipHash;
+}
+
 int Tileset::tilemapsCount() const {
   auto tsi = sprite()->tilesets()->getIndex(this);
   int count = 0;
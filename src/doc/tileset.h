@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019-2023  Igara Studio S.A.
+// Copyright (c) 2019-2024  Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -17,6 +17,7 @@
 #include "doc/with_user_data.h"
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace doc {
@@ -110,6 +111,15 @@ namespace doc {
     const std::string& externalFilename() const { return m_external.filename; }
     tileset_index externalTileset() const { return m_external.tileset; }
 
+    // Tile images of external tilesets can be shared with other
+    // documents that use the same external file (see
+    // app::ExternalTilesetCache). unshareTiles() must be called
+    // before modifying tile images in-place, so the tiles that are
+    // still shared are replaced with copies.
+    bool hasSharedTiles() const { return m_sharedTiles; }
+    void setSharedTiles(const bool state) { m_sharedTiles = state; }
+    void unshareTiles();
+
     // Unused functions.
     bool operator==(const Tileset& other) const = delete;
     bool operator!=(const Tileset& other) const = delete;
@@ -127,8 +137,23 @@ namespace doc {
     bool findTileIndex(const ImageRef& tileImage,
                        tile_index& ti);
 
+    // Like findTileIndex() but returns a tile that matches the
+    // "tileImage" flipped with one of the combinations of flags
+    // allowed by matchFlags() (in "flags"). The tiles are indexed by
+    // a flip invariant hash, so all orientations are found with just
+    // one lookup. Diagonal flips are matched only for square tiles.
+    //
+    // Warning: Use preprocess_transparent_pixels() with tileImage
+    // before calling this function.
+    bool findFlippedTileIndex(const ImageRef& tileImage,
+                              tile_index& ti,
+                              tile_flags& flags);
+
     // Must be called when a tile image was modified externally, so
-    // the hash elements are re-calculated for that specific tile.
+    // the hash elements are re-calculated for that specific tile. The
+    // tile is just marked as dirty, and it's re-hashed lazily when the
+    // hash table is used again (so several changes are re-hashed in
+    // just one pass).
     void notifyTileContentChange(const tile_index ti);
 
     // Called when the mask color of the sprite is modified, so we
@@ -143,17 +168,25 @@ namespace doc {
 #endif
 
   private:
-    void removeFromHash(const tile_index ti,
-                        const bool adjustIndexes);
+    void markDirtyTile(const tile_index ti);
+    void updateDirtyTiles();
     void hashImage(const tile_index ti,
-                   const ImageRef& tileImage);
+                   const ImageRef& tileImage,
+                   const bool addToFlipHash = true);
     void rehash();
     TilesetHashTable& hashTable();
+    std::unordered_multimap<uint64_t, tile_index>& flipHashTable();
 
     Sprite* m_sprite;
     Grid m_grid;
     Tiles m_tiles;
     TilesetHashTable m_hash;
+    // Tiles by calculate_flip_invariant_hash() (created lazily when
+    // findFlippedTileIndex() is used)
+    std::unordered_multimap<uint64_t, tile_index> m_flipHash;
+    // Tiles modified/added since the last time the hash tables were
+    // used, their hash entries are updated in updateDirtyTiles().
+    std::vector<tile_index> m_dirtyTiles;
     std::string m_name;
     int m_baseIndex = 1;
     tile_flags m_matchFlags = 0;
@@ -161,6 +194,7 @@ namespace doc {
       std::string filename;
       tileset_index tileset;
     } m_external;
+    bool m_sharedTiles = false;
 
     // This is a cached version of the compressed tileset data
     // directly read from an .aseprite file. It's used to save the
@@ -0,0 +1,113 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/image.h"
+#include "doc/primitives.h"
+#include "doc/remap.h"
+#include "doc/sprite.h"
+#include "doc/tileset.h"
+
+#include <memory>
+
+using namespace doc;
+
+static ImageRef make_tile(Tileset* tileset, color_t c)
+{
+  ImageRef tile = tileset->makeEmptyTile();
+  put_pixel(tile.get(), 1, 1, c);
+  return tile;
+}
+
+static tile_index find(Tileset* tileset, const ImageRef& image)
+{
+  tile_index ti;
+  if (tileset->findTileIndex(image, ti))
+    return ti;
+  return notile;
+}
+
+class TilesetTest : public ::testing::Test {
+protected:
+  TilesetTest()
+    : sprite(ImageSpec(ColorMode::RGB, 32, 32), 256)
+    , tileset(&sprite, Grid(gfx::Size(4, 4)), 1) {
+    for (int i=1; i<8; ++i)
+      tileset.add(make_tile(&tileset, rgba(i, 0, 0, 255)));
+  }
+
+  Sprite sprite;
+  Tileset tileset;
+};
+
+TEST_F(TilesetTest, ModifiedTileIsRehashed)
+{
+  ImageRef a = make_tile(&tileset, rgba(3, 0, 0, 255));
+  ImageRef b = make_tile(&tileset, rgba(0, 64, 0, 255));
+  EXPECT_EQ(3, find(&tileset, a));
+  EXPECT_EQ(notile, find(&tileset, b));
+
+  put_pixel(tileset.get(3).get(), 1, 1, rgba(0, 64, 0, 255));
+  tileset.notifyTileContentChange(3);
+
+  EXPECT_EQ(notile, find(&tileset, a));
+  EXPECT_EQ(3, find(&tileset, b));
+}
+
+TEST_F(TilesetTest, DuplicatedTiles)
+{
+  ImageRef a = make_tile(&tileset, rgba(2, 0, 0, 255));
+  tileset.set(5, make_tile(&tileset, rgba(2, 0, 0, 255)));
+  EXPECT_EQ(2, find(&tileset, a));
+
+  // Tile 5 must be found when tile 2 is modified
+  put_pixel(tileset.get(2).get(), 1, 1, rgba(0, 0, 64, 255));
+  tileset.notifyTileContentChange(2);
+  EXPECT_EQ(5, find(&tileset, a));
+
+  // The first tile is found when both tiles are equal again
+  put_pixel(tileset.get(2).get(), 1, 1, rgba(2, 0, 0, 255));
+  tileset.notifyTileContentChange(2);
+  EXPECT_EQ(2, find(&tileset, a));
+}
+
+TEST_F(TilesetTest, AddAndInsertTiles)
+{
+  ImageRef a = make_tile(&tileset, rgba(0, 0, 0, 128));
+  ImageRef b = make_tile(&tileset, rgba(4, 0, 0, 255));
+  EXPECT_EQ(notile, find(&tileset, a));
+  EXPECT_EQ(4, find(&tileset, b));
+
+  tileset.add(make_tile(&tileset, rgba(0, 0, 0, 128)));
+  EXPECT_EQ(8, find(&tileset, a));
+
+  tileset.insert(1, make_tile(&tileset, rgba(0, 0, 0, 128)));
+  EXPECT_EQ(1, find(&tileset, a));
+  EXPECT_EQ(5, find(&tileset, b));
+}
+
+TEST_F(TilesetTest, Remap)
+{
+  ImageRef a = make_tile(&tileset, rgba(1, 0, 0, 255));
+  ImageRef b = make_tile(&tileset, rgba(7, 0, 0, 255));
+  EXPECT_EQ(1, find(&tileset, a));
+  EXPECT_EQ(7, find(&tileset, b));
+
+  Remap remap(tileset.size());
+  for (tile_index i=1; i<tileset.size(); ++i)
+    remap.map(i, i);
+  remap.map(1, 7);
+  remap.map(7, 1);
+  tileset.remap(remap);
+
+  EXPECT_EQ(7, find(&tileset, a));
+  EXPECT_EQ(1, find(&tileset, b));
+}
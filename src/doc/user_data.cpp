@@ -14,6 +14,46 @@
 
 namespace doc {
 
+UserData::UserData(const UserData& other)
+  : m_text(other.m_text)
+  , m_color(other.m_color)
+{
+  // If the properties of "other" weren't loaded yet, we share the
+  // loader instead of decoding them now.
+  if (other.hasUnloadedProperties()) {
+    m_lazy = std::make_unique<LazyProperties>();
+    m_lazy->loader = other.m_lazy->loader;
+  }
+  else
+    m_propertiesMaps = other.m_propertiesMaps;
+}
+
+UserData& UserData::operator=(const UserData& other)
+{
+  if (this != &other) {
+    UserData copy(other);
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+void UserData::setPropertiesLoader(PropertiesLoader&& loader)
+{
+  m_propertiesMaps.clear();
+  m_lazy = std::make_unique<LazyProperties>();
+  m_lazy->loader = std::make_shared<const PropertiesLoader>(std::move(loader));
+}
+
+void UserData::loadLazyProperties() const
+{
+  std::call_once(
+    m_lazy->once,
+    [this]{
+      m_propertiesMaps = (*m_lazy->loader)();
+      m_lazy->loaded = true;
+    });
+}
+
 size_t count_nonempty_properties_maps(const UserData::PropertiesMaps& propertiesMaps)
 {
   size_t i = 0;
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2022-2023 Igara Studio S.A.
+// Copyright (c) 2022-2024 Igara Studio S.A.
 // Copyright (c) 2001-2015 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -11,14 +11,19 @@
 
 #include "base/uuid.h"
 #include "doc/color.h"
+#include "doc/flat_map.h"
 #include "fixmath/fixmath.h"
 #include "gfx/point.h"
 #include "gfx/size.h"
 #include "gfx/rect.h"
 
+#include <atomic>
 #include <cstddef>
+#include <functional>
 #include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <variant>
@@ -58,7 +63,10 @@ namespace doc {
     };
     struct Variant;
     using Vector = std::vector<Variant>;
-    using Properties = std::map<std::string, Variant>;
+    // Properties are stored in a sorted vector (instead of a
+    // std::map) as objects usually have a few properties, and there
+    // can be thousands of objects with properties (e.g. tiles).
+    using Properties = FlatMap<std::string, Variant>;
     using PropertiesMaps = std::map<std::string, Properties>;
     using VariantBase = std::variant<std::nullptr_t,
                                      bool,
@@ -98,24 +106,46 @@ namespace doc {
       }
     };
 
+    // Function to decode the properties the first time they are
+    // used (e.g. from the original bytes of a loaded file).
+    using PropertiesLoader = std::function<PropertiesMaps()>;
+
     UserData() : m_color(0) {
     }
+    UserData(const UserData& other);
+    UserData(UserData&& other) = default;
+    UserData& operator=(const UserData& other);
+    UserData& operator=(UserData&& other) = default;
 
     size_t size() const { return m_text.size(); }
     bool isEmpty() const {
-      return m_text.empty() && !doc::rgba_geta(m_color) && m_propertiesMaps.empty();
+      return m_text.empty() && !doc::rgba_geta(m_color) &&
+        !hasUnloadedProperties() && m_propertiesMaps.empty();
     }
 
     const std::string& text() const { return m_text; }
     color_t color() const { return m_color; }
-    const PropertiesMaps& propertiesMaps() const { return m_propertiesMaps; }
-    PropertiesMaps& propertiesMaps() { return m_propertiesMaps; }
+    const PropertiesMaps& propertiesMaps() const {
+      loadProperties();
+      return m_propertiesMaps;
+    }
+    PropertiesMaps& propertiesMaps() {
+      loadProperties();
+      return m_propertiesMaps;
+    }
     Properties& properties() { return properties(std::string()); }
-    Properties& properties(const std::string& groupKey) { return m_propertiesMaps[groupKey]; }
+    Properties& properties(const std::string& groupKey) { return propertiesMaps()[groupKey]; }
 
     void setText(const std::string& text) { m_text = text; }
     void setColor(color_t color) { m_color = color; }
 
+    // Replaces the properties with the ones returned by the loader
+    // the first time they are accessed.
+    void setPropertiesLoader(PropertiesLoader&& loader);
+    bool hasUnloadedProperties() const {
+      return (m_lazy && !m_lazy->loaded);
+    }
+
     bool operator==(const UserData& other) const {
       return (m_text == other.m_text &&
               m_color == other.m_color);
@@ -126,9 +156,25 @@ namespace doc {
     }
 
   private:
+    struct LazyProperties {
+      // The loader is shared between copies of the user data that
+      // weren't loaded yet, and it's never modified (so it can be
+      // copied while other thread loads the properties).
+      std::shared_ptr<const PropertiesLoader> loader;
+      std::once_flag once;
+      std::atomic<bool> loaded = false;
+    };
+
+    void loadProperties() const {
+      if (m_lazy && !m_lazy->loaded)
+        loadLazyProperties();
+    }
+    void loadLazyProperties() const;
+
     std::string m_text;
     color_t m_color;
-    PropertiesMaps m_propertiesMaps;
+    mutable PropertiesMaps m_propertiesMaps;
+    std::unique_ptr<LazyProperties> m_lazy;
   };
 
   // macOS 10.9 C++ runtime doesn't support std::get<T>(value)
@@ -180,6 +180,61 @@ TEST(ExtensionProperties, SimpleProperties)
   EXPECT_TRUE(data.properties("someExtensionId").size() == 0);
 }
 
+TEST(CustomProperties, SortedProperties)
+{
+  Properties props = { { "b", int32_t(2) },
+                       { "a", int32_t(1) },
+                       { "b", int32_t(3) } }; // Duplicated key is ignored
+  props["d"] = int32_t(4);
+  props["c"] = int32_t(3);
+  EXPECT_EQ(4, props.size());
+
+  const char* keys[] = { "a", "b", "c", "d" };
+  int i = 0;
+  for (const auto& kv : props) {
+    EXPECT_EQ(keys[i], kv.first);
+    EXPECT_EQ(i+1, get_value<int32_t>(kv.second));
+    ++i;
+  }
+
+  EXPECT_TRUE(props.find("e") == props.end());
+  EXPECT_EQ(1, props.erase("b"));
+  EXPECT_EQ(0, props.erase("b"));
+  EXPECT_EQ(3, props.size());
+  EXPECT_EQ(3, get_value<int32_t>(props.at("c")));
+}
+
+TEST(CustomProperties, LazyProperties)
+{
+  int loads = 0;
+  UserData data;
+  data.setPropertiesLoader(
+    [&loads]{
+      ++loads;
+      UserData::PropertiesMaps maps;
+      maps[""]["a"] = int32_t(1);
+      return maps;
+    });
+  EXPECT_TRUE(data.hasUnloadedProperties());
+  EXPECT_FALSE(data.isEmpty());
+  EXPECT_EQ(0, loads);
+
+  // Copies share the loader until they are used
+  UserData copy = data;
+  EXPECT_TRUE(copy.hasUnloadedProperties());
+  EXPECT_EQ(0, loads);
+
+  EXPECT_EQ(1, get_value<int32_t>(data.properties()["a"]));
+  EXPECT_EQ(1, get_value<int32_t>(data.properties()["a"]));
+  EXPECT_FALSE(data.hasUnloadedProperties());
+  EXPECT_EQ(1, loads);
+
+  copy.properties()["a"] = int32_t(2);
+  EXPECT_EQ(2, loads);
+  EXPECT_EQ(1, get_value<int32_t>(data.properties()["a"]));
+  EXPECT_EQ(2, get_value<int32_t>(copy.properties()["a"]));
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
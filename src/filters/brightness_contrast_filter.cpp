@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2017  David Capello
 //
 // This program is distributed under the terms of
@@ -33,7 +33,6 @@ const char* BrightnessContrastFilter::getName()
 BrightnessContrastFilter::BrightnessContrastFilter()
   : m_brightness(0.0)
   , m_contrast(0.0)
-  , m_cmap(256)
 {
   updateMap();
 }
@@ -55,6 +54,10 @@ void BrightnessContrastFilter::applyToRgba(FilterManager* filterMgr)
   FilterIndexedData* fid = filterMgr->getIndexedData();
   const Palette* pal = fid->getPalette();
   Palette* newPal = (m_usePaletteOnRGB ? fid->getNewPalette(): nullptr);
+  const Target rgbTarget = filterMgr->getTarget();
+  const ChannelMap& rmap = channel_map_for_target(m_cmap, rgbTarget, TARGET_RED_CHANNEL);
+  const ChannelMap& gmap = channel_map_for_target(m_cmap, rgbTarget, TARGET_GREEN_CHANNEL);
+  const ChannelMap& bmap = channel_map_for_target(m_cmap, rgbTarget, TARGET_BLUE_CHANNEL);
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t) {
     color_t c = *src_address;
@@ -69,7 +72,10 @@ void BrightnessContrastFilter::applyToRgba(FilterManager* filterMgr)
         c = newPal->getEntry(i);
     }
     else {
-      applyFilterToRgb(target, c);
+      c = rgba(rmap[rgba_getr(c)],
+               gmap[rgba_getg(c)],
+               bmap[rgba_getb(c)],
+               rgba_geta(c));
     }
 
     *dst_address = c;
@@ -79,14 +85,12 @@ void BrightnessContrastFilter::applyToRgba(FilterManager* filterMgr)
 
 void BrightnessContrastFilter::applyToGrayscale(FilterManager* filterMgr)
 {
+  const ChannelMap& kmap =
+    channel_map_for_target(m_cmap, filterMgr->getTarget(), TARGET_GRAY_CHANNEL);
+
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t) {
     color_t c = *src_address;
-    int k = graya_getv(c);
-    int a = graya_geta(c);
-
-    if (target & TARGET_GRAY_CHANNEL) k = m_cmap[k];
-
-    *dst_address = graya(k, a);
+    *dst_address = graya(kmap[graya_getv(c)], graya_geta(c));
   }
   FILTER_LOOP_THROUGH_ROW_END()
 }
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2017  David Capello
 //
 // This program is distributed under the terms of
@@ -11,11 +11,10 @@
 
 #include "doc/color.h"
 #include "doc/palette_picks.h"
+#include "filters/channel_map.h"
 #include "filters/filter.h"
 #include "filters/target.h"
 
-#include <vector>
-
 namespace filters {
 
   class BrightnessContrastFilter : public FilterWithPalette {
@@ -26,12 +25,14 @@ namespace filters {
     double contrast() const { return m_contrast; }
     void setBrightness(double brightness);
     void setContrast(double contrast);
+    const ChannelMap& channelMap() const { return m_cmap; }
 
     // Filter implementation
     const char* getName() override;
     void applyToRgba(FilterManager* filterMgr) override;
     void applyToGrayscale(FilterManager* filterMgr) override;
     void applyToIndexed(FilterManager* filterMgr) override;
+    bool isPerPixel() const override { return true; }
 
   private:
     void onApplyToPalette(FilterManager* filterMgr,
@@ -40,7 +41,7 @@ namespace filters {
     void updateMap();
 
     double m_brightness, m_contrast;
-    std::vector<int> m_cmap;
+    ChannelMap m_cmap;
   };
 
 } // namespace filters
@@ -0,0 +1,45 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef FILTERS_CHANNEL_MAP_H_INCLUDED
+#define FILTERS_CHANNEL_MAP_H_INCLUDED
+#pragma once
+
+#include "filters/target.h"
+
+#include <array>
+#include <cstdint>
+
+namespace filters {
+
+  // Table to convert each possible value of an 8-bit channel into
+  // the filtered value. Filters where each channel depends only on
+  // its own value generate this table once (when their parameters
+  // change) and then each pixel is converted with table lookups.
+  using ChannelMap = std::array<uint8_t, 256>;
+
+  inline const ChannelMap& identity_channel_map() {
+    static const ChannelMap map = []{
+      ChannelMap map;
+      for (int i=0; i<256; ++i)
+        map[i] = i;
+      return map;
+    }();
+    return map;
+  }
+
+  // Returns the map to convert the given channel: "map" if the
+  // channel is in the target, or the identity map in other case (so
+  // we can avoid checking the target for each pixel).
+  inline const ChannelMap& channel_map_for_target(const ChannelMap& map,
+                                                  const Target target,
+                                                  const Target channel) {
+    return ((target & channel) ? map: identity_channel_map());
+  }
+
+} // namespace filters
+
+#endif
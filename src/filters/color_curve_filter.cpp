@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -26,7 +26,7 @@ namespace filters {
 using namespace doc;
 
 ColorCurveFilter::ColorCurveFilter()
-  : m_cmap(256)
+  : m_cmap(identity_channel_map())
 {
 }
 
@@ -39,9 +39,10 @@ void ColorCurveFilter::setCurve(const ColorCurve& curve)
 void ColorCurveFilter::generateMap()
 {
   // Generate the color convertion map
-  m_curve.getValues(0, 255, m_cmap);
+  std::vector<int> values(256);
+  m_curve.getValues(0, 255, values);
   for (int c=0; c<256; c++)
-    m_cmap[c] = std::clamp(m_cmap[c], 0, 255);
+    m_cmap[c] = std::clamp(values[c], 0, 255);
 }
 
 const char* ColorCurveFilter::getName()
@@ -51,40 +52,34 @@ const char* ColorCurveFilter::getName()
 
 void ColorCurveFilter::applyToRgba(FilterManager* filterMgr)
 {
-  int c, r, g, b, a;
+  const Target rgbTarget = filterMgr->getTarget();
+  const ChannelMap& rmap = channel_map_for_target(m_cmap, rgbTarget, TARGET_RED_CHANNEL);
+  const ChannelMap& gmap = channel_map_for_target(m_cmap, rgbTarget, TARGET_GREEN_CHANNEL);
+  const ChannelMap& bmap = channel_map_for_target(m_cmap, rgbTarget, TARGET_BLUE_CHANNEL);
+  const ChannelMap& amap = channel_map_for_target(m_cmap, rgbTarget, TARGET_ALPHA_CHANNEL);
+  color_t c;
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t) {
     c = *src_address;
-
-    r = rgba_getr(c);
-    g = rgba_getg(c);
-    b = rgba_getb(c);
-    a = rgba_geta(c);
-
-    if (target & TARGET_RED_CHANNEL) r = m_cmap[r];
-    if (target & TARGET_GREEN_CHANNEL) g = m_cmap[g];
-    if (target & TARGET_BLUE_CHANNEL) b = m_cmap[b];
-    if (target & TARGET_ALPHA_CHANNEL) a = m_cmap[a];
-
-    *dst_address = rgba(r, g, b, a);
+    *dst_address = rgba(rmap[rgba_getr(c)],
+                        gmap[rgba_getg(c)],
+                        bmap[rgba_getb(c)],
+                        amap[rgba_geta(c)]);
   }
   FILTER_LOOP_THROUGH_ROW_END()
 }
 
 void ColorCurveFilter::applyToGrayscale(FilterManager* filterMgr)
 {
-  int c, k, a;
+  const Target grayTarget = filterMgr->getTarget();
+  const ChannelMap& kmap = channel_map_for_target(m_cmap, grayTarget, TARGET_GRAY_CHANNEL);
+  const ChannelMap& amap = channel_map_for_target(m_cmap, grayTarget, TARGET_ALPHA_CHANNEL);
+  color_t c;
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t) {
     c = *src_address;
-
-    k = graya_getv(c);
-    a = graya_geta(c);
-
-    if (target & TARGET_GRAY_CHANNEL) k = m_cmap[k];
-    if (target & TARGET_ALPHA_CHANNEL) a = m_cmap[a];
-
-    *dst_address = graya(k, a);
+    *dst_address = graya(kmap[graya_getv(c)],
+                         amap[graya_geta(c)]);
   }
   FILTER_LOOP_THROUGH_ROW_END()
 }
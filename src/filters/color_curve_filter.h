@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -9,8 +9,7 @@
 #define FILTERS_COLOR_CURVE_FILTER_H_INCLUDED
 #pragma once
 
-#include <vector>
-
+#include "filters/channel_map.h"
 #include "filters/filter.h"
 #include "filters/color_curve.h"
 
@@ -22,18 +21,20 @@ namespace filters {
 
     void setCurve(const ColorCurve& curve);
     const ColorCurve& getCurve() const { return m_curve; }
+    const ChannelMap& getChannelMap() const { return m_cmap; }
 
     // Filter implementation
     const char* getName();
     void applyToRgba(FilterManager* filterMgr);
     void applyToGrayscale(FilterManager* filterMgr);
     void applyToIndexed(FilterManager* filterMgr);
+    bool isPerPixel() const { return true; }
 
   private:
     void generateMap();
 
     ColorCurve m_curve;
-    std::vector<int> m_cmap;
+    ChannelMap m_cmap;
   };
 
 } // namespace filters
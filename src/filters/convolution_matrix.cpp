@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -10,6 +11,9 @@
 
 #include "filters/convolution_matrix.h"
 
+#include <cstdlib>
+#include <numeric>
+
 namespace filters {
 
 ConvolutionMatrix::ConvolutionMatrix(int width, int height)
@@ -24,4 +28,52 @@ ConvolutionMatrix::ConvolutionMatrix(int width, int height)
 {
 }
 
+void ConvolutionMatrix::updateSeparable()
+{
+  m_rowFactors.clear();
+  m_colFactors.clear();
+
+  // 1D matrices are already applied in O(k) per pixel
+  if (m_width < 2 || m_height < 2)
+    return;
+
+  // The first row with a non-zero value divided by the GCD of its
+  // values is the row of factors
+  int y0 = 0, x0 = 0;
+  for (; y0<m_height; ++y0) {
+    for (x0=0; x0<m_width && value(x0, y0) == 0; ++x0)
+      ;
+    if (x0 < m_width)
+      break;
+  }
+  if (y0 == m_height)
+    return;
+
+  int gcd = 0;
+  for (int x=0; x<m_width; ++x)
+    gcd = std::gcd(gcd, std::abs(value(x, y0)));
+  if (value(x0, y0) < 0)
+    gcd = -gcd;
+
+  std::vector<int> row(m_width);
+  for (int x=0; x<m_width; ++x)
+    row[x] = value(x, y0) / gcd;
+
+  // Each row must be a multiple of the row of factors
+  std::vector<int> col(m_height);
+  for (int y=0; y<m_height; ++y) {
+    if (value(x0, y) % row[x0] != 0)
+      return;
+
+    col[y] = value(x0, y) / row[x0];
+    for (int x=0; x<m_width; ++x) {
+      if (value(x, y) != col[y] * row[x])
+        return;
+    }
+  }
+
+  m_rowFactors = std::move(row);
+  m_colFactors = std::move(col);
+}
+
 } // namespace filters
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -54,6 +55,19 @@ namespace filters {
     int& value(int x, int y) { return m_data[y*m_width+x]; }
     const int& value(int x, int y) const { return m_data[y*m_width+x]; }
 
+    // Returns true if the matrix is the product of a column and a row
+    // of integer factors (e.g. box or gaussian blurs), so it can be
+    // applied in two 1D passes:
+    //
+    //    value(x, y) == getColumnFactors()[y] * getRowFactors()[x]
+    //
+    // updateSeparable() must be called after changing the matrix
+    // values.
+    bool isSeparable() const { return !m_rowFactors.empty(); }
+    const std::vector<int>& getRowFactors() const { return m_rowFactors; }
+    const std::vector<int>& getColumnFactors() const { return m_colFactors; }
+    void updateSeparable();
+
   private:
     std::string m_name;          // Name
     int m_width, m_height;       // Size of the matrix
@@ -62,6 +76,8 @@ namespace filters {
     int m_bias;                  // Addition factor (for offset)
     Target m_defaultTarget;      // Targets by default (look at TARGET_RED_CHANNEL, etc. constants)
     std::vector<int> m_data;     // The matrix with the multiplication factors
+    std::vector<int> m_rowFactors; // Factors of a separable matrix (or empty)
+    std::vector<int> m_colFactors;
   };
 
 } // namespace filters
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -19,6 +19,10 @@
 #include "doc/palette.h"
 #include "doc/rgbmap.h"
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
 namespace filters {
 
 using namespace doc;
@@ -29,20 +33,32 @@ namespace {
     int div;
     const int* matrixData;
 
-    void reset(const ConvolutionMatrix* matrix) {
-      div = matrix->getDiv();
-      matrixData = &matrix->value(0, 0);
+    void reset(const int* data, int initialDiv) {
+      div = initialDiv;
+      matrixData = data;
     }
   };
 
   struct GetPixelsDelegateRgba : public GetPixelsDelegate {
     int r, g, b, a;
 
-    void reset(const ConvolutionMatrix* matrix) {
-      GetPixelsDelegate::reset(matrix);
+    void reset(const int* data, int initialDiv) {
+      GetPixelsDelegate::reset(data, initialDiv);
       r = g = b = a = 0;
     }
 
+    void reset(const ConvolutionMatrix* matrix) {
+      reset(&matrix->value(0, 0), matrix->getDiv());
+    }
+
+    void addScaled(const GetPixelsDelegateRgba& o, int factor) {
+      r += o.r * factor;
+      g += o.g * factor;
+      b += o.b * factor;
+      a += o.a * factor;
+      div += o.div * factor;
+    }
+
     void operator()(RgbTraits::pixel_t color) {
       if (*matrixData) {
         if (rgba_geta(color) == 0)
@@ -61,11 +77,21 @@ namespace {
   struct GetPixelsDelegateGrayscale : public GetPixelsDelegate {
     int v, a;
 
-    void reset(const ConvolutionMatrix* matrix) {
-      GetPixelsDelegate::reset(matrix);
+    void reset(const int* data, int initialDiv) {
+      GetPixelsDelegate::reset(data, initialDiv);
       v = a = 0;
     }
 
+    void reset(const ConvolutionMatrix* matrix) {
+      reset(&matrix->value(0, 0), matrix->getDiv());
+    }
+
+    void addScaled(const GetPixelsDelegateGrayscale& o, int factor) {
+      v += o.v * factor;
+      a += o.a * factor;
+      div += o.div * factor;
+    }
+
     void operator()(GrayscaleTraits::pixel_t color) {
       if (*matrixData) {
         if (graya_geta(color) == 0)
@@ -85,11 +111,24 @@ namespace {
 
     GetPixelsDelegateIndexed(const Palette* pal) : pal(pal) { }
 
-    void reset(const ConvolutionMatrix* matrix) {
-      GetPixelsDelegate::reset(matrix);
+    void reset(const int* data, int initialDiv) {
+      GetPixelsDelegate::reset(data, initialDiv);
       r = g = b = a = index = 0;
     }
 
+    void reset(const ConvolutionMatrix* matrix) {
+      reset(&matrix->value(0, 0), matrix->getDiv());
+    }
+
+    void addScaled(const GetPixelsDelegateIndexed& o, int factor) {
+      r += o.r * factor;
+      g += o.g * factor;
+      b += o.b * factor;
+      a += o.a * factor;
+      index += o.index * factor;
+      div += o.div * factor;
+    }
+
     void operator()(IndexedTraits::pixel_t color) {
       if (*matrixData) {
         index += color * (*matrixData);
@@ -107,6 +146,111 @@ namespace {
     }
   };
 
+  // Applies a separable matrix to a row of pixels in two 1D passes:
+  // first each column of the row neighborhood is accumulated with
+  // the column factors (vertical pass) in one delegate per column,
+  // and then the delegate of each pixel accumulates its neighboring
+  // columns with the row factors (horizontal pass). The result of
+  // each delegate is the same as calling get_neighboring_pixels()
+  // with the whole matrix, but it costs O(w+h) per pixel instead of
+  // O(w*h).
+  template<typename Traits, typename Delegate>
+  class SeparableRow {
+  public:
+    SeparableRow(const Image* src,
+                 const ConvolutionMatrix* matrix,
+                 const TiledMode tiledMode,
+                 const int x, const int y, const int w,
+                 const Delegate& prototype)
+      : m_x(x - matrix->getCenterX())
+      , m_matrix(matrix)
+      , m_columns(w + matrix->getWidth() - 1, prototype) {
+      const bool tiledX = (int(tiledMode) & int(TiledMode::X_AXIS));
+      const bool tiledY = (int(tiledMode) & int(TiledMode::Y_AXIS));
+      const int* colFactors = &matrix->getColumnFactors()[0];
+
+      std::vector<int> rows(matrix->getHeight());
+      for (int dy=0; dy<int(rows.size()); ++dy)
+        rows[dy] = get_neighboring_coord(y - matrix->getCenterY() + dy,
+                                         src->height(), tiledY);
+
+      for (int u=0; u<int(m_columns.size()); ++u) {
+        const int srcX = get_neighboring_coord(m_x + u, src->width(), tiledX);
+        Delegate& column = m_columns[u];
+        column.reset(colFactors, 0);
+        for (int srcY : rows)
+          column(get_pixel_fast<Traits>(src, srcX, srcY));
+      }
+    }
+
+    void get(const int x, Delegate& delegate) const {
+      const std::vector<int>& rowFactors = m_matrix->getRowFactors();
+      const Delegate* column = &m_columns[x - m_matrix->getCenterX() - m_x];
+
+      delegate.reset(m_matrix);
+      for (int factor : rowFactors) {
+        if (factor)
+          delegate.addScaled(*column, factor);
+        ++column;
+      }
+    }
+
+  private:
+    int m_x;
+    const ConvolutionMatrix* m_matrix;
+    std::vector<Delegate> m_columns;
+  };
+
+  // Uses a separable matrix only when the image is not narrower than
+  // the matrix (where get_neighboring_pixels() doesn't clamp the X
+  // coordinate in the same way).
+  bool use_separable_matrix(const ConvolutionMatrix* matrix,
+                            const Image* src)
+  {
+    return (matrix->isSeparable() &&
+            matrix->getWidth() <= src->width());
+  }
+
+  // Calculates the delegate values for the given pixel using the
+  // separable row (if it's available) or the whole matrix.
+  template<typename Traits, typename Delegate>
+  void get_convolution(const Image* src, const int x, const int y,
+                       const ConvolutionMatrix* matrix,
+                       const TiledMode tiledMode,
+                       const std::unique_ptr<SeparableRow<Traits, Delegate>>& separable,
+                       Delegate& delegate)
+  {
+    if (separable) {
+      separable->get(x, delegate);
+    }
+    else {
+      delegate.reset(matrix);
+      get_neighboring_pixels<Traits>(src, x, y,
+                                     matrix->getWidth(),
+                                     matrix->getHeight(),
+                                     matrix->getCenterX(),
+                                     matrix->getCenterY(),
+                                     tiledMode, delegate);
+    }
+  }
+
+  template<typename Traits, typename Delegate>
+  std::unique_ptr<SeparableRow<Traits, Delegate>>
+  create_separable_row(FilterManager* filterMgr,
+                       const ConvolutionMatrix* matrix,
+                       const TiledMode tiledMode,
+                       const Delegate& prototype)
+  {
+    const Image* src = filterMgr->getSourceImage();
+    if (!use_separable_matrix(matrix, src))
+      return nullptr;
+
+    return std::make_unique<SeparableRow<Traits, Delegate>>(
+      src, matrix, tiledMode,
+      filterMgr->x(), filterMgr->y(), filterMgr->getWidth(),
+      prototype);
+  }
+
 }
 
 ConvolutionMatrixFilter::ConvolutionMatrixFilter()
@@ -138,15 +282,12 @@ void ConvolutionMatrixFilter::applyToRgba(FilterManager* filterMgr)
   const Image* src = filterMgr->getSourceImage();
   uint32_t color;
   GetPixelsDelegateRgba delegate;
+  const auto separable = create_separable_row<RgbTraits>(
+    filterMgr, m_matrix.get(), m_tiledMode, delegate);
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t) {
-    delegate.reset(m_matrix.get());
-    get_neighboring_pixels<RgbTraits>(src, x, y,
-                                      m_matrix->getWidth(),
-                                      m_matrix->getHeight(),
-                                      m_matrix->getCenterX(),
-                                      m_matrix->getCenterY(),
-                                      m_tiledMode, delegate);
+    get_convolution(src, x, y, m_matrix.get(), m_tiledMode,
+                    separable, delegate);
 
     color = get_pixel_fast<RgbTraits>(src, x, y);
     if (delegate.div == 0) {
@@ -195,15 +336,12 @@ void ConvolutionMatrixFilter::applyToGrayscale(FilterManager* filterMgr)
   const Image* src = filterMgr->getSourceImage();
   uint16_t color;
   GetPixelsDelegateGrayscale delegate;
+  const auto separable = create_separable_row<GrayscaleTraits>(
+    filterMgr, m_matrix.get(), m_tiledMode, delegate);
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t) {
-    delegate.reset(m_matrix.get());
-    get_neighboring_pixels<GrayscaleTraits>(src, x, y,
-                                            m_matrix->getWidth(),
-                                            m_matrix->getHeight(),
-                                            m_matrix->getCenterX(),
-                                            m_matrix->getCenterY(),
-                                            m_tiledMode, delegate);
+    get_convolution(src, x, y, m_matrix.get(), m_tiledMode,
+                    separable, delegate);
 
     color = get_pixel_fast<GrayscaleTraits>(src, x, y);
     if (delegate.div == 0) {
@@ -240,15 +378,12 @@ void ConvolutionMatrixFilter::applyToIndexed(FilterManager* filterMgr)
   const RgbMap* rgbmap = filterMgr->getIndexedData()->getRgbMap();
   uint8_t color;
   GetPixelsDelegateIndexed delegate(pal);
+  const auto separable = create_separable_row<IndexedTraits>(
+    filterMgr, m_matrix.get(), m_tiledMode, delegate);
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint8_t) {
-    delegate.reset(m_matrix.get());
-    get_neighboring_pixels<IndexedTraits>(src, x, y,
-                                          m_matrix->getWidth(),
-                                          m_matrix->getHeight(),
-                                          m_matrix->getCenterX(),
-                                          m_matrix->getCenterY(),
-                                          m_tiledMode, delegate);
+    get_convolution(src, x, y, m_matrix.get(), m_tiledMode,
+                    separable, delegate);
 
     color = get_pixel_fast<IndexedTraits>(src, x, y);
     if (delegate.div == 0) {
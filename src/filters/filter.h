@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -44,6 +44,18 @@ namespace filters {
 
     // Applies the filter to the color palette.
     virtual void applyToPalette(FilterManager* filterMgr) { }
+
+    // Returns true if applyToRgba() and applyToGrayscale() can be
+    // called for different rows at the same time from several
+    // threads (i.e. they don't modify the filter state). Filters that
+    // cannot be split in bands of rows must return false.
+    virtual bool canApplyToRowsInParallel() const { return true; }
+
+    // Returns true if each output pixel depends only on the same
+    // source pixel (the filter doesn't read neighbors with
+    // FilterManager::getSourceImage()). Per-pixel filters can be
+    // applied to each tile of a tileset instead of the tilemap.
+    virtual bool isPerPixel() const { return false; }
   };
 
   // Filter that support applying it only to palette colors.
@@ -52,6 +64,10 @@ namespace filters {
     FilterWithPalette();
     void applyToPalette(FilterManager* filterMgr) override;
 
+    // Returns true if the last applyToPalette() call decided to
+    // replace colors of RGB images with the modified palette.
+    bool usePaletteOnRGB() const { return m_usePaletteOnRGB; }
+
   protected:
     virtual void onApplyToPalette(FilterManager* filterMgr,
                                   const doc::PalettePicks& picks) = 0;
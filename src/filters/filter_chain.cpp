@@ -0,0 +1,195 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "filters/filter_chain.h"
+
+#include "doc/palette_picks.h"
+#include "filters/filter_indexed_data.h"
+#include "filters/filter_manager.h"
+
+namespace filters {
+
+using namespace doc;
+
+namespace {
+
+  // FilterManager given to each filter of the chain. The second and
+  // next filters read the pixels from the destination row (the result
+  // of the previous filter), use the filter's own target, and see the
+  // palette generated by the previous filters.
+  class StepManager : public FilterManager,
+                      public FilterIndexedData {
+  public:
+    StepManager(FilterManager* mgr,
+                const Target target,
+                const bool readDst,
+                const std::vector<bool>* skip,
+                const Palette* pal,
+                Palette* newPal)
+      : m_mgr(mgr)
+      , m_target(target & mgr->getTarget())
+      , m_readDst(readDst)
+      , m_skip(skip)
+      , m_pal(pal)
+      , m_newPal(newPal) {
+    }
+
+    // FilterManager impl
+    PixelFormat pixelFormat() const override { return m_mgr->pixelFormat(); }
+    const void* getSourceAddress() override {
+      return (m_readDst ? m_mgr->getDestinationAddress():
+                          m_mgr->getSourceAddress());
+    }
+    void* getDestinationAddress() override { return m_mgr->getDestinationAddress(); }
+    int getWidth() override { return m_mgr->getWidth(); }
+    Target getTarget() override { return m_target; }
+    FilterIndexedData* getIndexedData() override { return this; }
+    bool skipPixel() override {
+      return (m_skip && (*m_skip)[m_x++]);
+    }
+    const Image* getSourceImage() override { return m_mgr->getSourceImage(); }
+    int x() const override { return m_mgr->x(); }
+    int y() const override { return m_mgr->y(); }
+    bool isFirstRow() const override { return m_mgr->isFirstRow(); }
+    bool isMaskActive() const override { return m_mgr->isMaskActive(); }
+    base::task_token& taskToken() const override { return m_mgr->taskToken(); }
+
+    // FilterIndexedData impl
+    const Palette* getPalette() const override {
+      return (m_pal ? m_pal: m_mgr->getIndexedData()->getPalette());
+    }
+    const RgbMap* getRgbMap() const override {
+      return m_mgr->getIndexedData()->getRgbMap();
+    }
+    Palette* getNewPalette() override {
+      return (m_newPal ? m_newPal: m_mgr->getIndexedData()->getNewPalette());
+    }
+    PalettePicks getPalettePicks() override {
+      return m_mgr->getIndexedData()->getPalettePicks();
+    }
+
+  private:
+    FilterManager* m_mgr;
+    Target m_target;
+    bool m_readDst;
+    const std::vector<bool>* m_skip;
+    int m_x = 0;
+    const Palette* m_pal;
+    Palette* m_newPal;
+  };
+
+}
+
+FilterChain::FilterChain()
+{
+}
+
+void FilterChain::addFilter(std::unique_ptr<Filter>&& filter,
+                            const Target target)
+{
+  if (!m_name.empty())
+    m_name += " + ";
+  m_name += filter->getName();
+
+  m_steps.push_back(Step{ std::move(filter), target });
+  m_palettes.clear();
+}
+
+Target FilterChain::target() const
+{
+  Target target = 0;
+  for (const auto& step : m_steps)
+    target |= step.target;
+  return target;
+}
+
+const char* FilterChain::getName()
+{
+  return m_name.c_str();
+}
+
+template<typename ApplyToRow>
+void FilterChain::applyToRow(FilterManager* filterMgr, ApplyToRow apply)
+{
+  // skipPixel() advances the mask iterator of the real manager, so
+  // we read it once for the whole row and repeat it for each filter.
+  const int w = filterMgr->getWidth();
+  std::vector<bool> skip(w);
+  for (int x=0; x<w; ++x)
+    skip[x] = filterMgr->skipPixel();
+
+  const bool usePalettes = (int(m_palettes.size()) == size()+1);
+  for (int i=0; i<size(); ++i) {
+    StepManager stepMgr(filterMgr, m_steps[i].target, (i > 0), &skip,
+                        (usePalettes ? &m_palettes[i]: nullptr),
+                        (usePalettes ? &m_palettes[i+1]: nullptr));
+    apply(m_steps[i].filter.get(), &stepMgr);
+  }
+}
+
+void FilterChain::applyToRgba(FilterManager* filterMgr)
+{
+  applyToRow(filterMgr, [](Filter* filter, FilterManager* mgr){
+    filter->applyToRgba(mgr);
+  });
+}
+
+void FilterChain::applyToGrayscale(FilterManager* filterMgr)
+{
+  applyToRow(filterMgr, [](Filter* filter, FilterManager* mgr){
+    filter->applyToGrayscale(mgr);
+  });
+}
+
+void FilterChain::applyToIndexed(FilterManager* filterMgr)
+{
+  applyToRow(filterMgr, [](Filter* filter, FilterManager* mgr){
+    filter->applyToIndexed(mgr);
+  });
+}
+
+void FilterChain::applyToPalette(FilterManager* filterMgr)
+{
+  FilterIndexedData* fid = filterMgr->getIndexedData();
+  const int n = size();
+
+  // Each filter modifies the palette generated by the previous one
+  m_palettes.assign(n+1, *fid->getPalette());
+  for (int i=0; i<n; ++i) {
+    m_palettes[i+1] = m_palettes[i];
+
+    StepManager stepMgr(filterMgr, m_steps[i].target, false, nullptr,
+                        &m_palettes[i], &m_palettes[i+1]);
+    m_steps[i].filter->applyToPalette(&stepMgr);
+  }
+
+  if (m_palettes[n] != *fid->getPalette())
+    *fid->getNewPalette() = m_palettes[n];
+}
+
+bool FilterChain::canApplyToRowsInParallel() const
+{
+  for (const auto& step : m_steps) {
+    if (!step.filter->canApplyToRowsInParallel())
+      return false;
+  }
+  return true;
+}
+
+bool FilterChain::isPerPixel() const
+{
+  for (const auto& step : m_steps) {
+    if (!step.filter->isPerPixel())
+      return false;
+  }
+  return true;
+}
+
+} // namespace filters
@@ -0,0 +1,70 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef FILTERS_FILTER_CHAIN_H_INCLUDED
+#define FILTERS_FILTER_CHAIN_H_INCLUDED
+#pragma once
+
+#include "doc/palette.h"
+#include "filters/filter.h"
+#include "filters/target.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace filters {
+
+  // Applies several filters to each row in just one pass: the first
+  // filter reads the source row, and the next ones read (and modify)
+  // the row generated by the previous filter. Only per-pixel filters
+  // (filters that don't use FilterManager::getSourceImage() to read
+  // neighbors) can be chained.
+  class FilterChain : public Filter {
+  public:
+    FilterChain();
+
+    // Adds a filter at the end of the chain, it will be applied to
+    // the given target channels.
+    void addFilter(std::unique_ptr<Filter>&& filter,
+                   const Target target);
+
+    bool empty() const { return m_steps.empty(); }
+    int size() const { return int(m_steps.size()); }
+
+    // Returns the union of the targets of all filters.
+    Target target() const;
+
+    // Filter implementation
+    const char* getName() override;
+    void applyToRgba(FilterManager* filterMgr) override;
+    void applyToGrayscale(FilterManager* filterMgr) override;
+    void applyToIndexed(FilterManager* filterMgr) override;
+    void applyToPalette(FilterManager* filterMgr) override;
+    bool canApplyToRowsInParallel() const override;
+    bool isPerPixel() const override;
+
+  private:
+    struct Step {
+      std::unique_ptr<Filter> filter;
+      Target target;
+    };
+
+    template<typename ApplyToRow>
+    void applyToRow(FilterManager* filterMgr, ApplyToRow apply);
+
+    std::vector<Step> m_steps;
+    std::string m_name;
+
+    // Palette before each filter (m_palettes[i]) and after each
+    // filter (m_palettes[i+1]) when the filters are applied to the
+    // palette.
+    std::vector<doc::Palette> m_palettes;
+  };
+
+} // namespace filters
+
+#endif
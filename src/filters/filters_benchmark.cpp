@@ -0,0 +1,197 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "base/task.h"
+#include "doc/image.h"
+#include "doc/palette.h"
+#include "doc/palette_picks.h"
+#include "filters/brightness_contrast_filter.h"
+#include "filters/color_curve.h"
+#include "filters/color_curve_filter.h"
+#include "filters/convolution_matrix.h"
+#include "filters/convolution_matrix_filter.h"
+#include "filters/filter_indexed_data.h"
+#include "filters/filter_manager.h"
+#include "filters/hue_saturation_filter.h"
+#include "filters/invert_color_filter.h"
+#include "filters/median_filter.h"
+#include "filters/outline_filter.h"
+#include "filters/replace_color_filter.h"
+#include "tests/benchmark_fixtures.h"
+
+#include <benchmark/benchmark.h>
+
+#include <functional>
+#include <memory>
+
+using namespace doc;
+using namespace filters;
+
+namespace {
+
+// Applies a filter to all the rows of an image (without selection,
+// in the same thread), so we measure only the filter itself.
+class ImageFilterManager : public FilterManager,
+                           public FilterIndexedData {
+public:
+  ImageFilterManager(const Image* src, Image* dst)
+    : m_src(src)
+    , m_dst(dst)
+    , m_pal(frame_t(0), 256) {
+    for (int i=0; i<256; ++i)
+      m_pal.setEntry(i, tests::fixture_color(IMAGE_RGB, i));
+  }
+
+  void apply(Filter* filter) {
+    for (m_y=0; m_y<m_src->height(); ++m_y) {
+      switch (m_src->pixelFormat()) {
+        case IMAGE_RGB: filter->applyToRgba(this); break;
+        case IMAGE_GRAYSCALE: filter->applyToGrayscale(this); break;
+        case IMAGE_INDEXED: filter->applyToIndexed(this); break;
+      }
+    }
+  }
+
+  // FilterManager impl
+  PixelFormat pixelFormat() const override { return m_src->pixelFormat(); }
+  const void* getSourceAddress() override { return m_src->getPixelAddress(0, m_y); }
+  void* getDestinationAddress() override { return m_dst->getPixelAddress(0, m_y); }
+  int getWidth() override { return m_src->width(); }
+  Target getTarget() override { return TARGET_ALL_CHANNELS; }
+  FilterIndexedData* getIndexedData() override { return this; }
+  bool skipPixel() override { return false; }
+  const Image* getSourceImage() override { return m_src; }
+  int x() const override { return 0; }
+  int y() const override { return m_y; }
+  bool isFirstRow() const override { return m_y == 0; }
+  bool isMaskActive() const override { return false; }
+  base::task_token& taskToken() const override { return m_token; }
+
+  // FilterIndexedData impl
+  const Palette* getPalette() const override { return &m_pal; }
+  const RgbMap* getRgbMap() const override { return nullptr; }
+  Palette* getNewPalette() override { return nullptr; }
+  PalettePicks getPalettePicks() override { return PalettePicks(m_pal.size()); }
+
+private:
+  const Image* m_src;
+  Image* m_dst;
+  Palette m_pal;
+  int m_y = 0;
+  mutable base::task_token m_token;
+};
+
+using FilterFactory = std::function<std::unique_ptr<Filter>()>;
+
+void BM_Filter(benchmark::State& state, FilterFactory createFilter)
+{
+  const int size = state.range(0);
+  std::unique_ptr<Image> src(Image::create(IMAGE_RGB, size, size));
+  std::unique_ptr<Image> dst(Image::create(IMAGE_RGB, size, size));
+  tests::draw_fixture_image(src.get(), 1);
+
+  std::unique_ptr<Filter> filter = createFilter();
+  for (auto _ : state) {
+    ImageFilterManager mgr(src.get(), dst.get());
+    mgr.apply(filter.get());
+  }
+}
+
+std::unique_ptr<Filter> brightness_contrast()
+{
+  auto filter = std::make_unique<BrightnessContrastFilter>();
+  filter->setBrightness(0.2);
+  filter->setContrast(0.3);
+  return filter;
+}
+
+std::unique_ptr<Filter> color_curve()
+{
+  ColorCurve curve(ColorCurve::Linear);
+  curve.addPoint(gfx::Point(0, 0));
+  curve.addPoint(gfx::Point(64, 96));
+  curve.addPoint(gfx::Point(255, 255));
+  auto filter = std::make_unique<ColorCurveFilter>();
+  filter->setCurve(curve);
+  return filter;
+}
+
+std::unique_ptr<Filter> convolution_matrix(int n)
+{
+  auto matrix = std::make_shared<ConvolutionMatrix>(n, n);
+  matrix->setCenterX(n/2);
+  matrix->setCenterY(n/2);
+  matrix->setDiv(n*n*ConvolutionMatrix::Precision);
+  matrix->setDefaultTarget(TARGET_ALL_CHANNELS);
+  for (int y=0; y<n; ++y)
+    for (int x=0; x<n; ++x)
+      matrix->value(x, y) = ConvolutionMatrix::Precision;
+  matrix->updateSeparable();
+
+  auto filter = std::make_unique<ConvolutionMatrixFilter>();
+  filter->setMatrix(matrix);
+  return filter;
+}
+
+std::unique_ptr<Filter> hue_saturation()
+{
+  auto filter = std::make_unique<HueSaturationFilter>();
+  filter->setMode(HueSaturationFilter::Mode::HSL_MUL);
+  filter->setHue(30.0);
+  filter->setSaturation(0.2);
+  filter->setLightness(-0.1);
+  return filter;
+}
+
+std::unique_ptr<Filter> median(int n)
+{
+  auto filter = std::make_unique<MedianFilter>();
+  filter->setSize(n, n);
+  return filter;
+}
+
+std::unique_ptr<Filter> outline()
+{
+  auto filter = std::make_unique<OutlineFilter>();
+  filter->place(OutlineFilter::Place::Outside);
+  filter->matrix(OutlineFilter::Matrix::Circle);
+  filter->color(rgba(0, 0, 0, 255));
+  filter->bgColor(rgba(0, 0, 0, 0));
+  return filter;
+}
+
+std::unique_ptr<Filter> replace_color()
+{
+  auto filter = std::make_unique<ReplaceColorFilter>();
+  filter->setFrom(tests::fixture_color(IMAGE_RGB, 200));
+  filter->setTo(rgba(255, 0, 0, 255));
+  filter->setTolerance(16);
+  return filter;
+}
+
+} // anonymous namespace
+
+#define FILTER_BENCHMARK(name, ...)                                     \
+  BENCHMARK_CAPTURE(BM_Filter, name, []{ return __VA_ARGS__; })         \
+    ->Arg(256)->Arg(1024)->Arg(4096)                                    \
+    ->Unit(benchmark::kMillisecond);
+
+FILTER_BENCHMARK(brightness_contrast, brightness_contrast())
+FILTER_BENCHMARK(color_curve, color_curve())
+FILTER_BENCHMARK(convolution_3x3, convolution_matrix(3))
+FILTER_BENCHMARK(convolution_7x7, convolution_matrix(7))
+FILTER_BENCHMARK(hue_saturation, hue_saturation())
+FILTER_BENCHMARK(invert_color, std::unique_ptr<Filter>(new InvertColorFilter))
+FILTER_BENCHMARK(median_3x3, median(3))
+FILTER_BENCHMARK(median_7x7, median(7))
+FILTER_BENCHMARK(outline, outline())
+FILTER_BENCHMARK(replace_color, replace_color())
+
+BENCHMARK_MAIN();
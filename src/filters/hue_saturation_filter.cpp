@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2017-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -21,6 +21,7 @@
 #include "gfx/hsv.h"
 #include "gfx/rgb.h"
 
+#include <array>
 #include <cmath>
 
 namespace filters {
@@ -38,6 +39,8 @@ HueSaturationFilter::HueSaturationFilter()
   , m_s(0.0)
   , m_l(0.0)
   , m_a(0.0)
+  , m_grayMap(identity_channel_map())
+  , m_alphaMap(identity_channel_map())
 {
 }
 
@@ -59,11 +62,13 @@ void HueSaturationFilter::setSaturation(double s)
 void HueSaturationFilter::setLightness(double l)
 {
   m_l = l;
+  updateGrayMap();
 }
 
 void HueSaturationFilter::setAlpha(double a)
 {
   m_a = a;
+  updateAlphaMap();
 }
 
 void HueSaturationFilter::applyToRgba(FilterManager* filterMgr)
@@ -71,6 +76,9 @@ void HueSaturationFilter::applyToRgba(FilterManager* filterMgr)
   FilterIndexedData* fid = filterMgr->getIndexedData();
   const Palette* pal = fid->getPalette();
   Palette* newPal = (m_usePaletteOnRGB ? fid->getNewPalette(): nullptr);
+  color_t lastSrc = 0;
+  color_t lastDst = 0;
+  bool hasLast = false;
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t) {
     color_t c = *src_address;
@@ -84,8 +92,16 @@ void HueSaturationFilter::applyToRgba(FilterManager* filterMgr)
       if (i >= 0)
         c = newPal->getEntry(i);
     }
+    // Consecutive pixels of the same color are common, so we can
+    // reuse the last converted color
+    else if (hasLast && c == lastSrc) {
+      c = lastDst;
+    }
     else {
+      lastSrc = c;
       applyFilterToRgb(target, c);
+      lastDst = c;
+      hasLast = true;
     }
 
     *dst_address = c;
@@ -95,29 +111,14 @@ void HueSaturationFilter::applyToRgba(FilterManager* filterMgr)
 
 void HueSaturationFilter::applyToGrayscale(FilterManager* filterMgr)
 {
+  const Target grayTarget = filterMgr->getTarget();
+  const ChannelMap& kmap = channel_map_for_target(m_grayMap, grayTarget, TARGET_GRAY_CHANNEL);
+  const ChannelMap& amap = channel_map_for_target(m_alphaMap, grayTarget, TARGET_ALPHA_CHANNEL);
+
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t) {
     color_t c = *src_address;
-    int k = graya_getv(c);
-    int a = graya_geta(c);
-
-    {
-      gfx::Hsl hsl(gfx::Rgb(k, k, k));
-
-      double l = hsl.lightness()*(1.0+m_l);
-      l = std::clamp(l, 0.0, 1.0);
-
-      hsl.lightness(l);
-      gfx::Rgb rgb(hsl);
-
-      if (target & TARGET_GRAY_CHANNEL) k = rgb.red();
-
-      if (a && (target & TARGET_ALPHA_CHANNEL)) {
-        a = a*(1.0+m_a);
-        a = std::clamp(a, 0, 255);
-      }
-    }
-
-    *dst_address = graya(k, a);
+    *dst_address = graya(kmap[graya_getv(c)],
+                         amap[graya_geta(c)]);
   }
   FILTER_LOOP_THROUGH_ROW_END()
 }
@@ -135,10 +136,18 @@ void HueSaturationFilter::applyToIndexed(FilterManager* filterMgr)
   const Palette* pal = fid->getPalette();
   const RgbMap* rgbmap = fid->getRgbMap();
 
+  // Each palette entry is converted only one time in each row
+  std::array<int, 256> indexes;
+  indexes.fill(-1);
+
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint8_t) {
-    color_t c = pal->getEntry(*src_address);
-    applyFilterToRgb(target, c);
-    *dst_address = rgbmap->mapColor(c);
+    int& index = indexes[*src_address];
+    if (index < 0) {
+      color_t c = pal->getEntry(*src_address);
+      applyFilterToRgb(target, c);
+      index = rgbmap->mapColor(c);
+    }
+    *dst_address = index;
   }
   FILTER_LOOP_THROUGH_ROW_END()
 }
@@ -199,10 +208,8 @@ void HueSaturationFilter::applyFilterToRgbT(const Target target,
   if (target & TARGET_RED_CHANNEL  ) r = rgb.red();
   if (target & TARGET_GREEN_CHANNEL) g = rgb.green();
   if (target & TARGET_BLUE_CHANNEL ) b = rgb.blue();
-  if (a && (target & TARGET_ALPHA_CHANNEL)) {
-    a = a*(1.0+m_a);
-    a = std::clamp(a, 0, 255);
-  }
+  if (target & TARGET_ALPHA_CHANNEL)
+    a = m_alphaMap[a];
 
   c = rgba(r, g, b, a);
 }
@@ -233,4 +240,25 @@ void HueSaturationFilter::applyFilterToRgb(const Target target, doc::color_t& co
   }
 }
 
+void HueSaturationFilter::updateGrayMap()
+{
+  for (int k=0; k<256; ++k) {
+    gfx::Hsl hsl(gfx::Rgb(k, k, k));
+
+    double l = hsl.lightness()*(1.0+m_l);
+    l = std::clamp(l, 0.0, 1.0);
+
+    hsl.lightness(l);
+    m_grayMap[k] = gfx::Rgb(hsl).red();
+  }
+}
+
+void HueSaturationFilter::updateAlphaMap()
+{
+  // Fully transparent pixels are kept transparent
+  m_alphaMap[0] = 0;
+  for (int a=1; a<256; ++a)
+    m_alphaMap[a] = std::clamp(int(a*(1.0+m_a)), 0, 255);
+}
+
 } // namespace filters
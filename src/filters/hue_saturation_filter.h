@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2017-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -10,6 +10,7 @@
 #pragma once
 
 #include "doc/color.h"
+#include "filters/channel_map.h"
 #include "filters/filter.h"
 #include "filters/target.h"
 
@@ -30,11 +31,18 @@ namespace filters {
     void setLightness(double v);
     void setAlpha(double a);
 
+    Mode mode() const { return m_mode; }
+    double hue() const { return m_h; }
+    double saturation() const { return m_s; }
+    double lightness() const { return m_l; }
+    double alpha() const { return m_a; }
+
     // Filter implementation
     const char* getName() override;
     void applyToRgba(FilterManager* filterMgr) override;
     void applyToGrayscale(FilterManager* filterMgr) override;
     void applyToIndexed(FilterManager* filterMgr) override;
+    bool isPerPixel() const override { return true; }
 
   private:
     void onApplyToPalette(FilterManager* filterMgr,
@@ -45,9 +53,13 @@ namespace filters {
              void (T::*set_lightness)(double)>
     void applyFilterToRgbT(const Target target, doc::color_t& color, bool multiply);
     void applyFilterToRgb(const Target target, doc::color_t& color);
+    void updateGrayMap();
+    void updateAlphaMap();
 
     Mode m_mode;
     double m_h, m_s, m_l, m_a;
+    ChannelMap m_grayMap;         // Lightness applied to gray values
+    ChannelMap m_alphaMap;
   };
 
 } // namespace filters
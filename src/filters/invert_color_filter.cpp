@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -25,42 +26,35 @@ const char* InvertColorFilter::getName()
   return "Invert Color";
 }
 
+// Each targeted channel is inverted XOR'ing the whole pixel with
+// 0xff in the bits of that channel.
+static int invert_mask(const Target target, const Target channel)
+{
+  return ((target & channel) ? 0xff: 0);
+}
+
 void InvertColorFilter::applyToRgba(FilterManager* filterMgr)
 {
-  int c, r, g, b, a;
+  const Target rgbTarget = filterMgr->getTarget();
+  const color_t mask = rgba(invert_mask(rgbTarget, TARGET_RED_CHANNEL),
+                            invert_mask(rgbTarget, TARGET_GREEN_CHANNEL),
+                            invert_mask(rgbTarget, TARGET_BLUE_CHANNEL),
+                            invert_mask(rgbTarget, TARGET_ALPHA_CHANNEL));
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t) {
-    c = *src_address;
-
-    r = rgba_getr(c);
-    g = rgba_getg(c);
-    b = rgba_getb(c);
-    a = rgba_geta(c);
-
-    if (target & TARGET_RED_CHANNEL) r ^= 0xff;
-    if (target & TARGET_GREEN_CHANNEL) g ^= 0xff;
-    if (target & TARGET_BLUE_CHANNEL) b ^= 0xff;
-    if (target & TARGET_ALPHA_CHANNEL) a ^= 0xff;
-
-    *dst_address = rgba(r, g, b, a);
+    *dst_address = *src_address ^ mask;
   }
   FILTER_LOOP_THROUGH_ROW_END()
 }
 
 void InvertColorFilter::applyToGrayscale(FilterManager* filterMgr)
 {
-  int c, k, a;
+  const Target grayTarget = filterMgr->getTarget();
+  const uint16_t mask = graya(invert_mask(grayTarget, TARGET_GRAY_CHANNEL),
+                              invert_mask(grayTarget, TARGET_ALPHA_CHANNEL));
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t) {
-    c = *src_address;
-
-    k = graya_getv(c);
-    a = graya_geta(c);
-
-    if (target & TARGET_GRAY_CHANNEL) k ^= 0xff;
-    if (target & TARGET_ALPHA_CHANNEL) a ^= 0xff;
-
-    *dst_address = graya(k, a);
+    *dst_address = *src_address ^ mask;
   }
   FILTER_LOOP_THROUGH_ROW_END()
 }
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -21,80 +21,293 @@
 #include "filters/tiled_mode.h"
 
 #include <algorithm>
+#include <array>
+#include <vector>
 
 namespace filters {
 
 using namespace doc;
 
 namespace {
-  struct GetPixelsDelegateRgba {
-    std::vector<std::vector<uint8_t> >& channel;
-    int c;
 
-    GetPixelsDelegateRgba(std::vector<std::vector<uint8_t> >& channel) : channel(channel) { }
+  // Matrices with less elements are calculated sorting the
+  // neighboring pixels, which is faster for small matrices than
+  // updating the histograms.
+  constexpr int kMinColorsForHistograms = 5*5;
 
-    void reset() { c = 0; }
+  constexpr int kMaxChannels = 4;
+  using ChannelValues = std::array<int, kMaxChannels>;
 
-    void operator()(RgbTraits::pixel_t color)
-    {
-      channel[0][c] = rgba_getr(color);
-      channel[1][c] = rgba_getg(color);
-      channel[2][c] = rgba_getb(color);
-      channel[3][c] = rgba_geta(color);
-      c++;
+  struct GetChannelsRgba {
+    void operator()(RgbTraits::pixel_t color, ChannelValues& v) const {
+      v[0] = rgba_getr(color);
+      v[1] = rgba_getg(color);
+      v[2] = rgba_getb(color);
+      v[3] = rgba_geta(color);
     }
   };
 
-  struct GetPixelsDelegateGrayscale {
-    std::vector<std::vector<uint8_t> >& channel;
-    int c;
+  struct GetChannelsGrayscale {
+    void operator()(GrayscaleTraits::pixel_t color, ChannelValues& v) const {
+      v[0] = graya_getv(color);
+      v[1] = graya_geta(color);
+    }
+  };
 
-    GetPixelsDelegateGrayscale(std::vector<std::vector<uint8_t> >& channel) : channel(channel) { }
+  struct GetChannelsIndexed {
+    const Palette* pal;
+    Target target;
 
-    void reset() { c = 0; }
+    void operator()(IndexedTraits::pixel_t color, ChannelValues& v) const {
+      if (target & TARGET_INDEX_CHANNEL) {
+        v[0] = color;
+      }
+      else {
+        color_t rgb = pal->getEntry(color);
+        v[0] = rgba_getr(rgb);
+        v[1] = rgba_getg(rgb);
+        v[2] = rgba_getb(rgb);
+        v[3] = rgba_geta(rgb);
+      }
+    }
+  };
+
+  // Collects the neighboring pixels of each pixel and sorts the
+  // values of each channel to get the median.
+  template<typename Traits, typename GetChannels>
+  class SortedWindow {
+  public:
+    SortedWindow(const Image* src, int width, int height, TiledMode tiledMode,
+                 int nchannels, const GetChannels& getChannels)
+      : m_src(src)
+      , m_width(width)
+      , m_height(height)
+      , m_tiledMode(tiledMode)
+      , m_nchannels(nchannels)
+      , m_getChannels(getChannels)
+      , m_channel(nchannels, std::vector<uint8_t>(width*height)) {
+    }
 
-    void operator()(GrayscaleTraits::pixel_t color)
-    {
-      channel[0][c] = graya_getv(color);
-      channel[1][c] = graya_geta(color);
-      c++;
+    void moveTo(int x, int y) {
+      m_c = 0;
+      get_neighboring_pixels<Traits>(m_src, x, y, m_width, m_height,
+                                     m_width/2, m_height/2,
+                                     m_tiledMode, *this);
     }
+
+    int median(int channel) {
+      auto& values = m_channel[channel];
+      std::sort(values.begin(), values.end());
+      return values[values.size()/2];
+    }
+
+    void operator()(typename Traits::pixel_t color) {
+      ChannelValues v;
+      m_getChannels(color, v);
+      for (int c=0; c<m_nchannels; ++c)
+        m_channel[c][m_c] = v[c];
+      ++m_c;
+    }
+
+  private:
+    const Image* m_src;
+    int m_width, m_height;
+    TiledMode m_tiledMode;
+    int m_nchannels;
+    GetChannels m_getChannels;
+    std::vector<std::vector<uint8_t> > m_channel;
+    int m_c = 0;
   };
 
-  struct GetPixelsDelegateIndexed {
-    const Palette* pal;
-    std::vector<std::vector<uint8_t> >& channel;
-    Target target;
-    int c;
+  // Histogram of one channel of the pixels in the window, the median
+  // is tracked incrementally as values are added/removed (Huang's
+  // algorithm).
+  class ChannelHistogram {
+  public:
+    void reset(int rank) {
+      m_count.fill(0);
+      m_rank = rank;
+      m_median = 0;
+      m_lessThanMedian = 0;
+    }
 
-    GetPixelsDelegateIndexed(const Palette* pal, std::vector<std::vector<uint8_t> >& channel, Target target)
-      : pal(pal), channel(channel), target(target) { }
+    void add(int v) {
+      ++m_count[v];
+      if (v < m_median)
+        ++m_lessThanMedian;
+    }
 
-    void reset() { c = 0; }
+    void remove(int v) {
+      --m_count[v];
+      if (v < m_median)
+        --m_lessThanMedian;
+    }
 
-    void operator()(IndexedTraits::pixel_t color)
-    {
-      if (target & TARGET_INDEX_CHANNEL) {
-        channel[0][c] = color;
+    // Returns the value at position "rank" of the sorted values.
+    int median() {
+      while (m_lessThanMedian > m_rank)
+        m_lessThanMedian -= m_count[--m_median];
+      while (m_lessThanMedian + m_count[m_median] <= m_rank)
+        m_lessThanMedian += m_count[m_median++];
+      return m_median;
+    }
+
+  private:
+    std::array<int, 256> m_count;
+    int m_rank = 0;
+    int m_median = 0;
+    int m_lessThanMedian = 0;
+  };
+
+  // Keeps the histograms of the channels in the window around the
+  // current pixel. Moving the window one pixel to the right removes
+  // the left column and adds a new column at the right, so the cost
+  // for each pixel is linear with the matrix height (instead of
+  // width*height). Uses the same coordinates of neighboring pixels
+  // as get_neighboring_pixels() (wrapping them in tiled mode, or
+  // clamping them to the image bounds).
+  template<typename Traits, typename GetChannels>
+  class HistogramWindow {
+  public:
+    HistogramWindow(const Image* src, int width, int height, TiledMode tiledMode,
+                    int nchannels, const GetChannels& getChannels)
+      : m_src(src)
+      , m_width(width)
+      , m_height(height)
+      , m_tiledX(int(tiledMode) & int(TiledMode::X_AXIS))
+      , m_tiledY(int(tiledMode) & int(TiledMode::Y_AXIS))
+      , m_nchannels(nchannels)
+      , m_getChannels(getChannels)
+      , m_rows(height) {
+    }
+
+    void moveTo(int x, int y) {
+      if (y != m_y || x < m_x || x > m_x+m_width) {
+        if (y != m_y) {
+          m_y = y;
+          for (int dy=0; dy<m_height; ++dy)
+            m_rows[dy] = get_neighboring_coord(y - m_height/2 + dy,
+                                               m_src->height(), m_tiledY);
+        }
+
+        m_x = x;
+        for (int c=0; c<m_nchannels; ++c)
+          m_hist[c].reset(m_width*m_height/2);
+        for (int dx=0; dx<m_width; ++dx)
+          updateColumn(x - m_width/2 + dx, +1);
       }
       else {
-        color_t rgb = pal->getEntry(color);
-        channel[0][c] = rgba_getr(rgb);
-        channel[1][c] = rgba_getg(rgb);
-        channel[2][c] = rgba_getb(rgb);
-        channel[3][c] = rgba_geta(rgb);
+        for (; m_x<x; ++m_x) {
+          updateColumn(m_x - m_width/2, -1);
+          updateColumn(m_x - m_width/2 + m_width, +1);
+        }
       }
-      c++;
     }
+
+    int median(int channel) {
+      return m_hist[channel].median();
+    }
+
+  private:
+    void updateColumn(int x, int sign) {
+      x = get_neighboring_coord(x, m_src->width(), m_tiledX);
+      ChannelValues v;
+      for (int dy=0; dy<m_height; ++dy) {
+        m_getChannels(get_pixel_fast<Traits>(m_src, x, m_rows[dy]), v);
+        for (int c=0; c<m_nchannels; ++c) {
+          if (sign > 0)
+            m_hist[c].add(v[c]);
+          else
+            m_hist[c].remove(v[c]);
+        }
+      }
+    }
+
+    const Image* m_src;
+    int m_width, m_height;
+    bool m_tiledX, m_tiledY;
+    int m_nchannels;
+    GetChannels m_getChannels;
+    std::vector<int> m_rows;
+    std::array<ChannelHistogram, kMaxChannels> m_hist;
+    int m_x = 0;
+    int m_y = -1;
   };
-};
+
+  template<typename Window>
+  void apply_median_to_rgba(FilterManager* filterMgr, Window& window)
+  {
+    const Image* src = filterMgr->getSourceImage();
+    int color, r, g, b, a;
+
+    FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t) {
+      window.moveTo(x, y);
+      color = get_pixel_fast<RgbTraits>(src, x, y);
+
+      r = (target & TARGET_RED_CHANNEL   ? window.median(0): rgba_getr(color));
+      g = (target & TARGET_GREEN_CHANNEL ? window.median(1): rgba_getg(color));
+      b = (target & TARGET_BLUE_CHANNEL  ? window.median(2): rgba_getb(color));
+      a = (target & TARGET_ALPHA_CHANNEL ? window.median(3): rgba_geta(color));
+
+      *dst_address = rgba(r, g, b, a);
+    }
+    FILTER_LOOP_THROUGH_ROW_END()
+  }
+
+  template<typename Window>
+  void apply_median_to_grayscale(FilterManager* filterMgr, Window& window)
+  {
+    const Image* src = filterMgr->getSourceImage();
+    int color, k, a;
+
+    FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t) {
+      window.moveTo(x, y);
+      color = get_pixel_fast<GrayscaleTraits>(src, x, y);
+
+      k = (target & TARGET_GRAY_CHANNEL  ? window.median(0): graya_getv(color));
+      a = (target & TARGET_ALPHA_CHANNEL ? window.median(1): graya_geta(color));
+
+      *dst_address = graya(k, a);
+    }
+    FILTER_LOOP_THROUGH_ROW_END()
+  }
+
+  template<typename Window>
+  void apply_median_to_indexed(FilterManager* filterMgr, Window& window)
+  {
+    const Image* src = filterMgr->getSourceImage();
+    const Palette* pal = filterMgr->getIndexedData()->getPalette();
+    const RgbMap* rgbmap = filterMgr->getIndexedData()->getRgbMap();
+    int color, r, g, b, a;
+
+    FILTER_LOOP_THROUGH_ROW_BEGIN(uint8_t) {
+      window.moveTo(x, y);
+
+      if (target & TARGET_INDEX_CHANNEL) {
+        *dst_address = window.median(0);
+      }
+      else {
+        color = get_pixel_fast<IndexedTraits>(src, x, y);
+        color = pal->getEntry(color);
+
+        r = (target & TARGET_RED_CHANNEL   ? window.median(0): rgba_getr(color));
+        g = (target & TARGET_GREEN_CHANNEL ? window.median(1): rgba_getg(pal->getEntry(color)));
+        b = (target & TARGET_BLUE_CHANNEL  ? window.median(2): rgba_getb(color));
+        a = (target & TARGET_ALPHA_CHANNEL ? window.median(3): rgba_geta(color));
+
+        *dst_address = rgbmap->mapColor(r, g, b, a);
+      }
+    }
+    FILTER_LOOP_THROUGH_ROW_END()
+  }
+
+} // anonymous namespace
 
 MedianFilter::MedianFilter()
   : m_tiledMode(TiledMode::NONE)
   , m_width(1)
   , m_height(1)
   , m_ncolors(0)
-  , m_channel(4)
 {
 }
 
@@ -111,9 +324,6 @@ void MedianFilter::setSize(int width, int height)
   m_width = std::max(1, width);
   m_height = std::max(1, height);
   m_ncolors = width*height;
-
-  for (int c = 0; c < 4; ++c)
-    m_channel[c].resize(m_ncolors);
 }
 
 const char* MedianFilter::getName()
@@ -121,137 +331,52 @@ const char* MedianFilter::getName()
   return "Median Blur";
 }
 
-void MedianFilter::applyToRgba(FilterManager* filterMgr)
+// Each row uses its own window (buffers/histograms), so the filter
+// can be applied to several rows at the same time. Histograms are
+// used for big matrices, except when the image is narrower than the
+// matrix (where get_neighboring_pixels() doesn't clamp the X
+// coordinate in the same way).
+template<typename Traits, typename GetChannels, typename ApplyToRow>
+void MedianFilter::applyWithWindow(const Image* src,
+                                   const int nchannels,
+                                   GetChannels getChannels,
+                                   ApplyToRow applyToRow)
 {
-  const Image* src = filterMgr->getSourceImage();
-  int color, r, g, b, a;
-  GetPixelsDelegateRgba delegate(m_channel);
-
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t) {
-    delegate.reset();
-    get_neighboring_pixels<RgbTraits>(src, x, y, m_width, m_height, m_width/2, m_height/2,
-                                      m_tiledMode, delegate);
-
-    color = get_pixel_fast<RgbTraits>(src, x, y);
-
-    if (target & TARGET_RED_CHANNEL) {
-      std::sort(m_channel[0].begin(), m_channel[0].end());
-      r = m_channel[0][m_ncolors/2];
-    }
-    else
-      r = rgba_getr(color);
-
-    if (target & TARGET_GREEN_CHANNEL) {
-      std::sort(m_channel[1].begin(), m_channel[1].end());
-      g = m_channel[1][m_ncolors/2];
-    }
-    else
-      g = rgba_getg(color);
-
-    if (target & TARGET_BLUE_CHANNEL) {
-      std::sort(m_channel[2].begin(), m_channel[2].end());
-      b = m_channel[2][m_ncolors/2];
-    }
-    else
-      b = rgba_getb(color);
-
-    if (target & TARGET_ALPHA_CHANNEL) {
-      std::sort(m_channel[3].begin(), m_channel[3].end());
-      a = m_channel[3][m_ncolors/2];
-    }
-    else
-      a = rgba_geta(color);
-
-    *dst_address = rgba(r, g, b, a);
+  if (m_ncolors >= kMinColorsForHistograms &&
+      m_width <= src->width()) {
+    HistogramWindow<Traits, GetChannels> window(
+      src, m_width, m_height, m_tiledMode, nchannels, getChannels);
+    applyToRow(window);
+  }
+  else {
+    SortedWindow<Traits, GetChannels> window(
+      src, m_width, m_height, m_tiledMode, nchannels, getChannels);
+    applyToRow(window);
   }
-  FILTER_LOOP_THROUGH_ROW_END()
 }
 
-void MedianFilter::applyToGrayscale(FilterManager* filterMgr)
+void MedianFilter::applyToRgba(FilterManager* filterMgr)
 {
-  const Image* src = filterMgr->getSourceImage();
-  int color, k, a;
-  GetPixelsDelegateGrayscale delegate(m_channel);
-
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t) {
-    delegate.reset();
-    get_neighboring_pixels<GrayscaleTraits>(src, x, y, m_width, m_height, m_width/2, m_height/2,
-                                            m_tiledMode, delegate);
-
-    color = get_pixel_fast<GrayscaleTraits>(src, x, y);
-
-    if (target & TARGET_GRAY_CHANNEL) {
-      std::sort(m_channel[0].begin(), m_channel[0].end());
-      k = m_channel[0][m_ncolors/2];
-    }
-    else
-      k = graya_getv(color);
-
-    if (target & TARGET_ALPHA_CHANNEL) {
-      std::sort(m_channel[1].begin(), m_channel[1].end());
-      a = m_channel[1][m_ncolors/2];
-    }
-    else
-      a = graya_geta(color);
+  applyWithWindow<RgbTraits>(
+    filterMgr->getSourceImage(), 4, GetChannelsRgba(),
+    [filterMgr](auto& window){ apply_median_to_rgba(filterMgr, window); });
+}
 
-    *dst_address = graya(k, a);
-  }
-  FILTER_LOOP_THROUGH_ROW_END()
+void MedianFilter::applyToGrayscale(FilterManager* filterMgr)
+{
+  applyWithWindow<GrayscaleTraits>(
+    filterMgr->getSourceImage(), 2, GetChannelsGrayscale(),
+    [filterMgr](auto& window){ apply_median_to_grayscale(filterMgr, window); });
 }
 
 void MedianFilter::applyToIndexed(FilterManager* filterMgr)
 {
-  const Image* src = filterMgr->getSourceImage();
-  const Palette* pal = filterMgr->getIndexedData()->getPalette();
-  const RgbMap* rgbmap = filterMgr->getIndexedData()->getRgbMap();
-  int color, r, g, b, a;
-  GetPixelsDelegateIndexed delegate(pal, m_channel, filterMgr->getTarget());
-
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint8_t) {
-    delegate.reset();
-    get_neighboring_pixels<IndexedTraits>(src, x, y, m_width, m_height, m_width/2, m_height/2,
-                                          m_tiledMode, delegate);
-
-    if (target & TARGET_INDEX_CHANNEL) {
-      std::sort(m_channel[0].begin(), m_channel[0].end());
-      *dst_address = m_channel[0][m_ncolors/2];
-    }
-    else {
-      color = get_pixel_fast<IndexedTraits>(src, x, y);
-      color = pal->getEntry(color);
-
-      if (target & TARGET_RED_CHANNEL) {
-        std::sort(m_channel[0].begin(), m_channel[0].end());
-        r = m_channel[0][m_ncolors/2];
-      }
-      else
-        r = rgba_getr(color);
-
-      if (target & TARGET_GREEN_CHANNEL) {
-        std::sort(m_channel[1].begin(), m_channel[1].end());
-        g = m_channel[1][m_ncolors/2];
-      }
-      else
-        g = rgba_getg(pal->getEntry(color));
-
-      if (target & TARGET_BLUE_CHANNEL) {
-        std::sort(m_channel[2].begin(), m_channel[2].end());
-        b = m_channel[2][m_ncolors/2];
-      }
-      else
-        b = rgba_getb(color);
-
-      if (target & TARGET_ALPHA_CHANNEL) {
-        std::sort(m_channel[3].begin(), m_channel[3].end());
-        a = m_channel[3][m_ncolors/2];
-      }
-      else
-        a = rgba_geta(color);
-
-      *dst_address = rgbmap->mapColor(r, g, b, a);
-    }
-  }
-  FILTER_LOOP_THROUGH_ROW_END()
+  const Target target = filterMgr->getTarget();
+  applyWithWindow<IndexedTraits>(
+    filterMgr->getSourceImage(),
+    (target & TARGET_INDEX_CHANNEL ? 1: 4),
+    GetChannelsIndexed{ filterMgr->getIndexedData()->getPalette(), target },
+    [filterMgr](auto& window){ apply_median_to_indexed(filterMgr, window); });
 }
 
 } // namespace filters
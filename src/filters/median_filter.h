@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -12,7 +13,9 @@
 #include "filters/filter.h"
 #include "filters/tiled_mode.h"
 
-#include <vector>
+namespace doc {
+  class Image;
+}
 
 namespace filters {
 
@@ -34,11 +37,16 @@ namespace filters {
     void applyToIndexed(FilterManager* filterMgr);
 
   private:
+    template<typename Traits, typename GetChannels, typename ApplyToRow>
+    void applyWithWindow(const doc::Image* src,
+                         const int nchannels,
+                         GetChannels getChannels,
+                         ApplyToRow applyToRow);
+
     TiledMode m_tiledMode;
     int m_width;
     int m_height;
     int m_ncolors;
-    std::vector<std::vector<uint8_t> > m_channel;
   };
 
 } // namespace filters
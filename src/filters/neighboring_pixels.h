@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -17,6 +18,19 @@
 namespace filters {
   using namespace doc;
 
+  // Returns the coordinate "v" of a neighboring pixel in one axis as
+  // get_neighboring_pixels() uses it: wrapped in tiled mode, or
+  // clamped to the image size. (In the X axis this is true only when
+  // the matrix width is not greater than the image width.)
+  inline int get_neighboring_coord(int v, const int size, const bool tiled)
+  {
+    if (tiled) {
+      v %= size;
+      return (v < 0 ? v+size: v);
+    }
+    return (v < 0 ? 0: (v >= size ? size-1: v));
+  }
+
   // Calls the specified "delegate" for all neighboring pixels in a 2D
   // (width*height) matrix located in (x,y) where its center is the
   // (centerX,centerY) element of the matrix.
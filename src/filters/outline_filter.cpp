@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -18,6 +18,7 @@
 #include "filters/neighboring_pixels.h"
 
 #include <algorithm>
+#include <vector>
 
 namespace filters {
 
@@ -79,6 +80,88 @@ namespace {
     }
   };
 
+  // Calculates the outline of the given thickness for the whole
+  // "src" image in one breadth-first pass: pixels in the outline are
+  // the ones that can be reached from a seed pixel (opaque pixels for
+  // Outside, transparent pixels for Inside) in 1 to "thickness" steps
+  // of the neighbors matrix. Each pixel is visited once, and the result
+  // is the same as applying the 1px outline "thickness" times (for
+  // Circle it's the city block distance, and for Square it's the
+  // chessboard distance).
+  template<typename Traits, typename IsTransparent>
+  void calc_thick_outline(const Image* src,
+                          const int matrix,
+                          const bool inside,
+                          const int thickness,
+                          const TiledMode tiledMode,
+                          IsTransparent isTransparent,
+                          std::vector<uint8_t>& outline)
+  {
+    const int w = src->width();
+    const int h = src->height();
+    const bool tiledX = (int(tiledMode) & int(TiledMode::X_AXIS));
+    const bool tiledY = (int(tiledMode) & int(TiledMode::Y_AXIS));
+
+    // 0 = not visited, 1 = in the outline, 2 = seed
+    outline.assign(w*h, 0);
+
+    std::vector<int> frontier, next;
+    for (int y=0; y<h; ++y) {
+      auto it = (typename Traits::const_address_t)src->getPixelAddress(0, y);
+      for (int x=0; x<w; ++x, ++it) {
+        if (isTransparent(*it) == inside) {
+          outline[y*w+x] = 2;
+          frontier.push_back(y*w+x);
+        }
+      }
+    }
+
+    // Returns the coordinates "p" of the given axis such that
+    // get_neighboring_coord(p+d) == q (more than one when q is clamped)
+    auto sources = [](const int q, const int d, const int size,
+                      const bool tiled, int* p) -> int {
+      int n = 0;
+      if (tiled)
+        p[n++] = get_neighboring_coord(q-d, size, true);
+      else {
+        if (q-d >= 0 && q-d < size)
+          p[n++] = q-d;
+        if ((d < 0 && q == 0) || (d > 0 && q == size-1))
+          p[n++] = q;
+      }
+      return n;
+    };
+
+    for (int step=0; step<thickness && !frontier.empty(); ++step) {
+      next.clear();
+      for (const int i : frontier) {
+        const int qx = i % w;
+        const int qy = i / w;
+        for (int bit=0; bit<9; ++bit) {
+          if (bit == 4 || !(matrix & (1 << bit)))
+            continue;
+
+          int px[2], py[2];
+          const int nx = sources(qx, (bit % 3) - 1, w, tiledX, px);
+          const int ny = sources(qy, (bit / 3) - 1, h, tiledY, py);
+          for (int v=0; v<ny; ++v) {
+            for (int u=0; u<nx; ++u) {
+              const int j = py[v]*w + px[u];
+              if (outline[j] == 0) {
+                outline[j] = 1;
+                next.push_back(j);
+              }
+            }
+          }
+        }
+      }
+      std::swap(frontier, next);
+    }
+
+    for (uint8_t& v : outline)
+      v = (v == 1 ? 1: 0);
+  }
+
 }
 
 OutlineFilter::OutlineFilter()
@@ -87,6 +170,8 @@ OutlineFilter::OutlineFilter()
   , m_tiledMode(TiledMode::NONE)
   , m_color(0)
   , m_bgColor(0)
+  , m_thickness(1)
+  , m_outlineImageId(doc::NullId)
 {
 }
 
@@ -95,6 +180,39 @@ const char* OutlineFilter::getName()
   return "Outline";
 }
 
+void OutlineFilter::updateThickOutline(FilterManager* filterMgr)
+{
+  const Image* src = filterMgr->getSourceImage();
+  if (!filterMgr->isFirstRow() && m_outlineImageId == src->id())
+    return;
+
+  const bool inside = (m_place == Place::Inside);
+  const color_t bg = m_bgColor;
+  switch (src->pixelFormat()) {
+    case IMAGE_RGB:
+      calc_thick_outline<RgbTraits>(
+        src, int(m_matrix), inside, m_thickness, m_tiledMode,
+        [bg](color_t c){ return (rgba_geta(c) == 0 || c == bg); },
+        m_outline);
+      break;
+    case IMAGE_GRAYSCALE:
+      calc_thick_outline<GrayscaleTraits>(
+        src, int(m_matrix), inside, m_thickness, m_tiledMode,
+        [bg](color_t c){ return (graya_geta(c) == 0 || c == bg); },
+        m_outline);
+      break;
+    case IMAGE_INDEXED: {
+      const Palette* pal = filterMgr->getIndexedData()->getPalette();
+      calc_thick_outline<IndexedTraits>(
+        src, int(m_matrix), inside, m_thickness, m_tiledMode,
+        [bg, pal](color_t c){ return (rgba_geta(pal->getEntry(c)) == 0 || c == bg); },
+        m_outline);
+      break;
+    }
+  }
+  m_outlineImageId = src->id();
+}
+
 void OutlineFilter::applyToRgba(FilterManager* filterMgr)
 {
   const Image* src = filterMgr->getSourceImage();
@@ -104,13 +222,20 @@ void OutlineFilter::applyToRgba(FilterManager* filterMgr)
 
   GetPixelsDelegateRgba delegate;
   delegate.init(m_bgColor, m_matrix);
+  if (m_thickness > 1)
+    updateThickOutline(filterMgr);
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t) {
-    delegate.reset();
-    get_neighboring_pixels<RgbTraits>(src, x, y, 3, 3, 1, 1, m_tiledMode, delegate);
+    if (m_thickness > 1) {
+      n = m_outline[y*src->width() + x];
+    }
+    else {
+      delegate.reset();
+      get_neighboring_pixels<RgbTraits>(src, x, y, 3, 3, 1, 1, m_tiledMode, delegate);
+      n = (m_place == Place::Outside ? delegate.opaque: delegate.transparent);
+    }
 
     c = *src_address;
-    n = (m_place == Place::Outside ? delegate.opaque: delegate.transparent);
     isTransparent = (rgba_geta(c) == 0 || c == m_bgColor);
 
     if ((n >= 1) &&
@@ -137,13 +262,20 @@ void OutlineFilter::applyToGrayscale(FilterManager* filterMgr)
 
   GetPixelsDelegateGrayscale delegate;
   delegate.init(m_bgColor, m_matrix);
+  if (m_thickness > 1)
+    updateThickOutline(filterMgr);
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t) {
-    delegate.reset();
-    get_neighboring_pixels<GrayscaleTraits>(src, x, y, 3, 3, 1, 1, m_tiledMode, delegate);
+    if (m_thickness > 1) {
+      n = m_outline[y*src->width() + x];
+    }
+    else {
+      delegate.reset();
+      get_neighboring_pixels<GrayscaleTraits>(src, x, y, 3, 3, 1, 1, m_tiledMode, delegate);
+      n = (m_place == Place::Outside ? delegate.opaque: delegate.transparent);
+    }
 
     c = *src_address;
-    n = (m_place == Place::Outside ? delegate.opaque: delegate.transparent);
     isTransparent = (graya_geta(c) == 0 || c == m_bgColor);
 
     if ((n >= 1) &&
@@ -170,13 +302,20 @@ void OutlineFilter::applyToIndexed(FilterManager* filterMgr)
 
   GetPixelsDelegateIndexed delegate(pal);
   delegate.init(m_bgColor, m_matrix);
+  if (m_thickness > 1)
+    updateThickOutline(filterMgr);
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint8_t) {
-    delegate.reset();
-    get_neighboring_pixels<IndexedTraits>(src, x, y, 3, 3, 1, 1, m_tiledMode, delegate);
+    if (m_thickness > 1) {
+      n = m_outline[y*src->width() + x];
+    }
+    else {
+      delegate.reset();
+      get_neighboring_pixels<IndexedTraits>(src, x, y, 3, 3, 1, 1, m_tiledMode, delegate);
+      n = (m_place == Place::Outside ? delegate.opaque: delegate.transparent);
+    }
 
     c = *src_address;
-    n = (m_place == Place::Outside ? delegate.opaque: delegate.transparent);
 
     if (target & TARGET_INDEX_CHANNEL) {
       isTransparent = (c == m_bgColor);
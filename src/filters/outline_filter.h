@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -9,9 +9,14 @@
 #pragma once
 
 #include "doc/color.h"
+#include "doc/object_id.h"
 #include "filters/filter.h"
 #include "filters/tiled_mode.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
 namespace filters {
 
   class OutlineFilter : public Filter {
@@ -32,12 +37,14 @@ namespace filters {
     void tiledMode(const TiledMode tiledMode) { m_tiledMode = tiledMode; }
     void color(const doc::color_t color) { m_color = color; }
     void bgColor(const doc::color_t color) { m_bgColor = color; }
+    void thickness(const int thickness) { m_thickness = std::max(1, thickness); }
 
     Place place() const { return m_place; }
     Matrix matrix() const { return m_matrix; }
     TiledMode tiledMode() const { return m_tiledMode; }
     doc::color_t color() const { return m_color; }
     doc::color_t bgColor() const { return m_bgColor; }
+    int thickness() const { return m_thickness; }
 
     // Filter implementation
     const char* getName();
@@ -45,12 +52,27 @@ namespace filters {
     void applyToGrayscale(FilterManager* filterMgr);
     void applyToIndexed(FilterManager* filterMgr);
 
+    // Thick outlines are calculated for the whole image in the first
+    // row, so rows cannot be processed in parallel.
+    bool canApplyToRowsInParallel() const override {
+      return m_thickness == 1;
+    }
+
   private:
+    void updateThickOutline(FilterManager* filterMgr);
+
     Place m_place;
     Matrix m_matrix;
     TiledMode m_tiledMode;
     doc::color_t m_color;
     doc::color_t m_bgColor;
+    int m_thickness;
+
+    // For thickness > 1, the pixels of the source image (with ID
+    // m_outlineImageId) that are in the outline have a 1 in this
+    // vector.
+    std::vector<uint8_t> m_outline;
+    doc::ObjectId m_outlineImageId;
   };
 
 } // namespace filters
@@ -1,4 +1,5 @@
 // Aseprite Network Library
+// Copyright (c) 2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -16,8 +17,57 @@
 
 #include <curl/curl.h>
 
+#include <atomic>
+#include <mutex>
+
 namespace net {
 
+// Data shared between all requests (DNS cache, TLS sessions, and
+// open connections) so consecutive requests to the same host
+// (e.g. the update check and the news) can reuse the connection
+// instead of doing a new DNS lookup + TCP/TLS handshake each time.
+class HttpShare {
+public:
+  static CURLSH* get() {
+    static HttpShare share;
+    return share.m_share;
+  }
+
+private:
+  HttpShare() : m_share(curl_share_init()) {
+    if (!m_share)
+      return;
+
+    curl_share_setopt(m_share, CURLSHOPT_LOCKFUNC, &HttpShare::lockCallback);
+    curl_share_setopt(m_share, CURLSHOPT_UNLOCKFUNC, &HttpShare::unlockCallback);
+    curl_share_setopt(m_share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900 // 7.57.0
+    curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+  }
+
+  ~HttpShare() {
+    if (m_share)
+      curl_share_cleanup(m_share);
+  }
+
+  static void lockCallback(CURL*, curl_lock_data data, curl_lock_access, void* userdata) {
+    auto share = reinterpret_cast<HttpShare*>(userdata);
+    share->m_mutexes[data % kMutexes].lock();
+  }
+
+  static void unlockCallback(CURL*, curl_lock_data data, void* userdata) {
+    auto share = reinterpret_cast<HttpShare*>(userdata);
+    share->m_mutexes[data % kMutexes].unlock();
+  }
+
+  static constexpr int kMutexes = 8;
+  CURLSH* m_share;
+  std::mutex m_mutexes[kMutexes];
+};
+
 class HttpRequestImpl {
 public:
   HttpRequestImpl(const std::string& url)
@@ -28,6 +78,14 @@ public:
     curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, &HttpRequestImpl::writeBodyCallback);
     curl_easy_setopt(m_curl, CURLOPT_URL, url.c_str());
     curl_easy_setopt(m_curl, CURLOPT_NOSIGNAL, 1);
+    curl_easy_setopt(m_curl, CURLOPT_NOPROGRESS, 0);
+    curl_easy_setopt(m_curl, CURLOPT_XFERINFODATA, this);
+    curl_easy_setopt(m_curl, CURLOPT_XFERINFOFUNCTION, &HttpRequestImpl::progressCallback);
+#if LIBCURL_VERSION_NUM >= 0x072f00 // 7.47.0
+    curl_easy_setopt(m_curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+#endif
+    if (CURLSH* share = HttpShare::get())
+      curl_easy_setopt(m_curl, CURLOPT_SHARE, share);
   }
 
   ~HttpRequestImpl() {
@@ -56,6 +114,9 @@ public:
   }
 
   bool send(HttpResponse& response) {
+    if (m_aborted)
+      return false;
+
     m_response = &response;
     int res = curl_easy_perform(m_curl);
     if (res != CURLE_OK)
@@ -67,9 +128,10 @@ public:
     return true;
   }
 
+  // Can be called from other thread while send() is waiting for the
+  // response, the transfer is stopped in the next progress callback.
   void abort() {
-    curl_easy_setopt(m_curl, CURLOPT_TIMEOUT_MS, 1);
-    curl_easy_setopt(m_curl, CURLOPT_CONNECTTIMEOUT_MS, 1);
+    m_aborted = true;
   }
 
 private:
@@ -84,9 +146,17 @@ private:
     return req->writeBody(ptr, size*nmemb);
   }
 
+  static int progressCallback(void* userdata,
+                              curl_off_t dltotal, curl_off_t dlnow,
+                              curl_off_t ultotal, curl_off_t ulnow) {
+    HttpRequestImpl* req = reinterpret_cast<HttpRequestImpl*>(userdata);
+    return (req->m_aborted ? 1: 0);
+  }
+
   CURL* m_curl;
   curl_slist* m_headerlist;
   HttpResponse* m_response;
+  std::atomic<bool> m_aborted = false;
 };
 
 HttpRequest::HttpRequest(const std::string& url)
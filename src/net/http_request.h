@@ -1,4 +1,5 @@
 // Aseprite Network Library
+// Copyright (c) 2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -25,6 +26,9 @@ public:
 
   void setHeaders(const HttpHeaders& headers);
   bool send(HttpResponse& response);
+
+  // Cancels the request, it can be called from other thread to stop
+  // a send() call that is in progress.
   void abort();
 
 private:
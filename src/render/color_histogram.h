@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c)      2020 Igara Studio S.A.
+// Copyright (c) 2020-2024 Igara Studio S.A.
 // Copyright (c) 2001-2015 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -9,6 +9,7 @@
 #define RENDER_COLOR_HISTOGRAM_H_INCLUDED
 #pragma once
 
+#include <algorithm>
 #include <limits>
 #include <vector>
 
@@ -22,11 +23,19 @@
 namespace render {
   using namespace doc;
 
+  // The memory used by a histogram is fixed: one "Count" for each
+  // entry (2^(RBits+GBits+BBits+ABits) entries) plus up to 256 colors
+  // for the high-precision table, no matter how many different colors
+  // are added.
   template<int RBits, // Number of bits for each component in the histogram
            int GBits,
            int BBits,
-           int ABits>
+           int ABits,
+           typename Count = std::size_t> // Type used to count samples (saturated)
   class ColorHistogram {
+    template<int, int, int, int, typename>
+    friend class ColorHistogram;
+
   public:
     // Number of elements in histogram for each RGB component
     enum {
@@ -39,6 +48,7 @@ namespace render {
     ColorHistogram()
       : m_histogram(RElements*GElements*BElements*AElements, 0)
       , m_useHighPrecision(true) {
+      m_highPrecision.reserve(256);
     }
 
     // Returns the number of points in the specified histogram
@@ -52,11 +62,7 @@ namespace render {
     // specified value in "count".
     void addSamples(doc::color_t color, std::size_t count = 1) {
       int i = histogramIndex(color);
-
-      if (m_histogram[i] < std::numeric_limits<std::size_t>::max()-count) // Avoid overflow
-        m_histogram[i] += count;
-      else
-        m_histogram[i] = std::numeric_limits<std::size_t>::max();
+      addCount(m_histogram[i], count);
 
       // Accurate colors are used only for less than 256 colors.  If the
       // image has more than 256 colors the m_histogram is used
@@ -78,6 +84,46 @@ namespace render {
       }
     }
 
+    // Adds all the samples of "other" to this histogram. The
+    // high-precision colors of "other" are appended after ours, so
+    // merging histograms of consecutive frames in order gives the
+    // same result as feeding all those frames to one histogram.
+    template<typename OtherCount>
+    void merge(const ColorHistogram<RBits, GBits, BBits, ABits, OtherCount>& other) {
+      for (std::size_t i=0; i<m_histogram.size(); ++i) {
+        const std::size_t count = other.m_histogram[i];
+        if (count)
+          addCount(m_histogram[i], count);
+      }
+
+      if (m_useHighPrecision) {
+        if (!other.m_useHighPrecision) {
+          m_useHighPrecision = false;
+          return;
+        }
+
+        for (doc::color_t color : other.m_highPrecision) {
+          if (std::find(m_highPrecision.begin(), m_highPrecision.end(), color) != m_highPrecision.end())
+            continue;
+
+          if (m_highPrecision.size() < 256) {
+            m_highPrecision.push_back(color);
+          }
+          else {
+            m_useHighPrecision = false;
+            break;
+          }
+        }
+      }
+    }
+
+    // Removes all samples (so the histogram can be reused).
+    void clear() {
+      std::fill(m_histogram.begin(), m_histogram.end(), 0);
+      m_highPrecision.clear();
+      m_useHighPrecision = true;
+    }
+
     // Creates a set of entries for the given palette in the given range
     // with the more important colors in the histogram. Returns the
     // number of used entries in the palette (maybe the range [from,to]
@@ -106,7 +152,23 @@ namespace render {
     bool isHighPrecision() { return m_useHighPrecision; }
     int highPrecisionSize() { return m_highPrecision.size(); }
 
+    // Bytes used by this histogram (it doesn't depend on the number
+    // of added samples/colors).
+    std::size_t memSize() const {
+      return (sizeof(*this) +
+              sizeof(Count) * m_histogram.size() +
+              sizeof(doc::color_t) * 256);
+    }
+
   private:
+    static void addCount(Count& value, const std::size_t count) {
+      constexpr std::size_t max = std::numeric_limits<Count>::max();
+      if (count < max && value < max-count) // Avoid overflow
+        value += Count(count);
+      else
+        value = Count(max);
+    }
+
     // Converts input color in a index for the histogram. It reduces
     // each 8-bit component to the resolution given in the template
     // parameters.
@@ -126,7 +188,7 @@ namespace render {
     }
 
     // 3D histogram (the index in the histogram is calculated through histogramIndex() function).
-    std::vector<std::size_t> m_histogram;
+    std::vector<Count> m_histogram;
 
     // High precision histogram to create an accurate palette if RGB
     // source images contains less than 256 colors.
@@ -0,0 +1,98 @@
+// Aseprite Render Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "render/color_histogram.h"
+
+using namespace doc;
+using namespace render;
+
+using Histogram = ColorHistogram<5, 6, 5, 5>;
+
+TEST(ColorHistogram, MergeIsLikeFeedingInOrder)
+{
+  const color_t colors[] = {
+    rgba(255, 0, 0, 255),
+    rgba(0, 255, 0, 255),
+    rgba(255, 0, 0, 255),
+    rgba(0, 0, 255, 255),
+    rgba(0, 255, 0, 255),
+    rgba(16, 32, 64, 128),
+  };
+
+  Histogram all, a, b;
+  for (int i=0; i<6; ++i) {
+    all.addSamples(colors[i]);
+    (i < 3 ? a: b).addSamples(colors[i]);
+  }
+  a.merge(b);
+
+  EXPECT_TRUE(a.isHighPrecision());
+  EXPECT_EQ(all.highPrecisionSize(), a.highPrecisionSize());
+  EXPECT_EQ(2u, a.at(31, 0, 0, 31));
+  EXPECT_EQ(2u, a.at(0, 63, 0, 31));
+  EXPECT_EQ(1u, a.at(0, 0, 31, 31));
+
+  Palette palA(0, 256), palAll(0, 256);
+  EXPECT_EQ(4, a.createOptimizedPalette(&palA));
+  EXPECT_EQ(4, all.createOptimizedPalette(&palAll));
+  for (int i=0; i<4; ++i)
+    EXPECT_EQ(palAll.getEntry(i), palA.getEntry(i));
+}
+
+TEST(ColorHistogram, MergeTooManyColors)
+{
+  Histogram a, b;
+  for (int i=0; i<200; ++i) {
+    a.addSamples(rgba(i, 0, 0, 255));
+    b.addSamples(rgba(0, i, 0, 255));
+  }
+  EXPECT_TRUE(a.isHighPrecision());
+  EXPECT_TRUE(b.isHighPrecision());
+
+  a.merge(b);
+  EXPECT_FALSE(a.isHighPrecision());
+
+  a.clear();
+  EXPECT_TRUE(a.isHighPrecision());
+  EXPECT_EQ(0, a.highPrecisionSize());
+  EXPECT_EQ(0u, a.at(0, 0, 0, 31));
+}
+
+TEST(ColorHistogram, SaturatedCounters)
+{
+  ColorHistogram<5, 6, 5, 5, uint8_t> small;
+  small.addSamples(rgba(255, 255, 255, 255), 200);
+  small.addSamples(rgba(255, 255, 255, 255), 100);
+  EXPECT_EQ(255u, small.at(31, 63, 31, 31));
+
+  Histogram big;
+  big.addSamples(rgba(255, 255, 255, 255), 1000);
+  big.merge(small);
+  EXPECT_EQ(1255u, big.at(31, 63, 31, 31));
+}
+
+TEST(ColorHistogram, FixedMemSize)
+{
+  ColorHistogram<5, 6, 5, 5, uint32_t> h;
+  const std::size_t size = h.memSize();
+  for (int i=0; i<100000; ++i)
+    h.addSamples(rgba(i & 255, (i >> 8) & 255, i*7 & 255, 255));
+  EXPECT_EQ(size, h.memSize());
+  EXPECT_FALSE(h.isHighPrecision());
+  EXPECT_EQ(256, h.highPrecisionSize());
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,153 @@
+// Aseprite Render Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef RENDER_COMPOSITE_CACHE_H_INCLUDED
+#define RENDER_COMPOSITE_CACHE_H_INCLUDED
+#pragma once
+
+#include "doc/blend_mode.h"
+#include "doc/color.h"
+#include "doc/frame.h"
+#include "doc/image_ref.h"
+#include "doc/object_version.h"
+#include "doc/pixel_format.h"
+#include "gfx/rect.h"
+#include "render/onionskin_options.h"
+
+#include <vector>
+
+namespace doc {
+  class Cel;
+  class Image;
+  class Layer;
+  class Palette;
+  class Sprite;
+  class Tileset;
+}
+
+namespace render {
+
+  // Flattened image of all the layers below the active layer (the
+  // layers that don't change while we are painting in the active
+  // layer), including the onion skin behind the sprite. Used by
+  // render::Render to composite only the active layer and the layers
+  // above it when the layers below didn't change.
+  //
+  // The cached image is the whole sprite canvas with the projection
+  // applied, so any area of the sprite can be restored from it.
+  class CompositeCache {
+  public:
+    // Everything that can modify the composited result of one cel.
+    // We use the ObjectVersion of each object, but we also keep the
+    // properties that are used by the render (opacity, bounds, etc.)
+    // in case that some modification doesn't increment the version.
+    struct Item {
+      const doc::Layer* layer = nullptr;
+      doc::ObjectVersion layerVersion = 0;
+      int layerOpacity = 0;
+      doc::BlendMode blendMode = doc::BlendMode::NORMAL;
+      const doc::Cel* cel = nullptr;
+      doc::ObjectVersion celVersion = 0;
+      doc::ObjectVersion celDataVersion = 0;
+      const doc::Image* image = nullptr;
+      doc::ObjectVersion imageVersion = 0;
+      const doc::Tileset* tileset = nullptr;
+      doc::ObjectVersion tilesetVersion = 0; // Tileset + tiles versions
+      gfx::RectF bounds;
+      int opacity = 0;
+      int zIndex = 0;
+
+      bool operator==(const Item& o) const {
+        return (layer == o.layer &&
+                layerVersion == o.layerVersion &&
+                layerOpacity == o.layerOpacity &&
+                blendMode == o.blendMode &&
+                cel == o.cel &&
+                celVersion == o.celVersion &&
+                celDataVersion == o.celDataVersion &&
+                image == o.image &&
+                imageVersion == o.imageVersion &&
+                tileset == o.tileset &&
+                tilesetVersion == o.tilesetVersion &&
+                bounds == o.bounds &&
+                opacity == o.opacity &&
+                zIndex == o.zIndex);
+      }
+      bool operator!=(const Item& o) const { return !operator==(o); }
+    };
+
+    // Render state + items used to create the cached image.
+    struct Key {
+      const doc::Sprite* sprite = nullptr;
+      doc::frame_t frame = 0;
+      doc::PixelFormat pixelFormat = doc::IMAGE_RGB;
+      doc::color_t bgColor = 0;
+      const doc::Palette* palette = nullptr;
+      doc::ObjectVersion paletteVersion = 0;
+      double scaleX = 1.0;
+      double scaleY = 1.0;
+      bool newBlend = true;
+      int flags = 0;
+      int nonactiveLayersOpacity = 255;
+      const doc::Layer* activeLayer = nullptr;
+      std::vector<Item> items;
+
+      // Onion skin behind the sprite (frames and the items of all
+      // those frames)
+      const doc::Layer* onionskinLayer = nullptr;
+      std::vector<OnionskinFrame> onionskinFrames;
+      std::vector<Item> onionskinItems;
+
+      bool operator==(const Key& o) const {
+        return (sprite == o.sprite &&
+                frame == o.frame &&
+                pixelFormat == o.pixelFormat &&
+                bgColor == o.bgColor &&
+                palette == o.palette &&
+                paletteVersion == o.paletteVersion &&
+                scaleX == o.scaleX &&
+                scaleY == o.scaleY &&
+                newBlend == o.newBlend &&
+                flags == o.flags &&
+                nonactiveLayersOpacity == o.nonactiveLayersOpacity &&
+                activeLayer == o.activeLayer &&
+                items == o.items &&
+                onionskinLayer == o.onionskinLayer &&
+                onionskinFrames == o.onionskinFrames &&
+                onionskinItems == o.onionskinItems);
+      }
+      bool operator!=(const Key& o) const { return !operator==(o); }
+    };
+
+    // Maximum number of pixels of the cached image (the cache is not
+    // used on bigger canvases/zoom levels).
+    static constexpr int kMaxPixels = 4096*4096;
+
+    bool isValid(const Key& key) const {
+      return (m_image && m_key == key);
+    }
+
+    const doc::ImageRef& image() const { return m_image; }
+    const Key& key() const { return m_key; }
+
+    void update(Key&& key, const doc::ImageRef& image) {
+      m_key = std::move(key);
+      m_image = image;
+    }
+
+    void invalidate() {
+      m_key = Key();
+      m_image.reset();
+    }
+
+  private:
+    Key m_key;
+    doc::ImageRef m_image;
+  };
+
+} // namespace render
+
+#endif
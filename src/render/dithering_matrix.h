@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2020 Igara Studio S.A.
+// Copyright (c) 2020-2024 Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -18,12 +18,15 @@ namespace render {
   public:
     DitheringMatrix()
       : m_rows(1), m_cols(1)
+      , m_rowMask(0), m_colMask(0)
       , m_matrix(1, 1)
       , m_maxValue(1) {
     }
 
     DitheringMatrix(int rows, int cols)
       : m_rows(rows), m_cols(cols)
+      , m_rowMask(powerOfTwoMask(rows))
+      , m_colMask(powerOfTwoMask(cols))
       , m_matrix(rows*cols, 0)
       , m_maxValue(1) {
     }
@@ -39,15 +42,35 @@ namespace render {
     }
 
     int operator()(int i, int j) const {
-      return m_matrix[(i%m_rows)*m_cols + (j%m_cols)];
+      return m_matrix[wrapRow(i)*m_cols + wrapCol(j)];
     }
 
     int& operator()(int i, int j) {
-      return m_matrix[(i%m_rows)*m_cols + (j%m_cols)];
+      return m_matrix[wrapRow(i)*m_cols + wrapCol(j)];
+    }
+
+    // Thresholds of the i-th row (use wrapCol() to get the index of
+    // each column), to avoid calculating the row offset in each pixel.
+    const int* row(int i) const {
+      return &m_matrix[wrapRow(i)*m_cols];
+    }
+
+    // Matrices with power of two sizes (like Bayer matrices) are
+    // tiled using a bit mask instead of a modulo.
+    int wrapRow(int i) const {
+      return (m_rowMask >= 0 ? (i & m_rowMask): (i % m_rows));
+    }
+    int wrapCol(int j) const {
+      return (m_colMask >= 0 ? (j & m_colMask): (j % m_cols));
     }
 
   private:
+    static int powerOfTwoMask(int n) {
+      return (n > 0 && (n & (n-1)) == 0 ? n-1: -1);
+    }
+
     int m_rows, m_cols;
+    int m_rowMask, m_colMask;   // -1 if the size isn't a power of two
     std::vector<int> m_matrix;
     int m_maxValue;
   };
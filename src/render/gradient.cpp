@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019-2020 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -11,11 +11,24 @@
 
 #include "render/gradient.h"
 
-#include "base/vector2d.h"
 #include "doc/image.h"
 #include "doc/image_impl.h"
 #include "render/dithering_matrix.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define RENDER_GRADIENT_SSE2 1
+#endif
+
 namespace render {
 
 void render_rgba_gradient(
@@ -38,6 +51,112 @@ void render_rgba_gradient(
   }
 }
 
+namespace {
+
+// Number of colors of a gradient ramp, i.e. the precision used to
+// quantize the position "f" (from 0.0 to 1.0) of each pixel in the
+// gradient.
+constexpr int kRampSize = 4096;
+constexpr int kRampMax = kRampSize-1;
+
+using Ramp = std::array<doc::color_t, kRampSize>;
+
+// As we use non-premultiplied RGB values, we need correct RGB values
+// on each stop. So in case that one color has alpha=0 (complete
+// transparent), use the RGB values of the non-transparent color in
+// the other stop point.
+void fix_transparent_stops(doc::color_t& c0, doc::color_t& c1)
+{
+  if (doc::rgba_geta(c0) == 0 &&
+      doc::rgba_geta(c1) != 0) {
+    c0 = (c1 & doc::rgba_rgb_mask);
+  }
+  else if (doc::rgba_geta(c0) != 0 &&
+           doc::rgba_geta(c1) == 0) {
+    c1 = (c0 & doc::rgba_rgb_mask);
+  }
+}
+
+void create_ramp(Ramp& ramp, const doc::color_t c0, const doc::color_t c1)
+{
+  const int r0 = doc::rgba_getr(c0), dr = doc::rgba_getr(c1) - r0;
+  const int g0 = doc::rgba_getg(c0), dg = doc::rgba_getg(c1) - g0;
+  const int b0 = doc::rgba_getb(c0), db = doc::rgba_getb(c1) - b0;
+  const int a0 = doc::rgba_geta(c0), da = doc::rgba_geta(c1) - a0;
+
+  // The numerators are always positive, so the integer division
+  // truncates each component like the old floating point version.
+  for (int i=0; i<kRampSize; ++i) {
+    ramp[i] = doc::rgba((r0*kRampMax + i*dr) / kRampMax,
+                        (g0*kRampMax + i*dg) / kRampMax,
+                        (b0*kRampMax + i*db) / kRampMax,
+                        (a0*kRampMax + i*da) / kRampMax);
+  }
+}
+
+// The last used ramps, so the gradient tool doesn't have to create
+// the same ramp again each time the mouse is moved.
+class RampCache {
+public:
+  static constexpr int kMaxRamps = 4;
+
+  std::shared_ptr<const Ramp> get(const doc::color_t c0,
+                                  const doc::color_t c1) {
+    const uint64_t key = (uint64_t(c0) << 32) | c1;
+
+    const std::lock_guard lock(m_mutex);
+    auto it = std::find_if(m_ramps.begin(), m_ramps.end(),
+                           [key](const auto& item){ return item.first == key; });
+    if (it != m_ramps.end()) {
+      // Move the ramp to the front (most recently used)
+      std::rotate(m_ramps.begin(), it, it+1);
+      return m_ramps.front().second;
+    }
+
+    auto ramp = std::make_shared<Ramp>();
+    create_ramp(*ramp, c0, c1);
+
+    if (m_ramps.size() == kMaxRamps)
+      m_ramps.pop_back();
+    m_ramps.insert(m_ramps.begin(), std::make_pair(key, ramp));
+    return ramp;
+  }
+
+private:
+  std::mutex m_mutex;
+  std::vector<std::pair<uint64_t, std::shared_ptr<const Ramp>>> m_ramps;
+};
+
+RampCache g_rampCache;
+
+// Calculates the distance "f" of each pixel of a row to the center
+// of a radial gradient, where cx is the center, ix the inverse of
+// the horizontal radius, and fy2 the squared vertical component.
+void radial_row(float* f, const int width,
+                const float x0, const float cx,
+                const float ix, const float fy2)
+{
+  int x = 0;
+#if RENDER_GRADIENT_SSE2
+  const __m128 vcx = _mm_set1_ps(cx);
+  const __m128 vix = _mm_set1_ps(ix);
+  const __m128 vfy2 = _mm_set1_ps(fy2);
+  const __m128 four = _mm_set1_ps(4.0f);
+  __m128 vx = _mm_setr_ps(x0, x0+1.0f, x0+2.0f, x0+3.0f);
+  for (; x+4<=width; x+=4) {
+    const __m128 q = _mm_mul_ps(_mm_sub_ps(vx, vcx), vix);
+    _mm_storeu_ps(f+x, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(q, q), vfy2)));
+    vx = _mm_add_ps(vx, four);
+  }
+#endif
+  for (; x<width; ++x) {
+    const float q = (x0 + float(x) - cx) * ix;
+    f[x] = std::sqrt(q*q + fy2);
+  }
+}
+
+} // anonymous namespace
+
 void render_rgba_linear_gradient(
   doc::Image* img,
   const gfx::Point imgPos,
@@ -59,73 +178,59 @@ void render_rgba_linear_gradient(
     return;
   }
 
-  base::Vector2d<double>
-    u(p0.x, p0.y),
-    v(p1.x, p1.y), w;
-  w = v - u;
-  const double wmag = w.magnitude();
-  w = w.normalize();
-
-  // As we use non-premultiplied RGB values, we need correct RGB
-  // values on each stop. So in case that one color has alpha=0
-  // (complete transparent), use the RGB values of the
-  // non-transparent color in the other stop point.
-  if (doc::rgba_geta(c0) == 0 &&
-      doc::rgba_geta(c1) != 0) {
-    c0 = (c1 & doc::rgba_rgb_mask);
-  }
-  else if (doc::rgba_geta(c0) != 0 &&
-           doc::rgba_geta(c1) == 0) {
-    c1 = (c0 & doc::rgba_rgb_mask);
-  }
-
-  const uint8_t r0 = doc::rgba_getr(c0);
-  const uint8_t g0 = doc::rgba_getg(c0);
-  const uint8_t b0 = doc::rgba_getb(c0);
-  const uint8_t a0 = doc::rgba_geta(c0);
-
-  const uint8_t r1 = doc::rgba_getr(c1);
-  const uint8_t g1 = doc::rgba_getg(c1);
-  const uint8_t b1 = doc::rgba_getb(c1);
-  const uint8_t a1 = doc::rgba_geta(c1);
+  fix_transparent_stops(c0, c1);
 
-  doc::LockImageBits<doc::RgbTraits> bits(img);
-  auto it = bits.begin();
+  // The position of each pixel in the gradient is f = n/d, where n
+  // is the dot product between (pixel - p0) and (p1 - p0), and d the
+  // squared length of (p1 - p0). As n is incremented by dx for each
+  // pixel of a row, we can evaluate the whole row with integers.
+  const int64_t dx = p1.x - p0.x;
+  const int64_t dy = p1.y - p0.y;
+  const int64_t d = dx*dx + dy*dy;
   const int width = img->width();
   const int height = img->height();
 
   if (matrix.rows() == 1 && matrix.cols() == 1) {
+    auto ramp = g_rampCache.get(c0, c1);
+    const doc::color_t* rampColors = ramp->data();
+
+    // Index of the ramp in 32.32 fixed point (|dx| <= d, so the
+    // step is less than kRampSize<<32).
+    const double scale = double(kRampMax) * 4294967296.0 / double(d);
+    const int64_t step = std::llround(double(dx) * scale);
+    const double kMaxIndex = double(int64_t(1) << 61);
+
     for (int y=0; y<height; ++y) {
-      for (int x=0; x<width; ++x, ++it) {
-        base::Vector2d<double> q(imgPos.x+x,
-                                 imgPos.y+y);
-        q -= u;
-        double f = (q * w) / wmag;
-
-        doc::color_t c;
-        if (f < 0.0) c = c0;
-        else if (f > 1.0) c = c1;
-        else {
-          c = doc::rgba(int(r0 + f*(r1-r0) + 1e-7),
-                        int(g0 + f*(g1-g0) + 1e-7),
-                        int(b0 + f*(b1-b0) + 1e-7),
-                        int(a0 + f*(a1-a0) + 1e-7));
-        }
-
-        *it = c;
-      }
+      const int64_t n0 =
+        (imgPos.x - p0.x)*dx + (imgPos.y+y - p0.y)*dy;
+      // Clamp the start of the row to avoid overflows (the result is
+      // clamped anyway, and a clamped value cannot change its sign
+      // adding "width" steps).
+      int64_t t = int64_t(std::clamp(double(n0) * scale, -kMaxIndex, kMaxIndex))
+        + (int64_t(1) << 31);     // Round to the nearest ramp index
+
+      auto dst = (doc::RgbTraits::address_t)img->getPixelAddress(0, y);
+      for (int x=0; x<width; ++x, ++dst, t+=step)
+        *dst = rampColors[std::clamp<int64_t>(t >> 32, 0, kRampMax)];
     }
   }
   else {
+    // f*(maxValue+2) < matrix(y, x)+1 is equal to
+    // n*(maxValue+2) < (matrix(y, x)+1)*d
+    const int64_t m = matrix.maxValue()+2;
+    std::vector<int64_t> thresholds(matrix.cols());
+
     for (int y=0; y<height; ++y) {
-      for (int x=0; x<width; ++x, ++it) {
-        base::Vector2d<double> q(imgPos.x+x,
-                                 imgPos.y+y);
-        q -= u;
-        double f = (q * w) / wmag;
-
-        *it = (f*(matrix.maxValue()+2) < matrix(y, x)+1 ? c0: c1);
-      }
+      const int* row = matrix.row(y);
+      for (int j=0; j<matrix.cols(); ++j)
+        thresholds[j] = int64_t(row[j]+1) * d;
+
+      int64_t n = ((imgPos.x - p0.x)*dx + (imgPos.y+y - p0.y)*dy) * m;
+      const int64_t step = dx * m;
+
+      auto dst = (doc::RgbTraits::address_t)img->getPixelAddress(0, y);
+      for (int x=0; x<width; ++x, ++dst, n+=step)
+        *dst = (n < thresholds[matrix.wrapCol(x)] ? c0: c1);
     }
   }
 }
@@ -144,83 +249,50 @@ void render_rgba_radial_gradient(
     return;
   }
 
-  base::Vector2d<double>
-    u(p0.x, p0.y),
-    v(p1.x, p1.y), w;
-  w = (v - u) / 2;
+  const double wx = std::fabs(p1.x - p0.x) / 2.0;
+  const double wy = std::fabs(p1.y - p0.y) / 2.0;
 
   // If there is no vector defining the gradient (just one point),
   // the "gradient" will be just a solid color ("c1")
-  if (std::fabs(w.x) <= 0.000001 ||
-      std::fabs(w.y) <= 0.000001) {
+  if (wx <= 0.000001 || wy <= 0.000001) {
     img->clear(c1);
     return;
   }
 
-  // As we use non-premultiplied RGB values, we need correct RGB
-  // values on each stop. So in case that one color has alpha=0
-  // (complete transparent), use the RGB values of the
-  // non-transparent color in the other stop point.
-  if (doc::rgba_geta(c0) == 0 &&
-      doc::rgba_geta(c1) != 0) {
-    c0 = (c1 & doc::rgba_rgb_mask);
-  }
-  else if (doc::rgba_geta(c0) != 0 &&
-           doc::rgba_geta(c1) == 0) {
-    c1 = (c0 & doc::rgba_rgb_mask);
-  }
-
-  const uint8_t r0 = doc::rgba_getr(c0);
-  const uint8_t g0 = doc::rgba_getg(c0);
-  const uint8_t b0 = doc::rgba_getb(c0);
-  const uint8_t a0 = doc::rgba_geta(c0);
+  fix_transparent_stops(c0, c1);
 
-  const uint8_t r1 = doc::rgba_getr(c1);
-  const uint8_t g1 = doc::rgba_getg(c1);
-  const uint8_t b1 = doc::rgba_getb(c1);
-  const uint8_t a1 = doc::rgba_geta(c1);
-
-  doc::LockImageBits<doc::RgbTraits> bits(img);
-  auto it = bits.begin();
+  const float cx = float((p0.x + p1.x) / 2.0);
+  const float cy = float((p0.y + p1.y) / 2.0);
+  const float ix = float(1.0 / wx);
+  const float iy = float(1.0 / wy);
   const int width = img->width();
   const int height = img->height();
+  std::vector<float> f(width);
 
   if (matrix.rows() == 1 && matrix.cols() == 1) {
+    auto ramp = g_rampCache.get(c0, c1);
+    const doc::color_t* rampColors = ramp->data();
+
     for (int y=0; y<height; ++y) {
-      for (int x=0; x<width; ++x, ++it) {
-        base::Vector2d<double> q(imgPos.x+x,
-                                 imgPos.y+y);
-        q -= (u+v)/2;
-        q.x /= std::fabs(w.x);
-        q.y /= std::fabs(w.y);
-        double f = std::sqrt(q.x*q.x + q.y*q.y);
-
-        doc::color_t c;
-        if (f < 0.0) c = c0;
-        else if (f > 1.0) c = c1;
-        else {
-          c = doc::rgba(int(r0 + f*(r1-r0) + 1e-7),
-                        int(g0 + f*(g1-g0) + 1e-7),
-                        int(b0 + f*(b1-b0) + 1e-7),
-                        int(a0 + f*(a1-a0) + 1e-7));
-        }
-
-        *it = c;
-      }
+      const float fy = (float(imgPos.y+y) - cy) * iy;
+      radial_row(f.data(), width, float(imgPos.x), cx, ix, fy*fy);
+
+      auto dst = (doc::RgbTraits::address_t)img->getPixelAddress(0, y);
+      for (int x=0; x<width; ++x, ++dst)
+        *dst = rampColors[int(std::min(f[x], 1.0f)*kRampMax + 0.5f)];
     }
   }
   else {
+    const float m = float(matrix.maxValue()+2);
+
     for (int y=0; y<height; ++y) {
-      for (int x=0; x<width; ++x, ++it) {
-        base::Vector2d<double> q(imgPos.x+x,
-                                 imgPos.y+y);
-        q -= (u+v)/2;
-        q.x /= std::fabs(w.x);
-        q.y /= std::fabs(w.y);
-        double f = std::sqrt(q.x*q.x + q.y*q.y);
-
-        *it = (f*(matrix.maxValue()+2) < matrix(y, x)+1 ? c0: c1);
-      }
+      const float fy = (float(imgPos.y+y) - cy) * iy;
+      radial_row(f.data(), width, float(imgPos.x), cx, ix, fy*fy);
+
+      const int* row = matrix.row(y);
+      auto dst = (doc::RgbTraits::address_t)img->getPixelAddress(0, y);
+      for (int x=0; x<width; ++x, ++dst)
+        *dst = (f[x]*m < row[matrix.wrapCol(x)]+1 ? c0: c1);
     }
   }
 }
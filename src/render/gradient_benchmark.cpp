@@ -0,0 +1,60 @@
+// Aseprite Render Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "render/gradient.h"
+
+#include "doc/image.h"
+#include "render/dithering_matrix.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+
+using namespace doc;
+using namespace render;
+
+// Renders a gradient in a square image as the gradient tool does
+// on each mouse movement (a 1x1 matrix means no dithering).
+static void BM_Gradient(benchmark::State& state,
+                        const GradientType type,
+                        const DitheringMatrix matrix)
+{
+  const int size = state.range(0);
+  std::unique_ptr<Image> img(Image::create(IMAGE_RGB, size, size));
+  const color_t c0 = rgba(255, 0, 0, 255);
+  const color_t c1 = rgba(0, 0, 255, 128);
+
+  int i = 0;
+  for (auto _ : state) {
+    const int d = (++i & 15);
+    render_rgba_gradient(img.get(), gfx::Point(0, 0),
+                         gfx::Point(size/4 + d, size/3),
+                         gfx::Point(3*size/4, 2*size/3 - d),
+                         c0, c1, matrix, type);
+  }
+}
+
+BENCHMARK_CAPTURE(BM_Gradient, linear, GradientType::Linear, DitheringMatrix())
+  ->Arg(256)->Arg(1024)->Arg(4096)
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(BM_Gradient, linear_bayer8, GradientType::Linear, BayerMatrix(8))
+  ->Arg(256)->Arg(1024)->Arg(4096)
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(BM_Gradient, radial, GradientType::Radial, DitheringMatrix())
+  ->Arg(256)->Arg(1024)->Arg(4096)
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(BM_Gradient, radial_bayer8, GradientType::Radial, BayerMatrix(8))
+  ->Arg(256)->Arg(1024)->Arg(4096)
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
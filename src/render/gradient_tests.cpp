@@ -0,0 +1,134 @@
+// Aseprite Render Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "render/gradient.h"
+
+#include "doc/image.h"
+#include "doc/image_ref.h"
+#include "doc/primitives.h"
+#include "render/dithering_matrix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace doc;
+using namespace render;
+
+static int channel_diff(color_t a, color_t b)
+{
+  return std::max({ std::abs(rgba_getr(a) - rgba_getr(b)),
+                    std::abs(rgba_getg(a) - rgba_getg(b)),
+                    std::abs(rgba_getb(a) - rgba_getb(b)),
+                    std::abs(rgba_geta(a) - rgba_geta(b)) });
+}
+
+TEST(Gradient, Linear)
+{
+  const color_t c0 = rgba(0, 255, 10, 255);
+  const color_t c1 = rgba(200, 0, 250, 100);
+  ImageRef img(Image::create(IMAGE_RGB, 64, 4));
+  render_rgba_linear_gradient(img.get(), gfx::Point(0, 0),
+                              gfx::Point(10, 0), gfx::Point(50, 0),
+                              c0, c1, DitheringMatrix());
+
+  for (int x=0; x<64; ++x) {
+    const double f = std::clamp((x - 10) / 40.0, 0.0, 1.0);
+    const color_t expected =
+      rgba(int(f*200), int(255 - f*255), int(10 + f*240), int(255 - f*155));
+    for (int y=0; y<4; ++y)
+      EXPECT_LE(channel_diff(expected, get_pixel(img.get(), x, y)), 1) << x;
+  }
+  EXPECT_EQ(c0, get_pixel(img.get(), 0, 0));
+  EXPECT_EQ(c0, get_pixel(img.get(), 10, 0));
+  EXPECT_EQ(c1, get_pixel(img.get(), 50, 0));
+  EXPECT_EQ(c1, get_pixel(img.get(), 63, 0));
+}
+
+TEST(Gradient, LinearWithImagePosition)
+{
+  ImageRef a(Image::create(IMAGE_RGB, 32, 32));
+  ImageRef b(Image::create(IMAGE_RGB, 16, 16));
+  const gfx::Point p0(3, 5), p1(27, 20);
+  const color_t c0 = rgba(255, 0, 0, 255);
+  const color_t c1 = rgba(0, 0, 255, 255);
+  render_rgba_linear_gradient(a.get(), gfx::Point(0, 0), p0, p1, c0, c1, DitheringMatrix());
+  render_rgba_linear_gradient(b.get(), gfx::Point(8, 12), p0, p1, c0, c1, DitheringMatrix());
+
+  for (int y=0; y<16; ++y)
+    for (int x=0; x<16; ++x)
+      EXPECT_EQ(get_pixel(a.get(), x+8, y+12), get_pixel(b.get(), x, y));
+}
+
+TEST(Gradient, LinearDithering)
+{
+  const color_t c0 = rgba(255, 0, 0, 255);
+  const color_t c1 = rgba(0, 0, 255, 255);
+  const BayerMatrix matrix(8);
+  ImageRef img(Image::create(IMAGE_RGB, 64, 8));
+  render_rgba_linear_gradient(img.get(), gfx::Point(0, 0),
+                              gfx::Point(0, 0), gfx::Point(63, 0),
+                              c0, c1, matrix);
+
+  // Same comparison of the original floating point version
+  for (int y=0; y<8; ++y) {
+    for (int x=0; x<64; ++x) {
+      const double f = x / 63.0;
+      EXPECT_EQ((f*(matrix.maxValue()+2) < matrix(y, x)+1 ? c0: c1),
+                get_pixel(img.get(), x, y)) << x << "," << y;
+    }
+  }
+}
+
+TEST(Gradient, Radial)
+{
+  const color_t c0 = rgba(255, 255, 255, 255);
+  const color_t c1 = rgba(0, 0, 0, 255);
+  ImageRef img(Image::create(IMAGE_RGB, 41, 21));
+  render_rgba_radial_gradient(img.get(), gfx::Point(0, 0),
+                              gfx::Point(0, 0), gfx::Point(40, 20),
+                              c0, c1, DitheringMatrix());
+
+  for (int y=0; y<21; ++y) {
+    for (int x=0; x<41; ++x) {
+      const double qx = (x - 20) / 20.0;
+      const double qy = (y - 10) / 10.0;
+      const double f = std::min(std::sqrt(qx*qx + qy*qy), 1.0);
+      const int v = int(255 - f*255);
+      EXPECT_LE(channel_diff(rgba(v, v, v, 255), get_pixel(img.get(), x, y)), 1)
+        << x << "," << y;
+    }
+  }
+  EXPECT_EQ(c0, get_pixel(img.get(), 20, 10));
+  EXPECT_EQ(c1, get_pixel(img.get(), 0, 0));
+}
+
+TEST(Gradient, DifferentStops)
+{
+  // Check that cached ramps of other colors are not reused
+  ImageRef img(Image::create(IMAGE_RGB, 8, 1));
+  for (int i=0; i<16; ++i) {
+    const color_t c0 = rgba(i*10, 0, 0, 255);
+    const color_t c1 = rgba(0, i*10, 0, 255);
+    render_rgba_linear_gradient(img.get(), gfx::Point(0, 0),
+                                gfx::Point(0, 0), gfx::Point(7, 0),
+                                c0, c1, DitheringMatrix());
+    EXPECT_EQ(c0, get_pixel(img.get(), 0, 0));
+    EXPECT_EQ(c1, get_pixel(img.get(), 7, 0));
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,138 @@
+// Aseprite Render Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "render/mipmap_cache.h"
+
+#include "doc/image.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace render {
+
+using namespace doc;
+
+namespace {
+
+// Creates an image with one of each "step" pixels of the given image
+// (in both axes).
+Image* create_reduced_image(const Image* src, const int step)
+{
+  const int w = src->width() / step;
+  const int h = src->height() / step;
+  const int bpp = src->bytesPerPixel();
+
+  Image* dst = Image::create(src->pixelFormat(), w, h);
+  dst->setMaskColor(src->maskColor());
+
+  for (int y=0; y<h; ++y) {
+    const uint8_t* srcPtr = src->getPixelAddress(0, y*step);
+    uint8_t* dstPtr = dst->getPixelAddress(0, y);
+    for (int x=0; x<w; ++x, srcPtr+=bpp*step, dstPtr+=bpp)
+      std::memcpy(dstPtr, srcPtr, bpp);
+  }
+  return dst;
+}
+
+} // anonymous namespace
+
+ImageRef MipmapCache::level(const Image* image, int& level)
+{
+  level = std::min(level, kMaxLevel);
+  while (level > 0 &&
+         ((image->width() >> level) == 0 ||
+          (image->height() >> level) == 0))
+    --level;
+
+  if (level <= 0 ||
+      image->width() * image->height() < kMinPixels) {
+    level = 0;
+    return nullptr;
+  }
+
+  ImageRef result;
+  bool grown = false;
+  {
+    const std::lock_guard lock(m_mutex);
+
+    Entry& entry = m_entries[image->id()];
+    entry.lastUse = ++m_useCounter;
+    if (entry.version != image->version()) {
+      for (const auto& img : entry.levels) {
+        if (img)
+          m_pixels -= img->width() * img->height();
+      }
+      entry.levels.clear();
+      entry.version = image->version();
+    }
+
+    if (int(entry.levels.size()) < level)
+      entry.levels.resize(level);
+
+    result = entry.levels[level-1];
+    if (!result) {
+      // Reduce the nearest level that we already have
+      int from = level-1;
+      while (from > 0 && !entry.levels[from-1])
+        --from;
+      const Image* src = (from > 0 ? entry.levels[from-1].get(): image);
+
+      result.reset(create_reduced_image(src, 1 << (level-from)));
+      entry.levels[level-1] = result;
+      m_pixels += result->width() * result->height();
+      shrink();
+      grown = true;
+    }
+  }
+
+  // Without the lock as this cache could be released
+  if (grown)
+    check_memory_soft_limit();
+  return result;
+}
+
+void MipmapCache::invalidate()
+{
+  const std::lock_guard lock(m_mutex);
+  m_entries.clear();
+  m_pixels = 0;
+}
+
+std::size_t MipmapCache::memoryBytes()
+{
+  const std::lock_guard lock(m_mutex);
+  std::size_t bytes = 0;
+  for (const auto& it : m_entries) {
+    for (const auto& img : it.second.levels) {
+      if (img)
+        bytes += img->getMemSize();
+    }
+  }
+  return bytes;
+}
+
+void MipmapCache::shrink()
+{
+  while (m_pixels > kMaxPixels && m_entries.size() > 1) {
+    auto lru = std::min_element(
+      m_entries.begin(), m_entries.end(),
+      [](const auto& a, const auto& b){
+        return a.second.lastUse < b.second.lastUse;
+      });
+
+    for (const auto& img : lru->second.levels) {
+      if (img)
+        m_pixels -= img->width() * img->height();
+    }
+    m_entries.erase(lru);
+  }
+}
+
+} // namespace render
@@ -0,0 +1,83 @@
+// Aseprite Render Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef RENDER_MIPMAP_CACHE_H_INCLUDED
+#define RENDER_MIPMAP_CACHE_H_INCLUDED
+#pragma once
+
+#include "doc/image_ref.h"
+#include "doc/memory_account.h"
+#include "doc/object_id.h"
+#include "doc/object_version.h"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace doc {
+  class Image;
+}
+
+namespace render {
+
+  // Reduced versions of big cel images used by render::Render when
+  // the projection is zoomed out by a power of two (1/2, 1/4, 1/8,
+  // etc.).
+  //
+  // The pixel (x, y) of the level N is the pixel (x*2^N, y*2^N) of
+  // the original image (its size is the original size / 2^N rounded
+  // down), so rendering the level N with a 2^N bigger scale gives
+  // exactly the same result of rendering the original image, but
+  // reading contiguous pixels instead of skipping 2^N-1 columns and
+  // rows for each composited pixel.
+  //
+  // Levels are created lazily and discarded when the image version
+  // changes. The cache can be shared between threads.
+  class MipmapCache {
+  public:
+    // Images with fewer pixels are not worth to be reduced.
+    static constexpr int kMinPixels = 256*256;
+
+    // Maximum number of pixels of all the levels in the cache (the
+    // least recently used images are discarded).
+    static constexpr int kMaxPixels = 4096*4096;
+
+    static constexpr int kMaxLevel = 8;
+
+    // Returns the given level of the image (or a lower one if the
+    // image is too small), and the used level in "level". Returns
+    // nullptr (and level=0) if the original image must be used.
+    doc::ImageRef level(const doc::Image* image, int& level);
+
+    void invalidate();
+
+    // Memory used by all the levels in the cache.
+    std::size_t memoryBytes();
+
+  private:
+    struct Entry {
+      doc::ObjectVersion version = 0;
+      std::vector<doc::ImageRef> levels; // levels[N-1] = level N
+      uint64_t lastUse = 0;
+    };
+
+    void shrink();
+
+    std::mutex m_mutex;
+    std::map<doc::ObjectId, Entry> m_entries;
+    int64_t m_pixels = 0;
+    uint64_t m_useCounter = 0;
+
+    doc::MemoryAccount m_memoryAccount{
+      doc::MemoryPool::RenderCache,
+      [this]{ return memoryBytes(); },
+      [this]{ invalidate(); } };
+  };
+
+} // namespace render
+
+#endif
@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2018  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -9,6 +9,8 @@
 #define RENDER_ONIONSKIN_OPTIONS_H_INCLUDED
 #pragma once
 
+#include "doc/blend_mode.h"
+#include "doc/frame.h"
 #include "render/onionskin_position.h"
 #include "render/onionskin_type.h"
 
@@ -61,6 +63,19 @@ namespace render {
     doc::Layer* m_layer;
   };
 
+  // One of the frames composited as onion skin for the current frame.
+  struct OnionskinFrame {
+    doc::frame_t frame = 0;
+    int opacity = 0;
+    doc::BlendMode blendMode = doc::BlendMode::UNSPECIFIED;
+
+    bool operator==(const OnionskinFrame& o) const {
+      return (frame == o.frame &&
+              opacity == o.opacity &&
+              blendMode == o.blendMode);
+    }
+  };
+
 } // namespace render
 
 #endif
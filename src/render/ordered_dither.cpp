@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019-2022  Igara Studio S.A.
+// Copyright (c) 2019-2024  Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -11,11 +11,14 @@
 
 #include "render/ordered_dither.h"
 
+#include "base/thread_pool.h"
 #include "render/dithering.h"
 #include "render/dithering_matrix.h"
 
 #include <algorithm>
 #include <limits>
+#include <memory>
+#include <thread>
 #include <vector>
 
 namespace render {
@@ -40,6 +43,18 @@ static int colorDistance(int r1, int g1, int b1, int a1,
   return result;
 }
 
+void DitheringAlgorithmBase::ditherRgbRowToIndex(
+  const DitheringMatrix& matrix,
+  const doc::RgbTraits::pixel_t* srcRow,
+  doc::IndexedTraits::pixel_t* dstRow,
+  const int x, const int y, const int w,
+  const doc::RgbMap* rgbmap,
+  const doc::Palette* palette)
+{
+  for (int u=x; u<x+w; ++u, ++srcRow, ++dstRow)
+    *dstRow = ditherRgbPixelToIndex(matrix, *srcRow, u, y, rgbmap, palette);
+}
+
 OrderedDither::OrderedDither(int transparentIndex)
   : m_transparentIndex(transparentIndex)
 {
@@ -52,6 +67,33 @@ doc::color_t OrderedDither::ditherRgbPixelToIndex(
   const int y,
   const doc::RgbMap* rgbmap,
   const doc::Palette* palette)
+{
+  return ditherColor(color, matrix(y, x), matrix.maxValue(),
+                     rgbmap, palette);
+}
+
+void OrderedDither::ditherRgbRowToIndex(
+  const DitheringMatrix& matrix,
+  const doc::RgbTraits::pixel_t* srcRow,
+  doc::IndexedTraits::pixel_t* dstRow,
+  const int x, const int y, const int w,
+  const doc::RgbMap* rgbmap,
+  const doc::Palette* palette)
+{
+  const int* thresholds = matrix.row(y);
+  const int maxValue = matrix.maxValue();
+  for (int u=x; u<x+w; ++u, ++srcRow, ++dstRow) {
+    *dstRow = ditherColor(*srcRow, thresholds[matrix.wrapCol(u)], maxValue,
+                          rgbmap, palette);
+  }
+}
+
+doc::color_t OrderedDither::ditherColor(
+  const doc::color_t color,
+  const int threshold,
+  const int maxValue,
+  const doc::RgbMap* rgbmap,
+  const doc::Palette* palette) const
 {
   // Alpha=0, output transparent color
   if (m_transparentIndex >= 0 &&
@@ -112,9 +154,7 @@ doc::color_t OrderedDither::ditherRgbPixelToIndex(
   // We convert the d/D factor to the matrix range to compare it
   // with the threshold. If d > threshold, it means that we're
   // closer to 'nearest2rgb' than to 'nearest1rgb'.
-  d = matrix.maxValue() * d / D;
-  int threshold = matrix(y, x);
-
+  d = maxValue * d / D;
   return (d > threshold ? nearest2idx:
                           nearest1idx);
 }
@@ -141,6 +181,33 @@ doc::color_t OrderedDither2::ditherRgbPixelToIndex(
   const int y,
   const doc::RgbMap* rgbmap,
   const doc::Palette* palette)
+{
+  return ditherColor(color, matrix(y, x), matrix.maxValue(),
+                     rgbmap, palette);
+}
+
+void OrderedDither2::ditherRgbRowToIndex(
+  const DitheringMatrix& matrix,
+  const doc::RgbTraits::pixel_t* srcRow,
+  doc::IndexedTraits::pixel_t* dstRow,
+  const int x, const int y, const int w,
+  const doc::RgbMap* rgbmap,
+  const doc::Palette* palette)
+{
+  const int* thresholds = matrix.row(y);
+  const int maxValue = matrix.maxValue();
+  for (int u=x; u<x+w; ++u, ++srcRow, ++dstRow) {
+    *dstRow = ditherColor(*srcRow, thresholds[matrix.wrapCol(u)], maxValue,
+                          rgbmap, palette);
+  }
+}
+
+doc::color_t OrderedDither2::ditherColor(
+  const doc::color_t color,
+  const int threshold,
+  const int maxValue,
+  const doc::RgbMap* rgbmap,
+  const doc::Palette* palette) const
 {
   // Alpha=0, output transparent color
   if (m_transparentIndex >= 0 &&
@@ -186,7 +253,7 @@ doc::color_t OrderedDither2::ditherRgbPixelToIndex(
     // maxMixValue, but this is too slow, so we try to figure out
     // a good mix factor using the RGB values of color0 and
     // color1.
-    int maxMixValue = matrix.maxValue();
+    const int maxMixValue = maxValue;
 
     int mix = 0;
     int div = 0;
@@ -221,12 +288,84 @@ doc::color_t OrderedDither2::ditherRgbPixelToIndex(
 
   // Using the bestMix factor the dithering matrix tells us if we
   // should paint with altIndex or index in this x,y position.
-  if (altIndex >= 0 && matrix(y, x) < bestMix)
+  if (altIndex >= 0 && threshold < bestMix)
     return altIndex;
   else
     return index;
 }
 
+// Minimum number of pixels to dither an image from several threads,
+// and minimum number of pixels dithered by each task.
+static constexpr int kMinPixelsForThreads = 256*256;
+static constexpr int kMinPixelsPerTask = 64*1024;
+
+// Dithers bands of rows of the image in parallel with an algorithm of
+// 1 dimension (where each pixel doesn't depend on other pixels). The
+// RgbMap implementations cache results lazily in mapColor() (they are
+// not thread-safe), so each thread uses its own RgbMap, regenerated
+// with the same palette, mask index and criteria (which gives the
+// same results). Returns false if the task was canceled.
+static bool dither_rgb_image_to_indexed_in_threads(
+  DitheringAlgorithmBase& algorithm,
+  const DitheringMatrix& matrix,
+  const doc::Image* srcImage,
+  doc::Image* dstImage,
+  const doc::RgbMap* rgbmap,
+  const doc::Palette* palette,
+  TaskDelegate* delegate,
+  const int threads)
+{
+  const int w = srcImage->width();
+  const int h = srcImage->height();
+  const int rowsPerTask = std::max(1, kMinPixelsPerTask / w);
+
+  std::vector<std::unique_ptr<doc::RgbMap>> rgbmaps(threads);
+  std::vector<const doc::RgbMap*> threadRgbmaps(threads, rgbmap);
+  if (rgbmap) {
+    for (int i=1; i<threads; ++i) {
+      rgbmaps[i] = doc::create_rgbmap(rgbmap->rgbmapAlgorithm());
+      if (!rgbmaps[i])
+        return false;
+
+      rgbmaps[i]->regenerateMap(rgbmap->palette(),
+                                rgbmap->maskIndex(),
+                                rgbmap->fitCriteria());
+      threadRgbmaps[i] = rgbmaps[i].get();
+    }
+  }
+
+  base::thread_pool pool(threads);
+  for (int y=0; y<h; ) {
+    for (int i=0; i<threads && y<h; ++i) {
+      const int y0 = y;
+      const int y1 = std::min(h, y+rowsPerTask);
+      y = y1;
+
+      const doc::RgbMap* threadRgbmap = threadRgbmaps[i];
+      pool.execute([&algorithm, &matrix, srcImage, dstImage,
+                    threadRgbmap, palette, w, y0, y1]{
+        for (int v=y0; v<y1; ++v) {
+          algorithm.ditherRgbRowToIndex(
+            matrix,
+            doc::get_pixel_address_fast<doc::RgbTraits>(srcImage, 0, v),
+            doc::get_pixel_address_fast<doc::IndexedTraits>(dstImage, 0, v),
+            0, v, w, threadRgbmap, palette);
+        }
+      });
+    }
+    pool.wait_all();
+
+    if (delegate) {
+      if (!delegate->continueTask())
+        return false;
+
+      delegate->notifyTaskProgress(
+        double(y) / double(h));
+    }
+  }
+  return true;
+}
+
 void dither_rgb_image_to_indexed(
   DitheringAlgorithmBase& algorithm,
   const Dithering& dithering,
@@ -241,26 +380,36 @@ void dither_rgb_image_to_indexed(
 
   algorithm.start(srcImage, dstImage, dithering.factor());
 
-  if (algorithm.dimensions() == 1) {
-    const doc::LockImageBits<doc::RgbTraits> srcBits(srcImage);
-    doc::LockImageBits<doc::IndexedTraits> dstBits(dstImage);
-    auto srcIt = srcBits.begin();
-    auto dstIt = dstBits.begin();
+  // Dithering::matrix() returns a copy of the matrix
+  const DitheringMatrix matrix = dithering.matrix();
 
+  const int threads =
+    (algorithm.dimensions() == 1 && w*h >= kMinPixelsForThreads ?
+     std::clamp<int>(std::thread::hardware_concurrency(), 1,
+                     h / std::max(1, kMinPixelsPerTask / w)): 1);
+
+  if (threads > 1) {
+    if (!dither_rgb_image_to_indexed_in_threads(
+          algorithm, matrix, srcImage, dstImage,
+          rgbmap, palette, delegate, threads))
+      return;
+  }
+  // TODO The error diffusion uses a serpentine scan (odd rows go
+  //      from right-to-left), so each row needs the whole previous
+  //      row finished and it cannot be processed in a wavefront
+  //      without changing the output.
+  else if (algorithm.dimensions() == 1) {
     for (int y=0; y<h; ++y) {
-      for (int x=0; x<w; ++x, ++srcIt, ++dstIt) {
-        ASSERT(srcIt != srcBits.end());
-        ASSERT(dstIt != dstBits.end());
-        *dstIt = algorithm.ditherRgbPixelToIndex(
-          dithering.matrix(), *srcIt, x, y, rgbmap, palette);
-
-        if (delegate) {
-          if (!delegate->continueTask())
-            return;
-        }
-      }
+      algorithm.ditherRgbRowToIndex(
+        matrix,
+        doc::get_pixel_address_fast<doc::RgbTraits>(srcImage, 0, y),
+        doc::get_pixel_address_fast<doc::IndexedTraits>(dstImage, 0, y),
+        0, y, w, rgbmap, palette);
 
       if (delegate) {
+        if (!delegate->continueTask())
+          return;
+
         delegate->notifyTaskProgress(
           double(y+1) / double(h));
       }
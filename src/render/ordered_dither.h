@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -43,6 +43,18 @@ namespace render {
       const doc::RgbMap* rgbmap,
       const doc::Palette* palette) { return 0; }
 
+    // Dithers the "w" pixels of the row "y" starting from column
+    // "x". The default implementation calls ditherRgbPixelToIndex()
+    // for each pixel, algorithms can override it to avoid a virtual
+    // call and the threshold lookup per pixel.
+    virtual void ditherRgbRowToIndex(
+      const DitheringMatrix& matrix,
+      const doc::RgbTraits::pixel_t* srcRow,
+      doc::IndexedTraits::pixel_t* dstRow,
+      const int x, const int y, const int w,
+      const doc::RgbMap* rgbmap,
+      const doc::Palette* palette);
+
     virtual doc::color_t ditherRgbToIndex2D(
       const int x, const int y,
       const doc::RgbMap* rgbmap,
@@ -59,7 +71,21 @@ namespace render {
       const int y,
       const doc::RgbMap* rgbmap,
       const doc::Palette* palette) override;
+    void ditherRgbRowToIndex(
+      const DitheringMatrix& matrix,
+      const doc::RgbTraits::pixel_t* srcRow,
+      doc::IndexedTraits::pixel_t* dstRow,
+      const int x, const int y, const int w,
+      const doc::RgbMap* rgbmap,
+      const doc::Palette* palette) override;
   private:
+    doc::color_t ditherColor(
+      const doc::color_t color,
+      const int threshold,
+      const int maxValue,
+      const doc::RgbMap* rgbmap,
+      const doc::Palette* palette) const;
+
     int m_transparentIndex;
   };
 
@@ -73,7 +99,21 @@ namespace render {
       const int y,
       const doc::RgbMap* rgbmap,
       const doc::Palette* palette) override;
+    void ditherRgbRowToIndex(
+      const DitheringMatrix& matrix,
+      const doc::RgbTraits::pixel_t* srcRow,
+      doc::IndexedTraits::pixel_t* dstRow,
+      const int x, const int y, const int w,
+      const doc::RgbMap* rgbmap,
+      const doc::Palette* palette) override;
   private:
+    doc::color_t ditherColor(
+      const doc::color_t color,
+      const int threshold,
+      const int maxValue,
+      const doc::RgbMap* rgbmap,
+      const doc::Palette* palette) const;
+
     int m_transparentIndex;
   };
 
@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -11,9 +11,15 @@
 
 #include <gtest/gtest.h>
 
+#include "doc/image_ref.h"
+#include "doc/octree_map.h"
+#include "doc/palette.h"
+#include "render/dithering.h"
 #include "render/dithering_matrix.h"
 #include "render/ordered_dither.h"
 
+#include <cstdlib>
+
 using namespace doc;
 using namespace render;
 
@@ -65,8 +71,104 @@ TEST(BayerMatrix, CheckD8)
       EXPECT_EQ(expected[c++], matrix(i, j));
 }
 
+TEST(DitheringMatrix, WrapCoordinates)
+{
+  // Power of two sizes use a mask, other sizes a modulo
+  BayerMatrix bayer(4);
+  DitheringMatrix odd(3, 5);
+  for (int i=0; i<3; ++i)
+    for (int j=0; j<5; ++j)
+      odd(i, j) = i*5 + j;
+
+  for (int i=0; i<20; ++i) {
+    for (int j=0; j<20; ++j) {
+      EXPECT_EQ(bayer(i % 4, j % 4), bayer(i, j));
+      EXPECT_EQ(bayer(i, j), bayer.row(i)[bayer.wrapCol(j)]);
+      EXPECT_EQ((i % 3)*5 + (j % 5), odd(i, j));
+      EXPECT_EQ(odd(i, j), odd.row(i)[odd.wrapCol(j)]);
+    }
+  }
+}
+
+TEST(OrderedDither, RowLikePixels)
+{
+  std::srand(2);
+  Palette pal(0, 16);
+  for (int i=0; i<pal.size(); ++i)
+    pal.setEntry(i, rgba(std::rand() & 255, std::rand() & 255,
+                         std::rand() & 255, std::rand() & 255));
+
+  DitheringMatrix odd(3, 5);
+  for (int i=0; i<3; ++i)
+    for (int j=0; j<5; ++j)
+      odd(i, j) = std::rand() % 15;
+  odd.calcMaxValue();
+
+  color_t src[37];
+  uint8_t dst[37];
+  for (color_t& c : src)
+    c = rgba(std::rand() & 255, std::rand() & 255,
+             std::rand() & 255, std::rand() & 255);
+
+  OrderedDither dither1(0);
+  OrderedDither2 dither2(0);
+  for (DitheringAlgorithmBase* algorithm : { (DitheringAlgorithmBase*)&dither1,
+                                             (DitheringAlgorithmBase*)&dither2 }) {
+    for (const DitheringMatrix& matrix : { (DitheringMatrix)BayerMatrix(8), odd }) {
+      for (int y=0; y<10; ++y) {
+        algorithm->ditherRgbRowToIndex(matrix, src, dst, 3, y, 37,
+                                       nullptr, &pal);
+        for (int x=0; x<37; ++x)
+          ASSERT_EQ(algorithm->ditherRgbPixelToIndex(
+                      matrix, src[x], x+3, y, nullptr, &pal),
+                    dst[x]);
+      }
+    }
+  }
+}
+
+// Big images are dithered from several threads, the result must be
+// the same as dithering each pixel in order.
+TEST(OrderedDither, SameResultInBigImages)
+{
+  std::srand(1);
+  Palette pal(0, 32);
+  for (int i=0; i<pal.size(); ++i)
+    pal.setEntry(i, rgba(std::rand() & 255, std::rand() & 255,
+                         std::rand() & 255, 255));
+
+  ImageRef src(Image::create(IMAGE_RGB, 513, 301));
+  for (int y=0; y<src->height(); ++y)
+    for (int x=0; x<src->width(); ++x)
+      src->putPixel(x, y, rgba(x & 255, y & 255, (x+y) & 255, 255));
+
+  const Dithering dithering(DitheringAlgorithm::Ordered, BayerMatrix(8));
+  const DitheringMatrix matrix = dithering.matrix();
+
+  OrderedDither dither1;
+  OrderedDither2 dither2;
+  for (DitheringAlgorithmBase* algorithm : { (DitheringAlgorithmBase*)&dither1,
+                                             (DitheringAlgorithmBase*)&dither2 }) {
+    OctreeMap rgbmap;
+    rgbmap.regenerateMap(&pal, -1, FitCriteria::DEFAULT);
+
+    ImageRef dst(Image::create(IMAGE_INDEXED, src->width(), src->height()));
+    dither_rgb_image_to_indexed(*algorithm, dithering,
+                                src.get(), dst.get(), &rgbmap, &pal);
+
+    OctreeMap rgbmap2;
+    rgbmap2.regenerateMap(&pal, -1, FitCriteria::DEFAULT);
+    for (int y=0; y<src->height(); ++y)
+      for (int x=0; x<src->width(); ++x)
+        ASSERT_EQ(algorithm->ditherRgbPixelToIndex(
+                    matrix, src->getPixel(x, y), x, y, &rgbmap2, &pal),
+                  dst->getPixel(x, y));
+  }
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
+  doc::Palette::initBestfit();
   return RUN_ALL_TESTS();
 }
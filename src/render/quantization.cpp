@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019-2022  Igara Studio S.A.
+// Copyright (c) 2019-2024  Igara Studio S.A.
 // Copyright (c) 2001-2018  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -11,6 +11,9 @@
 
 #include "render/quantization.h"
 
+#include "base/thread_pool.h"
+#include "doc/cel.h"
+#include "doc/image_buffer_pool.h"
 #include "doc/image_impl.h"
 #include "doc/layer.h"
 #include "doc/octree_map.h"
@@ -28,6 +31,7 @@
 #include <limits>
 #include <map>
 #include <memory>
+#include <thread>
 #include <vector>
 
 namespace render {
@@ -35,6 +39,265 @@ namespace render {
 using namespace doc;
 using namespace gfx;
 
+// Each thread has its own histogram (~8MB) or octree, so we limit
+// the number of threads used to feed the palette generators.
+static constexpr int kMaxHistogramThreads = 8;
+
+// Minimum number of pixels rendered by each task, so the time to
+// merge a histogram is small compared with the time to fill it.
+static constexpr int kMinPixelsPerHistogramTask = 1 << 21;
+
+// Returns the layers that can be read directly to feed the palette
+// generators (instead of rendering each frame), or an empty list if
+// the sprite needs to be rendered. All visible layers must be image
+// layers in the root using the Normal blend mode without opacity.
+static LayerList get_layers_to_feed_with_cels(const Sprite* sprite)
+{
+  if (sprite->pixelFormat() != IMAGE_RGB)
+    return LayerList();
+
+  LayerList layers = sprite->allVisibleLayers();
+  for (const Layer* layer : layers) {
+    if (!layer->isImage() ||
+        layer->isTilemap() ||
+        layer->isReference() ||
+        layer->parent() != sprite->root())
+      return LayerList();
+
+    auto imageLayer = static_cast<const LayerImage*>(layer);
+    if (imageLayer->blendMode() != BlendMode::NORMAL ||
+        imageLayer->opacity() < 255)
+      return LayerList();
+  }
+  return layers;
+}
+
+// Returns an image with the pixels of the given frame. If the frame
+// has only one cel (from "celLayers", without opacity, inside the
+// sprite bounds) we use the cel image directly, as the palette
+// generators ignore transparent pixels (the area outside the cel).
+// In other case the frame is rendered in "renderImage".
+static const Image* get_frame_image(const Sprite* sprite,
+                                    const frame_t frame,
+                                    const LayerList& celLayers,
+                                    render::Render& render,
+                                    Image* renderImage)
+{
+  if (!celLayers.empty()) {
+    const Cel* uniqueCel = nullptr;
+    for (const Layer* layer : celLayers) {
+      if (const Cel* cel = layer->cel(frame)) {
+        if (uniqueCel) {
+          uniqueCel = nullptr;
+          break;
+        }
+        uniqueCel = cel;
+      }
+    }
+
+    if (uniqueCel &&
+        uniqueCel->opacity() == 255 &&
+        uniqueCel->image()->pixelFormat() == IMAGE_RGB &&
+        sprite->bounds().contains(uniqueCel->bounds()))
+      return uniqueCel->image();
+  }
+
+  render.renderSprite(renderImage, sprite, frame);
+  return renderImage;
+}
+
+// Copies one of each "step" pixels of one of each "step" rows of
+// "src" to "dst" (which is re-created using the given "buffer").
+static const Image* sample_image(const Image* src,
+                                 const int step,
+                                 const ImageBufferPtr& buffer,
+                                 ImageRef& dst)
+{
+  const int w = (src->width() + step - 1) / step;
+  const int h = (src->height() + step - 1) / step;
+  dst.reset(Image::create(IMAGE_RGB, w, h, buffer));
+
+  for (int y=0; y<h; ++y) {
+    auto s = (RgbTraits::const_address_t)src->getPixelAddress(0, y*step);
+    auto d = (RgbTraits::address_t)dst->getPixelAddress(0, y);
+    for (int x=0; x<w; ++x, ++d, s+=step)
+      *d = *s;
+  }
+  return dst.get();
+}
+
+// Renders the given range of frames and feeds them to the palette
+// generator. With only one thread each frame is given to feedImage(),
+// in other case each worker renders a consecutive range of frames and
+// feeds its own "Partial" generator with feedPartial(). After each
+// round, the partial generators are given to mergePartial() in frame
+// order (so the result is the same as feeding the frames in only one
+// thread), which must merge and clear them. Returns false if the task
+// was canceled.
+//
+// Frames with just one cel are not rendered (see get_frame_image()),
+// and "sampling" can be used to feed only some frames/pixels.
+template<typename Partial,
+         typename FeedImage,
+         typename FeedPartial,
+         typename MergePartial>
+static bool feed_with_frames(
+  const Sprite* sprite,
+  const frame_t fromFrame,
+  const frame_t toFrame,
+  const bool newBlend,
+  TaskDelegate* delegate,
+  const PaletteSampling& sampling,
+  FeedImage feedImage,
+  FeedPartial feedPartial,
+  MergePartial mergePartial)
+{
+  const int frameStep = std::max(1, sampling.frameStep);
+  const int pixelStep = std::max(1, sampling.pixelStep);
+
+  std::vector<frame_t> frames;
+  for (frame_t frame=fromFrame; frame<=toFrame; frame+=frameStep)
+    frames.push_back(frame);
+  if (frames.empty())
+    return true;
+
+  const LayerList celLayers = get_layers_to_feed_with_cels(sprite);
+  const int nframes = int(frames.size());
+  const int pixels = std::max(1, sprite->width() * sprite->height() / (pixelStep*pixelStep));
+  const int framesPerTask = std::clamp(kMinPixelsPerHistogramTask / pixels, 1, nframes);
+  const int threads = std::clamp<int>(
+    std::min<int>(std::thread::hardware_concurrency(), kMaxHistogramThreads),
+    1, (nframes + framesPerTask - 1) / framesPerTask);
+
+  struct Worker {
+    render::Render render;
+    ImageRef image;
+    ImageBufferPtr sampleBuffer;
+    ImageRef sample;
+    Partial partial;
+
+    const Image* frameImage(const Sprite* sprite,
+                            const frame_t frame,
+                            const LayerList& celLayers,
+                            const int pixelStep) {
+      const Image* result =
+        get_frame_image(sprite, frame, celLayers, render, image.get());
+      if (pixelStep > 1)
+        result = sample_image(result, pixelStep, sampleBuffer, sample);
+      return result;
+    }
+  };
+  std::vector<std::unique_ptr<Worker>> workers(threads);
+  for (auto& worker : workers) {
+    worker = std::make_unique<Worker>();
+    worker->render.setNewBlend(newBlend);
+    worker->image.reset(Image::create(IMAGE_RGB, sprite->width(), sprite->height()));
+    worker->sampleBuffer = ImageBufferPool::instance()->get();
+  }
+
+  if (threads == 1) {
+    Worker* worker = workers[0].get();
+    for (int i=0; i<nframes; ++i) {
+      feedImage(worker->frameImage(sprite, frames[i], celLayers, pixelStep));
+
+      if (delegate) {
+        if (!delegate->continueTask())
+          return false;
+
+        delegate->notifyTaskProgress(
+          double(i+1) / double(nframes));
+      }
+    }
+    return true;
+  }
+
+  base::thread_pool pool(threads);
+  for (int i=0; i<nframes; ) {
+    int used = 0;
+    for (; used<threads && i<nframes; ++used) {
+      const int first = i;
+      const int last = std::min(nframes-1, i+framesPerTask-1);
+      i = last+1;
+
+      Worker* worker = workers[used].get();
+      pool.execute([worker, sprite, first, last, pixelStep,
+                    &frames, &celLayers, &feedPartial]{
+        for (int j=first; j<=last; ++j) {
+          feedPartial(worker->partial,
+                      worker->frameImage(sprite, frames[j], celLayers, pixelStep));
+        }
+      });
+    }
+    pool.wait_all();
+
+    for (int j=0; j<used; ++j)
+      mergePartial(workers[j]->partial);
+
+    if (delegate) {
+      if (!delegate->continueTask())
+        return false;
+
+      delegate->notifyTaskProgress(
+        double(i) / double(nframes));
+    }
+  }
+  return true;
+}
+
+// Each round feeds less than 2^32 pixels to each worker (a frame has
+// less than 2^32 pixels), so the 32-bit counters of the partial
+// histograms cannot overflow.
+static bool feed_optimizer_with_frames(
+  PaletteOptimizer& optimizer,
+  const Sprite* sprite,
+  const frame_t fromFrame,
+  const frame_t toFrame,
+  const bool withAlpha,
+  const bool newBlend,
+  TaskDelegate* delegate,
+  const PaletteSampling& sampling)
+{
+  using Partial = PaletteOptimizer::PartialHistogram;
+  return feed_with_frames<Partial>(
+    sprite, fromFrame, toFrame, newBlend, delegate, sampling,
+    [&optimizer, withAlpha](const Image* image){
+      optimizer.feedWithImage(image, withAlpha);
+    },
+    [withAlpha](Partial& histogram, const Image* image){
+      PaletteOptimizer::feedHistogramWithImage(histogram, image, withAlpha);
+    },
+    [&optimizer, withAlpha](Partial& histogram){
+      optimizer.merge(histogram, withAlpha);
+      histogram.clear();
+    });
+}
+
+static bool feed_octree_with_frames(
+  OctreeMap& octreemap,
+  const Sprite* sprite,
+  const frame_t fromFrame,
+  const frame_t toFrame,
+  const bool withAlpha,
+  const color_t maskColor,
+  const int levelDeep,
+  const bool newBlend,
+  TaskDelegate* delegate,
+  const PaletteSampling& sampling)
+{
+  return feed_with_frames<OctreeMap>(
+    sprite, fromFrame, toFrame, newBlend, delegate, sampling,
+    [&](const Image* image){
+      octreemap.feedWithImage(image, withAlpha, maskColor, levelDeep);
+    },
+    [&](OctreeMap& partial, const Image* image){
+      partial.feedWithImage(image, withAlpha, maskColor, levelDeep);
+    },
+    [&octreemap](OctreeMap& partial){
+      octreemap.merge(partial);
+      partial = OctreeMap();
+    });
+}
+
 Palette* create_palette_from_sprite(
   const Sprite* sprite,
   const frame_t fromFrame,
@@ -44,9 +307,13 @@ Palette* create_palette_from_sprite(
   TaskDelegate* delegate,
   const bool newBlend,
   RgbMapAlgorithm mapAlgo,
-  const bool calculateWithTransparent)
+  const bool calculateWithTransparent,
+  const PaletteSampling& sampling)
 {
-   if (mapAlgo == doc::RgbMapAlgorithm::DEFAULT)
+   // The k-d tree is only used to map colors, the palette is
+   // created with the octree as in the default case.
+   if (mapAlgo == doc::RgbMapAlgorithm::DEFAULT ||
+       mapAlgo == doc::RgbMapAlgorithm::KDTREE)
      mapAlgo = doc::RgbMapAlgorithm::OCTREE;
 
   PaletteOptimizer optimizer;
@@ -73,36 +340,22 @@ Palette* create_palette_from_sprite(
   if (!palette)
     palette = new Palette(fromFrame, 256);
 
-  // Add a flat image with the current sprite's frame rendered
-  ImageRef flat_image(Image::create(IMAGE_RGB,
-      sprite->width(), sprite->height()));
-
-  render::Render render;
-  render.setNewBlend(newBlend);
-
   // Feed the optimizer with all rendered frames
-  for (frame_t frame=fromFrame; frame<=toFrame; ++frame) {
-    render.renderSprite(flat_image.get(), sprite, frame);
-
-    switch (mapAlgo) {
-      case RgbMapAlgorithm::RGB5A3:
-        optimizer.feedWithImage(flat_image.get(), withAlpha);
-        break;
-      case RgbMapAlgorithm::OCTREE:
-        octreemap.feedWithImage(flat_image.get(), withAlpha, maskColor);
-        break;
-      default:
-        ASSERT(false);
-        break;
-    }
-
-    if (delegate) {
-      if (!delegate->continueTask())
+  switch (mapAlgo) {
+    case RgbMapAlgorithm::RGB5A3:
+      if (!feed_optimizer_with_frames(optimizer, sprite, fromFrame, toFrame,
+                                      withAlpha, newBlend, delegate, sampling))
         return nullptr;
-
-      delegate->notifyTaskProgress(
-        double(frame-fromFrame+1) / double(toFrame-fromFrame+1));
-    }
+      break;
+    case RgbMapAlgorithm::OCTREE:
+      if (!feed_octree_with_frames(octreemap, sprite, fromFrame, toFrame,
+                                   withAlpha, maskColor, 7, newBlend, delegate,
+                                   sampling))
+        return nullptr;
+      break;
+    default:
+      ASSERT(false);
+      break;
   }
 
   switch (mapAlgo) {
@@ -120,17 +373,10 @@ Palette* create_palette_from_sprite(
         // We can use an 8-bit deep octree map, instead of 7-bit of the
         // first attempt.
         octreemap = OctreeMap();
-        for (frame_t frame=fromFrame; frame<=toFrame; ++frame) {
-          render.renderSprite(flat_image.get(), sprite, frame);
-          octreemap.feedWithImage(flat_image.get(), withAlpha, maskColor , 8);
-          if (delegate) {
-            if (!delegate->continueTask())
-              return nullptr;
-
-            delegate->notifyTaskProgress(
-              double(frame-fromFrame+1) / double(toFrame-fromFrame+1));
-          }
-        }
+        if (!feed_octree_with_frames(octreemap, sprite, fromFrame, toFrame,
+                                     withAlpha, maskColor, 8, newBlend, delegate,
+                                     sampling))
+          return nullptr;
         octreemap.makePalette(palette, palette->size(), 8);
       }
       break;
@@ -189,15 +435,9 @@ Image* convert_pixel_format(
       toGray = &rgba_to_graya_using_luma;
   }
 
-  color_t c;
-  int r, g, b, a;
-
   switch (image->pixelFormat()) {
 
     case IMAGE_RGB: {
-      const LockImageBits<RgbTraits> srcBits(image);
-      auto src_it = srcBits.begin(), src_end = srcBits.end();
-
       switch (new_image->pixelFormat()) {
 
         // RGB -> RGB
@@ -207,45 +447,30 @@ Image* convert_pixel_format(
 
         // RGB -> Grayscale
         case IMAGE_GRAYSCALE: {
-          LockImageBits<GrayscaleTraits> dstBits(new_image, Image::WriteLock);
-          auto dst_it = dstBits.begin();
-#ifdef _DEBUG
-          auto dst_end = dstBits.end();
           ASSERT(toGray);
-#endif
-          for (; src_it != src_end; ++src_it, ++dst_it) {
-            ASSERT(dst_it != dst_end);
-            *dst_it = (*toGray)(*src_it);
-          }
-          ASSERT(dst_it == dst_end);
+          transform_image<RgbTraits, GrayscaleTraits>(
+            image, new_image,
+            [toGray](const color_t c) -> color_t {
+              return (*toGray)(c);
+            });
           break;
         }
 
         // RGB -> Indexed
         case IMAGE_INDEXED: {
-          LockImageBits<IndexedTraits> dstBits(new_image, Image::WriteLock);
-          auto dst_it = dstBits.begin();
-#ifdef _DEBUG
-          auto dst_end = dstBits.end();
-#endif
-
-          for (; src_it != src_end; ++src_it, ++dst_it) {
-            ASSERT(dst_it != dst_end);
-            c = *src_it;
-
-            r = rgba_getr(c);
-            g = rgba_getg(c);
-            b = rgba_getb(c);
-            a = rgba_geta(c);
-
-            if (a == 0)
-              *dst_it = new_mask_color0;
-            else if (rgbmap)
-              *dst_it = rgbmap->mapColor(c);
-            else
-              *dst_it = palette->findBestfit(r, g, b, a, new_mask_color);
-          }
-          ASSERT(dst_it == dst_end);
+          transform_image<RgbTraits, IndexedTraits>(
+            image, new_image,
+            [=](const color_t c) -> color_t {
+              const int a = rgba_geta(c);
+              if (a == 0)
+                return new_mask_color0;
+              else if (rgbmap)
+                return rgbmap->mapColor(c);
+              else
+                return palette->findBestfit(rgba_getr(c),
+                                            rgba_getg(c),
+                                            rgba_getb(c), a, new_mask_color);
+            });
           break;
         }
       }
@@ -253,27 +478,16 @@ Image* convert_pixel_format(
     }
 
     case IMAGE_GRAYSCALE: {
-      const LockImageBits<GrayscaleTraits> srcBits(image);
-      auto src_it = srcBits.begin(), src_end = srcBits.end();
-
       switch (new_image->pixelFormat()) {
 
         // Grayscale -> RGB
         case IMAGE_RGB: {
-          LockImageBits<RgbTraits> dstBits(new_image, Image::WriteLock);
-          auto dst_it = dstBits.begin();
-#ifdef _DEBUG
-          auto dst_end = dstBits.end();
-#endif
-          for (; src_it != src_end; ++src_it, ++dst_it) {
-            ASSERT(dst_it != dst_end);
-            c = *src_it;
-
-            g = graya_getv(c);
-
-            *dst_it = rgba(g, g, g, graya_geta(c));
-          }
-          ASSERT(dst_it == dst_end);
+          transform_image<GrayscaleTraits, RgbTraits>(
+            image, new_image,
+            [](const color_t c) -> color_t {
+              const int g = graya_getv(c);
+              return rgba(g, g, g, graya_geta(c));
+            });
           break;
         }
 
@@ -284,25 +498,18 @@ Image* convert_pixel_format(
 
         // Grayscale -> Indexed
         case IMAGE_INDEXED: {
-          LockImageBits<IndexedTraits> dstBits(new_image, Image::WriteLock);
-          auto dst_it = dstBits.begin();
-#ifdef _DEBUG
-          auto dst_end = dstBits.end();
-#endif
-          for (; src_it != src_end; ++src_it, ++dst_it) {
-            ASSERT(dst_it != dst_end);
-            c = *src_it;
-            a = graya_geta(c);
-            c = graya_getv(c);
-
-            if (a == 0)
-              *dst_it = new_mask_color0;
-            else if (rgbmap)
-              *dst_it = rgbmap->mapColor(c, c, c, a);
-            else
-              *dst_it = palette->findBestfit(c, c, c, a, new_mask_color);
-          }
-          ASSERT(dst_it == dst_end);
+          transform_image<GrayscaleTraits, IndexedTraits>(
+            image, new_image,
+            [=](const color_t c) -> color_t {
+              const int a = graya_geta(c);
+              const int v = graya_getv(c);
+              if (a == 0)
+                return new_mask_color0;
+              else if (rgbmap)
+                return rgbmap->mapColor(v, v, v, a);
+              else
+                return palette->findBestfit(v, v, v, a, new_mask_color);
+            });
           break;
         }
       }
@@ -310,86 +517,59 @@ Image* convert_pixel_format(
     }
 
     case IMAGE_INDEXED: {
-      const LockImageBits<IndexedTraits> srcBits(image);
-      auto src_it = srcBits.begin(), src_end = srcBits.end();
+      const color_t maskColor = image->maskColor();
 
       switch (new_image->pixelFormat()) {
 
         // Indexed -> RGB
         case IMAGE_RGB: {
-          LockImageBits<RgbTraits> dstBits(new_image, Image::WriteLock);
-          auto dst_it = dstBits.begin();
-#ifdef _DEBUG
-          auto dst_end = dstBits.end();
-#endif
-          for (; src_it != src_end; ++src_it, ++dst_it) {
-            ASSERT(dst_it != dst_end);
-            c = *src_it;
+          transform_image<IndexedTraits, RgbTraits>(
+            image, new_image,
+            [=](const color_t c) -> color_t {
+              if (!is_background && c == maskColor)
+                return rgba(0, 0, 0, 0);
 
-            if (!is_background && c == image->maskColor())
-              *dst_it = rgba(0, 0, 0, 0);
-            else {
               const uint32_t p = palette->getEntry(c);
               if (is_background)
-                *dst_it = rgba(rgba_getr(p), rgba_getg(p), rgba_getb(p), 255);
+                return rgba(rgba_getr(p), rgba_getg(p), rgba_getb(p), 255);
               else
-                *dst_it = p;
-            }
-          }
-          ASSERT(dst_it == dst_end);
+                return p;
+            });
           break;
         }
 
         // Indexed -> Grayscale
         case IMAGE_GRAYSCALE: {
-          LockImageBits<GrayscaleTraits> dstBits(new_image, Image::WriteLock);
-          auto dst_it = dstBits.begin();
-#ifdef _DEBUG
-          auto dst_end = dstBits.end();
           ASSERT(toGray);
-#endif
-          for (; src_it != src_end; ++src_it, ++dst_it) {
-            ASSERT(dst_it != dst_end);
-            c = *src_it;
-
-            if (!is_background && c == image->maskColor())
-              *dst_it = graya(0, 0);
-            else {
-              c = palette->getEntry(c);
-              *dst_it = (*toGray)(c);
-            }
-          }
-          ASSERT(dst_it == dst_end);
+          transform_image<IndexedTraits, GrayscaleTraits>(
+            image, new_image,
+            [=](const color_t c) -> color_t {
+              if (!is_background && c == maskColor)
+                return graya(0, 0);
+              else
+                return (*toGray)(palette->getEntry(c));
+            });
           break;
         }
 
         // Indexed -> Indexed
         case IMAGE_INDEXED: {
-          LockImageBits<IndexedTraits> dstBits(new_image, Image::WriteLock);
-          auto dst_it = dstBits.begin();
-#ifdef _DEBUG
-          auto dst_end = dstBits.end();
-#endif
-          for (; src_it != src_end; ++src_it, ++dst_it) {
-            ASSERT(dst_it != dst_end);
-            c = *src_it;
-
-            if (!is_background && c == image->maskColor())
-              *dst_it = new_mask_color0;
-            else {
-              c = palette->getEntry(c);
-              r = rgba_getr(c);
-              g = rgba_getg(c);
-              b = rgba_getb(c);
-              a = rgba_geta(c);
-
+          transform_image<IndexedTraits, IndexedTraits>(
+            image, new_image,
+            [=](const color_t c) -> color_t {
+              if (!is_background && c == maskColor)
+                return new_mask_color0;
+
+              const color_t p = palette->getEntry(c);
+              const int r = rgba_getr(p);
+              const int g = rgba_getg(p);
+              const int b = rgba_getb(p);
+              const int a = rgba_geta(p);
               if (rgbmap)
-                *dst_it = rgbmap->mapColor(r, g, b, a);
+                return rgbmap->mapColor(r, g, b, a);
               else
-                *dst_it = palette->findBestfit(r, g, b, a, new_mask_color);
-            }
-          }
-          ASSERT(dst_it == dst_end);
+                return palette->findBestfit(r, g, b, a, new_mask_color);
+            });
           break;
         }
 
@@ -411,15 +591,14 @@ void PaletteOptimizer::feedWithImage(const Image* image,
   feedWithImage(image, image->bounds(), withAlpha);
 }
 
-void PaletteOptimizer::feedWithImage(const Image* image,
-                                     const gfx::Rect& bounds,
-                                     const bool withAlpha)
+template<typename Histogram>
+static void feed_histogram_with_image(Histogram& histogram,
+                                      const Image* image,
+                                      const gfx::Rect& bounds,
+                                      const bool withAlpha)
 {
   uint32_t color;
 
-  if (withAlpha)
-    m_withAlpha = true;
-
   ASSERT(image);
   switch (image->pixelFormat()) {
 
@@ -434,7 +613,7 @@ void PaletteOptimizer::feedWithImage(const Image* image,
             if (!withAlpha)
               color |= rgba(0, 0, 0, 255);
 
-            m_histogram.addSamples(color, 1);
+            histogram.addSamples(color, 1);
           }
         }
       }
@@ -452,10 +631,10 @@ void PaletteOptimizer::feedWithImage(const Image* image,
             if (!withAlpha)
               color = graya(graya_getv(color), 255);
 
-            m_histogram.addSamples(rgba(graya_getv(color),
-                                        graya_getv(color),
-                                        graya_getv(color),
-                                        graya_geta(color)), 1);
+            histogram.addSamples(rgba(graya_getv(color),
+                                      graya_getv(color),
+                                      graya_getv(color),
+                                      graya_geta(color)), 1);
           }
         }
       }
@@ -468,11 +647,37 @@ void PaletteOptimizer::feedWithImage(const Image* image,
   }
 }
 
+// static
+void PaletteOptimizer::feedHistogramWithImage(PartialHistogram& histogram,
+                                              const Image* image,
+                                              const bool withAlpha)
+{
+  feed_histogram_with_image(histogram, image, image->bounds(), withAlpha);
+}
+
+void PaletteOptimizer::feedWithImage(const Image* image,
+                                     const gfx::Rect& bounds,
+                                     const bool withAlpha)
+{
+  if (withAlpha)
+    m_withAlpha = true;
+
+  feed_histogram_with_image(m_histogram, image, bounds, withAlpha);
+}
+
 void PaletteOptimizer::feedWithRgbaColor(color_t color)
 {
   m_histogram.addSamples(color, 1);
 }
 
+void PaletteOptimizer::merge(const PartialHistogram& histogram,
+                             const bool withAlpha)
+{
+  m_histogram.merge(histogram);
+  if (withAlpha)
+    m_withAlpha = true;
+}
+
 void PaletteOptimizer::calculate(Palette* palette, int maskIndex)
 {
   bool addMask;
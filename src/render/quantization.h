@@ -1,5 +1,5 @@
 // Aseprite Rener Library
-// Copyright (c) 2019-2021  Igara Studio S.A.
+// Copyright (c) 2019-2024  Igara Studio S.A.
 // Copyright (c) 2001-2017  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -29,12 +29,23 @@ namespace render {
 
   class PaletteOptimizer {
   public:
+    // Histogram with 32-bit counters (half the memory of the main
+    // histogram) to accumulate the samples of a limited number of
+    // images, e.g. from other threads, and merge them later.
+    using PartialHistogram = render::ColorHistogram<5, 6, 5, 5, uint32_t>;
+
+    static void feedHistogramWithImage(PartialHistogram& histogram,
+                                       const doc::Image* image,
+                                       const bool withAlpha);
+
     void feedWithImage(const doc::Image* image,
                        const bool withAlpha);
     void feedWithImage(const doc::Image* image,
                        const gfx::Rect& bounds,
                        const bool withAlpha);
     void feedWithRgbaColor(doc::color_t color);
+    void merge(const PartialHistogram& histogram,
+               const bool withAlpha);
     void calculate(doc::Palette* palette, int maskIndex);
     bool isHighPrecision() { return m_histogram.isHighPrecision(); }
     int highPrecisionSize() { return m_histogram.highPrecisionSize(); }
@@ -44,6 +55,13 @@ namespace render {
     bool m_withAlpha = false;
   };
 
+  // Options to create a palette from a subset of the sprite pixels
+  // (an approximation of the palette created from all pixels).
+  struct PaletteSampling {
+    int frameStep = 1;          // Use one of each N frames
+    int pixelStep = 1;          // Use one of each N pixels in each row/column
+  };
+
   // Creates a new palette suitable to quantize the given RGB sprite to Indexed color.
   doc::Palette* create_palette_from_sprite(
     const doc::Sprite* sprite,
@@ -54,7 +72,8 @@ namespace render {
     TaskDelegate* delegate,
     const bool newBlend,
     RgbMapAlgorithm mapAlgo,
-    const bool calculateWithTransparent = true);
+    const bool calculateWithTransparent = true,
+    const PaletteSampling& sampling = PaletteSampling());
 
   // Changes the image pixel format. The dithering method is used only
   // when you want to convert from RGB to Indexed.
@@ -0,0 +1,83 @@
+// Aseprite Render Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "render/quantization.h"
+
+#include "doc/palette.h"
+#include "doc/rgbmap.h"
+#include "doc/sprite.h"
+#include "render/dithering.h"
+#include "render/dithering_matrix.h"
+#include "tests/benchmark_fixtures.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+
+using namespace doc;
+using namespace render;
+
+// Creates an optimized palette from all frames of an RGB sprite.
+static void BM_CreatePaletteFromSprite(benchmark::State& state)
+{
+  const int size = state.range(0);
+  const int nframes = state.range(1);
+  std::unique_ptr<Sprite> spr(
+    tests::create_fixture_sprite(ColorMode::RGB, size, size, nframes, 2));
+
+  for (auto _ : state) {
+    std::unique_ptr<Palette> pal(
+      create_palette_from_sprite(spr.get(), 0, spr->lastFrame(),
+                                 false, nullptr, nullptr, true,
+                                 RgbMapAlgorithm::DEFAULT));
+    benchmark::DoNotOptimize(pal.get());
+  }
+}
+
+// Converts an RGB image to indexed with the given dithering
+// algorithm.
+static void BM_ConvertToIndexed(benchmark::State& state,
+                                const DitheringAlgorithm algorithm)
+{
+  const int size = state.range(0);
+  std::unique_ptr<Sprite> spr(
+    tests::create_fixture_sprite(ColorMode::RGB, size, size));
+  const Image* src = spr->root()->firstLayer()->cel(0)->image();
+  const Palette* pal = spr->palette(0);
+  const RgbMap* rgbmap = spr->rgbMap(0, Sprite::RgbMapFor::OpaqueLayer);
+  const Dithering dithering(algorithm, BayerMatrix(8));
+  std::unique_ptr<Image> dst(Image::create(IMAGE_INDEXED, size, size));
+
+  for (auto _ : state) {
+    convert_pixel_format(src, dst.get(), IMAGE_INDEXED,
+                         dithering, rgbmap, pal, false, 0);
+  }
+}
+
+BENCHMARK(BM_CreatePaletteFromSprite)
+  ->Args({ 256, 1 })
+  ->Args({ 256, 16 })
+  ->Args({ 1024, 1 })
+  ->Args({ 4096, 1 })
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(BM_ConvertToIndexed, none, DitheringAlgorithm::None)
+  ->Arg(256)->Arg(1024)->Arg(4096)
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(BM_ConvertToIndexed, ordered, DitheringAlgorithm::Ordered)
+  ->Arg(256)->Arg(1024)->Arg(4096)
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_CAPTURE(BM_ConvertToIndexed, error_diffusion, DitheringAlgorithm::ErrorDiffusion)
+  ->Arg(256)->Arg(1024)->Arg(4096)
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
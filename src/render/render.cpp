@@ -11,9 +11,11 @@
 
 #include "render/render.h"
 
+#include "base/thread_pool.h"
 #include "doc/blend_internals.h"
 #include "doc/blend_mode.h"
 #include "doc/doc.h"
+#include "doc/image_buffer_pool.h"
 #include "doc/image_impl.h"
 #include "doc/layer_tilemap.h"
 #include "doc/playback.h"
@@ -22,8 +24,16 @@
 #include "doc/tilesets.h"
 #include "gfx/clip.h"
 #include "gfx/region.h"
+#include "render/composite_cache.h"
+#include "render/mipmap_cache.h"
+#include "render/scaled_image_cache.h"
+#include "render/tile_cache.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <type_traits>
+#include <vector>
 
 #define TRACE_RENDER_CEL(...) // TRACE
 
@@ -63,6 +73,44 @@ void composite_image_without_scale(
 
   ASSERT(!srcBounds.isEmpty());
 
+  // RGB -> RGB can be blended row by row (using SIMD when possible)
+  if constexpr (std::is_same_v<DstTraits, RgbTraits> &&
+                std::is_same_v<SrcTraits, RgbTraits>) {
+    const BlendRowFunc rowBlender = get_rgba_row_blender(blendMode, newBlend);
+    const color_t maskColor = src->maskColor();
+    for (int y=0; y<srcBounds.h && dstBounds.y+y <= bottom; ++y) {
+      rowBlender(
+        (color_t*)get_pixel_address_fast<DstTraits>(dst, dstBounds.x, dstBounds.y+y),
+        (const color_t*)get_pixel_address_fast<SrcTraits>(src, srcBounds.x, srcBounds.y+y),
+        srcBounds.w, opacity, maskColor);
+    }
+    return;
+  }
+
+  // Indexed -> Indexed doesn't blend colors (opacity is ignored), it
+  // copies the non-transparent indexes, so we can use plain rows.
+  if constexpr (std::is_same_v<DstTraits, IndexedTraits> &&
+                std::is_same_v<SrcTraits, IndexedTraits>) {
+    if (blendMode != BlendMode::DST_OVER) {
+      const color_t maskColor = src->maskColor();
+      const color_t palSize = (pal ? pal->size(): 256);
+      for (int y=0; y<srcBounds.h && dstBounds.y+y <= bottom; ++y) {
+        auto dstPtr = get_pixel_address_fast<DstTraits>(dst, dstBounds.x, dstBounds.y+y);
+        auto srcPtr = get_pixel_address_fast<SrcTraits>(src, srcBounds.x, srcBounds.y+y);
+        if (blendMode == BlendMode::SRC) {
+          std::memcpy(dstPtr, srcPtr, srcBounds.w);
+          continue;
+        }
+        for (int x=0; x<srcBounds.w; ++x) {
+          const color_t c = srcPtr[x];
+          if (c != maskColor && c < palSize)
+            dstPtr[x] = c;
+        }
+      }
+      return;
+    }
+  }
+
   // Lock all necessary bits
   const LockImageBits<SrcTraits> srcBits(src, srcBounds);
   LockImageBits<DstTraits> dstBits(dst, dstBounds);
@@ -91,6 +139,38 @@ void composite_image_without_scale(
   }
 }
 
+// Copies the pixels of an opaque RGB image without blending (same
+// result as composite_image_without_scale() with opacity=255 and the
+// normal blend mode).
+void copy_opaque_rgb_image_without_scale(
+  Image* dst, const Image* src, const Palette* pal,
+  const gfx::ClipF& areaF,
+  const int opacity,
+  const BlendMode blendMode,
+  const double sx,
+  const double sy,
+  const bool newBlend,
+  const tile_flags)             // Ignored
+{
+  ASSERT(dst);
+  ASSERT(src);
+  ASSERT(dst->pixelFormat() == IMAGE_RGB);
+  ASSERT(src->pixelFormat() == IMAGE_RGB);
+
+  gfx::Clip area(areaF);
+  if (!area.clip(dst->width(), dst->height(),
+                 src->width(), src->height()))
+    return;
+
+  const gfx::Rect srcBounds = area.srcBounds();
+  const gfx::Rect dstBounds = area.dstBounds();
+  for (int y=0; y<srcBounds.h; ++y) {
+    std::memcpy(get_pixel_address_fast<RgbTraits>(dst, dstBounds.x, dstBounds.y+y),
+                get_pixel_address_fast<RgbTraits>(src, srcBounds.x, srcBounds.y+y),
+                RgbTraits::bytes_per_pixel * srcBounds.w);
+  }
+}
+
 template<class DstTraits, class SrcTraits>
 void composite_image_scale_up(
   Image* dst, const Image* src, const Palette* pal,
@@ -508,6 +588,42 @@ CompositeImageFunc get_fastest_composition_path(const Projection& proj,
   }
 }
 
+template<class DstTraits>
+bool is_scale_down_composition_to(const CompositeImageFunc func)
+{
+  return (func == composite_image_scale_down<DstTraits, RgbTraits> ||
+          func == composite_image_scale_down<DstTraits, GrayscaleTraits> ||
+          func == composite_image_scale_down<DstTraits, IndexedTraits>);
+}
+
+// True if the given function takes one pixel of each N columns/rows
+// of the source image (so we can use a reduced image of the mipmap
+// cache to take the same pixels).
+bool is_scale_down_composition(const CompositeImageFunc func)
+{
+  return (is_scale_down_composition_to<RgbTraits>(func) ||
+          is_scale_down_composition_to<GrayscaleTraits>(func) ||
+          is_scale_down_composition_to<IndexedTraits>(func));
+}
+
+template<class DstTraits>
+bool is_general_composition_to(const CompositeImageFunc func)
+{
+  return (func == composite_image_general<DstTraits, RgbTraits> ||
+          func == composite_image_general<DstTraits, GrayscaleTraits> ||
+          func == composite_image_general<DstTraits, IndexedTraits>);
+}
+
+// True if the given function takes the nearest source pixel for
+// each destination pixel with any scale (so we can use a scaled image
+// of the ScaledImageCache with a 1:1 scale).
+bool is_general_composition(const CompositeImageFunc func)
+{
+  return (is_general_composition_to<RgbTraits>(func) ||
+          is_general_composition_to<GrayscaleTraits>(func) ||
+          is_general_composition_to<IndexedTraits>(func));
+}
+
 bool has_visible_reference_layers(const LayerGroup* group)
 {
   for (const Layer* child : group->layers()) {
@@ -544,6 +660,7 @@ Render::Render()
   , m_previewTileset(nullptr)
   , m_previewBlendMode(BlendMode::NORMAL)
   , m_onionskin(OnionskinType::NONE)
+  , m_tileSize(0)
 {
 }
 
@@ -631,6 +748,59 @@ void Render::disableOnionskin()
   m_onionskin.type(OnionskinType::NONE);
 }
 
+void Render::setCompositeCache(const bool enabled)
+{
+  if (enabled) {
+    if (!m_compositeCache)
+      m_compositeCache = std::make_shared<CompositeCache>();
+  }
+  else
+    m_compositeCache.reset();
+}
+
+void Render::setMipmapCache(const bool enabled)
+{
+  if (enabled) {
+    if (!m_mipmapCache)
+      m_mipmapCache = std::make_shared<MipmapCache>();
+  }
+  else
+    m_mipmapCache.reset();
+}
+
+void Render::setScaledImageCache(const bool enabled)
+{
+  if (enabled) {
+    if (!m_scaledImageCache)
+      m_scaledImageCache = std::make_shared<ScaledImageCache>();
+  }
+  else
+    m_scaledImageCache.reset();
+}
+
+void Render::setTileCache(const bool enabled)
+{
+  if (enabled) {
+    if (!m_tileCache)
+      m_tileCache = std::make_shared<TileCache>();
+  }
+  else
+    m_tileCache.reset();
+}
+
+void Render::setParallelTiles(const int threads,
+                              const int tileSize)
+{
+  if (threads > 1 && tileSize > 0) {
+    m_tileSize = tileSize;
+    m_tilesPool = std::make_shared<base::thread_pool>(threads);
+  }
+  else {
+    m_tileSize = 0;
+    m_tilesPool.reset();
+  }
+}
+
 void Render::renderSprite(
   Image* dstImage,
   const Sprite* sprite,
@@ -669,10 +839,9 @@ void Render::renderLayer(
 
   m_globalOpacity = 255;
 
-  doc::RenderPlan plan;
-  plan.addLayer(layer, frame);
+  auto plan = getRenderPlan(layer, frame);
   renderPlan(
-    plan, dstImage, area,
+    *plan, dstImage, area,
     frame, compositeImage,
     true, true, blendMode);
 }
@@ -685,6 +854,18 @@ void Render::renderSprite(
 {
   m_sprite = sprite;
 
+  // Tiles can be rendered in parallel only if their edges match the
+  // pixel grid (so no pixel is composited by two threads).
+  if (m_tilesPool &&
+      (area.size.w > m_tileSize || area.size.h > m_tileSize) &&
+      area.dst.x == std::floor(area.dst.x) &&
+      area.dst.y == std::floor(area.dst.y) &&
+      area.src.x == std::floor(area.src.x) &&
+      area.src.y == std::floor(area.src.y)) {
+    renderSpriteTiles(dstImage, sprite, frame, area);
+    return;
+  }
+
   CompositeImageFunc compositeImage =
     getImageComposition(
       dstImage->pixelFormat(),
@@ -715,27 +896,41 @@ void Render::renderSprite(
     fill_rect(dstImage, area.dstBounds(), bg_color);
 
     // Draw the Background layer - Onion skin behind the sprite - Transparent Layers
-    renderSpriteLayers(dstImage, area, frame, compositeImage);
+    renderSpriteLayers(dstImage, area, frame, compositeImage, bg_color);
 
     // In case that we need a special background (e.g. like the
     // checkered pattern), we can draw the background in a temporal
     // image and then merge this temporal image with the dstImage.
     if (!isSolidBackground(bgLayer, bg_color)) {
-      if (!m_tmpBuf)
-        m_tmpBuf.reset(new doc::ImageBuffer);
-      ImageRef tmpBackground(Image::create(dstImage->spec(), m_tmpBuf));
-      renderBackground(tmpBackground.get(), bgLayer, bg_color, area);
-
-      // Draws dstImage over the background on each pixel of dstImage
-      // with opacity is < 255 (the result is left on dstImage itself)
-      composite_image(dstImage, tmpBackground.get(), sprite->palette(frame),
-                      0, 0, 255, BlendMode::DST_OVER);
+      const gfx::Rect dstBounds = gfx::Rect(area.dstBounds()) & dstImage->bounds();
+      if (!dstBounds.isEmpty()) {
+        if (!m_tmpBuf)
+          m_tmpBuf = doc::ImageBufferPool::instance()->get();
+
+        // The temporal background covers only the rendered area, so
+        // the DST_OVER composition doesn't touch pixels outside the
+        // area (which can be rendered by other threads in the
+        // tile-parallel mode).
+        ImageRef tmpBackground(
+          Image::create(dstImage->pixelFormat(),
+                        dstBounds.w, dstBounds.h, m_tmpBuf));
+        renderBackground(tmpBackground.get(), bgLayer, bg_color,
+                         gfx::ClipF(area.dst.x - dstBounds.x,
+                                    area.dst.y - dstBounds.y,
+                                    area.src.x, area.src.y,
+                                    area.size.w, area.size.h));
+
+        // Draws dstImage over the background on each pixel of dstImage
+        // with opacity is < 255 (the result is left on dstImage itself)
+        composite_image(dstImage, tmpBackground.get(), sprite->palette(frame),
+                        dstBounds.x, dstBounds.y, 255, BlendMode::DST_OVER);
+      }
     }
   }
   // Old Blending Method:
   else {
     renderBackground(dstImage, bgLayer, bg_color, area);
-    renderSpriteLayers(dstImage, area, frame, compositeImage);
+    renderSpriteLayers(dstImage, area, frame, compositeImage, bg_color);
   }
 
   // Draw onion skin in front of the sprite.
@@ -763,13 +958,83 @@ void Render::renderSprite(
   }
 }
 
+void Render::renderSpriteTiles(
+  Image* dstImage,
+  const Sprite* sprite,
+  frame_t frame,
+  const gfx::ClipF& area)
+{
+  ASSERT(m_tilesPool);
+  ASSERT(m_tileSize > 0);
+
+  // Create the render plan before copying this Render, so all tiles
+  // share the same cached plan.
+  getRenderPlan(sprite->root(), frame);
+
+  // Each tile is rendered with its own copy of this Render (so each
+  // one has its own m_tmpBuf and state like m_globalOpacity).
+  std::vector<std::unique_ptr<Render>> tileRenders;
+  for (double y=0; y<area.size.h; y+=m_tileSize) {
+    for (double x=0; x<area.size.w; x+=m_tileSize) {
+      auto tileRender = std::make_unique<Render>(*this);
+      tileRender->m_tilesPool.reset();
+      tileRender->m_compositeCache.reset();
+      tileRender->m_tmpBuf.reset();
+
+      const gfx::ClipF tileArea(
+        area.dst.x+x, area.dst.y+y,
+        area.src.x+x, area.src.y+y,
+        std::min<double>(m_tileSize, area.size.w-x),
+        std::min<double>(m_tileSize, area.size.h-y));
+
+      Render* render = tileRender.get();
+      m_tilesPool->execute([render, dstImage, sprite, frame, tileArea]{
+        render->renderSprite(dstImage, sprite, frame, tileArea);
+      });
+      tileRenders.push_back(std::move(tileRender));
+    }
+  }
+  m_tilesPool->wait_all();
+}
+
+std::shared_ptr<const doc::RenderPlan> Render::getRenderPlan(const Layer* layer,
+                                                             const frame_t frame)
+{
+  // Max number of cached plans (e.g. frames + onion skin frames of
+  // the last renders).
+  const size_t kMaxPlans = 64;
+
+  const uint32_t version = doc::RenderPlan::structureVersion();
+  if (m_plansVersion != version ||
+      m_plans.size() >= kMaxPlans) {
+    m_plans.clear();
+    m_plansVersion = version;
+  }
+
+  auto& plan = m_plans[std::make_pair(layer, frame)];
+  if (!plan) {
+    auto newPlan = std::make_shared<doc::RenderPlan>();
+    newPlan->addLayer(layer, frame);
+    newPlan->items();           // Sort z-indexes now (the plan is shared)
+    plan = newPlan;
+  }
+  return plan;
+}
+
 void Render::renderSpriteLayers(Image* dstImage,
                                 const gfx::ClipF& area,
                                 frame_t frame,
-                                CompositeImageFunc compositeImage)
+                                CompositeImageFunc compositeImage,
+                                const color_t bg_color)
 {
-  doc::RenderPlan plan;
-  plan.addLayer(m_sprite->root(), frame);
+  auto planPtr = getRenderPlan(m_sprite->root(), frame);
+  const doc::RenderPlan& plan = *planPtr;
+
+  if (m_compositeCache &&
+      renderSpriteLayersWithCache(plan, dstImage, area, frame,
+                                  compositeImage, bg_color)) {
+    return;
+  }
 
   // Draw the background layer.
   m_globalOpacity = 255;
@@ -792,6 +1057,211 @@ void Render::renderSpriteLayers(Image* dstImage,
              BlendMode::UNSPECIFIED);
 }
 
+bool Render::renderSpriteLayersWithCache(const doc::RenderPlan& plan,
+                                         Image* dstImage,
+                                         const gfx::ClipF& area,
+                                         frame_t frame,
+                                         CompositeImageFunc compositeImage,
+                                         const color_t bg_color)
+{
+  ASSERT(m_compositeCache);
+
+  // The cache only works for the new blend method (where the
+  // background is filled with the bg_color).
+  if (!m_newBlendMethod ||
+      !m_selectedLayerForOpacity) {
+    return false;
+  }
+
+  // The onion skin between the background and the transparent layers
+  // is cached too (so we don't need to composite all the neighbor
+  // frames again while we paint in the current one).
+  const bool onionskinBehind =
+    (m_onionskin.type() != OnionskinType::NONE &&
+     m_onionskin.position() == OnionskinPosition::BEHIND);
+
+  // Each projected pixel must be always taken from the same sprite
+  // pixel independently of the rendered area (integer scales for
+  // zoom in, or integer steps for zoom out), so compositing the whole
+  // canvas or just a part of it gives the same result.
+  auto isIntegralScale = [](const double s) {
+    return (s >= 1.0 ? s == std::floor(s):
+            s > 0.0 && 1.0/s == std::floor(1.0/s));
+  };
+  if (!isIntegralScale(m_proj.scaleX()) ||
+      !isIntegralScale(m_proj.scaleY()) ||
+      area.src.x != std::floor(area.src.x) ||
+      area.src.y != std::floor(area.src.y) ||
+      area.dst.x != std::floor(area.dst.x) ||
+      area.dst.y != std::floor(area.dst.y)) {
+    return false;
+  }
+
+  const gfx::Rect cacheBounds(0, 0,
+                              m_proj.applyX(m_sprite->width()),
+                              m_proj.applyY(m_sprite->height()));
+  const gfx::Rect srcBounds(area.srcBounds());
+  if (cacheBounds.isEmpty() ||
+      !cacheBounds.contains(srcBounds) ||
+      double(cacheBounds.w) * double(cacheBounds.h) > CompositeCache::kMaxPixels) {
+    return false;
+  }
+
+  // Find the selected layer, all the items before it will be cached.
+  const auto& items = plan.items();
+  size_t n = 0;
+  for (; n<items.size(); ++n) {
+    if (items[n].layer == m_selectedLayerForOpacity)
+      break;
+  }
+  if ((n == 0 && !onionskinBehind) || n == items.size())
+    return false;
+
+  // Background layers are rendered in a first pass, so all of them
+  // must be cached.
+  for (size_t i=n; i<items.size(); ++i) {
+    if (items[i].layer->isBackground())
+      return false;
+  }
+
+  Palette* pal = m_sprite->palette(frame);
+
+  CompositeCache::Key key;
+  key.sprite = m_sprite;
+  key.frame = frame;
+  key.pixelFormat = dstImage->pixelFormat();
+  key.bgColor = bg_color;
+  key.palette = pal;
+  key.paletteVersion = pal->version();
+  key.scaleX = m_proj.scaleX();
+  key.scaleY = m_proj.scaleY();
+  key.newBlend = m_newBlendMethod;
+  key.flags = m_flags;
+  key.nonactiveLayersOpacity = m_nonactiveLayersOpacity;
+  key.activeLayer = m_selectedLayerForOpacity;
+  key.items.reserve(n);
+
+  // Returns false if the cel cannot be cached
+  auto addItem = [this](std::vector<CompositeCache::Item>& dstItems,
+                        const Layer* layer,
+                        const Cel* cel) -> bool {
+    CompositeCache::Item item;
+    item.layer = layer;
+    item.layerVersion = layer->version();
+    if (layer->isImage()) {
+      auto imgLayer = static_cast<const LayerImage*>(layer);
+      item.layerOpacity = imgLayer->opacity();
+      item.blendMode = imgLayer->blendMode();
+    }
+    if (cel) {
+      // The preview image is not cached
+      if (m_previewImage && checkIfWeShouldUsePreview(cel))
+        return false;
+
+      item.cel = cel;
+      item.celVersion = cel->version();
+      item.celDataVersion = cel->data()->version();
+      item.image = cel->image();
+      item.imageVersion = (item.image ? item.image->version(): 0);
+      item.bounds = cel->boundsF();
+      item.opacity = cel->opacity();
+      item.zIndex = cel->zIndex();
+    }
+    if (layer->isTilemap()) {
+      const Tileset* tileset = static_cast<const LayerTilemap*>(layer)->tileset();
+      item.tileset = tileset;
+      if (tileset) {
+        item.tilesetVersion = tileset->version();
+        for (const auto& tile : *tileset) {
+          if (tile.image)
+            item.tilesetVersion += tile.image->version();
+        }
+      }
+    }
+    dstItems.push_back(item);
+    return true;
+  };
+
+  for (size_t i=0; i<n; ++i) {
+    const Layer* layer = items[i].layer;
+    const Cel* cel = (items[i].cel ? items[i].cel: layer->cel(frame));
+    if (!addItem(key.items, layer, cel))
+      return false;
+  }
+
+  if (onionskinBehind) {
+    key.onionskinLayer = getOnionskinLayer();
+    key.onionskinFrames = getOnionskinFrames(frame);
+    for (const OnionskinFrame& onion : key.onionskinFrames) {
+      auto onionPlan = getRenderPlan(key.onionskinLayer, onion.frame);
+      for (const auto& onionItem : onionPlan->items()) {
+        const Layer* layer = onionItem.layer;
+        const Cel* cel = (onionItem.cel ? onionItem.cel: layer->cel(onion.frame));
+
+        // The extra cel is drawn in linked cels of other frames
+        if (m_extraCel && m_extraImage && cel &&
+            layer == m_currentLayer) {
+          const Cel* extraCel = layer->cel(m_extraCel->frame());
+          if (extraCel && extraCel->data() == cel->data())
+            return false;
+        }
+
+        if (!addItem(key.onionskinItems, layer, cel))
+          return false;
+      }
+    }
+  }
+
+  ImageRef cacheImage = m_compositeCache->image();
+  if (!m_compositeCache->isValid(key)) {
+    TRACE_RENDER_CEL("Render: composite cache miss\n");
+
+    if (!cacheImage ||
+        cacheImage->pixelFormat() != dstImage->pixelFormat() ||
+        cacheImage->bounds() != cacheBounds) {
+      cacheImage.reset(Image::create(dstImage->pixelFormat(),
+                                     cacheBounds.w, cacheBounds.h));
+    }
+    clear_image(cacheImage.get(), bg_color);
+
+    // Render the background layer and the transparent layers below the
+    // selected layer in the whole canvas.
+    const gfx::ClipF cacheArea(0, 0, 0, 0, cacheBounds.w, cacheBounds.h);
+    m_globalOpacity = 255;
+    renderPlan(plan, cacheImage.get(),
+               cacheArea, frame, compositeImage,
+               true,
+               false,
+               BlendMode::UNSPECIFIED);
+    if (onionskinBehind) {
+      renderOnionskin(cacheImage.get(), cacheArea, frame, compositeImage);
+      m_globalOpacity = 255;
+    }
+    renderPlan(plan, cacheImage.get(),
+               cacheArea, frame, compositeImage,
+               false,
+               true,
+               BlendMode::UNSPECIFIED,
+               0, n);
+
+    m_compositeCache->update(std::move(key), cacheImage);
+  }
+
+  // Restore the layers below the selected one from the cache.
+  dstImage->copy(cacheImage.get(),
+                 gfx::Clip(int(area.dst.x), int(area.dst.y), srcBounds));
+
+  // Draw the selected layer and the layers above it.
+  m_globalOpacity = 255;
+  renderPlan(plan, dstImage,
+             area, frame, compositeImage,
+             false,
+             true,
+             BlendMode::UNSPECIFIED,
+             n);
+  return true;
+}
+
 void Render::renderBackground(Image* image,
                               const Layer* bgLayer,
                               const color_t bg_color,
@@ -844,59 +1314,83 @@ void Render::renderOnionskin(
 {
   // Onion-skin feature: Draw previous/next frames with different
   // opacity (<255)
-  if (m_onionskin.type() != OnionskinType::NONE) {
-    Tag* loop = m_onionskin.loopTag();
-    Layer* onionLayer = (m_onionskin.layer() ? m_onionskin.layer():
-                                               m_sprite->root());
-    Playback play(
-      m_sprite,
-      TagsList(),  // TODO add an onionskin option to iterate subtags
-      frame,
-      loop ? Playback::PlayInLoop : Playback::PlayAll,
-      loop);
-    frame_t prevFrames = (loop ? m_onionskin.prevFrames():
-                                 std::min(frame, m_onionskin.prevFrames()));
-    play.nextFrame(-prevFrames);
-
-    for (frame_t frameOut = frame - prevFrames;
-         frameOut <= frame + m_onionskin.nextFrames();
-         ++frameOut, play.nextFrame()) {
-      const frame_t frameIn = play.frame();
-
-      if (frameIn == frame ||
-          frameIn < 0 ||
-          frameIn > m_sprite->lastFrame()) {
-        continue;
-      }
+  if (m_onionskin.type() == OnionskinType::NONE)
+    return;
 
-      if (frameOut < frame) {
-        m_globalOpacity = m_onionskin.opacityBase() - m_onionskin.opacityStep() * ((frame - frameOut)-1);
-      }
-      else {
-        m_globalOpacity = m_onionskin.opacityBase() - m_onionskin.opacityStep() * ((frameOut - frame)-1);
-      }
+  const Layer* onionLayer = getOnionskinLayer();
+  for (const OnionskinFrame& onion : getOnionskinFrames(frame)) {
+    m_globalOpacity = onion.opacity;
+
+    auto plan = getRenderPlan(onionLayer, onion.frame);
+    renderPlan(
+      *plan, dstImage,
+      area, onion.frame, compositeImage,
+      // Render background only for "in-front" onion skinning and
+      // when opacity is < 255
+      (m_globalOpacity < 255 &&
+       m_onionskin.position() == OnionskinPosition::INFRONT),
+      true, onion.blendMode);
+  }
+}
 
-      m_globalOpacity = std::clamp(m_globalOpacity, 0, 255);
-      if (m_globalOpacity > 0) {
-        BlendMode blendMode = BlendMode::UNSPECIFIED;
-        if (m_onionskin.type() == OnionskinType::MERGE)
-          blendMode = BlendMode::NORMAL;
-        else if (m_onionskin.type() == OnionskinType::RED_BLUE_TINT)
-          blendMode = (frameOut < frame ? BlendMode::RED_TINT: BlendMode::BLUE_TINT);
-
-        doc::RenderPlan plan;
-        plan.addLayer(onionLayer, frameIn);
-        renderPlan(
-          plan, dstImage,
-          area, frameIn, compositeImage,
-          // Render background only for "in-front" onion skinning and
-          // when opacity is < 255
-          (m_globalOpacity < 255 &&
-           m_onionskin.position() == OnionskinPosition::INFRONT),
-          true, blendMode);
-      }
+std::vector<OnionskinFrame> Render::getOnionskinFrames(const frame_t frame) const
+{
+  std::vector<OnionskinFrame> frames;
+  if (m_onionskin.type() == OnionskinType::NONE)
+    return frames;
+
+  Tag* loop = m_onionskin.loopTag();
+  Playback play(
+    m_sprite,
+    TagsList(),  // TODO add an onionskin option to iterate subtags
+    frame,
+    loop ? Playback::PlayInLoop : Playback::PlayAll,
+    loop);
+  frame_t prevFrames = (loop ? m_onionskin.prevFrames():
+                               std::min(frame, m_onionskin.prevFrames()));
+  play.nextFrame(-prevFrames);
+
+  for (frame_t frameOut = frame - prevFrames;
+       frameOut <= frame + m_onionskin.nextFrames();
+       ++frameOut, play.nextFrame()) {
+    const frame_t frameIn = play.frame();
+
+    if (frameIn == frame ||
+        frameIn < 0 ||
+        frameIn > m_sprite->lastFrame()) {
+      continue;
+    }
+
+    int opacity;
+    if (frameOut < frame) {
+      opacity = m_onionskin.opacityBase() - m_onionskin.opacityStep() * ((frame - frameOut)-1);
+    }
+    else {
+      opacity = m_onionskin.opacityBase() - m_onionskin.opacityStep() * ((frameOut - frame)-1);
+    }
+
+    opacity = std::clamp(opacity, 0, 255);
+    if (opacity > 0) {
+      BlendMode blendMode = BlendMode::UNSPECIFIED;
+      if (m_onionskin.type() == OnionskinType::MERGE)
+        blendMode = BlendMode::NORMAL;
+      else if (m_onionskin.type() == OnionskinType::RED_BLUE_TINT)
+        blendMode = (frameOut < frame ? BlendMode::RED_TINT: BlendMode::BLUE_TINT);
+
+      OnionskinFrame onion;
+      onion.frame = frameIn;
+      onion.opacity = opacity;
+      onion.blendMode = blendMode;
+      frames.push_back(onion);
     }
   }
+  return frames;
+}
+
+const Layer* Render::getOnionskinLayer() const
+{
+  return (m_onionskin.layer() ? m_onionskin.layer():
+                                m_sprite->root());
 }
 
 void Render::renderCheckeredBackground(
@@ -986,16 +1480,21 @@ void Render::renderImage(
 }
 
 void Render::renderPlan(
-  RenderPlan& plan,
+  const RenderPlan& plan,
   Image* image,
   const gfx::Clip& area,
   const frame_t frame,
   const CompositeImageFunc compositeImage,
   const bool render_background,
   const bool render_transparent,
-  const BlendMode blendMode)
+  const BlendMode blendMode,
+  const size_t firstItem,
+  const size_t endItem)
 {
-  for (const auto& item : plan.items()) {
+  const auto& items = plan.items();
+  const size_t end = std::min(endItem, items.size());
+  for (size_t i=firstItem; i<end; ++i) {
+    const auto& item = items[i];
     const Cel* cel = item.cel;
     const Layer* layer = item.layer;
 
@@ -1266,6 +1765,27 @@ void Render::renderCel(
     TRACE_RENDER_CEL("Drawing tilemap (%d %d %d %d)\n",
                      tilesToDraw.x, tilesToDraw.y, tilesToDraw.w, tilesToDraw.h);
 
+    // Use the cached RGB version of the tiles (the preview tileset is
+    // excluded as its tiles are modified without incrementing their
+    // versions, and the palette must be used for indexed pixels in
+    // SRC mode).
+    const bool useTileCache =
+      (m_tileCache &&
+       tileset != m_previewTileset &&
+       dst_image->pixelFormat() == IMAGE_RGB &&
+       blendMode != BlendMode::SRC);
+    CompositeImageFunc compositeTile = nullptr;
+    CompositeImageFunc copyTile = nullptr;
+    if (useTileCache) {
+      compositeTile = getImageComposition(IMAGE_RGB, IMAGE_RGB, nullptr);
+      if (opacity == 255 &&
+          blendMode == BlendMode::NORMAL &&
+          m_proj.scaleX() == 1.0 &&
+          m_proj.scaleY() == 1.0) {
+        copyTile = copy_opaque_rgb_image_without_scale;
+      }
+    }
+
     for (int v=tilesToDraw.y; v<tilesToDraw.y2(); ++v) {
       for (int u=tilesToDraw.x; u<tilesToDraw.x2(); ++u) {
         auto tileBoundsOnCanvas = grid.tileToCanvas(gfx::Rect(u, v, 1, 1));
@@ -1282,24 +1802,113 @@ void Render::renderCel(
           if (dst_image->pixelFormat() == IMAGE_TILEMAP) {
             put_pixel(dst_image, u-area.dst.x, v-area.dst.y, t);
           }
-          else {
+          // Skip the empty tile
+          else if (i != doc::notile) {
             const ImageRef tile_image = tileset->get(i);
             if (!tile_image)
               continue;
 
-            renderImage(dst_image, tile_image.get(), pal, tileBoundsOnCanvas,
-                        area, compositeImage, opacity, blendMode, tile_getf(t));
+            const tile_flags flags = tile_getf(t);
+            if (useTileCache &&
+                ((flags & tile_f_dflip) == 0 ||
+                 tile_image->width() == tile_image->height())) {
+              const TileCache::Tile tile =
+                m_tileCache->get(tile_image.get(), flags, pal);
+              renderImage(dst_image, tile.image.get(), pal, tileBoundsOnCanvas,
+                          area, (tile.opaque && copyTile ? copyTile: compositeTile),
+                          opacity, blendMode);
+            }
+            else {
+              renderImage(dst_image, tile_image.get(), pal, tileBoundsOnCanvas,
+                          area, compositeImage, opacity, blendMode, flags);
+            }
           }
         }
       }
     }
   }
   else {
+    // Background layers are opaque, so Normal at 100% is a plain copy
+    // (the preview and extra images are excluded as they can contain
+    // transparent pixels).
+    CompositeImageFunc func = compositeImage;
+    if (cel_layer &&
+        cel_layer->isBackground() &&
+        cel_image != m_previewImage &&
+        cel_image != m_extraImage &&
+        opacity == 255 &&
+        blendMode == BlendMode::NORMAL &&
+        func == composite_image_without_scale<RgbTraits, RgbTraits> &&
+        celBounds.w == cel_image->width() &&
+        celBounds.h == cel_image->height()) {
+      func = copy_opaque_rgb_image_without_scale;
+    }
+
+    // Reference layers are usually big images scaled down to the
+    // canvas, so we composite their pre-scaled version.
+    if (m_scaledImageCache &&
+        cel_layer &&
+        cel_layer->isReference() &&
+        cel_image != m_previewImage &&
+        cel_image != m_extraImage &&
+        renderScaledImage(dst_image, cel_image, pal, celBounds,
+                          area, func, opacity, blendMode)) {
+      return;
+    }
+
     renderImage(dst_image, cel_image, pal, celBounds,
-                area, compositeImage, opacity, blendMode);
+                area, func, opacity, blendMode);
   }
 }
 
+bool Render::renderScaledImage(
+  Image* dst_image,
+  const Image* cel_image,
+  const Palette* pal,
+  const gfx::RectF& celBounds,
+  const gfx::Clip& area,
+  const CompositeImageFunc compositeImage,
+  const int opacity,
+  const BlendMode blendMode)
+{
+  const double sx = m_proj.scaleX() * celBounds.w / double(cel_image->width());
+  const double sy = m_proj.scaleY() * celBounds.h / double(cel_image->height());
+  if (sx >= 1.0 || sy >= 1.0 ||
+      !is_general_composition(compositeImage))
+    return false;
+
+  const gfx::RectF scaledBounds = m_proj.apply(celBounds);
+  const gfx::RectF srcBounds = gfx::RectF(area.srcBounds()).createIntersection(scaledBounds);
+  if (srcBounds.isEmpty())
+    return true;
+
+  // Position of the area in the scaled cel, its fractional part is
+  // the phase of the scaled image.
+  const double u = srcBounds.x - scaledBounds.x;
+  const double v = srcBounds.y - scaledBounds.y;
+  const double ui = std::floor(u);
+  const double vi = std::floor(v);
+
+  ImageRef scaled = m_scaledImageCache->get(cel_image, sx, sy, u-ui, v-vi);
+  if (!scaled)
+    return false;
+
+  compositeImage(
+    dst_image, scaled.get(), pal,
+    gfx::ClipF(
+      double(area.dst.x) + srcBounds.x - double(area.src.x),
+      double(area.dst.y) + srcBounds.y - double(area.src.y),
+      ui, vi,
+      srcBounds.w,
+      srcBounds.h),
+    opacity,
+    blendMode,
+    1.0, 1.0,
+    m_newBlendMethod,
+    notile);
+  return true;
+}
+
 void Render::renderImage(
   Image* dst_image,
   const Image* cel_image,
@@ -1324,6 +1933,36 @@ void Render::renderImage(
       nullptr, tileFlags);
   }
 
+  double sx = m_proj.scaleX() * celBounds.w / double(cel_image->width());
+  double sy = m_proj.scaleY() * celBounds.h / double(cel_image->height());
+
+  // Use a reduced image when we skip 2^N columns and rows of the
+  // original one (it gives the same result reading less memory). The
+  // preview and extra images are excluded as they are modified
+  // without incrementing their versions.
+  ImageRef reduced;
+  if (m_mipmapCache &&
+      cel_image != m_previewImage &&
+      cel_image != m_extraImage &&
+      !tileFlags &&
+      sx < 1.0 && sy < 1.0 &&
+      is_scale_down_composition(compositeImage)) {
+    const int stepW = int(1.0 / sx);
+    const int stepH = int(1.0 / sy);
+    int level = 0;
+    while (level < MipmapCache::kMaxLevel &&
+           (stepW & (2 << level)-1) == 0 &&
+           (stepH & (2 << level)-1) == 0)
+      ++level;
+
+    reduced = m_mipmapCache->level(cel_image, level);
+    if (reduced) {
+      cel_image = reduced.get();
+      sx *= double(1 << level);
+      sy *= double(1 << level);
+    }
+  }
+
   compositeImage(
     dst_image, cel_image, pal,
     gfx::ClipF(
@@ -1335,8 +1974,7 @@ void Render::renderImage(
       srcBounds.h),
     opacity,
     blendMode,
-    m_proj.scaleX() * celBounds.w / double(cel_image->width()),
-    m_proj.scaleY() * celBounds.h / double(cel_image->height()),
+    sx, sy,
     m_newBlendMethod,
     tileFlags);
 }
@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019-2023 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -24,6 +24,16 @@
 #include "render/onionskin_options.h"
 #include "render/projection.h"
 
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace base {
+  class thread_pool;
+}
+
 namespace doc {
   class Cel;
   class Image;
@@ -37,6 +47,11 @@ namespace doc {
 namespace render {
   using namespace doc;
 
+  class CompositeCache;
+  class MipmapCache;
+  class ScaledImageCache;
+  class TileCache;
+
   typedef void (*CompositeImageFunc)(
     Image* dst,
     const Image* src,
@@ -86,6 +101,34 @@ namespace render {
     void setOnionskin(const OnionskinOptions& options);
     void disableOnionskin();
 
+    // Enables the tile-parallel mode for renderSprite(): the area is
+    // split in tiles of tileSize x tileSize pixels and each tile is
+    // composited in a pool of the given number of threads. Use
+    // threads <= 1 to disable this mode (the default).
+    void setParallelTiles(const int threads,
+                          const int tileSize = 256);
+
+    // Enables a cache of the composited image of all layers below
+    // the selected layer (see setSelectedLayer()), so when the same
+    // sprite/frame is rendered again (e.g. while we paint in the
+    // selected layer) only the selected layer and the layers above
+    // it are composited. Only available for the new blend method.
+    void setCompositeCache(const bool enabled);
+
+    // Enables a cache of reduced versions of big cel images (see
+    // MipmapCache) to composite them faster when the projection is
+    // zoomed out by a power of two.
+    void setMipmapCache(const bool enabled);
+
+    // Enables a cache of reference layer images scaled down to the
+    // current projection (see ScaledImageCache), so big reference
+    // images don't have to be sampled again on each render.
+    void setScaledImageCache(const bool enabled);
+
+    // Enables a cache of tile images converted to RGB and flipped
+    // (see TileCache) to composite tilemap layers faster.
+    void setTileCache(const bool enabled);
+
     void renderSprite(
       Image* dstImage,
       const Sprite* sprite,
@@ -139,11 +182,34 @@ namespace render {
       const BlendMode blendMode);
 
   private:
+    // Returns the render plan to draw the given layer in the given
+    // frame. Plans are cached until the layers/cels structure changes
+    // (see doc::RenderPlan::structureVersion()), so we don't have to
+    // create and sort the plan on each repaint.
+    std::shared_ptr<const doc::RenderPlan> getRenderPlan(
+      const Layer* layer,
+      frame_t frame);
+
+    void renderSpriteTiles(
+      Image* dstImage,
+      const Sprite* sprite,
+      frame_t frame,
+      const gfx::ClipF& area);
+
     void renderSpriteLayers(
       Image* dstImage,
       const gfx::ClipF& area,
       frame_t frame,
-      CompositeImageFunc compositeImage);
+      CompositeImageFunc compositeImage,
+      const color_t bg_color);
+
+    bool renderSpriteLayersWithCache(
+      const doc::RenderPlan& plan,
+      Image* dstImage,
+      const gfx::ClipF& area,
+      frame_t frame,
+      CompositeImageFunc compositeImage,
+      const color_t bg_color);
 
     void renderBackground(
       Image* image,
@@ -161,15 +227,23 @@ namespace render {
       const frame_t frame,
       const CompositeImageFunc compositeImage);
 
+    // Returns the frames to be composited as onion skin of the given
+    // frame (with their opacity and blend mode).
+    std::vector<OnionskinFrame> getOnionskinFrames(const frame_t frame) const;
+    const Layer* getOnionskinLayer() const;
+
+    // Renders the items of the plan in the [firstItem, endItem) range.
     void renderPlan(
-      doc::RenderPlan& plan,
+      const doc::RenderPlan& plan,
       Image* image,
       const gfx::Clip& area,
       const frame_t frame,
       const CompositeImageFunc compositeImage,
       const bool render_background,
       const bool render_transparent,
-      const BlendMode blendMode);
+      const BlendMode blendMode,
+      const size_t firstItem = 0,
+      const size_t endItem = size_t(-1));
 
     void renderCel(
       Image* dst_image,
@@ -183,6 +257,16 @@ namespace render {
       const int opacity,
       const BlendMode blendMode);
 
+    bool renderScaledImage(
+      Image* dst_image,
+      const Image* cel_image,
+      const Palette* pal,
+      const gfx::RectF& celBounds,
+      const gfx::Clip& area,
+      const CompositeImageFunc compositeImage,
+      const int opacity,
+      const BlendMode blendMode);
+
     void renderImage(
       Image* dst_image,
       const Image* cel_image,
@@ -224,6 +308,15 @@ namespace render {
     BlendMode m_previewBlendMode;
     OnionskinOptions m_onionskin;
     ImageBufferPtr m_tmpBuf;
+    int m_tileSize;
+    std::shared_ptr<base::thread_pool> m_tilesPool;
+    std::shared_ptr<CompositeCache> m_compositeCache;
+    std::shared_ptr<MipmapCache> m_mipmapCache;
+    std::shared_ptr<ScaledImageCache> m_scaledImageCache;
+    std::shared_ptr<TileCache> m_tileCache;
+    std::map<std::pair<const Layer*, frame_t>,
+             std::shared_ptr<const doc::RenderPlan>> m_plans;
+    uint32_t m_plansVersion = 0;
   };
 
   void composite_image(Image* dst,
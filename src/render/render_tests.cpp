@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019-2023 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -17,8 +17,11 @@
 #include "doc/document.h"
 #include "doc/image.h"
 #include "doc/layer.h"
+#include "doc/layer_tilemap.h"
 #include "doc/palette.h"
 #include "doc/primitives.h"
+#include "doc/tileset.h"
+#include "doc/tilesets.h"
 
 #include <memory>
 
@@ -81,6 +84,29 @@ TEST(Render, Basic)
   EXPECT_2X2_PIXELS(dst.get(), 2, 2, 2, 2);
 }
 
+TEST(Render, OpaqueBackgroundLayer)
+{
+  std::shared_ptr<Document> doc = std::make_shared<Document>();
+  doc->sprites().add(Sprite::MakeStdSprite(ImageSpec(ColorMode::RGB, 2, 2)));
+
+  Layer* layer = doc->sprite()->root()->firstLayer();
+  static_cast<LayerImage*>(layer)->configureAsBackground();
+  EXPECT_TRUE(layer->isBackground());
+
+  Image* src = layer->cel(0)->image();
+  clear_image(src, rgba(255, 0, 0, 255));
+  put_pixel(src, 1, 1, rgba(0, 0, 255, 255));
+
+  std::unique_ptr<Image> dst(Image::create(IMAGE_RGB, 2, 2));
+  clear_image(dst.get(), rgba(0, 255, 0, 255));
+
+  Render render;
+  render.renderSprite(dst.get(), doc->sprite(), frame_t(0));
+  EXPECT_2X2_PIXELS(dst.get(),
+                    rgba(255, 0, 0, 255), rgba(255, 0, 0, 255),
+                    rgba(255, 0, 0, 255), rgba(0, 0, 255, 255));
+}
+
 TYPED_TEST(RenderAllModes, CheckDefaultBackgroundMode)
 {
   typedef TypeParam ImageTraits;
@@ -277,6 +303,220 @@ TEST(Render, BugWithMultiplesOf3ZoomFactors)
   }
 }
 
+TEST(Render, CompositeCacheWithOnionskinBehind)
+{
+  std::shared_ptr<Document> doc = std::make_shared<Document>();
+  doc->sprites().add(Sprite::MakeStdSprite(ImageSpec(ColorMode::RGB, 2, 2)));
+  Sprite* sprite = doc->sprite();
+  LayerImage* layer = static_cast<LayerImage*>(sprite->root()->firstLayer());
+  sprite->setTotalFrames(3);
+  clear_image(layer->cel(0)->image(), rgba(255, 0, 0, 255));
+  for (frame_t frame=1; frame<3; ++frame) {
+    ImageRef image(Image::create(IMAGE_RGB, 2, 2));
+    clear_image(image.get(), rgba(0, 0, 255, 255));
+    layer->addCel(new Cel(frame, image));
+  }
+  put_pixel(layer->cel(1)->image(), 0, 0, rgba(0, 0, 0, 0));
+
+  OnionskinOptions opts(OnionskinType::MERGE);
+  opts.position(OnionskinPosition::BEHIND);
+  opts.prevFrames(1);
+  opts.nextFrames(1);
+  opts.opacityBase(255);
+  opts.opacityStep(0);
+
+  Render render;
+  render.setCompositeCache(true);
+  render.setSelectedLayer(layer);
+  render.setBgOptions(BgOptions::MakeTransparent());
+  render.setOnionskin(opts);
+
+  std::unique_ptr<Image> dst(Image::create(IMAGE_RGB, 2, 2));
+  render.renderSprite(dst.get(), sprite, frame_t(1));
+  EXPECT_EQ(rgba(0, 0, 255, 255), get_pixel(dst.get(), 0, 0));
+
+  // Modify the next frame, the cached onion skin must be discarded
+  put_pixel(layer->cel(2)->image(), 0, 0, rgba(0, 0, 0, 0));
+  layer->cel(2)->image()->incrementVersion();
+
+  render.renderSprite(dst.get(), sprite, frame_t(1));
+  EXPECT_EQ(rgba(255, 0, 0, 255), get_pixel(dst.get(), 0, 0));
+  EXPECT_EQ(rgba(0, 0, 255, 255), get_pixel(dst.get(), 1, 1));
+}
+
+TEST(Render, MipmapCacheGivesSameResult)
+{
+  std::shared_ptr<Document> doc = std::make_shared<Document>();
+  doc->sprites().add(Sprite::MakeStdSprite(ImageSpec(ColorMode::RGB, 515, 259)));
+  Image* src = doc->sprite()->root()->firstLayer()->cel(0)->image();
+  for (int y=0; y<src->height(); ++y)
+    for (int x=0; x<src->width(); ++x)
+      put_pixel(src, x, y, rgba(x & 255, y & 255, (x*y) & 255, 255));
+
+  Render render;
+  Render mipmapRender;
+  mipmapRender.setMipmapCache(true);
+
+  for (int zoom : { 2, 4, 8, 16, 32 }) {
+    const int w = src->width() / zoom;
+    const int h = src->height() / zoom;
+    const Projection proj(PixelRatio(1, 1), Zoom(1, zoom));
+    std::unique_ptr<Image> expected(Image::create(IMAGE_RGB, w, h));
+    std::unique_ptr<Image> dst(Image::create(IMAGE_RGB, w, h));
+    clear_image(expected.get(), 0);
+    clear_image(dst.get(), 0);
+
+    render.setProjection(proj);
+    render.renderSprite(expected.get(), doc->sprite(), frame_t(0),
+                        gfx::Clip(0, 0, 0, 0, w, h));
+
+    // Render two times (the second one uses the cached level)
+    for (int i=0; i<2; ++i) {
+      mipmapRender.setProjection(proj);
+      mipmapRender.renderSprite(dst.get(), doc->sprite(), frame_t(0),
+                                gfx::Clip(0, 0, 0, 0, w, h));
+      EXPECT_EQ(0, count_diff_between_images(expected.get(), dst.get()))
+        << " zoom=1/" << zoom << " i=" << i;
+    }
+  }
+
+  // Modify the image (the cached levels must be discarded)
+  clear_image(src, rgba(255, 0, 0, 255));
+  src->incrementVersion();
+
+  std::unique_ptr<Image> dst(Image::create(IMAGE_RGB, 128, 64));
+  mipmapRender.setProjection(Projection(PixelRatio(1, 1), Zoom(1, 4)));
+  mipmapRender.renderSprite(dst.get(), doc->sprite(), frame_t(0),
+                            gfx::Clip(0, 0, 0, 0, 128, 64));
+  EXPECT_EQ(rgba(255, 0, 0, 255), get_pixel(dst.get(), 64, 32));
+}
+
+TEST(Render, TileCacheGivesSameResult)
+{
+  std::shared_ptr<Document> doc = std::make_shared<Document>();
+  doc->sprites().add(Sprite::MakeStdSprite(ImageSpec(ColorMode::RGB, 32, 32)));
+  Sprite* sprite = doc->sprite();
+
+  // Tile 1 is opaque, tile 2 has transparent pixels
+  auto tileset = new Tileset(sprite, Grid(gfx::Size(4, 4)), 3);
+  for (tile_index ti=1; ti<3; ++ti) {
+    ImageRef tile(Image::create(IMAGE_RGB, 4, 4));
+    for (int y=0; y<4; ++y)
+      for (int x=0; x<4; ++x)
+        put_pixel(tile.get(), x, y,
+                  rgba(x*60, y*60, ti*100, (ti == 1 || x > y ? 255: 0)));
+    tileset->set(ti, tile);
+  }
+  const tileset_index tsi = sprite->tilesets()->add(tileset);
+
+  auto layer = new LayerTilemap(sprite, tsi);
+  sprite->root()->addLayer(layer);
+
+  ImageRef tilemap(Image::create(IMAGE_TILEMAP, 8, 8));
+  for (int v=0; v<8; ++v)
+    for (int u=0; u<8; ++u)
+      put_pixel(tilemap.get(), u, v,
+                tile((u+v) % 3, tile_f_mask & ((u*v) << 29)));
+  layer->addCel(new Cel(frame_t(0), tilemap));
+
+  Render render;
+  Render cacheRender;
+  cacheRender.setTileCache(true);
+
+  for (int zoom : { 1, 2, 3 }) {
+    const int w = 32 * zoom;
+    const int h = 32 * zoom;
+    const Projection proj(PixelRatio(1, 1), Zoom(zoom, 1));
+    std::unique_ptr<Image> expected(Image::create(IMAGE_RGB, w, h));
+    std::unique_ptr<Image> dst(Image::create(IMAGE_RGB, w, h));
+    clear_image(expected.get(), 0);
+    clear_image(dst.get(), 0);
+
+    render.setProjection(proj);
+    render.renderSprite(expected.get(), sprite, frame_t(0),
+                        gfx::Clip(0, 0, 0, 0, w, h));
+
+    // Render two times (the second one uses the cached tiles)
+    for (int i=0; i<2; ++i) {
+      cacheRender.setProjection(proj);
+      cacheRender.renderSprite(dst.get(), sprite, frame_t(0),
+                               gfx::Clip(0, 0, 0, 0, w, h));
+      EXPECT_EQ(0, count_diff_between_images(expected.get(), dst.get()))
+        << " zoom=" << zoom << " i=" << i;
+    }
+  }
+}
+
+TEST(Render, ScaledImageCacheGivesSameResult)
+{
+  std::shared_ptr<Document> doc = std::make_shared<Document>();
+  doc->sprites().add(Sprite::MakeStdSprite(ImageSpec(ColorMode::RGB, 64, 48)));
+  Sprite* sprite = doc->sprite();
+
+  // Big reference image scaled down to the canvas
+  ImageRef ref(Image::create(IMAGE_RGB, 1024, 768));
+  for (int y=0; y<ref->height(); ++y)
+    for (int x=0; x<ref->width(); ++x)
+      put_pixel(ref.get(), x, y, rgba(x & 255, y & 255, (x*y) & 255, 255));
+
+  auto layer = new LayerImage(sprite);
+  layer->setReference(true);
+  sprite->root()->addLayer(layer);
+  Cel* cel = new Cel(frame_t(0), ref);
+  layer->addCel(cel);
+
+  Render render;
+  Render cacheRender;
+  render.setRefLayersVisiblity(true);
+  cacheRender.setRefLayersVisiblity(true);
+  cacheRender.setScaledImageCache(true);
+
+  for (const gfx::RectF& bounds : { gfx::RectF(0, 0, 64, 48),
+                                    gfx::RectF(0.5, 0.25, 64, 48),
+                                    gfx::RectF(-8.5, 4.75, 96, 24) }) {
+    cel->setBoundsF(bounds);
+
+    for (const Zoom& zoom : { Zoom(1, 2), Zoom(1, 1), Zoom(2, 1) }) {
+      const Projection proj(PixelRatio(1, 1), zoom);
+      const int w = proj.applyX(64);
+      const int h = proj.applyY(48);
+      std::unique_ptr<Image> expected(Image::create(IMAGE_RGB, w, h));
+      std::unique_ptr<Image> dst(Image::create(IMAGE_RGB, w, h));
+      clear_image(expected.get(), 0);
+      clear_image(dst.get(), 0);
+
+      // Render in tiles (each tile has its own phase in the scaled
+      // image), two times (the second one uses the cached images)
+      render.setProjection(proj);
+      cacheRender.setProjection(proj);
+      for (int i=0; i<2; ++i) {
+        for (int y=0; y<h; y+=h/2) {
+          for (int x=0; x<w; x+=w/2) {
+            const gfx::Clip area(x, y, x, y, w/2, h/2);
+            if (i == 0)
+              render.renderSprite(expected.get(), sprite, frame_t(0), area);
+            cacheRender.renderSprite(dst.get(), sprite, frame_t(0), area);
+          }
+        }
+        EXPECT_EQ(0, count_diff_between_images(expected.get(), dst.get()))
+          << " bounds=" << bounds.x << "," << bounds.y
+          << " zoom=" << zoom.scale() << " i=" << i;
+      }
+    }
+  }
+
+  // Modify the image (the cached images must be discarded)
+  cel->setBoundsF(gfx::RectF(0, 0, 64, 48));
+  clear_image(ref.get(), rgba(255, 0, 0, 255));
+  ref->incrementVersion();
+
+  std::unique_ptr<Image> dst(Image::create(IMAGE_RGB, 64, 48));
+  cacheRender.setProjection(Projection());
+  cacheRender.renderSprite(dst.get(), sprite, frame_t(0),
+                           gfx::Clip(0, 0, 0, 0, 64, 48));
+  EXPECT_EQ(rgba(255, 0, 0, 255), get_pixel(dst.get(), 32, 24));
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
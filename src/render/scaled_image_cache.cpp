@@ -0,0 +1,176 @@
+// Aseprite Render Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "render/scaled_image_cache.h"
+
+#include "doc/image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace render {
+
+using namespace doc;
+
+namespace {
+
+template<typename Pixel>
+void copy_scaled_rows(const Image* src, Image* dst,
+                      const std::vector<int>& cols,
+                      const std::vector<int>& rows)
+{
+  for (int y=0; y<dst->height(); ++y) {
+    auto srcPtr = (const Pixel*)src->getPixelAddress(0, rows[y]);
+    auto dstPtr = (Pixel*)dst->getPixelAddress(0, y);
+    for (int x : cols)
+      *(dstPtr++) = srcPtr[x];
+  }
+}
+
+// Creates the scaled image taking the same source pixels that
+// composite_image_general() takes (nearest neighbor).
+Image* create_scaled_image(const Image* src,
+                           const double sx, const double sy,
+                           const double phaseX, const double phaseY)
+{
+  const double startX = phaseX / sx;
+  const double deltaX = 1.0 / sx;
+
+  std::vector<int> cols;
+  cols.reserve(int(std::ceil(sx * src->width())) + 1);
+  for (int x=0; ; ++x) {
+    const int srcX = int(startX + deltaX*x);
+    if (srcX >= src->width())
+      break;
+    cols.push_back(srcX);
+  }
+
+  std::vector<int> rows;
+  rows.reserve(int(std::ceil(sy * src->height())) + 1);
+  for (int y=0; ; ++y) {
+    const int srcY = int((phaseY + double(y)) / sy);
+    if (srcY >= src->height())
+      break;
+    rows.push_back(srcY);
+  }
+
+  if (cols.empty() || rows.empty() ||
+      int64_t(cols.size()) * int64_t(rows.size()) > ScaledImageCache::kMaxPixels)
+    return nullptr;
+
+  Image* dst = Image::create(src->pixelFormat(),
+                             int(cols.size()), int(rows.size()));
+  dst->setMaskColor(src->maskColor());
+
+  switch (src->bytesPerPixel()) {
+    case 1: copy_scaled_rows<uint8_t>(src, dst, cols, rows); break;
+    case 2: copy_scaled_rows<uint16_t>(src, dst, cols, rows); break;
+    case 4: copy_scaled_rows<uint32_t>(src, dst, cols, rows); break;
+    default:
+      delete dst;
+      return nullptr;
+  }
+  return dst;
+}
+
+} // anonymous namespace
+
+ImageRef ScaledImageCache::get(const Image* image,
+                               const double sx, const double sy,
+                               const double phaseX, const double phaseY)
+{
+  if (sx >= 1.0 || sy >= 1.0 || sx <= 0.0 || sy <= 0.0 ||
+      image->pixelFormat() == IMAGE_BITMAP ||
+      image->pixelFormat() == IMAGE_TILEMAP ||
+      image->width() * image->height() < kMinPixels)
+    return nullptr;
+
+  ImageRef result;
+  bool grown = false;
+  {
+    const std::lock_guard lock(m_mutex);
+
+    // Discard the images scaled with other scales or from an old
+    // version of the image (the phases of the same scale are kept,
+    // as each area can have its own phase).
+    auto it = m_entries.lower_bound(Key(image->id(), -1.0, -1.0, -1.0, -1.0));
+    while (it != m_entries.end() && std::get<0>(it->first) == image->id()) {
+      if (it->second.version != image->version() ||
+          std::get<1>(it->first) != sx ||
+          std::get<2>(it->first) != sy) {
+        if (it->second.image)
+          m_pixels -= it->second.image->width() * it->second.image->height();
+        it = m_entries.erase(it);
+      }
+      else
+        ++it;
+    }
+
+    const Key key(image->id(), sx, sy, phaseX, phaseY);
+    it = m_entries.find(key);
+    if (it != m_entries.end()) {
+      it->second.lastUse = ++m_useCounter;
+      return it->second.image;
+    }
+
+    result.reset(create_scaled_image(image, sx, sy, phaseX, phaseY));
+    if (!result)
+      return nullptr;
+
+    Entry& entry = m_entries[key];
+    entry.version = image->version();
+    entry.image = result;
+    entry.lastUse = ++m_useCounter;
+    m_pixels += result->width() * result->height();
+    shrink();
+    grown = true;
+  }
+
+  // Without the lock as this cache could be released
+  if (grown)
+    check_memory_soft_limit();
+  return result;
+}
+
+void ScaledImageCache::invalidate()
+{
+  const std::lock_guard lock(m_mutex);
+  m_entries.clear();
+  m_pixels = 0;
+}
+
+std::size_t ScaledImageCache::memoryBytes()
+{
+  const std::lock_guard lock(m_mutex);
+  std::size_t bytes = 0;
+  for (const auto& it : m_entries) {
+    if (it.second.image)
+      bytes += it.second.image->getMemSize();
+  }
+  return bytes;
+}
+
+void ScaledImageCache::shrink()
+{
+  while (m_pixels > kMaxPixels && m_entries.size() > 1) {
+    auto lru = std::min_element(
+      m_entries.begin(), m_entries.end(),
+      [](const auto& a, const auto& b){
+        return a.second.lastUse < b.second.lastUse;
+      });
+
+    if (lru->second.image)
+      m_pixels -= lru->second.image->width() * lru->second.image->height();
+    m_entries.erase(lru);
+  }
+}
+
+} // namespace render
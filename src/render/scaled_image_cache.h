@@ -0,0 +1,84 @@
+// Aseprite Render Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef RENDER_SCALED_IMAGE_CACHE_H_INCLUDED
+#define RENDER_SCALED_IMAGE_CACHE_H_INCLUDED
+#pragma once
+
+#include "doc/image_ref.h"
+#include "doc/memory_account.h"
+#include "doc/object_id.h"
+#include "doc/object_version.h"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace doc {
+  class Image;
+}
+
+namespace render {
+
+  // Images of reference layers already scaled down to the current
+  // projection, used by render::Render to composite them 1:1
+  // instead of picking scattered pixels of the (usually huge)
+  // original image on each repaint.
+  //
+  // The pixel (x, y) of a scaled image is the same pixel that
+  // composite_image_general() takes from the original image for the
+  // position (x+phaseX, y+phaseY) of the scaled cel (phaseX/Y are the
+  // fractional part of the composited area origin).
+  //
+  // Scaled images are discarded when the image version or the scale
+  // changes. The cache can be shared between threads.
+  class ScaledImageCache {
+  public:
+    // Images with fewer pixels are not worth to be scaled.
+    static constexpr int kMinPixels = 256*256;
+
+    // Maximum number of pixels of all the scaled images in the cache
+    // (the least recently used images are discarded, and bigger
+    // scaled images are not cached).
+    static constexpr int kMaxPixels = 4096*4096;
+
+    // Returns the image scaled down by (sx, sy) with the given phase,
+    // or nullptr if the original image must be used.
+    doc::ImageRef get(const doc::Image* image,
+                      const double sx, const double sy,
+                      const double phaseX, const double phaseY);
+
+    void invalidate();
+
+    // Memory used by all the scaled images in the cache.
+    std::size_t memoryBytes();
+
+  private:
+    using Key = std::tuple<doc::ObjectId, double, double, double, double>;
+
+    struct Entry {
+      doc::ObjectVersion version = 0;
+      doc::ImageRef image;
+      uint64_t lastUse = 0;
+    };
+
+    void shrink();
+
+    std::mutex m_mutex;
+    std::map<Key, Entry> m_entries;
+    int64_t m_pixels = 0;
+    uint64_t m_useCounter = 0;
+
+    doc::MemoryAccount m_memoryAccount{
+      doc::MemoryPool::RenderCache,
+      [this]{ return memoryBytes(); },
+      [this]{ invalidate(); } };
+  };
+
+} // namespace render
+
+#endif
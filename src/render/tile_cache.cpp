@@ -0,0 +1,176 @@
+// Aseprite Render Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "render/tile_cache.h"
+
+#include "doc/dispatch.h"
+#include "doc/image.h"
+#include "doc/image_impl.h"
+#include "doc/palette.h"
+#include "doc/primitives_fast.h"
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+namespace render {
+
+using namespace doc;
+
+namespace {
+
+template<typename ImageTraits>
+color_t to_rgba(const typename ImageTraits::pixel_t c,
+                const color_t maskColor,
+                const Palette* pal)
+{
+  if (c == maskColor)
+    return 0;
+  if constexpr (std::is_same_v<ImageTraits, RgbTraits>)
+    return c;
+  else if constexpr (std::is_same_v<ImageTraits, GrayscaleTraits>) {
+    const int v = graya_getv(c);
+    return rgba(v, v, v, graya_geta(c));
+  }
+  else if constexpr (std::is_same_v<ImageTraits, IndexedTraits>)
+    return (pal ? pal->getEntry(c): 0);
+  else
+    return 0;
+}
+
+// Same pixel mapping used by the composite function of flipped tiles
+// in render.cpp (first X/Y flips, then the coordinates are swapped
+// for diagonal flips).
+template<typename ImageTraits>
+bool convert_tile_templ(const Image* src, Image* dst,
+                        const tile_flags flags,
+                        const Palette* pal)
+{
+  const int w = dst->width();
+  const int h = dst->height();
+  const color_t maskColor = src->maskColor();
+  bool opaque = true;
+  for (int y=0; y<h; ++y) {
+    auto dstPtr = (RgbTraits::address_t)dst->getPixelAddress(0, y);
+    for (int x=0; x<w; ++x, ++dstPtr) {
+      int u = ((flags & tile_f_xflip) ? w-1-x: x);
+      int v = ((flags & tile_f_yflip) ? h-1-y: y);
+      if (flags & tile_f_dflip)
+        std::swap(u, v);
+
+      *dstPtr = to_rgba<ImageTraits>(
+        get_pixel_fast<ImageTraits>(src, u, v), maskColor, pal);
+      if (rgba_geta(*dstPtr) != 255)
+        opaque = false;
+    }
+  }
+  return opaque;
+}
+
+bool convert_tile(const Image* src, Image* dst,
+                  const tile_flags flags,
+                  const Palette* pal)
+{
+  DOC_DISPATCH_BY_COLOR_MODE(
+    src->colorMode(),
+    convert_tile_templ,
+    src, dst, flags, pal);
+  return false;
+}
+
+} // anonymous namespace
+
+TileCache::Tile TileCache::get(const Image* tileImage,
+                               const tile_flags flags,
+                               const Palette* pal)
+{
+  ASSERT((flags & tile_f_dflip) == 0 ||
+         tileImage->width() == tileImage->height());
+
+  const bool indexed = (tileImage->pixelFormat() == IMAGE_INDEXED);
+  const ObjectId paletteId = (indexed && pal ? pal->id(): 0);
+  const int paletteModifications = (indexed && pal ? pal->getModifications(): 0);
+
+  Tile result;
+  {
+    const std::lock_guard lock(m_mutex);
+
+    Entry& entry = m_entries[Key(tileImage->id(), flags & tile_f_mask)];
+    entry.lastUse = ++m_useCounter;
+    if (entry.tile.image &&
+        entry.version == tileImage->version() &&
+        entry.paletteId == paletteId &&
+        entry.paletteModifications == paletteModifications) {
+      return entry.tile;
+    }
+
+    ImageRef image(Image::create(IMAGE_RGB,
+                                 tileImage->width(),
+                                 tileImage->height()));
+    const bool opaque = convert_tile(tileImage, image.get(), flags, pal);
+
+    if (entry.tile.image)
+      m_pixels -= entry.tile.image->width() * entry.tile.image->height();
+    m_pixels += image->width() * image->height();
+
+    entry.version = tileImage->version();
+    entry.paletteId = paletteId;
+    entry.paletteModifications = paletteModifications;
+    entry.tile.image = image;
+    entry.tile.opaque = opaque;
+
+    result = entry.tile;
+    shrink();
+  }
+
+  // Without the lock as this cache could be released
+  check_memory_soft_limit();
+  return result;
+}
+
+void TileCache::invalidate()
+{
+  const std::lock_guard lock(m_mutex);
+  m_entries.clear();
+  m_pixels = 0;
+}
+
+std::size_t TileCache::memoryBytes()
+{
+  const std::lock_guard lock(m_mutex);
+  return std::size_t(m_pixels) * 4; // RGB tiles
+}
+
+void TileCache::shrink()
+{
+  if (m_pixels <= kMaxPixels)
+    return;
+
+  // Discard the least recently used tiles until we use 3/4 of the
+  // maximum (so we don't shrink the cache for each new tile).
+  std::vector<std::pair<uint64_t, Key>> lru;
+  lru.reserve(m_entries.size());
+  for (const auto& it : m_entries)
+    lru.emplace_back(it.second.lastUse, it.first);
+  std::sort(lru.begin(), lru.end());
+
+  for (const auto& it : lru) {
+    if (m_pixels <= kMaxPixels/4*3)
+      break;
+    auto entry = m_entries.find(it.second);
+    if (entry->second.tile.image) {
+      m_pixels -= entry->second.tile.image->width() *
+                  entry->second.tile.image->height();
+    }
+    m_entries.erase(entry);
+  }
+}
+
+} // namespace render
@@ -0,0 +1,87 @@
+// Aseprite Render Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef RENDER_TILE_CACHE_H_INCLUDED
+#define RENDER_TILE_CACHE_H_INCLUDED
+#pragma once
+
+#include "doc/image_ref.h"
+#include "doc/memory_account.h"
+#include "doc/object_id.h"
+#include "doc/object_version.h"
+#include "doc/tile.h"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace doc {
+  class Image;
+  class Palette;
+}
+
+namespace render {
+
+  // Tile images of tilemap layers already converted to RGB and
+  // flipped with the tile flags, used by render::Render to composite
+  // tilemaps with the fastest RGB -> RGB paths (or copying the pixels
+  // directly when the tile is opaque).
+  //
+  // Tiles are discarded when the image version (or the palette in
+  // case of indexed tiles) changes. The cache can be shared between
+  // threads.
+  class TileCache {
+  public:
+    // Maximum number of pixels of all the tiles in the cache (the
+    // least recently used tiles are discarded).
+    static constexpr int kMaxPixels = 2048*2048;
+
+    struct Tile {
+      doc::ImageRef image;      // RGB image
+      bool opaque = false;      // True if all pixels have alpha=255
+    };
+
+    // Returns the tile image converted to RGB and flipped with the
+    // given flags (diagonal flips are supported only for square
+    // tiles, as render::Render transposes only the square part of
+    // other tiles).
+    Tile get(const doc::Image* tileImage,
+             const doc::tile_flags flags,
+             const doc::Palette* pal);
+
+    void invalidate();
+
+    // Memory used by all the tiles in the cache.
+    std::size_t memoryBytes();
+
+  private:
+    using Key = std::pair<doc::ObjectId, doc::tile_flags>;
+
+    struct Entry {
+      doc::ObjectVersion version = 0;
+      doc::ObjectId paletteId = 0;
+      int paletteModifications = 0;
+      Tile tile;
+      uint64_t lastUse = 0;
+    };
+
+    void shrink();
+
+    std::mutex m_mutex;
+    std::map<Key, Entry> m_entries;
+    int64_t m_pixels = 0;
+    uint64_t m_useCounter = 0;
+
+    doc::MemoryAccount m_memoryAccount{
+      doc::MemoryPool::RenderCache,
+      [this]{ return memoryBytes(); },
+      [this]{ invalidate(); } };
+  };
+
+} // namespace render
+
+#endif
@@ -0,0 +1,153 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef TESTS_BENCHMARK_FIXTURES_H_INCLUDED
+#define TESTS_BENCHMARK_FIXTURES_H_INCLUDED
+#pragma once
+
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/image_ref.h"
+#include "doc/layer.h"
+#include "doc/palette.h"
+#include "doc/primitives.h"
+#include "doc/sprite.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace tests {
+
+  // Small deterministic pseudo-random generator (xorshift32) so the
+  // fixtures are the same in each run/platform.
+  class FixtureRandom {
+  public:
+    FixtureRandom(uint32_t seed) : m_state(seed ? seed: 1) { }
+    uint32_t next() {
+      m_state ^= m_state << 13;
+      m_state ^= m_state >> 17;
+      m_state ^= m_state << 5;
+      return m_state;
+    }
+    int next(int n) { return int(next() % uint32_t(n)); }
+  private:
+    uint32_t m_state;
+  };
+
+  // Returns the color "i" (0-255) of the fixture palette in the given
+  // image format (a ramp of hues and values).
+  inline doc::color_t fixture_color(doc::PixelFormat format, int i) {
+    switch (format) {
+      case doc::IMAGE_RGB: {
+        const int h = (i % 16) * 16;
+        const int v = 64 + (i / 16) * 12;
+        return doc::rgba(std::min(255, (h*v) >> 8),
+                         std::min(255, ((255-h)*v) >> 8),
+                         std::min(255, v),
+                         255);
+      }
+      case doc::IMAGE_GRAYSCALE:
+        return doc::graya(i, 255);
+      case doc::IMAGE_INDEXED:
+        return doc::color_t(std::clamp(i, 1, 255));
+    }
+    return 0;
+  }
+
+  // Draws pixel-art-like content in the image: flat color shapes with
+  // outlines, a dithered area, and some noise. The "seed" changes the
+  // position of the shapes.
+  inline void draw_fixture_image(doc::Image* image, uint32_t seed) {
+    const doc::PixelFormat format = image->pixelFormat();
+    const int w = image->width();
+    const int h = image->height();
+    FixtureRandom rnd(seed);
+
+    doc::clear_image(image, image->maskColor());
+
+    // Background gradient in bands
+    for (int y=0; y<h; y += 4)
+      doc::fill_rect(image, 0, y, w-1, y+3,
+                     fixture_color(format, 16 + (y*32/h)));
+
+    // Shapes
+    const int nshapes = std::max(4, (w*h) / 4096);
+    for (int i=0; i<nshapes; ++i) {
+      const int sw = 4 + rnd.next(std::max(1, w/4));
+      const int sh = 4 + rnd.next(std::max(1, h/4));
+      const int x = rnd.next(w) - sw/2;
+      const int y = rnd.next(h) - sh/2;
+      const doc::color_t c = fixture_color(format, 48 + rnd.next(200));
+      const doc::color_t outline = fixture_color(format, rnd.next(16));
+      if (i & 1) {
+        doc::fill_ellipse(image, x, y, x+sw, y+sh, 0, 0, c);
+        doc::draw_ellipse(image, x, y, x+sw, y+sh, 0, 0, outline);
+      }
+      else {
+        doc::fill_rect(image, x, y, x+sw, y+sh, c);
+        doc::draw_rect(image, x, y, x+sw, y+sh, outline);
+      }
+    }
+
+    // Dithered area and noise
+    const doc::color_t c1 = fixture_color(format, 200);
+    const doc::color_t c2 = fixture_color(format, 220);
+    for (int y=h/2; y<h*3/4; ++y)
+      for (int x=w/2; x<w*3/4; ++x)
+        doc::put_pixel(image, x, y, ((x+y) & 1) ? c1: c2);
+
+    for (int i=0; i<w*h/64; ++i)
+      doc::put_pixel(image, rnd.next(w), rnd.next(h),
+                     fixture_color(format, rnd.next(256)));
+  }
+
+  // Creates a sprite with "nlayers" image layers and "nframes"
+  // frames. One of each four frames repeats the previous frame (so
+  // there are duplicated frames/cels to merge, as in real
+  // animations).
+  inline doc::Sprite* create_fixture_sprite(doc::ColorMode colorMode,
+                                            int w, int h,
+                                            int nframes = 1,
+                                            int nlayers = 1) {
+    doc::Sprite* sprite =
+      doc::Sprite::MakeStdSprite(doc::ImageSpec(colorMode, w, h), 256);
+    sprite->setTotalFrames(doc::frame_t(nframes));
+
+    doc::Palette pal(doc::frame_t(0), 256);
+    for (int i=0; i<256; ++i)
+      pal.setEntry(i, fixture_color(doc::IMAGE_RGB, i));
+    sprite->setPalette(&pal, false);
+
+    for (int l=1; l<nlayers; ++l) {
+      auto layer = new doc::LayerImage(sprite);
+      sprite->root()->addLayer(layer);
+    }
+
+    int l = 0;
+    for (doc::Layer* layer : sprite->allLayers()) {
+      auto layerImage = static_cast<doc::LayerImage*>(layer);
+      for (doc::frame_t f=0; f<nframes; ++f) {
+        doc::Cel* cel = layerImage->cel(f);
+        doc::ImageRef image;
+        if (cel)
+          image = cel->imageRef();
+        else {
+          image.reset(doc::Image::create(sprite->spec()));
+          cel = new doc::Cel(f, image);
+          layerImage->addCel(cel);
+        }
+
+        const uint32_t seed = uint32_t((l+1)*1000 + (f - (f % 4 == 3 ? 1: 0)));
+        draw_fixture_image(image.get(), seed);
+      }
+      ++l;
+    }
+    return sprite;
+  }
+
+} // namespace tests
+
+#endif
@@ -31,7 +31,10 @@
 
 #include <algorithm>
 #include <cctype>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
 
 namespace ui {
 
@@ -411,6 +414,58 @@ private:
   gfx::Rect m_bounds;
 };
 
+// Widths of the strings measured with
+// Graphics::measureUITextLength(), as the same labels are measured
+// again in each paint and size hint calculation. Each entry keeps a
+// reference to its font so the os::Font* key cannot be reused by
+// other font.
+class UITextLengthCache {
+public:
+  // Maximum number of entries before the whole cache is discarded.
+  static constexpr size_t kMaxEntries = 16384;
+
+  bool find(os::Font* font, const std::string& str, int& length) {
+    const std::lock_guard lock(m_mutex);
+    auto it = m_entries.find(Key(font, str));
+    if (it == m_entries.end())
+      return false;
+    length = it->second.length;
+    return true;
+  }
+
+  void clear() {
+    const std::lock_guard lock(m_mutex);
+    m_entries.clear();
+  }
+
+  void insert(os::Font* font, const std::string& str, const int length) {
+    const std::lock_guard lock(m_mutex);
+    if (m_entries.size() >= kMaxEntries)
+      m_entries.clear();
+    m_entries[Key(font, str)] = Entry{ AddRef(font), length };
+  }
+
+private:
+  using Key = std::pair<os::Font*, std::string>;
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      return (std::hash<std::string>()(key.second) ^
+              (std::hash<os::Font*>()(key.first) << 1));
+    }
+  };
+
+  struct Entry {
+    os::FontRef font;
+    int length;
+  };
+
+  std::mutex m_mutex;
+  std::unordered_map<Key, Entry, KeyHash> m_entries;
+};
+
+UITextLengthCache g_uiTextLengthCache;
+
 }
 
 void Graphics::drawUIText(const std::string& str, gfx::Color fg, gfx::Color bg,
@@ -443,11 +498,24 @@ gfx::Size Graphics::measureUIText(const std::string& str)
 // static
 int Graphics::measureUITextLength(const std::string& str, os::Font* font)
 {
+  int length;
+  if (g_uiTextLengthCache.find(font, str, length))
+    return length;
+
   DrawUITextDelegate delegate(nullptr, font, 0);
   os::draw_text(nullptr, font, str,
                 gfx::ColorNone, gfx::ColorNone, 0, 0,
                 &delegate);
-  return delegate.bounds().w;
+  length = delegate.bounds().w;
+
+  g_uiTextLengthCache.insert(font, str, length);
+  return length;
+}
+
+// static
+void Graphics::clearUITextLengthCache()
+{
+  g_uiTextLengthCache.clear();
 }
 
 gfx::Size Graphics::fitString(const std::string& str, int maxWidth, int align)
@@ -112,6 +112,7 @@ namespace ui {
 
     gfx::Size measureUIText(const std::string& str);
     static int measureUITextLength(const std::string& str, os::Font* font);
+    static void clearUITextLengthCache();
     gfx::Size fitString(const std::string& str, int maxWidth, int align);
 
     // Can be used in case that you've accessed/changed the
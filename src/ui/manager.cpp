@@ -11,6 +11,7 @@
 // #define LIMIT_DISPATCH_TIME
 // #define DEBUG_UI_THREADS
 #define GARBAGE_TRACE(...)
+#define FRAME_TRACE(...)
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -60,6 +61,7 @@ enum class RedrawState {
    Normal,
    AWindowHasJustBeenClosed,
    RedrawDelayed,
+   WaitingNextFrame,
    ClosingApp,
 };
 RedrawState redrawState = RedrawState::Normal;
@@ -412,9 +414,19 @@ void Manager::generateMessagesFromOSEvents()
     // Calculate how much time we can wait for the next message in the
     // event queue.
     double timeout = 0.0;
-    if (msg_queue.empty() && redrawState == RedrawState::Normal) {
-      if (!Timer::getNextTimeout(timeout))
-        timeout = os::EventQueue::kWithoutTimeout;
+    if (msg_queue.empty()) {
+      if (redrawState == RedrawState::Normal) {
+        if (!Timer::getNextTimeout(timeout))
+          timeout = os::EventQueue::kWithoutTimeout;
+      }
+      // Wait the next frame (or the next timer) to paint the
+      // invalidated regions.
+      else if (redrawState == RedrawState::WaitingNextFrame &&
+               !isNextFrameDue(timeout)) {
+        double timerTimeout;
+        if (Timer::getNextTimeout(timerTimeout))
+          timeout = std::min(timeout, timerTimeout);
+      }
     }
 
     if (timeout == os::EventQueue::kWithoutTimeout && used_msg_queue.empty())
@@ -863,7 +875,9 @@ void Manager::dispatchMessages()
   // might change the state of widgets, etc. In case pumpQueue()
   // returns a number greater than 0, it means that we've processed
   // some messages, so we've to redraw the screen.
-  if (pumpQueue() > 0 || redrawState == RedrawState::RedrawDelayed) {
+  if (pumpQueue() > 0 ||
+      redrawState == RedrawState::RedrawDelayed ||
+      redrawState == RedrawState::WaitingNextFrame) {
     if (redrawState == RedrawState::ClosingApp) {
       // Do nothing, we don't flush nor process paint messages
     }
@@ -875,17 +889,65 @@ void Manager::dispatchMessages()
       redrawState = RedrawState::RedrawDelayed;
     }
     else {
-      if (redrawState == RedrawState::RedrawDelayed)
+      double timeout;
+      if (isNextFrameDue(timeout)) {
         redrawState = RedrawState::Normal;
+        paintFrame();
+      }
+      // Too soon to paint a new frame, the invalid regions will be
+      // accumulated and painted in the next one.
+      else if (redrawState != RedrawState::WaitingNextFrame) {
+        redrawState = RedrawState::WaitingNextFrame;
+        ++m_frameStats.delayedFrames;
+      }
+    }
+  }
+}
 
-      // Generate and send just kPaintMessages with the latest UI state.
-      flushRedraw();
-      pumpQueue();
+void Manager::setMaxFrameRate(int fps)
+{
+  m_maxFrameRate = std::max(0, fps);
+}
 
-      // Flip back-buffers to real displays.
-      flipAllDisplays();
-    }
+bool Manager::isNextFrameDue(double& timeout) const
+{
+  if (m_maxFrameRate <= 0) {
+    timeout = 0.0;
+    return true;
   }
+
+  const int64_t frameInterval = 1000 / m_maxFrameRate;
+  const int64_t elapsed = base::current_tick() - m_lastFrameTick;
+  if (elapsed >= frameInterval) {
+    timeout = 0.0;
+    return true;
+  }
+  timeout = (frameInterval - elapsed) / 1000.0;
+  return false;
+}
+
+void Manager::paintFrame()
+{
+  const base::tick_t t0 = base::current_tick();
+
+  // Generate and send just kPaintMessages with the latest UI state.
+  flushRedraw();
+  pumpQueue();
+
+  // Flip back-buffers to real displays.
+  flipAllDisplays();
+
+  const base::tick_t t1 = base::current_tick();
+  const int frameTime = int(t1 - t0);
+  m_lastFrameTick = t0;
+  ++m_frameStats.frames;
+  m_frameStats.lastFrameTime = frameTime;
+  m_frameStats.maxFrameTime = std::max(m_frameStats.maxFrameTime, frameTime);
+
+  FRAME_TRACE("Manager::paintFrame() #%d %dms (max=%dms delayed=%d)\n",
+              m_frameStats.frames, frameTime,
+              m_frameStats.maxFrameTime,
+              m_frameStats.delayedFrames);
 }
 
 void Manager::addToGarbage(Widget* widget)
@@ -1660,6 +1722,10 @@ bool Manager::onProcessMessage(Message* msg)
 
     case kResizeDisplayMessage:
       onNewDisplayConfiguration(msg->display());
+
+      // Paint the resized display right now, without waiting the
+      // next frame (e.g. in live resize the main loop isn't running).
+      m_lastFrameTick = 0;
       break;
 
     case kKeyDownMessage:
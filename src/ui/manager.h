@@ -9,6 +9,7 @@
 #define UI_MANAGER_H_INCLUDED
 #pragma once
 
+#include "base/time.h"
 #include "gfx/region.h"
 #include "ui/display.h"
 #include "ui/keys.h"
@@ -44,12 +45,30 @@ namespace ui {
     void run();
 
     // Refreshes all real displays with the UI content.
-    void flipAllDisplays();
+    virtual void flipAllDisplays();
 
     // Updates the scale and GPU acceleration flag of all native
     // windows.
     void updateAllDisplays(int scale, bool gpu);
 
+    // Limits the number of frames per second painted and flipped to
+    // the displays (e.g. to the refresh rate of the screen). All the
+    // regions invalidated in the meantime are painted together in
+    // the next frame. Zero means no limit (each batch of dispatched
+    // messages is painted as soon as possible).
+    void setMaxFrameRate(int fps);
+    int maxFrameRate() const { return m_maxFrameRate; }
+
+    // Time spent painting/flipping frames (in milliseconds).
+    struct FrameStats {
+      int frames = 0;           // Painted frames
+      int delayedFrames = 0;    // Redraws merged with the next frame
+      int lastFrameTime = 0;
+      int maxFrameTime = 0;
+    };
+    const FrameStats& frameStats() const { return m_frameStats; }
+    void resetFrameStats() { m_frameStats = FrameStats(); }
+
     // Adds the given "msg" message to the queue of messages to be
     // dispached. "msg" cannot be used after this function, it'll be
     // automatically deleted.
@@ -159,6 +178,8 @@ namespace ui {
                             Display* display);
 
     int pumpQueue();
+    bool isNextFrameDue(double& timeout) const;
+    void paintFrame();
     bool sendMessageToWidget(Message* msg, Widget* widget);
 
     static Widget* findLowestCommonAncestor(Widget* a, Widget* b);
@@ -189,6 +210,11 @@ namespace ui {
 
     // Last pressed mouse button.
     MouseButton m_mouseButton;
+
+    // Frame pacing (see setMaxFrameRate())
+    int m_maxFrameRate = 0;
+    base::tick_t m_lastFrameTick = 0;
+    FrameStats m_frameStats;
   };
 
 } // namespace ui
@@ -16,6 +16,7 @@
 #include "os/font.h"
 #include "os/surface.h"
 #include "os/system.h"
+#include "ui/graphics.h"
 #include "ui/intern.h"
 #include "ui/manager.h"
 #include "ui/paint_event.h"
@@ -29,6 +30,9 @@
 
 #include <algorithm>
 #include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 
 namespace ui {
 
@@ -96,6 +100,112 @@ getDrawSurfaceFunction(Graphics* g, os::Surface* sheet, gfx::Color color)
     };
 }
 
+// Nine-slices rendered with a specific size and color, so skin parts
+// that are painted again and again with the same size (buttons,
+// tabs, check boxes, etc.) can be drawn with just one blit. Entries
+// are evicted in LRU order when the cache exceeds kMaxPixels.
+class SlicesCache {
+public:
+  // Only nine-slices of this size or smaller are cached
+  static constexpr int kMaxEntryPixels = 256*256;
+  static constexpr int kMaxPixels = 16*kMaxEntryPixels;
+
+  os::SurfaceRef get(os::Surface* sheet,
+                     const gfx::Rect& sprite,
+                     const gfx::Rect& slices,
+                     const gfx::Size& size,
+                     const gfx::Color color,
+                     const bool drawCenter) {
+    const int pixels = size.w*size.h;
+    if (pixels <= 0 || pixels > kMaxEntryPixels)
+      return nullptr;
+
+    const Key key{ sheet, sprite, slices, size, color, drawCenter };
+    const std::lock_guard lock(m_mutex);
+
+    auto it = m_map.find(key);
+    if (it != m_map.end()) {
+      m_lru.splice(m_lru.begin(), m_lru, it->second);
+      return it->second->surface;
+    }
+
+    os::SurfaceRef surface = os::instance()->makeRgbaSurface(size.w, size.h);
+    surface->clear();
+    {
+      Paint paint;
+      paint.color(color);
+      os::SurfaceLock lockSrc(sheet);
+      os::SurfaceLock lockDst(surface.get());
+      surface->drawSurfaceNine(sheet, sprite, slices, gfx::Rect(size),
+                               drawCenter, &paint);
+    }
+
+    // The entry keeps a reference to the sheet so the os::Surface*
+    // key cannot be reused by other surface.
+    m_lru.push_front(Entry{ key, AddRef(sheet), surface });
+    m_map[key] = m_lru.begin();
+    m_pixels += pixels;
+
+    while (m_pixels > kMaxPixels) {
+      const Entry& last = m_lru.back();
+      m_pixels -= last.key.size.w*last.key.size.h;
+      m_map.erase(last.key);
+      m_lru.pop_back();
+    }
+    return surface;
+  }
+
+  void clear() {
+    const std::lock_guard lock(m_mutex);
+    m_map.clear();
+    m_lru.clear();
+    m_pixels = 0;
+  }
+
+private:
+  struct Key {
+    os::Surface* sheet;
+    gfx::Rect sprite;
+    gfx::Rect slices;
+    gfx::Size size;
+    gfx::Color color;
+    bool drawCenter;
+
+    bool operator==(const Key& o) const {
+      return (sheet == o.sheet &&
+              sprite == o.sprite &&
+              slices == o.slices &&
+              size == o.size &&
+              color == o.color &&
+              drawCenter == o.drawCenter);
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      size_t h = std::hash<os::Surface*>()(key.sheet);
+      for (int v : { key.sprite.x, key.sprite.y, key.sprite.w, key.sprite.h,
+                     key.slices.x, key.slices.y, key.slices.w, key.slices.h,
+                     key.size.w, key.size.h, int(key.drawCenter) })
+        h = h*31 + size_t(v);
+      return h*31 + size_t(key.color);
+    }
+  };
+
+  struct Entry {
+    Key key;
+    os::SurfaceRef sheet;
+    os::SurfaceRef surface;
+  };
+
+  std::mutex m_mutex;
+  std::list<Entry> m_lru;       // Most recently used entries first
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> m_map;
+  int m_pixels = 0;
+};
+
+SlicesCache g_slicesCache;
+
 } // anonymous namespace
 
 PaintWidgetPartInfo::PaintWidgetPartInfo()
@@ -780,6 +890,12 @@ void set_theme(Theme* theme, const int uiscale)
   old_ui_scale = current_ui_scale;
   current_ui_scale = uiscale;
 
+  // Text measured with the fonts of the previous theme/scale
+  Graphics::clearUITextLengthCache();
+
+  // Nine-slices rendered with the sheets of the previous theme
+  g_slicesCache.clear();
+
   if (theme) {
     theme->regenerateTheme();
 
@@ -821,6 +937,12 @@ void Theme::drawSlices(Graphics* g, os::Surface* sheet,
                        const gfx::Color color,
                        const bool drawCenter)
 {
+  if (os::SurfaceRef surface =
+        g_slicesCache.get(sheet, sprite, slices, rc.size(), color, drawCenter)) {
+    g->drawRgbaSurface(surface.get(), rc.x, rc.y);
+    return;
+  }
+
   Paint paint;
   paint.color(color);
   g->drawSurfaceNine(sheet, sprite, slices, rc, drawCenter, &paint);
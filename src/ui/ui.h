@@ -1,5 +1,5 @@
 // Aseprite UI Library
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -68,6 +68,7 @@
 #include "ui/tooltips.h"
 #include "ui/view.h"
 #include "ui/viewport.h"
+#include "ui/virtual_listbox.h"
 #include "ui/widget.h"
 #include "ui/widget_type.h"
 #include "ui/widgets_list.h"
@@ -1,5 +1,5 @@
 // Aseprite UI Library
-// Copyright (C) 2018-2022  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -304,6 +304,8 @@ void View::onSetViewScroll(const gfx::Point& pt)
 
   // Move attached widget
   updateAttachedWidgetBounds(newScroll);
+  if (auto viewable = dynamic_cast<ViewableWidget*>(attachedWidget()))
+    viewable->onViewScrollChange();
 
   // Change scroll bar positions
   m_scrollbar_h.setPos(newScroll.x);
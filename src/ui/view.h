@@ -1,5 +1,5 @@
 // Aseprite UI Library
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -22,6 +22,8 @@ namespace ui {
   public:
     virtual ~ViewableWidget() { }
     virtual void onScrollRegion(ScrollRegionEvent& ev) = 0;
+    // Called after the widget was moved to the new scroll position.
+    virtual void onViewScrollChange() { }
   };
 
   class View : public Widget
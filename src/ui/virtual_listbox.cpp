@@ -0,0 +1,401 @@
+// Aseprite UI Library
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "ui/virtual_listbox.h"
+
+#include "os/window.h"
+#include "ui/display.h"
+#include "ui/listitem.h"
+#include "ui/manager.h"
+#include "ui/message.h"
+#include "ui/resize_event.h"
+#include "ui/size_hint_event.h"
+#include "ui/system.h"
+#include "ui/theme.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace ui {
+
+using namespace gfx;
+
+VirtualListBox::VirtualListBox(Model* model)
+  : Widget(kListBoxWidget)
+  , m_model(model)
+  , m_selectedIndex(-1)
+  , m_itemHeight(0)
+  , m_itemMaxWidth(0)
+{
+  setFocusStop(true);
+  initTheme();
+}
+
+void VirtualListBox::setModel(Model* model)
+{
+  m_model = model;
+  modelChanged();
+}
+
+void VirtualListBox::modelChanged()
+{
+  for (auto& it : m_items)
+    deleteItem(it.second);
+  m_items.clear();
+
+  m_selectedIndex = -1;
+  m_itemHeight = 0;
+  m_itemMaxWidth = 0;
+  invalidateSizeHint();
+}
+
+void VirtualListBox::selectIndex(int index)
+{
+  if (index < -1 || index >= listSize())
+    index = -1;
+
+  if (m_selectedIndex == index)
+    return;
+
+  if (ListItem* item = getItem(m_selectedIndex))
+    item->setSelected(false);
+
+  m_selectedIndex = index;
+
+  if (ListItem* item = getItem(m_selectedIndex))
+    item->setSelected(true);
+
+  if (index >= 0)
+    makeIndexVisible(index);
+
+  onChange();
+}
+
+ListItem* VirtualListBox::getItem(int index) const
+{
+  auto it = m_items.find(index);
+  if (it != m_items.end())
+    return it->second;
+  else
+    return nullptr;
+}
+
+void VirtualListBox::makeIndexVisible(int index)
+{
+  View* view = View::getView(this);
+  if (!view || index < 0 || index >= listSize())
+    return;
+
+  gfx::Point scroll = view->viewScroll();
+  gfx::Rect vp = view->viewportBounds();
+  gfx::Rect rc = itemBounds(index);
+
+  if (rc.y < vp.y)
+    scroll.y = rc.y - bounds().y;
+  else if (rc.y > vp.y + vp.h - rc.h)
+    scroll.y = (rc.y - bounds().y
+                - vp.h + rc.h);
+
+  view->setViewScroll(scroll);
+}
+
+// Setup the scroll to center the selected item in the viewport
+void VirtualListBox::centerScroll()
+{
+  View* view = View::getView(this);
+  if (view && m_selectedIndex >= 0) {
+    gfx::Rect vp = view->viewportBounds();
+    gfx::Point scroll = view->viewScroll();
+    gfx::Rect rc = itemBounds(m_selectedIndex);
+
+    scroll.y = ((rc.y - bounds().y)
+                - vp.h/2 + rc.h/2);
+
+    view->setViewScroll(scroll);
+  }
+}
+
+bool VirtualListBox::onProcessMessage(Message* msg)
+{
+  switch (msg->type()) {
+
+    case kOpenMessage:
+      centerScroll();
+      break;
+
+    case kMouseDownMessage:
+      captureMouse();
+      [[fallthrough]];
+
+    case kMouseMoveMessage:
+      if (hasCapture()) {
+        gfx::Point screenPos = msg->display()->nativeWindow()->pointToScreen(static_cast<MouseMessage*>(msg)->position());
+        gfx::Point mousePos = display()->nativeWindow()->pointFromScreen(screenPos);
+        const int n = listSize();
+        int select = indexAtPosition(mousePos);
+
+        if (View* view = View::getView(this)) {
+          gfx::Rect vp = view->viewportBounds();
+
+          if (mousePos.y < vp.y) {
+            const int num = std::max(1, (vp.y - mousePos.y) / 8);
+            select = std::max(0, m_selectedIndex - num);
+          }
+          else if (mousePos.y >= vp.y + vp.h) {
+            const int num = std::max(1, (mousePos.y - (vp.y+vp.h-1)) / 8);
+            select = std::min(n-1, m_selectedIndex + num);
+          }
+        }
+
+        if (select >= 0)
+          selectIndex(select);
+      }
+      return true;
+
+    case kMouseUpMessage:
+      if (hasCapture())
+        releaseMouse();
+      return true;
+
+    case kMouseWheelMessage: {
+      View* view = View::getView(this);
+      if (view) {
+        auto mouseMsg = static_cast<MouseMessage*>(msg);
+        gfx::Point scroll = view->viewScroll();
+
+        if (mouseMsg->preciseWheel())
+          scroll += mouseMsg->wheelDelta();
+        else
+          scroll += mouseMsg->wheelDelta() * textHeight()*3;
+
+        view->setViewScroll(scroll);
+      }
+      break;
+    }
+
+    case kKeyDownMessage:
+      if (hasFocus() && listSize() > 0) {
+        int select = m_selectedIndex;
+        const int bottom = listSize()-1;
+        View* view = View::getView(this);
+        KeyMessage* keymsg = static_cast<KeyMessage*>(msg);
+        KeyScancode scancode = keymsg->scancode();
+
+        if (keymsg->onlyCmdPressed()) {
+          if (scancode == kKeyUp) scancode = kKeyHome;
+          if (scancode == kKeyDown) scancode = kKeyEnd;
+        }
+
+        switch (scancode) {
+          case kKeyUp:
+            // Select previous element (or the bottom of the list if
+            // there is no selected item).
+            select = (select > 0 ? select-1: bottom);
+            break;
+          case kKeyDown:
+            select = (select < bottom ? select+1: 0);
+            break;
+          case kKeyHome:
+            select = 0;
+            break;
+          case kKeyEnd:
+            select = bottom;
+            break;
+          case kKeyPageUp:
+            if (view)
+              select -= std::max(1, view->viewportBounds().h / itemStep());
+            else
+              select = 0;
+            break;
+          case kKeyPageDown:
+            if (view)
+              select += std::max(1, view->viewportBounds().h / itemStep());
+            else
+              select = bottom;
+            break;
+          case kKeyLeft:
+          case kKeyRight:
+            if (view) {
+              gfx::Rect vp = view->viewportBounds();
+              gfx::Point scroll = view->viewScroll();
+              int sgn = (keymsg->scancode() == kKeyLeft) ? -1: 1;
+
+              scroll.x += vp.w/2*sgn;
+
+              view->setViewScroll(scroll);
+            }
+            break;
+          default:
+            return Widget::onProcessMessage(msg);
+        }
+
+        selectIndex(std::clamp(select, 0, bottom));
+        return true;
+      }
+      break;
+
+    case kDoubleClickMessage:
+      onDoubleClickItem();
+      return true;
+  }
+
+  return Widget::onProcessMessage(msg);
+}
+
+void VirtualListBox::onPaint(PaintEvent& ev)
+{
+  theme()->paintListBox(ev);
+}
+
+void VirtualListBox::onResize(ResizeEvent& ev)
+{
+  setBoundsQuietly(ev.bounds());
+  updateItems(true);
+}
+
+void VirtualListBox::onSizeHint(SizeHintEvent& ev)
+{
+  const int n = listSize();
+  int h = 0;
+  if (n > 0)
+    h = n*itemStep() - childSpacing();
+
+  ev.setSizeHint(Size(m_itemMaxWidth + border().width(),
+                      h + border().height()));
+}
+
+void VirtualListBox::onInitTheme(InitThemeEvent& ev)
+{
+  Widget::onInitTheme(ev);
+
+  // Re-calculate the height of rows with the new theme
+  m_itemHeight = 0;
+  m_itemMaxWidth = 0;
+}
+
+void VirtualListBox::onChange()
+{
+  Change();
+}
+
+void VirtualListBox::onDoubleClickItem()
+{
+  DoubleClickItem();
+}
+
+void VirtualListBox::onViewScrollChange()
+{
+  updateItems(false);
+}
+
+int VirtualListBox::listSize() const
+{
+  return (m_model ? m_model->listSize(): 0);
+}
+
+int VirtualListBox::itemStep()
+{
+  // Use the first row to calculate the height of all rows
+  if (m_itemHeight == 0 && listSize() > 0) {
+    std::unique_ptr<ListItem> item(m_model->createListItem(0));
+    addChild(item.get());
+    const Size sz = item->sizeHint();
+    removeChild(item.get());
+
+    m_itemHeight = std::max(1, sz.h);
+    m_itemMaxWidth = std::max(m_itemMaxWidth, sz.w);
+  }
+  return m_itemHeight + childSpacing();
+}
+
+gfx::Rect VirtualListBox::itemBounds(int index)
+{
+  const int step = itemStep();
+  const Rect cpos = childrenBounds();
+  return Rect(cpos.x, cpos.y + index*step, cpos.w, m_itemHeight);
+}
+
+int VirtualListBox::indexAtPosition(const gfx::Point& pos)
+{
+  const Rect cpos = childrenBounds();
+  if (listSize() == 0 || pos.y < cpos.y)
+    return -1;
+
+  const int index = (pos.y - cpos.y) / itemStep();
+  return (index < listSize() ? index: -1);
+}
+
+void VirtualListBox::updateItems(const bool relayoutAll)
+{
+  const int n = listSize();
+  int first = 0;
+  int last = -1;
+
+  // Range of rows inside the viewport
+  if (n > 0) {
+    const int step = itemStep();
+    const Rect cpos = childrenBounds();
+    Rect visible = cpos;
+    if (View* view = View::getView(this))
+      visible &= view->viewportBounds();
+
+    if (!visible.isEmpty()) {
+      first = std::clamp((visible.y - cpos.y) / step, 0, n-1);
+      last = std::clamp((visible.y2() - 1 - cpos.y) / step, 0, n-1);
+    }
+  }
+
+  // Delete items of rows that are not visible anymore
+  for (auto it=m_items.begin(); it!=m_items.end(); ) {
+    if (it->first < first || it->first > last) {
+      deleteItem(it->second);
+      it = m_items.erase(it);
+    }
+    else
+      ++it;
+  }
+
+  // Create items for the new visible rows
+  const int oldMaxWidth = m_itemMaxWidth;
+  for (int i=first; i<=last; ++i) {
+    auto it = m_items.find(i);
+    if (it == m_items.end()) {
+      ListItem* item = m_model->createListItem(i);
+      addChild(item);
+      if (i == m_selectedIndex)
+        item->setSelected(true);
+
+      m_itemMaxWidth = std::max(m_itemMaxWidth, item->sizeHint().w);
+      item->setBounds(itemBounds(i));
+      m_items[i] = item;
+    }
+    else if (relayoutAll) {
+      it->second->setBounds(itemBounds(i));
+    }
+  }
+
+  // Our size hint includes the width of the widest created item
+  if (m_itemMaxWidth != oldMaxWidth)
+    invalidateSizeHint();
+}
+
+void VirtualListBox::deleteItem(ListItem* item)
+{
+  removeChild(item);
+
+  // Items can be deleted while they are processing a message
+  // (e.g. a click that scrolls the list), so we delete them later.
+  if (Manager* man = manager())
+    man->addToGarbage(item);
+  else
+    delete item;
+}
+
+} // namespace ui
@@ -0,0 +1,90 @@
+// Aseprite UI Library
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef UI_VIRTUAL_LISTBOX_H_INCLUDED
+#define UI_VIRTUAL_LISTBOX_H_INCLUDED
+#pragma once
+
+#include "obs/signal.h"
+#include "ui/view.h"
+#include "ui/widget.h"
+
+#include <map>
+
+namespace ui {
+
+  class ListItem;
+
+  // A list box for lists with thousands of rows. ListItem widgets
+  // are created (by the Model) only for the rows that are visible in
+  // the View where the list is attached. All rows have the same
+  // height (the height of the first row).
+  class VirtualListBox : public Widget
+                       , public ViewableWidget {
+  public:
+    class Model {
+    public:
+      virtual ~Model() { }
+      virtual int listSize() const = 0;
+      virtual ListItem* createListItem(int index) = 0;
+    };
+
+    VirtualListBox(Model* model = nullptr);
+
+    Model* model() const { return m_model; }
+    void setModel(Model* model);
+
+    // Must be called when the rows of the model change (e.g. the
+    // list is filtered). Deletes all created items and deselects the
+    // selected row.
+    void modelChanged();
+
+    int getSelectedIndex() const { return m_selectedIndex; }
+    void selectIndex(int index);
+
+    // Returns the item of the given row if it's visible (nullptr if
+    // it wasn't created).
+    ListItem* getItem(int index) const;
+
+    void makeIndexVisible(int index);
+    void centerScroll();
+
+    obs::signal<void()> Change;
+    obs::signal<void()> DoubleClickItem;
+
+  protected:
+    bool onProcessMessage(Message* msg) override;
+    void onPaint(PaintEvent& ev) override;
+    void onResize(ResizeEvent& ev) override;
+    void onSizeHint(SizeHintEvent& ev) override;
+    void onInitTheme(InitThemeEvent& ev) override;
+    virtual void onChange();
+    virtual void onDoubleClickItem();
+
+    // ViewableWidget impl
+    void onScrollRegion(ScrollRegionEvent& ev) override { }
+    void onViewScrollChange() override;
+
+  private:
+    int listSize() const;
+    int itemStep();
+    gfx::Rect itemBounds(int index);
+    int indexAtPosition(const gfx::Point& pos);
+    void updateItems(const bool relayoutAll);
+    void deleteItem(ListItem* item);
+
+    Model* m_model;
+    int m_selectedIndex;
+    int m_itemHeight;
+    int m_itemMaxWidth;
+
+    // Created items for the visible rows (index -> item)
+    std::map<int, ListItem*> m_items;
+  };
+
+} // namespace ui
+
+#endif
@@ -0,0 +1,66 @@
+// Aseprite UI Library
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#define TEST_GUI
+#include "tests/app_test.h"
+
+using namespace gfx;
+using namespace ui;
+
+namespace {
+
+class TestModel : public VirtualListBox::Model {
+public:
+  int size = 1000;
+  int created = 0;
+
+  int listSize() const override { return size; }
+  ListItem* createListItem(int index) override {
+    ++created;
+    auto item = new ListItem;
+    item->setMinSize(Size(20, 10));
+    return item;
+  }
+};
+
+} // anonymous namespace
+
+TEST(VirtualListBox, CreateOnlyVisibleItems)
+{
+  TestModel model;
+  VirtualListBox listbox(&model);
+  listbox.setBorder(gfx::Border(0));
+  listbox.setChildSpacing(0);
+  listbox.modelChanged();
+
+  EXPECT_EQ(Size(20, 10000), listbox.sizeHint());
+
+  // Without a View all the rows inside the bounds are visible
+  listbox.setBounds(Rect(0, 0, 20, 35));
+  EXPECT_EQ(4, int(listbox.children().size()));
+  EXPECT_NE(nullptr, listbox.getItem(3));
+  EXPECT_EQ(nullptr, listbox.getItem(4));
+  EXPECT_EQ(Rect(0, 30, 20, 10), listbox.getItem(3)->bounds());
+
+  // Bounds of a scrolled list
+  listbox.setBounds(Rect(0, -500, 20, 600));
+  EXPECT_EQ(60, int(listbox.children().size()));
+  EXPECT_NE(nullptr, listbox.getItem(0));
+  EXPECT_NE(nullptr, listbox.getItem(59));
+  EXPECT_EQ(Rect(0, -500, 20, 10), listbox.getItem(0)->bounds());
+
+  listbox.selectIndex(2);
+  EXPECT_EQ(2, listbox.getSelectedIndex());
+  EXPECT_TRUE(listbox.getItem(2)->isSelected());
+  EXPECT_FALSE(listbox.getItem(1)->isSelected());
+
+  // Filter the model
+  model.size = 10;
+  listbox.modelChanged();
+  EXPECT_EQ(-1, listbox.getSelectedIndex());
+  EXPECT_EQ(0, int(listbox.children().size()));
+  EXPECT_EQ(Size(20, 100), listbox.sizeHint());
+}
@@ -49,6 +49,11 @@ namespace ui {
 
 using namespace gfx;
 
+// Nesting level and ID of the active Widget::SizeHintCache (zero
+// means that there is no active cache).
+static int g_sizeHintCacheLevel = 0;
+static unsigned int g_sizeHintCacheId = 0;
+
 WidgetType register_widget_type()
 {
   static int type = (int)kFirstUserWidget;
@@ -160,6 +165,7 @@ void Widget::setTextQuiet(const std::string& text)
 
   m_text = text;
   enableFlags(HAS_TEXT);
+  invalidateSizeHint();
 }
 
 os::Font* Widget::font() const
@@ -190,6 +196,7 @@ void Widget::setTheme(Theme* theme)
 
   m_theme = theme;
   m_font = nullptr;
+  invalidateSizeHint();
 
   for (auto child : children())
     child->setTheme(theme);
@@ -208,6 +215,7 @@ void Widget::setStyle(Style* style)
   m_maxSize = m_theme->calcMaxSize(this, style);
   if (style->font())
     m_font = AddRef(style->font());
+  invalidateSizeHint();
 }
 
 // ===============================================================
@@ -221,6 +229,7 @@ void Widget::setVisible(bool state)
   if (state) {
     if (hasFlags(HIDDEN)) {
       disableFlags(HIDDEN);
+      invalidateSizeHint();
       invalidate();
 
       onVisible(true);
@@ -231,6 +240,7 @@ void Widget::setVisible(bool state)
       if (auto man = manager())
         man->freeWidget(this); // Free from manager
       enableFlags(HIDDEN);
+      invalidateSizeHint();
 
       onVisible(false);
     }
@@ -562,6 +572,7 @@ void Widget::addChild(Widget* child)
   m_children.push_back(child);
   child->m_parent = this;
   child->m_parentIndex = i;
+  invalidateSizeHint();
 }
 
 void Widget::removeChild(const WidgetsList::iterator& it)
@@ -593,6 +604,7 @@ void Widget::removeChild(const WidgetsList::iterator& it)
 
   child->m_parent = nullptr;
   child->m_parentIndex = -1;
+  invalidateSizeHint();
 }
 
 void Widget::removeChild(Widget* child)
@@ -638,6 +650,7 @@ void Widget::replaceChild(Widget* oldChild, Widget* newChild)
 
   newChild->m_parent = this;
   newChild->m_parentIndex = index;
+  invalidateSizeHint();
 }
 
 void Widget::insertChild(int index, Widget* child)
@@ -655,6 +668,7 @@ void Widget::insertChild(int index, Widget* child)
 
   child->m_parent = this;
   child->m_parentIndex = index;
+  invalidateSizeHint();
 }
 
 void Widget::moveChildTo(Widget* thisChild, Widget* toThisPosition)
@@ -676,6 +690,7 @@ void Widget::moveChildTo(Widget* thisChild, Widget* toThisPosition)
   thisChild->m_parentIndex = to;
   for (++it, end=m_children.end(); it!=end; ++it)
     ++(*it)->m_parentIndex;
+  invalidateSizeHint();
 }
 
 // ===============================================================
@@ -684,6 +699,7 @@ void Widget::moveChildTo(Widget* thisChild, Widget* toThisPosition)
 
 void Widget::layout()
 {
+  SizeHintCache cache;
   setBounds(bounds());
   invalidate();
 }
@@ -779,6 +795,13 @@ void Widget::setBoundsQuietly(const gfx::Rect& rc)
   if (m_bounds != rc) {
     m_bounds = rc;
 
+    // Some widgets calculate their size hint from their own bounds
+    // or from the bounds of their parent (e.g. TextBox inside a
+    // View).
+    invalidateSizeHint();
+    for (auto child : m_children)
+      child->m_sizeHintCacheId = 0;
+
     // Remove all paint messages for this widget.
     if (Manager* man = manager())
       man->removeMessagesFor(this, kPaintMessage);
@@ -793,6 +816,7 @@ void Widget::setBoundsQuietly(const gfx::Rect& rc)
 void Widget::setBorder(const Border& br)
 {
   m_border = br;
+  invalidateSizeHint();
 
 #ifdef _DEBUG
   if (m_style) {
@@ -805,6 +829,7 @@ void Widget::setBorder(const Border& br)
 void Widget::setChildSpacing(int childSpacing)
 {
   m_childSpacing = childSpacing;
+  invalidateSizeHint();
 
 #ifdef _DEBUG
   if (m_style) {
@@ -1034,6 +1059,7 @@ void Widget::setMinSize(const gfx::Size& sz)
   ASSERT(sz.w <= m_maxSize.w);
   ASSERT(sz.h <= m_maxSize.h);
   m_minSize = sz;
+  invalidateSizeHint();
 }
 
 void Widget::setMaxSize(const gfx::Size& sz)
@@ -1041,6 +1067,7 @@ void Widget::setMaxSize(const gfx::Size& sz)
   ASSERT(sz.w >= m_minSize.w);
   ASSERT(sz.h >= m_minSize.h);
   m_maxSize = sz;
+  invalidateSizeHint();
 }
 
 void Widget::setMinMaxSize(const gfx::Size& minSz,
@@ -1371,17 +1398,7 @@ void Widget::broadcastMouseMessage(const gfx::Point& screenPos,
 */
 Size Widget::sizeHint()
 {
-  if (m_sizeHint)
-    return *m_sizeHint;
-  else {
-    SizeHintEvent ev(this, Size(0, 0));
-    onSizeHint(ev);
-
-    Size sz(ev.sizeHint());
-    sz.w = std::clamp(sz.w, m_minSize.w, m_maxSize.w);
-    sz.h = std::clamp(sz.h, m_minSize.h, m_maxSize.h);
-    return sz;
-  }
+  return sizeHint(Size(0, 0));
 }
 
 /**
@@ -1402,6 +1419,11 @@ Size Widget::sizeHint(const Size& fitIn)
 {
   if (m_sizeHint)
     return *m_sizeHint;
+  else if (g_sizeHintCacheLevel > 0 &&
+           m_sizeHintCacheId == g_sizeHintCacheId &&
+           m_sizeHintFitIn == fitIn) {
+    return m_cachedSizeHint;
+  }
   else {
     SizeHintEvent ev(this, fitIn);
     onSizeHint(ev);
@@ -1409,6 +1431,12 @@ Size Widget::sizeHint(const Size& fitIn)
     Size sz(ev.sizeHint());
     sz.w = std::clamp(sz.w, m_minSize.w, m_maxSize.w);
     sz.h = std::clamp(sz.h, m_minSize.h, m_maxSize.h);
+
+    if (g_sizeHintCacheLevel > 0) {
+      m_sizeHintCacheId = g_sizeHintCacheId;
+      m_sizeHintFitIn = fitIn;
+      m_cachedSizeHint = sz;
+    }
     return sz;
   }
 }
@@ -1421,6 +1449,7 @@ void Widget::setSizeHint(const Size& fixedSize)
 {
   delete m_sizeHint;
   m_sizeHint = new Size(fixedSize);
+  invalidateSizeHint();
 }
 
 void Widget::setSizeHint(int fixedWidth, int fixedHeight)
@@ -1434,6 +1463,28 @@ void Widget::resetSizeHint()
     delete m_sizeHint;
     m_sizeHint = nullptr;
   }
+  invalidateSizeHint();
+}
+
+void Widget::invalidateSizeHint()
+{
+  for (Widget* widget=this; widget; widget=widget->m_parent)
+    widget->m_sizeHintCacheId = 0;
+}
+
+Widget::SizeHintCache::SizeHintCache()
+{
+  if (g_sizeHintCacheLevel++ == 0) {
+    // Skip 0 as it's used to mark invalid cached size hints
+    if (++g_sizeHintCacheId == 0)
+      ++g_sizeHintCacheId;
+  }
+}
+
+Widget::SizeHintCache::~SizeHintCache()
+{
+  ASSERT(g_sizeHintCacheLevel > 0);
+  --g_sizeHintCacheLevel;
 }
 
 // ===============================================================
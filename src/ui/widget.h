@@ -339,6 +339,26 @@ namespace ui {
     void setSizeHint(int fixedWidth, int fixedHeight);
     void resetSizeHint();
 
+    // Discards the size hint calculated for this widget (and its
+    // ancestors) in the active SizeHintCache. It's called
+    // automatically when the text, style, children, visibility, or
+    // bounds change, but widgets with a custom onSizeHint() must call
+    // it when other state used to calculate their size changes
+    // inside a layout pass.
+    void invalidateSizeHint();
+
+    // While an instance of this class is alive, sizeHint() results
+    // are memoized, so laying out a widget tree calculates the size
+    // hint of each widget once instead of once per ancestor. Widget
+    // creates one in layout(), and it can be nested.
+    class SizeHintCache {
+    public:
+      SizeHintCache();
+      ~SizeHintCache();
+      SizeHintCache(const SizeHintCache&) = delete;
+      SizeHintCache& operator=(const SizeHintCache&) = delete;
+    };
+
     // ===============================================================
     // MOUSE, FOCUS & KEYBOARD
     // ===============================================================
@@ -463,6 +483,12 @@ namespace ui {
     int m_parentIndex;            // Location/index of this widget in the parent's Widget::m_children vector
     gfx::Size* m_sizeHint;
 
+    // Size hint memoized in the active SizeHintCache (valid only if
+    // m_sizeHintCacheId is the ID of the active cache).
+    unsigned int m_sizeHintCacheId = 0;
+    gfx::Size m_sizeHintFitIn;
+    gfx::Size m_cachedSizeHint;
+
     // Keyboard shortcut to access this widget like Alt+mnemonic.  If
     // kMnemonicModifiersMask bit is zero, it means that the mnemonic
     // can be used without Alt or Command key modifiers (useful for
@@ -1,5 +1,5 @@
 // Aseprite UI Library
-// Copyright (C) 2022  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -55,3 +55,61 @@ TEST(Widget, ParentIndex)
   EXPECT_EQ(2, d.parentIndex());
   EXPECT_EQ(3, c.parentIndex());
 }
+
+namespace {
+
+class CountSizeHint : public Widget {
+public:
+  int count = 0;
+  gfx::Size size = gfx::Size(10, 10);
+protected:
+  void onSizeHint(SizeHintEvent& ev) override {
+    ++count;
+    ev.setSizeHint(size);
+  }
+};
+
+} // anonymous namespace
+
+TEST(Widget, SizeHintCache)
+{
+  Widget a;
+  CountSizeHint b;
+  a.addChild(&b);
+
+  // Without cache
+  b.sizeHint();
+  b.sizeHint();
+  EXPECT_EQ(2, b.count);
+
+  {
+    Widget::SizeHintCache cache;
+    EXPECT_EQ(gfx::Size(10, 10), b.sizeHint());
+    EXPECT_EQ(gfx::Size(10, 10), b.sizeHint());
+    EXPECT_EQ(3, b.count);
+
+    // Other fitIn size
+    b.sizeHint(gfx::Size(5, 0));
+    EXPECT_EQ(4, b.count);
+
+    b.size = gfx::Size(20, 20);
+    b.invalidateSizeHint();
+    EXPECT_EQ(gfx::Size(20, 20), b.sizeHint());
+    EXPECT_EQ(5, b.count);
+
+    // Changing the bounds of the parent invalidates the child
+    a.setBoundsQuietly(gfx::Rect(0, 0, 32, 32));
+    b.sizeHint();
+    b.sizeHint();
+    EXPECT_EQ(6, b.count);
+  }
+
+  // A new cache doesn't re-use the previous values
+  {
+    Widget::SizeHintCache cache;
+    b.sizeHint();
+    EXPECT_EQ(7, b.count);
+  }
+
+  a.removeChild(&b);
+}
@@ -322,6 +322,9 @@ void Window::remapWindow()
     setVisible(true);
   }
 
+  // Re-use the size hints calculated for the window size in its
+  // layout.
+  SizeHintCache cache;
   expandWindow(sizeHint());
 
   // load layout
@@ -22,6 +22,7 @@
 
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
 
 namespace updater {
@@ -94,6 +95,7 @@ public:
 
   void abort()
   {
+    const std::lock_guard lock(m_mutex);
     if (m_request)
       m_request->abort();
   }
@@ -110,7 +112,11 @@ public:
       url += extraParams;
     }
 
-    m_request.reset(new net::HttpRequest(url));
+    {
+      // abort() can be called from other thread
+      const std::lock_guard lock(m_mutex);
+      m_request.reset(new net::HttpRequest(url));
+    }
     net::HttpHeaders headers;
     headers.setHeader("User-Agent", getUserAgent());
     m_request->setHeaders(headers);
@@ -130,6 +136,7 @@ public:
   }
 
 private:
+  std::mutex m_mutex;
   std::unique_ptr<net::HttpRequest> m_request;
 };
 
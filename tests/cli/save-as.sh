@@ -1,5 +1,5 @@
 #! /bin/bash
-# Copyright (C) 2018-2023 Igara Studio S.A.
+# Copyright (C) 2018-2024 Igara Studio S.A.
 
 function list_files() {
     oldwd=$(pwd $PWDARG)
@@ -22,6 +22,12 @@ $ASEPRITE -b sprites/1empty3.aseprite --ignore-empty --save-as $d/image00.png ||
 expect "image00.png
 image02.png" "list_files $d"
 
+# --stats --save-as
+
+d=$t/save-as-stats
+$ASEPRITE -b sprites/1empty3.aseprite --ignore-empty --stats --save-as $d/image00.png >$d.txt || exit 1
+expect "$d/image00.png: 2 frame(s)" "cut -d, -f1 $d.txt"
+
 # --split-layers --save-as
 
 d=$t/save-as-split-layers
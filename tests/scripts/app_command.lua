@@ -664,3 +664,38 @@ do
   expect_img(i, { 1, 1, 1, 1,
                   1, 0, 0, 1 })
 end
+
+-- app.batch() merges the command notifications
+do
+  local s = Sprite(32, 32)
+  local before, after = 0, 0
+  local a = app.events:on('beforecommand', function() before = before + 1 end)
+  local b = app.events:on('aftercommand', function() after = after + 1 end)
+
+  local result = app.batch(
+    function()
+      for i=1,10 do
+        app.command.NewFrame()
+      end
+      expect_eq(1, before)
+      expect_eq(0, after)
+      return 5
+    end)
+  expect_eq(5, result)
+  expect_eq(11, #s.frames)
+  expect_eq(1, before)
+  expect_eq(1, after)
+
+  app.command.NewFrame()
+  expect_eq(2, before)
+  expect_eq(2, after)
+
+  -- Errors end the batch too
+  assert(not pcall(app.batch, function() error("error") end))
+  app.command.NewFrame()
+  expect_eq(3, before)
+  expect_eq(3, after)
+
+  app.events:off(a)
+  app.events:off(b)
+end
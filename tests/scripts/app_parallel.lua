@@ -0,0 +1,60 @@
+-- Copyright (C) 2024  Igara Studio S.A.
+--
+-- This file is released under the terms of the MIT license.
+-- Read LICENSE.txt for more information.
+
+dofile('./test_utils.lua')
+
+local rgba = app.pixelColor.rgba
+
+-- Basic values
+do
+  local results = app.parallel(
+    function(t)
+      return { sum=t.a+t.b, name=t.name:upper(), list={ t.a, t.b } }
+    end,
+    { { a=1, b=2, name="x" },
+      { a=3, b=4.5, name="y" },
+      { a=5, b=6, name="z" } })
+  expect_eq(3, #results)
+  expect_eq(3, results[1].sum)
+  expect_eq(7.5, results[2].sum)
+  expect_eq("Z", results[3].name)
+  expect_eq(5, results[3].list[1])
+  expect_eq(6, results[3].list[2])
+end
+
+-- Images are copied (snapshots) to/from workers
+do
+  local images = {}
+  for i=1,8 do
+    local img = Image(4, 4)
+    img:clear(rgba(i, 0, 0, 255))
+    images[i] = img
+  end
+
+  local results = app.parallel(
+    function(img)
+      local r = app.pixelColor.rgbaR(img:getPixel(0, 0))
+      img:drawPixel(0, 0, app.pixelColor.rgba(0, r*2, 0, 255))
+      return { image=img, r=r }
+    end,
+    images, { threads=3 })
+  expect_eq(8, #results)
+  for i=1,8 do
+    expect_eq(i, results[i].r)
+    expect_eq(rgba(0, i*2, 0, 255), results[i].image:getPixel(0, 0))
+    expect_eq(rgba(i, 0, 0, 255), results[i].image:getPixel(1, 0))
+    -- Original image wasn't modified
+    expect_eq(rgba(i, 0, 0, 255), images[i]:getPixel(0, 0))
+  end
+end
+
+-- Errors
+do
+  local upvalue = 1
+  assert(not pcall(app.parallel, function(x) return x+upvalue end, { 1 }))
+  assert(not pcall(app.parallel, function(x) error("fail") end, { 1, 2 }))
+  assert(not pcall(app.parallel, function(x) return x end, { Sprite(2, 2) }))
+  expect_eq(0, #app.parallel(function(x) return x end, { }))
+end
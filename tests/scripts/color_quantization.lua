@@ -1,4 +1,4 @@
--- Copyright (C) 2019-2022  Igara Studio S.A.
+-- Copyright (C) 2019-2024  Igara Studio S.A.
 --
 -- This file is released under the terms of the MIT license.
 -- Read LICENSE.txt for more information.
@@ -199,3 +199,38 @@ do
                    1, 0,
                    0, 0 })
 end
+
+----------------------------------------------------------------------
+-- app.command.ColorQuantization with frameStep/pixelStep sampling
+
+do
+  local s = Sprite(2, 2)
+  app.command.BackgroundFromLayer()
+  s:newEmptyFrame()
+  s:newEmptyFrame()
+
+  local l = s.layers[1]
+  local p = s.palettes[1]
+  array_to_pixels({ rgba(255, 0, 0), rgba(255, 0, 0),
+                    rgba(255, 0, 0), rgba(0, 255, 0) }, l:cel(1).image)
+  array_to_pixels({ rgba(0, 0, 255), rgba(0, 0, 255),
+                    rgba(0, 0, 255), rgba(0, 0, 255) },
+                  (l:cel(2) or s:newCel(l, 2)).image)
+  array_to_pixels({ rgba(255, 0, 0), rgba(255, 0, 0),
+                    rgba(255, 0, 0), rgba(255, 0, 0) },
+                  (l:cel(3) or s:newCel(l, 3)).image)
+
+  app.command.ColorQuantization{ algorithm="rgb5a3" }
+  assert(#p == 3)
+
+  -- Only frames 1 and 3
+  app.command.ColorQuantization{ algorithm="rgb5a3", frameStep=2 }
+  assert(#p == 2)
+  assert(p:getColor(0) == Color(255, 0, 0))
+  assert(p:getColor(1) == Color(0, 255, 0))
+
+  -- Only the first pixel of frames 1 and 3
+  app.command.ColorQuantization{ algorithm="rgb5a3", frameStep=2, pixelStep=2 }
+  assert(#p == 1)
+  assert(p:getColor(0) == Color(255, 0, 0))
+end
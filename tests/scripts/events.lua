@@ -134,3 +134,29 @@ do
   s:close()
   app.events:off(onSiteChange)
 end
+
+-- Coalesced events (without UI they are delivered immediately with
+-- ev.count=1)
+do
+  local s = Sprite(32, 32)
+  local calls, count = 0, 0
+  local listener = s.events:on('change',
+                               function(ev)
+                                 calls = calls + 1
+                                 count = count + ev.count
+                                 assert(ev.fromUndo ~= nil)
+                               end,
+                               { coalesce=true, maxRate=30 })
+  s.width = 64
+  s.width = 128
+  expect_eq(2, calls)
+  expect_eq(2, count)
+  s.events:off(listener)
+
+  -- 'beforecommand' cannot be coalesced
+  assert(not pcall(function()
+                     app.events:on('beforecommand', function() end,
+                                   { coalesce=true })
+                   end))
+  s:close()
+end
@@ -43,6 +43,109 @@ do
   assert(not a:isEmpty())
 end
 
+-- Get/put pixels in rectangles
+do
+  local b = Image(4, 3, ColorMode.INDEXED)
+  b:putPixels({ 1, 2, 3, 4,
+                5, 6, 7, 8,
+                9, 10, 11, 12 })
+  assert(b:getPixel(3, 0) == 4)
+  assert(b:getPixel(0, 2) == 9)
+
+  local s = b:getPixels(Rectangle(1, 1, 2, 2))
+  assert(s == string.char(6, 7, 10, 11))
+  assert(#b:getPixels() == 12)
+
+  b:putPixels(Rectangle(0, 0, 2, 1), string.char(20, 21))
+  assert(b:getPixel(0, 0) == 20)
+  assert(b:getPixel(1, 0) == 21)
+  assert(b:getPixel(2, 0) == 3)
+
+  b:putPixels(Rectangle(2, 1, 2, 2), { 30, 31, 32, 33 })
+  assert(b:getPixels(Rectangle(2, 1, 2, 2)) == string.char(30, 31, 32, 33))
+
+  local c = Image(2, 2)
+  c:batch(function()
+    c:putPixel(0, 0, rgba(255, 0, 0))
+    c:putPixel(1, 1, rgba(0, 0, 255))
+  end)
+  assert(c:getPixel(0, 0) == rgba(255, 0, 0))
+  assert(c:getPixel(1, 1) == rgba(0, 0, 255))
+end
+
+-- Image operations (map/remap/threshold/blend)
+do
+  local b = Image(2, 2)
+  b:putPixels({ rgba(10, 20, 30, 255), rgba(200, 100, 50, 255),
+                rgba(0, 0, 0, 0), rgba(255, 255, 255, 128) })
+
+  local inv = {}
+  for v=0,255 do inv[v] = 255-v end
+  b:map(inv)
+  assert(b:getPixel(0, 0) == rgba(245, 235, 225, 255))
+  assert(b:getPixel(1, 1) == rgba(0, 0, 0, 128))
+
+  b:map{ alpha=inv }
+  assert(b:getPixel(0, 0) == rgba(245, 235, 225, 0))
+
+  b:remap{ [rgba(0, 0, 0, 127)]=rgba(1, 2, 3, 4) }
+  assert(b:getPixel(1, 1) == rgba(1, 2, 3, 4))
+
+  local c = Image(2, 1)
+  c:putPixels({ rgba(10, 10, 10, 255), rgba(250, 250, 250, 255) })
+  c:threshold(128)
+  assert(c:getPixel(0, 0) == rgba(0, 0, 0, 255))
+  assert(c:getPixel(1, 0) == rgba(255, 255, 255, 255))
+
+  local d = Image(2, 1)
+  d:blend(c)
+  assert(d:getPixel(0, 0) == rgba(0, 0, 0, 255))
+  assert(d:getPixel(1, 0) == rgba(255, 255, 255, 255))
+
+  local idx = Image(3, 1, ColorMode.INDEXED)
+  idx:putPixels({ 1, 2, 3 })
+  idx:remap{ [2]=5 }
+  assert(idx:getPixels() == string.char(1, 5, 3))
+end
+
+-- Byte view of the image buffer
+do
+  local pc = app.pixelColor
+  local a = Image(3, 2)
+  a:clear(pc.rgba(1, 2, 3, 4))
+  local v = a.byteView
+  assert(v.isValid)
+  assert(#v == 3*2*4)
+  assert(v.rowStride == a.rowStride)
+  local r, g, b, al = v:byte(1, 4)
+  assert(r == 1 and g == 2 and b == 3 and al == 4)
+  assert(v:sub(5, 8) == string.char(1, 2, 3, 4))
+
+  v:setByte(13, 10, 20, 30, 255)
+  assert(a:getPixel(0, 1) == pc.rgba(10, 20, 30, 255))
+  v:write(5, string.char(40, 50, 60, 70))
+  assert(a:getPixel(1, 0) == pc.rgba(40, 50, 60, 70))
+
+  local pos = v:pack(9, "BBBB", 7, 8, 9, 11)
+  assert(pos == 13)
+  assert(a:getPixel(2, 0) == pc.rgba(7, 8, 9, 11))
+  local u, nextPos = v:unpack("<I4", 9)
+  assert(u == pc.rgba(7, 8, 9, 11))
+  assert(nextPos == 13)
+  assert(v:sub() == a.bytes)
+
+  -- Out of bounds access
+  assert(not pcall(function() v:byte(0) end))
+  assert(not pcall(function() v:byte(24, 25) end))
+  assert(not pcall(function() v:write(23, "abc") end))
+
+  -- The view is invalidated when the image is resized
+  a:resize(4, 4)
+  assert(not v.isValid)
+  assert(not pcall(function() return #v end))
+  assert(#a.byteView == 4*4*4)
+end
+
 -- Clear
 do
   local spec = ImageSpec{
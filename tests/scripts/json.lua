@@ -101,3 +101,24 @@ do
 
   assert(tostring(o) == '{"a": [10, 20, 30, 40], "b": {"c": 1, "d": 2}}')
 end
+
+-- Decode directly to Lua tables
+do
+  local t = json.decode('{"a":[1,2.5,"x\\n\\u00e1"],"b":{"c":null,"d":false}}',
+                        { table=true })
+  assert(type(t) == "table")
+  assert(#t.a == 3)
+  assert(math.type(t.a[1]) == "integer")
+  assert(t.a[1] == 1)
+  assert(t.a[2] == 2.5)
+  assert(t.a[3] == "x\ná")
+  assert(t.b.c == nil)
+  assert(t.b.d == false)
+
+  assert(json.encode(t) == '{"a": [1, 2.5, "x\\n\u{e1}"], "b": {"d": false}}')
+  assert(json.encode({ b=1, a={}, ["c\"d"]=true }) == '{"a": [], "b": 1, "c\\"d": true}')
+
+  local ok, msg = pcall(json.decode, '{"a":[1,2}', { table=true })
+  assert(not ok)
+  assert(msg:find("json parse error"))
+end